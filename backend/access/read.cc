@@ -39,6 +39,37 @@ std::ostream& operator<<(std::ostream& out, const ReadArg& arg) {
   return out;
 }
 
+void RowBatch::Reset(int num_columns) {
+  num_rows = 0;
+  columns.resize(num_columns);
+  for (ColumnVector& column : columns) {
+    column.values.clear();
+    column.is_null.clear();
+  }
+}
+
+absl::Status RowReader::ReadInterleaved(
+    const ReadArg& parent_arg, const ReadArg& child_arg,
+    std::unique_ptr<RowCursor>* parent_cursor,
+    std::unique_ptr<RowCursor>* child_cursor) {
+  absl::Status status = Read(parent_arg, parent_cursor);
+  if (!status.ok()) {
+    return status;
+  }
+  return Read(child_arg, child_cursor);
+}
+
+bool RowCursor::NextBatch(int max_rows, RowBatch* batch) {
+  batch->Reset(NumColumns());
+  while (batch->num_rows < max_rows && Next()) {
+    for (int i = 0; i < NumColumns(); ++i) {
+      batch->AddValue(i, ColumnValue(i));
+    }
+    ++batch->num_rows;
+  }
+  return batch->num_rows > 0;
+}
+
 }  // namespace backend
 }  // namespace emulator
 }  // namespace spanner
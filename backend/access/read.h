@@ -17,8 +17,10 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACCESS_READ_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACCESS_READ_H_
 
+#include <memory>
 #include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "zetasql/public/type.h"
@@ -55,6 +57,32 @@ struct ReadArg {
 // Streams a debug string representation of ReadArg to out.
 std::ostream& operator<<(std::ostream& out, const ReadArg& arg);
 
+// ColumnVector holds the values of a column in consecutive rows of a
+// RowCursor.
+struct ColumnVector {
+  // Values of the column, one per row, all of the type of the column.
+  std::vector<zetasql::Value> values;
+
+  // Null bitmap of the column: is_null[r] is true if values[r] is NULL.
+  std::vector<bool> is_null;
+};
+
+// RowBatch holds consecutive rows of a RowCursor column by column, see
+// RowCursor::NextBatch().
+struct RowBatch {
+  int num_rows = 0;
+  std::vector<ColumnVector> columns;
+
+  // Removes all rows, leaving `num_columns` empty columns.
+  void Reset(int num_columns);
+
+  // Appends the value of column `i` in the next row.
+  void AddValue(int i, zetasql::Value value) {
+    columns[i].is_null.push_back(value.is_null());
+    columns[i].values.push_back(std::move(value));
+  }
+};
+
 // RowCursor is an abstract interface for iterating over rows.
 //
 // All rows will have the same number of columns, column types, and column
@@ -97,6 +125,16 @@ class RowCursor {
   // Returns the type of the specified column. Types are owned by the database's
   // TypeFactory and not by the RowCursor.
   virtual const zetasql::Type* ColumnType(int i) const = 0;
+
+  // Moves past the next rows, up to `max_rows` of them, and replaces the
+  // contents of `batch` with their values. Returns false, with an empty batch,
+  // if the result set is exhausted or the cursor encountered an error, as
+  // Next() does. The rows read before an error are returned in a batch, and
+  // the error by Status(). ColumnValue() may not be called after NextBatch()
+  // until Next() returns true again. The default implementation calls Next()
+  // and ColumnValue() for each row; cursors which hold their rows in memory
+  // override it to copy them in bulk.
+  virtual bool NextBatch(int max_rows, RowBatch* batch);
 };
 
 // RowReader defines an abstract interface for reading rows from a database.
@@ -111,6 +149,18 @@ class RowReader {
   // Reads rows from a database based on the provided read_arg.
   virtual absl::Status Read(const ReadArg& read_arg,
                             std::unique_ptr<RowCursor>* cursor) = 0;
+
+  // Reads the rows of `parent_arg`, and the rows of the table of `child_arg`
+  // interleaved (directly or not) in the table of `parent_arg`, as two
+  // cursors. The key set of `child_arg` is that of `parent_arg`, so that the
+  // child rows read are those under the parent rows read. Used by merge joins
+  // of a table with a descendant. The default implementation reads each of
+  // the two separately; readers of storages which co-locate interleaved
+  // tables override it to read both in a single pass.
+  virtual absl::Status ReadInterleaved(
+      const ReadArg& parent_arg, const ReadArg& child_arg,
+      std::unique_ptr<RowCursor>* parent_cursor,
+      std::unique_ptr<RowCursor>* child_cursor);
 };
 
 }  // namespace backend
@@ -109,6 +109,15 @@ class RowWriter {
 
   // Write applies the mutation m to the database.
   virtual absl::Status Write(const Mutation& m) = 0;
+
+  // WriteBatch applies the mutation m, which holds one batch of the rows
+  // modified by a single statement, to the database. Constraints spanning
+  // several rows need only be verified once the last batch of the statement
+  // has been applied, so that large statements can be written incrementally.
+  // The default implementation applies each batch with Write.
+  virtual absl::Status WriteBatch(const Mutation& m, bool last_batch) {
+    return Write(m);
+  }
 };
 
 }  // namespace backend
@@ -17,8 +17,10 @@
 #include "backend/actions/action.h"
 
 #include "absl/status/status.h"
+#include "absl/types/span.h"
 #include "backend/actions/ops.h"
 #include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
 
 namespace google {
 namespace spanner {
@@ -35,6 +37,14 @@ absl::Status Validator::Validate(const ActionContext* ctx,
                     op);
 }
 
+absl::Status Validator::ValidateBatch(const ActionContext* ctx,
+                                      absl::Span<const WriteOp> ops) const {
+  for (const WriteOp& op : ops) {
+    ZETASQL_RETURN_IF_ERROR(Validate(ctx, op));
+  }
+  return absl::OkStatus();
+}
+
 absl::Status Validator::Validate(const ActionContext* ctx,
                                  const InsertOp& op) const {
   return absl::OkStatus();
@@ -81,6 +91,14 @@ absl::Status Effector::Effect(const ActionContext* ctx,
                     op);
 }
 
+absl::Status Effector::EffectBatch(const ActionContext* ctx,
+                                   absl::Span<const WriteOp> ops) const {
+  for (const WriteOp& op : ops) {
+    ZETASQL_RETURN_IF_ERROR(Effect(ctx, op));
+  }
+  return absl::OkStatus();
+}
+
 absl::Status Effector::Effect(const ActionContext* ctx,
                               const InsertOp& op) const {
   return absl::OkStatus();
@@ -104,6 +122,14 @@ absl::Status Verifier::Verify(const ActionContext* ctx,
                     op);
 }
 
+absl::Status Verifier::VerifyBatch(const ActionContext* ctx,
+                                   absl::Span<const WriteOp> ops) const {
+  for (const WriteOp& op : ops) {
+    ZETASQL_RETURN_IF_ERROR(Verify(ctx, op));
+  }
+  return absl::OkStatus();
+}
+
 absl::Status Verifier::Verify(const ActionContext* ctx,
                               const InsertOp& op) const {
   return absl::OkStatus();
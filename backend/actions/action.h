@@ -19,6 +19,7 @@
 
 #include <string>
 
+#include "absl/types/span.h"
 #include "backend/actions/context.h"
 #include "backend/actions/ops.h"
 #include "backend/schema/catalog/table.h"
@@ -53,6 +54,13 @@ class Validator {
   // Validates the given WriteOp within the give action context.
   absl::Status Validate(const ActionContext* ctx, const WriteOp& op) const;
 
+  // Validates a batch of WriteOps of the same type on the same table, sorted by
+  // key and with no duplicate keys. Validators which look up rows override this
+  // to share a single read across the batch. By default, each WriteOp is
+  // validated in turn.
+  virtual absl::Status ValidateBatch(const ActionContext* ctx,
+                                     absl::Span<const WriteOp> ops) const;
+
  private:
   virtual absl::Status Validate(const ActionContext* ctx,
                                 const InsertOp& op) const;
@@ -135,6 +143,13 @@ class Effector {
   // action context.
   absl::Status Effect(const ActionContext* ctx, const WriteOp& op) const;
 
+  // Creates additional WriteOp(s) for a batch of WriteOps of the same type on
+  // the same table, sorted by key and with no duplicate keys. Effectors which
+  // look up rows override this to share a single read across the batch. By
+  // default, the effects of each WriteOp are created in turn.
+  virtual absl::Status EffectBatch(const ActionContext* ctx,
+                                   absl::Span<const WriteOp> ops) const;
+
  private:
   virtual absl::Status Effect(const ActionContext* ctx,
                               const InsertOp& op) const;
@@ -154,6 +169,13 @@ class Verifier {
   // context.
   absl::Status Verify(const ActionContext* ctx, const WriteOp& op) const;
 
+  // Verifies a batch of WriteOps of the same type on the same table, sorted by
+  // key and with no duplicate keys. Verifiers which look up rows override this
+  // to share a single read across the batch. By default, each WriteOp is
+  // verified in turn.
+  virtual absl::Status VerifyBatch(const ActionContext* ctx,
+                                   absl::Span<const WriteOp> ops) const;
+
  private:
   virtual absl::Status Verify(const ActionContext* ctx,
                               const InsertOp& op) const;
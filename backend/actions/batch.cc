@@ -0,0 +1,111 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/actions/batch.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/storage/iterator.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+std::vector<Key> KeysOf(absl::Span<const WriteOp> ops) {
+  std::vector<Key> keys;
+  keys.reserve(ops.size());
+  for (const WriteOp& op : ops) {
+    keys.push_back(KeyOf(op));
+  }
+  return keys;
+}
+
+zetasql_base::StatusOr<std::vector<absl::optional<ValueList>>> LookupRowsInBatch(
+    const ActionContext* ctx, const Table* table, absl::Span<const Key> keys,
+    absl::Span<const Column* const> columns) {
+  std::vector<absl::optional<ValueList>> rows(keys.size());
+  if (keys.empty()) {
+    return rows;
+  }
+
+  // The cached rows hold all the columns of the table, of which `columns` are
+  // picked out.
+  std::vector<int> positions;
+  positions.reserve(columns.size());
+  for (const Column* column : columns) {
+    positions.push_back(
+        std::find(table->columns().begin(), table->columns().end(), column) -
+        table->columns().begin());
+  }
+  ZETASQL_ASSIGN_OR_RETURN(
+      std::vector<const absl::optional<ValueList>*> table_rows,
+      ctx->LookupRows(table, keys));
+  for (int i = 0; i < keys.size(); ++i) {
+    if (!table_rows[i]->has_value()) {
+      continue;
+    }
+    ValueList values;
+    values.reserve(positions.size());
+    for (int position : positions) {
+      values.push_back((**table_rows[i])[position]);
+    }
+    rows[i] = std::move(values);
+  }
+  return rows;
+}
+
+zetasql_base::StatusOr<std::vector<Key>> ReadKeysWithPrefixesInBatch(
+    const ActionContext* ctx, const Table* table,
+    absl::Span<const Key> prefixes) {
+  std::vector<Key> keys;
+  if (prefixes.empty()) {
+    return keys;
+  }
+
+  ZETASQL_ASSIGN_OR_RETURN(
+      std::unique_ptr<StorageIterator> itr,
+      ctx->store()->Read(table,
+                         KeyRange::ClosedOpen(prefixes.front(),
+                                              prefixes.back().ToPrefixLimit()),
+                         /*columns=*/{}));
+  int i = 0;
+  while (i < prefixes.size() && itr->Next()) {
+    const Key& key = itr->Key();
+    // Skip the prefixes whose keys all precede the current row.
+    while (i < prefixes.size() && !prefixes[i].IsPrefixOf(key) &&
+           prefixes[i] < key) {
+      ++i;
+    }
+    if (i < prefixes.size() && prefixes[i].IsPrefixOf(key)) {
+      keys.push_back(key);
+    }
+  }
+  ZETASQL_RETURN_IF_ERROR(itr->Status());
+  return keys;
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
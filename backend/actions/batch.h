@@ -0,0 +1,67 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_BATCH_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_BATCH_H_
+
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "backend/actions/context.h"
+#include "backend/actions/ops.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/value.h"
+#include "backend/schema/catalog/column.h"
+#include "backend/schema/catalog/table.h"
+#include "zetasql/base/statusor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// Helpers for actions which process a batch of row operations at once.
+//
+// A batch holds operations of the same type on the same table, sorted by key
+// and with no duplicate keys (see ActionRegistry). Instead of looking up rows
+// one operation at a time, batched actions read the smallest key range which
+// spans all the rows they need and merge it with the batch.
+
+// Returns the keys of the operations in `ops`, in the same order.
+std::vector<Key> KeysOf(absl::Span<const WriteOp> ops);
+
+// Looks up the rows of `table` with the given `keys`, which must be sorted and
+// have no duplicates, with a single read. Returns one entry for each key, which
+// holds the values of `columns` if the row exists and is empty otherwise. The
+// rows are looked up through ActionContext::LookupRows, so the actions on the
+// same batch share the read.
+zetasql_base::StatusOr<std::vector<absl::optional<ValueList>>> LookupRowsInBatch(
+    const ActionContext* ctx, const Table* table, absl::Span<const Key> keys,
+    absl::Span<const Column* const> columns);
+
+// Returns the keys of `table` which have one of `prefixes` as a prefix, in key
+// order, with a single read. `prefixes` must be sorted and have no duplicates.
+zetasql_base::StatusOr<std::vector<Key>> ReadKeysWithPrefixesInBatch(
+    const ActionContext* ctx, const Table* table,
+    absl::Span<const Key> prefixes);
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_BATCH_H_
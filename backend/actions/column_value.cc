@@ -16,17 +16,25 @@
 
 #include "backend/actions/column_value.h"
 
-#include "zetasql/public/functions/string.h"
+#include <vector>
+
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "absl/types/variant.h"
 #include "backend/actions/action.h"
 #include "backend/actions/context.h"
 #include "backend/actions/ops.h"
 #include "backend/datamodel/key.h"
+#include "backend/schema/catalog/column.h"
+#include "backend/schema/catalog/table.h"
 #include "common/clock.h"
 #include "common/constants.h"
 #include "common/errors.h"
 #include "common/limits.h"
+#include "common/utf8.h"
 #include "absl/status/status.h"
 #include "zetasql/base/status_macros.h"
 
@@ -58,10 +66,10 @@ absl::Status ValidateColumnValueType(const Table* table,
 
 absl::Status ValidateKeyNotNull(const Table* table, const Key& key) {
   // Incoming key should already have the correct number of columns
-  // corresponding to the primary key of the given table. So we do not check it
-  // here.
+  // corresponding to the primary key of the given table, or fewer for prefix
+  // deletes. So we do not check it here.
   absl::Span<const KeyColumn* const> primary_key = table->primary_key();
-  for (int i = 0; i < primary_key.size(); ++i) {
+  for (int i = 0; i < key.NumColumns(); ++i) {
     if (!primary_key.at(i)->column()->is_nullable() &&
         key.ColumnValue(i).is_null()) {
       return error::CannotParseKeyValue(
@@ -76,10 +84,8 @@ absl::Status ValidateColumnStringValue(const Table* table, const Column* column,
                                        const zetasql::Value& value) {
   // Validate that strings do not exceed max length.
   if (!value.is_null()) {
-    absl::Status error;
     int64_t encoded_chars = 0;
-    if (!zetasql::functions::LengthUtf8(value.string_value(), &encoded_chars,
-                                          &error)) {
+    if (!Utf8Length(value.string_value(), &encoded_chars)) {
       return error::InvalidStringEncoding(table->Name(), column->Name());
     }
     if (encoded_chars > column->effective_max_length()) {
@@ -126,38 +132,57 @@ absl::Status ValidateColumnTimestampValue(const Column* const column,
                                           Clock* clock) {
   // Check that user provided timestamp value is not in future. Sentinel max
   // timestamp value for commit timestamp column can only be set internally.
+  // Reading the clock for the check does not advance it.
   if (column->allows_commit_timestamp() && !value.is_null() &&
       value.ToTime() != kCommitTimestampValueSentinel &&
-      value.ToTime() > clock->Now()) {
+      value.ToTime() > clock->NowForRead()) {
     return error::CommitTimestampInFuture(value.ToTime());
   }
   return absl::OkStatus();
 }
 
-absl::Status ValidateInsertUpdateOp(const Table* table,
-                                    const std::vector<const Column*>& columns,
-                                    const std::vector<zetasql::Value>& values,
-                                    Clock* clock) {
-  for (int i = 0; i < columns.size(); i++) {
-    ZETASQL_RETURN_IF_ERROR(ValidateColumnValueType(table, columns[i], values[i]));
-    switch (columns[i]->GetType()->kind()) {
-      case zetasql::TYPE_ARRAY:
-        ZETASQL_RETURN_IF_ERROR(ValidateColumnArrayValue(table, columns[i], values[i]));
-        break;
-      case zetasql::TYPE_BYTES:
-        ZETASQL_RETURN_IF_ERROR(ValidateColumnBytesValue(table, columns[i], values[i]));
-        break;
-      case zetasql::TYPE_STRING:
-        ZETASQL_RETURN_IF_ERROR(
-            ValidateColumnStringValue(table, columns[i], values[i]));
-        break;
-      case zetasql::TYPE_TIMESTAMP:
-        ZETASQL_RETURN_IF_ERROR(
-            ValidateColumnTimestampValue(columns[i], values[i], clock));
-        break;
-      default:
-        continue;
-    }
+// Returns the columns written by `op`, or null for deletes.
+const std::vector<const Column*>* WrittenColumns(const WriteOp& op) {
+  if (const InsertOp* insert = absl::get_if<InsertOp>(&op)) {
+    return &insert->columns;
+  }
+  if (const UpdateOp* update = absl::get_if<UpdateOp>(&op)) {
+    return &update->columns;
+  }
+  return nullptr;
+}
+
+}  //  namespace
+
+absl::Status ValidateColumnValues(const Table* table, const Column* column,
+                                  absl::Span<const zetasql::Value> values,
+                                  Clock* clock) {
+  for (const zetasql::Value& value : values) {
+    ZETASQL_RETURN_IF_ERROR(ValidateColumnValueType(table, column, value));
+  }
+  switch (column->GetType()->kind()) {
+    case zetasql::TYPE_ARRAY:
+      for (const zetasql::Value& value : values) {
+        ZETASQL_RETURN_IF_ERROR(ValidateColumnArrayValue(table, column, value));
+      }
+      break;
+    case zetasql::TYPE_BYTES:
+      for (const zetasql::Value& value : values) {
+        ZETASQL_RETURN_IF_ERROR(ValidateColumnBytesValue(table, column, value));
+      }
+      break;
+    case zetasql::TYPE_STRING:
+      for (const zetasql::Value& value : values) {
+        ZETASQL_RETURN_IF_ERROR(ValidateColumnStringValue(table, column, value));
+      }
+      break;
+    case zetasql::TYPE_TIMESTAMP:
+      for (const zetasql::Value& value : values) {
+        ZETASQL_RETURN_IF_ERROR(ValidateColumnTimestampValue(column, value, clock));
+      }
+      break;
+    default:
+      break;
   }
   return absl::OkStatus();
 }
@@ -171,17 +196,140 @@ absl::Status ValidateKeySize(const Table* table, const Key& key) {
   return absl::OkStatus();
 }
 
-}  //  namespace
+ColumnValueValidator::ColumnValueValidator(const Table* table) {
+  column_checks_.reserve(table->columns().size());
+  for (const Column* column : table->columns()) {
+    column_checks_.emplace(column, CompileColumnCheck(column));
+  }
+  for (const KeyColumn* key_column : table->primary_key()) {
+    const zetasql::Type* type = key_column->column()->GetType();
+    if (type->IsString() || type->IsBytes()) {
+      check_key_size_ = true;
+    }
+  }
+}
+
+ColumnValueValidator::ColumnCheck ColumnValueValidator::CompileColumnCheck(
+    const Column* column) {
+  const zetasql::Type* type = column->GetType();
+  ValueCheck check = ValueCheck::kNone;
+  switch (type->kind()) {
+    case zetasql::TYPE_ARRAY:
+      if (type->AsArray()->element_type()->IsString() ||
+          type->AsArray()->element_type()->IsBytes()) {
+        check = ValueCheck::kArray;
+      }
+      break;
+    case zetasql::TYPE_BYTES:
+      check = ValueCheck::kBytes;
+      break;
+    case zetasql::TYPE_STRING:
+      check = ValueCheck::kString;
+      break;
+    case zetasql::TYPE_TIMESTAMP:
+      if (column->allows_commit_timestamp()) {
+        check = ValueCheck::kCommitTimestamp;
+      }
+      break;
+    default:
+      break;
+  }
+  return ColumnCheck{column, type->kind(), column->is_nullable(), check};
+}
+
+void ColumnValueValidator::ResolveChecks(
+    const std::vector<const Column*>& columns,
+    std::vector<ColumnCheck>* checks) const {
+  checks->clear();
+  checks->reserve(columns.size());
+  for (const Column* column : columns) {
+    auto it = column_checks_.find(column);
+    checks->push_back(it != column_checks_.end() ? it->second
+                                                 : CompileColumnCheck(column));
+  }
+}
+
+absl::Status ColumnValueValidator::ValidateValues(
+    const Table* table, absl::Span<const ColumnCheck> checks,
+    const std::vector<zetasql::Value>& values, Clock* clock) {
+  for (int i = 0; i < checks.size(); ++i) {
+    const ColumnCheck& check = checks[i];
+    const zetasql::Value& value = values[i];
+    if (value.type_kind() != check.type_kind ||
+        (value.is_null() && !check.nullable)) {
+      return ValidateColumnValueType(table, check.column, value);
+    }
+    switch (check.check) {
+      case ValueCheck::kNone:
+        break;
+      case ValueCheck::kString:
+        ZETASQL_RETURN_IF_ERROR(ValidateColumnStringValue(table, check.column, value));
+        break;
+      case ValueCheck::kBytes:
+        ZETASQL_RETURN_IF_ERROR(ValidateColumnBytesValue(table, check.column, value));
+        break;
+      case ValueCheck::kArray:
+        ZETASQL_RETURN_IF_ERROR(ValidateColumnArrayValue(table, check.column, value));
+        break;
+      case ValueCheck::kCommitTimestamp:
+        ZETASQL_RETURN_IF_ERROR(
+            ValidateColumnTimestampValue(check.column, value, clock));
+        break;
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ColumnValueValidator::ValidateKey(const Table* table,
+                                               const Key& key) const {
+  if (!check_key_size_) {
+    return absl::OkStatus();
+  }
+  return ValidateKeySize(table, key);
+}
+
+absl::Status ColumnValueValidator::ValidateBatch(
+    const ActionContext* ctx, absl::Span<const WriteOp> ops) const {
+  // Operations of a batch usually come from the same mutation and so write the
+  // same columns, whose checks are then resolved once.
+  std::vector<ColumnCheck> checks;
+  const std::vector<const Column*>* checked_columns = nullptr;
+  for (const WriteOp& op : ops) {
+    const std::vector<const Column*>* columns = WrittenColumns(op);
+    if (columns == nullptr) {
+      ZETASQL_RETURN_IF_ERROR(Validator::Validate(ctx, op));
+      continue;
+    }
+    if (checked_columns == nullptr || *columns != *checked_columns) {
+      ResolveChecks(*columns, &checks);
+      checked_columns = columns;
+    }
+    if (const InsertOp* insert = absl::get_if<InsertOp>(&op)) {
+      ZETASQL_RETURN_IF_ERROR(ValidateKey(insert->table, insert->key));
+      ZETASQL_RETURN_IF_ERROR(
+          ValidateValues(insert->table, checks, insert->values, ctx->clock()));
+    } else {
+      const UpdateOp& update = absl::get<UpdateOp>(op);
+      ZETASQL_RETURN_IF_ERROR(
+          ValidateValues(update.table, checks, update.values, ctx->clock()));
+    }
+  }
+  return absl::OkStatus();
+}
 
 absl::Status ColumnValueValidator::Validate(const ActionContext* ctx,
                                             const InsertOp& op) const {
-  ZETASQL_RETURN_IF_ERROR(ValidateKeySize(op.table, op.key));
-  return ValidateInsertUpdateOp(op.table, op.columns, op.values, ctx->clock());
+  ZETASQL_RETURN_IF_ERROR(ValidateKey(op.table, op.key));
+  std::vector<ColumnCheck> checks;
+  ResolveChecks(op.columns, &checks);
+  return ValidateValues(op.table, checks, op.values, ctx->clock());
 }
 
 absl::Status ColumnValueValidator::Validate(const ActionContext* ctx,
                                             const UpdateOp& op) const {
-  return ValidateInsertUpdateOp(op.table, op.columns, op.values, ctx->clock());
+  std::vector<ColumnCheck> checks;
+  ResolveChecks(op.columns, &checks);
+  return ValidateValues(op.table, checks, op.values, ctx->clock());
 }
 
 absl::Status ColumnValueValidator::Validate(const ActionContext* ctx,
@@ -17,9 +17,19 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_COLUMN_VALUE_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_COLUMN_VALUE_H_
 
+#include <vector>
+
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
 #include "backend/actions/action.h"
 #include "backend/actions/context.h"
 #include "backend/actions/ops.h"
+#include "backend/datamodel/key.h"
+#include "backend/schema/catalog/column.h"
+#include "backend/schema/catalog/table.h"
+#include "common/clock.h"
 #include "absl/status/status.h"
 
 namespace google {
@@ -29,16 +39,78 @@ namespace backend {
 
 // ColumnTypeValidator validates if a given mutation contains values which will
 // violate constraints for the corresponding column, including column types.
+//
+// The checks of each column of the table are resolved from the column's type
+// and options when the validator is built, so that validating a value only
+// branches on the precomputed check. A batch of operations which write the
+// same columns resolves its checks only once.
 class ColumnValueValidator : public Validator {
+ public:
+  explicit ColumnValueValidator(const Table* table);
+
+  absl::Status ValidateBatch(const ActionContext* ctx,
+                             absl::Span<const WriteOp> ops) const override;
+
  private:
+  // The check of the values of a column beyond their type and nullability.
+  enum class ValueCheck {
+    kNone,
+    kString,
+    kBytes,
+    kArray,
+    kCommitTimestamp,
+  };
+
+  // The checks of the values of a column.
+  struct ColumnCheck {
+    const Column* column;
+    zetasql::TypeKind type_kind;
+    bool nullable;
+    ValueCheck check;
+  };
+
+  // Returns the checks of `column`.
+  static ColumnCheck CompileColumnCheck(const Column* column);
+
+  // Sets `checks` to the checks of `columns`, which are taken from those built
+  // for the table if present.
+  void ResolveChecks(const std::vector<const Column*>& columns,
+                     std::vector<ColumnCheck>* checks) const;
+
+  // Validates `values`, written to the columns of `checks` of `table`.
+  static absl::Status ValidateValues(const Table* table,
+                                     absl::Span<const ColumnCheck> checks,
+                                     const std::vector<zetasql::Value>& values,
+                                     Clock* clock);
+
+  // Validates the size of `key` of `table` if it can exceed the limit.
+  absl::Status ValidateKey(const Table* table, const Key& key) const;
+
   absl::Status Validate(const ActionContext* ctx,
                         const InsertOp& op) const override;
   absl::Status Validate(const ActionContext* ctx,
                         const UpdateOp& op) const override;
   absl::Status Validate(const ActionContext* ctx,
                         const DeleteOp& op) const override;
+
+  // The checks of the columns of the table.
+  absl::flat_hash_map<const Column*, ColumnCheck> column_checks_;
+
+  // Whether keys of the table can exceed the maximum key size, which is only
+  // the case if a key column is of variable size.
+  bool check_key_size_ = false;
 };
 
+// Validates `values`, the values of `column` in many rows of `table`, as
+// ColumnValueValidator validates the values of inserts. Values are validated
+// column by column rather than row by row, for bulk imports.
+absl::Status ValidateColumnValues(const Table* table, const Column* column,
+                                  absl::Span<const zetasql::Value> values,
+                                  Clock* clock);
+
+// Validates that the size of `key` of a row of `table` is within limits.
+absl::Status ValidateKeySize(const Table* table, const Key& key);
+
 }  // namespace backend
 }  // namespace emulator
 }  // namespace spanner
@@ -18,6 +18,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "zetasql/public/functions/string.h"
 #include "zetasql/public/value.h"
@@ -108,7 +109,7 @@ class ColumnValueTest : public test::ActionsTest {
                     .value()),
         table_(schema_->FindTable("TestTable")),
         base_columns_(table_->columns()),
-        validator_(absl::make_unique<ColumnValueValidator>()) {}
+        validator_(absl::make_unique<ColumnValueValidator>(table_)) {}
 
   absl::Status ValidateInsert(const Values& values) {
     return validator_->Validate(
@@ -301,6 +302,30 @@ TEST_F(ColumnValueTest, ValidateKeyDoesNotContainNullValuesForDelete) {
               StatusIs(absl::StatusCode::kFailedPrecondition));
 }
 
+TEST_F(ColumnValueTest, ValidateBatchChecksEveryOperation) {
+  const Column* string_col = table_->FindColumn("string_col");
+  const Column* int64_col = table_->FindColumn("int64_col");
+  std::string exceed_max(limits::kMaxStringColumnLength + 1, '0');
+  std::vector<WriteOp> ops = {
+      Insert(table_, Key({Int64(1)}), {int64_col, string_col},
+             {Int64(1), String("a")}),
+      Insert(table_, Key({Int64(2)}), {int64_col, string_col},
+             {Int64(2), String("b")}),
+  };
+  ZETASQL_EXPECT_OK(validator_->ValidateBatch(ctx(), ops));
+
+  // Operations of a batch need not write the same columns.
+  ops.push_back(Insert(table_, Key({Int64(3)}), {string_col, int64_col},
+                       {String(exceed_max), Int64(3)}));
+  EXPECT_THAT(validator_->ValidateBatch(ctx(), ops),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+
+  ops.back() = Insert(table_, Key({Int64(3)}), {string_col, int64_col},
+                      {Int64(3), String("c")});
+  EXPECT_THAT(validator_->ValidateBatch(ctx(), ops),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
 TEST_F(ColumnValueTest, ValidateStringLength) {
   Values values;
   std::string max(limits::kMaxStringColumnLength, '0');
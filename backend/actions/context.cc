@@ -0,0 +1,99 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/actions/context.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/storage/iterator.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+zetasql_base::StatusOr<const absl::optional<ValueList>*>
+ActionContext::LookupRow(const Table* table, const Key& key) const {
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<const absl::optional<ValueList>*> rows,
+                   LookupRows(table, absl::MakeConstSpan(&key, 1)));
+  return rows.front();
+}
+
+zetasql_base::StatusOr<std::vector<const absl::optional<ValueList>*>>
+ActionContext::LookupRows(const Table* table,
+                          absl::Span<const Key> keys) const {
+  // Find the keys which are not cached yet.
+  std::vector<absl::optional<ValueList>*> rows(keys.size());
+  std::vector<int> uncached;
+  for (int i = 0; i < keys.size(); ++i) {
+    auto [itr, inserted] =
+        row_cache_.try_emplace(std::make_pair(table, keys[i]));
+    rows[i] = &itr->second;
+    if (inserted) {
+      uncached.push_back(i);
+    }
+  }
+
+  // Read the uncached rows with a single scan over the range they span.
+  if (!uncached.empty()) {
+    absl::Status status = [&]() -> absl::Status {
+      ZETASQL_ASSIGN_OR_RETURN(
+          std::unique_ptr<StorageIterator> itr,
+          store_->Read(table,
+                       KeyRange::ClosedOpen(
+                           keys[uncached.front()],
+                           keys[uncached.back()].ToPrefixLimit()),
+                       table->columns()));
+      int i = 0;
+      while (i < uncached.size() && itr->Next()) {
+        // Skip the keys which precede the current row, they do not exist.
+        while (i < uncached.size() && keys[uncached[i]] < itr->Key()) {
+          ++i;
+        }
+        if (i < uncached.size() && keys[uncached[i]] == itr->Key()) {
+          ValueList values;
+          values.reserve(itr->NumColumns());
+          for (int j = 0; j < itr->NumColumns(); ++j) {
+            values.push_back(itr->ColumnValue(j));
+          }
+          *rows[uncached[i++]] = std::move(values);
+        }
+      }
+      return itr->Status();
+    }();
+    if (!status.ok()) {
+      // Do not leave rows which were not read in the cache.
+      for (int i : uncached) {
+        row_cache_.erase(std::make_pair(table, keys[i]));
+      }
+      return status;
+    }
+  }
+  return std::vector<const absl::optional<ValueList>*>(rows.begin(),
+                                                       rows.end());
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
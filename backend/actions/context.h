@@ -17,9 +17,17 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_CONTEXT_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_CONTEXT_H_
 
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "backend/actions/ops.h"
 #include "backend/datamodel/key.h"
 #include "backend/datamodel/key_range.h"
+#include "backend/datamodel/value.h"
 #include "backend/schema/catalog/table.h"
 #include "backend/storage/iterator.h"
 #include "common/clock.h"
@@ -42,18 +50,20 @@ class EffectsBuffer {
  public:
   virtual ~EffectsBuffer() {}
 
-  // Adds an insert operation to the effects buffer.
-  virtual void Insert(const Table* table, const Key& key,
+  // Adds an insert operation to the effects buffer. The key and values are
+  // moved into the operation, so callers done with them should pass them with
+  // std::move.
+  virtual void Insert(const Table* table, Key key,
                       absl::Span<const Column* const> columns,
-                      const std::vector<zetasql::Value>& values) = 0;
+                      std::vector<zetasql::Value> values) = 0;
 
-  // Adds an update operation to the effects buffer.
-  virtual void Update(const Table* table, const Key& key,
+  // Adds an update operation to the effects buffer, like Insert.
+  virtual void Update(const Table* table, Key key,
                       absl::Span<const Column* const> columns,
-                      const std::vector<zetasql::Value>& values) = 0;
+                      std::vector<zetasql::Value> values) = 0;
 
   // Adds a delete operation to the effects buffer.
-  virtual void Delete(const Table* table, const Key& key) = 0;
+  virtual void Delete(const Table* table, Key key) = 0;
 };
 
 // ReadOnlyStore abstracts the storage environment in which an action lives.
@@ -89,6 +99,13 @@ class ReadOnlyStore {
 };
 
 // ActionContext contains the context in which an action operates.
+//
+// The context caches the rows which actions look up with LookupRow(s), so that
+// the validators and effectors of an operation which all need the current row
+// share a single read of it. The cached rows are only valid as long as the
+// store does not change: whoever changes the store must call ClearRowCache,
+// which the transaction does before processing each operation and before
+// running the statement verifiers.
 class ActionContext {
  public:
   ActionContext(std::unique_ptr<ReadOnlyStore> store,
@@ -100,10 +117,29 @@ class ActionContext {
   EffectsBuffer* effects() const { return effects_.get(); }
   Clock* clock() const { return clock_; }
 
+  // Returns the values of all the columns of the row of `table` with `key`, in
+  // the order of table->columns(), or nullopt if there is no such row. The
+  // returned row is owned by the cache and valid until ClearRowCache.
+  zetasql_base::StatusOr<const absl::optional<ValueList>*> LookupRow(
+      const Table* table, const Key& key) const;
+
+  // Like LookupRow, for each of `keys`, which must be sorted and distinct. The
+  // rows which are not cached yet are read from the store at once.
+  zetasql_base::StatusOr<std::vector<const absl::optional<ValueList>*>>
+  LookupRows(const Table* table, absl::Span<const Key> keys) const;
+
+  // Discards the cached rows.
+  void ClearRowCache() const { row_cache_.clear(); }
+
  private:
   std::unique_ptr<ReadOnlyStore> store_;
   std::unique_ptr<EffectsBuffer> effects_;
 
+  // Rows looked up since the cache was last cleared, or nullopt for those
+  // which do not exist.
+  mutable std::map<std::pair<const Table*, Key>, absl::optional<ValueList>>
+      row_cache_;
+
   // System-wide monotonic clock.
   Clock* clock_;
 };
@@ -0,0 +1,106 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/actions/context.h"
+
+#include <memory>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "tests/common/proto_matchers.h"
+#include "absl/types/optional.h"
+#include "tests/common/actions.h"
+#include "tests/common/schema_constructor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql::values::Int64;
+using zetasql::values::String;
+
+class ActionContextTest : public test::ActionsTest {
+ public:
+  ActionContextTest()
+      : schema_(emulator::test::CreateSchemaWithOneTable(&type_factory_)),
+        table_(schema_->FindTable("test_table")) {}
+
+ protected:
+  zetasql::TypeFactory type_factory_;
+  std::unique_ptr<const Schema> schema_;
+  const Table* table_;
+};
+
+TEST_F(ActionContextTest, LookupRowReturnsAllColumns) {
+  ZETASQL_EXPECT_OK(store()->Insert(table_, Key({Int64(1)}), table_->columns(),
+                            {Int64(1), String("value")}));
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(const absl::optional<ValueList>* row,
+                       ctx()->LookupRow(table_, Key({Int64(1)})));
+  ASSERT_TRUE(row->has_value());
+  EXPECT_THAT(**row, testing::ElementsAre(Int64(1), String("value")));
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(row, ctx()->LookupRow(table_, Key({Int64(2)})));
+  EXPECT_FALSE(row->has_value());
+}
+
+TEST_F(ActionContextTest, LookupRowIsCachedUntilCleared) {
+  test::TestReadOnlyStore* test_store = store();
+  ZETASQL_ASSERT_OK_AND_ASSIGN(const absl::optional<ValueList>* row,
+                       ctx()->LookupRow(table_, Key({Int64(1)})));
+  EXPECT_FALSE(row->has_value());
+
+  // The row inserted after the lookup is not seen until the cache is cleared.
+  ZETASQL_EXPECT_OK(test_store->Insert(table_, Key({Int64(1)}),
+                               table_->columns(),
+                               {Int64(1), String("value")}));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(row, ctx()->LookupRow(table_, Key({Int64(1)})));
+  EXPECT_FALSE(row->has_value());
+
+  ctx()->ClearRowCache();
+  ZETASQL_ASSERT_OK_AND_ASSIGN(row, ctx()->LookupRow(table_, Key({Int64(1)})));
+  EXPECT_TRUE(row->has_value());
+}
+
+TEST_F(ActionContextTest, LookupRowsMergesCachedAndStoredRows) {
+  for (int key : {1, 3}) {
+    ZETASQL_EXPECT_OK(store()->Insert(table_, Key({Int64(key)}),
+                              table_->columns(),
+                              {Int64(key), String("value")}));
+  }
+  ZETASQL_ASSERT_OK_AND_ASSIGN(const absl::optional<ValueList>* row,
+                       ctx()->LookupRow(table_, Key({Int64(3)})));
+  EXPECT_TRUE(row->has_value());
+
+  std::vector<Key> keys = {Key({Int64(1)}), Key({Int64(2)}), Key({Int64(3)})};
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::vector<const absl::optional<ValueList>*> rows,
+      ctx()->LookupRows(table_, keys));
+  ASSERT_EQ(rows.size(), 3);
+  EXPECT_TRUE(rows[0]->has_value());
+  EXPECT_FALSE(rows[1]->has_value());
+  EXPECT_EQ(rows[2], row);
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
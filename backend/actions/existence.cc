@@ -16,10 +16,18 @@
 
 #include "backend/actions/existence.h"
 
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "absl/types/variant.h"
 #include "backend/actions/action.h"
+#include "backend/actions/batch.h"
+#include "backend/actions/context.h"
 #include "backend/actions/ops.h"
 #include "common/errors.h"
 #include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
 #include "zetasql/base/statusor.h"
 
 namespace google {
@@ -27,10 +35,35 @@ namespace spanner {
 namespace emulator {
 namespace backend {
 
+absl::Status RowExistenceValidator::ValidateBatch(
+    const ActionContext* ctx, absl::Span<const WriteOp> ops) const {
+  if (ops.size() <= 1 || absl::holds_alternative<DeleteOp>(ops.front())) {
+    return Validator::ValidateBatch(ctx, ops);
+  }
+
+  const Table* table = TableOf(ops.front());
+  const bool is_insert = absl::holds_alternative<InsertOp>(ops.front());
+  std::vector<Key> keys = KeysOf(ops);
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<absl::optional<ValueList>> rows,
+                   LookupRowsInBatch(ctx, table, keys, /*columns=*/{}));
+  for (int i = 0; i < keys.size(); ++i) {
+    if (is_insert && rows[i].has_value()) {
+      return error::RowAlreadyExists(table->Name(), keys[i].DebugString());
+    }
+    if (!is_insert && !rows[i].has_value()) {
+      return error::RowNotFound(table->Name(), keys[i].DebugString());
+    }
+  }
+  return absl::OkStatus();
+}
+
 absl::Status RowExistenceValidator::Validate(const ActionContext* ctx,
                                              const InsertOp& op) const {
-  ZETASQL_ASSIGN_OR_RETURN(bool row_exists, ctx->store()->Exists(op.table, op.key));
-  if (row_exists) {
+  // The row is looked up through the context, which shares it with the other
+  // actions on the operation.
+  ZETASQL_ASSIGN_OR_RETURN(const absl::optional<ValueList>* row,
+                   ctx->LookupRow(op.table, op.key));
+  if (row->has_value()) {
     return error::RowAlreadyExists(op.table->Name(), op.key.DebugString());
   }
   return absl::OkStatus();
@@ -38,8 +71,9 @@ absl::Status RowExistenceValidator::Validate(const ActionContext* ctx,
 
 absl::Status RowExistenceValidator::Validate(const ActionContext* ctx,
                                              const UpdateOp& op) const {
-  ZETASQL_ASSIGN_OR_RETURN(bool row_exists, ctx->store()->Exists(op.table, op.key));
-  if (!row_exists) {
+  ZETASQL_ASSIGN_OR_RETURN(const absl::optional<ValueList>* row,
+                   ctx->LookupRow(op.table, op.key));
+  if (!row->has_value()) {
     return error::RowNotFound(op.table->Name(), op.key.DebugString());
   }
   return absl::OkStatus();
@@ -17,6 +17,7 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_EXISTENCE_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_EXISTENCE_H_
 
+#include "absl/types/span.h"
 #include "backend/actions/action.h"
 #include "backend/actions/context.h"
 #include "backend/actions/ops.h"
@@ -36,6 +37,8 @@ namespace backend {
 // - Update: Validates there is an existing row with the same key in this table.
 class RowExistenceValidator : public Validator {
  private:
+  absl::Status ValidateBatch(const ActionContext* ctx,
+                             absl::Span<const WriteOp> ops) const override;
   absl::Status Validate(const ActionContext* ctx,
                         const InsertOp& op) const override;
   absl::Status Validate(const ActionContext* ctx,
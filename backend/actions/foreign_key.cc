@@ -16,9 +16,15 @@
 
 #include "backend/actions/foreign_key.h"
 
+#include <utility>
+#include <vector>
+
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
+#include "absl/types/span.h"
+#include "absl/types/variant.h"
 #include "backend/actions/action.h"
+#include "backend/actions/batch.h"
 #include "backend/actions/context.h"
 #include "backend/actions/ops.h"
 #include "backend/datamodel/key_range.h"
@@ -32,19 +38,84 @@ namespace spanner {
 namespace emulator {
 namespace backend {
 
+namespace {
+
+// Returns the prefix of a referencing or referenced index data table key made
+// of the foreign key columns, excluding any extra columns from the primary key
+// that are not used by the foreign key.
+Key ForeignKeyPrefix(const ForeignKey* foreign_key, const Key& key) {
+  return Key(std::vector<zetasql::Value>(
+      key.column_values().begin(),
+      key.column_values().begin() + foreign_key->referencing_columns().size()));
+}
+
+// Returns true if the foreign key columns are ascending in the keys of both
+// the referencing and referenced index data tables. The prefixes probed by the
+// verifiers do not keep the sort order of their columns, so they can only be
+// merged with the keys of these tables in a single pass if they are.
+bool HasAscendingKeyColumns(const ForeignKey* foreign_key) {
+  const int num_columns = foreign_key->referencing_columns().size();
+  for (const Table* table : {foreign_key->referencing_data_table(),
+                             foreign_key->referenced_data_table()}) {
+    for (int i = 0; i < num_columns; ++i) {
+      if (table->primary_key()[i]->is_descending()) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Returns the distinct foreign key prefixes of the keys of `ops`, in key
+// order. Returns false if the batch cannot be verified at once, because the
+// foreign key columns are not all ascending or the batch holds a delete of a
+// key range shorter than the foreign key.
+bool ForeignKeyPrefixesOf(const ForeignKey* foreign_key,
+                          absl::Span<const WriteOp> ops,
+                          std::vector<Key>* prefixes) {
+  if (!HasAscendingKeyColumns(foreign_key)) {
+    return false;
+  }
+  for (const WriteOp& op : ops) {
+    const Key& key = KeyOf(op);
+    if (key.NumColumns() < foreign_key->referencing_columns().size()) {
+      return false;
+    }
+    Key prefix = ForeignKeyPrefix(foreign_key, key);
+    if (prefixes->empty() || !(prefixes->back() == prefix)) {
+      prefixes->push_back(std::move(prefix));
+    }
+  }
+  return true;
+}
+
+// Returns the prefixes which are not a prefix of any of `keys`. Both prefixes
+// and keys must be sorted.
+std::vector<Key> MissingPrefixes(absl::Span<const Key> prefixes,
+                                 absl::Span<const Key> keys) {
+  std::vector<Key> missing;
+  int i = 0;
+  for (const Key& prefix : prefixes) {
+    while (i < keys.size() && keys[i] < prefix) {
+      ++i;
+    }
+    if (i == keys.size() || !prefix.IsPrefixOf(keys[i])) {
+      missing.push_back(prefix);
+    }
+  }
+  return missing;
+}
+
+}  // namespace
+
 ForeignKeyReferencingVerifier::ForeignKeyReferencingVerifier(
     const ForeignKey* foreign_key)
     : foreign_key_(foreign_key) {}
 
 absl::Status ForeignKeyReferencingVerifier::Verify(const ActionContext* ctx,
                                                    const InsertOp& op) const {
-  // Check that the corresponding row exists in the referenced index. Exclude
-  // any extra columns from the primary key that are not used by the foreign
-  // key.
-  Key key(std::vector<zetasql::Value>(
-      op.key.column_values().begin(),
-      op.key.column_values().begin() +
-          foreign_key_->referencing_columns().size()));
+  // Check that the corresponding row exists in the referenced index.
+  Key key = ForeignKeyPrefix(foreign_key_, op.key);
   ZETASQL_ASSIGN_OR_RETURN(
       bool exists,
       ctx->store()->PrefixExists(foreign_key_->referenced_data_table(), key));
@@ -56,6 +127,31 @@ absl::Status ForeignKeyReferencingVerifier::Verify(const ActionContext* ctx,
   return absl::OkStatus();
 }
 
+absl::Status ForeignKeyReferencingVerifier::VerifyBatch(
+    const ActionContext* ctx, absl::Span<const WriteOp> ops) const {
+  std::vector<Key> prefixes;
+  if (ops.size() <= 1 || !absl::holds_alternative<InsertOp>(ops.front()) ||
+      !ForeignKeyPrefixesOf(foreign_key_, ops, &prefixes)) {
+    return Verifier::VerifyBatch(ctx, ops);
+  }
+
+  // Merge the distinct referenced keys of the batch with a single read of the
+  // referenced index. The first missing key is the one a verification of each
+  // row in turn would report.
+  ZETASQL_ASSIGN_OR_RETURN(
+      std::vector<Key> referenced_keys,
+      ReadKeysWithPrefixesInBatch(ctx, foreign_key_->referenced_data_table(),
+                                  prefixes));
+  std::vector<Key> missing = MissingPrefixes(prefixes, referenced_keys);
+  if (!missing.empty()) {
+    return error::ForeignKeyReferencedKeyNotFound(
+        foreign_key_->Name(), foreign_key_->referencing_table()->Name(),
+        foreign_key_->referenced_table()->Name(),
+        missing.front().DebugString());
+  }
+  return absl::OkStatus();
+}
+
 ForeignKeyReferencedVerifier::ForeignKeyReferencedVerifier(
     const ForeignKey* foreign_key)
     : foreign_key_(foreign_key) {}
@@ -63,12 +159,7 @@ ForeignKeyReferencedVerifier::ForeignKeyReferencedVerifier(
 absl::Status ForeignKeyReferencedVerifier::Verify(const ActionContext* ctx,
                                                   const DeleteOp& op) const {
   // Check that the corresponding row does not exist in the referencing index.
-  // Exclude any extra columns from the primary key that are not used by the
-  // foreign key.
-  Key key(std::vector<zetasql::Value>(
-      op.key.column_values().begin(),
-      op.key.column_values().begin() +
-          foreign_key_->referencing_columns().size()));
+  Key key = ForeignKeyPrefix(foreign_key_, op.key);
 
   // It is possible that a deleted key is inserted back in the same transaction
   // later. So check whether the key is really deleted before validating the
@@ -89,6 +180,34 @@ absl::Status ForeignKeyReferencedVerifier::Verify(const ActionContext* ctx,
   return absl::OkStatus();
 }
 
+absl::Status ForeignKeyReferencedVerifier::VerifyBatch(
+    const ActionContext* ctx, absl::Span<const WriteOp> ops) const {
+  std::vector<Key> prefixes;
+  if (ops.size() <= 1 || !absl::holds_alternative<DeleteOp>(ops.front()) ||
+      !ForeignKeyPrefixesOf(foreign_key_, ops, &prefixes)) {
+    return Verifier::VerifyBatch(ctx, ops);
+  }
+
+  // Keys deleted and inserted back are still referenced, so only the keys
+  // missing from the referenced index are looked up in the referencing index.
+  ZETASQL_ASSIGN_OR_RETURN(
+      std::vector<Key> referenced_keys,
+      ReadKeysWithPrefixesInBatch(ctx, foreign_key_->referenced_data_table(),
+                                  prefixes));
+  std::vector<Key> deleted = MissingPrefixes(prefixes, referenced_keys);
+  ZETASQL_ASSIGN_OR_RETURN(
+      std::vector<Key> referencing_keys,
+      ReadKeysWithPrefixesInBatch(ctx, foreign_key_->referencing_data_table(),
+                                  deleted));
+  if (!referencing_keys.empty()) {
+    return error::ForeignKeyReferencingKeyFound(
+        foreign_key_->Name(), foreign_key_->referencing_table()->Name(),
+        foreign_key_->referenced_table()->Name(),
+        ForeignKeyPrefix(foreign_key_, referencing_keys.front()).DebugString());
+  }
+  return absl::OkStatus();
+}
+
 }  // namespace backend
 }  // namespace emulator
 }  // namespace spanner
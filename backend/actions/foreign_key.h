@@ -17,6 +17,7 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_FOREIGN_KEY_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_FOREIGN_KEY_H_
 
+#include "absl/types/span.h"
 #include "backend/actions/action.h"
 #include "backend/actions/context.h"
 #include "backend/actions/ops.h"
@@ -48,6 +49,8 @@ class ForeignKeyReferencingVerifier : public Verifier {
  private:
   absl::Status Verify(const ActionContext* ctx,
                       const InsertOp& op) const override;
+  absl::Status VerifyBatch(const ActionContext* ctx,
+                           absl::Span<const WriteOp> ops) const override;
 
   const ForeignKey* foreign_key_;
 };
@@ -74,6 +77,8 @@ class ForeignKeyReferencedVerifier : public Verifier {
  private:
   absl::Status Verify(const ActionContext* ctx,
                       const DeleteOp& op) const override;
+  absl::Status VerifyBatch(const ActionContext* ctx,
+                           absl::Span<const WriteOp> ops) const override;
 
   const ForeignKey* foreign_key_;
 };
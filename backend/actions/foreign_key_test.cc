@@ -18,6 +18,7 @@
 
 #include <memory>
 #include <queue>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -142,6 +143,53 @@ TEST_F(ForeignKeyTest, DeleteReferencedRowWithoutReferencingRow) {
       ctx(), Delete(referenced_data_, Key({Int64(4), Int64(5), Int64(6)}))));
 }
 
+TEST_F(ForeignKeyTest, InsertBatchOfReferencingRows) {
+  ZETASQL_ASSERT_OK(
+      store()->Insert(referenced_data_, Key({Int64(1), Int64(2), Int64(3)}),
+                      referenced_columns_, {Int64(1), Int64(2), Int64(3)}));
+  ZETASQL_ASSERT_OK(
+      store()->Insert(referenced_data_, Key({Int64(4), Int64(5), Int64(6)}),
+                      referenced_columns_, {Int64(4), Int64(5), Int64(6)}));
+
+  // Rows sharing a referenced key, and rows referencing distinct keys, are
+  // verified with a single read of the referenced keys.
+  std::vector<WriteOp> ops = {
+      Insert(referencing_data_, Key({Int64(1), Int64(2), Int64(7)}),
+             referencing_columns_, {Int64(1), Int64(2), Int64(7)}),
+      Insert(referencing_data_, Key({Int64(1), Int64(2), Int64(8)}),
+             referencing_columns_, {Int64(1), Int64(2), Int64(8)}),
+      Insert(referencing_data_, Key({Int64(4), Int64(5), Int64(9)}),
+             referencing_columns_, {Int64(4), Int64(5), Int64(9)})};
+  ZETASQL_EXPECT_OK(referencing_verifier_->VerifyBatch(ctx(), ops));
+
+  // A single row without a referenced row fails the whole batch.
+  ops.push_back(Insert(referencing_data_, Key({Int64(7), Int64(8), Int64(9)}),
+                       referencing_columns_, {Int64(7), Int64(8), Int64(9)}));
+  EXPECT_THAT(referencing_verifier_->VerifyBatch(ctx(), ops),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST_F(ForeignKeyTest, DeleteBatchOfReferencedRows) {
+  ZETASQL_ASSERT_OK(
+      store()->Insert(referenced_data_, Key({Int64(1), Int64(2), Int64(3)}),
+                      referenced_columns_, {Int64(1), Int64(2), Int64(3)}));
+  ZETASQL_ASSERT_OK(
+      store()->Insert(referencing_data_, Key({Int64(4), Int64(5), Int64(6)}),
+                      referencing_columns_, {Int64(4), Int64(5), Int64(6)}));
+
+  // Deleting referenced rows which no row references succeeds, as does
+  // deleting a referenced key which another referenced row still holds.
+  std::vector<WriteOp> ops = {
+      Delete(referenced_data_, Key({Int64(1), Int64(2), Int64(4)})),
+      Delete(referenced_data_, Key({Int64(2), Int64(3), Int64(4)}))};
+  ZETASQL_EXPECT_OK(referenced_verifier_->VerifyBatch(ctx(), ops));
+
+  // Deleting the last referenced row of a referencing row fails the batch.
+  ops.push_back(Delete(referenced_data_, Key({Int64(4), Int64(5), Int64(6)})));
+  EXPECT_THAT(referenced_verifier_->VerifyBatch(ctx(), ops),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
 }  // namespace
 }  // namespace backend
 }  // namespace emulator
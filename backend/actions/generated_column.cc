@@ -0,0 +1,226 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/actions/generated_column.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/analyzer.h"
+#include "zetasql/public/evaluator.h"
+#include "zetasql/public/value.h"
+#include "zetasql/base/statusor.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "absl/types/variant.h"
+#include "backend/actions/batch.h"
+#include "backend/actions/context.h"
+#include "backend/query/analyzer_options.h"
+#include "backend/query/catalog.h"
+#include "backend/query/function_catalog.h"
+#include "backend/schema/catalog/column.h"
+#include "common/errors.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+GeneratedColumnEffector::GeneratedColumnEffector(const Schema* schema,
+                                                 const Table* table)
+    : table_(table), is_dependent_column_(table->columns().size(), false) {
+  for (int i = 0; i < table->columns().size(); ++i) {
+    column_positions_[table->columns()[i]] = i;
+  }
+  prepare_status_ = Prepare(schema);
+  if (!prepare_status_.ok()) {
+    prepare_status_ = error::Internal(absl::StrCat(
+        "Failed to prepare the generated columns of table ", table->Name(),
+        ": ", prepare_status_.message()));
+  }
+}
+
+absl::Status GeneratedColumnEffector::Prepare(const Schema* schema) {
+  // Order the generated columns so that each one follows the generated
+  // columns it depends on. Schema validation rejects cycles.
+  std::vector<const Column*> ordered;
+  absl::flat_hash_set<const Column*> visited;
+  std::function<void(const Column*)> visit = [&](const Column* column) {
+    if (!column->is_generated() || !visited.insert(column).second) {
+      return;
+    }
+    for (const Column* dependency : column->dependent_columns()) {
+      visit(dependency);
+    }
+    ordered.push_back(column);
+  };
+  for (const Column* column : table_->columns()) {
+    visit(column);
+  }
+
+  // The expressions can only reference the columns of the table.
+  zetasql::AnalyzerOptions options = MakeGoogleSqlAnalyzerOptions();
+  for (const Column* column : table_->columns()) {
+    ZETASQL_RETURN_IF_ERROR(
+        options.AddExpressionColumn(column->Name(), column->GetType()));
+  }
+  Catalog catalog(schema, FunctionCatalog::Shared());
+  for (const Column* column : ordered) {
+    GeneratedColumn generated;
+    generated.column = column;
+    ZETASQL_RETURN_IF_ERROR(zetasql::AnalyzeExpressionForAssignmentToType(
+        *column->expression(), options, &catalog, &type_factory_,
+        column->GetType(), &generated.analyzer_output));
+    generated.expression = absl::make_unique<zetasql::PreparedExpression>(
+        generated.analyzer_output->resolved_expr(),
+        zetasql::EvaluatorOptions());
+    ZETASQL_RETURN_IF_ERROR(generated.expression->Prepare(options));
+    ZETASQL_ASSIGN_OR_RETURN(std::vector<std::string> referenced_columns,
+                     generated.expression->GetReferencedColumns());
+    for (const std::string& name : referenced_columns) {
+      const Column* referenced = table_->FindColumn(name);
+      ZETASQL_RET_CHECK_NE(referenced, nullptr);
+      const int position = column_positions_.at(referenced);
+      generated.referenced_columns.push_back(position);
+      is_dependent_column_[position] = true;
+    }
+    columns_.push_back(column);
+    generated_columns_.push_back(std::move(generated));
+  }
+  return absl::OkStatus();
+}
+
+bool GeneratedColumnEffector::UpdatesDependentColumns(
+    const UpdateOp& op) const {
+  for (const Column* column : op.columns) {
+    auto itr = column_positions_.find(column);
+    if (itr != column_positions_.end() && !column->is_generated() &&
+        is_dependent_column_[itr->second]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+absl::Status GeneratedColumnEffector::EffectRow(const ActionContext* ctx,
+                                                const Key& key,
+                                                ValueList row) const {
+  ValueList values;
+  values.reserve(generated_columns_.size());
+  zetasql::ParameterValueList columns;
+  for (const GeneratedColumn& generated : generated_columns_) {
+    columns.clear();
+    for (int position : generated.referenced_columns) {
+      columns.push_back(row[position]);
+    }
+    zetasql_base::StatusOr<zetasql::Value> value;
+    {
+      absl::MutexLock lock(&mu_);
+      value = generated.expression->ExecuteAfterPrepareWithOrderedParams(
+          columns, /*parameters=*/{});
+    }
+    ZETASQL_RETURN_IF_ERROR(value.status());
+    row[column_positions_.at(generated.column)] = *value;
+    values.push_back(std::move(value).value());
+  }
+  ctx->effects()->Update(table_, key, columns_, std::move(values));
+  return absl::OkStatus();
+}
+
+absl::Status GeneratedColumnEffector::Effect(const ActionContext* ctx,
+                                             const InsertOp& op) const {
+  ZETASQL_RETURN_IF_ERROR(prepare_status_);
+  ValueList row;
+  row.reserve(table_->columns().size());
+  for (const Column* column : table_->columns()) {
+    row.push_back(zetasql::Value::Null(column->GetType()));
+  }
+  for (int i = 0; i < op.columns.size(); ++i) {
+    row[column_positions_.at(op.columns[i])] = op.values[i];
+  }
+  return EffectRow(ctx, op.key, std::move(row));
+}
+
+absl::Status GeneratedColumnEffector::Effect(const ActionContext* ctx,
+                                             const UpdateOp& op) const {
+  ZETASQL_RETURN_IF_ERROR(prepare_status_);
+  if (!UpdatesDependentColumns(op)) {
+    return absl::OkStatus();
+  }
+
+  // The update fails row existence validation if there is no row to update.
+  ZETASQL_ASSIGN_OR_RETURN(const absl::optional<ValueList>* current,
+                   ctx->LookupRow(table_, op.key));
+  if (!current->has_value()) {
+    return absl::OkStatus();
+  }
+  ValueList row = **current;
+  for (int i = 0; i < op.columns.size(); ++i) {
+    row[column_positions_.at(op.columns[i])] = op.values[i];
+  }
+  return EffectRow(ctx, op.key, std::move(row));
+}
+
+absl::Status GeneratedColumnEffector::EffectBatch(
+    const ActionContext* ctx, absl::Span<const WriteOp> ops) const {
+  if (ops.size() <= 1 || !absl::holds_alternative<UpdateOp>(ops.front())) {
+    return Effector::EffectBatch(ctx, ops);
+  }
+  ZETASQL_RETURN_IF_ERROR(prepare_status_);
+
+  // Read the current rows of the updates which need their generated columns
+  // computed at once.
+  std::vector<const UpdateOp*> effected_ops;
+  std::vector<Key> keys;
+  for (const WriteOp& op : ops) {
+    const UpdateOp& update = absl::get<UpdateOp>(op);
+    if (UpdatesDependentColumns(update)) {
+      effected_ops.push_back(&update);
+      keys.push_back(update.key);
+    }
+  }
+  if (effected_ops.empty()) {
+    return absl::OkStatus();
+  }
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<absl::optional<ValueList>> rows,
+                   LookupRowsInBatch(ctx, table_, keys, table_->columns()));
+  for (int i = 0; i < effected_ops.size(); ++i) {
+    if (!rows[i].has_value()) {
+      continue;
+    }
+    const UpdateOp& op = *effected_ops[i];
+    ValueList row = std::move(rows[i]).value();
+    for (int j = 0; j < op.columns.size(); ++j) {
+      row[column_positions_.at(op.columns[j])] = op.values[j];
+    }
+    ZETASQL_RETURN_IF_ERROR(EffectRow(ctx, op.key, std::move(row)));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,126 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_GENERATED_COLUMN_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_GENERATED_COLUMN_H_
+
+#include <memory>
+#include <vector>
+
+#include "zetasql/public/analyzer.h"
+#include "zetasql/public/evaluator.h"
+#include "zetasql/public/type.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "backend/actions/action.h"
+#include "backend/actions/ops.h"
+#include "backend/datamodel/value.h"
+#include "backend/schema/catalog/schema.h"
+#include "backend/schema/catalog/table.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// GeneratedColumnEffector computes the stored generated columns of a table.
+//
+// The expressions of the generated columns are analyzed and prepared once,
+// when the effector is created for a schema, and are then only evaluated for
+// each row written. Generated columns which depend on other generated columns
+// are evaluated after them.
+//
+// - Insert: The generated columns are computed from the inserted row, with
+//           the columns not written being NULL, and buffered as an update of
+//           the row.
+// - Update: Updates which write a column the generated columns depend on
+//           compute them from the current row patched with the update, and
+//           buffer them as another update of the row. The rows of a batch of
+//           updates are read at once. Updates which write no such column
+//           (including the ones buffered by this effector) are ignored.
+// - Delete: Not affected.
+class GeneratedColumnEffector : public Effector {
+ public:
+  // `schema` is only used to prepare the expressions and need not outlive the
+  // effector.
+  GeneratedColumnEffector(const Schema* schema, const Table* table);
+
+ private:
+  // A prepared generated column expression.
+  struct GeneratedColumn {
+    const Column* column;
+
+    // Keeps the resolved expression which `expression` evaluates.
+    std::unique_ptr<const zetasql::AnalyzerOutput> analyzer_output;
+    std::unique_ptr<zetasql::PreparedExpression> expression;
+
+    // The position in table->columns() of each column referenced by the
+    // expression, in the order the expression takes their values.
+    std::vector<int> referenced_columns;
+  };
+
+  absl::Status Effect(const ActionContext* ctx,
+                      const InsertOp& op) const override;
+  absl::Status Effect(const ActionContext* ctx,
+                      const UpdateOp& op) const override;
+  absl::Status EffectBatch(const ActionContext* ctx,
+                           absl::Span<const WriteOp> ops) const override;
+
+  // Prepares the expressions of the generated columns.
+  absl::Status Prepare(const Schema* schema);
+
+  // Returns true if `op` writes any column the generated columns depend on.
+  bool UpdatesDependentColumns(const UpdateOp& op) const;
+
+  // Computes the generated columns of `row`, which holds the values of all
+  // the columns of table_ in order, and buffers them as an update of the row
+  // with `key`.
+  absl::Status EffectRow(const ActionContext* ctx, const Key& key,
+                         ValueList row) const ABSL_LOCKS_EXCLUDED(mu_);
+
+  const Table* table_;
+
+  // Owns the types created while analyzing the expressions.
+  zetasql::TypeFactory type_factory_;
+
+  // The generated columns, ordered so that each one follows the generated
+  // columns it depends on.
+  std::vector<GeneratedColumn> generated_columns_;
+  std::vector<const Column*> columns_;
+
+  // The position of each column in table_->columns().
+  absl::flat_hash_map<const Column*, int> column_positions_;
+
+  // Whether each column of table_ is depended upon by a generated column.
+  std::vector<bool> is_dependent_column_;
+
+  // The error preparing the expressions, returned by every effect if any.
+  absl::Status prepare_status_;
+
+  // Serializes the evaluation of the expressions, as the effector is shared
+  // by all the transactions on the schema.
+  mutable absl::Mutex mu_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_GENERATED_COLUMN_H_
@@ -0,0 +1,180 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/actions/generated_column.h"
+
+#include <memory>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "absl/memory/memory.h"
+#include "absl/types/variant.h"
+#include "backend/actions/context.h"
+#include "backend/actions/ops.h"
+#include "tests/common/actions.h"
+#include "tests/common/scoped_feature_flags_setter.h"
+#include "tests/common/schema_constructor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using emulator::test::ScopedEmulatorFeatureFlagsSetter;
+using zetasql::values::Int64;
+using zetasql::values::NullInt64;
+using zetasql::values::NullString;
+using zetasql::values::String;
+
+class GeneratedColumnTest : public test::ActionsTest {
+ public:
+  GeneratedColumnTest()
+      : scoped_flags_setter_({.enable_stored_generated_columns = true}),
+        schema_(emulator::test::CreateSchemaFromDDL(
+                    {
+                        R"(
+                            CREATE TABLE TestTable (
+                              id INT64 NOT NULL,
+                              a STRING(MAX) AS (CONCAT(b, b)) STORED,
+                              b STRING(MAX) AS (c) STORED,
+                              c STRING(MAX),
+                              n INT64,
+                              n_plus_one INT64 AS (n + 1) STORED,
+                            ) PRIMARY KEY (id)
+                          )",
+                    },
+                    &type_factory_)
+                    .value()),
+        table_(schema_->FindTable("TestTable")),
+        id_(table_->FindColumn("id")),
+        a_(table_->FindColumn("a")),
+        b_(table_->FindColumn("b")),
+        c_(table_->FindColumn("c")),
+        n_(table_->FindColumn("n")),
+        n_plus_one_(table_->FindColumn("n_plus_one")),
+        effector_(absl::make_unique<GeneratedColumnEffector>(schema_.get(),
+                                                             table_)) {}
+
+ protected:
+  // Returns the operation buffered by the effector, if it buffered exactly
+  // one.
+  WriteOp SingleEffect() {
+    EXPECT_EQ(effects_buffer()->ops_queue()->size(), 1);
+    WriteOp op = effects_buffer()->ops_queue()->front();
+    effects_buffer()->ops_queue()->pop();
+    return op;
+  }
+
+  // Test components.
+  ScopedEmulatorFeatureFlagsSetter scoped_flags_setter_;
+  zetasql::TypeFactory type_factory_;
+  std::unique_ptr<const Schema> schema_;
+
+  // Test variables.
+  const Table* table_;
+  const Column* id_;
+  const Column* a_;
+  const Column* b_;
+  const Column* c_;
+  const Column* n_;
+  const Column* n_plus_one_;
+  std::unique_ptr<Effector> effector_;
+};
+
+TEST_F(GeneratedColumnTest, InsertComputesGeneratedColumnsInDependencyOrder) {
+  ZETASQL_EXPECT_OK(effector_->Effect(ctx(), Insert(table_, Key({Int64(1)}), {id_, c_},
+                                          {Int64(1), String("x")})));
+
+  WriteOp op = SingleEffect();
+  ASSERT_TRUE(absl::holds_alternative<UpdateOp>(op));
+  const UpdateOp& update = absl::get<UpdateOp>(op);
+  EXPECT_EQ(update.table, table_);
+  EXPECT_EQ(update.key, Key({Int64(1)}));
+  EXPECT_THAT(update.columns,
+              testing::UnorderedElementsAre(a_, b_, n_plus_one_));
+  for (int i = 0; i < update.columns.size(); ++i) {
+    if (update.columns[i] == a_) {
+      EXPECT_EQ(update.values[i], String("xx"));
+    } else if (update.columns[i] == b_) {
+      EXPECT_EQ(update.values[i], String("x"));
+    } else {
+      EXPECT_EQ(update.values[i], NullInt64());
+    }
+  }
+}
+
+TEST_F(GeneratedColumnTest, UpdateRecomputesGeneratedColumnsFromCurrentRow) {
+  ZETASQL_EXPECT_OK(store()->Insert(
+      table_, Key({Int64(1)}), table_->columns(),
+      {Int64(1), String("xx"), String("x"), String("x"), Int64(1), Int64(2)}));
+
+  ZETASQL_EXPECT_OK(effector_->Effect(
+      ctx(), Update(table_, Key({Int64(1)}), {n_}, {Int64(41)})));
+
+  WriteOp op = SingleEffect();
+  ASSERT_TRUE(absl::holds_alternative<UpdateOp>(op));
+  const UpdateOp& update = absl::get<UpdateOp>(op);
+  for (int i = 0; i < update.columns.size(); ++i) {
+    if (update.columns[i] == a_) {
+      EXPECT_EQ(update.values[i], String("xx"));
+    } else if (update.columns[i] == b_) {
+      EXPECT_EQ(update.values[i], String("x"));
+    } else {
+      EXPECT_EQ(update.values[i], Int64(42));
+    }
+  }
+}
+
+TEST_F(GeneratedColumnTest, UpdateOfGeneratedColumnsOnlyIsIgnored) {
+  ZETASQL_EXPECT_OK(store()->Insert(
+      table_, Key({Int64(1)}), table_->columns(),
+      {Int64(1), String("xx"), String("x"), String("x"), Int64(1), Int64(2)}));
+
+  ZETASQL_EXPECT_OK(effector_->Effect(
+      ctx(), Update(table_, Key({Int64(1)}), {a_, b_},
+                    {String("yy"), String("y")})));
+  EXPECT_TRUE(effects_buffer()->ops_queue()->empty());
+}
+
+TEST_F(GeneratedColumnTest, BatchOfUpdatesComputesEachRow) {
+  for (int i = 1; i <= 3; ++i) {
+    ZETASQL_EXPECT_OK(store()->Insert(
+        table_, Key({Int64(i)}), table_->columns(),
+        {Int64(i), NullString(), NullString(), NullString(), Int64(i),
+         Int64(i + 1)}));
+  }
+
+  std::vector<WriteOp> ops;
+  for (int i = 1; i <= 3; ++i) {
+    ops.push_back(Update(table_, Key({Int64(i)}), {c_}, {String("z")}));
+  }
+  ZETASQL_EXPECT_OK(effector_->EffectBatch(ctx(), ops));
+  EXPECT_EQ(effects_buffer()->ops_queue()->size(), 3);
+}
+
+TEST_F(GeneratedColumnTest, DeleteHasNoEffect) {
+  ZETASQL_EXPECT_OK(effector_->Effect(ctx(), Delete(table_, Key({Int64(1)}))));
+  EXPECT_TRUE(effects_buffer()->ops_queue()->empty());
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
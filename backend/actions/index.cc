@@ -16,13 +16,24 @@
 
 #include "backend/actions/index.h"
 
+#include <algorithm>
 #include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include "zetasql/base/statusor.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "absl/types/variant.h"
+#include "backend/actions/batch.h"
+#include "backend/actions/context.h"
 #include "backend/common/indexing.h"
+#include "backend/datamodel/key_range.h"
 #include "backend/schema/catalog/column.h"
 #include "backend/schema/catalog/index.h"
 #include "backend/schema/catalog/table.h"
+#include "backend/storage/iterator.h"
 #include "common/errors.h"
 #include "absl/status/status.h"
 #include "zetasql/base/status_macros.h"
@@ -34,22 +45,17 @@ namespace backend {
 
 namespace {
 
-// Returns the row from the indexed table for the given key.
-zetasql_base::StatusOr<Row> ReadBaseTableRow(
-    const ActionContext* ctx, const Table* table, const Key& key,
-    const std::vector<const Column*>& base_columns) {
-  ZETASQL_ASSIGN_OR_RETURN(
-      std::unique_ptr<StorageIterator> itr,
-      ctx->store()->Read(table, KeyRange::Point(key), base_columns));
-
-  Row base_row;
-  if (itr->Next()) {
-    for (int i = 0; i < itr->NumColumns(); ++i) {
-      base_row[base_columns[i]] = itr->ColumnValue(i);
-    }
+// Returns the row from the indexed table for the given key. The row is looked
+// up through the context, so that the effectors of all the indexes on the table
+// share a single read of it.
+zetasql_base::StatusOr<Row> ReadBaseTableRow(const ActionContext* ctx,
+                                     const Table* table, const Key& key) {
+  ZETASQL_ASSIGN_OR_RETURN(const absl::optional<ValueList>* values,
+                   ctx->LookupRow(table, key));
+  if (!values->has_value()) {
+    return Row();
   }
-  ZETASQL_RETURN_IF_ERROR(itr->Status());
-  return base_row;
+  return MakeRow(table->columns(), **values);
 }
 
 }  // namespace
@@ -58,9 +64,26 @@ IndexEffector::IndexEffector(const Index* index) : index_(index) {
   // Save the base table columns corresponding to the index data table.
   for (const Column* column : index->index_data_table()->columns()) {
     base_columns_.emplace_back(column->source_column());
+    index_columns_[column->source_column()] = column;
+  }
+  for (const KeyColumn* key_column : index->index_data_table()->primary_key()) {
+    key_base_columns_.insert(key_column->column()->source_column());
   }
 }
 
+bool IndexEffector::UpdatesIndexColumns(const UpdateOp& op) const {
+  return std::any_of(
+      op.columns.begin(), op.columns.end(),
+      [this](const Column* column) { return index_columns_.contains(column); });
+}
+
+bool IndexEffector::UpdatesIndexKeyColumns(const UpdateOp& op) const {
+  return std::any_of(op.columns.begin(), op.columns.end(),
+                     [this](const Column* column) {
+                       return key_base_columns_.contains(column);
+                     });
+}
+
 absl::Status IndexEffector::Effect(const ActionContext* ctx,
                                    const InsertOp& op) const {
   // Compute the index key and column values.
@@ -72,16 +95,28 @@ absl::Status IndexEffector::Effect(const ActionContext* ctx,
   }
 
   // Insert the new row in the index.
-  ctx->effects()->Insert(index_->index_data_table(), index_key,
-                         index_->index_data_table()->columns(), index_values);
+  ctx->effects()->Insert(index_->index_data_table(), std::move(index_key),
+                         index_->index_data_table()->columns(),
+                         std::move(index_values));
   return absl::OkStatus();
 }
 
 absl::Status IndexEffector::Effect(const ActionContext* ctx,
                                    const UpdateOp& op) const {
+  // The index entry does not change if no column of the index is written.
+  if (!UpdatesIndexColumns(op)) {
+    return absl::OkStatus();
+  }
+
   // Read the current base row values from the indexed table.
   ZETASQL_ASSIGN_OR_RETURN(Row base_row,
-                   ReadBaseTableRow(ctx, op.table, op.key, base_columns_));
+                   ReadBaseTableRow(ctx, op.table, op.key));
+  return EffectUpdate(ctx, op, std::move(base_row));
+}
+
+absl::Status IndexEffector::EffectUpdate(const ActionContext* ctx,
+                                         const UpdateOp& op,
+                                         Row base_row) const {
   if (base_row.empty()) {
     return error::Internal(
         absl::StrCat("Missing row from base table when an Update index effect "
@@ -89,10 +124,33 @@ absl::Status IndexEffector::Effect(const ActionContext* ctx,
                      op.table->Name(), " Key: ", op.key.DebugString()));
   }
 
+  // If the index key is unchanged, so is whether the entry is filtered, and
+  // only the stored columns written by the update need to be updated in the
+  // existing entry.
+  if (!UpdatesIndexKeyColumns(op)) {
+    ZETASQL_ASSIGN_OR_RETURN(Key index_key, ComputeIndexKey(base_row, index_));
+    if (ShouldFilterIndexKey(index_, index_key)) {
+      return absl::OkStatus();
+    }
+    std::vector<const Column*> index_columns;
+    ValueList index_values;
+    for (int i = 0; i < op.columns.size(); ++i) {
+      auto column_itr = index_columns_.find(op.columns[i]);
+      if (column_itr != index_columns_.end()) {
+        index_columns.push_back(column_itr->second);
+        index_values.push_back(op.values[i]);
+      }
+    }
+    ctx->effects()->Update(index_->index_data_table(), std::move(index_key),
+                           index_columns, std::move(index_values));
+    return absl::OkStatus();
+  }
+
   // If a previous index entry existed, delete it.
   ZETASQL_ASSIGN_OR_RETURN(Key old_index_key, ComputeIndexKey(base_row, index_));
   if (!ShouldFilterIndexKey(index_, old_index_key)) {
-    ctx->effects()->Delete(index_->index_data_table(), old_index_key);
+    ctx->effects()->Delete(index_->index_data_table(),
+                           std::move(old_index_key));
   }
 
   // Patch new values into value map.
@@ -106,17 +164,37 @@ absl::Status IndexEffector::Effect(const ActionContext* ctx,
   }
 
   // Insert the new row in the index.
-  ctx->effects()->Insert(index_->index_data_table(), new_index_key,
-                         index_->index_data_table()->columns(), index_values);
+  ctx->effects()->Insert(index_->index_data_table(), std::move(new_index_key),
+                         index_->index_data_table()->columns(),
+                         std::move(index_values));
   return absl::OkStatus();
 }
 
 absl::Status IndexEffector::Effect(const ActionContext* ctx,
                                    const DeleteOp& op) const {
+  if (IsPrefixDelete(op)) {
+    // Delete the index entries of all the base rows with the prefix.
+    ZETASQL_ASSIGN_OR_RETURN(
+        std::unique_ptr<StorageIterator> itr,
+        ctx->store()->Read(op.table, KeyRange::Prefix(op.key), base_columns_));
+    while (itr->Next()) {
+      Row base_row;
+      for (int i = 0; i < itr->NumColumns(); ++i) {
+        base_row[base_columns_[i]] = itr->ColumnValue(i);
+      }
+      ZETASQL_RETURN_IF_ERROR(EffectDelete(ctx, base_row));
+    }
+    return itr->Status();
+  }
+
   // Read base row values.
   ZETASQL_ASSIGN_OR_RETURN(Row base_row,
-                   ReadBaseTableRow(ctx, op.table, op.key, base_columns_));
+                   ReadBaseTableRow(ctx, op.table, op.key));
+  return EffectDelete(ctx, base_row);
+}
 
+absl::Status IndexEffector::EffectDelete(const ActionContext* ctx,
+                                         const Row& base_row) const {
   // Did not find an entry to delete from the index.
   if (base_row.empty()) {
     return absl::OkStatus();
@@ -129,7 +207,53 @@ absl::Status IndexEffector::Effect(const ActionContext* ctx,
   }
 
   // Delete the row from the index.
-  ctx->effects()->Delete(index_->index_data_table(), index_key);
+  ctx->effects()->Delete(index_->index_data_table(), std::move(index_key));
+  return absl::OkStatus();
+}
+
+absl::Status IndexEffector::EffectBatch(const ActionContext* ctx,
+                                        absl::Span<const WriteOp> ops) const {
+  if (ops.size() <= 1 || absl::holds_alternative<InsertOp>(ops.front()) ||
+      std::any_of(ops.begin(), ops.end(), [](const WriteOp& op) {
+        return absl::holds_alternative<DeleteOp>(op) &&
+               IsPrefixDelete(absl::get<DeleteOp>(op));
+      })) {
+    return Effector::EffectBatch(ctx, ops);
+  }
+
+  // Updates which write no column of the index leave its entries unchanged,
+  // so their rows are not read.
+  std::vector<const WriteOp*> effected_ops;
+  std::vector<Key> keys;
+  for (const WriteOp& op : ops) {
+    if (absl::holds_alternative<UpdateOp>(op) &&
+        !UpdatesIndexColumns(absl::get<UpdateOp>(op))) {
+      continue;
+    }
+    effected_ops.push_back(&op);
+    keys.push_back(KeyOf(op));
+  }
+  if (effected_ops.empty()) {
+    return absl::OkStatus();
+  }
+
+  // Read the current base row values for the whole batch at once.
+  const Table* table = TableOf(ops.front());
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<absl::optional<ValueList>> base_values,
+                   LookupRowsInBatch(ctx, table, keys, base_columns_));
+  for (int i = 0; i < effected_ops.size(); ++i) {
+    const WriteOp& op = *effected_ops[i];
+    Row base_row;
+    if (base_values[i].has_value()) {
+      base_row = MakeRow(base_columns_, *base_values[i]);
+    }
+    if (absl::holds_alternative<UpdateOp>(op)) {
+      ZETASQL_RETURN_IF_ERROR(
+          EffectUpdate(ctx, absl::get<UpdateOp>(op), std::move(base_row)));
+    } else {
+      ZETASQL_RETURN_IF_ERROR(EffectDelete(ctx, base_row));
+    }
+  }
   return absl::OkStatus();
 }
 
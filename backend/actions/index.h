@@ -17,8 +17,14 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_INDEX_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_INDEX_H_
 
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/types/span.h"
 #include "backend/actions/action.h"
 #include "backend/actions/ops.h"
+#include "backend/common/rows.h"
 #include "backend/schema/catalog/table.h"
 #include "absl/status/status.h"
 
@@ -35,7 +41,9 @@ namespace backend {
 // - Insert: Index entry is computed from the indexed row & buffered to the
 //           index.
 // - Update: Old index entry is buffered to be deleted and a new index entry is
-//           buffered to be added.
+//           buffered to be added. Updates which change no key column of the
+//           index instead update the stored columns of its entry in place,
+//           and updates which change no column of the index are ignored.
 // - Delete: Index entry is buffered to be deleted.
 //
 // NULL_FILTERED index entries are omitted from all operations above.
@@ -51,11 +59,33 @@ class IndexEffector : public Effector {
                       const UpdateOp& op) const override;
   absl::Status Effect(const ActionContext* ctx,
                       const DeleteOp& op) const override;
+  absl::Status EffectBatch(const ActionContext* ctx,
+                           absl::Span<const WriteOp> ops) const override;
+
+  // Buffers the index operations for an update or delete of `base_row`, which
+  // holds the current values of base_columns_, or is empty if the row does not
+  // exist.
+  absl::Status EffectUpdate(const ActionContext* ctx, const UpdateOp& op,
+                            Row base_row) const;
+  absl::Status EffectDelete(const ActionContext* ctx,
+                            const Row& base_row) const;
+
+  // Returns true if `op` writes any of base_columns_.
+  bool UpdatesIndexColumns(const UpdateOp& op) const;
+
+  // Returns true if `op` writes any column of the index data table key.
+  bool UpdatesIndexKeyColumns(const UpdateOp& op) const;
 
   const Index* index_;
 
   // List of indexed table columns relevant to the index.
   std::vector<const Column*> base_columns_;
+
+  // The indexed table columns which the index data table key is made of.
+  absl::flat_hash_set<const Column*> key_base_columns_;
+
+  // The column of the index data table storing each indexed table column.
+  absl::flat_hash_map<const Column*, const Column*> index_columns_;
 };
 
 }  // namespace backend
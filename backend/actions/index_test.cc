@@ -196,6 +196,62 @@ TEST_F(IndexTest, UpdateCascadesToIndexEntry) {
                            {String("new-value"), Int64(1), String("value2")}}));
 }
 
+TEST_F(IndexTest, UpdateOfStoredColumnUpdatesIndexEntryInPlace) {
+  // Add row in base table & index.
+  ZETASQL_EXPECT_OK(store()->Insert(table_, Key({Int64(1)}), base_columns_,
+                            {Int64(1), String("value"), String("value2")}));
+  ZETASQL_EXPECT_OK(store()->Insert(index_->index_data_table(),
+                            Key({String("value"), Int64(1)}), index_columns_,
+                            {Int64(1), String("value"), String("value2")}));
+
+  // Update the stored column of the base table entry.
+  ZETASQL_EXPECT_OK(effector_->Effect(
+      ctx(), Update(table_, Key({Int64(1)}),
+                    {table_->FindColumn("another_string_col")},
+                    {String("new-value2")})));
+
+  // Verify the existing index entry is updated, rather than replaced.
+  const Column* stored_column =
+      index_->index_data_table()->FindColumn("another_string_col");
+  ASSERT_EQ(effects_buffer()->ops_queue()->size(), 1);
+  EXPECT_THAT(effects_buffer()->ops_queue()->front(),
+              testing::VariantWith<UpdateOp>(UpdateOp{
+                  index_->index_data_table(),
+                  Key({String("value"), Int64(1)}),
+                  {stored_column},
+                  {String("new-value2")}}));
+}
+
+TEST_F(IndexTest, UpdateOfUnindexedColumnDoesNotCascadeToIndex) {
+  zetasql::TypeFactory type_factory;
+  std::unique_ptr<const Schema> schema =
+      emulator::test::CreateSchemaFromDDL(
+          {
+              R"(
+                  CREATE TABLE TestTable (
+                    int64_col INT64 NOT NULL,
+                    string_col STRING(MAX),
+                    another_string_col STRING(MAX)
+                  ) PRIMARY KEY (int64_col)
+                )",
+              R"(
+                  CREATE INDEX TestIndex ON TestTable(string_col)
+                )"},
+          &type_factory)
+          .value();
+  const Table* table = schema->FindTable("TestTable");
+  std::unique_ptr<Effector> effector =
+      absl::make_unique<IndexEffector>(schema->FindIndex("TestIndex"));
+
+  // The row is not even read, so the update does not fail although the row
+  // does not exist.
+  ZETASQL_EXPECT_OK(effector->Effect(
+      ctx(), Update(table, Key({Int64(1)}),
+                    {table->FindColumn("another_string_col")},
+                    {String("value")})));
+  EXPECT_EQ(effects_buffer()->ops_queue()->size(), 0);
+}
+
 }  // namespace
 }  // namespace backend
 }  // namespace emulator
@@ -17,11 +17,18 @@
 #include "backend/actions/interleave.h"
 
 #include <memory>
+#include <utility>
+#include <vector>
 
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "absl/types/variant.h"
+#include "backend/actions/batch.h"
 #include "backend/datamodel/key_range.h"
 #include "backend/storage/iterator.h"
 #include "common/errors.h"
 #include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
 #include "zetasql/base/statusor.h"
 
 namespace google {
@@ -29,12 +36,44 @@ namespace spanner {
 namespace emulator {
 namespace backend {
 
+bool CanDeleteByPrefix(const Table* table) {
+  if (!table->referencing_foreign_keys().empty()) {
+    return false;
+  }
+  for (const Table* child : table->children()) {
+    if (child->on_delete_action() != Table::OnDeleteAction::kCascade ||
+        !CanDeleteByPrefix(child)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 InterleaveParentValidator::InterleaveParentValidator(const Table* parent,
                                                      const Table* child)
     : parent_(parent),
       child_(child),
       on_delete_action_(child->on_delete_action()) {}
 
+absl::Status InterleaveParentValidator::ValidateBatch(
+    const ActionContext* ctx, absl::Span<const WriteOp> ops) const {
+  if (ops.size() <= 1 || !absl::holds_alternative<DeleteOp>(ops.front()) ||
+      on_delete_action_ != Table::OnDeleteAction::kNoAction) {
+    return Validator::ValidateBatch(ctx, ops);
+  }
+
+  // Check for children of all the deleted rows with a single read.
+  std::vector<Key> keys = KeysOf(ops);
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<Key> child_keys,
+                   ReadKeysWithPrefixesInBatch(ctx, child_, keys));
+  if (!child_keys.empty()) {
+    return error::ChildKeyExists(
+        parent_->Name(), child_->Name(),
+        child_keys.front().Prefix(parent_->primary_key().size()).DebugString());
+  }
+  return absl::OkStatus();
+}
+
 absl::Status InterleaveParentValidator::Validate(const ActionContext* ctx,
                                                  const DeleteOp& op) const {
   switch (on_delete_action_) {
@@ -57,7 +96,28 @@ InterleaveParentEffector::InterleaveParentEffector(const Table* parent,
                                                    const Table* child)
     : parent_(parent),
       child_(child),
-      on_delete_action_(child->on_delete_action()) {}
+      on_delete_action_(child->on_delete_action()),
+      delete_by_prefix_(on_delete_action_ == Table::OnDeleteAction::kCascade &&
+                        CanDeleteByPrefix(child)) {}
+
+absl::Status InterleaveParentEffector::EffectBatch(
+    const ActionContext* ctx, absl::Span<const WriteOp> ops) const {
+  if (ops.size() <= 1 || !absl::holds_alternative<DeleteOp>(ops.front()) ||
+      on_delete_action_ != Table::OnDeleteAction::kCascade ||
+      delete_by_prefix_) {
+    return Effector::EffectBatch(ctx, ops);
+  }
+
+  // Cascade the deletes to the children of all the deleted rows with a single
+  // read. Children are deleted in key order, as they are for each row in turn.
+  std::vector<Key> keys = KeysOf(ops);
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<Key> child_keys,
+                   ReadKeysWithPrefixesInBatch(ctx, child_, keys));
+  for (Key& child_key : child_keys) {
+    ctx->effects()->Delete(child_, std::move(child_key));
+  }
+  return absl::OkStatus();
+}
 
 absl::Status InterleaveParentEffector::Effect(const ActionContext* ctx,
                                               const DeleteOp& op) const {
@@ -66,6 +126,16 @@ absl::Status InterleaveParentEffector::Effect(const ActionContext* ctx,
       return absl::OkStatus();
     }
     case Table::OnDeleteAction::kCascade: {
+      if (delete_by_prefix_) {
+        // The parent key (itself a prefix for prefix deletes of the parent) is
+        // a prefix of the keys of all the child rows to delete.
+        ZETASQL_ASSIGN_OR_RETURN(bool has_children,
+                         ctx->store()->PrefixExists(child_, op.key));
+        if (has_children) {
+          ctx->effects()->Delete(child_, op.key);
+        }
+        return absl::OkStatus();
+      }
       ZETASQL_ASSIGN_OR_RETURN(
           std::unique_ptr<StorageIterator> itr,
           ctx->store()->Read(child_, KeyRange::Prefix(op.key), {}));
@@ -83,6 +153,33 @@ InterleaveChildValidator::InterleaveChildValidator(const Table* parent,
       child_(child),
       on_delete_action_(child->on_delete_action()) {}
 
+absl::Status InterleaveChildValidator::ValidateBatch(
+    const ActionContext* ctx, absl::Span<const WriteOp> ops) const {
+  if (ops.size() <= 1 || !absl::holds_alternative<InsertOp>(ops.front())) {
+    return Validator::ValidateBatch(ctx, ops);
+  }
+
+  // Compute the distinct parent keys, which are sorted since they are prefixes
+  // of the sorted child keys, and check that they exist with a single read.
+  std::vector<Key> parent_keys;
+  for (const WriteOp& op : ops) {
+    Key parent_key = KeyOf(op).Prefix(parent_->primary_key().size());
+    if (parent_keys.empty() || !(parent_keys.back() == parent_key)) {
+      parent_keys.push_back(std::move(parent_key));
+    }
+  }
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<absl::optional<ValueList>> parent_rows,
+                   LookupRowsInBatch(ctx, parent_, parent_keys,
+                                     /*columns=*/{}));
+  for (int i = 0; i < parent_keys.size(); ++i) {
+    if (!parent_rows[i].has_value()) {
+      return error::ParentKeyNotFound(parent_->Name(), child_->Name(),
+                                      parent_keys[i].DebugString());
+    }
+  }
+  return absl::OkStatus();
+}
+
 absl::Status InterleaveChildValidator::Validate(const ActionContext* ctx,
                                                 const InsertOp& op) const {
   // Compute the parent key as prefix of the child key.
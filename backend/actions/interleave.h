@@ -17,6 +17,7 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_INTERLEAVE_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_INTERLEAVE_H_
 
+#include "absl/types/span.h"
 #include "backend/actions/action.h"
 #include "backend/actions/ops.h"
 #include "backend/schema/catalog/table.h"
@@ -27,6 +28,11 @@ namespace spanner {
 namespace emulator {
 namespace backend {
 
+// Returns true if the rows of the table and of all its descendants can be
+// deleted by key prefix: deleting them has no effects which need the rows one
+// at a time, other than index maintenance which reads the deleted range.
+bool CanDeleteByPrefix(const Table* table);
+
 // InterleaveParentValidator triggers on mutations to a parent table in an
 // interleave relationship.
 //
@@ -41,6 +47,8 @@ class InterleaveParentValidator : public Validator {
   InterleaveParentValidator(const Table* parent, const Table* child);
 
  private:
+  absl::Status ValidateBatch(const ActionContext* ctx,
+                             absl::Span<const WriteOp> ops) const override;
   absl::Status Validate(const ActionContext* ctx,
                         const DeleteOp& op) const override;
 
@@ -57,17 +65,27 @@ class InterleaveParentValidator : public Validator {
 // there are the following two cases:
 // - kNoAction: No extra mutations are added.
 // - kCascade : Additional mutations are added to delete child rows.
+//
+// If the rows of the child table (and of all its descendants) need no checks
+// of their own when deleted, that is every descendant table is ON DELETE
+// CASCADE and no foreign key references any of them, child rows are deleted
+// with a single prefix delete of the parent key instead of one delete per row.
 class InterleaveParentEffector : public Effector {
  public:
   InterleaveParentEffector(const Table* parent, const Table* child);
 
  private:
+  absl::Status EffectBatch(const ActionContext* ctx,
+                           absl::Span<const WriteOp> ops) const override;
   absl::Status Effect(const ActionContext* ctx,
                       const DeleteOp& op) const override;
 
   const Table* parent_;
   const Table* child_;
   const Table::OnDeleteAction on_delete_action_;
+
+  // True if child rows are deleted by prefix, see above.
+  const bool delete_by_prefix_;
 };
 
 // InterleaveChildValidator validates row operations on a child table.
@@ -80,6 +98,8 @@ class InterleaveChildValidator : public Validator {
   InterleaveChildValidator(const Table* parent, const Table* child);
 
  private:
+  absl::Status ValidateBatch(const ActionContext* ctx,
+                             absl::Span<const WriteOp> ops) const override;
   absl::Status Validate(const ActionContext* ctx,
                         const InsertOp& op) const override;
 
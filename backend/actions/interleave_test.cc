@@ -18,6 +18,7 @@
 
 #include <memory>
 #include <queue>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -138,14 +139,29 @@ TEST_F(InterleaveTest, ParentRowDeleteWithOnDeleteCascadeAddsEffects) {
       absl::make_unique<InterleaveParentEffector>(parent_table_,
                                                   cascade_delete_child_);
 
-  // Effector should add delete ops for child rows.
+  // Effector should add a single prefix delete op for the child rows, since
+  // deleting them needs no further checks.
   ZETASQL_EXPECT_OK(store()->Insert(cascade_delete_child_, Key({Int64(1), Int64(1)}),
                             {}, {}));
+  ZETASQL_EXPECT_OK(store()->Insert(cascade_delete_child_, Key({Int64(1), Int64(2)}),
+                            {}, {}));
   ZETASQL_EXPECT_OK(effector->Effect(ctx(), Delete(parent_table_, Key({Int64(1)}))));
   ASSERT_EQ(effects_buffer()->ops_queue()->size(), 1);
   EXPECT_THAT(effects_buffer()->ops_queue()->front(),
               testing::VariantWith<DeleteOp>(
-                  DeleteOp{cascade_delete_child_, Key({Int64(1), Int64(1)})}));
+                  DeleteOp{cascade_delete_child_, Key({Int64(1)})}));
+  EXPECT_TRUE(IsPrefixDelete(
+      absl::get<DeleteOp>(effects_buffer()->ops_queue()->front())));
+}
+
+TEST_F(InterleaveTest, ParentRowDeleteWithOnDeleteCascadeWithoutChildRows) {
+  std::unique_ptr<Effector> effector =
+      absl::make_unique<InterleaveParentEffector>(parent_table_,
+                                                  cascade_delete_child_);
+
+  // Effector should not add a delete op if there are no child rows.
+  ZETASQL_EXPECT_OK(effector->Effect(ctx(), Delete(parent_table_, Key({Int64(1)}))));
+  EXPECT_EQ(effects_buffer()->ops_queue()->size(), 0);
 }
 
 TEST_F(InterleaveTest, ChildRowInsertFailsWithoutParentRow) {
@@ -172,6 +188,72 @@ TEST_F(InterleaveTest, ChildRowInsertSucceedsWithParentRow) {
       ctx(), Insert(cascade_delete_child_, Key({Int64(1), Int64(1)}))));
 }
 
+TEST_F(InterleaveTest, ChildRowInsertBatchChecksEachParentRow) {
+  std::unique_ptr<Validator> validator =
+      absl::make_unique<InterleaveChildValidator>(parent_table_,
+                                                  cascade_delete_child_);
+
+  // Add parent rows 1 and 3, but not 2.
+  ZETASQL_EXPECT_OK(store()->Insert(parent_table_, Key({Int64(1)}), {}, {}));
+  ZETASQL_EXPECT_OK(store()->Insert(parent_table_, Key({Int64(3)}), {}, {}));
+
+  // Batch succeeds when all the parent rows exist.
+  std::vector<WriteOp> ops = {
+      Insert(cascade_delete_child_, Key({Int64(1), Int64(1)})),
+      Insert(cascade_delete_child_, Key({Int64(1), Int64(2)})),
+      Insert(cascade_delete_child_, Key({Int64(3), Int64(1)}))};
+  ZETASQL_EXPECT_OK(validator->ValidateBatch(ctx(), ops));
+
+  // Batch fails when any of the parent rows is missing.
+  ops.insert(ops.begin() + 2,
+             Insert(cascade_delete_child_, Key({Int64(2), Int64(1)})));
+  EXPECT_THAT(validator->ValidateBatch(ctx(), ops),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST_F(InterleaveTest, ParentRowDeleteBatchWithNoActionFailsWithChildRows) {
+  std::unique_ptr<Validator> validator =
+      absl::make_unique<InterleaveParentValidator>(parent_table_,
+                                                   no_action_delete_child_);
+
+  // Only parent row 3 has a child row.
+  ZETASQL_EXPECT_OK(store()->Insert(no_action_delete_child_, Key({Int64(3), Int64(1)}),
+                            {}, {}));
+  std::vector<WriteOp> ops = {Delete(parent_table_, Key({Int64(1)})),
+                              Delete(parent_table_, Key({Int64(2)}))};
+  ZETASQL_EXPECT_OK(validator->ValidateBatch(ctx(), ops));
+
+  ops.push_back(Delete(parent_table_, Key({Int64(3)})));
+  EXPECT_THAT(validator->ValidateBatch(ctx(), ops),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST_F(InterleaveTest, ParentRowDeleteBatchWithOnDeleteCascadeAddsEffects) {
+  std::unique_ptr<Effector> effector =
+      absl::make_unique<InterleaveParentEffector>(parent_table_,
+                                                  cascade_delete_child_);
+
+  // Child rows of parent rows 1 and 3 are deleted by prefix, but not those of
+  // row 2.
+  for (int64_t k1 : {1, 2, 3}) {
+    for (int64_t k2 : {1, 2}) {
+      ZETASQL_EXPECT_OK(store()->Insert(cascade_delete_child_,
+                                Key({Int64(k1), Int64(k2)}), {}, {}));
+    }
+  }
+  ZETASQL_EXPECT_OK(effector->EffectBatch(
+      ctx(), {Delete(parent_table_, Key({Int64(1)})),
+              Delete(parent_table_, Key({Int64(3)}))}));
+
+  std::vector<Key> deleted_keys;
+  while (!effects_buffer()->ops_queue()->empty()) {
+    deleted_keys.push_back(KeyOf(effects_buffer()->ops_queue()->front()));
+    effects_buffer()->ops_queue()->pop();
+  }
+  EXPECT_THAT(deleted_keys,
+              testing::ElementsAre(Key({Int64(1)}), Key({Int64(3)})));
+}
+
 }  // namespace
 }  // namespace backend
 }  // namespace emulator
@@ -16,12 +16,15 @@
 
 #include "backend/actions/manager.h"
 
+#include <algorithm>
 #include <memory>
+#include <utility>
 
 #include "zetasql/base/statusor.h"
 #include "backend/actions/column_value.h"
 #include "backend/actions/existence.h"
 #include "backend/actions/foreign_key.h"
+#include "backend/actions/generated_column.h"
 #include "backend/actions/index.h"
 #include "backend/actions/interleave.h"
 #include "backend/actions/unique_index.h"
@@ -32,9 +35,36 @@ namespace spanner {
 namespace emulator {
 namespace backend {
 
+namespace {
+
+// Returns the actions registered for 'table' in 'actions', or an empty list if
+// there are none.
+template <typename T>
+absl::Span<T* const> ActionsFor(
+    const absl::flat_hash_map<const Table*, std::vector<T*>>& actions,
+    const Table* table) {
+  auto itr = actions.find(table);
+  if (itr == actions.end()) {
+    return {};
+  }
+  return itr->second;
+}
+
+// Appends the actions in 'owned' to the per-table lists in 'actions'.
+template <typename T>
+void Register(
+    const std::vector<std::pair<const Table*, std::unique_ptr<T>>>& owned,
+    absl::flat_hash_map<const Table*, std::vector<T*>>* actions) {
+  for (const auto& [table, action] : owned) {
+    (*actions)[table].push_back(action.get());
+  }
+}
+
+}  // namespace
+
 absl::Status ActionRegistry::ExecuteValidators(const ActionContext* ctx,
                                                const WriteOp& op) {
-  for (auto& validator : table_validators_[TableOf(op)]) {
+  for (Validator* validator : ActionsFor(table_validators_, TableOf(op))) {
     ZETASQL_RETURN_IF_ERROR(validator->Validate(ctx, op));
   }
   return absl::OkStatus();
@@ -42,15 +72,39 @@ absl::Status ActionRegistry::ExecuteValidators(const ActionContext* ctx,
 
 absl::Status ActionRegistry::ExecuteEffectors(const ActionContext* ctx,
                                               const WriteOp& op) {
-  for (auto& effector : table_effectors_[TableOf(op)]) {
+  for (Effector* effector : ActionsFor(table_effectors_, TableOf(op))) {
     ZETASQL_RETURN_IF_ERROR(effector->Effect(ctx, op));
   }
   return absl::OkStatus();
 }
 
+absl::Status ActionRegistry::ExecuteValidators(const ActionContext* ctx,
+                                               absl::Span<const WriteOp> ops) {
+  if (ops.empty()) {
+    return absl::OkStatus();
+  }
+  for (Validator* validator :
+       ActionsFor(table_validators_, TableOf(ops.front()))) {
+    ZETASQL_RETURN_IF_ERROR(validator->ValidateBatch(ctx, ops));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ActionRegistry::ExecuteEffectors(const ActionContext* ctx,
+                                              absl::Span<const WriteOp> ops) {
+  if (ops.empty()) {
+    return absl::OkStatus();
+  }
+  for (Effector* effector :
+       ActionsFor(table_effectors_, TableOf(ops.front()))) {
+    ZETASQL_RETURN_IF_ERROR(effector->EffectBatch(ctx, ops));
+  }
+  return absl::OkStatus();
+}
+
 absl::Status ActionRegistry::ExecuteModifiers(const ActionContext* ctx,
                                               const WriteOp& op) {
-  for (auto& modifier : table_modifiers_[TableOf(op)]) {
+  for (Modifier* modifier : ActionsFor(table_modifiers_, TableOf(op))) {
     ZETASQL_RETURN_IF_ERROR(modifier->Modify(ctx, op));
   }
   return absl::OkStatus();
@@ -58,79 +112,155 @@ absl::Status ActionRegistry::ExecuteModifiers(const ActionContext* ctx,
 
 absl::Status ActionRegistry::ExecuteVerifiers(const ActionContext* ctx,
                                               const WriteOp& op) {
-  for (auto& verifier : table_verifiers_[TableOf(op)]) {
+  for (Verifier* verifier : ActionsFor(table_verifiers_, TableOf(op))) {
     ZETASQL_RETURN_IF_ERROR(verifier->Verify(ctx, op));
   }
   return absl::OkStatus();
 }
 
-ActionRegistry::ActionRegistry(const Schema* schema) : schema_(schema) {
-  BuildActionRegistry();
+absl::Status ActionRegistry::ExecuteVerifiers(const ActionContext* ctx,
+                                              absl::Span<const WriteOp> ops) {
+  if (ops.empty()) {
+    return absl::OkStatus();
+  }
+  for (Verifier* verifier :
+       ActionsFor(table_verifiers_, TableOf(ops.front()))) {
+    ZETASQL_RETURN_IF_ERROR(verifier->VerifyBatch(ctx, ops));
+  }
+  return absl::OkStatus();
+}
+
+ActionRegistry::ActionRegistry(const Schema* schema,
+                               const ActionRegistry* previous)
+    : schema_(schema) {
+  BuildActionRegistry(previous);
 }
 
-void ActionRegistry::BuildActionRegistry() {
+void ActionRegistry::BuildActionRegistry(const ActionRegistry* previous) {
   for (const Table* table : schema_->tables()) {
-    // Column value checks for all tables.
-    table_validators_[table].emplace_back(
-        absl::make_unique<ColumnValueValidator>());
+    std::shared_ptr<const TableActions> actions = nullptr;
+    if (previous != nullptr) {
+      auto itr = previous->table_actions_.find(table);
+      if (itr != previous->table_actions_.end()) {
+        actions = itr->second;
+        ++num_reused_tables_;
+      }
+    }
+    if (actions == nullptr) {
+      actions = BuildTableActions(schema_, table);
+    }
 
-    // Row existence checks for all tables.
-    table_validators_[table].emplace_back(
-        absl::make_unique<RowExistenceValidator>());
+    // Registering the actions table by table, in schema order, keeps the
+    // order in which the actions for a given table are executed.
+    Register(actions->validators, &table_validators_);
+    Register(actions->effectors, &table_effectors_);
+    Register(actions->modifiers, &table_modifiers_);
+    Register(actions->verifiers, &table_verifiers_);
+    table_actions_[table] = std::move(actions);
+  }
+}
 
-    // Interleave actions for child tables.
-    for (const Table* child : table->children()) {
-      table_validators_[table].emplace_back(
-          absl::make_unique<InterleaveParentValidator>(table, child));
+std::shared_ptr<const ActionRegistry::TableActions>
+ActionRegistry::BuildTableActions(const Schema* schema, const Table* table) {
+  auto actions = std::make_shared<TableActions>();
 
-      table_effectors_[table].emplace_back(
-          absl::make_unique<InterleaveParentEffector>(table, child));
-    }
+  // Column value checks for all tables.
+  actions->validators.emplace_back(
+      table, absl::make_unique<ColumnValueValidator>(table));
 
-    // Interleave actions for parent table.
-    if (table->parent() != nullptr) {
-      table_validators_[table].emplace_back(
-          absl::make_unique<InterleaveChildValidator>(table->parent(), table));
-    }
+  // Row existence checks for all tables.
+  actions->validators.emplace_back(table,
+                                   absl::make_unique<RowExistenceValidator>());
 
-    // Actions for Index.
-    for (const Index* index : table->indexes()) {
-      // Index effects.
-      table_effectors_[table].emplace_back(
-          absl::make_unique<IndexEffector>(index));
+  // Generated column effects for tables with generated columns.
+  if (std::any_of(
+          table->columns().begin(), table->columns().end(),
+          [](const Column* column) { return column->is_generated(); })) {
+    actions->effectors.emplace_back(
+        table, absl::make_unique<GeneratedColumnEffector>(schema, table));
+  }
 
-      // Index uniqueness checks.
-      if (index->is_unique()) {
-        table_verifiers_[index->index_data_table()].emplace_back(
-            absl::make_unique<UniqueIndexVerifier>(index));
-      }
-    }
+  // Interleave actions for child tables.
+  for (const Table* child : table->children()) {
+    actions->validators.emplace_back(
+        table, absl::make_unique<InterleaveParentValidator>(table, child));
 
-    // Actions for foreign keys.
-    for (const ForeignKey* foreign_key : table->foreign_keys()) {
-      table_verifiers_[foreign_key->referencing_data_table()].emplace_back(
-          absl::make_unique<ForeignKeyReferencingVerifier>(foreign_key));
-    }
-    for (const ForeignKey* foreign_key : table->referencing_foreign_keys()) {
-      table_verifiers_[foreign_key->referenced_data_table()].emplace_back(
-          absl::make_unique<ForeignKeyReferencedVerifier>(foreign_key));
+    actions->effectors.emplace_back(
+        table, absl::make_unique<InterleaveParentEffector>(table, child));
+  }
+
+  // Interleave actions for parent table.
+  if (table->parent() != nullptr) {
+    actions->validators.emplace_back(
+        table,
+        absl::make_unique<InterleaveChildValidator>(table->parent(), table));
+  }
+
+  // Actions for Index.
+  for (const Index* index : table->indexes()) {
+    // Index effects.
+    actions->effectors.emplace_back(table,
+                                    absl::make_unique<IndexEffector>(index));
+
+    // Index uniqueness checks.
+    if (index->is_unique()) {
+      actions->verifiers.emplace_back(
+          index->index_data_table(),
+          absl::make_unique<UniqueIndexVerifier>(index));
     }
   }
+
+  // Actions for foreign keys.
+  for (const ForeignKey* foreign_key : table->foreign_keys()) {
+    actions->verifiers.emplace_back(
+        foreign_key->referencing_data_table(),
+        absl::make_unique<ForeignKeyReferencingVerifier>(foreign_key));
+  }
+  for (const ForeignKey* foreign_key : table->referencing_foreign_keys()) {
+    actions->verifiers.emplace_back(
+        foreign_key->referenced_data_table(),
+        absl::make_unique<ForeignKeyReferencedVerifier>(foreign_key));
+  }
+  return actions;
 }
 
 void ActionManager::AddActionsForSchema(const Schema* schema) {
-  registry_[schema] = absl::make_unique<ActionRegistry>(schema);
+  absl::MutexLock lock(&mu_);
+  latest_registry_ =
+      std::make_shared<ActionRegistry>(schema, latest_registry_.get());
+  registry_[schema] = latest_registry_;
+}
+
+void ActionManager::AddActionsForSchema(
+    const Schema* schema, std::shared_ptr<ActionRegistry> registry) {
+  absl::MutexLock lock(&mu_);
+  latest_registry_ = std::move(registry);
+  registry_[schema] = latest_registry_;
 }
 
-zetasql_base::StatusOr<ActionRegistry*> ActionManager::GetActionsForSchema(
-    const Schema* schema) const {
+zetasql_base::StatusOr<std::shared_ptr<ActionRegistry>>
+ActionManager::GetActionsForSchema(const Schema* schema) const {
+  absl::MutexLock lock(&mu_);
   auto itr = registry_.find(schema);
   if (itr == registry_.end()) {
     return error::Internal(
         absl::StrCat("Schema generation ", schema->generation(),
                      " was not registered with the Action Manager"));
   }
-  return itr->second.get();
+  std::shared_ptr<ActionRegistry> registry = itr->second.lock();
+  if (registry == nullptr) {
+    // The registry of an older schema was released after a newer schema was
+    // added. Rebuild it from the actions of the latest schema.
+    registry =
+        std::make_shared<ActionRegistry>(schema, latest_registry_.get());
+    itr->second = registry;
+  }
+  return registry;
+}
+
+void ActionManager::RemoveActionsForSchema(const Schema* schema) {
+  absl::MutexLock lock(&mu_);
+  registry_.erase(schema);
 }
 
 }  // namespace backend
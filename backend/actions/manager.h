@@ -18,9 +18,14 @@
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_MANAGER_H_
 
 #include <memory>
+#include <utility>
+#include <vector>
 
-#include "absl/container/node_hash_map.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "backend/actions/action.h"
 #include "backend/actions/context.h"
 #include "backend/actions/ops.h"
@@ -36,9 +41,15 @@ namespace backend {
 //
 // Transactions use this registry for constraint checking the writes to a
 // database.
+//
+// Actions are built per table of the schema. A registry built with a
+// 'previous' registry re-uses the actions of the tables that are unchanged
+// between the two schemas. Schema versions share the nodes of unchanged tables
+// so a table is unchanged if the same Table object is found in both schemas.
 class ActionRegistry {
  public:
-  explicit ActionRegistry(const Schema* schema);
+  explicit ActionRegistry(const Schema* schema,
+                          const ActionRegistry* previous = nullptr);
 
   // Executes the list of validators that apply to the given operation.
   absl::Status ExecuteValidators(const ActionContext* ctx, const WriteOp& op);
@@ -46,50 +57,114 @@ class ActionRegistry {
   // Executes the list of effectors that apply to the given operation.
   absl::Status ExecuteEffectors(const ActionContext* ctx, const WriteOp& op);
 
+  // Executes the list of validators that apply to a batch of operations of the
+  // same type on the same table, sorted by key and with no duplicate keys.
+  absl::Status ExecuteValidators(const ActionContext* ctx,
+                                 absl::Span<const WriteOp> ops);
+
+  // Executes the list of effectors that apply to a batch of operations of the
+  // same type on the same table, sorted by key and with no duplicate keys.
+  absl::Status ExecuteEffectors(const ActionContext* ctx,
+                                absl::Span<const WriteOp> ops);
+
   // Executes the list of modifiers that apply to the given operation.
   absl::Status ExecuteModifiers(const ActionContext* ctx, const WriteOp& op);
 
   // Executes the list of verifiers that apply to the given operation.
   absl::Status ExecuteVerifiers(const ActionContext* ctx, const WriteOp& op);
 
+  // Executes the list of verifiers that apply to a batch of operations of the
+  // same type on the same table, sorted by key and with no duplicate keys.
+  absl::Status ExecuteVerifiers(const ActionContext* ctx,
+                                absl::Span<const WriteOp> ops);
+
+  // Returns the number of tables whose actions were re-used from the previous
+  // registry.
+  int num_reused_tables() const { return num_reused_tables_; }
+
  private:
+  // Actions created for a single table of the schema, each paired with the
+  // table whose operations it applies to.
+  struct TableActions {
+    std::vector<std::pair<const Table*, std::unique_ptr<Validator>>> validators;
+    std::vector<std::pair<const Table*, std::unique_ptr<Effector>>> effectors;
+    std::vector<std::pair<const Table*, std::unique_ptr<Modifier>>> modifiers;
+    std::vector<std::pair<const Table*, std::unique_ptr<Verifier>>> verifiers;
+  };
+
   // Initialize the validators, effectors, modifiers and verifiers for each
   // table in the given schema.
-  void BuildActionRegistry();
+  void BuildActionRegistry(const ActionRegistry* previous);
+
+  // Creates the actions for 'table' of 'schema'. The expressions of its
+  // generated columns are prepared here, so that they are prepared once per
+  // table version rather than for each write.
+  static std::shared_ptr<const TableActions> BuildTableActions(
+      const Schema* schema, const Table* table);
 
   // Schema used to define the registry of actions.
   const Schema* schema_;
 
+  // Actions owned per table. Shared with the registries of other schema
+  // versions containing the same table.
+  absl::flat_hash_map<const Table*, std::shared_ptr<const TableActions>>
+      table_actions_;
+
+  // Number of tables whose actions were re-used from the previous registry.
+  int num_reused_tables_ = 0;
+
   // List of validators per table.
-  absl::node_hash_map<const Table*, std::vector<std::unique_ptr<Validator>>>
-      table_validators_;
+  absl::flat_hash_map<const Table*, std::vector<Validator*>> table_validators_;
 
   // List of effectors per table.
-  absl::node_hash_map<const Table*, std::vector<std::unique_ptr<Effector>>>
-      table_effectors_;
+  absl::flat_hash_map<const Table*, std::vector<Effector*>> table_effectors_;
 
   // List of modifiers per table.
-  absl::node_hash_map<const Table*, std::vector<std::unique_ptr<Modifier>>>
-      table_modifiers_;
+  absl::flat_hash_map<const Table*, std::vector<Modifier*>> table_modifiers_;
 
   // List of verifiers per table.
-  absl::node_hash_map<const Table*, std::vector<std::unique_ptr<Verifier>>>
-      table_verifiers_;
+  absl::flat_hash_map<const Table*, std::vector<Verifier*>> table_verifiers_;
 };
 
 // ActionManager manages the registry of actions for each schema in the
 // database.
+//
+// Only the registry of the latest schema is owned by the manager. Registries
+// of older schemas are released once no transaction holds them any more and
+// are rebuilt if requested again.
 class ActionManager {
  public:
-  // Builds the registry of actions for given schema.
-  void AddActionsForSchema(const Schema* schema);
+  // Builds the registry of actions for given schema, re-using the actions of
+  // the tables unchanged since the previously added schema.
+  void AddActionsForSchema(const Schema* schema) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Adds an already built registry of actions for given schema. Used by
+  // databases cloned from another database, which share its schema and so can
+  // share its registry too.
+  void AddActionsForSchema(const Schema* schema,
+                           std::shared_ptr<ActionRegistry> registry)
+      ABSL_LOCKS_EXCLUDED(mu_);
 
   // Returns the action registry for given schema.
-  zetasql_base::StatusOr<ActionRegistry*> GetActionsForSchema(
-      const Schema* schema) const;
+  zetasql_base::StatusOr<std::shared_ptr<ActionRegistry>> GetActionsForSchema(
+      const Schema* schema) const ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Forgets the registry of given schema. Called when the schema is pruned
+  // from the database's catalog. Registries still held by transactions remain
+  // valid.
+  void RemoveActionsForSchema(const Schema* schema) ABSL_LOCKS_EXCLUDED(mu_);
 
  private:
-  absl::node_hash_map<const Schema*, std::unique_ptr<ActionRegistry>> registry_;
+  // Guards the registries.
+  mutable absl::Mutex mu_;
+
+  // Registry of the latest added schema.
+  std::shared_ptr<ActionRegistry> latest_registry_ ABSL_GUARDED_BY(mu_);
+
+  // Registries of all the added schemas, keyed by schema. Entries of released
+  // registries are kept so that they can be rebuilt on demand.
+  mutable absl::flat_hash_map<const Schema*, std::weak_ptr<ActionRegistry>>
+      registry_ ABSL_GUARDED_BY(mu_);
 };
 
 }  // namespace backend
@@ -0,0 +1,148 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/actions/manager.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "zetasql/public/type.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "tests/common/proto_matchers.h"
+#include "absl/status/status.h"
+#include "backend/common/ids.h"
+#include "backend/schema/catalog/schema.h"
+#include "backend/schema/updater/schema_updater.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql_base::testing::StatusIs;
+
+class ActionManagerTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(schema_, UpdateSchema(nullptr, {R"(
+      CREATE TABLE T1 (
+        k1 INT64,
+        c1 STRING(MAX),
+      ) PRIMARY KEY (k1)
+    )",
+                                                          R"(
+      CREATE TABLE T2 (
+        k2 INT64,
+        c2 STRING(MAX),
+      ) PRIMARY KEY (k2)
+    )",
+                                                          R"(
+      CREATE UNIQUE INDEX T2ByC2 ON T2(c2)
+    )"}));
+    ZETASQL_ASSERT_OK_AND_ASSIGN(new_schema_, UpdateSchema(schema_.get(), {R"(
+      ALTER TABLE T1 ADD COLUMN c3 INT64
+    )"}));
+  }
+
+  zetasql_base::StatusOr<std::unique_ptr<const Schema>> UpdateSchema(
+      const Schema* base_schema, std::vector<std::string> statements) {
+    SchemaChangeContext context{.type_factory = &type_factory_,
+                                .table_id_generator = &table_id_generator_,
+                                .column_id_generator = &column_id_generator_};
+    return SchemaUpdater().ValidateSchemaFromDDL(statements, context,
+                                                 base_schema);
+  }
+
+  zetasql::TypeFactory type_factory_;
+  TableIDGenerator table_id_generator_;
+  ColumnIDGenerator column_id_generator_;
+  std::unique_ptr<const Schema> schema_;
+  std::unique_ptr<const Schema> new_schema_;
+  ActionManager manager_;
+};
+
+TEST_F(ActionManagerTest, ReusesActionsOfUnchangedTables) {
+  manager_.AddActionsForSchema(schema_.get());
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto registry,
+                       manager_.GetActionsForSchema(schema_.get()));
+  EXPECT_EQ(registry->num_reused_tables(), 0);
+
+  // Only T1 was altered, so the actions of T2 and its index are re-used.
+  manager_.AddActionsForSchema(new_schema_.get());
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto new_registry,
+                       manager_.GetActionsForSchema(new_schema_.get()));
+  EXPECT_EQ(new_registry->num_reused_tables(), 1);
+}
+
+TEST_F(ActionManagerTest, ReleasesRegistriesOfOlderSchemas) {
+  manager_.AddActionsForSchema(schema_.get());
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto registry,
+                       manager_.GetActionsForSchema(schema_.get()));
+  std::weak_ptr<ActionRegistry> weak_registry = registry;
+
+  // The registry of the older schema stays alive while it is held.
+  manager_.AddActionsForSchema(new_schema_.get());
+  EXPECT_FALSE(weak_registry.expired());
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto same_registry,
+                       manager_.GetActionsForSchema(schema_.get()));
+  EXPECT_EQ(same_registry, registry);
+
+  // Once released, it is rebuilt on demand.
+  registry.reset();
+  same_registry.reset();
+  EXPECT_TRUE(weak_registry.expired());
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto rebuilt_registry,
+                       manager_.GetActionsForSchema(schema_.get()));
+  EXPECT_EQ(rebuilt_registry->num_reused_tables(), 1);
+
+  // The registry of the latest schema is owned by the manager.
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto latest_registry,
+                       manager_.GetActionsForSchema(new_schema_.get()));
+  std::weak_ptr<ActionRegistry> weak_latest_registry = latest_registry;
+  latest_registry.reset();
+  EXPECT_FALSE(weak_latest_registry.expired());
+}
+
+TEST_F(ActionManagerTest, UnregisteredSchemaIsAnError) {
+  manager_.AddActionsForSchema(schema_.get());
+  EXPECT_THAT(manager_.GetActionsForSchema(new_schema_.get()),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST_F(ActionManagerTest, RemovedSchemaIsUnregistered) {
+  manager_.AddActionsForSchema(schema_.get());
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto registry,
+                       manager_.GetActionsForSchema(schema_.get()));
+  manager_.AddActionsForSchema(new_schema_.get());
+
+  // Registries held by transactions outlive the removal.
+  manager_.RemoveActionsForSchema(schema_.get());
+  EXPECT_THAT(manager_.GetActionsForSchema(schema_.get()),
+              StatusIs(absl::StatusCode::kInternal));
+  EXPECT_NE(registry, nullptr);
+  ZETASQL_EXPECT_OK(manager_.GetActionsForSchema(new_schema_.get()));
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -132,6 +132,19 @@ const Table* TableOf(const WriteOp& op) {
   return absl::visit(TableVisitor(), op);
 }
 
+struct KeyVisitor {
+  template <typename OpT>
+  const Key& operator()(const OpT& op) const {
+    return op.key;
+  }
+};
+
+const Key& KeyOf(const WriteOp& op) { return absl::visit(KeyVisitor(), op); }
+
+bool IsPrefixDelete(const DeleteOp& op) {
+  return op.key.NumColumns() < op.table->primary_key().size();
+}
+
 }  // namespace backend
 }  // namespace emulator
 }  // namespace spanner
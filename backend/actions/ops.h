@@ -60,11 +60,15 @@ struct UpdateOp {
 };
 
 // DeleteOp encapsulates a single row delete operation.
+//
+// Cascading deletes of interleaved rows may instead delete every row with a
+// given key prefix, by using the prefix (which has fewer columns than the
+// primary key) as the key. See IsPrefixDelete.
 struct DeleteOp {
   // The table on which the operation is performed.
   const Table* table;
 
-  // Primary key for this row.
+  // Primary key for this row, or the key prefix of the rows to delete.
   Key key;
 };
 
@@ -75,6 +79,13 @@ using WriteOp = absl::variant<InsertOp, UpdateOp, DeleteOp>;
 // Returns the table of the row operation.
 const Table* TableOf(const WriteOp& op);
 
+// Returns the key of the row operation.
+const Key& KeyOf(const WriteOp& op);
+
+// Returns true if the delete operation covers all the rows with its key as a
+// prefix rather than a single row.
+bool IsPrefixDelete(const DeleteOp& op);
+
 // Streams out a string representation of the WriteOp.
 std::ostream& operator<<(std::ostream& out, const WriteOp& op);
 std::ostream& operator<<(std::ostream& out, const InsertOp& op);
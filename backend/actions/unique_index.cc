@@ -16,7 +16,13 @@
 
 #include "backend/actions/unique_index.h"
 
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "absl/types/variant.h"
 #include "backend/actions/action.h"
+#include "backend/actions/batch.h"
 #include "backend/actions/context.h"
 #include "backend/actions/ops.h"
 #include "backend/datamodel/key_range.h"
@@ -59,6 +65,51 @@ absl::Status UniqueIndexVerifier::Verify(const ActionContext* ctx,
   return absl::OkStatus();
 }
 
+absl::Status UniqueIndexVerifier::VerifyBatch(
+    const ActionContext* ctx, absl::Span<const WriteOp> ops) const {
+  if (!index_->is_unique() || ops.size() <= 1 ||
+      !absl::holds_alternative<InsertOp>(ops.front())) {
+    return Verifier::VerifyBatch(ctx, ops);
+  }
+
+  // The inserts are sorted by key, so inserts sharing an index key are
+  // adjacent and already violate the constraint between themselves.
+  const int num_key_columns = index_->key_columns().size();
+  std::vector<Key> index_keys;
+  index_keys.reserve(ops.size());
+  for (const WriteOp& op : ops) {
+    Key index_key = KeyOf(op).Prefix(num_key_columns);
+    if (!index_keys.empty() && index_keys.back() == index_key) {
+      return error::UniqueIndexConstraintViolation(index_->Name(),
+                                                   index_key.DebugString());
+    }
+    index_keys.push_back(std::move(index_key));
+  }
+
+  // Count the entries of every index key with a single sweep of the index.
+  ZETASQL_ASSIGN_OR_RETURN(
+      std::vector<Key> entries,
+      ReadKeysWithPrefixesInBatch(ctx, index_->index_data_table(), index_keys));
+  int i = 0;
+  for (const Key& index_key : index_keys) {
+    int num_entries = 0;
+    while (i < entries.size() && index_key.IsPrefixOf(entries[i])) {
+      ++num_entries;
+      ++i;
+    }
+    if (num_entries == 0) {
+      return error::Internal(
+          absl::StrCat("Missing entry for index: ", index_->Name(),
+                       " key: ", index_key.DebugString()));
+    }
+    if (num_entries > 1) {
+      return error::UniqueIndexConstraintViolation(index_->Name(),
+                                                   index_key.DebugString());
+    }
+  }
+  return absl::OkStatus();
+}
+
 }  // namespace backend
 }  // namespace emulator
 }  // namespace spanner
@@ -17,6 +17,7 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_UNIQUE_INDEX_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_ACTIONS_UNIQUE_INDEX_H_
 
+#include "absl/types/span.h"
 #include "backend/actions/action.h"
 #include "backend/actions/context.h"
 #include "backend/actions/ops.h"
@@ -39,6 +40,11 @@ class UniqueIndexVerifier : public Verifier {
  public:
   explicit UniqueIndexVerifier(const Index* index);
 
+  // Verifies the index keys of a batch of inserts with a single read of the
+  // index data table.
+  absl::Status VerifyBatch(const ActionContext* ctx,
+                           absl::Span<const WriteOp> ops) const override;
+
  private:
   absl::Status Verify(const ActionContext* ctx,
                       const InsertOp& op) const override;
@@ -16,6 +16,10 @@
 
 #include "backend/actions/unique_index.h"
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "zetasql/base/testing/status_matchers.h"
@@ -94,6 +98,39 @@ TEST_F(UniqueIndexTest, UniqueIndexKeysReturnsOk) {
                                             Key({String("value")}), {}, {})));
 }
 
+TEST_F(UniqueIndexTest, VerifiesBatchOfIndexKeysWithOneSweep) {
+  const Table* index_data = index_->index_data_table();
+  auto insert = [&](const std::string& value, int64_t id) {
+    return Insert(index_data, Key({String(value), Int64(id)}), {}, {});
+  };
+  ZETASQL_EXPECT_OK(
+      store()->Insert(index_data, Key({String("a"), Int64(1)}), {}, {}));
+  ZETASQL_EXPECT_OK(
+      store()->Insert(index_data, Key({String("b"), Int64(2)}), {}, {}));
+  ZETASQL_EXPECT_OK(
+      store()->Insert(index_data, Key({String("c"), Int64(3)}), {}, {}));
+  ZETASQL_EXPECT_OK(
+      store()->Insert(index_data, Key({String("c"), Int64(4)}), {}, {}));
+
+  std::vector<WriteOp> ops = {insert("a", 1), insert("b", 2)};
+  ZETASQL_EXPECT_OK(verifier_->VerifyBatch(ctx(), ops));
+
+  // An index key with another entry from outside the batch is a violation.
+  ops = {insert("a", 1), insert("c", 3)};
+  EXPECT_THAT(verifier_->VerifyBatch(ctx(), ops),
+              StatusIs(absl::StatusCode::kAlreadyExists));
+
+  // So are two inserts of the same index key within the batch.
+  ops = {insert("c", 3), insert("c", 4)};
+  EXPECT_THAT(verifier_->VerifyBatch(ctx(), ops),
+              StatusIs(absl::StatusCode::kAlreadyExists));
+
+  // An index key without any entry is an internal error.
+  ops = {insert("a", 1), insert("d", 5)};
+  EXPECT_THAT(verifier_->VerifyBatch(ctx(), ops),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
 }  // namespace
 }  // namespace backend
 }  // namespace emulator
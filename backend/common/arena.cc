@@ -0,0 +1,66 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/common/arena.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+void* Arena::Allocate(size_t size, size_t alignment) {
+  // Blocks come from new[], so their start is suitably aligned for any
+  // supported alignment.
+  if (size > next_block_size_ / 4) {
+    // Large allocations get a block of their own, so that they neither waste
+    // the rest of the current block nor grow the regular blocks.
+    blocks_.emplace_back(new char[size]);
+    bytes_reserved_ += size;
+    return blocks_.back().get();
+  }
+  size_t padding = -reinterpret_cast<uintptr_t>(next_) & (alignment - 1);
+  if (padding + size > remaining_) {
+    blocks_.emplace_back(new char[next_block_size_]);
+    bytes_reserved_ += next_block_size_;
+    next_ = blocks_.back().get();
+    remaining_ = next_block_size_;
+    next_block_size_ = std::min(2 * next_block_size_, kMaxBlockSize);
+    padding = 0;
+  }
+  void* result = next_ + padding;
+  next_ += padding + size;
+  remaining_ -= padding + size;
+  return result;
+}
+
+void Arena::Reset() {
+  blocks_.clear();
+  next_ = nullptr;
+  remaining_ = 0;
+  next_block_size_ = kMinBlockSize;
+  bytes_reserved_ = 0;
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
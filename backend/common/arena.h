@@ -0,0 +1,116 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_COMMON_ARENA_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_COMMON_ARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// Arena hands out memory from a list of blocks which is only released as a
+// whole, by Reset() or on destruction.
+//
+// Allocation bumps a pointer within the current block, so objects with the
+// same lifetime (such as the buffered mutations of a transaction) are
+// allocated without going through the global allocator for each of them.
+// Memory given back to the arena is not reused until it is reset.
+//
+// This class is not thread safe.
+class Arena {
+ public:
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // Returns 'size' bytes aligned to 'alignment', which must be a power of two
+  // no larger than alignof(std::max_align_t).
+  void* Allocate(size_t size, size_t alignment);
+
+  // Releases all memory allocated from the arena.
+  void Reset();
+
+  // Returns the total size of the blocks held by the arena.
+  size_t bytes_reserved() const { return bytes_reserved_; }
+
+ private:
+  // Size of the first block. Subsequent blocks double in size up to
+  // kMaxBlockSize.
+  static constexpr size_t kMinBlockSize = 4 << 10;
+  static constexpr size_t kMaxBlockSize = 1 << 20;
+
+  // Blocks allocated so far.
+  std::vector<std::unique_ptr<char[]>> blocks_;
+
+  // Unused part of the block which regular allocations are served from.
+  char* next_ = nullptr;
+  size_t remaining_ = 0;
+
+  // Size of the next regular block to allocate.
+  size_t next_block_size_ = kMinBlockSize;
+
+  size_t bytes_reserved_ = 0;
+};
+
+// ArenaAllocator is a standard library allocator which allocates from an
+// Arena, for containers whose elements should be released with the arena.
+// The arena must outlive the containers using it.
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+
+  explicit ArenaAllocator(Arena* arena) : arena_(arena) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other)  // NOLINT
+      : arena_(other.arena()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+
+  // Memory is released with the arena.
+  void deallocate(T*, size_t) {}
+
+  Arena* arena() const { return arena_; }
+
+ private:
+  Arena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_COMMON_ARENA_H_
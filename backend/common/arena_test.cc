@@ -0,0 +1,92 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/common/arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+TEST(ArenaTest, ReturnsAlignedNonOverlappingMemory) {
+  Arena arena;
+  std::vector<std::pair<char*, size_t>> allocations;
+  for (size_t size : {1, 3, 8, 17, 2000, 64, 5000, 1}) {
+    for (size_t alignment : {1, 2, 8, 16}) {
+      char* p = static_cast<char*>(arena.Allocate(size, alignment));
+      EXPECT_EQ(0, reinterpret_cast<uintptr_t>(p) % alignment);
+      std::fill(p, p + size, 0x5a);
+      allocations.emplace_back(p, size);
+    }
+  }
+  for (int i = 0; i < allocations.size(); ++i) {
+    for (int j = i + 1; j < allocations.size(); ++j) {
+      const auto& [a, a_size] = allocations[i];
+      const auto& [b, b_size] = allocations[j];
+      EXPECT_TRUE(a + a_size <= b || b + b_size <= a);
+    }
+  }
+}
+
+TEST(ArenaTest, ReleasesAllMemoryOnReset) {
+  Arena arena;
+  for (int i = 0; i < 1000; ++i) {
+    arena.Allocate(100, 8);
+  }
+  arena.Allocate(1 << 20, 8);
+  EXPECT_GE(arena.bytes_reserved(), 1000 * 100 + (1 << 20));
+
+  arena.Reset();
+  EXPECT_EQ(0, arena.bytes_reserved());
+  EXPECT_NE(nullptr, arena.Allocate(100, 8));
+}
+
+TEST(ArenaAllocatorTest, BacksStandardContainers) {
+  Arena arena;
+  using Map = std::map<int, std::string, std::less<int>,
+                       ArenaAllocator<std::pair<const int, std::string>>>;
+  {
+    Map map{ArenaAllocator<std::pair<const int, std::string>>(&arena)};
+    for (int i = 0; i < 100; ++i) {
+      map[i] = std::to_string(i);
+    }
+    map.erase(map.find(50));
+    EXPECT_EQ(99, map.size());
+    EXPECT_EQ("42", map[42]);
+
+    Map moved = std::move(map);
+    EXPECT_EQ(&arena, moved.get_allocator().arena());
+    EXPECT_EQ(99, moved.size());
+  }
+  EXPECT_GT(arena.bytes_reserved(), 0);
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -17,12 +17,14 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_COMMON_CASE_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_COMMON_CASE_H_
 
+#include <cstdint>
 #include <string>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/ascii.h"
 #include "absl/strings/match.h"
+#include "absl/strings/string_view.h"
 
 namespace google {
 namespace spanner {
@@ -54,19 +56,30 @@ namespace backend {
 //       }
 //     }
 //
+// Both function objects are transparent, so lookups may pass an
+// absl::string_view without constructing a std::string, and neither allocates.
+//
 // A hash function object for performing case-insensitive hash on strings.
 struct CaseInsensitiveHash {
-  size_t operator()(const std::string& keyval) const {
-    std::string s = keyval;
-    absl::AsciiStrToLower(&s);
-    return std::hash<std::string>()(s);
+  using is_transparent = void;
+
+  size_t operator()(absl::string_view keyval) const {
+    // 64-bit FNV-1a over the lower-cased characters.
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : keyval) {
+      hash ^= static_cast<unsigned char>(absl::ascii_tolower(c));
+      hash *= 1099511628211ULL;
+    }
+    return static_cast<size_t>(hash);
   }
 };
 
 // A comparator function object for performing case-insensitive equal
 // comparison on strings.
 struct CaseInsensitiveEqual {
-  bool operator()(const std::string& left, const std::string& right) const {
+  using is_transparent = void;
+
+  bool operator()(absl::string_view left, absl::string_view right) const {
     return absl::EqualsIgnoreCase(left, right);
   }
 };
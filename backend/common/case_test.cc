@@ -21,6 +21,7 @@
 #include "zetasql/base/testing/status_matchers.h"
 #include "tests/common/proto_matchers.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
 
 namespace google {
 namespace spanner {
@@ -42,6 +43,17 @@ TEST(CaseTest, CaseInsensitiveHashContainer) {
   EXPECT_NE(*hash_set.begin(), "MY-TEST");
 }
 
+TEST(CaseTest, CaseInsensitiveLookupByStringView) {
+  CaseInsensitiveStringMap<int> hash_map;
+  hash_map["My-Test"] = 1;
+
+  absl::string_view key = "prefix-my-TEST";
+  EXPECT_TRUE(hash_map.contains(key.substr(7)));
+  EXPECT_FALSE(hash_map.contains(key));
+  EXPECT_EQ(CaseInsensitiveHash()(key.substr(7)),
+            CaseInsensitiveHash()(std::string("MY-TEST")));
+}
+
 }  // namespace
 }  // namespace backend
 }  // namespace emulator
@@ -17,20 +17,26 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_COMMON_IDS_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_COMMON_IDS_H_
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <string>
 
-#include "absl/base/thread_annotations.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
-#include "absl/synchronization/mutex.h"
 
 namespace google {
 namespace spanner {
 namespace emulator {
 namespace backend {
 
+// Generates unique IDs from a sequence number.
+//
+// This class is thread safe and lock free: IDs are allocated with a single
+// atomic increment, so concurrent transactions and schema changes of a database
+// never wait on each other to get an ID. IDs are unique but, when generated
+// concurrently, may be returned out of order.
 template <typename IdType>
 class UniqueIdGenerator {
  public:
@@ -38,20 +44,33 @@ class UniqueIdGenerator {
   explicit UniqueIdGenerator(int64_t starting_seq) : next_seq_(starting_seq) {}
 
   // Generate the next unique ID.
-  IdType NextId(absl::string_view prefix) ABSL_LOCKS_EXCLUDED(mu_) {
-    absl::MutexLock lock(&mu_);
-    return IdType{absl::StrCat(prefix, ":", next_seq_++)};
+  IdType NextId(absl::string_view prefix) {
+    return IdType{absl::StrCat(prefix, ":", NextSeq())};
   }
 
   // Generate the next unique ID.
-  IdType NextId() ABSL_LOCKS_EXCLUDED(mu_) {
-    absl::MutexLock lock(&mu_);
-    return IdType{next_seq_++};
+  IdType NextId() { return IdType{NextSeq()}; }
+
+  // Continues generating IDs after those generated so far by `other`, so that
+  // the IDs of objects shared between two databases never collide with those
+  // generated afterwards by either.
+  void ContinueFrom(const UniqueIdGenerator& other) {
+    const int64_t next_seq = other.next_seq_.load(std::memory_order_relaxed);
+    int64_t current = next_seq_.load(std::memory_order_relaxed);
+    while (current < next_seq &&
+           !next_seq_.compare_exchange_weak(current, next_seq,
+                                            std::memory_order_relaxed)) {
+    }
   }
 
  private:
-  absl::Mutex mu_;
-  int64_t next_seq_ ABSL_GUARDED_BY(mu_);
+  // Returns the next sequence number. Only uniqueness matters, so no ordering
+  // with other memory operations is needed.
+  int64_t NextSeq() {
+    return next_seq_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::atomic<int64_t> next_seq_;
 };
 
 // Unique identifier associated with a table. TableID is guaranteed to be unique
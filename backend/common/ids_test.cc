@@ -55,6 +55,46 @@ TEST(UniqueIdGeneratorTest, basic) {
   EXPECT_EQ(id_generator.NextId("my-table"), "my-table:101");
 }
 
+TEST(UniqueIdGeneratorTest, TransactionIdsAreUniqueAcrossThreads) {
+  constexpr int kNumThreads = 8;
+  constexpr int kIdsPerThread = 1000;
+  TransactionIDGenerator id_generator(1);
+  std::vector<std::vector<TransactionID>> ids(kNumThreads);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&id_generator, &ids, i]() {
+      for (int j = 0; j < kIdsPerThread; ++j) {
+        ids[i].push_back(id_generator.NextId());
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  std::unordered_set<TransactionID> id_set;
+  for (const std::vector<TransactionID>& thread_ids : ids) {
+    id_set.insert(thread_ids.begin(), thread_ids.end());
+  }
+  EXPECT_EQ(id_set.size(), kNumThreads * kIdsPerThread);
+  EXPECT_EQ(id_generator.NextId(), kNumThreads * kIdsPerThread + 1);
+}
+
+TEST(UniqueIdGeneratorTest, ContinueFrom) {
+  UniqueIdGenerator<std::string> id_generator;
+  id_generator.NextId("t");
+  id_generator.NextId("t");
+
+  UniqueIdGenerator<std::string> continued;
+  continued.ContinueFrom(id_generator);
+  EXPECT_EQ(continued.NextId("t"), "t:2");
+
+  // A generator never moves back to IDs it has already generated.
+  UniqueIdGenerator<std::string> unused;
+  continued.ContinueFrom(unused);
+  EXPECT_EQ(continued.NextId("t"), "t:3");
+}
+
 }  // namespace
 }  // namespace backend
 }  // namespace emulator
@@ -0,0 +1,255 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/common/sorted_run.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/base/statusor.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "common/errors.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// Size of each of the two length fields framing a record.
+constexpr int64_t kLengthSizeBytes = sizeof(uint32_t);
+
+// Bytes of records buffered by a writer before they are written to the file.
+constexpr int64_t kWriteBufferBytes = 1 << 20;
+
+// Minimum number of bytes read ahead by an iterator.
+constexpr int64_t kReadAheadBytes = 64 << 10;
+
+void AppendLength(uint32_t length, std::string* data) {
+  for (int i = 0; i < kLengthSizeBytes; ++i) {
+    data->push_back(static_cast<char>((length >> (8 * i)) & 0xff));
+  }
+}
+
+uint32_t ReadLength(const char* data) {
+  uint32_t length = 0;
+  for (int i = 0; i < kLengthSizeBytes; ++i) {
+    length |= static_cast<uint32_t>(static_cast<unsigned char>(data[i]))
+              << (8 * i);
+  }
+  return length;
+}
+
+std::string TemporaryDirectory() {
+  const char* directory = std::getenv("TMPDIR");
+  return directory != nullptr && *directory != '\0' ? directory : "/tmp";
+}
+
+}  // namespace
+
+zetasql_base::StatusOr<std::unique_ptr<SortedRun::Writer>>
+SortedRun::Writer::Create(const std::string& directory) {
+  std::string path =
+      absl::StrCat(directory.empty() ? TemporaryDirectory() : directory,
+                   "/spanner_emulator_spill_XXXXXX");
+  int fd = mkstemp(&path[0]);
+  if (fd < 0) {
+    return error::SpillFileIOError(path, "create", std::strerror(errno));
+  }
+  // The file is only reachable through the descriptor from now on, so it is
+  // removed once closed, even if the process exits abruptly.
+  if (unlink(path.c_str()) != 0) {
+    absl::Status status =
+        error::SpillFileIOError(path, "unlink", std::strerror(errno));
+    close(fd);
+    return status;
+  }
+  return absl::WrapUnique(new Writer(std::move(path), fd));
+}
+
+SortedRun::Writer::~Writer() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+absl::Status SortedRun::Writer::Add(absl::string_view key,
+                                    absl::string_view value) {
+  if (num_records_ > 0 && key < last_key_) {
+    return error::Internal(
+        absl::StrCat("Records of a sorted run must be added in key order, "
+                     "but key ", key, " follows ", last_key_));
+  }
+  if (num_records_ % kIndexInterval == 0) {
+    index_.emplace_back(std::string(key), size_);
+  }
+  last_key_.assign(key.data(), key.size());
+  AppendLength(key.size(), &buffer_);
+  AppendLength(value.size(), &buffer_);
+  buffer_.append(key.data(), key.size());
+  buffer_.append(value.data(), value.size());
+  size_ += 2 * kLengthSizeBytes + key.size() + value.size();
+  ++num_records_;
+  if (buffer_.size() >= kWriteBufferBytes) {
+    return Flush();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status SortedRun::Writer::Flush() {
+  const char* data = buffer_.data();
+  size_t remaining = buffer_.size();
+  while (remaining > 0) {
+    ssize_t written = write(fd_, data, remaining);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return error::SpillFileIOError(path_, "write", std::strerror(errno));
+    }
+    data += written;
+    remaining -= written;
+  }
+  buffer_.clear();
+  return absl::OkStatus();
+}
+
+zetasql_base::StatusOr<std::unique_ptr<SortedRun>> SortedRun::Writer::Finish() {
+  ZETASQL_RETURN_IF_ERROR(Flush());
+  int fd = fd_;
+  fd_ = -1;
+  return absl::WrapUnique(new SortedRun(std::move(path_), fd, size_,
+                                        num_records_, std::move(index_)));
+}
+
+SortedRun::~SortedRun() { close(fd_); }
+
+absl::Status SortedRun::ReadAt(int64_t offset, int64_t size,
+                               std::string* data) const {
+  const size_t start = data->size();
+  data->resize(start + size);
+  int64_t done = 0;
+  while (done < size) {
+    ssize_t read = pread(fd_, &(*data)[start + done], size - done,
+                         offset + done);
+    if (read < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return error::SpillFileIOError(path_, "read", std::strerror(errno));
+    }
+    if (read == 0) {
+      return error::SpillFileIOError(path_, "read", "unexpected end of file");
+    }
+    done += read;
+  }
+  return absl::OkStatus();
+}
+
+std::unique_ptr<SortedRun::Iterator> SortedRun::Seek(
+    absl::string_view key) const {
+  // Start from the last indexed record with a smaller key, since records with
+  // the key may precede the first indexed one.
+  auto itr = std::lower_bound(
+      index_.begin(), index_.end(), key,
+      [](const std::pair<std::string, int64_t>& entry, absl::string_view key) {
+        return entry.first < key;
+      });
+  const int64_t offset = itr == index_.begin() ? 0 : std::prev(itr)->second;
+  return absl::WrapUnique(new Iterator(this, offset, std::string(key)));
+}
+
+zetasql_base::StatusOr<bool> SortedRun::Find(absl::string_view key,
+                                             std::string* value) const {
+  std::unique_ptr<Iterator> itr = Seek(key);
+  if (!itr->Next()) {
+    ZETASQL_RETURN_IF_ERROR(itr->Status());
+    return false;
+  }
+  if (itr->key() != key) {
+    return false;
+  }
+  value->assign(itr->value().data(), itr->value().size());
+  return true;
+}
+
+bool SortedRun::Iterator::Fill(int64_t size) {
+  const int64_t buffered_end = buffer_offset_ + buffer_.size();
+  if (offset_ + size <= buffered_end) {
+    return true;
+  }
+  // Drop the records consumed so far and read ahead past the record.
+  buffer_.erase(0, std::min<int64_t>(offset_ - buffer_offset_, buffer_.size()));
+  buffer_offset_ = offset_;
+  const int64_t read_size =
+      std::min(std::max(size - static_cast<int64_t>(buffer_.size()),
+                        kReadAheadBytes),
+               run_->size_ - buffer_offset_ -
+                   static_cast<int64_t>(buffer_.size()));
+  status_ = run_->ReadAt(buffer_offset_ + buffer_.size(), read_size, &buffer_);
+  const int64_t buffered_size = buffer_.size();
+  return status_.ok() && offset_ + size <= buffer_offset_ + buffered_size;
+}
+
+bool SortedRun::Iterator::Next() {
+  while (status_.ok() && offset_ < run_->size_) {
+    if (!Fill(2 * kLengthSizeBytes)) {
+      break;
+    }
+    const char* header = buffer_.data() + (offset_ - buffer_offset_);
+    const int64_t key_size = ReadLength(header);
+    const int64_t value_size = ReadLength(header + kLengthSizeBytes);
+    const int64_t record_size = 2 * kLengthSizeBytes + key_size + value_size;
+    if (!Fill(record_size)) {
+      break;
+    }
+    const char* record = buffer_.data() + (offset_ - buffer_offset_);
+    offset_ += record_size;
+    absl::string_view key(record + 2 * kLengthSizeBytes, key_size);
+    if (key < start_key_) {
+      continue;
+    }
+    start_key_.clear();
+    key_.assign(key.data(), key.size());
+    value_.assign(record + 2 * kLengthSizeBytes + key_size, value_size);
+    return true;
+  }
+  if (status_.ok() && offset_ < run_->size_) {
+    status_ = error::SpillFileIOError(run_->path_, "read", "truncated record");
+  }
+  return false;
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,172 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_COMMON_SORTED_RUN_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_COMMON_SORTED_RUN_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/status/status.h"
+#include "zetasql/base/statusor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// SortedRun is an immutable sequence of key-value records sorted by key, held
+// in a temporary file rather than in memory. It is used to spill data which
+// outgrows its memory budget, such as the mutations buffered by a very large
+// transaction, with lookups and ordered scans reading the records back.
+//
+// Runs are written once by a SortedRun::Writer. The file is unlinked as soon
+// as it is created, so it never outlives the process, and its disk space is
+// released once the run is destroyed. Every kIndexInterval-th key is kept in
+// memory along with the offset of its record, so a lookup reads a single span
+// of at most kIndexInterval records.
+//
+// Records are framed as the sizes of the key and of the value, followed by
+// the key and the value. Keys compare bytewise, and may repeat.
+//
+// This class is thread-compatible: const methods may be called concurrently.
+class SortedRun {
+ public:
+  // Number of records between the keys kept in memory.
+  static constexpr int kIndexInterval = 64;
+
+  // Writer appends the records of a run in key order.
+  class Writer {
+   public:
+    // Returns a writer of a run held in a new temporary file within
+    // `directory`, or within the system's temporary directory if empty.
+    static zetasql_base::StatusOr<std::unique_ptr<Writer>> Create(
+        const std::string& directory);
+
+    ~Writer();
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    // Appends a record. Keys must be added in non-decreasing order.
+    absl::Status Add(absl::string_view key, absl::string_view value);
+
+    // Returns the run of the records added so far. The writer must not be
+    // used afterwards.
+    zetasql_base::StatusOr<std::unique_ptr<SortedRun>> Finish();
+
+   private:
+    Writer(std::string path, int fd) : path_(std::move(path)), fd_(fd) {}
+
+    // Writes the buffered records to the file.
+    absl::Status Flush();
+
+    std::string path_;
+    int fd_;
+
+    // Records not written to the file yet.
+    std::string buffer_;
+
+    // Offset of the end of the records written or buffered so far.
+    int64_t size_ = 0;
+
+    int64_t num_records_ = 0;
+    std::string last_key_;
+    std::vector<std::pair<std::string, int64_t>> index_;
+  };
+
+  // Iterator yields the records of a run in key order.
+  class Iterator {
+   public:
+    // Advances to the next record. Returns false once there is none, or if
+    // reading failed, which is reported by Status().
+    bool Next();
+
+    absl::Status Status() const { return status_; }
+    absl::string_view key() const { return key_; }
+    absl::string_view value() const { return value_; }
+
+   private:
+    friend class SortedRun;
+    Iterator(const SortedRun* run, int64_t offset, std::string start_key)
+        : run_(run), offset_(offset), start_key_(std::move(start_key)) {}
+
+    // Ensures that `size` bytes past offset_ are buffered.
+    bool Fill(int64_t size);
+
+    const SortedRun* run_;
+
+    // Offset of the next record within the file.
+    int64_t offset_;
+
+    // Records with keys less than this one are skipped.
+    std::string start_key_;
+
+    // Bytes of the file read ahead from buffer_offset_.
+    std::string buffer_;
+    int64_t buffer_offset_ = 0;
+
+    std::string key_;
+    std::string value_;
+    absl::Status status_;
+  };
+
+  ~SortedRun();
+  SortedRun(const SortedRun&) = delete;
+  SortedRun& operator=(const SortedRun&) = delete;
+
+  // Returns an iterator positioned before the first record whose key is not
+  // less than `key`.
+  std::unique_ptr<Iterator> Seek(absl::string_view key) const;
+
+  // Looks up the first record with the given key, storing its value in
+  // `value`. Returns false if there is none.
+  zetasql_base::StatusOr<bool> Find(absl::string_view key,
+                                    std::string* value) const;
+
+  int64_t num_records() const { return num_records_; }
+  int64_t size_bytes() const { return size_; }
+
+ private:
+  SortedRun(std::string path, int fd, int64_t size, int64_t num_records,
+            std::vector<std::pair<std::string, int64_t>> index)
+      : path_(std::move(path)),
+        fd_(fd),
+        size_(size),
+        num_records_(num_records),
+        index_(std::move(index)) {}
+
+  // Reads `size` bytes at `offset` of the file, appending them to `data`.
+  absl::Status ReadAt(int64_t offset, int64_t size, std::string* data) const;
+
+  std::string path_;
+  int fd_;
+  int64_t size_;
+  int64_t num_records_;
+
+  // Keys of every kIndexInterval-th record, with the offsets of the records.
+  std::vector<std::pair<std::string, int64_t>> index_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_COMMON_SORTED_RUN_H_
@@ -0,0 +1,129 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/common/sorted_run.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+// Returns the key of the i-th record of test runs, in increasing order.
+std::string TestKey(int i) { return absl::StrFormat("key-%06d", i); }
+
+std::unique_ptr<SortedRun> WriteRun(int num_records) {
+  auto writer = SortedRun::Writer::Create("");
+  EXPECT_TRUE(writer.ok());
+  for (int i = 0; i < num_records; ++i) {
+    EXPECT_TRUE((*writer)->Add(TestKey(i), absl::StrCat("value-", i)).ok());
+  }
+  auto run = (*writer)->Finish();
+  EXPECT_TRUE(run.ok());
+  return std::move(run).value();
+}
+
+TEST(SortedRunTest, IteratesRecordsInOrder) {
+  std::unique_ptr<SortedRun> run = WriteRun(1000);
+  EXPECT_EQ(run->num_records(), 1000);
+
+  std::unique_ptr<SortedRun::Iterator> itr = run->Seek("");
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_TRUE(itr->Next());
+    EXPECT_EQ(itr->key(), TestKey(i));
+    EXPECT_EQ(itr->value(), absl::StrCat("value-", i));
+  }
+  EXPECT_FALSE(itr->Next());
+  ZETASQL_EXPECT_OK(itr->Status());
+}
+
+TEST(SortedRunTest, SeeksToFirstRecordNotLessThanKey) {
+  std::unique_ptr<SortedRun> run = WriteRun(1000);
+  for (int i : {0, 1, 63, 64, 65, 500, 999}) {
+    std::unique_ptr<SortedRun::Iterator> itr = run->Seek(TestKey(i));
+    ASSERT_TRUE(itr->Next());
+    EXPECT_EQ(itr->key(), TestKey(i));
+  }
+
+  // Keys between records seek to the next record.
+  std::unique_ptr<SortedRun::Iterator> itr =
+      run->Seek(absl::StrCat(TestKey(127), "x"));
+  ASSERT_TRUE(itr->Next());
+  EXPECT_EQ(itr->key(), TestKey(128));
+
+  EXPECT_FALSE(run->Seek("zzz")->Next());
+}
+
+TEST(SortedRunTest, FindsRecordsByKey) {
+  std::unique_ptr<SortedRun> run = WriteRun(300);
+  std::string value;
+  for (int i = 0; i < 300; i += 7) {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(bool found, run->Find(TestKey(i), &value));
+    EXPECT_TRUE(found);
+    EXPECT_EQ(value, absl::StrCat("value-", i));
+  }
+  ZETASQL_ASSERT_OK_AND_ASSIGN(bool found, run->Find("key-missing", &value));
+  EXPECT_FALSE(found);
+}
+
+TEST(SortedRunTest, HoldsRecordsLargerThanTheReadAhead) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<SortedRun::Writer> writer,
+                       SortedRun::Writer::Create(""));
+  const std::string large_value(3 << 20, 'v');
+  ZETASQL_EXPECT_OK(writer->Add("a", "small"));
+  ZETASQL_EXPECT_OK(writer->Add("b", large_value));
+  ZETASQL_EXPECT_OK(writer->Add("c", ""));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<SortedRun> run,
+                       writer->Finish());
+
+  std::unique_ptr<SortedRun::Iterator> itr = run->Seek("");
+  ASSERT_TRUE(itr->Next());
+  EXPECT_EQ(itr->value(), "small");
+  ASSERT_TRUE(itr->Next());
+  EXPECT_EQ(itr->value(), large_value);
+  ASSERT_TRUE(itr->Next());
+  EXPECT_EQ(itr->key(), "c");
+  EXPECT_EQ(itr->value(), "");
+  EXPECT_FALSE(itr->Next());
+}
+
+TEST(SortedRunTest, RejectsRecordsOutOfOrder) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<SortedRun::Writer> writer,
+                       SortedRun::Writer::Create(""));
+  ZETASQL_EXPECT_OK(writer->Add("b", ""));
+  ZETASQL_EXPECT_OK(writer->Add("b", ""));
+  EXPECT_FALSE(writer->Add("a", "").ok());
+}
+
+TEST(SortedRunTest, FailsToCreateRunsInMissingDirectories) {
+  EXPECT_FALSE(SortedRun::Writer::Create("/nonexistent/directory").ok());
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
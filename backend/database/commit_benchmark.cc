@@ -0,0 +1,332 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Measures the cost of writing and committing mutations in read-write
+// transactions, for parameterized workloads: each commit inserts --rows new
+// rows into a table with --indexes secondary indexes, which is either a plain
+// table, interleaved beneath ancestor tables, or referencing another table by
+// a foreign key.
+//
+// The time of each commit is split into the stages of processing its mutation
+// (resolve, flatten, validate, effect, buffer and verify) and flushing it to
+// storage, as recorded by their stage latency metrics. The remainder is spent
+// building the mutation, creating the transaction and locking.
+//
+// Given a baseline saved from an earlier run with --benchmark_format=json, the
+// benchmark exits with an error if any case got slower than
+// --benchmark_max_regression allows, so that it can gate changes to the commit
+// path.
+//
+// Usage: commit_benchmark [--rows=1,100,1000] [--indexes=0,1,4]
+//            [--benchmark_format=table|json] [--benchmark_min_time=500ms]
+//            [--benchmark_filter=...] [--benchmark_baseline=results.json]
+//            [--benchmark_max_regression=0.1]
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "zetasql/public/value.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "zetasql/base/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "backend/access/write.h"
+#include "backend/database/database.h"
+#include "backend/transaction/options.h"
+#include "backend/transaction/read_write_transaction.h"
+#include "common/benchmark.h"
+#include "common/metrics.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+ABSL_FLAG(std::vector<std::string>, rows, {"1", "100", "1000"},
+          "Comma-separated numbers of rows inserted by each commit.");
+ABSL_FLAG(std::vector<std::string>, indexes, {"0", "1", "4"},
+          "Comma-separated numbers of secondary indexes of the table written.");
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql::values::Int64;
+
+// Number of non-key columns of the table written, each of which may be
+// indexed.
+constexpr int kNumValueColumns = 4;
+
+// Number of rows of the table referenced by the foreign key workload.
+constexpr int kNumReferencedRows = 1000;
+
+// Stages between which the time of commits is split.
+constexpr const char* kStages[] = {
+    "mutation_resolve", "mutation_flatten", "mutation_validate",
+    "mutation_effect",  "mutation_buffer",  "mutation_verify",
+    "commit_flush",
+};
+
+// A table written by the benchmark, along with the schema it is part of.
+struct Workload {
+  std::string name;
+  std::vector<std::string> schema;
+
+  // Rows committed before the benchmark, such as the ancestors of the rows
+  // inserted into an interleaved table.
+  Mutation setup;
+
+  std::string table;
+
+  // The key columns of the table. Rows inserted have their last key column
+  // set to increasing values, and any other key columns set to 0.
+  std::vector<std::string> key_columns;
+
+  // True if the table has a column `r` referencing the rows of a table R.
+  bool references = false;
+};
+
+std::string ValueColumnDefinitions() {
+  std::string definitions;
+  for (int i = 0; i < kNumValueColumns; ++i) {
+    absl::StrAppend(&definitions, ", c", i, " INT64");
+  }
+  return definitions;
+}
+
+void AddIndexes(int num_indexes, Workload* workload) {
+  for (int i = 0; i < num_indexes; ++i) {
+    workload->schema.push_back(absl::StrCat("CREATE INDEX ", workload->table,
+                                            "ByC", i, " ON ", workload->table,
+                                            "(c", i, ")"));
+  }
+}
+
+Workload PlainWorkload(int num_indexes) {
+  Workload workload;
+  workload.name = "plain";
+  workload.table = "T";
+  workload.key_columns = {"k"};
+  workload.schema = {absl::StrCat("CREATE TABLE T(k INT64",
+                                  ValueColumnDefinitions(),
+                                  ") PRIMARY KEY(k)")};
+  AddIndexes(num_indexes, &workload);
+  return workload;
+}
+
+// Rows are inserted into the table at `depth` levels of interleaving beneath
+// a single row of each ancestor table.
+Workload InterleavedWorkload(int depth, int num_indexes) {
+  Workload workload;
+  workload.name = absl::StrCat("interleaved/depth:", depth);
+  std::string key_definitions;
+  std::string primary_key;
+  for (int level = 0; level <= depth; ++level) {
+    const std::string key_column = absl::StrCat("k", level);
+    workload.key_columns.push_back(key_column);
+    absl::StrAppend(&key_definitions, level == 0 ? "" : ", ", key_column,
+                    " INT64");
+    absl::StrAppend(&primary_key, level == 0 ? "" : ", ", key_column);
+    workload.table = absl::StrCat("L", level);
+    workload.schema.push_back(absl::StrCat(
+        "CREATE TABLE ", workload.table, "(", key_definitions,
+        level == depth ? ValueColumnDefinitions() : "", ") PRIMARY KEY(",
+        primary_key, ")",
+        level == 0 ? "" : absl::StrCat(", INTERLEAVE IN PARENT L", level - 1)));
+    if (level < depth) {
+      workload.setup.AddWriteOp(
+          MutationOpType::kInsert, workload.table, workload.key_columns,
+          {ValueList(workload.key_columns.size(), Int64(0))});
+    }
+  }
+  AddIndexes(num_indexes, &workload);
+  return workload;
+}
+
+Workload ForeignKeyWorkload(int num_indexes) {
+  Workload workload;
+  workload.name = "foreign_key";
+  workload.table = "T";
+  workload.key_columns = {"k"};
+  workload.references = true;
+  workload.schema = {
+      "CREATE TABLE R(r INT64) PRIMARY KEY(r)",
+      absl::StrCat("CREATE TABLE T(k INT64", ValueColumnDefinitions(),
+                   ", r INT64, FOREIGN KEY(r) REFERENCES R(r)) "
+                   "PRIMARY KEY(k)"),
+  };
+  std::vector<ValueList> referenced_rows;
+  for (int i = 0; i < kNumReferencedRows; ++i) {
+    referenced_rows.push_back({Int64(i)});
+  }
+  workload.setup.AddWriteOp(MutationOpType::kInsert, "R", {"r"},
+                            std::move(referenced_rows));
+  AddIndexes(num_indexes, &workload);
+  return workload;
+}
+
+// Returns a mutation inserting `num_rows` new rows into the workload's table,
+// whose keys start at `*next_key`, and advances `*next_key` past them.
+Mutation MakeInserts(const Workload& workload, int num_rows,
+                     int64_t* next_key) {
+  std::vector<std::string> columns = workload.key_columns;
+  for (int i = 0; i < kNumValueColumns; ++i) {
+    columns.push_back(absl::StrCat("c", i));
+  }
+  if (workload.references) {
+    columns.push_back("r");
+  }
+  std::vector<ValueList> rows;
+  for (int i = 0; i < num_rows; ++i) {
+    const int64_t key = (*next_key)++;
+    ValueList row(workload.key_columns.size() - 1, Int64(0));
+    row.push_back(Int64(key));
+    for (int j = 0; j < kNumValueColumns; ++j) {
+      row.push_back(Int64(key * kNumValueColumns + j));
+    }
+    if (workload.references) {
+      row.push_back(Int64(key % kNumReferencedRows));
+    }
+    rows.push_back(std::move(row));
+  }
+  Mutation mutation;
+  mutation.AddWriteOp(MutationOpType::kInsert, workload.table, columns,
+                      std::move(rows));
+  return mutation;
+}
+
+absl::Status Commit(Database* database, const Mutation& mutation) {
+  ZETASQL_ASSIGN_OR_RETURN(
+      std::unique_ptr<ReadWriteTransaction> txn,
+      database->CreateReadWriteTransaction(ReadWriteOptions(), RetryState()));
+  ZETASQL_RETURN_IF_ERROR(txn->Write(mutation));
+  return txn->Commit();
+}
+
+// Returns the total time recorded so far in each stage of commits.
+std::vector<absl::Duration> StageTimes() {
+  std::vector<absl::Duration> times;
+  for (const char* stage : kStages) {
+    times.push_back(metrics::StageLatency(stage)->sum());
+  }
+  return times;
+}
+
+// Commits inserts of `num_rows` rows into the workload's table, in a database
+// created for the workload, and reports the time spent in each stage.
+absl::Status RunWorkload(BenchmarkRunner* runner, const Workload& workload,
+                         int num_rows, int num_indexes) {
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<Database> database,
+                   Database::Create(workload.schema));
+  if (!workload.setup.ops().empty()) {
+    ZETASQL_RETURN_IF_ERROR(Commit(database.get(), workload.setup));
+  }
+
+  const std::string name =
+      absl::StrCat("Commit/", workload.name, "/rows:", num_rows,
+                   "/indexes:", num_indexes);
+  int64_t next_key = 0;
+  int64_t total_iterations = 0;
+  absl::Status status;
+  const std::vector<absl::Duration> start_times = StageTimes();
+  bool ran = runner->Run(name, [&](int64_t iterations) {
+    for (int64_t i = 0; i < iterations && status.ok(); ++i) {
+      status = Commit(database.get(),
+                      MakeInserts(workload, num_rows, &next_key));
+      ++total_iterations;
+    }
+  });
+  ZETASQL_RETURN_IF_ERROR(status);
+  if (!ran) {
+    return absl::OkStatus();
+  }
+  const std::vector<absl::Duration> end_times = StageTimes();
+  for (int i = 0; i < end_times.size(); ++i) {
+    runner->AddBreakdown(kStages[i],
+                         (end_times[i] - start_times[i]) / total_iterations);
+  }
+  return absl::OkStatus();
+}
+
+// Parses a comma-separated list flag of non-negative numbers.
+zetasql_base::StatusOr<std::vector<int>> ParseCounts(
+    const std::vector<std::string>& values, const std::string& flag) {
+  std::vector<int> counts;
+  for (const std::string& value : values) {
+    int count;
+    if (!absl::SimpleAtoi(value, &count) || count < 0) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid --", flag, " value: ", value));
+    }
+    counts.push_back(count);
+  }
+  return counts;
+}
+
+// Runs the benchmark, and returns an error if it failed or if a case regressed
+// from the baseline.
+absl::Status RunBenchmark() {
+  // The stages of commits are only timed while metrics are enabled.
+  metrics::SetEnabled(true);
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<int> row_counts,
+                   ParseCounts(absl::GetFlag(FLAGS_rows), "rows"));
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<int> index_counts,
+                   ParseCounts(absl::GetFlag(FLAGS_indexes), "indexes"));
+  BenchmarkRunner runner;
+  for (int num_indexes : index_counts) {
+    if (num_indexes > kNumValueColumns) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("At most ", kNumValueColumns, " indexes are supported"));
+    }
+    const std::vector<Workload> workloads = {
+        PlainWorkload(num_indexes),
+        InterleavedWorkload(/*depth=*/1, num_indexes),
+        InterleavedWorkload(/*depth=*/3, num_indexes),
+        ForeignKeyWorkload(num_indexes),
+    };
+    for (const Workload& workload : workloads) {
+      for (int num_rows : row_counts) {
+        ZETASQL_RETURN_IF_ERROR(
+            RunWorkload(&runner, workload, num_rows, num_indexes));
+      }
+    }
+  }
+  runner.Report();
+  if (!runner.CheckBaseline()) {
+    return absl::FailedPreconditionError("Regressed from the baseline");
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  absl::Status status = google::spanner::emulator::backend::RunBenchmark();
+  if (!status.ok()) {
+    std::fprintf(stderr, "%s\n", status.ToString().c_str());
+    return 1;
+  }
+  return 0;
+}
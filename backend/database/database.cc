@@ -16,8 +16,20 @@
 
 #include "backend/database/database.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "zetasql/public/value.h"
+#include "zetasql/public/value.pb.h"
+#include "google/protobuf/repeated_field.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/memory/memory.h"
 #include "zetasql/base/statusor.h"
 #include "absl/strings/match.h"
@@ -25,19 +37,51 @@
 #include "absl/strings/string_view.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "absl/types/variant.h"
+#include "backend/access/read.h"
+#include "backend/actions/column_value.h"
 #include "backend/actions/manager.h"
+#include "backend/actions/ops.h"
 #include "backend/common/ids.h"
+#include "backend/common/rows.h"
+#include "backend/database/snapshot.h"
+#include "backend/database/snapshot.pb.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/datamodel/key_set.h"
+#include "backend/locking/handle.h"
 #include "backend/locking/manager.h"
 #include "backend/locking/request.h"
 #include "backend/query/query_engine.h"
+#include "backend/schema/backfills/index_backfill.h"
+#include "backend/schema/catalog/column.h"
+#include "backend/schema/catalog/foreign_key.h"
+#include "backend/schema/catalog/index.h"
+#include "backend/schema/catalog/schema.h"
+#include "backend/schema/catalog/schema_diff.h"
+#include "backend/schema/catalog/table.h"
 #include "backend/schema/catalog/versioned_catalog.h"
 #include "backend/schema/printer/print_ddl.h"
 #include "backend/schema/updater/schema_updater.h"
+#include "backend/schema/updater/schema_validation_context.h"
 #include "backend/schema/updater/scoped_schema_change_lock.h"
+#include "backend/schema/verifiers/foreign_key_verifiers.h"
 #include "backend/storage/in_memory_storage.h"
+#include "backend/storage/iterator.h"
+#include "backend/storage/parallel_scan.h"
+#include "backend/storage/staged_storage.h"
+#include "backend/storage/storage.h"
 #include "backend/transaction/actions.h"
+#include "backend/transaction/commit_log.h"
+#include "backend/transaction/commit_log.pb.h"
+#include "backend/transaction/flush.h"
 #include "backend/transaction/options.h"
+#include "common/clock.h"
+#include "common/config.h"
+#include "common/errors.h"
+#include "zetasql/base/ret_check.h"
 #include "absl/status/status.h"
 #include "zetasql/base/status_macros.h"
 
@@ -46,20 +90,483 @@ namespace spanner {
 namespace emulator {
 namespace backend {
 
+namespace {
+
+// Interval between garbage collection runs of old data versions.
+constexpr absl::Duration kGarbageCollectionInterval = absl::Minutes(1);
+
+// Maximum number of rows in each SnapshotRows record.
+constexpr int kSnapshotRowsPerRecord = 1000;
+
+// Number of rows in each key range of a partitioned DML statement, which are
+// modified by a single transaction.
+constexpr int64_t kRowsPerPartitionedDmlRange = 16 * 1024;
+
+// Maximum number of threads executing a single partitioned DML statement.
+constexpr int kMaxPartitionedDmlThreads = 8;
+
+// Maximum number of attempts at committing one partition of a partitioned DML
+// statement which keeps being aborted by conflicting transactions.
+constexpr int kMaxPartitionedDmlAttempts = 16;
+
+// Maximum number of tables of a database exported at once.
+constexpr int kMaxExportThreads = 8;
+
+// Maximum number of attempts at acquiring the lock of a schema change whose
+// backfills ran while read-write transactions were still committing, and the
+// delay before each retry, which grows with the attempts.
+constexpr int kMaxSchemaChangeLockAttempts = 8;
+constexpr absl::Duration kSchemaChangeLockRetryDelay = absl::Milliseconds(5);
+
+// Returns the IDs of the tables and index data tables of `schema`, whose rows
+// the storage of the database holds.
+absl::flat_hash_set<TableID> StorageTableIds(const Schema* schema) {
+  absl::flat_hash_set<TableID> table_ids;
+  for (const Table* table : schema->tables()) {
+    table_ids.insert(table->id());
+    for (const Index* index : table->indexes()) {
+      table_ids.insert(index->index_data_table()->id());
+    }
+  }
+  return table_ids;
+}
+
+// Appends the rows of `table` visible at `timestamp` to a snapshot. `name` and
+// `is_index` identify the table (or index) the rows are loaded into.
+absl::Status WriteTableSnapshot(const Table* table, const std::string& name,
+                                bool is_index, absl::Time timestamp,
+                                const Storage* storage,
+                                SnapshotWriter* writer) {
+  SnapshotRows record;
+  auto reset_record = [&]() {
+    record.Clear();
+    record.set_table_name(name);
+    record.set_is_index(is_index);
+    for (const Column* column : table->columns()) {
+      record.add_column_names(column->Name());
+    }
+  };
+  reset_record();
+
+  std::unique_ptr<StorageIterator> itr;
+  ZETASQL_RETURN_IF_ERROR(storage->Read(timestamp, table->id(), KeyRange::All(),
+                                GetColumnIDs(table->columns()), &itr));
+  while (itr->Next()) {
+    SnapshotRows::Row* row = record.add_rows();
+    for (const zetasql::Value& value : itr->Key().column_values()) {
+      ZETASQL_RETURN_IF_ERROR(value.Serialize(row->add_key()));
+    }
+    for (int i = 0; i < itr->NumColumns(); ++i) {
+      // Columns without a value are written as empty ValueProtos, which are
+      // loaded as NULL, matching how reads treat them.
+      zetasql::ValueProto* value = row->add_values();
+      if (itr->ColumnValue(i).is_valid()) {
+        ZETASQL_RETURN_IF_ERROR(itr->ColumnValue(i).Serialize(value));
+      }
+    }
+    if (record.rows_size() == kSnapshotRowsPerRecord) {
+      ZETASQL_RETURN_IF_ERROR(writer->Append(record));
+      reset_record();
+    }
+  }
+  ZETASQL_RETURN_IF_ERROR(itr->Status());
+  if (record.rows_size() > 0) {
+    ZETASQL_RETURN_IF_ERROR(writer->Append(record));
+  }
+  return absl::OkStatus();
+}
+
+// Exports the rows of `table` visible at `timestamp` to a new file at `path`,
+// as a sequence of SnapshotColumns records. `name` and `is_index` identify the
+// table (or index) the rows belong to.
+absl::Status ExportTableColumns(const Table* table, const std::string& name,
+                                bool is_index, absl::Time timestamp,
+                                const Storage* storage,
+                                const std::string& path) {
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<SnapshotWriter> writer,
+                   SnapshotWriter::Create(path));
+  SnapshotColumns record;
+  auto reset_record = [&]() {
+    record.Clear();
+    record.set_table_name(name);
+    record.set_is_index(is_index);
+    record.set_read_timestamp_micros(absl::ToUnixMicros(timestamp));
+    for (const Column* column : table->columns()) {
+      record.add_columns()->set_name(column->Name());
+    }
+  };
+  reset_record();
+
+  std::unique_ptr<StorageIterator> itr;
+  ZETASQL_RETURN_IF_ERROR(storage->Read(timestamp, table->id(), KeyRange::All(),
+                                GetColumnIDs(table->columns()), &itr));
+  // Each batch of rows is read column by column and written as a record.
+  StorageIterator::Batch batch;
+  while (itr->NextBatch(kSnapshotRowsPerRecord, &batch)) {
+    for (int i = 0; i < batch.columns.size(); ++i) {
+      SnapshotColumns::Column* column = record.mutable_columns(i);
+      for (const zetasql::Value& value : batch.columns[i]) {
+        zetasql::ValueProto* value_proto = column->add_values();
+        if (value.is_valid()) {
+          ZETASQL_RETURN_IF_ERROR(value.Serialize(value_proto));
+        }
+      }
+    }
+    ZETASQL_RETURN_IF_ERROR(writer->Append(record));
+    reset_record();
+  }
+  ZETASQL_RETURN_IF_ERROR(itr->Status());
+  return writer->Close();
+}
+
+// Returns the table with the given name, or the data table of the index with
+// the given name if `is_index` is true. Returns null if there is none.
+const Table* FindTableByName(const Schema* schema, const std::string& name,
+                             bool is_index) {
+  if (!is_index) {
+    return schema->FindTable(name);
+  }
+  const Index* index = schema->FindIndex(name);
+  return index == nullptr ? nullptr : index->index_data_table();
+}
+
+// Returns the key with the serialized `key_values` of the leading columns of
+// `primary_key`.
+zetasql_base::StatusOr<Key> DeserializeKey(
+    absl::Span<const KeyColumn* const> primary_key,
+    const google::protobuf::RepeatedPtrField<zetasql::ValueProto>& key_values) {
+  Key key;
+  for (int i = 0; i < key_values.size(); ++i) {
+    ZETASQL_ASSIGN_OR_RETURN(
+        zetasql::Value value,
+        zetasql::Value::Deserialize(key_values.Get(i),
+                                    primary_key[i]->column()->GetType()));
+    key.AddColumn(value, primary_key[i]->is_descending());
+  }
+  return key;
+}
+
+// Returns the write op recorded by `op` in a commit log at `path`.
+zetasql_base::StatusOr<WriteOp> ResolveLoggedOp(const std::string& path,
+                                        const CommitLogRecord::Op& op,
+                                        const Schema* schema) {
+  const Table* table = FindTableByName(schema, op.table_name(), op.is_index());
+  if (table == nullptr) {
+    return error::InvalidCommitLog(
+        path, absl::StrCat("unknown table ", op.table_name()));
+  }
+  // Deletes may be recorded for a key prefix, see IsPrefixDelete.
+  const bool is_prefix_delete = op.type() == CommitLogRecord::Op::DELETE &&
+                                op.key_size() < table->primary_key().size();
+  if ((op.key_size() != table->primary_key().size() && !is_prefix_delete) ||
+      op.column_names_size() != op.values_size()) {
+    return error::InvalidCommitLog(
+        path, absl::StrCat("write does not match the schema of table ",
+                           op.table_name()));
+  }
+  ZETASQL_ASSIGN_OR_RETURN(Key key, DeserializeKey(table->primary_key(), op.key()));
+
+  std::vector<const Column*> columns;
+  std::vector<zetasql::Value> values;
+  for (int i = 0; i < op.column_names_size(); ++i) {
+    const Column* column = table->FindColumn(op.column_names(i));
+    if (column == nullptr) {
+      return error::InvalidCommitLog(
+          path, absl::StrCat("unknown column ", op.column_names(i),
+                             " in table ", op.table_name()));
+    }
+    ZETASQL_ASSIGN_OR_RETURN(
+        zetasql::Value value,
+        zetasql::Value::Deserialize(op.values(i), column->GetType()));
+    columns.push_back(column);
+    values.push_back(std::move(value));
+  }
+
+  switch (op.type()) {
+    case CommitLogRecord::Op::INSERT:
+      return WriteOp(InsertOp{table, std::move(key), std::move(columns),
+                              std::move(values)});
+    case CommitLogRecord::Op::UPDATE:
+      return WriteOp(UpdateOp{table, std::move(key), std::move(columns),
+                              std::move(values)});
+    case CommitLogRecord::Op::DELETE:
+      return WriteOp(DeleteOp{table, std::move(key)});
+    default:
+      return error::InvalidCommitLog(
+          path, absl::StrCat("unknown write type ", op.type()));
+  }
+}
+
+// Writes the rows in a SnapshotRows record to storage at `timestamp`.
+absl::Status LoadTableSnapshot(const std::string& path,
+                               const SnapshotRows& record, const Schema* schema,
+                               absl::Time timestamp, Storage* storage) {
+  const Table* table =
+      FindTableByName(schema, record.table_name(), record.is_index());
+  if (table == nullptr) {
+    return error::InvalidSnapshot(
+        path, absl::StrCat("unknown table ", record.table_name()));
+  }
+
+  std::vector<const Column*> columns;
+  for (const std::string& column_name : record.column_names()) {
+    const Column* column = table->FindColumn(column_name);
+    if (column == nullptr) {
+      return error::InvalidSnapshot(
+          path, absl::StrCat("unknown column ", column_name, " in table ",
+                             record.table_name()));
+    }
+    columns.push_back(column);
+  }
+  std::vector<ColumnID> column_ids = GetColumnIDs(columns);
+
+  absl::Span<const KeyColumn* const> primary_key = table->primary_key();
+  for (const SnapshotRows::Row& row : record.rows()) {
+    if (row.key_size() != primary_key.size() ||
+        row.values_size() != columns.size()) {
+      return error::InvalidSnapshot(
+          path, absl::StrCat("row does not match the schema of table ",
+                             record.table_name()));
+    }
+    ZETASQL_ASSIGN_OR_RETURN(Key key, DeserializeKey(primary_key, row.key()));
+    std::vector<zetasql::Value> values;
+    values.reserve(columns.size());
+    for (int i = 0; i < columns.size(); ++i) {
+      ZETASQL_ASSIGN_OR_RETURN(
+          zetasql::Value value,
+          zetasql::Value::Deserialize(row.values(i), columns[i]->GetType()));
+      values.push_back(std::move(value));
+    }
+    ZETASQL_RETURN_IF_ERROR(
+        storage->Write(timestamp, table->id(), key, column_ids, values));
+  }
+  return absl::OkStatus();
+}
+
+// Validates the rows in a SnapshotRows record read from a bulk import file at
+// `path` and writes them to storage at `timestamp` as a single batch. The
+// values of each column are validated together for all the rows of the record.
+// The rows of each table must be in strictly increasing key order across its
+// records; `last_keys` holds the last key imported into each table so far.
+absl::Status BulkImportRows(const std::string& path, const SnapshotRows& record,
+                            const Schema* schema, absl::Time timestamp,
+                            Clock* clock, Storage* storage,
+                            absl::flat_hash_map<const Table*, Key>* last_keys) {
+  if (record.is_index()) {
+    return error::InvalidBulkImport(
+        path, absl::StrCat("index ", record.table_name(),
+                           " is built from its table and cannot be imported"));
+  }
+  const Table* table = schema->FindTable(record.table_name());
+  if (table == nullptr) {
+    return error::InvalidBulkImport(
+        path, absl::StrCat("unknown table ", record.table_name()));
+  }
+  for (const Column* column : table->columns()) {
+    if (column->is_generated()) {
+      return error::InvalidBulkImport(
+          path, absl::StrCat("generated column ", column->FullName(),
+                             " is not supported"));
+    }
+  }
+
+  // The values of the key columns are given by the key of each row, and are
+  // followed by the values of the columns of the record.
+  absl::Span<const KeyColumn* const> primary_key = table->primary_key();
+  std::vector<const Column*> columns;
+  for (const KeyColumn* key_column : primary_key) {
+    columns.push_back(key_column->column());
+  }
+  for (const std::string& column_name : record.column_names()) {
+    const Column* column = table->FindColumn(column_name);
+    if (column == nullptr) {
+      return error::InvalidBulkImport(
+          path, absl::StrCat("unknown column ", column_name, " in table ",
+                             record.table_name()));
+    }
+    if (std::find(columns.begin(), columns.end(), column) != columns.end()) {
+      return error::InvalidBulkImport(
+          path, absl::StrCat("column ", column->FullName(),
+                             " is a key column or is listed more than once"));
+    }
+    columns.push_back(column);
+  }
+  for (const Column* column : table->columns()) {
+    if (!column->is_nullable() &&
+        std::find(columns.begin(), columns.end(), column) == columns.end()) {
+      return error::NonNullValueNotSpecifiedForInsert(table->Name(),
+                                                      column->Name());
+    }
+  }
+  for (const SnapshotRows::Row& row : record.rows()) {
+    if (row.key_size() != primary_key.size() ||
+        row.values_size() != record.column_names_size()) {
+      return error::InvalidBulkImport(
+          path, absl::StrCat("row does not match the schema of table ",
+                             record.table_name()));
+    }
+  }
+
+  // Deserialize and validate the values column by column.
+  const int num_rows = record.rows_size();
+  std::vector<std::vector<zetasql::Value>> column_values(columns.size());
+  for (int i = 0; i < columns.size(); ++i) {
+    column_values[i].reserve(num_rows);
+    for (const SnapshotRows::Row& row : record.rows()) {
+      const zetasql::ValueProto& value =
+          i < primary_key.size() ? row.key(i)
+                                 : row.values(i - primary_key.size());
+      ZETASQL_ASSIGN_OR_RETURN(
+          zetasql::Value column_value,
+          zetasql::Value::Deserialize(value, columns[i]->GetType()));
+      column_values[i].push_back(std::move(column_value));
+    }
+    ZETASQL_RETURN_IF_ERROR(
+        ValidateColumnValues(table, columns[i], column_values[i], clock));
+  }
+
+  std::vector<ColumnID> column_ids = GetColumnIDs(columns);
+  std::vector<StorageWrite> writes(num_rows);
+  auto last_key = last_keys->find(table);
+  for (int r = 0; r < num_rows; ++r) {
+    StorageWrite& write = writes[r];
+    for (int i = 0; i < primary_key.size(); ++i) {
+      write.key.AddColumn(column_values[i][r], primary_key[i]->is_descending());
+    }
+    ZETASQL_RETURN_IF_ERROR(ValidateKeySize(table, write.key));
+    const Key* previous_key = nullptr;
+    if (r > 0) {
+      previous_key = &writes[r - 1].key;
+    } else if (last_key != last_keys->end()) {
+      previous_key = &last_key->second;
+    }
+    if (previous_key != nullptr && write.key <= *previous_key) {
+      return error::InvalidBulkImport(
+          path, absl::StrCat("rows of table ", table->Name(),
+                             " are not in increasing key order at key ",
+                             write.key.DebugString()));
+    }
+    write.column_ids = column_ids;
+    write.values.reserve(columns.size());
+    for (int i = 0; i < columns.size(); ++i) {
+      write.values.push_back(std::move(column_values[i][r]));
+    }
+  }
+  if (num_rows == 0) {
+    return absl::OkStatus();
+  }
+  (*last_keys)[table] = writes.back().key;
+  return storage->WriteBatch(timestamp, table->id(), writes);
+}
+
+// Verifies that the parent row of each row of the interleaved `table` exists
+// at `timestamp`, with a single sweep over the keys of the table and of its
+// parent, which are in the same order.
+absl::Status VerifyParentRowsExist(const Table* table, absl::Time timestamp,
+                                   const Storage* storage) {
+  const Table* parent = table->parent();
+  std::unique_ptr<StorageIterator> itr;
+  ZETASQL_RETURN_IF_ERROR(storage->Read(timestamp, table->id(), KeyRange::All(),
+                                /*column_ids=*/{}, &itr));
+  std::unique_ptr<StorageIterator> parent_itr;
+  ZETASQL_RETURN_IF_ERROR(storage->Read(timestamp, parent->id(), KeyRange::All(),
+                                /*column_ids=*/{}, &parent_itr));
+  const int num_parent_key_columns = parent->primary_key().size();
+  bool has_parent = parent_itr->Next();
+  while (itr->Next()) {
+    Key parent_key = itr->Key().Prefix(num_parent_key_columns);
+    while (has_parent && parent_itr->Key() < parent_key) {
+      has_parent = parent_itr->Next();
+    }
+    ZETASQL_RETURN_IF_ERROR(parent_itr->Status());
+    if (!has_parent || !(parent_itr->Key() == parent_key)) {
+      return error::ParentKeyNotFound(parent->Name(), table->Name(),
+                                      parent_key.DebugString());
+    }
+  }
+  return itr->Status();
+}
+
+// Copies the rows of `table` visible at `read_timestamp` in `source` to
+// `destination` at `commit_timestamp`. Columns without a value are left
+// without one.
+absl::Status CopyTableData(const Table* table, absl::Time read_timestamp,
+                           const Storage* source, absl::Time commit_timestamp,
+                           Storage* destination) {
+  std::vector<ColumnID> column_ids = GetColumnIDs(table->columns());
+  std::unique_ptr<StorageIterator> itr;
+  ZETASQL_RETURN_IF_ERROR(source->Read(read_timestamp, table->id(), KeyRange::All(),
+                               column_ids, &itr));
+  std::vector<ColumnID> row_column_ids;
+  std::vector<zetasql::Value> row_values;
+  while (itr->Next()) {
+    row_column_ids.clear();
+    row_values.clear();
+    for (int i = 0; i < itr->NumColumns(); ++i) {
+      if (itr->ColumnValue(i).is_valid()) {
+        row_column_ids.push_back(column_ids[i]);
+        row_values.push_back(itr->ColumnValue(i));
+      }
+    }
+    ZETASQL_RETURN_IF_ERROR(destination->Write(commit_timestamp, table->id(),
+                                       itr->Key(), row_column_ids,
+                                       row_values));
+  }
+  return itr->Status();
+}
+
+}  // namespace
+
 // TransactionIDGenerator is initialized to 1 because 0 is used as a sentinel
 // value for an invalid transaction.
 Database::Database() : transaction_id_generator_(1) {}
 
-zetasql_base::StatusOr<std::unique_ptr<Database>> Database::Create(
-    Clock* clock, const std::vector<std::string>& create_statements) {
+Database::~Database() {
+  shutdown_.Notify();
+  if (gc_thread_ != nullptr) {
+    gc_thread_->join();
+  }
+}
+
+std::unique_ptr<Database> Database::CreateUninitialized(
+    std::shared_ptr<zetasql::TypeFactory> type_factory) {
   auto database = absl::WrapUnique(new Database());
-  database->clock_ = clock;
   database->storage_ = absl::make_unique<InMemoryStorage>();
-  database->lock_manager_ = absl::make_unique<LockManager>(clock);
-  database->type_factory_ = absl::make_unique<zetasql::TypeFactory>();
-  database->query_engine_ =
-      absl::make_unique<QueryEngine>(database->type_factory_.get());
+  database->lock_manager_ = absl::make_unique<LockManager>(&database->clock_);
+  database->type_factory_ = std::move(type_factory);
+  database->query_engine_ = absl::make_unique<QueryEngine>(
+      database->type_factory_.get(),
+      ParallelQueryOptions{.num_threads = config::parallel_query_threads()},
+      QueryResultCacheOptions{
+          .storage = database->storage_.get(),
+          .max_bytes = config::query_result_cache_bytes()},
+      QueryLimits{
+          .max_concurrent_queries =
+              config::max_concurrent_queries_per_database(),
+          .max_rows_scanned = config::max_rows_scanned_per_query(),
+          .max_memory_bytes = config::max_query_memory_bytes()},
+      ExternalSortOptions{
+          .spill_threshold_bytes = config::query_sort_spill_threshold_bytes(),
+          .spill_directory = config::query_sort_spill_directory()},
+      &database->lock_manager_->lock_stats());
+  database->read_parallelism_ = config::parallel_read_threads();
   database->action_manager_ = absl::make_unique<ActionManager>();
+  if (config::change_stream_retained_changes() > 0) {
+    database->change_stream_ = absl::make_unique<ChangeStream>(
+        config::change_stream_retained_changes());
+  }
+  database->commit_pipeline_ = absl::make_unique<CommitPipeline>(
+      database->lock_manager_.get(), database->storage_.get(),
+      /*commit_log=*/nullptr, database->change_stream_.get());
+  database->memory_budget_ = absl::make_unique<MemoryBudget>(
+      database->storage_.get(), config::max_database_memory_bytes());
+  return database;
+}
+
+zetasql_base::StatusOr<std::unique_ptr<Database>> Database::Create(
+    const std::vector<std::string>& create_statements) {
+  std::unique_ptr<Database> database =
+      CreateUninitialized(std::make_shared<zetasql::TypeFactory>());
 
   if (create_statements.empty()) {
     database->versioned_catalog_ = absl::make_unique<VersionedCatalog>();
@@ -76,23 +583,502 @@ zetasql_base::StatusOr<std::unique_ptr<Database>> Database::Create(
   database->action_manager_->AddActionsForSchema(
       database->versioned_catalog_->GetLatestSchema());
 
+  database->gc_thread_ = absl::make_unique<std::thread>(
+      &Database::RunGarbageCollection, database.get());
+  return database;
+}
+
+zetasql_base::StatusOr<std::unique_ptr<Database>> Database::CreateFromTemplate(
+    Database* template_database, bool copy_data) {
+  // Pick a strong read timestamp of the template and wait for in-progress
+  // commits, which also prevents the versions being copied from being garbage
+  // collected.
+  std::unique_ptr<LockHandle> read_handle =
+      template_database->lock_manager_->CreateHandle(
+          template_database->transaction_id_generator_.NextId(),
+          /*priority=*/1);
+  absl::Time read_timestamp = template_database->clock_.Now();
+  read_handle->WaitForSafeRead(read_timestamp);
+  std::shared_ptr<const Schema> schema =
+      template_database->versioned_catalog_->ShareSchema(read_timestamp);
+  ZETASQL_ASSIGN_OR_RETURN(
+      std::shared_ptr<ActionRegistry> registry,
+      template_database->action_manager_->GetActionsForSchema(schema.get()));
+
+  // The schema refers to types owned by the template's type factory, and to
+  // table and column IDs generated by the template.
+  std::unique_ptr<Database> database =
+      CreateUninitialized(template_database->type_factory_);
+  database->table_id_generator_.ContinueFrom(
+      template_database->table_id_generator_);
+  database->column_id_generator_.ContinueFrom(
+      template_database->column_id_generator_);
+  database->versioned_catalog_ = absl::make_unique<VersionedCatalog>(schema);
+  database->action_manager_->AddActionsForSchema(schema.get(),
+                                                 std::move(registry));
+  ZETASQL_RETURN_IF_ERROR(
+      InterleaveTablesInStorage(schema.get(), database->storage_.get()));
+
+  if (copy_data) {
+    // As when loading a snapshot, the rows are committed at a single
+    // timestamp, with no concurrent transactions since the database is not
+    // shared yet.
+    std::unique_ptr<LockHandle> lock_handle =
+        database->lock_manager_->CreateHandle(
+            database->transaction_id_generator_.NextId(), /*priority=*/1);
+    ZETASQL_ASSIGN_OR_RETURN(absl::Time commit_timestamp,
+                     lock_handle->ReserveCommitTimestamp());
+    for (const Table* table : schema->tables()) {
+      ZETASQL_RETURN_IF_ERROR(CopyTableData(
+          table, read_timestamp, template_database->storage_.get(),
+          commit_timestamp, database->storage_.get()));
+      for (const Index* index : table->indexes()) {
+        ZETASQL_RETURN_IF_ERROR(CopyTableData(
+            index->index_data_table(), read_timestamp,
+            template_database->storage_.get(), commit_timestamp,
+            database->storage_.get()));
+      }
+    }
+    ZETASQL_RETURN_IF_ERROR(lock_handle->MarkCommitted());
+  }
+
+  database->gc_thread_ = absl::make_unique<std::thread>(
+      &Database::RunGarbageCollection, database.get());
+  return database;
+}
+
+zetasql_base::StatusOr<std::unique_ptr<Database>> Database::CreateFromSnapshot(
+    const std::string& path) {
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<SnapshotReader> reader,
+                   SnapshotReader::Open(path));
+  SnapshotHeader header;
+  ZETASQL_ASSIGN_OR_RETURN(bool has_header, reader->Next(&header));
+  if (!has_header) {
+    return error::InvalidSnapshot(path, "missing header");
+  }
+  if (header.version() != kSnapshotVersion) {
+    return error::InvalidSnapshot(
+        path, absl::StrCat("unsupported version ", header.version()));
+  }
+
+  std::vector<std::string> create_statements(header.ddl_statements().begin(),
+                                             header.ddl_statements().end());
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<Database> database,
+                   Create(create_statements));
+
+  // Load all the data at a single commit timestamp so that it becomes visible
+  // atomically. The database is not shared yet, so there are no concurrent
+  // transactions.
+  std::unique_ptr<LockHandle> lock_handle =
+      database->lock_manager_->CreateHandle(
+          database->transaction_id_generator_.NextId(), /*priority=*/1);
+  ZETASQL_ASSIGN_OR_RETURN(absl::Time commit_timestamp,
+                   lock_handle->ReserveCommitTimestamp());
+  const Schema* schema = database->versioned_catalog_->GetLatestSchema();
+  SnapshotRows record;
+  while (true) {
+    ZETASQL_ASSIGN_OR_RETURN(bool has_record, reader->Next(&record));
+    if (!has_record) {
+      break;
+    }
+    ZETASQL_RETURN_IF_ERROR(LoadTableSnapshot(path, record, schema, commit_timestamp,
+                                      database->storage_.get()));
+  }
+  ZETASQL_RETURN_IF_ERROR(lock_handle->MarkCommitted());
   return database;
 }
 
+zetasql_base::StatusOr<std::unique_ptr<Database>> Database::CreateWithBulkImport(
+    const std::vector<std::string>& create_statements,
+    const std::string& path) {
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<SnapshotReader> reader,
+                   SnapshotReader::Open(path));
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<Database> database,
+                   Create(create_statements));
+
+  // As when loading a snapshot, the rows are committed at a single timestamp,
+  // with no concurrent transactions since the database is not shared yet.
+  std::unique_ptr<LockHandle> lock_handle =
+      database->lock_manager_->CreateHandle(
+          database->transaction_id_generator_.NextId(), /*priority=*/1);
+  ZETASQL_ASSIGN_OR_RETURN(absl::Time commit_timestamp,
+                   lock_handle->ReserveCommitTimestamp());
+  const Schema* schema = database->versioned_catalog_->GetLatestSchema();
+  Storage* storage = database->storage_.get();
+  absl::flat_hash_map<const Table*, Key> last_keys;
+  SnapshotRows record;
+  while (true) {
+    ZETASQL_ASSIGN_OR_RETURN(bool has_record, reader->Next(&record));
+    if (!has_record) {
+      break;
+    }
+    ZETASQL_RETURN_IF_ERROR(BulkImportRows(path, record, schema, commit_timestamp,
+                                   &database->clock_, storage, &last_keys));
+  }
+
+  // Indexes are built and constraints verified once all the rows have been
+  // imported, as a schema change backfills and verifies existing data. Foreign
+  // keys are verified last, since they may be backed by indexes.
+  SchemaValidationContext context(storage, /*global_names=*/nullptr,
+                                  commit_timestamp);
+  for (const Table* table : schema->tables()) {
+    if (table->parent() != nullptr) {
+      ZETASQL_RETURN_IF_ERROR(
+          VerifyParentRowsExist(table, commit_timestamp, storage));
+    }
+    for (const Index* index : table->indexes()) {
+      ZETASQL_RETURN_IF_ERROR(BackfillIndex(index, &context));
+    }
+  }
+  for (const Table* table : schema->tables()) {
+    for (const ForeignKey* foreign_key : table->foreign_keys()) {
+      ZETASQL_RETURN_IF_ERROR(VerifyForeignKeyData(foreign_key, &context));
+    }
+  }
+  ZETASQL_RETURN_IF_ERROR(lock_handle->MarkCommitted());
+  return database;
+}
+
+zetasql_base::StatusOr<std::unique_ptr<Database>> Database::CreateWithCommitLog(
+    const std::vector<std::string>& create_statements,
+    const std::string& commit_log_path, CommitLog::SyncPolicy sync_policy) {
+  // The first record of a commit log holds the statements the database was
+  // created with, and the remaining records are applied in order.
+  std::unique_ptr<Database> database;
+  ZETASQL_RETURN_IF_ERROR(CommitLog::Replay(
+      commit_log_path, [&](const CommitLogRecord& record) -> absl::Status {
+        if (database == nullptr) {
+          ZETASQL_ASSIGN_OR_RETURN(database, Create(std::vector<std::string>(
+                                         record.ddl_statements().begin(),
+                                         record.ddl_statements().end())));
+          return absl::OkStatus();
+        }
+        return database->ReplayCommitLogRecord(commit_log_path, record);
+      }));
+
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<CommitLog> commit_log,
+                   CommitLog::Open(commit_log_path, sync_policy));
+  if (database == nullptr) {
+    ZETASQL_ASSIGN_OR_RETURN(database, Create(create_statements));
+    ZETASQL_RETURN_IF_ERROR(commit_log->AppendSchemaChange(database->clock_.Now(),
+                                                   create_statements));
+  }
+  database->commit_log_ = std::move(commit_log);
+  database->commit_pipeline_ = absl::make_unique<CommitPipeline>(
+      database->lock_manager_.get(), database->storage_.get(),
+      database->commit_log_.get(), database->change_stream_.get());
+  return database;
+}
+
+absl::Status Database::ReplayCommitLogRecord(const std::string& path,
+                                             const CommitLogRecord& record) {
+  if (record.ddl_statements_size() > 0) {
+    std::vector<std::string> statements(record.ddl_statements().begin(),
+                                        record.ddl_statements().end());
+    int num_successful_statements = 0;
+    absl::Time commit_timestamp;
+    absl::Status backfill_status;
+    ZETASQL_RETURN_IF_ERROR(UpdateSchema(statements, &num_successful_statements,
+                                 &commit_timestamp, &backfill_status));
+    if (!backfill_status.ok()) {
+      return error::InvalidCommitLog(
+          path, absl::StrCat("failed to replay schema change: ",
+                             backfill_status.message()));
+    }
+    return absl::OkStatus();
+  }
+
+  // Replayed transactions are committed at new timestamps, in the order they
+  // were logged. Commit timestamp sentinels were already replaced before the
+  // ops were logged, so the original values are restored.
+  const Schema* schema = versioned_catalog_->GetLatestSchema();
+  std::vector<WriteOp> write_ops;
+  write_ops.reserve(record.ops_size());
+  for (const CommitLogRecord::Op& op : record.ops()) {
+    ZETASQL_ASSIGN_OR_RETURN(WriteOp write_op, ResolveLoggedOp(path, op, schema));
+    write_ops.push_back(std::move(write_op));
+  }
+  std::unique_ptr<LockHandle> lock_handle = lock_manager_->CreateHandle(
+      transaction_id_generator_.NextId(), /*priority=*/1);
+  ZETASQL_ASSIGN_OR_RETURN(absl::Time commit_timestamp,
+                   lock_handle->ReserveCommitTimestamp());
+  absl::Status flush_status =
+      FlushWriteOpsToStorage(write_ops, storage_.get(), commit_timestamp);
+  ZETASQL_RETURN_IF_ERROR(lock_handle->MarkCommitted());
+  return flush_status;
+}
+
+absl::Status Database::WriteSnapshot(const std::string& path) {
+  // Pick a strong read timestamp and wait for in-progress commits, which also
+  // prevents the versions being read from being garbage collected.
+  std::unique_ptr<LockHandle> lock_handle = lock_manager_->CreateHandle(
+      transaction_id_generator_.NextId(), /*priority=*/1);
+  absl::Time read_timestamp = clock_.Now();
+  lock_handle->WaitForSafeRead(read_timestamp);
+  const Schema* schema = versioned_catalog_->GetSchema(read_timestamp);
+
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<SnapshotWriter> writer,
+                   SnapshotWriter::Create(path));
+  SnapshotHeader header;
+  header.set_version(kSnapshotVersion);
+  header.set_read_timestamp_micros(absl::ToUnixMicros(read_timestamp));
+  for (const std::string& statement : PrintDDLStatements(schema)) {
+    header.add_ddl_statements(statement);
+  }
+  ZETASQL_RETURN_IF_ERROR(writer->Append(header));
+
+  for (const Table* table : schema->tables()) {
+    ZETASQL_RETURN_IF_ERROR(WriteTableSnapshot(table, table->Name(),
+                                       /*is_index=*/false, read_timestamp,
+                                       storage_.get(), writer.get()));
+    for (const Index* index : table->indexes()) {
+      ZETASQL_RETURN_IF_ERROR(WriteTableSnapshot(
+          index->index_data_table(), index->Name(), /*is_index=*/true,
+          read_timestamp, storage_.get(), writer.get()));
+    }
+  }
+  return writer->Close();
+}
+
+absl::Status Database::ExportTables(const std::string& directory) {
+  // As for a snapshot, all the tables are read at a single strong read
+  // timestamp, whose versions are kept until the export completes.
+  std::unique_ptr<LockHandle> lock_handle = lock_manager_->CreateHandle(
+      transaction_id_generator_.NextId(), /*priority=*/1);
+  absl::Time read_timestamp = clock_.Now();
+  lock_handle->WaitForSafeRead(read_timestamp);
+  const Schema* schema = versioned_catalog_->GetSchema(read_timestamp);
+
+  struct ExportedTable {
+    const Table* table;
+    std::string name;
+    bool is_index;
+  };
+  std::vector<ExportedTable> exported_tables;
+  for (const Table* table : schema->tables()) {
+    exported_tables.push_back({table, table->Name(), /*is_index=*/false});
+    for (const Index* index : table->indexes()) {
+      exported_tables.push_back(
+          {index->index_data_table(), index->Name(), /*is_index=*/true});
+    }
+  }
+
+  // Tables are exported in parallel, each to a file of its own.
+  return ForEachInParallel(
+      exported_tables.size(), kMaxExportThreads, [&](int i) {
+        const ExportedTable& exported = exported_tables[i];
+        std::string path =
+            absl::StrCat(directory, "/", exported.name, ".columns");
+        return ExportTableColumns(exported.table, exported.name,
+                                  exported.is_index, read_timestamp,
+                                  storage_.get(), path);
+      });
+}
+
+absl::Status Database::Checkpoint() {
+  // Excluding read-write transactions makes the latest data consistent, and
+  // reserving a timestamp orders the checkpoint after their commits.
+  ScopedSchemaChangeLock lock{transaction_id_generator_.NextId(),
+                              lock_manager_.get()};
+  ZETASQL_RETURN_IF_ERROR(lock.Wait());
+  ZETASQL_ASSIGN_OR_RETURN(absl::Time timestamp, lock.ReserveCommitTimestamp());
+
+  absl::MutexLock checkpoint_lock(&checkpoint_mu_);
+  ZETASQL_ASSIGN_OR_RETURN(checkpoint_, storage_->Checkpoint(timestamp));
+  checkpoint_schema_ = versioned_catalog_->ShareSchema(timestamp);
+  return absl::OkStatus();
+}
+
+absl::Status Database::ResetToCheckpoint() {
+  if (commit_log_ != nullptr) {
+    return error::CannotResetToCheckpoint(
+        "the database has a commit log, which does not record resets");
+  }
+  ScopedSchemaChangeLock lock{transaction_id_generator_.NextId(),
+                              lock_manager_.get()};
+  if (!lock.Wait().ok()) {
+    return error::CannotResetToCheckpoint(
+        "a read-write transaction or schema change is in progress");
+  }
+  ZETASQL_ASSIGN_OR_RETURN(absl::Time timestamp, lock.ReserveCommitTimestamp());
+
+  absl::MutexLock checkpoint_lock(&checkpoint_mu_);
+  if (checkpoint_ == nullptr) {
+    return error::CannotResetToCheckpoint("no checkpoint was recorded");
+  }
+  if (versioned_catalog_->GetSchema(timestamp) != checkpoint_schema_.get()) {
+    return error::CannotResetToCheckpoint(
+        "the schema has changed since the checkpoint was recorded");
+  }
+  return storage_->ResetToCheckpoint(*checkpoint_);
+}
+
+void Database::RunGarbageCollection() {
+  while (
+      !shutdown_.WaitForNotificationWithTimeout(kGarbageCollectionInterval)) {
+    // Reads older than the retention period are rejected, but reads which
+    // passed that check earlier may still be in progress.
+    absl::Time horizon =
+        std::min(clock_.Now() - config::version_retention_period(),
+                 lock_manager_->OldestActiveReadTimestamp());
+    storage_->CollectGarbage(horizon);
+
+    // Schemas are pruned on the same horizon as data versions.
+    std::vector<const Schema*> pruned_schemas =
+        versioned_catalog_->PruneSchemas(horizon);
+    for (const Schema* schema : pruned_schemas) {
+      action_manager_->RemoveActionsForSchema(schema);
+    }
+    if (!pruned_schemas.empty()) {
+      query_engine_->ClearQueryCache();
+    }
+  }
+}
+
 zetasql_base::StatusOr<std::unique_ptr<ReadOnlyTransaction>>
 Database::CreateReadOnlyTransaction(const ReadOnlyOptions& options) {
   return absl::make_unique<ReadOnlyTransaction>(
-      options, transaction_id_generator_.NextId(), clock_, storage_.get(),
-      lock_manager_.get(), versioned_catalog_.get());
+      options, transaction_id_generator_.NextId(), &clock_, storage_.get(),
+      lock_manager_.get(), versioned_catalog_.get(), read_parallelism_);
+}
+
+absl::Status Database::ReadAtSnapshot(
+    const ReadOnlyOptions& options,
+    const std::function<absl::Status(ReadOnlyTransaction*)>& read) {
+  ReadOnlyTransaction transaction(
+      options, transaction_id_generator_.NextId(), &clock_, storage_.get(),
+      lock_manager_.get(), versioned_catalog_.get(), read_parallelism_);
+  return read(&transaction);
 }
 
 zetasql_base::StatusOr<std::unique_ptr<ReadWriteTransaction>>
 Database::CreateReadWriteTransaction(const ReadWriteOptions& options,
                                      const RetryState& retry_state) {
   return absl::make_unique<ReadWriteTransaction>(
-      options, retry_state, transaction_id_generator_.NextId(), clock_,
+      options, retry_state, transaction_id_generator_.NextId(), &clock_,
       storage_.get(), lock_manager_.get(), versioned_catalog_.get(),
-      action_manager_.get());
+      action_manager_.get(), commit_log_.get(), commit_pipeline_.get(),
+      memory_budget_.get());
+}
+
+Database::MemoryUsage Database::GetMemoryUsage() const {
+  absl::flat_hash_map<TableID, int64_t> bytes_by_id = storage_->TableBytes();
+  auto bytes_of = [&bytes_by_id](const Table* table) -> int64_t {
+    auto itr = bytes_by_id.find(table->id());
+    return itr == bytes_by_id.end() ? 0 : itr->second;
+  };
+  MemoryUsage usage;
+  for (const Table* table : versioned_catalog_->GetLatestSchema()->tables()) {
+    usage.table_bytes[table->Name()] = bytes_of(table);
+    for (const Index* index : table->indexes()) {
+      usage.table_bytes[index->Name()] = bytes_of(index->index_data_table());
+    }
+  }
+  usage.transaction_bytes = memory_budget_->transaction_bytes();
+  return usage;
+}
+
+zetasql_base::StatusOr<TableVersion> Database::GetTableVersion(
+    const std::string& table_name) const {
+  const Schema* schema = versioned_catalog_->GetLatestSchema();
+  const Table* table = schema->FindTable(table_name);
+  if (table == nullptr) {
+    const Index* index = schema->FindIndex(table_name);
+    if (index == nullptr) {
+      return error::TableNotFound(table_name);
+    }
+    table = index->index_data_table();
+  }
+  absl::optional<TableVersion> version = storage_->GetTableVersion(table->id());
+  ZETASQL_RET_CHECK(version.has_value())
+      << "Storage does not track the versions of its tables";
+  return *version;
+}
+
+absl::optional<TableStatistics> Database::GetTableStatistics(
+    const Table* table) const {
+  return storage_->GetTableStatistics(table->id());
+}
+
+absl::Status Database::ReadChanges(absl::Time after,
+                                   const std::vector<std::string>& tables,
+                                   int64_t max_changes, absl::Time deadline,
+                                   std::vector<Change>* changes) const {
+  if (change_stream_ == nullptr) {
+    return error::ChangeStreamDisabled();
+  }
+  const Schema* schema = versioned_catalog_->GetLatestSchema();
+  for (const std::string& table : tables) {
+    if (schema->FindTable(table) == nullptr) {
+      return error::TableNotFound(table);
+    }
+  }
+  return change_stream_->Read(after, tables, max_changes, deadline, changes);
+}
+
+zetasql_base::StatusOr<int64_t> Database::ExecutePartitionedDml(
+    const Query& query, const std::string& partitioned_table) {
+  const Table* table =
+      versioned_catalog_->GetLatestSchema()->FindTable(partitioned_table);
+  if (table == nullptr) {
+    return error::TableNotFound(partitioned_table);
+  }
+  // Split the table at keys sampled by storage, into as many ranges as keep
+  // each to about kRowsPerPartitionedDmlRange rows. Rows inserted into a range
+  // after it is split are still modified by the transaction of the range.
+  ZETASQL_ASSIGN_OR_RETURN(
+      std::vector<KeyRange> ranges,
+      SplitKeyRangeForScan(storage_.get(), table->id(), KeyRange::All(),
+                           /*max_ranges=*/std::numeric_limits<int>::max(),
+                           kRowsPerPartitionedDmlRange));
+
+  // Reports the error of the earliest failing range, as a sequential execution
+  // of the statement would.
+  std::vector<int64_t> range_counts(ranges.size(), 0);
+  ZETASQL_RETURN_IF_ERROR(ForEachInParallel(
+      ranges.size(), kMaxPartitionedDmlThreads, [&](int i) -> absl::Status {
+        ZETASQL_ASSIGN_OR_RETURN(
+            range_counts[i],
+            ExecutePartitionedDmlPartition(query, table, ranges[i]));
+        return absl::OkStatus();
+      }));
+  int64_t modified_row_count = 0;
+  for (int64_t range_count : range_counts) {
+    modified_row_count += range_count;
+  }
+  return modified_row_count;
+}
+
+zetasql_base::StatusOr<int64_t> Database::ExecutePartitionedDmlPartition(
+    const Query& query, const Table* table, const KeyRange& range) {
+  RetryState retry_state;
+  for (int attempt = 1;; ++attempt) {
+    ZETASQL_ASSIGN_OR_RETURN(
+        std::unique_ptr<ReadWriteTransaction> txn,
+        CreateReadWriteTransaction(ReadWriteOptions(), retry_state));
+    zetasql_base::StatusOr<QueryResult> result = query_engine_->ExecuteSql(
+        query, QueryContext{.schema = txn->schema(),
+                            .reader = txn.get(),
+                            .writer = txn.get(),
+                            .partitioned_table = table->Name(),
+                            .partition_range = range});
+    absl::Status status = result.status();
+    if (status.ok()) {
+      status = txn->Commit();
+    } else {
+      txn->Rollback().IgnoreError();
+    }
+    if (status.ok()) {
+      return result->modified_row_count;
+    }
+    if (status.code() != absl::StatusCode::kAborted ||
+        attempt == kMaxPartitionedDmlAttempts) {
+      return status;
+    }
+    // Retry with the priority of the aborted transaction, so that it
+    // eventually wins over the transactions it conflicts with.
+    retry_state = txn->retry_state();
+  }
 }
 
 SchemaChangeContext Database::GetSchemaChangeContext() {
@@ -104,31 +1090,105 @@ SchemaChangeContext Database::GetSchemaChangeContext() {
   };
 }
 
+absl::Status Database::ValidateSchemaChange(
+    absl::Span<const std::string> statements) {
+  if (statements.empty()) {
+    return error::UpdateDatabaseMissingStatements();
+  }
+
+  // Objects created by the statements are assigned IDs from copies of the
+  // generators, so that validating them does not use up the IDs of the
+  // database.
+  TableIDGenerator table_id_generator;
+  table_id_generator.ContinueFrom(table_id_generator_);
+  ColumnIDGenerator column_id_generator;
+  column_id_generator.ContinueFrom(column_id_generator_);
+
+  auto context = GetSchemaChangeContext();
+  context.table_id_generator = &table_id_generator;
+  context.column_id_generator = &column_id_generator;
+  context.schema_change_timestamp = clock_.Now();
+  SchemaUpdater updater;
+  return updater
+      .ValidateSchemaFromDDL(statements, context,
+                             versioned_catalog_->GetLatestSchema())
+      .status();
+}
+
 absl::Status Database::UpdateSchema(absl::Span<const std::string> statements,
                                     int* num_succesful_statements,
                                     absl::Time* commit_timestamp,
-                                    absl::Status* backfill_status) {
+                                    absl::Status* backfill_status,
+                                    const CancellationToken* cancellation,
+                                    SchemaChangeProgressFn progress) {
   if (statements.empty()) {
     return error::UpdateDatabaseMissingStatements();
   }
 
+  // The backfills and verifications of the statements first run against a
+  // snapshot of the database, without its lock, so that read-write
+  // transactions keep committing while they run. Their writes to new tables,
+  // such as the data tables of new indexes, are staged until the schema change
+  // commits. The read handle keeps the snapshot from being garbage collected.
+  std::unique_ptr<LockHandle> read_handle = lock_manager_->CreateHandle(
+      transaction_id_generator_.NextId(), /*priority=*/1);
+  absl::Time snapshot_timestamp = clock_.Now();
+  read_handle->WaitForSafeRead(snapshot_timestamp);
+  const Schema* existing_schema = versioned_catalog_->GetLatestSchema();
+  StagedStorage staged_storage(storage_.get(),
+                               StorageTableIds(existing_schema));
+  auto context = GetSchemaChangeContext();
+  context.storage = &staged_storage;
+  context.schema_change_timestamp = snapshot_timestamp;
+  context.cancellation = cancellation;
+  context.progress = progress;
+  ZETASQL_ASSIGN_OR_RETURN(
+      SchemaChangeResult result,
+      SchemaUpdater().UpdateSchemaFromDDL(existing_schema, statements, context));
+
   // Make an exclusive lock request for the database. If there are any
-  // concurrent transactions it will be denied and the operation aborted.
-  ScopedSchemaChangeLock lock{transaction_id_generator_.NextId(),
-                              lock_manager_.get()};
-  ZETASQL_RETURN_IF_ERROR(lock.Wait());
+  // concurrent transactions it will be denied, and retried a few times since
+  // transactions may have started while the backfills ran.
+  std::unique_ptr<ScopedSchemaChangeLock> lock;
+  for (int attempt = 1;; ++attempt) {
+    lock = absl::make_unique<ScopedSchemaChangeLock>(
+        transaction_id_generator_.NextId(), lock_manager_.get());
+    absl::Status status = lock->Wait();
+    if (status.ok()) {
+      break;
+    }
+    if (attempt == kMaxSchemaChangeLockAttempts) {
+      return status;
+    }
+    lock = nullptr;
+    absl::SleepFor(kSchemaChangeLockRetryDelay * attempt);
+  }
 
   // Reserve a commit timestamp for the schema changes. Even if the
   // schema change fails, it will result in a no-op commit that will
   // be invisible to other read-only/read-write transactions.
-  ZETASQL_ASSIGN_OR_RETURN(auto update_timestamp, lock.ReserveCommitTimestamp());
+  ZETASQL_ASSIGN_OR_RETURN(auto update_timestamp, lock->ReserveCommitTimestamp());
 
-  auto context = GetSchemaChangeContext();
-  context.schema_change_timestamp = update_timestamp;
-  const Schema* existing_schema = versioned_catalog_->GetLatestSchema();
-  SchemaUpdater updater;
-  ZETASQL_ASSIGN_OR_RETURN(auto result, updater.UpdateSchemaFromDDL(
-                                    existing_schema, statements, context));
+  // The staged result is kept if it succeeded, only wrote to new tables, and
+  // nothing it depends on changed since the snapshot; the staged rows are then
+  // all that is written under the lock. Otherwise, the schema change runs
+  // again under the lock, against the latest data, and reports its progress
+  // anew.
+  ZETASQL_ASSIGN_OR_RETURN(bool changed,
+                   staged_storage.BaseChangedSince(snapshot_timestamp));
+  read_handle->UnlockAll();
+  if (result.backfill_status.ok() && !staged_storage.deferred() && !changed &&
+      versioned_catalog_->GetLatestSchema() == existing_schema) {
+    ZETASQL_RETURN_IF_ERROR(
+        staged_storage.ApplyTo(update_timestamp, storage_.get()));
+  } else {
+    existing_schema = versioned_catalog_->GetLatestSchema();
+    context.storage = storage_.get();
+    context.schema_change_timestamp = update_timestamp;
+    context.progress = std::move(progress);
+    ZETASQL_ASSIGN_OR_RETURN(result, SchemaUpdater().UpdateSchemaFromDDL(
+                                 existing_schema, statements, context));
+  }
   *commit_timestamp = update_timestamp;
   *num_succesful_statements = result.num_successful_statements;
   *backfill_status = result.backfill_status;
@@ -137,16 +1197,66 @@ absl::Status Database::UpdateSchema(absl::Span<const std::string> statements,
   // schema will be the schema for the last valid statement before the statement
   // for which the backfill/verification failed.
   if (result.updated_schema != nullptr) {
+    if (commit_log_ != nullptr) {
+      ZETASQL_RETURN_IF_ERROR(commit_log_->AppendSchemaChange(
+          update_timestamp,
+          statements.subspan(0, result.num_successful_statements)));
+    }
     ZETASQL_RETURN_IF_ERROR(versioned_catalog_->AddSchema(
         update_timestamp, std::move(result.updated_schema)));
+
+    // The rows of dropped tables and indexes are detached from storage as a
+    // whole, and freed once older reads can no longer see them.
+    for (const TableID& table_id :
+         result.schema_diff.DroppedStorageTableIds()) {
+      ZETASQL_RETURN_IF_ERROR(storage_->DropTable(update_timestamp, table_id));
+    }
+
+    // The structures derived from the schema are updated for the tables which
+    // changed. The action registry re-uses the actions of the tables shared
+    // with the previous schema by itself.
     action_manager_->AddActionsForSchema(versioned_catalog_->GetLatestSchema());
+    query_engine_->UpdateQueryCache(result.schema_diff);
   }
   return absl::OkStatus();
 }
 
 std::vector<std::string> Database::GetSchema() {
-  const Schema* schema = versioned_catalog_->GetLatestSchema();
-  return PrintDDLStatements(schema);
+  std::shared_ptr<const Schema> schema =
+      versioned_catalog_->ShareSchema(absl::InfiniteFuture());
+  {
+    absl::MutexLock lock(&printed_schema_mu_);
+    if (printed_schema_ == schema) {
+      return printed_ddl_statements_;
+    }
+  }
+  // Print outside the lock, so that callers of GetSchema for a schema already
+  // printed do not wait. Concurrent callers for a new schema may both print
+  // it. Only the tables which the schema does not share with the one printed
+  // last are printed.
+  PrintedTables previous_tables;
+  {
+    absl::MutexLock lock(&printed_schema_mu_);
+    previous_tables = printed_tables_;
+  }
+  PrintedTables tables;
+  std::vector<std::string> ddl_statements;
+  for (const Table* table : schema->tables()) {
+    auto itr = previous_tables.find(table);
+    std::shared_ptr<const std::vector<std::string>> statements =
+        itr != previous_tables.end()
+            ? itr->second
+            : std::make_shared<const std::vector<std::string>>(
+                  PrintTableAndIndexes(table));
+    ddl_statements.insert(ddl_statements.end(), statements->begin(),
+                          statements->end());
+    tables[table] = std::move(statements);
+  }
+  absl::MutexLock lock(&printed_schema_mu_);
+  printed_schema_ = std::move(schema);
+  printed_tables_ = std::move(tables);
+  printed_ddl_statements_ = ddl_statements;
+  return ddl_statements;
 }
 
 }  // namespace backend
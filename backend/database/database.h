@@ -17,25 +17,41 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_DATABASE_DATABASE_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_DATABASE_DATABASE_H_
 
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
+#include <thread>  // NOLINT
 #include <vector>
 
 #include "zetasql/public/type.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/base/thread_annotations.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
 #include "absl/time/time.h"
+#include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "absl/types/variant.h"
 #include "backend/actions/manager.h"
 #include "backend/common/ids.h"
+#include "backend/datamodel/key_range.h"
 #include "backend/locking/manager.h"
 #include "backend/query/query_engine.h"
+#include "backend/schema/catalog/table.h"
 #include "backend/schema/catalog/versioned_catalog.h"
 #include "backend/schema/updater/schema_updater.h"
 #include "backend/storage/storage.h"
+#include "backend/transaction/change_stream.h"
+#include "backend/transaction/commit_log.h"
+#include "backend/transaction/commit_log.pb.h"
+#include "backend/transaction/commit_pipeline.h"
+#include "backend/transaction/memory_budget.h"
 #include "backend/transaction/options.h"
 #include "backend/transaction/read_only_transaction.h"
 #include "backend/transaction/read_write_transaction.h"
+#include "common/cancellation.h"
 #include "common/clock.h"
 #include "absl/status/status.h"
 #include "zetasql/base/statusor.h"
@@ -55,12 +71,61 @@ class Database {
   // create_statements. Returns an error if create_statements are invalid, or if
   // failed to create the database.
   static zetasql_base::StatusOr<std::unique_ptr<Database>> Create(
-      Clock* clock, const std::vector<std::string>& create_statements);
+      const std::vector<std::string>& create_statements);
+
+  // Constructs a database from a snapshot written by WriteSnapshot(). The
+  // schema is recreated from the DDL statements in the snapshot, and data is
+  // written directly to storage without going through transactions or actions.
+  static zetasql_base::StatusOr<std::unique_ptr<Database>> CreateFromSnapshot(
+      const std::string& path);
+
+  // Constructs a database with schema created using `create_statements`, and
+  // imports the rows of a trusted bulk import file at `path` into its tables,
+  // much faster than committing them through transactions. The file has the
+  // format of a snapshot without a header: a sequence of SnapshotRows records
+  // of tables, listing the values of the non-key columns of the record. The
+  // rows of each table must be in strictly increasing key order. Values are
+  // validated column by column as they are imported. Index entries are then
+  // built by sorted bulk insertion, and interleaving, unique index and foreign
+  // key constraints are verified once over all the rows. Tables with generated
+  // columns cannot be imported.
+  static zetasql_base::StatusOr<std::unique_ptr<Database>> CreateWithBulkImport(
+      const std::vector<std::string>& create_statements,
+      const std::string& path);
+
+  // Constructs a database with the schema of `template_database` as of a
+  // strong read at the time of the call. The schema and its action registry
+  // are shared with the template rather than recreated from DDL, which makes
+  // creating many databases with the same schema cheap. If `copy_data` is
+  // true, the rows of the template visible at that read are copied too. The
+  // databases are independent afterwards: schema changes and writes to either
+  // are not visible in the other.
+  static zetasql_base::StatusOr<std::unique_ptr<Database>> CreateFromTemplate(
+      Database* template_database, bool copy_data);
+
+  // Constructs a database whose schema changes and committed transactions are
+  // recorded in the commit log at `commit_log_path`, so that it can be
+  // recovered after the emulator exits. If the log already has records, the
+  // database is recovered by replaying them and `create_statements` are
+  // ignored. Otherwise the database is created from `create_statements`.
+  static zetasql_base::StatusOr<std::unique_ptr<Database>> CreateWithCommitLog(
+      const std::vector<std::string>& create_statements,
+      const std::string& commit_log_path, CommitLog::SyncPolicy sync_policy);
+
+  // Stops garbage collection of old data versions.
+  ~Database();
 
   // Creates a read only transaction attached to this database.
   zetasql_base::StatusOr<std::unique_ptr<ReadOnlyTransaction>>
   CreateReadOnlyTransaction(const ReadOnlyOptions& options);
 
+  // Runs `read` with a single-use read only transaction, which is allocated on
+  // the stack of the call rather than the heap. The transaction, and any
+  // cursor read from it, must not be used once `read` returns.
+  absl::Status ReadAtSnapshot(
+      const ReadOnlyOptions& options,
+      const std::function<absl::Status(ReadOnlyTransaction*)>& read);
+
   // Creates a read write transaction attached to this database.
   zetasql_base::StatusOr<std::unique_ptr<ReadWriteTransaction>>
   CreateReadWriteTransaction(const ReadWriteOptions& options,
@@ -68,10 +133,18 @@ class Database {
 
   // Updates the schema for this database.
   //
-  // All schema changes are applied synchronously and transactionally.
-  // If there are any transactions or other schema changes already in progress,
-  // incoming schema change requests will be rejected with a FAILED_PRECONDITION
-  // error.
+  // All schema changes are applied synchronously and transactionally. The
+  // backfills and verifications of the statements first run against a
+  // snapshot of the database, while read-write transactions keep committing.
+  // The schema change then takes an exclusive lock on the database, retrying
+  // for a short while if transactions are in progress before it is rejected
+  // with a FAILED_PRECONDITION error. Under the lock, the rows the backfills
+  // wrote to new tables (such as the data tables of new indexes) are written
+  // to the database, unless the backfills changed existing tables, failed, or
+  // read tables which transactions changed since the snapshot: the statements
+  // are then applied again under the lock, and report their progress anew.
+  // Reads are not blocked while a schema change is in progress: strong reads
+  // are served just before the schema change, using the previous schema.
   //
   // DDL statements in `statements` are applied one-by-one until they either all
   // succeed or the first failure is encoutered.
@@ -93,29 +166,143 @@ class Database {
   // If all the statements are found to be semantically valid, but an error is
   // encountered while processing the backfill/verification actions for the
   // statements, then the first such error will be returned in
-  // `backfill_status`.
+  // `backfill_status`. If `cancellation` is not null, the actions stop once it
+  // is cancelled, and its status is returned in `backfill_status`. If
+  // `progress` is set, it receives the progress of the actions of each
+  // statement as they run.
   absl::Status UpdateSchema(absl::Span<const std::string> statements,
                             int* num_succesful_statements,
                             absl::Time* commit_timestamp,
-                            absl::Status* backfill_status);
+                            absl::Status* backfill_status,
+                            const CancellationToken* cancellation = nullptr,
+                            SchemaChangeProgressFn progress = nullptr);
+
+  // Parses `statements` and validates them against the latest schema, without
+  // applying them or running their backfill/verification actions. Returns the
+  // error that UpdateSchema would return for the first invalid statement, so
+  // that invalid statements can be rejected before a schema change is started.
+  // Errors which depend on the data of the database are only detected when
+  // the statements are applied by UpdateSchema.
+  absl::Status ValidateSchemaChange(absl::Span<const std::string> statements);
 
   // Retrives the sdl statements that correspond to the current version of the
-  // schema.
-  std::vector<std::string> GetSchema();
+  // schema. The statements are printed once per schema version, and repeated
+  // calls return a copy of them.
+  std::vector<std::string> GetSchema() ABSL_LOCKS_EXCLUDED(printed_schema_mu_);
+
+  // Writes a snapshot of the schema and data of this database, as of a strong
+  // read at the time of the call, to a new file at `path`. See snapshot.h for
+  // details of the file format.
+  absl::Status WriteSnapshot(const std::string& path);
+
+  // Exports the rows of each table and index of this database, as of a strong
+  // read at the time of the call, to a file of its own in the existing
+  // `directory`, named after the table or index with a ".columns" suffix. The
+  // files hold SnapshotColumns records, which store the rows in columnar form
+  // (see snapshot.proto). Tables are read straight from storage and exported in
+  // parallel. Existing files are replaced.
+  absl::Status ExportTables(const std::string& directory);
+
+  // Records a checkpoint of the data of this database, replacing any previous
+  // checkpoint. Returns FAILED_PRECONDITION if a read-write transaction or
+  // schema change is in progress.
+  absl::Status Checkpoint() ABSL_LOCKS_EXCLUDED(checkpoint_mu_);
+
+  // Resets the data of this database to its checkpoint, discarding all writes
+  // since, much faster than deleting them. Older versions are discarded too, so
+  // reads at timestamps before the reset may see the checkpoint's data. Returns
+  // FAILED_PRECONDITION if there is no checkpoint, if the schema has changed
+  // since it was recorded, if the database has a commit log, which does not
+  // record resets, or if a read-write transaction or schema change is in
+  // progress.
+  absl::Status ResetToCheckpoint() ABSL_LOCKS_EXCLUDED(checkpoint_mu_);
+
+  // Executes a partitioned DML statement, which has been validated with
+  // QueryEngine::IsValidPartitionedDML, over the key space of
+  // `partitioned_table`, the table it modifies. The key space is split into
+  // ranges which are executed in parallel, each in a read-write transaction of
+  // its own which is committed independently and retried if it aborts. The
+  // statement is therefore not applied atomically: on error, some partitions
+  // may already have been committed. Returns the number of modified rows.
+  zetasql_base::StatusOr<int64_t> ExecutePartitionedDml(
+      const Query& query, const std::string& partitioned_table);
+
+  // Approximate memory held by a database, see GetMemoryUsage().
+  struct MemoryUsage {
+    // Bytes held by the rows of each table and index of the latest schema,
+    // including their older versions, keyed by name.
+    absl::flat_hash_map<std::string, int64_t> table_bytes;
+
+    // Bytes held by the mutations buffered in read-write transactions.
+    int64_t transaction_bytes = 0;
+  };
+
+  // Returns the approximate memory held by the database. Schemas are not
+  // accounted for.
+  MemoryUsage GetMemoryUsage() const;
+
+  // Returns the version of the rows of the table or index with the given name
+  // in the latest schema, see Storage::GetTableVersion. Its
+  // max_change_timestamp is the latest commit timestamp at which the rows
+  // were written or deleted, so that caches of data derived from a set of
+  // tables can be validated by checking the versions of these tables alone.
+  // Returns NOT_FOUND if there is no such table or index.
+  zetasql_base::StatusOr<TableVersion> GetTableVersion(
+      const std::string& table_name) const;
+
+  // Returns statistics of the rows of the given table (or index data table) of
+  // any schema of the database, see Storage::GetTableStatistics. Returns
+  // nullopt if the storage keeps no statistics.
+  absl::optional<TableStatistics> GetTableStatistics(const Table* table) const;
+
+  // Reads the changes committed after `after` to the given tables of the
+  // latest schema (or to all tables if `tables` is empty), waiting until
+  // `deadline` for there to be any, see ChangeStream::Read. Consumers tail the
+  // database by passing the commit timestamp of the last change they read.
+  // Returns FAILED_PRECONDITION if changes are not recorded (see
+  // --change_stream_retained_changes) or were already dropped, and NOT_FOUND
+  // if there is no such table.
+  absl::Status ReadChanges(absl::Time after,
+                           const std::vector<std::string>& tables,
+                           int64_t max_changes, absl::Time deadline,
+                           std::vector<Change>* changes) const;
 
   // Used to execute queries against the database.
   QueryEngine* query_engine() { return query_engine_.get(); }
 
  private:
+  friend class DatabaseReplica;
+
   Database();
   // Delete copy and assignment operators since database shouldn't be copyable.
   Database(const Database&) = delete;
   Database& operator=(const Database&) = delete;
 
+  // Constructs a database with its subsystems, other than the catalog and the
+  // garbage collection thread, which are left to the caller.
+  static std::unique_ptr<Database> CreateUninitialized(
+      std::shared_ptr<zetasql::TypeFactory> type_factory);
+
   SchemaChangeContext GetSchemaChangeContext();
 
-  // Clock to provide commit timestamps.
-  Clock* clock_;
+  // Executes the partition of a partitioned DML statement over the rows of
+  // `table` in `range`, and returns the number of modified rows.
+  zetasql_base::StatusOr<int64_t> ExecutePartitionedDmlPartition(const Query& query,
+                                                         const Table* table,
+                                                         const KeyRange& range);
+
+  // Applies a record read from the commit log at `path` during recovery.
+  absl::Status ReplayCommitLogRecord(const std::string& path,
+                                     const CommitLogRecord& record);
+
+  // Periodically garbage collects data versions older than the version
+  // retention period which are not visible to any active read, until the
+  // database is destroyed.
+  void RunGarbageCollection();
+
+  // Clock to provide commit and read timestamps. Each database has its own
+  // clock, so that databases never contend with each other for timestamps.
+  Clock clock_;
 
   // Unique ID generator for TransactionID.
   TransactionIDGenerator transaction_id_generator_;
@@ -132,8 +319,10 @@ class Database {
   // Lock management.
   std::unique_ptr<LockManager> lock_manager_;
 
-  // Type factory used for all ZetaSQL operations on this database.
-  std::unique_ptr<zetasql::TypeFactory> type_factory_;
+  // Type factory used for all ZetaSQL operations on this database. Shared with
+  // the databases created from it as a template, whose schemas refer to its
+  // types.
+  std::shared_ptr<zetasql::TypeFactory> type_factory_;
 
   // Versioned catalog of this database.
   std::unique_ptr<VersionedCatalog> versioned_catalog_;
@@ -141,8 +330,61 @@ class Database {
   // Query engine of the database.
   std::unique_ptr<QueryEngine> query_engine_;
 
+  // Number of ranges of large reads of read-only transactions read in parallel
+  // on the shared executor, or 0 if reads are always performed by the calling
+  // thread.
+  int read_parallelism_ = 0;
+
   // Maintains an action registry per schema.
   std::unique_ptr<ActionManager> action_manager_;
+
+  // Log of schema changes and commits, if the database was created with one.
+  std::unique_ptr<CommitLog> commit_log_;
+
+  // Recently committed changes, or null if changes are not recorded.
+  std::unique_ptr<ChangeStream> change_stream_;
+
+  // Groups the commits of concurrent read-write transactions.
+  std::unique_ptr<CommitPipeline> commit_pipeline_;
+
+  // Budget of the memory held by the rows and the buffered mutations, which
+  // read-write transactions check before buffering inserts and updates.
+  std::unique_ptr<MemoryBudget> memory_budget_;
+
+  // Guards the checkpoint of the database.
+  absl::Mutex checkpoint_mu_;
+
+  // Checkpoint of the storage and the schema it was recorded with, if any.
+  std::unique_ptr<StorageCheckpoint> checkpoint_
+      ABSL_GUARDED_BY(checkpoint_mu_);
+  std::shared_ptr<const Schema> checkpoint_schema_
+      ABSL_GUARDED_BY(checkpoint_mu_);
+
+  // Guards the DDL statements last printed by GetSchema.
+  absl::Mutex printed_schema_mu_;
+
+  // Schema whose DDL statements were last printed by GetSchema, kept alive so
+  // that it is not mistaken for a later schema allocated at the same address,
+  // along with the printed statements.
+  std::shared_ptr<const Schema> printed_schema_
+      ABSL_GUARDED_BY(printed_schema_mu_);
+  std::vector<std::string> printed_ddl_statements_
+      ABSL_GUARDED_BY(printed_schema_mu_);
+
+  // The statements printed for each table of `printed_schema_`, re-used for
+  // the tables which later schemas share with it. Only holds the tables of
+  // `printed_schema_`, which is kept alive, so that a table is never mistaken
+  // for a later one allocated at the same address.
+  using PrintedTables =
+      absl::flat_hash_map<const Table*,
+                          std::shared_ptr<const std::vector<std::string>>>;
+  PrintedTables printed_tables_ ABSL_GUARDED_BY(printed_schema_mu_);
+
+  // Notified when the database is destroyed to stop garbage collection.
+  absl::Notification shutdown_;
+
+  // Thread running garbage collection of old data versions.
+  std::unique_ptr<std::thread> gc_thread_;
 };
 
 }  // namespace backend
@@ -0,0 +1,288 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Measures the commit throughput of an increasing number of databases, each
+// written to by its own thread. Databases share no clock or lock manager, so
+// the total throughput should scale with the number of databases until the
+// machine runs out of cores.
+//
+// Then measures the latency of single-use strong point reads, both through a
+// heap-allocated read-only transaction and through ReadAtSnapshot.
+//
+// Finally measures the throughput of commits made of many single row mutation
+// ops, each of which writes a timestamp, by an increasing number of threads
+// sharing one database.
+//
+// Usage: database_benchmark [--duration=1s] [--max_databases=64]
+//                           [--mutation_ops=1000] [--max_threads=16]
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "zetasql/public/value.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "backend/access/read.h"
+#include "backend/access/write.h"
+#include "backend/database/database.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_set.h"
+#include "backend/transaction/options.h"
+#include "backend/transaction/read_only_transaction.h"
+#include "backend/transaction/read_write_transaction.h"
+#include "absl/status/status.h"
+
+ABSL_FLAG(absl::Duration, duration, absl::Seconds(1),
+          "Time spent committing for each number of databases.");
+ABSL_FLAG(int, max_databases, 64, "Largest number of databases.");
+ABSL_FLAG(int, mutation_ops, 1000,
+          "Number of mutation ops in each commit of the mutation benchmark.");
+ABSL_FLAG(int, max_threads, 16,
+          "Largest number of threads committing to one database.");
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+// Commits single row inserts to `database` until `done` is set, and returns
+// the number of commits.
+int64_t CommitUntilDone(Database* database, const std::atomic<bool>& done) {
+  int64_t commits = 0;
+  while (!done.load(std::memory_order_relaxed)) {
+    auto txn =
+        database->CreateReadWriteTransaction(ReadWriteOptions(), RetryState());
+    if (!txn.ok()) {
+      std::fprintf(stderr, "%s\n", txn.status().ToString().c_str());
+      return commits;
+    }
+    Mutation m;
+    m.AddWriteOp(MutationOpType::kInsert, "T", {"k"},
+                 {{zetasql::values::Int64(commits)}});
+    absl::Status status = (*txn)->Write(m);
+    if (status.ok()) {
+      status = (*txn)->Commit();
+    }
+    if (!status.ok()) {
+      std::fprintf(stderr, "%s\n", status.ToString().c_str());
+      return commits;
+    }
+    ++commits;
+  }
+  return commits;
+}
+
+// Returns the total commits per second of `num_databases` databases written to
+// concurrently for `duration`.
+double CommitsPerSecond(int num_databases, absl::Duration duration) {
+  std::vector<std::unique_ptr<Database>> databases;
+  for (int i = 0; i < num_databases; ++i) {
+    auto database =
+        Database::Create({"CREATE TABLE T(k INT64) PRIMARY KEY(k)"});
+    if (!database.ok()) {
+      std::fprintf(stderr, "%s\n", database.status().ToString().c_str());
+      return 0;
+    }
+    databases.push_back(std::move(database).value());
+  }
+
+  std::atomic<bool> done(false);
+  std::atomic<int64_t> total_commits(0);
+  std::vector<std::thread> threads;
+  for (const std::unique_ptr<Database>& database : databases) {
+    threads.emplace_back([&done, &total_commits, db = database.get()]() {
+      total_commits += CommitUntilDone(db, done);
+    });
+  }
+  absl::SleepFor(duration);
+  done = true;
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return total_commits / absl::ToDoubleSeconds(duration);
+}
+
+// Reads every row of `cursor`.
+absl::Status Drain(RowCursor* cursor) {
+  while (cursor->Next()) {
+  }
+  return cursor->Status();
+}
+
+// Returns the mean latency of strong point reads of `database` for
+// `duration`, each run at a snapshot on the stack if `at_snapshot` is true, or
+// in a read-only transaction created for it otherwise.
+absl::Duration PointReadLatency(Database* database, bool at_snapshot,
+                                absl::Duration duration) {
+  ReadArg read_arg;
+  read_arg.table = "T";
+  read_arg.key_set = KeySet(Key({zetasql::values::Int64(0)}));
+  read_arg.columns = {"k"};
+  auto read = [&read_arg](ReadOnlyTransaction* txn) {
+    std::unique_ptr<RowCursor> cursor;
+    absl::Status status = txn->Read(read_arg, &cursor);
+    return status.ok() ? Drain(cursor.get()) : status;
+  };
+
+  int64_t reads = 0;
+  const absl::Time start = absl::Now();
+  const absl::Time end = start + duration;
+  while (absl::Now() < end) {
+    absl::Status status;
+    if (at_snapshot) {
+      status = database->ReadAtSnapshot(ReadOnlyOptions(), read);
+    } else {
+      auto txn = database->CreateReadOnlyTransaction(ReadOnlyOptions());
+      status = txn.ok() ? read(txn->get()) : txn.status();
+    }
+    if (!status.ok()) {
+      std::fprintf(stderr, "%s\n", status.ToString().c_str());
+      return absl::InfiniteDuration();
+    }
+    ++reads;
+  }
+  return (absl::Now() - start) / reads;
+}
+
+void RunPointReadBenchmark() {
+  auto database = Database::Create({"CREATE TABLE T(k INT64) PRIMARY KEY(k)"});
+  if (!database.ok()) {
+    std::fprintf(stderr, "%s\n", database.status().ToString().c_str());
+    return;
+  }
+  auto txn = (*database)->CreateReadWriteTransaction(ReadWriteOptions(),
+                                                     RetryState());
+  Mutation m;
+  m.AddWriteOp(MutationOpType::kInsert, "T", {"k"},
+               {{zetasql::values::Int64(0)}});
+  absl::Status status = txn.ok() ? (*txn)->Write(m) : txn.status();
+  if (status.ok()) {
+    status = (*txn)->Commit();
+  }
+  if (!status.ok()) {
+    std::fprintf(stderr, "%s\n", status.ToString().c_str());
+    return;
+  }
+
+  const absl::Duration duration = absl::GetFlag(FLAGS_duration);
+  std::printf("\n%-24s %16s\n", "point read", "latency us");
+  std::printf("%-24s %16.3f\n", "transaction",
+              absl::ToDoubleMicroseconds(PointReadLatency(
+                  database->get(), /*at_snapshot=*/false, duration)));
+  std::printf("%-24s %16.3f\n", "snapshot",
+              absl::ToDoubleMicroseconds(PointReadLatency(
+                  database->get(), /*at_snapshot=*/true, duration)));
+}
+
+// Commits transactions of `num_ops` single row inserts to `database`, with keys
+// starting at `first_key` and increasing, until `done` is set, and returns the
+// number of commits.
+int64_t CommitMutationOpsUntilDone(Database* database, int64_t first_key,
+                                   int num_ops, const std::atomic<bool>& done) {
+  int64_t commits = 0;
+  int64_t key = first_key;
+  while (!done.load(std::memory_order_relaxed)) {
+    Mutation m;
+    for (int i = 0; i < num_ops; ++i) {
+      m.AddWriteOp(MutationOpType::kInsert, "T", {"k", "ts"},
+                   {{zetasql::values::Int64(key++),
+                     zetasql::values::Timestamp(absl::UnixEpoch())}});
+    }
+    auto txn =
+        database->CreateReadWriteTransaction(ReadWriteOptions(), RetryState());
+    absl::Status status = txn.ok() ? (*txn)->Write(m) : txn.status();
+    if (status.ok()) {
+      status = (*txn)->Commit();
+    }
+    if (!status.ok()) {
+      std::fprintf(stderr, "%s\n", status.ToString().c_str());
+      return commits;
+    }
+    ++commits;
+  }
+  return commits;
+}
+
+void RunMutationOpsBenchmark() {
+  const absl::Duration duration = absl::GetFlag(FLAGS_duration);
+  const int num_ops = absl::GetFlag(FLAGS_mutation_ops);
+  std::printf("\n%10s %16s %16s\n", "threads", "commits/s", "mutation ops/s");
+  for (int num_threads = 1; num_threads <= absl::GetFlag(FLAGS_max_threads);
+       num_threads *= 2) {
+    auto database = Database::Create(
+        {"CREATE TABLE T(k INT64, ts TIMESTAMP OPTIONS "
+         "(allow_commit_timestamp = true)) PRIMARY KEY(k)"});
+    if (!database.ok()) {
+      std::fprintf(stderr, "%s\n", database.status().ToString().c_str());
+      return;
+    }
+    std::atomic<bool> done(false);
+    std::atomic<int64_t> total_commits(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; ++i) {
+      // Each thread writes its own key range, so that commits do not conflict.
+      threads.emplace_back([&done, &total_commits, db = database->get(),
+                            first_key = int64_t{i} << 40, num_ops]() {
+        total_commits += CommitMutationOpsUntilDone(db, first_key, num_ops,
+                                                    done);
+      });
+    }
+    absl::SleepFor(duration);
+    done = true;
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    const double commits_per_second =
+        total_commits / absl::ToDoubleSeconds(duration);
+    std::printf("%10d %16.0f %16.0f\n", num_threads, commits_per_second,
+                commits_per_second * num_ops);
+  }
+}
+
+void RunBenchmark() {
+  const absl::Duration duration = absl::GetFlag(FLAGS_duration);
+  std::printf("%10s %16s %24s\n", "databases", "commits/s",
+              "commits/s per database");
+  for (int num_databases = 1;
+       num_databases <= absl::GetFlag(FLAGS_max_databases);
+       num_databases *= 2) {
+    const double commits_per_second =
+        CommitsPerSecond(num_databases, duration);
+    std::printf("%10d %16.0f %24.0f\n", num_databases, commits_per_second,
+                commits_per_second / num_databases);
+  }
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  google::spanner::emulator::backend::RunBenchmark();
+  google::spanner::emulator::backend::RunPointReadBenchmark();
+  google::spanner::emulator::backend::RunMutationOpsBenchmark();
+  return 0;
+}
@@ -16,21 +16,29 @@
 
 #include "backend/database/database.h"
 
+#include <cstdint>
+#include <cstdio>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "zetasql/public/value.pb.h"
 #include "zetasql/base/testing/status_matchers.h"
 #include "tests/common/proto_matchers.h"
 #include "absl/status/status.h"
 #include "backend/access/read.h"
 #include "backend/common/ids.h"
+#include "backend/database/snapshot.h"
+#include "backend/database/snapshot.pb.h"
 #include "backend/datamodel/key_set.h"
+#include "backend/query/query_engine.h"
+#include "backend/transaction/commit_log.h"
 #include "backend/transaction/options.h"
-#include "common/clock.h"
 #include "common/errors.h"
+#include "zetasql/base/status_macros.h"
 #include "zetasql/base/statusor.h"
 
 namespace google {
@@ -52,15 +60,12 @@ class DatabaseTest : public ::testing::Test {
     args.columns = std::vector<std::string>{column_name};
     return args;
   }
-
- protected:
-  Clock clock_;
 };
 
 TEST_F(DatabaseTest, CreateSuccessful) {
-  ZETASQL_EXPECT_OK(Database::Create(&clock_, /*create_statements=*/{}));
+  ZETASQL_EXPECT_OK(Database::Create(/*create_statements=*/{}));
 
-  ZETASQL_EXPECT_OK(Database::Create(&clock_, {R"(
+  ZETASQL_EXPECT_OK(Database::Create({R"(
     CREATE TABLE T(
       k1 INT64,
       k2 INT64,
@@ -72,7 +77,7 @@ TEST_F(DatabaseTest, CreateSuccessful) {
 
 TEST_F(DatabaseTest, UpdateSchemaSuccessful) {
   ZETASQL_ASSERT_OK_AND_ASSIGN(auto db,
-                       Database::Create(&clock_, /*create_statements=*/{}));
+                       Database::Create(/*create_statements=*/{}));
 
   std::vector<std::string> update_statements = {R"(
     CREATE TABLE T(
@@ -92,8 +97,54 @@ TEST_F(DatabaseTest, UpdateSchemaSuccessful) {
   ZETASQL_EXPECT_OK(backfill_status);
 }
 
+TEST_F(DatabaseTest, GetSchemaReturnsDdlOfLatestSchema) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      auto db, Database::Create({"CREATE TABLE T(k INT64) PRIMARY KEY(k)"}));
+  std::vector<std::string> ddl_statements = db->GetSchema();
+  ASSERT_EQ(ddl_statements.size(), 1);
+  EXPECT_EQ(db->GetSchema(), ddl_statements);
+
+  absl::Status backfill_status;
+  int completed_statements;
+  absl::Time commit_ts;
+  ZETASQL_ASSERT_OK(db->UpdateSchema({"CREATE INDEX I ON T(k)"},
+                             &completed_statements, &commit_ts,
+                             &backfill_status));
+  ZETASQL_ASSERT_OK(backfill_status);
+  ddl_statements = db->GetSchema();
+  ASSERT_EQ(ddl_statements.size(), 2);
+  EXPECT_THAT(ddl_statements[1], testing::HasSubstr("CREATE INDEX I"));
+  EXPECT_EQ(db->GetSchema(), ddl_statements);
+}
+
+TEST_F(DatabaseTest, GetSchemaReflectsTablesAddedAlteredAndDropped) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      auto db, Database::Create({"CREATE TABLE A(k INT64) PRIMARY KEY(k)",
+                                 "CREATE TABLE B(k INT64) PRIMARY KEY(k)",
+                                 "CREATE TABLE C(k INT64) PRIMARY KEY(k)"}));
+  std::vector<std::string> ddl_statements = db->GetSchema();
+  ASSERT_EQ(ddl_statements.size(), 3);
+
+  // The statements of the table the change does not touch are re-used, and
+  // those of the others printed again.
+  absl::Status backfill_status;
+  int completed_statements;
+  absl::Time commit_ts;
+  ZETASQL_ASSERT_OK(db->UpdateSchema(
+      {"CREATE INDEX AByK ON A(k)", "DROP TABLE B",
+       "CREATE TABLE D(k INT64) PRIMARY KEY(k)"},
+      &completed_statements, &commit_ts, &backfill_status));
+  ZETASQL_ASSERT_OK(backfill_status);
+  std::vector<std::string> updated = db->GetSchema();
+  ASSERT_EQ(updated.size(), 4);
+  EXPECT_THAT(updated[0], testing::HasSubstr("CREATE TABLE A"));
+  EXPECT_THAT(updated[1], testing::HasSubstr("CREATE INDEX AByK"));
+  EXPECT_EQ(updated[2], ddl_statements[2]);
+  EXPECT_THAT(updated[3], testing::HasSubstr("CREATE TABLE D"));
+}
+
 TEST_F(DatabaseTest, UpdateSchemaPartialSuccess) {
-  ZETASQL_ASSERT_OK_AND_ASSIGN(auto db, Database::Create(&clock_, {R"(
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto db, Database::Create({R"(
     CREATE TABLE T(
       k1 INT64,
       k2 INT64,
@@ -145,7 +196,7 @@ TEST_F(DatabaseTest, UpdateSchemaPartialSuccess) {
 }
 
 TEST_F(DatabaseTest, ConcurrentSchemaChangeIsAborted) {
-  ZETASQL_ASSERT_OK_AND_ASSIGN(auto db, Database::Create(&clock_, {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto db, Database::Create({
                                                               R"(
     CREATE TABLE T(
       k1 INT64,
@@ -165,7 +216,7 @@ TEST_F(DatabaseTest, ConcurrentSchemaChangeIsAborted) {
   absl::Time commit_ts;
   EXPECT_EQ(
       db->UpdateSchema({R"(
-    CREATE TABLE T(
+    CREATE TABLE U(
       k1 INT64,
       k2 INT64,
     ) PRIMARY KEY(k1)
@@ -174,8 +225,99 @@ TEST_F(DatabaseTest, ConcurrentSchemaChangeIsAborted) {
       error::ConcurrentSchemaChangeOrReadWriteTxnInProgress());
 }
 
+TEST_F(DatabaseTest, ReadWriteTransactionsCommitWhileBackfillsRun) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto db, Database::Create({R"(
+    CREATE TABLE T(
+      k1 INT64,
+      k2 INT64,
+    ) PRIMARY KEY(k1))"}));
+  auto insert = [&](int64_t k1, int64_t k2) -> absl::Status {
+    ZETASQL_ASSIGN_OR_RETURN(
+        std::unique_ptr<ReadWriteTransaction> txn,
+        db->CreateReadWriteTransaction(ReadWriteOptions(), RetryState()));
+    Mutation m;
+    m.AddWriteOp(MutationOpType::kInsert, "T", {"k1", "k2"},
+                 {{Int64(k1), Int64(k2)}});
+    ZETASQL_RETURN_IF_ERROR(txn->Write(m));
+    return txn->Commit();
+  };
+  ZETASQL_ASSERT_OK(insert(1, 30));
+
+  // A transaction commits to the indexed table once the index has been
+  // backfilled, before the schema change takes its lock, so the backfill runs
+  // again under the lock and sees the new row.
+  bool inserted = false;
+  auto progress = [&](int statement_index, int progress_percent) {
+    if (progress_percent == 100 && !inserted) {
+      inserted = true;
+      ZETASQL_EXPECT_OK(insert(2, 20));
+    }
+  };
+  absl::Status backfill_status;
+  int completed_statements;
+  absl::Time commit_ts;
+  ZETASQL_ASSERT_OK(db->UpdateSchema({"CREATE INDEX I ON T(k2)"},
+                             &completed_statements, &commit_ts,
+                             &backfill_status, /*cancellation=*/nullptr,
+                             progress));
+  ZETASQL_ASSERT_OK(backfill_status);
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<ReadOnlyTransaction> read_txn,
+                       db->CreateReadOnlyTransaction(ReadOnlyOptions()));
+  ReadArg args = read_column("T", "k1");
+  args.index = "I";
+  std::unique_ptr<RowCursor> cursor;
+  ZETASQL_ASSERT_OK(read_txn->Read(args, &cursor));
+  std::vector<zetasql::Value> keys;
+  while (cursor->Next()) {
+    keys.push_back(cursor->ColumnValue(0));
+  }
+  ZETASQL_EXPECT_OK(cursor->Status());
+  EXPECT_THAT(keys, testing::ElementsAre(Int64(2), Int64(1)));
+}
+
+TEST_F(DatabaseTest, AppliesStagedBackfillsWhenNothingChanged) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto db, Database::Create({R"(
+    CREATE TABLE T(
+      k1 INT64,
+      k2 INT64,
+    ) PRIMARY KEY(k1))"}));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ReadWriteTransaction> txn,
+      db->CreateReadWriteTransaction(ReadWriteOptions(), RetryState()));
+  Mutation m;
+  m.AddWriteOp(MutationOpType::kInsert, "T", {"k1", "k2"},
+               {{Int64(1), Int64(30)}, {Int64(2), Int64(20)}});
+  ZETASQL_ASSERT_OK(txn->Write(m));
+  ZETASQL_ASSERT_OK(txn->Commit());
+
+  absl::Status backfill_status;
+  int completed_statements;
+  absl::Time commit_ts;
+  ZETASQL_ASSERT_OK(db->UpdateSchema({"CREATE INDEX I ON T(k2)"},
+                             &completed_statements, &commit_ts,
+                             &backfill_status));
+  ZETASQL_ASSERT_OK(backfill_status);
+
+  // The staged index entries are written at the schema change's timestamp.
+  ZETASQL_ASSERT_OK_AND_ASSIGN(TableVersion version, db->GetTableVersion("I"));
+  EXPECT_EQ(version.max_change_timestamp, commit_ts);
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<ReadOnlyTransaction> read_txn,
+                       db->CreateReadOnlyTransaction(ReadOnlyOptions()));
+  ReadArg args = read_column("T", "k1");
+  args.index = "I";
+  std::unique_ptr<RowCursor> cursor;
+  ZETASQL_ASSERT_OK(read_txn->Read(args, &cursor));
+  std::vector<zetasql::Value> keys;
+  while (cursor->Next()) {
+    keys.push_back(cursor->ColumnValue(0));
+  }
+  ZETASQL_EXPECT_OK(cursor->Status());
+  EXPECT_THAT(keys, testing::ElementsAre(Int64(2), Int64(1)));
+}
+
 TEST_F(DatabaseTest, SchemaChangeLocksSuccesfullyReleased) {
-  ZETASQL_ASSERT_OK_AND_ASSIGN(auto db, Database::Create(&clock_, {R"(
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto db, Database::Create({R"(
     CREATE TABLE T(
       k1 INT64,
       k2 INT64,
@@ -204,6 +346,551 @@ TEST_F(DatabaseTest, SchemaChangeLocksSuccesfullyReleased) {
   ZETASQL_EXPECT_OK(txn->Commit());
 }
 
+TEST_F(DatabaseTest, RestoresSchemaAndDataFromSnapshot) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto db, Database::Create({R"(
+    CREATE TABLE T(
+      k1 INT64,
+      k2 INT64,
+    ) PRIMARY KEY(k1 DESC))",
+                                                          R"(
+    CREATE INDEX I on T(k2))"}));
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ReadWriteTransaction> txn,
+      db->CreateReadWriteTransaction(ReadWriteOptions(), RetryState()));
+  Mutation m;
+  m.AddWriteOp(MutationOpType::kInsert, "T", {"k1", "k2"},
+               {{Int64(1), Int64(20)}, {Int64(2), Int64(10)}});
+  m.AddWriteOp(MutationOpType::kInsert, "T", {"k1"}, {{Int64(3)}});
+  ZETASQL_ASSERT_OK(txn->Write(m));
+  ZETASQL_ASSERT_OK(txn->Commit());
+
+  std::string path = ::testing::TempDir() + "/database_snapshot";
+  ZETASQL_ASSERT_OK(db->WriteSnapshot(path));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto restored,
+                       Database::CreateFromSnapshot(path));
+  EXPECT_EQ(restored->GetSchema(), db->GetSchema());
+
+  // Rows are restored in key order, including the descending primary key.
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ReadOnlyTransaction> read_txn,
+      restored->CreateReadOnlyTransaction(ReadOnlyOptions()));
+  ReadArg args = read_column("T", "k1");
+  args.columns.push_back("k2");
+  std::unique_ptr<RowCursor> cursor;
+  ZETASQL_ASSERT_OK(read_txn->Read(args, &cursor));
+  std::vector<std::pair<zetasql::Value, zetasql::Value>> rows;
+  while (cursor->Next()) {
+    rows.emplace_back(cursor->ColumnValue(0), cursor->ColumnValue(1));
+  }
+  ZETASQL_EXPECT_OK(cursor->Status());
+  EXPECT_THAT(rows,
+              testing::ElementsAre(
+                  std::make_pair(Int64(3), zetasql::values::NullInt64()),
+                  std::make_pair(Int64(2), Int64(10)),
+                  std::make_pair(Int64(1), Int64(20))));
+
+  // Index data is restored as well.
+  args.index = "I";
+  ZETASQL_ASSERT_OK(read_txn->Read(args, &cursor));
+  std::vector<zetasql::Value> keys;
+  while (cursor->Next()) {
+    keys.push_back(cursor->ColumnValue(0));
+  }
+  EXPECT_THAT(keys, testing::ElementsAre(Int64(3), Int64(2), Int64(1)));
+}
+
+TEST_F(DatabaseTest, CreatesIndependentDatabasesFromTemplate) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto db, Database::Create({R"(
+    CREATE TABLE T(
+      k1 INT64,
+      k2 INT64,
+    ) PRIMARY KEY(k1))",
+                                                          R"(
+    CREATE INDEX I on T(k2))"}));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ReadWriteTransaction> txn,
+      db->CreateReadWriteTransaction(ReadWriteOptions(), RetryState()));
+  Mutation m;
+  m.AddWriteOp(MutationOpType::kInsert, "T", {"k1", "k2"},
+               {{Int64(1), Int64(20)}, {Int64(2), Int64(10)}});
+  ZETASQL_ASSERT_OK(txn->Write(m));
+  ZETASQL_ASSERT_OK(txn->Commit());
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto empty_clone,
+                       Database::CreateFromTemplate(db.get(),
+                                                    /*copy_data=*/false));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto clone, Database::CreateFromTemplate(
+                                       db.get(), /*copy_data=*/true));
+  EXPECT_EQ(empty_clone->GetSchema(), db->GetSchema());
+  EXPECT_EQ(clone->GetSchema(), db->GetSchema());
+
+  auto read_keys = [&](Database* database, const std::string& index) {
+    auto read_txn = database->CreateReadOnlyTransaction(ReadOnlyOptions());
+    ZETASQL_EXPECT_OK(read_txn.status());
+    ReadArg args = read_column("T", "k1");
+    args.index = index;
+    std::unique_ptr<RowCursor> cursor;
+    ZETASQL_EXPECT_OK(read_txn.value()->Read(args, &cursor));
+    std::vector<zetasql::Value> keys;
+    while (cursor->Next()) {
+      keys.push_back(cursor->ColumnValue(0));
+    }
+    return keys;
+  };
+  EXPECT_THAT(read_keys(empty_clone.get(), ""), testing::IsEmpty());
+  EXPECT_THAT(read_keys(clone.get(), ""),
+              testing::ElementsAre(Int64(1), Int64(2)));
+  EXPECT_THAT(read_keys(clone.get(), "I"),
+              testing::ElementsAre(Int64(2), Int64(1)));
+
+  // Writes and schema changes to a clone are not visible in the template,
+  // and the clone outlives the template.
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      txn, clone->CreateReadWriteTransaction(ReadWriteOptions(), RetryState()));
+  Mutation clone_mutation;
+  clone_mutation.AddWriteOp(MutationOpType::kInsert, "T", {"k1", "k2"},
+                            {{Int64(3), Int64(0)}});
+  ZETASQL_ASSERT_OK(txn->Write(clone_mutation));
+  ZETASQL_ASSERT_OK(txn->Commit());
+  int num_succesful_statements;
+  absl::Time commit_timestamp;
+  absl::Status backfill_status;
+  ZETASQL_ASSERT_OK(clone->UpdateSchema(
+      {"CREATE TABLE U(k INT64) PRIMARY KEY(k)"}, &num_succesful_statements,
+      &commit_timestamp, &backfill_status));
+  ZETASQL_ASSERT_OK(backfill_status);
+  EXPECT_THAT(read_keys(db.get(), ""),
+              testing::ElementsAre(Int64(1), Int64(2)));
+  EXPECT_EQ(db->GetSchema().size(), 2);
+
+  db.reset();
+  EXPECT_THAT(read_keys(clone.get(), "I"),
+              testing::ElementsAre(Int64(3), Int64(2), Int64(1)));
+  EXPECT_EQ(clone->GetSchema().size(), 3);
+}
+
+TEST_F(DatabaseTest, ResetsDataToCheckpoint) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto db, Database::Create({R"(
+    CREATE TABLE T(
+      k1 INT64,
+      k2 INT64,
+    ) PRIMARY KEY(k1))"}));
+  EXPECT_THAT(db->ResetToCheckpoint(),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kFailedPrecondition));
+
+  auto insert = [&](int64_t key) {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<ReadWriteTransaction> txn,
+        db->CreateReadWriteTransaction(ReadWriteOptions(), RetryState()));
+    Mutation m;
+    m.AddWriteOp(MutationOpType::kInsert, "T", {"k1", "k2"},
+                 {{Int64(key), Int64(key)}});
+    ZETASQL_ASSERT_OK(txn->Write(m));
+    ZETASQL_ASSERT_OK(txn->Commit());
+  };
+  auto read_keys = [&]() {
+    auto read_txn = db->CreateReadOnlyTransaction(ReadOnlyOptions());
+    ZETASQL_EXPECT_OK(read_txn.status());
+    std::unique_ptr<RowCursor> cursor;
+    ZETASQL_EXPECT_OK(read_txn.value()->Read(read_column("T", "k1"), &cursor));
+    std::vector<zetasql::Value> keys;
+    while (cursor->Next()) {
+      keys.push_back(cursor->ColumnValue(0));
+    }
+    return keys;
+  };
+
+  insert(1);
+  ZETASQL_ASSERT_OK(db->Checkpoint());
+  insert(2);
+  insert(3);
+  EXPECT_THAT(read_keys(), testing::ElementsAre(Int64(1), Int64(2), Int64(3)));
+
+  ZETASQL_ASSERT_OK(db->ResetToCheckpoint());
+  EXPECT_THAT(read_keys(), testing::ElementsAre(Int64(1)));
+
+  // Keys written since the checkpoint can be inserted again after a reset.
+  insert(2);
+  ZETASQL_ASSERT_OK(db->ResetToCheckpoint());
+  EXPECT_THAT(read_keys(), testing::ElementsAre(Int64(1)));
+
+  int num_succesful_statements;
+  absl::Time commit_timestamp;
+  absl::Status backfill_status;
+  ZETASQL_ASSERT_OK(db->UpdateSchema({"CREATE TABLE U(k INT64) PRIMARY KEY(k)"},
+                             &num_succesful_statements, &commit_timestamp,
+                             &backfill_status));
+  EXPECT_THAT(db->ResetToCheckpoint(),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST_F(DatabaseTest, ReportsMemoryUsageOfTablesAndIndexes) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto db, Database::Create({R"(
+    CREATE TABLE T(
+      k1 INT64,
+      k2 INT64,
+    ) PRIMARY KEY(k1))",
+                                                  "CREATE INDEX I ON T(k2)"}));
+  Database::MemoryUsage usage = db->GetMemoryUsage();
+  EXPECT_THAT(usage.table_bytes,
+              testing::UnorderedElementsAre(testing::Pair("T", 0),
+                                            testing::Pair("I", 0)));
+  EXPECT_EQ(usage.transaction_bytes, 0);
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ReadWriteTransaction> txn,
+      db->CreateReadWriteTransaction(ReadWriteOptions(), RetryState()));
+  Mutation m;
+  m.AddWriteOp(MutationOpType::kInsert, "T", {"k1", "k2"},
+               {{Int64(1), Int64(2)}});
+  ZETASQL_ASSERT_OK(txn->Write(m));
+  EXPECT_GT(db->GetMemoryUsage().transaction_bytes, 0);
+
+  ZETASQL_ASSERT_OK(txn->Commit());
+  usage = db->GetMemoryUsage();
+  EXPECT_GT(usage.table_bytes["T"], 0);
+  EXPECT_GT(usage.table_bytes["I"], 0);
+  EXPECT_EQ(usage.transaction_bytes, 0);
+}
+
+TEST_F(DatabaseTest, ReportsVersionsOfTablesAndIndexes) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto db, Database::Create({R"(
+    CREATE TABLE T(
+      k1 INT64,
+      k2 INT64,
+    ) PRIMARY KEY(k1))",
+                                                  R"(
+    CREATE TABLE U(
+      k1 INT64,
+    ) PRIMARY KEY(k1))",
+                                                  "CREATE INDEX I ON T(k2)"}));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(TableVersion t_version,
+                       db->GetTableVersion("T"));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(TableVersion u_version,
+                       db->GetTableVersion("U"));
+  EXPECT_EQ(t_version.max_change_timestamp, absl::InfinitePast());
+  EXPECT_THAT(db->GetTableVersion("V"),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ReadWriteTransaction> txn,
+      db->CreateReadWriteTransaction(ReadWriteOptions(), RetryState()));
+  Mutation m;
+  m.AddWriteOp(MutationOpType::kInsert, "T", {"k1", "k2"},
+               {{Int64(1), Int64(2)}});
+  ZETASQL_ASSERT_OK(txn->Write(m));
+  ZETASQL_ASSERT_OK(txn->Commit());
+  ZETASQL_ASSERT_OK_AND_ASSIGN(absl::Time commit_timestamp,
+                       txn->GetCommitTimestamp());
+
+  // Only the versions of the table and index written to change.
+  ZETASQL_ASSERT_OK_AND_ASSIGN(TableVersion version, db->GetTableVersion("T"));
+  EXPECT_NE(version, t_version);
+  EXPECT_EQ(version.max_change_timestamp, commit_timestamp);
+  ZETASQL_ASSERT_OK_AND_ASSIGN(version, db->GetTableVersion("I"));
+  EXPECT_EQ(version.max_change_timestamp, commit_timestamp);
+  EXPECT_THAT(db->GetTableVersion("U"),
+              zetasql_base::testing::IsOkAndHolds(u_version));
+}
+
+TEST_F(DatabaseTest, ReadAtSnapshotSeesCommittedRows) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      auto db, Database::Create({"CREATE TABLE T(k1 INT64) PRIMARY KEY(k1)"}));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ReadWriteTransaction> txn,
+      db->CreateReadWriteTransaction(ReadWriteOptions(), RetryState()));
+  Mutation m;
+  m.AddWriteOp(MutationOpType::kInsert, "T", {"k1"}, {{Int64(1)}, {Int64(2)}});
+  ZETASQL_ASSERT_OK(txn->Write(m));
+  ZETASQL_ASSERT_OK(txn->Commit());
+  ZETASQL_ASSERT_OK_AND_ASSIGN(absl::Time commit_timestamp,
+                       txn->GetCommitTimestamp());
+
+  std::vector<int64_t> keys;
+  ZETASQL_EXPECT_OK(db->ReadAtSnapshot(
+      ReadOnlyOptions(), [&](ReadOnlyTransaction* read_txn) -> absl::Status {
+        EXPECT_GE(read_txn->read_timestamp(), commit_timestamp);
+        std::unique_ptr<RowCursor> cursor;
+        ZETASQL_RETURN_IF_ERROR(
+            read_txn->Read(read_column("T", "k1"), &cursor));
+        while (cursor->Next()) {
+          keys.push_back(cursor->ColumnValue(0).int64_value());
+        }
+        return cursor->Status();
+      }));
+  EXPECT_THAT(keys, testing::ElementsAre(1, 2));
+}
+
+TEST_F(DatabaseTest, ExecutesPartitionedDmlOverAllKeyRanges) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto db, Database::Create({R"(
+    CREATE TABLE T(
+      k1 INT64,
+      k2 INT64,
+    ) PRIMARY KEY(k1))"}));
+
+  // Insert enough rows for the statement to be split into several ranges.
+  constexpr int kNumRows = 40 * 1000;
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ReadWriteTransaction> txn,
+      db->CreateReadWriteTransaction(ReadWriteOptions(), RetryState()));
+  std::vector<std::vector<zetasql::Value>> values;
+  for (int i = 0; i < kNumRows; ++i) {
+    values.push_back({Int64(i), Int64(0)});
+  }
+  Mutation m;
+  m.AddWriteOp(MutationOpType::kInsert, "T", {"k1", "k2"}, values);
+  ZETASQL_ASSERT_OK(txn->Write(m));
+  ZETASQL_ASSERT_OK(txn->Commit());
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      int64_t modified_row_count,
+      db->ExecutePartitionedDml(
+          Query{"UPDATE T SET k2 = k1 + 1 WHERE k1 >= 10"}, "T"));
+  EXPECT_EQ(modified_row_count, kNumRows - 10);
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<ReadOnlyTransaction> read_txn,
+                       db->CreateReadOnlyTransaction(ReadOnlyOptions()));
+  ReadArg args = read_column("T", "k1");
+  args.columns.push_back("k2");
+  std::unique_ptr<RowCursor> cursor;
+  ZETASQL_ASSERT_OK(read_txn->Read(args, &cursor));
+  int num_rows = 0;
+  while (cursor->Next()) {
+    int64_t k1 = cursor->ColumnValue(0).int64_value();
+    EXPECT_EQ(cursor->ColumnValue(1), Int64(k1 >= 10 ? k1 + 1 : 0));
+    ++num_rows;
+  }
+  ZETASQL_EXPECT_OK(cursor->Status());
+  EXPECT_EQ(num_rows, kNumRows);
+}
+
+// Returns a SnapshotRows record of `table_name` with the given non-key
+// `column_names`, for rows of a single INT64 key column and INT64 values.
+SnapshotRows MakeImportRecord(
+    const std::string& table_name, std::vector<std::string> column_names,
+    const std::vector<std::vector<int64_t>>& rows) {
+  SnapshotRows record;
+  record.set_table_name(table_name);
+  for (const std::string& column_name : column_names) {
+    record.add_column_names(column_name);
+  }
+  for (const std::vector<int64_t>& row : rows) {
+    SnapshotRows::Row* record_row = record.add_rows();
+    ZETASQL_EXPECT_OK(Int64(row[0]).Serialize(record_row->add_key()));
+    for (int i = 1; i < row.size(); ++i) {
+      ZETASQL_EXPECT_OK(Int64(row[i]).Serialize(record_row->add_values()));
+    }
+  }
+  return record;
+}
+
+TEST_F(DatabaseTest, BulkImportsRowsAndBuildsIndexes) {
+  std::string path = ::testing::TempDir() + "/database_bulk_import";
+  {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(auto writer, SnapshotWriter::Create(path));
+    ZETASQL_ASSERT_OK(writer->Append(
+        MakeImportRecord("T", {"k2"}, {{1, 30}, {2, 20}})));
+    ZETASQL_ASSERT_OK(writer->Append(MakeImportRecord("T", {"k2"}, {{3, 10}})));
+    ZETASQL_ASSERT_OK(writer->Close());
+  }
+  const std::vector<std::string> schema = {R"(
+    CREATE TABLE T(
+      k1 INT64,
+      k2 INT64,
+    ) PRIMARY KEY(k1))",
+                                           R"(
+    CREATE UNIQUE INDEX I on T(k2))"};
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto db, Database::CreateWithBulkImport(schema, path));
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<ReadOnlyTransaction> read_txn,
+                       db->CreateReadOnlyTransaction(ReadOnlyOptions()));
+  ReadArg args = read_column("T", "k1");
+  args.columns.push_back("k2");
+  std::unique_ptr<RowCursor> cursor;
+  ZETASQL_ASSERT_OK(read_txn->Read(args, &cursor));
+  std::vector<std::pair<zetasql::Value, zetasql::Value>> rows;
+  while (cursor->Next()) {
+    rows.emplace_back(cursor->ColumnValue(0), cursor->ColumnValue(1));
+  }
+  ZETASQL_EXPECT_OK(cursor->Status());
+  EXPECT_THAT(rows, testing::ElementsAre(std::make_pair(Int64(1), Int64(30)),
+                                         std::make_pair(Int64(2), Int64(20)),
+                                         std::make_pair(Int64(3), Int64(10))));
+
+  // The index is built from the imported rows.
+  args.index = "I";
+  ZETASQL_ASSERT_OK(read_txn->Read(args, &cursor));
+  std::vector<zetasql::Value> keys;
+  while (cursor->Next()) {
+    keys.push_back(cursor->ColumnValue(0));
+  }
+  EXPECT_THAT(keys, testing::ElementsAre(Int64(3), Int64(2), Int64(1)));
+}
+
+TEST_F(DatabaseTest, BulkImportVerifiesConstraintsOfAllRows) {
+  const std::vector<std::string> schema = {R"(
+    CREATE TABLE Parent(
+      k1 INT64,
+    ) PRIMARY KEY(k1))",
+                                           R"(
+    CREATE TABLE Child(
+      k1 INT64,
+      k2 INT64 NOT NULL,
+    ) PRIMARY KEY(k1),
+      INTERLEAVE IN PARENT Parent)"};
+  std::string path = ::testing::TempDir() + "/database_bulk_import_invalid";
+
+  // Rows must be in increasing key order.
+  {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(auto writer, SnapshotWriter::Create(path));
+    ZETASQL_ASSERT_OK(writer->Append(MakeImportRecord("Parent", {}, {{2}, {1}})));
+    ZETASQL_ASSERT_OK(writer->Close());
+  }
+  EXPECT_THAT(Database::CreateWithBulkImport(schema, path),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kInvalidArgument));
+
+  // NOT NULL columns must be imported.
+  {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(auto writer, SnapshotWriter::Create(path));
+    ZETASQL_ASSERT_OK(writer->Append(MakeImportRecord("Parent", {}, {{1}})));
+    ZETASQL_ASSERT_OK(writer->Append(MakeImportRecord("Child", {}, {{1}})));
+    ZETASQL_ASSERT_OK(writer->Close());
+  }
+  EXPECT_THAT(Database::CreateWithBulkImport(schema, path),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kFailedPrecondition));
+
+  // Child rows must have a parent row.
+  {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(auto writer, SnapshotWriter::Create(path));
+    ZETASQL_ASSERT_OK(writer->Append(MakeImportRecord("Parent", {}, {{1}})));
+    ZETASQL_ASSERT_OK(
+        writer->Append(MakeImportRecord("Child", {"k2"}, {{1, 0}, {2, 0}})));
+    ZETASQL_ASSERT_OK(writer->Close());
+  }
+  EXPECT_THAT(Database::CreateWithBulkImport(schema, path),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+}
+
+// Returns the INT64 values of each column in a file written by ExportTables.
+std::vector<std::vector<int64_t>> ReadExportedColumns(const std::string& path) {
+  std::vector<std::vector<int64_t>> columns;
+  zetasql_base::StatusOr<std::unique_ptr<SnapshotReader>> reader =
+      SnapshotReader::Open(path);
+  ZETASQL_EXPECT_OK(reader.status());
+  SnapshotColumns record;
+  while (reader.ok()) {
+    zetasql_base::StatusOr<bool> has_record = reader.value()->Next(&record);
+    ZETASQL_EXPECT_OK(has_record.status());
+    if (!has_record.ok() || !has_record.value()) {
+      break;
+    }
+    columns.resize(record.columns_size());
+    for (int i = 0; i < record.columns_size(); ++i) {
+      for (const zetasql::ValueProto& value : record.columns(i).values()) {
+        columns[i].push_back(value.int64_value());
+      }
+    }
+  }
+  return columns;
+}
+
+TEST_F(DatabaseTest, ExportsTablesInColumnarForm) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto db, Database::Create({R"(
+    CREATE TABLE T(
+      k1 INT64,
+      k2 INT64,
+    ) PRIMARY KEY(k1))",
+                                                          R"(
+    CREATE INDEX I on T(k2))"}));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ReadWriteTransaction> txn,
+      db->CreateReadWriteTransaction(ReadWriteOptions(), RetryState()));
+  Mutation m;
+  m.AddWriteOp(MutationOpType::kInsert, "T", {"k1", "k2"},
+               {{Int64(1), Int64(20)}, {Int64(2), Int64(10)}});
+  ZETASQL_ASSERT_OK(txn->Write(m));
+  ZETASQL_ASSERT_OK(txn->Commit());
+
+  ZETASQL_ASSERT_OK(db->ExportTables(::testing::TempDir()));
+
+  // Each table and index is exported to a file of its own, column by column.
+  EXPECT_THAT(ReadExportedColumns(::testing::TempDir() + "/T.columns"),
+              testing::ElementsAre(testing::ElementsAre(1, 2),
+                                   testing::ElementsAre(20, 10)));
+  EXPECT_THAT(ReadExportedColumns(::testing::TempDir() + "/I.columns"),
+              testing::ElementsAre(testing::ElementsAre(10, 20),
+                                   testing::ElementsAre(2, 1)));
+}
+
+TEST_F(DatabaseTest, CreateFromMissingSnapshotFails) {
+  EXPECT_FALSE(Database::CreateFromSnapshot(::testing::TempDir() + "/missing_snapshot")
+                   .ok());
+}
+
+TEST_F(DatabaseTest, RecoversSchemaAndDataFromCommitLog) {
+  std::string path = ::testing::TempDir() + "/database_commit_log";
+  std::remove(path.c_str());
+  std::vector<std::string> schema;
+  {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        auto db, Database::CreateWithCommitLog({R"(
+          CREATE TABLE T(
+            k1 INT64,
+            k2 INT64,
+          ) PRIMARY KEY(k1))"},
+                                               path,
+                                               CommitLog::SyncPolicy::kAlways));
+
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<ReadWriteTransaction> txn,
+        db->CreateReadWriteTransaction(ReadWriteOptions(), RetryState()));
+    Mutation m;
+    m.AddWriteOp(MutationOpType::kInsert, "T", {"k1", "k2"},
+                 {{Int64(1), Int64(10)}, {Int64(2), Int64(20)}});
+    ZETASQL_ASSERT_OK(txn->Write(m));
+    ZETASQL_ASSERT_OK(txn->Commit());
+
+    int num_succesful;
+    absl::Status backfill_status;
+    absl::Time update_time;
+    ZETASQL_ASSERT_OK(db->UpdateSchema({"CREATE INDEX I ON T(k2)"}, &num_succesful,
+                               &update_time, &backfill_status));
+    ZETASQL_ASSERT_OK(backfill_status);
+
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        txn, db->CreateReadWriteTransaction(ReadWriteOptions(), RetryState()));
+    Mutation delete_mutation;
+    KeySet key_set;
+    key_set.AddKey(Key({Int64(1)}));
+    delete_mutation.AddDeleteOp("T", key_set);
+    ZETASQL_ASSERT_OK(txn->Write(delete_mutation));
+    ZETASQL_ASSERT_OK(txn->Commit());
+    schema = db->GetSchema();
+  }
+
+  // Create statements are ignored when recovering from an existing log.
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      auto recovered,
+      Database::CreateWithCommitLog({}, path,
+                                    CommitLog::SyncPolicy::kAlways));
+  EXPECT_EQ(recovered->GetSchema(), schema);
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ReadOnlyTransaction> read_txn,
+      recovered->CreateReadOnlyTransaction(ReadOnlyOptions()));
+  ReadArg args = read_column("T", "k1");
+  args.index = "I";
+  std::unique_ptr<RowCursor> cursor;
+  ZETASQL_ASSERT_OK(read_txn->Read(args, &cursor));
+  std::vector<zetasql::Value> keys;
+  while (cursor->Next()) {
+    keys.push_back(cursor->ColumnValue(0));
+  }
+  ZETASQL_EXPECT_OK(cursor->Status());
+  EXPECT_THAT(keys, testing::ElementsAre(Int64(2)));
+}
+
 }  // namespace
 }  // namespace backend
 }  // namespace emulator
@@ -0,0 +1,149 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/database/replica.h"
+
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "backend/database/database.h"
+#include "backend/transaction/commit_log.h"
+#include "backend/transaction/commit_log.pb.h"
+#include "backend/transaction/options.h"
+#include "common/config.h"
+#include "common/errors.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+zetasql_base::StatusOr<std::unique_ptr<DatabaseReplica>> DatabaseReplica::Create(
+    const std::string& commit_log_path) {
+  auto replica = absl::WrapUnique(new DatabaseReplica(commit_log_path));
+  ZETASQL_RETURN_IF_ERROR(replica->CatchUp().status());
+  if (replica->database_ == nullptr) {
+    return error::InvalidCommitLog(commit_log_path, "it has no records");
+  }
+  return replica;
+}
+
+DatabaseReplica::~DatabaseReplica() {
+  shutdown_.Notify();
+  if (tailing_thread_ != nullptr) {
+    tailing_thread_->join();
+  }
+}
+
+zetasql_base::StatusOr<int> DatabaseReplica::CatchUp() {
+  absl::MutexLock lock(&apply_mu_);
+  int num_applied = 0;
+  ZETASQL_RETURN_IF_ERROR(CommitLog::ReplayFrom(
+      commit_log_path_, &offset_,
+      [&](const CommitLogRecord& record) -> absl::Status {
+        ZETASQL_RETURN_IF_ERROR(Apply(record));
+        ++num_applied;
+        return absl::OkStatus();
+      }));
+  return num_applied;
+}
+
+absl::Status DatabaseReplica::Apply(const CommitLogRecord& record) {
+  if (database_ == nullptr) {
+    ZETASQL_ASSIGN_OR_RETURN(database_, Database::Create(std::vector<std::string>(
+                                    record.ddl_statements().begin(),
+                                    record.ddl_statements().end())));
+  } else {
+    ZETASQL_RETURN_IF_ERROR(
+        database_->ReplayCommitLogRecord(commit_log_path_, record));
+  }
+
+  // The record is visible at any later timestamp of the replica.
+  const absl::Time replica_timestamp = database_->clock_.Now();
+  const absl::Time commit_timestamp =
+      absl::FromUnixMicros(record.commit_timestamp_micros());
+  absl::MutexLock lock(&mu_);
+  replica_timestamps_[commit_timestamp] = replica_timestamp;
+
+  // Versions older than the retention period are garbage collected, but the
+  // last entry before the horizon still maps the reads of the timestamps
+  // between it and the next entry.
+  const absl::Time horizon =
+      replica_timestamp - config::version_retention_period();
+  auto it = replica_timestamps_.begin();
+  while (std::next(it) != replica_timestamps_.end() &&
+         std::next(it)->second <= horizon) {
+    it = replica_timestamps_.erase(it);
+  }
+  return absl::OkStatus();
+}
+
+void DatabaseReplica::StartTailing(absl::Duration poll_interval) {
+  tailing_thread_ = absl::make_unique<std::thread>(
+      &DatabaseReplica::Tail, this, poll_interval);
+}
+
+void DatabaseReplica::Tail(absl::Duration poll_interval) {
+  while (!shutdown_.WaitForNotificationWithTimeout(poll_interval)) {
+    absl::Status status = CatchUp().status();
+    if (!status.ok()) {
+      absl::MutexLock lock(&mu_);
+      tailing_status_ = status;
+      return;
+    }
+  }
+}
+
+absl::Time DatabaseReplica::applied_watermark() const {
+  absl::MutexLock lock(&mu_);
+  return replica_timestamps_.rbegin()->first;
+}
+
+absl::Status DatabaseReplica::ReadAtSnapshot(
+    absl::Time read_timestamp,
+    const std::function<absl::Status(ReadOnlyTransaction*)>& read) {
+  ReadOnlyOptions options;
+  options.bound = TimestampBound::kExactTimestamp;
+  {
+    absl::MutexLock lock(&mu_);
+    ZETASQL_RETURN_IF_ERROR(tailing_status_);
+    const absl::Time watermark = replica_timestamps_.rbegin()->first;
+    if (read_timestamp > watermark) {
+      return error::ReadTimestampPastReplicaWatermark(read_timestamp,
+                                                      watermark);
+    }
+    auto it = replica_timestamps_.upper_bound(read_timestamp);
+    if (it == replica_timestamps_.begin()) {
+      return error::ReadTimestampPastVersionGCLimit(read_timestamp);
+    }
+    options.timestamp = std::prev(it)->second;
+  }
+  return database_->ReadAtSnapshot(options, read);
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,142 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_DATABASE_REPLICA_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_DATABASE_REPLICA_H_
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "backend/database/database.h"
+#include "backend/query/query_engine.h"
+#include "backend/transaction/commit_log.pb.h"
+#include "backend/transaction/read_only_transaction.h"
+#include "absl/status/status.h"
+#include "zetasql/base/statusor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// DatabaseReplica is a read-only replica of a database created with a commit
+// log (see Database::CreateWithCommitLog), which it tails to apply the schema
+// changes and transactions committed to the database. The database may run in
+// this process or in another one. Each replica has its own storage, lock
+// manager and query engine, so snapshot reads spread over several replicas
+// do not contend with each other nor with the writes of the database.
+//
+// Records are applied in the order they were logged, which is the order of
+// their commit timestamps, and the applied watermark is the commit timestamp
+// of the last record applied. A snapshot read at a timestamp of the database
+// at or before the watermark sees exactly the commits at or before that
+// timestamp. More recent reads are rejected, so that a replica never serves
+// data which would be stale for the timestamp read.
+//
+// Records are re-applied at timestamps of the replica's own clock, which is
+// therefore the time of the read-only transactions of the replica, see
+// ReadAtSnapshot().
+//
+// This class is thread-safe.
+class DatabaseReplica {
+ public:
+  // Creates a replica of the database whose commit log is at
+  // `commit_log_path`, applying all the records already in the log. Fails if
+  // the log has no records yet.
+  static zetasql_base::StatusOr<std::unique_ptr<DatabaseReplica>> Create(
+      const std::string& commit_log_path);
+
+  // Stops tailing the log.
+  ~DatabaseReplica();
+
+  // Applies the records appended to the log since the last call. Returns the
+  // number of records applied.
+  zetasql_base::StatusOr<int> CatchUp() ABSL_LOCKS_EXCLUDED(apply_mu_);
+
+  // Starts a thread which catches up with the log every `poll_interval` until
+  // the replica is destroyed. If catching up fails, the thread stops and reads
+  // return the error. Must be called at most once.
+  void StartTailing(absl::Duration poll_interval);
+
+  // Returns the commit timestamp of the last record applied to the replica.
+  absl::Time applied_watermark() const ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Runs `read` with a single-use read-only transaction of the replica which
+  // sees the commits of the database at or before `read_timestamp`. The
+  // transaction reads at the corresponding timestamp of the replica. Returns
+  // UNAVAILABLE if `read_timestamp` is after the applied watermark, and
+  // FAILED_PRECONDITION if it is before the versions the replica retains.
+  absl::Status ReadAtSnapshot(
+      absl::Time read_timestamp,
+      const std::function<absl::Status(ReadOnlyTransaction*)>& read)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Used to execute queries in the transactions of ReadAtSnapshot().
+  QueryEngine* query_engine() { return database_->query_engine(); }
+
+ private:
+  explicit DatabaseReplica(const std::string& commit_log_path)
+      : commit_log_path_(commit_log_path) {}
+
+  // Applies a record of the log, the first of which creates the database.
+  absl::Status Apply(const CommitLogRecord& record)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(apply_mu_);
+
+  // Catches up with the log every `poll_interval` until shutdown.
+  void Tail(absl::Duration poll_interval);
+
+  const std::string commit_log_path_;
+
+  // The replicated database. Created by the first record of the log, before
+  // the replica is returned by Create().
+  std::unique_ptr<Database> database_;
+
+  // Serializes the application of records.
+  absl::Mutex apply_mu_;
+
+  // Offset in the log of the next record to apply.
+  int64_t offset_ ABSL_GUARDED_BY(apply_mu_) = 0;
+
+  mutable absl::Mutex mu_;
+
+  // Timestamps of the replica at which the records applied are visible, keyed
+  // by their commit timestamps in the database. Entries are dropped once the
+  // replica no longer retains the versions they map to.
+  std::map<absl::Time, absl::Time> replica_timestamps_ ABSL_GUARDED_BY(mu_);
+
+  // The error which stopped the tailing thread, if any.
+  absl::Status tailing_status_ ABSL_GUARDED_BY(mu_);
+
+  absl::Notification shutdown_;
+
+  // Thread tailing the log, if started.
+  std::unique_ptr<std::thread> tailing_thread_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_DATABASE_REPLICA_H_
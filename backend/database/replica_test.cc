@@ -0,0 +1,156 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/database/replica.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/public/value.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "absl/time/time.h"
+#include "backend/access/read.h"
+#include "backend/access/write.h"
+#include "backend/database/database.h"
+#include "backend/datamodel/key_set.h"
+#include "backend/transaction/commit_log.h"
+#include "backend/transaction/options.h"
+#include "backend/transaction/read_only_transaction.h"
+#include "backend/transaction/read_write_transaction.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql::values::Int64;
+using zetasql_base::testing::IsOkAndHolds;
+using zetasql_base::testing::StatusIs;
+
+class DatabaseReplicaTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = ::testing::TempDir() + "/replica_commit_log";
+    std::remove(path_.c_str());
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        primary_,
+        Database::CreateWithCommitLog(
+            {"CREATE TABLE T(k INT64, v INT64) PRIMARY KEY(k)"}, path_,
+            CommitLog::SyncPolicy::kAlways));
+  }
+
+  // Inserts row (`k`, `k`) to the primary and returns its commit timestamp.
+  absl::Time Insert(int64_t k) {
+    auto txn = primary_->CreateReadWriteTransaction(ReadWriteOptions(),
+                                                    RetryState());
+    EXPECT_TRUE(txn.ok());
+    Mutation m;
+    m.AddWriteOp(MutationOpType::kInsert, "T", {"k", "v"},
+                 {{Int64(k), Int64(k)}});
+    ZETASQL_EXPECT_OK((*txn)->Write(m));
+    ZETASQL_EXPECT_OK((*txn)->Commit());
+    auto commit_timestamp = (*txn)->GetCommitTimestamp();
+    EXPECT_TRUE(commit_timestamp.ok());
+    return *commit_timestamp;
+  }
+
+  // Returns the keys of T read from `replica` at `read_timestamp`.
+  zetasql_base::StatusOr<std::vector<zetasql::Value>> ReadKeys(
+      DatabaseReplica* replica, absl::Time read_timestamp) {
+    std::vector<zetasql::Value> keys;
+    ZETASQL_RETURN_IF_ERROR(replica->ReadAtSnapshot(
+        read_timestamp, [&](ReadOnlyTransaction* txn) -> absl::Status {
+          ReadArg args;
+          args.table = "T";
+          args.key_set = KeySet::All();
+          args.columns = {"k"};
+          std::unique_ptr<RowCursor> cursor;
+          ZETASQL_RETURN_IF_ERROR(txn->Read(args, &cursor));
+          while (cursor->Next()) {
+            keys.push_back(cursor->ColumnValue(0));
+          }
+          return cursor->Status();
+        }));
+    return keys;
+  }
+
+  std::string path_;
+  std::unique_ptr<Database> primary_;
+};
+
+TEST_F(DatabaseReplicaTest, ReadsCommitsAtOrBeforeTheReadTimestamp) {
+  absl::Time first = Insert(1);
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DatabaseReplica> replica,
+                       DatabaseReplica::Create(path_));
+  EXPECT_EQ(replica->applied_watermark(), first);
+
+  absl::Time second = Insert(2);
+  ZETASQL_ASSERT_OK_AND_ASSIGN(int num_applied, replica->CatchUp());
+  EXPECT_EQ(num_applied, 1);
+  EXPECT_EQ(replica->applied_watermark(), second);
+
+  EXPECT_THAT(ReadKeys(replica.get(), first - absl::Microseconds(1)),
+              IsOkAndHolds(testing::IsEmpty()));
+  EXPECT_THAT(ReadKeys(replica.get(), first),
+              IsOkAndHolds(testing::ElementsAre(Int64(1))));
+  EXPECT_THAT(ReadKeys(replica.get(), second),
+              IsOkAndHolds(testing::ElementsAre(Int64(1), Int64(2))));
+}
+
+TEST_F(DatabaseReplicaTest, RejectsReadsPastTheAppliedWatermark) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DatabaseReplica> replica,
+                       DatabaseReplica::Create(path_));
+  absl::Time commit_timestamp = Insert(1);
+  EXPECT_THAT(ReadKeys(replica.get(), commit_timestamp),
+              StatusIs(absl::StatusCode::kUnavailable));
+
+  ZETASQL_ASSERT_OK(replica->CatchUp().status());
+  EXPECT_THAT(ReadKeys(replica.get(), commit_timestamp),
+              IsOkAndHolds(testing::ElementsAre(Int64(1))));
+}
+
+TEST_F(DatabaseReplicaTest, TailsTheLog) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DatabaseReplica> replica,
+                       DatabaseReplica::Create(path_));
+  replica->StartTailing(absl::Milliseconds(1));
+  absl::Time commit_timestamp = Insert(1);
+  while (replica->applied_watermark() < commit_timestamp) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  EXPECT_THAT(ReadKeys(replica.get(), commit_timestamp),
+              IsOkAndHolds(testing::ElementsAre(Int64(1))));
+}
+
+TEST_F(DatabaseReplicaTest, FailsOnAnEmptyLog) {
+  std::string path = ::testing::TempDir() + "/empty_commit_log";
+  std::remove(path.c_str());
+  EXPECT_THAT(DatabaseReplica::Create(path),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,173 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/database/snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+
+#include "google/protobuf/message.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "common/errors.h"
+#include "zetasql/base/statusor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// Size of the length prefix of each record.
+constexpr size_t kRecordSizeBytes = sizeof(uint64_t);
+
+}  // namespace
+
+SnapshotWriter::SnapshotWriter(const std::string& path)
+    : path_(path),
+      file_(path, std::ios::binary | std::ios::out | std::ios::trunc) {}
+
+zetasql_base::StatusOr<std::unique_ptr<SnapshotWriter>> SnapshotWriter::Create(
+    const std::string& path) {
+  auto writer = absl::WrapUnique(new SnapshotWriter(path));
+  if (!writer->file_.is_open()) {
+    return error::SnapshotIOError(path, "create", std::strerror(errno));
+  }
+  return writer;
+}
+
+absl::Status SnapshotWriter::Append(const google::protobuf::Message& record) {
+  std::string serialized;
+  if (!record.SerializeToString(&serialized)) {
+    return error::Internal(
+        absl::StrCat("Failed to serialize snapshot record ",
+                     record.GetDescriptor()->full_name()));
+  }
+
+  char size[kRecordSizeBytes];
+  uint64_t record_size = serialized.size();
+  for (int i = 0; i < kRecordSizeBytes; ++i) {
+    size[i] = static_cast<char>((record_size >> (8 * i)) & 0xff);
+  }
+  file_.write(size, kRecordSizeBytes);
+  file_.write(serialized.data(), serialized.size());
+  if (!file_.good()) {
+    return error::SnapshotIOError(path_, "write", std::strerror(errno));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status SnapshotWriter::Close() {
+  file_.close();
+  if (file_.fail()) {
+    return error::SnapshotIOError(path_, "write", std::strerror(errno));
+  }
+  return absl::OkStatus();
+}
+
+SnapshotReader::SnapshotReader(const std::string& path, const char* data,
+                               size_t size)
+    : path_(path), data_(data), size_(size) {}
+
+SnapshotReader::~SnapshotReader() {
+  if (size_ > 0) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+zetasql_base::StatusOr<std::unique_ptr<SnapshotReader>> SnapshotReader::Open(
+    const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return error::SnapshotIOError(path, "open", std::strerror(errno));
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    absl::Status status =
+        error::SnapshotIOError(path, "open", std::strerror(errno));
+    close(fd);
+    return status;
+  }
+
+  // Empty files cannot be mapped, they are reported as missing the header by
+  // the caller.
+  size_t size = file_stat.st_size;
+  const char* data = nullptr;
+  if (size > 0) {
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      absl::Status status =
+          error::SnapshotIOError(path, "map", std::strerror(errno));
+      close(fd);
+      return status;
+    }
+    // Records are read sequentially.
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(mapping);
+  }
+
+  // The mapping remains valid after the file is closed.
+  close(fd);
+  return absl::WrapUnique(new SnapshotReader(path, data, size));
+}
+
+zetasql_base::StatusOr<bool> SnapshotReader::Next(
+    google::protobuf::Message* record) {
+  if (offset_ == size_) {
+    return false;
+  }
+  if (size_ - offset_ < kRecordSizeBytes) {
+    return error::InvalidSnapshot(path_, "truncated record size");
+  }
+
+  uint64_t record_size = 0;
+  for (int i = 0; i < kRecordSizeBytes; ++i) {
+    record_size |= static_cast<uint64_t>(
+                       static_cast<unsigned char>(data_[offset_ + i]))
+                   << (8 * i);
+  }
+  offset_ += kRecordSizeBytes;
+  if (record_size > size_ - offset_) {
+    return error::InvalidSnapshot(path_, "truncated record");
+  }
+  if (record_size > std::numeric_limits<int>::max()) {
+    return error::InvalidSnapshot(path_, "record is too large");
+  }
+
+  if (!record->ParseFromArray(data_ + offset_, record_size)) {
+    return error::InvalidSnapshot(
+        path_, absl::StrCat("failed to parse ",
+                            record->GetDescriptor()->full_name()));
+  }
+  offset_ += record_size;
+  return true;
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,101 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_DATABASE_SNAPSHOT_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_DATABASE_SNAPSHOT_H_
+
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "google/protobuf/message.h"
+#include "absl/status/status.h"
+#include "zetasql/base/statusor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// Version of the snapshot format written by SnapshotWriter.
+constexpr int kSnapshotVersion = 1;
+
+// A database snapshot file is a sequence of records. Each record is a
+// serialized proto message prefixed by its size as a 64-bit little-endian
+// integer. The first record is a SnapshotHeader and the remaining records are
+// SnapshotRows chunks (see snapshot.proto).
+//
+// SnapshotWriter appends records to a new snapshot file. This class is not
+// thread-safe.
+class SnapshotWriter {
+ public:
+  // Creates a writer for a new snapshot file at `path`, replacing any existing
+  // file.
+  static zetasql_base::StatusOr<std::unique_ptr<SnapshotWriter>> Create(
+      const std::string& path);
+
+  // Appends a record to the snapshot.
+  absl::Status Append(const google::protobuf::Message& record);
+
+  // Flushes and closes the snapshot file. No records can be appended after.
+  absl::Status Close();
+
+ private:
+  explicit SnapshotWriter(const std::string& path);
+
+  // Path of the snapshot file.
+  const std::string path_;
+
+  // The snapshot file being written.
+  std::ofstream file_;
+};
+
+// SnapshotReader reads the records of a snapshot file. The file is mapped into
+// memory and records are parsed from the mapping in place, so reading does not
+// copy the file. This class is not thread-safe.
+class SnapshotReader {
+ public:
+  // Opens and maps the snapshot file at `path`.
+  static zetasql_base::StatusOr<std::unique_ptr<SnapshotReader>> Open(
+      const std::string& path);
+
+  ~SnapshotReader();
+
+  // Parses the next record into `record`. Returns false if there are no more
+  // records.
+  zetasql_base::StatusOr<bool> Next(google::protobuf::Message* record);
+
+ private:
+  SnapshotReader(const std::string& path, const char* data, size_t size);
+
+  // Path of the snapshot file.
+  const std::string path_;
+
+  // The memory mapped contents of the snapshot file.
+  const char* const data_;
+  const size_t size_;
+
+  // Offset of the next record within data_.
+  size_t offset_ = 0;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_DATABASE_SNAPSHOT_H_
@@ -0,0 +1,119 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/database/snapshot.h"
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "tests/common/proto_matchers.h"
+#include "absl/status/status.h"
+#include "backend/database/snapshot.pb.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql_base::testing::StatusIs;
+
+class SnapshotTest : public testing::Test {
+ protected:
+  std::string path_ = testing::TempDir() + "/snapshot_test";
+};
+
+TEST_F(SnapshotTest, ReadsRecordsInWrittenOrder) {
+  SnapshotHeader header;
+  header.set_version(kSnapshotVersion);
+  header.add_ddl_statements("CREATE TABLE T (k INT64) PRIMARY KEY (k)");
+  SnapshotRows rows;
+  rows.set_table_name("T");
+  rows.add_column_names("k");
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<SnapshotWriter> writer,
+                       SnapshotWriter::Create(path_));
+  ZETASQL_ASSERT_OK(writer->Append(header));
+  ZETASQL_ASSERT_OK(writer->Append(rows));
+  ZETASQL_ASSERT_OK(writer->Close());
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<SnapshotReader> reader,
+                       SnapshotReader::Open(path_));
+  SnapshotHeader read_header;
+  EXPECT_THAT(reader->Next(&read_header),
+              zetasql_base::testing::IsOkAndHolds(true));
+  EXPECT_THAT(read_header, test::EqualsProto(header));
+  SnapshotRows read_rows;
+  EXPECT_THAT(reader->Next(&read_rows),
+              zetasql_base::testing::IsOkAndHolds(true));
+  EXPECT_THAT(read_rows, test::EqualsProto(rows));
+  EXPECT_THAT(reader->Next(&read_rows),
+              zetasql_base::testing::IsOkAndHolds(false));
+}
+
+TEST_F(SnapshotTest, EmptyFileHasNoRecords) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<SnapshotWriter> writer,
+                       SnapshotWriter::Create(path_));
+  ZETASQL_ASSERT_OK(writer->Close());
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<SnapshotReader> reader,
+                       SnapshotReader::Open(path_));
+  SnapshotHeader header;
+  EXPECT_THAT(reader->Next(&header),
+              zetasql_base::testing::IsOkAndHolds(false));
+}
+
+TEST_F(SnapshotTest, TruncatedRecordIsInvalid) {
+  SnapshotHeader header;
+  header.set_version(kSnapshotVersion);
+  header.add_ddl_statements("CREATE TABLE T (k INT64) PRIMARY KEY (k)");
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<SnapshotWriter> writer,
+                       SnapshotWriter::Create(path_));
+  ZETASQL_ASSERT_OK(writer->Append(header));
+  ZETASQL_ASSERT_OK(writer->Close());
+
+  // Drop the last byte of the record.
+  std::string contents;
+  {
+    std::ifstream file(path_, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(file),
+                    std::istreambuf_iterator<char>());
+  }
+  {
+    std::ofstream file(path_, std::ios::binary | std::ios::trunc);
+    file.write(contents.data(), contents.size() - 1);
+  }
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<SnapshotReader> reader,
+                       SnapshotReader::Open(path_));
+  EXPECT_THAT(reader->Next(&header),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST_F(SnapshotTest, OpenMissingFileFails) {
+  EXPECT_THAT(SnapshotReader::Open(path_ + "_missing"),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
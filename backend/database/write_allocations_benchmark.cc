@@ -0,0 +1,158 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Counts the heap allocations made while buffering a mutation in a read-write
+// transaction, per row, for each type of mutation on a table with an index.
+// Mutations are built before counting starts, so only the work of resolving,
+// flattening, running the actions and buffering the rows is counted.
+//
+// Usage: write_allocations_benchmark [--rows=100]
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/value.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "backend/access/write.h"
+#include "backend/database/database.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_set.h"
+#include "backend/transaction/options.h"
+#include "backend/transaction/read_write_transaction.h"
+#include "absl/status/status.h"
+
+ABSL_FLAG(int, rows, 100, "Number of rows written by each mutation.");
+
+namespace {
+
+std::atomic<int64_t> allocations(0);
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+// Returns a mutation of type `type` on rows [0, `num_rows`) of T.
+Mutation MakeMutation(MutationOpType type, int num_rows) {
+  std::vector<ValueList> rows;
+  for (int i = 0; i < num_rows; ++i) {
+    rows.push_back({zetasql::values::Int64(i),
+                    zetasql::values::String(std::to_string(i))});
+  }
+  Mutation m;
+  m.AddWriteOp(type, "T", {"k", "v"}, std::move(rows));
+  return m;
+}
+
+// Writes `m` to a transaction in which the rows of `setup` are already
+// buffered, and returns the number of allocations the write made, or -1 on
+// error.
+int64_t CountAllocations(Database* database, const Mutation& setup,
+                         const Mutation& m) {
+  auto txn =
+      database->CreateReadWriteTransaction(ReadWriteOptions(), RetryState());
+  absl::Status status = txn.ok() ? (*txn)->Write(setup) : txn.status();
+  if (!status.ok()) {
+    std::fprintf(stderr, "%s\n", status.ToString().c_str());
+    return -1;
+  }
+  const int64_t before = allocations.load();
+  status = (*txn)->Write(m);
+  const int64_t after = allocations.load();
+  if (!status.ok()) {
+    std::fprintf(stderr, "%s\n", status.ToString().c_str());
+    return -1;
+  }
+  return after - before;
+}
+
+void RunBenchmark() {
+  auto database = Database::Create({
+      "CREATE TABLE T(k INT64, v STRING(MAX)) PRIMARY KEY(k)",
+      "CREATE INDEX TByV ON T(v)",
+  });
+  if (!database.ok()) {
+    std::fprintf(stderr, "%s\n", database.status().ToString().c_str());
+    return;
+  }
+
+  const int num_rows = absl::GetFlag(FLAGS_rows);
+  const Mutation empty;
+  const Mutation inserted = MakeMutation(MutationOpType::kInsert, num_rows);
+  struct Case {
+    const char* name;
+    const Mutation* setup;
+    MutationOpType type;
+  };
+  const Case cases[] = {
+      {"insert", &empty, MutationOpType::kInsert},
+      {"update", &inserted, MutationOpType::kUpdate},
+      {"insert_or_update", &inserted, MutationOpType::kInsertOrUpdate},
+      {"replace", &inserted, MutationOpType::kReplace},
+      {"delete", &inserted, MutationOpType::kDelete},
+  };
+
+  std::printf("%-24s %16s %16s\n", "mutation", "allocations", "per row");
+  for (const Case& c : cases) {
+    Mutation m;
+    if (c.type == MutationOpType::kDelete) {
+      for (int i = 0; i < num_rows; ++i) {
+        m.AddDeleteOp("T", KeySet(Key({zetasql::values::Int64(i)})));
+      }
+    } else {
+      m = MakeMutation(c.type, num_rows);
+    }
+    const int64_t count = CountAllocations(database->get(), *c.setup, m);
+    std::printf("%-24s %16lld %16.1f\n", c.name,
+                static_cast<long long>(count),  // NOLINT
+                static_cast<double>(count) / num_rows);
+  }
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  google::spanner::emulator::backend::RunBenchmark();
+  return 0;
+}
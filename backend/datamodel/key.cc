@@ -16,8 +16,12 @@
 
 #include "backend/datamodel/key.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <sstream>
 
+#include "absl/time/time.h"
+
 namespace google {
 namespace spanner {
 namespace emulator {
@@ -54,29 +58,102 @@ int64_t LogicalBytesInternal(const zetasql::Value& value) {
   }
 }
 
+// Returns -1, 0 or 1 as `a` is less than, equal to or greater than `b`.
+template <typename T>
+int ThreeWayCompare(const T& a, const T& b) {
+  return a < b ? -1 : (b < a ? 1 : 0);
+}
+
+// Performs a three-way comparison of two key column values in ascending order,
+// ordering nulls first as zetasql::Value does.
+//
+// The key column types are dispatched on once per column, and values are
+// compared directly, instead of through the generic Value::LessThan and
+// Value::Equals.
+int CompareColumnValues(const zetasql::Value& a, const zetasql::Value& b) {
+  if (a.is_null() || b.is_null()) {
+    return ThreeWayCompare(!a.is_null(), !b.is_null());
+  }
+  if (a.type_kind() == b.type_kind()) {
+    switch (a.type_kind()) {
+      case zetasql::TYPE_INT64:
+        return ThreeWayCompare(a.int64_value(), b.int64_value());
+      case zetasql::TYPE_STRING: {
+        const int result = a.string_value().compare(b.string_value());
+        return ThreeWayCompare(result, 0);
+      }
+      case zetasql::TYPE_BYTES: {
+        const int result = a.bytes_value().compare(b.bytes_value());
+        return ThreeWayCompare(result, 0);
+      }
+      case zetasql::TYPE_TIMESTAMP:
+        return ThreeWayCompare(a.ToTime(), b.ToTime());
+      case zetasql::TYPE_NUMERIC:
+        return ThreeWayCompare(a.numeric_value(), b.numeric_value());
+      case zetasql::TYPE_DATE:
+        return ThreeWayCompare(a.date_value(), b.date_value());
+      case zetasql::TYPE_BOOL:
+        return ThreeWayCompare(a.bool_value(), b.bool_value());
+      default:
+        // Other types, e.g. DOUBLE, whose ordering of NaNs Value defines.
+        break;
+    }
+  }
+  if (a.LessThan(b)) {
+    return -1;
+  }
+  return a.Equals(b) ? 0 : 1;
+}
+
 }  // namespace
 
 Key::Key() {}
 
-Key::Key(std::vector<zetasql::Value> columns)
-    : columns_(std::move(columns)), is_descending_(columns_.size()) {}
+Key::Key(std::vector<zetasql::Value> columns) : columns_(std::move(columns)) {
+  if (columns_.size() > kMaskColumns) {
+    overflow_descending_.resize(columns_.size() - kMaskColumns);
+  }
+  for (const zetasql::Value& value : columns_) {
+    logical_size_ += LogicalBytesInternal(value);
+  }
+}
 
 void Key::AddColumn(zetasql::Value value, bool desc) {
+  logical_size_ += LogicalBytesInternal(value);
   columns_.emplace_back(std::move(value));
-  is_descending_.push_back(desc);
+  if (columns_.size() > kMaskColumns) {
+    overflow_descending_.push_back(desc);
+  } else if (desc) {
+    descending_mask_ |= uint64_t{1} << (columns_.size() - 1);
+  }
 }
 
 int Key::NumColumns() const { return columns_.size(); }
 
 void Key::SetColumnValue(int i, zetasql::Value value) {
+  logical_size_ +=
+      LogicalBytesInternal(value) - LogicalBytesInternal(columns_[i]);
   columns_[i] = std::move(value);
 }
 
-void Key::SetColumnDescending(int i, bool value) { is_descending_[i] = value; }
+void Key::SetColumnDescending(int i, bool value) {
+  if (i >= kMaskColumns) {
+    overflow_descending_[i - kMaskColumns] = value;
+  } else if (value) {
+    descending_mask_ |= uint64_t{1} << i;
+  } else {
+    descending_mask_ &= ~(uint64_t{1} << i);
+  }
+}
 
 const zetasql::Value& Key::ColumnValue(int i) const { return columns_[i]; }
 
-bool Key::IsColumnDescending(int i) const { return is_descending_[i]; }
+bool Key::IsColumnDescending(int i) const {
+  if (i >= kMaskColumns) {
+    return overflow_descending_[i - kMaskColumns];
+  }
+  return (descending_mask_ >> i) & 1;
+}
 
 int Key::Compare(const Key& other) const {
   // Handle infinity keys first.
@@ -94,15 +171,10 @@ int Key::Compare(const Key& other) const {
       return other.is_prefix_limit_ ? -1 : 1;
     }
 
-    if (columns_[i].LessThan(other.columns_[i])) {
-      return is_descending_[i] ? 1 : -1;
+    const int result = CompareColumnValues(columns_[i], other.columns_[i]);
+    if (result != 0) {
+      return IsColumnDescending(i) ? -result : result;
     }
-
-    if (columns_[i].Equals(other.columns_[i])) {
-      continue;
-    }
-
-    return is_descending_[i] ? -1 : 1;
   }
 
   // If we reached here, *this is a prefix of other.
@@ -136,8 +208,18 @@ Key Key::ToPrefixLimit() const {
 
 Key Key::Prefix(int n) const {
   Key k = (*this);
+  for (int i = n; i < k.columns_.size(); ++i) {
+    k.logical_size_ -= LogicalBytesInternal(k.columns_[i]);
+  }
   k.columns_.resize(n);
-  k.is_descending_.resize(n);
+  if (n < kMaskColumns) {
+    k.descending_mask_ &= (uint64_t{1} << n) - 1;
+  }
+  k.overflow_descending_.resize(std::max(n - kMaskColumns, 0));
+  // A strict prefix of a prefix limit key is a regular key.
+  if (n < NumColumns()) {
+    k.is_prefix_limit_ = false;
+  }
   return k;
 }
 
@@ -163,14 +245,6 @@ bool Key::IsPrefixOf(const Key& other) const {
   return is_prefix_limit_ == other.is_prefix_limit_;
 }
 
-int64_t Key::LogicalSizeInBytes() const {
-  int64_t key_size = 0;
-  for (int i = 0; i < NumColumns(); ++i) {
-    key_size += LogicalBytesInternal(ColumnValue(i));
-  }
-  return key_size;
-}
-
 std::string Key::DebugString() const {
   std::stringstream out;
   out << (*this);
@@ -190,7 +264,7 @@ std::ostream& operator<<(std::ostream& out, const Key& k) {
       out << ", ";
     }
     out << k.ColumnValue(i);
-    if (k.is_descending_[i]) {
+    if (k.IsColumnDescending(i)) {
       out << "↓";
     }
   }
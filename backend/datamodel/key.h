@@ -17,6 +17,7 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_DATAMODEL_KEY_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_DATAMODEL_KEY_H_
 
+#include <cstdint>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -94,8 +95,15 @@ class Key {
   // Returns true if the key does not have any columns.
   bool IsEmpty() const { return columns_.empty(); }
 
-  // Returns the logical size of the key in bytes.
-  int64_t LogicalSizeInBytes() const;
+  // Returns true if the key is Key::Infinity().
+  bool IsInfinity() const { return is_infinity_; }
+
+  // Returns true if the key was obtained by ToPrefixLimit().
+  bool IsPrefixLimit() const { return is_prefix_limit_; }
+
+  // Returns the logical size of the key in bytes. The size is kept up to date
+  // as columns are set, so this does not walk the columns.
+  int64_t LogicalSizeInBytes() const { return logical_size_; }
 
   // Returns a debug string suitable to be included in error messages.
   std::string DebugString() const;
@@ -108,8 +116,15 @@ class Key {
   bool is_infinity_ = false;
   bool is_prefix_limit_ = false;
 
-  // Column metadata.
-  std::vector<bool> is_descending_;
+  // Column metadata. The descending flags of the first kMaskColumns columns
+  // are bits of a mask, so that keys need no allocation for them, and those of
+  // any further columns are kept in a vector.
+  static constexpr int kMaskColumns = 64;
+  uint64_t descending_mask_ = 0;
+  std::vector<bool> overflow_descending_;
+
+  // Sum of the logical sizes of the columns.
+  int64_t logical_size_ = 0;
 
   // Friend for member access.
   friend std::ostream& operator<<(std::ostream& out, const Key& k);
@@ -0,0 +1,138 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Measures the cost of comparing keys of different column types and of
+// canonicalizing key sets into disjoint key ranges.
+//
+// Usage: key_benchmark [--benchmark_format=table|json]
+//            [--benchmark_min_time=500ms] [--benchmark_filter=...]
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "zetasql/public/value.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/datamodel/key_set.h"
+#include "common/benchmark.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql::values::Bool;
+using zetasql::values::Double;
+using zetasql::values::Int64;
+using zetasql::values::Numeric;
+using zetasql::values::String;
+using zetasql::values::Timestamp;
+
+// Number of distinct keys compared in turn, so that comparisons do not always
+// see the same pair of keys.
+constexpr int kNumKeys = 1024;
+
+constexpr int kKeySetSizes[] = {10, 1000};
+
+// A mix of column types for the keys of a Compare case. Keys which share a
+// long common prefix make the comparison visit all of their columns.
+struct KeyMix {
+  std::string name;
+  std::function<Key(int64_t)> make_key;
+};
+
+std::vector<KeyMix> KeyMixes() {
+  return {
+      {"int64", [](int64_t i) { return Key({Int64(i)}); }},
+      {"string",
+       [](int64_t i) { return Key({String(absl::StrCat("key-", i))}); }},
+      {"int64,int64,int64",
+       [](int64_t i) { return Key({Int64(0), Int64(i / 16), Int64(i)}); }},
+      {"timestamp",
+       [](int64_t i) { return Key({Timestamp(absl::FromUnixMicros(i))}); }},
+      {"numeric",
+       [](int64_t i) { return Key({Numeric(zetasql::NumericValue(i))}); }},
+      {"string,int64,bool,double",
+       [](int64_t i) {
+         return Key({String("tenant"), Int64(i / 16), Bool(i % 2 == 0),
+                     Double(i)});
+       }},
+  };
+}
+
+// Returns a key set of `size` overlapping ranges and point keys, in
+// descending order so that canonicalization has to sort them.
+KeySet MakeKeySet(int size) {
+  KeySet set;
+  for (int64_t i = size; i > 0; --i) {
+    if (i % 2 == 0) {
+      set.AddKey(Key({Int64(2 * i)}));
+    } else {
+      set.AddRange(
+          KeyRange::ClosedOpen(Key({Int64(2 * i)}), Key({Int64(2 * i + 3)})));
+    }
+  }
+  return set;
+}
+
+void RunBenchmark() {
+  BenchmarkRunner runner;
+  for (const KeyMix& mix : KeyMixes()) {
+    std::vector<Key> keys;
+    for (int64_t i = 0; i < kNumKeys; ++i) {
+      keys.push_back(mix.make_key(i));
+    }
+    runner.Run(absl::StrCat("Key::Compare/", mix.name),
+               [&](int64_t iterations) {
+                 for (int64_t i = 0; i < iterations; ++i) {
+                   DoNotOptimize(
+                       keys[i % kNumKeys].Compare(keys[(i + 1) % kNumKeys]));
+                 }
+               });
+  }
+
+  for (int size : kKeySetSizes) {
+    KeySet set = MakeKeySet(size);
+    runner.Run(absl::StrCat("MakeDisjointKeyRanges/size:", size),
+               [&](int64_t iterations) {
+                 std::vector<KeyRange> ranges;
+                 for (int64_t i = 0; i < iterations; ++i) {
+                   ranges.clear();
+                   MakeDisjointKeyRanges(set, &ranges);
+                   DoNotOptimize(ranges.data());
+                 }
+               });
+  }
+  runner.Report();
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  google::spanner::emulator::backend::RunBenchmark();
+  return 0;
+}
@@ -0,0 +1,335 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/datamodel/key_encoding.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include "zetasql/base/logging.h"
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "backend/datamodel/key.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// Marks a NULL column value, followed by the type tag of the column. It sorts
+// before the tags of non-NULL values.
+constexpr char kNullMarker = 0x01;
+
+// Type tags of non-NULL column values, followed by the image of the value.
+constexpr char kBoolTag = 0x10;
+constexpr char kInt64Tag = 0x11;
+constexpr char kDoubleTag = 0x12;
+constexpr char kStringTag = 0x13;
+constexpr char kBytesTag = 0x14;
+constexpr char kDateTag = 0x15;
+constexpr char kTimestampTag = 0x16;
+
+// Ends the image of a STRING or BYTES value, in which each 0x00 byte is
+// escaped as 0x00 0xFF so that shorter values sort first.
+constexpr char kEscape = 0x00;
+constexpr char kEscapedZero = static_cast<char>(0xFF);
+constexpr char kTerminator = 0x01;
+
+// Follows the columns of a prefix limit key. The first byte of a column is
+// either a tag or an inverted tag, so it is always smaller.
+constexpr char kPrefixLimit = static_cast<char>(0xFF);
+
+// The encoding of Key::Infinity(), which sorts after any other encoding since
+// only the empty prefix limit key starts with kPrefixLimit.
+constexpr absl::string_view kInfinity("\xFF\xFF", 2);
+
+// Appends the bytes of the encoding of one column, inverting them for
+// descending columns.
+class ColumnWriter {
+ public:
+  ColumnWriter(std::string* out, bool desc)
+      : out_(out), mask_(desc ? 0xFF : 0x00) {}
+
+  void PutByte(char c) { out_->push_back(c ^ mask_); }
+
+  void PutUint64(uint64_t v, int num_bytes) {
+    for (int shift = 8 * (num_bytes - 1); shift >= 0; shift -= 8) {
+      PutByte(static_cast<char>((v >> shift) & 0xFF));
+    }
+  }
+
+  // Signed integers are offset by flipping the sign bit so that negative
+  // values sort first.
+  void PutInt64(int64_t v) {
+    PutUint64(static_cast<uint64_t>(v) ^ (uint64_t{1} << 63), 8);
+  }
+
+  void PutInt32(int32_t v) {
+    PutUint64(static_cast<uint32_t>(v) ^ (uint32_t{1} << 31), 4);
+  }
+
+  void PutString(absl::string_view s) {
+    for (char c : s) {
+      PutByte(c);
+      if (c == kEscape) {
+        PutByte(kEscapedZero);
+      }
+    }
+    PutByte(kEscape);
+    PutByte(kTerminator);
+  }
+
+ private:
+  std::string* out_;
+  const char mask_;
+};
+
+// Reads back the bytes written by a ColumnWriter.
+class ColumnReader {
+ public:
+  ColumnReader(absl::string_view* in, bool desc)
+      : in_(in), mask_(desc ? 0xFF : 0x00) {}
+
+  char GetByte() {
+    char c = in_->front() ^ mask_;
+    in_->remove_prefix(1);
+    return c;
+  }
+
+  uint64_t GetUint64(int num_bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < num_bytes; ++i) {
+      v = (v << 8) | static_cast<uint8_t>(GetByte());
+    }
+    return v;
+  }
+
+  int64_t GetInt64() {
+    return static_cast<int64_t>(GetUint64(8) ^ (uint64_t{1} << 63));
+  }
+
+  int32_t GetInt32() {
+    return static_cast<int32_t>(GetUint64(4) ^ (uint32_t{1} << 31));
+  }
+
+  std::string GetString() {
+    std::string s;
+    while (true) {
+      char c = GetByte();
+      if (c == kEscape) {
+        if (GetByte() == kTerminator) {
+          return s;
+        }
+      }
+      s.push_back(c);
+    }
+  }
+
+ private:
+  absl::string_view* in_;
+  const char mask_;
+};
+
+// Maps doubles to unsigned integers in the order of zetasql::Value::LessThan,
+// in which NaN sorts before any other value. Positive values have their sign
+// bit set, and negative values have all bits inverted.
+uint64_t DoubleToOrderedBits(double d) {
+  if (std::isnan(d)) {
+    return 0;
+  }
+  if (d == 0) {
+    d = 0;  // Normalize -0.0.
+  }
+  uint64_t bits;
+  std::memcpy(&bits, &d, sizeof(bits));
+  return (bits >> 63) ? ~bits : bits | (uint64_t{1} << 63);
+}
+
+double OrderedBitsToDouble(uint64_t bits) {
+  if (bits == 0) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  bits = (bits >> 63) ? bits & ~(uint64_t{1} << 63) : ~bits;
+  double d;
+  std::memcpy(&d, &bits, sizeof(d));
+  return d;
+}
+
+char TypeTag(zetasql::TypeKind kind) {
+  switch (kind) {
+    case zetasql::TYPE_BOOL:
+      return kBoolTag;
+    case zetasql::TYPE_INT64:
+      return kInt64Tag;
+    case zetasql::TYPE_DOUBLE:
+      return kDoubleTag;
+    case zetasql::TYPE_STRING:
+      return kStringTag;
+    case zetasql::TYPE_BYTES:
+      return kBytesTag;
+    case zetasql::TYPE_DATE:
+      return kDateTag;
+    case zetasql::TYPE_TIMESTAMP:
+      return kTimestampTag;
+    // TODO: Add support for NUMERIC in keys
+    default:
+      // Key columns should have already been validated, so invalid key columns
+      // should not occur.
+      LOG(DFATAL) << "Unsupported key column type: " << kind;
+      return kNullMarker;
+  }
+}
+
+const zetasql::Type* TagType(char tag) {
+  switch (tag) {
+    case kBoolTag:
+      return zetasql::types::BoolType();
+    case kInt64Tag:
+      return zetasql::types::Int64Type();
+    case kDoubleTag:
+      return zetasql::types::DoubleType();
+    case kStringTag:
+      return zetasql::types::StringType();
+    case kBytesTag:
+      return zetasql::types::BytesType();
+    case kDateTag:
+      return zetasql::types::DateType();
+    case kTimestampTag:
+      return zetasql::types::TimestampType();
+    default:
+      LOG(DFATAL) << "Invalid key column tag: " << static_cast<int>(tag);
+      return zetasql::types::Int64Type();
+  }
+}
+
+void EncodeColumn(const zetasql::Value& value, bool desc, std::string* out) {
+  ColumnWriter writer(out, desc);
+  if (value.is_null()) {
+    writer.PutByte(kNullMarker);
+    writer.PutByte(TypeTag(value.type_kind()));
+    return;
+  }
+  writer.PutByte(TypeTag(value.type_kind()));
+  switch (value.type_kind()) {
+    case zetasql::TYPE_BOOL:
+      writer.PutByte(value.bool_value() ? 1 : 0);
+      break;
+    case zetasql::TYPE_INT64:
+      writer.PutInt64(value.int64_value());
+      break;
+    case zetasql::TYPE_DOUBLE:
+      writer.PutUint64(DoubleToOrderedBits(value.double_value()), 8);
+      break;
+    case zetasql::TYPE_STRING:
+      writer.PutString(value.string_value());
+      break;
+    case zetasql::TYPE_BYTES:
+      writer.PutString(value.bytes_value());
+      break;
+    case zetasql::TYPE_DATE:
+      writer.PutInt32(value.date_value());
+      break;
+    case zetasql::TYPE_TIMESTAMP: {
+      // Timestamps are encoded as seconds and nanoseconds since the epoch,
+      // since nanoseconds alone overflow int64 for the range of timestamps.
+      absl::Time time = value.ToTime();
+      int64_t seconds = absl::ToUnixSeconds(time);
+      int64_t nanos =
+          absl::ToInt64Nanoseconds(time - absl::FromUnixSeconds(seconds));
+      writer.PutInt64(seconds);
+      writer.PutUint64(nanos, 4);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+zetasql::Value DecodeColumn(absl::string_view* in, bool desc) {
+  ColumnReader reader(in, desc);
+  char tag = reader.GetByte();
+  if (tag == kNullMarker) {
+    return zetasql::values::Null(TagType(reader.GetByte()));
+  }
+  switch (tag) {
+    case kBoolTag:
+      return zetasql::values::Bool(reader.GetByte() != 0);
+    case kInt64Tag:
+      return zetasql::values::Int64(reader.GetInt64());
+    case kDoubleTag:
+      return zetasql::values::Double(OrderedBitsToDouble(reader.GetUint64(8)));
+    case kStringTag:
+      return zetasql::values::String(reader.GetString());
+    case kBytesTag:
+      return zetasql::values::Bytes(reader.GetString());
+    case kDateTag:
+      return zetasql::values::Date(reader.GetInt32());
+    case kTimestampTag: {
+      int64_t seconds = reader.GetInt64();
+      int64_t nanos = reader.GetUint64(4);
+      return zetasql::values::Timestamp(absl::FromUnixSeconds(seconds) +
+                                        absl::Nanoseconds(nanos));
+    }
+    default:
+      LOG(DFATAL) << "Invalid key column tag: " << static_cast<int>(tag);
+      return zetasql::Value();
+  }
+}
+
+}  // namespace
+
+std::string EncodeKey(const Key& key) {
+  if (key.IsInfinity()) {
+    return std::string(kInfinity);
+  }
+  std::string out;
+  for (int i = 0; i < key.NumColumns(); ++i) {
+    EncodeColumn(key.ColumnValue(i), key.IsColumnDescending(i), &out);
+  }
+  if (key.IsPrefixLimit()) {
+    out.push_back(kPrefixLimit);
+  }
+  return out;
+}
+
+Key DecodeKey(absl::string_view encoded) {
+  if (encoded == kInfinity) {
+    return Key::Infinity();
+  }
+  Key key;
+  while (!encoded.empty()) {
+    if (encoded.front() == kPrefixLimit) {
+      return key.ToPrefixLimit();
+    }
+    // Inverted tags have the high bit set, tags do not.
+    bool desc = (encoded.front() & 0x80) != 0;
+    key.AddColumn(DecodeColumn(&encoded, desc), desc);
+  }
+  return key;
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
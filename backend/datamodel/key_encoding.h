@@ -0,0 +1,56 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_DATAMODEL_KEY_ENCODING_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_DATAMODEL_KEY_ENCODING_H_
+
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "backend/datamodel/key.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// Returns an order-preserving binary encoding of the given key.
+//
+// For keys k1 and k2 with matching column types and order attributes,
+// comparing EncodeKey(k1) and EncodeKey(k2) bytewise (as std::string and
+// memcmp do) gives the same result as k1.Compare(k2). This allows sorted
+// containers of keys to compare them without visiting each column value.
+//
+// Each column is encoded as a type tag followed by a fixed width big-endian
+// image of the value (or an escaped and terminated image for STRING and
+// BYTES), with all bytes inverted for descending columns. NULLs sort before
+// any other value. The tag makes the encoding self-describing, so the key can
+// be recovered with DecodeKey. Keys which compare equal have the same
+// encoding, so -0.0 is encoded as 0.0 and all NaNs alike.
+//
+// Only the column types supported in keys can be encoded.
+std::string EncodeKey(const Key& key);
+
+// Returns the key for an encoding returned by EncodeKey.
+Key DecodeKey(absl::string_view encoded);
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_DATAMODEL_KEY_ENCODING_H_
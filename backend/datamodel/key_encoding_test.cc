@@ -0,0 +1,189 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/datamodel/key_encoding.h"
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/time/time.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/value.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+using zetasql::values::Bool;
+using zetasql::values::Bytes;
+using zetasql::values::Date;
+using zetasql::values::Double;
+using zetasql::values::Int64;
+using zetasql::values::Null;
+using zetasql::values::String;
+using zetasql::values::Timestamp;
+
+int Sign(int v) { return (v > 0) - (v < 0); }
+
+// Returns the values of a single key column type in increasing order.
+std::vector<std::vector<zetasql::Value>> SortedColumnValues() {
+  double inf = std::numeric_limits<double>::infinity();
+  double nan = std::numeric_limits<double>::quiet_NaN();
+  return {
+      {Null(zetasql::types::BoolType()), Bool(false), Bool(true)},
+      {Null(zetasql::types::Int64Type()),
+       Int64(std::numeric_limits<int64_t>::min()), Int64(-256), Int64(-1),
+       Int64(0), Int64(1), Int64(255), Int64(256),
+       Int64(std::numeric_limits<int64_t>::max())},
+      {Null(zetasql::types::DoubleType()), Double(nan), Double(-inf),
+       Double(-1e300), Double(-1), Double(-1e-300), Double(0), Double(1e-300),
+       Double(1), Double(1e300), Double(inf)},
+      {Null(zetasql::types::StringType()), String(""),
+       String(std::string("\0", 1)), String(std::string("\0\0", 2)),
+       String(std::string("\0\x01", 2)), String("\x01"), String("a"),
+       String(std::string("a\0", 2)), String(std::string("a\0b", 3)),
+       String("a\x01"), String("ab"), String("b"), String("\xFF"),
+       String("\xFF\xFF")},
+      {Null(zetasql::types::BytesType()), Bytes(""),
+       Bytes(std::string("\0", 1)), Bytes(std::string("\0\xFF", 2)),
+       Bytes("\x01"), Bytes("\xFE"), Bytes("\xFF"), Bytes(std::string("\xFF\0", 2))},
+      {Null(zetasql::types::DateType()), Date(-719162), Date(-1), Date(0),
+       Date(1), Date(2932896)},
+      {Null(zetasql::types::TimestampType()),
+       Timestamp(absl::FromUnixSeconds(-62135596800)),
+       Timestamp(absl::FromUnixNanos(-1000000001)),
+       Timestamp(absl::FromUnixNanos(-1)), Timestamp(absl::UnixEpoch()),
+       Timestamp(absl::FromUnixNanos(1)),
+       Timestamp(absl::FromUnixNanos(999999999)),
+       Timestamp(absl::FromUnixSeconds(1)),
+       Timestamp(absl::FromUnixSeconds(253402300799) +
+                 absl::Nanoseconds(999999999))},
+  };
+}
+
+void ExpectSameOrder(const std::vector<Key>& keys) {
+  for (const Key& k1 : keys) {
+    for (const Key& k2 : keys) {
+      EXPECT_EQ(Sign(k1.Compare(k2)),
+                Sign(EncodeKey(k1).compare(EncodeKey(k2))))
+          << k1 << " vs " << k2;
+    }
+  }
+}
+
+TEST(KeyEncoding, PreservesOrderOfAscendingColumns) {
+  for (const auto& values : SortedColumnValues()) {
+    std::vector<Key> keys;
+    for (const zetasql::Value& value : values) {
+      keys.push_back(Key({value}));
+    }
+    ExpectSameOrder(keys);
+    for (int i = 1; i < keys.size(); ++i) {
+      EXPECT_LT(EncodeKey(keys[i - 1]), EncodeKey(keys[i])) << keys[i];
+    }
+  }
+}
+
+TEST(KeyEncoding, PreservesOrderOfDescendingColumns) {
+  for (const auto& values : SortedColumnValues()) {
+    std::vector<Key> keys;
+    for (const zetasql::Value& value : values) {
+      Key key;
+      key.AddColumn(value, /*desc=*/true);
+      keys.push_back(key);
+    }
+    ExpectSameOrder(keys);
+    for (int i = 1; i < keys.size(); ++i) {
+      EXPECT_GT(EncodeKey(keys[i - 1]), EncodeKey(keys[i])) << keys[i];
+    }
+  }
+}
+
+TEST(KeyEncoding, PreservesOrderOfPrefixesAndSpecialKeys) {
+  for (bool first_desc : {false, true}) {
+    for (bool second_desc : {false, true}) {
+      std::vector<Key> keys = {Key::Empty(), Key::Empty().ToPrefixLimit(),
+                               Key::Infinity()};
+      for (const zetasql::Value& first :
+           {String(""), String(std::string("\0", 1)), String("a")}) {
+        Key prefix;
+        prefix.AddColumn(first, first_desc);
+        keys.push_back(prefix);
+        keys.push_back(prefix.ToPrefixLimit());
+        for (const zetasql::Value& second :
+             {Null(zetasql::types::Int64Type()), Int64(-1), Int64(0)}) {
+          Key key = prefix;
+          key.AddColumn(second, second_desc);
+          keys.push_back(key);
+          keys.push_back(key.ToPrefixLimit());
+        }
+      }
+      ExpectSameOrder(keys);
+    }
+  }
+}
+
+TEST(KeyEncoding, EncodesEqualKeysAlike) {
+  double nan = std::numeric_limits<double>::quiet_NaN();
+  EXPECT_EQ(EncodeKey(Key({Double(-0.0)})), EncodeKey(Key({Double(0.0)})));
+  EXPECT_EQ(EncodeKey(Key({Double(nan)})), EncodeKey(Key({Double(-nan)})));
+  EXPECT_EQ(EncodeKey(Key::Infinity()),
+            EncodeKey(Key::Infinity().ToPrefixLimit()));
+}
+
+TEST(KeyEncoding, DecodesEncodedKeys) {
+  std::vector<Key> keys = {Key::Empty(), Key::Empty().ToPrefixLimit(),
+                           Key::Infinity()};
+  for (const auto& values : SortedColumnValues()) {
+    for (const zetasql::Value& value : values) {
+      for (bool desc : {false, true}) {
+        Key key;
+        key.AddColumn(String("prefix"));
+        key.AddColumn(value, desc);
+        keys.push_back(key);
+        keys.push_back(key.ToPrefixLimit());
+      }
+    }
+  }
+  for (const Key& key : keys) {
+    Key decoded = DecodeKey(EncodeKey(key));
+    EXPECT_EQ(key, decoded);
+    EXPECT_EQ(key.IsInfinity(), decoded.IsInfinity());
+    EXPECT_EQ(key.IsPrefixLimit(), decoded.IsPrefixLimit());
+    ASSERT_EQ(key.NumColumns(), decoded.NumColumns());
+    for (int i = 0; i < key.NumColumns(); ++i) {
+      EXPECT_EQ(key.IsColumnDescending(i), decoded.IsColumnDescending(i));
+      EXPECT_TRUE(key.ColumnValue(i).type()->Equals(
+          decoded.ColumnValue(i).type()));
+    }
+  }
+}
+
+}  // namespace
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
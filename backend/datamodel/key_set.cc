@@ -16,6 +16,8 @@
 
 #include "backend/datamodel/key_set.h"
 
+#include <algorithm>
+
 namespace google {
 namespace spanner {
 namespace emulator {
@@ -68,6 +70,7 @@ std::ostream& operator<<(std::ostream& out, const KeySet& set) {
 void MakeDisjointKeyRanges(const KeySet& set, std::vector<KeyRange>* ranges) {
   // Clear output.
   ranges->clear();
+  ranges->reserve(set.keys().size() + set.ranges().size());
 
   // First convert all keys and ranges to closed-open ranges.
   for (const Key& key : set.keys()) {
@@ -77,6 +80,10 @@ void MakeDisjointKeyRanges(const KeySet& set, std::vector<KeyRange>* ranges) {
     ranges->push_back(range.ToClosedOpen());
   }
 
+  MakeDisjointKeyRanges(ranges);
+}
+
+void MakeDisjointKeyRanges(std::vector<KeyRange>* ranges) {
   // Early exit if we have nothing to do.
   if (ranges->empty()) {
     return;
@@ -88,7 +95,9 @@ void MakeDisjointKeyRanges(const KeySet& set, std::vector<KeyRange>* ranges) {
               return kr1.start_key() < kr2.start_key();
             });
 
-  // Finally, walk through the ranges, merging them as we go.
+  // Finally, walk through the ranges, merging them as we go. Ranges which are
+  // merged away are not used again, so their keys are moved rather than
+  // copied.
   // Invariants:
   // - All ranges before last are disjoint
   // - All ranges in [last, next) have been merged into last
@@ -108,21 +117,25 @@ void MakeDisjointKeyRanges(const KeySet& set, std::vector<KeyRange>* ranges) {
         // The next range's start key is after the last range's limit key.
         // Everything before next is now disjoint, so make next the new last.
         ++last;
-        *last = *next;
+        if (last != next) {
+          *last = std::move(*next);
+        }
         break;
       }
 
       case 0: {
         // The next range's start key coincides with the last range's limit key.
         // The two ranges are contiguous, make last extend to cover both ranges.
-        last->limit_key() = next->limit_key();
+        last->limit_key() = std::move(next->limit_key());
         break;
       }
 
       case -1: {
         // The next range's start key is before the last range's limit key.
         // The two ranges overlap, extend last to the greater of the two ranges.
-        last->limit_key() = std::max(next->limit_key(), last->limit_key());
+        if (next->limit_key() > last->limit_key()) {
+          last->limit_key() = std::move(next->limit_key());
+        }
         break;
       }
     }
@@ -135,6 +148,27 @@ void MakeDisjointKeyRanges(const KeySet& set, std::vector<KeyRange>* ranges) {
   ranges->erase(last + 1, next);
 }
 
+KeySet IntersectKeySet(const KeySet& set, const KeyRange& range) {
+  const KeyRange bounds = range.ToClosedOpen();
+  KeySet result;
+  for (const Key& key : set.keys()) {
+    if (bounds.Contains(key)) {
+      result.AddKey(key);
+    }
+  }
+  for (const KeyRange& key_range : set.ranges()) {
+    const KeyRange closed_open = key_range.ToClosedOpen();
+    const Key& start_key =
+        std::max(closed_open.start_key(), bounds.start_key());
+    const Key& limit_key =
+        std::min(closed_open.limit_key(), bounds.limit_key());
+    if (start_key < limit_key) {
+      result.AddRange(KeyRange::ClosedOpen(start_key, limit_key));
+    }
+  }
+  return result;
+}
+
 }  // namespace backend
 }  // namespace emulator
 }  // namespace spanner
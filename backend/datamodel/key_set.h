@@ -76,6 +76,15 @@ std::ostream& operator<<(std::ostream& out, const KeySet& set);
 // Converts a key set to a sorted list of disjoint closed-open key ranges.
 void MakeDisjointKeyRanges(const KeySet& set, std::vector<KeyRange>* ranges);
 
+// Sorts and merges closed-open ranges in place into a sorted list of disjoint
+// closed-open key ranges. This takes O(n log n) time for n ranges, and lets
+// callers which build the ranges themselves avoid copying them into a KeySet.
+void MakeDisjointKeyRanges(std::vector<KeyRange>* ranges);
+
+// Returns the keys of set which are contained in range, and the parts of the
+// ranges of set which overlap with it. Ranges in the result are closed-open.
+KeySet IntersectKeySet(const KeySet& set, const KeyRange& range);
+
 }  // namespace backend
 }  // namespace emulator
 }  // namespace spanner
@@ -136,6 +136,22 @@ TEST(KeySet, CanonicalizesSingleRange) {
   EXPECT_THAT(expected_ranges, testing::ElementsAreArray(actual_ranges));
 }
 
+TEST(KeySet, CanonicalizesUnsortedAndDuplicatePointKeys) {
+  KeySet ks;
+  for (int i = 999; i >= 0; --i) {
+    ks.AddKey(Key({Int64(i % 100)}));
+  }
+  std::vector<KeyRange> expected_ranges;
+  for (int i = 0; i < 100; ++i) {
+    expected_ranges.push_back(KeyRange::Point(Key({Int64(i)})));
+  }
+
+  std::vector<KeyRange> actual_ranges;
+  MakeDisjointKeyRanges(ks, &actual_ranges);
+
+  EXPECT_THAT(expected_ranges, testing::ElementsAreArray(actual_ranges));
+}
+
 TEST(KeySet, CanonicalizesOverlappingKeyRangesWithMultipleParts) {
   Key b1 = Key({String("b"), Int64(1)});
   Key b2 = Key({String("b"), Int64(2)});
@@ -182,6 +198,40 @@ TEST(KeySet, CanonicalizeOverlappingKeyRangesWithAll) {
   EXPECT_THAT(actual_ranges, testing::ElementsAreArray(expected_ranges));
 }
 
+TEST(KeySet, IntersectsKeysAndRangesWithKeyRange) {
+  Key a = Key({String("a")});
+  Key b = Key({String("b")});
+  Key c = Key({String("c")});
+  Key d = Key({String("d")});
+
+  KeySet ks;
+  ks.AddKey(a);
+  ks.AddKey(c);
+  ks.AddRange(KeyRange::ClosedClosed(a, b));
+  ks.AddRange(KeyRange::ClosedOpen(c, d));
+
+  KeySet intersection = IntersectKeySet(ks, KeyRange::ClosedOpen(b, d));
+  EXPECT_THAT(intersection.keys(), testing::ElementsAre(c));
+  EXPECT_THAT(intersection.ranges(),
+              testing::ElementsAre(
+                  KeyRange::ClosedOpen(b, b.ToPrefixLimit()),
+                  KeyRange::ClosedOpen(c, d)));
+}
+
+TEST(KeySet, IntersectionWithDisjointRangeIsEmpty) {
+  Key a = Key({String("a")});
+  Key b = Key({String("b")});
+  Key c = Key({String("c")});
+
+  KeySet ks;
+  ks.AddKey(a);
+  ks.AddRange(KeyRange::ClosedOpen(a, b));
+
+  KeySet intersection = IntersectKeySet(ks, KeyRange::ClosedOpen(b, c));
+  EXPECT_TRUE(intersection.keys().empty());
+  EXPECT_TRUE(intersection.ranges().empty());
+}
+
 TEST(KeySet, CanonicalizeOverlappingKeyRangesWithEmpty) {
   Key b1 = Key({String("b"), Int64(1)});
   Key b2 = Key({String("b"), Int64(2)});
@@ -16,10 +16,16 @@
 
 #include "backend/datamodel/key.h"
 
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "zetasql/base/testing/status_matchers.h"
 #include "tests/common/proto_matchers.h"
+#include "absl/time/time.h"
 #include "backend/datamodel/value.h"
 
 namespace google {
@@ -30,9 +36,16 @@ namespace backend {
 namespace {
 
 using zetasql::types::Int64Type;
+using zetasql::values::Bool;
+using zetasql::values::Bytes;
+using zetasql::values::Date;
+using zetasql::values::Double;
 using zetasql::values::Int64;
 using zetasql::values::Null;
+using zetasql::values::NullBool;
+using zetasql::values::Numeric;
 using zetasql::values::String;
+using zetasql::values::Timestamp;
 
 TEST(Key, ReturnsNoColumnsForEmptyKeys) {
   Key empty_key;
@@ -110,6 +123,29 @@ TEST(Key, OrdersKeysOfSameLength) {
   EXPECT_LT(Key({String("B"), Int64(1)}), Key({String("B"), Int64(2)}));
 }
 
+TEST(Key, OrdersKeysOfEachColumnType) {
+  const std::vector<std::pair<zetasql::Value, zetasql::Value>> ordered{
+      {Int64(-5), Int64(3)},
+      {String("ab"), String("b")},
+      {String("a"), String("a\xc3\xa9")},
+      {Bytes("\x01"), Bytes("\xff")},
+      {Timestamp(absl::FromUnixNanos(1)), Timestamp(absl::FromUnixNanos(2))},
+      {Numeric(zetasql::NumericValue(-1)), Numeric(zetasql::NumericValue(1))},
+      {Date(-1), Date(1)},
+      {Bool(false), Bool(true)},
+      {Double(std::numeric_limits<double>::quiet_NaN()), Double(-1.5)},
+      {Null(Int64Type()), Int64(std::numeric_limits<int64_t>::min())},
+  };
+  for (const auto& values : ordered) {
+    const Key smaller({values.first});
+    const Key larger({values.second});
+    EXPECT_LT(smaller, larger) << smaller << " " << larger;
+    EXPECT_GT(larger, smaller) << smaller << " " << larger;
+    EXPECT_EQ(smaller, Key({values.first})) << smaller;
+    EXPECT_EQ(larger, Key({values.second})) << larger;
+  }
+}
+
 TEST(Key, OrdersKeysOfDifferentLength) {
   EXPECT_LT(Key({Int64(1)}), Key({Int64(1), String("One")}));
   EXPECT_GT(Key({String("B"), Int64(1)}), Key({String("A")}));
@@ -162,6 +198,28 @@ TEST(Key, OrdersMultiColumnKeysWithDescendingColumns) {
   EXPECT_LT(k2a3d3a, k2a1d);
 }
 
+TEST(Key, OrdersKeysWithManyDescendingColumns) {
+  // Keys of more than 64 columns keep the flags of the later columns apart.
+  Key k1;
+  Key k2;
+  for (int i = 0; i < 100; ++i) {
+    k1.AddColumn(Int64(1), i % 2 == 1);
+    k2.AddColumn(Int64(i == 99 ? 2 : 1), i % 2 == 1);
+  }
+  EXPECT_TRUE(k1.IsColumnDescending(99));
+  EXPECT_FALSE(k1.IsColumnDescending(98));
+  EXPECT_LT(k2, k1);
+
+  k1.SetColumnDescending(99, false);
+  k2.SetColumnDescending(99, false);
+  EXPECT_LT(k1, k2);
+
+  Key prefix = k1.Prefix(2);
+  EXPECT_FALSE(prefix.IsColumnDescending(0));
+  EXPECT_TRUE(prefix.IsColumnDescending(1));
+  EXPECT_FALSE(prefix.Prefix(1).Prefix(2).IsColumnDescending(1));
+}
+
 TEST(Key, OrdersSingleColumnPrefixLimitKeys) {
   Key key({String("A")});
 
@@ -224,6 +282,21 @@ TEST(Key, ChecksPrefixKeys) {
   EXPECT_FALSE(a.IsPrefixOf(a.ToPrefixLimit()));
 }
 
+TEST(Key, TracksLogicalSizeAsColumnsChange) {
+  Key key({Int64(1), String("abc")});
+  EXPECT_EQ(11, key.LogicalSizeInBytes());
+
+  key.AddColumn(NullBool());
+  EXPECT_EQ(13, key.LogicalSizeInBytes());
+
+  key.SetColumnValue(1, String("abcdef"));
+  EXPECT_EQ(16, key.LogicalSizeInBytes());
+
+  EXPECT_EQ(8, key.Prefix(1).LogicalSizeInBytes());
+  EXPECT_EQ(16, key.ToPrefixLimit().LogicalSizeInBytes());
+  EXPECT_EQ(0, Key::Empty().LogicalSizeInBytes());
+}
+
 TEST(Key, GeneratesDebugString) {
   EXPECT_EQ("{Int64(1)}", Key({Int64(1)}).DebugString());
   EXPECT_EQ("{Int64(1), String(\"A\")}",
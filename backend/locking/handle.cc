@@ -19,6 +19,7 @@
 #include "zetasql/base/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "backend/locking/manager.h"
+#include "common/trace.h"
 
 namespace google {
 namespace spanner {
@@ -29,7 +30,11 @@ LockHandle::LockHandle(LockManager* manager, TransactionID tid,
                        TransactionPriority priority)
     : manager_(manager), tid_(tid), priority_(priority) {}
 
-LockHandle::~LockHandle() {}
+LockHandle::~LockHandle() {
+  // Release any locks still held so that the lock table never refers to a
+  // destroyed handle.
+  manager_->UnlockAll(this);
+}
 
 void LockHandle::EnqueueLock(const LockRequest& request) {
   manager_->EnqueueLock(this, request);
@@ -37,21 +42,17 @@ void LockHandle::EnqueueLock(const LockRequest& request) {
 
 void LockHandle::UnlockAll() { manager_->UnlockAll(this); }
 
-bool LockHandle::IsBlocked() {
-  // The current implementation never blocks.
-  absl::MutexLock lock(&mu_);
-  return false;
-}
+bool LockHandle::IsBlocked() { return manager_->IsBlocked(this); }
 
 bool LockHandle::IsAborted() {
   absl::MutexLock lock(&mu_);
   return !status_.ok();
 }
 
-absl::Status LockHandle::Wait() {
-  // The current implementation never blocks.
-  absl::MutexLock lock(&mu_);
-  return status_;
+absl::Status LockHandle::Wait() { return manager_->Wait(this); }
+
+void LockHandle::Expire(const absl::Status& status) {
+  manager_->Expire(this, status);
 }
 
 void LockHandle::Abort(const absl::Status& status) {
@@ -64,6 +65,11 @@ void LockHandle::Reset() {
   status_ = absl::OkStatus();
 }
 
+absl::Status LockHandle::status() {
+  absl::MutexLock lock(&mu_);
+  return status_;
+}
+
 zetasql_base::StatusOr<absl::Time> LockHandle::ReserveCommitTimestamp() {
   return manager_->ReserveCommitTimestamp(this);
 }
@@ -73,7 +79,12 @@ absl::Status LockHandle::MarkCommitted() {
 }
 
 void LockHandle::WaitForSafeRead(absl::Time read_time) {
-  manager_->WaitForSafeRead(read_time);
+  trace::ScopedSpan span("WaitForSafeRead");
+  manager_->WaitForSafeRead(this, read_time);
+}
+
+absl::Time LockHandle::SafeReadTimestamp() {
+  return manager_->SafeReadTimestamp();
 }
 
 }  // namespace backend
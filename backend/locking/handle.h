@@ -17,6 +17,10 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_LOCKING_HANDLE_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_LOCKING_HANDLE_H_
 
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
 #include "absl/base/thread_annotations.h"
 #include "absl/time/time.h"
 #include "backend/common/ids.h"
@@ -82,13 +86,15 @@ class LockHandle {
   bool IsBlocked() ABSL_LOCKS_EXCLUDED(mu_);
 
   // Returns true if this handle has been aborted by the lock manager. Previous
-  // locks acquired by the handle are not release automatically. The handle must
-  // explicitly call UnlockAll().
+  // locks acquired by the handle are not released automatically unless the
+  // handle was wounded by an older transaction. The handle must explicitly call
+  // UnlockAll() to reset its state.
   bool IsAborted() ABSL_LOCKS_EXCLUDED(mu_);
 
   // Waits till all locks requested via this handle have either all been granted
-  // or have at least one request denied. Lock denials will return ABORTED
-  // status, otherwise OK will be returned.
+  // or have at least one request denied. Requests which are still waiting when
+  // the lock manager's lock wait timeout expires are denied. Lock denials will
+  // return ABORTED status, otherwise OK will be returned.
   absl::Status Wait() ABSL_LOCKS_EXCLUDED(mu_);
 
   // Returns timestamp which can be used by this transaction as a commit
@@ -98,10 +104,22 @@ class LockHandle {
   // Notifies the LockManager that this transaction has committed.
   absl::Status MarkCommitted();
 
+  // Aborts this transaction with `status`, releasing its locks and cancelling
+  // its waiting requests, unless it started committing or holds the database
+  // lock of a schema change. The transaction only finds out when it next
+  // requests locks. Used to abort abandoned transactions, whose locks would
+  // otherwise block others indefinitely.
+  void Expire(const absl::Status& status);
+
   // Waits for the intended read timestamp to be safe from any in-progress
-  // commits.
+  // commits. The read timestamp is retained by version garbage collection
+  // until UnlockAll() is called.
   void WaitForSafeRead(absl::Time read_time);
 
+  // Returns the latest timestamp at which a read does not wait for commits in
+  // progress, see LockManager::SafeReadTimestamp.
+  absl::Time SafeReadTimestamp();
+
  private:
   // Only the LockManager is allowed to create and destroy LockHandles.
   friend class LockManager;
@@ -116,6 +134,9 @@ class LockHandle {
   // Resets the state of this handle.
   void Reset() ABSL_LOCKS_EXCLUDED(mu_);
 
+  // Returns the status of the lock handle requests.
+  absl::Status status() ABSL_LOCKS_EXCLUDED(mu_);
+
   // The LockManager which this LockHandle interacts with.
   LockManager* const manager_;
 
@@ -125,6 +146,14 @@ class LockHandle {
   // The priority of the transaction which owns this lock handle.
   TransactionPriority priority_;
 
+  // Read timestamp registered by this handle with the LockManager, in unix
+  // microseconds rounded up, or the maximum value if none is registered. Read
+  // without holding any mutex by the fast path of
+  // LockManager::WaitForSafeRead, and written by the LockManager under its
+  // mutex.
+  std::atomic<int64_t> registered_read_micros_{
+      std::numeric_limits<int64_t>::max()};
+
   // Mutex to guard state below.
   absl::Mutex mu_;
 
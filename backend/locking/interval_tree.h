@@ -0,0 +1,266 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_LOCKING_INTERVAL_TREE_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_LOCKING_INTERVAL_TREE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// IntervalTree holds values of type V, each for a half-open interval
+// [start, limit) of keys of type K, which are ordered by operator<. It finds
+// the intervals overlapping a given one in O(log n + m) expected time, for m
+// overlapping intervals, however long the intervals are.
+//
+// The intervals are kept in a treap ordered by their start, in which each node
+// also tracks the greatest limit in its subtree, so that searches skip the
+// subtrees whose intervals all end before the interval searched for. Intervals
+// may repeat, and nodes never move in memory, so each insertion returns a
+// handle to its node which stays valid until the node is erased.
+//
+// This class is not thread-safe.
+template <typename K, typename V>
+class IntervalTree {
+ public:
+  class Node {
+   public:
+    const K& start() const { return start_; }
+    const K& limit() const { return limit_; }
+    V& value() { return value_; }
+    const V& value() const { return value_; }
+
+   private:
+    friend class IntervalTree;
+
+    Node(K start, K limit, V value, uint64_t priority)
+        : start_(std::move(start)),
+          limit_(std::move(limit)),
+          value_(std::move(value)),
+          priority_(priority),
+          max_limit_(&limit_) {}
+
+    const K start_;
+    const K limit_;
+    V value_;
+
+    // Nodes with greater priorities are closer to the root.
+    const uint64_t priority_;
+
+    // The greatest limit of the intervals in the subtree of this node, which
+    // points into one of the nodes of the subtree.
+    const K* max_limit_;
+
+    Node* parent_ = nullptr;
+    Node* left_ = nullptr;
+    Node* right_ = nullptr;
+  };
+
+  IntervalTree() = default;
+  ~IntervalTree() { Delete(root_); }
+
+  IntervalTree(const IntervalTree&) = delete;
+  IntervalTree& operator=(const IntervalTree&) = delete;
+
+  bool empty() const { return root_ == nullptr; }
+  size_t size() const { return size_; }
+
+  // Inserts `value` for the interval [start, limit), and returns its node.
+  Node* Insert(K start, K limit, V value) {
+    Node* node = new Node(std::move(start), std::move(limit),
+                          std::move(value), NextPriority());
+    if (root_ == nullptr) {
+      root_ = node;
+    } else {
+      Node* parent = root_;
+      while (true) {
+        Node*& child =
+            node->start_ < parent->start_ ? parent->left_ : parent->right_;
+        if (child == nullptr) {
+          child = node;
+          break;
+        }
+        parent = child;
+      }
+      node->parent_ = parent;
+      while (node->parent_ != nullptr &&
+             node->parent_->priority_ < node->priority_) {
+        RotateUp(node);
+      }
+      UpdateAncestors(node->parent_);
+    }
+    ++size_;
+    return node;
+  }
+
+  // Erases `node`, which must be in this tree.
+  void Erase(Node* node) {
+    // Rotate the node down until it is a leaf, keeping the children with
+    // greater priorities above the others.
+    while (node->left_ != nullptr || node->right_ != nullptr) {
+      Node* child = node->left_;
+      if (child == nullptr ||
+          (node->right_ != nullptr &&
+           node->left_->priority_ < node->right_->priority_)) {
+        child = node->right_;
+      }
+      RotateUp(child);
+    }
+    Node* parent = node->parent_;
+    ReplaceChild(parent, node, nullptr);
+    UpdateAncestors(parent);
+    delete node;
+    --size_;
+  }
+
+  // Calls `fn` with the value of each interval overlapping [start, limit), in
+  // order of their start.
+  template <typename Fn>
+  void ForEachOverlapping(const K& start, const K& limit, Fn fn) const {
+    ForEachOverlapping(root_, start, limit, fn);
+  }
+
+  // Returns the first node of an interval starting at `start` which satisfies
+  // `pred`, called with the node, or null if there is none.
+  template <typename Pred>
+  Node* FindWithStart(const K& start, Pred pred) const {
+    return FindWithStart(root_, start, pred);
+  }
+
+ private:
+  template <typename Fn>
+  static void ForEachOverlapping(const Node* node, const K& start,
+                                 const K& limit, Fn& fn) {
+    // Equal starts may be on either side of a node, so the intervals of the
+    // left subtree start at or before it, and those of the right subtree at or
+    // after it.
+    while (node != nullptr && start < *node->max_limit_) {
+      ForEachOverlapping(node->left_, start, limit, fn);
+      if (!(node->start_ < limit)) {
+        return;
+      }
+      if (start < node->limit_) {
+        fn(node->value_);
+      }
+      node = node->right_;
+    }
+  }
+
+  template <typename Pred>
+  static Node* FindWithStart(Node* node, const K& start, Pred& pred) {
+    while (node != nullptr) {
+      if (start < node->start_) {
+        node = node->left_;
+      } else if (node->start_ < start) {
+        node = node->right_;
+      } else {
+        if (Node* found = FindWithStart(node->left_, start, pred)) {
+          return found;
+        }
+        if (pred(*node)) {
+          return node;
+        }
+        node = node->right_;
+      }
+    }
+    return nullptr;
+  }
+
+  // Rotates `node` above its parent.
+  void RotateUp(Node* node) {
+    Node* parent = node->parent_;
+    if (parent->left_ == node) {
+      parent->left_ = node->right_;
+      if (node->right_ != nullptr) {
+        node->right_->parent_ = parent;
+      }
+      node->right_ = parent;
+    } else {
+      parent->right_ = node->left_;
+      if (node->left_ != nullptr) {
+        node->left_->parent_ = parent;
+      }
+      node->left_ = parent;
+    }
+    ReplaceChild(parent->parent_, parent, node);
+    node->parent_ = parent->parent_;
+    parent->parent_ = node;
+    UpdateMaxLimit(parent);
+    UpdateMaxLimit(node);
+  }
+
+  // Replaces `child` of `parent`, or the root if `parent` is null, with
+  // `replacement`.
+  void ReplaceChild(Node* parent, Node* child, Node* replacement) {
+    if (parent == nullptr) {
+      root_ = replacement;
+    } else if (parent->left_ == child) {
+      parent->left_ = replacement;
+    } else {
+      parent->right_ = replacement;
+    }
+  }
+
+  static void UpdateMaxLimit(Node* node) {
+    node->max_limit_ = &node->limit_;
+    for (const Node* child : {node->left_, node->right_}) {
+      if (child != nullptr && *node->max_limit_ < *child->max_limit_) {
+        node->max_limit_ = child->max_limit_;
+      }
+    }
+  }
+
+  static void UpdateAncestors(Node* node) {
+    for (; node != nullptr; node = node->parent_) {
+      UpdateMaxLimit(node);
+    }
+  }
+
+  static void Delete(Node* node) {
+    while (node != nullptr) {
+      Delete(node->left_);
+      Node* right = node->right_;
+      delete node;
+      node = right;
+    }
+  }
+
+  // Returns the next pseudo-random priority of a node, from a splitmix64
+  // sequence.
+  uint64_t NextPriority() {
+    uint64_t z = (priority_state_ += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+  }
+
+  Node* root_ = nullptr;
+  size_t size_ = 0;
+  uint64_t priority_state_ = 0;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_LOCKING_INTERVAL_TREE_H_
@@ -0,0 +1,144 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/locking/interval_tree.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using testing::ElementsAre;
+using testing::IsEmpty;
+
+using Tree = IntervalTree<int, int>;
+
+std::vector<int> Overlapping(const Tree& tree, int start, int limit) {
+  std::vector<int> values;
+  tree.ForEachOverlapping(start, limit,
+                          [&](int value) { values.push_back(value); });
+  return values;
+}
+
+TEST(IntervalTreeTest, EmptyTreeHasNoIntervals) {
+  Tree tree;
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(tree.size(), 0);
+  EXPECT_THAT(Overlapping(tree, 0, 100), IsEmpty());
+}
+
+TEST(IntervalTreeTest, FindsOverlappingIntervalsInOrderOfStart) {
+  Tree tree;
+  tree.Insert(10, 20, 1);
+  tree.Insert(0, 100, 2);
+  tree.Insert(30, 40, 3);
+  tree.Insert(15, 16, 4);
+  EXPECT_EQ(tree.size(), 4);
+
+  EXPECT_THAT(Overlapping(tree, 12, 18), ElementsAre(2, 1, 4));
+  EXPECT_THAT(Overlapping(tree, 20, 30), ElementsAre(2));
+  EXPECT_THAT(Overlapping(tree, 39, 41), ElementsAre(2, 3));
+  EXPECT_THAT(Overlapping(tree, 100, 200), IsEmpty());
+}
+
+TEST(IntervalTreeTest, IntervalsTouchingAtAnEndDoNotOverlap) {
+  Tree tree;
+  tree.Insert(10, 20, 1);
+  EXPECT_THAT(Overlapping(tree, 0, 10), IsEmpty());
+  EXPECT_THAT(Overlapping(tree, 20, 30), IsEmpty());
+  EXPECT_THAT(Overlapping(tree, 19, 20), ElementsAre(1));
+}
+
+TEST(IntervalTreeTest, ErasesNodesByHandle) {
+  Tree tree;
+  Tree::Node* first = tree.Insert(10, 20, 1);
+  Tree::Node* second = tree.Insert(10, 20, 2);
+  tree.Insert(15, 30, 3);
+  tree.Erase(first);
+  EXPECT_THAT(Overlapping(tree, 0, 100), ElementsAre(2, 3));
+  tree.Erase(second);
+  EXPECT_THAT(Overlapping(tree, 0, 100), ElementsAre(3));
+  EXPECT_THAT(Overlapping(tree, 10, 15), IsEmpty());
+  EXPECT_EQ(tree.size(), 1);
+}
+
+TEST(IntervalTreeTest, FindsNodesByStart) {
+  Tree tree;
+  tree.Insert(5, 6, 1);
+  Tree::Node* node = tree.Insert(10, 20, 2);
+  tree.Insert(10, 30, 3);
+  EXPECT_EQ(tree.FindWithStart(
+                10, [](const Tree::Node& n) { return n.value() == 2; }),
+            node);
+  Tree::Node* found = tree.FindWithStart(
+      10, [](const Tree::Node& n) { return n.limit() == 30; });
+  ASSERT_NE(found, nullptr);
+  EXPECT_EQ(found->value(), 3);
+  EXPECT_EQ(tree.FindWithStart(11, [](const Tree::Node&) { return true; }),
+            nullptr);
+}
+
+TEST(IntervalTreeTest, MatchesBruteForceUnderRandomOperations) {
+  struct Interval {
+    int start;
+    int limit;
+    Tree::Node* node;
+  };
+  std::mt19937 rng(42);
+  Tree tree;
+  std::vector<Interval> intervals;
+  for (int step = 0; step < 20000; ++step) {
+    if (intervals.empty() || rng() % 3 != 0) {
+      int start = rng() % 1000;
+      int limit = start + 1 + rng() % (rng() % 10 == 0 ? 500 : 10);
+      intervals.push_back(
+          {start, limit, tree.Insert(start, limit, static_cast<int>(step))});
+    } else {
+      int i = rng() % intervals.size();
+      tree.Erase(intervals[i].node);
+      intervals[i] = intervals.back();
+      intervals.pop_back();
+    }
+    ASSERT_EQ(tree.size(), intervals.size());
+
+    int start = rng() % 1100;
+    int limit = start + 1 + rng() % 50;
+    std::vector<int> expected;
+    for (const Interval& interval : intervals) {
+      if (interval.start < limit && start < interval.limit) {
+        expected.push_back(interval.node->value());
+      }
+    }
+    std::vector<int> actual = Overlapping(tree, start, limit);
+    std::sort(expected.begin(), expected.end());
+    std::sort(actual.begin(), actual.end());
+    ASSERT_EQ(actual, expected) << "at step " << step;
+  }
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
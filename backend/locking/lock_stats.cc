@@ -0,0 +1,119 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/locking/lock_stats.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "backend/common/ids.h"
+#include "backend/datamodel/key.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// Orders entries hottest first.
+bool IsHotter(const LockStats::Entry& a, const LockStats::Entry& b) {
+  if (a.counts.lock_wait != b.counts.lock_wait) {
+    return a.counts.lock_wait > b.counts.lock_wait;
+  }
+  if (a.counts.lock_conflicts != b.counts.lock_conflicts) {
+    return a.counts.lock_conflicts > b.counts.lock_conflicts;
+  }
+  return a.counts.aborts > b.counts.aborts;
+}
+
+// Returns the `n` hottest of `entries`, hottest first.
+std::vector<LockStats::Entry> Hottest(std::vector<LockStats::Entry> entries,
+                                      int n) {
+  n = std::max(0, std::min(n, static_cast<int>(entries.size())));
+  std::partial_sort(entries.begin(), entries.begin() + n, entries.end(),
+                    IsHotter);
+  entries.resize(n);
+  return entries;
+}
+
+}  // namespace
+
+template <typename Add>
+void LockStats::Update(const TableID& table_id, const Key& start_key,
+                       Add add) {
+  absl::MutexLock lock(&mu_);
+  TableCounts& table = tables_[table_id];
+  add(&table.totals);
+  auto itr = table.ranges.find(start_key);
+  if (itr == table.ranges.end()) {
+    if (num_ranges_ >= max_ranges_) {
+      return;
+    }
+    itr = table.ranges.emplace(start_key, LockCounts()).first;
+    ++num_ranges_;
+  }
+  add(&itr->second);
+}
+
+void LockStats::RecordConflict(const TableID& table_id, const Key& start_key) {
+  Update(table_id, start_key,
+         [](LockCounts* counts) { ++counts->lock_conflicts; });
+}
+
+void LockStats::RecordAbort(const TableID& table_id, const Key& start_key) {
+  Update(table_id, start_key, [](LockCounts* counts) { ++counts->aborts; });
+}
+
+void LockStats::RecordWait(const TableID& table_id, const Key& start_key,
+                           absl::Duration wait) {
+  Update(table_id, start_key,
+         [wait](LockCounts* counts) { counts->lock_wait += wait; });
+}
+
+std::vector<LockStats::Entry> LockStats::TopRanges(int n) const {
+  std::vector<Entry> entries;
+  {
+    absl::MutexLock lock(&mu_);
+    entries.reserve(num_ranges_);
+    for (const auto& [table_id, table] : tables_) {
+      for (const auto& [start_key, counts] : table.ranges) {
+        entries.push_back(Entry{table_id, start_key, counts});
+      }
+    }
+  }
+  return Hottest(std::move(entries), n);
+}
+
+std::vector<LockStats::Entry> LockStats::TopTables(int n) const {
+  std::vector<Entry> entries;
+  {
+    absl::MutexLock lock(&mu_);
+    entries.reserve(tables_.size());
+    for (const auto& [table_id, table] : tables_) {
+      entries.push_back(Entry{table_id, Key(), table.totals});
+    }
+  }
+  return Hottest(std::move(entries), n);
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,112 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_LOCKING_LOCK_STATS_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_LOCKING_LOCK_STATS_H_
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "backend/common/ids.h"
+#include "backend/datamodel/key.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// Lock contention counted for a table or a range of keys.
+struct LockCounts {
+  // Number of lock requests which found conflicting locks held by other
+  // transactions.
+  int64_t lock_conflicts = 0;
+
+  // Number of transactions aborted over the locks: denied or wounded requests,
+  // and lock waits which timed out.
+  int64_t aborts = 0;
+
+  // Total time lock requests waited for conflicting locks to be released.
+  absl::Duration lock_wait = absl::ZeroDuration();
+};
+
+// LockStats counts lock conflicts, aborts and lock waits per table and per
+// range of keys locked, so that hot spots in a schema can be found. Ranges are
+// identified by the start key of their ClosedOpen form, so that the locks of a
+// row are counted together, and at most `max_ranges` of them are tracked: once
+// that many are, the contention of other ranges is only counted in the totals
+// of their table. Database-wide locks are not counted. Thread-safe.
+class LockStats {
+ public:
+  // The contention of a table, or of a range of keys if start_key is set.
+  struct Entry {
+    TableID table_id;
+    Key start_key;
+    LockCounts counts;
+  };
+
+  static constexpr int kDefaultMaxRanges = 10000;
+
+  explicit LockStats(int max_ranges = kDefaultMaxRanges)
+      : max_ranges_(max_ranges) {}
+
+  void RecordConflict(const TableID& table_id, const Key& start_key)
+      ABSL_LOCKS_EXCLUDED(mu_);
+  void RecordAbort(const TableID& table_id, const Key& start_key)
+      ABSL_LOCKS_EXCLUDED(mu_);
+  void RecordWait(const TableID& table_id, const Key& start_key,
+                  absl::Duration wait) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the `n` ranges with the longest lock waits, and then the most
+  // conflicts and aborts, hottest first.
+  std::vector<Entry> TopRanges(int n) const ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the `n` tables with the longest lock waits, and then the most
+  // conflicts and aborts, hottest first. Their start keys are empty.
+  std::vector<Entry> TopTables(int n) const ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  struct TableCounts {
+    LockCounts totals;
+    std::map<Key, LockCounts> ranges;
+  };
+
+  // Applies `add` to the counts of the table, and to those of the range if it
+  // is tracked or there is room to track it.
+  template <typename Add>
+  void Update(const TableID& table_id, const Key& start_key, Add add)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  const int max_ranges_;
+
+  mutable absl::Mutex mu_;
+
+  absl::flat_hash_map<TableID, TableCounts> tables_ ABSL_GUARDED_BY(mu_);
+
+  // Number of ranges tracked across all tables.
+  int num_ranges_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_LOCKING_LOCK_STATS_H_
@@ -0,0 +1,83 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/locking/lock_stats.h"
+
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/public/value.h"
+#include "absl/time/time.h"
+#include "backend/datamodel/key.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql::values::Int64;
+
+TEST(LockStatsTest, CountsContentionPerRangeAndTable) {
+  LockStats stats;
+  stats.RecordConflict("t1", Key({Int64(1)}));
+  stats.RecordConflict("t1", Key({Int64(1)}));
+  stats.RecordAbort("t1", Key({Int64(1)}));
+  stats.RecordConflict("t1", Key({Int64(2)}));
+  stats.RecordWait("t2", Key({Int64(1)}), absl::Seconds(1));
+
+  std::vector<LockStats::Entry> ranges = stats.TopRanges(10);
+  ASSERT_EQ(ranges.size(), 3);
+  EXPECT_EQ(ranges[0].table_id, "t2");
+  EXPECT_EQ(ranges[0].counts.lock_wait, absl::Seconds(1));
+  EXPECT_EQ(ranges[1].table_id, "t1");
+  EXPECT_EQ(ranges[1].start_key, Key({Int64(1)}));
+  EXPECT_EQ(ranges[1].counts.lock_conflicts, 2);
+  EXPECT_EQ(ranges[1].counts.aborts, 1);
+  EXPECT_EQ(ranges[2].start_key, Key({Int64(2)}));
+
+  std::vector<LockStats::Entry> tables = stats.TopTables(1);
+  ASSERT_EQ(tables.size(), 1);
+  EXPECT_EQ(tables[0].table_id, "t2");
+  tables = stats.TopTables(10);
+  ASSERT_EQ(tables.size(), 2);
+  EXPECT_EQ(tables[1].table_id, "t1");
+  EXPECT_EQ(tables[1].counts.lock_conflicts, 3);
+  EXPECT_EQ(tables[1].counts.aborts, 1);
+}
+
+TEST(LockStatsTest, UntrackedRangesAreCountedInTableTotals) {
+  LockStats stats(/*max_ranges=*/1);
+  stats.RecordConflict("t1", Key({Int64(1)}));
+  stats.RecordConflict("t1", Key({Int64(2)}));
+  stats.RecordConflict("t1", Key({Int64(1)}));
+
+  std::vector<LockStats::Entry> ranges = stats.TopRanges(10);
+  ASSERT_EQ(ranges.size(), 1);
+  EXPECT_EQ(ranges[0].start_key, Key({Int64(1)}));
+  EXPECT_EQ(ranges[0].counts.lock_conflicts, 2);
+
+  std::vector<LockStats::Entry> tables = stats.TopTables(10);
+  ASSERT_EQ(tables.size(), 1);
+  EXPECT_EQ(tables[0].counts.lock_conflicts, 3);
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -16,24 +16,318 @@
 
 #include "backend/locking/manager.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
 #include "zetasql/base/statusor.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "backend/common/ids.h"
+#include "backend/datamodel/key_range.h"
+#include "common/config.h"
 #include "common/errors.h"
+#include "common/metrics.h"
+#include "common/slow_log.h"
+#include "zetasql/base/status_macros.h"
 
 namespace google {
 namespace spanner {
 namespace emulator {
 namespace backend {
 
+namespace {
+
+// Returns the given time in unix microseconds, rounded up.
+int64_t ToUnixMicrosRoundedUp(absl::Time time) {
+  int64_t micros = absl::ToUnixMicros(time);
+  if (absl::FromUnixMicros(micros) < time &&
+      micros < std::numeric_limits<int64_t>::max()) {
+    ++micros;
+  }
+  return micros;
+}
+
+// Returns true if the given column sets have columns in common. An empty set
+// of columns represents the entire row.
+bool ColumnsOverlap(const std::vector<ColumnID>& a,
+                    const std::vector<ColumnID>& b) {
+  if (a.empty() || b.empty()) {
+    return true;
+  }
+  for (const ColumnID& column_id : a) {
+    if (std::find(b.begin(), b.end(), column_id) != b.end()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ModesConflict(LockMode a, LockMode b) {
+  return a == LockMode::kExclusive || b == LockMode::kExclusive;
+}
+
+LockMode StrongerMode(LockMode a, LockMode b) {
+  return ModesConflict(a, b) ? LockMode::kExclusive : LockMode::kShared;
+}
+
+// Merges the columns in `other` into `column_ids`.
+void MergeColumns(const std::vector<ColumnID>& other,
+                  std::vector<ColumnID>* column_ids) {
+  if (column_ids->empty()) {
+    return;
+  }
+  if (other.empty()) {
+    column_ids->clear();
+    return;
+  }
+  column_ids->insert(column_ids->end(), other.begin(), other.end());
+  std::sort(column_ids->begin(), column_ids->end());
+  column_ids->erase(std::unique(column_ids->begin(), column_ids->end()),
+                    column_ids->end());
+}
+
+}  // namespace
+
+LockManager::LockManager(Clock* clock)
+    : LockManager(clock, config::lock_wait_timeout()) {}
+
 std::unique_ptr<LockHandle> LockManager::CreateHandle(
     TransactionID tid, TransactionPriority priority) {
   return absl::WrapUnique(new LockHandle(this, tid, priority));
 }
 
+void LockManager::FindConflicts(LockHandle* handle, const LockRequest& request,
+                                const KeyRange& key_range,
+                                absl::flat_hash_set<LockHandle*>* conflicts) {
+  // Database-wide locks conflict with every other lock.
+  for (const auto& [holder, mode] : database_locks_) {
+    if (holder != handle && ModesConflict(mode, request.mode())) {
+      conflicts->insert(holder);
+    }
+  }
+
+  if (request.IsDatabaseWide()) {
+    for (const auto& [holder, lock_refs] : held_locks_) {
+      if (holder == handle) {
+        continue;
+      }
+      for (const LockRef& lock_ref : lock_refs) {
+        if (ModesConflict(lock_ref.node->value().mode, request.mode())) {
+          conflicts->insert(holder);
+          break;
+        }
+      }
+    }
+    // Commits that are already in progress also prevent a database-wide lock
+    // from being granted, even if they did not acquire any other locks.
+    for (const auto& [holder, timestamp] : pending_commit_timestamps_) {
+      if (holder != handle) {
+        conflicts->insert(holder);
+      }
+    }
+    return;
+  }
+
+  auto table_itr = table_locks_.find(request.table_id());
+  if (table_itr == table_locks_.end()) {
+    return;
+  }
+  const TableLocks& table_locks = table_itr->second;
+  auto check_lock = [&](const Lock& lock) {
+    if (lock.handle != handle && ModesConflict(lock.mode, request.mode()) &&
+        ColumnsOverlap(lock.column_ids, request.column_ids())) {
+      conflicts->insert(lock.handle);
+    }
+  };
+
+  // A point lock on a key prefix (e.g. from a read of KeyRange::Prefix) covers
+  // the keys up to the prefix limit, so it overlaps requests for the keys with
+  // that prefix.
+  table_locks.ForEachOverlapping(key_range.start_key(), key_range.limit_key(),
+                                 check_lock);
+}
+
+void LockManager::GrantLock(LockHandle* handle, const LockRequest& request,
+                            const KeyRange& key_range) {
+  if (request.IsDatabaseWide()) {
+    auto [itr, inserted] = database_locks_.emplace(handle, request.mode());
+    if (!inserted) {
+      itr->second = StrongerMode(itr->second, request.mode());
+    }
+    return;
+  }
+
+  TableLocks& table_locks = table_locks_[request.table_id()];
+
+  // Re-requesting a range that the transaction already holds a lock on only
+  // strengthens the existing lock to keep the lock table compact.
+  TableLocks::Node* held = table_locks.FindWithStart(
+      key_range.start_key(), [&](const TableLocks::Node& node) {
+        return node.value().handle == handle &&
+               node.limit() == key_range.limit_key();
+      });
+  if (held != nullptr) {
+    Lock& lock = held->value();
+    lock.mode = StrongerMode(lock.mode, request.mode());
+    MergeColumns(request.column_ids(), &lock.column_ids);
+    return;
+  }
+
+  TableLocks::Node* node = table_locks.Insert(
+      key_range.start_key(), key_range.limit_key(),
+      Lock{handle, request.mode(), request.column_ids()});
+  held_locks_[handle].push_back(
+      LockRef{request.table_id(), &table_locks, node});
+}
+
+void LockManager::ReleaseLocks(LockHandle* handle) {
+  database_locks_.erase(handle);
+
+  auto held_itr = held_locks_.find(handle);
+  if (held_itr == held_locks_.end()) {
+    return;
+  }
+  for (const LockRef& lock_ref : held_itr->second) {
+    lock_ref.locks->Erase(lock_ref.node);
+  }
+  for (const LockRef& lock_ref : held_itr->second) {
+    auto table_itr = table_locks_.find(lock_ref.table_id);
+    if (table_itr != table_locks_.end() && table_itr->second.empty()) {
+      table_locks_.erase(table_itr);
+    }
+  }
+  held_locks_.erase(held_itr);
+}
+
+bool LockManager::CanWound(LockHandle* handle, LockHandle* holder) const {
+  // Commits in progress and schema changes are never wounded.
+  if (pending_commit_timestamps_.contains(holder) ||
+      database_locks_.contains(holder)) {
+    return false;
+  }
+  return handle->priority() < holder->priority();
+}
+
+LockManager::LockResult LockManager::TryLock(LockHandle* handle,
+                                             const LockRequest& request,
+                                             const KeyRange& key_range,
+                                             bool is_retry,
+                                             TransactionID* holder_tid) {
+  absl::flat_hash_set<LockHandle*> conflicts;
+  FindConflicts(handle, request, key_range, &conflicts);
+  if (!conflicts.empty() && !is_retry && !request.IsDatabaseWide()) {
+    lock_stats_.RecordConflict(request.table_id(), key_range.start_key());
+  }
+
+  // Database-wide locks are only granted when there are no conflicts at all.
+  // Other requests wait for the conflicting transactions which cannot be
+  // wounded, or are denied if waits are disabled.
+  bool must_wait = false;
+  for (LockHandle* holder : conflicts) {
+    if (request.IsDatabaseWide() ||
+        (!CanWound(handle, holder) &&
+         lock_wait_timeout_ <= absl::ZeroDuration())) {
+      handle->Abort(
+          error::AbortConcurrentTransaction(handle->tid(), holder->tid()));
+      if (!request.IsDatabaseWide()) {
+        lock_stats_.RecordAbort(request.table_id(), key_range.start_key());
+      }
+      return LockResult::kDenied;
+    }
+    if (!CanWound(handle, holder)) {
+      *holder_tid = holder->tid();
+      must_wait = true;
+    }
+  }
+  if (must_wait) {
+    return LockResult::kWaiting;
+  }
+
+  // Otherwise, this is an older transaction. Wound the younger holders, their
+  // next lock request or commit will observe the abort.
+  for (LockHandle* holder : conflicts) {
+    Wound(handle, holder);
+    lock_stats_.RecordAbort(request.table_id(), key_range.start_key());
+  }
+  GrantLock(handle, request, key_range);
+  return LockResult::kGranted;
+}
+
+void LockManager::Wound(LockHandle* handle, LockHandle* holder) {
+  holder->Abort(
+      error::AbortConcurrentTransaction(holder->tid(), handle->tid()));
+  ReleaseLocks(holder);
+  CancelWaitingRequests(holder);
+}
+
+void LockManager::RecordWait(const WaitingRequest& waiting) {
+  lock_stats_.RecordWait(waiting.request.table_id(),
+                         waiting.key_range.start_key(),
+                         absl::Now() - waiting.enqueue_time);
+}
+
+void LockManager::CancelWaitingRequests(LockHandle* handle) {
+  if (num_waiting_requests_.erase(handle) == 0) {
+    return;
+  }
+  auto range = waiting_requests_.equal_range(handle->priority());
+  for (auto itr = range.first; itr != range.second;) {
+    if (itr->second.handle == handle) {
+      RecordWait(itr->second);
+      itr = waiting_requests_.erase(itr);
+    } else {
+      ++itr;
+    }
+  }
+  lock_wait_cvar_.SignalAll();
+}
+
+void LockManager::GrantWaitingRequests() {
+  bool changed = false;
+  std::vector<LockHandle*> denied;
+  for (auto itr = waiting_requests_.begin(); itr != waiting_requests_.end();) {
+    WaitingRequest& waiting = itr->second;
+    // Wounds only affect younger transactions, which sort after this one, so
+    // the iterator stays valid.
+    LockResult result =
+        waiting.handle->IsAborted()
+            ? LockResult::kDenied
+            : TryLock(waiting.handle, waiting.request, waiting.key_range,
+                      /*is_retry=*/true, &waiting.holder_tid);
+    if (result == LockResult::kWaiting) {
+      ++itr;
+      continue;
+    }
+    if (result == LockResult::kDenied) {
+      denied.push_back(waiting.handle);
+    }
+    auto count_itr = num_waiting_requests_.find(waiting.handle);
+    if (--count_itr->second == 0) {
+      num_waiting_requests_.erase(count_itr);
+    }
+    RecordWait(waiting);
+    itr = waiting_requests_.erase(itr);
+    changed = true;
+  }
+  for (LockHandle* handle : denied) {
+    CancelWaitingRequests(handle);
+  }
+  if (changed) {
+    lock_wait_cvar_.SignalAll();
+  }
+}
+
 void LockManager::EnqueueLock(LockHandle* handle, const LockRequest& request) {
+  // Lock requests are granted, denied or queued right away, so the time spent
+  // here is mostly contention on the lock manager. Waits are recorded by
+  // Wait().
+  static metrics::Histogram* const lock_acquire_latency =
+      metrics::StageLatency("lock_acquire");
+  metrics::ScopedLatencyRecorder recorder(lock_acquire_latency);
   absl::MutexLock lock(&mu_);
 
   // Don't hand out locks to aborted handles.
@@ -41,83 +335,296 @@ void LockManager::EnqueueLock(LockHandle* handle, const LockRequest& request) {
     return;
   }
 
-  // If there is no transaction holding the lock, we grant it.
-  if (active_tid_ == kInvalidTransactionID) {
-    active_tid_ = handle->tid();
+  // Empty ranges do not need to be locked.
+  KeyRange key_range = request.key_range().ToClosedOpen();
+  if (!request.IsDatabaseWide() &&
+      key_range.start_key() >= key_range.limit_key()) {
     return;
   }
 
-  // If the requesting transaction is already holding the lock, we grant it.
-  if (active_tid_ == handle->tid()) {
-    return;
+  TransactionID holder_tid = 0;
+  switch (TryLock(handle, request, key_range, /*is_retry=*/false,
+                  &holder_tid)) {
+    case LockResult::kGranted:
+      // Wounded transactions may have released locks that others wait for.
+      GrantWaitingRequests();
+      break;
+    case LockResult::kWaiting:
+      waiting_requests_.emplace(
+          handle->priority(),
+          WaitingRequest{handle, request, key_range, holder_tid, absl::Now()});
+      ++num_waiting_requests_[handle];
+      break;
+    case LockResult::kDenied:
+      break;
   }
+}
 
-  // If we reached here, another transaction is already holding the lock, deny.
-  handle->Abort(error::AbortConcurrentTransaction(handle->tid(), active_tid_));
+bool LockManager::IsBlocked(LockHandle* handle) {
+  absl::MutexLock lock(&mu_);
+  return num_waiting_requests_.contains(handle);
 }
 
-void LockManager::UnlockAll(LockHandle* handle) {
+absl::Status LockManager::Wait(LockHandle* handle) {
   absl::MutexLock lock(&mu_);
+  if (!num_waiting_requests_.contains(handle)) {
+    return handle->status();
+  }
 
-  // If the transaction does not hold the lock, there is nothing to do.
-  if (active_tid_ != handle->tid()) {
-    handle->Reset();
-    return;
+  static metrics::Histogram* const lock_wait_latency =
+      metrics::StageLatency("lock_wait");
+  metrics::ScopedLatencyRecorder recorder(lock_wait_latency);
+  const absl::Time start = absl::Now();
+  const absl::Time deadline = start + lock_wait_timeout_;
+  while (num_waiting_requests_.contains(handle)) {
+    if (lock_wait_cvar_.WaitWithDeadline(&mu_, deadline)) {
+      break;
+    }
   }
+  slow_log::AddLockWait(absl::Now() - start);
+  if (!num_waiting_requests_.contains(handle)) {
+    return handle->status();
+  }
+
+  // The wait timed out, give up on all the waiting requests. The abort is
+  // counted against the range of the first of them.
+  TransactionID holder_tid = 0;
+  for (const auto& [priority, waiting] : waiting_requests_) {
+    if (waiting.handle == handle) {
+      holder_tid = waiting.holder_tid;
+      lock_stats_.RecordAbort(waiting.request.table_id(),
+                              waiting.key_range.start_key());
+      break;
+    }
+  }
+  CancelWaitingRequests(handle);
+  handle->Abort(
+      error::LockWaitTimeout(handle->tid(), holder_tid, lock_wait_timeout_));
+  return handle->status();
+}
 
-  // Clear the active transaction if it holds the lock.
-  active_tid_ = kInvalidTransactionID;
+void LockManager::UnlockAll(LockHandle* handle) {
+  absl::MutexLock lock(&mu_);
+
+  ReleaseLocks(handle);
+  CancelWaitingRequests(handle);
+  active_read_timestamps_.erase(handle);
+  handle->registered_read_micros_.store(std::numeric_limits<int64_t>::max(),
+                                        std::memory_order_relaxed);
+
+  // A transaction which reserved a commit timestamp but never marked it as
+  // committed should not hold back safe reads.
+  if (pending_commit_timestamps_.erase(handle) > 0) {
+    num_pending_commits_.fetch_sub(1);
+    PublishSafeReadWatermark();
+    pending_commit_cvar_.SignalAll();
+  }
   handle->Reset();
+
+  // Waiting requests may be granted the released locks.
+  GrantWaitingRequests();
+}
+
+void LockManager::Expire(LockHandle* handle, const absl::Status& status) {
+  absl::MutexLock lock(&mu_);
+  if (pending_commit_timestamps_.contains(handle) ||
+      database_locks_.contains(handle)) {
+    return;
+  }
+  handle->Abort(status);
+  ReleaseLocks(handle);
+  CancelWaitingRequests(handle);
+  GrantWaitingRequests();
 }
 
 zetasql_base::StatusOr<absl::Time> LockManager::ReserveCommitTimestamp(
     LockHandle* handle) {
   absl::MutexLock lock(&mu_);
+  return ReserveCommitTimestampLocked(handle);
+}
 
-  // If there is no transaction holding the lock, we grant it to the transaction
-  // requesting commit timestamp. This can happen if transaction has empty
-  // mutations and write locks weren't thus acquired yet.
-  if (active_tid_ == kInvalidTransactionID) {
-    active_tid_ = handle->tid();
-  } else if (active_tid_ != handle->tid()) {
-    // There is another active transaction, abort this transaction.
-    return error::AbortConcurrentTransaction(handle->tid(), active_tid_);
+std::vector<zetasql_base::StatusOr<absl::Time>>
+LockManager::ReserveCommitTimestamps(absl::Span<LockHandle* const> handles) {
+  absl::MutexLock lock(&mu_);
+  std::vector<zetasql_base::StatusOr<absl::Time>> commit_timestamps;
+  commit_timestamps.reserve(handles.size());
+  for (LockHandle* handle : handles) {
+    commit_timestamps.push_back(ReserveCommitTimestampLocked(handle));
   }
+  return commit_timestamps;
+}
+
+zetasql_base::StatusOr<absl::Time> LockManager::ReserveCommitTimestampLocked(
+    LockHandle* handle) {
+  // A transaction which was wounded by an older transaction cannot commit.
+  ZETASQL_RETURN_IF_ERROR(handle->status());
 
-  pending_commit_timestamp_ = clock_->Now();
-  return pending_commit_timestamp_;
+  // Transactions cannot commit while a schema change is in progress. This
+  // covers transactions with empty mutations which never acquired any locks.
+  for (const auto& [holder, mode] : database_locks_) {
+    if (holder != handle) {
+      return error::AbortConcurrentTransaction(handle->tid(), holder->tid());
+    }
+  }
+
+  // The commit is counted as pending before its timestamp is drawn, see
+  // num_pending_commits_.
+  auto [itr, inserted] = pending_commit_timestamps_.try_emplace(handle);
+  if (inserted) {
+    num_pending_commits_.fetch_add(1);
+  }
+  itr->second = clock_->Now();
+  return itr->second;
 }
 
 absl::Status LockManager::MarkCommitted(LockHandle* handle) {
   absl::MutexLock lock(&mu_);
+  absl::Status status = MarkCommittedLocked(handle);
+  PublishSafeReadWatermark();
+  pending_commit_cvar_.SignalAll();
+  return status;
+}
 
-  // This transaction should have been set as the active transaction.
-  ZETASQL_RET_CHECK_EQ(active_tid_, handle->tid())
-      << absl::Substitute("Transaction $0 is not active.", handle->tid());
-
-  last_commit_timestamp_ = pending_commit_timestamp_;
-  pending_commit_timestamp_ = absl::InfiniteFuture();
+std::vector<absl::Status> LockManager::MarkCommitted(
+    absl::Span<LockHandle* const> handles) {
+  absl::MutexLock lock(&mu_);
+  std::vector<absl::Status> statuses;
+  statuses.reserve(handles.size());
+  for (LockHandle* handle : handles) {
+    statuses.push_back(MarkCommittedLocked(handle));
+  }
+  PublishSafeReadWatermark();
   pending_commit_cvar_.SignalAll();
+  return statuses;
+}
+
+absl::Status LockManager::MarkCommittedLocked(LockHandle* handle) {
+  // This transaction should have reserved a commit timestamp.
+  auto itr = pending_commit_timestamps_.find(handle);
+  ZETASQL_RET_CHECK(itr != pending_commit_timestamps_.end()) << absl::Substitute(
+      "Transaction $0 does not have a pending commit.", handle->tid());
+
+  last_commit_timestamp_ = std::max(last_commit_timestamp_, itr->second);
+  pending_commit_timestamps_.erase(itr);
+  num_pending_commits_.fetch_sub(1);
   return absl::OkStatus();
 }
 
-void LockManager::WaitForSafeRead(absl::Time read_time) {
+absl::Time LockManager::MinPendingCommitTimestamp() const {
+  absl::Time min_timestamp = absl::InfiniteFuture();
+  for (const auto& [handle, timestamp] : pending_commit_timestamps_) {
+    min_timestamp = std::min(min_timestamp, timestamp);
+  }
+  return min_timestamp;
+}
+
+void LockManager::PublishSafeReadWatermark() {
+  // A read at a pending commit's timestamp must wait for it as well.
+  const absl::Time watermark =
+      std::min(last_commit_timestamp_,
+               MinPendingCommitTimestamp() - absl::Microseconds(1));
+  safe_read_watermark_micros_.store(absl::ToUnixMicros(watermark),
+                                    std::memory_order_release);
+  last_commit_micros_.store(absl::ToUnixMicros(last_commit_timestamp_),
+                            std::memory_order_release);
+}
+
+void LockManager::WaitForSafeRead(LockHandle* handle, absl::Time read_time) {
+  // Fast path: the handle already registered a read timestamp which retains
+  // the versions visible at read_time, and no commit at or before read_time can
+  // be in flight. The latter holds either if read_time is covered by the safe
+  // read watermark, or if read_time is not after a timestamp drawn from the
+  // clock and no commit was pending after it was drawn, since later commits
+  // draw greater timestamps. The acquire loads pair with the updates made by
+  // commits under mu_, so their writes are visible to the read.
+  if (handle->registered_read_micros_.load(std::memory_order_relaxed) <=
+      absl::ToUnixMicros(read_time)) {
+    if (read_time <= absl::FromUnixMicros(safe_read_watermark_micros_.load(
+                         std::memory_order_acquire))) {
+      return;
+    }
+    if (read_time <= clock_->NowForRead() &&
+        num_pending_commits_.load() == 0) {
+      return;
+    }
+  }
+
+  static metrics::Histogram* const safe_read_wait_latency =
+      metrics::StageLatency("safe_read_wait");
+  metrics::ScopedLatencyRecorder recorder(safe_read_wait_latency);
   absl::MutexLock lock(&mu_);
 
+  // Register the read timestamp before waiting so that versions visible to the
+  // read are retained by garbage collection.
+  auto [itr, inserted] = active_read_timestamps_.emplace(handle, read_time);
+  if (!inserted) {
+    itr->second = std::min(itr->second, read_time);
+  }
+  handle->registered_read_micros_.store(ToUnixMicrosRoundedUp(itr->second),
+                                        std::memory_order_relaxed);
+
   // Wait for read time to become current if passed a future timestamp  for the
   // case of exact timestamp bound for snapshot read.
   // https://cloud.google.com/spanner/docs/timestamp-bounds#introduction
   bool f = false;
   mu_.AwaitWithDeadline(absl::Condition(&f), read_time);
 
-  while (pending_commit_timestamp_ < read_time) {
-    pending_commit_cvar_.Wait(&mu_);
+  if (MinPendingCommitTimestamp() < read_time) {
+    // Waiting for the commits which hold back the read is accounted as lock
+    // waits of the request.
+    const absl::Time start = absl::Now();
+    while (MinPendingCommitTimestamp() < read_time) {
+      pending_commit_cvar_.Wait(&mu_);
+    }
+    slow_log::AddLockWait(absl::Now() - start);
   }
 }
 
 absl::Time LockManager::LastCommitTimestamp() {
+  const int64_t micros = last_commit_micros_.load(std::memory_order_acquire);
+  if (micros == std::numeric_limits<int64_t>::min()) {
+    return absl::InfinitePast();
+  }
+  return absl::FromUnixMicros(micros);
+}
+
+absl::Time LockManager::SafeReadTimestamp() {
+  // As in WaitForSafeRead, a timestamp drawn from the clock is safe if no
+  // commit was pending after it was drawn, since later commits draw greater
+  // timestamps.
+  const absl::Time now = clock_->NowForRead();
+  if (num_pending_commits_.load() == 0) {
+    return now;
+  }
+  return absl::FromUnixMicros(
+      safe_read_watermark_micros_.load(std::memory_order_acquire));
+}
+
+absl::Time LockManager::OldestActiveReadTimestamp() {
+  absl::ReaderMutexLock lock(&mu_);
+  absl::Time oldest_timestamp = absl::InfiniteFuture();
+  for (const auto& [handle, timestamp] : active_read_timestamps_) {
+    oldest_timestamp = std::min(oldest_timestamp, timestamp);
+  }
+  return oldest_timestamp;
+}
+
+absl::Time LockManager::StrongReadTimestamp() {
+  // Without pending commits, no schema change has reserved a commit timestamp
+  // before the current time either.
+  absl::Time read_timestamp = clock_->NowForRead();
+  if (num_pending_commits_.load() == 0) {
+    return read_timestamp;
+  }
   absl::ReaderMutexLock lock(&mu_);
-  return last_commit_timestamp_;
+  for (const auto& [holder, mode] : database_locks_) {
+    auto itr = pending_commit_timestamps_.find(holder);
+    if (itr != pending_commit_timestamps_.end()) {
+      read_timestamp =
+          std::min(read_timestamp, itr->second - absl::Microseconds(1));
+    }
+  }
+  return read_timestamp;
 }
 
 }  // namespace backend
@@ -17,13 +17,27 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_LOCKING_MANAGER_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_LOCKING_MANAGER_H_
 
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <map>
 #include <memory>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/container/node_hash_map.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "backend/common/ids.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
 #include "backend/locking/handle.h"
+#include "backend/locking/interval_tree.h"
+#include "backend/locking/lock_stats.h"
+#include "backend/locking/request.h"
 #include "common/clock.h"
 
 namespace google {
@@ -38,12 +52,33 @@ namespace backend {
 // happens via the LockHandle. See LockHandle methods for more details about
 // this interaction.
 //
-// We currently only implement a whole-database lock. The interface is generic
-// to avoid irreversibly baking the single-lock assumption into the rest of the
-// system.
+// Locks are tracked per table at key-range granularity. Shared locks on
+// overlapping ranges are compatible with each other, exclusive locks conflict
+// with any other lock on an overlapping range. Column ids narrow a lock to a
+// subset of the row's cells; a request with no column ids covers the entire
+// row (including its existence). Requests with an empty table id lock the
+// whole database and are used by schema changes.
+//
+// Conflicts are resolved using wound-wait on the transaction priority: an
+// older (lower priority value) transaction wounds, i.e. aborts and releases
+// the locks of, younger conflicting holders that have not yet started
+// committing. A request conflicting with older or committing holders waits
+// for them to release their locks, for at most the lock wait timeout, after
+// which its transaction is aborted. Since transactions only wait for older or
+// committing ones, waits never form a cycle. Waiting requests are granted
+// oldest transaction first. Database-wide requests never wait.
+//
+// The conflicts, aborts and lock waits of the requests on each table and
+// range of keys are counted in lock_stats(), see LockStats.
 class LockManager {
  public:
-  explicit LockManager(Clock* clock) : clock_(clock) {}
+  // Lock requests wait at most config::lock_wait_timeout().
+  explicit LockManager(Clock* clock);
+
+  // Lock requests wait at most `lock_wait_timeout`, a zero timeout aborts
+  // conflicting requests right away.
+  LockManager(Clock* clock, absl::Duration lock_wait_timeout)
+      : clock_(clock), lock_wait_timeout_(lock_wait_timeout) {}
 
   // Returns a handle for a single transaction with the given id and priority.
   // Subsequent communication between the transaction and the lock manager
@@ -52,37 +87,241 @@ class LockManager {
                                            TransactionPriority priority);
 
   // Returns the timestamp at which last schema update or commit completed.
+  // Does not acquire the manager's mutex.
   absl::Time LastCommitTimestamp();
 
+  // Returns the latest timestamp at which a read does not wait for commits in
+  // progress, including a schema change: the current time if there are none,
+  // or else the safe read watermark. Does not acquire the manager's mutex.
+  absl::Time SafeReadTimestamp();
+
+  // Returns the oldest read timestamp in use by a transaction which has not
+  // yet released its locks, or absl::InfiniteFuture() if there is none. Data
+  // versions visible at or after this timestamp must be retained.
+  absl::Time OldestActiveReadTimestamp() ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the timestamp at which a strong read should be performed. This is
+  // the current time, unless a schema change has reserved its commit timestamp,
+  // in which case it is the timestamp just before the schema change. No other
+  // transaction can commit while a schema change holds its database-wide lock,
+  // so such a read observes all completed commits with the previous schema,
+  // instead of waiting for the schema change (and its backfills) to finish.
+  // The timestamp is drawn with Clock::NowForRead(), so concurrent strong
+  // reads may share it, and the mutex is only acquired if a commit is pending.
+  absl::Time StrongReadTimestamp() ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Reserves commit timestamps for a group of transactions which commit
+  // together, under a single acquisition of the manager's mutex. Timestamps
+  // increase in the order of `handles`. Each entry of the result is what
+  // LockHandle::ReserveCommitTimestamp would have returned for the handle.
+  std::vector<zetasql_base::StatusOr<absl::Time>> ReserveCommitTimestamps(
+      absl::Span<LockHandle* const> handles) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Marks a group of transactions which reserved commit timestamps as
+  // committed, waking up the reads waiting for them once.
+  std::vector<absl::Status> MarkCommitted(absl::Span<LockHandle* const> handles)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the lock contention counted by the manager.
+  const LockStats& lock_stats() const { return lock_stats_; }
+
  private:
+  // A lock granted to a transaction.
+  struct Lock {
+    // The handle of the transaction which holds this lock.
+    LockHandle* handle;
+
+    // The mode in which the lock is held.
+    LockMode mode;
+
+    // The locked columns, empty if the entire row is locked.
+    std::vector<ColumnID> column_ids;
+  };
+
+  // The locks on a table, for their ClosedOpen ranges of keys. Point locks
+  // cover the range from their key to its prefix limit. Finding the locks
+  // overlapping a request takes time logarithmic in the number of locks on the
+  // table, plus linear in the number of overlapping locks, so requests on
+  // disjoint keys do not slow each other down however many locks are held.
+  using TableLocks = IntervalTree<Key, Lock>;
+
+  // Reference to a lock held by a transaction, used to release it.
+  struct LockRef {
+    TableID table_id;
+    TableLocks* locks;
+    TableLocks::Node* node;
+  };
+
+  // A lock request waiting for conflicting locks to be released.
+  struct WaitingRequest {
+    // The handle of the transaction which made the request.
+    LockHandle* handle;
+
+    LockRequest request;
+
+    // The requested range of keys in ClosedOpen format.
+    KeyRange key_range;
+
+    // A transaction holding a conflicting lock, reported if the wait times
+    // out.
+    TransactionID holder_tid;
+
+    // When the request started waiting.
+    absl::Time enqueue_time;
+  };
+
+  // Outcome of an attempt to acquire a lock.
+  enum class LockResult { kGranted, kDenied, kWaiting };
+
   // LockHandle simply forwards requests to the LockManager.
   friend class LockHandle;
   void EnqueueLock(LockHandle* handle, const LockRequest& request)
       ABSL_LOCKS_EXCLUDED(mu_);
   void UnlockAll(LockHandle* handle) ABSL_LOCKS_EXCLUDED(mu_);
+  void Expire(LockHandle* handle, const absl::Status& status)
+      ABSL_LOCKS_EXCLUDED(mu_);
   zetasql_base::StatusOr<absl::Time> ReserveCommitTimestamp(LockHandle* handle)
       ABSL_LOCKS_EXCLUDED(mu_);
   absl::Status MarkCommitted(LockHandle* handle) ABSL_LOCKS_EXCLUDED(mu_);
-  void WaitForSafeRead(absl::Time read_time) ABSL_LOCKS_EXCLUDED(mu_);
+  bool IsBlocked(LockHandle* handle) ABSL_LOCKS_EXCLUDED(mu_);
+  absl::Status Wait(LockHandle* handle) ABSL_LOCKS_EXCLUDED(mu_);
+  void WaitForSafeRead(LockHandle* handle, absl::Time read_time)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Adds the handles of all other transactions whose locks conflict with
+  // `request` to `conflicts`.
+  void FindConflicts(LockHandle* handle, const LockRequest& request,
+                     const KeyRange& key_range,
+                     absl::flat_hash_set<LockHandle*>* conflicts)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Grants `request` to `handle`, merging it with an identical-range lock
+  // already held by the same transaction if there is one.
+  void GrantLock(LockHandle* handle, const LockRequest& request,
+                 const KeyRange& key_range) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Releases all the locks held by `handle`.
+  void ReleaseLocks(LockHandle* handle) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Grants `request` to `handle` if it does not conflict with locks held by
+  // other transactions, or if all of them can be wounded, in which case they
+  // are. Otherwise, denies the request by aborting `handle`, or returns
+  // kWaiting and sets `holder_tid` to a conflicting holder if it should wait.
+  // Conflicts are counted in lock_stats_ unless `is_retry`, i.e. on the first
+  // attempt of the request only.
+  LockResult TryLock(LockHandle* handle, const LockRequest& request,
+                     const KeyRange& key_range, bool is_retry,
+                     TransactionID* holder_tid)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Aborts `holder` on behalf of the older transaction of `handle`, releasing
+  // its locks and cancelling its waiting requests.
+  void Wound(LockHandle* handle, LockHandle* holder)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Counts the time `waiting` waited in lock_stats_, once it stops waiting.
+  void RecordWait(const WaitingRequest& waiting)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Removes the waiting requests of `handle`.
+  void CancelWaitingRequests(LockHandle* handle)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Retries the waiting requests, oldest transaction first, after locks were
+  // released.
+  void GrantWaitingRequests() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Returns true if `handle` may wound `holder` under wound-wait, i.e. `handle`
+  // belongs to an older transaction and `holder` has not started committing.
+  bool CanWound(LockHandle* handle, LockHandle* holder) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Implementations of ReserveCommitTimestamp and MarkCommitted for a single
+  // handle. MarkCommittedLocked does not publish the safe read watermark nor
+  // wake up waiting reads, which callers do once for a group.
+  zetasql_base::StatusOr<absl::Time> ReserveCommitTimestampLocked(
+      LockHandle* handle) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  absl::Status MarkCommittedLocked(LockHandle* handle)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Returns the earliest commit timestamp in use by an in-progress commit.
+  absl::Time MinPendingCommitTimestamp() const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Publishes the safe read watermark after the last commit timestamp or the
+  // pending commits changed.
+  void PublishSafeReadWatermark() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
   // Mutex to guard state below.
   absl::Mutex mu_;
 
-  // The currently active transaction ID (only one transaction can be active).
-  TransactionID active_tid_ ABSL_GUARDED_BY(mu_) = kInvalidTransactionID;
+  // Locks held on individual tables. A node hash map is used since LockRefs
+  // point into the table entries.
+  absl::node_hash_map<TableID, TableLocks> table_locks_ ABSL_GUARDED_BY(mu_);
+
+  // Transactions holding database-wide locks, along with the lock mode.
+  absl::flat_hash_map<LockHandle*, LockMode> database_locks_
+      ABSL_GUARDED_BY(mu_);
+
+  // Table locks held by each transaction.
+  absl::flat_hash_map<LockHandle*, std::vector<LockRef>> held_locks_
+      ABSL_GUARDED_BY(mu_);
 
   // System wide monotonic clock used to provide commit and read timestamps.
   Clock* clock_;
 
+  // How long lock requests wait for conflicting locks to be released.
+  const absl::Duration lock_wait_timeout_;
+
+  // Lock requests waiting for conflicting locks to be released, ordered by the
+  // priority of their transaction (oldest first) and then by arrival.
+  std::multimap<TransactionPriority, WaitingRequest> waiting_requests_
+      ABSL_GUARDED_BY(mu_);
+
+  // Number of entries in waiting_requests_ for each transaction.
+  absl::flat_hash_map<LockHandle*, int> num_waiting_requests_
+      ABSL_GUARDED_BY(mu_);
+
+  // Signalled when waiting requests are granted, denied or cancelled.
+  absl::CondVar lock_wait_cvar_;
+
   // Timestamp at which last schema update or commit completed.
   absl::Time last_commit_timestamp_ ABSL_GUARDED_BY(mu_) = absl::InfinitePast();
 
-  // Commit timestamp being used by an in-progress commit.
-  absl::Time pending_commit_timestamp_ ABSL_GUARDED_BY(mu_) =
-      absl::InfiniteFuture();
+  // Commit timestamps being used by in-progress commits.
+  absl::flat_hash_map<LockHandle*, absl::Time> pending_commit_timestamps_
+      ABSL_GUARDED_BY(mu_);
 
   // Signals completion of pending commit.
   absl::CondVar pending_commit_cvar_ ABSL_GUARDED_BY(mu_);
+
+  // Read timestamps in use by each transaction, registered on the first call
+  // to WaitForSafeRead and released by UnlockAll.
+  absl::flat_hash_map<LockHandle*, absl::Time> active_read_timestamps_
+      ABSL_GUARDED_BY(mu_);
+
+  // Timestamp in unix microseconds at or before which reads are safe, i.e. the
+  // minimum of last_commit_timestamp_ and the timestamps just before the
+  // pending commit timestamps. It never decreases, since commit timestamps are
+  // reserved from a monotonic clock after the last commit completed. Published
+  // under mu_ and read without it by WaitForSafeRead, so strong and snapshot
+  // reads in the past do not contend on mu_ unless a commit at or before them
+  // is in flight.
+  std::atomic<int64_t> safe_read_watermark_micros_{
+      std::numeric_limits<int64_t>::min()};
+
+  // last_commit_timestamp_ in unix microseconds, published along with the safe
+  // read watermark so that LastCommitTimestamp() does not contend on mu_.
+  std::atomic<int64_t> last_commit_micros_{std::numeric_limits<int64_t>::min()};
+
+  // Number of entries in pending_commit_timestamps_. Commits count themselves
+  // here before drawing their timestamp from the clock, so a read which draws
+  // a timestamp from the clock and then finds no pending commit knows that
+  // every later commit gets a greater timestamp than its read timestamp.
+  std::atomic<int64_t> num_pending_commits_{0};
+
+  // Lock contention per table and range of keys.
+  LockStats lock_stats_;
 };
 
 }  // namespace backend
@@ -0,0 +1,153 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Measures the cost of the lock manager operations made by a read-write
+// transaction, from creating its lock handle through committing, when they are
+// made by an increasing number of threads locking disjoint rows, and while an
+// increasing number of read ranges of other transactions are locked.
+//
+// Usage: manager_benchmark [--benchmark_format=table|json]
+//            [--benchmark_min_time=500ms] [--benchmark_filter=...]
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "zetasql/public/value.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "backend/common/ids.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/locking/handle.h"
+#include "backend/locking/manager.h"
+#include "backend/locking/request.h"
+#include "common/benchmark.h"
+#include "common/clock.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+constexpr int kNumThreads[] = {1, 4, 16};
+
+constexpr int kNumHeldRanges[] = {100, 10000, 100000};
+
+// Number of rows in each range locked by readers, and between two ranges.
+constexpr int64_t kRowsPerRange = 10;
+
+// Runs the lock manager operations of a transaction which writes `row`.
+absl::Status RunTransaction(LockManager* lock_manager, TransactionID id,
+                            int64_t row) {
+  std::unique_ptr<LockHandle> handle =
+      lock_manager->CreateHandle(id, /*priority=*/id);
+  handle->EnqueueLock(
+      LockRequest(LockMode::kExclusive, "table:0",
+                  KeyRange::Point(Key({zetasql::values::Int64(row)})),
+                  {"column:0"}));
+  ZETASQL_RETURN_IF_ERROR(handle->Wait());
+  ZETASQL_RETURN_IF_ERROR(handle->ReserveCommitTimestamp().status());
+  ZETASQL_RETURN_IF_ERROR(handle->MarkCommitted());
+  handle->UnlockAll();
+  return absl::OkStatus();
+}
+
+void RunBenchmark() {
+  BenchmarkRunner runner;
+  for (int num_threads : kNumThreads) {
+    Clock clock;
+    LockManager lock_manager(&clock, /*lock_wait_timeout=*/absl::Seconds(10));
+    std::atomic<TransactionID> next_id(1);
+    runner.Run(
+        absl::StrCat("Transaction/threads:", num_threads),
+        [&](int64_t iterations) {
+          std::vector<std::thread> threads;
+          for (int t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&, t]() {
+              for (int64_t i = t; i < iterations; i += num_threads) {
+                absl::Status status =
+                    RunTransaction(&lock_manager, next_id++, /*row=*/t);
+                if (!status.ok()) {
+                  std::fprintf(stderr, "%s\n", status.ToString().c_str());
+                  return;
+                }
+              }
+            });
+          }
+          for (std::thread& thread : threads) {
+            thread.join();
+          }
+        });
+  }
+
+  // A single thread writes rows between the ranges held by readers, to which
+  // requests must not be compared one by one.
+  for (int num_ranges : kNumHeldRanges) {
+    Clock clock;
+    LockManager lock_manager(&clock, /*lock_wait_timeout=*/absl::Seconds(10));
+    std::vector<std::unique_ptr<LockHandle>> readers;
+    for (int i = 0; i < num_ranges; ++i) {
+      const int64_t start = 2 * i * kRowsPerRange;
+      readers.push_back(lock_manager.CreateHandle(i + 1, /*priority=*/i + 1));
+      readers.back()->EnqueueLock(LockRequest(
+          LockMode::kShared, "table:0",
+          KeyRange::ClosedOpen(
+              Key({zetasql::values::Int64(start)}),
+              Key({zetasql::values::Int64(start + kRowsPerRange)})),
+          {}));
+      if (!readers.back()->Wait().ok()) {
+        std::fprintf(stderr, "Failed to lock read range %d\n", i);
+        return;
+      }
+    }
+    std::atomic<TransactionID> next_id(num_ranges + 1);
+    int64_t next_range = 0;
+    runner.Run(absl::StrCat("Transaction/held_ranges:", num_ranges),
+               [&](int64_t iterations) {
+                 for (int64_t i = 0; i < iterations; ++i) {
+                   const int64_t row =
+                       (2 * (next_range++ % num_ranges) + 1) * kRowsPerRange;
+                   absl::Status status =
+                       RunTransaction(&lock_manager, next_id++, row);
+                   if (!status.ok()) {
+                     std::fprintf(stderr, "%s\n", status.ToString().c_str());
+                     return;
+                   }
+                 }
+               });
+  }
+  runner.Report();
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  google::spanner::emulator::backend::RunBenchmark();
+  return 0;
+}
@@ -17,13 +17,19 @@
 #include "backend/locking/manager.h"
 
 #include <atomic>
+#include <memory>
 #include <thread>  // NOLINT
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "zetasql/base/testing/status_matchers.h"
 #include "tests/common/proto_matchers.h"
+#include "zetasql/public/value.h"
 #include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
 
 namespace google {
 namespace spanner {
@@ -32,6 +38,9 @@ namespace backend {
 
 namespace {
 
+using zetasql::values::Int64;
+using zetasql_base::testing::StatusIs;
+
 class LockManagerTest : public testing::Test {
  public:
   LockManagerTest()
@@ -43,7 +52,9 @@ class LockManagerTest : public testing::Test {
 
  private:
   Clock clock_;
-  LockManager manager_ = LockManager(&clock_);
+  // Conflicting requests are denied right away unless they can wound.
+  LockManager manager_ =
+      LockManager(&clock_, /*lock_wait_timeout=*/absl::ZeroDuration());
   LockRequest request_;
 };
 
@@ -118,6 +129,348 @@ TEST_F(LockManagerTest, TransactionsThatDidNotAcquireLockCanReleaseIt) {
   ZETASQL_EXPECT_OK(lh2->Wait());
 }
 
+TEST_F(LockManagerTest, DisjointKeysAreLockedConcurrently) {
+  std::unique_ptr<LockHandle> lh1 =
+      manager()->CreateHandle(TransactionID(1), TransactionPriority(1));
+  std::unique_ptr<LockHandle> lh2 =
+      manager()->CreateHandle(TransactionID(2), TransactionPriority(1));
+
+  lh1->EnqueueLock(LockRequest(LockMode::kExclusive, "table",
+                               KeyRange::Point(Key({Int64(1)})), {}));
+  lh2->EnqueueLock(LockRequest(LockMode::kExclusive, "table",
+                               KeyRange::Point(Key({Int64(2)})), {}));
+  ZETASQL_EXPECT_OK(lh1->Wait());
+  ZETASQL_EXPECT_OK(lh2->Wait());
+
+  // The same key in a different table does not conflict either.
+  lh2->EnqueueLock(LockRequest(LockMode::kExclusive, "other_table",
+                               KeyRange::Point(Key({Int64(1)})), {}));
+  ZETASQL_EXPECT_OK(lh2->Wait());
+}
+
+TEST_F(LockManagerTest, SharedLocksAreCompatible) {
+  std::unique_ptr<LockHandle> lh1 =
+      manager()->CreateHandle(TransactionID(1), TransactionPriority(1));
+  std::unique_ptr<LockHandle> lh2 =
+      manager()->CreateHandle(TransactionID(2), TransactionPriority(1));
+
+  lh1->EnqueueLock(
+      LockRequest(LockMode::kShared, "table", KeyRange::All(), {}));
+  lh2->EnqueueLock(LockRequest(LockMode::kShared, "table",
+                               KeyRange::Point(Key({Int64(1)})), {}));
+  ZETASQL_EXPECT_OK(lh1->Wait());
+  ZETASQL_EXPECT_OK(lh2->Wait());
+}
+
+TEST_F(LockManagerTest, ExclusiveLockConflictsWithOverlappingRange) {
+  std::unique_ptr<LockHandle> lh1 =
+      manager()->CreateHandle(TransactionID(1), TransactionPriority(1));
+  std::unique_ptr<LockHandle> lh2 =
+      manager()->CreateHandle(TransactionID(2), TransactionPriority(1));
+
+  lh1->EnqueueLock(LockRequest(
+      LockMode::kShared, "table",
+      KeyRange::ClosedOpen(Key({Int64(1)}), Key({Int64(10)})), {}));
+  ZETASQL_EXPECT_OK(lh1->Wait());
+
+  // A write outside the read range is granted.
+  lh2->EnqueueLock(LockRequest(LockMode::kExclusive, "table",
+                               KeyRange::Point(Key({Int64(10)})), {}));
+  ZETASQL_EXPECT_OK(lh2->Wait());
+
+  // A write inside the read range is denied.
+  lh2->EnqueueLock(LockRequest(LockMode::kExclusive, "table",
+                               KeyRange::Point(Key({Int64(5)})), {}));
+  EXPECT_THAT(lh2->Wait(), StatusIs(absl::StatusCode::kAborted));
+}
+
+TEST_F(LockManagerTest, WritesConflictOnlyWithReadRangesTheyOverlap) {
+  // Many readers hold shared locks on disjoint ranges [10 * i, 10 * i + 5),
+  // and one of them also on the long range [500, 1000).
+  std::vector<std::unique_ptr<LockHandle>> readers;
+  for (int i = 0; i < 100; ++i) {
+    readers.push_back(manager()->CreateHandle(TransactionID(i + 1),
+                                              TransactionPriority(1)));
+    readers.back()->EnqueueLock(LockRequest(
+        LockMode::kShared, "table",
+        KeyRange::ClosedOpen(Key({Int64(10 * i)}), Key({Int64(10 * i + 5)})),
+        {}));
+    ZETASQL_ASSERT_OK(readers.back()->Wait());
+  }
+  readers[0]->EnqueueLock(LockRequest(
+      LockMode::kShared, "table",
+      KeyRange::ClosedOpen(Key({Int64(500)}), Key({Int64(1000)})), {}));
+  ZETASQL_ASSERT_OK(readers[0]->Wait());
+
+  // Writes between the ranges are granted.
+  std::unique_ptr<LockHandle> writer =
+      manager()->CreateHandle(TransactionID(1000), TransactionPriority(1));
+  for (int i = 0; i < 50; ++i) {
+    writer->EnqueueLock(LockRequest(LockMode::kExclusive, "table",
+                                    KeyRange::Point(Key({Int64(10 * i + 7)})),
+                                    {}));
+    ZETASQL_EXPECT_OK(writer->Wait());
+  }
+
+  // A write within the long range is denied.
+  writer->EnqueueLock(LockRequest(LockMode::kExclusive, "table",
+                                  KeyRange::Point(Key({Int64(707)})), {}));
+  EXPECT_THAT(writer->Wait(), StatusIs(absl::StatusCode::kAborted));
+
+  // Once the long range is released, so is its conflict.
+  readers[0]->UnlockAll();
+  std::unique_ptr<LockHandle> next_writer =
+      manager()->CreateHandle(TransactionID(1001), TransactionPriority(1));
+  next_writer->EnqueueLock(LockRequest(LockMode::kExclusive, "table",
+                                       KeyRange::Point(Key({Int64(707)})), {}));
+  ZETASQL_EXPECT_OK(next_writer->Wait());
+  next_writer->EnqueueLock(LockRequest(LockMode::kExclusive, "table",
+                                       KeyRange::Point(Key({Int64(703)})), {}));
+  EXPECT_THAT(next_writer->Wait(), StatusIs(absl::StatusCode::kAborted));
+}
+
+TEST_F(LockManagerTest, PrefixLockConflictsWithKeysWithinPrefix) {
+  std::unique_ptr<LockHandle> lh1 =
+      manager()->CreateHandle(TransactionID(1), TransactionPriority(1));
+  std::unique_ptr<LockHandle> lh2 =
+      manager()->CreateHandle(TransactionID(2), TransactionPriority(1));
+
+  lh1->EnqueueLock(LockRequest(LockMode::kShared, "table",
+                               KeyRange::Prefix(Key({Int64(1)})), {}));
+  ZETASQL_EXPECT_OK(lh1->Wait());
+
+  lh2->EnqueueLock(LockRequest(LockMode::kExclusive, "table",
+                               KeyRange::Point(Key({Int64(1), Int64(2)})),
+                               {}));
+  EXPECT_THAT(lh2->Wait(), StatusIs(absl::StatusCode::kAborted));
+}
+
+TEST_F(LockManagerTest, DisjointColumnsAreLockedConcurrently) {
+  std::unique_ptr<LockHandle> lh1 =
+      manager()->CreateHandle(TransactionID(1), TransactionPriority(1));
+  std::unique_ptr<LockHandle> lh2 =
+      manager()->CreateHandle(TransactionID(2), TransactionPriority(1));
+  std::unique_ptr<LockHandle> lh3 =
+      manager()->CreateHandle(TransactionID(3), TransactionPriority(1));
+
+  KeyRange key_range = KeyRange::Point(Key({Int64(1)}));
+  lh1->EnqueueLock(
+      LockRequest(LockMode::kExclusive, "table", key_range, {"c1"}));
+  lh2->EnqueueLock(LockRequest(LockMode::kShared, "table", key_range, {"c2"}));
+  ZETASQL_EXPECT_OK(lh1->Wait());
+  ZETASQL_EXPECT_OK(lh2->Wait());
+
+  // A request without columns covers the entire row.
+  lh3->EnqueueLock(LockRequest(LockMode::kShared, "table", key_range, {}));
+  EXPECT_THAT(lh3->Wait(), StatusIs(absl::StatusCode::kAborted));
+}
+
+TEST_F(LockManagerTest, OlderTransactionWoundsYoungerTransaction) {
+  std::unique_ptr<LockHandle> young =
+      manager()->CreateHandle(TransactionID(1), TransactionPriority(2));
+  std::unique_ptr<LockHandle> old =
+      manager()->CreateHandle(TransactionID(2), TransactionPriority(1));
+
+  young->EnqueueLock(request());
+  ZETASQL_EXPECT_OK(young->Wait());
+
+  // The older transaction gets the lock and the younger one is aborted.
+  old->EnqueueLock(request());
+  ZETASQL_EXPECT_OK(old->Wait());
+  EXPECT_TRUE(young->IsAborted());
+  EXPECT_THAT(young->ReserveCommitTimestamp(),
+              StatusIs(absl::StatusCode::kAborted));
+
+  // The younger transaction can retry once the older one is done.
+  young->UnlockAll();
+  young->EnqueueLock(request());
+  EXPECT_THAT(young->Wait(), StatusIs(absl::StatusCode::kAborted));
+  old->UnlockAll();
+  young->UnlockAll();
+  young->EnqueueLock(request());
+  ZETASQL_EXPECT_OK(young->Wait());
+}
+
+TEST_F(LockManagerTest, CommittingTransactionIsNotWounded) {
+  std::unique_ptr<LockHandle> young =
+      manager()->CreateHandle(TransactionID(1), TransactionPriority(2));
+  std::unique_ptr<LockHandle> old =
+      manager()->CreateHandle(TransactionID(2), TransactionPriority(1));
+
+  young->EnqueueLock(request());
+  ZETASQL_EXPECT_OK(young->Wait());
+  ZETASQL_EXPECT_OK(young->ReserveCommitTimestamp());
+
+  old->EnqueueLock(request());
+  EXPECT_THAT(old->Wait(), StatusIs(absl::StatusCode::kAborted));
+  EXPECT_FALSE(young->IsAborted());
+  ZETASQL_EXPECT_OK(young->MarkCommitted());
+}
+
+TEST_F(LockManagerTest, DatabaseWideLockConflictsWithTableLocks) {
+  std::unique_ptr<LockHandle> lh1 =
+      manager()->CreateHandle(TransactionID(1), TransactionPriority(2));
+  std::unique_ptr<LockHandle> lh2 =
+      manager()->CreateHandle(TransactionID(2), TransactionPriority(1));
+
+  lh1->EnqueueLock(LockRequest(LockMode::kShared, "table",
+                               KeyRange::Point(Key({Int64(1)})), {}));
+  ZETASQL_EXPECT_OK(lh1->Wait());
+
+  // Database-wide requests never wound other transactions.
+  lh2->EnqueueLock(
+      LockRequest(LockMode::kExclusive, "", KeyRange::All(), {}));
+  EXPECT_THAT(lh2->Wait(), StatusIs(absl::StatusCode::kAborted));
+  EXPECT_FALSE(lh1->IsAborted());
+
+  lh1->UnlockAll();
+  lh2->UnlockAll();
+  lh2->EnqueueLock(
+      LockRequest(LockMode::kExclusive, "", KeyRange::All(), {}));
+  ZETASQL_EXPECT_OK(lh2->Wait());
+
+  // While the database-wide lock is held, table locks are denied.
+  lh1->EnqueueLock(LockRequest(LockMode::kShared, "table",
+                               KeyRange::Point(Key({Int64(1)})), {}));
+  EXPECT_THAT(lh1->Wait(), StatusIs(absl::StatusCode::kAborted));
+}
+
+TEST_F(LockManagerTest, SafeReadWaitsForAllPendingCommits) {
+  std::unique_ptr<LockHandle> lh1 =
+      manager()->CreateHandle(TransactionID(1), TransactionPriority(1));
+  std::unique_ptr<LockHandle> lh2 =
+      manager()->CreateHandle(TransactionID(2), TransactionPriority(1));
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(absl::Time ts1, lh1->ReserveCommitTimestamp());
+  ZETASQL_ASSERT_OK_AND_ASSIGN(absl::Time ts2, lh2->ReserveCommitTimestamp());
+  EXPECT_LT(ts1, ts2);
+
+  // Commits can complete out of order, the last commit timestamp is the latest
+  // one that completed.
+  ZETASQL_EXPECT_OK(lh2->MarkCommitted());
+  EXPECT_EQ(manager()->LastCommitTimestamp(), ts2);
+
+  std::atomic<bool> read_done(false);
+  std::thread reader([&]() {
+    lh1->WaitForSafeRead(ts2);
+    read_done = true;
+  });
+  absl::SleepFor(absl::Milliseconds(10));
+  EXPECT_FALSE(read_done);
+  ZETASQL_EXPECT_OK(lh1->MarkCommitted());
+  reader.join();
+  EXPECT_TRUE(read_done);
+  EXPECT_EQ(manager()->LastCommitTimestamp(), ts2);
+}
+
+TEST_F(LockManagerTest, RegisteredReadsWaitForCommitsReservedLater) {
+  std::unique_ptr<LockHandle> reader =
+      manager()->CreateHandle(TransactionID(1), TransactionPriority(1));
+  std::unique_ptr<LockHandle> writer =
+      manager()->CreateHandle(TransactionID(2), TransactionPriority(1));
+
+  // Reads of a handle which registered its read timestamp do not block while
+  // no commit is pending.
+  absl::Time ts0 = clock()->Now();
+  reader->WaitForSafeRead(ts0);
+  reader->WaitForSafeRead(ts0);
+  reader->WaitForSafeRead(clock()->Now());
+
+  // A commit reserved after the registration still blocks later reads.
+  ZETASQL_ASSERT_OK_AND_ASSIGN(absl::Time commit_ts,
+                       writer->ReserveCommitTimestamp());
+  absl::Time read_ts = clock()->Now();
+  EXPECT_LT(commit_ts, read_ts);
+  reader->WaitForSafeRead(ts0);
+
+  std::atomic<bool> read_done(false);
+  std::thread reader_thread([&]() {
+    reader->WaitForSafeRead(read_ts);
+    read_done = true;
+  });
+  absl::SleepFor(absl::Milliseconds(10));
+  EXPECT_FALSE(read_done);
+  ZETASQL_EXPECT_OK(writer->MarkCommitted());
+  reader_thread.join();
+  EXPECT_TRUE(read_done);
+
+  // The read timestamp registered first is the one retained.
+  EXPECT_EQ(manager()->OldestActiveReadTimestamp(), ts0);
+}
+
+TEST_F(LockManagerTest, StrongReadsPrecedePendingSchemaChange) {
+  std::unique_ptr<LockHandle> schema_change =
+      manager()->CreateHandle(TransactionID(1), TransactionPriority(1));
+  std::unique_ptr<LockHandle> reader =
+      manager()->CreateHandle(TransactionID(2), TransactionPriority(1));
+
+  // Without a schema change in progress, strong reads happen at current time,
+  // which they may share with the last timestamp drawn from the clock.
+  absl::Time before = clock()->Now();
+  EXPECT_GE(manager()->StrongReadTimestamp(), before);
+
+  schema_change->EnqueueLock(
+      LockRequest(LockMode::kExclusive, "", KeyRange::All(), {}));
+  ZETASQL_ASSERT_OK(schema_change->Wait());
+  ZETASQL_ASSERT_OK_AND_ASSIGN(absl::Time schema_change_ts,
+                       schema_change->ReserveCommitTimestamp());
+
+  // Strong reads are served before the pending schema change, without waiting
+  // for it to commit.
+  absl::Time read_ts = manager()->StrongReadTimestamp();
+  EXPECT_LT(read_ts, schema_change_ts);
+  EXPECT_GE(read_ts, before);
+  reader->WaitForSafeRead(read_ts);
+
+  ZETASQL_EXPECT_OK(schema_change->MarkCommitted());
+  schema_change->UnlockAll();
+  EXPECT_GE(manager()->StrongReadTimestamp(), schema_change_ts);
+}
+
+TEST_F(LockManagerTest, SafeReadTimestampPrecedesPendingCommits) {
+  std::unique_ptr<LockHandle> lh1 =
+      manager()->CreateHandle(TransactionID(1), TransactionPriority(1));
+  std::unique_ptr<LockHandle> lh2 =
+      manager()->CreateHandle(TransactionID(2), TransactionPriority(1));
+
+  // Without pending commits, reads are safe at the current time.
+  absl::Time before = clock()->Now();
+  EXPECT_GE(manager()->SafeReadTimestamp(), before);
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(absl::Time ts1, lh1->ReserveCommitTimestamp());
+  ZETASQL_ASSERT_OK_AND_ASSIGN(absl::Time ts2, lh2->ReserveCommitTimestamp());
+  EXPECT_LT(manager()->SafeReadTimestamp(), ts1);
+
+  // The safe read timestamp does not pass the older commit, which is still
+  // pending, even though a later one completed.
+  ZETASQL_EXPECT_OK(lh2->MarkCommitted());
+  EXPECT_EQ(manager()->LastCommitTimestamp(), ts2);
+  EXPECT_LT(manager()->SafeReadTimestamp(), ts1);
+
+  ZETASQL_EXPECT_OK(lh1->MarkCommitted());
+  EXPECT_GE(manager()->SafeReadTimestamp(), ts2);
+}
+
+TEST_F(LockManagerTest, TracksOldestActiveReadTimestamp) {
+  std::unique_ptr<LockHandle> lh1 =
+      manager()->CreateHandle(TransactionID(1), TransactionPriority(1));
+  std::unique_ptr<LockHandle> lh2 =
+      manager()->CreateHandle(TransactionID(2), TransactionPriority(1));
+  EXPECT_EQ(manager()->OldestActiveReadTimestamp(), absl::InfiniteFuture());
+
+  absl::Time ts1 = clock()->Now();
+  absl::Time ts2 = clock()->Now();
+  lh2->WaitForSafeRead(ts2);
+  lh1->WaitForSafeRead(ts1);
+  EXPECT_EQ(manager()->OldestActiveReadTimestamp(), ts1);
+
+  // Read timestamps are retained until the transaction releases its locks.
+  lh1->UnlockAll();
+  EXPECT_EQ(manager()->OldestActiveReadTimestamp(), ts2);
+  lh2.reset();
+  EXPECT_EQ(manager()->OldestActiveReadTimestamp(), absl::InfiniteFuture());
+}
+
 TEST_F(LockManagerTest, EnsuresSerializationWithParallelTransactions) {
   // Simulate a thread-safe mvcc store with a single key. Even though multiple
   // threads access this store, they are synchronized by the lock manager.
@@ -176,6 +529,208 @@ TEST_F(LockManagerTest, EnsuresSerializationWithParallelTransactions) {
   EXPECT_EQ(n * k, GetValue(absl::InfiniteFuture()));
 }
 
+class LockWaitTest : public testing::Test {
+ public:
+  LockWaitTest()
+      : request_(LockMode::kExclusive, "table", KeyRange::All(), {}) {}
+
+  LockManager* manager() { return &manager_; }
+  const LockRequest& request() { return request_; }
+
+ private:
+  Clock clock_;
+  LockManager manager_ =
+      LockManager(&clock_, /*lock_wait_timeout=*/absl::Seconds(30));
+  LockRequest request_;
+};
+
+TEST_F(LockWaitTest, YoungerTransactionWaitsForOlderTransaction) {
+  std::unique_ptr<LockHandle> old =
+      manager()->CreateHandle(TransactionID(1), TransactionPriority(1));
+  std::unique_ptr<LockHandle> young =
+      manager()->CreateHandle(TransactionID(2), TransactionPriority(2));
+
+  old->EnqueueLock(request());
+  ZETASQL_EXPECT_OK(old->Wait());
+
+  young->EnqueueLock(request());
+  EXPECT_TRUE(young->IsBlocked());
+  EXPECT_FALSE(young->IsAborted());
+
+  std::thread unlocker([&old]() {
+    absl::SleepFor(absl::Milliseconds(10));
+    old->UnlockAll();
+  });
+  ZETASQL_EXPECT_OK(young->Wait());
+  EXPECT_FALSE(young->IsBlocked());
+  unlocker.join();
+}
+
+TEST_F(LockWaitTest, WaitingRequestsAreGrantedOldestFirst) {
+  std::unique_ptr<LockHandle> holder =
+      manager()->CreateHandle(TransactionID(1), TransactionPriority(1));
+  std::unique_ptr<LockHandle> youngest =
+      manager()->CreateHandle(TransactionID(2), TransactionPriority(3));
+  std::unique_ptr<LockHandle> older =
+      manager()->CreateHandle(TransactionID(3), TransactionPriority(2));
+
+  holder->EnqueueLock(request());
+  ZETASQL_EXPECT_OK(holder->Wait());
+  youngest->EnqueueLock(request());
+  older->EnqueueLock(request());
+  EXPECT_TRUE(youngest->IsBlocked());
+  EXPECT_TRUE(older->IsBlocked());
+
+  // The older waiter gets the lock although it arrived last.
+  holder->UnlockAll();
+  EXPECT_FALSE(older->IsBlocked());
+  ZETASQL_EXPECT_OK(older->Wait());
+  EXPECT_TRUE(youngest->IsBlocked());
+
+  older->UnlockAll();
+  ZETASQL_EXPECT_OK(youngest->Wait());
+}
+
+TEST_F(LockWaitTest, WaitingTransactionIsWoundedByOlderTransaction) {
+  std::unique_ptr<LockHandle> oldest =
+      manager()->CreateHandle(TransactionID(1), TransactionPriority(1));
+  std::unique_ptr<LockHandle> old =
+      manager()->CreateHandle(TransactionID(2), TransactionPriority(2));
+  std::unique_ptr<LockHandle> young =
+      manager()->CreateHandle(TransactionID(3), TransactionPriority(3));
+  LockRequest first(LockMode::kExclusive, "table",
+                    KeyRange::Point(Key({Int64(1)})), {});
+  LockRequest second(LockMode::kExclusive, "table",
+                     KeyRange::Point(Key({Int64(2)})), {});
+
+  // The young transaction holds the second key and waits for the first.
+  oldest->EnqueueLock(first);
+  ZETASQL_EXPECT_OK(oldest->Wait());
+  young->EnqueueLock(second);
+  ZETASQL_EXPECT_OK(young->Wait());
+  young->EnqueueLock(first);
+  EXPECT_TRUE(young->IsBlocked());
+
+  // An older transaction requesting the second key does not wait behind it,
+  // it wounds the waiting transaction instead.
+  old->EnqueueLock(second);
+  ZETASQL_EXPECT_OK(old->Wait());
+  EXPECT_FALSE(young->IsBlocked());
+  EXPECT_THAT(young->Wait(), StatusIs(absl::StatusCode::kAborted));
+}
+
+TEST_F(LockWaitTest, WaitTimesOut) {
+  Clock clock;
+  LockManager manager(&clock, /*lock_wait_timeout=*/absl::Milliseconds(10));
+  std::unique_ptr<LockHandle> old =
+      manager.CreateHandle(TransactionID(1), TransactionPriority(1));
+  std::unique_ptr<LockHandle> young =
+      manager.CreateHandle(TransactionID(2), TransactionPriority(2));
+
+  old->EnqueueLock(request());
+  ZETASQL_EXPECT_OK(old->Wait());
+  young->EnqueueLock(request());
+  EXPECT_THAT(young->Wait(), StatusIs(absl::StatusCode::kAborted));
+  EXPECT_FALSE(young->IsBlocked());
+  EXPECT_TRUE(young->IsAborted());
+
+  // The timed out request was not granted behind the scenes.
+  old->UnlockAll();
+  EXPECT_TRUE(young->IsAborted());
+  young->UnlockAll();
+  young->EnqueueLock(request());
+  ZETASQL_EXPECT_OK(young->Wait());
+}
+
+TEST_F(LockWaitTest, CountsLockContention) {
+  Clock clock;
+  LockManager manager(&clock, /*lock_wait_timeout=*/absl::Milliseconds(10));
+  std::unique_ptr<LockHandle> old =
+      manager.CreateHandle(TransactionID(1), TransactionPriority(1));
+  std::unique_ptr<LockHandle> young =
+      manager.CreateHandle(TransactionID(2), TransactionPriority(2));
+  LockRequest hot(LockMode::kExclusive, "table",
+                  KeyRange::Point(Key({Int64(1)})), {});
+  LockRequest cold(LockMode::kExclusive, "table",
+                   KeyRange::Point(Key({Int64(2)})), {});
+
+  // The young transaction waits for the hot key until the wait times out.
+  old->EnqueueLock(hot);
+  ZETASQL_EXPECT_OK(old->Wait());
+  young->EnqueueLock(cold);
+  ZETASQL_EXPECT_OK(young->Wait());
+  young->EnqueueLock(hot);
+  EXPECT_THAT(young->Wait(), StatusIs(absl::StatusCode::kAborted));
+
+  // The old transaction then wounds the young one, which holds the cold key.
+  young->UnlockAll();
+  young->EnqueueLock(cold);
+  ZETASQL_EXPECT_OK(young->Wait());
+  old->EnqueueLock(cold);
+  ZETASQL_EXPECT_OK(old->Wait());
+  EXPECT_TRUE(young->IsAborted());
+
+  std::vector<LockStats::Entry> ranges = manager.lock_stats().TopRanges(10);
+  ASSERT_EQ(ranges.size(), 2);
+  EXPECT_EQ(ranges[0].table_id, "table");
+  EXPECT_EQ(ranges[0].start_key, Key({Int64(1)}));
+  EXPECT_EQ(ranges[0].counts.lock_conflicts, 1);
+  EXPECT_EQ(ranges[0].counts.aborts, 1);
+  EXPECT_GE(ranges[0].counts.lock_wait, absl::Milliseconds(10));
+  EXPECT_EQ(ranges[1].start_key, Key({Int64(2)}));
+  EXPECT_EQ(ranges[1].counts.lock_conflicts, 1);
+  EXPECT_EQ(ranges[1].counts.aborts, 1);
+  EXPECT_EQ(ranges[1].counts.lock_wait, absl::ZeroDuration());
+
+  std::vector<LockStats::Entry> tables = manager.lock_stats().TopTables(10);
+  ASSERT_EQ(tables.size(), 1);
+  EXPECT_EQ(tables[0].counts.lock_conflicts, 2);
+  EXPECT_EQ(tables[0].counts.aborts, 2);
+}
+
+TEST_F(LockWaitTest, ParallelTransactionsQueueForLock) {
+  int value = 0;
+
+  // Start n threads each doing a transactional increment k times. Each
+  // transaction is younger than the previous ones, so it waits for them
+  // instead of being aborted.
+  int n = 20;
+  int k = 10;
+  std::vector<std::thread> threads;
+  std::atomic<int> id_counter(0);
+  for (int i = 0; i < n; ++i) {
+    threads.emplace_back([&]() {
+      for (int j = 0; j < k; ++j) {
+        while (true) {
+          int id = ++id_counter;
+          std::unique_ptr<LockHandle> lh = manager()->CreateHandle(
+              TransactionID(id), TransactionPriority(id));
+          lh->EnqueueLock(request());
+          // An older transaction arriving late may still wound this one
+          // until it starts committing.
+          absl::Status status = lh->Wait();
+          if (status.ok()) {
+            status = lh->ReserveCommitTimestamp().status();
+          }
+          if (status.code() == absl::StatusCode::kAborted) {
+            continue;
+          }
+          ZETASQL_ASSERT_OK(status);
+          ++value;
+          ZETASQL_ASSERT_OK(lh->MarkCommitted());
+          lh->UnlockAll();
+          break;
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(n * k, value);
+}
+
 }  // namespace
 
 }  // namespace backend
@@ -0,0 +1,234 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/query/aggregate_rewriter.h"
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/type.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "zetasql/resolved_ast/resolved_column.h"
+#include "zetasql/resolved_ast/resolved_node_kind.pb.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "backend/query/aggregated_table.h"
+#include "backend/query/filtered_table.h"
+#include "backend/query/queryable_table.h"
+#include "backend/schema/catalog/table.h"
+#include "absl/status/status.h"
+#include "zetasql/base/ret_check.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+const auto& kAggregateFunctions =
+    *new absl::flat_hash_map<std::string, AggregateFunction>{
+        {"$count_star", AggregateFunction::kCountStar},
+        {"count", AggregateFunction::kCount},
+        {"sum", AggregateFunction::kSum},
+        {"min", AggregateFunction::kMin},
+        {"max", AggregateFunction::kMax},
+        {"any_value", AggregateFunction::kAnyValue},
+    };
+
+// Returns the index in the scanned table of the column referenced by `expr`,
+// or -1 if `expr` is not a reference to a column produced by `scan`.
+int ColumnIndex(const zetasql::ResolvedTableScan* scan,
+                const zetasql::ResolvedExpr* expr) {
+  if (expr->node_kind() != zetasql::RESOLVED_COLUMN_REF ||
+      expr->GetAs<zetasql::ResolvedColumnRef>()->is_correlated()) {
+    return -1;
+  }
+  const zetasql::ResolvedColumn& column =
+      expr->GetAs<zetasql::ResolvedColumnRef>()->column();
+  for (int i = 0; i < scan->column_list_size(); ++i) {
+    if (scan->column_list(i) == column) {
+      return scan->column_index_list(i);
+    }
+  }
+  return -1;
+}
+
+// Returns the aggregate computed by `column` over the rows of `scan`, or
+// nullopt if it is not supported.
+std::optional<AggregateColumn> AsAggregateColumn(
+    const zetasql::ResolvedTableScan* scan,
+    const zetasql::ResolvedComputedColumn* column) {
+  if (column->expr()->node_kind() !=
+      zetasql::RESOLVED_AGGREGATE_FUNCTION_CALL) {
+    return std::nullopt;
+  }
+  const auto* call =
+      column->expr()->GetAs<zetasql::ResolvedAggregateFunctionCall>();
+  auto it = kAggregateFunctions.find(call->function()->Name());
+  if (!call->function()->IsZetaSQLBuiltin() ||
+      it == kAggregateFunctions.end() || call->distinct() ||
+      call->error_mode() !=
+          zetasql::ResolvedFunctionCallBase::DEFAULT_ERROR_MODE ||
+      call->null_handling_modifier() !=
+          zetasql::ResolvedNonScalarFunctionCallBase::DEFAULT_NULL_HANDLING ||
+      call->having_modifier() != nullptr ||
+      call->order_by_item_list_size() > 0 || call->limit() != nullptr) {
+    return std::nullopt;
+  }
+  AggregateColumn aggregate{column->column().name(), it->second, -1,
+                            call->type()};
+  if (aggregate.function == AggregateFunction::kCountStar) {
+    return call->argument_list_size() == 0 ? std::make_optional(aggregate)
+                                           : std::nullopt;
+  }
+  if (call->argument_list_size() != 1) {
+    return std::nullopt;
+  }
+  aggregate.source_column = ColumnIndex(scan, call->argument_list(0));
+  if (aggregate.source_column < 0) {
+    return std::nullopt;
+  }
+  const zetasql::Type* type = call->argument_list(0)->type();
+  switch (aggregate.function) {
+    case AggregateFunction::kSum:
+      if (!type->IsInt64() && !type->IsDouble()) {
+        return std::nullopt;
+      }
+      break;
+    case AggregateFunction::kMin:
+    case AggregateFunction::kMax:
+      // NaN is the least value in order, but MIN and MAX return NaN if any
+      // value is NaN.
+      if (type->IsFloat() || type->IsDouble()) {
+        return std::nullopt;
+      }
+      break;
+    default:
+      break;
+  }
+  return aggregate;
+}
+
+// Returns the index of `column` in the columns of its table.
+int ColumnIndexInTable(const backend::Column* column) {
+  const backend::Table* table = column->table();
+  for (int i = 0; i < table->columns().size(); ++i) {
+    if (table->columns()[i] == column) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+}  // namespace
+
+absl::Status AggregateRewriter::VisitResolvedAggregateScan(
+    const zetasql::ResolvedAggregateScan* node) {
+  if (node->group_by_list_size() == 0 || node->grouping_set_list_size() > 0 ||
+      node->rollup_column_list_size() > 0) {
+    return CopyVisitResolvedAggregateScan(node);
+  }
+
+  // Projections do not change the rows aggregated, only their columns.
+  const zetasql::ResolvedScan* scan = node->input_scan();
+  while (scan->node_kind() == zetasql::RESOLVED_PROJECT_SCAN) {
+    scan = scan->GetAs<zetasql::ResolvedProjectScan>()->input_scan();
+  }
+  if (scan->node_kind() != zetasql::RESOLVED_TABLE_SCAN) {
+    return CopyVisitResolvedAggregateScan(node);
+  }
+  const auto* table_scan = scan->GetAs<zetasql::ResolvedTableScan>();
+  const auto* filtered_table =
+      dynamic_cast<const FilteredTable*>(table_scan->table());
+  const QueryableTable* table =
+      filtered_table != nullptr
+          ? filtered_table->table()
+          : dynamic_cast<const QueryableTable*>(table_scan->table());
+  // Rows limited in a heap are not read in key order.
+  if (table == nullptr || table_scan->for_system_time_expr() != nullptr ||
+      (filtered_table != nullptr && filtered_table->row_limit().has_value() &&
+       !filtered_table->row_limit()->in_key_order)) {
+    return CopyVisitResolvedAggregateScan(node);
+  }
+
+  // The groups must be a prefix of the primary key, in any order, so that the
+  // rows of each group are read one after the other.
+  std::vector<int> group_columns;
+  for (const auto& group_by : node->group_by_list()) {
+    group_columns.push_back(ColumnIndex(table_scan, group_by->expr()));
+  }
+  const auto& primary_key = table->wrapped_table()->primary_key();
+  if (group_columns.size() > primary_key.size()) {
+    return CopyVisitResolvedAggregateScan(node);
+  }
+  for (int i = 0; i < group_columns.size(); ++i) {
+    const backend::Column* key_column = primary_key[i]->column();
+    if (std::find(group_columns.begin(), group_columns.end(),
+                  ColumnIndexInTable(key_column)) == group_columns.end() ||
+        key_column->GetType()->IsFloat() || key_column->GetType()->IsDouble()) {
+      return CopyVisitResolvedAggregateScan(node);
+    }
+  }
+
+  std::vector<AggregateColumn> aggregates;
+  for (const auto& aggregate : node->aggregate_list()) {
+    std::optional<AggregateColumn> column =
+        AsAggregateColumn(table_scan, aggregate.get());
+    if (!column.has_value()) {
+      return CopyVisitResolvedAggregateScan(node);
+    }
+    aggregates.push_back(std::move(column).value());
+  }
+
+  // The columns of the aggregated table are the group columns followed by the
+  // aggregates.
+  std::vector<int> column_indexes;
+  for (const zetasql::ResolvedColumn& column : node->column_list()) {
+    int index = -1;
+    for (int i = 0; i < node->group_by_list_size(); ++i) {
+      if (node->group_by_list(i)->column() == column) {
+        index = i;
+      }
+    }
+    for (int i = 0; i < node->aggregate_list_size(); ++i) {
+      if (node->aggregate_list(i)->column() == column) {
+        index = node->group_by_list_size() + i;
+      }
+    }
+    ZETASQL_RET_CHECK_GE(index, 0);
+    column_indexes.push_back(index);
+  }
+  auto aggregated_table = absl::make_unique<AggregatedTable>(
+      table, filtered_table, std::move(group_columns), std::move(aggregates));
+  auto aggregated_scan = zetasql::MakeResolvedTableScan(
+      node->column_list(), aggregated_table.get(),
+      /*for_system_time_expr=*/nullptr);
+  aggregated_scan->set_column_index_list(column_indexes);
+  aggregated_tables_.push_back(std::move(aggregated_table));
+  PushNodeToStack(std::move(aggregated_scan));
+  return absl::OkStatus();
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
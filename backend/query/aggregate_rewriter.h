@@ -0,0 +1,65 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_AGGREGATE_REWRITER_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_AGGREGATE_REWRITER_H_
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/catalog.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "zetasql/resolved_ast/resolved_ast_deep_copy_visitor.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// Implements ResolvedASTDeepCopyVisitor to replace aggregations of a table
+// grouped by a prefix of its primary key with scans of an AggregatedTable,
+// which aggregates the groups in one pass as the rows are read in key order.
+//
+// An aggregation is rewritten if its input is a scan of a database table,
+// possibly filtered by a FilteredTable and through projections, its groups
+// are the leading primary key columns of the table, and its aggregates are
+// COUNT(*), or COUNT, SUM, MIN, MAX or ANY_VALUE of columns of the table
+// without modifiers. Other aggregations, and aggregations grouped by floating
+// point columns, are left to the ZetaSQL reference implementation.
+class AggregateRewriter : public zetasql::ResolvedASTDeepCopyVisitor {
+ public:
+  absl::Status VisitResolvedAggregateScan(
+      const zetasql::ResolvedAggregateScan* node) override;
+
+  // Returns the tables scanned by the rewritten statement, which must outlive
+  // it.
+  std::vector<std::unique_ptr<const zetasql::Table>>
+  release_aggregated_tables() {
+    return std::move(aggregated_tables_);
+  }
+
+ private:
+  std::vector<std::unique_ptr<const zetasql::Table>> aggregated_tables_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_AGGREGATE_REWRITER_H_
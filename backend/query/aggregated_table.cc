@@ -0,0 +1,337 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/query/aggregated_table.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/evaluator_table_iterator.h"
+#include "zetasql/public/simple_catalog.h"
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/types/span.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// The state of an aggregate over the rows of a group.
+class Accumulator {
+ public:
+  explicit Accumulator(const AggregateColumn& aggregate)
+      : aggregate_(aggregate) {
+    Reset();
+  }
+
+  // Starts a new group.
+  void Reset() {
+    count_ = 0;
+    int64_sum_ = 0;
+    double_sum_ = 0;
+    value_ = zetasql::Value();
+  }
+
+  // Adds the value of the aggregated column in a row of the group, or any
+  // value for COUNT(*).
+  void Accumulate(const zetasql::Value& value) {
+    if (aggregate_.function == AggregateFunction::kCountStar) {
+      ++count_;
+      return;
+    }
+    if (value.is_null()) {
+      return;
+    }
+    ++count_;
+    switch (aggregate_.function) {
+      case AggregateFunction::kSum:
+        if (value.type()->IsInt64()) {
+          int64_sum_ += value.int64_value();
+        } else {
+          double_sum_ += value.double_value();
+        }
+        break;
+      case AggregateFunction::kMin:
+        if (!value_.is_valid() || value.LessThan(value_)) {
+          value_ = value;
+        }
+        break;
+      case AggregateFunction::kMax:
+        if (!value_.is_valid() || value_.LessThan(value)) {
+          value_ = value;
+        }
+        break;
+      case AggregateFunction::kAnyValue:
+        if (!value_.is_valid()) {
+          value_ = value;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  // Returns the aggregate of the group.
+  zetasql_base::StatusOr<zetasql::Value> Finish() const {
+    switch (aggregate_.function) {
+      case AggregateFunction::kCountStar:
+      case AggregateFunction::kCount:
+        return zetasql::values::Int64(count_);
+      case AggregateFunction::kSum:
+        if (count_ == 0) {
+          return zetasql::values::Null(aggregate_.type);
+        }
+        if (aggregate_.type->IsDouble()) {
+          return zetasql::values::Double(double_sum_);
+        }
+        // As in the reference implementation, only the sum itself needs to
+        // fit in an INT64.
+        if (int64_sum_ > std::numeric_limits<int64_t>::max() ||
+            int64_sum_ < std::numeric_limits<int64_t>::min()) {
+          return absl::OutOfRangeError("int64 overflow");
+        }
+        return zetasql::values::Int64(static_cast<int64_t>(int64_sum_));
+      default:
+        return value_.is_valid() ? value_
+                                 : zetasql::values::Null(aggregate_.type);
+    }
+  }
+
+ private:
+  const AggregateColumn& aggregate_;
+  int64_t count_;
+  __int128 int64_sum_;
+  double double_sum_;
+  zetasql::Value value_;
+};
+
+// An implementation of EvaluatorTableIterator which aggregates the groups of
+// an AggregatedTable as the rows of its source table are read in key order.
+//
+// The source table is read on the first call to NextRow(), so that filters on
+// the group columns set by SetColumnFilterMap() narrow the rows read.
+class AggregatedTableIterator : public zetasql::EvaluatorTableIterator {
+ public:
+  AggregatedTableIterator(const AggregatedTable* table,
+                          absl::Span<const int> column_idxs)
+      : table_(table), column_idxs_(column_idxs.begin(), column_idxs.end()) {
+    for (int column : table->group_columns()) {
+      group_positions_.push_back(SourcePosition(column));
+    }
+    for (const AggregateColumn& aggregate : table->aggregates()) {
+      const int column = aggregate.source_column;
+      aggregate_positions_.push_back(column < 0 ? -1 : SourcePosition(column));
+      accumulators_.emplace_back(aggregate);
+    }
+    for (int column_idx : column_idxs_) {
+      values_.push_back(
+          zetasql::values::Null(table->GetColumn(column_idx)->GetType()));
+    }
+  }
+
+  int NumColumns() const override { return column_idxs_.size(); }
+
+  std::string GetColumnName(int i) const override {
+    return table_->GetColumn(column_idxs_[i])->Name();
+  }
+
+  const zetasql::Type* GetColumnType(int i) const override {
+    return table_->GetColumn(column_idxs_[i])->GetType();
+  }
+
+  absl::Status SetColumnFilterMap(
+      absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>>
+          filter_map) override {
+    // Filters on aggregates cannot narrow the rows read.
+    const int num_group_columns = group_positions_.size();
+    for (auto& [i, filter] : filter_map) {
+      if (column_idxs_[i] < num_group_columns) {
+        source_filters_[group_positions_[column_idxs_[i]]] = std::move(filter);
+      }
+    }
+    return absl::OkStatus();
+  }
+
+  bool NextRow() override {
+    if (source_ == nullptr) {
+      status_ = Open();
+      if (!status_.ok()) {
+        return false;
+      }
+      has_next_row_ = source_->NextRow();
+    }
+    if (!has_next_row_) {
+      return false;
+    }
+
+    std::vector<zetasql::Value> group;
+    for (int position : group_positions_) {
+      group.push_back(source_->GetValue(position));
+    }
+    for (Accumulator& accumulator : accumulators_) {
+      accumulator.Reset();
+    }
+    do {
+      for (int i = 0; i < accumulators_.size(); ++i) {
+        accumulators_[i].Accumulate(aggregate_positions_[i] < 0
+                                        ? group[0]
+                                        : source_->GetValue(
+                                              aggregate_positions_[i]));
+      }
+      has_next_row_ = source_->NextRow();
+    } while (has_next_row_ && InGroup(group));
+    if (!source_->Status().ok()) {
+      return false;
+    }
+
+    const int num_group_columns = group_positions_.size();
+    for (int i = 0; i < column_idxs_.size(); ++i) {
+      const int column_idx = column_idxs_[i];
+      if (column_idx < num_group_columns) {
+        values_[i] = group[column_idx];
+        continue;
+      }
+      auto value = accumulators_[column_idx - num_group_columns].Finish();
+      if (!value.ok()) {
+        status_ = value.status();
+        return false;
+      }
+      values_[i] = std::move(value).value();
+    }
+    return true;
+  }
+
+  const zetasql::Value& GetValue(int i) const override { return values_[i]; }
+
+  absl::Status Status() const override {
+    ZETASQL_RETURN_IF_ERROR(status_);
+    return source_ == nullptr ? absl::OkStatus() : source_->Status();
+  }
+
+  absl::Status Cancel() override {
+    return source_ == nullptr ? absl::OkStatus() : source_->Cancel();
+  }
+
+ private:
+  // Returns the position of source table column `column` in the columns read
+  // from the source table, adding it if needed.
+  int SourcePosition(int column) {
+    auto it = std::find(source_columns_.begin(), source_columns_.end(), column);
+    if (it != source_columns_.end()) {
+      return it - source_columns_.begin();
+    }
+    source_columns_.push_back(column);
+    return source_columns_.size() - 1;
+  }
+
+  // Returns true if the current row of the source table is in `group`.
+  bool InGroup(const std::vector<zetasql::Value>& group) const {
+    for (int i = 0; i < group_positions_.size(); ++i) {
+      if (!source_->GetValue(group_positions_[i]).Equals(group[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  absl::Status Open() {
+    ZETASQL_ASSIGN_OR_RETURN(source_,
+                     table_->CreateSourceIterator(source_columns_));
+    return source_->SetColumnFilterMap(std::move(source_filters_));
+  }
+
+  const AggregatedTable* table_;
+  const std::vector<int> column_idxs_;
+
+  // The columns read from the source table, as column indexes of the table,
+  // and the positions among them of the group columns and of the columns
+  // aggregated, or -1 for COUNT(*).
+  std::vector<int> source_columns_;
+  std::vector<int> group_positions_;
+  std::vector<int> aggregate_positions_;
+
+  // The filters to set on source_ when it is opened.
+  absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>>
+      source_filters_;
+
+  // The source rows, or nullptr before the first call to NextRow(), and
+  // whether source_ is at the first row of the next group.
+  std::unique_ptr<zetasql::EvaluatorTableIterator> source_;
+  bool has_next_row_ = false;
+
+  std::vector<Accumulator> accumulators_;
+  std::vector<zetasql::Value> values_;
+  absl::Status status_;
+};
+
+}  // namespace
+
+AggregatedTable::AggregatedTable(const QueryableTable* table,
+                                 const FilteredTable* filtered_table,
+                                 std::vector<int> group_columns,
+                                 std::vector<AggregateColumn> aggregates)
+    : table_(table),
+      filtered_table_(filtered_table),
+      group_columns_(std::move(group_columns)),
+      aggregates_(std::move(aggregates)) {
+  std::vector<std::string> group_names;
+  for (int column : group_columns_) {
+    const zetasql::Column* source_column = table->GetColumn(column);
+    group_names.push_back(source_column->Name());
+    columns_.push_back(absl::make_unique<zetasql::SimpleColumn>(
+        table->Name(), source_column->Name(), source_column->GetType()));
+  }
+  for (const AggregateColumn& aggregate : aggregates_) {
+    columns_.push_back(absl::make_unique<zetasql::SimpleColumn>(
+        table->Name(), aggregate.name, aggregate.type));
+  }
+  name_ = absl::StrCat(table->Name(), " GROUP BY ",
+                       absl::StrJoin(group_names, ", "));
+}
+
+zetasql_base::StatusOr<std::unique_ptr<zetasql::EvaluatorTableIterator>>
+AggregatedTable::CreateEvaluatorTableIterator(
+    absl::Span<const int> column_idxs) const {
+  return absl::make_unique<AggregatedTableIterator>(this, column_idxs);
+}
+
+zetasql_base::StatusOr<std::unique_ptr<zetasql::EvaluatorTableIterator>>
+AggregatedTable::CreateSourceIterator(absl::Span<const int> column_idxs) const {
+  if (filtered_table_ != nullptr) {
+    return filtered_table_->CreateOrderedEvaluatorTableIterator(column_idxs);
+  }
+  return table_->CreateOrderedEvaluatorTableIterator(column_idxs,
+                                                     /*index=*/nullptr);
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
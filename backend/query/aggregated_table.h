@@ -0,0 +1,127 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_AGGREGATED_TABLE_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_AGGREGATED_TABLE_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "zetasql/public/catalog.h"
+#include "zetasql/public/evaluator_table_iterator.h"
+#include "zetasql/public/simple_catalog.h"
+#include "zetasql/public/type.h"
+#include "absl/types/span.h"
+#include "backend/query/filtered_table.h"
+#include "backend/query/queryable_table.h"
+#include "zetasql/base/statusor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// The aggregate functions which an AggregatedTable computes.
+enum class AggregateFunction {
+  kCountStar,
+  kCount,
+  kSum,
+  kMin,
+  kMax,
+  kAnyValue,
+};
+
+// An aggregate computed by an AggregatedTable.
+struct AggregateColumn {
+  std::string name;
+  AggregateFunction function;
+
+  // The index in the source table of the column aggregated, or -1 for
+  // COUNT(*).
+  int source_column;
+
+  // The type of the aggregate.
+  const zetasql::Type* type;
+};
+
+// AggregatedTable is a zetasql::Table holding the result of grouping the rows
+// of a table by a prefix of its primary key. AggregateRewriter substitutes
+// scans of an AggregatedTable for such aggregations in queries, which the
+// ZetaSQL reference implementation would otherwise evaluate by hashing all
+// the rows of the table.
+//
+// The rows of the source table are read in primary key order, so the rows of
+// each group are read one after the other, and are aggregated in a single
+// pass holding the state of one group at a time.
+//
+// The columns of the table are the group columns, given as column indexes in
+// the source table, followed by the aggregates. The source table is a
+// QueryableTable, or a FilteredTable over it when the rows aggregated are
+// filtered. Filters on the group columns are pushed down to the read of the
+// source table.
+class AggregatedTable : public zetasql::Table {
+ public:
+  AggregatedTable(const QueryableTable* table,
+                  const FilteredTable* filtered_table,
+                  std::vector<int> group_columns,
+                  std::vector<AggregateColumn> aggregates);
+
+  std::string Name() const override { return name_; }
+
+  // FullName is used in debugging so it's OK to not include full path here.
+  std::string FullName() const override { return name_; }
+
+  int NumColumns() const override { return columns_.size(); }
+
+  const zetasql::Column* GetColumn(int i) const override {
+    return columns_[i].get();
+  }
+
+  // Columns are never looked up by name, since the table is not in any
+  // catalog.
+  const zetasql::Column* FindColumnByName(
+      const std::string& name) const override {
+    return nullptr;
+  }
+
+  zetasql_base::StatusOr<std::unique_ptr<zetasql::EvaluatorTableIterator>>
+  CreateEvaluatorTableIterator(
+      absl::Span<const int> column_idxs) const override;
+
+  const std::vector<int>& group_columns() const { return group_columns_; }
+  const std::vector<AggregateColumn>& aggregates() const { return aggregates_; }
+
+  // Returns an iterator over the columns `column_idxs` of the source table, in
+  // primary key order.
+  zetasql_base::StatusOr<std::unique_ptr<zetasql::EvaluatorTableIterator>>
+  CreateSourceIterator(absl::Span<const int> column_idxs) const;
+
+ private:
+  const QueryableTable* table_;
+  const FilteredTable* filtered_table_;
+  const std::vector<int> group_columns_;
+  const std::vector<AggregateColumn> aggregates_;
+  std::vector<std::unique_ptr<const zetasql::SimpleColumn>> columns_;
+  std::string name_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_AGGREGATED_TABLE_H_
@@ -0,0 +1,864 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/query/batch_predicate.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/evaluator_table_iterator.h"
+#include "zetasql/public/function.h"
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "zetasql/resolved_ast/resolved_node_kind.pb.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "common/errors.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// The loops below are written over plain arrays with no branches on the values
+// so that the compiler can vectorize them.
+
+enum class Comparison { kEqual, kNotEqual, kLess, kLessOrEqual, kGreater,
+                        kGreaterOrEqual };
+
+enum class Arithmetic { kAdd, kSubtract, kMultiply };
+
+// Resizes the arrays of `result` used by values of `type` to `size` rows.
+void Resize(const zetasql::Type* type, int size, BatchVector* result) {
+  result->nulls.resize(size);
+  if (type->IsInt64()) {
+    result->int64s.resize(size);
+  } else if (type->IsDouble()) {
+    result->doubles.resize(size);
+  } else if (type->IsBool()) {
+    result->bools.resize(size);
+  } else {
+    result->strings.resize(size);
+  }
+}
+
+// Sets `result` to the bitwise or of the null arrays of `left` and `right`.
+void OrNulls(const BatchVector& left, const BatchVector& right,
+             BatchVector* result) {
+  const int size = left.nulls.size();
+  result->nulls.resize(size);
+  for (int i = 0; i < size; ++i) {
+    result->nulls[i] = left.nulls[i] | right.nulls[i];
+  }
+}
+
+template <typename T>
+void Compare(Comparison comparison, const std::vector<T>& left,
+             const std::vector<T>& right, std::vector<uint8_t>* result) {
+  const int size = left.size();
+  result->resize(size);
+  uint8_t* out = result->data();
+  const T* a = left.data();
+  const T* b = right.data();
+  switch (comparison) {
+    case Comparison::kEqual:
+      for (int i = 0; i < size; ++i) out[i] = a[i] == b[i];
+      break;
+    case Comparison::kNotEqual:
+      for (int i = 0; i < size; ++i) out[i] = a[i] != b[i];
+      break;
+    case Comparison::kLess:
+      for (int i = 0; i < size; ++i) out[i] = a[i] < b[i];
+      break;
+    case Comparison::kLessOrEqual:
+      for (int i = 0; i < size; ++i) out[i] = a[i] <= b[i];
+      break;
+    case Comparison::kGreater:
+      for (int i = 0; i < size; ++i) out[i] = a[i] > b[i];
+      break;
+    case Comparison::kGreaterOrEqual:
+      for (int i = 0; i < size; ++i) out[i] = a[i] >= b[i];
+      break;
+  }
+}
+
+// A reference to a column of the scanned table.
+class ColumnExpression : public BatchExpression {
+ public:
+  ColumnExpression(const zetasql::Type* type, int column)
+      : BatchExpression(type), column_(column) {}
+
+  absl::Status Evaluate(const ColumnBatch& batch,
+                        BatchVector* result) const override {
+    const BatchVector& values = batch.column(column_);
+    result->nulls = values.nulls;
+    if (type()->IsInt64()) {
+      result->int64s = values.int64s;
+    } else if (type()->IsDouble()) {
+      result->doubles = values.doubles;
+    } else if (type()->IsBool()) {
+      result->bools = values.bools;
+    } else {
+      result->strings = values.strings;
+    }
+    return absl::OkStatus();
+  }
+
+  int column() const { return column_; }
+
+ private:
+  int column_;
+};
+
+// A literal, or a query parameter bound before the query is executed.
+class ConstantExpression : public BatchExpression {
+ public:
+  explicit ConstantExpression(const zetasql::Value& value)
+      : BatchExpression(value.type()), value_(value) {}
+
+  ConstantExpression(const zetasql::Type* type, const std::string& parameter)
+      : BatchExpression(type), parameter_(absl::AsciiStrToLower(parameter)) {}
+
+  absl::Status Evaluate(const ColumnBatch& batch,
+                        BatchVector* result) const override {
+    if (!value_.is_valid()) {
+      return error::Internal(
+          absl::StrCat("Query parameter @", parameter_, " is not bound."));
+    }
+    const int size = batch.size();
+    result->nulls.assign(size, value_.is_null());
+    if (value_.is_null()) {
+      Resize(type(), size, result);
+    } else if (type()->IsInt64()) {
+      result->int64s.assign(size, value_.int64_value());
+    } else if (type()->IsDouble()) {
+      result->doubles.assign(size, value_.double_value());
+    } else if (type()->IsBool()) {
+      result->bools.assign(size, value_.bool_value());
+    } else {
+      result->strings.assign(size, value_.string_value());
+    }
+    return absl::OkStatus();
+  }
+
+  void BindParameters(const zetasql::ParameterValueMap& parameters) override {
+    if (parameter_.empty()) {
+      return;
+    }
+    value_ = zetasql::Value();
+    for (const auto& [name, value] : parameters) {
+      if (absl::AsciiStrToLower(name) == parameter_ &&
+          value.type()->Equals(type())) {
+        value_ = value;
+      }
+    }
+  }
+
+  const zetasql::Value& value() const { return value_; }
+
+ private:
+  // Empty for literals.
+  std::string parameter_;
+  zetasql::Value value_;
+};
+
+// Addition, subtraction or multiplication of INT64 or FLOAT64 values.
+class ArithmeticExpression : public BatchExpression {
+ public:
+  ArithmeticExpression(Arithmetic arithmetic,
+                       std::unique_ptr<BatchExpression> left,
+                       std::unique_ptr<BatchExpression> right)
+      : BatchExpression(left->type()),
+        arithmetic_(arithmetic),
+        left_(std::move(left)),
+        right_(std::move(right)) {}
+
+  absl::Status Evaluate(const ColumnBatch& batch,
+                        BatchVector* result) const override {
+    BatchVector left, right;
+    ZETASQL_RETURN_IF_ERROR(left_->Evaluate(batch, &left));
+    ZETASQL_RETURN_IF_ERROR(right_->Evaluate(batch, &right));
+    OrNulls(left, right, result);
+    if (type()->IsDouble()) {
+      EvaluateDouble(left.doubles, right.doubles, &result->doubles);
+      return absl::OkStatus();
+    }
+    return EvaluateInt64(left.int64s, right.int64s, result);
+  }
+
+  void BindParameters(const zetasql::ParameterValueMap& parameters) override {
+    left_->BindParameters(parameters);
+    right_->BindParameters(parameters);
+  }
+
+ private:
+  void EvaluateDouble(const std::vector<double>& left,
+                      const std::vector<double>& right,
+                      std::vector<double>* result) const {
+    const int size = left.size();
+    result->resize(size);
+    for (int i = 0; i < size; ++i) {
+      switch (arithmetic_) {
+        case Arithmetic::kAdd:
+          (*result)[i] = left[i] + right[i];
+          break;
+        case Arithmetic::kSubtract:
+          (*result)[i] = left[i] - right[i];
+          break;
+        case Arithmetic::kMultiply:
+          (*result)[i] = left[i] * right[i];
+          break;
+      }
+    }
+  }
+
+  // INT64 arithmetic fails on overflow, as in the reference implementation.
+  absl::Status EvaluateInt64(const std::vector<int64_t>& left,
+                             const std::vector<int64_t>& right,
+                             BatchVector* result) const {
+    const int size = left.size();
+    result->int64s.resize(size);
+    std::vector<uint8_t> overflows(size);
+    for (int i = 0; i < size; ++i) {
+      int64_t value = 0;
+      switch (arithmetic_) {
+        case Arithmetic::kAdd:
+          overflows[i] = __builtin_add_overflow(left[i], right[i], &value);
+          break;
+        case Arithmetic::kSubtract:
+          overflows[i] = __builtin_sub_overflow(left[i], right[i], &value);
+          break;
+        case Arithmetic::kMultiply:
+          overflows[i] = __builtin_mul_overflow(left[i], right[i], &value);
+          break;
+      }
+      result->int64s[i] = value;
+    }
+    for (int i = 0; i < size; ++i) {
+      if (overflows[i] && !result->nulls[i]) {
+        const char* op = arithmetic_ == Arithmetic::kAdd        ? " + "
+                         : arithmetic_ == Arithmetic::kSubtract ? " - "
+                                                                : " * ";
+        return absl::OutOfRangeError(
+            absl::StrCat("int64 overflow: ", left[i], op, right[i]));
+      }
+    }
+    return absl::OkStatus();
+  }
+
+  Arithmetic arithmetic_;
+  std::unique_ptr<BatchExpression> left_;
+  std::unique_ptr<BatchExpression> right_;
+};
+
+// A comparison of two values of the same type.
+class ComparisonExpression : public BatchExpression {
+ public:
+  ComparisonExpression(Comparison comparison,
+                       std::unique_ptr<BatchExpression> left,
+                       std::unique_ptr<BatchExpression> right)
+      : BatchExpression(zetasql::types::BoolType()),
+        comparison_(comparison),
+        left_(std::move(left)),
+        right_(std::move(right)) {}
+
+  absl::Status Evaluate(const ColumnBatch& batch,
+                        BatchVector* result) const override {
+    BatchVector left, right;
+    ZETASQL_RETURN_IF_ERROR(left_->Evaluate(batch, &left));
+    ZETASQL_RETURN_IF_ERROR(right_->Evaluate(batch, &right));
+    OrNulls(left, right, result);
+    const zetasql::Type* type = left_->type();
+    if (type->IsInt64()) {
+      Compare(comparison_, left.int64s, right.int64s, &result->bools);
+    } else if (type->IsDouble()) {
+      Compare(comparison_, left.doubles, right.doubles, &result->bools);
+    } else if (type->IsBool()) {
+      Compare(comparison_, left.bools, right.bools, &result->bools);
+    } else {
+      // Strings compare by their UTF-8 bytes, which orders them by code point.
+      Compare(comparison_, left.strings, right.strings, &result->bools);
+    }
+    return absl::OkStatus();
+  }
+
+  void BindParameters(const zetasql::ParameterValueMap& parameters) override {
+    left_->BindParameters(parameters);
+    right_->BindParameters(parameters);
+  }
+
+  Comparison comparison() const { return comparison_; }
+  const BatchExpression* left() const { return left_.get(); }
+  const BatchExpression* right() const { return right_.get(); }
+
+ private:
+  Comparison comparison_;
+  std::unique_ptr<BatchExpression> left_;
+  std::unique_ptr<BatchExpression> right_;
+};
+
+// IS NULL.
+class IsNullExpression : public BatchExpression {
+ public:
+  explicit IsNullExpression(std::unique_ptr<BatchExpression> input)
+      : BatchExpression(zetasql::types::BoolType()), input_(std::move(input)) {}
+
+  absl::Status Evaluate(const ColumnBatch& batch,
+                        BatchVector* result) const override {
+    BatchVector input;
+    ZETASQL_RETURN_IF_ERROR(input_->Evaluate(batch, &input));
+    result->bools = std::move(input.nulls);
+    result->nulls.assign(batch.size(), 0);
+    return absl::OkStatus();
+  }
+
+  void BindParameters(const zetasql::ParameterValueMap& parameters) override {
+    input_->BindParameters(parameters);
+  }
+
+ private:
+  std::unique_ptr<BatchExpression> input_;
+};
+
+// NOT, which is NULL for NULL inputs.
+class NotExpression : public BatchExpression {
+ public:
+  explicit NotExpression(std::unique_ptr<BatchExpression> input)
+      : BatchExpression(zetasql::types::BoolType()), input_(std::move(input)) {}
+
+  absl::Status Evaluate(const ColumnBatch& batch,
+                        BatchVector* result) const override {
+    ZETASQL_RETURN_IF_ERROR(input_->Evaluate(batch, result));
+    for (uint8_t& value : result->bools) {
+      value = !value;
+    }
+    return absl::OkStatus();
+  }
+
+  void BindParameters(const zetasql::ParameterValueMap& parameters) override {
+    input_->BindParameters(parameters);
+  }
+
+ private:
+  std::unique_ptr<BatchExpression> input_;
+};
+
+// AND or OR, with the three-valued logic of SQL: AND is FALSE if an input is
+// FALSE and OR is TRUE if an input is TRUE, regardless of NULL inputs.
+class LogicalExpression : public BatchExpression {
+ public:
+  LogicalExpression(bool is_and,
+                    std::vector<std::unique_ptr<BatchExpression>> inputs)
+      : BatchExpression(zetasql::types::BoolType()),
+        is_and_(is_and),
+        inputs_(std::move(inputs)) {}
+
+  absl::Status Evaluate(const ColumnBatch& batch,
+                        BatchVector* result) const override {
+    const int size = batch.size();
+    // Whether some input decides the result, and whether some input is NULL.
+    std::vector<uint8_t> decided(size, 0);
+    std::vector<uint8_t> any_null(size, 0);
+    BatchVector input;
+    for (const auto& expression : inputs_) {
+      ZETASQL_RETURN_IF_ERROR(expression->Evaluate(batch, &input));
+      const uint8_t deciding_value = is_and_ ? 0 : 1;
+      for (int i = 0; i < size; ++i) {
+        decided[i] |= !input.nulls[i] & (input.bools[i] == deciding_value);
+        any_null[i] |= input.nulls[i];
+      }
+    }
+    result->bools.resize(size);
+    result->nulls.resize(size);
+    for (int i = 0; i < size; ++i) {
+      result->nulls[i] = !decided[i] & any_null[i];
+      result->bools[i] = is_and_ ? !decided[i] & !any_null[i] : decided[i];
+    }
+    return absl::OkStatus();
+  }
+
+  void BindParameters(const zetasql::ParameterValueMap& parameters) override {
+    for (auto& input : inputs_) {
+      input->BindParameters(parameters);
+    }
+  }
+
+ private:
+  bool is_and_;
+  std::vector<std::unique_ptr<BatchExpression>> inputs_;
+};
+
+// STARTS_WITH over STRING values.
+class StartsWithExpression : public BatchExpression {
+ public:
+  StartsWithExpression(std::unique_ptr<BatchExpression> input,
+                       std::unique_ptr<BatchExpression> prefix)
+      : BatchExpression(zetasql::types::BoolType()),
+        input_(std::move(input)),
+        prefix_(std::move(prefix)) {}
+
+  absl::Status Evaluate(const ColumnBatch& batch,
+                        BatchVector* result) const override {
+    BatchVector input, prefix;
+    ZETASQL_RETURN_IF_ERROR(input_->Evaluate(batch, &input));
+    ZETASQL_RETURN_IF_ERROR(prefix_->Evaluate(batch, &prefix));
+    OrNulls(input, prefix, result);
+    const int size = batch.size();
+    result->bools.resize(size);
+    for (int i = 0; i < size; ++i) {
+      result->bools[i] = absl::StartsWith(input.strings[i], prefix.strings[i]);
+    }
+    return absl::OkStatus();
+  }
+
+  void BindParameters(const zetasql::ParameterValueMap& parameters) override {
+    input_->BindParameters(parameters);
+    prefix_->BindParameters(parameters);
+  }
+
+ private:
+  std::unique_ptr<BatchExpression> input_;
+  std::unique_ptr<BatchExpression> prefix_;
+};
+
+// IN over a list of constants, or over the elements of a constant array for
+// IN UNNEST, with the three-valued logic of SQL: NULL if the input is NULL, or
+// if it matches no value and the list holds a NULL. The values are hashed once
+// they are bound, so that long lists of keys are matched in constant time.
+class InListExpression : public BatchExpression {
+ public:
+  InListExpression(std::unique_ptr<BatchExpression> input,
+                   std::vector<std::unique_ptr<ConstantExpression>> list,
+                   bool is_array)
+      : BatchExpression(zetasql::types::BoolType()),
+        input_(std::move(input)),
+        list_(std::move(list)),
+        is_array_(is_array) {
+    HashValues();
+  }
+
+  absl::Status Evaluate(const ColumnBatch& batch,
+                        BatchVector* result) const override {
+    if (!bound_) {
+      return error::Internal("Query parameter of IN list is not bound.");
+    }
+    BatchVector input;
+    ZETASQL_RETURN_IF_ERROR(input_->Evaluate(batch, &input));
+    const int size = batch.size();
+    result->bools.resize(size);
+    result->nulls.resize(size);
+    const zetasql::Type* type = input_->type();
+    for (int i = 0; i < size; ++i) {
+      bool found = false;
+      if (!input.nulls[i]) {
+        if (type->IsInt64()) {
+          found = int64s_.contains(input.int64s[i]);
+        } else if (type->IsBool()) {
+          found = bools_.contains(input.bools[i]);
+        } else {
+          found = strings_.contains(input.strings[i]);
+        }
+      }
+      result->bools[i] = found;
+      result->nulls[i] = input.nulls[i] | (!found & has_null_);
+    }
+    return absl::OkStatus();
+  }
+
+  void BindParameters(const zetasql::ParameterValueMap& parameters) override {
+    input_->BindParameters(parameters);
+    for (auto& constant : list_) {
+      constant->BindParameters(parameters);
+    }
+    HashValues();
+  }
+
+  const BatchExpression* input() const { return input_.get(); }
+
+  // Whether all the query parameters of the list are bound.
+  bool bound() const { return bound_; }
+
+  // The non-NULL values of the list, once bound.
+  const std::vector<zetasql::Value>& values() const { return values_; }
+
+ private:
+  // Sets values_ and the hashed values to those of the bound list.
+  void HashValues() {
+    values_.clear();
+    int64s_.clear();
+    bools_.clear();
+    strings_.clear();
+    has_null_ = false;
+    bound_ = true;
+    for (const auto& constant : list_) {
+      const zetasql::Value& value = constant->value();
+      if (!value.is_valid()) {
+        bound_ = false;
+        return;
+      }
+      if (!is_array_) {
+        AddValue(value);
+      } else if (!value.is_null()) {
+        // IN UNNEST of a NULL array is FALSE, as for an empty array.
+        for (const zetasql::Value& element : value.elements()) {
+          AddValue(element);
+        }
+      }
+    }
+  }
+
+  void AddValue(const zetasql::Value& value) {
+    if (value.is_null()) {
+      has_null_ = true;
+      return;
+    }
+    values_.push_back(value);
+    if (value.type()->IsInt64()) {
+      int64s_.insert(value.int64_value());
+    } else if (value.type()->IsBool()) {
+      bools_.insert(value.bool_value());
+    } else {
+      // The views are of the strings of values_, which share their contents
+      // when copied as the vector grows.
+      strings_.insert(values_.back().string_value());
+    }
+  }
+
+  std::unique_ptr<BatchExpression> input_;
+  std::vector<std::unique_ptr<ConstantExpression>> list_;
+  const bool is_array_;
+
+  bool bound_ = false;
+  bool has_null_ = false;
+  std::vector<zetasql::Value> values_;
+  absl::flat_hash_set<int64_t> int64s_;
+  absl::flat_hash_set<bool> bools_;
+  absl::flat_hash_set<absl::string_view> strings_;
+};
+
+const auto& kComparisons = *new absl::flat_hash_map<std::string, Comparison>{
+    {"$equal", Comparison::kEqual},
+    {"$not_equal", Comparison::kNotEqual},
+    {"$less", Comparison::kLess},
+    {"$less_or_equal", Comparison::kLessOrEqual},
+    {"$greater", Comparison::kGreater},
+    {"$greater_or_equal", Comparison::kGreaterOrEqual},
+};
+
+const auto& kArithmetics = *new absl::flat_hash_map<std::string, Arithmetic>{
+    {"$add", Arithmetic::kAdd},
+    {"$subtract", Arithmetic::kSubtract},
+    {"$multiply", Arithmetic::kMultiply},
+};
+
+}  // namespace
+
+bool IsBatchType(const zetasql::Type* type) {
+  return type->IsInt64() || type->IsDouble() || type->IsBool() ||
+         type->IsString();
+}
+
+void ColumnBatch::Append(int column, const zetasql::Value& value) {
+  BatchVector& values = columns_[column];
+  const bool is_null = value.is_null();
+  values.nulls.push_back(is_null);
+  const zetasql::Type* type = value.type();
+  if (type->IsInt64()) {
+    values.int64s.push_back(is_null ? 0 : value.int64_value());
+  } else if (type->IsDouble()) {
+    values.doubles.push_back(is_null ? 0 : value.double_value());
+  } else if (type->IsBool()) {
+    values.bools.push_back(is_null ? 0 : value.bool_value());
+  } else if (is_null) {
+    values.strings.emplace_back();
+  } else {
+    // String values share their contents when copied, so the views stay valid
+    // as string_values grows.
+    values.string_values.push_back(value);
+    values.strings.push_back(values.string_values.back().string_value());
+  }
+}
+
+void ColumnBatch::Clear() {
+  for (BatchVector& values : columns_) {
+    values.int64s.clear();
+    values.doubles.clear();
+    values.bools.clear();
+    values.strings.clear();
+    values.nulls.clear();
+    values.string_values.clear();
+  }
+  size_ = 0;
+}
+
+std::unique_ptr<BatchExpression> BatchPredicate::Compile(
+    const zetasql::ResolvedExpr* expr, const ColumnIndexFn& column_index,
+    std::vector<int>* columns) {
+  if (!IsBatchType(expr->type())) {
+    return nullptr;
+  }
+  switch (expr->node_kind()) {
+    case zetasql::RESOLVED_COLUMN_REF: {
+      const auto* column_ref = expr->GetAs<zetasql::ResolvedColumnRef>();
+      const int column = column_index(column_ref->column());
+      if (column_ref->is_correlated() || column < 0) {
+        return nullptr;
+      }
+      if (std::find(columns->begin(), columns->end(), column) ==
+          columns->end()) {
+        columns->push_back(column);
+      }
+      return absl::make_unique<ColumnExpression>(expr->type(), column);
+    }
+    case zetasql::RESOLVED_LITERAL:
+      return absl::make_unique<ConstantExpression>(
+          expr->GetAs<zetasql::ResolvedLiteral>()->value());
+    case zetasql::RESOLVED_PARAMETER: {
+      const auto* parameter = expr->GetAs<zetasql::ResolvedParameter>();
+      if (parameter->name().empty()) {
+        return nullptr;
+      }
+      return absl::make_unique<ConstantExpression>(expr->type(),
+                                                   parameter->name());
+    }
+    case zetasql::RESOLVED_FUNCTION_CALL:
+      break;
+    default:
+      return nullptr;
+  }
+
+  const auto* call = expr->GetAs<zetasql::ResolvedFunctionCall>();
+  if (!call->function()->IsZetaSQLBuiltin() ||
+      call->error_mode() !=
+          zetasql::ResolvedFunctionCallBase::DEFAULT_ERROR_MODE) {
+    return nullptr;
+  }
+  if (call->function()->Name() == "$in" ||
+      call->function()->Name() == "$in_array") {
+    return CompileInList(call, column_index, columns);
+  }
+  std::vector<std::unique_ptr<BatchExpression>> arguments;
+  for (const auto& argument : call->argument_list()) {
+    auto compiled = Compile(argument.get(), column_index, columns);
+    if (compiled == nullptr) {
+      return nullptr;
+    }
+    arguments.push_back(std::move(compiled));
+  }
+
+  const std::string& name = call->function()->Name();
+  if (name == "$and" || name == "$or") {
+    return absl::make_unique<LogicalExpression>(name == "$and",
+                                                std::move(arguments));
+  }
+  if (name == "$not" && arguments.size() == 1) {
+    return absl::make_unique<NotExpression>(std::move(arguments[0]));
+  }
+  if (name == "$is_null" && arguments.size() == 1) {
+    return absl::make_unique<IsNullExpression>(std::move(arguments[0]));
+  }
+  if (arguments.size() != 2 ||
+      !arguments[0]->type()->Equals(arguments[1]->type())) {
+    return nullptr;
+  }
+  const zetasql::Type* type = arguments[0]->type();
+  if (auto it = kComparisons.find(name); it != kComparisons.end()) {
+    return absl::make_unique<ComparisonExpression>(
+        it->second, std::move(arguments[0]), std::move(arguments[1]));
+  }
+  if (auto it = kArithmetics.find(name);
+      it != kArithmetics.end() && (type->IsInt64() || type->IsDouble())) {
+    return absl::make_unique<ArithmeticExpression>(
+        it->second, std::move(arguments[0]), std::move(arguments[1]));
+  }
+  if (name == "starts_with" && type->IsString()) {
+    return absl::make_unique<StartsWithExpression>(std::move(arguments[0]),
+                                                   std::move(arguments[1]));
+  }
+  return nullptr;
+}
+
+std::unique_ptr<BatchExpression> BatchPredicate::CompileInList(
+    const zetasql::ResolvedFunctionCall* call,
+    const ColumnIndexFn& column_index, std::vector<int>* columns) {
+  const bool is_array = call->function()->Name() == "$in_array";
+  if (call->argument_list_size() < 2 ||
+      (is_array && call->argument_list_size() != 2)) {
+    return nullptr;
+  }
+  auto input = Compile(call->argument_list(0), column_index, columns);
+  if (input == nullptr || input->type()->IsDouble()) {
+    return nullptr;
+  }
+  std::vector<std::unique_ptr<ConstantExpression>> list;
+  for (int i = 1; i < call->argument_list_size(); ++i) {
+    const zetasql::ResolvedExpr* argument = call->argument_list(i);
+    const zetasql::Type* type = argument->type();
+    if (is_array ? !type->IsArray() ||
+                       !type->AsArray()->element_type()->Equals(input->type())
+                 : !type->Equals(input->type())) {
+      return nullptr;
+    }
+    if (argument->node_kind() == zetasql::RESOLVED_LITERAL) {
+      list.push_back(absl::make_unique<ConstantExpression>(
+          argument->GetAs<zetasql::ResolvedLiteral>()->value()));
+    } else if (argument->node_kind() == zetasql::RESOLVED_PARAMETER &&
+               !argument->GetAs<zetasql::ResolvedParameter>()
+                    ->name()
+                    .empty()) {
+      list.push_back(absl::make_unique<ConstantExpression>(
+          type, argument->GetAs<zetasql::ResolvedParameter>()->name()));
+    } else {
+      return nullptr;
+    }
+  }
+  return absl::make_unique<InListExpression>(std::move(input), std::move(list),
+                                             is_array);
+}
+
+bool BatchPredicate::AddConjunct(const zetasql::ResolvedExpr* expr,
+                                 const ColumnIndexFn& column_index) {
+  std::vector<int> columns = columns_;
+  std::unique_ptr<BatchExpression> conjunct =
+      Compile(expr, column_index, &columns);
+  if (conjunct == nullptr || !conjunct->type()->IsBool()) {
+    return false;
+  }
+  columns_ = std::move(columns);
+
+  // Comparisons of a column with a constant bound the values of the column.
+  if (const auto* comparison =
+          dynamic_cast<const ComparisonExpression*>(conjunct.get());
+      comparison != nullptr &&
+      comparison->comparison() != Comparison::kNotEqual &&
+      !comparison->left()->type()->IsDouble()) {
+    const auto* left_column =
+        dynamic_cast<const ColumnExpression*>(comparison->left());
+    const auto* right_column =
+        dynamic_cast<const ColumnExpression*>(comparison->right());
+    const auto* left_constant =
+        dynamic_cast<const ConstantExpression*>(comparison->left());
+    const auto* right_constant =
+        dynamic_cast<const ConstantExpression*>(comparison->right());
+    // With the column on the left, the constant is a lower bound of the column
+    // for > and >=, and an upper bound for < and <=.
+    const bool is_greater =
+        comparison->comparison() == Comparison::kGreater ||
+        comparison->comparison() == Comparison::kGreaterOrEqual;
+    const bool is_less = comparison->comparison() == Comparison::kLess ||
+                         comparison->comparison() == Comparison::kLessOrEqual;
+    const bool is_equal = comparison->comparison() == Comparison::kEqual;
+    if (left_column != nullptr && right_constant != nullptr) {
+      bounds_.push_back({left_column->column(), is_equal || is_greater,
+                         is_equal || is_less, right_constant});
+    } else if (left_constant != nullptr && right_column != nullptr) {
+      bounds_.push_back({right_column->column(), is_equal || is_less,
+                         is_equal || is_greater, left_constant});
+    }
+  }
+  // An IN list of a column holds all the values of the column that satisfy
+  // the predicate.
+  if (const auto* in_list =
+          dynamic_cast<const InListExpression*>(conjunct.get());
+      in_list != nullptr) {
+    if (const auto* column =
+            dynamic_cast<const ColumnExpression*>(in_list->input());
+        column != nullptr) {
+      in_lists_.push_back({column->column(), in_list});
+    }
+  }
+  conjuncts_.push_back(std::move(conjunct));
+  return true;
+}
+
+void BatchPredicate::BindParameters(
+    const zetasql::ParameterValueMap& parameters) {
+  for (auto& conjunct : conjuncts_) {
+    conjunct->BindParameters(parameters);
+  }
+}
+
+absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>>
+BatchPredicate::ColumnFilters() const {
+  // The lower and upper bounds of each column, or invalid values if unbounded.
+  // Rows outside of any bound do not satisfy the predicate, so one bound of
+  // each side is enough to narrow the rows read.
+  absl::flat_hash_map<int, std::pair<zetasql::Value, zetasql::Value>> ranges;
+  for (const ColumnBound& bound : bounds_) {
+    const zetasql::Value& value =
+        static_cast<const ConstantExpression*>(bound.constant)->value();
+    if (!value.is_valid() || value.is_null()) {
+      continue;
+    }
+    auto& [lower, upper] = ranges[bound.column];
+    if (bound.is_lower && !lower.is_valid()) {
+      lower = value;
+    }
+    if (bound.is_upper && !upper.is_valid()) {
+      upper = value;
+    }
+  }
+  absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>> filters;
+  // The values of an IN list narrow the rows read to point lookups of keys,
+  // so they are preferred to the bounds of the same column.
+  for (const InListBound& bound : in_lists_) {
+    const auto* in_list = static_cast<const InListExpression*>(bound.in_list);
+    if (in_list->bound() && !filters.contains(bound.column)) {
+      filters[bound.column] =
+          absl::make_unique<zetasql::ColumnFilter>(in_list->values());
+    }
+  }
+  for (const auto& [column, range] : ranges) {
+    if (!filters.contains(column)) {
+      filters[column] =
+          absl::make_unique<zetasql::ColumnFilter>(range.first, range.second);
+    }
+  }
+  return filters;
+}
+
+absl::Status BatchPredicate::Evaluate(const ColumnBatch& batch,
+                                      std::vector<uint8_t>* selected) const {
+  const int size = batch.size();
+  selected->assign(size, 1);
+  BatchVector result;
+  for (const auto& conjunct : conjuncts_) {
+    ZETASQL_RETURN_IF_ERROR(conjunct->Evaluate(batch, &result));
+    for (int i = 0; i < size; ++i) {
+      (*selected)[i] &= result.bools[i] & !result.nulls[i];
+    }
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,192 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_BATCH_PREDICATE_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_BATCH_PREDICATE_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "zetasql/public/evaluator.h"
+#include "zetasql/public/evaluator_table_iterator.h"
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "zetasql/resolved_ast/resolved_column.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// BatchVector holds the values of an expression over a batch of rows as a
+// typed array, so that expressions are evaluated by tight loops over plain
+// integers rather than through zetasql::Value. Only the array of the type of
+// the expression is used. nulls[i] is non-zero if the value of row i is NULL,
+// in which case the value in the typed array is unspecified.
+struct BatchVector {
+  std::vector<int64_t> int64s;
+  std::vector<double> doubles;
+  std::vector<uint8_t> bools;
+  std::vector<absl::string_view> strings;
+  std::vector<uint8_t> nulls;
+
+  // The string values viewed by `strings`, if this holds a column.
+  std::vector<zetasql::Value> string_values;
+};
+
+// ColumnBatch holds the values of some of the columns of a table over a batch
+// of rows, as BatchVectors indexed by column index in the table.
+class ColumnBatch {
+ public:
+  explicit ColumnBatch(int num_columns) : columns_(num_columns) {}
+
+  // Appends the value of `column` in the current row. Each row must have a
+  // value for the same columns.
+  void Append(int column, const zetasql::Value& value);
+
+  // Ends the current row.
+  void FinishRow() { ++size_; }
+
+  // Removes all the rows.
+  void Clear();
+
+  int size() const { return size_; }
+
+  const BatchVector& column(int i) const { return columns_[i]; }
+
+ private:
+  std::vector<BatchVector> columns_;
+  int size_ = 0;
+};
+
+// Returns true if values of `type` can be held by a BatchVector.
+bool IsBatchType(const zetasql::Type* type);
+
+// An expression evaluated over batches of rows.
+class BatchExpression {
+ public:
+  virtual ~BatchExpression() = default;
+
+  const zetasql::Type* type() const { return type_; }
+
+  // Evaluates the expression over the rows of `batch` into `result`.
+  virtual absl::Status Evaluate(const ColumnBatch& batch,
+                                BatchVector* result) const = 0;
+
+  // Sets the values of the query parameters the expression refers to.
+  virtual void BindParameters(const zetasql::ParameterValueMap& parameters) {}
+
+ protected:
+  explicit BatchExpression(const zetasql::Type* type) : type_(type) {}
+
+ private:
+  const zetasql::Type* type_;
+};
+
+// BatchPredicate is a conjunction of boolean expressions evaluated over
+// batches of rows of a table, used to apply filters to the rows of a table
+// scan before they reach the ZetaSQL reference implementation.
+//
+// Comparisons, INT64 and FLOAT64 addition, subtraction and multiplication,
+// AND, OR, NOT, IS NULL and STARTS_WITH are supported over INT64, FLOAT64,
+// BOOL and STRING columns, literals and query parameters, as are IN lists and
+// IN UNNEST of literals and query parameters over INT64, BOOL and STRING
+// values. Other expressions are left for the reference implementation to
+// evaluate.
+//
+// This class is not thread-safe: its parameters are bound by the execution of
+// the query it belongs to.
+class BatchPredicate {
+ public:
+  // Returns the index in the scanned table of a column referenced by an
+  // expression, or -1 if the column is not a column of the table.
+  using ColumnIndexFn = std::function<int(const zetasql::ResolvedColumn&)>;
+
+  // Adds `expr` as a conjunct of the predicate and returns true, or returns
+  // false if some part of `expr` is not supported.
+  bool AddConjunct(const zetasql::ResolvedExpr* expr,
+                   const ColumnIndexFn& column_index);
+
+  bool empty() const { return conjuncts_.empty(); }
+
+  // The indexes in the scanned table of the columns the predicate reads.
+  const std::vector<int>& columns() const { return columns_; }
+
+  // Sets the values of the query parameters of the conjuncts, before the query
+  // is executed.
+  void BindParameters(const zetasql::ParameterValueMap& parameters);
+
+  // Returns the filters on columns of the table implied by the conjuncts with
+  // the bound parameters, by column index in the table. Rows which do not
+  // satisfy them do not satisfy the predicate, so the filters can narrow the
+  // rows read. IN lists of key columns are returned as in-list filters, which
+  // the table reads as lookups of the keys.
+  absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>>
+  ColumnFilters() const;
+
+  // Sets selected[i] to non-zero if row i of `batch` satisfies the predicate,
+  // and to zero if it evaluates to FALSE or NULL.
+  absl::Status Evaluate(const ColumnBatch& batch,
+                        std::vector<uint8_t>* selected) const;
+
+ private:
+  // A comparison of a column with a constant, which bounds the values of the
+  // column in the rows satisfying the predicate.
+  struct ColumnBound {
+    int column;
+    bool is_lower;
+    bool is_upper;
+    const BatchExpression* constant;
+  };
+
+  // An IN list of a column, which holds the values of the column in the rows
+  // satisfying the predicate.
+  struct InListBound {
+    int column;
+    const BatchExpression* in_list;
+  };
+
+  // Returns the expression evaluating `expr`, or nullptr if it is not
+  // supported.
+  std::unique_ptr<BatchExpression> Compile(const zetasql::ResolvedExpr* expr,
+                                           const ColumnIndexFn& column_index,
+                                           std::vector<int>* columns);
+
+  // Returns the expression evaluating IN or IN UNNEST `call`, or nullptr if
+  // its list is not of literals and query parameters.
+  std::unique_ptr<BatchExpression> CompileInList(
+      const zetasql::ResolvedFunctionCall* call,
+      const ColumnIndexFn& column_index, std::vector<int>* columns);
+
+  std::vector<std::unique_ptr<BatchExpression>> conjuncts_;
+  std::vector<int> columns_;
+  std::vector<ColumnBound> bounds_;
+  std::vector<InListBound> in_lists_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_BATCH_PREDICATE_H_
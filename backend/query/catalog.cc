@@ -16,6 +16,8 @@
 
 #include "backend/query/catalog.h"
 
+#include <memory>
+
 #include "zetasql/public/catalog.h"
 #include "zetasql/public/function.h"
 #include "absl/memory/memory.h"
@@ -23,9 +25,12 @@
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "backend/access/read.h"
+#include "backend/locking/lock_stats.h"
 #include "backend/query/function_catalog.h"
 #include "backend/query/information_schema_catalog.h"
+#include "backend/query/query_stats.h"
 #include "backend/query/queryable_table.h"
+#include "backend/query/spanner_sys_catalog.h"
 #include "backend/schema/catalog/schema.h"
 #include "common/errors.h"
 #include "absl/status/status.h"
@@ -68,11 +73,28 @@ class NetCatalog : public zetasql::Catalog {
 };
 
 Catalog::Catalog(const Schema* schema, const FunctionCatalog* function_catalog,
-                 RowReader* reader)
-    : schema_(schema), function_catalog_(function_catalog) {
-  for (const auto* table : schema->tables()) {
-    tables_[table->Name()] = absl::make_unique<QueryableTable>(table, reader);
+                 RowReader* reader,
+                 InformationSchemaCache* information_schema_cache,
+                 QueryableColumnsCache* columns_cache,
+                 const LockStats* lock_stats,
+                 const QueryStats* query_stats)
+    : schema_(schema),
+      reader_(reader),
+      function_catalog_(function_catalog),
+      information_schema_cache_(information_schema_cache),
+      columns_cache_(columns_cache),
+      lock_stats_(lock_stats),
+      query_stats_(query_stats) {}
+
+const QueryableTable* Catalog::GetQueryableTable(const Table* table) const {
+  absl::MutexLock lock(&mu_);
+  std::unique_ptr<const QueryableTable>& queryable_table = tables_[table];
+  if (queryable_table == nullptr) {
+    queryable_table = absl::make_unique<QueryableTable>(
+        table, reader_,
+        columns_cache_ != nullptr ? columns_cache_->Get(table) : nullptr);
   }
+  return queryable_table.get();
 }
 
 absl::Status Catalog::GetCatalog(const std::string& name,
@@ -82,6 +104,8 @@ absl::Status Catalog::GetCatalog(const std::string& name,
     *catalog = GetInformationSchemaCatalog();
   } else if (absl::EqualsIgnoreCase(name, NetCatalog::kName)) {
     *catalog = GetNetFunctionsCatalog();
+  } else if (absl::EqualsIgnoreCase(name, SpannerSysCatalog::kName)) {
+    *catalog = GetSpannerSysCatalog();
   }
   return absl::OkStatus();
 }
@@ -89,12 +113,12 @@ absl::Status Catalog::GetCatalog(const std::string& name,
 absl::Status Catalog::GetTable(const std::string& name,
                                const zetasql::Table** table,
                                const FindOptions& options) {
-  auto iter = tables_.find(name);
-  if (iter == tables_.end()) {
+  const Table* schema_table = schema_->FindTable(name);
+  if (schema_table == nullptr) {
     *table = nullptr;
     return error::TableNotFound(name);
   } else {
-    *table = iter->second.get();
+    *table = GetQueryableTable(schema_table);
     return absl::OkStatus();
   }
 }
@@ -110,13 +134,14 @@ absl::Status Catalog::GetCatalogs(
     absl::flat_hash_set<const zetasql::Catalog*>* output) const {
   output->insert(GetInformationSchemaCatalog());
   output->insert(GetNetFunctionsCatalog());
+  output->insert(GetSpannerSysCatalog());
   return absl::OkStatus();
 }
 
 absl::Status Catalog::GetTables(
     absl::flat_hash_set<const zetasql::Table*>* output) const {
-  for (auto iter = tables_.begin(); iter != tables_.end(); ++iter) {
-    output->insert(iter->second.get());
+  for (const Table* table : schema_->tables()) {
+    output->insert(GetQueryableTable(table));
   }
   return absl::OkStatus();
 }
@@ -134,8 +159,12 @@ absl::Status Catalog::GetFunctions(
 zetasql::Catalog* Catalog::GetInformationSchemaCatalog() const {
   absl::MutexLock lock(&mu_);
   if (!information_schema_catalog_) {
-    information_schema_catalog_ =
-        absl::make_unique<InformationSchemaCatalog>(schema_);
+    if (information_schema_cache_ != nullptr) {
+      information_schema_catalog_ = information_schema_cache_->Get(schema_);
+    } else {
+      information_schema_catalog_ =
+          std::make_shared<InformationSchemaCatalog>(schema_);
+    }
   }
   return information_schema_catalog_.get();
 }
@@ -148,6 +177,15 @@ zetasql::Catalog* Catalog::GetNetFunctionsCatalog() const {
   return net_catalog_.get();
 }
 
+zetasql::Catalog* Catalog::GetSpannerSysCatalog() const {
+  absl::MutexLock lock(&mu_);
+  if (!spanner_sys_catalog_) {
+    spanner_sys_catalog_ = absl::make_unique<SpannerSysCatalog>(
+        schema_, lock_stats_, query_stats_);
+  }
+  return spanner_sys_catalog_.get();
+}
+
 }  // namespace backend
 }  // namespace emulator
 }  // namespace spanner
@@ -23,10 +23,15 @@
 #include "zetasql/public/catalog.h"
 #include "zetasql/public/function.h"
 #include "zetasql/public/simple_catalog.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
 #include "backend/access/read.h"
-#include "backend/common/case.h"
+#include "backend/locking/lock_stats.h"
 #include "backend/query/function_catalog.h"
+#include "backend/query/information_schema_catalog.h"
+#include "backend/query/query_stats.h"
 #include "backend/query/queryable_table.h"
 #include "backend/schema/catalog/schema.h"
 #include "absl/status/status.h"
@@ -43,9 +48,18 @@ class NetCatalog;
 class Catalog : public zetasql::EnumerableCatalog {
  public:
   // 'reader' can be nullptr unless CreateEvaluatorTableIterator is called on
-  // tables in the catalog.
+  // tables in the catalog. If 'information_schema_cache' is not null, the
+  // information schema catalog is shared through it with other catalogs of
+  // the same schema, and likewise for the columns of the tables in the catalog
+  // with 'columns_cache'. Tables are only wrapped once they are looked up.
+  // The SPANNER_SYS tables report the contention counted in 'lock_stats' and
+  // the executions counted in 'query_stats', and are empty if they are null.
   Catalog(const Schema* schema, const FunctionCatalog* function_catalog,
-          RowReader* reader);
+          RowReader* reader,
+          InformationSchemaCache* information_schema_cache = nullptr,
+          QueryableColumnsCache* columns_cache = nullptr,
+          const LockStats* lock_stats = nullptr,
+          const QueryStats* query_stats = nullptr);
   Catalog(const Schema* schema, const FunctionCatalog* function_catalog)
       : Catalog(schema, function_catalog, /*reader=*/nullptr) {}
 
@@ -83,24 +97,53 @@ class Catalog : public zetasql::EnumerableCatalog {
   // Returns the NET catalog.
   zetasql::Catalog* GetNetFunctionsCatalog() const ABSL_LOCKS_EXCLUDED(mu_);
 
+  // Returns the SPANNER_SYS catalog (creating one if needed).
+  zetasql::Catalog* GetSpannerSysCatalog() const ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the queryable table for 'table' (creating one if needed).
+  const QueryableTable* GetQueryableTable(const Table* table) const
+      ABSL_LOCKS_EXCLUDED(mu_);
+
   // The backend schema (which is the default schema in this catalog).
   const Schema* schema_;
 
-  // Tables available in the default schema.
-  CaseInsensitiveStringMap<std::unique_ptr<const QueryableTable>> tables_;
+  // Reader of the tables in the catalog.
+  RowReader* reader_;
 
   // Functions available in the default schema.
   const FunctionCatalog* function_catalog_;
 
+  // Cache of information schema catalogs, or nullptr if not shared.
+  InformationSchemaCache* information_schema_cache_;
+
+  // Cache of the columns of queryable tables, or nullptr if not shared.
+  QueryableColumnsCache* columns_cache_;
+
+  // Lock contention reported by the SPANNER_SYS tables, or nullptr.
+  const LockStats* lock_stats_;
+
+  // Query executions reported by the SPANNER_SYS tables, or nullptr.
+  const QueryStats* query_stats_;
+
   // Mutex to protect state below.
   mutable absl::Mutex mu_;
 
+  // Tables of the default schema that have been looked up (created only if
+  // accessed).
+  mutable absl::flat_hash_map<const Table*,
+                              std::unique_ptr<const QueryableTable>>
+      tables_ ABSL_GUARDED_BY(mu_);
+
   // Information schema catalog (created only if accessed).
-  mutable std::unique_ptr<zetasql::Catalog> information_schema_catalog_
+  mutable std::shared_ptr<zetasql::Catalog> information_schema_catalog_
       ABSL_GUARDED_BY(mu_);
 
   // Sub-catalog for resolving NET function lookup.
   mutable std::unique_ptr<zetasql::Catalog> net_catalog_ ABSL_GUARDED_BY(mu_);
+
+  // SPANNER_SYS catalog (created only if accessed).
+  mutable std::unique_ptr<zetasql::Catalog> spanner_sys_catalog_
+      ABSL_GUARDED_BY(mu_);
 };
 
 }  // namespace backend
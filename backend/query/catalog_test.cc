@@ -17,17 +17,29 @@
 #include "zetasql/public/catalog.h"
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "zetasql/public/analyzer.h"
+#include "zetasql/public/evaluator_table_iterator.h"
 #include "zetasql/public/function.h"
+#include "zetasql/public/value.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "zetasql/base/testing/status_matchers.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/status/status.h"
+#include "backend/common/ids.h"
+#include "backend/datamodel/key.h"
+#include "backend/locking/lock_stats.h"
 #include "backend/query/catalog.h"
 #include "backend/query/function_catalog.h"
+#include "backend/query/information_schema_catalog.h"
+#include "backend/query/queryable_table.h"
+#include "backend/query/spanner_sys_catalog.h"
 #include "backend/schema/catalog/column.h"
 #include "backend/schema/catalog/schema.h"
 #include "backend/schema/catalog/table.h"
@@ -40,6 +52,7 @@ namespace backend {
 namespace {
 
 using ::testing::Contains;
+using ::testing::ElementsAre;
 using ::testing::Property;
 using ::zetasql_base::testing::StatusIs;
 
@@ -117,6 +130,36 @@ TEST_F(CatalogTest, FindFunctionFindsCountFunction) {
   EXPECT_EQ(function->Name(), "count");
 }
 
+TEST(SharedFunctionCatalogTest, IsBuiltOnceForAllCatalogs) {
+  zetasql::TypeFactory type_factory;
+  std::unique_ptr<const Schema> schema =
+      test::CreateSchemaWithOneTable(&type_factory);
+  Catalog catalog1(schema.get(), FunctionCatalog::Shared());
+  Catalog catalog2(schema.get(), FunctionCatalog::Shared());
+
+  const zetasql::Function* function1;
+  const zetasql::Function* function2;
+  ZETASQL_ASSERT_OK(catalog1.FindFunction({"COUNT"}, &function1, {}));
+  ZETASQL_ASSERT_OK(catalog2.FindFunction({"COUNT"}, &function2, {}));
+  EXPECT_EQ(function1, function2);
+}
+
+TEST(SharedFunctionCatalogTest, PendingCommitTimestampIsEvaluatedOncePrepared) {
+  const zetasql::Function* function;
+  FunctionCatalog::Shared()->GetFunction("PENDING_COMMIT_TIMESTAMP",
+                                         &function);
+  ASSERT_NE(function, nullptr);
+  ASSERT_NE(function->GetFunctionEvaluatorFactory(), nullptr);
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      zetasql::FunctionEvaluator evaluator,
+      function->GetFunctionEvaluatorFactory()(*function->GetSignature(0)));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(zetasql::Value first, evaluator({}));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(zetasql::Value second, evaluator({}));
+  EXPECT_TRUE(first.type()->IsTimestamp());
+  EXPECT_EQ(first, second);
+}
+
 TEST_F(CatalogTest, GetTablesGetsTheOnlyTable) {
   using zetasql::Table;
   absl::flat_hash_set<const Table*> output;
@@ -125,6 +168,157 @@ TEST_F(CatalogTest, GetTablesGetsTheOnlyTable) {
   EXPECT_THAT(output, Contains(Property(&Table::Name, "test_table")));
 }
 
+TEST_F(CatalogTest, FindTableReturnsTheSameTableOnEachLookup) {
+  const zetasql::Table* table;
+  ZETASQL_ASSERT_OK(catalog().FindTable({"test_table"}, &table, {}));
+  const zetasql::Table* same_table;
+  ZETASQL_ASSERT_OK(catalog().FindTable({"TEST_TABLE"}, &same_table, {}));
+  EXPECT_EQ(table, same_table);
+
+  absl::flat_hash_set<const zetasql::Table*> output;
+  ZETASQL_EXPECT_OK(catalog().GetTables(&output));
+  EXPECT_THAT(output, Contains(table));
+}
+
+TEST(InformationSchemaCacheTest, CatalogsOfTheSameSchemaShareIt) {
+  zetasql::TypeFactory type_factory;
+  std::unique_ptr<const Schema> schema =
+      test::CreateSchemaWithOneTable(&type_factory);
+  FunctionCatalog function_catalog{&type_factory};
+  InformationSchemaCache cache;
+  Catalog catalog{schema.get(), &function_catalog, /*reader=*/nullptr,
+                  &cache};
+  Catalog other_catalog{schema.get(), &function_catalog, /*reader=*/nullptr,
+                        &cache};
+
+  const zetasql::Table* table;
+  ZETASQL_ASSERT_OK(catalog.FindTable({"INFORMATION_SCHEMA", "TABLES"}, &table, {}));
+  const zetasql::Table* other_table;
+  ZETASQL_ASSERT_OK(other_catalog.FindTable({"INFORMATION_SCHEMA", "TABLES"},
+                                    &other_table, {}));
+  EXPECT_EQ(table, other_table);
+
+  // Catalogs created after the cache is cleared get a new information schema,
+  // while existing ones keep theirs.
+  cache.Clear();
+  Catalog new_catalog{schema.get(), &function_catalog, /*reader=*/nullptr,
+                      &cache};
+  const zetasql::Table* new_table;
+  ZETASQL_ASSERT_OK(
+      new_catalog.FindTable({"INFORMATION_SCHEMA", "TABLES"}, &new_table, {}));
+  EXPECT_NE(new_table, table);
+  ZETASQL_ASSERT_OK(catalog.FindTable({"INFORMATION_SCHEMA", "TABLES"}, &table, {}));
+  EXPECT_EQ(table, other_table);
+}
+
+// Returns the TABLE_NAME.COLUMN_NAME of the rows of INFORMATION_SCHEMA.COLUMNS,
+// limited to the tables named in 'table_names' by a filter if not empty.
+std::vector<std::string> ReadColumns(
+    InformationSchemaCatalog* catalog,
+    std::vector<zetasql::Value> table_names = {}) {
+  const zetasql::Table* columns;
+  ZETASQL_EXPECT_OK(catalog->GetTable("COLUMNS", &columns, {}));
+  // Reads COLUMN_NAME and TABLE_NAME, in that order.
+  auto iterator = columns->CreateEvaluatorTableIterator({3, 2});
+  ZETASQL_EXPECT_OK(iterator);
+  if (!table_names.empty()) {
+    absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>> filters;
+    filters[1] = absl::make_unique<zetasql::ColumnFilter>(table_names);
+    ZETASQL_EXPECT_OK((*iterator)->SetColumnFilterMap(std::move(filters)));
+  }
+  std::vector<std::string> names;
+  while ((*iterator)->NextRow()) {
+    names.push_back(absl::StrCat((*iterator)->GetValue(1).string_value(), ".",
+                                 (*iterator)->GetValue(0).string_value()));
+  }
+  ZETASQL_EXPECT_OK((*iterator)->Status());
+  return names;
+}
+
+TEST(InformationSchemaCatalogTest, TableNameFiltersLimitTheRowsGenerated) {
+  zetasql::TypeFactory type_factory;
+  std::unique_ptr<const Schema> schema =
+      test::CreateSchemaWithOneTable(&type_factory);
+  InformationSchemaCatalog catalog(schema.get());
+
+  EXPECT_THAT(ReadColumns(&catalog), Contains("test_table.string_col"));
+  EXPECT_THAT(ReadColumns(&catalog), Contains("TABLES.TABLE_NAME"));
+  EXPECT_THAT(ReadColumns(&catalog, {zetasql::values::String("test_table")}),
+              ElementsAre("test_table.int64_col", "test_table.string_col"));
+  EXPECT_THAT(ReadColumns(&catalog, {zetasql::values::String("SCHEMATA"),
+                                     zetasql::values::NullString()}),
+              ElementsAre("SCHEMATA.CATALOG_NAME", "SCHEMATA.SCHEMA_NAME"));
+  EXPECT_THAT(ReadColumns(&catalog, {zetasql::values::String("TEST_TABLE")}),
+              ElementsAre());
+}
+
+TEST(SpannerSysCatalogTest, LockStatsAreReportedAsTheyAreRead) {
+  zetasql::TypeFactory type_factory;
+  std::unique_ptr<const Schema> schema =
+      test::CreateSchemaWithOneTable(&type_factory);
+  FunctionCatalog function_catalog{&type_factory};
+  LockStats lock_stats;
+  Catalog catalog{schema.get(), &function_catalog, /*reader=*/nullptr,
+                  /*information_schema_cache=*/nullptr,
+                  /*columns_cache=*/nullptr, &lock_stats};
+
+  const zetasql::Table* table;
+  ZETASQL_ASSERT_OK(catalog.FindTable({"SPANNER_SYS", "LOCK_STATS_TOP_RANGES"},
+                              &table, {}));
+  EXPECT_TRUE(SpannerSysCatalog::IsSpannerSysTable(table));
+  // Reads TABLE_NAME, ROW_RANGE_START_KEY and LOCK_CONFLICTS.
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto iterator,
+                       table->CreateEvaluatorTableIterator({0, 1, 2}));
+  EXPECT_FALSE(iterator->NextRow());
+
+  // Contention is reported by the next read, and only for tables of the
+  // schema.
+  const TableID table_id = schema->FindTable("test_table")->id();
+  lock_stats.RecordConflict(table_id, Key({zetasql::values::Int64(1)}));
+  lock_stats.RecordConflict("dropped", Key());
+  ZETASQL_ASSERT_OK_AND_ASSIGN(iterator,
+                       table->CreateEvaluatorTableIterator({0, 1, 2}));
+  ASSERT_TRUE(iterator->NextRow());
+  EXPECT_EQ(iterator->GetValue(0), zetasql::values::String("test_table"));
+  EXPECT_EQ(iterator->GetValue(1), zetasql::values::String("test_table(1)"));
+  EXPECT_EQ(iterator->GetValue(2), zetasql::values::Int64(1));
+  EXPECT_FALSE(iterator->NextRow());
+  ZETASQL_EXPECT_OK(iterator->Status());
+}
+
+TEST(QueryableColumnsCacheTest, CatalogsOfTheSameSchemaShareColumns) {
+  zetasql::TypeFactory type_factory;
+  std::unique_ptr<const Schema> schema =
+      test::CreateSchemaWithOneTable(&type_factory);
+  FunctionCatalog function_catalog{&type_factory};
+  QueryableColumnsCache cache;
+  Catalog catalog{schema.get(), &function_catalog, /*reader=*/nullptr,
+                  /*information_schema_cache=*/nullptr, &cache};
+  Catalog other_catalog{schema.get(), &function_catalog, /*reader=*/nullptr,
+                        /*information_schema_cache=*/nullptr, &cache};
+
+  // Each catalog has its own table, bound to its own reader, but the tables
+  // share their columns.
+  const zetasql::Table* table;
+  ZETASQL_ASSERT_OK(catalog.FindTable({"test_table"}, &table, {}));
+  const zetasql::Table* other_table;
+  ZETASQL_ASSERT_OK(other_catalog.FindTable({"test_table"}, &other_table, {}));
+  EXPECT_NE(table, other_table);
+  ASSERT_GT(table->NumColumns(), 0);
+  EXPECT_EQ(table->GetColumn(0), other_table->GetColumn(0));
+  EXPECT_EQ(table->FindColumnByName("int64_col"),
+            other_table->FindColumnByName("int64_col"));
+
+  // Catalogs created after the cache is cleared get new columns.
+  cache.Clear();
+  Catalog new_catalog{schema.get(), &function_catalog, /*reader=*/nullptr,
+                      /*information_schema_cache=*/nullptr, &cache};
+  const zetasql::Table* new_table;
+  ZETASQL_ASSERT_OK(new_catalog.FindTable({"test_table"}, &new_table, {}));
+  EXPECT_NE(new_table->GetColumn(0), table->GetColumn(0));
+  EXPECT_EQ(new_table->GetColumn(0)->Name(), table->GetColumn(0)->Name());
+}
+
 }  // namespace
 }  // namespace backend
 }  // namespace emulator
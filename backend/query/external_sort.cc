@@ -0,0 +1,203 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/query/external_sort.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "backend/common/sorted_run.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_encoding.h"
+#include "backend/query/external_sort.pb.h"
+#include "common/errors.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// Appends the big-endian image of `value` to `out`, so that appended values
+// sort numerically.
+void AppendUint64(uint64_t value, std::string* out) {
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    out->push_back(static_cast<char>((value >> shift) & 0xff));
+  }
+}
+
+}  // namespace
+
+bool IsExternallySortable(const zetasql::Type* type) {
+  switch (type->kind()) {
+    case zetasql::TYPE_BOOL:
+    case zetasql::TYPE_INT64:
+    case zetasql::TYPE_DOUBLE:
+    case zetasql::TYPE_STRING:
+    case zetasql::TYPE_BYTES:
+    case zetasql::TYPE_DATE:
+    case zetasql::TYPE_TIMESTAMP:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool ExternalSortRowCursor::Next() {
+  if (!status_.ok()) {
+    return false;
+  }
+  if (!sorted_) {
+    sorted_ = true;
+    status_ = Sort();
+    if (!status_.ok()) {
+      return false;
+    }
+  }
+  if (runs_.empty()) {
+    if (next_buffered_row_ >= buffered_rows_.size()) {
+      buffered_rows_.clear();
+      return false;
+    }
+    current_row_ = std::move(buffered_rows_[next_buffered_row_++].values);
+    return true;
+  }
+  bool found = false;
+  status_ = NextMergedRow(&found);
+  return status_.ok() && found;
+}
+
+absl::Status ExternalSortRowCursor::Sort() {
+  while (rows_->Next()) {
+    Key key;
+    for (const SortColumn& column : sort_columns_) {
+      key.AddColumn(rows_->ColumnValue(column.index), column.descending);
+    }
+    BufferedRow row;
+    row.key = EncodeKey(key);
+    AppendUint64(num_rows_read_++, &row.key);
+    row.values.reserve(num_columns_);
+    int64_t row_bytes = row.key.size();
+    for (int i = 0; i < num_columns_; ++i) {
+      row.values.push_back(rows_->ColumnValue(i));
+      row_bytes += row.values.back().physical_byte_size();
+    }
+    buffered_rows_.push_back(std::move(row));
+    buffered_bytes_ += row_bytes;
+    if (options_.spill_threshold_bytes > 0 &&
+        buffered_bytes_ > options_.spill_threshold_bytes) {
+      ZETASQL_RETURN_IF_ERROR(SpillBufferedRows());
+    }
+  }
+  ZETASQL_RETURN_IF_ERROR(rows_->Status());
+
+  if (runs_.empty()) {
+    std::sort(buffered_rows_.begin(), buffered_rows_.end(),
+              [](const BufferedRow& a, const BufferedRow& b) {
+                return a.key < b.key;
+              });
+    return absl::OkStatus();
+  }
+
+  // Once any rows are spilled, the rest are too, so that all rows are merged
+  // alike.
+  if (!buffered_rows_.empty()) {
+    ZETASQL_RETURN_IF_ERROR(SpillBufferedRows());
+  }
+  for (int i = 0; i < runs_.size(); ++i) {
+    run_iterators_.push_back(runs_[i]->Seek(""));
+    if (run_iterators_[i]->Next()) {
+      run_heap_.push_back(i);
+    } else {
+      ZETASQL_RETURN_IF_ERROR(run_iterators_[i]->Status());
+    }
+  }
+  std::make_heap(run_heap_.begin(), run_heap_.end(),
+                 [this](int a, int b) { return RunSortsAfter(a, b); });
+  return absl::OkStatus();
+}
+
+absl::Status ExternalSortRowCursor::SpillBufferedRows() {
+  std::sort(buffered_rows_.begin(), buffered_rows_.end(),
+            [](const BufferedRow& a, const BufferedRow& b) {
+              return a.key < b.key;
+            });
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<SortedRun::Writer> writer,
+                   SortedRun::Writer::Create(options_.spill_directory));
+  std::string serialized;
+  for (const BufferedRow& row : buffered_rows_) {
+    SpilledSortRow spilled;
+    for (const zetasql::Value& value : row.values) {
+      ZETASQL_RETURN_IF_ERROR(value.Serialize(spilled.add_values()));
+    }
+    if (!spilled.SerializeToString(&serialized)) {
+      return error::Internal("Failed to serialize a spilled row of a sort");
+    }
+    ZETASQL_RETURN_IF_ERROR(writer->Add(row.key, serialized));
+  }
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<SortedRun> run, writer->Finish());
+  runs_.push_back(std::move(run));
+  buffered_rows_.clear();
+  buffered_bytes_ = 0;
+  return absl::OkStatus();
+}
+
+absl::Status ExternalSortRowCursor::NextMergedRow(bool* found) {
+  *found = false;
+  if (run_heap_.empty()) {
+    return absl::OkStatus();
+  }
+  auto sorts_after = [this](int a, int b) { return RunSortsAfter(a, b); };
+  std::pop_heap(run_heap_.begin(), run_heap_.end(), sorts_after);
+  const int run = run_heap_.back();
+  SortedRun::Iterator* itr = run_iterators_[run].get();
+
+  SpilledSortRow spilled;
+  if (!spilled.ParseFromArray(itr->value().data(), itr->value().size()) ||
+      spilled.values_size() != num_columns_) {
+    return error::Internal("Failed to parse a spilled row of a sort");
+  }
+  current_row_.resize(num_columns_);
+  for (int i = 0; i < num_columns_; ++i) {
+    ZETASQL_ASSIGN_OR_RETURN(current_row_[i],
+                     zetasql::Value::Deserialize(spilled.values(i),
+                                                   rows_->ColumnType(i)));
+  }
+
+  if (itr->Next()) {
+    std::push_heap(run_heap_.begin(), run_heap_.end(), sorts_after);
+  } else {
+    ZETASQL_RETURN_IF_ERROR(itr->Status());
+    run_heap_.pop_back();
+  }
+  *found = true;
+  return absl::OkStatus();
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,162 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_EXTERNAL_SORT_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_EXTERNAL_SORT_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "backend/access/read.h"
+#include "backend/common/sorted_run.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// ExternalSortOptions controls the sorting of the results of ordered queries
+// by ExternalSortRowCursor rather than by the query evaluator.
+struct ExternalSortOptions {
+  // Bytes of rows buffered in memory by a sort before they are spilled to a
+  // sorted run on disk. If 0, queries are sorted by the query evaluator.
+  int64_t spill_threshold_bytes = 0;
+
+  // Directory of the files of spilled runs, or empty for the system's
+  // temporary directory.
+  std::string spill_directory;
+};
+
+// SortColumn is a column by which ExternalSortRowCursor orders rows.
+struct SortColumn {
+  // Position of the column in the rows.
+  int index;
+
+  bool descending = false;
+};
+
+// Returns true if ExternalSortRowCursor can order rows by columns of `type`,
+// which must have an order-preserving binary encoding, see EncodeKey.
+bool IsExternallySortable(const zetasql::Type* type);
+
+// ExternalSortRowCursor returns the rows of a wrapped cursor ordered by some
+// of their columns, as ORDER BY does by default: NULLs sort first in ascending
+// order and last in descending order. Rows which compare equal are returned
+// in the order they were read.
+//
+// Each row is sorted by a normalized key: the order-preserving encoding of its
+// sort columns (see EncodeKey) followed by its position, so that sorting
+// compares rows with memcmp rather than value by value. The rows are buffered
+// in memory until they hold more than `spill_threshold_bytes`. They are then
+// sorted and spilled to a SortedRun on disk, and the runs are merged as the
+// rows are returned, so that sorting large results holds only one row of each
+// run in memory.
+//
+// The wrapped cursor is read in full by the first call to Next(). Only its
+// first `num_columns` columns are returned, so the sort columns may be hidden.
+//
+// This class is not thread-safe.
+class ExternalSortRowCursor : public RowCursor {
+ public:
+  ExternalSortRowCursor(std::unique_ptr<RowCursor> rows,
+                        std::vector<SortColumn> sort_columns, int num_columns,
+                        ExternalSortOptions options)
+      : rows_(std::move(rows)),
+        sort_columns_(std::move(sort_columns)),
+        num_columns_(num_columns),
+        options_(std::move(options)) {}
+
+  // Implementation of the RowCursor interface
+  bool Next() override;
+  absl::Status Status() const override { return status_; }
+  int NumColumns() const override { return num_columns_; }
+  const std::string ColumnName(int i) const override {
+    return rows_->ColumnName(i);
+  }
+  const zetasql::Value ColumnValue(int i) const override {
+    return current_row_[i];
+  }
+  const zetasql::Type* ColumnType(int i) const override {
+    return rows_->ColumnType(i);
+  }
+
+  // Returns the number of runs spilled to disk by the sort.
+  int num_spilled_runs() const { return runs_.size(); }
+
+ private:
+  // A row buffered in memory, with its normalized sort key.
+  struct BufferedRow {
+    std::string key;
+    std::vector<zetasql::Value> values;
+  };
+
+  // Reads and sorts the rows of the wrapped cursor.
+  absl::Status Sort();
+
+  // Sorts the buffered rows and spills them to a new run.
+  absl::Status SpillBufferedRows();
+
+  // Moves to the next row of the runs, in key order.
+  absl::Status NextMergedRow(bool* found);
+
+  // Returns true if the current record of run `a` sorts after that of run `b`,
+  // which orders run_heap_ as a min-heap.
+  bool RunSortsAfter(int a, int b) const {
+    return run_iterators_[a]->key() > run_iterators_[b]->key();
+  }
+
+  std::unique_ptr<RowCursor> rows_;
+  const std::vector<SortColumn> sort_columns_;
+  const int num_columns_;
+  const ExternalSortOptions options_;
+
+  absl::Status status_;
+  bool sorted_ = false;
+
+  // Rows read but not spilled yet, and their approximate size.
+  std::vector<BufferedRow> buffered_rows_;
+  int64_t buffered_bytes_ = 0;
+
+  // Number of rows read so far, which orders equal rows.
+  uint64_t num_rows_read_ = 0;
+
+  // Position in buffered_rows_ of the next row, if no rows were spilled.
+  int64_t next_buffered_row_ = 0;
+
+  // Spilled runs, and an iterator over each of them.
+  std::vector<std::unique_ptr<SortedRun>> runs_;
+  std::vector<std::unique_ptr<SortedRun::Iterator>> run_iterators_;
+
+  // Positions in run_iterators_ of the runs with rows left, as a min-heap
+  // ordered by the key of the current record of each run.
+  std::vector<int> run_heap_;
+
+  std::vector<zetasql::Value> current_row_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_EXTERNAL_SORT_H_
@@ -0,0 +1,167 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/query/external_sort.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "absl/memory/memory.h"
+#include "backend/access/read.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql::values::Int64;
+using zetasql::values::NullInt64;
+using zetasql::values::String;
+
+// A cursor over rows of an INT64 column "k" and a STRING column "v".
+class TestRowCursor : public RowCursor {
+ public:
+  explicit TestRowCursor(std::vector<std::vector<zetasql::Value>> rows)
+      : rows_(std::move(rows)) {}
+
+  bool Next() override {
+    return ++position_ < static_cast<int>(rows_.size());
+  }
+  absl::Status Status() const override { return absl::OkStatus(); }
+  int NumColumns() const override { return 2; }
+  const std::string ColumnName(int i) const override {
+    return i == 0 ? "k" : "v";
+  }
+  const zetasql::Value ColumnValue(int i) const override {
+    return rows_[position_][i];
+  }
+  const zetasql::Type* ColumnType(int i) const override {
+    return i == 0 ? zetasql::types::Int64Type()
+                  : zetasql::types::StringType();
+  }
+
+ private:
+  std::vector<std::vector<zetasql::Value>> rows_;
+  int position_ = -1;
+};
+
+// Returns the rows of `cursor`, which must not fail.
+std::vector<std::vector<zetasql::Value>> ReadAll(RowCursor* cursor) {
+  std::vector<std::vector<zetasql::Value>> rows;
+  while (cursor->Next()) {
+    std::vector<zetasql::Value> row;
+    for (int i = 0; i < cursor->NumColumns(); ++i) {
+      row.push_back(cursor->ColumnValue(i));
+    }
+    rows.push_back(std::move(row));
+  }
+  ZETASQL_EXPECT_OK(cursor->Status());
+  return rows;
+}
+
+TEST(ExternalSortRowCursorTest, SortsRowsInMemory) {
+  ExternalSortRowCursor cursor(
+      absl::make_unique<TestRowCursor>(std::vector<std::vector<zetasql::Value>>{
+          {Int64(3), String("c")},
+          {NullInt64(), String("n")},
+          {Int64(1), String("a")},
+          {Int64(2), String("b")}}),
+      {{.index = 0}}, /*num_columns=*/2, ExternalSortOptions());
+
+  EXPECT_THAT(ReadAll(&cursor),
+              testing::ElementsAre(
+                  testing::ElementsAre(NullInt64(), String("n")),
+                  testing::ElementsAre(Int64(1), String("a")),
+                  testing::ElementsAre(Int64(2), String("b")),
+                  testing::ElementsAre(Int64(3), String("c"))));
+  EXPECT_EQ(cursor.num_spilled_runs(), 0);
+}
+
+TEST(ExternalSortRowCursorTest, SortsDescendingColumnsWithNullsLast) {
+  ExternalSortRowCursor cursor(
+      absl::make_unique<TestRowCursor>(std::vector<std::vector<zetasql::Value>>{
+          {Int64(1), String("a")},
+          {NullInt64(), String("n")},
+          {Int64(2), String("b")}}),
+      {{.index = 0, .descending = true}}, /*num_columns=*/2,
+      ExternalSortOptions());
+
+  EXPECT_THAT(ReadAll(&cursor),
+              testing::ElementsAre(
+                  testing::ElementsAre(Int64(2), String("b")),
+                  testing::ElementsAre(Int64(1), String("a")),
+                  testing::ElementsAre(NullInt64(), String("n"))));
+}
+
+TEST(ExternalSortRowCursorTest, KeepsOrderOfEqualRowsAndHidesColumns) {
+  ExternalSortRowCursor cursor(
+      absl::make_unique<TestRowCursor>(std::vector<std::vector<zetasql::Value>>{
+          {Int64(1), String("b")},
+          {Int64(2), String("a")},
+          {Int64(3), String("b")},
+          {Int64(4), String("a")}}),
+      {{.index = 1}}, /*num_columns=*/1, ExternalSortOptions());
+
+  EXPECT_EQ(cursor.NumColumns(), 1);
+  EXPECT_THAT(ReadAll(&cursor),
+              testing::ElementsAre(testing::ElementsAre(Int64(2)),
+                                   testing::ElementsAre(Int64(4)),
+                                   testing::ElementsAre(Int64(1)),
+                                   testing::ElementsAre(Int64(3))));
+}
+
+TEST(ExternalSortRowCursorTest, MergesSpilledRuns) {
+  constexpr int kNumRows = 1000;
+  std::vector<std::vector<zetasql::Value>> rows;
+  for (int i = 0; i < kNumRows; ++i) {
+    // Visits every row once, in an order unrelated to the keys.
+    const int k = (i * 337) % kNumRows;
+    rows.push_back({Int64(k), String(std::to_string(k))});
+  }
+  ExternalSortRowCursor cursor(
+      absl::make_unique<TestRowCursor>(std::move(rows)), {{.index = 0}},
+      /*num_columns=*/2, {.spill_threshold_bytes = 4096});
+
+  std::vector<std::vector<zetasql::Value>> sorted = ReadAll(&cursor);
+  ASSERT_EQ(sorted.size(), kNumRows);
+  for (int i = 0; i < kNumRows; ++i) {
+    EXPECT_THAT(sorted[i], testing::ElementsAre(Int64(i),
+                                                String(std::to_string(i))));
+  }
+  EXPECT_GT(cursor.num_spilled_runs(), 1);
+}
+
+TEST(ExternalSortRowCursorTest, SortsKeyEncodableTypesOnly) {
+  EXPECT_TRUE(IsExternallySortable(zetasql::types::StringType()));
+  EXPECT_TRUE(IsExternallySortable(zetasql::types::TimestampType()));
+  EXPECT_FALSE(IsExternallySortable(zetasql::types::NumericType()));
+  EXPECT_FALSE(IsExternallySortable(zetasql::types::Int64ArrayType()));
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
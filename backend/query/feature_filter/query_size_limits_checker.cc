@@ -16,9 +16,7 @@
 
 #include "backend/query/feature_filter/query_size_limits_checker.h"
 
-#include <map>
 #include <queue>
-#include <set>
 #include <utility>
 #include <vector>
 
@@ -58,28 +56,65 @@ const int QuerySizeLimitsChecker::kMaxNestedStructDepth = 15;
 
 absl::Status QuerySizeLimitsChecker::CheckQueryAgainstLimits(
     const ResolvedNode* ast_root) {
-  std::set<ResolvedNodeKind> interest_nodes;
-  interest_nodes.insert(ResolvedNodeKind::RESOLVED_JOIN_SCAN);
-  interest_nodes.insert(ResolvedNodeKind::RESOLVED_PROJECT_SCAN);
-  interest_nodes.insert(ResolvedNodeKind::RESOLVED_SUBQUERY_EXPR);
-  interest_nodes.insert(ResolvedNodeKind::RESOLVED_AGGREGATE_SCAN);
-  interest_nodes.insert(ResolvedNodeKind::RESOLVED_FUNCTION_CALL);
-  interest_nodes.insert(ResolvedNodeKind::RESOLVED_PARAMETER);
-  std::map<ResolvedNodeKind, NodeCounts> collected_node_counts;
-  ZETASQL_RETURN_IF_ERROR(GetNodeMetricsAndRunLocalChecks(ast_root, interest_nodes,
-                                                  &collected_node_counts));
-  ZETASQL_RETURN_IF_ERROR(RunGlobalChecks(collected_node_counts));
-  return absl::OkStatus();
+  std::vector<std::pair<const ResolvedNode*, int>> node_stack;
+  std::vector<const ResolvedNode*> child_nodes;
+  node_stack.emplace_back(ast_root, 0);
+  while (!node_stack.empty()) {
+    auto [node, depth] = node_stack.back();
+    node_stack.pop_back();
+    ZETASQL_RETURN_IF_ERROR(CheckNode(node, depth));
+    child_nodes.clear();
+    node->GetChildNodes(&child_nodes);
+    for (const ResolvedNode* child_node : child_nodes) {
+      node_stack.emplace_back(child_node, depth + 1);
+    }
+  }
+  return CheckRecordedNodes();
 }
 
-absl::Status QuerySizeLimitsChecker::CheckNumPredicates(
-    const std::map<ResolvedNodeKind, NodeCounts>& collected_node_counts) {
-  auto it =
-      collected_node_counts.find(ResolvedNodeKind::RESOLVED_FUNCTION_CALL);
-  if (it == collected_node_counts.end()) {
-    return absl::OkStatus();
+QuerySizeLimitsChecker::CountedNodeKind QuerySizeLimitsChecker::CountedKindOf(
+    ResolvedNodeKind kind) {
+  switch (kind) {
+    case ResolvedNodeKind::RESOLVED_JOIN_SCAN:
+      return kJoinScan;
+    case ResolvedNodeKind::RESOLVED_PROJECT_SCAN:
+      return kProjectScan;
+    case ResolvedNodeKind::RESOLVED_SUBQUERY_EXPR:
+      return kSubqueryExpr;
+    case ResolvedNodeKind::RESOLVED_AGGREGATE_SCAN:
+      return kAggregateScan;
+    case ResolvedNodeKind::RESOLVED_FUNCTION_CALL:
+      return kFunctionCall;
+    case ResolvedNodeKind::RESOLVED_PARAMETER:
+      return kParameter;
+    default:
+      return kNumCountedNodeKinds;
+  }
+}
+
+void QuerySizeLimitsChecker::CountNode(CountedNodeKind kind, int depth) {
+  NodeCounts& counts = node_counts_[kind];
+  counts.total_occurrences++;
+  if (depth >= static_cast<int>(counts.occurs_at_depth.size())) {
+    counts.occurs_at_depth.resize(depth + 1);
+  }
+  if (!counts.occurs_at_depth[depth]) {
+    counts.occurs_at_depth[depth] = true;
+    counts.nested_occurrences++;
+  }
+}
+
+absl::Status QuerySizeLimitsChecker::CheckNode(const ResolvedNode* node,
+                                               int depth) {
+  const CountedNodeKind kind = CountedKindOf(node->node_kind());
+  if (kind != kNumCountedNodeKinds) {
+    CountNode(kind, depth);
   }
-  const auto node_counts = it->second;
+  return RunNodeLocalChecks(node);
+}
+
+absl::Status QuerySizeLimitsChecker::CheckNumPredicates(
+    const NodeCounts& node_counts) const {
   if (node_counts.total_occurrences > kMaxFunctionNodes) {
     return error::TooManyFunctions(kMaxFunctionNodes);
   }
@@ -87,13 +122,7 @@ absl::Status QuerySizeLimitsChecker::CheckNumPredicates(
 }
 
 absl::Status QuerySizeLimitsChecker::CheckPredicateBooleanExpressionDepth(
-    const std::map<ResolvedNodeKind, NodeCounts>& collected_node_counts) {
-  auto it =
-      collected_node_counts.find(ResolvedNodeKind::RESOLVED_FUNCTION_CALL);
-  if (it == collected_node_counts.end()) {
-    return absl::OkStatus();
-  }
-  const auto node_counts = it->second;
+    const NodeCounts& node_counts) const {
   if (node_counts.nested_occurrences > kMaxNestedFunctionNodes) {
     return error::TooManyNestedBooleanPredicates(kMaxNestedFunctionNodes);
   }
@@ -101,12 +130,7 @@ absl::Status QuerySizeLimitsChecker::CheckPredicateBooleanExpressionDepth(
 }
 
 absl::Status QuerySizeLimitsChecker::CheckNumJoins(
-    const std::map<ResolvedNodeKind, NodeCounts>& collected_node_counts) {
-  auto it = collected_node_counts.find(ResolvedNodeKind::RESOLVED_JOIN_SCAN);
-  if (it == collected_node_counts.end()) {
-    return absl::OkStatus();
-  }
-  const auto node_counts = it->second;
+    const NodeCounts& node_counts) const {
   if (node_counts.total_occurrences > kMaxJoins) {
     return error::TooManyJoins(kMaxJoins);
   }
@@ -114,13 +138,7 @@ absl::Status QuerySizeLimitsChecker::CheckNumJoins(
 }
 
 absl::Status QuerySizeLimitsChecker::CheckSubqueryExpressionDepth(
-    const std::map<ResolvedNodeKind, NodeCounts>& collected_node_counts) {
-  auto it =
-      collected_node_counts.find(ResolvedNodeKind::RESOLVED_SUBQUERY_EXPR);
-  if (it == collected_node_counts.end()) {
-    return absl::OkStatus();
-  }
-  const auto node_counts = it->second;
+    const NodeCounts& node_counts) const {
   if (node_counts.nested_occurrences > kMaxNestedSubqueryExpressions) {
     return error::TooManyNestedSubqueries(kMaxNestedSubqueryExpressions);
   }
@@ -128,12 +146,7 @@ absl::Status QuerySizeLimitsChecker::CheckSubqueryExpressionDepth(
 }
 
 absl::Status QuerySizeLimitsChecker::CheckSubselectDepth(
-    const std::map<ResolvedNodeKind, NodeCounts>& collected_node_counts) {
-  auto it = collected_node_counts.find(ResolvedNodeKind::RESOLVED_PROJECT_SCAN);
-  if (it == collected_node_counts.end()) {
-    return absl::OkStatus();
-  }
-  const auto node_counts = it->second;
+    const NodeCounts& node_counts) const {
   if (node_counts.nested_occurrences > kMaxNestedSubselects) {
     return error::TooManyNestedSubselects(kMaxNestedSubselects);
   }
@@ -141,13 +154,7 @@ absl::Status QuerySizeLimitsChecker::CheckSubselectDepth(
 }
 
 absl::Status QuerySizeLimitsChecker::CheckGroupByDepth(
-    const std::map<ResolvedNodeKind, NodeCounts>& collected_node_counts) {
-  auto it =
-      collected_node_counts.find(ResolvedNodeKind::RESOLVED_AGGREGATE_SCAN);
-  if (it == collected_node_counts.end()) {
-    return absl::OkStatus();
-  }
-  const auto node_counts = it->second;
+    const NodeCounts& node_counts) const {
   if (node_counts.nested_occurrences > kMaxNestedGroupBy) {
     return error::TooManyNestedAggregates(kMaxNestedGroupBy);
   }
@@ -155,12 +162,7 @@ absl::Status QuerySizeLimitsChecker::CheckGroupByDepth(
 }
 
 absl::Status QuerySizeLimitsChecker::CheckNumParameters(
-    const std::map<ResolvedNodeKind, NodeCounts>& collected_node_counts) {
-  auto it = collected_node_counts.find(ResolvedNodeKind::RESOLVED_PARAMETER);
-  if (it == collected_node_counts.end()) {
-    return absl::OkStatus();
-  }
-  const auto node_counts = it->second;
+    const NodeCounts& node_counts) const {
   if (node_counts.total_occurrences > kMaxParameters) {
     return error::TooManyParameters(kMaxParameters);
   }
@@ -259,16 +261,15 @@ absl::Status QuerySizeLimitsChecker::CheckStructParameterBreadthAndDepth(
   return absl::OkStatus();
 }
 
-absl::Status QuerySizeLimitsChecker::RunGlobalChecks(
-    const std::map<zetasql::ResolvedNodeKind, NodeCounts>&
-        collected_node_counts) {
-  ZETASQL_RETURN_IF_ERROR(CheckNumPredicates(collected_node_counts));
-  ZETASQL_RETURN_IF_ERROR(CheckPredicateBooleanExpressionDepth(collected_node_counts));
-  ZETASQL_RETURN_IF_ERROR(CheckNumJoins(collected_node_counts));
-  ZETASQL_RETURN_IF_ERROR(CheckSubqueryExpressionDepth(collected_node_counts));
-  ZETASQL_RETURN_IF_ERROR(CheckSubselectDepth(collected_node_counts));
-  ZETASQL_RETURN_IF_ERROR(CheckGroupByDepth(collected_node_counts));
-  ZETASQL_RETURN_IF_ERROR(CheckNumParameters(collected_node_counts));
+absl::Status QuerySizeLimitsChecker::CheckRecordedNodes() const {
+  ZETASQL_RETURN_IF_ERROR(CheckNumPredicates(node_counts_[kFunctionCall]));
+  ZETASQL_RETURN_IF_ERROR(
+      CheckPredicateBooleanExpressionDepth(node_counts_[kFunctionCall]));
+  ZETASQL_RETURN_IF_ERROR(CheckNumJoins(node_counts_[kJoinScan]));
+  ZETASQL_RETURN_IF_ERROR(CheckSubqueryExpressionDepth(node_counts_[kSubqueryExpr]));
+  ZETASQL_RETURN_IF_ERROR(CheckSubselectDepth(node_counts_[kProjectScan]));
+  ZETASQL_RETURN_IF_ERROR(CheckGroupByDepth(node_counts_[kAggregateScan]));
+  ZETASQL_RETURN_IF_ERROR(CheckNumParameters(node_counts_[kParameter]));
   return absl::OkStatus();
 }
 
@@ -296,49 +297,4 @@ absl::Status QuerySizeLimitsChecker::RunNodeLocalChecks(
   return absl::OkStatus();
 }
 
-absl::Status QuerySizeLimitsChecker::GetNodeMetricsAndRunLocalChecks(
-    const ResolvedNode* ast_root,
-    const std::set<ResolvedNodeKind>& interest_nodes,
-    std::map<ResolvedNodeKind, NodeCounts>* collected_node_counts) {
-  std::queue<const ResolvedNode*> node_queue;
-  node_queue.push(ast_root);
-  node_queue.push(nullptr);
-  int tree_depth = 0;
-  while (!node_queue.empty()) {
-    const ResolvedNode* node = node_queue.front();
-    node_queue.pop();
-    if (node == nullptr) {
-      if (!node_queue.empty()) {
-        node_queue.push(nullptr);
-        tree_depth++;
-      }
-      continue;
-    }
-    if (interest_nodes.find(node->node_kind()) != interest_nodes.end()) {
-      auto it = collected_node_counts->find(node->node_kind());
-      if (it != collected_node_counts->end()) {
-        NodeCounts& count_info = it->second;
-        count_info.total_occurrences++;
-        if (tree_depth > count_info.max_occurrence_depth) {
-          count_info.nested_occurrences++;
-        }
-        count_info.max_occurrence_depth = tree_depth;
-      } else {
-        NodeCounts node_counts;
-        node_counts.max_occurrence_depth = tree_depth;
-        node_counts.nested_occurrences = 1;
-        node_counts.total_occurrences = 1;
-        (*collected_node_counts)[node->node_kind()] = node_counts;
-      }
-    }
-    ZETASQL_RETURN_IF_ERROR(RunNodeLocalChecks(node));
-    std::vector<const ResolvedNode*> child_nodes;
-    node->GetChildNodes(&child_nodes);
-    for (const ResolvedNode* child_node : child_nodes) {
-      node_queue.push(child_node);
-    }
-  }
-  return absl::OkStatus();
-}
-
 }  // namespace google::spanner::emulator::backend
@@ -18,8 +18,8 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_FEATURE_FILTER_QUERY_SIZE_LIMITS_CHECKER_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_FEATURE_FILTER_QUERY_SIZE_LIMITS_CHECKER_H_
 
-#include <map>
-#include <set>
+#include <array>
+#include <vector>
 
 #include "zetasql/resolved_ast/resolved_node.h"
 #include "zetasql/resolved_ast/resolved_node_kind.pb.h"
@@ -27,9 +27,22 @@
 
 namespace google::spanner::emulator::backend {
 
+// Checks a resolved AST against the query size limits. The tree can either be
+// checked at once with CheckQueryAgainstLimits, or node by node with CheckNode
+// while walking it for another purpose, followed by CheckRecordedNodes.
 class QuerySizeLimitsChecker {
  public:
   absl::Status CheckQueryAgainstLimits(const zetasql::ResolvedNode* ast_root);
+
+  // Checks the limits on `node` alone, and records its metrics for the limits
+  // on the whole tree. `depth` is the depth of `node` in the tree, the root
+  // being at depth 0. The nodes of a tree can be checked in any order.
+  absl::Status CheckNode(const zetasql::ResolvedNode* node, int depth);
+
+  // Checks the limits on the whole tree, using the metrics of the nodes passed
+  // to CheckNode.
+  absl::Status CheckRecordedNodes() const;
+
   virtual ~QuerySizeLimitsChecker() {}
   static const int kMaxJoins;
   static const int kMaxNestedSubqueryExpressions;
@@ -45,38 +58,41 @@ class QuerySizeLimitsChecker {
   static const int kMaxSubqueryExpressionChildren;
 
  private:
+  // Kinds of nodes whose occurrences are counted across the tree.
+  enum CountedNodeKind {
+    kJoinScan,
+    kProjectScan,
+    kSubqueryExpr,
+    kAggregateScan,
+    kFunctionCall,
+    kParameter,
+    kNumCountedNodeKinds,
+  };
+
   struct NodeCounts {
-    int max_occurrence_depth;
-    int total_occurrences;
-    int nested_occurrences;
+    int total_occurrences = 0;
+    // Number of distinct depths at which the kind occurs.
+    int nested_occurrences = 0;
+    // Whether the kind occurs at each depth of the tree.
+    std::vector<bool> occurs_at_depth;
   };
-  absl::Status GetNodeMetricsAndRunLocalChecks(
-      const zetasql::ResolvedNode* ast_root,
-      const std::set<zetasql::ResolvedNodeKind>& interest_nodes,
-      std::map<zetasql::ResolvedNodeKind, NodeCounts>* collected_node_counts);
-  absl::Status CheckNumPredicates(
-      const std::map<zetasql::ResolvedNodeKind, NodeCounts>&
-          collected_node_counts);
+
+  // Returns the counted kind of nodes of kind `kind`, or kNumCountedNodeKinds
+  // if they are not counted.
+  static CountedNodeKind CountedKindOf(zetasql::ResolvedNodeKind kind);
+
+  // Records an occurrence of a node of `kind` at `depth`.
+  void CountNode(CountedNodeKind kind, int depth);
+
+  absl::Status CheckNumPredicates(const NodeCounts& node_counts) const;
   absl::Status CheckPredicateBooleanExpressionDepth(
-      const std::map<zetasql::ResolvedNodeKind, NodeCounts>&
-          collected_node_counts);
-  absl::Status CheckNumJoins(const std::map<zetasql::ResolvedNodeKind,
-                                            NodeCounts>& collected_node_counts);
+      const NodeCounts& node_counts) const;
+  absl::Status CheckNumJoins(const NodeCounts& node_counts) const;
   absl::Status CheckSubqueryExpressionDepth(
-      const std::map<zetasql::ResolvedNodeKind, NodeCounts>&
-          collected_node_counts);
-  absl::Status CheckSubselectDepth(
-      const std::map<zetasql::ResolvedNodeKind, NodeCounts>&
-          collected_node_counts);
-  absl::Status CheckGroupByDepth(
-      const std::map<zetasql::ResolvedNodeKind, NodeCounts>&
-          collected_node_counts);
-  absl::Status CheckNumParameters(
-      const std::map<zetasql::ResolvedNodeKind, NodeCounts>&
-          collected_node_counts);
-  absl::Status RunGlobalChecks(
-      const std::map<zetasql::ResolvedNodeKind, NodeCounts>&
-          collected_node_counts);
+      const NodeCounts& node_counts) const;
+  absl::Status CheckSubselectDepth(const NodeCounts& node_counts) const;
+  absl::Status CheckGroupByDepth(const NodeCounts& node_counts) const;
+  absl::Status CheckNumParameters(const NodeCounts& node_counts) const;
   absl::Status CheckNumColumnsInGroupBy(const zetasql::ResolvedNode* node);
   absl::Status CheckNumFieldsInStruct(const zetasql::ResolvedNode* node);
   absl::Status CheckStructParameterBreadthAndDepth(
@@ -85,6 +101,9 @@ class QuerySizeLimitsChecker {
   absl::Status CheckNumSubQueriesInSelectList(
       const zetasql::ResolvedNode* node);
   absl::Status RunNodeLocalChecks(const zetasql::ResolvedNode* node);
+
+  // Metrics of the checked nodes, by counted kind.
+  std::array<NodeCounts, kNumCountedNodeKinds> node_counts_;
 };
 
 }  // namespace google::spanner::emulator::backend
@@ -0,0 +1,114 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/query/filter_rewriter.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "zetasql/resolved_ast/resolved_column.h"
+#include "zetasql/resolved_ast/resolved_node_kind.pb.h"
+#include "absl/memory/memory.h"
+#include "backend/query/batch_predicate.h"
+#include "backend/query/filtered_table.h"
+#include "backend/query/queryable_table.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// Appends the conjuncts of `expr` to `conjuncts`.
+void AddConjuncts(const zetasql::ResolvedExpr* expr,
+                  std::vector<const zetasql::ResolvedExpr*>* conjuncts) {
+  if (expr->node_kind() == zetasql::RESOLVED_FUNCTION_CALL) {
+    const auto* call = expr->GetAs<zetasql::ResolvedFunctionCall>();
+    if (call->function()->Name() == "$and") {
+      for (const auto& argument : call->argument_list()) {
+        AddConjuncts(argument.get(), conjuncts);
+      }
+      return;
+    }
+  }
+  conjuncts->push_back(expr);
+}
+
+}  // namespace
+
+absl::Status FilterRewriter::VisitResolvedFilterScan(
+    const zetasql::ResolvedFilterScan* node) {
+  // Hints on the scan do not change how the table is read, so only time
+  // travel rules out a rewrite.
+  if (node->input_scan()->node_kind() != zetasql::RESOLVED_TABLE_SCAN) {
+    return CopyVisitResolvedFilterScan(node);
+  }
+  const auto* scan = node->input_scan()->GetAs<zetasql::ResolvedTableScan>();
+  const auto* table = dynamic_cast<const QueryableTable*>(scan->table());
+  if (table == nullptr || scan->for_system_time_expr() != nullptr) {
+    return CopyVisitResolvedFilterScan(node);
+  }
+
+  std::vector<const zetasql::ResolvedExpr*> conjuncts;
+  AddConjuncts(node->filter_expr(), &conjuncts);
+  auto column_index = [scan](const zetasql::ResolvedColumn& column) {
+    for (int i = 0; i < scan->column_list_size(); ++i) {
+      if (scan->column_list(i) == column) {
+        return scan->column_index_list(i);
+      }
+    }
+    return -1;
+  };
+  auto predicate = absl::make_unique<BatchPredicate>();
+  std::vector<const zetasql::ResolvedExpr*> remaining_conjuncts;
+  for (const zetasql::ResolvedExpr* conjunct : conjuncts) {
+    if (!predicate->AddConjunct(conjunct, column_index)) {
+      remaining_conjuncts.push_back(conjunct);
+    }
+  }
+  if (predicate->empty()) {
+    return CopyVisitResolvedFilterScan(node);
+  }
+
+  auto filtered_table =
+      absl::make_unique<FilteredTable>(table, std::move(predicate));
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<zetasql::ResolvedTableScan> table_scan,
+                   ProcessNode(scan));
+  table_scan->set_table(filtered_table.get());
+  filtered_tables_.push_back(std::move(filtered_table));
+
+  std::unique_ptr<zetasql::ResolvedScan> result = std::move(table_scan);
+  for (int i = 0; i < remaining_conjuncts.size(); ++i) {
+    ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<zetasql::ResolvedExpr> filter,
+                     ProcessNode(remaining_conjuncts[i]));
+    result = zetasql::MakeResolvedFilterScan(
+        i + 1 < remaining_conjuncts.size() ? scan->column_list()
+                                           : node->column_list(),
+        std::move(result), std::move(filter));
+  }
+  PushNodeToStack(std::move(result));
+  return absl::OkStatus();
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
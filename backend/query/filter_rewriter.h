@@ -0,0 +1,61 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_FILTER_REWRITER_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_FILTER_REWRITER_H_
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "zetasql/resolved_ast/resolved_ast_deep_copy_visitor.h"
+#include "backend/query/filtered_table.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// Implements ResolvedASTDeepCopyVisitor to replace filters over scans of
+// database tables with scans of a FilteredTable, which evaluates the
+// supported conjuncts of the filter over batches of rows.
+//
+// Conjuncts which BatchPredicate does not support are left in filter scans
+// over the FilteredTable, for the ZetaSQL reference implementation to
+// evaluate. Filters with no supported conjunct are not rewritten.
+class FilterRewriter : public zetasql::ResolvedASTDeepCopyVisitor {
+ public:
+  absl::Status VisitResolvedFilterScan(
+      const zetasql::ResolvedFilterScan* node) override;
+
+  // Returns the tables scanned by the rewritten statement, which must outlive
+  // it.
+  std::vector<std::unique_ptr<FilteredTable>> release_filtered_tables() {
+    return std::move(filtered_tables_);
+  }
+
+ private:
+  std::vector<std::unique_ptr<FilteredTable>> filtered_tables_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_FILTER_REWRITER_H_
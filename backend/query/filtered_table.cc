@@ -0,0 +1,396 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/query/filtered_table.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/evaluator_table_iterator.h"
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/ascii.h"
+#include "absl/types/span.h"
+#include "backend/query/batch_predicate.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// The number of rows read from the table and filtered at a time.
+constexpr int kBatchSize = 1024;
+
+// Returns the number of rows `count` stands for, or nullopt if it is not
+// bound to a non-negative number.
+std::optional<int64_t> NumRows(const RowCount& count) {
+  if (!count.value.is_valid() || count.value.is_null() ||
+      !count.value.type()->IsInt64() || count.value.int64_value() < 0) {
+    return std::nullopt;
+  }
+  return count.value.int64_value();
+}
+
+// Binds `count` to its parameter in `parameters`, if any.
+void BindRowCount(const zetasql::ParameterValueMap& parameters,
+                  RowCount* count) {
+  if (count->parameter.empty()) {
+    return;
+  }
+  count->value = zetasql::Value();
+  for (const auto& [name, value] : parameters) {
+    if (absl::AsciiStrToLower(name) == count->parameter) {
+      count->value = value;
+    }
+  }
+}
+
+// Orders rows by some of their values, as given by pairs of a position in the
+// rows and whether the order is descending. NULLs come first in ascending
+// order, as in ORDER BY.
+class RowOrder {
+ public:
+  explicit RowOrder(std::vector<std::pair<int, bool>> order_by)
+      : order_by_(std::move(order_by)) {}
+
+  bool operator()(const std::vector<zetasql::Value>& a,
+                  const std::vector<zetasql::Value>& b) const {
+    for (const auto& [position, descending] : order_by_) {
+      if (a[position].Equals(b[position])) {
+        continue;
+      }
+      return descending ? b[position].LessThan(a[position])
+                        : a[position].LessThan(b[position]);
+    }
+    return false;
+  }
+
+ private:
+  std::vector<std::pair<int, bool>> order_by_;
+};
+
+// An implementation of EvaluatorTableIterator which returns the rows of a
+// table iterator satisfying the predicate of a FilteredTable.
+//
+// The iterator reads the requested columns followed by the other columns read
+// by the predicate or used to order the rows. Rows are buffered in batches,
+// whose predicate columns are also held as typed arrays for the predicate to
+// evaluate.
+//
+// If the rows are limited, at most `max_rows` rows are returned: the first
+// ones read if `order_by` is empty, since the input then returns rows in
+// order, or otherwise the first ones in that order, kept in a bounded heap
+// while all the rows are read.
+class FilteredTableIterator : public zetasql::EvaluatorTableIterator {
+ public:
+  FilteredTableIterator(const FilteredTable* table,
+                        absl::Span<const int> column_idxs,
+                        std::vector<int> read_columns,
+                        std::unique_ptr<zetasql::EvaluatorTableIterator> input,
+                        int64_t max_rows,
+                        std::vector<std::pair<int, bool>> order_by)
+      : table_(table),
+        num_columns_(column_idxs.size()),
+        read_columns_(std::move(read_columns)),
+        input_(std::move(input)),
+        max_rows_(max_rows),
+        order_by_(std::move(order_by)),
+        batch_(table->NumColumns()) {
+    for (int column : table->predicate()->columns()) {
+      predicate_positions_.push_back(Position(column));
+    }
+  }
+
+  int NumColumns() const override { return num_columns_; }
+
+  std::string GetColumnName(int i) const override {
+    return input_->GetColumnName(i);
+  }
+
+  const zetasql::Type* GetColumnType(int i) const override {
+    return input_->GetColumnType(i);
+  }
+
+  // Filters are set on the input once the predicate's own filters are added,
+  // on the first call to NextRow().
+  absl::Status SetColumnFilterMap(
+      absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>>
+          filter_map) override {
+    filter_map_ = std::move(filter_map);
+    return absl::OkStatus();
+  }
+
+  bool NextRow() override {
+    if (!opened_) {
+      opened_ = true;
+      status_ = Open();
+      if (!status_.ok()) {
+        return false;
+      }
+    }
+    while (true) {
+      if (order_by_.empty() && max_rows_ >= 0 && num_returned_ == max_rows_) {
+        return false;
+      }
+      ++row_;
+      if (row_ < batch_.size()) {
+        if (selected_[row_]) {
+          ++num_returned_;
+          return true;
+        }
+        continue;
+      }
+      if (input_done_) {
+        return false;
+      }
+      status_ = ReadBatch(max_rows_ >= 0 && order_by_.empty()
+                              ? max_rows_ - num_returned_
+                              : kBatchSize);
+      if (!status_.ok()) {
+        return false;
+      }
+      row_ = -1;
+    }
+  }
+
+  const zetasql::Value& GetValue(int i) const override {
+    return rows_[row_ * read_columns_.size() + i];
+  }
+
+  absl::Status Status() const override {
+    ZETASQL_RETURN_IF_ERROR(status_);
+    return input_->Status();
+  }
+
+  absl::Status Cancel() override { return input_->Cancel(); }
+
+ private:
+  // Returns the position of `column` in read_columns_.
+  int Position(int column) const {
+    return std::find(read_columns_.begin(), read_columns_.end(), column) -
+           read_columns_.begin();
+  }
+
+  // Sets the filters of the predicate on the input, where no other filter is
+  // set on the same column, and finds the first rows in order if the rows are
+  // ordered and limited.
+  absl::Status Open() {
+    for (auto& [column, filter] : table_->predicate()->ColumnFilters()) {
+      const int position = Position(column);
+      if (!filter_map_.contains(position)) {
+        filter_map_[position] = std::move(filter);
+      }
+    }
+    ZETASQL_RETURN_IF_ERROR(input_->SetColumnFilterMap(std::move(filter_map_)));
+    if (!order_by_.empty() && max_rows_ >= 0) {
+      return ReadFirstRows();
+    }
+    return absl::OkStatus();
+  }
+
+  // Reads up to `max_batch_size` rows from the input and selects those
+  // satisfying the predicate.
+  absl::Status ReadBatch(int64_t max_batch_size) {
+    rows_.clear();
+    batch_.Clear();
+    max_batch_size = std::min<int64_t>(max_batch_size, kBatchSize);
+    while (batch_.size() < max_batch_size) {
+      if (!input_->NextRow()) {
+        input_done_ = true;
+        ZETASQL_RETURN_IF_ERROR(input_->Status());
+        break;
+      }
+      for (int i = 0; i < read_columns_.size(); ++i) {
+        rows_.push_back(input_->GetValue(i));
+      }
+      const std::vector<int>& columns = table_->predicate()->columns();
+      for (int i = 0; i < columns.size(); ++i) {
+        batch_.Append(columns[i], input_->GetValue(predicate_positions_[i]));
+      }
+      batch_.FinishRow();
+    }
+    return table_->predicate()->Evaluate(batch_, &selected_);
+  }
+
+  // Reads all the rows of the input, and keeps the first max_rows_ of those
+  // selected in order_by_ as a single batch.
+  absl::Status ReadFirstRows() {
+    std::vector<std::pair<int, bool>> order_positions;
+    for (const auto& [column, descending] : order_by_) {
+      order_positions.emplace_back(Position(column), descending);
+    }
+    // The heap holds the first rows found so far, with the last of them on
+    // top.
+    std::priority_queue<std::vector<zetasql::Value>,
+                        std::vector<std::vector<zetasql::Value>>, RowOrder>
+        first_rows{RowOrder(std::move(order_positions))};
+    const int stride = read_columns_.size();
+    while (!input_done_) {
+      ZETASQL_RETURN_IF_ERROR(ReadBatch(kBatchSize));
+      for (int i = 0; i < batch_.size(); ++i) {
+        if (!selected_[i]) {
+          continue;
+        }
+        first_rows.emplace(rows_.begin() + i * stride,
+                           rows_.begin() + (i + 1) * stride);
+        if (static_cast<int64_t>(first_rows.size()) > max_rows_) {
+          first_rows.pop();
+        }
+      }
+    }
+
+    // The rows are returned in any order, since the query sorts them.
+    rows_.clear();
+    batch_.Clear();
+    for (; !first_rows.empty(); first_rows.pop()) {
+      rows_.insert(rows_.end(), first_rows.top().begin(),
+                   first_rows.top().end());
+      batch_.FinishRow();
+    }
+    selected_.assign(batch_.size(), 1);
+    return absl::OkStatus();
+  }
+
+  const FilteredTable* table_;
+
+  // The number of requested columns, which lead the columns read.
+  const int num_columns_;
+
+  // The column indexes in the table of the columns read from input_.
+  const std::vector<int> read_columns_;
+
+  // The positions in read_columns_ of the columns read by the predicate.
+  std::vector<int> predicate_positions_;
+
+  std::unique_ptr<zetasql::EvaluatorTableIterator> input_;
+  bool input_done_ = false;
+
+  // The number of rows to return, or -1 if not limited, and the order which
+  // they are the first of, as column indexes in the table, if the input does
+  // not return rows in that order.
+  const int64_t max_rows_;
+  const std::vector<std::pair<int, bool>> order_by_;
+  int64_t num_returned_ = 0;
+
+  // The filters to set on input_ when it is opened.
+  absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>>
+      filter_map_;
+  bool opened_ = false;
+
+  // The current batch: the columns read for its rows, one row after the other,
+  // the columns read by the predicate, and the rows which satisfy it.
+  std::vector<zetasql::Value> rows_;
+  ColumnBatch batch_;
+  std::vector<uint8_t> selected_;
+
+  // The position of the current row in the batch.
+  int row_ = -1;
+
+  absl::Status status_;
+};
+
+}  // namespace
+
+void FilteredTable::BindParameters(
+    const zetasql::ParameterValueMap& parameters) {
+  predicate_->BindParameters(parameters);
+  max_rows_ = -1;
+  if (!row_limit_.has_value()) {
+    return;
+  }
+  BindRowCount(parameters, &row_limit_->limit);
+  std::optional<int64_t> limit = NumRows(row_limit_->limit);
+  std::optional<int64_t> offset = 0;
+  if (row_limit_->offset.has_value()) {
+    BindRowCount(parameters, &*row_limit_->offset);
+    offset = NumRows(*row_limit_->offset);
+  }
+  // Invalid limits are left for the query to reject.
+  if (limit.has_value() && offset.has_value() &&
+      !__builtin_add_overflow(*limit, *offset, &max_rows_)) {
+    return;
+  }
+  max_rows_ = -1;
+}
+
+zetasql_base::StatusOr<std::unique_ptr<zetasql::EvaluatorTableIterator>>
+FilteredTable::CreateEvaluatorTableIterator(
+    absl::Span<const int> column_idxs) const {
+  return CreateIterator(column_idxs, /*ordered=*/false);
+}
+
+zetasql_base::StatusOr<std::unique_ptr<zetasql::EvaluatorTableIterator>>
+FilteredTable::CreateOrderedEvaluatorTableIterator(
+    absl::Span<const int> column_idxs) const {
+  // Rows kept in a heap are not returned in order.
+  ZETASQL_RET_CHECK(!row_limit_.has_value() || row_limit_->in_key_order);
+  return CreateIterator(column_idxs, /*ordered=*/true);
+}
+
+zetasql_base::StatusOr<std::unique_ptr<zetasql::EvaluatorTableIterator>>
+FilteredTable::CreateIterator(absl::Span<const int> column_idxs,
+                              bool ordered) const {
+  std::vector<int> read_columns(column_idxs.begin(), column_idxs.end());
+  auto add_column = [&read_columns](int column) {
+    if (std::find(read_columns.begin(), read_columns.end(), column) ==
+        read_columns.end()) {
+      read_columns.push_back(column);
+    }
+  };
+  for (int column : predicate_->columns()) {
+    add_column(column);
+  }
+  std::vector<std::pair<int, bool>> order_by;
+  const bool limited = row_limit_.has_value() && max_rows_ >= 0;
+  if (limited && !row_limit_->in_key_order) {
+    order_by = row_limit_->order_by;
+    for (const auto& [column, descending] : order_by) {
+      add_column(column);
+    }
+  }
+
+  std::unique_ptr<zetasql::EvaluatorTableIterator> input;
+  if (limited && row_limit_->in_key_order) {
+    ZETASQL_ASSIGN_OR_RETURN(input, table_->CreateOrderedEvaluatorTableIterator(
+                                read_columns, row_limit_->index));
+  } else if (ordered) {
+    ZETASQL_ASSIGN_OR_RETURN(input, table_->CreateOrderedEvaluatorTableIterator(
+                                read_columns, /*index=*/nullptr));
+  } else {
+    ZETASQL_ASSIGN_OR_RETURN(input,
+                     table_->CreateEvaluatorTableIterator(read_columns));
+  }
+  return absl::make_unique<FilteredTableIterator>(
+      this, column_idxs, std::move(read_columns), std::move(input),
+      limited ? max_rows_ : -1, std::move(order_by));
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
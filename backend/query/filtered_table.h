@@ -0,0 +1,144 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_FILTERED_TABLE_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_FILTERED_TABLE_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/catalog.h"
+#include "zetasql/public/evaluator.h"
+#include "zetasql/public/evaluator_table_iterator.h"
+#include "zetasql/public/value.h"
+#include "absl/types/span.h"
+#include "backend/query/batch_predicate.h"
+#include "backend/query/queryable_table.h"
+#include "backend/schema/catalog/index.h"
+#include "zetasql/base/statusor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// A literal or query parameter giving the number of rows of a LIMIT or OFFSET
+// clause.
+struct RowCount {
+  // The lower-cased name of the parameter, or empty for a literal.
+  std::string parameter;
+
+  // The number of rows, once the parameter is bound.
+  zetasql::Value value;
+};
+
+// The rows of a table needed by a query which orders them and keeps the first
+// of them with LIMIT and OFFSET: the first limit + offset rows in the order of
+// the query. The query still sorts and limits the rows, but only sorts those.
+struct RowLimit {
+  RowCount limit;
+  std::optional<RowCount> offset;
+
+  // The columns the rows are ordered by, as column indexes in the table, and
+  // whether each is in descending order.
+  std::vector<std::pair<int, bool>> order_by;
+
+  // Whether order_by is the key order of `index`, or of the primary key if
+  // `index` is nullptr. The rows are then read in that order until enough are
+  // found. Otherwise all the rows are read, and the first ones in order are
+  // kept in a bounded heap.
+  bool in_key_order = false;
+  const Index* index = nullptr;
+};
+
+// FilteredTable is a zetasql::Table holding the rows of a QueryableTable which
+// satisfy a BatchPredicate. FilterRewriter substitutes scans of a
+// FilteredTable for filters over table scans in queries, so that the rows of
+// the table are filtered in batches of typed values rather than one at a time
+// by the ZetaSQL reference implementation.
+//
+// The columns of the table are those of the QueryableTable. Comparisons of
+// columns with constants in the predicate are pushed down to the read of the
+// table, along with the filters set on the iterators of the table.
+//
+// LimitRewriter further restricts the table to a RowLimit when its rows are
+// ordered and limited by a query, possibly with an empty predicate, so that
+// reads of the first rows of a table do not read the whole table.
+class FilteredTable : public zetasql::Table {
+ public:
+  std::string Name() const override { return table_->Name(); }
+
+  // FullName is used in debugging so it's OK to not include full path here.
+  std::string FullName() const override { return table_->FullName(); }
+
+  int NumColumns() const override { return table_->NumColumns(); }
+
+  const zetasql::Column* GetColumn(int i) const override {
+    return table_->GetColumn(i);
+  }
+
+  const zetasql::Column* FindColumnByName(
+      const std::string& name) const override {
+    return table_->FindColumnByName(name);
+  }
+
+  std::optional<std::vector<int>> PrimaryKey() const override {
+    return table_->PrimaryKey();
+  }
+
+  zetasql_base::StatusOr<std::unique_ptr<zetasql::EvaluatorTableIterator>>
+  CreateEvaluatorTableIterator(
+      absl::Span<const int> column_idxs) const override;
+
+  // Returns an iterator over the rows of the table in primary key order, or in
+  // the key order of the row limit. The rows must not be kept in a heap.
+  zetasql_base::StatusOr<std::unique_ptr<zetasql::EvaluatorTableIterator>>
+  CreateOrderedEvaluatorTableIterator(absl::Span<const int> column_idxs) const;
+
+  // Sets the values of the query parameters referenced by the predicate and
+  // the row limit. Must be called before each execution of the query scanning
+  // the table.
+  void BindParameters(const zetasql::ParameterValueMap& parameters);
+
+  void set_row_limit(RowLimit row_limit) { row_limit_ = std::move(row_limit); }
+
+  const QueryableTable* table() const { return table_; }
+  const BatchPredicate* predicate() const { return predicate_.get(); }
+  const std::optional<RowLimit>& row_limit() const { return row_limit_; }
+
+ private:
+  zetasql_base::StatusOr<std::unique_ptr<zetasql::EvaluatorTableIterator>>
+  CreateIterator(absl::Span<const int> column_idxs, bool ordered) const;
+
+  const QueryableTable* table_;
+  std::unique_ptr<BatchPredicate> predicate_;
+  std::optional<RowLimit> row_limit_;
+
+  // The number of rows of row_limit_ with the bound parameters, or -1 if the
+  // rows are not limited.
+  int64_t max_rows_ = -1;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_FILTERED_TABLE_H_
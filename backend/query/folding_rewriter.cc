@@ -0,0 +1,344 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/query/folding_rewriter.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/function.h"
+#include "zetasql/public/function_signature.h"
+#include "zetasql/public/type.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "zetasql/resolved_ast/resolved_ast_deep_copy_visitor.h"
+#include "zetasql/resolved_ast/resolved_column.h"
+#include "zetasql/resolved_ast/resolved_node_kind.pb.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "backend/query/function_catalog.h"
+#include "backend/query/spanner_sys_catalog.h"
+#include "absl/status/status.h"
+#include "zetasql/base/statusor.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// Checks that an expression only calls deterministic builtin functions of
+// literals, query parameters and, if allowed, columns.
+class ExpressionChecker : public zetasql::ResolvedASTVisitor {
+ public:
+  explicit ExpressionChecker(bool allow_column_refs)
+      : allow_column_refs_(allow_column_refs) {}
+
+  absl::Status DefaultVisit(const zetasql::ResolvedNode* node) override {
+    switch (node->node_kind()) {
+      case zetasql::RESOLVED_LITERAL:
+      case zetasql::RESOLVED_PARAMETER:
+      case zetasql::RESOLVED_CAST:
+        break;
+      case zetasql::RESOLVED_COLUMN_REF:
+        supported_ = allow_column_refs_;
+        break;
+      case zetasql::RESOLVED_FUNCTION_CALL: {
+        const auto* call = node->GetAs<zetasql::ResolvedFunctionCall>();
+        supported_ = call->function()->IsZetaSQLBuiltin() &&
+                     !IsNondeterministicFunction(call->function()->Name());
+        break;
+      }
+      default:
+        supported_ = false;
+    }
+    if (!supported_) {
+      return absl::OkStatus();
+    }
+    return zetasql::ResolvedASTVisitor::DefaultVisit(node);
+  }
+
+  bool supported() const { return supported_; }
+
+ private:
+  const bool allow_column_refs_;
+  bool supported_ = true;
+};
+
+// Finds the calls of functions whose results differ between executions of a
+// statement over the same rows, and the scans which sample rows at random.
+class NondeterminismFinder : public zetasql::ResolvedASTVisitor {
+ public:
+  absl::Status VisitResolvedFunctionCall(
+      const zetasql::ResolvedFunctionCall* node) override {
+    if (IsNondeterministicFunction(node->function()->Name())) {
+      found_ = true;
+    }
+    return DefaultVisit(node);
+  }
+
+  absl::Status VisitResolvedSampleScan(
+      const zetasql::ResolvedSampleScan* node) override {
+    found_ = true;
+    return DefaultVisit(node);
+  }
+
+  // The rows of the SPANNER_SYS tables change without any write to the
+  // database.
+  absl::Status VisitResolvedTableScan(
+      const zetasql::ResolvedTableScan* node) override {
+    if (SpannerSysCatalog::IsSpannerSysTable(node->table())) {
+      found_ = true;
+    }
+    return DefaultVisit(node);
+  }
+
+  bool found() const { return found_; }
+
+ private:
+  bool found_ = false;
+};
+
+// Returns a deep copy of `expr`.
+zetasql_base::StatusOr<std::unique_ptr<const zetasql::ResolvedExpr>> CopyExpr(
+    const zetasql::ResolvedExpr* expr) {
+  zetasql::ResolvedASTDeepCopyVisitor copier;
+  ZETASQL_RETURN_IF_ERROR(expr->Accept(&copier));
+  return copier.ConsumeRootNode<zetasql::ResolvedExpr>();
+}
+
+// Returns true if `expr` is a function call or cast which only depends on
+// literals, query parameters and, if `allow_column_refs`, columns.
+bool IsComputedExpression(const zetasql::ResolvedExpr* expr,
+                          bool allow_column_refs) {
+  if (expr->node_kind() != zetasql::RESOLVED_FUNCTION_CALL &&
+      expr->node_kind() != zetasql::RESOLVED_CAST) {
+    return false;
+  }
+  ExpressionChecker checker(allow_column_refs);
+  return expr->Accept(&checker).ok() && checker.supported();
+}
+
+}  // namespace
+
+bool IsNondeterministicFunction(absl::string_view name) {
+  static const auto* nondeterministic_functions =
+      new absl::flat_hash_set<absl::string_view>{
+          "current_date",
+          "current_datetime",
+          "current_time",
+          "current_timestamp",
+          "generate_uuid",
+          "pending_commit_timestamp",
+          "rand",
+      };
+  return nondeterministic_functions->contains(name);
+}
+
+bool IsDeterministic(const zetasql::ResolvedNode& node) {
+  NondeterminismFinder finder;
+  return node.Accept(&finder).ok() && !finder.found();
+}
+
+std::string FoldingRewriter::FoldedParameter(
+    std::unique_ptr<const zetasql::ResolvedExpr> expr) {
+  auto [itr, inserted] = folded_expression_indexes_.emplace(
+      expr->DebugString(), folded_expressions_.size());
+  if (inserted) {
+    FoldedExpression folded_expression;
+    folded_expression.parameter =
+        absl::StrCat("$folded", folded_expressions_.size());
+    folded_expression.expr = std::move(expr);
+    folded_expressions_.push_back(std::move(folded_expression));
+  }
+  return folded_expressions_[itr->second].parameter;
+}
+
+absl::Status FoldingRewriter::MaybeFold(const zetasql::ResolvedExpr* node,
+                                        bool* folded) {
+  *folded = false;
+  if (option_depth_ > 0 ||
+      !IsComputedExpression(node, /*allow_column_refs=*/false)) {
+    return absl::OkStatus();
+  }
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<const zetasql::ResolvedExpr> copy,
+                   CopyExpr(node));
+  PushNodeToStack(zetasql::MakeResolvedParameter(
+      node->type(), FoldedParameter(std::move(copy)), /*position=*/0,
+      /*is_untyped=*/false));
+  *folded = true;
+  return absl::OkStatus();
+}
+
+absl::Status FoldingRewriter::MaybeFoldSemiJoin(
+    const zetasql::ResolvedSubqueryExpr* node, bool* folded) {
+  *folded = false;
+  const zetasql::Function* in_array = nullptr;
+  function_catalog_->GetFunction("$in_array", &in_array);
+  if (option_depth_ > 0 || in_array == nullptr ||
+      node->subquery_type() != zetasql::ResolvedSubqueryExpr::IN ||
+      node->parameter_list_size() > 0 ||
+      node->subquery()->column_list_size() != 1 ||
+      !IsDeterministic(*node->subquery())) {
+    return absl::OkStatus();
+  }
+  const zetasql::Type* type = node->in_expr()->type();
+  if (type->IsArray() ||
+      !node->subquery()->column_list(0).type()->Equals(type)) {
+    return absl::OkStatus();
+  }
+  const zetasql::ArrayType* array_type = nullptr;
+  ZETASQL_RETURN_IF_ERROR(type_factory_->MakeArrayType(type, &array_type));
+
+  zetasql::ResolvedASTDeepCopyVisitor copier;
+  ZETASQL_RETURN_IF_ERROR(node->subquery()->Accept(&copier));
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<zetasql::ResolvedScan> subquery,
+                   copier.ConsumeRootNode<zetasql::ResolvedScan>());
+  const std::string parameter = FoldedParameter(
+      zetasql::MakeResolvedSubqueryExpr(
+          array_type, zetasql::ResolvedSubqueryExpr::ARRAY,
+          /*parameter_list=*/{}, /*in_expr=*/nullptr, std::move(subquery)));
+
+  std::vector<std::unique_ptr<const zetasql::ResolvedExpr>> arguments;
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<zetasql::ResolvedExpr> in_expr,
+                   ProcessNode(node->in_expr()));
+  arguments.push_back(std::move(in_expr));
+  arguments.push_back(zetasql::MakeResolvedParameter(
+      array_type, parameter, /*position=*/0, /*is_untyped=*/false));
+  zetasql::FunctionSignature signature(
+      zetasql::FunctionArgumentType(zetasql::types::BoolType(),
+                                    /*num_occurrences=*/1),
+      {zetasql::FunctionArgumentType(type, /*num_occurrences=*/1),
+       zetasql::FunctionArgumentType(array_type, /*num_occurrences=*/1)},
+      in_array->GetSignature(0)->context_id());
+  PushNodeToStack(zetasql::MakeResolvedFunctionCall(
+      zetasql::types::BoolType(), in_array, signature, std::move(arguments),
+      zetasql::ResolvedFunctionCallBase::DEFAULT_ERROR_MODE));
+  *folded = true;
+  return absl::OkStatus();
+}
+
+absl::Status FoldingRewriter::VisitResolvedFunctionCall(
+    const zetasql::ResolvedFunctionCall* node) {
+  bool folded = false;
+  ZETASQL_RETURN_IF_ERROR(MaybeFold(node, &folded));
+  if (folded) {
+    return absl::OkStatus();
+  }
+  return CopyVisitResolvedFunctionCall(node);
+}
+
+absl::Status FoldingRewriter::VisitResolvedCast(
+    const zetasql::ResolvedCast* node) {
+  bool folded = false;
+  ZETASQL_RETURN_IF_ERROR(MaybeFold(node, &folded));
+  if (folded) {
+    return absl::OkStatus();
+  }
+  return CopyVisitResolvedCast(node);
+}
+
+absl::Status FoldingRewriter::VisitResolvedSubqueryExpr(
+    const zetasql::ResolvedSubqueryExpr* node) {
+  bool folded = false;
+  ZETASQL_RETURN_IF_ERROR(MaybeFoldSemiJoin(node, &folded));
+  if (folded) {
+    return absl::OkStatus();
+  }
+  return CopyVisitResolvedSubqueryExpr(node);
+}
+
+absl::Status FoldingRewriter::VisitResolvedProjectScan(
+    const zetasql::ResolvedProjectScan* node) {
+  // Position in the expressions of the projection of the first computed
+  // column with the same expression, for each computed column.
+  std::vector<int> first_computed(node->expr_list_size());
+  absl::flat_hash_map<std::string, int> computed_indexes;
+  bool duplicated = false;
+  for (int i = 0; i < node->expr_list_size(); ++i) {
+    first_computed[i] = i;
+    const zetasql::ResolvedExpr* expr = node->expr_list(i)->expr();
+    if (!IsComputedExpression(expr, /*allow_column_refs=*/true)) {
+      continue;
+    }
+    auto [itr, inserted] = computed_indexes.emplace(expr->DebugString(), i);
+    if (!inserted) {
+      first_computed[i] = itr->second;
+      duplicated = true;
+    }
+  }
+  if (!duplicated) {
+    return CopyVisitResolvedProjectScan(node);
+  }
+
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<zetasql::ResolvedScan> input_scan,
+                   ProcessNode(node->input_scan()));
+  std::vector<zetasql::ResolvedColumn> inner_columns =
+      node->input_scan()->column_list();
+  std::vector<std::unique_ptr<const zetasql::ResolvedComputedColumn>>
+      inner_exprs;
+  std::vector<std::unique_ptr<const zetasql::ResolvedComputedColumn>>
+      outer_exprs;
+  for (int i = 0; i < node->expr_list_size(); ++i) {
+    const zetasql::ResolvedComputedColumn* computed = node->expr_list(i);
+    if (first_computed[i] == i) {
+      ZETASQL_ASSIGN_OR_RETURN(
+          std::unique_ptr<zetasql::ResolvedComputedColumn> copy,
+          ProcessNode(computed));
+      inner_columns.push_back(computed->column());
+      inner_exprs.push_back(std::move(copy));
+    } else {
+      const zetasql::ResolvedColumn& column =
+          node->expr_list(first_computed[i])->column();
+      outer_exprs.push_back(zetasql::MakeResolvedComputedColumn(
+          computed->column(),
+          zetasql::MakeResolvedColumnRef(column.type(), column,
+                                         /*is_correlated=*/false)));
+    }
+  }
+  auto inner_scan = zetasql::MakeResolvedProjectScan(
+      inner_columns, std::move(inner_exprs), std::move(input_scan));
+  inner_scan->set_is_ordered(node->is_ordered());
+  auto outer_scan = zetasql::MakeResolvedProjectScan(
+      node->column_list(), std::move(outer_exprs), std::move(inner_scan));
+  outer_scan->set_is_ordered(node->is_ordered());
+  for (const auto& hint : node->hint_list()) {
+    ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<zetasql::ResolvedOption> copy,
+                     ProcessNode(hint.get()));
+    outer_scan->add_hint_list(std::move(copy));
+  }
+  PushNodeToStack(std::move(outer_scan));
+  return absl::OkStatus();
+}
+
+absl::Status FoldingRewriter::VisitResolvedOption(
+    const zetasql::ResolvedOption* node) {
+  ++option_depth_;
+  absl::Status status = CopyVisitResolvedOption(node);
+  --option_depth_;
+  return status;
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,139 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_FOLDING_REWRITER_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_FOLDING_REWRITER_H_
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/evaluator.h"
+#include "zetasql/public/types/type_factory.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "zetasql/resolved_ast/resolved_ast_deep_copy_visitor.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "backend/query/function_catalog.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// Returns true if calls of the function named `name` may return different
+// results for the same arguments.
+bool IsNondeterministicFunction(absl::string_view name);
+
+// Returns true if the result of `node` only depends on the rows it reads: it
+// calls no nondeterministic function, samples no rows at random and reads no
+// SPANNER_SYS table.
+bool IsDeterministic(const zetasql::ResolvedNode& node);
+
+// An expression replaced with a query parameter by FoldingRewriter.
+struct FoldedExpression {
+  // Name of the parameter holding the value of the expression.
+  std::string parameter;
+
+  std::unique_ptr<const zetasql::ResolvedExpr> expr;
+
+  // The expression once prepared, which must be evaluated with the parameters
+  // of each execution of the rewritten statement.
+  std::unique_ptr<zetasql::PreparedExpression> prepared;
+};
+
+// Implements ResolvedASTDeepCopyVisitor to reduce the expressions the ZetaSQL
+// reference implementation evaluates for each row of a statement:
+//
+//  - Calls of deterministic functions (and casts) whose arguments only depend
+//    on literals and query parameters are replaced with new query parameters,
+//    so that they are evaluated once per execution rather than once per row.
+//    Identical expressions share a parameter.
+//
+//  - Computed columns of a projection with the same expression as an earlier
+//    computed column of the projection are replaced with references to it,
+//    through a new projection evaluating each distinct expression once.
+//
+//  - Uncorrelated and deterministic `x IN (SELECT ...)` semi-joins are
+//    replaced with `x IN UNNEST(@p)`, where the parameter holds the array of
+//    the rows of the subquery. The subquery is then evaluated once per
+//    execution, and an IN UNNEST of a key column of a filtered table scan is
+//    read as a lookup of the keys, see BatchPredicate.
+//
+// The names of the new parameters start with "$", which query parameters
+// named in SQL cannot. Hints are not rewritten.
+class FoldingRewriter : public zetasql::ResolvedASTDeepCopyVisitor {
+ public:
+  // Semi-joins are rewritten with the IN UNNEST function of
+  // `function_catalog`, with array types made by `type_factory`.
+  FoldingRewriter(const FunctionCatalog* function_catalog,
+                  zetasql::TypeFactory* type_factory)
+      : function_catalog_(function_catalog), type_factory_(type_factory) {}
+
+  absl::Status VisitResolvedFunctionCall(
+      const zetasql::ResolvedFunctionCall* node) override;
+
+  absl::Status VisitResolvedCast(const zetasql::ResolvedCast* node) override;
+
+  absl::Status VisitResolvedProjectScan(
+      const zetasql::ResolvedProjectScan* node) override;
+
+  absl::Status VisitResolvedSubqueryExpr(
+      const zetasql::ResolvedSubqueryExpr* node) override;
+
+  absl::Status VisitResolvedOption(
+      const zetasql::ResolvedOption* node) override;
+
+  // Returns the expressions replaced with parameters, which are not prepared.
+  std::vector<FoldedExpression> release_folded_expressions() {
+    return std::move(folded_expressions_);
+  }
+
+ private:
+  // Replaces `node` with a parameter if it can be folded, setting `folded`.
+  absl::Status MaybeFold(const zetasql::ResolvedExpr* node, bool* folded);
+
+  // Returns the parameter holding the value of `expr`, which is taken as a
+  // new folded expression unless an identical one was already folded.
+  std::string FoldedParameter(
+      std::unique_ptr<const zetasql::ResolvedExpr> expr);
+
+  // Replaces `node` with an IN UNNEST of a parameter if it is a semi-join
+  // which can be folded, setting `folded`.
+  absl::Status MaybeFoldSemiJoin(const zetasql::ResolvedSubqueryExpr* node,
+                                 bool* folded);
+
+  const FunctionCatalog* function_catalog_;
+  zetasql::TypeFactory* type_factory_;
+
+  std::vector<FoldedExpression> folded_expressions_;
+
+  // Positions in folded_expressions_ by the debug string of the expression.
+  absl::flat_hash_map<std::string, int> folded_expression_indexes_;
+
+  // Number of hints being copied, within which nothing is folded.
+  int option_depth_ = 0;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_FOLDING_REWRITER_H_
@@ -44,21 +44,31 @@ namespace {
 constexpr char kCloudSpannerEmulatorFunctionCatalog[] =
     "CloudSpannerEmulatorCatalog";
 
-zetasql_base::StatusOr<zetasql::Value> EvalPendingCommitTimestamp(
-    absl::Span<const zetasql::Value> args) {
-  ZETASQL_RET_CHECK(args.empty());
+// Returns the evaluator of PENDING_COMMIT_TIMESTAMP for the concrete
+// `signature` of a call. It is chosen once when the statement is prepared, so
+// the arguments are checked there rather than on every row, and every row
+// returns the same prebuilt value.
+zetasql_base::StatusOr<zetasql::FunctionEvaluator>
+PendingCommitTimestampEvaluator(const zetasql::FunctionSignature& signature) {
+  ZETASQL_RET_CHECK_EQ(signature.NumConcreteArguments(), 0);
 
   // Timestamp returned by this function is ignored later by query engine and is
   // replaced by kCommitTimestampIdentifier sentinel string as expected by cloud
   // spanner. Note that this function cannot return a string sentinel here since
   // googlesql evaluator expects a timestamp value for the corresponding column.
-  return zetasql::Value::Timestamp(zetasql::types::TimestampMinBaseTime());
+  static const zetasql::Value* const kPendingCommitTimestamp =
+      new zetasql::Value(
+          zetasql::Value::Timestamp(zetasql::types::TimestampMinBaseTime()));
+  return zetasql::FunctionEvaluator(
+      [](absl::Span<const zetasql::Value> args)
+          -> zetasql_base::StatusOr<zetasql::Value> {
+        return *kPendingCommitTimestamp;
+      });
 }
 
 std::unique_ptr<zetasql::Function> PendingCommitTimestampFunction() {
   zetasql::FunctionOptions function_options;
-  function_options.set_evaluator(
-      zetasql::FunctionEvaluator(EvalPendingCommitTimestamp));
+  function_options.set_evaluator_factory(PendingCommitTimestampEvaluator);
 
   return absl::make_unique<zetasql::Function>(
       kPendingCommitTimestampFunctionName, kCloudSpannerEmulatorFunctionCatalog,
@@ -79,6 +89,16 @@ FunctionCatalog::FunctionCatalog(zetasql::TypeFactory* type_factory) {
   AddFunctionAliases();
 }
 
+const FunctionCatalog* FunctionCatalog::Shared() {
+  // Registering the builtin functions dominates the creation of an empty
+  // database, so it is only done once. Neither object is ever destroyed.
+  static zetasql::TypeFactory* const type_factory =
+      new zetasql::TypeFactory();
+  static const FunctionCatalog* const function_catalog =
+      new FunctionCatalog(type_factory);
+  return function_catalog;
+}
+
 void FunctionCatalog::AddZetaSQLBuiltInFunctions(
     zetasql::TypeFactory* type_factory) {
   // Get all the ZetaSQL built-in functions.
@@ -34,10 +34,17 @@ namespace backend {
 // A catalog of all SQL functions.
 //
 // The FunctionCatalog supports looking up a function by name and emunerating
-// all existing functions.
+// all existing functions. It is immutable once constructed, and thus
+// thread-safe.
 class FunctionCatalog {
  public:
   explicit FunctionCatalog(zetasql::TypeFactory* type_factory);
+
+  // Returns the catalog shared by all the databases of the process, which is
+  // built on first use. The types of its function signatures are owned by a
+  // type factory which lives for the lifetime of the process.
+  static const FunctionCatalog* Shared();
+
   void GetFunction(const std::string& name,
                    const zetasql::Function** output) const;
   void GetFunctions(
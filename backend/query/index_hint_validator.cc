@@ -71,38 +71,28 @@ bool HasGeneratedEmulatorName(const Index* index) {
 
 }  // namespace
 
-absl::Status IndexHintValidator::VisitResolvedTableScan(
-    const zetasql::ResolvedTableScan* table_scan) {
-  // Visit child nodes first.
-  ZETASQL_RETURN_IF_ERROR(zetasql::ResolvedASTVisitor::DefaultVisit(table_scan));
-
-  std::vector<const zetasql::ResolvedNode*> child_nodes;
-  table_scan->GetChildNodes(&child_nodes);
-
-  for (const zetasql::ResolvedNode* child_node : child_nodes) {
-    if (child_node->node_kind() == zetasql::RESOLVED_OPTION) {
-      const zetasql::ResolvedOption* hint =
-          child_node->GetAs<zetasql::ResolvedOption>();
-      if ((absl::EqualsIgnoreCase(hint->qualifier(), "spanner") ||
-           hint->qualifier().empty()) &&
-          absl::EqualsIgnoreCase(hint->name(), "force_index")) {
-        // We should expect only one hint per table scan as multiple hints per
-        // node is not allowed and would've been rejected by the HintValidator.
-        ZETASQL_RET_CHECK_EQ(hint->value()->node_kind(), zetasql::RESOLVED_LITERAL);
-        const zetasql::Value& value =
-            hint->value()->GetAs<zetasql::ResolvedLiteral>()->value();
-        ZETASQL_RET_CHECK(value.type()->IsString());
-        index_hints_map_[table_scan] = value.string_value();
-        break;
-      }
+absl::Status CollectIndexHint(const zetasql::ResolvedTableScan* table_scan,
+                              IndexHintMap* index_hints) {
+  for (const auto& hint : table_scan->hint_list()) {
+    if ((absl::EqualsIgnoreCase(hint->qualifier(), "spanner") ||
+         hint->qualifier().empty()) &&
+        absl::EqualsIgnoreCase(hint->name(), "force_index")) {
+      // We should expect only one hint per table scan as multiple hints per
+      // node is not allowed and would've been rejected by the HintValidator.
+      ZETASQL_RET_CHECK_EQ(hint->value()->node_kind(), zetasql::RESOLVED_LITERAL);
+      const zetasql::Value& value =
+          hint->value()->GetAs<zetasql::ResolvedLiteral>()->value();
+      ZETASQL_RET_CHECK(value.type()->IsString());
+      (*index_hints)[table_scan] = value.string_value();
+      break;
     }
   }
-
   return absl::OkStatus();
 }
 
-absl::Status IndexHintValidator::ValidateIndexesForTables() {
-  for (auto [table_scan, index_name] : index_hints_map_) {
+absl::Status ValidateIndexHints(const IndexHintMap& index_hints,
+                                bool disable_null_filtered_index_check) {
+  for (auto [table_scan, index_name] : index_hints) {
     if (absl::EqualsIgnoreCase(index_name, "_base_table")) {
       continue;
     }
@@ -120,7 +110,7 @@ absl::Status IndexHintValidator::ValidateIndexesForTables() {
       return error::QueryHintManagedIndexNotSupported(index_name);
     }
 
-    if (index->is_null_filtered() && !disable_null_filtered_index_check_) {
+    if (index->is_null_filtered() && !disable_null_filtered_index_check) {
       for (const auto* key_column : index->key_columns()) {
         const auto* source_column = key_column->column()->source_column();
         // If any of the index's columns are nullable, then it is not indexing
@@ -136,6 +126,18 @@ absl::Status IndexHintValidator::ValidateIndexesForTables() {
   return absl::OkStatus();
 }
 
+absl::Status IndexHintValidator::VisitResolvedTableScan(
+    const zetasql::ResolvedTableScan* table_scan) {
+  // Visit child nodes first.
+  ZETASQL_RETURN_IF_ERROR(zetasql::ResolvedASTVisitor::DefaultVisit(table_scan));
+  return CollectIndexHint(table_scan, &index_hints_map_);
+}
+
+absl::Status IndexHintValidator::ValidateIndexesForTables() {
+  return ValidateIndexHints(index_hints_map_,
+                            disable_null_filtered_index_check_);
+}
+
 absl::Status IndexHintValidator::VisitResolvedQueryStmt(
     const zetasql::ResolvedQueryStmt* stmt) {
   // Visit children first to collect all hints.
@@ -17,6 +17,8 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_INDEX_HINT_VALIDATOR_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_INDEX_HINT_VALIDATOR_H_
 
+#include <string>
+
 #include "zetasql/resolved_ast/resolved_ast.h"
 #include "zetasql/resolved_ast/resolved_ast_visitor.h"
 #include "zetasql/resolved_ast/resolved_node_kind.pb.h"
@@ -29,6 +31,19 @@ namespace spanner {
 namespace emulator {
 namespace backend {
 
+// Index hints specified on table scans, by table scan.
+using IndexHintMap =
+    absl::flat_hash_map<const zetasql::ResolvedTableScan*, std::string>;
+
+// Adds the index hint specified on `table_scan`, if any, to `index_hints`.
+absl::Status CollectIndexHint(const zetasql::ResolvedTableScan* table_scan,
+                              IndexHintMap* index_hints);
+
+// Validates that all the index hints used in a query can be applied to serving
+// the tables they are specified on.
+absl::Status ValidateIndexHints(const IndexHintMap& index_hints,
+                                bool disable_null_filtered_index_check);
+
 // Checks if an index hint specified on a table scan is valid.
 class IndexHintValidator : public zetasql::ResolvedASTVisitor {
  public:
@@ -59,8 +74,7 @@ class IndexHintValidator : public zetasql::ResolvedASTVisitor {
       const zetasql::ResolvedTableScan* scan) final;
 
   // Mapping of table scans to the index hints specified on each.
-  absl::flat_hash_map<const zetasql::ResolvedTableScan*, std::string>
-      index_hints_map_;
+  IndexHintMap index_hints_map_;
 
   // The database schema.
   const Schema* schema_;
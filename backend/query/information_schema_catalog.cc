@@ -16,7 +16,23 @@
 
 #include "backend/query/information_schema_catalog.h"
 
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/evaluator_table_iterator.h"
+#include "zetasql/public/value.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "backend/schema/printer/print_ddl.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
 
 namespace google {
 namespace spanner {
@@ -297,6 +313,120 @@ const IndexColumnsMetaEntry* FindKeyColumnMetadata(
   return m == IndexColumnsMetadata()->end() ? nullptr : &*m;
 }
 
+// An EvaluatorTableIterator over rows generated one described table at a time,
+// so that only the rows of the current table are held in memory. An equality
+// or IN filter on TABLE_NAME set by SetColumnFilterMap() limits the tables
+// whose rows are generated to the ones named.
+class GeneratedRowsIterator : public zetasql::EvaluatorTableIterator {
+ public:
+  using Rows = std::vector<std::vector<zetasql::Value>>;
+
+  // Appends the rows of one described table.
+  using RowSource = std::function<void(Rows*)>;
+
+  // Returns the row sources of the tables named in 'table_names', or of all
+  // tables if 'table_names' is null.
+  using ListSources = std::function<std::vector<RowSource>(
+      const std::vector<std::string>* table_names)>;
+
+  GeneratedRowsIterator(const zetasql::Table* table,
+                        absl::Span<const int> column_idxs,
+                        ListSources list_sources)
+      : table_(table),
+        column_idxs_(column_idxs.begin(), column_idxs.end()),
+        list_sources_(std::move(list_sources)) {}
+
+  int NumColumns() const override { return column_idxs_.size(); }
+
+  std::string GetColumnName(int i) const override {
+    return table_->GetColumn(column_idxs_[i])->Name();
+  }
+
+  const zetasql::Type* GetColumnType(int i) const override {
+    return table_->GetColumn(column_idxs_[i])->GetType();
+  }
+
+  absl::Status SetColumnFilterMap(
+      absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>>
+          filter_map) override {
+    for (const auto& entry : filter_map) {
+      if (GetColumnName(entry.first) != "TABLE_NAME") {
+        continue;
+      }
+      const zetasql::ColumnFilter& filter = *entry.second;
+      std::vector<zetasql::Value> points;
+      if (filter.kind() == zetasql::ColumnFilter::kInList) {
+        points = filter.in_list();
+      } else if (filter.lower_bound().is_valid() &&
+                 filter.upper_bound().is_valid() &&
+                 filter.lower_bound() == filter.upper_bound()) {
+        points.push_back(filter.lower_bound());
+      } else {
+        continue;
+      }
+      std::vector<std::string> table_names;
+      for (const zetasql::Value& point : points) {
+        if (!point.type()->IsString()) {
+          return absl::OkStatus();
+        }
+        if (!point.is_null()) {
+          table_names.push_back(point.string_value());
+        }
+      }
+      table_names_ = std::move(table_names);
+    }
+    return absl::OkStatus();
+  }
+
+  bool NextRow() override {
+    if (!listed_) {
+      sources_ = list_sources_(table_names_.has_value() ? &*table_names_
+                                                        : nullptr);
+      listed_ = true;
+    }
+    ++row_;
+    while (row_ >= rows_.size()) {
+      if (next_source_ == sources_.size()) {
+        return false;
+      }
+      rows_.clear();
+      row_ = 0;
+      sources_[next_source_++](&rows_);
+    }
+    return true;
+  }
+
+  const zetasql::Value& GetValue(int i) const override {
+    return rows_[row_][column_idxs_[i]];
+  }
+
+  absl::Status Status() const override { return absl::OkStatus(); }
+
+  // Cancel is best-effort and not required.
+  absl::Status Cancel() override { return absl::OkStatus(); }
+
+ private:
+  // The table read, which has the columns of the generated rows.
+  const zetasql::Table* table_;
+
+  // The indexes of the table columns read, in the order they are returned.
+  const std::vector<int> column_idxs_;
+
+  const ListSources list_sources_;
+
+  // The tables named by a filter on TABLE_NAME, if any.
+  absl::optional<std::vector<std::string>> table_names_;
+
+  // Whether sources_ has been listed yet, on the first call to NextRow().
+  bool listed_ = false;
+  std::vector<RowSource> sources_;
+  size_t next_source_ = 0;
+
+  // The rows of the table of the last source called, and the current row.
+  Rows rows_;
+  size_t row_ = 0;
+};
+
 template <typename T>
 std::string PrimaryKeyName(const T* table) {
   return absl::StrCat("PK_", table->Name());
@@ -309,8 +439,11 @@ std::string CheckNotNullName(const T* table, const C* column) {
 
 }  // namespace
 
-InformationSchemaCatalog::InformationSchemaCatalog(const Schema* default_schema)
-    : zetasql::SimpleCatalog(kName), default_schema_(default_schema) {
+InformationSchemaCatalog::InformationSchemaCatalog(
+    const Schema* default_schema, InformationSchemaRowsCache* rows_cache)
+    : zetasql::SimpleCatalog(kName),
+      default_schema_(default_schema),
+      rows_cache_(rows_cache) {
   AddSchemataTable();
   auto* tables = AddTablesTable();
   auto* columns = AddColumnsTable();
@@ -322,19 +455,202 @@ InformationSchemaCatalog::InformationSchemaCatalog(const Schema* default_schema)
   auto* referential_constraints = AddReferentialConstraintsTable();
   auto* key_column_usage = AddKeyColumnUsageTable();
   auto* constraint_column_usage = AddConstraintColumnUsageTable();
+  meta_tables_ = this->tables();
+
+  // These tables generate their rows from the schema as they are read.
+  SetRowGenerator(tables, [](const InformationSchemaCatalog* catalog,
+                             const auto* table, Rows* rows) {
+    catalog->AddTablesRows(table, rows);
+  });
+  SetRowGenerator(columns, [](const InformationSchemaCatalog* catalog,
+                              const auto* table, Rows* rows) {
+    catalog->AddColumnsRows(table, rows);
+  });
+  SetRowGenerator(indexes, [](const InformationSchemaCatalog* catalog,
+                              const auto* table, Rows* rows) {
+    catalog->AddIndexesRows(table, rows);
+  });
+  SetRowGenerator(index_columns, [](const InformationSchemaCatalog* catalog,
+                                    const auto* table, Rows* rows) {
+    catalog->AddIndexColumnsRows(table, rows);
+  });
 
   // These tables are populated only after all tables have been added to the
   // catalog (including meta tables) because they add rows based on the tables
-  // in the catalog.
-  FillTablesTable(tables);
-  FillColumnsTable(columns);
-  FillIndexesTable(indexes);
-  FillIndexColumnsTable(index_columns);
-  FillTableConstraintsTable(table_constraints);
-  FillConstraintTableUsageTable(constraint_table_usage);
-  FillReferentialConstraintsTable(referential_constraints);
-  FillKeyColumnUsageTable(key_column_usage);
-  FillConstraintColumnUsageTable(constraint_column_usage);
+  // in the catalog. They are populated on first reference, so that queries
+  // only pay for the tables they use.
+  absl::MutexLock lock(&mu_);
+  unfilled_tables_[table_constraints] = [this, table_constraints] {
+    FillTableConstraintsTable(table_constraints);
+  };
+  unfilled_tables_[constraint_table_usage] = [this, constraint_table_usage] {
+    FillConstraintTableUsageTable(constraint_table_usage);
+  };
+  unfilled_tables_[referential_constraints] = [this, referential_constraints] {
+    FillReferentialConstraintsTable(referential_constraints);
+  };
+  unfilled_tables_[key_column_usage] = [this, key_column_usage] {
+    FillKeyColumnUsageTable(key_column_usage);
+  };
+  unfilled_tables_[constraint_column_usage] = [this, constraint_column_usage] {
+    FillConstraintColumnUsageTable(constraint_column_usage);
+  };
+}
+
+absl::Status InformationSchemaCatalog::GetTable(
+    const std::string& name, const zetasql::Table** table,
+    const FindOptions& options) {
+  ZETASQL_RETURN_IF_ERROR(zetasql::SimpleCatalog::GetTable(name, table, options));
+  if (*table != nullptr) {
+    FillTable(*table);
+  }
+  return absl::OkStatus();
+}
+
+absl::Status InformationSchemaCatalog::GetTables(
+    absl::flat_hash_set<const zetasql::Table*>* output) const {
+  ZETASQL_RETURN_IF_ERROR(zetasql::SimpleCatalog::GetTables(output));
+  for (const zetasql::Table* table : *output) {
+    FillTable(table);
+  }
+  return absl::OkStatus();
+}
+
+std::vector<InformationSchemaCatalog::DescribedTable>
+InformationSchemaCatalog::DescribedTables(
+    const std::vector<std::string>* names) const {
+  std::vector<DescribedTable> described;
+  if (names == nullptr) {
+    for (const Table* table : default_schema_->tables()) {
+      described.push_back(table);
+    }
+    for (const zetasql::Table* table : meta_tables_) {
+      described.push_back(table);
+    }
+    return described;
+  }
+
+  std::vector<std::string> unique_names = *names;
+  std::sort(unique_names.begin(), unique_names.end());
+  unique_names.erase(std::unique(unique_names.begin(), unique_names.end()),
+                     unique_names.end());
+  for (const std::string& name : unique_names) {
+    if (const Table* table = default_schema_->FindTableCaseSensitive(name)) {
+      described.push_back(table);
+    }
+  }
+  for (const zetasql::Table* table : meta_tables_) {
+    if (std::binary_search(unique_names.begin(), unique_names.end(),
+                           table->Name())) {
+      described.push_back(table);
+    }
+  }
+  return described;
+}
+
+template <typename AddRows>
+void InformationSchemaCatalog::SetRowGenerator(zetasql::SimpleTable* table,
+                                               AddRows add_rows) {
+  auto list_sources = [this, add_rows](const std::vector<std::string>* names) {
+    std::vector<GeneratedRowsIterator::RowSource> sources;
+    for (const DescribedTable& described : DescribedTables(names)) {
+      sources.push_back([this, add_rows, described](Rows* rows) {
+        absl::visit(
+            [this, add_rows, rows](const auto* described_table) {
+              add_rows(this, described_table, rows);
+            },
+            described);
+      });
+    }
+    return sources;
+  };
+  table->SetEvaluatorTableIteratorFactory(
+      [table, list_sources](absl::Span<const int> column_idxs)
+          -> zetasql_base::StatusOr<
+              std::unique_ptr<zetasql::EvaluatorTableIterator>> {
+        return absl::make_unique<GeneratedRowsIterator>(table, column_idxs,
+                                                        list_sources);
+      });
+}
+
+void InformationSchemaCatalog::AddUserTableRows(
+    const zetasql::Table* meta_table, const Table* table, Rows* rows,
+    const std::function<Rows()>& generate) const {
+  if (rows_cache_ == nullptr) {
+    Rows generated = generate();
+    rows->insert(rows->end(), std::make_move_iterator(generated.begin()),
+                 std::make_move_iterator(generated.end()));
+    return;
+  }
+  std::shared_ptr<const Rows> cached =
+      rows_cache_->Get(meta_table->Name(), table, generate);
+  rows->insert(rows->end(), cached->begin(), cached->end());
+}
+
+void InformationSchemaCatalog::FillTable(const zetasql::Table* table) const {
+  absl::MutexLock lock(&mu_);
+  auto itr = unfilled_tables_.find(table);
+  if (itr == unfilled_tables_.end()) {
+    return;
+  }
+  itr->second();
+  unfilled_tables_.erase(itr);
+}
+
+std::shared_ptr<const InformationSchemaRowsCache::Rows>
+InformationSchemaRowsCache::Get(const std::string& meta_table,
+                                const Table* table,
+                                const std::function<Rows()>& generate) {
+  {
+    absl::MutexLock lock(&mu_);
+    auto table_itr = rows_.find(table);
+    if (table_itr != rows_.end()) {
+      auto itr = table_itr->second.find(meta_table);
+      if (itr != table_itr->second.end()) {
+        return itr->second;
+      }
+    }
+  }
+  // Generate outside the lock, so that catalogs filling other tables do not
+  // wait. Concurrent callers for the same rows may both generate them.
+  auto rows = std::make_shared<const Rows>(generate());
+  absl::MutexLock lock(&mu_);
+  rows_[table][meta_table] = rows;
+  return rows;
+}
+
+void InformationSchemaRowsCache::Erase(absl::Span<const Table* const> tables) {
+  absl::MutexLock lock(&mu_);
+  for (const Table* table : tables) {
+    rows_.erase(table);
+  }
+}
+
+void InformationSchemaRowsCache::Clear() {
+  absl::MutexLock lock(&mu_);
+  rows_.clear();
+}
+
+std::shared_ptr<InformationSchemaCatalog> InformationSchemaCache::Get(
+    const Schema* schema) {
+  absl::MutexLock lock(&mu_);
+  std::shared_ptr<InformationSchemaCatalog>& catalog = catalogs_[schema];
+  if (catalog == nullptr) {
+    catalog = std::make_shared<InformationSchemaCatalog>(schema, &rows_cache_);
+  }
+  return catalog;
+}
+
+void InformationSchemaCache::Update(const SchemaDiff& diff) {
+  absl::MutexLock lock(&mu_);
+  catalogs_.clear();
+  rows_cache_.Erase(diff.RemovedTables());
+}
+
+void InformationSchemaCache::Clear() {
+  absl::MutexLock lock(&mu_);
+  catalogs_.clear();
+  rows_cache_.Clear();
 }
 
 void InformationSchemaCatalog::AddSchemataTable() {
@@ -367,46 +683,42 @@ zetasql::SimpleTable* InformationSchemaCatalog::AddTablesTable() {
   return tables;
 }
 
-void InformationSchemaCatalog::FillTablesTable(zetasql::SimpleTable* tables) {
-  // Add table rows.
-  std::vector<std::vector<zetasql::Value>> rows;
-  for (const Table* table : default_schema_->tables()) {
-    rows.push_back({
-        // table_catalog
-        String(""),
-        // table_schema
-        String(""),
-        // table_name
-        String(table->Name()),
-        // parent_table_name
-        table->parent() ? String(table->parent()->Name()) : NullString(),
-        // on_delete_action
-        table->parent()
-            ? String(OnDeleteActionToString(table->on_delete_action()))
-            : NullString(),
-        // spanner_state,
-        String("COMMITTED"),
-    });
-  }
-
-  for (const auto& table : this->tables()) {
-    rows.push_back({
-        // table_catalog
-        String(""),
-        // table_schema
-        String(kInformationSchema),
-        // table_name
-        String(table->Name()),
-        // parent_table_name
-        NullString(),
-        // on_delete_action
-        NullString(),
-        // spanner_state,
-        NullString(),
-    });
-  }
+void InformationSchemaCatalog::AddTablesRows(const Table* table,
+                                             Rows* rows) const {
+  rows->push_back({
+      // table_catalog
+      String(""),
+      // table_schema
+      String(""),
+      // table_name
+      String(table->Name()),
+      // parent_table_name
+      table->parent() ? String(table->parent()->Name()) : NullString(),
+      // on_delete_action
+      table->parent()
+          ? String(OnDeleteActionToString(table->on_delete_action()))
+          : NullString(),
+      // spanner_state,
+      String("COMMITTED"),
+  });
+}
 
-  tables->SetContents(rows);
+void InformationSchemaCatalog::AddTablesRows(const zetasql::Table* table,
+                                             Rows* rows) const {
+  rows->push_back({
+      // table_catalog
+      String(""),
+      // table_schema
+      String(kInformationSchema),
+      // table_name
+      String(table->Name()),
+      // parent_table_name
+      NullString(),
+      // on_delete_action
+      NullString(),
+      // spanner_state,
+      NullString(),
+  });
 }
 
 zetasql::SimpleTable* InformationSchemaCatalog::AddColumnsTable() {
@@ -426,72 +738,65 @@ zetasql::SimpleTable* InformationSchemaCatalog::AddColumnsTable() {
   return columns;
 }
 
-void InformationSchemaCatalog::FillColumnsTable(
-    zetasql::SimpleTable* columns) {
-  // Add table rows.
-  std::vector<std::vector<zetasql::Value>> rows;
-  for (const Table* table : default_schema_->tables()) {
-    int pos = 1;
-    for (const Column* column : table->columns()) {
-      rows.push_back({
-          // table_catalog
-          String(""),
-          // table_schema
-          String(""),
-          // table_name
-          String(table->Name()),
-          // column_name
-          String(column->Name()),
-          // ordinal_position
-          Int64(pos++),
-          // column_default,
-          NullBytes(),
-          // data_type,
-          NullString(),
-          // is_nullable
-          String(column->is_nullable() ? "YES" : "NO"),
-          // spanner_type
-          String(ColumnTypeToString(column->GetType(),
-                                    column->declared_max_length())),
-          // spanner_state
-          String("COMMITTED"),
-      });
-    }
+void InformationSchemaCatalog::AddColumnsRows(const Table* table,
+                                              Rows* rows) const {
+  int pos = 1;
+  for (const Column* column : table->columns()) {
+    rows->push_back({
+        // table_catalog
+        String(""),
+        // table_schema
+        String(""),
+        // table_name
+        String(table->Name()),
+        // column_name
+        String(column->Name()),
+        // ordinal_position
+        Int64(pos++),
+        // column_default,
+        NullBytes(),
+        // data_type,
+        NullString(),
+        // is_nullable
+        String(column->is_nullable() ? "YES" : "NO"),
+        // spanner_type
+        String(ColumnTypeToString(column->GetType(),
+                                  column->declared_max_length())),
+        // spanner_state
+        String("COMMITTED"),
+    });
   }
+}
 
-  // Add columns for the tables that live inside INFORMATION_SCHEMA.
-  for (const auto& table : this->tables()) {
-    int pos = 1;
-    for (int i = 0; i < table->NumColumns(); ++i) {
-      const auto* column = table->GetColumn(i);
-      const auto& metadata = GetColumnMetadata(table, column);
-      rows.push_back({
-          // table_catalog
-          String(""),
-          // table_schema
-          String(kInformationSchema),
-          // table_name
-          String(table->Name()),
-          // column_name
-          String(column->Name()),
-          // ordinal_position
-          Int64(pos++),
-          // column_default,
-          NullBytes(),
-          // data_type,
-          NullString(),
-          // is_nullable
-          String(metadata.is_nullable),
-          // spanner_type
-          String(metadata.spanner_type),
-          // spanner_state
-          NullString(),
-      });
-    }
+void InformationSchemaCatalog::AddColumnsRows(const zetasql::Table* table,
+                                              Rows* rows) const {
+  int pos = 1;
+  for (int i = 0; i < table->NumColumns(); ++i) {
+    const auto* column = table->GetColumn(i);
+    const auto& metadata = GetColumnMetadata(table, column);
+    rows->push_back({
+        // table_catalog
+        String(""),
+        // table_schema
+        String(kInformationSchema),
+        // table_name
+        String(table->Name()),
+        // column_name
+        String(column->Name()),
+        // ordinal_position
+        Int64(pos++),
+        // column_default,
+        NullBytes(),
+        // data_type,
+        NullString(),
+        // is_nullable
+        String(metadata.is_nullable),
+        // spanner_type
+        String(metadata.spanner_type),
+        // spanner_state
+        NullString(),
+    });
   }
-
-  // Add table to catalog.
-  columns->SetContents(rows);
 }
 
 zetasql::SimpleTable* InformationSchemaCatalog::AddIndexesTable() {
@@ -513,39 +818,11 @@ zetasql::SimpleTable* InformationSchemaCatalog::AddIndexesTable() {
   return indexes;
 }
 
-void InformationSchemaCatalog::FillIndexesTable(
-    zetasql::SimpleTable* indexes) {
-  // Add table rows.
-  std::vector<std::vector<zetasql::Value>> rows;
-  for (const Table* table : default_schema_->tables()) {
-    // Add normal indexes.
-    for (const Index* index : table->indexes()) {
-      rows.push_back({
-          // table_catalog
-          String(""),
-          // table_schema
-          String(""),
-          // table_name
-          String(table->Name()),
-          // index_name
-          String(index->Name()),
-          // index_type
-          String("INDEX"),
-          // parent_table_name
-          String(index->parent() ? index->parent()->Name() : ""),
-          // is_unique
-          Bool(index->is_unique()),
-          // is_null_filtered
-          Bool(index->is_null_filtered()),
-          // index_state
-          String("READ_WRITE"),
-          // spanner_is_managed
-          Bool(index->is_managed()),
-      });
-    }
-
-    // Add the primary key index.
-    rows.push_back({
+void InformationSchemaCatalog::AddIndexesRows(const Table* table,
+                                              Rows* rows) const {
+  // Add normal indexes.
+  for (const Index* index : table->indexes()) {
+    rows->push_back({
         // table_catalog
         String(""),
         // table_schema
@@ -553,50 +830,71 @@ void InformationSchemaCatalog::FillIndexesTable(
         // table_name
         String(table->Name()),
         // index_name
-        String("PRIMARY_KEY"),
+        String(index->Name()),
         // index_type
-        String("PRIMARY_KEY"),
+        String("INDEX"),
         // parent_table_name
-        String(""),
+        String(index->parent() ? index->parent()->Name() : ""),
         // is_unique
-        Bool(true),
+        Bool(index->is_unique()),
         // is_null_filtered
-        Bool(false),
+        Bool(index->is_null_filtered()),
         // index_state
-        NullString(),
+        String("READ_WRITE"),
         // spanner_is_managed
-        Bool(false),
+        Bool(index->is_managed()),
     });
   }
 
-  // Add the primary key index for tables that live in INFORMATION_SCHEMA.
-  for (const auto& table : this->tables()) {
-    rows.push_back({
-        // table_catalog
-        String(""),
-        // table_schema
-        String(kInformationSchema),
-        // table_name
-        String(table->Name()),
-        // index_name
-        String("PRIMARY_KEY"),
-        // index_type
-        String("PRIMARY_KEY"),
-        // parent_table_name
-        String(""),
-        // is_unique
-        Bool(true),
-        // is_null_filtered
-        Bool(false),
-        // index_state
-        NullString(),
-        // spanner_is_managed
-        Bool(false),
-    });
-  }
+  // Add the primary key index.
+  rows->push_back({
+      // table_catalog
+      String(""),
+      // table_schema
+      String(""),
+      // table_name
+      String(table->Name()),
+      // index_name
+      String("PRIMARY_KEY"),
+      // index_type
+      String("PRIMARY_KEY"),
+      // parent_table_name
+      String(""),
+      // is_unique
+      Bool(true),
+      // is_null_filtered
+      Bool(false),
+      // index_state
+      NullString(),
+      // spanner_is_managed
+      Bool(false),
+  });
+}
 
-  // Add table to catalog.
-  indexes->SetContents(rows);
+void InformationSchemaCatalog::AddIndexesRows(const zetasql::Table* table,
+                                              Rows* rows) const {
+  rows->push_back({
+      // table_catalog
+      String(""),
+      // table_schema
+      String(kInformationSchema),
+      // table_name
+      String(table->Name()),
+      // index_name
+      String("PRIMARY_KEY"),
+      // index_type
+      String("PRIMARY_KEY"),
+      // parent_table_name
+      String(""),
+      // is_unique
+      Bool(true),
+      // is_null_filtered
+      Bool(false),
+      // index_state
+      NullString(),
+      // spanner_is_managed
+      Bool(false),
+  });
 }
 
 zetasql::SimpleTable* InformationSchemaCatalog::AddIndexColumnsTable() {
@@ -620,119 +918,79 @@ zetasql::SimpleTable* InformationSchemaCatalog::AddIndexColumnsTable() {
   return index_columns;
 }
 
-void InformationSchemaCatalog::FillIndexColumnsTable(
-    zetasql::SimpleTable* index_columns) {
-  // Add table rows.
-  std::vector<std::vector<zetasql::Value>> rows;
-  for (const Table* table : default_schema_->tables()) {
-    // Add normal indexes.
-    for (const Index* index : table->indexes()) {
-      int pos = 1;
-      // Add key columns.
-      for (const KeyColumn* key_column : index->key_columns()) {
-        rows.push_back({
-            // table_catalog
-            String(""),
-            // table_schema
-            String(""),
-            // table_name
-            String(table->Name()),
-            // index_name
-            String(index->Name()),
-            // index_type
-            String("INDEX"),
-            // column_name
-            String(key_column->column()->Name()),
-            // ordinal_position
-            Int64(pos++),
-            // column_ordering
-            String(key_column->is_descending() ? "DESC" : "ASC"),
-            // is_nullable
-            String(key_column->column()->is_nullable() &&
-                           !index->is_null_filtered()
-                       ? "YES"
-                       : "NO"),
-            // spanner_type
-            String(ColumnTypeToString(
-                key_column->column()->GetType(),
-                key_column->column()->declared_max_length())),
-        });
-      }
-
-      // Add storing columns.
-      for (const Column* column : index->stored_columns()) {
-        rows.push_back({
-            // table_catalog
-            String(""),
-            // table_schema
-            String(""),
-            // table_name
-            String(table->Name()),
-            // index_name
-            String(index->Name()),
-            // index_type
-            String("INDEX"),
-            // column_name
-            String(column->Name()),
-            // ordinal_position
-            NullInt64(),
-            // column_ordering
-            NullString(),
-            // is_nullable
-            String(column->is_nullable() ? "YES" : "NO"),
-            // spanner_type
-            String(ColumnTypeToString(column->GetType(),
-                                      column->declared_max_length())),
-        });
-      }
+void InformationSchemaCatalog::AddIndexColumnsRows(const Table* table,
+                                                   Rows* rows) const {
+  // Add normal indexes.
+  for (const Index* index : table->indexes()) {
+    int pos = 1;
+    // Add key columns.
+    for (const KeyColumn* key_column : index->key_columns()) {
+      rows->push_back({
+          // table_catalog
+          String(""),
+          // table_schema
+          String(""),
+          // table_name
+          String(table->Name()),
+          // index_name
+          String(index->Name()),
+          // index_type
+          String("INDEX"),
+          // column_name
+          String(key_column->column()->Name()),
+          // ordinal_position
+          Int64(pos++),
+          // column_ordering
+          String(key_column->is_descending() ? "DESC" : "ASC"),
+          // is_nullable
+          String(key_column->column()->is_nullable() &&
+                         !index->is_null_filtered()
+                     ? "YES"
+                     : "NO"),
+          // spanner_type
+          String(ColumnTypeToString(
+              key_column->column()->GetType(),
+              key_column->column()->declared_max_length())),
+      });
     }
 
-    // Add the primary key columns.
-    {
-      int pos = 1;
-      for (const KeyColumn* key_column : table->primary_key()) {
-        rows.push_back({
-            // table_catalog
-            String(""),
-            // table_schema
-            String(""),
-            // table_name
-            String(table->Name()),
-            // index_name
-            String("PRIMARY_KEY"),
-            // index_type
-            String("PRIMARY_KEY"),
-            // column_name
-            String(key_column->column()->Name()),
-            // ordinal_position
-            Int64(pos++),
-            // column_ordering
-            String(key_column->is_descending() ? "DESC" : "ASC"),
-            // is_nullable
-            String(key_column->column()->is_nullable() ? "YES" : "NO"),
-            // spanner_type
-            String(ColumnTypeToString(
-                key_column->column()->GetType(),
-                key_column->column()->declared_max_length())),
-        });
-      }
+    // Add storing columns.
+    for (const Column* column : index->stored_columns()) {
+      rows->push_back({
+          // table_catalog
+          String(""),
+          // table_schema
+          String(""),
+          // table_name
+          String(table->Name()),
+          // index_name
+          String(index->Name()),
+          // index_type
+          String("INDEX"),
+          // column_name
+          String(column->Name()),
+          // ordinal_position
+          NullInt64(),
+          // column_ordering
+          NullString(),
+          // is_nullable
+          String(column->is_nullable() ? "YES" : "NO"),
+          // spanner_type
+          String(ColumnTypeToString(column->GetType(),
+                                    column->declared_max_length())),
+      });
     }
   }
 
-  // Add the information schema primary key columns.
-  for (const auto& table : this->tables()) {
-    int primary_key_ordinal = 1;
-    for (int i = 0; i < table->NumColumns(); ++i) {
-      const auto* column = table->GetColumn(i);
-      const auto* metadata = FindKeyColumnMetadata(table, column);
-      if (metadata == nullptr) {
-        continue;  // Not a primary key column.
-      }
-      rows.push_back({
+  // Add the primary key columns.
+  {
+    int pos = 1;
+    for (const KeyColumn* key_column : table->primary_key()) {
+      rows->push_back({
           // table_catalog
           String(""),
           // table_schema
-          String(kInformationSchema),
+          String(""),
           // table_name
           String(table->Name()),
           // index_name
@@ -740,22 +998,56 @@ void InformationSchemaCatalog::FillIndexColumnsTable(
           // index_type
           String("PRIMARY_KEY"),
           // column_name
-          String(column->Name()),
+          String(key_column->column()->Name()),
           // ordinal_position
-          Int64(metadata->primary_key_ordinal > 0
-                    ? metadata->primary_key_ordinal
-                    : primary_key_ordinal++),
+          Int64(pos++),
           // column_ordering
-          String(metadata->column_ordering),
+          String(key_column->is_descending() ? "DESC" : "ASC"),
           // is_nullable
-          String(metadata->is_nullable),
+          String(key_column->column()->is_nullable() ? "YES" : "NO"),
           // spanner_type
-          String(metadata->spanner_type),
+          String(ColumnTypeToString(
+              key_column->column()->GetType(),
+              key_column->column()->declared_max_length())),
       });
     }
   }
+}
 
-  index_columns->SetContents(rows);
+void InformationSchemaCatalog::AddIndexColumnsRows(const zetasql::Table* table,
+                                                   Rows* rows) const {
+  int primary_key_ordinal = 1;
+  for (int i = 0; i < table->NumColumns(); ++i) {
+    const auto* column = table->GetColumn(i);
+    const auto* metadata = FindKeyColumnMetadata(table, column);
+    if (metadata == nullptr) {
+      continue;  // Not a primary key column.
+    }
+    rows->push_back({
+        // table_catalog
+        String(""),
+        // table_schema
+        String(kInformationSchema),
+        // table_name
+        String(table->Name()),
+        // index_name
+        String("PRIMARY_KEY"),
+        // index_type
+        String("PRIMARY_KEY"),
+        // column_name
+        String(column->Name()),
+        // ordinal_position
+        Int64(metadata->primary_key_ordinal > 0
+                  ? metadata->primary_key_ordinal
+                  : primary_key_ordinal++),
+        // column_ordering
+        String(metadata->column_ordering),
+        // is_nullable
+        String(metadata->is_nullable),
+        // spanner_type
+        String(metadata->spanner_type),
+    });
+  }
 }
 
 void InformationSchemaCatalog::AddColumnOptionsTable() {
@@ -822,100 +1114,24 @@ void InformationSchemaCatalog::FillTableConstraintsTable(
 
   // Add the user table constraints.
   for (const auto* table : default_schema_->tables()) {
-    // Add the primary key.
-    rows.push_back({
-        // constraint_catalog
-        String(""),
-        // constraint_schema
-        String(""),
-        // constraint_name
-        String(PrimaryKeyName(table)),
-        // table_catalog
-        String(""),
-        // table_schema
-        String(""),
-        // table_name
-        String(table->Name()),
-        // constraint_type,
-        String("PRIMARY KEY"),
-        // is_deferrable,
-        String("NO"),
-        // initially_deferred,
-        String("NO"),
-        // enforced,
-        String("YES"),
-    });
-
-    // Add the NOT NULL check constraints.
-    for (const auto* column : table->columns()) {
-      if (column->is_nullable()) {
-        continue;
-      }
-      rows.push_back({
-          // constraint_catalog
-          String(""),
-          // constraint_schema
-          String(""),
-          // constraint_name
-          String(CheckNotNullName(table, column)),
-          // table_catalog
-          String(""),
-          // table_schema
-          String(""),
-          // table_name
-          String(table->Name()),
-          // constraint_type,
-          String("CHECK"),
-          // is_deferrable,
-          String("NO"),
-          // initially_deferred,
-          String("NO"),
-          // enforced,
-          String("YES"),
-      });
-    }
-
-    // Add the foreign keys.
-    for (const auto* foreign_key : table->foreign_keys()) {
-      rows.push_back({
+    AddUserTableRows(table_constraints, table, &rows, [&] {
+      Rows table_rows;
+      // Add the primary key.
+      table_rows.push_back({
           // constraint_catalog
           String(""),
           // constraint_schema
           String(""),
           // constraint_name
-          String(foreign_key->Name()),
-          // table_catalog
-          String(""),
-          // table_schema
-          String(""),
-          // table_name
-          String(table->Name()),
-          // constraint_type,
-          String("FOREIGN KEY"),
-          // is_deferrable,
-          String("NO"),
-          // initially_deferred,
-          String("NO"),
-          // enforced,
-          String("YES"),
-      });
-
-      // Add the foreign key's unique backing index as a unique constraint.
-      rows.push_back({
-          // constraint_catalog
-          String(""),
-          // constraint_schema
-          String(""),
-          // constraint_name
-          String(foreign_key->referenced_index()->Name()),
+          String(PrimaryKeyName(table)),
           // table_catalog
           String(""),
           // table_schema
           String(""),
           // table_name
-          String(foreign_key->referenced_table()->Name()),
+          String(table->Name()),
           // constraint_type,
-          String("UNIQUE"),
+          String("PRIMARY KEY"),
           // is_deferrable,
           String("NO"),
           // initially_deferred,
@@ -923,7 +1139,87 @@ void InformationSchemaCatalog::FillTableConstraintsTable(
           // enforced,
           String("YES"),
       });
-    }
+
+      // Add the NOT NULL check constraints.
+      for (const auto* column : table->columns()) {
+        if (column->is_nullable()) {
+          continue;
+        }
+        table_rows.push_back({
+            // constraint_catalog
+            String(""),
+            // constraint_schema
+            String(""),
+            // constraint_name
+            String(CheckNotNullName(table, column)),
+            // table_catalog
+            String(""),
+            // table_schema
+            String(""),
+            // table_name
+            String(table->Name()),
+            // constraint_type,
+            String("CHECK"),
+            // is_deferrable,
+            String("NO"),
+            // initially_deferred,
+            String("NO"),
+            // enforced,
+            String("YES"),
+        });
+      }
+
+      // Add the foreign keys.
+      for (const auto* foreign_key : table->foreign_keys()) {
+        table_rows.push_back({
+            // constraint_catalog
+            String(""),
+            // constraint_schema
+            String(""),
+            // constraint_name
+            String(foreign_key->Name()),
+            // table_catalog
+            String(""),
+            // table_schema
+            String(""),
+            // table_name
+            String(table->Name()),
+            // constraint_type,
+            String("FOREIGN KEY"),
+            // is_deferrable,
+            String("NO"),
+            // initially_deferred,
+            String("NO"),
+            // enforced,
+            String("YES"),
+        });
+
+        // Add the foreign key's unique backing index as a unique constraint.
+        table_rows.push_back({
+            // constraint_catalog
+            String(""),
+            // constraint_schema
+            String(""),
+            // constraint_name
+            String(foreign_key->referenced_index()->Name()),
+            // table_catalog
+            String(""),
+            // table_schema
+            String(""),
+            // table_name
+            String(foreign_key->referenced_table()->Name()),
+            // constraint_type,
+            String("UNIQUE"),
+            // is_deferrable,
+            String("NO"),
+            // initially_deferred,
+            String("NO"),
+            // enforced,
+            String("YES"),
+        });
+      }
+      return table_rows;
+    });
   }
 
   // Add the information schema constraints.
@@ -1011,28 +1307,10 @@ void InformationSchemaCatalog::FillConstraintTableUsageTable(
 
   // Add the user table constraints.
   for (const auto* table : default_schema_->tables()) {
-    // Add the primary key.
-    rows.push_back({
-        // table_catalog
-        String(""),
-        // table_schema
-        String(""),
-        // table_name
-        String(table->Name()),
-        // constraint_catalog
-        String(""),
-        // constraint_schema
-        String(""),
-        // constraint_name
-        String(PrimaryKeyName(table)),
-    });
-
-    // Add the NOT NULL check constraints.
-    for (const auto* column : table->columns()) {
-      if (column->is_nullable()) {
-        continue;
-      }
-      rows.push_back({
+    AddUserTableRows(constraint_table_usage, table, &rows, [&] {
+      Rows table_rows;
+      // Add the primary key.
+      table_rows.push_back({
           // table_catalog
           String(""),
           // table_schema
@@ -1044,43 +1322,65 @@ void InformationSchemaCatalog::FillConstraintTableUsageTable(
           // constraint_schema
           String(""),
           // constraint_name
-          String(CheckNotNullName(table, column)),
+          String(PrimaryKeyName(table)),
       });
-    }
 
-    // Add the foreign keys.
-    for (const auto* foreign_key : table->foreign_keys()) {
-      rows.push_back({
-          // table_catalog
-          String(""),
-          // table_schema
-          String(""),
-          // table_name
-          String(foreign_key->referenced_table()->Name()),
-          // constraint_catalog
-          String(""),
-          // constraint_schema
-          String(""),
-          // constraint_name
-          String(foreign_key->Name()),
-      });
+      // Add the NOT NULL check constraints.
+      for (const auto* column : table->columns()) {
+        if (column->is_nullable()) {
+          continue;
+        }
+        table_rows.push_back({
+            // table_catalog
+            String(""),
+            // table_schema
+            String(""),
+            // table_name
+            String(table->Name()),
+            // constraint_catalog
+            String(""),
+            // constraint_schema
+            String(""),
+            // constraint_name
+            String(CheckNotNullName(table, column)),
+        });
+      }
 
-      // Add the foreign key's unique backing index as a unique constraint.
-      rows.push_back({
-          // table_catalog
-          String(""),
-          // table_schema
-          String(""),
-          // table_name
-          String(foreign_key->referenced_table()->Name()),
-          // constraint_catalog
-          String(""),
-          // constraint_schema
-          String(""),
-          // constraint_name
-          String(foreign_key->referenced_index()->Name()),
-      });
-    }
+      // Add the foreign keys.
+      for (const auto* foreign_key : table->foreign_keys()) {
+        table_rows.push_back({
+            // table_catalog
+            String(""),
+            // table_schema
+            String(""),
+            // table_name
+            String(foreign_key->referenced_table()->Name()),
+            // constraint_catalog
+            String(""),
+            // constraint_schema
+            String(""),
+            // constraint_name
+            String(foreign_key->Name()),
+        });
+
+        // Add the foreign key's unique backing index as a unique constraint.
+        table_rows.push_back({
+            // table_catalog
+            String(""),
+            // table_schema
+            String(""),
+            // table_name
+            String(foreign_key->referenced_table()->Name()),
+            // constraint_catalog
+            String(""),
+            // constraint_schema
+            String(""),
+            // constraint_name
+            String(foreign_key->referenced_index()->Name()),
+        });
+      }
+      return table_rows;
+    });
   }
 
   // Add the information schema constraints.
@@ -1157,30 +1457,34 @@ void InformationSchemaCatalog::FillReferentialConstraintsTable(
 
   // Add the foreign key constraints.
   for (const auto* table : default_schema_->tables()) {
-    for (const auto* foreign_key : table->foreign_keys()) {
-      rows.push_back({
-          // constraint_catalog
-          String(""),
-          // constraint_schema
-          String(""),
-          // constraint_name
-          String(foreign_key->Name()),
-          // unique_constraint_catalog
-          String(""),
-          // unique_constraint_schema
-          String(""),
-          // unique_constraint_name
-          String(foreign_key->referenced_index()->Name()),
-          // match_option
-          String("SIMPLE"),
-          // update_rule
-          String("NO ACTION"),
-          // delete_rule
-          String("NO ACTION"),
-          // spanner_state
-          String("COMMITTED"),
-      });
-    }
+    AddUserTableRows(referential_constraints, table, &rows, [&] {
+      Rows table_rows;
+      for (const auto* foreign_key : table->foreign_keys()) {
+        table_rows.push_back({
+            // constraint_catalog
+            String(""),
+            // constraint_schema
+            String(""),
+            // constraint_name
+            String(foreign_key->Name()),
+            // unique_constraint_catalog
+            String(""),
+            // unique_constraint_schema
+            String(""),
+            // unique_constraint_name
+            String(foreign_key->referenced_index()->Name()),
+            // match_option
+            String("SIMPLE"),
+            // update_rule
+            String("NO ACTION"),
+            // delete_rule
+            String("NO ACTION"),
+            // spanner_state
+            String("COMMITTED"),
+        });
+      }
+      return table_rows;
+    });
   }
 
   referential_constraints->SetContents(rows);
@@ -1211,43 +1515,18 @@ void InformationSchemaCatalog::FillKeyColumnUsageTable(
   std::vector<std::vector<zetasql::Value>> rows;
 
   for (const auto* table : default_schema_->tables()) {
-    // Add the primary key columns.
-    int table_ordinal = 1;
-    for (const auto* key_column : table->primary_key()) {
-      rows.push_back({
-          // constraint_catalog
-          String(""),
-          // constraint_schema
-          String(""),
-          // constraint_name
-          String(PrimaryKeyName(table)),
-          // table_catalog
-          String(""),
-          // table_schema
-          String(""),
-          // table_name
-          String(table->Name()),
-          // column_name
-          String(key_column->column()->Name()),
-          // ordinal_position
-          Int64(table_ordinal++),
-          // position_in_unique_constraint
-          NullString(),
-      });
-    }
-
-    // Add the foreign keys.
-    for (const auto* foreign_key : table->foreign_keys()) {
-      // Add the foreign key referencing columns.
-      int foreign_key_ordinal = 1;
-      for (const auto* column : foreign_key->referencing_columns()) {
-        rows.push_back({
+    AddUserTableRows(key_column_usage, table, &rows, [&] {
+      Rows table_rows;
+      // Add the primary key columns.
+      int table_ordinal = 1;
+      for (const auto* key_column : table->primary_key()) {
+        table_rows.push_back({
             // constraint_catalog
             String(""),
             // constraint_schema
             String(""),
             // constraint_name
-            String(foreign_key->Name()),
+            String(PrimaryKeyName(table)),
             // table_catalog
             String(""),
             // table_schema
@@ -1255,41 +1534,70 @@ void InformationSchemaCatalog::FillKeyColumnUsageTable(
             // table_name
             String(table->Name()),
             // column_name
-            String(column->Name()),
-            // ordinal_position
-            Int64(foreign_key_ordinal),
-            // position_in_unique_constraint
-            Int64(foreign_key_ordinal),
-        });
-        ++foreign_key_ordinal;
-      }
-
-      // Add the foreign key's unique backing index columns.
-      int index_ordinal = 1;
-      for (const auto* key_column :
-           foreign_key->referenced_index()->key_columns()) {
-        rows.push_back({
-            // constraint_catalog
-            String(""),
-            // constraint_schema
-            String(""),
-            // constraint_name
-            String(foreign_key->referenced_index()->Name()),
-            // table_catalog
-            String(""),
-            // table_schema
-            String(""),
-            // table_name
-            String(foreign_key->referenced_table()->Name()),
-            // column_name
             String(key_column->column()->Name()),
             // ordinal_position
-            Int64(index_ordinal++),
+            Int64(table_ordinal++),
             // position_in_unique_constraint
             NullString(),
         });
       }
-    }
+
+      // Add the foreign keys.
+      for (const auto* foreign_key : table->foreign_keys()) {
+        // Add the foreign key referencing columns.
+        int foreign_key_ordinal = 1;
+        for (const auto* column : foreign_key->referencing_columns()) {
+          table_rows.push_back({
+              // constraint_catalog
+              String(""),
+              // constraint_schema
+              String(""),
+              // constraint_name
+              String(foreign_key->Name()),
+              // table_catalog
+              String(""),
+              // table_schema
+              String(""),
+              // table_name
+              String(table->Name()),
+              // column_name
+              String(column->Name()),
+              // ordinal_position
+              Int64(foreign_key_ordinal),
+              // position_in_unique_constraint
+              Int64(foreign_key_ordinal),
+          });
+          ++foreign_key_ordinal;
+        }
+
+        // Add the foreign key's unique backing index columns.
+        int index_ordinal = 1;
+        for (const auto* key_column :
+             foreign_key->referenced_index()->key_columns()) {
+          table_rows.push_back({
+              // constraint_catalog
+              String(""),
+              // constraint_schema
+              String(""),
+              // constraint_name
+              String(foreign_key->referenced_index()->Name()),
+              // table_catalog
+              String(""),
+              // table_schema
+              String(""),
+              // table_name
+              String(foreign_key->referenced_table()->Name()),
+              // column_name
+              String(key_column->column()->Name()),
+              // ordinal_position
+              Int64(index_ordinal++),
+              // position_in_unique_constraint
+              NullString(),
+          });
+        }
+      }
+      return table_rows;
+    });
   }
 
   // Add the information schema primary key columns.
@@ -1353,92 +1661,96 @@ void InformationSchemaCatalog::FillConstraintColumnUsageTable(
   std::vector<std::vector<zetasql::Value>> rows;
 
   for (const auto* table : default_schema_->tables()) {
-    // Add the primary key columns.
-    for (const auto* key_column : table->primary_key()) {
-      rows.push_back({
-          // table_catalog
-          String(""),
-          // table_schema
-          String(""),
-          // table_name
-          String(table->Name()),
-          // column_name
-          String(key_column->column()->Name()),
-          // constraint_catalog
-          String(""),
-          // constraint_schema
-          String(""),
-          // constraint_name
-          String(PrimaryKeyName(table)),
-      });
-    }
-
-    // Add the NOT NULL check constraints.
-    for (const auto* column : table->columns()) {
-      if (column->is_nullable()) {
-        continue;
-      }
-      rows.push_back({
-          // table_catalog
-          String(""),
-          // table_schema
-          String(""),
-          // table_name
-          String(table->Name()),
-          // column_name
-          String(column->Name()),
-          // constraint_catalog
-          String(""),
-          // constraint_schema
-          String(""),
-          // constraint_name
-          String(CheckNotNullName(table, column)),
-      });
-    }
-
-    // Add the foreign keys.
-    for (const auto* foreign_key : table->foreign_keys()) {
-      // Add the foreign key referenced columns.
-      for (const auto* column : foreign_key->referenced_columns()) {
-        rows.push_back({
+    AddUserTableRows(constraint_column_usage, table, &rows, [&] {
+      Rows table_rows;
+      // Add the primary key columns.
+      for (const auto* key_column : table->primary_key()) {
+        table_rows.push_back({
             // table_catalog
             String(""),
             // table_schema
             String(""),
             // table_name
-            String(foreign_key->referenced_table()->Name()),
+            String(table->Name()),
             // column_name
-            String(column->Name()),
+            String(key_column->column()->Name()),
             // constraint_catalog
             String(""),
             // constraint_schema
             String(""),
             // constraint_name
-            String(foreign_key->Name()),
+            String(PrimaryKeyName(table)),
         });
       }
 
-      // Add the foreign key's unique backing index columns.
-      for (const auto* key_column :
-           foreign_key->referenced_index()->key_columns()) {
-        rows.push_back({
+      // Add the NOT NULL check constraints.
+      for (const auto* column : table->columns()) {
+        if (column->is_nullable()) {
+          continue;
+        }
+        table_rows.push_back({
             // table_catalog
             String(""),
             // table_schema
             String(""),
             // table_name
-            String(foreign_key->referenced_table()->Name()),
+            String(table->Name()),
             // column_name
-            String(key_column->column()->Name()),
+            String(column->Name()),
             // constraint_catalog
             String(""),
             // constraint_schema
             String(""),
             // constraint_name
-            String(foreign_key->referenced_index()->Name()),
+            String(CheckNotNullName(table, column)),
         });
       }
-    }
+
+      // Add the foreign keys.
+      for (const auto* foreign_key : table->foreign_keys()) {
+        // Add the foreign key referenced columns.
+        for (const auto* column : foreign_key->referenced_columns()) {
+          table_rows.push_back({
+              // table_catalog
+              String(""),
+              // table_schema
+              String(""),
+              // table_name
+              String(foreign_key->referenced_table()->Name()),
+              // column_name
+              String(column->Name()),
+              // constraint_catalog
+              String(""),
+              // constraint_schema
+              String(""),
+              // constraint_name
+              String(foreign_key->Name()),
+          });
+        }
+
+        // Add the foreign key's unique backing index columns.
+        for (const auto* key_column :
+             foreign_key->referenced_index()->key_columns()) {
+          table_rows.push_back({
+              // table_catalog
+              String(""),
+              // table_schema
+              String(""),
+              // table_name
+              String(foreign_key->referenced_table()->Name()),
+              // column_name
+              String(key_column->column()->Name()),
+              // constraint_catalog
+              String(""),
+              // constraint_schema
+              String(""),
+              // constraint_name
+              String(foreign_key->referenced_index()->Name()),
+          });
+        }
+      }
+      return table_rows;
+    });
   }
 
   // Add the information schema primary key columns.
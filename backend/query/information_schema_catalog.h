@@ -17,19 +17,64 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_INFORMATION_SCHEMA_CATALOG_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_INFORMATION_SCHEMA_CATALOG_H_
 
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "zetasql/public/simple_catalog.h"
+#include "zetasql/public/value.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "absl/types/variant.h"
 #include "backend/schema/catalog/schema.h"
+#include "backend/schema/catalog/schema_diff.h"
+#include "absl/status/status.h"
 
 namespace google {
 namespace spanner {
 namespace emulator {
 namespace backend {
 
+// InformationSchemaRowsCache holds the rows which the materialized
+// information schema tables have for each user table, so that the catalogs of
+// successive schema versions only generate the rows of the tables which
+// differ between them. Tables are keyed by identity, since schema versions
+// share the tables a schema change did not touch.
+//
+// This class is thread-safe.
+class InformationSchemaRowsCache {
+ public:
+  using Rows = std::vector<std::vector<zetasql::Value>>;
+
+  // Returns the rows of information schema table 'meta_table' for user table
+  // 'table', calling 'generate' to create them if they are not cached.
+  std::shared_ptr<const Rows> Get(const std::string& meta_table,
+                                  const Table* table,
+                                  const std::function<Rows()>& generate)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Discards the rows of 'tables'.
+  void Erase(absl::Span<const Table* const> tables) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Discards all cached rows.
+  void Clear() ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  absl::Mutex mu_;
+
+  // The rows of each user table, keyed by the name of the information schema
+  // table they belong to.
+  absl::flat_hash_map<
+      const Table*,
+      absl::flat_hash_map<std::string, std::shared_ptr<const Rows>>>
+      rows_ ABSL_GUARDED_BY(mu_);
+};
+
 // InformationSchemaCatalog provides the INFORMATION_SCHEMA tables.
 //
 // ZetaSQL reference implementation accesses table data via the catalog objects
@@ -43,29 +88,91 @@ namespace backend {
 // In production, in addition to the default schema, INFORMATION_SCHEMA and
 // SPANNER_SYS schemas are also exposed.
 //
+// TABLES, COLUMNS, INDEXES and INDEX_COLUMNS are not materialized: their rows
+// are generated from the schema as they are read, and a filter on TABLE_NAME
+// pushed down by ZetaSQL limits the rows generated to the tables named. The
+// other tables are populated on first reference, from the rows of each user
+// table held by 'rows_cache' if one is given.
+//
 // This class is tested via tests/conformance/cases/information_schema.cc
 class InformationSchemaCatalog : public zetasql::SimpleCatalog {
  public:
   static constexpr char kName[] = "INFORMATION_SCHEMA";
 
-  explicit InformationSchemaCatalog(const Schema* default_schema);
+  explicit InformationSchemaCatalog(
+      const Schema* default_schema,
+      InformationSchemaRowsCache* rows_cache = nullptr);
+
+  // Implementation of the zetasql::Catalog interface. Populates the
+  // returned table on first reference.
+  absl::Status GetTable(const std::string& name, const zetasql::Table** table,
+                        const FindOptions& options) override;
+
+  // Implementation of the zetasql::EnumerableCatalog interface. Populates
+  // all the tables.
+  absl::Status GetTables(
+      absl::flat_hash_set<const zetasql::Table*>* output) const override;
 
  private:
   const Schema* default_schema_;
 
+  // Rows of the user tables shared with the catalogs of other schema
+  // versions, if not null.
+  InformationSchemaRowsCache* rows_cache_;
+
+  using Rows = InformationSchemaRowsCache::Rows;
+
+  // A table described by the information schema: either a user table or one
+  // of the information schema tables themselves.
+  using DescribedTable = absl::variant<const Table*, const zetasql::Table*>;
+
+  // Returns the tables described by the information schema, user tables
+  // first. If 'names' is not null, returns only the tables with those names.
+  std::vector<DescribedTable> DescribedTables(
+      const std::vector<std::string>* names) const;
+
+  // Makes 'table' generate its rows on read by calling 'add_rows' for each
+  // described table.
+  template <typename AddRows>
+  void SetRowGenerator(zetasql::SimpleTable* table, AddRows add_rows);
+
+  // Appends to 'rows' the rows of 'meta_table' for user table 'table', which
+  // 'generate' returns, unless the rows cache already holds them.
+  void AddUserTableRows(const zetasql::Table* meta_table, const Table* table,
+                        Rows* rows,
+                        const std::function<Rows()>& generate) const;
+
+  // Populates 'table' if it has not been populated yet.
+  void FillTable(const zetasql::Table* table) const ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Guards the tables that have not been populated yet.
+  mutable absl::Mutex mu_;
+
+  // Tables that have not been populated yet, along with the function
+  // populating each of them.
+  mutable absl::flat_hash_map<const zetasql::Table*, std::function<void()>>
+      unfilled_tables_ ABSL_GUARDED_BY(mu_);
+
+  // The information schema tables, in the order they were added.
+  std::vector<const zetasql::Table*> meta_tables_;
+
   void AddSchemataTable();
 
   zetasql::SimpleTable* AddTablesTable();
-  void FillTablesTable(zetasql::SimpleTable* tables);
+  void AddTablesRows(const Table* table, Rows* rows) const;
+  void AddTablesRows(const zetasql::Table* table, Rows* rows) const;
 
   zetasql::SimpleTable* AddColumnsTable();
-  void FillColumnsTable(zetasql::SimpleTable* columns);
+  void AddColumnsRows(const Table* table, Rows* rows) const;
+  void AddColumnsRows(const zetasql::Table* table, Rows* rows) const;
 
   zetasql::SimpleTable* AddIndexesTable();
-  void FillIndexesTable(zetasql::SimpleTable* indexes);
+  void AddIndexesRows(const Table* table, Rows* rows) const;
+  void AddIndexesRows(const zetasql::Table* table, Rows* rows) const;
 
   zetasql::SimpleTable* AddIndexColumnsTable();
-  void FillIndexColumnsTable(zetasql::SimpleTable* index_columns);
+  void AddIndexColumnsRows(const Table* table, Rows* rows) const;
+  void AddIndexColumnsRows(const zetasql::Table* table, Rows* rows) const;
 
   void AddColumnOptionsTable();
 
@@ -88,6 +195,37 @@ class InformationSchemaCatalog : public zetasql::SimpleCatalog {
       zetasql::SimpleTable* constraint_column_usage);
 };
 
+// InformationSchemaCache shares the information schema catalog of a schema
+// between all the queries against that schema, so that it is built at most
+// once per schema version. The rows of the user tables are shared between the
+// catalogs of successive schema versions.
+//
+// This class is thread-safe.
+class InformationSchemaCache {
+ public:
+  // Returns the information schema catalog for 'schema', creating it if
+  // needed. The catalog remains valid after the cache is cleared for as long
+  // as the returned pointer is held.
+  std::shared_ptr<InformationSchemaCatalog> Get(const Schema* schema)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Discards the cached catalogs, and the rows of the tables which 'diff'
+  // lists as dropped or altered. Called when a new schema is published.
+  void Update(const SchemaDiff& diff) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Discards all cached catalogs and rows. Called when schemas are pruned,
+  // since rows must not be kept for tables which no longer exist.
+  void Clear() ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  absl::Mutex mu_;
+
+  InformationSchemaRowsCache rows_cache_;
+
+  absl::flat_hash_map<const Schema*, std::shared_ptr<InformationSchemaCatalog>>
+      catalogs_ ABSL_GUARDED_BY(mu_);
+};
+
 }  // namespace backend
 }  // namespace emulator
 }  // namespace spanner
@@ -0,0 +1,304 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/query/join_rewriter.h"
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/type.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "zetasql/resolved_ast/resolved_column.h"
+#include "zetasql/resolved_ast/resolved_node_kind.pb.h"
+#include "absl/memory/memory.h"
+#include "absl/types/span.h"
+#include "backend/query/joined_table.h"
+#include "backend/query/queryable_table.h"
+#include "backend/schema/catalog/table.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// An equality between a column of the outer table and a column of the inner
+// table of a join, as column indexes in their tables.
+struct ColumnEquality {
+  int outer_column;
+  int inner_column;
+};
+
+// How a join is evaluated by a JoinedTable: its method, the outer columns
+// joined with the leading primary key columns of the inner table, and the
+// conjuncts of the join condition they replace.
+struct JoinPlan {
+  JoinMethod method;
+  std::vector<int> outer_join_columns;
+  std::vector<int> used_conjuncts;
+};
+
+// Returns the table scanned by `scan` if it is a scan of a database table with
+// no hints and no time travel, or nullptr otherwise.
+const zetasql::ResolvedTableScan* PlainTableScan(
+    const zetasql::ResolvedScan* scan) {
+  if (scan->node_kind() != zetasql::RESOLVED_TABLE_SCAN) {
+    return nullptr;
+  }
+  const auto* table_scan = scan->GetAs<zetasql::ResolvedTableScan>();
+  if (table_scan->hint_list_size() > 0 ||
+      table_scan->for_system_time_expr() != nullptr ||
+      dynamic_cast<const QueryableTable*>(table_scan->table()) == nullptr) {
+    return nullptr;
+  }
+  return table_scan;
+}
+
+// Returns the index in the scanned table of `column`, or -1 if the scan does
+// not produce it.
+int ColumnIndex(const zetasql::ResolvedTableScan* scan,
+                const zetasql::ResolvedColumn& column) {
+  for (int i = 0; i < scan->column_list_size(); ++i) {
+    if (scan->column_list(i) == column) {
+      return scan->column_index_list(i);
+    }
+  }
+  return -1;
+}
+
+// Appends the conjuncts of `expr` to `conjuncts`.
+void AddConjuncts(const zetasql::ResolvedExpr* expr,
+                  std::vector<const zetasql::ResolvedExpr*>* conjuncts) {
+  if (expr->node_kind() == zetasql::RESOLVED_FUNCTION_CALL) {
+    const auto* call = expr->GetAs<zetasql::ResolvedFunctionCall>();
+    if (call->function()->Name() == "$and") {
+      for (const auto& argument : call->argument_list()) {
+        AddConjuncts(argument.get(), conjuncts);
+      }
+      return;
+    }
+  }
+  conjuncts->push_back(expr);
+}
+
+// Returns the columns equated by `expr` if it is an equality between a column
+// of `outer` and a column of `inner` whose values compare as keys do.
+std::optional<ColumnEquality> AsColumnEquality(
+    const zetasql::ResolvedExpr* expr, const zetasql::ResolvedTableScan* outer,
+    const zetasql::ResolvedTableScan* inner) {
+  if (expr->node_kind() != zetasql::RESOLVED_FUNCTION_CALL) {
+    return std::nullopt;
+  }
+  const auto* call = expr->GetAs<zetasql::ResolvedFunctionCall>();
+  if (call->function()->Name() != "$equal" || call->argument_list_size() != 2) {
+    return std::nullopt;
+  }
+  std::vector<zetasql::ResolvedColumn> columns;
+  for (const auto& argument : call->argument_list()) {
+    if (argument->node_kind() != zetasql::RESOLVED_COLUMN_REF ||
+        argument->GetAs<zetasql::ResolvedColumnRef>()->is_correlated()) {
+      return std::nullopt;
+    }
+    columns.push_back(argument->GetAs<zetasql::ResolvedColumnRef>()->column());
+  }
+  // NaN is equal to itself as a key but not in SQL, so floating point columns
+  // cannot be joined as keys.
+  const zetasql::Type* type = columns[0].type();
+  if (type->IsFloat() || type->IsDouble() || !type->Equals(columns[1].type())) {
+    return std::nullopt;
+  }
+  for (int i = 0; i < 2; ++i) {
+    int outer_column = ColumnIndex(outer, columns[i]);
+    int inner_column = ColumnIndex(inner, columns[1 - i]);
+    if (outer_column >= 0 && inner_column >= 0) {
+      return ColumnEquality{outer_column, inner_column};
+    }
+  }
+  return std::nullopt;
+}
+
+// Returns the index of `column` in the columns of its table.
+int ColumnIndexInTable(const backend::Column* column) {
+  const backend::Table* table = column->table();
+  for (int i = 0; i < table->columns().size(); ++i) {
+    if (table->columns()[i] == column) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Returns true if `ancestor` is the parent of `table`, or one of its parent's
+// ancestors.
+bool IsAncestor(const backend::Table* ancestor, const backend::Table* table) {
+  for (const backend::Table* parent = table->parent(); parent != nullptr;
+       parent = parent->parent()) {
+    if (parent == ancestor) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Plans the join of `outer` and `inner` on `conjuncts`, or returns nullopt if
+// the conjuncts do not equate the leading primary key columns of `inner` with
+// columns of `outer`.
+std::optional<JoinPlan> PlanJoin(
+    const zetasql::ResolvedTableScan* outer,
+    const zetasql::ResolvedTableScan* inner,
+    absl::Span<const zetasql::ResolvedExpr* const> conjuncts) {
+  const backend::Table* outer_table =
+      static_cast<const QueryableTable*>(outer->table())->wrapped_table();
+  const backend::Table* inner_table =
+      static_cast<const QueryableTable*>(inner->table())->wrapped_table();
+  std::vector<std::optional<ColumnEquality>> equalities;
+  for (const zetasql::ResolvedExpr* conjunct : conjuncts) {
+    equalities.push_back(AsColumnEquality(conjunct, outer, inner));
+  }
+
+  JoinPlan plan;
+  for (const KeyColumn* key_column : inner_table->primary_key()) {
+    const int inner_column = ColumnIndexInTable(key_column->column());
+    int conjunct = 0;
+    while (conjunct < equalities.size() &&
+           (!equalities[conjunct].has_value() ||
+            equalities[conjunct]->inner_column != inner_column)) {
+      ++conjunct;
+    }
+    if (conjunct == equalities.size()) {
+      break;
+    }
+    plan.outer_join_columns.push_back(equalities[conjunct]->outer_column);
+    plan.used_conjuncts.push_back(conjunct);
+  }
+  if (plan.outer_join_columns.empty()) {
+    return std::nullopt;
+  }
+
+  // Interleaved rows can be merged if they are joined on the whole key of
+  // their ancestor, column by column, in the same order.
+  plan.method = JoinMethod::kKeyLookup;
+  absl::Span<const KeyColumn* const> outer_key = outer_table->primary_key();
+  if (IsAncestor(outer_table, inner_table) &&
+      plan.outer_join_columns.size() == outer_key.size()) {
+    bool aligned = true;
+    for (int i = 0; i < outer_key.size(); ++i) {
+      aligned &= plan.outer_join_columns[i] ==
+                     ColumnIndexInTable(outer_key[i]->column()) &&
+                 outer_key[i]->is_descending() ==
+                     inner_table->primary_key()[i]->is_descending();
+    }
+    if (aligned) {
+      plan.method = JoinMethod::kInterleavedMerge;
+    }
+  }
+  return plan;
+}
+
+// Returns true if `plan` is expected to evaluate a join faster than `other`:
+// merges first, then lookups of more key columns.
+bool IsBetterPlan(const JoinPlan& plan, const JoinPlan& other) {
+  if (plan.method != other.method) {
+    return plan.method == JoinMethod::kInterleavedMerge;
+  }
+  return plan.outer_join_columns.size() > other.outer_join_columns.size();
+}
+
+}  // namespace
+
+absl::Status JoinRewriter::VisitResolvedJoinScan(
+    const zetasql::ResolvedJoinScan* node) {
+  const zetasql::ResolvedTableScan* left = PlainTableScan(node->left_scan());
+  const zetasql::ResolvedTableScan* right = PlainTableScan(node->right_scan());
+  if (node->join_type() != zetasql::ResolvedJoinScan::INNER ||
+      node->join_expr() == nullptr || left == nullptr || right == nullptr) {
+    return CopyVisitResolvedJoinScan(node);
+  }
+  std::vector<const zetasql::ResolvedExpr*> conjuncts;
+  AddConjuncts(node->join_expr(), &conjuncts);
+
+  // Inner joins are symmetric, so either table can be the outer one.
+  const zetasql::ResolvedTableScan* outer = left;
+  const zetasql::ResolvedTableScan* inner = right;
+  std::optional<JoinPlan> plan = PlanJoin(left, right, conjuncts);
+  std::optional<JoinPlan> swapped_plan = PlanJoin(right, left, conjuncts);
+  if (swapped_plan.has_value() &&
+      (!plan.has_value() || IsBetterPlan(*swapped_plan, *plan))) {
+    plan = std::move(swapped_plan);
+    std::swap(outer, inner);
+  }
+  if (!plan.has_value()) {
+    return CopyVisitResolvedJoinScan(node);
+  }
+
+  const auto* outer_table = static_cast<const QueryableTable*>(outer->table());
+  const auto* inner_table = static_cast<const QueryableTable*>(inner->table());
+  auto joined_table = absl::make_unique<JoinedTable>(
+      plan->method, outer_table, inner_table, plan->outer_join_columns,
+      reader_);
+
+  std::vector<const zetasql::ResolvedExpr*> remaining_conjuncts;
+  for (int i = 0; i < conjuncts.size(); ++i) {
+    if (std::find(plan->used_conjuncts.begin(), plan->used_conjuncts.end(),
+                  i) == plan->used_conjuncts.end()) {
+      remaining_conjuncts.push_back(conjuncts[i]);
+    }
+  }
+
+  // The joined table produces the columns of the join, and those the remaining
+  // conjuncts are evaluated over, which may be any column of either scan.
+  // Inner columns are numbered after all the outer ones.
+  std::vector<zetasql::ResolvedColumn> scan_columns = node->column_list();
+  if (!remaining_conjuncts.empty()) {
+    scan_columns = outer->column_list();
+    scan_columns.insert(scan_columns.end(), inner->column_list().begin(),
+                        inner->column_list().end());
+  }
+  std::vector<int> column_indexes;
+  for (const zetasql::ResolvedColumn& column : scan_columns) {
+    const int outer_index = ColumnIndex(outer, column);
+    column_indexes.push_back(outer_index >= 0
+                                 ? outer_index
+                                 : outer_table->NumColumns() +
+                                       ColumnIndex(inner, column));
+  }
+  auto table_scan = zetasql::MakeResolvedTableScan(
+      scan_columns, joined_table.get(), /*for_system_time_expr=*/nullptr);
+  table_scan->set_column_index_list(column_indexes);
+  joined_tables_.push_back(std::move(joined_table));
+
+  std::unique_ptr<zetasql::ResolvedScan> scan = std::move(table_scan);
+  for (int i = 0; i < remaining_conjuncts.size(); ++i) {
+    ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<zetasql::ResolvedExpr> filter,
+                     ProcessNode(remaining_conjuncts[i]));
+    scan = zetasql::MakeResolvedFilterScan(
+        i + 1 < remaining_conjuncts.size() ? scan_columns : node->column_list(),
+        std::move(scan), std::move(filter));
+  }
+  PushNodeToStack(std::move(scan));
+  return absl::OkStatus();
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,69 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_JOIN_REWRITER_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_JOIN_REWRITER_H_
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/catalog.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "zetasql/resolved_ast/resolved_ast_deep_copy_visitor.h"
+#include "backend/access/read.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// Implements ResolvedASTDeepCopyVisitor to replace inner joins of two tables
+// on key columns with scans of a JoinedTable, which evaluates the join as a
+// merge of interleaved tables or as key lookups in the inner table.
+//
+// A join is rewritten if both of its inputs are scans of database tables
+// without hints, and its condition equates the leading primary key columns of
+// one table with columns of the other. Equalities used by the JoinedTable are
+// dropped from the condition, and the remaining conjuncts are applied by
+// filter scans over the JoinedTable. Other joins, including those on
+// floating point columns, are left to the ZetaSQL reference implementation.
+class JoinRewriter : public zetasql::ResolvedASTDeepCopyVisitor {
+ public:
+  // Joined tables read through `reader`.
+  explicit JoinRewriter(RowReader* reader) : reader_(reader) {}
+
+  absl::Status VisitResolvedJoinScan(
+      const zetasql::ResolvedJoinScan* node) override;
+
+  // Returns the tables scanned by the rewritten statement, which must outlive
+  // it.
+  std::vector<std::unique_ptr<const zetasql::Table>> release_joined_tables() {
+    return std::move(joined_tables_);
+  }
+
+ private:
+  RowReader* reader_;
+  std::vector<std::unique_ptr<const zetasql::Table>> joined_tables_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_JOIN_REWRITER_H_
@@ -0,0 +1,434 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/query/joined_table.h"
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/evaluator_table_iterator.h"
+#include "zetasql/public/value.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "zetasql/base/ret_check.h"
+#include "zetasql/base/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "backend/access/read.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/datamodel/key_set.h"
+#include "backend/query/queryable_table.h"
+#include "backend/schema/catalog/column.h"
+#include "backend/schema/catalog/table.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// Maximum number of outer rows whose inner rows are read together by
+// kKeyLookup joins.
+constexpr int kLookupBatchSize = 1024;
+
+// One of the two tables of a join, as read by JoinedTableIterator.
+struct JoinInput {
+  const backend::Table* table = nullptr;
+
+  // The columns read from the table.
+  std::vector<const backend::Column*> columns;
+
+  // Positions in `columns` of the columns the tables are joined on.
+  std::vector<int> join_positions;
+
+  std::unique_ptr<RowCursor> cursor;
+
+  // Returns the position of `column` in `columns`, adding it if needed.
+  int AddColumn(const backend::Column* column) {
+    for (int i = 0; i < columns.size(); ++i) {
+      if (columns[i] == column) {
+        return i;
+      }
+    }
+    columns.push_back(column);
+    return columns.size() - 1;
+  }
+
+  ReadArg MakeReadArg(const KeySet& key_set) const {
+    ReadArg read_arg;
+    read_arg.table = table->Name();
+    read_arg.key_set = key_set;
+    for (const backend::Column* column : columns) {
+      read_arg.columns.push_back(column->Name());
+    }
+    return read_arg;
+  }
+
+  // Returns the values of the current row of the cursor.
+  std::vector<zetasql::Value> RowValues() const {
+    std::vector<zetasql::Value> values;
+    values.reserve(cursor->NumColumns());
+    for (int i = 0; i < cursor->NumColumns(); ++i) {
+      values.push_back(cursor->ColumnValue(i));
+    }
+    return values;
+  }
+};
+
+}  // namespace
+
+// An implementation of EvaluatorTableIterator which evaluates the join of a
+// JoinedTable.
+//
+// The tables are read on the first call to NextRow(), so that filters on the
+// key columns of the outer table set by SetColumnFilterMap() narrow the keys
+// read from both tables.
+class JoinedTableIterator : public zetasql::EvaluatorTableIterator {
+ public:
+  JoinedTableIterator(const JoinedTable* table,
+                      absl::Span<const int> column_idxs)
+      : table_(table), column_idxs_(column_idxs.begin(), column_idxs.end()) {
+    outer_.table = table->outer_table();
+    inner_.table = table->inner_table();
+    const int num_outer_columns = outer_.table->columns().size();
+    for (int column_idx : column_idxs_) {
+      if (column_idx < num_outer_columns) {
+        const backend::Column* column = outer_.table->columns()[column_idx];
+        sources_.push_back({/*inner=*/false, outer_.AddColumn(column)});
+      } else {
+        const backend::Column* column =
+            inner_.table->columns()[column_idx - num_outer_columns];
+        sources_.push_back({/*inner=*/true, inner_.AddColumn(column)});
+      }
+      values_.push_back(
+          zetasql::values::Null(table->GetColumn(column_idx)->GetType()));
+    }
+    absl::Span<const KeyColumn* const> inner_key = inner_.table->primary_key();
+    for (int i = 0; i < table->outer_join_columns().size(); ++i) {
+      outer_.join_positions.push_back(outer_.AddColumn(
+          outer_.table->columns()[table->outer_join_columns()[i]]));
+      inner_.join_positions.push_back(
+          inner_.AddColumn(inner_key[i]->column()));
+      join_key_descending_.push_back(inner_key[i]->is_descending());
+    }
+  }
+
+  int NumColumns() const override { return column_idxs_.size(); }
+
+  std::string GetColumnName(int i) const override {
+    return table_->GetColumn(column_idxs_[i])->Name();
+  }
+
+  const zetasql::Type* GetColumnType(int i) const override {
+    return table_->GetColumn(column_idxs_[i])->GetType();
+  }
+
+  absl::Status SetColumnFilterMap(
+      absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>>
+          filter_map) override {
+    // A filter on a join column of the inner table applies equally to the
+    // outer column it is joined with.
+    absl::Span<const KeyColumn* const> outer_key = outer_.table->primary_key();
+    std::vector<const zetasql::ColumnFilter*> key_filters;
+    for (const KeyColumn* key_column : outer_key) {
+      const zetasql::ColumnFilter* key_filter =
+          FindFilter(filter_map, /*inner=*/false, key_column->column());
+      for (int i = 0; key_filter == nullptr &&
+                      i < table_->outer_join_columns().size();
+           ++i) {
+        if (outer_.table->columns()[table_->outer_join_columns()[i]] ==
+            key_column->column()) {
+          key_filter =
+              FindFilter(filter_map, /*inner=*/true,
+                         inner_.table->primary_key()[i]->column());
+        }
+      }
+      key_filters.push_back(key_filter);
+    }
+    std::optional<KeySet> key_set =
+        KeySetFromKeyColumnFilters(outer_key, key_filters);
+    if (key_set.has_value()) {
+      outer_key_set_ = std::move(key_set).value();
+    }
+    return absl::OkStatus();
+  }
+
+  bool NextRow() override {
+    if (outer_.cursor == nullptr) {
+      status_ = Open();
+      if (!status_.ok()) {
+        return false;
+      }
+    }
+    if (table_->method() == JoinMethod::kInterleavedMerge) {
+      return NextMergedRow();
+    }
+    return NextLookedUpRow();
+  }
+
+  const zetasql::Value& GetValue(int i) const override { return values_[i]; }
+
+  absl::Status Status() const override {
+    ZETASQL_RETURN_IF_ERROR(status_);
+    if (outer_.cursor != nullptr) {
+      ZETASQL_RETURN_IF_ERROR(outer_.cursor->Status());
+    }
+    if (inner_.cursor != nullptr) {
+      ZETASQL_RETURN_IF_ERROR(inner_.cursor->Status());
+    }
+    return absl::OkStatus();
+  }
+
+  // Cancel is best-effort and not required.
+  absl::Status Cancel() override { return absl::OkStatus(); }
+
+ private:
+  // Where a column of the iterator is read from: the position of the column
+  // in the columns read from the inner or outer table.
+  struct Source {
+    bool inner;
+    int position;
+  };
+
+  // Returns the filter on `column` of the inner or outer table, or nullptr if
+  // the column is not filtered.
+  const zetasql::ColumnFilter* FindFilter(
+      const absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>>&
+          filter_map,
+      bool inner, const backend::Column* column) const {
+    const JoinInput& input = inner ? inner_ : outer_;
+    for (int i = 0; i < sources_.size(); ++i) {
+      auto filter_itr = filter_map.find(i);
+      if (sources_[i].inner == inner &&
+          input.columns[sources_[i].position] == column &&
+          filter_itr != filter_map.end()) {
+        return filter_itr->second.get();
+      }
+    }
+    return nullptr;
+  }
+
+  // Opens the cursor over the outer rows, and for merges over the inner rows.
+  // Inner rows are interleaved under the outer rows with the same key, so the
+  // keys read from the outer table also select the inner rows to merge, and
+  // storage which co-locates them can read both in one pass.
+  absl::Status Open() {
+    if (table_->method() == JoinMethod::kInterleavedMerge) {
+      return table_->reader()->ReadInterleaved(
+          outer_.MakeReadArg(outer_key_set_),
+          inner_.MakeReadArg(outer_key_set_), &outer_.cursor, &inner_.cursor);
+    }
+    return table_->reader()->Read(outer_.MakeReadArg(outer_key_set_),
+                                  &outer_.cursor);
+  }
+
+  // Returns the values of the join columns of the current row of `input` as a
+  // key of the inner table, or nullopt if any of them is NULL.
+  std::optional<Key> JoinKey(const JoinInput& input) const {
+    Key key;
+    for (int i = 0; i < input.join_positions.size(); ++i) {
+      zetasql::Value value = input.cursor->ColumnValue(input.join_positions[i]);
+      if (value.is_null()) {
+        return std::nullopt;
+      }
+      key.AddColumn(std::move(value), join_key_descending_[i]);
+    }
+    return key;
+  }
+
+  void SetValues(const std::vector<zetasql::Value>& outer_row,
+                 const std::vector<zetasql::Value>& inner_row) {
+    for (int i = 0; i < sources_.size(); ++i) {
+      values_[i] = sources_[i].inner ? inner_row[sources_[i].position]
+                                     : outer_row[sources_[i].position];
+    }
+  }
+
+  // Advances to the next outer row whose join columns are not NULL.
+  void AdvanceOuterRow() {
+    has_outer_row_ = false;
+    while (outer_.cursor->Next()) {
+      std::optional<Key> key = JoinKey(outer_);
+      if (key.has_value()) {
+        outer_key_ = std::move(key).value();
+        outer_row_ = outer_.RowValues();
+        has_outer_row_ = true;
+        return;
+      }
+    }
+  }
+
+  // Returns the next inner row along with the outer row it is interleaved
+  // under. Since the outer key is unique, each inner row has at most one
+  // matching outer row, and the outer cursor only moves forward.
+  bool NextMergedRow() {
+    if (!outer_started_) {
+      outer_started_ = true;
+      AdvanceOuterRow();
+    }
+    while (has_outer_row_ && inner_.cursor->Next()) {
+      std::optional<Key> inner_key = JoinKey(inner_);
+      if (!inner_key.has_value()) {
+        continue;
+      }
+      while (has_outer_row_ && outer_key_ < *inner_key) {
+        AdvanceOuterRow();
+      }
+      if (has_outer_row_ && outer_key_ == *inner_key) {
+        SetValues(outer_row_, inner_.RowValues());
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool NextLookedUpRow() {
+    while (next_batch_row_ == batch_rows_.size()) {
+      if (outer_done_) {
+        return false;
+      }
+      status_ = ReadBatch();
+      if (!status_.ok()) {
+        return false;
+      }
+    }
+    values_ = std::move(batch_rows_[next_batch_row_++]);
+    return true;
+  }
+
+  // Reads the next batch of outer rows and the inner rows whose keys they
+  // join, and stores the joined rows in batch_rows_.
+  absl::Status ReadBatch() {
+    batch_rows_.clear();
+    next_batch_row_ = 0;
+    std::vector<std::vector<zetasql::Value>> outer_rows;
+    std::map<Key, std::vector<int>> outer_rows_by_key;
+    while (outer_rows.size() < kLookupBatchSize) {
+      if (!outer_.cursor->Next()) {
+        ZETASQL_RETURN_IF_ERROR(outer_.cursor->Status());
+        outer_done_ = true;
+        break;
+      }
+      std::optional<Key> key = JoinKey(outer_);
+      if (key.has_value()) {
+        outer_rows_by_key[std::move(key).value()].push_back(outer_rows.size());
+        outer_rows.push_back(outer_.RowValues());
+      }
+    }
+    if (outer_rows_by_key.empty()) {
+      return absl::OkStatus();
+    }
+
+    const bool full_key = inner_.join_positions.size() ==
+                          inner_.table->primary_key().size();
+    KeySet key_set;
+    for (const auto& [key, rows] : outer_rows_by_key) {
+      if (full_key) {
+        key_set.AddKey(key);
+      } else {
+        key_set.AddRange(KeyRange::Prefix(key));
+      }
+    }
+    ZETASQL_RETURN_IF_ERROR(
+        table_->reader()->Read(inner_.MakeReadArg(key_set), &inner_.cursor));
+    while (inner_.cursor->Next()) {
+      std::optional<Key> key = JoinKey(inner_);
+      if (!key.has_value()) {
+        continue;
+      }
+      auto rows = outer_rows_by_key.find(*key);
+      if (rows == outer_rows_by_key.end()) {
+        continue;
+      }
+      std::vector<zetasql::Value> inner_row = inner_.RowValues();
+      for (int outer_row : rows->second) {
+        SetValues(outer_rows[outer_row], inner_row);
+        batch_rows_.push_back(values_);
+      }
+    }
+    return inner_.cursor->Status();
+  }
+
+  const JoinedTable* table_;
+  const std::vector<int> column_idxs_;
+
+  // The columns of the iterator, by where they are read from.
+  std::vector<Source> sources_;
+
+  JoinInput outer_;
+  JoinInput inner_;
+
+  // Whether each column of the join keys is a descending key column.
+  std::vector<bool> join_key_descending_;
+
+  // The keys read from the outer table, narrowed by SetColumnFilterMap.
+  KeySet outer_key_set_ = KeySet::All();
+
+  // The current outer row of a merge, and its join key.
+  bool outer_started_ = false;
+  bool has_outer_row_ = false;
+  Key outer_key_;
+  std::vector<zetasql::Value> outer_row_;
+
+  // The joined rows of the current batch of a key lookup join.
+  std::vector<std::vector<zetasql::Value>> batch_rows_;
+  int next_batch_row_ = 0;
+  bool outer_done_ = false;
+
+  // Status of reading the tables, besides the status of their cursors.
+  absl::Status status_;
+
+  // Values of the current row.
+  std::vector<zetasql::Value> values_;
+};
+
+JoinedTable::JoinedTable(JoinMethod method, const QueryableTable* outer,
+                         const QueryableTable* inner,
+                         std::vector<int> outer_join_columns,
+                         RowReader* reader)
+    : method_(method),
+      outer_(outer),
+      inner_(inner),
+      outer_join_columns_(std::move(outer_join_columns)),
+      reader_(reader),
+      name_(absl::StrCat(outer->Name(), " JOIN ", inner->Name())) {}
+
+const zetasql::Column* JoinedTable::GetColumn(int i) const {
+  if (i < outer_->NumColumns()) {
+    return outer_->GetColumn(i);
+  }
+  return inner_->GetColumn(i - outer_->NumColumns());
+}
+
+zetasql_base::StatusOr<std::unique_ptr<zetasql::EvaluatorTableIterator>>
+JoinedTable::CreateEvaluatorTableIterator(
+    absl::Span<const int> column_idxs) const {
+  ZETASQL_RET_CHECK_NE(reader_, nullptr);
+  return absl::make_unique<JoinedTableIterator>(this, column_idxs);
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
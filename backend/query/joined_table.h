@@ -0,0 +1,117 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_JOINED_TABLE_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_JOINED_TABLE_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "zetasql/public/catalog.h"
+#include "zetasql/public/evaluator_table_iterator.h"
+#include "absl/types/span.h"
+#include "backend/access/read.h"
+#include "backend/query/queryable_table.h"
+#include "backend/schema/catalog/table.h"
+#include "zetasql/base/statusor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// The ways in which a JoinedTable joins the rows of its two tables.
+enum class JoinMethod {
+  // The inner table is interleaved in the outer table, directly or through
+  // other tables, and is joined on all the primary key columns of the outer
+  // table. Both tables are read in key order and their rows are merged, so the
+  // join reads each table once and holds a single outer row at a time.
+  kInterleavedMerge,
+
+  // The inner table is joined on a prefix of its primary key, such as the key
+  // referenced by a foreign key of the outer table. Outer rows are read in
+  // batches and the inner rows matching each batch are read by key.
+  kKeyLookup,
+};
+
+// JoinedTable is a zetasql::Table holding the rows of the inner join of two
+// tables on key columns of the inner table. JoinRewriter substitutes scans of
+// a JoinedTable for such joins in queries, which the ZetaSQL reference
+// implementation would otherwise evaluate over full scans of both tables.
+//
+// The columns of the table are the columns of the outer table followed by the
+// columns of the inner table. The leading primary key columns of the inner
+// table are joined with the outer columns `outer_join_columns`, given as
+// column indexes of the outer table. Rows with a NULL join column never match,
+// as with SQL equality.
+//
+// Filters on the primary key of the outer table are pushed down to the reads
+// of both tables when the table is scanned.
+class JoinedTable : public zetasql::Table {
+ public:
+  JoinedTable(JoinMethod method, const QueryableTable* outer,
+              const QueryableTable* inner, std::vector<int> outer_join_columns,
+              RowReader* reader);
+
+  std::string Name() const override { return name_; }
+
+  // FullName is used in debugging so it's OK to not include full path here.
+  std::string FullName() const override { return name_; }
+
+  int NumColumns() const override {
+    return outer_->NumColumns() + inner_->NumColumns();
+  }
+
+  const zetasql::Column* GetColumn(int i) const override;
+
+  // Columns are never looked up by name, since the table is not in any
+  // catalog, and the names of the two tables may collide.
+  const zetasql::Column* FindColumnByName(
+      const std::string& name) const override {
+    return nullptr;
+  }
+
+  zetasql_base::StatusOr<std::unique_ptr<zetasql::EvaluatorTableIterator>>
+  CreateEvaluatorTableIterator(
+      absl::Span<const int> column_idxs) const override;
+
+  JoinMethod method() const { return method_; }
+  const backend::Table* outer_table() const { return outer_->wrapped_table(); }
+  const backend::Table* inner_table() const { return inner_->wrapped_table(); }
+  const std::vector<int>& outer_join_columns() const {
+    return outer_join_columns_;
+  }
+  RowReader* reader() const { return reader_; }
+
+ private:
+  const JoinMethod method_;
+  const QueryableTable* outer_;
+  const QueryableTable* inner_;
+  const std::vector<int> outer_join_columns_;
+
+  // The reader which both tables are read through.
+  RowReader* reader_;
+
+  const std::string name_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_JOINED_TABLE_H_
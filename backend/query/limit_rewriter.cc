@@ -0,0 +1,215 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/query/limit_rewriter.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/type.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "zetasql/resolved_ast/resolved_column.h"
+#include "zetasql/resolved_ast/resolved_node_kind.pb.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/ascii.h"
+#include "absl/types/span.h"
+#include "backend/query/batch_predicate.h"
+#include "backend/query/filtered_table.h"
+#include "backend/query/queryable_table.h"
+#include "backend/schema/catalog/index.h"
+#include "backend/schema/catalog/table.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// Returns the number of rows given by `expr` if it is an INT64 literal or
+// named query parameter.
+std::optional<RowCount> AsRowCount(const zetasql::ResolvedExpr* expr) {
+  if (!expr->type()->IsInt64()) {
+    return std::nullopt;
+  }
+  if (expr->node_kind() == zetasql::RESOLVED_LITERAL) {
+    return RowCount{"", expr->GetAs<zetasql::ResolvedLiteral>()->value()};
+  }
+  if (expr->node_kind() == zetasql::RESOLVED_PARAMETER &&
+      !expr->GetAs<zetasql::ResolvedParameter>()->name().empty()) {
+    return RowCount{absl::AsciiStrToLower(
+                        expr->GetAs<zetasql::ResolvedParameter>()->name()),
+                    zetasql::Value()};
+  }
+  return std::nullopt;
+}
+
+// Returns the index in the scanned table of `column`, or -1 if the scan does
+// not produce it.
+int ColumnIndex(const zetasql::ResolvedTableScan* scan,
+                const zetasql::ResolvedColumn& column) {
+  for (int i = 0; i < scan->column_list_size(); ++i) {
+    if (scan->column_list(i) == column) {
+      return scan->column_index_list(i);
+    }
+  }
+  return -1;
+}
+
+// Returns true if rows of `table` ordered by `key_columns`, the key columns of
+// the table or of one of its index data tables, are ordered by `order_by`.
+bool IsKeyOrder(const std::vector<std::pair<int, bool>>& order_by,
+                const backend::Table* table,
+                absl::Span<const KeyColumn* const> key_columns) {
+  for (int i = 0; i < order_by.size(); ++i) {
+    // Keys are unique, so further columns do not change the order.
+    if (i == key_columns.size()) {
+      return true;
+    }
+    const backend::Column* column = key_columns[i]->column();
+    if (column->table() != table) {
+      column = column->source_column();
+    }
+    if (column != table->columns()[order_by[i].first] ||
+        key_columns[i]->is_descending() != order_by[i].second) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns true if `index` stores all the columns of `table` in `columns`.
+bool IndexStoresColumns(const Index* index, const backend::Table* table,
+                        const std::vector<int>& columns) {
+  for (int column : columns) {
+    const std::string& name = table->columns()[column]->Name();
+    if (index->index_data_table()->FindColumn(name) == nullptr) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Sets `row_limit` to read the rows of `table` in the order of its primary
+// key or of the key of one of its indexes if that is the order of the rows,
+// given the columns read from the table.
+void SetKeyOrder(const backend::Table* table, const std::vector<int>& columns,
+                 RowLimit* row_limit) {
+  if (IsKeyOrder(row_limit->order_by, table, table->primary_key())) {
+    row_limit->in_key_order = true;
+    return;
+  }
+  // Null-filtered indexes omit rows with NULL key columns.
+  for (const Index* index : table->indexes()) {
+    if (!index->is_null_filtered() &&
+        IndexStoresColumns(index, table, columns) &&
+        IsKeyOrder(row_limit->order_by, table,
+                   index->index_data_table()->primary_key())) {
+      row_limit->in_key_order = true;
+      row_limit->index = index;
+      return;
+    }
+  }
+}
+
+}  // namespace
+
+absl::Status LimitRewriter::VisitResolvedLimitOffsetScan(
+    const zetasql::ResolvedLimitOffsetScan* node) {
+  std::optional<RowCount> limit = AsRowCount(node->limit());
+  std::optional<RowCount> offset;
+  if (node->offset() != nullptr) {
+    offset = AsRowCount(node->offset());
+  }
+  if (!limit.has_value() ||
+      (node->offset() != nullptr && !offset.has_value()) ||
+      node->input_scan()->node_kind() != zetasql::RESOLVED_ORDER_BY_SCAN) {
+    return CopyVisitResolvedLimitOffsetScan(node);
+  }
+
+  // Projections do not change the rows ordered, only their columns.
+  const auto* order_by_scan =
+      node->input_scan()->GetAs<zetasql::ResolvedOrderByScan>();
+  const zetasql::ResolvedScan* scan = order_by_scan->input_scan();
+  while (scan->node_kind() == zetasql::RESOLVED_PROJECT_SCAN) {
+    scan = scan->GetAs<zetasql::ResolvedProjectScan>()->input_scan();
+  }
+  if (scan->node_kind() != zetasql::RESOLVED_TABLE_SCAN) {
+    return CopyVisitResolvedLimitOffsetScan(node);
+  }
+  const auto* table_scan = scan->GetAs<zetasql::ResolvedTableScan>();
+  FilteredTable* filtered_table = nullptr;
+  for (const auto& table : *filtered_tables_) {
+    if (table.get() == table_scan->table()) {
+      filtered_table = table.get();
+    }
+  }
+  const QueryableTable* table =
+      filtered_table != nullptr
+          ? filtered_table->table()
+          : dynamic_cast<const QueryableTable*>(table_scan->table());
+  if (table == nullptr || table_scan->for_system_time_expr() != nullptr ||
+      (filtered_table != nullptr && filtered_table->row_limit().has_value())) {
+    return CopyVisitResolvedLimitOffsetScan(node);
+  }
+
+  RowLimit row_limit{*std::move(limit), std::move(offset)};
+  for (const auto& item : order_by_scan->order_by_item_list()) {
+    const int column = ColumnIndex(table_scan, item->column_ref()->column());
+    if (column < 0 || item->collation_name() != nullptr) {
+      return CopyVisitResolvedLimitOffsetScan(node);
+    }
+    row_limit.order_by.emplace_back(column, item->is_descending());
+  }
+  std::vector<int> columns(table_scan->column_index_list().begin(),
+                           table_scan->column_index_list().end());
+  if (filtered_table != nullptr) {
+    const std::vector<int>& predicate_columns =
+        filtered_table->predicate()->columns();
+    columns.insert(columns.end(), predicate_columns.begin(),
+                   predicate_columns.end());
+  }
+  SetKeyOrder(table->wrapped_table(), columns, &row_limit);
+
+  if (filtered_table == nullptr) {
+    filtered_tables_->push_back(absl::make_unique<FilteredTable>(
+        table, absl::make_unique<BatchPredicate>()));
+    filtered_table = filtered_tables_->back().get();
+    limited_tables_[table_scan] = filtered_table;
+  }
+  filtered_table->set_row_limit(std::move(row_limit));
+  return CopyVisitResolvedLimitOffsetScan(node);
+}
+
+absl::Status LimitRewriter::VisitResolvedTableScan(
+    const zetasql::ResolvedTableScan* node) {
+  ZETASQL_RETURN_IF_ERROR(CopyVisitResolvedTableScan(node));
+  auto it = limited_tables_.find(node);
+  if (it != limited_tables_.end()) {
+    GetUnownedTopOfStack<zetasql::ResolvedTableScan>()->set_table(it->second);
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,76 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_LIMIT_REWRITER_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_LIMIT_REWRITER_H_
+
+#include <memory>
+#include <vector>
+
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "zetasql/resolved_ast/resolved_ast_deep_copy_visitor.h"
+#include "absl/container/flat_hash_map.h"
+#include "backend/query/filtered_table.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// Implements ResolvedASTDeepCopyVisitor to restrict the table scanned by a
+// query of the form `SELECT ... FROM t ORDER BY ... LIMIT n [OFFSET m]` to the
+// first n + m rows in the order of the query, so that the query does not
+// sort, or read, the whole table.
+//
+// A query is rewritten if its ORDER BY is applied to a table scan, possibly
+// through projections, and orders the rows by columns of the table without
+// collation, and if its LIMIT and OFFSET are literals or query parameters.
+// When the order is that of the primary key of the table, or of the key of an
+// index storing the columns read, the table is read in that order and only
+// the first rows are read. Otherwise the first rows are found in a single pass
+// over the table, keeping only n + m rows at a time.
+//
+// The table scanned is replaced with a FilteredTable with a RowLimit, or is
+// given a RowLimit if it already is a FilteredTable.
+class LimitRewriter : public zetasql::ResolvedASTDeepCopyVisitor {
+ public:
+  // Scans of the tables of `filtered_tables` are limited by setting their row
+  // limit, and the tables substituted for other table scans are added to it.
+  explicit LimitRewriter(
+      std::vector<std::unique_ptr<FilteredTable>>* filtered_tables)
+      : filtered_tables_(filtered_tables) {}
+
+  absl::Status VisitResolvedLimitOffsetScan(
+      const zetasql::ResolvedLimitOffsetScan* node) override;
+
+  absl::Status VisitResolvedTableScan(
+      const zetasql::ResolvedTableScan* node) override;
+
+ private:
+  std::vector<std::unique_ptr<FilteredTable>>* filtered_tables_;
+
+  // The tables substituted for the tables of limited table scans.
+  absl::flat_hash_map<const zetasql::ResolvedTableScan*, const FilteredTable*>
+      limited_tables_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_LIMIT_REWRITER_H_
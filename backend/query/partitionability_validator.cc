@@ -84,6 +84,8 @@ absl::Status PartitionabilityValidator::ValidateSimpleScan(
         }
         return error_status;
       case zetasql::RESOLVED_TABLE_SCAN:
+        table_name_ =
+            current_node->GetAs<zetasql::ResolvedTableScan>()->table()->Name();
         return absl::OkStatus();
       default:
         return error_status;
@@ -17,6 +17,8 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_PARTITIONABILITY_VALIDATOR_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_PARTITIONABILITY_VALIDATOR_H_
 
+#include <string>
+
 #include "zetasql/resolved_ast/resolved_ast.h"
 #include "zetasql/resolved_ast/resolved_ast_visitor.h"
 #include "absl/status/status.h"
@@ -42,6 +44,10 @@ class PartitionabilityValidator : public zetasql::ResolvedASTVisitor {
     return zetasql::ResolvedASTVisitor::DefaultVisit(node);
   }
 
+  // Returns the name of the table scanned by the query, once it has been
+  // validated as partitionable.
+  const std::string& table_name() const { return table_name_; }
+
  private:
   // Returns OK if query is partitionable.
   absl::Status ValidatePartitionability(const zetasql::ResolvedNode* node);
@@ -53,6 +59,9 @@ class PartitionabilityValidator : public zetasql::ResolvedASTVisitor {
   bool HasSubquery(const zetasql::ResolvedNode* node);
 
   const Schema* schema_;
+
+  // Name of the table scanned by the query.
+  std::string table_name_;
 };
 
 }  // namespace backend
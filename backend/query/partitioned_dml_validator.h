@@ -17,6 +17,8 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_PARTITIONED_DML_VALIDATOR_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_PARTITIONED_DML_VALIDATOR_H_
 
+#include <string>
+
 #include "zetasql/resolved_ast/resolved_ast.h"
 #include "zetasql/resolved_ast/resolved_ast_visitor.h"
 #include "zetasql/resolved_ast/resolved_node_kind.pb.h"
@@ -44,6 +46,9 @@ class PartitionedDMLValidator : public zetasql::ResolvedASTVisitor {
     return zetasql::ResolvedASTVisitor::DefaultVisit(node);
   }
 
+  // Returns the name of the table modified by the statement.
+  const std::string& table_name() const { return table_name_; }
+
  private:
   absl::Status VisitResolvedTableScan(
       const zetasql::ResolvedTableScan* scan) final {
@@ -52,12 +57,16 @@ class PartitionedDMLValidator : public zetasql::ResolvedASTVisitor {
     if (num_tables_ > 1) {
       return error::PartitionedDMLOnlySupportsSimpleQuery();
     }
+    table_name_ = scan->table()->Name();
     // Continue to visit the rest of the tree.
     return zetasql::ResolvedASTVisitor::DefaultVisit(scan);
   }
 
   // Number of tables referenced in the DML statement.
   int num_tables_ = 0;
+
+  // Name of the only table referenced in the DML statement.
+  std::string table_name_;
 };
 
 }  // namespace backend
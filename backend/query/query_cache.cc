@@ -0,0 +1,328 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/query/query_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "backend/access/read.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/datamodel/key_set.h"
+#include "backend/schema/catalog/schema.h"
+#include "backend/schema/catalog/table.h"
+#include "backend/transaction/row_cursor.h"
+#include "common/cancellation.h"
+#include "common/errors.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// A RowCursor over the rows of an index read which only returns those whose
+// indexed table key is within a range. The key columns of the indexed table
+// are read after the requested columns, and hidden from the caller.
+class KeyRangeFilteredRowCursor : public RowCursor {
+ public:
+  KeyRangeFilteredRowCursor(std::unique_ptr<RowCursor> wrapped_cursor,
+                            int num_columns,
+                            std::vector<std::pair<int, bool>> key_columns,
+                            const KeyRange& range)
+      : wrapped_cursor_(std::move(wrapped_cursor)),
+        num_columns_(num_columns),
+        key_columns_(std::move(key_columns)),
+        range_(range.ToClosedOpen()) {}
+
+  bool Next() override {
+    while (wrapped_cursor_->Next()) {
+      Key key;
+      for (const auto& [column, is_descending] : key_columns_) {
+        key.AddColumn(wrapped_cursor_->ColumnValue(column), is_descending);
+      }
+      if (range_.Contains(key)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  absl::Status Status() const override { return wrapped_cursor_->Status(); }
+
+  int NumColumns() const override { return num_columns_; }
+
+  const std::string ColumnName(int i) const override {
+    return wrapped_cursor_->ColumnName(i);
+  }
+
+  const zetasql::Value ColumnValue(int i) const override {
+    return wrapped_cursor_->ColumnValue(i);
+  }
+
+  const zetasql::Type* ColumnType(int i) const override {
+    return wrapped_cursor_->ColumnType(i);
+  }
+
+ private:
+  std::unique_ptr<RowCursor> wrapped_cursor_;
+
+  // Number of columns requested by the caller.
+  const int num_columns_;
+
+  // Positions and sort orders of the key columns of the indexed table in the
+  // rows of wrapped_cursor_.
+  const std::vector<std::pair<int, bool>> key_columns_;
+
+  const KeyRange range_;
+};
+
+// A RowCursor which counts the rows returned by a wrapped cursor.
+class CountingRowCursor : public RowCursor {
+ public:
+  CountingRowCursor(std::unique_ptr<RowCursor> wrapped_cursor,
+                    int64_t* num_rows)
+      : wrapped_cursor_(std::move(wrapped_cursor)), num_rows_(num_rows) {}
+
+  bool Next() override {
+    if (!wrapped_cursor_->Next()) {
+      return false;
+    }
+    ++*num_rows_;
+    return true;
+  }
+
+  absl::Status Status() const override { return wrapped_cursor_->Status(); }
+
+  int NumColumns() const override { return wrapped_cursor_->NumColumns(); }
+
+  const std::string ColumnName(int i) const override {
+    return wrapped_cursor_->ColumnName(i);
+  }
+
+  const zetasql::Value ColumnValue(int i) const override {
+    return wrapped_cursor_->ColumnValue(i);
+  }
+
+  const zetasql::Type* ColumnType(int i) const override {
+    return wrapped_cursor_->ColumnType(i);
+  }
+
+ private:
+  std::unique_ptr<RowCursor> wrapped_cursor_;
+  int64_t* num_rows_;
+};
+
+// A RowCursor which charges the rows returned by a wrapped cursor to a budget,
+// and fails once the budget is spent.
+class BudgetedRowCursor : public RowCursor {
+ public:
+  BudgetedRowCursor(std::unique_ptr<RowCursor> wrapped_cursor,
+                    RowBudget* budget)
+      : wrapped_cursor_(std::move(wrapped_cursor)), budget_(budget) {}
+
+  bool Next() override {
+    if (!status_.ok() || !wrapped_cursor_->Next()) {
+      return false;
+    }
+    if (!budget_->Consume()) {
+      status_ = error::TooManyRowsScanned(budget_->max_rows());
+      return false;
+    }
+    return true;
+  }
+
+  absl::Status Status() const override {
+    return status_.ok() ? wrapped_cursor_->Status() : status_;
+  }
+
+  int NumColumns() const override { return wrapped_cursor_->NumColumns(); }
+
+  const std::string ColumnName(int i) const override {
+    return wrapped_cursor_->ColumnName(i);
+  }
+
+  const zetasql::Value ColumnValue(int i) const override {
+    return wrapped_cursor_->ColumnValue(i);
+  }
+
+  const zetasql::Type* ColumnType(int i) const override {
+    return wrapped_cursor_->ColumnType(i);
+  }
+
+ private:
+  std::unique_ptr<RowCursor> wrapped_cursor_;
+  RowBudget* budget_;
+  absl::Status status_;
+};
+
+}  // namespace
+
+absl::Status ForwardingRowReader::Read(const ReadArg& read_arg,
+                                      std::unique_ptr<RowCursor>* cursor) {
+  ZETASQL_RETURN_IF_ERROR(ReadPartition(read_arg, cursor));
+  WrapCursor(read_arg.table, cursor);
+  return absl::OkStatus();
+}
+
+absl::Status ForwardingRowReader::ReadInterleaved(
+    const ReadArg& parent_arg, const ReadArg& child_arg,
+    std::unique_ptr<RowCursor>* parent_cursor,
+    std::unique_ptr<RowCursor>* child_cursor) {
+  if (partitioned_table_ != nullptr &&
+      (parent_arg.table == partitioned_table_->Name() ||
+       child_arg.table == partitioned_table_->Name())) {
+    return RowReader::ReadInterleaved(parent_arg, child_arg, parent_cursor,
+                                      child_cursor);
+  }
+  ZETASQL_RETURN_IF_ERROR(target_->ReadInterleaved(parent_arg, child_arg,
+                                           parent_cursor, child_cursor));
+  WrapCursor(parent_arg.table, parent_cursor);
+  WrapCursor(child_arg.table, child_cursor);
+  return absl::OkStatus();
+}
+
+void ForwardingRowReader::WrapCursor(const std::string& table,
+                                     std::unique_ptr<RowCursor>* cursor) {
+  if (profile_ != nullptr) {
+    *cursor = absl::make_unique<CountingRowCursor>(
+        std::move(*cursor), profile_->mutable_rows_scanned(table));
+  }
+  if (row_budget_ != nullptr) {
+    *cursor =
+        absl::make_unique<BudgetedRowCursor>(std::move(*cursor), row_budget_);
+  }
+  if (cancellation_ != nullptr) {
+    *cursor = absl::make_unique<CancellableRowCursor>(std::move(*cursor),
+                                                      cancellation_);
+  }
+}
+
+absl::Status ForwardingRowReader::ReadPartition(
+    const ReadArg& read_arg, std::unique_ptr<RowCursor>* cursor) {
+  if (partitioned_table_ == nullptr ||
+      read_arg.table != partitioned_table_->Name()) {
+    return target_->Read(read_arg, cursor);
+  }
+  if (read_arg.index.empty()) {
+    ReadArg partitioned_read_arg = read_arg;
+    partitioned_read_arg.key_set =
+        IntersectKeySet(read_arg.key_set, partition_range_);
+    return target_->Read(partitioned_read_arg, cursor);
+  }
+
+  // Index keys are unrelated to the partition range, so the rows read from the
+  // index are filtered by the table key stored with them instead.
+  ReadArg index_read_arg = read_arg;
+  std::vector<std::pair<int, bool>> key_columns;
+  for (const KeyColumn* key_column : partitioned_table_->primary_key()) {
+    const std::string& name = key_column->column()->Name();
+    auto itr =
+        std::find(read_arg.columns.begin(), read_arg.columns.end(), name);
+    if (itr != read_arg.columns.end()) {
+      key_columns.emplace_back(itr - read_arg.columns.begin(),
+                               key_column->is_descending());
+    } else {
+      key_columns.emplace_back(index_read_arg.columns.size(),
+                               key_column->is_descending());
+      index_read_arg.columns.push_back(name);
+    }
+  }
+  std::unique_ptr<RowCursor> index_cursor;
+  ZETASQL_RETURN_IF_ERROR(target_->Read(index_read_arg, &index_cursor));
+  *cursor = absl::make_unique<KeyRangeFilteredRowCursor>(
+      std::move(index_cursor), read_arg.columns.size(), std::move(key_columns),
+      partition_range_);
+  return absl::OkStatus();
+}
+
+std::unique_ptr<CachedQuery> QueryCache::Acquire(const Schema* schema,
+                                                 const std::string& key) {
+  absl::MutexLock lock(&mu_);
+  auto itr = entries_.find(Key(schema, key));
+  if (itr == entries_.end()) {
+    return nullptr;
+  }
+  std::vector<std::unique_ptr<CachedQuery>>& queries = itr->second.queries;
+  std::unique_ptr<CachedQuery> query = std::move(queries.back());
+  queries.pop_back();
+  if (queries.empty()) {
+    lru_.erase(itr->second.lru_position);
+    entries_.erase(itr);
+  }
+  return query;
+}
+
+void QueryCache::Release(const Schema* schema, const std::string& key,
+                         std::unique_ptr<CachedQuery> query) {
+  query->reader.set_target(nullptr);
+  absl::MutexLock lock(&mu_);
+  if (capacity_ <= 0 || query->generation != generation_) {
+    return;
+  }
+
+  // Add the query to the instances released for the same key, unless there are
+  // enough of them already, and mark them as the most recently used.
+  Key cache_key(schema, key);
+  auto itr = entries_.find(cache_key);
+  if (itr != entries_.end()) {
+    if (itr->second.queries.size() <
+        static_cast<size_t>(max_queries_per_key_)) {
+      itr->second.queries.push_back(std::move(query));
+    }
+    lru_.splice(lru_.begin(), lru_, itr->second.lru_position);
+    return;
+  }
+
+  if (entries_.size() >= static_cast<size_t>(capacity_)) {
+    entries_.erase(lru_.back());
+    lru_.pop_back();
+  }
+  lru_.push_front(cache_key);
+  Entry& entry = entries_[std::move(cache_key)];
+  entry.queries.push_back(std::move(query));
+  entry.lru_position = lru_.begin();
+}
+
+void QueryCache::Clear() {
+  absl::MutexLock lock(&mu_);
+  ++generation_;
+  entries_.clear();
+  lru_.clear();
+}
+
+int64_t QueryCache::generation() const {
+  absl::MutexLock lock(&mu_);
+  return generation_;
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,293 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_QUERY_CACHE_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_QUERY_CACHE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/analyzer.h"
+#include "zetasql/public/evaluator.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "backend/access/read.h"
+#include "backend/common/case.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/query/catalog.h"
+#include "backend/query/external_sort.h"
+#include "backend/query/filtered_table.h"
+#include "backend/query/folding_rewriter.h"
+#include "backend/query/query_profile.h"
+#include "backend/schema/catalog/schema.h"
+#include "backend/schema/catalog/table.h"
+#include "common/cancellation.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// RowBudget bounds the number of rows returned by the reads of a query. It is
+// shared by the readers of the partitions of a query evaluated in parallel.
+//
+// This class is thread-safe.
+class RowBudget {
+ public:
+  explicit RowBudget(int64_t max_rows)
+      : max_rows_(max_rows), remaining_rows_(max_rows) {}
+
+  // Consumes one row of the budget. Returns false once the budget is spent.
+  bool Consume() {
+    return remaining_rows_.fetch_sub(1, std::memory_order_relaxed) > 0;
+  }
+
+  int64_t max_rows() const { return max_rows_; }
+
+  // Returns the number of rows consumed, up to max_rows().
+  int64_t rows_consumed() const {
+    const int64_t remaining = remaining_rows_.load(std::memory_order_relaxed);
+    return max_rows_ - std::max<int64_t>(0, remaining);
+  }
+
+ private:
+  const int64_t max_rows_;
+  std::atomic<int64_t> remaining_rows_;
+};
+
+// ForwardingRowReader forwards reads to a target reader which can be changed
+// between uses, so that tables bound to it can be read by different
+// transactions.
+class ForwardingRowReader : public RowReader {
+ public:
+  // Sets the reader to forward reads to, and lifts any partition restriction
+  // and stops counting rows read.
+  void set_target(RowReader* target) {
+    target_ = target;
+    partitioned_table_ = nullptr;
+    profile_ = nullptr;
+    row_budget_ = nullptr;
+    cancellation_ = nullptr;
+  }
+
+  // Restricts forwarded reads of `table`, and of its indexes, to rows whose
+  // primary key is in `range`. Reads of other tables are forwarded unchanged.
+  // Has no effect if `table` is null.
+  void set_partition(const Table* table, const KeyRange& range) {
+    partitioned_table_ = table;
+    partition_range_ = range;
+  }
+
+  // Counts the rows returned by forwarded reads in `profile`, by table. Has no
+  // effect if `profile` is null.
+  void set_profile(QueryProfile* profile) { profile_ = profile; }
+
+  // Charges the rows returned by forwarded reads to `budget`, failing the
+  // reads with RESOURCE_EXHAUSTED once it is spent. Has no effect if `budget`
+  // is null.
+  void set_row_budget(RowBudget* budget) { row_budget_ = budget; }
+
+  // Fails forwarded reads with the status of `cancellation` once it is
+  // cancelled. Has no effect if `cancellation` is null.
+  void set_cancellation(const CancellationToken* cancellation) {
+    cancellation_ = cancellation;
+  }
+
+  absl::Status Read(const ReadArg& read_arg,
+                    std::unique_ptr<RowCursor>* cursor) override;
+
+  // Reads of the partitioned table are made separately, as by Read.
+  absl::Status ReadInterleaved(
+      const ReadArg& parent_arg, const ReadArg& child_arg,
+      std::unique_ptr<RowCursor>* parent_cursor,
+      std::unique_ptr<RowCursor>* child_cursor) override;
+
+ private:
+  // Forwards a read, restricting it to the partition range if needed.
+  absl::Status ReadPartition(const ReadArg& read_arg,
+                             std::unique_ptr<RowCursor>* cursor);
+
+  // Wraps the cursor of a forwarded read of `table` to count its rows, charge
+  // them to the row budget and check for cancellation, as set.
+  void WrapCursor(const std::string& table, std::unique_ptr<RowCursor>* cursor);
+
+  RowReader* target_ = nullptr;
+
+  // Table whose reads are restricted to partition_range_, if not null.
+  const Table* partitioned_table_ = nullptr;
+  KeyRange partition_range_;
+
+  // Profile counting the rows read, if not null.
+  QueryProfile* profile_ = nullptr;
+
+  // Budget the rows read are charged to, if not null.
+  RowBudget* row_budget_ = nullptr;
+
+  // Cancellation checked by the reads, if not null.
+  const CancellationToken* cancellation_ = nullptr;
+};
+
+// CachedQuery holds a query statement which has been analyzed, validated and
+// prepared for evaluation, along with the catalog it was analyzed against. It
+// can be executed repeatedly with parameters of the same types, but only by
+// one caller at a time. Each execution binds the reader of its transaction to
+// `reader`, so the catalog and prepared statement are shared across requests.
+struct CachedQuery {
+  // Reader of the tables in catalog, forwarding to the reader of the caller
+  // currently executing the query.
+  ForwardingRowReader reader;
+  std::unique_ptr<Catalog> catalog;
+
+  // Tables substituted for joins in resolved_statement by JoinRewriter.
+  std::vector<std::unique_ptr<const zetasql::Table>> joined_tables;
+
+  // Tables substituted for filters and limited table scans in
+  // resolved_statement by FilterRewriter and LimitRewriter, whose parameters
+  // are bound before each execution of the statement.
+  std::vector<std::unique_ptr<FilteredTable>> filtered_tables;
+
+  // Tables substituted for aggregations in resolved_statement by
+  // AggregateRewriter.
+  std::vector<std::unique_ptr<const zetasql::Table>> aggregated_tables;
+
+  std::unique_ptr<const zetasql::AnalyzerOutput> analyzer_output;
+
+  // Undeclared parameters of the statement with the types the analysis
+  // inferred for them, along with the spelling each was last supplied under,
+  // so that repeated executions decode them without case-insensitive lookups.
+  struct UndeclaredParameter {
+    std::string name;
+    const zetasql::Type* type;
+    std::string supplied_name;
+  };
+  std::vector<UndeclaredParameter> undeclared_parameters;
+  std::unique_ptr<zetasql::ResolvedStatement> resolved_statement;
+  std::unique_ptr<zetasql::PreparedQuery> prepared_query;
+
+  // True if the statement is a query whose rows are ordered by an outermost
+  // ORDER BY.
+  bool ordered = false;
+
+  // Columns by which the rows of the query are sorted as they are returned,
+  // if SortRewriter removed its outermost ORDER BY, and the number of columns
+  // of the original query, which precede the added sort columns.
+  std::vector<SortColumn> sort_columns;
+  int num_output_columns = 0;
+
+  // Expressions of the statement replaced with parameters by FoldingRewriter,
+  // evaluated before each execution, and the statement before folding with
+  // its prepared query, executed instead when a folded expression fails.
+  std::vector<FoldedExpression> folded_expressions;
+  std::unique_ptr<zetasql::ResolvedStatement> unfolded_statement;
+  std::unique_ptr<zetasql::PreparedQuery> unfolded_query;
+
+  // True if the current execution of the query executes unfolded_query.
+  bool execute_unfolded = false;
+
+  // True if the rows of the statement only depend on the rows it reads, see
+  // QueryResult::deterministic.
+  bool deterministic = false;
+
+  // Set instead of prepared_query for DML statements, along with the columns
+  // the statement sets to the pending commit timestamp.
+  std::unique_ptr<zetasql::PreparedModify> prepared_modify;
+  CaseInsensitiveStringSet pending_commit_timestamp_columns;
+
+  // Generation of the cache when the query was analyzed.
+  int64_t generation = 0;
+};
+
+// QueryCache is a least recently used cache of CachedQuery objects, keyed by
+// the schema the query was analyzed against and a key describing the SQL text
+// and parameter types of the query.
+//
+// Queries are checked out of the cache while they are being executed, and
+// released back into it once their results have been read. Up to
+// `max_queries_per_key` instances of the same query are kept, so that a query
+// executed concurrently (such as by the partitions of a parallel query) is
+// only analyzed once per concurrent caller.
+//
+// This class is thread-safe.
+class QueryCache {
+ public:
+  explicit QueryCache(int capacity, int max_queries_per_key = 1)
+      : capacity_(capacity), max_queries_per_key_(max_queries_per_key) {}
+
+  // Removes and returns a query cached for `key` against `schema`, or returns
+  // null if there is none.
+  std::unique_ptr<CachedQuery> Acquire(const Schema* schema,
+                                       const std::string& key)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns a query acquired from (or created for) the cache. The query is
+  // discarded if the cache was cleared after it was analyzed, or if as many
+  // instances of it are already cached.
+  void Release(const Schema* schema, const std::string& key,
+               std::unique_ptr<CachedQuery> query) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Discards all cached queries, including the ones currently acquired once
+  // they are released. Called when the schema changes.
+  void Clear() ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the current generation of the cache, to be recorded in queries
+  // created for it.
+  int64_t generation() const ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  using Key = std::pair<const Schema*, std::string>;
+
+  struct Entry {
+    // Instances of the query which are not checked out, most recently released
+    // last.
+    std::vector<std::unique_ptr<CachedQuery>> queries;
+
+    // Position of the key in lru_.
+    std::list<Key>::iterator lru_position;
+  };
+
+  // Maximum number of cached queries, not counting their instances.
+  const int capacity_;
+
+  // Maximum number of cached instances of each query.
+  const int max_queries_per_key_;
+
+  mutable absl::Mutex mu_;
+
+  // Incremented by Clear().
+  int64_t generation_ ABSL_GUARDED_BY(mu_) = 0;
+
+  absl::flat_hash_map<Key, Entry> entries_ ABSL_GUARDED_BY(mu_);
+
+  // Keys of the cached queries, most recently used first.
+  std::list<Key> lru_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_QUERY_CACHE_H_
@@ -0,0 +1,218 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/query/query_cache.h"
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "absl/status/status.h"
+#include "backend/access/read.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/datamodel/key_set.h"
+#include "tests/common/row_reader.h"
+#include "tests/common/schema_constructor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql::values::Int64;
+
+// Records the last read forwarded to it.
+class RecordingRowReader : public RowReader {
+ public:
+  absl::Status Read(const ReadArg& read_arg,
+                    std::unique_ptr<RowCursor>* cursor) override {
+    last_read_arg_ = read_arg;
+    return absl::OkStatus();
+  }
+
+  const ReadArg& last_read_arg() const { return last_read_arg_; }
+
+ private:
+  ReadArg last_read_arg_;
+};
+
+// The cache only compares schema pointers, so any distinct addresses will do.
+const Schema* SchemaAt(intptr_t n) {
+  return reinterpret_cast<const Schema*>(n);
+}
+
+std::unique_ptr<CachedQuery> NewQuery(const QueryCache& cache) {
+  auto query = std::make_unique<CachedQuery>();
+  query->generation = cache.generation();
+  return query;
+}
+
+TEST(QueryCacheTest, AcquireMissesEmptyCache) {
+  QueryCache cache(/*capacity=*/2);
+  EXPECT_EQ(cache.Acquire(SchemaAt(1), "SELECT 1"), nullptr);
+}
+
+TEST(QueryCacheTest, AcquireChecksOutReleasedQuery) {
+  QueryCache cache(/*capacity=*/2);
+  std::unique_ptr<CachedQuery> query = NewQuery(cache);
+  CachedQuery* released = query.get();
+  cache.Release(SchemaAt(1), "SELECT 1", std::move(query));
+
+  EXPECT_EQ(cache.Acquire(SchemaAt(1), "SELECT 1").get(), released);
+  EXPECT_EQ(cache.Acquire(SchemaAt(1), "SELECT 1"), nullptr);
+}
+
+TEST(QueryCacheTest, QueriesAreKeyedBySchemaAndKey) {
+  QueryCache cache(/*capacity=*/2);
+  cache.Release(SchemaAt(1), "SELECT 1", NewQuery(cache));
+
+  EXPECT_EQ(cache.Acquire(SchemaAt(2), "SELECT 1"), nullptr);
+  EXPECT_EQ(cache.Acquire(SchemaAt(1), "SELECT 2"), nullptr);
+  EXPECT_NE(cache.Acquire(SchemaAt(1), "SELECT 1"), nullptr);
+}
+
+TEST(QueryCacheTest, EvictsLeastRecentlyUsedQuery) {
+  QueryCache cache(/*capacity=*/2);
+  cache.Release(SchemaAt(1), "SELECT 1", NewQuery(cache));
+  cache.Release(SchemaAt(1), "SELECT 2", NewQuery(cache));
+  cache.Release(SchemaAt(1), "SELECT 1",
+                cache.Acquire(SchemaAt(1), "SELECT 1"));
+  cache.Release(SchemaAt(1), "SELECT 3", NewQuery(cache));
+
+  EXPECT_EQ(cache.Acquire(SchemaAt(1), "SELECT 2"), nullptr);
+  EXPECT_NE(cache.Acquire(SchemaAt(1), "SELECT 1"), nullptr);
+  EXPECT_NE(cache.Acquire(SchemaAt(1), "SELECT 3"), nullptr);
+}
+
+TEST(QueryCacheTest, KeepsFirstReleasedQueryForDuplicateKeys) {
+  QueryCache cache(/*capacity=*/2);
+  std::unique_ptr<CachedQuery> first = NewQuery(cache);
+  CachedQuery* released = first.get();
+  cache.Release(SchemaAt(1), "SELECT 1", std::move(first));
+  cache.Release(SchemaAt(1), "SELECT 1", NewQuery(cache));
+
+  EXPECT_EQ(cache.Acquire(SchemaAt(1), "SELECT 1").get(), released);
+}
+
+TEST(QueryCacheTest, KeepsInstancesOfQueriesExecutedConcurrently) {
+  QueryCache cache(/*capacity=*/1, /*max_queries_per_key=*/2);
+  std::unique_ptr<CachedQuery> first = NewQuery(cache);
+  std::unique_ptr<CachedQuery> second = NewQuery(cache);
+  CachedQuery* released_first = first.get();
+  CachedQuery* released_second = second.get();
+  cache.Release(SchemaAt(1), "SELECT 1", std::move(first));
+  cache.Release(SchemaAt(1), "SELECT 1", std::move(second));
+  cache.Release(SchemaAt(1), "SELECT 1", NewQuery(cache));
+
+  // The most recently released instance is acquired first, and instances
+  // beyond the limit are discarded.
+  EXPECT_EQ(cache.Acquire(SchemaAt(1), "SELECT 1").get(), released_second);
+  EXPECT_EQ(cache.Acquire(SchemaAt(1), "SELECT 1").get(), released_first);
+  EXPECT_EQ(cache.Acquire(SchemaAt(1), "SELECT 1"), nullptr);
+}
+
+TEST(QueryCacheTest, ClearDiscardsCachedAndAcquiredQueries) {
+  QueryCache cache(/*capacity=*/2);
+  cache.Release(SchemaAt(1), "SELECT 1", NewQuery(cache));
+  std::unique_ptr<CachedQuery> acquired = NewQuery(cache);
+
+  cache.Clear();
+  cache.Release(SchemaAt(1), "SELECT 2", std::move(acquired));
+
+  EXPECT_EQ(cache.Acquire(SchemaAt(1), "SELECT 1"), nullptr);
+  EXPECT_EQ(cache.Acquire(SchemaAt(1), "SELECT 2"), nullptr);
+
+  cache.Release(SchemaAt(1), "SELECT 2", NewQuery(cache));
+  EXPECT_NE(cache.Acquire(SchemaAt(1), "SELECT 2"), nullptr);
+}
+
+TEST(ForwardingRowReaderTest, RestrictsReadsOfPartitionedTable) {
+  zetasql::TypeFactory type_factory;
+  std::unique_ptr<const Schema> schema =
+      test::CreateSchemaWithOneTable(&type_factory);
+  RecordingRowReader target;
+  ForwardingRowReader reader;
+  reader.set_target(&target);
+  reader.set_partition(schema->FindTable("test_table"),
+                       KeyRange::ClosedOpen(Key({Int64(1)}), Key({Int64(5)})));
+
+  ReadArg read_arg;
+  read_arg.table = "test_table";
+  read_arg.key_set = KeySet(KeyRange::All());
+  std::unique_ptr<RowCursor> cursor;
+  ZETASQL_ASSERT_OK(reader.Read(read_arg, &cursor));
+  EXPECT_THAT(target.last_read_arg().key_set.ranges(),
+              testing::ElementsAre(KeyRange::ClosedOpen(Key({Int64(1)}),
+                                                        Key({Int64(5)}))));
+
+  // Reads of other tables, and reads after the target is reset, are not
+  // restricted.
+  read_arg.table = "other_table";
+  ZETASQL_ASSERT_OK(reader.Read(read_arg, &cursor));
+  EXPECT_THAT(target.last_read_arg().key_set.ranges(),
+              testing::ElementsAre(KeyRange::All()));
+
+  reader.set_target(&target);
+  read_arg.table = "test_table";
+  ZETASQL_ASSERT_OK(reader.Read(read_arg, &cursor));
+  EXPECT_THAT(target.last_read_arg().key_set.ranges(),
+              testing::ElementsAre(KeyRange::All()));
+}
+
+TEST(ForwardingRowReaderTest, FiltersIndexReadsOfPartitionedTable) {
+  zetasql::TypeFactory type_factory;
+  std::unique_ptr<const Schema> schema =
+      test::CreateSchemaWithOneTable(&type_factory);
+  test::TestRowReader target{
+      {{"test_table",
+        {{"int64_col", "string_col"},
+         {zetasql::types::Int64Type(), zetasql::types::StringType()},
+         {{Int64(1), zetasql::values::String("a")},
+          {Int64(7), zetasql::values::String("b")}}}}}};
+  ForwardingRowReader reader;
+  reader.set_target(&target);
+  reader.set_partition(schema->FindTable("test_table"),
+                       KeyRange::ClosedOpen(Key({Int64(1)}), Key({Int64(5)})));
+
+  ReadArg read_arg;
+  read_arg.table = "test_table";
+  read_arg.index = "test_index";
+  read_arg.key_set = KeySet(KeyRange::All());
+  read_arg.columns = {"string_col"};
+  std::unique_ptr<RowCursor> cursor;
+  ZETASQL_ASSERT_OK(reader.Read(read_arg, &cursor));
+
+  // Only the row whose table key is in the partition is returned, without the
+  // key column read to filter it.
+  ASSERT_TRUE(cursor->Next());
+  ASSERT_EQ(cursor->NumColumns(), 1);
+  EXPECT_EQ(cursor->ColumnValue(0).string_value(), "a");
+  EXPECT_FALSE(cursor->Next());
+  ZETASQL_EXPECT_OK(cursor->Status());
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -16,6 +16,10 @@
 
 #include "backend/query/query_engine.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
 #include <memory>
 #include <string>
 #include <utility>
@@ -30,29 +34,49 @@
 #include "zetasql/public/parse_helpers.h"
 #include "zetasql/public/type.h"
 #include "zetasql/public/value.h"
+#include "zetasql/public/value.pb.h"
 #include "zetasql/resolved_ast/resolved_ast.h"
 #include "zetasql/resolved_ast/resolved_node_kind.pb.h"
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "zetasql/base/statusor.h"
 #include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "backend/access/read.h"
 #include "backend/access/write.h"
 #include "backend/common/case.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_set.h"
 #include "backend/datamodel/value.h"
+#include "backend/query/aggregate_rewriter.h"
 #include "backend/query/analyzer_options.h"
 #include "backend/query/catalog.h"
-#include "backend/query/feature_filter/query_size_limits_checker.h"
+#include "backend/query/external_sort.h"
 #include "backend/query/hint_rewriter.h"
-#include "backend/query/index_hint_validator.h"
+#include "backend/query/filter_rewriter.h"
+#include "backend/query/folding_rewriter.h"
+#include "backend/query/join_rewriter.h"
+#include "backend/query/limit_rewriter.h"
 #include "backend/query/partitionability_validator.h"
 #include "backend/query/partitioned_dml_validator.h"
+#include "backend/query/query_cache.h"
+#include "backend/query/query_profile.h"
 #include "backend/query/query_engine_options.h"
+#include "backend/query/query_result_cache.h"
+#include "backend/query/query_stats.h"
 #include "backend/query/query_validator.h"
+#include "backend/query/sort_rewriter.h"
+#include "backend/transaction/row_cursor.h"
+#include "common/cancellation.h"
 #include "common/constants.h"
 #include "common/errors.h"
+#include "common/executor.h"
 #include "common/limits.h"
+#include "common/metrics.h"
+#include "common/slow_log.h"
+#include "common/trace.h"
 #include "frontend/converters/values.h"
 #include "zetasql/base/ret_check.h"
 #include "absl/status/status.h"
@@ -73,23 +97,109 @@ bool IsDMLQuery(const std::string& query) {
 
 namespace {
 
-// A RowCursor backed by vectors (one per each row) of values.
-class VectorsRowCursor : public RowCursor {
+// Maximum number of rows modified by a DML statement which are buffered into a
+// single mutation before being written, bounding the memory used to build the
+// mutations of large statements.
+constexpr int kRowsPerDmlMutation = 1024;
+
+// A RowCursor which evaluates the rows of a query as they are read, rather
+// than materializing the whole result upfront. It holds the cached query being
+// executed and returns it to the cache once the cursor is destroyed.
+class QueryRowCursor : public RowCursor {
  public:
-  VectorsRowCursor(
-      const std::vector<std::string> column_names,
-      const std::vector<const zetasql::Type*> column_types,
-      const std::vector<std::vector<zetasql::Value>> column_values)
-      : column_names_(column_names),
-        column_types_(column_types),
-        column_values_(column_values) {
-    assert(column_names_.size() == column_types_.size());
-    for (int i = 0; i < column_values.size(); ++i) {
-      assert(column_names_.size() == column_values[i].size());
+  QueryRowCursor(QueryCache* cache, const Schema* schema, std::string cache_key,
+                 std::unique_ptr<CachedQuery> query,
+                 zetasql::ParameterValueMap params,
+                 std::unique_ptr<zetasql::EvaluatorTableIterator> iterator,
+                 absl::Time evaluation_start, absl::Duration evaluation_time,
+                 QueryProfile* profile)
+      : cache_(cache),
+        schema_(schema),
+        cache_key_(std::move(cache_key)),
+        query_(std::move(query)),
+        params_(std::move(params)),
+        iterator_(std::move(iterator)),
+        track_evaluation_time_(metrics::Enabled() || trace::Active()),
+        evaluation_start_(evaluation_start),
+        evaluation_time_(evaluation_time),
+        profile_(profile) {}
+
+  ~QueryRowCursor() override {
+    // The iterator refers to the query, so it is destroyed before the query is
+    // released for reuse.
+    iterator_.reset();
+    cache_->Release(schema_, cache_key_, std::move(query_));
+    if (metrics::Enabled()) {
+      static metrics::Histogram* const evaluate_latency =
+          metrics::StageLatency("evaluate");
+      evaluate_latency->Record(evaluation_time_);
+    }
+    if (track_evaluation_time_) {
+      trace::RecordSpan("Evaluate", evaluation_start_, evaluation_time_);
+    }
+  }
+
+  bool Next() override {
+    ScopedCpuTimeRecorder cpu_time_recorder(profile_);
+    if (!track_evaluation_time_) {
+      return iterator_->NextRow();
     }
+    absl::Time start = absl::Now();
+    bool has_row = iterator_->NextRow();
+    evaluation_time_ += absl::Now() - start;
+    return has_row;
   }
 
-  bool Next() override { return ++row_index_ < column_values_.size(); }
+  absl::Status Status() const override { return iterator_->Status(); }
+
+  int NumColumns() const override { return iterator_->NumColumns(); }
+
+  const std::string ColumnName(int i) const override {
+    return iterator_->GetColumnName(i);
+  }
+
+  const zetasql::Type* ColumnType(int i) const override {
+    return iterator_->GetColumnType(i);
+  }
+
+  const zetasql::Value ColumnValue(int i) const override {
+    return iterator_->GetValue(i);
+  }
+
+ private:
+  QueryCache* cache_;
+  const Schema* schema_;
+  const std::string cache_key_;
+  std::unique_ptr<CachedQuery> query_;
+  zetasql::ParameterValueMap params_;
+  std::unique_ptr<zetasql::EvaluatorTableIterator> iterator_;
+
+  // True if the evaluation time is tracked, which is the case if metrics are
+  // enabled or the request is being traced.
+  const bool track_evaluation_time_;
+
+  // Time at which the evaluation of the query started.
+  const absl::Time evaluation_start_;
+
+  // Time spent evaluating the query so far, if tracked.
+  absl::Duration evaluation_time_;
+
+  // Profile of the query, if requested.
+  QueryProfile* profile_;
+};
+
+// A RowCursor over rows which have already been evaluated, such as the rows of
+// the partitions of a query evaluated in parallel.
+class MaterializedRowCursor : public RowCursor {
+ public:
+  MaterializedRowCursor(std::vector<std::string> column_names,
+                        std::vector<const zetasql::Type*> column_types,
+                        std::vector<std::vector<zetasql::Value>> rows)
+      : column_names_(std::move(column_names)),
+        column_types_(std::move(column_types)),
+        rows_(std::move(rows)) {}
+
+  bool Next() override { return ++row_ < static_cast<int64_t>(rows_.size()); }
 
   absl::Status Status() const override { return absl::OkStatus(); }
 
@@ -104,20 +214,208 @@ class VectorsRowCursor : public RowCursor {
   }
 
   const zetasql::Value ColumnValue(int i) const override {
-    return column_values_[row_index_][i];
+    return rows_[row_][i];
+  }
+
+  bool NextBatch(int max_rows, RowBatch* batch) override {
+    batch->Reset(NumColumns());
+    while (batch->num_rows < max_rows &&
+           row_ + 1 < static_cast<int64_t>(rows_.size())) {
+      const std::vector<zetasql::Value>& row = rows_[++row_];
+      for (int i = 0; i < row.size(); ++i) {
+        batch->AddValue(i, row[i]);
+      }
+      ++batch->num_rows;
+    }
+    return batch->num_rows > 0;
+  }
+
+ private:
+  const std::vector<std::string> column_names_;
+  const std::vector<const zetasql::Type*> column_types_;
+  const std::vector<std::vector<zetasql::Value>> rows_;
+
+  // Index of the current row, or -1 before the first call to Next().
+  int64_t row_ = -1;
+};
+
+// The resources a query is charged for by the limits of its engine, which are
+// held until its rows are read.
+struct QueryCharge {
+  explicit QueryCharge(std::atomic<int>* num_running_queries)
+      : num_running_queries(num_running_queries) {}
+  ~QueryCharge() {
+    if (num_running_queries != nullptr) {
+      num_running_queries->fetch_sub(1);
+    }
+  }
+
+  QueryCharge(const QueryCharge&) = delete;
+  QueryCharge& operator=(const QueryCharge&) = delete;
+
+  // Running queries of the engine, which the query counts towards if not
+  // null.
+  std::atomic<int>* const num_running_queries;
+
+  // Budget of the rows read by the query, unlimited unless the engine limits
+  // the rows scanned.
+  std::unique_ptr<RowBudget> row_budget;
+};
+
+// Returns the approximate bytes of the values of the current row of `cursor`.
+int64_t RowBytes(const RowCursor& cursor) {
+  int64_t bytes = 0;
+  for (int i = 0; i < cursor.NumColumns(); ++i) {
+    bytes += cursor.ColumnValue(i).physical_byte_size();
+  }
+  return bytes;
+}
+
+// A RowCursor over the rows of a query which holds the query's charge until it
+// is destroyed, and then records the execution of the query in its engine's
+// QueryStats.
+class ChargedRowCursor : public RowCursor {
+ public:
+  ChargedRowCursor(std::unique_ptr<QueryCharge> charge,
+                   std::unique_ptr<RowCursor> rows, QueryStats* query_stats,
+                   std::string sql, absl::Time start)
+      : charge_(std::move(charge)),
+        rows_(std::move(rows)),
+        query_stats_(query_stats),
+        sql_(std::move(sql)),
+        start_(start) {}
+
+  ~ChargedRowCursor() override {
+    execution_.latency = absl::Now() - start_;
+    execution_.rows_scanned = charge_->row_budget->rows_consumed();
+    execution_.failed = !rows_->Status().ok();
+    query_stats_->Record(sql_, execution_);
+  }
+
+  bool Next() override {
+    if (!rows_->Next()) {
+      return false;
+    }
+    ++execution_.rows_returned;
+    execution_.bytes_returned += RowBytes(*rows_);
+    return true;
+  }
+
+  absl::Status Status() const override { return rows_->Status(); }
+
+  int NumColumns() const override { return rows_->NumColumns(); }
+
+  const std::string ColumnName(int i) const override {
+    return rows_->ColumnName(i);
+  }
+
+  const zetasql::Type* ColumnType(int i) const override {
+    return rows_->ColumnType(i);
+  }
+
+  const zetasql::Value ColumnValue(int i) const override {
+    return rows_->ColumnValue(i);
+  }
+
+  bool NextBatch(int max_rows, RowBatch* batch) override {
+    if (!rows_->NextBatch(max_rows, batch)) {
+      return false;
+    }
+    execution_.rows_returned += batch->num_rows;
+    for (const ColumnVector& column : batch->columns) {
+      for (const zetasql::Value& value : column.values) {
+        execution_.bytes_returned += value.physical_byte_size();
+      }
+    }
+    return true;
   }
 
  private:
-  size_t row_index_ = -1;
-  std::vector<std::string> column_names_;
-  std::vector<const zetasql::Type*> column_types_;
-  std::vector<std::vector<zetasql::Value>> column_values_;
+  // Declared before the rows, which read through its row budget, so that it
+  // is released once they are destroyed.
+  std::unique_ptr<QueryCharge> charge_;
+  std::unique_ptr<RowCursor> rows_;
+
+  QueryStats* const query_stats_;
+  const std::string sql_;
+  const absl::Time start_;
+  QueryExecution execution_;
+};
+
+// The rows of one partition of a query evaluated in parallel.
+struct PartitionResult {
+  std::vector<std::string> column_names;
+  std::vector<const zetasql::Type*> column_types;
+  std::vector<std::vector<zetasql::Value>> rows;
 };
 
+// Reads all the rows of `cursor` into `result`.
+absl::Status MaterializeRows(RowCursor* cursor, PartitionResult* result) {
+  for (int i = 0; i < cursor->NumColumns(); ++i) {
+    result->column_names.push_back(cursor->ColumnName(i));
+    result->column_types.push_back(cursor->ColumnType(i));
+  }
+  while (cursor->Next()) {
+    std::vector<zetasql::Value> row;
+    row.reserve(cursor->NumColumns());
+    for (int i = 0; i < cursor->NumColumns(); ++i) {
+      row.push_back(cursor->ColumnValue(i));
+    }
+    result->rows.push_back(std::move(row));
+  }
+  return cursor->Status();
+}
+
+// Returns the key under which a query is cached. Analysis depends on the SQL
+// text and the types of the declared parameters, but not on their values.
+std::string QueryCacheKey(const Query& query) {
+  std::string key = query.sql;
+  for (const auto& [name, value] : query.declared_params) {
+    absl::StrAppend(&key, "\n@", name, ":", value.type()->DebugString());
+  }
+  return key;
+}
+
+// Returns the key under which the rows of a query are cached. Unlike
+// QueryCacheKey, it depends on the values of the parameters, each of which is
+// prefixed with its length so that no two sets of values share a key.
+zetasql_base::StatusOr<std::string> ResultCacheKey(const Query& query) {
+  std::string key = query.sql;
+  for (const auto& [name, value] : query.declared_params) {
+    zetasql::ValueProto value_proto;
+    ZETASQL_RETURN_IF_ERROR(value.Serialize(&value_proto));
+    const std::string serialized = value_proto.SerializeAsString();
+    absl::StrAppend(&key, "\n@", name, ":", value.type()->DebugString(), "=",
+                    serialized.size(), ":", serialized);
+  }
+  for (const auto& [name, value] : query.undeclared_params) {
+    const std::string serialized = value.ShortDebugString();
+    absl::StrAppend(&key, "\n@", name, "=", serialized.size(), ":",
+                    serialized);
+  }
+  return key;
+}
+
+// Returns true if the rows of `statement` only depend on the rows it reads.
+bool IsDeterministicQuery(const zetasql::ResolvedStatement& statement) {
+  return IsDeterministic(statement);
+}
+
+// Returns true if `statement` is a query whose rows are ordered.
+bool IsOrderedQuery(const zetasql::ResolvedStatement& statement) {
+  return statement.node_kind() == zetasql::RESOLVED_QUERY_STMT &&
+         statement.GetAs<zetasql::ResolvedQueryStmt>()->query()->is_ordered();
+}
+
+// Returns the options of the evaluator of statements. If `max_memory_bytes` is
+// positive, it bounds the memory of the intermediate results of statements.
 zetasql::EvaluatorOptions CommonEvaluatorOptions(
-    zetasql::TypeFactory* type_factory) {
+    zetasql::TypeFactory* type_factory, int64_t max_memory_bytes) {
   zetasql::EvaluatorOptions options;
   options.type_factory = type_factory;
+  if (max_memory_bytes > 0) {
+    options.max_intermediate_byte_size = max_memory_bytes;
+  }
   absl::TimeZone time_zone;
   absl::LoadTimeZone(kDefaultTimeZone, &time_zone);
   options.default_time_zone = time_zone;
@@ -149,6 +447,10 @@ zetasql_base::StatusOr<std::unique_ptr<const zetasql::AnalyzerOutput>> Analyze(
   ZETASQL_ASSIGN_OR_RETURN(auto options, MakeAnalyzerOptionsWithParameters(params));
   options.set_prune_unused_columns(prune_unused_columns);
 
+  static metrics::Histogram* const analyze_latency =
+      metrics::StageLatency("analyze");
+  metrics::ScopedLatencyRecorder recorder(analyze_latency);
+  trace::ScopedSpan span("Analyze");
   std::unique_ptr<const zetasql::AnalyzerOutput> output;
   ZETASQL_RETURN_IF_ERROR(zetasql::AnalyzeStatement(sql, options, catalog,
                                               type_factory, &output));
@@ -177,92 +479,90 @@ absl::Status MaybeTransformZetaSQLDMLError(absl::Status error) {
   return error;
 }
 
-// Builds a INSERT mutation and returns it along with a count of inserted rows.
-std::pair<Mutation, int64_t> BuildInsert(
+// Writes the rows produced by an INSERT or UPDATE statement to `writer`, in
+// mutations of at most kRowsPerDmlMutation rows, and returns the number of
+// written rows.
+zetasql_base::StatusOr<int64_t> WriteInsertOrUpdate(
     std::unique_ptr<zetasql::EvaluatorTableModifyIterator> iterator,
-    MutationOpType op_type,
-    const CaseInsensitiveStringSet& pending_ts_columns) {
+    MutationOpType op_type, const CaseInsensitiveStringSet& pending_ts_columns,
+    RowWriter* writer) {
   const zetasql::Table* table = iterator->table();
   std::vector<std::string> column_names;
+  std::vector<bool> is_pending_ts_column;
   column_names.reserve(table->NumColumns());
   for (int i = 0; i < table->NumColumns(); ++i) {
     column_names.push_back(table->GetColumn(i)->Name());
+    is_pending_ts_column.push_back(
+        pending_ts_columns.find(column_names.back()) !=
+        pending_ts_columns.end());
   }
 
+  int64_t num_rows = 0;
   std::vector<ValueList> values;
-  while (iterator->NextRow()) {
-    values.emplace_back();
-    for (int i = 0; i < table->NumColumns(); ++i) {
-      if (pending_ts_columns.find(column_names[i]) !=
-          pending_ts_columns.end()) {
-        values.back().push_back(
-            zetasql::Value::StringValue(kCommitTimestampIdentifier));
-      } else {
-        values.back().push_back(iterator->GetColumnValue(i));
+  bool has_row = true;
+  while (has_row) {
+    has_row = iterator->NextRow();
+    if (has_row) {
+      values.emplace_back();
+      for (int i = 0; i < table->NumColumns(); ++i) {
+        if (is_pending_ts_column[i]) {
+          values.back().push_back(
+              zetasql::Value::StringValue(kCommitTimestampIdentifier));
+        } else {
+          values.back().push_back(iterator->GetColumnValue(i));
+        }
       }
+      ++num_rows;
     }
-  }
-
-  Mutation mutation;
-  mutation.AddWriteOp(op_type, table->Name(), column_names, values);
-  return std::make_pair(mutation, values.size());
-}
-
-// Builds a UPDATE mutation and returns it along with a count of updated rows.
-std::pair<Mutation, int64_t> BuildUpdate(
-    std::unique_ptr<zetasql::EvaluatorTableModifyIterator> iterator,
-    MutationOpType op_type,
-    const CaseInsensitiveStringSet& pending_ts_columns) {
-  const zetasql::Table* table = iterator->table();
-  std::vector<std::string> column_names;
-  column_names.reserve(table->NumColumns());
-  for (int i = 0; i < table->NumColumns(); ++i) {
-    column_names.push_back(table->GetColumn(i)->Name());
-  }
-
-  std::vector<ValueList> values;
-  while (iterator->NextRow()) {
-    values.emplace_back();
-    for (int i = 0; i < table->NumColumns(); ++i) {
-      if (pending_ts_columns.find(column_names[i]) !=
-          pending_ts_columns.end()) {
-        values.back().push_back(
-            zetasql::Value::StringValue(kCommitTimestampIdentifier));
-      } else {
-        values.back().push_back(iterator->GetColumnValue(i));
-      }
+    // The last mutation is written even if it is empty so that the statement
+    // constraints are verified.
+    if (!has_row || values.size() == kRowsPerDmlMutation) {
+      Mutation mutation;
+      mutation.AddWriteOp(op_type, table->Name(), column_names,
+                          std::move(values));
+      values.clear();
+      ZETASQL_RETURN_IF_ERROR(writer->WriteBatch(mutation, /*last_batch=*/!has_row));
     }
   }
-
-  Mutation mutation;
-  mutation.AddWriteOp(op_type, table->Name(), column_names, values);
-  return std::make_pair(mutation, values.size());
+  return num_rows;
 }
 
-// Builds a DELETE mutation and returns it along with a count of deleted rows.
-std::pair<Mutation, int64_t> BuildDelete(
-    std::unique_ptr<zetasql::EvaluatorTableModifyIterator> iterator) {
+// Writes the deletions of the rows produced by a DELETE statement to `writer`,
+// in mutations of at most kRowsPerDmlMutation keys, and returns the number of
+// deleted rows.
+zetasql_base::StatusOr<int64_t> WriteDelete(
+    std::unique_ptr<zetasql::EvaluatorTableModifyIterator> iterator,
+    RowWriter* writer) {
   const zetasql::Table* table = iterator->table();
 
+  int64_t num_rows = 0;
   KeySet key_set;
-  if (!table->PrimaryKey().has_value() && iterator->NextRow()) {
-    // There is no primary key in the case of a singleton table. Delete
-    // mutation will contain an empty key set in such a case if there is a row
-    // to be deleted.
-    key_set.AddKey(Key{});
-  } else {
-    while (iterator->NextRow()) {
+  int num_keys = 0;
+  bool has_row = true;
+  while (has_row) {
+    has_row = iterator->NextRow();
+    if (has_row) {
+      // There is no primary key in the case of a singleton table. Delete
+      // mutation will contain an empty key in such a case.
       ValueList key_values;
-      for (int i = 0; i < table->PrimaryKey()->size(); ++i) {
-        key_values.push_back(iterator->GetOriginalKeyValue(i));
+      if (table->PrimaryKey().has_value()) {
+        for (int i = 0; i < table->PrimaryKey()->size(); ++i) {
+          key_values.push_back(iterator->GetOriginalKeyValue(i));
+        }
       }
       key_set.AddKey(Key{key_values});
+      ++num_keys;
+      ++num_rows;
+    }
+    if (!has_row || num_keys == kRowsPerDmlMutation) {
+      Mutation mutation;
+      mutation.AddDeleteOp(table->Name(), key_set);
+      key_set = KeySet();
+      num_keys = 0;
+      ZETASQL_RETURN_IF_ERROR(writer->WriteBatch(mutation, /*last_batch=*/!has_row));
     }
   }
-
-  Mutation mutation;
-  mutation.AddDeleteOp(table->Name(), key_set);
-  return std::make_pair(mutation, key_set.keys().size());
+  return num_rows;
 }
 
 // Returns true if the ResolvedDMLValue is a call to PENDING_COMMIT_TIMESTAMP()
@@ -322,175 +622,269 @@ zetasql_base::StatusOr<CaseInsensitiveStringSet> PendingCommitTimestampColumnsIn
   return pending_ts_columns;
 }
 
-zetasql_base::StatusOr<std::pair<Mutation, int64_t>> EvaluateResolvedInsert(
-    const zetasql::ResolvedInsertStmt* insert_statement,
-    const zetasql::ParameterValueMap& parameters,
-    zetasql::TypeFactory* type_factory) {
-  ZETASQL_ASSIGN_OR_RETURN(auto pending_ts_columns,
-                   PendingCommitTimestampColumnsInInsert(
-                       insert_statement->insert_column_list(),
-                       insert_statement->row_list()));
-
-  auto prepared_insert = absl::make_unique<zetasql::PreparedModify>(
-      insert_statement, CommonEvaluatorOptions(type_factory));
-  ZETASQL_ASSIGN_OR_RETURN(auto analyzer_options,
-                   MakeAnalyzerOptionsWithParameters(parameters));
-  ZETASQL_RETURN_IF_ERROR(prepared_insert->Prepare(analyzer_options));
-
-  auto status_or = prepared_insert->Execute(parameters);
-  if (!status_or.ok()) {
-    return MaybeTransformZetaSQLDMLError(status_or.status());
+// Uses googlesql/public/evaluator to prepare the DML statement of `query`,
+// represented by a resolved AST, for evaluation.
+absl::Status PrepareModify(const zetasql::ParameterValueMap& parameters,
+                           zetasql::TypeFactory* type_factory,
+                           int64_t max_memory_bytes, CachedQuery* query) {
+  static metrics::Histogram* const prepare_latency =
+      metrics::StageLatency("prepare");
+  metrics::ScopedLatencyRecorder recorder(prepare_latency);
+  trace::ScopedSpan span("Prepare");
+  const zetasql::ResolvedStatement* statement =
+      query->resolved_statement.get();
+  switch (statement->node_kind()) {
+    case zetasql::RESOLVED_INSERT_STMT: {
+      const auto* insert_statement =
+          statement->GetAs<zetasql::ResolvedInsertStmt>();
+      ZETASQL_ASSIGN_OR_RETURN(query->pending_commit_timestamp_columns,
+                       PendingCommitTimestampColumnsInInsert(
+                           insert_statement->insert_column_list(),
+                           insert_statement->row_list()));
+      break;
+    }
+    case zetasql::RESOLVED_UPDATE_STMT: {
+      const auto* update_statement =
+          statement->GetAs<zetasql::ResolvedUpdateStmt>();
+      ZETASQL_ASSIGN_OR_RETURN(query->pending_commit_timestamp_columns,
+                       PendingCommitTimestampColumnsInUpdate(
+                           update_statement->update_item_list()));
+      break;
+    }
+    case zetasql::RESOLVED_DELETE_STMT:
+      break;
+    default:
+      ZETASQL_RET_CHECK_FAIL() << "Unsupported support node kind "
+                       << ResolvedNodeKind_Name(statement->node_kind());
   }
-  auto iterator = std::move(status_or).ValueOrDie();
-  return BuildInsert(std::move(iterator), MutationOpType::kInsert,
-                     pending_ts_columns);
-}
 
-zetasql_base::StatusOr<std::pair<Mutation, int64_t>> EvaluateResolvedUpdate(
-    const zetasql::ResolvedUpdateStmt* update_statement,
-    const zetasql::ParameterValueMap& parameters,
-    zetasql::TypeFactory* type_factory) {
-  ZETASQL_ASSIGN_OR_RETURN(auto pending_ts_columns,
-                   PendingCommitTimestampColumnsInUpdate(
-                       update_statement->update_item_list()));
-
-  auto prepared_update = absl::make_unique<zetasql::PreparedModify>(
-      update_statement, CommonEvaluatorOptions(type_factory));
+  query->prepared_modify = absl::make_unique<zetasql::PreparedModify>(
+      statement, CommonEvaluatorOptions(type_factory, max_memory_bytes));
   ZETASQL_ASSIGN_OR_RETURN(auto analyzer_options,
                    MakeAnalyzerOptionsWithParameters(parameters));
-  ZETASQL_RETURN_IF_ERROR(prepared_update->Prepare(analyzer_options));
+  return query->prepared_modify->Prepare(analyzer_options);
+}
 
-  auto status_or = prepared_update->Execute(parameters);
+// Evaluates the DML statement prepared for `query`, writes the modified rows to
+// `writer` and returns the count of modified rows. The CPU time spent is added
+// to `profile` if not null.
+zetasql_base::StatusOr<int64_t> EvaluateModify(
+    const CachedQuery& query, const zetasql::ParameterValueMap& parameters,
+    RowWriter* writer, QueryProfile* profile) {
+  static metrics::Histogram* const evaluate_latency =
+      metrics::StageLatency("evaluate");
+  metrics::ScopedLatencyRecorder recorder(evaluate_latency);
+  trace::ScopedSpan span("Evaluate");
+  ScopedCpuTimeRecorder cpu_time_recorder(profile);
+  auto status_or = query.prepared_modify->Execute(parameters);
+  const zetasql::ResolvedNodeKind kind = query.resolved_statement->node_kind();
+  if (kind == zetasql::RESOLVED_DELETE_STMT) {
+    ZETASQL_ASSIGN_OR_RETURN(auto iterator, std::move(status_or));
+    return WriteDelete(std::move(iterator), writer);
+  }
   if (!status_or.ok()) {
     return MaybeTransformZetaSQLDMLError(status_or.status());
   }
-  auto iterator = std::move(status_or).ValueOrDie();
-  return BuildUpdate(std::move(iterator), MutationOpType::kUpdate,
-                     pending_ts_columns);
-}
-
-zetasql_base::StatusOr<std::pair<Mutation, int64_t>> EvaluateResolvedDelete(
-    const zetasql::ResolvedDeleteStmt* delete_statement,
-    const zetasql::ParameterValueMap& parameters,
-    zetasql::TypeFactory* type_factory) {
-  auto prepared_delete = absl::make_unique<zetasql::PreparedModify>(
-      delete_statement, CommonEvaluatorOptions(type_factory));
-  ZETASQL_ASSIGN_OR_RETURN(auto analyzer_options,
-                   MakeAnalyzerOptionsWithParameters(parameters));
-  ZETASQL_RETURN_IF_ERROR(prepared_delete->Prepare(analyzer_options));
-
-  ZETASQL_ASSIGN_OR_RETURN(auto iterator, prepared_delete->Execute(parameters));
-  return BuildDelete(std::move(iterator));
+  return WriteInsertOrUpdate(std::move(status_or).ValueOrDie(),
+                             kind == zetasql::RESOLVED_INSERT_STMT
+                                 ? MutationOpType::kInsert
+                                 : MutationOpType::kUpdate,
+                             query.pending_commit_timestamp_columns, writer);
 }
 
-// Uses googlesql/public/evaluator to evaluate a DML statement represented by a
-// resolved AST and returns a pair of mutation and count of modified rows.
-zetasql_base::StatusOr<std::pair<Mutation, int64_t>> EvaluateUpdate(
-    const zetasql::ResolvedStatement* resolved_statement,
-    const zetasql::ParameterValueMap& parameters,
-    zetasql::TypeFactory* type_factory) {
-  switch (resolved_statement->node_kind()) {
-    case zetasql::RESOLVED_INSERT_STMT:
-      return EvaluateResolvedInsert(
-          resolved_statement->GetAs<zetasql::ResolvedInsertStmt>(),
-          parameters, type_factory);
-    case zetasql::RESOLVED_UPDATE_STMT:
-      return EvaluateResolvedUpdate(
-          resolved_statement->GetAs<zetasql::ResolvedUpdateStmt>(),
-          parameters, type_factory);
-    case zetasql::RESOLVED_DELETE_STMT:
-      return EvaluateResolvedDelete(
-          resolved_statement->GetAs<zetasql::ResolvedDeleteStmt>(),
-          parameters, type_factory);
-    default:
-      ZETASQL_RET_CHECK_FAIL() << "Unsupported support node kind "
-                       << ResolvedNodeKind_Name(
-                              resolved_statement->node_kind());
-      break;
-  }
-}
-
-// Uses googlesql/public/evaluator to evaluate a query statement represented by
-// a resolved AST and returns a row cursor.
-zetasql_base::StatusOr<std::unique_ptr<RowCursor>> EvaluateQuery(
+// Uses googlesql/public/evaluator to prepare a query statement represented by
+// a resolved AST for evaluation.
+zetasql_base::StatusOr<std::unique_ptr<zetasql::PreparedQuery>> PrepareQuery(
     const zetasql::ResolvedStatement* resolved_statement,
     const zetasql::ParameterValueMap& params,
-    zetasql::TypeFactory* type_factory, int64_t* num_output_rows) {
+    zetasql::TypeFactory* type_factory, int64_t max_memory_bytes) {
   ZETASQL_RET_CHECK_EQ(resolved_statement->node_kind(), zetasql::RESOLVED_QUERY_STMT)
       << "input is not a query statement";
 
+  static metrics::Histogram* const prepare_latency =
+      metrics::StageLatency("prepare");
+  metrics::ScopedLatencyRecorder recorder(prepare_latency);
+  trace::ScopedSpan span("Prepare");
   auto prepared_query = absl::make_unique<zetasql::PreparedQuery>(
       resolved_statement->GetAs<zetasql::ResolvedQueryStmt>(),
-      CommonEvaluatorOptions(type_factory));
+      CommonEvaluatorOptions(type_factory, max_memory_bytes));
   // Call PrepareQuery to set the AnalyzerOptions that we used to Analyze the
   // statement.
   ZETASQL_ASSIGN_OR_RETURN(auto analyzer_options,
                    MakeAnalyzerOptionsWithParameters(params));
   ZETASQL_RETURN_IF_ERROR(prepared_query->Prepare(analyzer_options));
-  // Finally execute the query.
-  ZETASQL_ASSIGN_OR_RETURN(auto iterator, prepared_query->Execute(params));
+  return prepared_query;
+}
 
-  std::vector<std::vector<zetasql::Value>> values;
-  while (iterator->NextRow()) {
-    values.emplace_back();
-    values.back().reserve(iterator->NumColumns());
-    for (int i = 0; i < iterator->NumColumns(); ++i) {
-      values.back().push_back(iterator->GetValue(i));
+// Prepares the expressions of `cached_query` folded into parameters by
+// FoldingRewriter, for evaluation with parameters of the types of `params`.
+absl::Status PrepareFoldedExpressions(const zetasql::ParameterValueMap& params,
+                                      zetasql::TypeFactory* type_factory,
+                                      int64_t max_memory_bytes,
+                                      CachedQuery* cached_query) {
+  if (cached_query->folded_expressions.empty()) {
+    return absl::OkStatus();
+  }
+  ZETASQL_ASSIGN_OR_RETURN(auto analyzer_options,
+                   MakeAnalyzerOptionsWithParameters(params));
+  for (FoldedExpression& folded : cached_query->folded_expressions) {
+    folded.prepared = absl::make_unique<zetasql::PreparedExpression>(
+        folded.expr.get(),
+        CommonEvaluatorOptions(type_factory, max_memory_bytes));
+    ZETASQL_RETURN_IF_ERROR(folded.prepared->Prepare(analyzer_options));
+  }
+  return absl::OkStatus();
+}
+
+// Returns `params` with a NULL for each parameter folded into the statement of
+// `cached_query`, so that the statement is prepared with their types.
+zetasql::ParameterValueMap WithFoldedParameters(
+    const CachedQuery& cached_query, zetasql::ParameterValueMap params) {
+  for (const FoldedExpression& folded : cached_query.folded_expressions) {
+    params[folded.parameter] = zetasql::Value::Null(folded.expr->type());
+  }
+  return params;
+}
+
+// Evaluates the folded expressions of `query` and adds their values to
+// `params`. A folded expression may fail although the statement would not
+// evaluate it, for example over a table with no rows, so if any fails, the
+// statement is executed as written instead, prepared on first use.
+absl::Status BindFoldedExpressions(zetasql::TypeFactory* type_factory,
+                                   int64_t max_memory_bytes, CachedQuery* query,
+                                   zetasql::ParameterValueMap* params) {
+  query->execute_unfolded = false;
+  zetasql::ParameterValueMap folded_params;
+  for (const FoldedExpression& folded : query->folded_expressions) {
+    auto value = folded.prepared->Execute(/*columns=*/{}, *params);
+    if (!value.ok()) {
+      query->execute_unfolded = true;
+      break;
     }
+    folded_params[folded.parameter] = std::move(value).value();
   }
-  ZETASQL_RETURN_IF_ERROR(iterator->Status());
-  *num_output_rows = values.size();
-  std::vector<std::string> names;
-  std::vector<const zetasql::Type*> types;
-  for (int i = 0; i < iterator->NumColumns(); ++i) {
-    names.push_back(iterator->GetColumnName(i));
-    types.push_back(iterator->GetColumnType(i));
+  if (!query->execute_unfolded) {
+    params->insert(folded_params.begin(), folded_params.end());
+    return absl::OkStatus();
+  }
+  if (query->unfolded_query == nullptr) {
+    ZETASQL_ASSIGN_OR_RETURN(query->unfolded_query,
+                     PrepareQuery(query->unfolded_statement.get(), *params,
+                                  type_factory, max_memory_bytes));
   }
-  return absl::make_unique<VectorsRowCursor>(names, types, values);
+  return absl::OkStatus();
+}
+
+// Executes a prepared query and returns a row cursor which evaluates the rows
+// as it is read. The query is released back to `cache` once the cursor is
+// destroyed, or immediately on error. The CPU time spent evaluating the rows is
+// added to `profile` if not null. If SortRewriter removed the ORDER BY of the
+// query, the rows are sorted with `sort_options` as they are first read. The
+// statement before folding is executed instead if BindFoldedExpressions chose
+// so.
+zetasql_base::StatusOr<std::unique_ptr<RowCursor>> EvaluateQuery(
+    QueryCache* cache, const Schema* schema, const std::string& cache_key,
+    std::unique_ptr<CachedQuery> query, zetasql::ParameterValueMap params,
+    QueryProfile* profile, const ExternalSortOptions& sort_options) {
+  const absl::Time start = absl::Now();
+  zetasql::PreparedQuery* prepared_query = query->execute_unfolded
+                                               ? query->unfolded_query.get()
+                                               : query->prepared_query.get();
+  std::vector<SortColumn> sort_columns;
+  if (!query->execute_unfolded) {
+    sort_columns = query->sort_columns;
+  }
+  const int num_output_columns = query->num_output_columns;
+  for (const auto& table : query->filtered_tables) {
+    table->BindParameters(params);
+  }
+  zetasql_base::StatusOr<std::unique_ptr<zetasql::EvaluatorTableIterator>> iterator;
+  {
+    ScopedCpuTimeRecorder cpu_time_recorder(profile);
+    iterator = prepared_query->Execute(params);
+  }
+  if (!iterator.ok()) {
+    cache->Release(schema, cache_key, std::move(query));
+    return iterator.status();
+  }
+  std::unique_ptr<RowCursor> rows = absl::make_unique<QueryRowCursor>(
+      cache, schema, cache_key, std::move(query), std::move(params),
+      std::move(iterator).value(), start, absl::Now() - start, profile);
+  if (!sort_columns.empty()) {
+    rows = absl::make_unique<ExternalSortRowCursor>(
+        std::move(rows), std::move(sort_columns), num_output_columns,
+        sort_options);
+  }
+  return rows;
+}
+
+// Records the undeclared parameters of the analyzed statement of
+// `cached_query` and the types inferred for them.
+absl::Status SetUndeclaredParameters(CachedQuery* cached_query) {
+  for (const auto& [name, type] :
+       cached_query->analyzer_output->undeclared_parameters()) {
+    if (type->IsTimestamp() || type->IsDate()) {
+      return error::UnableToInferUndeclaredParameter(name);
+    }
+    cached_query->undeclared_parameters.push_back({name, type, name});
+  }
+  return absl::OkStatus();
 }
 
 zetasql_base::StatusOr<std::map<std::string, zetasql::Value>> ExtractParameters(
-    const Query& query, const zetasql::AnalyzerOutput* analyzer_output) {
-  // Allow the loop below to look up undeclared parameters without worrying
-  // about case. ZetaSQL will return the undeclared parameters using the
-  // spelling provided in the query, but the undeclared_params map uses the
-  // spelling from the query params section of the request.
+    const Query& query, CachedQuery* cached_query) {
+  // ZetaSQL returns the undeclared parameters using the spelling provided in
+  // the query, but the undeclared_params map uses the spelling from the query
+  // params section of the request, and the two may differ in case.
   //
   // For example:
   //     SELECT CAST(@pBool AS bool) with a supplied parameter "pbool".
   //
-  // Do this here instead of the frontend so that the frontend does not need to
-  // know any details about case normalization.
+  // Each parameter is looked up under the spelling it was last supplied with,
+  // and only if that fails, without worrying about case. Do this here instead
+  // of the frontend so that the frontend does not need to know any details
+  // about case normalization.
   //
   // This map takes pointers to elements inside of query.undeclared_params,
   // which is const so the pointers should not be invalidated.
   CaseInsensitiveStringMap<const google::protobuf::Value*> undeclared_params;
-  for (const auto& [name, value] : query.undeclared_params)
-    undeclared_params[name] = &value;
+  bool undeclared_params_indexed = false;
 
   // Build new parameter map which includes all unresolved parameters.
   auto params = query.declared_params;
-  for (const auto& [name, type] : analyzer_output->undeclared_parameters()) {
-    if (type->IsTimestamp() || type->IsDate()) {
-      return error::UnableToInferUndeclaredParameter(name);
-    }
-
-    auto it = undeclared_params.find(name);
-
-    // ZetaSQL will return an undeclared parameter error for any parameters that
-    // do not have values specified (ie, when it == end()).
-    if (it != undeclared_params.end()) {
-      auto parsed_value = frontend::ValueFromProto(*it->second, type);
+  for (CachedQuery::UndeclaredParameter& parameter :
+       cached_query->undeclared_parameters) {
+    const google::protobuf::Value* value = nullptr;
+    auto supplied = query.undeclared_params.find(parameter.supplied_name);
+    if (supplied != query.undeclared_params.end()) {
+      value = &supplied->second;
+    } else {
+      if (!undeclared_params_indexed) {
+        for (const auto& [name, proto_value] : query.undeclared_params) {
+          undeclared_params[name] = &proto_value;
+        }
+        undeclared_params_indexed = true;
+      }
+      auto it = undeclared_params.find(parameter.name);
 
-      // If the value does not parse as the given type, the error code is
-      // kInvalidArgument, not kFailedPrecondition, for example.
-      if (!parsed_value.ok()) {
-        return absl::Status(absl::StatusCode::kInvalidArgument,
-                            parsed_value.status().message());
+      // ZetaSQL will return an undeclared parameter error for any parameters
+      // that do not have values specified (ie, when it == end()).
+      if (it == undeclared_params.end()) {
+        continue;
       }
+      value = it->second;
+      parameter.supplied_name = it->first;
+    }
+    auto parsed_value = frontend::ValueFromProto(*value, parameter.type);
 
-      params[name] = parsed_value.value();
+    // If the value does not parse as the given type, the error code is
+    // kInvalidArgument, not kFailedPrecondition, for example.
+    if (!parsed_value.ok()) {
+      return absl::Status(absl::StatusCode::kInvalidArgument,
+                          parsed_value.status().message());
     }
+
+    params[parameter.name] = std::move(parsed_value).value();
   }
 
   return params;
@@ -502,81 +896,447 @@ ExtractValidatedResolvedStatementAndOptions(
     QueryEngineOptions* query_engine_options = nullptr) {
   ZETASQL_RET_CHECK_NE(analyzer_output->resolved_statement(), nullptr);
 
+  static metrics::Histogram* const validate_latency =
+      metrics::StageLatency("validate");
+  metrics::ScopedLatencyRecorder recorder(validate_latency);
+  trace::ScopedSpan span("Validate");
+
   // Rewrite query hints to use only the 'spanner' prefix.
   HintRewriter rewriter;
   ZETASQL_RETURN_IF_ERROR(analyzer_output->resolved_statement()->Accept(&rewriter));
   ZETASQL_ASSIGN_OR_RETURN(auto statement,
                    rewriter.ConsumeRootNode<zetasql::ResolvedStatement>());
 
-  // Validate the query and extract and return any options specified
-  // through hint if the caller requested them.
+  // Validate the query, its index hints and its size limits in a single pass,
+  // and extract and return any options specified through hint if the caller
+  // requested them.
   QueryEngineOptions options;
   QueryValidator query_validator{schema, &options};
-  ZETASQL_RETURN_IF_ERROR(statement->Accept(&query_validator));
+  ZETASQL_RETURN_IF_ERROR(query_validator.ValidateStatement(statement.get()));
   if (query_engine_options != nullptr) {
     *query_engine_options = options;
   }
+  return statement;
+}
 
-  // Validate the index hints.
-  IndexHintValidator index_hint_validator{
-      schema, options.disable_query_null_filtered_index_check};
-  ZETASQL_RETURN_IF_ERROR(statement->Accept(&index_hint_validator));
+// Rewrites the statement of `cached_query` so that the expressions which only
+// depend on literals and parameters are evaluated once per execution, and
+// repeated computed columns once per row. The statement before folding is
+// kept in case a folded expression fails. Uncorrelated semi-joins are read
+// by the key lookups of an IN UNNEST over their folded rows.
+absl::Status RewriteFoldedExpressions(const FunctionCatalog* function_catalog,
+                                      zetasql::TypeFactory* type_factory,
+                                      CachedQuery* cached_query) {
+  FoldingRewriter rewriter(function_catalog, type_factory);
+  ZETASQL_RETURN_IF_ERROR(cached_query->resolved_statement->Accept(&rewriter));
+  ZETASQL_ASSIGN_OR_RETURN(auto statement,
+                   rewriter.ConsumeRootNode<zetasql::ResolvedStatement>());
+  cached_query->folded_expressions = rewriter.release_folded_expressions();
+  if (!cached_query->folded_expressions.empty()) {
+    cached_query->unfolded_statement =
+        std::move(cached_query->resolved_statement);
+  }
+  cached_query->resolved_statement = std::move(statement);
+  return absl::OkStatus();
+}
 
-  // Check the query size limits
-  // https://cloud.google.com/spanner/quotas#query_limits
-  QuerySizeLimitsChecker checker;
-  ZETASQL_RETURN_IF_ERROR(checker.CheckQueryAgainstLimits(statement.get()));
+// Replaces the joins of the statement of `cached_query` which can be evaluated
+// by key with scans of joined tables, which read through the reader of the
+// cached query.
+absl::Status RewriteJoins(CachedQuery* cached_query) {
+  JoinRewriter rewriter(&cached_query->reader);
+  ZETASQL_RETURN_IF_ERROR(cached_query->resolved_statement->Accept(&rewriter));
+  ZETASQL_ASSIGN_OR_RETURN(cached_query->resolved_statement,
+                   rewriter.ConsumeRootNode<zetasql::ResolvedStatement>());
+  cached_query->joined_tables = rewriter.release_joined_tables();
+  return absl::OkStatus();
+}
 
-  return statement;
+// Replaces the filters over table scans in the statement of `cached_query`
+// with scans of filtered tables, which filter the rows read in batches.
+absl::Status RewriteFilters(CachedQuery* cached_query) {
+  FilterRewriter rewriter;
+  ZETASQL_RETURN_IF_ERROR(cached_query->resolved_statement->Accept(&rewriter));
+  ZETASQL_ASSIGN_OR_RETURN(cached_query->resolved_statement,
+                   rewriter.ConsumeRootNode<zetasql::ResolvedStatement>());
+  cached_query->filtered_tables = rewriter.release_filtered_tables();
+  return absl::OkStatus();
+}
+
+// Restricts the tables scanned by ordered and limited queries in the statement
+// of `cached_query` to the rows the queries need.
+absl::Status RewriteLimits(CachedQuery* cached_query) {
+  LimitRewriter rewriter(&cached_query->filtered_tables);
+  ZETASQL_RETURN_IF_ERROR(cached_query->resolved_statement->Accept(&rewriter));
+  ZETASQL_ASSIGN_OR_RETURN(cached_query->resolved_statement,
+                   rewriter.ConsumeRootNode<zetasql::ResolvedStatement>());
+  return absl::OkStatus();
+}
+
+// Replaces the aggregations grouped by primary key prefixes in the statement of
+// `cached_query` with scans of aggregated tables, which aggregate the rows of
+// each group as they are read in key order.
+absl::Status RewriteAggregates(CachedQuery* cached_query) {
+  AggregateRewriter rewriter;
+  ZETASQL_RETURN_IF_ERROR(cached_query->resolved_statement->Accept(&rewriter));
+  ZETASQL_ASSIGN_OR_RETURN(cached_query->resolved_statement,
+                   rewriter.ConsumeRootNode<zetasql::ResolvedStatement>());
+  cached_query->aggregated_tables = rewriter.release_aggregated_tables();
+  return absl::OkStatus();
+}
+
+// Removes the outermost ORDER BY of the query of `cached_query`, recording the
+// columns by which its rows are to be sorted as they are returned.
+absl::Status RewriteSorts(CachedQuery* cached_query) {
+  SortRewriter rewriter;
+  ZETASQL_RETURN_IF_ERROR(cached_query->resolved_statement->Accept(&rewriter));
+  ZETASQL_ASSIGN_OR_RETURN(cached_query->resolved_statement,
+                   rewriter.ConsumeRootNode<zetasql::ResolvedStatement>());
+  cached_query->sort_columns = rewriter.release_sort_columns();
+  if (!cached_query->sort_columns.empty()) {
+    cached_query->num_output_columns =
+        cached_query->analyzer_output->resolved_statement()
+            ->GetAs<zetasql::ResolvedQueryStmt>()
+            ->output_column_list_size();
+  }
+  return absl::OkStatus();
+}
+
+// Starts collecting the profile of `cached_query` in `result` if it was
+// requested by `query`, counting the rows read by the cached query.
+void MaybeStartProfile(const Query& query, CachedQuery* cached_query,
+                       QueryResult* result) {
+  if (!query.collect_profile) {
+    return;
+  }
+  result->profile =
+      absl::make_unique<QueryProfile>(*cached_query->resolved_statement);
+  cached_query->reader.set_profile(result->profile.get());
+}
+
+// Returns the table whose reads are restricted to the partition range of
+// `context`, or null if the query is not partitioned.
+const Table* PartitionedTable(const QueryContext& context) {
+  if (context.partitioned_table.empty()) {
+    return nullptr;
+  }
+  return context.schema->FindTable(context.partitioned_table);
 }
 
 }  // namespace
 
+zetasql_base::StatusOr<std::vector<KeyRange>> QueryEngine::SplitTableKeySpace(
+    const Table* table, RowReader* reader) const {
+  ReadArg read_arg;
+  read_arg.table = table->Name();
+  read_arg.key_set = KeySet::All();
+  for (const KeyColumn* key_column : table->primary_key()) {
+    read_arg.columns.push_back(key_column->column()->Name());
+  }
+  std::unique_ptr<RowCursor> cursor;
+  ZETASQL_RETURN_IF_ERROR(reader->Read(read_arg, &cursor));
+  std::vector<Key> keys;
+  while (cursor->Next()) {
+    Key key;
+    for (int i = 0; i < cursor->NumColumns(); ++i) {
+      key.AddColumn(cursor->ColumnValue(i),
+                    table->primary_key()[i]->is_descending());
+    }
+    keys.push_back(std::move(key));
+  }
+  ZETASQL_RETURN_IF_ERROR(cursor->Status());
+
+  // Rows are spread evenly across the partitions, each starting at the key of
+  // its first row. The first and last ranges extend to the ends of the key
+  // space.
+  const int64_t num_partitions = std::min<int64_t>(
+      parallel_options_.num_threads,
+      keys.size() / std::max<int64_t>(parallel_options_.min_rows_per_partition,
+                                      1));
+  std::vector<KeyRange> ranges;
+  Key range_start = Key::Empty();
+  for (int64_t i = 1; i < num_partitions; ++i) {
+    const Key& range_limit = keys[i * keys.size() / num_partitions];
+    ranges.push_back(KeyRange::ClosedOpen(range_start, range_limit));
+    range_start = range_limit;
+  }
+  ranges.push_back(KeyRange::ClosedOpen(range_start, Key::Infinity()));
+  return ranges;
+}
+
+zetasql_base::StatusOr<std::unique_ptr<RowCursor>> QueryEngine::ExecuteSqlInParallel(
+    const Query& query, const QueryContext& context) const {
+  // Only simple scans of a single table can be split by key range. Queries
+  // which fail the check are evaluated serially, which reports any errors.
+  std::string partitioned_table;
+  if (!IsPartitionable(query, context, &partitioned_table).ok() ||
+      partitioned_table.empty()) {
+    return nullptr;
+  }
+  const Table* table = context.schema->FindTable(partitioned_table);
+  ZETASQL_RET_CHECK_NE(table, nullptr);
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<KeyRange> ranges,
+                   SplitTableKeySpace(table, context.reader));
+  if (ranges.size() < 2) {
+    return nullptr;
+  }
+
+  std::vector<PartitionResult> results(ranges.size());
+  slow_log::RequestStats* const request_stats = slow_log::Current();
+  TaskGroup group(Executor::Default(), TaskPriority::kInteractive,
+                  parallel_options_.num_threads, context.cancellation);
+  for (int i = 0; i < ranges.size(); ++i) {
+    group.Schedule([&, i]() -> absl::Status {
+      // The rows scanned by the partition are counted for the request once
+      // its cursor is destroyed, which must be before the request ends.
+      slow_log::ScopedAttach attach_request(request_stats);
+      QueryContext partition_context = context;
+      partition_context.partitioned_table = partitioned_table;
+      partition_context.partition_range = ranges[i];
+      partition_context.allow_parallel_execution = false;
+      ZETASQL_ASSIGN_OR_RETURN(QueryResult partition_result,
+                       ExecuteAdmittedSql(query, partition_context));
+      return MaterializeRows(partition_result.rows.get(), &results[i]);
+    });
+  }
+
+  // Report the error of the earliest failing partition, as a serial scan of
+  // the table would, and otherwise return the rows of the partitions in key
+  // order.
+  ZETASQL_RETURN_IF_ERROR(group.Wait());
+  std::vector<std::vector<zetasql::Value>> rows;
+  for (PartitionResult& result : results) {
+    std::move(result.rows.begin(), result.rows.end(), std::back_inserter(rows));
+    result.rows.clear();
+  }
+  return absl::make_unique<MaterializedRowCursor>(
+      std::move(results[0].column_names), std::move(results[0].column_types),
+      std::move(rows));
+}
+
+zetasql_base::StatusOr<QueryResult> QueryEngine::ExecuteSqlWithResultCache(
+    const Query& query, const QueryContext& context) const {
+  ZETASQL_ASSIGN_OR_RETURN(const std::string key, ResultCacheKey(query));
+  QueryResult result;
+  result.rows = result_cache_->Lookup(context.schema, key,
+                                      *context.read_timestamp, &result.ordered);
+  if (result.rows != nullptr) {
+    result.deterministic = true;
+    return result;
+  }
+
+  // The query is executed without a read timestamp, so that it is not looked
+  // up again, reading through a recorder of the tables it reads.
+  auto recorder = absl::make_unique<TableVersionRecorder>(
+      context.reader, context.schema, result_cache_storage_);
+  QueryContext recorded_context = context;
+  recorded_context.reader = recorder.get();
+  recorded_context.read_timestamp = absl::nullopt;
+  ZETASQL_ASSIGN_OR_RETURN(result, ExecuteAdmittedSql(query, recorded_context));
+  if (!result.deterministic) {
+    recorder->MarkIncomplete();
+  }
+  result.rows = result_cache_->CacheRows(
+      context.schema, key, *context.read_timestamp, result.ordered,
+      std::move(recorder), std::move(result.rows));
+  return result;
+}
+
 zetasql_base::StatusOr<QueryResult> QueryEngine::ExecuteSql(
     const Query& query, const QueryContext& context) const {
-  absl::Time start_time = absl::Now();
-  Catalog catalog{context.schema, &function_catalog_, context.reader};
-  ZETASQL_ASSIGN_OR_RETURN(auto analyzer_output,
-                   Analyze(query.sql, query.declared_params, &catalog,
-                           type_factory_, /*prune_unused_columns=*/true));
+  const absl::Time start = absl::Now();
+  std::unique_ptr<QueryCharge> charge;
+  if (limits_.max_concurrent_queries > 0) {
+    if (num_running_queries_.fetch_add(1) >= limits_.max_concurrent_queries) {
+      num_running_queries_.fetch_sub(1);
+      return error::TooManyConcurrentQueries(limits_.max_concurrent_queries);
+    }
+    charge = absl::make_unique<QueryCharge>(&num_running_queries_);
+  } else {
+    charge = absl::make_unique<QueryCharge>(/*num_running_queries=*/nullptr);
+  }
+  // The rows read are always charged to a budget, which counts them for the
+  // query's statistics.
+  charge->row_budget = absl::make_unique<RowBudget>(
+      limits_.max_rows_scanned > 0 ? limits_.max_rows_scanned
+                                   : std::numeric_limits<int64_t>::max());
+  QueryContext charged_context = context;
+  charged_context.row_budget = charge->row_budget.get();
+
+  zetasql_base::StatusOr<QueryResult> result =
+      ExecuteAdmittedSql(query, charged_context);
+  if (!result.ok() || result->rows == nullptr) {
+    // DML statements and failed queries are done executing.
+    QueryExecution execution;
+    execution.latency = absl::Now() - start;
+    execution.rows_scanned = charge->row_budget->rows_consumed();
+    execution.failed = !result.ok();
+    query_stats_.Record(query.sql, execution);
+    return result;
+  }
+  if (context.cancellation != nullptr) {
+    result->rows = absl::make_unique<CancellableRowCursor>(
+        std::move(result->rows), context.cancellation);
+  }
+  result->rows = absl::make_unique<ChargedRowCursor>(
+      std::move(charge), std::move(result->rows), &query_stats_, query.sql,
+      start);
+  return result;
+}
 
+zetasql_base::StatusOr<QueryResult> QueryEngine::ExecuteAdmittedSql(
+    const Query& query, const QueryContext& context) const {
+  if (result_cache_ != nullptr && context.read_timestamp.has_value() &&
+      context.writer == nullptr && context.partitioned_table.empty() &&
+      !query.collect_profile && !IsDMLQuery(query.sql)) {
+    return ExecuteSqlWithResultCache(query, context);
+  }
+
+  QueryResult result;
+  if (parallel_options_.num_threads > 0 && context.allow_parallel_execution &&
+      context.partitioned_table.empty() && !query.collect_profile &&
+      !IsDMLQuery(query.sql)) {
+    ZETASQL_ASSIGN_OR_RETURN(result.rows, ExecuteSqlInParallel(query, context));
+    if (result.rows != nullptr) {
+      return result;
+    }
+  }
+
+  const std::string cache_key = QueryCacheKey(query);
+  std::unique_ptr<CachedQuery> cached_query =
+      query_cache_.Acquire(context.schema, cache_key);
+  if (cached_query != nullptr) {
+    // The statement has already been analyzed and prepared, and only needs to
+    // be executed, so that repeated statements (such as the statements of a
+    // batch DML request) are only analyzed once.
+    cached_query->reader.set_target(context.reader);
+    cached_query->reader.set_partition(PartitionedTable(context),
+                                       context.partition_range);
+    cached_query->reader.set_row_budget(context.row_budget);
+    cached_query->reader.set_cancellation(context.cancellation);
+    auto params = ExtractParameters(query, cached_query.get());
+    absl::Status status = params.status();
+    if (status.ok()) {
+      status = BindFoldedExpressions(type_factory_, limits_.max_memory_bytes,
+                                     cached_query.get(), &params.value());
+    }
+    if (!status.ok()) {
+      query_cache_.Release(context.schema, cache_key, std::move(cached_query));
+      return status;
+    }
+    MaybeStartProfile(query, cached_query.get(), &result);
+    result.ordered = cached_query->ordered;
+    result.deterministic = cached_query->deterministic;
+    if (cached_query->prepared_modify != nullptr) {
+      ZETASQL_RET_CHECK_NE(context.writer, nullptr);
+      auto modified_row_count =
+          EvaluateModify(*cached_query, params.value(), context.writer,
+                         result.profile.get());
+      query_cache_.Release(context.schema, cache_key, std::move(cached_query));
+      ZETASQL_ASSIGN_OR_RETURN(result.modified_row_count, modified_row_count);
+      return result;
+    }
+    ZETASQL_ASSIGN_OR_RETURN(result.rows,
+                     EvaluateQuery(&query_cache_, context.schema, cache_key,
+                                   std::move(cached_query),
+                                   std::move(params).value(),
+                                   result.profile.get(), sort_options_));
+    return result;
+  }
+
+  cached_query = absl::make_unique<CachedQuery>();
+  cached_query->generation = query_cache_.generation();
+  cached_query->reader.set_target(context.reader);
+  cached_query->reader.set_partition(PartitionedTable(context),
+                                     context.partition_range);
+  cached_query->reader.set_row_budget(context.row_budget);
+  cached_query->reader.set_cancellation(context.cancellation);
+  cached_query->catalog = absl::make_unique<Catalog>(
+      context.schema, function_catalog_, &cached_query->reader,
+      &information_schema_cache_, &queryable_columns_cache_, lock_stats_,
+      &query_stats_);
+  Catalog* catalog = cached_query->catalog.get();
+  // DML statements need all the columns of the table they modify, so only
+  // queries can be analyzed with unused columns pruned.
+  const bool is_dml = IsDMLQuery(query.sql);
+  ZETASQL_ASSIGN_OR_RETURN(cached_query->analyzer_output,
+                   Analyze(query.sql, query.declared_params, catalog,
+                           type_factory_, /*prune_unused_columns=*/!is_dml));
+  const zetasql::AnalyzerOutput* analyzer_output =
+      cached_query->analyzer_output.get();
+
+  ZETASQL_RETURN_IF_ERROR(SetUndeclaredParameters(cached_query.get()));
   ZETASQL_ASSIGN_OR_RETURN(auto params,
-                   ExtractParameters(query, analyzer_output.get()));
+                   ExtractParameters(query, cached_query.get()));
 
-  ZETASQL_ASSIGN_OR_RETURN(auto resolved_statement,
+  ZETASQL_ASSIGN_OR_RETURN(cached_query->resolved_statement,
                    ExtractValidatedResolvedStatementAndOptions(
-                       analyzer_output.get(), context.schema));
+                       analyzer_output, context.schema));
+  if (!is_dml) {
+    // The profile describes the plan of the statement, so the expressions of
+    // profiled queries are evaluated as written.
+    if (!query.collect_profile) {
+      ZETASQL_RETURN_IF_ERROR(RewriteFoldedExpressions(
+          function_catalog_, type_factory_, cached_query.get()));
+    }
+    ZETASQL_RETURN_IF_ERROR(RewriteJoins(cached_query.get()));
+    ZETASQL_RETURN_IF_ERROR(RewriteFilters(cached_query.get()));
+    ZETASQL_RETURN_IF_ERROR(RewriteLimits(cached_query.get()));
+    ZETASQL_RETURN_IF_ERROR(RewriteAggregates(cached_query.get()));
+  }
+  cached_query->ordered = IsOrderedQuery(*cached_query->resolved_statement);
+  result.ordered = cached_query->ordered;
+  cached_query->deterministic =
+      IsDeterministicQuery(*cached_query->resolved_statement);
+  result.deterministic = cached_query->deterministic;
+  // The profile describes the plan of the statement, so profiled queries keep
+  // their ORDER BY.
+  if (cached_query->ordered && !query.collect_profile &&
+      sort_options_.spill_threshold_bytes > 0) {
+    ZETASQL_RETURN_IF_ERROR(RewriteSorts(cached_query.get()));
+  }
+  MaybeStartProfile(query, cached_query.get(), &result);
 
-  QueryResult result;
   if (analyzer_output->resolved_statement()->node_kind() ==
       zetasql::RESOLVED_QUERY_STMT) {
-    ZETASQL_ASSIGN_OR_RETURN(auto cursor,
-                     EvaluateQuery(resolved_statement.get(), params,
-                                   type_factory_, &result.num_output_rows));
-    result.rows = std::move(cursor);
+    ZETASQL_ASSIGN_OR_RETURN(
+        cached_query->prepared_query,
+        PrepareQuery(cached_query->resolved_statement.get(),
+                     WithFoldedParameters(*cached_query, params),
+                     type_factory_, limits_.max_memory_bytes));
+    ZETASQL_RETURN_IF_ERROR(PrepareFoldedExpressions(
+        params, type_factory_, limits_.max_memory_bytes, cached_query.get()));
+    ZETASQL_RETURN_IF_ERROR(BindFoldedExpressions(type_factory_,
+                                          limits_.max_memory_bytes,
+                                          cached_query.get(), &params));
+    ZETASQL_ASSIGN_OR_RETURN(
+        result.rows,
+        EvaluateQuery(&query_cache_, context.schema, cache_key,
+                      std::move(cached_query), std::move(params),
+                      result.profile.get(), sort_options_));
   } else {
     ZETASQL_RET_CHECK_NE(context.writer, nullptr);
-    ZETASQL_ASSIGN_OR_RETURN(auto analyzer_output,
-                     Analyze(query.sql, query.declared_params, &catalog,
-                             type_factory_, /*prune_unused_columns=*/false));
-    ZETASQL_ASSIGN_OR_RETURN(auto resolved_statement,
-                     ExtractValidatedResolvedStatementAndOptions(
-                         analyzer_output.get(), context.schema));
-
-    ZETASQL_ASSIGN_OR_RETURN(
-        const auto& mutation_and_count,
-        EvaluateUpdate(resolved_statement.get(), params, type_factory_));
-    ZETASQL_RETURN_IF_ERROR(context.writer->Write(mutation_and_count.first));
-    result.modified_row_count = static_cast<int64_t>(mutation_and_count.second);
+    ZETASQL_RETURN_IF_ERROR(
+        PrepareModify(params, type_factory_, limits_.max_memory_bytes,
+                      cached_query.get()));
+    auto modified_row_count = EvaluateModify(
+        *cached_query, params, context.writer, result.profile.get());
+    query_cache_.Release(context.schema, cache_key, std::move(cached_query));
+    ZETASQL_ASSIGN_OR_RETURN(result.modified_row_count, modified_row_count);
   }
-
-  result.elapsed_time = absl::Now() - start_time;
   return result;
 }
 
-absl::Status QueryEngine::IsPartitionable(const Query& query,
-                                          const QueryContext& context) const {
-  Catalog catalog{context.schema, &function_catalog_, context.reader};
+absl::Status QueryEngine::IsPartitionable(
+    const Query& query, const QueryContext& context,
+    std::string* partitioned_table) const {
+  if (partitioned_table != nullptr) {
+    partitioned_table->clear();
+  }
+
+  Catalog catalog{context.schema, function_catalog_, context.reader,
+                  &information_schema_cache_, &queryable_columns_cache_,
+                  lock_stats_, &query_stats_};
   ZETASQL_ASSIGN_OR_RETURN(auto analyzer_output,
                    Analyze(query.sql, query.declared_params, &catalog,
                            type_factory_, /*prune_unused_columns=*/true));
@@ -591,16 +1351,23 @@ absl::Status QueryEngine::IsPartitionable(const Query& query,
 
   // Perform partitionability checks on the query
   PartitionabilityValidator part_validator{context.schema};
-  return resolved_statement->Accept(&part_validator);
+  ZETASQL_RETURN_IF_ERROR(resolved_statement->Accept(&part_validator));
+  if (partitioned_table != nullptr) {
+    *partitioned_table = part_validator.table_name();
+  }
+  return absl::OkStatus();
 }
 
 absl::Status QueryEngine::IsValidPartitionedDML(
-    const Query& query, const QueryContext& context) const {
+    const Query& query, const QueryContext& context,
+    std::string* partitioned_table) const {
   if (!IsDMLQuery(query.sql)) {
     return error::InvalidOperationUsingPartitionedDmlTransaction();
   }
 
-  Catalog catalog{context.schema, &function_catalog_, context.reader};
+  Catalog catalog{context.schema, function_catalog_, context.reader,
+                  &information_schema_cache_, &queryable_columns_cache_,
+                  lock_stats_, &query_stats_};
   ZETASQL_ASSIGN_OR_RETURN(auto analyzer_output,
                    Analyze(query.sql, query.declared_params, &catalog,
                            type_factory_, /*prune_unused_columns=*/true));
@@ -611,7 +1378,34 @@ absl::Status QueryEngine::IsValidPartitionedDML(
 
   // Check that the DML statement is partitionable.
   PartitionedDMLValidator validator;
-  return resolved_statement->Accept(&validator);
+  ZETASQL_RETURN_IF_ERROR(resolved_statement->Accept(&validator));
+  if (partitioned_table != nullptr) {
+    *partitioned_table = validator.table_name();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status QueryEngine::WarmUp() {
+  // The stages are run directly rather than through ExecuteSql, so that the
+  // warm-up is not recorded in the latency metrics of queries.
+  zetasql::TypeFactory type_factory;
+  Schema schema;
+  Catalog catalog{&schema, FunctionCatalog::Shared()};
+  std::unique_ptr<const zetasql::AnalyzerOutput> output;
+  ZETASQL_RETURN_IF_ERROR(zetasql::AnalyzeStatement(
+      "SELECT x + 1, CONCAT('a', CAST(x AS STRING)), CURRENT_TIMESTAMP() "
+      "FROM UNNEST([1, 2, 3]) AS x WHERE x > 1 ORDER BY x",
+      MakeGoogleSqlAnalyzerOptions(), &catalog, &type_factory, &output));
+  zetasql::PreparedQuery prepared_query(
+      output->resolved_statement()->GetAs<zetasql::ResolvedQueryStmt>(),
+      CommonEvaluatorOptions(&type_factory, /*max_memory_bytes=*/0));
+  ZETASQL_RETURN_IF_ERROR(
+      prepared_query.Prepare(MakeGoogleSqlAnalyzerOptions()));
+  ZETASQL_ASSIGN_OR_RETURN(auto iterator,
+                   prepared_query.Execute(zetasql::ParameterValueMap()));
+  while (iterator->NextRow()) {
+  }
+  return iterator->Status();
 }
 
 }  // namespace backend
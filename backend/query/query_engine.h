@@ -17,18 +17,37 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_QUERY_ENGINE_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_QUERY_ENGINE_H_
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "google/protobuf/struct.pb.h"
 #include "zetasql/public/type.h"
 #include "zetasql/public/value.h"
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
 #include "backend/access/read.h"
 #include "backend/access/write.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/locking/lock_stats.h"
+#include "backend/query/external_sort.h"
 #include "backend/query/function_catalog.h"
+#include "backend/query/information_schema_catalog.h"
+#include "backend/query/query_cache.h"
+#include "backend/query/query_profile.h"
+#include "backend/query/query_result_cache.h"
+#include "backend/query/query_stats.h"
+#include "backend/query/queryable_table.h"
 #include "backend/schema/catalog/schema.h"
+#include "backend/schema/catalog/schema_diff.h"
+#include "backend/schema/catalog/table.h"
+#include "backend/storage/storage.h"
+#include "common/cancellation.h"
 #include "absl/status/status.h"
 #include "zetasql/base/statusor.h"
 
@@ -49,6 +68,11 @@ struct Query {
   // Parameters that did not have a type supplied. They will be deserialized in
   // the backend once the ZetaSQL analyzer provides types.
   std::map<std::string, google::protobuf::Value> undeclared_params;
+
+  // If true, the plan of the statement and statistics of its execution are
+  // collected in QueryResult::profile. Profiled statements are never evaluated
+  // in parallel.
+  bool collect_profile = false;
 };
 
 // Returns true if the given query is a DML statement.
@@ -56,17 +80,31 @@ bool IsDMLQuery(const std::string& query);
 
 // QueryResult specifies the output of a query request.
 struct QueryResult {
+  // The profile of the statement if requested by Query::collect_profile, null
+  // otherwise. Its statistics are only complete once the rows of the cursor
+  // have been read. Declared before the cursor, which refers to it while it is
+  // read.
+  std::unique_ptr<QueryProfile> profile;
+
   // A row cursor containing the query result rows, null for DML requests.
+  // Rows are evaluated as the cursor is read, so it must not outlive the
+  // reader in the QueryContext the query was executed with, nor the
+  // QueryEngine.
   std::unique_ptr<RowCursor> rows;
 
   // The number of modified rows.
   int64_t modified_row_count = 0;
 
-  // The number of rows in the returned row cursor.
-  int64_t num_output_rows = 0;
+  // True if the rows are ordered by the outermost ORDER BY of the query, so
+  // that executing it again at the same timestamp returns them in the same
+  // order (up to ties).
+  bool ordered = false;
 
-  // Query execution elapsed time.
-  absl::Duration elapsed_time;
+  // True if the rows only depend on the rows read by the query, so that
+  // executing it again over the same rows returns the same result. False if
+  // the query calls functions such as CURRENT_TIMESTAMP() or RAND(), or
+  // samples rows at random.
+  bool deterministic = false;
 };
 
 // QueryContext provides resources required to execute a query.
@@ -79,33 +117,240 @@ struct QueryContext {
 
   // A writer for writing data for DML requests. Can be null for SELECT queries.
   RowWriter* writer;
+
+  // When executing one partition of a partitioned query, the table scanned by
+  // the query, whose reads only return rows with keys in partition_range.
+  // Empty otherwise.
+  std::string partitioned_table;
+  KeyRange partition_range = KeyRange::All();
+
+  // If true, the query may be split into partitions which read through
+  // `reader` concurrently from several threads. Must only be set if the
+  // reader is thread-safe.
+  bool allow_parallel_execution = false;
+
+  // The timestamp `reader` reads at, if it is a snapshot reader. The rows of
+  // SELECT queries executed at a timestamp may be cached and returned for
+  // later executions of the same query, see QueryResultCacheOptions.
+  absl::optional<absl::Time> read_timestamp;
+
+  // Budget the rows read by the query are charged to, if not null. Set by
+  // QueryEngine::ExecuteSql to count the rows scanned by each query, and limit
+  // them if the engine does, so that the partitions of a parallel query share
+  // the budget.
+  RowBudget* row_budget = nullptr;
+
+  // Cancellation of the request executing the query, if not null. The query
+  // fails with the status of the token once it is cancelled, checked as rows
+  // are read from tables and returned.
+  const CancellationToken* cancellation = nullptr;
+};
+
+// ParallelQueryOptions controls the parallel evaluation of partitionable
+// queries by QueryEngine.
+struct ParallelQueryOptions {
+  // Number of partitions of a query evaluated at once on the shared executor.
+  // Queries are evaluated by the calling thread if this is 0.
+  int num_threads = 0;
+
+  // Minimum number of rows of the scanned table in each partition. Smaller
+  // tables are not split.
+  int64_t min_rows_per_partition = 64 * 1024;
+};
+
+// QueryLimits bound the resources used by the queries of a QueryEngine, so
+// that the queries of one database cannot starve those of the other databases
+// of the process. Queries exceeding a limit fail with RESOURCE_EXHAUSTED. A
+// limit of 0 means no limit.
+struct QueryLimits {
+  // Maximum number of queries and DML statements running at once. A query
+  // runs until its result cursor is destroyed.
+  int max_concurrent_queries = 0;
+
+  // Maximum number of rows read from tables and indexes by each query.
+  int64_t max_rows_scanned = 0;
+
+  // Maximum bytes of the intermediate results of each query, such as the rows
+  // being sorted, aggregated or joined by the evaluator. 0 leaves the default
+  // limit of the evaluator.
+  int64_t max_memory_bytes = 0;
 };
 
 // QueryEngine handles SQL-related requests.
 class QueryEngine {
  public:
-  explicit QueryEngine(zetasql::TypeFactory* type_factory)
-      : type_factory_(type_factory), function_catalog_(type_factory) {}
+  // If `lock_stats` is not null, the SPANNER_SYS tables report the lock
+  // contention it counts.
+  explicit QueryEngine(
+      zetasql::TypeFactory* type_factory,
+      const ParallelQueryOptions& parallel_options = {},
+      const QueryResultCacheOptions& result_cache_options = {},
+      const QueryLimits& limits = {},
+      const ExternalSortOptions& sort_options = {},
+      const LockStats* lock_stats = nullptr)
+      : type_factory_(type_factory),
+        function_catalog_(FunctionCatalog::Shared()),
+        query_cache_(kQueryCacheCapacity,
+                     std::max(kMinCachedInstancesPerQuery,
+                              parallel_options.num_threads)),
+        parallel_options_(parallel_options),
+        limits_(limits),
+        sort_options_(sort_options),
+        result_cache_storage_(result_cache_options.storage),
+        lock_stats_(lock_stats) {
+    if (result_cache_options.storage != nullptr &&
+        result_cache_options.max_bytes > 0) {
+      result_cache_ = absl::make_unique<QueryResultCache>(
+          result_cache_options.storage, result_cache_options.max_bytes);
+    }
+  }
 
   // Executes a SQL query (SELECT query or DML).
   // Skip execution if validate_only is true.
+  //
+  // SELECT queries are analyzed and prepared once per schema, SQL text and
+  // parameter types, and reused by later executions with the same ones.
+  //
+  // If parallel evaluation is enabled and allowed by the context, a
+  // partitionable query over a large table is evaluated in partitions on the
+  // threads of the engine, and its rows are returned once all partitions have
+  // been evaluated.
+  //
+  // If result caching is enabled and the context has a read timestamp, the
+  // rows of deterministic SELECT queries are cached once they have all been
+  // read, and returned for later executions of the query with the same
+  // parameter values over tables which have not changed since.
+  //
+  // Fails with RESOURCE_EXHAUSTED if the engine already runs as many queries
+  // as its limits allow, and the rows of queries reading more rows than the
+  // limits allow fail with RESOURCE_EXHAUSTED.
+  //
+  // Each execution is counted in query_stats() once its rows have been read
+  // and the cursor destroyed, or once it fails or its DML completes.
   zetasql_base::StatusOr<QueryResult> ExecuteSql(const Query& query,
                                          const QueryContext& context) const;
 
-  // Returns OK if query is partitionable.
-  absl::Status IsPartitionable(const Query& query,
-                               const QueryContext& context) const;
+  // Returns OK if query is partitionable. If partitioned_table is not null, it
+  // is set to the name of the table scanned by the query, whose key space can
+  // be split to partition the query. It is left empty if the partitionability
+  // check was disabled with a hint, as the query may not be a simple scan.
+  absl::Status IsPartitionable(const Query& query, const QueryContext& context,
+                               std::string* partitioned_table = nullptr) const;
 
   // Returns OK if the 'query' is a DML statement that can be executed through
-  // partitioned DML.
-  absl::Status IsValidPartitionedDML(const Query& query,
-                                     const QueryContext& context) const;
+  // partitioned DML. If partitioned_table is not null, it is set to the name of
+  // the table modified by the statement, whose key space can be split to
+  // partition the statement.
+  absl::Status IsValidPartitionedDML(
+      const Query& query, const QueryContext& context,
+      std::string* partitioned_table = nullptr) const;
 
   zetasql::TypeFactory* type_factory() const { return type_factory_; }
 
+  // Statistics of the statements executed by the engine, which the SPANNER_SYS
+  // tables report.
+  const QueryStats& query_stats() const { return query_stats_; }
+
+  // Initializes the function catalog and the ZetaSQL analyzer and evaluator by
+  // analyzing and evaluating a query over an empty schema, so that the first
+  // query of a database does not pay for it. Safe to call from any thread and
+  // more than once.
+  static absl::Status WarmUp();
+
+  // Discards what the engine cached for the tables which `diff` lists as
+  // dropped or altered, along with the analyzed queries, information schema
+  // catalogs and query results, which are cached per schema. Must be called
+  // when a new schema is published for the database, with the tables which
+  // differ from the previous one.
+  void UpdateQueryCache(const SchemaDiff& diff) {
+    query_cache_.Clear();
+    information_schema_cache_.Update(diff);
+    queryable_columns_cache_.Erase(diff.RemovedTables());
+    if (result_cache_ != nullptr) {
+      result_cache_->Clear();
+    }
+  }
+
+  // Discards all the analyzed queries, information schema catalogs, queryable
+  // columns and query results cached by the engine. Must be called when
+  // schemas are pruned, since nothing may be cached for their tables once they
+  // are released.
+  void ClearQueryCache() {
+    query_cache_.Clear();
+    information_schema_cache_.Clear();
+    queryable_columns_cache_.Clear();
+    if (result_cache_ != nullptr) {
+      result_cache_->Clear();
+    }
+  }
+
  private:
+  // Maximum number of analyzed queries cached by ExecuteSql.
+  static constexpr int kQueryCacheCapacity = 256;
+
+  // Number of instances of each analyzed query cached for concurrent callers,
+  // unless more threads evaluate the partitions of parallel queries.
+  static constexpr int kMinCachedInstancesPerQuery = 4;
+
+  // Executes a query admitted by ExecuteSql within the limits of the engine.
+  zetasql_base::StatusOr<QueryResult> ExecuteAdmittedSql(
+      const Query& query, const QueryContext& context) const;
+
+  // Evaluates the query in partitions of the table it scans on the shared
+  // executor. Returns null if the query is not partitionable, or the
+  // table is too small to be split, in which case it should be evaluated
+  // serially.
+  zetasql_base::StatusOr<std::unique_ptr<RowCursor>> ExecuteSqlInParallel(
+      const Query& query, const QueryContext& context) const;
+
+  // Returns the rows of the query cached for the read timestamp of `context`
+  // if any, and otherwise executes it, caching its rows once they are read.
+  zetasql_base::StatusOr<QueryResult> ExecuteSqlWithResultCache(
+      const Query& query, const QueryContext& context) const;
+
+  // Splits the key space of `table` into ranges of at least
+  // min_rows_per_partition rows, parallel_options_.num_threads at most.
+  zetasql_base::StatusOr<std::vector<KeyRange>> SplitTableKeySpace(
+      const Table* table, RowReader* reader) const;
+
   zetasql::TypeFactory* type_factory_;
-  FunctionCatalog function_catalog_;
+
+  // The catalog of functions, shared by all the query engines of the process.
+  const FunctionCatalog* const function_catalog_;
+
+  // Analyzed queries, reused across executions. Mutable because caching does
+  // not change the results of ExecuteSql.
+  mutable QueryCache query_cache_;
+
+  // Information schema catalogs, shared by the queries against a schema.
+  mutable InformationSchemaCache information_schema_cache_;
+
+  // Queryable columns of the tables of a schema, shared by the queries against
+  // it.
+  mutable QueryableColumnsCache queryable_columns_cache_;
+
+  const ParallelQueryOptions parallel_options_;
+
+  const QueryLimits limits_;
+
+  // Options of the sorts of ordered queries, see SortRewriter.
+  const ExternalSortOptions sort_options_;
+
+  // Number of queries running, if the engine limits concurrent queries.
+  mutable std::atomic<int> num_running_queries_{0};
+
+  // Storage whose table versions tell whether cached results are up to date.
+  const Storage* const result_cache_storage_;
+
+  // Results of queries, or null if results are not cached.
+  std::unique_ptr<QueryResultCache> result_cache_;
+
+  // Lock contention reported by the SPANNER_SYS tables, or null.
+  const LockStats* const lock_stats_;
+
+  // Executions of the statements, by shape. Mutable because counting them does
+  // not change the results of ExecuteSql.
+  mutable QueryStats query_stats_;
 };
 
 }  // namespace backend
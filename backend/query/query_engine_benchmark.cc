@@ -0,0 +1,337 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Measures the latency of QueryEngine::ExecuteSql over a corpus of
+// representative queries, on generated datasets of increasing size.
+//
+// Each query of the corpus is run twice per dataset: cold, with the query
+// cache cleared before every execution so that the query is analyzed and
+// prepared each time, and warm, reusing the cached query as repeated requests
+// do. The time of each execution is split into the analyze, validate, prepare
+// and evaluate stages of the query engine, as recorded by its stage latency
+// metrics.
+//
+// The datasets are a Users table and an Albums table interleaved in it, with
+// --dataset_rows Albums rows and one Users row for every kAlbumsPerUser
+// albums. Larger datasets, up to 10M rows, can be requested with the flag but
+// take a while to load.
+//
+// Usage: query_engine_benchmark [--dataset_rows=10000,100000]
+//            [--benchmark_format=table|json] [--benchmark_min_time=500ms]
+//            [--benchmark_filter=...]
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/value.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "zetasql/base/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/time/time.h"
+#include "backend/access/write.h"
+#include "backend/database/database.h"
+#include "backend/datamodel/value.h"
+#include "backend/query/query_engine.h"
+#include "backend/transaction/options.h"
+#include "backend/transaction/read_only_transaction.h"
+#include "backend/transaction/read_write_transaction.h"
+#include "common/benchmark.h"
+#include "common/metrics.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+ABSL_FLAG(std::vector<std::string>, dataset_rows, {"10000", "100000"},
+          "Comma-separated sizes of the generated datasets, in rows of the "
+          "Albums table.");
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql::values::Int64;
+using zetasql::values::String;
+
+constexpr int kAlbumsPerUser = 4;
+
+// Number of distinct values of Users.Country, grouped by the GROUP BY query.
+constexpr int kNumCountries = 64;
+
+// Number of Users rows inserted by each commit while loading a dataset.
+constexpr int kUsersPerCommit = 1000;
+
+// Number of rows read by range scans, and of users joined by join queries.
+constexpr int kRowsPerScan = 1000;
+constexpr int kUsersPerJoin = 100;
+
+// Number of values in the IN list query.
+constexpr int kInListSize = 1000;
+
+// The stages of the query engine, as named by its stage latency metrics.
+constexpr const char* kStages[] = {"analyze", "validate", "prepare",
+                                   "evaluate"};
+
+const std::vector<std::string>& SchemaStatements() {
+  static const auto* statements = new std::vector<std::string>{
+      R"(
+        CREATE TABLE Users (
+          UserId INT64 NOT NULL,
+          Name STRING(MAX),
+          Age INT64,
+          Country STRING(MAX),
+        ) PRIMARY KEY (UserId)
+      )",
+      R"(
+        CREATE TABLE Albums (
+          UserId INT64 NOT NULL,
+          AlbumId INT64 NOT NULL,
+          Title STRING(MAX),
+          Plays INT64,
+        ) PRIMARY KEY (UserId, AlbumId),
+        INTERLEAVE IN PARENT Users ON DELETE CASCADE
+      )",
+      "CREATE INDEX UsersByCountry ON Users(Country)",
+  };
+  return *statements;
+}
+
+// A query of the corpus. `make_params` returns the parameters of the query for
+// the given iteration, so that successive executions read different rows.
+struct BenchmarkQuery {
+  std::string name;
+  std::string sql;
+  std::function<std::map<std::string, zetasql::Value>(int64_t iteration,
+                                                        int64_t num_users)>
+      make_params;
+};
+
+std::map<std::string, zetasql::Value> NoParams(int64_t, int64_t) {
+  return {};
+}
+
+// Returns the key of a user spread over the whole table for each iteration,
+// leaving room for `count` users after it.
+int64_t UserIdForIteration(int64_t iteration, int64_t num_users,
+                           int64_t count) {
+  // A large prime stride visits the users in a scattered order.
+  return (iteration * 7919) % std::max<int64_t>(1, num_users - count);
+}
+
+std::vector<BenchmarkQuery> QueryCorpus() {
+  std::vector<std::string> in_list;
+  for (int i = 0; i < kInListSize; ++i) {
+    in_list.push_back(absl::StrCat(i * 3));
+  }
+  return {
+      {"PointSelect", "SELECT Name, Age FROM Users WHERE UserId = @id",
+       [](int64_t iteration, int64_t num_users) {
+         return std::map<std::string, zetasql::Value>{
+             {"id", Int64(UserIdForIteration(iteration, num_users, 1))}};
+       }},
+      {"RangeScan",
+       absl::StrCat("SELECT UserId, Name, Age FROM Users "
+                    "WHERE UserId >= @start AND UserId < @start + ",
+                    kRowsPerScan),
+       [](int64_t iteration, int64_t num_users) {
+         return std::map<std::string, zetasql::Value>{
+             {"start", Int64(UserIdForIteration(iteration, num_users,
+                                                kRowsPerScan))}};
+       }},
+      {"InterleavedJoin",
+       absl::StrCat("SELECT u.Name, a.Title, a.Plays FROM Users AS u "
+                    "JOIN Albums AS a ON u.UserId = a.UserId "
+                    "WHERE u.UserId >= @start AND u.UserId < @start + ",
+                    kUsersPerJoin),
+       [](int64_t iteration, int64_t num_users) {
+         return std::map<std::string, zetasql::Value>{
+             {"start", Int64(UserIdForIteration(iteration, num_users,
+                                                kUsersPerJoin))}};
+       }},
+      {"GroupBy",
+       "SELECT Country, COUNT(*), AVG(Age) FROM Users GROUP BY Country",
+       NoParams},
+      {"GroupByJoin",
+       "SELECT u.Country, SUM(a.Plays) FROM Users AS u "
+       "JOIN Albums AS a ON u.UserId = a.UserId GROUP BY u.Country",
+       NoParams},
+      {"LargeInList",
+       absl::StrCat("SELECT UserId, Name FROM Users WHERE UserId IN (",
+                    absl::StrJoin(in_list, ", "), ")"),
+       NoParams},
+      {"IndexLookup",
+       "SELECT UserId FROM Users@{FORCE_INDEX=UsersByCountry} "
+       "WHERE Country = 'country0'",
+       NoParams},
+      {"InformationSchemaTables",
+       "SELECT table_name FROM information_schema.tables "
+       "WHERE table_schema = ''",
+       NoParams},
+      {"InformationSchemaColumns",
+       "SELECT column_name, spanner_type FROM information_schema.columns "
+       "WHERE table_name = 'Albums' ORDER BY ordinal_position",
+       NoParams},
+  };
+}
+
+// Inserts `num_albums` Albums rows, and their users, into the database.
+absl::Status LoadDataset(Database* database, int64_t num_albums) {
+  const int64_t num_users = num_albums / kAlbumsPerUser;
+  for (int64_t start = 0; start < num_users; start += kUsersPerCommit) {
+    std::vector<ValueList> users;
+    std::vector<ValueList> albums;
+    for (int64_t user = start;
+         user < std::min<int64_t>(start + kUsersPerCommit, num_users); ++user) {
+      users.push_back({Int64(user), String(absl::StrCat("user", user)),
+                       Int64(18 + user % 60),
+                       String(absl::StrCat("country", user % kNumCountries))});
+      for (int64_t album = 0; album < kAlbumsPerUser; ++album) {
+        albums.push_back({Int64(user), Int64(album),
+                          String(absl::StrCat("album", user, "-", album)),
+                          Int64(user * album % 1000)});
+      }
+    }
+    Mutation mutation;
+    mutation.AddWriteOp(MutationOpType::kInsert, "Users",
+                        {"UserId", "Name", "Age", "Country"}, std::move(users));
+    mutation.AddWriteOp(MutationOpType::kInsert, "Albums",
+                        {"UserId", "AlbumId", "Title", "Plays"},
+                        std::move(albums));
+    ZETASQL_ASSIGN_OR_RETURN(
+        std::unique_ptr<ReadWriteTransaction> txn,
+        database->CreateReadWriteTransaction(ReadWriteOptions(), RetryState()));
+    ZETASQL_RETURN_IF_ERROR(txn->Write(mutation));
+    ZETASQL_RETURN_IF_ERROR(txn->Commit());
+  }
+  return absl::OkStatus();
+}
+
+// Executes `query` and reads all of its rows.
+absl::Status ExecuteQuery(const QueryEngine& query_engine,
+                          ReadOnlyTransaction* txn, const Query& query) {
+  ZETASQL_ASSIGN_OR_RETURN(QueryResult result,
+                   query_engine.ExecuteSql(
+                       query, QueryContext{.schema = txn->schema(),
+                                           .reader = txn,
+                                           .writer = nullptr}));
+  int64_t num_rows = 0;
+  while (result.rows->Next()) {
+    ++num_rows;
+  }
+  DoNotOptimize(num_rows);
+  return result.rows->Status();
+}
+
+// Returns the total time recorded so far in each stage of the query engine.
+std::vector<absl::Duration> StageTimes() {
+  std::vector<absl::Duration> times;
+  for (const char* stage : kStages) {
+    times.push_back(metrics::StageLatency(stage)->sum());
+  }
+  return times;
+}
+
+// Runs `benchmark_query` against the dataset, clearing the query cache before
+// each execution if `cold`, and reports the time spent in each stage.
+void RunQuery(BenchmarkRunner* runner, const std::string& name,
+              const BenchmarkQuery& benchmark_query, bool cold,
+              int64_t num_users, Database* database, ReadOnlyTransaction* txn) {
+  QueryEngine* query_engine = database->query_engine();
+  query_engine->ClearQueryCache();
+  int64_t total_iterations = 0;
+  const std::vector<absl::Duration> start_times = StageTimes();
+  bool ran = runner->Run(name, [&](int64_t iterations) {
+    for (int64_t i = 0; i < iterations; ++i) {
+      Query query{benchmark_query.sql,
+                  benchmark_query.make_params(total_iterations, num_users)};
+      if (cold) {
+        query_engine->ClearQueryCache();
+      }
+      absl::Status status = ExecuteQuery(*query_engine, txn, query);
+      ++total_iterations;
+      if (!status.ok()) {
+        std::fprintf(stderr, "%s: %s\n", name.c_str(),
+                     status.ToString().c_str());
+        return;
+      }
+    }
+  });
+  if (!ran || total_iterations == 0) {
+    return;
+  }
+  const std::vector<absl::Duration> end_times = StageTimes();
+  for (int i = 0; i < end_times.size(); ++i) {
+    runner->AddBreakdown(kStages[i],
+                         (end_times[i] - start_times[i]) / total_iterations);
+  }
+}
+
+absl::Status RunBenchmark() {
+  // The stages of the query engine are only timed while metrics are enabled.
+  metrics::SetEnabled(true);
+  const std::vector<BenchmarkQuery> corpus = QueryCorpus();
+  BenchmarkRunner runner;
+  for (const std::string& rows_flag : absl::GetFlag(FLAGS_dataset_rows)) {
+    int64_t num_rows;
+    if (!absl::SimpleAtoi(rows_flag, &num_rows) || num_rows < kAlbumsPerUser) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid --dataset_rows value: ", rows_flag));
+    }
+    ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<Database> database,
+                     Database::Create(SchemaStatements()));
+    ZETASQL_RETURN_IF_ERROR(LoadDataset(database.get(), num_rows));
+    // All queries read the same snapshot of the dataset.
+    ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<ReadOnlyTransaction> txn,
+                     database->CreateReadOnlyTransaction(ReadOnlyOptions()));
+    const int64_t num_users = num_rows / kAlbumsPerUser;
+    for (const BenchmarkQuery& query : corpus) {
+      for (bool cold : {true, false}) {
+        RunQuery(&runner,
+                 absl::StrCat(query.name, "/rows:", num_rows,
+                              cold ? "/cold" : "/warm"),
+                 query, cold, num_users, database.get(), txn.get());
+      }
+    }
+  }
+  runner.Report();
+  return absl::OkStatus();
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  absl::Status status = google::spanner::emulator::backend::RunBenchmark();
+  if (!status.ok()) {
+    std::fprintf(stderr, "%s\n", status.ToString().c_str());
+    return 1;
+  }
+  return 0;
+}
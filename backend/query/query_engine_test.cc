@@ -16,10 +16,14 @@
 
 #include "backend/query/query_engine.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "google/protobuf/struct.pb.h"
 #include "zetasql/public/type.h"
 #include "zetasql/public/value.h"
 #include "gmock/gmock.h"
@@ -28,12 +32,23 @@
 #include "absl/memory/memory.h"
 #include "zetasql/base/statusor.h"
 #include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
 #include "backend/access/read.h"
 #include "backend/access/write.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
 #include "backend/datamodel/key_set.h"
 #include "backend/datamodel/value.h"
+#include "backend/locking/lock_stats.h"
 #include "backend/query/catalog.h"
+#include "backend/query/query_profile.h"
+#include "backend/query/query_stats.h"
 #include "backend/schema/catalog/schema.h"
+#include "backend/storage/in_memory_storage.h"
+#include "common/cancellation.h"
+#include "common/errors.h"
+#include "tests/common/row_cursor.h"
 #include "tests/common/row_reader.h"
 #include "tests/common/schema_constructor.h"
 #include "absl/status/status.h"
@@ -47,14 +62,18 @@ namespace backend {
 namespace {
 
 using testing::AllOf;
+using testing::Contains;
 using testing::ElementsAre;
 using testing::Field;
+using testing::IsEmpty;
 using testing::IsTrue;
 using testing::Property;
 using testing::Return;
 using testing::UnorderedElementsAre;
 using zetasql_base::testing::IsOkAndHolds;
+using zetasql_base::testing::StatusIs;
 
+using zetasql::values::Double;
 using zetasql::values::Int64;
 using zetasql::values::String;
 
@@ -99,12 +118,74 @@ zetasql_base::StatusOr<std::vector<std::vector<zetasql::Value>>> GetAllColumnVal
   return all_values;
 }
 
+// A RowReader which only returns the rows of the wrapped reader whose
+// int64_col key is in the key set of the read, if int64_col is read.
+class KeySetFilteringRowReader : public RowReader {
+ public:
+  explicit KeySetFilteringRowReader(RowReader* reader) : reader_(reader) {}
+
+  absl::Status Read(const ReadArg& read_arg,
+                    std::unique_ptr<RowCursor>* cursor) override {
+    std::unique_ptr<RowCursor> all_rows;
+    ZETASQL_RETURN_IF_ERROR(reader_->Read(read_arg, &all_rows));
+    auto key_column = std::find(read_arg.columns.begin(),
+                                read_arg.columns.end(), "int64_col");
+    std::vector<std::vector<zetasql::Value>> rows;
+    while (all_rows->Next()) {
+      std::vector<zetasql::Value> row;
+      for (int i = 0; i < all_rows->NumColumns(); ++i) {
+        row.push_back(all_rows->ColumnValue(i));
+      }
+      if (key_column == read_arg.columns.end() ||
+          Contains(read_arg.key_set,
+                   Key({row[key_column - read_arg.columns.begin()]}))) {
+        rows.push_back(std::move(row));
+      }
+    }
+    ZETASQL_RETURN_IF_ERROR(all_rows->Status());
+    *cursor = absl::make_unique<test::TestRowCursor>(
+        GetColumnNames(*all_rows), GetColumnTypes(*all_rows), std::move(rows));
+    return absl::OkStatus();
+  }
+
+ private:
+  static bool Contains(const KeySet& key_set, const Key& key) {
+    return std::find(key_set.keys().begin(), key_set.keys().end(), key) !=
+               key_set.keys().end() ||
+           std::any_of(key_set.ranges().begin(), key_set.ranges().end(),
+                       [&key](const KeyRange& range) {
+                         return range.Contains(key);
+                       });
+  }
+
+  RowReader* reader_;
+};
+
+// A RowReader which counts the reads forwarded to the wrapped reader.
+class CountingRowReader : public RowReader {
+ public:
+  explicit CountingRowReader(RowReader* reader) : reader_(reader) {}
+
+  absl::Status Read(const ReadArg& read_arg,
+                    std::unique_ptr<RowCursor>* cursor) override {
+    ++num_reads_;
+    return reader_->Read(read_arg, cursor);
+  }
+
+  int num_reads() const { return num_reads_; }
+
+ private:
+  RowReader* reader_;
+  int num_reads_ = 0;
+};
+
 class QueryEngineTest : public testing::Test {
  public:
   const Schema* schema() { return schema_.get(); }
   const Schema* multi_table_schema() { return multi_table_schema_.get(); }
   RowReader* reader() { return &reader_; }
   QueryEngine& query_engine() { return query_engine_; }
+  zetasql::TypeFactory* type_factory() { return &type_factory_; }
 
  private:
   zetasql::TypeFactory type_factory_;
@@ -118,7 +199,20 @@ class QueryEngineTest : public testing::Test {
          {zetasql::types::Int64Type(), zetasql::types::StringType()},
          {{zetasql::values::Int64(1), zetasql::values::String("one")},
           {zetasql::values::Int64(2), zetasql::values::String("two")},
-          {zetasql::values::Int64(4), zetasql::values::String("four")}}}}}};
+          {zetasql::values::Int64(4), zetasql::values::String("four")}}}},
+       {"child_table",
+        {{"int64_col", "child_key"},
+         {zetasql::types::Int64Type(), zetasql::types::Int64Type()},
+         {{zetasql::values::Int64(1), zetasql::values::Int64(10)},
+          {zetasql::values::Int64(1), zetasql::values::Int64(11)},
+          {zetasql::values::Int64(3), zetasql::values::Int64(30)},
+          {zetasql::values::Int64(4), zetasql::values::Int64(40)}}}},
+       {"test_table2",
+        {{"int64_col", "string_col"},
+         {zetasql::types::Int64Type(), zetasql::types::StringType()},
+         {{zetasql::values::Int64(1), zetasql::values::String("uno")},
+          {zetasql::values::Int64(4), zetasql::values::String("cuatro")},
+          {zetasql::values::Int64(5), zetasql::values::String("cinco")}}}}}};
   QueryEngine query_engine_{&type_factory_};
 };
 
@@ -129,6 +223,11 @@ TEST_F(QueryEngineTest, DetectsDMLQueries) {
   EXPECT_FALSE(IsDMLQuery("SELECT * from Users"));
 }
 
+TEST_F(QueryEngineTest, WarmUpCanBeRepeated) {
+  ZETASQL_EXPECT_OK(QueryEngine::WarmUp());
+  ZETASQL_EXPECT_OK(QueryEngine::WarmUp());
+}
+
 TEST_F(QueryEngineTest, ExecuteSqlSelectsOneFromTable) {
   ZETASQL_ASSERT_OK_AND_ASSIGN(
       QueryResult result,
@@ -236,6 +335,443 @@ TEST_F(QueryEngineTest, ExecuteSqlSelectsCountFromTable) {
               IsOkAndHolds(ElementsAre(ElementsAre(Int64(3)))));
 }
 
+TEST_F(QueryEngineTest, ExecuteSqlEvaluatesPartitionableQueryInParallel) {
+  QueryEngine parallel_query_engine{
+      query_engine().type_factory(),
+      ParallelQueryOptions{.num_threads = 3, .min_rows_per_partition = 1}};
+  KeySetFilteringRowReader filtering_reader(reader());
+  QueryContext context{schema(), &filtering_reader};
+  context.allow_parallel_execution = true;
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult result,
+      parallel_query_engine.ExecuteSql(
+          Query{"SELECT int64_col, string_col FROM test_table"}, context));
+  ASSERT_NE(result.rows, nullptr);
+  EXPECT_THAT(GetColumnNames(*result.rows),
+              ElementsAre("int64_col", "string_col"));
+  EXPECT_THAT(GetColumnTypes(*result.rows),
+              ElementsAre(Int64Type(), StringType()));
+
+  // Each row is evaluated by exactly one partition, and the partitions are
+  // returned in key order.
+  EXPECT_THAT(GetAllColumnValues(std::move(result.rows)),
+              IsOkAndHolds(ElementsAre(ElementsAre(Int64(1), String("one")),
+                                       ElementsAre(Int64(2), String("two")),
+                                       ElementsAre(Int64(4), String("four")))));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlEvaluatesOtherQueriesSerially) {
+  QueryEngine parallel_query_engine{
+      query_engine().type_factory(),
+      ParallelQueryOptions{.num_threads = 3, .min_rows_per_partition = 1}};
+  KeySetFilteringRowReader filtering_reader(reader());
+  QueryContext context{schema(), &filtering_reader};
+  context.allow_parallel_execution = true;
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult result,
+      parallel_query_engine.ExecuteSql(
+          Query{"SELECT COUNT(*) AS count FROM test_table"}, context));
+  EXPECT_THAT(GetAllColumnValues(std::move(result.rows)),
+              IsOkAndHolds(ElementsAre(ElementsAre(Int64(3)))));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlLimitsConcurrentQueries) {
+  QueryEngine limited_query_engine{query_engine().type_factory(),
+                                   ParallelQueryOptions{},
+                                   QueryResultCacheOptions{},
+                                   QueryLimits{.max_concurrent_queries = 1}};
+  const Query query{"SELECT int64_col FROM test_table"};
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult result,
+      limited_query_engine.ExecuteSql(query, QueryContext{schema(), reader()}));
+
+  // The first query runs until its rows are read.
+  EXPECT_THAT(
+      limited_query_engine.ExecuteSql(query, QueryContext{schema(), reader()}),
+      StatusIs(absl::StatusCode::kResourceExhausted));
+  ZETASQL_EXPECT_OK(GetAllColumnValues(std::move(result.rows)));
+  ZETASQL_EXPECT_OK(
+      limited_query_engine.ExecuteSql(query, QueryContext{schema(), reader()}));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlStopsOnceCancelled) {
+  CancellationToken cancellation;
+  QueryContext context{schema(), reader()};
+  context.cancellation = &cancellation;
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult result,
+      query_engine().ExecuteSql(
+          Query{"SELECT int64_col FROM test_table ORDER BY int64_col"},
+          context));
+
+  cancellation.Cancel();
+  EXPECT_THAT(GetAllColumnValues(std::move(result.rows)),
+              StatusIs(absl::StatusCode::kCancelled));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlLimitsRowsScanned) {
+  const Query query{"SELECT int64_col FROM test_table"};
+  QueryEngine engine_reading_all_rows{query_engine().type_factory(),
+                                      ParallelQueryOptions{},
+                                      QueryResultCacheOptions{},
+                                      QueryLimits{.max_rows_scanned = 3}};
+  ZETASQL_ASSERT_OK_AND_ASSIGN(QueryResult result,
+                       engine_reading_all_rows.ExecuteSql(
+                           query, QueryContext{schema(), reader()}));
+  ZETASQL_EXPECT_OK(GetAllColumnValues(std::move(result.rows)));
+
+  QueryEngine engine_reading_fewer_rows{query_engine().type_factory(),
+                                        ParallelQueryOptions{},
+                                        QueryResultCacheOptions{},
+                                        QueryLimits{.max_rows_scanned = 2}};
+  ZETASQL_ASSERT_OK_AND_ASSIGN(result, engine_reading_fewer_rows.ExecuteSql(
+                                   query, QueryContext{schema(), reader()}));
+  EXPECT_THAT(GetAllColumnValues(std::move(result.rows)),
+              StatusIs(absl::StatusCode::kResourceExhausted));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlSortsOrderedQueriesExternally) {
+  // Every row is spilled, so that the sorted rows are merged from disk.
+  QueryEngine engine{query_engine().type_factory(), ParallelQueryOptions{},
+                     QueryResultCacheOptions{}, QueryLimits{},
+                     ExternalSortOptions{.spill_threshold_bytes = 1}};
+  const Query query{
+      "SELECT string_col FROM test_table ORDER BY int64_col DESC"};
+  for (int i = 0; i < 2; ++i) {
+    // The second execution reuses the cached query.
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        QueryResult result,
+        engine.ExecuteSql(query, QueryContext{schema(), reader()}));
+    EXPECT_TRUE(result.ordered);
+    EXPECT_THAT(GetAllColumnValues(std::move(result.rows)),
+                IsOkAndHolds(ElementsAre(ElementsAre(String("four")),
+                                         ElementsAre(String("two")),
+                                         ElementsAre(String("one")))));
+  }
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlFoldsRepeatedAndConstantExpressions) {
+  const std::string sql =
+      "SELECT CONCAT(@suffix, '!') AS a, CONCAT(@suffix, '!') AS b, "
+      "UPPER(string_col) AS c, UPPER(string_col) AS d "
+      "FROM test_table WHERE int64_col = @key + 1";
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult first,
+      query_engine().ExecuteSql(
+          Query{sql, {{"suffix", String("x")}, {"key", Int64(1)}}},
+          QueryContext{schema(), reader()}));
+  EXPECT_THAT(GetAllColumnValues(std::move(first.rows)),
+              IsOkAndHolds(ElementsAre(ElementsAre(String("x!"), String("x!"),
+                                                   String("TWO"),
+                                                   String("TWO")))));
+
+  // The folded expressions are evaluated again with the new parameters.
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult second,
+      query_engine().ExecuteSql(
+          Query{sql, {{"suffix", String("y")}, {"key", Int64(3)}}},
+          QueryContext{schema(), reader()}));
+  EXPECT_THAT(GetAllColumnValues(std::move(second.rows)),
+              IsOkAndHolds(ElementsAre(ElementsAre(String("y!"), String("y!"),
+                                                   String("FOUR"),
+                                                   String("FOUR")))));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlReadsSemiJoinsAsInLists) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult result,
+      query_engine().ExecuteSql(
+          Query{"SELECT string_col FROM test_table WHERE int64_col IN "
+                "(SELECT int64_col FROM test_table2)"},
+          QueryContext{schema(), reader()}));
+  EXPECT_THAT(GetAllColumnValues(std::move(result.rows)),
+              IsOkAndHolds(UnorderedElementsAre(ElementsAre(String("one")),
+                                                ElementsAre(String("four")))));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlReadsInUnnestParameters) {
+  const std::string sql =
+      "SELECT string_col FROM test_table WHERE int64_col IN UNNEST(@ids)";
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult first,
+      query_engine().ExecuteSql(
+          Query{sql, {{"ids", zetasql::values::Int64Array({2, 3, 4})}}},
+          QueryContext{schema(), reader()}));
+  EXPECT_THAT(GetAllColumnValues(std::move(first.rows)),
+              IsOkAndHolds(UnorderedElementsAre(ElementsAre(String("two")),
+                                                ElementsAre(String("four")))));
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult second,
+      query_engine().ExecuteSql(
+          Query{sql, {{"ids", zetasql::values::Int64Array({1})}}},
+          QueryContext{schema(), reader()}));
+  EXPECT_THAT(GetAllColumnValues(std::move(second.rows)),
+              IsOkAndHolds(ElementsAre(ElementsAre(String("one")))));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlDoesNotFailOnUnevaluatedFoldedExpressions) {
+  // DIV(1, @divisor) fails, but there are no rows to evaluate it for.
+  const std::string sql =
+      "SELECT DIV(1, @divisor) FROM test_table WHERE int64_col > 10";
+  for (int i = 0; i < 2; ++i) {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        QueryResult result,
+        query_engine().ExecuteSql(Query{sql, {{"divisor", Int64(0)}}},
+                                  QueryContext{schema(), reader()}));
+    EXPECT_THAT(GetAllColumnValues(std::move(result.rows)),
+                IsOkAndHolds(IsEmpty()));
+  }
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlCollectsProfileOfQuery) {
+  Query query{"SELECT COUNT(*) AS count FROM test_table WHERE int64_col > 1"};
+  query.collect_profile = true;
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult result,
+      query_engine().ExecuteSql(query, QueryContext{schema(), reader()}));
+  ASSERT_NE(result.profile, nullptr);
+  EXPECT_THAT(GetAllColumnValues(std::move(result.rows)),
+              IsOkAndHolds(ElementsAre(ElementsAre(Int64(2)))));
+
+  const std::vector<QueryPlanNode>& plan = result.profile->plan();
+  ASSERT_FALSE(plan.empty());
+  EXPECT_EQ(plan[0].display_name, "QueryStmt");
+  EXPECT_THAT(plan[0].child_indexes, ElementsAre(1));
+  EXPECT_THAT(plan, Contains(AllOf(
+                        Field(&QueryPlanNode::display_name, "TableScan"),
+                        Field(&QueryPlanNode::table, "test_table"))));
+
+  // All the rows of the table are scanned, although only two are counted.
+  EXPECT_EQ(result.profile->rows_scanned("test_table"), 3);
+  EXPECT_EQ(result.profile->total_rows_scanned(), 3);
+  EXPECT_GE(result.profile->cpu_time(), absl::ZeroDuration());
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlDoesNotCollectProfileByDefault) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult result,
+      query_engine().ExecuteSql(Query{"SELECT int64_col FROM test_table"},
+                                QueryContext{schema(), reader()}));
+  EXPECT_EQ(result.profile, nullptr);
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlReusesCachedQueryWithNewReaderAndParams) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult first,
+      query_engine().ExecuteSql(
+          Query{"SELECT string_col FROM test_table WHERE int64_col > @p",
+                {{"p", Int64(1)}}},
+          QueryContext{schema(), reader()}));
+  EXPECT_THAT(GetAllColumnValues(std::move(first.rows)),
+              IsOkAndHolds(UnorderedElementsAre(ElementsAre(String("two")),
+                                                ElementsAre(String("four")))));
+
+  test::TestRowReader other_reader{
+      {{"test_table",
+        {{"int64_col", "string_col"},
+         {zetasql::types::Int64Type(), zetasql::types::StringType()},
+         {{zetasql::values::Int64(3), zetasql::values::String("three")},
+          {zetasql::values::Int64(5), zetasql::values::String("five")}}}}}};
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult second,
+      query_engine().ExecuteSql(
+          Query{"SELECT string_col FROM test_table WHERE int64_col > @p",
+                {{"p", Int64(4)}}},
+          QueryContext{schema(), &other_reader}));
+  EXPECT_THAT(GetAllColumnValues(std::move(second.rows)),
+              IsOkAndHolds(ElementsAre(ElementsAre(String("five")))));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlReusesCachedQueryWithUndeclaredParams) {
+  // Undeclared parameters are matched regardless of case, including when a
+  // later execution of the cached query spells them differently.
+  auto execute = [this](const std::string& name, int64_t value) {
+    google::protobuf::Value proto_value;
+    proto_value.set_string_value(absl::StrCat(value));
+    return query_engine().ExecuteSql(
+        Query{"SELECT string_col FROM test_table WHERE int64_col > @pValue",
+              {},
+              {{name, proto_value}}},
+        QueryContext{schema(), reader()});
+  };
+  ZETASQL_ASSERT_OK_AND_ASSIGN(QueryResult first, execute("pvalue", 1));
+  EXPECT_THAT(GetAllColumnValues(std::move(first.rows)),
+              IsOkAndHolds(UnorderedElementsAre(ElementsAre(String("two")),
+                                                ElementsAre(String("four")))));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(QueryResult second, execute("PVALUE", 2));
+  EXPECT_THAT(GetAllColumnValues(std::move(second.rows)),
+              IsOkAndHolds(ElementsAre(ElementsAre(String("four")))));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(QueryResult third, execute("pValue", 4));
+  EXPECT_THAT(GetAllColumnValues(std::move(third.rows)),
+              IsOkAndHolds(ElementsAre()));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlFiltersRowsInBatches) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult result,
+      query_engine().ExecuteSql(
+          Query{"SELECT int64_col FROM test_table "
+                "WHERE (int64_col * 2 > 3 OR string_col IS NULL) "
+                "AND NOT STARTS_WITH(string_col, 't')"},
+          QueryContext{schema(), reader()}));
+  EXPECT_THAT(GetAllColumnValues(std::move(result.rows)),
+              IsOkAndHolds(ElementsAre(ElementsAre(Int64(4)))));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlFiltersRowsOnUnsupportedConditions) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult result,
+      query_engine().ExecuteSql(
+          Query{"SELECT string_col FROM test_table "
+                "WHERE int64_col > 1 AND LENGTH(string_col) = 3"},
+          QueryContext{schema(), reader()}));
+  EXPECT_THAT(GetAllColumnValues(std::move(result.rows)),
+              IsOkAndHolds(ElementsAre(ElementsAre(String("two")))));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlFailsOnOverflowInFilter) {
+  zetasql_base::StatusOr<QueryResult> result = query_engine().ExecuteSql(
+      Query{"SELECT int64_col FROM test_table "
+            "WHERE int64_col + 9223372036854775807 > 0"},
+      QueryContext{schema(), reader()});
+  absl::Status status = result.status();
+  if (result.ok()) {
+    status = GetAllColumnValues(std::move(result->rows)).status();
+  }
+  EXPECT_THAT(status,
+              zetasql_base::testing::StatusIs(absl::StatusCode::kOutOfRange));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlReadsOnlyFirstRowsInKeyOrder) {
+  Query query{
+      "SELECT int64_col, string_col FROM test_table "
+      "ORDER BY int64_col LIMIT 2"};
+  query.collect_profile = true;
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult result,
+      query_engine().ExecuteSql(query, QueryContext{schema(), reader()}));
+  EXPECT_THAT(GetAllColumnValues(std::move(result.rows)),
+              IsOkAndHolds(ElementsAre(ElementsAre(Int64(1), String("one")),
+                                       ElementsAre(Int64(2), String("two")))));
+  EXPECT_EQ(result.profile->rows_scanned("test_table"), 2);
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlKeepsFirstRowsInOtherOrders) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult result,
+      query_engine().ExecuteSql(
+          Query{"SELECT int64_col FROM test_table ORDER BY string_col LIMIT 2"},
+          QueryContext{schema(), reader()}));
+  EXPECT_THAT(GetAllColumnValues(std::move(result.rows)),
+              IsOkAndHolds(ElementsAre(ElementsAre(Int64(4)),
+                                       ElementsAre(Int64(1)))));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlBindsLimitParameters) {
+  const std::string sql =
+      "SELECT string_col FROM test_table ORDER BY int64_col DESC "
+      "LIMIT @num_rows OFFSET @num_skipped";
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult first,
+      query_engine().ExecuteSql(
+          Query{sql, {{"num_rows", Int64(1)}, {"num_skipped", Int64(1)}}},
+          QueryContext{schema(), reader()}));
+  EXPECT_THAT(GetAllColumnValues(std::move(first.rows)),
+              IsOkAndHolds(ElementsAre(ElementsAre(String("two")))));
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult second,
+      query_engine().ExecuteSql(
+          Query{sql, {{"num_rows", Int64(2)}, {"num_skipped", Int64(0)}}},
+          QueryContext{schema(), reader()}));
+  EXPECT_THAT(GetAllColumnValues(std::move(second.rows)),
+              IsOkAndHolds(ElementsAre(ElementsAre(String("four")),
+                                       ElementsAre(String("two")))));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlAggregatesGroupsOfPrimaryKeyPrefix) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult result,
+      query_engine().ExecuteSql(
+          Query{"SELECT int64_col, COUNT(*), SUM(child_key), MAX(child_key) "
+                "FROM child_table WHERE child_key > 10 GROUP BY int64_col"},
+          QueryContext{multi_table_schema(), reader()}));
+  EXPECT_THAT(
+      GetAllColumnValues(std::move(result.rows)),
+      IsOkAndHolds(UnorderedElementsAre(
+          ElementsAre(Int64(1), Int64(1), Int64(11), Int64(11)),
+          ElementsAre(Int64(3), Int64(1), Int64(30), Int64(30)),
+          ElementsAre(Int64(4), Int64(1), Int64(40), Int64(40)))));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlAggregatesGroupsOfOtherColumns) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult result,
+      query_engine().ExecuteSql(
+          Query{"SELECT COUNT(int64_col), AVG(int64_col) FROM child_table "
+                "GROUP BY child_key > 20"},
+          QueryContext{multi_table_schema(), reader()}));
+  EXPECT_THAT(GetAllColumnValues(std::move(result.rows)),
+              IsOkAndHolds(UnorderedElementsAre(
+                  ElementsAre(Int64(2), Double(1)),
+                  ElementsAre(Int64(2), Double(3.5)))));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlMergesJoinOfInterleavedTables) {
+  Query query{
+      "SELECT t.int64_col, t.string_col, c.child_key "
+      "FROM test_table AS t JOIN child_table AS c "
+      "ON t.int64_col = c.int64_col"};
+  query.collect_profile = true;
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult result,
+      query_engine().ExecuteSql(
+          query, QueryContext{multi_table_schema(), reader()}));
+  EXPECT_THAT(GetAllColumnValues(std::move(result.rows)),
+              IsOkAndHolds(UnorderedElementsAre(
+                  ElementsAre(Int64(1), String("one"), Int64(10)),
+                  ElementsAre(Int64(1), String("one"), Int64(11)),
+                  ElementsAre(Int64(4), String("four"), Int64(40)))));
+
+  // The join is evaluated by a scan of the joined tables.
+  ASSERT_NE(result.profile, nullptr);
+  EXPECT_THAT(result.profile->plan(),
+              Contains(AllOf(Field(&QueryPlanNode::display_name, "TableScan"),
+                             Field(&QueryPlanNode::table,
+                                   "test_table JOIN child_table"))));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlFiltersJoinOnOtherConditions) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult result,
+      query_engine().ExecuteSql(
+          Query{"SELECT c.int64_col, c.child_key "
+                "FROM child_table AS c JOIN test_table AS t "
+                "ON c.int64_col = t.int64_col AND c.child_key > 10 "
+                "WHERE t.int64_col < 5"},
+          QueryContext{multi_table_schema(), reader()}));
+  EXPECT_THAT(GetAllColumnValues(std::move(result.rows)),
+              IsOkAndHolds(UnorderedElementsAre(
+                  ElementsAre(Int64(1), Int64(11)),
+                  ElementsAre(Int64(4), Int64(40)))));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlJoinsTablesByKeyLookup) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult result,
+      query_engine().ExecuteSql(
+          Query{"SELECT c.child_key, t.string_col "
+                "FROM child_table AS c JOIN test_table2 AS t "
+                "ON c.int64_col = t.int64_col"},
+          QueryContext{multi_table_schema(), reader()}));
+  EXPECT_THAT(GetAllColumnValues(std::move(result.rows)),
+              IsOkAndHolds(UnorderedElementsAre(
+                  ElementsAre(Int64(10), String("uno")),
+                  ElementsAre(Int64(11), String("uno")),
+                  ElementsAre(Int64(40), String("cuatro")))));
+}
+
 TEST_F(QueryEngineTest, PartitionableSimpleScan) {
   Query query{"SELECT string_col FROM test_table"};
   ZETASQL_ASSERT_OK(query_engine().IsPartitionable(
@@ -346,6 +882,39 @@ TEST_F(QueryEngineTest, ExecuteInsertsTwoRows) {
               IsOkAndHolds(Field(&QueryResult::modified_row_count, 2)));
 }
 
+// A RowWriter which records the number of rows and whether it is the last
+// batch of its statement for each batch of mutations written to it.
+class BatchRecordingRowWriter : public RowWriter {
+ public:
+  absl::Status Write(const Mutation& m) override {
+    return error::Internal("Statements should be written in batches.");
+  }
+
+  absl::Status WriteBatch(const Mutation& m, bool last_batch) override {
+    batches_.emplace_back(m.ops()[0].rows.size(), last_batch);
+    return absl::OkStatus();
+  }
+
+  const std::vector<std::pair<int, bool>>& batches() const { return batches_; }
+
+ private:
+  std::vector<std::pair<int, bool>> batches_;
+};
+
+TEST_F(QueryEngineTest, ExecuteSqlWritesLargeStatementsInBatches) {
+  BatchRecordingRowWriter writer;
+  EXPECT_THAT(query_engine().ExecuteSql(
+                  Query{"INSERT INTO test_table (int64_col, string_col) "
+                        "SELECT x, 'x' FROM UNNEST(GENERATE_ARRAY(10, 2509)) "
+                        "AS x"},
+                  QueryContext{schema(), reader(), &writer}),
+              IsOkAndHolds(Field(&QueryResult::modified_row_count, 2500)));
+  EXPECT_THAT(writer.batches(),
+              ElementsAre(std::make_pair(1024, false),
+                          std::make_pair(1024, false),
+                          std::make_pair(452, true)));
+}
+
 TEST_F(QueryEngineTest, ExecuteSqlDeleteRows) {
   MockRowWriter writer;
   EXPECT_CALL(writer,
@@ -391,6 +960,32 @@ TEST_F(QueryEngineTest, ExecuteSqlUpdatesRows) {
               IsOkAndHolds(Field(&QueryResult::modified_row_count, 2)));
 }
 
+TEST_F(QueryEngineTest, ExecuteSqlReusesCachedDmlStatementWithNewParams) {
+  MockRowWriter writer;
+  EXPECT_CALL(writer, Write(Property(
+                          &Mutation::ops,
+                          ElementsAre(Field(&MutationOp::rows,
+                                            ElementsAre(ValueList{
+                                                Int64(2), String("foo")}))))))
+      .WillOnce(Return(absl::OkStatus()));
+  EXPECT_CALL(writer, Write(Property(
+                          &Mutation::ops,
+                          ElementsAre(Field(&MutationOp::rows,
+                                            ElementsAre(ValueList{
+                                                Int64(4), String("bar")}))))))
+      .WillOnce(Return(absl::OkStatus()));
+  for (const auto& [key, value] :
+       {std::make_pair(2, "foo"), std::make_pair(4, "bar")}) {
+    EXPECT_THAT(
+        query_engine().ExecuteSql(
+            Query{"UPDATE test_table SET string_col = @value "
+                  "WHERE int64_col = @key",
+                  {{"key", Int64(key)}, {"value", String(value)}}},
+            QueryContext{schema(), reader(), &writer}),
+        IsOkAndHolds(Field(&QueryResult::modified_row_count, 1)));
+  }
+}
+
 TEST_F(QueryEngineTest, CannotInsertDuplicateValuesForPrimaryKey) {
   MockRowWriter writer;
   EXPECT_THAT(query_engine().ExecuteSql(
@@ -408,6 +1003,147 @@ TEST_F(QueryEngineTest, ConnotUpdatePrimaryKey) {
               zetasql_base::testing::StatusIs(absl::StatusCode::kInvalidArgument));
 }
 
+TEST_F(QueryEngineTest, ExecuteSqlCachesRowsOfSnapshotQueries) {
+  InMemoryStorage storage;
+  QueryEngine engine(type_factory(), ParallelQueryOptions(),
+                     QueryResultCacheOptions{.storage = &storage,
+                                             .max_bytes = 1024 * 1024});
+  CountingRowReader counting_reader(reader());
+  const absl::Time t0 = absl::Now();
+  auto execute = [&](int64_t min_key, absl::Time read_timestamp)
+      -> zetasql_base::StatusOr<std::vector<std::vector<zetasql::Value>>> {
+    ZETASQL_ASSIGN_OR_RETURN(
+        QueryResult result,
+        engine.ExecuteSql(
+            Query{"SELECT int64_col FROM test_table WHERE int64_col > @min_key",
+                  {{"min_key", Int64(min_key)}}},
+            QueryContext{.schema = schema(),
+                         .reader = &counting_reader,
+                         .writer = nullptr,
+                         .read_timestamp = read_timestamp}));
+    return GetAllColumnValues(std::move(result.rows));
+  };
+
+  EXPECT_THAT(execute(1, t0),
+              IsOkAndHolds(UnorderedElementsAre(ElementsAre(Int64(2)),
+                                                ElementsAre(Int64(4)))));
+  EXPECT_EQ(counting_reader.num_reads(), 1);
+
+  // The same query with the same parameters is served from the cache, even at
+  // a later timestamp since the table has not changed.
+  EXPECT_THAT(execute(1, t0 + absl::Seconds(1)),
+              IsOkAndHolds(UnorderedElementsAre(ElementsAre(Int64(2)),
+                                                ElementsAre(Int64(4)))));
+  EXPECT_EQ(counting_reader.num_reads(), 1);
+
+  // Other parameter values are executed again.
+  EXPECT_THAT(execute(2, t0),
+              IsOkAndHolds(UnorderedElementsAre(ElementsAre(Int64(4)))));
+  EXPECT_EQ(counting_reader.num_reads(), 2);
+
+  // So is the query once the table it read was written to.
+  ZETASQL_ASSERT_OK(storage.Write(t0 + absl::Seconds(2),
+                          schema()->FindTable("test_table")->id(),
+                          Key({Int64(8)}), {}, {}));
+  EXPECT_THAT(execute(1, t0 + absl::Seconds(3)),
+              IsOkAndHolds(UnorderedElementsAre(ElementsAre(Int64(2)),
+                                                ElementsAre(Int64(4)))));
+  EXPECT_EQ(counting_reader.num_reads(), 3);
+  EXPECT_THAT(execute(1, t0 + absl::Seconds(3)),
+              IsOkAndHolds(UnorderedElementsAre(ElementsAre(Int64(2)),
+                                                ElementsAre(Int64(4)))));
+  EXPECT_EQ(counting_reader.num_reads(), 3);
+
+  // The cached rows do not hold for reads before the write.
+  ZETASQL_EXPECT_OK(execute(1, t0 + absl::Seconds(1)));
+  EXPECT_EQ(counting_reader.num_reads(), 4);
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlDoesNotCacheRowsOfNondeterministicQueries) {
+  InMemoryStorage storage;
+  QueryEngine engine(type_factory(), ParallelQueryOptions(),
+                     QueryResultCacheOptions{.storage = &storage,
+                                             .max_bytes = 1024 * 1024});
+  CountingRowReader counting_reader(reader());
+  const absl::Time t0 = absl::Now();
+  for (int i = 0; i < 2; ++i) {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        QueryResult result,
+        engine.ExecuteSql(Query{"SELECT int64_col, RAND() FROM test_table"},
+                          QueryContext{.schema = schema(),
+                                       .reader = &counting_reader,
+                                       .writer = nullptr,
+                                       .read_timestamp = t0}));
+    ZETASQL_EXPECT_OK(GetAllColumnValues(std::move(result.rows)));
+  }
+  EXPECT_EQ(counting_reader.num_reads(), 2);
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlReportsLockStatsAsOfEachExecution) {
+  InMemoryStorage storage;
+  LockStats lock_stats;
+  QueryEngine engine(type_factory(), ParallelQueryOptions(),
+                     QueryResultCacheOptions{.storage = &storage,
+                                             .max_bytes = 1024 * 1024},
+                     QueryLimits(), ExternalSortOptions(), &lock_stats);
+  const absl::Time t0 = absl::Now();
+  auto execute = [&]()
+      -> zetasql_base::StatusOr<std::vector<std::vector<zetasql::Value>>> {
+    ZETASQL_ASSIGN_OR_RETURN(
+        QueryResult result,
+        engine.ExecuteSql(Query{"SELECT TABLE_NAME, LOCK_CONFLICTS "
+                                "FROM SPANNER_SYS.LOCK_STATS_TOP_TABLES"},
+                          QueryContext{.schema = schema(),
+                                       .reader = reader(),
+                                       .writer = nullptr,
+                                       .read_timestamp = t0}));
+    EXPECT_FALSE(result.deterministic);
+    return GetAllColumnValues(std::move(result.rows));
+  };
+
+  EXPECT_THAT(execute(), IsOkAndHolds(ElementsAre()));
+
+  // The rows are generated again rather than served from the result cache.
+  lock_stats.RecordConflict(schema()->FindTable("test_table")->id(),
+                            Key({Int64(1)}));
+  EXPECT_THAT(execute(), IsOkAndHolds(ElementsAre(ElementsAre(
+                             String("test_table"), Int64(1)))));
+}
+
+TEST_F(QueryEngineTest, ExecuteSqlCountsExecutionsByQueryShape) {
+  for (const char* sql :
+       {"SELECT int64_col FROM test_table WHERE int64_col = 1",
+        "SELECT int64_col FROM test_table WHERE int64_col = 2"}) {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        QueryResult result,
+        query_engine().ExecuteSql(
+            Query{sql}, QueryContext{.schema = schema(), .reader = reader()}));
+    ZETASQL_EXPECT_OK(GetAllColumnValues(std::move(result.rows)));
+  }
+
+  std::vector<QueryStats::Entry> top =
+      query_engine().query_stats().TopQueries(1);
+  ASSERT_EQ(top.size(), 1);
+  EXPECT_EQ(top[0].text,
+            "SELECT int64_col FROM test_table WHERE int64_col = ?");
+  EXPECT_EQ(top[0].execution_count, 2);
+  EXPECT_EQ(top[0].rows_returned, 2);
+  EXPECT_GT(top[0].rows_scanned, 0);
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      QueryResult result,
+      query_engine().ExecuteSql(
+          Query{"SELECT TEXT, EXECUTION_COUNT, AVG_ROWS "
+                "FROM SPANNER_SYS.QUERY_STATS_TOP_QUERIES "
+                "WHERE TEXT LIKE '%test_table%'"},
+          QueryContext{.schema = schema(), .reader = reader()}));
+  EXPECT_THAT(
+      GetAllColumnValues(std::move(result.rows)),
+      IsOkAndHolds(ElementsAre(ElementsAre(
+          String("SELECT int64_col FROM test_table WHERE int64_col = ?"),
+          Int64(2), Double(1)))));
+}
+
 }  // namespace
 
 }  // namespace backend
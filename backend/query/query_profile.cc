@@ -0,0 +1,110 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/query/query_profile.h"
+
+#include <time.h>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "zetasql/resolved_ast/resolved_ast_visitor.h"
+#include "absl/status/status.h"
+#include "absl/time/time.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// Adds a plan node for each statement and scan of a resolved AST. Scans nested
+// in expressions, such as the scans of subqueries, become children of the
+// closest enclosing plan node.
+class QueryPlanBuilder : public zetasql::ResolvedASTVisitor {
+ public:
+  explicit QueryPlanBuilder(std::vector<QueryPlanNode>* plan) : plan_(plan) {}
+
+  absl::Status DefaultVisit(const zetasql::ResolvedNode* node) override {
+    if (!node->IsStatement() && !node->IsScan()) {
+      return zetasql::ResolvedASTVisitor::DefaultVisit(node);
+    }
+    const int index = plan_->size();
+    if (parent_index_ >= 0) {
+      (*plan_)[parent_index_].child_indexes.push_back(index);
+    }
+    QueryPlanNode plan_node;
+    plan_node.display_name = node->node_kind_string();
+    if (node->node_kind() == zetasql::RESOLVED_TABLE_SCAN) {
+      plan_node.table =
+          node->GetAs<zetasql::ResolvedTableScan>()->table()->Name();
+    }
+    plan_->push_back(std::move(plan_node));
+
+    const int parent_index = parent_index_;
+    parent_index_ = index;
+    ZETASQL_RETURN_IF_ERROR(zetasql::ResolvedASTVisitor::DefaultVisit(node));
+    parent_index_ = parent_index;
+    return absl::OkStatus();
+  }
+
+ private:
+  std::vector<QueryPlanNode>* plan_;
+
+  // Index of the plan node of the closest enclosing statement or scan, or -1
+  // at the root.
+  int parent_index_ = -1;
+};
+
+}  // namespace
+
+QueryProfile::QueryProfile(const zetasql::ResolvedStatement& statement) {
+  QueryPlanBuilder builder(&plan_);
+  // The builder does not fail, it only visits the nodes of the tree.
+  statement.Accept(&builder).IgnoreError();
+}
+
+int64_t QueryProfile::rows_scanned(const std::string& table) const {
+  auto itr = rows_scanned_.find(table);
+  return itr == rows_scanned_.end() ? 0 : itr->second;
+}
+
+int64_t QueryProfile::total_rows_scanned() const {
+  int64_t total = 0;
+  for (const auto& [table, rows] : rows_scanned_) {
+    total += rows;
+  }
+  return total;
+}
+
+absl::Duration ThreadCpuTime() {
+  timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+    return absl::ZeroDuration();
+  }
+  return absl::DurationFromTimespec(ts);
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,116 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_QUERY_PROFILE_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_QUERY_PROFILE_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// QueryPlanNode describes one relational operator of a statement, as evaluated
+// by the ZetaSQL reference implementation.
+struct QueryPlanNode {
+  // Name of the operator, which is the kind of its resolved node (for example,
+  // "FilterScan" or "QueryStmt").
+  std::string display_name;
+
+  // Name of the table read by a table scan. Empty for other operators.
+  std::string table;
+
+  // Indexes of the operators producing the input rows of this one.
+  std::vector<int> child_indexes;
+};
+
+// QueryProfile holds the plan of a statement along with statistics collected
+// while it is executed, used to answer queries executed in PROFILE mode.
+//
+// The reference implementation does not expose the rows produced by each of
+// its operators, so the statistics are limited to the rows read from each
+// table and the CPU time spent evaluating the statement.
+//
+// This class is not thread-safe, profiled statements are evaluated by a single
+// thread.
+class QueryProfile {
+ public:
+  // Builds the plan of `statement`. Statement and scan nodes become plan
+  // nodes, listed in pre-order so that the root of the plan is at index 0.
+  explicit QueryProfile(const zetasql::ResolvedStatement& statement);
+
+  const std::vector<QueryPlanNode>& plan() const { return plan_; }
+
+  // Returns the counter of rows read from `table` (and its indexes), which
+  // remains valid for the lifetime of the profile.
+  int64_t* mutable_rows_scanned(const std::string& table) {
+    return &rows_scanned_[table];
+  }
+
+  // Returns the number of rows read from `table` and its indexes.
+  int64_t rows_scanned(const std::string& table) const;
+
+  // Returns the number of rows read from all tables.
+  int64_t total_rows_scanned() const;
+
+  void AddCpuTime(absl::Duration cpu_time) { cpu_time_ += cpu_time; }
+  absl::Duration cpu_time() const { return cpu_time_; }
+
+ private:
+  std::vector<QueryPlanNode> plan_;
+
+  // Rows read so far, by table name.
+  std::map<std::string, int64_t> rows_scanned_;
+
+  // CPU time spent so far evaluating the statement.
+  absl::Duration cpu_time_;
+};
+
+// Returns the CPU time consumed by the calling thread so far.
+absl::Duration ThreadCpuTime();
+
+// Adds the CPU time consumed by the calling thread during the lifetime of the
+// recorder to a profile. Does nothing if the profile is null.
+class ScopedCpuTimeRecorder {
+ public:
+  explicit ScopedCpuTimeRecorder(QueryProfile* profile)
+      : profile_(profile),
+        start_(profile != nullptr ? ThreadCpuTime() : absl::ZeroDuration()) {}
+
+  ~ScopedCpuTimeRecorder() {
+    if (profile_ != nullptr) {
+      profile_->AddCpuTime(ThreadCpuTime() - start_);
+    }
+  }
+
+ private:
+  QueryProfile* profile_;
+  const absl::Duration start_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_QUERY_PROFILE_H_
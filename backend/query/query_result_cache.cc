@@ -0,0 +1,335 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/query/query_result_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "backend/access/read.h"
+#include "backend/schema/catalog/index.h"
+#include "backend/schema/catalog/schema.h"
+#include "backend/schema/catalog/table.h"
+#include "backend/storage/storage.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// Approximate bytes of bookkeeping of a cached row, besides its values.
+constexpr int64_t kRowOverheadBytes = sizeof(std::vector<zetasql::Value>);
+
+}  // namespace
+
+// QueryResultCache::CachedRowCursor reads the rows of a cached result, which it
+// keeps alive even if the result is evicted from the cache meanwhile.
+class QueryResultCache::CachedRowCursor : public RowCursor {
+ public:
+  explicit CachedRowCursor(std::shared_ptr<const Result> result)
+      : result_(std::move(result)) {}
+
+  bool Next() override {
+    return ++row_ < static_cast<int64_t>(result_->rows.size());
+  }
+
+  absl::Status Status() const override { return absl::OkStatus(); }
+
+  int NumColumns() const override { return result_->column_names.size(); }
+
+  const std::string ColumnName(int i) const override {
+    return result_->column_names[i];
+  }
+
+  const zetasql::Type* ColumnType(int i) const override {
+    return result_->column_types[i];
+  }
+
+  const zetasql::Value ColumnValue(int i) const override {
+    return result_->rows[row_][i];
+  }
+
+ private:
+  const std::shared_ptr<const Result> result_;
+
+  // Index of the current row, or -1 before the first call to Next().
+  int64_t row_ = -1;
+};
+
+// QueryResultCache::CachingRowCursor forwards the rows of a query as they are
+// read, copying them into a result which is added to the cache once the
+// wrapped cursor is exhausted. Copying stops once the rows outgrow the largest
+// result the cache holds.
+class QueryResultCache::CachingRowCursor : public RowCursor {
+ public:
+  CachingRowCursor(QueryResultCache* cache, const Schema* schema,
+                   std::string key, int64_t generation,
+                   absl::Time read_timestamp, bool ordered,
+                   std::unique_ptr<TableVersionRecorder> recorder,
+                   std::unique_ptr<RowCursor> rows)
+      : cache_(cache),
+        schema_(schema),
+        key_(std::move(key)),
+        generation_(generation),
+        recorder_(std::move(recorder)),
+        rows_(std::move(rows)),
+        result_(std::make_shared<Result>()) {
+    result_->read_timestamp = read_timestamp;
+    result_->ordered = ordered;
+    for (int i = 0; i < rows_->NumColumns(); ++i) {
+      result_->column_names.push_back(rows_->ColumnName(i));
+      result_->column_types.push_back(rows_->ColumnType(i));
+    }
+  }
+
+  bool Next() override {
+    if (!rows_->Next()) {
+      if (result_ != nullptr && rows_->Status().ok() &&
+          recorder_->complete()) {
+        result_->table_versions = recorder_->versions();
+        cache_->Insert(schema_, key_, generation_, std::move(result_));
+      }
+      result_ = nullptr;
+      return false;
+    }
+    if (result_ != nullptr) {
+      std::vector<zetasql::Value> row;
+      row.reserve(rows_->NumColumns());
+      int64_t row_bytes = kRowOverheadBytes;
+      for (int i = 0; i < rows_->NumColumns(); ++i) {
+        row.push_back(rows_->ColumnValue(i));
+        row_bytes += row.back().physical_byte_size();
+      }
+      result_->rows.push_back(std::move(row));
+      result_->bytes += row_bytes;
+      if (result_->bytes > cache_->max_bytes_ / kMaxResultFraction) {
+        result_ = nullptr;
+      }
+    }
+    return true;
+  }
+
+  absl::Status Status() const override { return rows_->Status(); }
+
+  int NumColumns() const override { return rows_->NumColumns(); }
+
+  const std::string ColumnName(int i) const override {
+    return rows_->ColumnName(i);
+  }
+
+  const zetasql::Type* ColumnType(int i) const override {
+    return rows_->ColumnType(i);
+  }
+
+  const zetasql::Value ColumnValue(int i) const override {
+    return rows_->ColumnValue(i);
+  }
+
+ private:
+  QueryResultCache* cache_;
+  const Schema* schema_;
+  const std::string key_;
+  const int64_t generation_;
+
+  // Declared before the rows, which read through it.
+  std::unique_ptr<TableVersionRecorder> recorder_;
+  std::unique_ptr<RowCursor> rows_;
+
+  // The rows read so far, or null once the rows are known not to be cached.
+  std::shared_ptr<Result> result_;
+};
+
+absl::Status TableVersionRecorder::Read(const ReadArg& read_arg,
+                                        std::unique_ptr<RowCursor>* cursor) {
+  RecordRead(read_arg);
+  return target_->Read(read_arg, cursor);
+}
+
+absl::Status TableVersionRecorder::ReadInterleaved(
+    const ReadArg& parent_arg, const ReadArg& child_arg,
+    std::unique_ptr<RowCursor>* parent_cursor,
+    std::unique_ptr<RowCursor>* child_cursor) {
+  RecordRead(parent_arg);
+  RecordRead(child_arg);
+  return target_->ReadInterleaved(parent_arg, child_arg, parent_cursor,
+                                  child_cursor);
+}
+
+void TableVersionRecorder::RecordRead(const ReadArg& read_arg) {
+  // Index reads return the rows of the index's data table.
+  const Table* table = nullptr;
+  if (!read_arg.index.empty()) {
+    const Index* index = schema_->FindIndex(read_arg.index);
+    if (index != nullptr) {
+      table = index->index_data_table();
+    }
+  } else {
+    table = schema_->FindTable(read_arg.table);
+  }
+  if (table == nullptr) {
+    absl::MutexLock lock(&mu_);
+    complete_ = false;
+  } else {
+    RecordVersion(table->id());
+  }
+}
+
+void TableVersionRecorder::RecordVersion(const TableID& table_id) {
+  {
+    absl::MutexLock lock(&mu_);
+    if (versions_.contains(table_id)) {
+      return;
+    }
+  }
+  absl::optional<TableVersion> version = storage_->GetTableVersion(table_id);
+  absl::MutexLock lock(&mu_);
+  if (!version.has_value()) {
+    complete_ = false;
+    return;
+  }
+  // Concurrent reads of the same table keep the version recorded first.
+  versions_.emplace(table_id, *version);
+}
+
+bool TableVersionRecorder::complete() const {
+  absl::MutexLock lock(&mu_);
+  return complete_;
+}
+
+void TableVersionRecorder::MarkIncomplete() {
+  absl::MutexLock lock(&mu_);
+  complete_ = false;
+}
+
+std::vector<std::pair<TableID, TableVersion>> TableVersionRecorder::versions()
+    const {
+  absl::MutexLock lock(&mu_);
+  return {versions_.begin(), versions_.end()};
+}
+
+std::unique_ptr<RowCursor> QueryResultCache::Lookup(const Schema* schema,
+                                                    const std::string& key,
+                                                    absl::Time read_timestamp,
+                                                    bool* ordered) {
+  std::shared_ptr<const Result> result;
+  {
+    absl::MutexLock lock(&mu_);
+    auto itr = entries_.find(Key(schema, key));
+    if (itr == entries_.end()) {
+      return nullptr;
+    }
+    result = itr->second.result;
+    lru_.splice(lru_.begin(), lru_, itr->second.lru_position);
+  }
+
+  // The storage is not consulted with the cache's lock held, so that lookups
+  // of other queries are not serialized behind it.
+  if (!IsUpToDate(*result, read_timestamp)) {
+    absl::MutexLock lock(&mu_);
+    auto itr = entries_.find(Key(schema, key));
+    if (itr != entries_.end() && itr->second.result == result) {
+      Erase(itr);
+    }
+    return nullptr;
+  }
+  *ordered = result->ordered;
+  return absl::make_unique<CachedRowCursor>(std::move(result));
+}
+
+std::unique_ptr<RowCursor> QueryResultCache::CacheRows(
+    const Schema* schema, const std::string& key, absl::Time read_timestamp,
+    bool ordered, std::unique_ptr<TableVersionRecorder> recorder,
+    std::unique_ptr<RowCursor> rows) {
+  int64_t generation;
+  {
+    absl::MutexLock lock(&mu_);
+    generation = generation_;
+  }
+  return absl::make_unique<CachingRowCursor>(
+      this, schema, key, generation, read_timestamp, ordered,
+      std::move(recorder), std::move(rows));
+}
+
+void QueryResultCache::Insert(const Schema* schema, const std::string& key,
+                              int64_t generation,
+                              std::shared_ptr<const Result> result) {
+  absl::MutexLock lock(&mu_);
+  if (generation != generation_) {
+    return;
+  }
+  auto itr = entries_.find(Key(schema, key));
+  if (itr != entries_.end()) {
+    Erase(itr);
+  }
+  while (!lru_.empty() && bytes_ + result->bytes > max_bytes_) {
+    Erase(entries_.find(lru_.back()));
+  }
+  lru_.push_front(Key(schema, key));
+  bytes_ += result->bytes;
+  entries_[lru_.front()] = Entry{std::move(result), lru_.begin()};
+}
+
+bool QueryResultCache::IsUpToDate(const Result& result,
+                                  absl::Time read_timestamp) const {
+  // The rows are the same at both timestamps if no table changed between
+  // them, and the tables have not changed since the rows were read.
+  const absl::Time since = std::min(read_timestamp, result.read_timestamp);
+  for (const auto& [table_id, version] : result.table_versions) {
+    absl::optional<TableVersion> current = storage_->GetTableVersion(table_id);
+    if (!current.has_value() || *current != version ||
+        current->max_change_timestamp > since) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void QueryResultCache::Erase(absl::flat_hash_map<Key, Entry>::iterator itr) {
+  bytes_ -= itr->second.result->bytes;
+  lru_.erase(itr->second.lru_position);
+  entries_.erase(itr);
+}
+
+void QueryResultCache::Clear() {
+  absl::MutexLock lock(&mu_);
+  ++generation_;
+  entries_.clear();
+  lru_.clear();
+  bytes_ = 0;
+}
+
+int64_t QueryResultCache::bytes() const {
+  absl::MutexLock lock(&mu_);
+  return bytes_;
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
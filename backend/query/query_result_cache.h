@@ -0,0 +1,217 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_QUERY_RESULT_CACHE_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_QUERY_RESULT_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "backend/access/read.h"
+#include "backend/common/ids.h"
+#include "backend/schema/catalog/schema.h"
+#include "backend/storage/storage.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// QueryResultCacheOptions controls the caching of query results by
+// QueryEngine.
+struct QueryResultCacheOptions {
+  // The storage read by the queries, whose table versions tell whether cached
+  // results are still up to date. Results are not cached if null.
+  const Storage* storage = nullptr;
+
+  // Maximum number of bytes of rows cached. Results are not cached if 0.
+  int64_t max_bytes = 0;
+};
+
+// TableVersionRecorder forwards reads to a target reader, recording the
+// version each table read has in the storage as of its first read. Since the
+// version is recorded before the table is read, rows read from a table which
+// still has the recorded version are still up to date.
+//
+// This class is thread-safe if the target reader is.
+class TableVersionRecorder : public RowReader {
+ public:
+  TableVersionRecorder(RowReader* target, const Schema* schema,
+                       const Storage* storage)
+      : target_(target), schema_(schema), storage_(storage) {}
+
+  absl::Status Read(const ReadArg& read_arg,
+                    std::unique_ptr<RowCursor>* cursor) override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  absl::Status ReadInterleaved(const ReadArg& parent_arg,
+                               const ReadArg& child_arg,
+                               std::unique_ptr<RowCursor>* parent_cursor,
+                               std::unique_ptr<RowCursor>* child_cursor)
+      override ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns false if a table was read whose version could not be recorded,
+  // such as a table the storage does not track the versions of, or if the
+  // recorder was marked incomplete.
+  bool complete() const ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Marks the recorded versions as incomplete, so that the rows read through
+  // the recorder are not cached.
+  void MarkIncomplete() ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the versions of the tables read so far.
+  std::vector<std::pair<TableID, TableVersion>> versions() const
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  // Records the version of the table which `read_arg` reads.
+  void RecordRead(const ReadArg& read_arg) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Records the version of the table stored under `table_id`.
+  void RecordVersion(const TableID& table_id) ABSL_LOCKS_EXCLUDED(mu_);
+
+  RowReader* target_;
+  const Schema* schema_;
+  const Storage* storage_;
+
+  mutable absl::Mutex mu_;
+  absl::flat_hash_map<TableID, TableVersion> versions_ ABSL_GUARDED_BY(mu_);
+  bool complete_ ABSL_GUARDED_BY(mu_) = true;
+};
+
+// QueryResultCache is a least recently used cache of the rows returned by
+// read-only queries, keyed by the schema the query was executed against and a
+// key describing the SQL text and parameter values of the query.
+//
+// Each result records the versions of the tables it was computed from and
+// the timestamp it was read at. It is returned for later reads of the same
+// query for as long as these tables keep the same versions, and none of them
+// changed after the earlier of the two read timestamps, so that repeated
+// strong reads of tables which are not written to are served from the cache.
+//
+// This class is thread-safe.
+class QueryResultCache {
+ public:
+  QueryResultCache(const Storage* storage, int64_t max_bytes)
+      : storage_(storage), max_bytes_(max_bytes) {}
+
+  // Returns a cursor over the rows cached for `key` against `schema` which are
+  // up to date at `read_timestamp`, or null if there are none. Sets `ordered`
+  // to whether the rows were ordered by the query.
+  std::unique_ptr<RowCursor> Lookup(const Schema* schema,
+                                    const std::string& key,
+                                    absl::Time read_timestamp, bool* ordered)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns a cursor over `rows`, the result of the query `key` read at
+  // `read_timestamp` through `recorder`, which caches the rows once they have
+  // all been read. Rows are not cached if they are larger than a fraction of
+  // the cache, or if the recorder could not record the versions of all the
+  // tables read. The cursor holds the recorder, which is destroyed after
+  // `rows`.
+  std::unique_ptr<RowCursor> CacheRows(
+      const Schema* schema, const std::string& key, absl::Time read_timestamp,
+      bool ordered, std::unique_ptr<TableVersionRecorder> recorder,
+      std::unique_ptr<RowCursor> rows);
+
+  // Discards all cached results. Called when the schema changes.
+  void Clear() ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the approximate number of bytes of rows currently cached.
+  int64_t bytes() const ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  // The result of a query, shared with the cursors reading it.
+  struct Result {
+    std::vector<std::string> column_names;
+    std::vector<const zetasql::Type*> column_types;
+    std::vector<std::vector<zetasql::Value>> rows;
+    bool ordered = false;
+
+    // Versions of the tables the rows were read from.
+    std::vector<std::pair<TableID, TableVersion>> table_versions;
+    absl::Time read_timestamp;
+
+    // Approximate bytes of memory held by the rows.
+    int64_t bytes = 0;
+  };
+
+  using Key = std::pair<const Schema*, std::string>;
+
+  struct Entry {
+    std::shared_ptr<const Result> result;
+
+    // Position of the key in lru_.
+    std::list<Key>::iterator lru_position;
+  };
+
+  // Cursors over the rows of a cached result, and over the rows of a query
+  // which caches them once they have been read.
+  class CachedRowCursor;
+  class CachingRowCursor;
+
+  // Adds a result read while the cache was at `generation` to the cache,
+  // evicting the least recently used results until it fits. The result is
+  // discarded if the cache was cleared since.
+  void Insert(const Schema* schema, const std::string& key,
+              int64_t generation, std::shared_ptr<const Result> result)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns true if `result` is up to date for a read at `read_timestamp`.
+  bool IsUpToDate(const Result& result, absl::Time read_timestamp) const;
+
+  // Removes the entry of `itr` from the cache.
+  void Erase(absl::flat_hash_map<Key, Entry>::iterator itr)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Results larger than max_bytes_ / kMaxResultFraction are not cached, so
+  // that a single large result does not evict all others.
+  static constexpr int kMaxResultFraction = 4;
+
+  const Storage* const storage_;
+  const int64_t max_bytes_;
+
+  mutable absl::Mutex mu_;
+
+  // Incremented by Clear(), so that results read before are not cached.
+  int64_t generation_ ABSL_GUARDED_BY(mu_) = 0;
+
+  absl::flat_hash_map<Key, Entry> entries_ ABSL_GUARDED_BY(mu_);
+
+  // Keys of the cached results, most recently used first.
+  std::list<Key> lru_ ABSL_GUARDED_BY(mu_);
+
+  // Approximate bytes of the cached results.
+  int64_t bytes_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_QUERY_RESULT_CACHE_H_
@@ -0,0 +1,166 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/query/query_result_cache.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "backend/access/read.h"
+#include "backend/datamodel/key.h"
+#include "backend/schema/catalog/schema.h"
+#include "backend/storage/in_memory_storage.h"
+#include "tests/common/row_reader.h"
+#include "tests/common/schema_constructor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql::values::Int64;
+using zetasql::values::String;
+
+// Returns the values of the first column of the remaining rows of `cursor`.
+std::vector<zetasql::Value> ReadAll(RowCursor* cursor) {
+  std::vector<zetasql::Value> values;
+  while (cursor->Next()) {
+    values.push_back(cursor->ColumnValue(0));
+  }
+  return values;
+}
+
+class QueryResultCacheTest : public testing::Test {
+ protected:
+  // Returns a cursor over the keys of test_table read through a recorder,
+  // whose rows are cached under `key` once they have been read.
+  std::unique_ptr<RowCursor> ReadTable(QueryResultCache* cache,
+                                       const std::string& key,
+                                       absl::Time read_timestamp) {
+    auto recorder = absl::make_unique<TableVersionRecorder>(
+        &reader_, schema_.get(), &storage_);
+    ReadArg read_arg;
+    read_arg.table = "test_table";
+    read_arg.columns = {"int64_col"};
+    std::unique_ptr<RowCursor> rows;
+    EXPECT_TRUE(recorder->Read(read_arg, &rows).ok());
+    return cache->CacheRows(schema_.get(), key, read_timestamp,
+                            /*ordered=*/true, std::move(recorder),
+                            std::move(rows));
+  }
+
+  // Writes a row of test_table at the given timestamp.
+  void WriteTable(absl::Time timestamp) {
+    EXPECT_TRUE(storage_
+                    .Write(timestamp, schema_->FindTable("test_table")->id(),
+                           Key({Int64(1)}), {}, {})
+                    .ok());
+  }
+
+  const Schema* schema() { return schema_.get(); }
+
+  const absl::Time t0_ = absl::Now();
+  InMemoryStorage storage_;
+
+ private:
+  zetasql::TypeFactory type_factory_;
+  std::unique_ptr<const Schema> schema_ =
+      test::CreateSchemaWithOneTable(&type_factory_);
+  test::TestRowReader reader_{
+      {{"test_table",
+        {{"int64_col", "string_col"},
+         {zetasql::types::Int64Type(), zetasql::types::StringType()},
+         {{Int64(1), String("one")}, {Int64(2), String("two")}}}}}};
+};
+
+TEST_F(QueryResultCacheTest, CachesRowsOnceAllHaveBeenRead) {
+  QueryResultCache cache(&storage_, /*max_bytes=*/1024 * 1024);
+  bool ordered = false;
+  EXPECT_EQ(cache.Lookup(schema(), "q", t0_, &ordered), nullptr);
+
+  std::unique_ptr<RowCursor> rows = ReadTable(&cache, "q", t0_);
+  ASSERT_TRUE(rows->Next());
+  EXPECT_EQ(cache.Lookup(schema(), "q", t0_, &ordered), nullptr);
+  EXPECT_THAT(ReadAll(rows.get()), testing::ElementsAre(Int64(2)));
+  EXPECT_GT(cache.bytes(), 0);
+
+  std::unique_ptr<RowCursor> cached =
+      cache.Lookup(schema(), "q", t0_, &ordered);
+  ASSERT_NE(cached, nullptr);
+  EXPECT_TRUE(ordered);
+  ASSERT_EQ(cached->NumColumns(), 1);
+  EXPECT_EQ(cached->ColumnName(0), "int64_col");
+  EXPECT_THAT(ReadAll(cached.get()),
+              testing::ElementsAre(Int64(1), Int64(2)));
+  EXPECT_EQ(cache.Lookup(schema(), "other", t0_, &ordered), nullptr);
+}
+
+TEST_F(QueryResultCacheTest, DiscardsRowsOnceTheirTableChanges) {
+  QueryResultCache cache(&storage_, /*max_bytes=*/1024 * 1024);
+  bool ordered = false;
+  WriteTable(t0_);
+  ReadAll(ReadTable(&cache, "q", t0_ + absl::Seconds(1)).get());
+
+  // The rows hold for reads at any timestamp after the table last changed.
+  EXPECT_NE(cache.Lookup(schema(), "q", t0_ + absl::Seconds(2), &ordered),
+            nullptr);
+  EXPECT_NE(cache.Lookup(schema(), "q", t0_, &ordered), nullptr);
+  EXPECT_EQ(cache.Lookup(schema(), "q", t0_ - absl::Seconds(1), &ordered),
+            nullptr);
+
+  ReadAll(ReadTable(&cache, "q", t0_ + absl::Seconds(1)).get());
+  WriteTable(t0_ + absl::Seconds(3));
+  EXPECT_EQ(cache.Lookup(schema(), "q", t0_ + absl::Seconds(4), &ordered),
+            nullptr);
+  EXPECT_EQ(cache.bytes(), 0);
+}
+
+TEST_F(QueryResultCacheTest, DoesNotCacheLargeResults) {
+  QueryResultCache cache(&storage_, /*max_bytes=*/16);
+  bool ordered = false;
+  ReadAll(ReadTable(&cache, "q", t0_).get());
+  EXPECT_EQ(cache.Lookup(schema(), "q", t0_, &ordered), nullptr);
+  EXPECT_EQ(cache.bytes(), 0);
+}
+
+TEST_F(QueryResultCacheTest, ClearDiscardsCachedAndPendingResults) {
+  QueryResultCache cache(&storage_, /*max_bytes=*/1024 * 1024);
+  bool ordered = false;
+  ReadAll(ReadTable(&cache, "q1", t0_).get());
+  std::unique_ptr<RowCursor> pending = ReadTable(&cache, "q2", t0_);
+
+  cache.Clear();
+  ReadAll(pending.get());
+  EXPECT_EQ(cache.Lookup(schema(), "q1", t0_, &ordered), nullptr);
+  EXPECT_EQ(cache.Lookup(schema(), "q2", t0_, &ordered), nullptr);
+  EXPECT_EQ(cache.bytes(), 0);
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,292 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/query/query_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "farmhash.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+bool IsIdentifierChar(char c) { return absl::ascii_isalnum(c) || c == '_'; }
+
+// Returns the length of the string or bytes literal at the start of `sql`,
+// including its r and b prefixes and its quotes, or 0 if `sql` does not start
+// with one.
+size_t StringLiteralLength(absl::string_view sql) {
+  size_t pos = 0;
+  while (pos < sql.size() && pos < 2 &&
+         (absl::ascii_tolower(sql[pos]) == 'r' ||
+          absl::ascii_tolower(sql[pos]) == 'b')) {
+    ++pos;
+  }
+  if (pos == sql.size() || (sql[pos] != '\'' && sql[pos] != '"')) {
+    return 0;
+  }
+  const char quote = sql[pos];
+  const bool triple = sql.substr(pos, 3) == std::string(3, quote);
+  pos += triple ? 3 : 1;
+  while (pos < sql.size()) {
+    if (sql[pos] == '\\') {
+      // Even in raw literals, a backslash keeps the next quote from closing the
+      // literal.
+      pos += 2;
+    } else if (sql[pos] == quote &&
+               (!triple || sql.substr(pos, 3) == std::string(3, quote))) {
+      return pos + (triple ? 3 : 1);
+    } else {
+      ++pos;
+    }
+  }
+  // Unterminated literals extend to the end of the statement.
+  return sql.size();
+}
+
+// Returns the length of the numeric literal at the start of `sql`, which
+// starts with a digit or a period followed by a digit.
+size_t NumericLiteralLength(absl::string_view sql) {
+  const bool hex = sql.size() > 1 && sql[0] == '0' &&
+                   absl::ascii_tolower(sql[1]) == 'x';
+  size_t pos = 0;
+  while (pos < sql.size()) {
+    const char c = sql[pos];
+    if ((c == '+' || c == '-') && !hex &&
+        absl::ascii_tolower(sql[pos - 1]) == 'e') {
+      ++pos;
+    } else if (IsIdentifierChar(c) || c == '.') {
+      ++pos;
+    } else {
+      break;
+    }
+  }
+  return pos;
+}
+
+// Appends a literal to the normalized text in `out`, collapsing it into the
+// previous literal if both are elements of the same list.
+void AppendLiteral(std::string* out) {
+  size_t end = out->size();
+  while (end > 0 && (*out)[end - 1] == ' ') --end;
+  if (end > 0 && (*out)[end - 1] == ',') {
+    size_t prev = end - 1;
+    while (prev > 0 && (*out)[prev - 1] == ' ') --prev;
+    if (prev > 0 && (*out)[prev - 1] == '?') {
+      out->resize(prev);
+      return;
+    }
+  }
+  out->push_back('?');
+}
+
+// Returns `text` truncated to at most `max_bytes` without splitting a UTF-8
+// character.
+absl::string_view TruncateUtf8(absl::string_view text, size_t max_bytes) {
+  if (text.size() <= max_bytes) {
+    return text;
+  }
+  size_t end = max_bytes;
+  while (end > 0 && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) {
+    --end;
+  }
+  return text.substr(0, end);
+}
+
+int LatencyBucket(absl::Duration latency) {
+  int64_t micros = absl::ToInt64Microseconds(latency);
+  int bucket = 0;
+  while (micros > 0 && bucket < QueryStats::kNumLatencyBuckets - 1) {
+    micros >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+void Add(const QueryExecution& execution, QueryStats::Entry* entry) {
+  ++entry->execution_count;
+  if (execution.failed) {
+    ++entry->failed_execution_count;
+  }
+  entry->total_latency += execution.latency;
+  entry->max_latency = std::max(entry->max_latency, execution.latency);
+  ++entry->latency_buckets[LatencyBucket(execution.latency)];
+  entry->rows_returned += execution.rows_returned;
+  entry->rows_scanned += execution.rows_scanned;
+  entry->bytes_returned += execution.bytes_returned;
+}
+
+// Orders entries most expensive first.
+bool IsMoreExpensive(const QueryStats::Entry& a, const QueryStats::Entry& b) {
+  if (a.total_latency != b.total_latency) {
+    return a.total_latency > b.total_latency;
+  }
+  if (a.execution_count != b.execution_count) {
+    return a.execution_count > b.execution_count;
+  }
+  return a.fingerprint < b.fingerprint;
+}
+
+}  // namespace
+
+std::string NormalizeSql(absl::string_view sql) {
+  std::string out;
+  out.reserve(sql.size());
+  bool space = false;
+  size_t pos = 0;
+  while (pos < sql.size()) {
+    const char c = sql[pos];
+    const absl::string_view rest = sql.substr(pos);
+    // Comments and whitespace separate tokens as a single space.
+    if (absl::ascii_isspace(c)) {
+      space = true;
+      ++pos;
+      continue;
+    }
+    if (c == '#' || absl::StartsWith(rest, "--")) {
+      size_t end = sql.find('\n', pos);
+      pos = end == absl::string_view::npos ? sql.size() : end;
+      space = true;
+      continue;
+    }
+    if (absl::StartsWith(rest, "/*")) {
+      size_t end = sql.find("*/", pos + 2);
+      pos = end == absl::string_view::npos ? sql.size() : end + 2;
+      space = true;
+      continue;
+    }
+    if (space && !out.empty()) {
+      out.push_back(' ');
+    }
+    space = false;
+
+    const char prev = out.empty() ? ' ' : out.back();
+    if (size_t length = StringLiteralLength(rest); length > 0) {
+      AppendLiteral(&out);
+      pos += length;
+    } else if (absl::ascii_isdigit(c) ||
+               (c == '.' && rest.size() > 1 && absl::ascii_isdigit(rest[1]) &&
+                !IsIdentifierChar(prev) && prev != ')' && prev != ']' &&
+                prev != '`')) {
+      AppendLiteral(&out);
+      pos += NumericLiteralLength(rest);
+    } else if (c == '`') {
+      size_t end = sql.find('`', pos + 1);
+      end = end == absl::string_view::npos ? sql.size() : end + 1;
+      out.append(sql.data() + pos, end - pos);
+      pos = end;
+    } else if (IsIdentifierChar(c) || c == '@') {
+      // Keywords, identifiers and parameters, including the digits in them.
+      size_t end = pos + 1;
+      while (end < sql.size() &&
+             (IsIdentifierChar(sql[end]) || sql[end] == '@')) {
+        ++end;
+      }
+      out.append(sql.data() + pos, end - pos);
+      pos = end;
+    } else {
+      out.push_back(c);
+      ++pos;
+    }
+  }
+  return out;
+}
+
+absl::Duration QueryStats::Entry::LatencyPercentile(double fraction) const {
+  const int64_t target = std::max<int64_t>(
+      1, static_cast<int64_t>(std::ceil(fraction * execution_count)));
+  int64_t count = 0;
+  for (int i = 0; i < kNumLatencyBuckets - 1; ++i) {
+    count += latency_buckets[i];
+    if (count >= target) {
+      return std::min(absl::Microseconds(int64_t{1} << i), max_latency);
+    }
+  }
+  return max_latency;
+}
+
+void QueryStats::Record(absl::string_view sql,
+                        const QueryExecution& execution) {
+  {
+    absl::MutexLock lock(&mu_);
+    auto itr = fingerprints_.find(sql);
+    if (itr != fingerprints_.end()) {
+      auto entry = entries_.find(itr->second);
+      if (entry != entries_.end()) {
+        Add(execution, &entry->second);
+      }
+      return;
+    }
+  }
+
+  // Normalize outside of the lock, since this is the expensive part.
+  const std::string text = NormalizeSql(sql);
+  const int64_t fingerprint =
+      static_cast<int64_t>(farmhash::Fingerprint64(text));
+
+  absl::MutexLock lock(&mu_);
+  if (fingerprints_.size() >= static_cast<size_t>(max_queries_)) {
+    fingerprints_.clear();
+  }
+  fingerprints_.emplace(sql, fingerprint);
+  auto itr = entries_.find(fingerprint);
+  if (itr == entries_.end()) {
+    if (entries_.size() >= static_cast<size_t>(max_queries_)) {
+      return;
+    }
+    Entry entry;
+    entry.fingerprint = fingerprint;
+    entry.text = std::string(TruncateUtf8(text, kMaxTextBytes));
+    entry.text_truncated = entry.text.size() < text.size();
+    itr = entries_.emplace(fingerprint, std::move(entry)).first;
+  }
+  Add(execution, &itr->second);
+}
+
+std::vector<QueryStats::Entry> QueryStats::TopQueries(int n) const {
+  std::vector<Entry> entries;
+  {
+    absl::MutexLock lock(&mu_);
+    entries.reserve(entries_.size());
+    for (const auto& [fingerprint, entry] : entries_) {
+      entries.push_back(entry);
+    }
+  }
+  n = std::max(0, std::min(n, static_cast<int>(entries.size())));
+  std::partial_sort(entries.begin(), entries.begin() + n, entries.end(),
+                    IsMoreExpensive);
+  entries.resize(n);
+  return entries;
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,137 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_QUERY_STATS_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_QUERY_STATS_H_
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// Returns the shape of a SQL statement: its text with the string, bytes and
+// numeric literals replaced by `?` (and lists of them collapsed to a single
+// `?`), comments removed and whitespace collapsed, so that executions of the
+// same statement with different literals share their shape. Identifiers,
+// keywords, parameters and the NULL, TRUE and FALSE literals are kept.
+std::string NormalizeSql(absl::string_view sql);
+
+// The outcome of one execution of a SQL statement.
+struct QueryExecution {
+  // Time from the start of the execution until its rows were all read.
+  absl::Duration latency = absl::ZeroDuration();
+
+  // Number of rows returned by the statement.
+  int64_t rows_returned = 0;
+
+  // Number of rows read from tables and indexes by the statement.
+  int64_t rows_scanned = 0;
+
+  // Approximate bytes of the values of the rows returned.
+  int64_t bytes_returned = 0;
+
+  // True if the execution failed.
+  bool failed = false;
+};
+
+// QueryStats aggregates the executions of SQL statements by the fingerprint of
+// their shape (see NormalizeSql), modeled on the query statistics of Cloud
+// Spanner:
+//   https://cloud.google.com/spanner/docs/introspection/query-statistics
+//
+// At most `max_queries` shapes are tracked: once that many are, executions of
+// other shapes are not counted. Shapes are computed once per distinct SQL text
+// seen recently, rather than on each execution. Thread-safe.
+class QueryStats {
+ public:
+  // Executions are counted in buckets of latency, the i-th of which holds
+  // latencies below 2^i microseconds, and the last one all longer latencies.
+  static constexpr int kNumLatencyBuckets = 32;
+
+  // Longest text kept for each shape, in bytes.
+  static constexpr int kMaxTextBytes = 1024;
+
+  static constexpr int kDefaultMaxQueries = 10000;
+
+  // The executions of a shape of statements.
+  struct Entry {
+    // Fingerprint of the shape, as reported by Cloud Spanner's
+    // TEXT_FINGERPRINT.
+    int64_t fingerprint = 0;
+
+    // The shape, truncated to kMaxTextBytes if text_truncated.
+    std::string text;
+    bool text_truncated = false;
+
+    int64_t execution_count = 0;
+    int64_t failed_execution_count = 0;
+
+    absl::Duration total_latency = absl::ZeroDuration();
+    absl::Duration max_latency = absl::ZeroDuration();
+    std::array<int64_t, kNumLatencyBuckets> latency_buckets = {};
+
+    int64_t rows_returned = 0;
+    int64_t rows_scanned = 0;
+    int64_t bytes_returned = 0;
+
+    // Returns an upper bound of the latency below which `fraction` of the
+    // executions completed, from the bucket holding that fraction.
+    absl::Duration LatencyPercentile(double fraction) const;
+  };
+
+  explicit QueryStats(int max_queries = kDefaultMaxQueries)
+      : max_queries_(max_queries) {}
+
+  // Counts an execution of `sql`.
+  void Record(absl::string_view sql, const QueryExecution& execution)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the `n` shapes with the longest total latency, and then the most
+  // executions, most expensive first.
+  std::vector<Entry> TopQueries(int n) const ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  const int max_queries_;
+
+  mutable absl::Mutex mu_;
+
+  // Entries of the shapes tracked, by fingerprint.
+  absl::flat_hash_map<int64_t, Entry> entries_ ABSL_GUARDED_BY(mu_);
+
+  // Fingerprints of the SQL texts recorded, so that the text of a statement
+  // executed repeatedly is only normalized once. Cleared once it holds
+  // max_queries_ texts, since texts with inlined literals are unbounded.
+  absl::flat_hash_map<std::string, int64_t> fingerprints_
+      ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_QUERY_STATS_H_
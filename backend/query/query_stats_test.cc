@@ -0,0 +1,131 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/query/query_stats.h"
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+TEST(NormalizeSqlTest, ReplacesLiterals) {
+  EXPECT_EQ(NormalizeSql("SELECT * FROM Users WHERE Id = 42"),
+            "SELECT * FROM Users WHERE Id = ?");
+  EXPECT_EQ(NormalizeSql("SELECT 1.5e-3, .5, 0x1F, 'a\\'b', \"c\\\"d\""),
+            "SELECT ?");
+  EXPECT_EQ(NormalizeSql("SELECT r'\\d', b\"x\", rb'''a'b''', \"\"\"c\"\"\""),
+            "SELECT ?");
+  EXPECT_EQ(NormalizeSql("SELECT Name FROM Users WHERE Id IN (1, 2,3)"),
+            "SELECT Name FROM Users WHERE Id IN (?)");
+}
+
+TEST(NormalizeSqlTest, KeepsIdentifiersParametersAndKeywords) {
+  EXPECT_EQ(NormalizeSql("SELECT t1.c2, `my-table`.x FROM t1, `my-table` "
+                         "WHERE c3 = @p1 AND c4 IS NOT NULL AND c5 = TRUE"),
+            "SELECT t1.c2, `my-table`.x FROM t1, `my-table` "
+            "WHERE c3 = @p1 AND c4 IS NOT NULL AND c5 = TRUE");
+  EXPECT_EQ(NormalizeSql("SELECT a[OFFSET(1)], f(x).y FROM T"),
+            "SELECT a[OFFSET(?)], f(x).y FROM T");
+}
+
+TEST(NormalizeSqlTest, CollapsesWhitespaceAndComments) {
+  EXPECT_EQ(NormalizeSql("  SELECT\n\t1 -- one\n  FROM /* the */ T # t\n"),
+            "SELECT ? FROM T");
+  EXPECT_EQ(NormalizeSql("SELECT 'a' -- x"), NormalizeSql("SELECT  \"b\""));
+}
+
+TEST(QueryStatsTest, AggregatesExecutionsByShape) {
+  QueryStats stats;
+  stats.Record("SELECT * FROM T WHERE k = 1",
+               {absl::Milliseconds(2), /*rows_returned=*/1,
+                /*rows_scanned=*/10, /*bytes_returned=*/8});
+  stats.Record("SELECT * FROM T WHERE k = 2",
+               {absl::Milliseconds(4), /*rows_returned=*/3,
+                /*rows_scanned=*/10, /*bytes_returned=*/24});
+  stats.Record("SELECT * FROM T WHERE k = 2",
+               {absl::Milliseconds(1), 0, 0, 0, /*failed=*/true});
+  stats.Record("SELECT 1", {absl::Milliseconds(1), 1, 0, 8});
+
+  std::vector<QueryStats::Entry> top = stats.TopQueries(10);
+  ASSERT_EQ(top.size(), 2);
+  EXPECT_EQ(top[0].text, "SELECT * FROM T WHERE k = ?");
+  EXPECT_FALSE(top[0].text_truncated);
+  EXPECT_EQ(top[0].execution_count, 3);
+  EXPECT_EQ(top[0].failed_execution_count, 1);
+  EXPECT_EQ(top[0].total_latency, absl::Milliseconds(7));
+  EXPECT_EQ(top[0].max_latency, absl::Milliseconds(4));
+  EXPECT_EQ(top[0].rows_returned, 4);
+  EXPECT_EQ(top[0].rows_scanned, 20);
+  EXPECT_EQ(top[0].bytes_returned, 32);
+  EXPECT_EQ(top[1].text, "SELECT ?");
+  EXPECT_NE(top[0].fingerprint, top[1].fingerprint);
+
+  top = stats.TopQueries(1);
+  ASSERT_EQ(top.size(), 1);
+  EXPECT_EQ(top[0].execution_count, 3);
+}
+
+TEST(QueryStatsTest, EstimatesLatencyPercentiles) {
+  QueryStats stats;
+  for (int i = 0; i < 99; ++i) {
+    stats.Record("SELECT 1", {absl::Microseconds(100)});
+  }
+  stats.Record("SELECT 1", {absl::Seconds(1)});
+
+  std::vector<QueryStats::Entry> top = stats.TopQueries(1);
+  ASSERT_EQ(top.size(), 1);
+  // 100us falls in the bucket of latencies below 128us.
+  EXPECT_EQ(top[0].LatencyPercentile(0.5), absl::Microseconds(128));
+  EXPECT_EQ(top[0].LatencyPercentile(0.99), absl::Microseconds(128));
+  EXPECT_EQ(top[0].LatencyPercentile(1), absl::Seconds(1));
+}
+
+TEST(QueryStatsTest, TruncatesLongTexts) {
+  QueryStats stats;
+  std::string sql = "SELECT " + std::string(QueryStats::kMaxTextBytes, 'x');
+  stats.Record(sql, {});
+
+  std::vector<QueryStats::Entry> top = stats.TopQueries(1);
+  ASSERT_EQ(top.size(), 1);
+  EXPECT_EQ(top[0].text, sql.substr(0, QueryStats::kMaxTextBytes));
+  EXPECT_TRUE(top[0].text_truncated);
+}
+
+TEST(QueryStatsTest, StopsTrackingNewShapesAtLimit) {
+  QueryStats stats(/*max_queries=*/1);
+  stats.Record("SELECT a FROM T", {});
+  stats.Record("SELECT b FROM T", {});
+  stats.Record("SELECT a FROM T", {});
+
+  std::vector<QueryStats::Entry> top = stats.TopQueries(10);
+  ASSERT_EQ(top.size(), 1);
+  EXPECT_EQ(top[0].text, "SELECT a FROM T");
+  EXPECT_EQ(top[0].execution_count, 2);
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
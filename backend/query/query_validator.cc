@@ -107,6 +107,34 @@ absl::Status CollectHintsForNode(
 
 }  // namespace
 
+absl::Status QueryValidator::ValidateStatement(
+    const zetasql::ResolvedStatement* statement) {
+  ZETASQL_RETURN_IF_ERROR(statement->Accept(this));
+  ZETASQL_RETURN_IF_ERROR(ValidateIndexHints(
+      index_hints_,
+      extracted_options_ != nullptr &&
+          extracted_options_->disable_query_null_filtered_index_check));
+  ZETASQL_RETURN_IF_ERROR(size_limits_status_);
+  return size_limits_checker_.CheckRecordedNodes();
+}
+
+absl::Status QueryValidator::DefaultVisit(const zetasql::ResolvedNode* node) {
+  ZETASQL_RETURN_IF_ERROR(ValidateHints(node));
+  if (node->node_kind() == zetasql::RESOLVED_TABLE_SCAN) {
+    ZETASQL_RETURN_IF_ERROR(CollectIndexHint(
+        node->GetAs<zetasql::ResolvedTableScan>(), &index_hints_));
+  }
+  return VisitChildren(node);
+}
+
+absl::Status QueryValidator::VisitChildren(const zetasql::ResolvedNode* node) {
+  size_limits_status_.Update(size_limits_checker_.CheckNode(node, depth_));
+  ++depth_;
+  absl::Status status = zetasql::ResolvedASTVisitor::DefaultVisit(node);
+  --depth_;
+  return status;
+}
+
 absl::Status QueryValidator::ValidateHints(
     const zetasql::ResolvedNode* node) const {
   std::vector<const zetasql::ResolvedNode*> child_nodes;
@@ -342,7 +370,7 @@ absl::Status QueryValidator::VisitResolvedFunctionCall(
         CheckAllowedCasts(node->argument_list(0)->type(), node->type()));
   }
 
-  return zetasql::ResolvedASTVisitor::DefaultVisit(node);
+  return VisitChildren(node);
 }
 
 absl::Status QueryValidator::VisitResolvedAggregateFunctionCall(
@@ -357,13 +385,13 @@ absl::Status QueryValidator::VisitResolvedAggregateFunctionCall(
   // are unimplemented or may require additional validation of arguments.
   ZETASQL_RETURN_IF_ERROR(FilterSafeModeFunction(*node));
   ZETASQL_RETURN_IF_ERROR(FilterResolvedAggregateFunction(sql_features_, *node));
-  return zetasql::ResolvedASTVisitor::DefaultVisit(node);
+  return VisitChildren(node);
 }
 
 absl::Status QueryValidator::VisitResolvedCast(
     const zetasql::ResolvedCast* node) {
   ZETASQL_RETURN_IF_ERROR(CheckAllowedCasts(node->expr()->type(), node->type()));
-  return zetasql::ResolvedASTVisitor::DefaultVisit(node);
+  return VisitChildren(node);
 }
 
 }  // namespace backend
@@ -23,7 +23,9 @@
 #include "zetasql/resolved_ast/resolved_ast_visitor.h"
 #include "backend/common/case.h"
 #include "backend/query/analyzer_options.h"
+#include "backend/query/feature_filter/query_size_limits_checker.h"
 #include "backend/query/feature_filter/sql_features_view.h"
+#include "backend/query/index_hint_validator.h"
 #include "backend/query/query_engine_options.h"
 #include "backend/schema/catalog/schema.h"
 #include "absl/status/status.h"
@@ -34,6 +36,10 @@ namespace emulator {
 namespace backend {
 
 // Implements ResolvedASTVisitor to validate various nodes in an AST.
+//
+// While visiting the nodes, the validator also collects the index hints of
+// table scans and the metrics of the query size limits, so that
+// ValidateStatement checks a statement in a single pass over its nodes.
 class QueryValidator : public zetasql::ResolvedASTVisitor {
  public:
   explicit QueryValidator(const Schema* schema,
@@ -44,10 +50,13 @@ class QueryValidator : public zetasql::ResolvedASTVisitor {
         sql_features_(SqlFeaturesView()),
         extracted_options_(extracted_options) {}
 
-  absl::Status DefaultVisit(const zetasql::ResolvedNode* node) override {
-    ZETASQL_RETURN_IF_ERROR(ValidateHints(node));
-    return zetasql::ResolvedASTVisitor::DefaultVisit(node);
-  }
+  // Validates the nodes of `statement`, then its index hints and the query
+  // size limits (https://cloud.google.com/spanner/quotas#query_limits), which
+  // is equivalent to, but cheaper than, visiting `statement` with this
+  // validator, an IndexHintValidator and a QuerySizeLimitsChecker in turn.
+  absl::Status ValidateStatement(const zetasql::ResolvedStatement* statement);
+
+  absl::Status DefaultVisit(const zetasql::ResolvedNode* node) override;
 
  protected:
   absl::Status VisitResolvedFunctionCall(
@@ -59,6 +68,10 @@ class QueryValidator : public zetasql::ResolvedASTVisitor {
   absl::Status VisitResolvedCast(const zetasql::ResolvedCast* node) override;
 
  private:
+  // Records the query size metrics of `node` and visits its children, keeping
+  // track of the depth of the nodes visited.
+  absl::Status VisitChildren(const zetasql::ResolvedNode* node);
+
   // Validates the child hint nodes of `node`.
   absl::Status ValidateHints(const zetasql::ResolvedNode* node) const;
 
@@ -101,6 +114,17 @@ class QueryValidator : public zetasql::ResolvedASTVisitor {
   // Options for the query engine that are extracted through user-specified
   // hints.
   QueryEngineOptions* extracted_options_;
+
+  // Depth of the children of the node being visited.
+  int depth_ = 0;
+
+  // Index hints of the table scans visited.
+  IndexHintMap index_hints_;
+
+  // Checks the query size limits on the nodes visited, the first violation of
+  // which is kept in size_limits_status_ until ValidateStatement returns it.
+  QuerySizeLimitsChecker size_limits_checker_;
+  absl::Status size_limits_status_;
 };
 
 }  // namespace backend
@@ -21,6 +21,7 @@
 #include "gtest/gtest.h"
 #include "zetasql/base/testing/status_matchers.h"
 #include "absl/status/status.h"
+#include "backend/query/feature_filter/query_size_limits_checker.h"
 #include "backend/query/query_engine_options.h"
 #include "backend/query/queryable_table.h"
 #include "backend/schema/catalog/table.h"
@@ -153,6 +154,39 @@ TEST_F(QueryValidatorTest, CollectEmulatorOnlyOptionsFromHints) {
   }
 }
 
+TEST_F(QueryValidatorTest, ValidateStatementChecksQuerySizeLimits) {
+  QueryableTable table{schema()->FindTable("test_table"), /*reader=*/nullptr};
+  auto make_statement = [&table](int num_nested_subselects) {
+    std::unique_ptr<const zetasql::ResolvedScan> scan =
+        zetasql::MakeResolvedTableScan(/*column_list=*/{}, &table,
+                                         /*for_system_time_expr=*/nullptr);
+    for (int i = 0; i < num_nested_subselects; ++i) {
+      scan = zetasql::MakeResolvedProjectScan(/*column_list=*/{},
+                                                /*expr_list=*/{},
+                                                std::move(scan));
+    }
+    return zetasql::MakeResolvedQueryStmt(/*output_column_list=*/{},
+                                            /*is_value_table=*/false,
+                                            std::move(scan));
+  };
+
+  {
+    auto statement =
+        make_statement(QuerySizeLimitsChecker::kMaxNestedSubselects);
+    QueryEngineOptions opts;
+    QueryValidator validator{schema(), &opts};
+    ZETASQL_EXPECT_OK(validator.ValidateStatement(statement.get()));
+  }
+  {
+    auto statement =
+        make_statement(QuerySizeLimitsChecker::kMaxNestedSubselects + 1);
+    QueryEngineOptions opts;
+    QueryValidator validator{schema(), &opts};
+    EXPECT_THAT(validator.ValidateStatement(statement.get()),
+                StatusIs(absl::StatusCode::kInvalidArgument));
+  }
+}
+
 }  // namespace
 
 }  // namespace backend
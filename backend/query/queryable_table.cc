@@ -18,47 +18,213 @@
 
 #include <algorithm>
 #include <memory>
+#include <optional>
+#include <utility>
 #include <vector>
 
 #include "zetasql/public/evaluator_table_iterator.h"
 #include "zetasql/public/value.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
 #include "zetasql/base/statusor.h"
 #include "absl/types/span.h"
 #include "backend/access/read.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/datamodel/key_set.h"
 #include "backend/query/queryable_column.h"
+#include "backend/schema/catalog/column.h"
+#include "backend/schema/catalog/index.h"
+#include "backend/schema/catalog/table.h"
 #include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
 
 namespace google {
 namespace spanner {
 namespace emulator {
 namespace backend {
 
-// An implementation of EvaluatorTableIterator which wraps a RowCursor.
+namespace {
+
+// Maximum number of keys that filters on the leading key columns of a table
+// are expanded to. Filters on further key columns are not pushed down once
+// this is exceeded. Large enough for batch gets of tens of thousands of keys
+// with IN UNNEST, which are read as a single sorted lookup of the keys.
+constexpr int kMaxPushedDownKeys = 100000;
+
+// Returns the values which satisfy 'filter' if it admits a finite set of
+// values of the given type, or nullopt otherwise.
+std::optional<std::vector<zetasql::Value>> FilterPoints(
+    const zetasql::ColumnFilter& filter, const zetasql::Type* type) {
+  std::vector<zetasql::Value> points;
+  if (filter.kind() == zetasql::ColumnFilter::kInList) {
+    points = filter.in_list();
+  } else if (filter.lower_bound().is_valid() &&
+             filter.upper_bound().is_valid() &&
+             filter.lower_bound() == filter.upper_bound()) {
+    points.push_back(filter.lower_bound());
+  } else {
+    return std::nullopt;
+  }
+  for (const zetasql::Value& point : points) {
+    if (!point.type()->Equals(type)) {
+      return std::nullopt;
+    }
+  }
+  return points;
+}
+
+// Returns true if the bound is unset or has the given type.
+bool IsUsableBound(const zetasql::Value& bound, const zetasql::Type* type) {
+  return !bound.is_valid() || bound.type()->Equals(type);
+}
+
+// Returns a key with 'prefix' followed by 'value'.
+Key ExtendKey(const Key& prefix, const zetasql::Value& value) {
+  Key key = prefix;
+  key.AddColumn(value);
+  return key;
+}
+
+// Returns the number of leading key columns with a filter.
+int NumLeadingFilteredKeyColumns(
+    const std::vector<const zetasql::ColumnFilter*>& key_filters) {
+  int i = 0;
+  while (i < key_filters.size() && key_filters[i] != nullptr) {
+    ++i;
+  }
+  return i;
+}
+
+}  // namespace
+
+std::optional<KeySet> KeySetFromKeyColumnFilters(
+    absl::Span<const KeyColumn* const> key_columns,
+    const std::vector<const zetasql::ColumnFilter*>& key_filters) {
+  std::vector<Key> prefixes = {Key()};
+  int i = 0;
+  for (; i < key_filters.size() && key_filters[i] != nullptr; ++i) {
+    const zetasql::Type* type = key_columns[i]->column()->GetType();
+    std::optional<std::vector<zetasql::Value>> points =
+        FilterPoints(*key_filters[i], type);
+    if (!points.has_value() ||
+        prefixes.size() * points->size() > kMaxPushedDownKeys) {
+      break;
+    }
+    std::vector<Key> keys;
+    keys.reserve(prefixes.size() * points->size());
+    for (const Key& prefix : prefixes) {
+      for (const zetasql::Value& point : *points) {
+        keys.push_back(ExtendKey(prefix, point));
+      }
+    }
+    prefixes = std::move(keys);
+  }
+
+  KeySet key_set;
+  const zetasql::ColumnFilter* range_filter =
+      i < key_filters.size() ? key_filters[i] : nullptr;
+  if (range_filter != nullptr &&
+      range_filter->kind() == zetasql::ColumnFilter::kRange) {
+    const zetasql::Type* type = key_columns[i]->column()->GetType();
+    zetasql::Value lower_bound = range_filter->lower_bound();
+    zetasql::Value upper_bound = range_filter->upper_bound();
+    if (IsUsableBound(lower_bound, type) && IsUsableBound(upper_bound, type)) {
+      // Descending columns sort the upper bound first. Unset bounds leave the
+      // range open up to the end of the prefix.
+      if (key_columns[i]->is_descending()) {
+        std::swap(lower_bound, upper_bound);
+      }
+      for (const Key& prefix : prefixes) {
+        key_set.AddRange(KeyRange::ClosedClosed(
+            lower_bound.is_valid() ? ExtendKey(prefix, lower_bound) : prefix,
+            upper_bound.is_valid() ? ExtendKey(prefix, upper_bound) : prefix));
+      }
+      return key_set;
+    }
+  }
+  if (i == 0) {
+    return std::nullopt;
+  }
+  for (const Key& prefix : prefixes) {
+    if (prefix.NumColumns() == key_columns.size()) {
+      key_set.AddKey(prefix);
+    } else {
+      key_set.AddRange(KeyRange::Prefix(prefix));
+    }
+  }
+  return key_set;
+}
+
+// An implementation of EvaluatorTableIterator which reads the table through a
+// RowReader.
+//
+// Used by QueryableTable::CreateEvaluatorTableIterator. The table is read on
+// the first call to NextRow(), so that filters on the key columns of the table
+// set by SetColumnFilterMap() narrow the keys read, turning queries for a key
+// into point reads instead of scans of the whole table.
+//
+// If the filters do not narrow the primary key of the table, but do narrow a
+// prefix of the key of one of its indexes, the rows are looked up through the
+// index data table instead. The index is read directly if it stores all the
+// columns being read, and otherwise is used to find the primary keys of the
+// rows, which are then read from the table.
 //
-// Used by QueryableTable::CreateEvaluatorTableIterator.
+// If the iterator is ordered, rows are always read in the key order of the
+// table, or of `order_index` if set, and filters only narrow the keys of that
+// order.
 class RowCursorEvaluatorTableIterator
     : public zetasql::EvaluatorTableIterator {
  public:
-  explicit RowCursorEvaluatorTableIterator(std::unique_ptr<RowCursor> cursor)
-      : cursor_(std::move(cursor)) {
-    values_.reserve(cursor_->NumColumns());
-    for (int i = 0; i < cursor_->NumColumns(); ++i) {
-      values_.push_back(zetasql::values::Null(cursor_->ColumnType(i)));
+  RowCursorEvaluatorTableIterator(const backend::Table* table,
+                                  RowReader* reader,
+                                  std::vector<const backend::Column*> columns,
+                                  bool ordered = false,
+                                  const Index* order_index = nullptr)
+      : table_(table),
+        reader_(reader),
+        columns_(std::move(columns)),
+        ordered_(ordered),
+        index_(order_index) {
+    values_.reserve(columns_.size());
+    for (const backend::Column* column : columns_) {
+      values_.push_back(zetasql::values::Null(column->GetType()));
     }
   }
 
-  int NumColumns() const override { return cursor_->NumColumns(); }
+  int NumColumns() const override { return columns_.size(); }
 
   std::string GetColumnName(int i) const override {
-    return cursor_->ColumnName(i);
+    return columns_[i]->Name();
   }
 
   const zetasql::Type* GetColumnType(int i) const override {
-    return cursor_->ColumnType(i);
+    return columns_[i]->GetType();
+  }
+
+  absl::Status SetColumnFilterMap(
+      absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>>
+          filter_map) override {
+    absl::Span<const KeyColumn* const> key_columns =
+        index_ != nullptr ? index_->index_data_table()->primary_key()
+                          : table_->primary_key();
+    std::optional<KeySet> key_set = KeySetFromKeyColumnFilters(
+        key_columns, KeyColumnFilters(key_columns, filter_map));
+    if (key_set.has_value()) {
+      key_set_ = std::move(key_set).value();
+    } else if (!ordered_) {
+      ChooseIndex(filter_map);
+    }
+    return absl::OkStatus();
   }
 
   bool NextRow() override {
+    if (cursor_ == nullptr) {
+      status_ = Read();
+      if (!status_.ok()) {
+        return false;
+      }
+    }
     if (cursor_->Next()) {
       for (int i = 0; i < cursor_->NumColumns(); ++i) {
         values_[i] = cursor_->ColumnValue(i);
@@ -71,65 +237,253 @@ class RowCursorEvaluatorTableIterator
 
   const zetasql::Value& GetValue(int i) const override { return values_[i]; }
 
-  absl::Status Status() const override { return cursor_->Status(); }
+  absl::Status Status() const override {
+    return cursor_ == nullptr ? status_ : cursor_->Status();
+  }
 
   // Cancel is best-effort and not required.
   absl::Status Cancel() override { return absl::OkStatus(); }
 
  private:
-  // The wrapped RowCursor.
+  // Returns the filters on each of the given key columns, which are key columns
+  // of either table_ or the index data table of one of its indexes.
+  std::vector<const zetasql::ColumnFilter*> KeyColumnFilters(
+      absl::Span<const KeyColumn* const> key_columns,
+      const absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>>&
+          filter_map) const {
+    std::vector<const zetasql::ColumnFilter*> key_filters;
+    for (const KeyColumn* key_column : key_columns) {
+      const backend::Column* column = key_column->column();
+      if (column->table() != table_) {
+        column = column->source_column();
+      }
+      const zetasql::ColumnFilter* key_filter = nullptr;
+      for (int i = 0; i < columns_.size(); ++i) {
+        auto filter_itr = filter_map.find(i);
+        if (columns_[i] == column && filter_itr != filter_map.end()) {
+          key_filter = filter_itr->second.get();
+          break;
+        }
+      }
+      key_filters.push_back(key_filter);
+    }
+    return key_filters;
+  }
+
+  // Sets index_ to the index whose key has the longest filtered prefix, if
+  // any, and key_set_ to the keys of that index to read.
+  //
+  // Null-filtered indexes are not considered since they omit rows with NULL
+  // key columns, which may still satisfy filters on other columns.
+  void ChooseIndex(
+      const absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>>&
+          filter_map) {
+    int best_num_filtered_columns = 0;
+    for (const Index* index : table_->indexes()) {
+      if (index->is_null_filtered()) {
+        continue;
+      }
+      absl::Span<const KeyColumn* const> key_columns =
+          index->index_data_table()->primary_key();
+      std::vector<const zetasql::ColumnFilter*> key_filters =
+          KeyColumnFilters(key_columns, filter_map);
+      int num_filtered_columns = NumLeadingFilteredKeyColumns(key_filters);
+      if (num_filtered_columns <= best_num_filtered_columns) {
+        continue;
+      }
+      std::optional<KeySet> key_set =
+          KeySetFromKeyColumnFilters(key_columns, key_filters);
+      if (key_set.has_value()) {
+        index_ = index;
+        key_set_ = std::move(key_set).value();
+        best_num_filtered_columns = num_filtered_columns;
+      }
+    }
+  }
+
+  // Returns true if index_ stores all the columns being read.
+  bool IndexCoversColumns() const {
+    for (const backend::Column* column : columns_) {
+      if (index_->index_data_table()->FindColumn(column->Name()) == nullptr) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Opens cursor_ over the rows of key_set_.
+  absl::Status Read() {
+    ReadArg read_arg;
+    read_arg.table = table_->Name();
+    read_arg.key_set = key_set_;
+    for (const backend::Column* column : columns_) {
+      read_arg.columns.push_back(column->Name());
+    }
+    if (index_ == nullptr) {
+      return reader_->Read(read_arg, &cursor_);
+    }
+    if (IndexCoversColumns()) {
+      read_arg.index = index_->Name();
+      return reader_->Read(read_arg, &cursor_);
+    }
+
+    // Look up the primary keys of the rows in the index, and read the rows
+    // with those keys from the table.
+    ReadArg index_read_arg;
+    index_read_arg.table = table_->Name();
+    index_read_arg.index = index_->Name();
+    index_read_arg.key_set = key_set_;
+    for (const KeyColumn* key_column : table_->primary_key()) {
+      index_read_arg.columns.push_back(key_column->column()->Name());
+    }
+    std::unique_ptr<RowCursor> index_cursor;
+    ZETASQL_RETURN_IF_ERROR(reader_->Read(index_read_arg, &index_cursor));
+    read_arg.key_set = KeySet();
+    while (index_cursor->Next()) {
+      Key key;
+      for (int i = 0; i < index_cursor->NumColumns(); ++i) {
+        key.AddColumn(index_cursor->ColumnValue(i));
+      }
+      read_arg.key_set.AddKey(key);
+    }
+    ZETASQL_RETURN_IF_ERROR(index_cursor->Status());
+    return reader_->Read(read_arg, &cursor_);
+  }
+
+  // The table being read.
+  const backend::Table* table_;
+
+  // The reader which the table is read through.
+  RowReader* reader_;
+
+  // The columns being read.
+  const std::vector<const backend::Column*> columns_;
+
+  // Whether rows are read in the key order of index_, or of the table if
+  // index_ is nullptr, regardless of the filters set.
+  const bool ordered_;
+
+  // The index through which the rows are looked up, or nullptr if the table
+  // is read directly.
+  const Index* index_;
+
+  // The keys to read, narrowed by SetColumnFilterMap. If index_ is set, these
+  // are keys of the index data table.
+  KeySet key_set_ = KeySet::All();
+
+  // The RowCursor over the rows read, or nullptr before the first NextRow().
   std::unique_ptr<RowCursor> cursor_;
 
+  // Status of reading the table, until cursor_ is opened.
+  absl::Status status_;
+
   // Values of the current row. EvaluatorTableIterator::GetValue need to return
   // a reference so we need to buffer the values instead of simply delegate to
   // RowCursor::ColumnValue.
   std::vector<zetasql::Value> values_;
 };
 
-QueryableTable::QueryableTable(const backend::Table* table, RowReader* reader)
-    : wrapped_table_(table), reader_(reader) {
+QueryableColumns::QueryableColumns(const backend::Table* table) {
+  columns.reserve(table->columns().size());
   for (const auto* column : table->columns()) {
-    columns_.push_back(absl::make_unique<const QueryableColumn>(column));
+    columns.push_back(absl::make_unique<const QueryableColumn>(column));
   }
 
-  // Populate primary_key_column_indexes_.
+  // Populate primary_key_column_indexes.
   for (const auto& key_column : table->primary_key()) {
-    for (int i = 0; i < wrapped_table_->columns().size(); ++i) {
-      if (key_column->column() == wrapped_table_->columns()[i]) {
-        primary_key_column_indexes_.push_back(i);
+    for (int i = 0; i < table->columns().size(); ++i) {
+      if (key_column->column() == table->columns()[i]) {
+        primary_key_column_indexes.push_back(i);
         break;
       }
     }
   }
 }
 
+bool QueryableColumns::Wrap(const backend::Table* table) const {
+  if (columns.size() != table->columns().size()) {
+    return false;
+  }
+  for (int i = 0; i < columns.size(); ++i) {
+    if (columns[i]->wrapped_column() != table->columns()[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::shared_ptr<const QueryableColumns> QueryableColumnsCache::Get(
+    const backend::Table* table) {
+  absl::MutexLock lock(&mu_);
+  std::shared_ptr<const QueryableColumns>& columns = columns_[table];
+  // A table of a later schema version may have been allocated where a table
+  // of an earlier one was, so the columns are checked against the table.
+  if (columns == nullptr || !columns->Wrap(table)) {
+    columns = std::make_shared<const QueryableColumns>(table);
+  }
+  return columns;
+}
+
+void QueryableColumnsCache::Erase(
+    absl::Span<const backend::Table* const> tables) {
+  absl::MutexLock lock(&mu_);
+  for (const backend::Table* table : tables) {
+    columns_.erase(table);
+  }
+}
+
+void QueryableColumnsCache::Clear() {
+  absl::MutexLock lock(&mu_);
+  columns_.clear();
+}
+
+QueryableTable::QueryableTable(const backend::Table* table, RowReader* reader,
+                               std::shared_ptr<const QueryableColumns> columns)
+    : wrapped_table_(table),
+      reader_(reader),
+      columns_(columns != nullptr
+                   ? std::move(columns)
+                   : std::make_shared<const QueryableColumns>(table)) {}
+
 zetasql_base::StatusOr<std::unique_ptr<zetasql::EvaluatorTableIterator>>
 QueryableTable::CreateEvaluatorTableIterator(
     absl::Span<const int> column_idxs) const {
   ZETASQL_RET_CHECK_NE(reader_, nullptr);
 
-  std::vector<std::string> column_names;
+  std::vector<const backend::Column*> columns;
   for (int idx : column_idxs) {
-    column_names.push_back(GetColumn(idx)->Name());
+    columns.push_back(wrapped_table_->columns()[idx]);
   }
+  return absl::make_unique<RowCursorEvaluatorTableIterator>(
+      wrapped_table_, reader_, std::move(columns));
+}
 
-  ReadArg read_arg;
-  read_arg.table = Name();
-  read_arg.key_set = KeySet::All();
-  read_arg.columns = column_names;
-  std::unique_ptr<RowCursor> cursor;
-  ZETASQL_RETURN_IF_ERROR(reader_->Read(read_arg, &cursor));
-  return absl::make_unique<RowCursorEvaluatorTableIterator>(std::move(cursor));
+zetasql_base::StatusOr<std::unique_ptr<zetasql::EvaluatorTableIterator>>
+QueryableTable::CreateOrderedEvaluatorTableIterator(
+    absl::Span<const int> column_idxs, const Index* index) const {
+  ZETASQL_RET_CHECK_NE(reader_, nullptr);
+
+  std::vector<const backend::Column*> columns;
+  for (int idx : column_idxs) {
+    const backend::Column* column = wrapped_table_->columns()[idx];
+    ZETASQL_RET_CHECK(index == nullptr ||
+              index->index_data_table()->FindColumn(column->Name()) != nullptr)
+        << "Index " << index->Name() << " does not store column "
+        << column->Name();
+    columns.push_back(column);
+  }
+  return absl::make_unique<RowCursorEvaluatorTableIterator>(
+      wrapped_table_, reader_, std::move(columns), /*ordered=*/true, index);
 }
 
 const zetasql::Column* QueryableTable::FindColumnByName(
     const std::string& name) const {
   const auto* to_find = wrapped_table_->FindColumn(name);
-  auto it = std::find_if(columns_.begin(), columns_.end(),
+  auto it = std::find_if(columns_->columns.begin(), columns_->columns.end(),
                          [to_find](const auto& column) {
                            return column->wrapped_column() == to_find;
                          });
-  if (it == columns_.end()) {
+  if (it == columns_->columns.end()) {
     return nullptr;
   }
   return it->get();
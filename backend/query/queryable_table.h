@@ -23,9 +23,14 @@
 
 #include "zetasql/public/catalog.h"
 #include "zetasql/public/evaluator_table_iterator.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/span.h"
 #include "backend/access/read.h"
+#include "backend/datamodel/key_set.h"
 #include "backend/query/queryable_column.h"
+#include "backend/schema/catalog/index.h"
 #include "backend/schema/catalog/table.h"
 #include "absl/status/status.h"
 
@@ -34,12 +39,69 @@ namespace spanner {
 namespace emulator {
 namespace backend {
 
+// Returns the set of keys which may satisfy the given filters, where
+// key_filters[i] is the filter on key_columns[i] (or nullptr), or nullopt if
+// none of the filters narrow the keys.
+//
+// Point filters (equality and IN) on leading key columns are expanded into
+// keys, and a range filter on the key column following them narrows each of
+// these into a range. The result may contain rows which do not satisfy the
+// filters, which are still applied by the evaluator, but never omits rows which
+// do.
+std::optional<KeySet> KeySetFromKeyColumnFilters(
+    absl::Span<const KeyColumn* const> key_columns,
+    const std::vector<const zetasql::ColumnFilter*>& key_filters);
+
+// QueryableColumns holds the zetasql::Column wrappers of the columns of a
+// table, and the positions of its primary key columns among them. They only
+// depend on the schema, so the queryable tables of a table in any number of
+// catalogs can share them.
+struct QueryableColumns {
+  explicit QueryableColumns(const backend::Table* table);
+
+  // Returns true if these are the columns of `table`.
+  bool Wrap(const backend::Table* table) const;
+
+  std::vector<std::unique_ptr<const QueryableColumn>> columns;
+  std::vector<int> primary_key_column_indexes;
+};
+
+// QueryableColumnsCache shares the queryable columns of the tables of a schema
+// between all the catalogs of that schema, so that they are built at most once
+// per schema version. Schema versions share the tables a schema change did not
+// touch, and so share their columns too.
+//
+// This class is thread-safe.
+class QueryableColumnsCache {
+ public:
+  // Returns the queryable columns of `table`, creating them if needed.
+  std::shared_ptr<const QueryableColumns> Get(const backend::Table* table)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Discards the columns of `tables`. Called when a new schema drops or alters
+  // them.
+  void Erase(absl::Span<const backend::Table* const> tables)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Discards all cached columns. Called when schemas are pruned.
+  void Clear() ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  absl::Mutex mu_;
+
+  absl::flat_hash_map<const backend::Table*,
+                      std::shared_ptr<const QueryableColumns>>
+      columns_ ABSL_GUARDED_BY(mu_);
+};
+
 // A wrapper over Table class which implements zetasql::Table.
 // QueryableTable builds instances of EvalutorTableIterator by reading data of
 // the table through a RowReader.
 class QueryableTable : public zetasql::Table {
  public:
-  QueryableTable(const backend::Table* table, RowReader* reader);
+  // If `columns` is null, the table builds its own column wrappers.
+  QueryableTable(const backend::Table* table, RowReader* reader,
+                 std::shared_ptr<const QueryableColumns> columns = nullptr);
 
   std::string Name() const override { return wrapped_table_->Name(); }
 
@@ -49,16 +111,16 @@ class QueryableTable : public zetasql::Table {
   int NumColumns() const override { return wrapped_table_->columns().size(); }
 
   const zetasql::Column* GetColumn(int i) const override {
-    return columns_[i].get();
+    return columns_->columns[i].get();
   }
 
   const zetasql::Column* FindColumnByName(
       const std::string& name) const override;
 
   std::optional<std::vector<int>> PrimaryKey() const override {
-    return primary_key_column_indexes_.empty()
+    return columns_->primary_key_column_indexes.empty()
                ? std::nullopt
-               : std::make_optional(primary_key_column_indexes_);
+               : std::make_optional(columns_->primary_key_column_indexes);
   }
 
   const backend::Table* wrapped_table() const { return wrapped_table_; }
@@ -68,6 +130,14 @@ class QueryableTable : public zetasql::Table {
   CreateEvaluatorTableIterator(
       absl::Span<const int> column_idxs) const override;
 
+  // Returns an iterator over the rows of the table in the key order of
+  // `index`, or of the primary key if `index` is nullptr. Filters set on the
+  // iterator narrow the keys read, but never change the order of the rows.
+  // The index must store all the columns in `column_idxs`.
+  zetasql_base::StatusOr<std::unique_ptr<zetasql::EvaluatorTableIterator>>
+  CreateOrderedEvaluatorTableIterator(absl::Span<const int> column_idxs,
+                                      const Index* index) const;
+
  private:
   // The underlying Table object which backes the QueryableTable.
   const backend::Table* wrapped_table_;
@@ -76,11 +146,8 @@ class QueryableTable : public zetasql::Table {
   // EvalutorTableIterator when CreateEvaluatorTableIterator is called.
   RowReader* reader_;
 
-  // The columns in the table.
-  std::vector<std::unique_ptr<const QueryableColumn>> columns_;
-
-  // A list of ordinal indexes of the primary key columns of the table.
-  std::vector<int> primary_key_column_indexes_;
+  // The columns in the table, possibly shared with other queryable tables.
+  std::shared_ptr<const QueryableColumns> columns_;
 };
 
 }  // namespace backend
@@ -16,12 +16,21 @@
 
 #include "backend/query/queryable_table.h"
 
+#include <memory>
+#include <vector>
+
+#include "zetasql/public/evaluator_table_iterator.h"
 #include "zetasql/public/type.h"
 #include "zetasql/public/value.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "zetasql/base/testing/status_matchers.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
 #include "backend/access/read.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/datamodel/key_set.h"
 #include "backend/query/catalog.h"
 #include "backend/query/queryable_column.h"
 #include "tests/common/row_cursor.h"
@@ -37,11 +46,52 @@ namespace {
 
 using testing::ElementsAre;
 
+// A RowReader which records the last ReadArg it was called with.
+class RecordingRowReader : public RowReader {
+ public:
+  explicit RecordingRowReader(RowReader* reader) : reader_(reader) {}
+
+  absl::Status Read(const ReadArg& read_arg,
+                    std::unique_ptr<RowCursor>* cursor) override {
+    last_read_arg_ = read_arg;
+    return reader_->Read(read_arg, cursor);
+  }
+
+  const ReadArg& last_read_arg() const { return last_read_arg_; }
+
+ private:
+  RowReader* reader_;
+  ReadArg last_read_arg_;
+};
+
 class QueryableTableTest : public testing::Test {
  public:
   const Schema* schema() { return schema_.get(); }
   RowReader* reader() { return &reader_; }
 
+  // Returns the last read made by an iterator over all the columns of the
+  // table with the given column filters.
+  ReadArg ReadWithFilters(
+      absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>>
+          filter_map) {
+    RecordingRowReader recording_reader(reader());
+    QueryableTable table{schema()->FindTable("test_table"), &recording_reader};
+    auto iterator =
+        table.CreateEvaluatorTableIterator(/*column_idxs=*/{0, 1}).value();
+    ZETASQL_EXPECT_OK(iterator->SetColumnFilterMap(std::move(filter_map)));
+    EXPECT_TRUE(iterator->NextRow());
+    ZETASQL_EXPECT_OK(iterator->Status());
+    return recording_reader.last_read_arg();
+  }
+
+  // Returns the key set read by an iterator over all the columns of the table
+  // with the given column filters.
+  KeySet ReadKeySet(
+      absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>>
+          filter_map) {
+    return ReadWithFilters(std::move(filter_map)).key_set;
+  }
+
  private:
   zetasql::TypeFactory type_factory_;
   std::unique_ptr<const Schema> schema_ =
@@ -112,6 +162,103 @@ TEST_F(QueryableTableTest, CreateEvaluatorTableIteratorWithAllColumns) {
   ASSERT_FALSE(iterator->NextRow());
 }
 
+TEST_F(QueryableTableTest, ReadsAllKeysWithoutFilters) {
+  KeySet key_set = ReadKeySet({});
+  EXPECT_TRUE(key_set.keys().empty());
+  EXPECT_THAT(key_set.ranges(), ElementsAre(KeyRange::All()));
+}
+
+TEST_F(QueryableTableTest, PushesDownKeyEqualityFiltersAsPointReads) {
+  absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>> filters;
+  filters[0] = absl::make_unique<zetasql::ColumnFilter>(
+      std::vector<zetasql::Value>{zetasql::values::Int64(42),
+                                  zetasql::values::Int64(43)});
+  KeySet key_set = ReadKeySet(std::move(filters));
+  EXPECT_THAT(key_set.keys(), ElementsAre(Key({zetasql::values::Int64(42)}),
+                                          Key({zetasql::values::Int64(43)})));
+  EXPECT_TRUE(key_set.ranges().empty());
+}
+
+TEST_F(QueryableTableTest, PushesDownKeyRangeFiltersAsRangeReads) {
+  absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>> filters;
+  filters[0] = absl::make_unique<zetasql::ColumnFilter>(
+      zetasql::values::Int64(1), zetasql::Value());
+  KeySet key_set = ReadKeySet(std::move(filters));
+  EXPECT_TRUE(key_set.keys().empty());
+  EXPECT_THAT(key_set.ranges(),
+              ElementsAre(KeyRange::ClosedClosed(
+                  Key({zetasql::values::Int64(1)}), Key())));
+}
+
+TEST_F(QueryableTableTest, ReadsCoveringIndexForFiltersOnIndexKeyColumns) {
+  absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>> filters;
+  filters[1] = absl::make_unique<zetasql::ColumnFilter>(
+      std::vector<zetasql::Value>{zetasql::values::String("foo")});
+  ReadArg read_arg = ReadWithFilters(std::move(filters));
+  EXPECT_EQ(read_arg.index, "test_index");
+  EXPECT_TRUE(read_arg.key_set.keys().empty());
+  EXPECT_THAT(
+      read_arg.key_set.ranges(),
+      ElementsAre(KeyRange::Prefix(Key({zetasql::values::String("foo")}))));
+}
+
+TEST_F(QueryableTableTest, PrefersPrimaryKeyFiltersOverIndexKeyFilters) {
+  absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>> filters;
+  filters[0] = absl::make_unique<zetasql::ColumnFilter>(
+      std::vector<zetasql::Value>{zetasql::values::Int64(42)});
+  filters[1] = absl::make_unique<zetasql::ColumnFilter>(
+      std::vector<zetasql::Value>{zetasql::values::String("foo")});
+  ReadArg read_arg = ReadWithFilters(std::move(filters));
+  EXPECT_TRUE(read_arg.index.empty());
+  EXPECT_THAT(read_arg.key_set.keys(),
+              ElementsAre(Key({zetasql::values::Int64(42)})));
+}
+
+TEST(QueryableTableIndexTest, JoinsNonCoveringIndexBackToTable) {
+  zetasql::TypeFactory type_factory;
+  std::unique_ptr<const Schema> schema =
+      test::CreateSchemaFromDDL(
+          {
+              R"(
+                  CREATE TABLE test_table (
+                    int64_col INT64 NOT NULL,
+                    string_col STRING(MAX),
+                    another_string_col STRING(MAX)
+                  ) PRIMARY KEY (int64_col)
+                )",
+              R"(
+                  CREATE INDEX test_index ON test_table(string_col)
+                )",
+          },
+          &type_factory)
+          .value();
+  test::TestRowReader reader{
+      {{"test_table",
+        {{"int64_col", "string_col", "another_string_col"},
+         {zetasql::types::Int64Type(), zetasql::types::StringType(),
+          zetasql::types::StringType()},
+         {{zetasql::values::Int64(42), zetasql::values::String("foo"),
+           zetasql::values::String("bar")}}}}}};
+  RecordingRowReader recording_reader(&reader);
+  QueryableTable table{schema->FindTable("test_table"), &recording_reader};
+  auto iterator =
+      table.CreateEvaluatorTableIterator(/*column_idxs=*/{1, 2}).value();
+  absl::flat_hash_map<int, std::unique_ptr<zetasql::ColumnFilter>> filters;
+  filters[0] = absl::make_unique<zetasql::ColumnFilter>(
+      std::vector<zetasql::Value>{zetasql::values::String("foo")});
+  ZETASQL_ASSERT_OK(iterator->SetColumnFilterMap(std::move(filters)));
+  ASSERT_TRUE(iterator->NextRow());
+  ZETASQL_ASSERT_OK(iterator->Status());
+  EXPECT_EQ(iterator->GetValue(1).string_value(), "bar");
+
+  // The last read is of the table, for the keys found in the index.
+  const ReadArg& read_arg = recording_reader.last_read_arg();
+  EXPECT_TRUE(read_arg.index.empty());
+  EXPECT_THAT(read_arg.key_set.keys(),
+              ElementsAre(Key({zetasql::values::Int64(42)})));
+  EXPECT_TRUE(read_arg.key_set.ranges().empty());
+}
+
 }  // namespace
 
 }  // namespace backend
@@ -0,0 +1,90 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/query/sort_rewriter.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "zetasql/resolved_ast/resolved_node_kind.pb.h"
+#include "absl/strings/str_cat.h"
+#include "backend/query/external_sort.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+absl::Status SortRewriter::VisitResolvedQueryStmt(
+    const zetasql::ResolvedQueryStmt* node) {
+  if (node->is_value_table() ||
+      node->query()->node_kind() != zetasql::RESOLVED_ORDER_BY_SCAN) {
+    return CopyVisitResolvedQueryStmt(node);
+  }
+  const auto* order_by_scan =
+      node->query()->GetAs<zetasql::ResolvedOrderByScan>();
+  for (const auto& item : order_by_scan->order_by_item_list()) {
+    if (item->collation_name() != nullptr ||
+        !IsExternallySortable(item->column_ref()->column().type())) {
+      return CopyVisitResolvedQueryStmt(node);
+    }
+  }
+
+  std::vector<std::unique_ptr<const zetasql::ResolvedOutputColumn>>
+      output_columns;
+  for (const auto& output_column : node->output_column_list()) {
+    output_columns.push_back(zetasql::MakeResolvedOutputColumn(
+        output_column->name(), output_column->column()));
+  }
+  std::vector<SortColumn> sort_columns;
+  for (const auto& item : order_by_scan->order_by_item_list()) {
+    const zetasql::ResolvedColumn& column = item->column_ref()->column();
+    int index = 0;
+    while (index < output_columns.size() &&
+           output_columns[index]->column() != column) {
+      ++index;
+    }
+    if (index == output_columns.size()) {
+      output_columns.push_back(zetasql::MakeResolvedOutputColumn(
+          absl::StrCat("$sort", index), column));
+    }
+    sort_columns.push_back({index, item->is_descending()});
+  }
+
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<zetasql::ResolvedScan> input_scan,
+                   ProcessNode(order_by_scan->input_scan()));
+  auto statement = zetasql::MakeResolvedQueryStmt(
+      std::move(output_columns), /*is_value_table=*/false,
+      std::move(input_scan));
+  for (const auto& hint : node->hint_list()) {
+    ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<zetasql::ResolvedOption> copy,
+                     ProcessNode(hint.get()));
+    statement->add_hint_list(std::move(copy));
+  }
+  sort_columns_ = std::move(sort_columns);
+  PushNodeToStack(std::move(statement));
+  return absl::OkStatus();
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,62 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_SORT_REWRITER_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_SORT_REWRITER_H_
+
+#include <utility>
+#include <vector>
+
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "zetasql/resolved_ast/resolved_ast_deep_copy_visitor.h"
+#include "backend/query/external_sort.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// Implements ResolvedASTDeepCopyVisitor to remove the outermost ORDER BY of a
+// query, so that its rows are sorted by an ExternalSortRowCursor rather than
+// by the ZetaSQL reference implementation, which sorts all rows in memory.
+//
+// A query is rewritten if it is not a value table and its ORDER BY only orders
+// by columns without collation whose types are externally sortable. The
+// columns ordered by which are not output by the query are added to its
+// output, after the columns of the original query.
+class SortRewriter : public zetasql::ResolvedASTDeepCopyVisitor {
+ public:
+  absl::Status VisitResolvedQueryStmt(
+      const zetasql::ResolvedQueryStmt* node) override;
+
+  // Returns the columns of the rewritten query by which its rows must be
+  // sorted, or nothing if the query was not rewritten.
+  std::vector<SortColumn> release_sort_columns() {
+    return std::move(sort_columns_);
+  }
+
+ private:
+  std::vector<SortColumn> sort_columns_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_SORT_REWRITER_H_
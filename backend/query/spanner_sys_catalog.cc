@@ -0,0 +1,259 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/query/spanner_sys_catalog.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/evaluator_table_iterator.h"
+#include "zetasql/public/simple_catalog.h"
+#include "zetasql/public/value.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "backend/common/ids.h"
+#include "backend/datamodel/key.h"
+#include "backend/locking/lock_stats.h"
+#include "backend/query/query_stats.h"
+#include "backend/schema/catalog/schema.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+using zetasql::types::BoolType;
+using zetasql::types::DoubleType;
+using zetasql::types::Int64Type;
+using zetasql::types::StringType;
+using zetasql::values::Bool;
+using zetasql::values::Double;
+using zetasql::values::Int64;
+using zetasql::values::String;
+
+using Rows = std::vector<std::vector<zetasql::Value>>;
+
+// Iterates over rows generated when the iterator was created.
+class RowsIterator : public zetasql::EvaluatorTableIterator {
+ public:
+  RowsIterator(const zetasql::Table* table, absl::Span<const int> column_idxs,
+               Rows rows)
+      : table_(table),
+        column_idxs_(column_idxs.begin(), column_idxs.end()),
+        rows_(std::move(rows)) {}
+
+  int NumColumns() const override { return column_idxs_.size(); }
+
+  std::string GetColumnName(int i) const override {
+    return table_->GetColumn(column_idxs_[i])->Name();
+  }
+
+  const zetasql::Type* GetColumnType(int i) const override {
+    return table_->GetColumn(column_idxs_[i])->GetType();
+  }
+
+  bool NextRow() override { return ++row_ <= rows_.size(); }
+
+  const zetasql::Value& GetValue(int i) const override {
+    return rows_[row_ - 1][column_idxs_[i]];
+  }
+
+  absl::Status Status() const override { return absl::OkStatus(); }
+
+  // Cancel is best-effort and not required.
+  absl::Status Cancel() override { return absl::OkStatus(); }
+
+ private:
+  const zetasql::Table* table_;
+
+  // The indexes of the table columns read, in the order they are returned.
+  const std::vector<int> column_idxs_;
+
+  const Rows rows_;
+
+  // One past the index of the current row.
+  size_t row_ = 0;
+};
+
+// A SPANNER_SYS table, whose rows are listed by `list_rows` whenever it is
+// read.
+class SpannerSysTable : public zetasql::SimpleTable {
+ public:
+  SpannerSysTable(const std::string& name,
+                  const std::vector<NameAndType>& columns,
+                  std::function<Rows()> list_rows)
+      : zetasql::SimpleTable(name, columns),
+        list_rows_(std::move(list_rows)) {}
+
+  zetasql_base::StatusOr<std::unique_ptr<zetasql::EvaluatorTableIterator>>
+  CreateEvaluatorTableIterator(
+      absl::Span<const int> column_idxs) const override {
+    return absl::make_unique<RowsIterator>(this, column_idxs, list_rows_());
+  }
+
+ private:
+  const std::function<Rows()> list_rows_;
+};
+
+// Returns the key in the format of Cloud Spanner's ROW_RANGE_START_KEY, e.g.
+// Singers(1,"Marc").
+std::string RangeStartKey(const std::string& table_name, const Key& key) {
+  std::vector<std::string> values;
+  values.reserve(key.NumColumns());
+  for (int i = 0; i < key.NumColumns(); ++i) {
+    values.push_back(key.ColumnValue(i).DebugString());
+  }
+  return absl::StrCat(table_name, "(", absl::StrJoin(values, ","), ")");
+}
+
+// Returns the average of `total` over `count` executions.
+double Average(double total, int64_t count) {
+  return count == 0 ? 0 : total / count;
+}
+
+}  // namespace
+
+SpannerSysCatalog::SpannerSysCatalog(const Schema* schema,
+                                     const LockStats* lock_stats,
+                                     const QueryStats* query_stats)
+    : zetasql::SimpleCatalog(kName),
+      schema_(schema),
+      lock_stats_(lock_stats),
+      query_stats_(query_stats) {
+  AddOwnedTable(new SpannerSysTable(
+      "LOCK_STATS_TOP_RANGES",
+      {{"TABLE_NAME", StringType()},
+       {"ROW_RANGE_START_KEY", StringType()},
+       {"LOCK_CONFLICTS", Int64Type()},
+       {"ABORTS", Int64Type()},
+       {"LOCK_WAIT_SECONDS", DoubleType()}},
+      [this] { return TopRangesRows(); }));
+  AddOwnedTable(new SpannerSysTable(
+      "LOCK_STATS_TOP_TABLES",
+      {{"TABLE_NAME", StringType()},
+       {"LOCK_CONFLICTS", Int64Type()},
+       {"ABORTS", Int64Type()},
+       {"LOCK_WAIT_SECONDS", DoubleType()}},
+      [this] { return TopTablesRows(); }));
+  AddOwnedTable(new SpannerSysTable(
+      "QUERY_STATS_TOP_QUERIES",
+      {{"TEXT", StringType()},
+       {"TEXT_TRUNCATED", BoolType()},
+       {"TEXT_FINGERPRINT", Int64Type()},
+       {"EXECUTION_COUNT", Int64Type()},
+       {"ALL_FAILED_EXECUTION_COUNT", Int64Type()},
+       {"AVG_LATENCY_SECONDS", DoubleType()},
+       {"LATENCY_P50_SECONDS", DoubleType()},
+       {"LATENCY_P99_SECONDS", DoubleType()},
+       {"MAX_LATENCY_SECONDS", DoubleType()},
+       {"AVG_ROWS", DoubleType()},
+       {"AVG_BYTES", DoubleType()},
+       {"AVG_ROWS_SCANNED", DoubleType()}},
+      [this] { return TopQueriesRows(); }));
+}
+
+bool SpannerSysCatalog::IsSpannerSysTable(const zetasql::Table* table) {
+  return dynamic_cast<const SpannerSysTable*>(table) != nullptr;
+}
+
+absl::flat_hash_map<TableID, std::string> SpannerSysCatalog::TableNames()
+    const {
+  absl::flat_hash_map<TableID, std::string> names;
+  for (const Table* table : schema_->tables()) {
+    names[table->id()] = table->Name();
+    for (const Index* index : table->indexes()) {
+      names[index->index_data_table()->id()] = index->Name();
+    }
+  }
+  return names;
+}
+
+SpannerSysCatalog::Rows SpannerSysCatalog::TopRangesRows() const {
+  Rows rows;
+  if (lock_stats_ == nullptr) {
+    return rows;
+  }
+  const absl::flat_hash_map<TableID, std::string> names = TableNames();
+  for (const LockStats::Entry& entry : lock_stats_->TopRanges(kNumTopRows)) {
+    auto itr = names.find(entry.table_id);
+    if (itr == names.end()) {
+      continue;
+    }
+    rows.push_back({String(itr->second),
+                    String(RangeStartKey(itr->second, entry.start_key)),
+                    Int64(entry.counts.lock_conflicts),
+                    Int64(entry.counts.aborts),
+                    Double(absl::ToDoubleSeconds(entry.counts.lock_wait))});
+  }
+  return rows;
+}
+
+SpannerSysCatalog::Rows SpannerSysCatalog::TopTablesRows() const {
+  Rows rows;
+  if (lock_stats_ == nullptr) {
+    return rows;
+  }
+  const absl::flat_hash_map<TableID, std::string> names = TableNames();
+  for (const LockStats::Entry& entry : lock_stats_->TopTables(kNumTopRows)) {
+    auto itr = names.find(entry.table_id);
+    if (itr == names.end()) {
+      continue;
+    }
+    rows.push_back({String(itr->second), Int64(entry.counts.lock_conflicts),
+                    Int64(entry.counts.aborts),
+                    Double(absl::ToDoubleSeconds(entry.counts.lock_wait))});
+  }
+  return rows;
+}
+
+SpannerSysCatalog::Rows SpannerSysCatalog::TopQueriesRows() const {
+  Rows rows;
+  if (query_stats_ == nullptr) {
+    return rows;
+  }
+  for (const QueryStats::Entry& entry :
+       query_stats_->TopQueries(kNumTopRows)) {
+    const int64_t count = entry.execution_count;
+    rows.push_back(
+        {String(entry.text), Bool(entry.text_truncated),
+         Int64(entry.fingerprint), Int64(count),
+         Int64(entry.failed_execution_count),
+         Double(Average(absl::ToDoubleSeconds(entry.total_latency), count)),
+         Double(absl::ToDoubleSeconds(entry.LatencyPercentile(0.5))),
+         Double(absl::ToDoubleSeconds(entry.LatencyPercentile(0.99))),
+         Double(absl::ToDoubleSeconds(entry.max_latency)),
+         Double(Average(entry.rows_returned, count)),
+         Double(Average(entry.bytes_returned, count)),
+         Double(Average(entry.rows_scanned, count))});
+  }
+  return rows;
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
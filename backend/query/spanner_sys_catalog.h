@@ -0,0 +1,93 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_SPANNER_SYS_CATALOG_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_SPANNER_SYS_CATALOG_H_
+
+#include <string>
+#include <vector>
+
+#include "zetasql/public/simple_catalog.h"
+#include "zetasql/public/value.h"
+#include "absl/container/flat_hash_map.h"
+#include "backend/common/ids.h"
+#include "backend/locking/lock_stats.h"
+#include "backend/query/query_stats.h"
+#include "backend/schema/catalog/schema.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// SpannerSysCatalog provides the SPANNER_SYS tables which report the lock
+// contention and the query executions of the database, modeled on the lock
+// and query statistics of Cloud Spanner:
+//   https://cloud.google.com/spanner/docs/introspection/lock-statistics
+//   https://cloud.google.com/spanner/docs/introspection/query-statistics
+//
+// Unlike Cloud Spanner, which aggregates statistics over intervals, the
+// emulator reports the statistics counted since the database was created:
+//
+//   LOCK_STATS_TOP_RANGES: the hottest ranges of keys, identified by their
+//     ROW_RANGE_START_KEY, with their LOCK_CONFLICTS, ABORTS and
+//     LOCK_WAIT_SECONDS.
+//   LOCK_STATS_TOP_TABLES: the same totals for the hottest tables.
+//   QUERY_STATS_TOP_QUERIES: the shapes of the SQL statements with the longest
+//     total latency, identified by their TEXT_FINGERPRINT, with their
+//     EXECUTION_COUNT and the latency and averages of their executions.
+//
+// Tables are named after the schema of the catalog, and ranges of index data
+// tables after their index. Contention on tables the schema does not have
+// (e.g. dropped tables) is not reported. Rows are generated as they are read,
+// so queries over these tables are never deterministic, see
+// IsSpannerSysTable.
+class SpannerSysCatalog : public zetasql::SimpleCatalog {
+ public:
+  static constexpr char kName[] = "SPANNER_SYS";
+
+  // Number of rows reported by each table, hottest first.
+  static constexpr int kNumTopRows = 100;
+
+  // If `lock_stats` or `query_stats` is null, the tables reporting them are
+  // empty.
+  SpannerSysCatalog(const Schema* schema, const LockStats* lock_stats,
+                    const QueryStats* query_stats = nullptr);
+
+  // Returns true if `table` is one of the SPANNER_SYS tables.
+  static bool IsSpannerSysTable(const zetasql::Table* table);
+
+ private:
+  using Rows = std::vector<std::vector<zetasql::Value>>;
+
+  // Returns the names of the tables and index data tables of the schema.
+  absl::flat_hash_map<TableID, std::string> TableNames() const;
+
+  Rows TopRangesRows() const;
+  Rows TopTablesRows() const;
+  Rows TopQueriesRows() const;
+
+  const Schema* schema_;
+  const LockStats* lock_stats_;
+  const QueryStats* query_stats_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_QUERY_SPANNER_SYS_CATALOG_H_
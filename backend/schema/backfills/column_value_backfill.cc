@@ -16,11 +16,20 @@
 
 #include "backend/schema/backfills/column_value_backfill.h"
 
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
 #include "zetasql/public/type.h"
 #include "zetasql/public/value.h"
 #include "zetasql/base/statusor.h"
 #include "backend/datamodel/types.h"
 #include "backend/schema/catalog/table.h"
+#include "backend/schema/updater/parallel_table_scan.h"
+#include "backend/storage/iterator.h"
+#include "backend/storage/storage.h"
+#include "common/cancellation.h"
 #include "absl/status/status.h"
 #include "zetasql/base/status_macros.h"
 
@@ -67,33 +76,70 @@ zetasql_base::StatusOr<zetasql::Value> RewriteColumnValue(
   return zetasql::Value::String(value.bytes_value());
 }
 
-}  // namespace
-
-absl::Status BackfillColumnValue(const Column* old_column,
-                                 const Column* new_column,
-                                 const SchemaValidationContext* context) {
-  ZETASQL_RET_CHECK_EQ(old_column->id(), new_column->id());
-  auto column_id = old_column->id();
-  const Table* table = old_column->table();
-
+// Computes the rewrites of the values of `old_column` within `range`. Rows
+// without a value for the column are left alone, since there is nothing to
+// convert.
+absl::Status ComputeColumnValueRewrites(const Column* old_column,
+                                        const Column* new_column,
+                                        const SchemaValidationContext* context,
+                                        const KeyRange& range,
+                                        std::vector<StorageWrite>* writes) {
+  const ColumnID column_id = old_column->id();
   std::unique_ptr<StorageIterator> itr;
-  ZETASQL_RETURN_IF_ERROR(context->storage()->Read(context->pending_commit_timestamp(),
-                                           table->id(), KeyRange::All(),
-                                           {column_id}, &itr));
+  ZETASQL_RETURN_IF_ERROR(context->storage()->Read(
+      context->pending_commit_timestamp(), old_column->table()->id(), range,
+      {column_id}, &itr));
 
+  CancellationCheck cancellation(context->cancellation());
   while (itr->Next()) {
-    std::vector<zetasql::Value> row_values;
+    ZETASQL_RETURN_IF_ERROR(cancellation.OnRow());
     ZETASQL_RET_CHECK_EQ(itr->NumColumns(), 1);
     const zetasql::Value& orig_value = itr->ColumnValue(0);
-    ZETASQL_ASSIGN_OR_RETURN(const auto new_column_value,
+    if (!orig_value.is_valid()) {
+      continue;
+    }
+    ZETASQL_ASSIGN_OR_RETURN(zetasql::Value new_column_value,
                      RewriteColumnValue(old_column->GetType(),
                                         new_column->GetType(), orig_value));
-    ZETASQL_RETURN_IF_ERROR(context->storage()->Write(
-        context->pending_commit_timestamp(), table->id(), itr->Key(),
-        {column_id}, {new_column_value}));
+    StorageWrite write;
+    write.key = itr->Key();
+    write.column_ids = {column_id};
+    write.values = {std::move(new_column_value)};
+    writes->push_back(std::move(write));
   }
+  return itr->Status();
+}
 
-  return absl::OkStatus();
+}  // namespace
+
+absl::Status BackfillColumnValue(const Column* old_column,
+                                 const Column* new_column,
+                                 const SchemaValidationContext* context) {
+  ZETASQL_RET_CHECK_EQ(old_column->id(), new_column->id());
+  const Table* table = old_column->table();
+
+  // Convert the values of each key range of the table in parallel, then write
+  // them back in key order with a single batch.
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<KeyRange> ranges,
+                   SplitTableKeySpace(table, context));
+  std::vector<std::vector<StorageWrite>> range_writes(ranges.size());
+  ZETASQL_RETURN_IF_ERROR(ForEachRangeInParallel(ranges.size(), [&](int i) {
+    return ComputeColumnValueRewrites(old_column, new_column, context,
+                                      ranges[i], &range_writes[i]);
+  }));
+
+  size_t num_writes = 0;
+  for (const auto& writes : range_writes) {
+    num_writes += writes.size();
+  }
+  std::vector<StorageWrite> writes;
+  writes.reserve(num_writes);
+  for (auto& range : range_writes) {
+    std::move(range.begin(), range.end(), std::back_inserter(writes));
+    range.clear();
+  }
+  return context->storage()->WriteBatch(context->pending_commit_timestamp(),
+                                        table->id(), writes);
 }
 
 }  // namespace backend
@@ -52,7 +52,7 @@ class ColumnValueBackfillTest : public ::testing::Test {
  protected:
   void SetUp() override {
     std::vector<std::string> create_statements;
-    ZETASQL_ASSERT_OK_AND_ASSIGN(database_, Database::Create(&clock_, {R"(
+    ZETASQL_ASSERT_OK_AND_ASSIGN(database_, Database::Create({R"(
                             CREATE TABLE TestTable (
                               int64_col INT64,
                               string_col STRING(10),
@@ -117,7 +117,6 @@ class ColumnValueBackfillTest : public ::testing::Test {
     return values;
   }
 
-  Clock clock_;
   std::unique_ptr<Database> database_;
   const zetasql::ArrayType* string_array_type_ = nullptr;
   const zetasql::ArrayType* bytes_array_type_ = nullptr;
@@ -161,6 +160,45 @@ TEST_F(ColumnValueBackfillTest, BackfillArrayType) {
               }));
 }
 
+TEST_F(ColumnValueBackfillTest, VerifiesAndBackfillsLargeTableInParallel) {
+  // Enough rows for the table to be verified and backfilled in several key
+  // ranges, two of which have values too long for STRING(6).
+  constexpr int kNumRows = 20000;
+  {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<ReadWriteTransaction> txn,
+                         database_->CreateReadWriteTransaction(
+                             ReadWriteOptions(), RetryState()));
+    std::vector<std::vector<zetasql::Value>> rows;
+    for (int i = 3; i < kNumRows; ++i) {
+      rows.push_back({Int64(i), String(i == 5000 || i == 15000 ? "0123456789"
+                                                               : "abc")});
+    }
+    Mutation m;
+    m.AddWriteOp(MutationOpType::kInsert, "TestTable",
+                 {"int64_col", "string_col"}, rows);
+    ZETASQL_ASSERT_OK(txn->Write(m));
+    ZETASQL_ASSERT_OK(txn->Commit());
+  }
+
+  // The error of the first row in key order is reported.
+  EXPECT_EQ(UpdateSchema({R"(
+    ALTER TABLE TestTable ALTER COLUMN string_col STRING(6)
+    )"}),
+            error::InvalidColumnSizeReduction("string_col", 6, 10,
+                                              "{Int64(5000)}"));
+
+  ZETASQL_EXPECT_OK(UpdateSchema({R"(
+    ALTER TABLE TestTable ALTER COLUMN string_col BYTES(20)
+    )"}));
+  std::vector<zetasql::Value> values = ColumnValues("string_col");
+  ASSERT_EQ(values.size(), kNumRows - 1);
+  EXPECT_EQ(values[0], Bytes("ФдΣβaA"));
+  EXPECT_EQ(values[1], NullBytes());
+  EXPECT_EQ(values[2], Bytes("abc"));
+  EXPECT_EQ(values[5000 - 1], Bytes("0123456789"));
+  EXPECT_EQ(values.back(), Bytes("abc"));
+}
+
 }  // namespace
 }  // namespace backend
 }  // namespace emulator
@@ -16,8 +16,12 @@
 
 #include "backend/schema/backfills/index_backfill.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
 #include <memory>
-#include <queue>
+#include <utility>
+#include <vector>
 
 #include "zetasql/public/functions/string.h"
 #include "zetasql/public/type.pb.h"
@@ -28,10 +32,15 @@
 #include "backend/common/ids.h"
 #include "backend/common/indexing.h"
 #include "backend/common/rows.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
 #include "backend/datamodel/value.h"
 #include "backend/schema/catalog/column.h"
+#include "backend/schema/updater/parallel_table_scan.h"
 #include "backend/storage/in_memory_storage.h"
 #include "backend/storage/iterator.h"
+#include "backend/storage/storage.h"
+#include "common/cancellation.h"
 #include "common/errors.h"
 #include "common/limits.h"
 #include "absl/status/status.h"
@@ -43,24 +52,31 @@ namespace spanner {
 namespace emulator {
 namespace backend {
 
-absl::Status BackfillIndex(const Index* index,
-                           const SchemaValidationContext* context) {
+namespace {
+
+// An entry of the index data table computed from a base table row.
+struct IndexEntry {
+  Key key;
+  ValueList values;
+};
+
+// Computes the index entries for the base table rows within `range`.
+absl::Status ComputeIndexEntries(const Index* index,
+                                 const SchemaValidationContext* context,
+                                 const KeyRange& range,
+                                 std::vector<IndexEntry>* entries) {
   absl::Span<const Column* const> base_columns =
       index->indexed_table()->columns();
-  absl::Span<const Column* const> index_columns =
-      index->index_data_table()->columns();
   std::vector<ColumnID> base_column_ids = GetColumnIDs(base_columns);
-  std::vector<ColumnID> index_column_ids = GetColumnIDs(index_columns);
 
-  // TODO: Use actions framework for index backfills.
   std::unique_ptr<StorageIterator> itr;
   ZETASQL_RETURN_IF_ERROR(context->storage()->Read(
-      context->pending_commit_timestamp(), index->indexed_table()->id(),
-      KeyRange::All(), base_column_ids, &itr));
+      context->pending_commit_timestamp(), index->indexed_table()->id(), range,
+      base_column_ids, &itr));
 
-  // List of index keys used for verifying index uniqueness.
-  std::set<Key> index_keys;
+  CancellationCheck cancellation(context->cancellation());
   while (itr->Next()) {
+    ZETASQL_RETURN_IF_ERROR(cancellation.OnRow());
     std::vector<zetasql::Value> row_values;
     row_values.reserve(itr->NumColumns());
     for (int i = 0; i < itr->NumColumns(); ++i) {
@@ -77,28 +93,127 @@ absl::Status BackfillIndex(const Index* index,
     // Backfill should return failed precondition error for invalid index keys.
     ZETASQL_ASSIGN_OR_RETURN(Key index_data_table_key, ComputeIndexKey(base_row, index),
                      _.SetErrorCode(absl::StatusCode::kFailedPrecondition));
-    ValueList index_values = ComputeIndexValues(base_row, index);
     if (ShouldFilterIndexKey(index, index_data_table_key)) {
       continue;
     }
+    entries->push_back(IndexEntry{std::move(index_data_table_key),
+                                  ComputeIndexValues(base_row, index)});
+  }
+  return itr->Status();
+}
+
+// Minimum number of base table rows in each chunk of a backfill. The index
+// entries of a chunk are computed, sorted and written before moving on to the
+// next chunk, so only about a chunk of entries is held in memory.
+constexpr int64_t kMinRowsPerBackfillChunk = 16 * 1024;
+
+// Returns whether the index data table already holds an entry whose index key
+// is `index_key`, written by an earlier chunk of the backfill.
+zetasql_base::StatusOr<bool> HasIndexEntry(const Index* index,
+                                   const SchemaValidationContext* context,
+                                   const Key& index_key) {
+  std::unique_ptr<StorageIterator> itr;
+  ZETASQL_RETURN_IF_ERROR(context->storage()->Read(
+      context->pending_commit_timestamp(), index->index_data_table()->id(),
+      KeyRange::Prefix(index_key), /*column_ids=*/{}, &itr));
+  const bool found = itr->Next();
+  ZETASQL_RETURN_IF_ERROR(itr->Status());
+  return found;
+}
+
+// Computes, sorts, checks and writes the index entries of the base table rows
+// within `chunk`. `check_written` tells whether earlier chunks wrote entries
+// which unique keys must be checked against.
+absl::Status BackfillChunk(const Index* index,
+                           const SchemaValidationContext* context,
+                           const KeyRange& chunk, bool check_written) {
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<KeyRange> ranges,
+                   SplitTableKeyRange(index->indexed_table(), chunk, context));
 
-    // Check uniqueness constraints.
-    if (index->is_unique()) {
-      Key index_key = index_data_table_key.Prefix(index->key_columns().size());
-      if (index_keys.find(index_key) != index_keys.end()) {
+  // Compute the index entries of each range of the chunk, in parallel if there
+  // is more than one range.
+  std::vector<std::vector<IndexEntry>> range_entries(ranges.size());
+  ZETASQL_RETURN_IF_ERROR(ForEachRangeInParallel(ranges.size(), [&](int i) {
+    return ComputeIndexEntries(index, context, ranges[i], &range_entries[i]);
+  }));
+  size_t num_entries = 0;
+  for (const auto& entries : range_entries) {
+    num_entries += entries.size();
+  }
+
+  // Sort the entries of all ranges by index key.
+  std::vector<IndexEntry> entries;
+  entries.reserve(num_entries);
+  for (auto& range : range_entries) {
+    std::move(range.begin(), range.end(), std::back_inserter(entries));
+    range.clear();
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const IndexEntry& a, const IndexEntry& b) {
+              return a.key < b.key;
+            });
+
+  // Check uniqueness constraints. Since the index data table key is the index
+  // key followed by the base table key, entries of the chunk with equal index
+  // keys are adjacent once sorted. Entries of earlier chunks are looked up in
+  // the index data table, once per distinct index key of the chunk.
+  if (index->is_unique()) {
+    const int num_key_columns = index->key_columns().size();
+    for (int i = 0; i < entries.size(); ++i) {
+      Key index_key = entries[i].key.Prefix(num_key_columns);
+      if (i > 0 && entries[i - 1].key.Prefix(num_key_columns) == index_key) {
         return error::UniqueIndexViolationOnIndexCreation(
             index->Name(), index_key.DebugString());
       }
-      // Add key to current list of index keys.
-      index_keys.insert(index_key);
+      if (check_written) {
+        ZETASQL_ASSIGN_OR_RETURN(bool written,
+                         HasIndexEntry(index, context, index_key));
+        if (written) {
+          return error::UniqueIndexViolationOnIndexCreation(
+              index->Name(), index_key.DebugString());
+        }
+      }
     }
+  }
 
-    // Insert the new row in the index.
-    ZETASQL_RETURN_IF_ERROR(context->storage()->Write(
-        context->pending_commit_timestamp(), index->index_data_table()->id(),
-        index_data_table_key, index_column_ids, index_values));
+  // Bulk load the sorted entries into the index.
+  std::vector<ColumnID> index_column_ids =
+      GetColumnIDs(index->index_data_table()->columns());
+  std::vector<StorageWrite> writes;
+  writes.reserve(entries.size());
+  for (IndexEntry& entry : entries) {
+    StorageWrite write;
+    write.key = std::move(entry.key);
+    write.column_ids = index_column_ids;
+    write.values = std::move(entry.values);
+    writes.push_back(std::move(write));
   }
+  return context->storage()->WriteBatch(context->pending_commit_timestamp(),
+                                        index->index_data_table()->id(),
+                                        writes);
+}
 
+}  // namespace
+
+absl::Status BackfillIndex(const Index* index,
+                           const SchemaValidationContext* context) {
+  // TODO: Use actions framework for index backfills.
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<KeyRange> chunks,
+                   SplitTableIntoChunks(index->indexed_table(),
+                                        kMinRowsPerBackfillChunk, context));
+  for (int i = 0; i < chunks.size(); ++i) {
+    absl::Status status =
+        BackfillChunk(index, context, chunks[i], /*check_written=*/i > 0);
+    if (!status.ok()) {
+      // Entries of earlier chunks are dropped along with the index data table,
+      // so that no reads at or after the schema change see them.
+      ZETASQL_RETURN_IF_ERROR(context->storage()->DropTable(
+          context->pending_commit_timestamp(),
+          index->index_data_table()->id()));
+      return status;
+    }
+    context->ReportProgress(i + 1, chunks.size());
+  }
   return absl::OkStatus();
 }
 
@@ -16,17 +16,21 @@
 
 #include "backend/schema/backfills/index_backfill.h"
 
+#include <algorithm>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "zetasql/base/testing/status_matchers.h"
 #include "tests/common/proto_matchers.h"
+#include "absl/strings/str_cat.h"
 #include "absl/types/span.h"
 #include "backend/database/database.h"
 #include "backend/schema/catalog/schema.h"
 #include "backend/transaction/options.h"
+#include "common/cancellation.h"
 #include "common/errors.h"
 #include "tests/common/actions.h"
 #include "tests/common/schema_constructor.h"
@@ -48,15 +52,36 @@ using zetasql::values::String;
 // more robust testing after schema constructor has been finished.
 class BackfillTest : public ::testing::Test {
  public:
-  absl::Status UpdateSchema(absl::Span<const std::string> update_statements) {
+  absl::Status UpdateSchema(absl::Span<const std::string> update_statements,
+                            const CancellationToken* cancellation = nullptr,
+                            SchemaChangeProgressFn progress = nullptr) {
     int num_succesful;
     absl::Status backfill_status;
     absl::Time update_time;
     ZETASQL_RETURN_IF_ERROR(database_->UpdateSchema(update_statements, &num_succesful,
-                                            &update_time, &backfill_status));
+                                            &update_time, &backfill_status,
+                                            cancellation, std::move(progress)));
     return backfill_status;
   }
 
+  // Inserts `num_rows` rows into TestTable, whose string_col values are all
+  // distinct except for the first and last rows if `duplicate` is set.
+  void InsertRows(int num_rows, bool duplicate) {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<ReadWriteTransaction> txn,
+                         database_->CreateReadWriteTransaction(
+                             ReadWriteOptions(), RetryState()));
+    Mutation m;
+    for (int i = 0; i < num_rows; ++i) {
+      std::string value = duplicate && i == num_rows - 1
+                              ? "value0"
+                              : absl::StrCat("value", i);
+      m.AddWriteOp(MutationOpType::kInsert, "TestTable",
+                   {"int64_col", "string_col"}, {{Int64(i), String(value)}});
+    }
+    ZETASQL_EXPECT_OK(txn->Write(m));
+    ZETASQL_EXPECT_OK(txn->Commit());
+  }
+
  protected:
   void SetUp() override {
     std::vector<std::string> create_statements;
@@ -68,7 +93,7 @@ class BackfillTest : public ::testing::Test {
                             ) PRIMARY KEY (int64_col)
                           )");
     ZETASQL_ASSERT_OK_AND_ASSIGN(database_,
-                         Database::Create(&clock_, create_statements));
+                         Database::Create(create_statements));
 
     index_update_statements_.push_back(R"(
                             CREATE UNIQUE NULL_FILTERED INDEX TestIndex ON
@@ -78,7 +103,6 @@ class BackfillTest : public ::testing::Test {
   }
 
   // Test components.
-  Clock clock_;
   std::unique_ptr<Database> database_;
   const Schema* schema_;
 
@@ -299,6 +323,145 @@ TEST_F(BackfillTest, BackfillUniqueIndex) {
                 "TestIndex", R"({String("value")↓})"));
 }
 
+TEST_F(BackfillTest, BackfillIndexOverMultipleKeyRanges) {
+  // Enough rows for the backfill to split the table into several key ranges.
+  constexpr int kNumRows = 10000;
+  {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<ReadWriteTransaction> txn,
+                         database_->CreateReadWriteTransaction(
+                             ReadWriteOptions(), RetryState()));
+    Mutation m;
+    for (int i = 0; i < kNumRows; ++i) {
+      m.AddWriteOp(MutationOpType::kInsert, "TestTable",
+                   {"int64_col", "string_col"},
+                   {{Int64(i), String(absl::StrCat("value", i))}});
+    }
+    ZETASQL_EXPECT_OK(txn->Write(m));
+    ZETASQL_EXPECT_OK(txn->Commit());
+  }
+
+  ZETASQL_EXPECT_OK(UpdateSchema(index_update_statements_));
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ReadOnlyTransaction> txn,
+      database_->CreateReadOnlyTransaction(ReadOnlyOptions()));
+  std::unique_ptr<backend::RowCursor> cursor;
+  backend::ReadArg read_arg;
+  read_arg.table = "TestTable";
+  read_arg.index = "TestIndex";
+  read_arg.columns = {"string_col", "int64_col"};
+  read_arg.key_set = KeySet::All();
+  ZETASQL_EXPECT_OK(txn->Read(read_arg, &cursor));
+
+  // Index entries from all key ranges should be present, in index key order.
+  std::vector<std::string> index_keys;
+  while (cursor->Next()) {
+    EXPECT_EQ(cursor->ColumnValue(0).string_value(),
+              absl::StrCat("value", cursor->ColumnValue(1).int64_value()));
+    index_keys.push_back(cursor->ColumnValue(0).string_value());
+  }
+  ZETASQL_EXPECT_OK(cursor->Status());
+  EXPECT_EQ(index_keys.size(), kNumRows);
+  EXPECT_TRUE(std::is_sorted(index_keys.rbegin(), index_keys.rend()));
+}
+
+TEST_F(BackfillTest, CancelledBackfillDoesNotCreateIndex) {
+  {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<ReadWriteTransaction> txn,
+                         database_->CreateReadWriteTransaction(
+                             ReadWriteOptions(), RetryState()));
+    Mutation m;
+    m.AddWriteOp(MutationOpType::kInsert, "TestTable",
+                 {"int64_col", "string_col"}, {{Int64(1), String("value1")}});
+    ZETASQL_EXPECT_OK(txn->Write(m));
+    ZETASQL_EXPECT_OK(txn->Commit());
+  }
+
+  CancellationToken cancellation;
+  cancellation.Cancel();
+  EXPECT_THAT(UpdateSchema(index_update_statements_, &cancellation),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kCancelled));
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ReadOnlyTransaction> txn,
+      database_->CreateReadOnlyTransaction(ReadOnlyOptions()));
+  EXPECT_EQ(txn->schema()->tables()[0]->indexes().size(), 0);
+}
+
+TEST_F(BackfillTest, BackfillUniqueIndexDetectsDuplicatesAcrossKeyRanges) {
+  constexpr int kNumRows = 10000;
+  {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<ReadWriteTransaction> txn,
+                         database_->CreateReadWriteTransaction(
+                             ReadWriteOptions(), RetryState()));
+    Mutation m;
+    for (int i = 0; i < kNumRows; ++i) {
+      // The first and last rows fall into different key ranges of the backfill
+      // but share the same index key.
+      std::string value =
+          i == kNumRows - 1 ? "value0" : absl::StrCat("value", i);
+      m.AddWriteOp(MutationOpType::kInsert, "TestTable",
+                   {"int64_col", "string_col"}, {{Int64(i), String(value)}});
+    }
+    ZETASQL_EXPECT_OK(txn->Write(m));
+    ZETASQL_EXPECT_OK(txn->Commit());
+  }
+
+  EXPECT_EQ(UpdateSchema(index_update_statements_),
+            error::UniqueIndexViolationOnIndexCreation(
+                "TestIndex", R"({String("value0")↓})"));
+}
+
+TEST_F(BackfillTest, BackfillIndexReportsProgressOfEachChunk) {
+  // Enough rows for the backfill to process the table in several chunks.
+  constexpr int kNumRows = 50000;
+  InsertRows(kNumRows, /*duplicate=*/false);
+
+  std::vector<int> progress;
+  auto record_progress = [&](int statement_index, int progress_percent) {
+    EXPECT_EQ(statement_index, 0);
+    progress.push_back(progress_percent);
+  };
+  ZETASQL_EXPECT_OK(UpdateSchema(index_update_statements_,
+                         /*cancellation=*/nullptr, record_progress));
+  ASSERT_GT(progress.size(), 2);
+  EXPECT_LT(progress.front(), 100);
+  EXPECT_EQ(progress.back(), 100);
+  EXPECT_TRUE(std::is_sorted(progress.begin(), progress.end()));
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ReadOnlyTransaction> txn,
+      database_->CreateReadOnlyTransaction(ReadOnlyOptions()));
+  std::unique_ptr<backend::RowCursor> cursor;
+  backend::ReadArg read_arg;
+  read_arg.table = "TestTable";
+  read_arg.index = "TestIndex";
+  read_arg.columns = {"string_col"};
+  read_arg.key_set = KeySet::All();
+  ZETASQL_EXPECT_OK(txn->Read(read_arg, &cursor));
+  int num_entries = 0;
+  while (cursor->Next()) {
+    ++num_entries;
+  }
+  ZETASQL_EXPECT_OK(cursor->Status());
+  EXPECT_EQ(num_entries, kNumRows);
+}
+
+TEST_F(BackfillTest, BackfillUniqueIndexDetectsDuplicatesAcrossChunks) {
+  // The first and last rows fall into different chunks of the backfill but
+  // share the same index key, which is found in the entries written for the
+  // first chunk.
+  InsertRows(/*num_rows=*/50000, /*duplicate=*/true);
+  EXPECT_EQ(UpdateSchema(index_update_statements_),
+            error::UniqueIndexViolationOnIndexCreation(
+                "TestIndex", R"({String("value0")↓})"));
+
+  // The entries written before the violation was found are not left behind.
+  index_update_statements_ = {
+      "CREATE INDEX TestIndex ON TestTable(string_col DESC)"};
+  ZETASQL_EXPECT_OK(UpdateSchema(index_update_statements_));
+}
+
 }  // namespace
 }  // namespace backend
 }  // namespace emulator
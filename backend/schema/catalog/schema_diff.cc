@@ -0,0 +1,97 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/schema/catalog/schema_diff.h"
+
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "backend/schema/catalog/index.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+std::vector<const Table*> SchemaDiff::RemovedTables() const {
+  std::vector<const Table*> removed = dropped_tables;
+  for (const auto& [old_table, new_table] : altered_tables) {
+    removed.push_back(old_table);
+  }
+  return removed;
+}
+
+std::vector<TableID> SchemaDiff::DroppedStorageTableIds() const {
+  std::vector<TableID> table_ids;
+  for (const Table* table : dropped_tables) {
+    table_ids.push_back(table->id());
+    for (const Index* index : table->indexes()) {
+      table_ids.push_back(index->index_data_table()->id());
+    }
+  }
+  // An altered table keeps its ID, but may have lost indexes.
+  for (const auto& [old_table, new_table] : altered_tables) {
+    absl::flat_hash_set<TableID> index_ids;
+    for (const Index* index : new_table->indexes()) {
+      index_ids.insert(index->index_data_table()->id());
+    }
+    for (const Index* index : old_table->indexes()) {
+      if (!index_ids.contains(index->index_data_table()->id())) {
+        table_ids.push_back(index->index_data_table()->id());
+      }
+    }
+  }
+  return table_ids;
+}
+
+SchemaDiff ComputeSchemaDiff(const Schema* old_schema,
+                             const Schema* new_schema) {
+  SchemaDiff diff;
+  absl::flat_hash_map<TableID, const Table*> old_tables;
+  if (old_schema != nullptr) {
+    for (const Table* table : old_schema->tables()) {
+      old_tables[table->id()] = table;
+    }
+  }
+  if (new_schema != nullptr) {
+    for (const Table* table : new_schema->tables()) {
+      auto itr = old_tables.find(table->id());
+      if (itr == old_tables.end()) {
+        diff.added_tables.push_back(table);
+        continue;
+      }
+      if (itr->second != table) {
+        diff.altered_tables.emplace_back(itr->second, table);
+      }
+      old_tables.erase(itr);
+    }
+  }
+  if (old_schema != nullptr && !old_tables.empty()) {
+    for (const Table* table : old_schema->tables()) {
+      if (old_tables.contains(table->id())) {
+        diff.dropped_tables.push_back(table);
+      }
+    }
+  }
+  return diff;
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,80 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_SCHEMA_CATALOG_SCHEMA_DIFF_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_SCHEMA_CATALOG_SCHEMA_DIFF_H_
+
+#include <utility>
+#include <vector>
+
+#include "backend/common/ids.h"
+#include "backend/schema/catalog/schema.h"
+#include "backend/schema/catalog/table.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// SchemaDiff lists the tables which differ between two versions of a schema,
+// so that the structures derived from a schema can be updated for the tables
+// a schema change touched rather than rebuilt for the whole schema.
+//
+// Schema versions share the nodes of the tables a schema change did not touch
+// (see SchemaGraphEditor), so tables are compared by identity: a table of the
+// new schema is unchanged if the same Table object is in the old schema, and
+// altered if a different table with the same ID is. Since the editor clones
+// whole connected components, a table is also reported as altered when a
+// table it is interleaved with or related to by a foreign key is. Changes to
+// the columns, indexes and foreign keys of a table are reported as changes to
+// the table.
+struct SchemaDiff {
+  // Tables of the new schema which are not in the old one.
+  std::vector<const Table*> added_tables;
+
+  // Tables of the old schema which are not in the new one.
+  std::vector<const Table*> dropped_tables;
+
+  // The old and new versions of the tables which may have changed.
+  std::vector<std::pair<const Table*, const Table*>> altered_tables;
+
+  // Returns true if the two schemas have the same tables.
+  bool empty() const {
+    return added_tables.empty() && dropped_tables.empty() &&
+           altered_tables.empty();
+  }
+
+  // Returns the tables of the old schema which are not shared with the new
+  // one: the dropped tables and the old versions of the altered ones.
+  std::vector<const Table*> RemovedTables() const;
+
+  // Returns the IDs of the tables and index data tables of the old schema
+  // whose data is no longer part of the new one.
+  std::vector<TableID> DroppedStorageTableIds() const;
+};
+
+// Returns the tables which differ between `old_schema` and `new_schema`, in
+// the order of the schemas' tables. Either schema may be null, as an empty
+// schema.
+SchemaDiff ComputeSchemaDiff(const Schema* old_schema,
+                             const Schema* new_schema);
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_SCHEMA_CATALOG_SCHEMA_DIFF_H_
@@ -16,7 +16,9 @@
 
 #include "backend/schema/catalog/versioned_catalog.h"
 
+#include <algorithm>
 #include <memory>
+#include <utility>
 
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
@@ -29,37 +31,159 @@ namespace spanner {
 namespace emulator {
 namespace backend {
 
-VersionedCatalog::VersionedCatalog() {
-  schemas_[absl::InfinitePast()] = absl::make_unique<const Schema>();
-}
+namespace {
+
+// Capacity of the first array of schema versions. Arrays double in capacity
+// as schemas are added.
+constexpr size_t kInitialCapacity = 8;
+
+// Counts a reader of the version arrays for the duration of its scope.
+class ScopedReader {
+ public:
+  explicit ScopedReader(std::atomic<int64_t>* num_readers)
+      : num_readers_(num_readers) {
+    num_readers_->fetch_add(1, std::memory_order_seq_cst);
+  }
+  ~ScopedReader() { num_readers_->fetch_sub(1, std::memory_order_release); }
+
+ private:
+  std::atomic<int64_t>* num_readers_;
+};
+
+}  // namespace
+
+VersionedCatalog::VersionedCatalog()
+    : VersionedCatalog(absl::make_unique<const Schema>()) {}
 
 VersionedCatalog::VersionedCatalog(
-    std::unique_ptr<const Schema> initial_schema) {
-  schemas_[absl::InfinitePast()] = std::move(initial_schema);
+    std::shared_ptr<const Schema> initial_schema) {
+  absl::MutexLock lock(&mu_);
+  Publish(absl::make_unique<SchemaVersions>(kInitialCapacity));
+  AppendVersion(absl::InfinitePast(), std::move(initial_schema));
+}
+
+VersionedCatalog::~VersionedCatalog() {
+  delete versions_.load(std::memory_order_relaxed);
 }
 
 const Schema* VersionedCatalog::GetSchema(absl::Time timestamp) const {
-  absl::MutexLock lock(&mu_);
-  auto itr = schemas_.upper_bound(timestamp);
-  itr--;
-  return itr->second.get();
+  ScopedReader reader(&num_readers_);
+  const SchemaVersions* versions = versions_.load(std::memory_order_seq_cst);
+  auto begin = versions->entries.begin();
+  auto end = begin + versions->size.load(std::memory_order_acquire);
+  auto itr = std::upper_bound(
+      begin, end, timestamp,
+      [](absl::Time timestamp, const SchemaVersion& version) {
+        return timestamp < version.creation_time;
+      });
+  if (itr != begin) {
+    itr--;
+  }
+  return itr->schema;
 }
 
 const Schema* VersionedCatalog::GetLatestSchema() const {
-  return GetSchema(absl::InfiniteFuture());
+  ScopedReader reader(&num_readers_);
+  const SchemaVersions* versions = versions_.load(std::memory_order_seq_cst);
+  return versions->entries[versions->size.load(std::memory_order_acquire) - 1]
+      .schema;
+}
+
+std::shared_ptr<const Schema> VersionedCatalog::ShareSchema(
+    absl::Time timestamp) const {
+  // Writers hold `mu_` while they change `schemas_`, which holds the schemas
+  // of the published versions in the same order.
+  absl::MutexLock lock(&mu_);
+  const SchemaVersions* versions = versions_.load(std::memory_order_relaxed);
+  auto begin = versions->entries.begin();
+  auto end = begin + versions->size.load(std::memory_order_relaxed);
+  auto itr = std::upper_bound(
+      begin, end, timestamp,
+      [](absl::Time timestamp, const SchemaVersion& version) {
+        return timestamp < version.creation_time;
+      });
+  if (itr != begin) {
+    itr--;
+  }
+  return schemas_[itr - begin];
 }
 
 absl::Status VersionedCatalog::AddSchema(absl::Time creation_time,
-                                         std::unique_ptr<const Schema> schema) {
+                                         std::shared_ptr<const Schema> schema) {
   absl::MutexLock lock(&mu_);
-  ZETASQL_RET_CHECK(creation_time > schemas_.rbegin()->first)
+  const SchemaVersions* versions = versions_.load(std::memory_order_relaxed);
+  absl::Time latest_creation_time =
+      versions->entries[versions->size.load(std::memory_order_relaxed) - 1]
+          .creation_time;
+  ZETASQL_RET_CHECK(creation_time > latest_creation_time)
       << "Failed to insert schema at " << absl::FormatTime(creation_time)
       << ": the latest schema creation timestamp is "
-      << absl::FormatTime(schemas_.rbegin()->first);
-  schemas_[creation_time] = std::move(schema);
+      << absl::FormatTime(latest_creation_time);
+  AppendVersion(creation_time, std::move(schema));
   return absl::OkStatus();
 }
 
+std::vector<const Schema*> VersionedCatalog::PruneSchemas(absl::Time horizon) {
+  absl::MutexLock lock(&mu_);
+  reclaimable_schemas_ = std::move(retired_schemas_);
+  retired_schemas_.clear();
+
+  const SchemaVersions* versions = versions_.load(std::memory_order_relaxed);
+  size_t size = versions->size.load(std::memory_order_relaxed);
+  size_t num_pruned = 0;
+  while (num_pruned + 1 < size &&
+         versions->entries[num_pruned + 1].creation_time <= horizon) {
+    ++num_pruned;
+  }
+  std::vector<const Schema*> pruned;
+  if (num_pruned == 0) {
+    return pruned;
+  }
+
+  size_t num_remaining = size - num_pruned;
+  auto remaining = absl::make_unique<SchemaVersions>(
+      std::max(kInitialCapacity, 2 * num_remaining));
+  std::copy(versions->entries.begin() + num_pruned,
+            versions->entries.begin() + size, remaining->entries.begin());
+  remaining->size.store(num_remaining, std::memory_order_relaxed);
+  Publish(std::move(remaining));
+
+  for (size_t i = 0; i < num_pruned; ++i) {
+    pruned.push_back(schemas_.front().get());
+    retired_schemas_.push_back(std::move(schemas_.front()));
+    schemas_.pop_front();
+  }
+  return pruned;
+}
+
+void VersionedCatalog::AppendVersion(absl::Time creation_time,
+                                     std::shared_ptr<const Schema> schema) {
+  SchemaVersions* versions = versions_.load(std::memory_order_relaxed);
+  size_t size = versions->size.load(std::memory_order_relaxed);
+  if (size == versions->entries.size()) {
+    auto grown = absl::make_unique<SchemaVersions>(2 * size);
+    std::copy(versions->entries.begin(), versions->entries.end(),
+              grown->entries.begin());
+    grown->size.store(size, std::memory_order_relaxed);
+    versions = grown.get();
+    Publish(std::move(grown));
+  }
+  versions->entries[size] = {creation_time, schema.get()};
+  schemas_.push_back(std::move(schema));
+  versions->size.store(size + 1, std::memory_order_release);
+}
+
+void VersionedCatalog::Publish(std::unique_ptr<SchemaVersions> versions) {
+  SchemaVersions* previous =
+      versions_.exchange(versions.release(), std::memory_order_seq_cst);
+  if (previous != nullptr) {
+    retired_versions_.emplace_back(previous);
+  }
+  if (num_readers_.load(std::memory_order_seq_cst) == 0) {
+    retired_versions_.clear();
+  }
+}
+
 }  // namespace backend
 }  // namespace emulator
 }  // namespace spanner
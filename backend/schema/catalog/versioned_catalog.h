@@ -17,8 +17,11 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_SCHEMA_CATALOG_VERSIONED_CATALOG_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_SCHEMA_CATALOG_VERSIONED_CATALOG_H_
 
-#include <map>
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/synchronization/mutex.h"
@@ -32,6 +35,11 @@ namespace backend {
 
 // VersionedCatalog owns schemas that belongs to a single database, and keep a
 // mapping between the schema creation time and the schema object.
+//
+// Schemas are only ever appended in creation time order, so lookups do not
+// take a lock. They binary search a sorted array of (creation time, schema)
+// entries which is published atomically and only ever grows at its end while
+// it is visible to readers. Writers are serialized by `mu_`.
 class VersionedCatalog {
  public:
   // The default constructor creates an empty schema in the catalog and assigns
@@ -41,40 +49,100 @@ class VersionedCatalog {
   // The single-argument constructor is used when a database is created with an
   // initial schema specified. The initial_schema is added to the catalog and
   // absl::InfinitePast() is assigned as its creation timestamp.
-  explicit VersionedCatalog(std::unique_ptr<const Schema> initial_schema);
+  explicit VersionedCatalog(std::shared_ptr<const Schema> initial_schema);
+
+  ~VersionedCatalog();
+
+  VersionedCatalog(const VersionedCatalog&) = delete;
+  VersionedCatalog& operator=(const VersionedCatalog&) = delete;
 
   // Finds the newest schema that is created at or before a given timestamp and
   // returns a pointer to that schema object. There is always a first schema in
   // each VersionedCatalog, which has a creation timestamp of
   // absl::InfinitePast() (see comments of the constructors above). Therefore,
-  // GetSchema never returns a nullptr.
-  const Schema* GetSchema(absl::Time timestamp) const ABSL_LOCKS_EXCLUDED(mu_);
+  // GetSchema never returns a nullptr. Timestamps older than the oldest schema
+  // retained after PruneSchemas return that oldest schema.
+  const Schema* GetSchema(absl::Time timestamp) const;
 
   // Returns the latest schema object in the catalog. Will return the first
   // schema initialized if there are no subsequent new schema. Therefore,
   // GetLatestSchema never returns a nullptr.
-  const Schema* GetLatestSchema() const ABSL_LOCKS_EXCLUDED(mu_);
+  const Schema* GetLatestSchema() const;
+
+  // Like GetSchema, but shares ownership of the returned schema, so that it
+  // can be added to the catalog of another database and outlive this catalog.
+  std::shared_ptr<const Schema> ShareSchema(absl::Time timestamp) const
+      ABSL_LOCKS_EXCLUDED(mu_);
 
   // Adds a schema at a given timestamp. Returns an error if creation_time is
   // the same or prior to the largest timestamp in all of the schemas. In this
   // case, the new schema will not be added.
   absl::Status AddSchema(absl::Time creation_time,
-                         std::unique_ptr<const Schema> schema)
+                         std::shared_ptr<const Schema> schema)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Removes the schemas which are not visible at any timestamp at or after
+  // `horizon`, i.e. those superseded by a schema created at or before it. The
+  // latest schema is never removed. Returns the removed schemas, which are
+  // kept alive until the call to PruneSchemas after the next one so that
+  // readers which looked them up concurrently can finish using them.
+  std::vector<const Schema*> PruneSchemas(absl::Time horizon)
       ABSL_LOCKS_EXCLUDED(mu_);
 
  private:
-  // For guarding concurrent access to `schemas_`.
+  struct SchemaVersion {
+    absl::Time creation_time;
+    const Schema* schema;
+  };
+
+  // A fixed capacity array of schema versions sorted by creation time. Entries
+  // below `size` are immutable, so readers may search them while a writer
+  // appends past the end.
+  struct SchemaVersions {
+    explicit SchemaVersions(size_t capacity) : entries(capacity) {}
+
+    std::vector<SchemaVersion> entries;
+    std::atomic<size_t> size{0};
+  };
+
+  // Appends a schema to the published versions, moving to an array of twice
+  // the capacity if the current one is full.
+  void AppendVersion(absl::Time creation_time,
+                     std::shared_ptr<const Schema> schema)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Publishes `versions` to readers and retires the previously published
+  // array. Releases the retired arrays if there are no concurrent readers.
+  void Publish(std::unique_ptr<SchemaVersions> versions)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // The array searched by readers. Never null, and never empty since a first
+  // schema is always created in the constructors. Owned by this catalog.
+  std::atomic<SchemaVersions*> versions_{nullptr};
+
+  // For serializing writers.
   mutable absl::Mutex mu_;
 
-  // A mapping between the creation time of each schema in the catalog and the
-  // schema objects. Used to look up schema at a specific point in time. A first
-  // schema is always created in the constructors. Therefore, this map is never
-  // empty.
-  //
-  // Note that this cannot be changed into a hash map (e.g. std::unordered_map)
-  // because the lookup of schemas by creation timestamp depends on the ordering
-  // of keys in this map.
-  std::map<absl::Time, std::unique_ptr<const Schema>> schemas_
+  // The schemas in `versions_`, oldest first. Schemas may be shared with the
+  // catalogs of databases cloned from this one.
+  std::deque<std::shared_ptr<const Schema>> schemas_ ABSL_GUARDED_BY(mu_);
+
+  // Number of readers currently searching a version array. Retired arrays are
+  // released when a writer observes no readers, since readers which start
+  // afterwards can only see the published array.
+  mutable std::atomic<int64_t> num_readers_{0};
+
+  // Version arrays which are no longer published.
+  std::vector<std::unique_ptr<const SchemaVersions>> retired_versions_
+      ABSL_GUARDED_BY(mu_);
+
+  // Pruned schemas may still be in use by readers which looked them up before
+  // they were pruned. They are released by the call to PruneSchemas after the
+  // one which pruned them, so they stay alive for at least one full interval
+  // between two calls.
+  std::vector<std::shared_ptr<const Schema>> retired_schemas_
+      ABSL_GUARDED_BY(mu_);
+  std::vector<std::shared_ptr<const Schema>> reclaimable_schemas_
       ABSL_GUARDED_BY(mu_);
 };
 
@@ -16,6 +16,11 @@
 
 #include "backend/schema/catalog/versioned_catalog.h"
 
+#include <atomic>
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "zetasql/base/testing/status_matchers.h"
@@ -101,6 +106,120 @@ TEST(VersionedCatalogTest, AddSchemaWithSameOrEarlierCreationTime) {
                   testing::MatchesRegex(".*Failed to insert schema.*")));
 }
 
+TEST(VersionedCatalogTest, FindSchemasAcrossArrayGrowth) {
+  VersionedCatalog catalog;
+  absl::Time t0 = absl::Now();
+  std::vector<const Schema*> schemas;
+  for (int i = 0; i < 100; ++i) {
+    ZETASQL_EXPECT_OK(catalog.AddSchema(t0 + absl::Seconds(i),
+                                absl::make_unique<const Schema>()));
+    schemas.push_back(catalog.GetLatestSchema());
+  }
+
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(catalog.GetSchema(t0 + absl::Seconds(i)), schemas[i]);
+    EXPECT_EQ(catalog.GetSchema(t0 + absl::Seconds(i) + absl::Milliseconds(1)),
+              schemas[i]);
+  }
+}
+
+TEST(VersionedCatalogTest, PruneSchemasSupersededBeforeHorizon) {
+  VersionedCatalog catalog;
+  const Schema* initial_schema = catalog.GetLatestSchema();
+  absl::Time t1 = absl::Now();
+  absl::Time t2 = t1 + absl::Seconds(1);
+  ZETASQL_EXPECT_OK(catalog.AddSchema(t1, absl::make_unique<const Schema>()));
+  const Schema* schema_t1 = catalog.GetLatestSchema();
+  ZETASQL_EXPECT_OK(catalog.AddSchema(t2, absl::make_unique<const Schema>()));
+  const Schema* schema_t2 = catalog.GetLatestSchema();
+
+  // The schema created at t1 is still visible to reads between t1 and t2.
+  EXPECT_THAT(catalog.PruneSchemas(t1 + absl::Milliseconds(1)),
+              testing::ElementsAre(initial_schema));
+  EXPECT_EQ(catalog.GetSchema(t1), schema_t1);
+  EXPECT_EQ(catalog.GetSchema(t2), schema_t2);
+
+  // Reads older than the oldest retained schema see the oldest one.
+  EXPECT_EQ(catalog.GetSchema(absl::InfinitePast()), schema_t1);
+
+  // The latest schema is never pruned.
+  EXPECT_THAT(catalog.PruneSchemas(absl::InfiniteFuture()),
+              testing::ElementsAre(schema_t1));
+  EXPECT_EQ(catalog.GetSchema(t1), schema_t2);
+  EXPECT_EQ(catalog.GetLatestSchema(), schema_t2);
+  EXPECT_THAT(catalog.PruneSchemas(absl::InfiniteFuture()),
+              testing::IsEmpty());
+}
+
+TEST(VersionedCatalogTest, AddSchemaAfterPruning) {
+  VersionedCatalog catalog;
+  absl::Time t0 = absl::Now();
+  for (int i = 0; i < 20; ++i) {
+    ZETASQL_EXPECT_OK(catalog.AddSchema(t0 + absl::Seconds(i),
+                                absl::make_unique<const Schema>()));
+  }
+  EXPECT_EQ(catalog.PruneSchemas(t0 + absl::Seconds(10)).size(), 11);
+
+  absl::Time t1 = t0 + absl::Seconds(20);
+  EXPECT_THAT(catalog.AddSchema(t0 + absl::Seconds(19),
+                                absl::make_unique<const Schema>()),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kInternal));
+  ZETASQL_EXPECT_OK(catalog.AddSchema(t1, absl::make_unique<const Schema>()));
+  EXPECT_NE(catalog.GetSchema(t1 - absl::Seconds(1)), catalog.GetSchema(t1));
+  EXPECT_EQ(catalog.GetSchema(t1), catalog.GetLatestSchema());
+}
+
+TEST(VersionedCatalogTest, SharedSchemaOutlivesCatalog) {
+  auto catalog = absl::make_unique<VersionedCatalog>();
+  absl::Time t0 = absl::Now();
+  for (int i = 0; i < 3; ++i) {
+    ZETASQL_EXPECT_OK(catalog->AddSchema(t0 + absl::Seconds(i),
+                                 absl::make_unique<const Schema>()));
+  }
+  EXPECT_EQ(catalog->PruneSchemas(t0 + absl::Seconds(1)).size(), 2);
+
+  // Schemas are found the same way as by GetSchema, after pruning too.
+  EXPECT_EQ(catalog->ShareSchema(t0 + absl::Seconds(1)).get(),
+            catalog->GetSchema(t0 + absl::Seconds(1)));
+  std::shared_ptr<const Schema> schema = catalog->ShareSchema(t0);
+  EXPECT_EQ(schema.get(), catalog->GetSchema(t0));
+
+  VersionedCatalog clone(schema);
+  catalog.reset();
+  EXPECT_EQ(clone.GetLatestSchema(), schema.get());
+  EXPECT_EQ(clone.GetSchema(absl::InfinitePast()), schema.get());
+}
+
+TEST(VersionedCatalogTest, ConcurrentReadsWhileAddingAndPruning) {
+  VersionedCatalog catalog;
+  absl::Time t0 = absl::Now();
+  constexpr int kNumSchemas = 200;
+
+  std::atomic<bool> done{false};
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&]() {
+      while (!done.load()) {
+        EXPECT_NE(catalog.GetSchema(absl::Now()), nullptr);
+        EXPECT_NE(catalog.GetLatestSchema(), nullptr);
+      }
+    });
+  }
+  for (int i = 0; i < kNumSchemas; ++i) {
+    ZETASQL_EXPECT_OK(catalog.AddSchema(t0 + absl::Microseconds(i),
+                                absl::make_unique<const Schema>()));
+    if (i % 10 == 0) {
+      catalog.PruneSchemas(t0 + absl::Microseconds(i));
+    }
+  }
+  done = true;
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(catalog.GetSchema(t0 + absl::Microseconds(kNumSchemas - 1)),
+            catalog.GetLatestSchema());
+}
+
 }  // namespace
 }  // namespace backend
 }  // namespace emulator
@@ -17,8 +17,13 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_SCHEMA_GRAPH_SCHEMA_GRAPH_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_SCHEMA_GRAPH_SCHEMA_GRAPH_H_
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/types/span.h"
 #include "backend/schema/graph/schema_node.h"
 #include "backend/schema/graph/schema_objects_pool.h"
 
@@ -32,10 +37,28 @@ class SchemaGraph {
   SchemaGraph() : pool_(absl::make_unique<SchemaObjectsPool>()) {}
 
   // Constructor for creating a graph from an externally-maintained list of
-  // nodes.
+  // nodes. 'component_ids', if not empty, holds for each node in
+  // 'schema_nodes' the id of the connected component of the graph that the
+  // node belongs to. Component ids must be dense, i.e. in the range
+  // [0, number of components). A graph without component ids is treated as a
+  // single component.
   SchemaGraph(std::vector<const SchemaNode*> schema_nodes,
-              std::unique_ptr<SchemaObjectsPool> pool)
-      : schema_nodes_(std::move(schema_nodes)), pool_(std::move(pool)) {}
+              std::unique_ptr<SchemaObjectsPool> pool,
+              std::vector<int> component_ids = {})
+      : schema_nodes_(std::move(schema_nodes)),
+        component_ids_(std::move(component_ids)),
+        pool_(std::move(pool)) {
+    node_index_.reserve(schema_nodes_.size());
+    for (int i = 0; i < schema_nodes_.size(); ++i) {
+      node_index_[schema_nodes_[i]] = i;
+    }
+    if (component_ids_.size() != schema_nodes_.size()) {
+      component_ids_.assign(schema_nodes_.size(), 0);
+    }
+    for (int component_id : component_ids_) {
+      num_components_ = std::max(num_components_, component_id + 1);
+    }
+  }
 
   // Get a list of all the nodes in the graph in the order in which they were
   // added.
@@ -43,10 +66,32 @@ class SchemaGraph {
     return schema_nodes_;
   }
 
-  // Adds a new node to the graph.
+  // Returns the position of 'node' in GetSchemaNodes() or -1 if the node is
+  // not part of this graph.
+  int IndexOf(const SchemaNode* node) const {
+    auto it = node_index_.find(node);
+    return it == node_index_.end() ? -1 : it->second;
+  }
+
+  // Returns the id of the connected component of the node at position 'index'
+  // in GetSchemaNodes(). Nodes in different components hold no references to
+  // each other.
+  int ComponentOf(int index) const { return component_ids_[index]; }
+
+  // Returns the number of connected components in the graph.
+  int num_components() const { return num_components_; }
+
+  // Returns the pool owning the nodes of this graph.
+  const SchemaObjectsPool* pool() const { return pool_.get(); }
+
+  // Adds a new node to the graph. Nodes added through this method are placed
+  // in the same component as all other nodes of the graph.
   void Add(std::unique_ptr<const SchemaNode> node_ptr) {
     const SchemaNode* node = node_ptr.get();
+    node_index_[node] = schema_nodes_.size();
     schema_nodes_.push_back(node);
+    component_ids_.assign(schema_nodes_.size(), 0);
+    num_components_ = 1;
     pool_->Add(std::move(node_ptr));
   }
 
@@ -54,6 +99,15 @@ class SchemaGraph {
   // List representing the order of the nodes in the graph.
   std::vector<const SchemaNode*> schema_nodes_;
 
+  // Position of each node in 'schema_nodes_'.
+  absl::flat_hash_map<const SchemaNode*, int> node_index_;
+
+  // Component id of each node in 'schema_nodes_'.
+  std::vector<int> component_ids_;
+
+  // Number of distinct ids in 'component_ids_'.
+  int num_components_ = 0;
+
   // Pool for managing the lifetime of the nodes in the graph.
   std::unique_ptr<SchemaObjectsPool> pool_;
 };
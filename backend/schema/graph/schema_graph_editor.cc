@@ -17,6 +17,7 @@
 #include "backend/schema/graph/schema_graph_editor.h"
 
 #include <memory>
+#include <vector>
 
 #include "zetasql/base/logging.h"
 #include "absl/container/flat_hash_map.h"
@@ -42,14 +43,27 @@ SchemaNode* SchemaGraphEditor::MakeNewClone(const SchemaNode* node) {
   return mutable_clone;
 }
 
-absl::Status SchemaGraphEditor::InitCloneMap() {
-  // First, make a clone of the graph.
-  VLOG(2) << "First cloning pass";
-  for (const auto* schema_node : original_graph_->GetSchemaNodes()) {
-    ZETASQL_ASSIGN_OR_RETURN(const auto* cloned_node, Clone(schema_node));
-    new_nodes_.push_back(cloned_node);
+absl::Status SchemaGraphEditor::CloneComponentOf(const SchemaNode* node) {
+  int index = original_graph_->IndexOf(node);
+  ZETASQL_RET_CHECK_GE(index, 0);
+  int component = original_graph_->ComponentOf(index);
+  if (cloned_components_[component]) {
+    return absl::OkStatus();
+  }
+
+  // Mark the component as cloned first so that Clone() clones, rather than
+  // shares, the members of the component reached while cloning.
+  VLOG(2) << "Cloning component " << component;
+  cloned_components_[component] = true;
+  auto orig_nodes = original_graph_->GetSchemaNodes();
+  for (int i = 0; i < orig_nodes.size(); ++i) {
+    if (original_graph_->ComponentOf(i) != component) {
+      continue;
+    }
+    ZETASQL_ASSIGN_OR_RETURN(new_nodes_[i], Clone(orig_nodes[i]));
+    ZETASQL_RET_CHECK_NE(new_nodes_[i], orig_nodes[i]);
+    ++num_cloned_nodes_;
   }
-  ZETASQL_RET_CHECK_EQ(clone_map_.size(), num_original_nodes());
   return absl::OkStatus();
 }
 
@@ -58,7 +72,9 @@ absl::Status SchemaGraphEditor::FixupInternal(const SchemaNode* original,
   VLOG(4) << std::string(depth_, ' ') << "Fixing "
           << NodeKindString(mutable_clone) << " node :" << mutable_clone;
   ++depth_;
+  fixup_stack_.push_back(mutable_clone);
   ZETASQL_RETURN_IF_ERROR(mutable_clone->DeepClone(this, original));
+  fixup_stack_.pop_back();
   --depth_;
   VLOG(4) << std::string(depth_, ' ')
           << "Finished fixing node: " << mutable_clone->DebugString();
@@ -97,6 +113,9 @@ zetasql_base::StatusOr<const SchemaNode*> SchemaGraphEditor::Clone(
     clone_map_[node] = node;
     ZETASQL_RETURN_IF_ERROR(FixupInternal(node, mutable_node));
     ret = node;
+  } else if (kind == kOriginal && !IsInClonedComponent(node)) {
+    // Nodes outside of the cloned components are shared with the new graph.
+    ret = node;
   } else {
     ZETASQL_RET_CHECK_EQ(kind, kOriginal);
     ZETASQL_RET_CHECK(!node->is_deleted());
@@ -109,6 +128,12 @@ zetasql_base::StatusOr<const SchemaNode*> SchemaGraphEditor::Clone(
             << "Finished cloning node: " << node->DebugString();
     ret = mutable_clone;
   }
+
+  // Record the reference held by the node being fixed up so that the
+  // components of the new graph can be computed.
+  if (!fixup_stack_.empty()) {
+    references_.emplace_back(fixup_stack_.back(), ret);
+  }
   return ret;
 }
 
@@ -130,13 +155,71 @@ absl::Status SchemaGraphEditor::AddNode(
   return absl::OkStatus();
 }
 
-bool SchemaGraphEditor::IsOriginalNode(const SchemaNode* node) const {
-  for (const auto* schema_node : original_graph_->GetSchemaNodes()) {
-    if (schema_node == node) {
-      return true;
+absl::Status SchemaGraphEditor::AddSharedNodes() {
+  for (const auto* node : new_nodes_) {
+    if (!IsOriginalNode(node)) {
+      continue;
     }
+    std::shared_ptr<const SchemaNode> shared_node =
+        original_graph_->pool()->Get(node);
+    ZETASQL_RET_CHECK_NE(shared_node, nullptr);
+    cloned_pool_->AddShared(std::move(shared_node));
   }
-  return false;
+  return absl::OkStatus();
+}
+
+std::vector<int> SchemaGraphEditor::ComputeComponentIds() const {
+  absl::flat_hash_map<const SchemaNode*, int> new_index;
+  new_index.reserve(new_nodes_.size());
+  for (int i = 0; i < new_nodes_.size(); ++i) {
+    new_index[new_nodes_[i]] = i;
+  }
+
+  // Union-find over the positions of the nodes in 'new_nodes_'.
+  std::vector<int> parent(new_nodes_.size());
+  for (int i = 0; i < parent.size(); ++i) {
+    parent[i] = i;
+  }
+  auto find = [&parent](int i) {
+    while (parent[i] != i) {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  };
+  auto merge = [&parent, &find](int a, int b) { parent[find(b)] = find(a); };
+
+  // Shared nodes keep the components they had in the original graph.
+  absl::flat_hash_map<int, int> component_members;
+  for (int i = 0; i < new_nodes_.size(); ++i) {
+    int orig_index = original_graph_->IndexOf(new_nodes_[i]);
+    if (orig_index < 0) {
+      continue;
+    }
+    auto inserted = component_members.emplace(
+        original_graph_->ComponentOf(orig_index), i);
+    if (!inserted.second) {
+      merge(inserted.first->second, i);
+    }
+  }
+
+  // Cloned and added nodes are connected through the references discovered
+  // while fixing them up. References to deleted nodes are ignored.
+  for (const auto& reference : references_) {
+    auto from = new_index.find(reference.first);
+    auto to = new_index.find(reference.second);
+    if (from != new_index.end() && to != new_index.end()) {
+      merge(from->second, to->second);
+    }
+  }
+
+  std::vector<int> component_ids(new_nodes_.size());
+  absl::flat_hash_map<int, int> dense_ids;
+  for (int i = 0; i < new_nodes_.size(); ++i) {
+    int next_id = dense_ids.size();
+    component_ids[i] = dense_ids.emplace(find(i), next_id).first->second;
+  }
+  return component_ids;
 }
 
 zetasql_base::StatusOr<std::unique_ptr<SchemaGraph>>
@@ -152,10 +235,12 @@ SchemaGraphEditor::CanonicalizeGraph() {
     VLOG(2) << "Canonicalizing edits and additions";
     ZETASQL_RETURN_IF_ERROR(CanonicalizeEdits());
   }
+  ZETASQL_RETURN_IF_ERROR(AddSharedNodes());
   ZETASQL_RETURN_IF_ERROR(CheckInvariants());
   ZETASQL_RETURN_IF_ERROR(CheckValid());
-  cloned_graph = absl::make_unique<SchemaGraph>(std::move(new_nodes_),
-                                                std::move(cloned_pool_));
+  std::vector<int> component_ids = ComputeComponentIds();
+  cloned_graph = absl::make_unique<SchemaGraph>(
+      std::move(new_nodes_), std::move(cloned_pool_), std::move(component_ids));
   return cloned_graph;
 }
 
@@ -164,33 +249,40 @@ absl::Status SchemaGraphEditor::CheckValid() const {
     // ValidateUpdate was already called on deleted nodes.
     auto orig_nodes = original_graph_->GetSchemaNodes();
     for (int i = 0; i < num_original_nodes(); ++i) {
+      if (new_nodes_[i] == orig_nodes[i]) {
+        continue;
+      }
       ZETASQL_RETURN_IF_ERROR(new_nodes_[i]->ValidateUpdate(orig_nodes[i], context_));
     }
   }
 
   // A final pass on the canonicalized set of nodes to perform per-node
-  // validation.
+  // validation. Shared nodes and everything they reference are unchanged and
+  // were validated when the original graph was built.
   for (const auto* node : new_nodes_) {
+    if (IsOriginalNode(node)) {
+      continue;
+    }
     ZETASQL_RETURN_IF_ERROR(node->Validate(context_));
   }
   return absl::OkStatus();
 }
 
 absl::Status SchemaGraphEditor::CanonicalizeEdits() {
-  if (clone_map_.empty()) {
-    ZETASQL_RETURN_IF_ERROR(InitCloneMap());
-  }
-
   // Run a fixup/cloning pass so that changes from edit nodes in the cloned
-  // graph are propagated to their neighbors.
+  // graph are propagated to their neighbors. Shared nodes do not reference
+  // any cloned node and need no fixup.
   VLOG(2) << "Fixing clones";
-  for (const auto* clone : new_nodes_) {
-    ZETASQL_RETURN_IF_ERROR(Fixup(clone));
+  for (const auto* node : new_nodes_) {
+    if (IsOriginalNode(node)) {
+      continue;
+    }
+    ZETASQL_RETURN_IF_ERROR(Fixup(node));
   }
 
   // No new clones were added.
   ZETASQL_RET_CHECK_EQ(new_nodes_.size(), num_original_nodes());
-  ZETASQL_RET_CHECK_EQ(cloned_pool_->size(), num_original_nodes());
+  ZETASQL_RET_CHECK_EQ(cloned_pool_->size(), num_cloned_nodes_);
 
   VLOG(2) << "Fixing added nodes";
   for (auto& added_node : added_nodes_) {
@@ -199,7 +291,7 @@ absl::Status SchemaGraphEditor::CanonicalizeEdits() {
     cloned_pool_->Add(std::move(added_node));
   }
   ZETASQL_RET_CHECK_EQ(cloned_pool_->size(),
-               num_original_nodes() + added_nodes_.size());
+               num_cloned_nodes_ + added_nodes_.size());
   return absl::OkStatus();
 }
 
@@ -210,9 +302,9 @@ absl::Status SchemaGraphEditor::Fixup(const SchemaNode* node) {
 }
 
 absl::Status SchemaGraphEditor::CanonicalizeDeletion() {
-  if (clone_map_.empty()) {
-    ZETASQL_RETURN_IF_ERROR(InitCloneMap());
-  }
+  // Deletes only cascade through references, so they cannot reach beyond the
+  // component of the deleted node.
+  ZETASQL_RETURN_IF_ERROR(CloneComponentOf(deleted_node_));
 
   // Mark the clone of the node as deleted.
   const SchemaNode* deleted_clone = FindClone(deleted_node_);
@@ -225,11 +317,12 @@ absl::Status SchemaGraphEditor::CanonicalizeDeletion() {
   // graph or until the number of deletions has  converged).
   delete_fixup_ = true;
   int deletions = 1;
-  for (int i = 0; i < num_original_nodes(); ++i) {
+  for (int i = 0; i < num_cloned_nodes_; ++i) {
     int new_deletions = 0;
-    for (const auto* node : original_graph_->GetSchemaNodes()) {
-      const SchemaNode* clone = FindClone(node);
-      ZETASQL_RET_CHECK_NE(clone, nullptr);
+    for (const auto* clone : new_nodes_) {
+      if (IsOriginalNode(clone)) {
+        continue;
+      }
       ZETASQL_RETURN_IF_ERROR(FixupInternal(clone, const_cast<SchemaNode*>(clone)));
       if (clone->is_deleted()) {
         ++new_deletions;
@@ -247,11 +340,13 @@ absl::Status SchemaGraphEditor::CanonicalizeDeletion() {
   }
   delete_fixup_ = false;
 
-  for (const auto* orig_node : original_graph_->GetSchemaNodes()) {
-    auto clone = FindClone(orig_node);
-    ZETASQL_RET_CHECK_NE(clone, nullptr);
+  auto orig_nodes = original_graph_->GetSchemaNodes();
+  for (int i = 0; i < num_original_nodes(); ++i) {
+    if (new_nodes_[i] == orig_nodes[i]) {
+      continue;
+    }
     // Validate the update on cloned/edited nodes.
-    ZETASQL_RETURN_IF_ERROR(clone->ValidateUpdate(orig_node, context_));
+    ZETASQL_RETURN_IF_ERROR(new_nodes_[i]->ValidateUpdate(orig_nodes[i], context_));
   }
 
   // Erase deleted nodes from the new graph.
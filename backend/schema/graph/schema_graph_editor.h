@@ -18,6 +18,8 @@
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_SCHEMA_GRAPH_SCHEMA_GRAPH_EDITOR_H_
 
 #include <algorithm>
+#include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
@@ -48,12 +50,23 @@ namespace backend {
 // the CanonicalizeGraph() method must be called to obtain a new graph with the
 // additions/updates/deletions applied. An instance of SchemaGraphEditor should
 // not be re-used after a call to CanonicalizeGraph().
+//
+// Cloning is copy-on-write at the granularity of the connected components of
+// the original graph: only the components containing edited or deleted nodes
+// are cloned, and the nodes of all other components are shared between the
+// original and the new graph. This is safe because a node only references
+// nodes of its own component, so a shared node never references a node that
+// was cloned. The components of the new graph are computed from the
+// references discovered while fixing up the cloned and added nodes.
 class SchemaGraphEditor {
  public:
   SchemaGraphEditor(const SchemaGraph* original_graph,
                     SchemaValidationContext* context)
       : original_graph_(original_graph),
         context_(context),
+        new_nodes_(original_graph->GetSchemaNodes().begin(),
+                   original_graph->GetSchemaNodes().end()),
+        cloned_components_(original_graph->num_components(), false),
         cloned_pool_(absl::make_unique<SchemaObjectsPool>()) {
     context_->set_added_nodes(&added_nodes_);
   }
@@ -83,10 +96,8 @@ class SchemaGraphEditor {
 
     // Clone the node if it already exists.
     if (IsOriginalNode(node)) {
-      // Create a clone of the schema first.
-      if (clone_map_.empty()) {
-        ZETASQL_RETURN_IF_ERROR(InitCloneMap());
-      }
+      // Create a clone of the component containing the node first.
+      ZETASQL_RETURN_IF_ERROR(CloneComponentOf(node));
 
       // Edit the clone.
       const auto* clone = FindClone(node);
@@ -117,7 +128,8 @@ class SchemaGraphEditor {
 
   // Deep-clones starting from the SchemaNode 'node' in schema graph. Any
   // nodes reachable from 'node' in the schema graph will also be cloned and
-  // owned by the 'cloned_pool_'. As a result this method doesn't guarantee to
+  // owned by the 'cloned_pool_'. Original nodes outside of the cloned
+  // components are returned as-is. As a result this method doesn't guarantee to
   // clone the entire schema graph, only the sub-graph reachable from 'node' and
   // ownership of the cloned sub-graph cannot be released from this class.
   // Callers should not directly call this method.
@@ -211,12 +223,27 @@ class SchemaGraphEditor {
     return original_graph_->GetSchemaNodes().size();
   }
 
-  // Clones the original schema and creates the mapping of
-  // original nodes to clones.
-  absl::Status InitCloneMap();
+  // Clones all the nodes in the component of the original graph that
+  // 'node' belongs to, if not already cloned, and registers the clones in the
+  // mapping of original nodes to clones.
+  absl::Status CloneComponentOf(const SchemaNode* node);
+
+  // Returns true if 'node' is present in the original graph.
+  bool IsOriginalNode(const SchemaNode* node) const {
+    return original_graph_->IndexOf(node) >= 0;
+  }
+
+  // Returns true if the original 'node' belongs to a cloned component.
+  bool IsInClonedComponent(const SchemaNode* node) const {
+    return cloned_components_[original_graph_->ComponentOf(
+        original_graph_->IndexOf(node))];
+  }
 
-  // Returns OK if 'node' is present in the original graph.
-  bool IsOriginalNode(const SchemaNode* node) const;
+  // Adds the original nodes shared with the new graph to 'cloned_pool_'.
+  absl::Status AddSharedNodes();
+
+  // Computes the component ids of 'new_nodes_'.
+  std::vector<int> ComputeComponentIds() const;
 
   // Creates and registers a clone for 'node'.
   SchemaNode* MakeNewClone(const SchemaNode* node);
@@ -262,10 +289,22 @@ class SchemaGraphEditor {
   // If true, the SchemaGraph is being visited in the delete fixup phase.
   bool delete_fixup_ = false;
 
-  // The set of nodes (cloned + newly added) that will constitue
+  // The set of nodes (shared + cloned + newly added) that will constitue
   // the new SchemaGraph.
   std::vector<const SchemaNode*> new_nodes_;
 
+  // Components of the original graph that were cloned.
+  std::vector<bool> cloned_components_;
+
+  // Number of original nodes that were cloned.
+  int num_cloned_nodes_ = 0;
+
+  // Nodes whose references are currently being fixed up.
+  std::vector<const SchemaNode*> fixup_stack_;
+
+  // References between nodes discovered during fixup.
+  std::vector<std::pair<const SchemaNode*, const SchemaNode*>> references_;
+
   // The pool to store cloned schema objects in.
   std::unique_ptr<SchemaObjectsPool> cloned_pool_;
 
@@ -21,7 +21,7 @@
 #include <memory>
 #include <vector>
 
-#include "absl/container/flat_hash_set.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_cat.h"
 #include "backend/schema/graph/schema_node.h"
 
@@ -32,13 +32,32 @@ namespace backend {
 
 // A class for managing the lifetime of all the objects present in a
 // SchemaGraph.
+// SchemaObjectsPool manages the lifetime of the nodes of a SchemaGraph. Nodes
+// are held through shared ownership so that successive versions of a schema
+// can share the nodes that were not modified between them.
 class SchemaObjectsPool {
  public:
   SchemaObjectsPool() {}
 
   // Takes ownership of a 'node'.
   void Add(std::unique_ptr<const SchemaNode> node) {
-    schema_node_pool_.insert(std::move(node));
+    AddShared(std::shared_ptr<const SchemaNode>(std::move(node)));
+  }
+
+  // Shares ownership of a 'node' with other pools.
+  void AddShared(std::shared_ptr<const SchemaNode> node) {
+    const SchemaNode* key = node.get();
+    schema_node_pool_[key] = std::move(node);
+  }
+
+  // Returns the shared handle to 'node', or nullptr if the node is not owned
+  // by this pool.
+  std::shared_ptr<const SchemaNode> Get(const SchemaNode* node) const {
+    auto it = schema_node_pool_.find(node);
+    if (it == schema_node_pool_.end()) {
+      return nullptr;
+    }
+    return it->second;
   }
 
   // Removes the given 'node' from the pool. Returns true if the node
@@ -51,7 +70,7 @@ class SchemaObjectsPool {
   int Trim() {
     int trim_count = 0;
     for (auto it = schema_node_pool_.begin(); it != schema_node_pool_.end();) {
-      if ((*it)->is_deleted()) {
+      if (it->first->is_deleted()) {
         ++trim_count;
         schema_node_pool_.erase(it++);
       } else {
@@ -65,14 +84,15 @@ class SchemaObjectsPool {
 
   std::string DebugString() {
     std::string out;
-    for (const auto& node : schema_node_pool_) {
-      absl::StrAppend(&out, "\n", node->DebugString());
+    for (const auto& entry : schema_node_pool_) {
+      absl::StrAppend(&out, "\n", entry.first->DebugString());
     }
     return out;
   }
 
  private:
-  absl::flat_hash_set<std::unique_ptr<const SchemaNode>> schema_node_pool_;
+  absl::flat_hash_map<const SchemaNode*, std::shared_ptr<const SchemaNode>>
+      schema_node_pool_;
 };
 
 }  // namespace backend
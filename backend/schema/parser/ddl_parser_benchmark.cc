@@ -0,0 +1,150 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Measures the throughput of the DDL parser on a large schema. The schema is
+// either read from --ddl_file, with statements separated by ';', or generated
+// with --tables tables of --columns columns each, every other table
+// interleaved in the previous one and indexed on its first column.
+//
+// Usage: ddl_parser_benchmark [--ddl_file=schema.sql] [--tables=1000]
+//            [--columns=20] [--iterations=5]
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/base/macros.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "backend/schema/parser/ddl_parser.h"
+
+ABSL_FLAG(std::string, ddl_file, "",
+          "File of ';' separated DDL statements to parse instead of a "
+          "generated schema.");
+ABSL_FLAG(int, tables, 1000, "Number of tables in the generated schema.");
+ABSL_FLAG(int, columns, 20, "Number of columns of each generated table.");
+ABSL_FLAG(int, iterations, 5, "Number of times the schema is parsed.");
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+std::vector<std::string> GenerateSchema(int num_tables, int num_columns) {
+  static constexpr absl::string_view kTypes[] = {
+      "INT64", "STRING(MAX)", "BYTES(1024)", "FLOAT64", "BOOL", "DATE",
+      "NUMERIC", "ARRAY<STRING(64)>"};
+  std::vector<std::string> statements;
+  for (int t = 0; t < num_tables; ++t) {
+    const bool interleaved = t % 2 == 1;
+    std::string statement = absl::StrCat("CREATE TABLE Table", t, " (\n");
+    absl::StrAppend(&statement, "  ParentKey INT64 NOT NULL,\n");
+    if (interleaved) {
+      absl::StrAppend(&statement, "  ChildKey STRING(36) NOT NULL,\n");
+    }
+    for (int c = 0; c < num_columns; ++c) {
+      absl::StrAppend(&statement, "  Column", c, " ",
+                      kTypes[c % ABSL_ARRAYSIZE(kTypes)], ",\n");
+    }
+    absl::StrAppend(&statement,
+                    "  UpdatedAt TIMESTAMP OPTIONS "
+                    "(allow_commit_timestamp = true),\n"
+                    ") PRIMARY KEY (ParentKey");
+    if (interleaved) {
+      absl::StrAppend(&statement,
+                      ", ChildKey DESC),\n  INTERLEAVE IN PARENT Table", t - 1,
+                      " ON DELETE CASCADE");
+    } else {
+      absl::StrAppend(&statement, ")");
+    }
+    statements.push_back(std::move(statement));
+    if (interleaved) {
+      statements.push_back(absl::StrCat(
+          "CREATE NULL_FILTERED INDEX Table", t, "ByColumn0 ON Table", t,
+          "(ParentKey, Column0) STORING (Column1), INTERLEAVE IN Table",
+          t - 1));
+    }
+  }
+  return statements;
+}
+
+std::vector<std::string> ReadSchema(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    std::fprintf(stderr, "Failed to open %s\n", path.c_str());
+    return {};
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  std::vector<std::string> statements;
+  for (absl::string_view statement :
+       absl::StrSplit(contents.str(), ';', absl::SkipWhitespace())) {
+    statements.emplace_back(absl::StripAsciiWhitespace(statement));
+  }
+  return statements;
+}
+
+void RunBenchmark() {
+  const std::string ddl_file = absl::GetFlag(FLAGS_ddl_file);
+  const std::vector<std::string> statements =
+      ddl_file.empty() ? GenerateSchema(absl::GetFlag(FLAGS_tables),
+                                        absl::GetFlag(FLAGS_columns))
+                       : ReadSchema(ddl_file);
+  int64_t num_bytes = 0;
+  for (const std::string& statement : statements) {
+    num_bytes += statement.size();
+  }
+  std::printf("%zu statements, %.2f MB\n", statements.size(),
+              num_bytes / 1e6);
+
+  std::printf("%10s %12s %16s %12s\n", "iteration", "seconds",
+              "statements/s", "MB/s");
+  for (int i = 0; i < absl::GetFlag(FLAGS_iterations); ++i) {
+    const absl::Time start = absl::Now();
+    for (const std::string& statement : statements) {
+      auto parsed = ddl::ParseDDLStatement(statement);
+      if (!parsed.ok()) {
+        std::fprintf(stderr, "%s\n", parsed.status().ToString().c_str());
+        return;
+      }
+    }
+    const double seconds = absl::ToDoubleSeconds(absl::Now() - start);
+    std::printf("%10d %12.3f %16.0f %12.2f\n", i, seconds,
+                statements.size() / seconds, num_bytes / 1e6 / seconds);
+  }
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  google::spanner::emulator::backend::RunBenchmark();
+  return 0;
+}
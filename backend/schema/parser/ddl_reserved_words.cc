@@ -16,8 +16,6 @@
 
 #include "backend/schema/parser/ddl_reserved_words.h"
 
-#include <string>
-
 #include "backend/common/case.h"
 
 namespace google {
@@ -141,7 +139,7 @@ static const CaseInsensitiveStringSet* const pseudo_reserved_words =
 }  // namespace
 
 bool IsReservedWord(absl::string_view reserved_word) {
-  return reserved_words->contains(std::string(reserved_word));
+  return reserved_words->contains(reserved_word);
 }
 
 const CaseInsensitiveStringSet& GetReservedWords() { return *reserved_words; }
@@ -20,6 +20,7 @@
 #include "backend/schema/parser/Token.h"
 #include "backend/schema/parser/ddl_token_validation_utils.h"
 #include "zetasql/public/strings.h"
+#include "absl/strings/ascii.h"
 #include "absl/status/status.h"
 
 namespace google {
@@ -28,8 +29,27 @@ namespace emulator {
 namespace backend {
 namespace ddl {
 
+namespace {
+
+// Returns true if the literal image has no escape sequences and only printable
+// ASCII characters or newlines, in which case unescaping it cannot fail. Most
+// literals in schema files are like that, so the lexer can skip unescaping them
+// into a string only to discard it.
+bool IsPlainLiteralImage(const std::string& image) {
+  for (char c : image) {
+    if (c == '\\' || (!absl::ascii_isprint(c) && c != '\n')) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
 
 void ValidateBytesLiteral(Token* token) {
+  if (IsPlainLiteralImage(token->image)) {
+    return;
+  }
   std::string unused_error;
   absl::Status status = ValidateBytesLiteralImage(token->image, &unused_error);
   if (!status.ok()) {
@@ -39,6 +59,9 @@ void ValidateBytesLiteral(Token* token) {
 }
 
 void ValidateStringLiteral(Token* token, bool unused) {
+  if (IsPlainLiteralImage(token->image)) {
+    return;
+  }
   std::string unused_error;
   absl::Status status =
       ValidateStringLiteralImage(token->image, /*force=*/true, &unused_error);
@@ -16,7 +16,9 @@
 
 #include "backend/schema/printer/print_ddl.h"
 
+#include <iterator>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "absl/strings/str_cat.h"
@@ -183,23 +185,32 @@ std::string PrintForeignKey(const ForeignKey* foreign_key) {
   return out;
 }
 
+std::vector<std::string> PrintTableAndIndexes(const Table* table) {
+  std::vector<std::string> statements;
+  statements.push_back(PrintTable(table));
+  // Print indexes (sorted by name).
+  std::vector<const Index*> indexes{table->indexes().begin(),
+                                    table->indexes().end()};
+  std::sort(indexes.begin(), indexes.end(),
+            [](const Index* i1, const Index* i2) {
+              return i1->Name() < i2->Name();
+            });
+  for (auto index : indexes) {
+    if (!index->is_managed()) {
+      statements.push_back(PrintIndex(index));
+    }
+  }
+  return statements;
+}
+
 std::vector<std::string> PrintDDLStatements(const Schema* schema) {
   std::vector<std::string> statements;
   // Print tables
   for (auto table : schema->tables()) {
-    statements.push_back(PrintTable(table));
-    // Print indexes (sorted by name).
-    std::vector<const Index*> indexes{table->indexes().begin(),
-                                      table->indexes().end()};
-    std::sort(indexes.begin(), indexes.end(),
-              [](const Index* i1, const Index* i2) {
-                return i1->Name() < i2->Name();
-              });
-    for (auto index : indexes) {
-      if (!index->is_managed()) {
-        statements.push_back(PrintIndex(index));
-      }
-    }
+    std::vector<std::string> table_statements = PrintTableAndIndexes(table);
+    statements.insert(statements.end(),
+                      std::make_move_iterator(table_statements.begin()),
+                      std::make_move_iterator(table_statements.end()));
   }
   return statements;
 }
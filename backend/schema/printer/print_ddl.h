@@ -53,6 +53,10 @@ std::string OnDeleteActionToString(Table::OnDeleteAction action);
 std::string ColumnTypeToString(const zetasql::Type* type,
                                absl::optional<int64_t> max_length);
 
+// Prints the DDL statements for a table followed by those for its indexes,
+// which are the statements PrintDDLStatements prints for the table.
+std::vector<std::string> PrintTableAndIndexes(const Table* table);
+
 // Prints the DDL statements for all tables and indexes within the given schema.
 std::vector<std::string> PrintDDLStatements(const Schema* schema);
 
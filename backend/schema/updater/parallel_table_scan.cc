@@ -0,0 +1,76 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/schema/updater/parallel_table_scan.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "backend/storage/parallel_scan.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// Maximum number of threads scanning the rows of a table.
+constexpr int kMaxScanThreads = 8;
+
+// Maximum number of ranges a table is split into. There are more ranges than
+// threads, so that a thread done with its range picks up another one.
+constexpr int kMaxScanRanges = 4 * kMaxScanThreads;
+
+// Minimum number of rows in each range of a table.
+constexpr int64_t kMinRowsPerScanRange = 4 * 1024;
+
+// Maximum number of chunks a table is split into. Chunks of larger tables
+// have more rows than requested.
+constexpr int kMaxChunks = 1024;
+
+}  // namespace
+
+zetasql_base::StatusOr<std::vector<KeyRange>> SplitTableKeySpace(
+    const Table* table, const SchemaValidationContext* context) {
+  return SplitTableKeyRange(table, KeyRange::All(), context);
+}
+
+zetasql_base::StatusOr<std::vector<KeyRange>> SplitTableKeyRange(
+    const Table* table, const KeyRange& key_range,
+    const SchemaValidationContext* context) {
+  return SplitKeyRangeForScan(context->storage(), table->id(), key_range,
+                              kMaxScanRanges, kMinRowsPerScanRange);
+}
+
+zetasql_base::StatusOr<std::vector<KeyRange>> SplitTableIntoChunks(
+    const Table* table, int64_t min_rows_per_chunk,
+    const SchemaValidationContext* context) {
+  return SplitKeyRangeForScan(context->storage(), table->id(),
+                              KeyRange::All(), kMaxChunks, min_rows_per_chunk);
+}
+
+absl::Status ForEachRangeInParallel(
+    int num_ranges, const std::function<absl::Status(int)>& fn) {
+  return ForEachInParallel(num_ranges, kMaxScanThreads, fn);
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
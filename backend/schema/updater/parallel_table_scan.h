@@ -0,0 +1,67 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_SCHEMA_UPDATER_PARALLEL_TABLE_SCAN_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_SCHEMA_UPDATER_PARALLEL_TABLE_SCAN_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "zetasql/base/statusor.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/schema/catalog/table.h"
+#include "backend/schema/updater/schema_validation_context.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// Splits the key space of `table` into consecutive closed-open ranges of about
+// the same number of rows, so that verifications and backfills of its rows can
+// scan them in parallel. Small tables are not split.
+zetasql_base::StatusOr<std::vector<KeyRange>> SplitTableKeySpace(
+    const Table* table, const SchemaValidationContext* context);
+
+// Like SplitTableKeySpace, but splits `key_range` of `table` only.
+zetasql_base::StatusOr<std::vector<KeyRange>> SplitTableKeyRange(
+    const Table* table, const KeyRange& key_range,
+    const SchemaValidationContext* context);
+
+// Splits the key space of `table` into consecutive closed-open chunks of at
+// least `min_rows_per_chunk` rows, for backfills which process a large table a
+// chunk at a time to bound their memory use. Each chunk can then be split with
+// SplitTableKeyRange to be scanned in parallel.
+zetasql_base::StatusOr<std::vector<KeyRange>> SplitTableIntoChunks(
+    const Table* table, int64_t min_rows_per_chunk,
+    const SchemaValidationContext* context);
+
+// Calls `fn` with each index in [0, num_ranges), on a pool of worker threads if
+// there is more than one, and returns the error of the lowest failing index, as
+// a sequential scan of the ranges would. Indexes above a failing one are not
+// scanned once its failure is known.
+absl::Status ForEachRangeInParallel(int num_ranges,
+                                    const std::function<absl::Status(int)>& fn);
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_SCHEMA_UPDATER_PARALLEL_TABLE_SCAN_H_
@@ -43,6 +43,7 @@
 #include "backend/schema/builders/table_builder.h"
 #include "backend/schema/catalog/column.h"
 #include "backend/schema/catalog/index.h"
+#include "backend/schema/catalog/schema_diff.h"
 #include "backend/schema/catalog/table.h"
 #include "backend/schema/ddl/operations.pb.h"
 #include "backend/schema/graph/schema_graph.h"
@@ -105,6 +106,13 @@ class SchemaUpdaterImpl {
   zetasql_base::StatusOr<std::vector<SchemaValidationContext>> ApplyDDLStatements(
       absl::Span<const std::string> statements);
 
+  // Applies DDL statements without retaining the schema change actions or the
+  // intermediate schema snapshots of the individual statements. Each
+  // snapshot is released as soon as the next statement has been applied to
+  // it. Returns the schema resulting from the last statement.
+  zetasql_base::StatusOr<std::unique_ptr<const Schema>> ApplyDDLStatementsInBatch(
+      absl::Span<const std::string> statements);
+
   std::vector<std::unique_ptr<const Schema>> GetIntermediateSchemas() {
     return std::move(intermediate_schemas_);
   }
@@ -125,9 +133,15 @@ class SchemaUpdaterImpl {
   // Initializes potentially failing components after construction.
   absl::Status Init();
 
-  // Applies the given `statement` on to `latest_schema_`.
+  // Parses `statements` into `ddl_statements`, stopping at the first
+  // statement that fails to parse and returning its error.
+  absl::Status ParseDDLStatements(
+      absl::Span<const std::string> statements,
+      std::vector<ddl::DDLStatement>* ddl_statements);
+
+  // Applies the given `ddl_statement` on to `latest_schema_`.
   zetasql_base::StatusOr<std::unique_ptr<const Schema>> ApplyDDLStatement(
-      absl::string_view statement);
+      const ddl::DDLStatement& ddl_statement);
 
   // Run any pending schema actions resulting from the schema change statements.
   absl::Status RunPendingActions(
@@ -302,16 +316,25 @@ absl::Status SchemaUpdaterImpl::DropNode(const SchemaNode* node) {
   return absl::OkStatus();
 }
 
-zetasql_base::StatusOr<std::unique_ptr<const Schema>>
-SchemaUpdaterImpl::ApplyDDLStatement(absl::string_view statement) {
-  if (statement.empty()) {
-    return error::EmptyDDLStatement();
+absl::Status SchemaUpdaterImpl::ParseDDLStatements(
+    absl::Span<const std::string> statements,
+    std::vector<ddl::DDLStatement>* ddl_statements) {
+  ddl_statements->reserve(statements.size());
+  for (const auto& statement : statements) {
+    if (statement.empty()) {
+      return error::EmptyDDLStatement();
+    }
+    ZETASQL_ASSIGN_OR_RETURN(ddl::DDLStatement ddl_statement,
+                     ddl::ParseDDLStatement(statement));
+    ddl_statements->push_back(std::move(ddl_statement));
   }
+  return absl::OkStatus();
+}
 
+zetasql_base::StatusOr<std::unique_ptr<const Schema>>
+SchemaUpdaterImpl::ApplyDDLStatement(const ddl::DDLStatement& ddl_statement) {
   // Apply the statement to the schema graph.
   ZETASQL_RET_CHECK(!editor_->HasModifications());
-  ZETASQL_ASSIGN_OR_RETURN(const auto& ddl_statement,
-                   ddl::ParseDDLStatement(statement));
 
   switch (ddl_statement.kind_case()) {
     case ddl::DDLStatement::kCreateTable: {
@@ -345,10 +368,16 @@ SchemaUpdaterImpl::ApplyDDLStatement(absl::string_view statement) {
 zetasql_base::StatusOr<std::vector<SchemaValidationContext>>
 SchemaUpdaterImpl::ApplyDDLStatements(
     absl::Span<const std::string> statements) {
-  std::vector<SchemaValidationContext> pending_work;
+  // All statements are parsed before any of them is applied. A parse error is
+  // only reported after the statements preceding the one that failed to parse
+  // have been applied, so that the error of the first failing statement is
+  // returned.
+  std::vector<ddl::DDLStatement> ddl_statements;
+  absl::Status parse_status = ParseDDLStatements(statements, &ddl_statements);
 
-  for (const auto& statement : statements) {
-    VLOG(2) << "Applying statement " << statement;
+  std::vector<SchemaValidationContext> pending_work;
+  for (const auto& ddl_statement : ddl_statements) {
+    VLOG(2) << "Applying statement " << ddl_statement.DebugString();
     SchemaValidationContext statement_context{storage_, &global_names_,
                                               schema_change_timestamp_};
     statement_context_ = &statement_context;
@@ -356,7 +385,7 @@ SchemaUpdaterImpl::ApplyDDLStatements(
         latest_schema_->GetSchemaGraph(), statement_context_);
 
     // If there is a semantic validation error, then we return right away.
-    ZETASQL_ASSIGN_OR_RETURN(auto new_schema, ApplyDDLStatement(statement));
+    ZETASQL_ASSIGN_OR_RETURN(auto new_schema, ApplyDDLStatement(ddl_statement));
 
     // We save every schema snapshot as verifiers/backfillers from the
     // current/next statement may need to refer to the previous/current
@@ -371,10 +400,44 @@ SchemaUpdaterImpl::ApplyDDLStatements(
     // work.
     pending_work.emplace_back(std::move(statement_context));
   }
+  editor_ = nullptr;
+  statement_context_ = nullptr;
+  ZETASQL_RETURN_IF_ERROR(parse_status);
 
   return pending_work;
 }
 
+zetasql_base::StatusOr<std::unique_ptr<const Schema>>
+SchemaUpdaterImpl::ApplyDDLStatementsInBatch(
+    absl::Span<const std::string> statements) {
+  std::vector<ddl::DDLStatement> ddl_statements;
+  absl::Status parse_status = ParseDDLStatements(statements, &ddl_statements);
+
+  std::unique_ptr<const Schema> last_schema = nullptr;
+  for (const auto& ddl_statement : ddl_statements) {
+    VLOG(2) << "Applying statement " << ddl_statement.DebugString();
+    SchemaValidationContext statement_context{storage_, &global_names_,
+                                              schema_change_timestamp_};
+    statement_context_ = &statement_context;
+    editor_ = absl::make_unique<SchemaGraphEditor>(
+        latest_schema_->GetSchemaGraph(), statement_context_);
+
+    ZETASQL_ASSIGN_OR_RETURN(auto new_schema, ApplyDDLStatement(ddl_statement));
+
+    // The editor refers to the previous snapshot, so it must go first. The
+    // previous snapshot can then be released since no schema change actions
+    // will refer to it, and the nodes it shares with the new snapshot are
+    // kept alive by the new snapshot.
+    editor_ = nullptr;
+    statement_context_ = nullptr;
+    latest_schema_ = new_schema.get();
+    last_schema = std::move(new_schema);
+  }
+  ZETASQL_RETURN_IF_ERROR(parse_status);
+
+  return last_schema;
+}
+
 template <typename ColumnModifier>
 absl::Status SchemaUpdaterImpl::SetColumnOptions(const ddl::Options& options,
                                                  ColumnModifier* modifier) {
@@ -473,8 +536,7 @@ absl::Status SchemaUpdaterImpl::AnalyzeColumnExpression(
         options.AddExpressionColumn(name_and_type.first, name_and_type.second));
   }
   std::unique_ptr<const zetasql::AnalyzerOutput> output;
-  FunctionCatalog function_catalog(type_factory_);
-  Catalog catalog(latest_schema_, &function_catalog);
+  Catalog catalog(latest_schema_, FunctionCatalog::Shared());
   ZETASQL_RETURN_IF_ERROR(zetasql::AnalyzeExpressionForAssignmentToType(
       expression, options, &catalog, type_factory_, column_type, &output));
 
@@ -1322,23 +1384,26 @@ SchemaUpdater::ValidateSchemaFromDDL(absl::Span<const std::string> statements,
                        context.type_factory, context.table_id_generator,
                        context.column_id_generator, context.storage,
                        context.schema_change_timestamp, existing_schema));
-  ZETASQL_ASSIGN_OR_RETURN(pending_work_, updater.ApplyDDLStatements(statements));
-  intermediate_schemas_ = updater.GetIntermediateSchemas();
-
-  std::unique_ptr<const Schema> new_schema = nullptr;
-  if (!intermediate_schemas_.empty()) {
-    new_schema = std::move(*intermediate_schemas_.rbegin());
-  }
-  pending_work_.clear();
-  intermediate_schemas_.clear();
-  return new_schema;
+  return updater.ApplyDDLStatementsInBatch(statements);
 }
 
 // TODO : These should run in a ReadWriteTransaction with rollback
 // capability so that changes to the database can be reversed.
-absl::Status SchemaUpdater::RunPendingActions(int* num_succesful) {
-  for (const auto& pending_statement : pending_work_) {
+absl::Status SchemaUpdater::RunPendingActions(
+    const CancellationToken* cancellation,
+    const SchemaChangeProgressFn& progress, int* num_succesful) {
+  for (auto& pending_statement : pending_work_) {
+    const int statement_index = *num_succesful;
+    pending_statement.set_cancellation(cancellation);
+    if (progress != nullptr) {
+      pending_statement.set_progress([&progress, statement_index](int percent) {
+        progress(statement_index, percent);
+      });
+    }
     ZETASQL_RETURN_IF_ERROR(pending_statement.RunSchemaChangeActions());
+    if (progress != nullptr) {
+      progress(statement_index, 100);
+    }
     ++(*num_succesful);
   }
   return absl::OkStatus();
@@ -1354,19 +1419,29 @@ zetasql_base::StatusOr<SchemaChangeResult> SchemaUpdater::UpdateSchemaFromDDL(
                        context.schema_change_timestamp, existing_schema));
   ZETASQL_ASSIGN_OR_RETURN(pending_work_, updater.ApplyDDLStatements(statements));
   intermediate_schemas_ = updater.GetIntermediateSchemas();
+  for (const std::unique_ptr<const Schema>& schema : intermediate_schemas_) {
+    ZETASQL_RETURN_IF_ERROR(
+        InterleaveTablesInStorage(schema.get(), context.storage));
+  }
 
   // Use the schema snapshot for the last succesful statement.
   int num_successful = 0;
   std::unique_ptr<const Schema> new_schema = nullptr;
 
-  absl::Status backfill_status = RunPendingActions(&num_successful);
+  absl::Status backfill_status = RunPendingActions(
+      context.cancellation, context.progress, &num_successful);
   if (num_successful > 0) {
     new_schema = std::move(intermediate_schemas_[num_successful - 1]);
   }
   ZETASQL_RET_CHECK_LE(num_successful, intermediate_schemas_.size());
+  SchemaDiff schema_diff;
+  if (new_schema != nullptr) {
+    schema_diff = ComputeSchemaDiff(existing_schema, new_schema.get());
+  }
   return SchemaChangeResult{
       .num_successful_statements = num_successful,
       .updated_schema = std::move(new_schema),
+      .schema_diff = std::move(schema_diff),
       .backfill_status = backfill_status,
   };
 }
@@ -1374,10 +1449,33 @@ zetasql_base::StatusOr<SchemaChangeResult> SchemaUpdater::UpdateSchemaFromDDL(
 zetasql_base::StatusOr<std::unique_ptr<const Schema>>
 SchemaUpdater::CreateSchemaFromDDL(absl::Span<const std::string> statements,
                                    const SchemaChangeContext& context) {
-  ZETASQL_ASSIGN_OR_RETURN(SchemaChangeResult result,
-                   UpdateSchemaFromDDL(EmptySchema(), statements, context));
-  ZETASQL_RETURN_IF_ERROR(result.backfill_status);
-  return std::move(result.updated_schema);
+  // A new database does not contain any data, so there is nothing for the
+  // backfill and verification actions of the statements to process.
+  ZETASQL_ASSIGN_OR_RETURN(SchemaUpdaterImpl updater,
+                   SchemaUpdaterImpl::Build(
+                       context.type_factory, context.table_id_generator,
+                       context.column_id_generator, context.storage,
+                       context.schema_change_timestamp, EmptySchema()));
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<const Schema> schema,
+                   updater.ApplyDDLStatementsInBatch(statements));
+  ZETASQL_RETURN_IF_ERROR(
+      InterleaveTablesInStorage(schema.get(), context.storage));
+  return schema;
+}
+
+absl::Status InterleaveTablesInStorage(const Schema* schema, Storage* storage) {
+  if (storage == nullptr) {
+    return absl::OkStatus();
+  }
+  // Tables are listed after their parents.
+  for (const Table* table : schema->tables()) {
+    if (table->parent() != nullptr) {
+      ZETASQL_RETURN_IF_ERROR(storage->InterleaveTable(
+          table->id(), table->parent()->id(), table->primary_key().size(),
+          table->parent()->primary_key().size()));
+    }
+  }
+  return absl::OkStatus();
 }
 
 }  // namespace backend
@@ -17,6 +17,7 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_SCHEMA_UPDATER_SCHEMA_UPDATER_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_SCHEMA_UPDATER_SCHEMA_UPDATER_H_
 
+#include <functional>
 #include <memory>
 
 #include "zetasql/public/type.h"
@@ -25,6 +26,9 @@
 #include "absl/types/span.h"
 #include "backend/common/ids.h"
 #include "backend/schema/catalog/schema.h"
+#include "backend/schema/catalog/schema_diff.h"
+#include "backend/storage/storage.h"
+#include "common/cancellation.h"
 #include "absl/status/status.h"
 #include "zetasql/base/status_macros.h"
 
@@ -35,6 +39,11 @@ namespace backend {
 
 static constexpr char kIndexDataTablePrefix[] = "_index_data_table_";
 
+// Receives the progress of the backfills and verifications of the statement at
+// `statement_index` of a schema change, as a percentage.
+using SchemaChangeProgressFn =
+    std::function<void(int statement_index, int progress_percent)>;
+
 // Database context within which a schema change is processed.
 struct SchemaChangeContext {
   // Type factory for the database.
@@ -52,6 +61,14 @@ struct SchemaChangeContext {
   // The timestamp at which the schema changes/validations/backfills
   // should be done.
   absl::Time schema_change_timestamp;
+
+  // Cancellation of the schema change, checked by its backfills and
+  // verifications, if not null.
+  const CancellationToken* cancellation = nullptr;
+
+  // Receives the progress of the schema change's actions, if not null. Each
+  // statement reports 100 once its actions are done.
+  SchemaChangeProgressFn progress = nullptr;
 };
 
 // The result of processing a set of DDL statements for a schema change request.
@@ -63,6 +80,10 @@ struct SchemaChangeResult {
   // DDL statement.
   std::unique_ptr<const Schema> updated_schema;
 
+  // The tables which differ between the existing schema and
+  // `updated_schema`. Empty if `updated_schema` is null.
+  SchemaDiff schema_diff;
+
   // The error encounterd while processing the first backfill/verifier action
   // that failed. absl::OkStatus() if all schema actions successfully applied.
   absl::Status backfill_status;
@@ -73,10 +94,10 @@ class SchemaUpdater {
   SchemaUpdater() = default;
 
   // Creates a new Schema from `statements` or returns the error encountered
-  // while applying the first invalid statement. Also runs any backfill or
-  // data-dependent verification tasks resulting from the new schema such as
-  // creation of a new index. However, since the database will not contain any
-  // data at this point, none of the backfill tasks are expected to fail.
+  // while applying the first invalid statement. Since the database will not
+  // contain any data at this point, the statements are applied in a single
+  // batch that skips the backfill and data-dependent verification tasks
+  // resulting from the new schema, such as the creation of a new index.
   zetasql_base::StatusOr<std::unique_ptr<const Schema>> CreateSchemaFromDDL(
       absl::Span<const std::string> statements,
       const SchemaChangeContext& context);
@@ -97,7 +118,8 @@ class SchemaUpdater {
 
   // Validates the given set DDL statements, producing a new schema with the
   // DDL statements applied. Does not run any backfill/verification tasks
-  // entailed by `statements`.
+  // entailed by `statements`, and does not retain the schema snapshots of the
+  // individual statements.
   zetasql_base::StatusOr<std::unique_ptr<const Schema>> ValidateSchemaFromDDL(
       absl::Span<const std::string> statements,
       const SchemaChangeContext& context,
@@ -106,13 +128,21 @@ class SchemaUpdater {
  private:
   static const Schema* EmptySchema();
 
-  absl::Status RunPendingActions(int* num_succesful);
+  absl::Status RunPendingActions(const CancellationToken* cancellation,
+                                 const SchemaChangeProgressFn& progress,
+                                 int* num_succesful);
 
   std::vector<SchemaValidationContext> pending_work_;
 
   std::vector<std::unique_ptr<const Schema>> intermediate_schemas_;
 };
 
+// Declares the interleaving of the tables of `schema` to `storage`, see
+// Storage::InterleaveTable. Called before rows are written to new tables, for
+// storages which co-locate interleaved tables. Does nothing if `storage` is
+// nullptr.
+absl::Status InterleaveTablesInStorage(const Schema* schema, Storage* storage);
+
 }  // namespace backend
 }  // namespace emulator
 }  // namespace spanner
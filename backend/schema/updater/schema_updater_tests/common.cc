@@ -16,6 +16,8 @@
 
 #include "backend/schema/updater/schema_updater_tests/base.h"
 
+#include "backend/schema/catalog/schema_diff.h"
+
 namespace google {
 namespace spanner {
 namespace emulator {
@@ -106,6 +108,68 @@ TEST_F(SchemaUpdaterTest, CreationOrder) {
               testing::ElementsAreArray(expected));
 }
 
+TEST_F(SchemaUpdaterTest, ReportsErrorOfFirstFailingStatement) {
+  // The second statement fails validation before the third one fails to
+  // parse.
+  EXPECT_THAT(CreateSchema({R"(
+      CREATE TABLE T (
+        k1 INT64,
+      ) PRIMARY KEY (k1)
+    )",
+                            R"(
+      CREATE TABLE T (
+        k1 INT64,
+      ) PRIMARY KEY (k1)
+    )",
+                            "CREATE TABLE"}),
+              StatusIs(error::SchemaObjectAlreadyExists("Table", "T")));
+
+  // A parse error is reported after the preceding statements are applied.
+  EXPECT_EQ(CreateSchema({R"(
+      CREATE TABLE T (
+        k1 INT64,
+      ) PRIMARY KEY (k1)
+    )",
+                          "CREATE TABLE"})
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST_F(SchemaUpdaterTest, DiffListsTheTablesTheChangeTouched) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      auto old_schema,
+      CreateSchema({"CREATE TABLE T1 (k INT64, v INT64) PRIMARY KEY (k)",
+                    "CREATE INDEX T1ByV ON T1(v)",
+                    "CREATE TABLE T2 (k INT64) PRIMARY KEY (k)",
+                    "CREATE TABLE T3 (k INT64) PRIMARY KEY (k)"}));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      auto new_schema,
+      UpdateSchema(old_schema.get(),
+                   {"DROP INDEX T1ByV", "DROP TABLE T3",
+                    "CREATE TABLE T4 (k INT64) PRIMARY KEY (k)"}));
+
+  const Table* old_t1 = old_schema->FindTable("T1");
+  const Table* old_t3 = old_schema->FindTable("T3");
+  SchemaDiff diff = ComputeSchemaDiff(old_schema.get(), new_schema.get());
+  EXPECT_THAT(diff.added_tables,
+              testing::ElementsAre(new_schema->FindTable("T4")));
+  EXPECT_THAT(diff.dropped_tables, testing::ElementsAre(old_t3));
+  EXPECT_THAT(diff.altered_tables,
+              testing::ElementsAre(
+                  testing::Pair(old_t1, new_schema->FindTable("T1"))));
+  EXPECT_THAT(diff.RemovedTables(),
+              testing::UnorderedElementsAre(old_t1, old_t3));
+  EXPECT_THAT(diff.DroppedStorageTableIds(),
+              testing::UnorderedElementsAre(
+                  old_t3->id(),
+                  old_t1->FindIndex("T1ByV")->index_data_table()->id()));
+
+  // The table the change did not touch is shared by both schemas.
+  EXPECT_EQ(new_schema->FindTable("T2"), old_schema->FindTable("T2"));
+  EXPECT_TRUE(ComputeSchemaDiff(new_schema.get(), new_schema.get()).empty());
+}
+
 }  // namespace
 
 }  // namespace test
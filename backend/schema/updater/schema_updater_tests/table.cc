@@ -724,9 +724,58 @@ TEST_F(SchemaUpdaterTest, DropTable) {
   EXPECT_EQ(t1, nullptr);
   EXPECT_EQ(new_schema->GetSchemaGraph()->GetSchemaNodes().size(), 4);
 
-  // The other table is still there.
+  // The other table is still there and shared with the original schema.
   auto t2 = new_schema->FindTable("T2");
   EXPECT_NE(t2, nullptr);
+  EXPECT_EQ(t2, schema->FindTable("T2"));
+}
+
+TEST_F(SchemaUpdaterTest, AlterTableOnlyClonesRelatedTables) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto schema, CreateSchema({R"(
+      CREATE TABLE T1 (
+        k1 INT64,
+        c1 STRING(10),
+      ) PRIMARY KEY (k1)
+    )",
+                                                  R"(
+      CREATE TABLE T2 (
+        k1 INT64,
+        k2 INT64,
+      ) PRIMARY KEY (k1, k2),
+      INTERLEAVE IN PARENT T1
+    )",
+                                                  R"(
+      CREATE TABLE T3 (
+        k3 INT64,
+        c3 STRING(MAX),
+      ) PRIMARY KEY (k3)
+    )"}));
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(auto new_schema, UpdateSchema(schema.get(), {R"(
+      ALTER TABLE T2 ADD COLUMN c2 INT64
+    )"}));
+
+  // The edited table and the tables related to it are cloned.
+  const Table* t1 = new_schema->FindTable("T1");
+  const Table* t2 = new_schema->FindTable("T2");
+  ASSERT_NE(t1, nullptr);
+  ASSERT_NE(t2, nullptr);
+  EXPECT_NE(t1, schema->FindTable("T1"));
+  EXPECT_NE(t2, schema->FindTable("T2"));
+  EXPECT_EQ(t2->parent(), t1);
+  ASSERT_EQ(t1->children().size(), 1);
+  EXPECT_EQ(t1->children()[0], t2);
+  EXPECT_NE(t2->FindColumn("c2"), nullptr);
+  EXPECT_EQ(schema->FindTable("T2")->FindColumn("c2"), nullptr);
+
+  // Unrelated tables and their columns are shared with the original schema.
+  const Table* t3 = new_schema->FindTable("T3");
+  EXPECT_EQ(t3, schema->FindTable("T3"));
+  EXPECT_EQ(t3->FindColumn("c3"), schema->FindTable("T3")->FindColumn("c3"));
+
+  // Shared nodes outlive the schema they were created in.
+  schema.reset();
+  EXPECT_EQ(t3->FindColumn("c3")->table(), t3);
 }
 
 TEST_F(SchemaUpdaterTest, DropTable_CanDropChildTable) {
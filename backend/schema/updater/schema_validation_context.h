@@ -17,13 +17,17 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_SCHEMA_CATALOG_SCHEMA_VALIDATION_CONTEXT_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_SCHEMA_CATALOG_SCHEMA_VALIDATION_CONTEXT_H_
 
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_set.h"
 #include "absl/time/time.h"
 #include "backend/schema/graph/schema_node.h"
 #include "backend/storage/storage.h"
+#include "common/cancellation.h"
 #include "absl/status/status.h"
 #include "zetasql/base/status_macros.h"
 
@@ -93,6 +97,20 @@ class SchemaValidationContext {
 
   const Schema* new_schema() const { return new_schema_snapshot_; }
 
+  // Returns the cancellation of the schema change, checked by actions which
+  // scan the rows of tables, such as backfills. Null if the schema change
+  // cannot be cancelled.
+  const CancellationToken* cancellation() const { return cancellation_; }
+
+  // Reports that an action is `done` out of `total` units of its work, such
+  // as the chunks of a table it backfills, as a percentage of the schema
+  // change statement being processed.
+  void ReportProgress(int64_t done, int64_t total) const {
+    if (progress_ != nullptr && total > 0) {
+      progress_(static_cast<int>(100 * done / total));
+    }
+  }
+
   // Interface accessed by SchemaUpdater to execute queued
   // actions.
   // -----------------------------------------------------
@@ -105,9 +123,22 @@ class SchemaValidationContext {
     new_schema_snapshot_ = new_schema;
   }
 
-  // Runs all SchemaVerifiers added to this validation context.
+  void set_cancellation(const CancellationToken* cancellation) {
+    cancellation_ = cancellation;
+  }
+
+  // Sets the callback receiving the percentages reported by ReportProgress.
+  void set_progress(std::function<void(int progress_percent)> progress) {
+    progress_ = std::move(progress);
+  }
+
+  // Runs all SchemaVerifiers added to this validation context, until one fails
+  // or the schema change is cancelled.
   absl::Status RunSchemaChangeActions() const {
     for (auto& action : actions_) {
+      if (cancellation_ != nullptr) {
+        ZETASQL_RETURN_IF_ERROR(cancellation_->Check());
+      }
       ZETASQL_RETURN_IF_ERROR(action(this));
     }
     return absl::OkStatus();
@@ -182,6 +213,12 @@ class SchemaValidationContext {
 
   // The new schema.
   const Schema* new_schema_snapshot_;
+
+  // Cancellation of the schema change, if not null. Not owned.
+  const CancellationToken* cancellation_ = nullptr;
+
+  // Receives the progress of the statement's actions, if not null.
+  std::function<void(int progress_percent)> progress_;
 };
 
 }  // namespace backend
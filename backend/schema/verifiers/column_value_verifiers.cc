@@ -16,7 +16,10 @@
 
 #include "backend/schema/verifiers/column_value_verifiers.h"
 
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "zetasql/public/functions/string.h"
 #include "zetasql/public/type.pb.h"
@@ -34,6 +37,7 @@
 #include "backend/datamodel/value.h"
 #include "backend/schema/catalog/column.h"
 #include "backend/schema/catalog/table.h"
+#include "backend/schema/updater/parallel_table_scan.h"
 #include "backend/schema/updater/schema_validation_context.h"
 #include "backend/storage/in_memory_storage.h"
 #include "backend/storage/iterator.h"
@@ -50,22 +54,37 @@ namespace backend {
 
 namespace {
 
-absl::Status VerifyColumnValue(
+absl::Status VerifyColumnValueInRange(
     const SchemaValidationContext* context, const Table* table,
-    const Column* column,
+    const Column* column, const KeyRange& range,
     const std::function<absl::Status(const zetasql::Value& column_value,
                                      const Key& key)>& verifier) {
   std::unique_ptr<StorageIterator> itr;
   ZETASQL_RETURN_IF_ERROR(context->storage()->Read(context->pending_commit_timestamp(),
-                                           table->id(), KeyRange::All(),
-                                           {column->id()}, &itr));
+                                           table->id(), range, {column->id()},
+                                           &itr));
 
   while (itr->Next()) {
     for (int i = 0; i < itr->NumColumns(); ++i) {
       ZETASQL_RETURN_IF_ERROR(verifier(itr->ColumnValue(i), itr->Key()));
     }
   }
-  return absl::OkStatus();
+  return itr->Status();
+}
+
+// Verifies the values of `column` in all rows of `table`. The key ranges of
+// the table are verified in parallel, so `verifier` must be thread-safe.
+absl::Status VerifyColumnValue(
+    const SchemaValidationContext* context, const Table* table,
+    const Column* column,
+    const std::function<absl::Status(const zetasql::Value& column_value,
+                                     const Key& key)>& verifier) {
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<KeyRange> ranges,
+                   SplitTableKeySpace(table, context));
+  return ForEachRangeInParallel(ranges.size(), [&](int i) {
+    return VerifyColumnValueInRange(context, table, column, ranges[i],
+                                    verifier);
+  });
 }
 
 absl::Status VerifyStringColumnValue(absl::string_view table_name,
@@ -33,7 +33,6 @@
 #include "backend/schema/catalog/table.h"
 #include "backend/schema/updater/schema_validation_context.h"
 #include "backend/storage/in_memory_storage.h"
-#include "common/clock.h"
 #include "common/errors.h"
 
 namespace google {
@@ -63,7 +62,7 @@ class ColumnValueVerifiersTest : public ::testing::Test {
   }
 
   void SetUp() override {
-    ZETASQL_ASSERT_OK_AND_ASSIGN(database_, Database::Create(&clock_, {R"(
+    ZETASQL_ASSERT_OK_AND_ASSIGN(database_, Database::Create({R"(
                             CREATE TABLE TestTable (
                               int64_col INT64,
                               string_col STRING(30),
@@ -98,8 +97,6 @@ class ColumnValueVerifiersTest : public ::testing::Test {
   }
 
  protected:
-  Clock clock_;
-
   std::unique_ptr<Database> database_;
 
   absl::Time commit_ts_value_;
@@ -17,13 +17,22 @@
 #include "backend/schema/verifiers/foreign_key_verifiers.h"
 
 #include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include "zetasql/public/value.h"
 #include "absl/status/status.h"
+#include "absl/types/span.h"
 #include "backend/common/ids.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
 #include "backend/schema/catalog/foreign_key.h"
 #include "backend/schema/catalog/index.h"
+#include "backend/schema/updater/parallel_table_scan.h"
+#include "backend/storage/iterator.h"
 #include "common/errors.h"
+#include "zetasql/base/status_macros.h"
 
 namespace google {
 namespace spanner {
@@ -42,38 +51,102 @@ std::vector<ColumnID> DataColumnIds(const Table* data_table, int column_count) {
                                column_ids.begin() + column_count);
 }
 
-}  // namespace
+// Returns true if the first `column_count` key columns of the referencing and
+// referenced data tables sort in the same order. The referencing keys of a key
+// range can then be merged with a single scan of the referenced data table.
+bool ConstraintKeysSortAlike(const ForeignKey* foreign_key, int column_count) {
+  absl::Span<const KeyColumn* const> referencing_key =
+      foreign_key->referencing_data_table()->primary_key();
+  absl::Span<const KeyColumn* const> referenced_key =
+      foreign_key->referenced_data_table()->primary_key();
+  for (int i = 0; i < column_count; ++i) {
+    if (referencing_key[i]->is_descending() !=
+        referenced_key[i]->is_descending()) {
+      return false;
+    }
+  }
+  return true;
+}
 
-absl::Status VerifyForeignKeyData(const ForeignKey* foreign_key,
-                                  const SchemaValidationContext* context) {
+// Verifies the rows of the referencing data table in `key_range`. Consecutive
+// rows with the same constraint key are verified once. If `merge` is true, the
+// referenced keys are found by a scan of the referenced data table from the
+// first constraint key of the range; otherwise each one is looked up.
+absl::Status VerifyForeignKeyRange(const ForeignKey* foreign_key,
+                                   const KeyRange& key_range, bool merge,
+                                   const SchemaValidationContext* context) {
   const Storage* storage = context->storage();
   absl::Time timestamp = context->pending_commit_timestamp();
   int column_count = foreign_key->referencing_columns().size();
-  TableID referenced_data_table_id = foreign_key->referenced_data_table()->id();
+  const Table* referenced_data_table = foreign_key->referenced_data_table();
   std::unique_ptr<StorageIterator> referencing_iterator;
   ZETASQL_RETURN_IF_ERROR(storage->Read(
-      timestamp, foreign_key->referencing_data_table()->id(), KeyRange::All(),
+      timestamp, foreign_key->referencing_data_table()->id(), key_range,
       DataColumnIds(foreign_key->referencing_data_table(), column_count),
       &referencing_iterator));
+  std::unique_ptr<StorageIterator> referenced_iterator;
+  bool has_referenced_row = false;
+  Key previous_key;
+  bool has_previous_key = false;
   while (referencing_iterator->Next()) {
-    Key constraint_key(std::vector<zetasql::Value>(
-        referencing_iterator->Key().column_values().begin(),
-        referencing_iterator->Key().column_values().begin() + column_count));
-    std::unique_ptr<StorageIterator> referenced_iterator;
-    ZETASQL_RETURN_IF_ERROR(storage->Read(timestamp, referenced_data_table_id,
-                                  KeyRange::Point(constraint_key), {},
-                                  &referenced_iterator));
-    if (!referenced_iterator->Next() && referenced_iterator->Status().ok()) {
+    // Constraint keys are ordered like the referenced data table's keys.
+    Key constraint_key;
+    for (int i = 0; i < column_count; ++i) {
+      constraint_key.AddColumn(
+          referencing_iterator->Key().ColumnValue(i),
+          referenced_data_table->primary_key()[i]->is_descending());
+    }
+    if (has_previous_key && constraint_key == previous_key) {
+      continue;
+    }
+    bool found;
+    if (merge) {
+      if (referenced_iterator == nullptr) {
+        ZETASQL_RETURN_IF_ERROR(storage->Read(
+            timestamp, referenced_data_table->id(),
+            KeyRange::ClosedOpen(constraint_key, Key::Infinity()), {},
+            &referenced_iterator));
+        has_referenced_row = referenced_iterator->Next();
+      }
+      while (has_referenced_row &&
+             referenced_iterator->Key().Prefix(column_count) < constraint_key) {
+        has_referenced_row = referenced_iterator->Next();
+      }
+      found = has_referenced_row &&
+              referenced_iterator->Key().Prefix(column_count) == constraint_key;
+    } else {
+      ZETASQL_RETURN_IF_ERROR(storage->Read(
+          timestamp, referenced_data_table->id(),
+          KeyRange::Point(constraint_key), {}, &referenced_iterator));
+      found = referenced_iterator->Next();
+    }
+    ZETASQL_RETURN_IF_ERROR(referenced_iterator->Status());
+    if (!found) {
       return error::ForeignKeyReferencedKeyNotFound(
           foreign_key->Name(), foreign_key->referencing_table()->Name(),
           foreign_key->referenced_table()->Name(),
-          constraint_key.DebugString());
+          Key(constraint_key.column_values()).DebugString());
     }
-    ZETASQL_RETURN_IF_ERROR(referenced_iterator->Status());
+    previous_key = std::move(constraint_key);
+    has_previous_key = true;
   }
   return referencing_iterator->Status();
 }
 
+}  // namespace
+
+absl::Status VerifyForeignKeyData(const ForeignKey* foreign_key,
+                                  const SchemaValidationContext* context) {
+  int column_count = foreign_key->referencing_columns().size();
+  bool merge = ConstraintKeysSortAlike(foreign_key, column_count);
+  ZETASQL_ASSIGN_OR_RETURN(
+      std::vector<KeyRange> key_ranges,
+      SplitTableKeySpace(foreign_key->referencing_data_table(), context));
+  return ForEachRangeInParallel(key_ranges.size(), [&](int i) {
+    return VerifyForeignKeyRange(foreign_key, key_ranges[i], merge, context);
+  });
+}
+
 }  // namespace backend
 }  // namespace emulator
 }  // namespace spanner
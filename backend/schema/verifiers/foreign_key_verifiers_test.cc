@@ -23,7 +23,7 @@
 #include "backend/database/database.h"
 #include "backend/transaction/options.h"
 #include "backend/transaction/read_write_transaction.h"
-#include "common/clock.h"
+#include "common/errors.h"
 
 namespace google {
 namespace spanner {
@@ -64,7 +64,7 @@ class ForeignKeyVerifiersTest : public ::testing::Test {
   }
 
   absl::Status CreateDatabase(const std::vector<std::string>& statements) {
-    ZETASQL_ASSIGN_OR_RETURN(database_, Database::Create(&clock_, statements));
+    ZETASQL_ASSIGN_OR_RETURN(database_, Database::Create(statements));
     return absl::OkStatus();
   }
 
@@ -79,8 +79,17 @@ class ForeignKeyVerifiersTest : public ::testing::Test {
 
   void Insert(const std::string& table, const std::vector<std::string>& columns,
               const std::vector<int>& values) {
+    InsertRows(table, columns, {values});
+  }
+
+  void InsertRows(const std::string& table,
+                  const std::vector<std::string>& columns,
+                  const std::vector<std::vector<int>>& rows) {
+    std::vector<ValueList> value_lists;
+    std::transform(rows.begin(), rows.end(), std::back_inserter(value_lists),
+                   [this](const std::vector<int>& row) { return AsList(row); });
     Mutation m;
-    m.AddWriteOp(MutationOpType::kInsert, table, columns, {AsList(values)});
+    m.AddWriteOp(MutationOpType::kInsert, table, columns, value_lists);
     ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<ReadWriteTransaction> txn,
                          database_->CreateReadWriteTransaction(
                              ReadWriteOptions(), RetryState()));
@@ -96,7 +105,6 @@ class ForeignKeyVerifiersTest : public ::testing::Test {
     return value_list;
   }
 
-  Clock clock_;
   std::unique_ptr<Database> database_;
 };
 
@@ -114,6 +122,62 @@ TEST_F(ForeignKeyVerifiersTest, InvalidExistingData) {
   EXPECT_THAT(AddForeignKey(), StatusIs(absl::StatusCode::kFailedPrecondition));
 }
 
+TEST_F(ForeignKeyVerifiersTest, LargeValidExistingData) {
+  // Enough rows for the referencing keys to be verified in several key ranges,
+  // with each referenced key used by two referencing rows.
+  constexpr int kNumKeys = 10000;
+  std::vector<std::vector<int>> t_rows;
+  std::vector<std::vector<int>> u_rows;
+  for (int i = 1; i <= kNumKeys; ++i) {
+    t_rows.push_back({i, i, i});
+    u_rows.push_back({2 * i - 1, i, i});
+    u_rows.push_back({2 * i, i, i});
+  }
+  InsertRows("T", {"A", "B", "C"}, t_rows);
+  InsertRows("U", {"X", "Y", "Z"}, u_rows);
+  ZETASQL_EXPECT_OK(AddForeignKey());
+}
+
+TEST_F(ForeignKeyVerifiersTest, LargeInvalidExistingData) {
+  constexpr int kNumKeys = 20000;
+  std::vector<std::vector<int>> t_rows;
+  std::vector<std::vector<int>> u_rows;
+  for (int i = 1; i <= kNumKeys; ++i) {
+    t_rows.push_back({i, i, i});
+    // Two key ranges have a row without a referenced key.
+    u_rows.push_back({i, i == 5000 || i == 15000 ? 1 : i, i});
+  }
+  InsertRows("T", {"A", "B", "C"}, t_rows);
+  InsertRows("U", {"X", "Y", "Z"}, u_rows);
+
+  // The violation of the first referencing key in key order is reported.
+  EXPECT_EQ(AddForeignKey(), error::ForeignKeyReferencedKeyNotFound(
+                                 "C", "U", "T", "{Int64(5000), Int64(1)}"));
+}
+
+TEST_F(ForeignKeyVerifiersTest, ReferencedKeyInDifferentOrder) {
+  // The referenced keys sort in the opposite order of the referencing keys,
+  // so each of them is looked up.
+  ZETASQL_ASSERT_OK(CreateDatabase({R"(
+      CREATE TABLE P (
+        K INT64,
+      ) PRIMARY KEY(K DESC))",
+                            R"(
+      CREATE TABLE R (
+        K INT64,
+      ) PRIMARY KEY(K))"}));
+  InsertRows("P", {"K"}, {{1}, {2}, {3}});
+  InsertRows("R", {"K"}, {{1}, {3}});
+  ZETASQL_EXPECT_OK(UpdateSchema({R"(
+      ALTER TABLE R ADD CONSTRAINT C FOREIGN KEY(K) REFERENCES P(K))"}));
+
+  InsertRows("R", {"K"}, {{4}});
+  EXPECT_EQ(UpdateSchema({R"(
+      ALTER TABLE R ADD CONSTRAINT D FOREIGN KEY(K) REFERENCES P(K))"}),
+            error::ForeignKeyReferencedKeyNotFound("D", "R", "P",
+                                                   "{Int64(4)}"));
+}
+
 }  // namespace
 }  // namespace backend
 }  // namespace emulator
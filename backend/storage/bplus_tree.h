@@ -0,0 +1,579 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_BPLUS_TREE_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_BPLUS_TREE_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// BPlusTree is an ordered map from encoded keys to values of type V, laid out
+// as a B+-tree with up to kNodeSize entries per node.
+//
+// Leaves keep their keys contiguously, apart from their values, so that
+// searching a leaf touches few cache lines, and are linked in key order so
+// that scans step from one leaf to the next without going back up the tree.
+// Inserting keys in increasing order at the end of the tree fills each leaf
+// before starting the next one, so constructing a tree from a sorted range
+// bulk-loads it in linear time into full nodes.
+//
+// The interface is the subset of std::map<std::string, V> used by
+// InMemoryStorage, with two differences:
+//  - Iterators dereference to a pair of references to the key and value of
+//    an entry, rather than to a stored pair. Range-based for loops should bind
+//    entries with `const auto&` or `auto&&`.
+//  - Entries move within and between nodes, so any insertion or erasure
+//    invalidates all iterators into the tree, except the one returned.
+//
+// Leaves which are less than a quarter full after an erasure are merged with
+// a neighboring leaf if both fit in half a node, and empty nodes are removed.
+// Internal nodes are not rebalanced otherwise.
+//
+// This class is not thread-safe.
+template <typename V, int kNodeSize = 64>
+class BPlusTree {
+  static_assert(kNodeSize >= 4, "Nodes must hold at least 4 entries");
+
+  struct Leaf;
+
+ public:
+  template <bool kConst>
+  class Iterator {
+   public:
+    using Value = typename std::conditional<kConst, const V, V>::type;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = std::pair<std::string, V>;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::pair<const std::string&, Value&>;
+
+    // Holds the entry returned by operator-> so that member access reaches
+    // through it.
+    class pointer {
+     public:
+      explicit pointer(reference entry) : entry_(entry) {}
+      const reference* operator->() const { return &entry_; }
+
+     private:
+      reference entry_;
+    };
+
+    Iterator() = default;
+
+    // Converts an iterator to a const_iterator.
+    Iterator(const Iterator<false>& other)  // NOLINT
+        : leaf_(other.leaf_), pos_(other.pos_) {}
+
+    reference operator*() const {
+      return reference(leaf_->keys[pos_], leaf_->values[pos_]);
+    }
+    pointer operator->() const { return pointer(**this); }
+
+    Iterator& operator++() {
+      if (++pos_ == leaf_->size && leaf_->next != nullptr) {
+        leaf_ = leaf_->next;
+        pos_ = 0;
+      }
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator itr = *this;
+      ++*this;
+      return itr;
+    }
+    Iterator& operator--() {
+      if (pos_ == 0) {
+        leaf_ = leaf_->prev;
+        pos_ = leaf_->size;
+      }
+      --pos_;
+      return *this;
+    }
+    Iterator operator--(int) {
+      Iterator itr = *this;
+      --*this;
+      return itr;
+    }
+
+    friend bool operator==(const Iterator& a, const Iterator& b) {
+      return a.leaf_ == b.leaf_ && a.pos_ == b.pos_;
+    }
+    friend bool operator!=(const Iterator& a, const Iterator& b) {
+      return !(a == b);
+    }
+
+   private:
+    friend class BPlusTree;
+    template <bool>
+    friend class Iterator;
+
+    Iterator(Leaf* leaf, int pos) : leaf_(leaf), pos_(pos) {}
+
+    // The leaf holding the entry and its position within the leaf. The end
+    // iterator is positioned one past the last entry of the last leaf, or at
+    // no leaf if the tree is empty.
+    Leaf* leaf_ = nullptr;
+    int pos_ = 0;
+  };
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  BPlusTree() = default;
+
+  // Constructs a tree holding the entries of [first, last), which need not be
+  // sorted, though sorted entries are loaded in linear time. The first of
+  // entries with equal keys is kept.
+  template <typename InputIterator>
+  BPlusTree(InputIterator first, InputIterator last) {
+    for (; first != last; ++first) {
+      auto&& entry = *first;
+      emplace_hint(end(), std::forward<decltype(entry)>(entry).first,
+                   std::forward<decltype(entry)>(entry).second);
+    }
+  }
+
+  BPlusTree(const BPlusTree& other) : BPlusTree(other.begin(), other.end()) {}
+  BPlusTree(BPlusTree&& other) noexcept { swap(other); }
+  BPlusTree& operator=(BPlusTree other) {
+    swap(other);
+    return *this;
+  }
+  ~BPlusTree() { DeleteNode(root_); }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  iterator begin() { return iterator(leftmost_, 0); }
+  const_iterator begin() const { return const_iterator(leftmost_, 0); }
+  iterator end() {
+    return iterator(rightmost_, rightmost_ == nullptr ? 0 : rightmost_->size);
+  }
+  const_iterator end() const {
+    return const_iterator(rightmost_,
+                          rightmost_ == nullptr ? 0 : rightmost_->size);
+  }
+
+  // Returns the entry with the given key, or end() if there is none.
+  iterator find(const std::string& key) { return Find(key); }
+  const_iterator find(const std::string& key) const { return Find(key); }
+
+  // Returns the first entry whose key is not before the given key.
+  iterator lower_bound(const std::string& key) { return LowerBound(key); }
+  const_iterator lower_bound(const std::string& key) const {
+    return LowerBound(key);
+  }
+
+  // Inserts an entry with the given key and a value constructed from `args`,
+  // unless the key is already present. Returns the entry with the key, and
+  // whether it was inserted.
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(std::string key, Args&&... args) {
+    if (root_ == nullptr) {
+      return {InsertAt(nullptr, 0, std::move(key),
+                       V(std::forward<Args>(args)...)),
+              true};
+    }
+    auto [leaf, pos] = Search(key);
+    if (pos < leaf->size && leaf->keys[pos] == key) {
+      return {iterator(leaf, pos), false};
+    }
+    return {InsertAt(leaf, pos, std::move(key), V(std::forward<Args>(args)...)),
+            true};
+  }
+
+  // As try_emplace, but without searching the tree if the key belongs right
+  // before `hint`. Returns the entry with the key.
+  template <typename... Args>
+  iterator emplace_hint(const_iterator hint, std::string key,
+                        Args&&... args) {
+    if (hint == end()) {
+      if (rightmost_ != nullptr &&
+          rightmost_->keys[rightmost_->size - 1] < key) {
+        return InsertAt(rightmost_, rightmost_->size, std::move(key),
+                        V(std::forward<Args>(args)...));
+      }
+    } else if (hint.pos_ > 0 && hint.leaf_->keys[hint.pos_ - 1] < key &&
+               key < hint.leaf_->keys[hint.pos_]) {
+      // The first entry of a leaf may be after keys which belong to the leaf
+      // before it, so a key is only inserted right before an entry within
+      // the same leaf.
+      return InsertAt(hint.leaf_, hint.pos_, std::move(key),
+                      V(std::forward<Args>(args)...));
+    }
+    return try_emplace(std::move(key), std::forward<Args>(args)...).first;
+  }
+
+  // Erases the entry at `pos`, and returns the entry after it.
+  iterator erase(const_iterator pos);
+
+  void clear() {
+    DeleteNode(root_);
+    root_ = nullptr;
+    leftmost_ = rightmost_ = nullptr;
+    size_ = 0;
+  }
+
+  void swap(BPlusTree& other) {
+    std::swap(root_, other.root_);
+    std::swap(leftmost_, other.leftmost_);
+    std::swap(rightmost_, other.rightmost_);
+    std::swap(size_, other.size_);
+  }
+
+ private:
+  struct Internal;
+
+  struct Node {
+    explicit Node(bool is_leaf) : is_leaf(is_leaf) {}
+
+    const bool is_leaf;
+
+    // Number of entries of a leaf, or of children of an internal node.
+    int size = 0;
+
+    Internal* parent = nullptr;
+  };
+
+  struct Leaf : Node {
+    Leaf() : Node(true) {}
+
+    std::array<std::string, kNodeSize> keys;
+    std::array<V, kNodeSize> values;
+
+    // Neighboring leaves in key order.
+    Leaf* prev = nullptr;
+    Leaf* next = nullptr;
+  };
+
+  struct Internal : Node {
+    Internal() : Node(false) {}
+
+    // For i > 0, keys[i] is at or before the keys of the entries under
+    // children[i], and after those under children[i - 1]. keys[0] is unused.
+    std::array<std::string, kNodeSize> keys;
+    std::array<Node*, kNodeSize> children;
+  };
+
+  // Returns the leaf which holds or would hold the key, and the position of
+  // the first entry of the leaf not before the key, which may be one past
+  // the last. The tree must not be empty.
+  std::pair<Leaf*, int> Search(const std::string& key) const {
+    Node* node = root_;
+    while (!node->is_leaf) {
+      const Internal* internal = static_cast<const Internal*>(node);
+      const auto keys_end = internal->keys.begin() + internal->size;
+      const int child =
+          std::upper_bound(internal->keys.begin() + 1, keys_end, key) -
+          internal->keys.begin() - 1;
+      node = internal->children[child];
+    }
+    Leaf* leaf = static_cast<Leaf*>(node);
+    const int pos =
+        std::lower_bound(leaf->keys.begin(), leaf->keys.begin() + leaf->size,
+                         key) -
+        leaf->keys.begin();
+    return {leaf, pos};
+  }
+
+  iterator Find(const std::string& key) const {
+    if (root_ != nullptr) {
+      auto [leaf, pos] = Search(key);
+      if (pos < leaf->size && leaf->keys[pos] == key) {
+        return iterator(leaf, pos);
+      }
+    }
+    return iterator(rightmost_, rightmost_ == nullptr ? 0 : rightmost_->size);
+  }
+
+  iterator LowerBound(const std::string& key) const {
+    if (root_ == nullptr) {
+      return iterator();
+    }
+    auto [leaf, pos] = Search(key);
+    return MakeIterator(leaf, pos);
+  }
+
+  // Returns an iterator to the entry at `pos` in the leaf, which moves on to
+  // the next leaf if `pos` is one past the last entry of the leaf.
+  static iterator MakeIterator(Leaf* leaf, int pos) {
+    if (pos == leaf->size && leaf->next != nullptr) {
+      return iterator(leaf->next, 0);
+    }
+    return iterator(leaf, pos);
+  }
+
+  // Inserts an entry at `pos` in the leaf, which is where its key belongs,
+  // splitting the leaf if it is full. A null leaf creates the first leaf of
+  // an empty tree.
+  iterator InsertAt(Leaf* leaf, int pos, std::string key, V value);
+
+  // Inserts `right` after its sibling `left` into their parent, along with the
+  // lower bound of the keys under `right`, splitting the parent if it is full.
+  // `append` is set if `right` is the new last node of its level, in which case
+  // a full parent keeps all its children rather than half of them.
+  void InsertChild(Node* left, std::string key, Node* right, bool append);
+
+  // Moves the entries at [begin, end) of `from` to `to`, starting at `pos`.
+  static void MoveEntries(Leaf* from, int begin, int end, Leaf* to, int pos) {
+    for (int i = begin; i < end; ++i, ++pos) {
+      to->keys[pos] = std::move(from->keys[i]);
+      to->values[pos] = std::move(from->values[i]);
+      from->keys[i] = std::string();
+      from->values[i] = V();
+    }
+  }
+
+  // Returns the position of `child` among the children of its parent.
+  static int IndexOf(const Node* child) {
+    const Internal* parent = child->parent;
+    return std::find(parent->children.begin(),
+                     parent->children.begin() + parent->size, child) -
+           parent->children.begin();
+  }
+
+  // Unlinks an empty leaf from its neighbors and removes it from the tree.
+  void RemoveLeaf(Leaf* leaf);
+
+  // Removes an empty node from its parent and deletes it, along with any
+  // ancestor left without children.
+  void RemoveNode(Node* node);
+
+  // Deletes the node and all nodes under it.
+  static void DeleteNode(Node* node) {
+    if (node == nullptr) {
+      return;
+    }
+    if (node->is_leaf) {
+      delete static_cast<Leaf*>(node);
+      return;
+    }
+    Internal* internal = static_cast<Internal*>(node);
+    for (int i = 0; i < internal->size; ++i) {
+      DeleteNode(internal->children[i]);
+    }
+    delete internal;
+  }
+
+  Node* root_ = nullptr;
+
+  // The first and last leaves, or null if the tree is empty. Leaves are never
+  // empty.
+  Leaf* leftmost_ = nullptr;
+  Leaf* rightmost_ = nullptr;
+
+  size_t size_ = 0;
+};
+
+template <typename V, int kNodeSize>
+typename BPlusTree<V, kNodeSize>::iterator BPlusTree<V, kNodeSize>::InsertAt(
+    Leaf* leaf, int pos, std::string key, V value) {
+  if (leaf == nullptr) {
+    leaf = new Leaf();
+    root_ = leftmost_ = rightmost_ = leaf;
+  }
+  ++size_;
+
+  // A full leaf is split in half, except when appending to the last leaf,
+  // which is left full so that sorted inserts fill every leaf.
+  Leaf* target = leaf;
+  bool split = leaf->size == kNodeSize;
+  bool append = split && pos == kNodeSize && leaf->next == nullptr;
+  if (split) {
+    Leaf* right = new Leaf();
+    const int split_pos = append ? kNodeSize : kNodeSize / 2;
+    MoveEntries(leaf, split_pos, kNodeSize, right, 0);
+    right->size = kNodeSize - split_pos;
+    leaf->size = split_pos;
+    right->prev = leaf;
+    right->next = leaf->next;
+    if (leaf->next != nullptr) {
+      leaf->next->prev = right;
+    } else {
+      rightmost_ = right;
+    }
+    leaf->next = right;
+    if (pos > split_pos || append) {
+      target = right;
+      pos -= split_pos;
+    }
+  }
+
+  std::move_backward(target->keys.begin() + pos,
+                     target->keys.begin() + target->size,
+                     target->keys.begin() + target->size + 1);
+  std::move_backward(target->values.begin() + pos,
+                     target->values.begin() + target->size,
+                     target->values.begin() + target->size + 1);
+  target->keys[pos] = std::move(key);
+  target->values[pos] = std::move(value);
+  ++target->size;
+
+  if (split) {
+    Leaf* right = leaf->next;
+    InsertChild(leaf, right->keys[0], right, append);
+  }
+  return iterator(target, pos);
+}
+
+template <typename V, int kNodeSize>
+void BPlusTree<V, kNodeSize>::InsertChild(Node* left, std::string key,
+                                          Node* right, bool append) {
+  Internal* parent = left->parent;
+  if (parent == nullptr) {
+    parent = new Internal();
+    parent->children[0] = left;
+    parent->size = 1;
+    left->parent = parent;
+    root_ = parent;
+  }
+  int pos = IndexOf(left) + 1;
+
+  Internal* target = parent;
+  Internal* sibling = nullptr;
+  if (parent->size == kNodeSize) {
+    sibling = new Internal();
+    const int split_pos = append ? kNodeSize : kNodeSize / 2;
+    for (int i = split_pos; i < kNodeSize; ++i) {
+      sibling->keys[i - split_pos] = std::move(parent->keys[i]);
+      sibling->children[i - split_pos] = parent->children[i];
+      sibling->children[i - split_pos]->parent = sibling;
+    }
+    sibling->size = kNodeSize - split_pos;
+    parent->size = split_pos;
+    if (pos > split_pos || append) {
+      target = sibling;
+      pos -= split_pos;
+    }
+  }
+
+  std::move_backward(target->keys.begin() + pos,
+                     target->keys.begin() + target->size,
+                     target->keys.begin() + target->size + 1);
+  std::copy_backward(target->children.begin() + pos,
+                     target->children.begin() + target->size,
+                     target->children.begin() + target->size + 1);
+  target->keys[pos] = std::move(key);
+  target->children[pos] = right;
+  right->parent = target;
+  ++target->size;
+
+  if (sibling != nullptr) {
+    InsertChild(parent, sibling->keys[0], sibling, append);
+  }
+}
+
+template <typename V, int kNodeSize>
+typename BPlusTree<V, kNodeSize>::iterator BPlusTree<V, kNodeSize>::erase(
+    const_iterator itr) {
+  Leaf* leaf = itr.leaf_;
+  const int pos = itr.pos_;
+  std::move(leaf->keys.begin() + pos + 1, leaf->keys.begin() + leaf->size,
+            leaf->keys.begin() + pos);
+  std::move(leaf->values.begin() + pos + 1, leaf->values.begin() + leaf->size,
+            leaf->values.begin() + pos);
+  --leaf->size;
+  leaf->keys[leaf->size] = std::string();
+  leaf->values[leaf->size] = V();
+  --size_;
+
+  if (leaf->size == 0) {
+    Leaf* next = leaf->next;
+    RemoveLeaf(leaf);
+    return next != nullptr ? iterator(next, 0) : end();
+  }
+  if (leaf->size < kNodeSize / 4) {
+    Leaf* next = leaf->next;
+    if (next != nullptr && next->parent == leaf->parent &&
+        leaf->size + next->size <= kNodeSize / 2) {
+      MoveEntries(next, 0, next->size, leaf, leaf->size);
+      leaf->size += next->size;
+      next->size = 0;
+      RemoveLeaf(next);
+      return MakeIterator(leaf, pos);
+    }
+    Leaf* prev = leaf->prev;
+    if (prev != nullptr && prev->parent == leaf->parent &&
+        prev->size + leaf->size <= kNodeSize / 2) {
+      const int offset = prev->size;
+      MoveEntries(leaf, 0, leaf->size, prev, offset);
+      prev->size += leaf->size;
+      leaf->size = 0;
+      RemoveLeaf(leaf);
+      return MakeIterator(prev, offset + pos);
+    }
+  }
+  return MakeIterator(leaf, pos);
+}
+
+template <typename V, int kNodeSize>
+void BPlusTree<V, kNodeSize>::RemoveLeaf(Leaf* leaf) {
+  if (leaf->prev != nullptr) {
+    leaf->prev->next = leaf->next;
+  } else {
+    leftmost_ = leaf->next;
+  }
+  if (leaf->next != nullptr) {
+    leaf->next->prev = leaf->prev;
+  } else {
+    rightmost_ = leaf->prev;
+  }
+  RemoveNode(leaf);
+
+  // A root left with a single child is replaced by the child.
+  while (root_ != nullptr && !root_->is_leaf && root_->size == 1) {
+    Internal* root = static_cast<Internal*>(root_);
+    root_ = root->children[0];
+    root_->parent = nullptr;
+    delete root;
+  }
+}
+
+template <typename V, int kNodeSize>
+void BPlusTree<V, kNodeSize>::RemoveNode(Node* node) {
+  Internal* parent = node->parent;
+  if (parent == nullptr) {
+    root_ = nullptr;
+  } else {
+    const int pos = IndexOf(node);
+    std::move(parent->keys.begin() + pos + 1,
+              parent->keys.begin() + parent->size, parent->keys.begin() + pos);
+    std::copy(parent->children.begin() + pos + 1,
+              parent->children.begin() + parent->size,
+              parent->children.begin() + pos);
+    --parent->size;
+    parent->keys[parent->size] = std::string();
+  }
+  DeleteNode(node);
+  if (parent != nullptr && parent->size == 0) {
+    RemoveNode(parent);
+  }
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_BPLUS_TREE_H_
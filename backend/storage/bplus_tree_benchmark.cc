@@ -0,0 +1,138 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Compares the cost of building, searching and scanning the containers which
+// can hold the rows of an InMemoryStorage table, std::map and BPlusTree, for
+// tables of 1M rows and up keyed by encoded INT64 keys.
+//
+// Usage: bplus_tree_benchmark [--max_rows=10000000]
+//            [--benchmark_format=table|json] [--benchmark_min_time=500ms]
+//            [--benchmark_filter=...]
+//
+// Tables grow tenfold from 1M rows up to --max_rows. A table of 100M rows
+// takes tens of GB of memory with either container.
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "zetasql/public/value.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/str_cat.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_encoding.h"
+#include "backend/storage/bplus_tree.h"
+#include "common/benchmark.h"
+
+ABSL_FLAG(int64_t, max_rows, 10000000,
+          "Number of rows of the largest table measured.");
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+// Stands in for the rows of a table, which take about as much space.
+using Payload = std::array<int64_t, 12>;
+
+// Number of distinct keys searched by the lookups and scans of each table.
+constexpr int kNumProbes = 1 << 16;
+
+// Number of rows visited by each scan.
+constexpr int kRowsPerScan = 1000;
+
+std::string MakeKey(int64_t row) {
+  return EncodeKey(Key({zetasql::values::Int64(row)}));
+}
+
+// Returns the keys of rows spread over a table of `num_rows` rows, so that
+// successive searches rarely visit the same nodes.
+std::vector<std::string> MakeProbes(int64_t num_rows) {
+  std::vector<std::string> probes;
+  for (int64_t i = 0; i < kNumProbes; ++i) {
+    probes.push_back(MakeKey(i * 2654435761 % num_rows));
+  }
+  return probes;
+}
+
+template <typename Rows>
+void RunCases(BenchmarkRunner* runner, const std::string& container,
+              int64_t num_rows, const std::vector<std::string>& probes) {
+  const std::string suffix = absl::StrCat("/", container, "/rows:", num_rows);
+  Rows rows;
+
+  // Keys are inserted in order, as they are when copying a table, and
+  // encoded as they are inserted. Each iteration also frees the table built
+  // by the previous one.
+  auto build = [&](int64_t iterations) {
+    for (int64_t i = 0; i < iterations; ++i) {
+      rows.clear();
+      for (int64_t row = 0; row < num_rows; ++row) {
+        rows.emplace_hint(rows.end(), MakeKey(row), Payload{row});
+      }
+    }
+  };
+  if (!runner->Run(absl::StrCat("Build", suffix), build)) {
+    build(1);
+  }
+
+  runner->Run(absl::StrCat("Lookup", suffix), [&](int64_t iterations) {
+    for (int64_t i = 0; i < iterations; ++i) {
+      auto itr = rows.find(probes[i % kNumProbes]);
+      DoNotOptimize(itr->second[0]);
+    }
+  });
+
+  runner->Run(absl::StrCat("Scan", suffix, "/rows_per_scan:", kRowsPerScan),
+              [&](int64_t iterations) {
+                for (int64_t i = 0; i < iterations; ++i) {
+                  int64_t sum = 0;
+                  auto itr = rows.lower_bound(probes[i % kNumProbes]);
+                  for (int j = 0; j < kRowsPerScan && itr != rows.end();
+                       ++j, ++itr) {
+                    sum += itr->second[0];
+                  }
+                  DoNotOptimize(sum);
+                }
+              });
+}
+
+void RunBenchmark() {
+  BenchmarkRunner runner;
+  for (int64_t num_rows = 1000000; num_rows <= absl::GetFlag(FLAGS_max_rows);
+       num_rows *= 10) {
+    std::vector<std::string> probes = MakeProbes(num_rows);
+    RunCases<std::map<std::string, Payload>>(&runner, "map", num_rows, probes);
+    RunCases<BPlusTree<Payload>>(&runner, "bplus_tree", num_rows, probes);
+  }
+  runner.Report();
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  google::spanner::emulator::backend::RunBenchmark();
+  return 0;
+}
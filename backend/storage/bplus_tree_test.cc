@@ -0,0 +1,234 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/storage/bplus_tree.h"
+
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/strings/str_format.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using Entries = std::vector<std::pair<std::string, int>>;
+
+// Small nodes, so that a few hundred entries take several levels.
+using SmallTree = BPlusTree<int, 8>;
+
+// Returns keys which sort in the order of `i`.
+std::string MakeKey(int i) { return absl::StrFormat("key%06d", i); }
+
+template <typename Tree>
+Entries Contents(const Tree& tree) {
+  Entries entries;
+  for (const auto& [key, value] : tree) {
+    entries.emplace_back(key, value);
+  }
+  return entries;
+}
+
+Entries Contents(const std::map<std::string, int>& map) {
+  return Entries(map.begin(), map.end());
+}
+
+TEST(BPlusTreeTest, EmptyTreeHasNoEntries) {
+  SmallTree tree;
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(tree.size(), 0);
+  EXPECT_TRUE(tree.begin() == tree.end());
+  EXPECT_TRUE(tree.find("a") == tree.end());
+  EXPECT_TRUE(tree.lower_bound("a") == tree.end());
+}
+
+TEST(BPlusTreeTest, InsertsEntriesInAnyOrder) {
+  std::mt19937 random(17);
+  SmallTree tree;
+  std::map<std::string, int> expected;
+  for (int i = 0; i < 2000; ++i) {
+    std::string key = MakeKey(random() % 1000);
+    auto [itr, inserted] = tree.try_emplace(key, i);
+    auto [expected_itr, expected_inserted] = expected.try_emplace(key, i);
+    ASSERT_EQ(inserted, expected_inserted);
+    ASSERT_EQ(itr->first, key);
+    ASSERT_EQ(itr->second, expected_itr->second);
+  }
+  EXPECT_EQ(tree.size(), expected.size());
+  EXPECT_EQ(Contents(tree), Contents(expected));
+
+  for (int i = 0; i < 1000; ++i) {
+    std::string key = MakeKey(i);
+    auto itr = tree.find(key);
+    auto expected_itr = expected.find(key);
+    ASSERT_EQ(itr == tree.end(), expected_itr == expected.end()) << key;
+    if (itr != tree.end()) {
+      EXPECT_EQ(itr->second, expected_itr->second);
+    }
+  }
+}
+
+TEST(BPlusTreeTest, FindsTheFirstEntryNotBeforeAKey) {
+  SmallTree tree;
+  for (int i = 0; i < 500; i += 5) {
+    tree.try_emplace(MakeKey(i), i);
+  }
+  for (int i = 0; i <= 495; ++i) {
+    auto itr = tree.lower_bound(MakeKey(i));
+    ASSERT_TRUE(itr != tree.end());
+    EXPECT_EQ(itr->second, (i + 4) / 5 * 5);
+  }
+  EXPECT_TRUE(tree.lower_bound(MakeKey(496)) == tree.end());
+}
+
+TEST(BPlusTreeTest, IteratesInBothDirections) {
+  SmallTree tree;
+  for (int i = 999; i >= 0; --i) {
+    tree.try_emplace(MakeKey(i), i);
+  }
+  int expected = 0;
+  for (auto itr = tree.begin(); itr != tree.end(); ++itr) {
+    EXPECT_EQ((*itr).second, expected++);
+  }
+  EXPECT_EQ(expected, 1000);
+  EXPECT_EQ(std::distance(tree.begin(), tree.end()), 1000);
+  for (auto itr = tree.end(); itr != tree.begin();) {
+    --itr;
+    EXPECT_EQ(itr->second, --expected);
+  }
+  EXPECT_EQ(expected, 0);
+}
+
+TEST(BPlusTreeTest, ErasesEntriesAndReturnsTheNextOne) {
+  std::mt19937 random(17);
+  SmallTree tree;
+  std::map<std::string, int> expected;
+  for (int i = 0; i < 1000; ++i) {
+    tree.try_emplace(MakeKey(i), i);
+    expected.try_emplace(MakeKey(i), i);
+  }
+
+  // Erase runs of entries from random positions, until all are gone.
+  while (!expected.empty()) {
+    std::string key = MakeKey(random() % 1000);
+    auto itr = tree.lower_bound(key);
+    auto expected_itr = expected.lower_bound(key);
+    for (int i = random() % 20; i >= 0 && expected_itr != expected.end();
+         --i) {
+      itr = tree.erase(itr);
+      expected_itr = expected.erase(expected_itr);
+      ASSERT_EQ(itr == tree.end(), expected_itr == expected.end());
+      if (itr != tree.end()) {
+        ASSERT_EQ(itr->first, expected_itr->first);
+      }
+    }
+    ASSERT_EQ(tree.size(), expected.size());
+    ASSERT_EQ(Contents(tree), Contents(expected));
+  }
+  EXPECT_TRUE(tree.empty());
+  EXPECT_TRUE(tree.begin() == tree.end());
+
+  // The emptied tree can be reused.
+  tree.try_emplace("a", 1);
+  EXPECT_EQ(Contents(tree), Entries({{"a", 1}}));
+}
+
+TEST(BPlusTreeTest, InsertsNextToHints) {
+  SmallTree tree;
+  for (int i = 0; i < 100; ++i) {
+    auto itr = tree.emplace_hint(tree.end(), MakeKey(2 * i), 2 * i);
+    EXPECT_EQ(itr->second, 2 * i);
+  }
+  for (int i = 0; i < 100; ++i) {
+    auto itr = tree.emplace_hint(tree.lower_bound(MakeKey(2 * i + 1)),
+                                 MakeKey(2 * i + 1), 2 * i + 1);
+    EXPECT_EQ(itr->second, 2 * i + 1);
+  }
+
+  // Hints which are not next to the key, or at an existing key, are ignored.
+  EXPECT_EQ(tree.emplace_hint(tree.begin(), MakeKey(150), -1)->second, 150);
+  EXPECT_EQ(tree.emplace_hint(tree.end(), MakeKey(199), -1)->second, 199);
+
+  int expected = 0;
+  for (const auto& [key, value] : tree) {
+    EXPECT_EQ(key, MakeKey(expected));
+    EXPECT_EQ(value, expected);
+    ++expected;
+  }
+  EXPECT_EQ(expected, 200);
+}
+
+TEST(BPlusTreeTest, ConstructsFromSortedAndUnsortedEntries) {
+  Entries sorted;
+  for (int i = 0; i < 1000; ++i) {
+    sorted.emplace_back(MakeKey(i), i);
+  }
+  EXPECT_EQ(Contents(SmallTree(sorted.begin(), sorted.end())), sorted);
+
+  Entries unsorted(sorted.rbegin(), sorted.rend());
+  unsorted.emplace_back(MakeKey(0), -1);
+  EXPECT_EQ(Contents(SmallTree(unsorted.begin(), unsorted.end())), sorted);
+}
+
+TEST(BPlusTreeTest, CopiesAndSwapsTrees) {
+  SmallTree tree;
+  for (int i = 0; i < 100; ++i) {
+    tree.try_emplace(MakeKey(i), i);
+  }
+  SmallTree copy = tree;
+  copy.erase(copy.find(MakeKey(50)));
+  EXPECT_EQ(tree.size(), 100);
+  EXPECT_EQ(copy.size(), 99);
+
+  SmallTree other;
+  other.swap(copy);
+  EXPECT_TRUE(copy.empty());
+  EXPECT_EQ(other.size(), 99);
+  EXPECT_TRUE(other.find(MakeKey(50)) == other.end());
+
+  copy = std::move(other);
+  EXPECT_EQ(copy.size(), 99);
+  copy.clear();
+  EXPECT_TRUE(copy.empty());
+  EXPECT_EQ(tree.size(), 100);
+}
+
+TEST(BPlusTreeTest, UpdatesValuesInPlace) {
+  BPlusTree<std::vector<int>> tree;
+  for (int i = 0; i < 1000; ++i) {
+    tree.try_emplace(MakeKey(i));
+  }
+  for (auto&& [key, value] : tree) {
+    value.push_back(key.size());
+  }
+  tree.find(MakeKey(10))->second.push_back(1);
+  EXPECT_THAT(tree.find(MakeKey(10))->second, testing::ElementsAre(9, 1));
+  EXPECT_THAT(tree.find(MakeKey(11))->second, testing::ElementsAre(9));
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
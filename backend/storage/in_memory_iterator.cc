@@ -45,6 +45,20 @@ const zetasql::Value& FixedRowStorageIterator::ColumnValue(int i) const {
   return GetColumns()[i];
 }
 
+bool FixedRowStorageIterator::NextBatch(int max_rows, Batch* batch) {
+  batch->Reset();
+  while (static_cast<int>(batch->keys.size()) < max_rows &&
+         pos_ + 1 < static_cast<int>(rows_.size())) {
+    const Row& row = rows_[++pos_];
+    batch->columns.resize(row.second.size());
+    batch->keys.push_back(row.first);
+    for (int i = 0; i < row.second.size(); ++i) {
+      batch->columns[i].push_back(row.second[i]);
+    }
+  }
+  return !batch->keys.empty();
+}
+
 }  // namespace backend
 }  // namespace emulator
 }  // namespace spanner
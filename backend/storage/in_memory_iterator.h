@@ -47,6 +47,7 @@ class FixedRowStorageIterator : public StorageIterator {
   const class Key& Key() const override;
   int NumColumns() const override;
   const zetasql::Value& ColumnValue(int i) const override;
+  bool NextBatch(int max_rows, Batch* batch) override;
 
  private:
   const std::vector<zetasql::Value>& GetColumns() const;
@@ -16,13 +16,31 @@
 
 #include "backend/storage/in_memory_storage.h"
 
+#include <algorithm>
+#include <iterator>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "zetasql/base/logging.h"
+#include "zetasql/public/type.h"
 #include "zetasql/public/value.h"
+#include "zlib.h"
 #include "absl/status/status.h"
+#include "absl/hash/hash.h"
+#include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "backend/datamodel/key_encoding.h"
 #include "backend/storage/in_memory_iterator.h"
+#include "backend/storage/key_filter.h"
+#include "common/config.h"
 #include "common/errors.h"
+#include "common/metrics.h"
+#include "zetasql/base/status_macros.h"
 #include "absl/status/status.h"
 
 namespace google {
@@ -32,42 +50,1454 @@ namespace backend {
 
 namespace {
 
-static constexpr char kExistsColumn[] = "_exists";
+// Maximum number of rows copied out of a table each time a TableIterator
+// acquires the table's lock.
+static constexpr int kReadBatchSize = 128;
+
+// Maximum number of read cursors kept per table, see Table::cursors. A few
+// suffice for several clients paging through the same table concurrently.
+static constexpr int kMaxReadCursorsPerTable = 8;
+
+// Maximum number of start key positions cached per table, see
+// Table::positions.
+static constexpr int kMaxCachedPositionsPerTable = 64;
+
+// Number of rows MultiLookup steps forward from its position in a table before
+// it searches the table for the next key. Batches of point keys are often
+// dense (e.g. consecutive ids), in which case the next key is found within a
+// few steps of the previous one.
+static constexpr int kMultiLookupMaxSteps = 4;
+
+// Maximum number of rows visited by garbage collection each time it acquires a
+// table's lock, so that it does not block writers for long.
+static constexpr int kGarbageCollectionBatchSize = 1024;
+
+// Tables are compacted once garbage collection has erased at least this many
+// of their rows since they were last compacted, and at least
+// kMinErasedRowsFractionToCompact of the rows they held, so that tables with
+// a steady trickle of deletes are not rebuilt over and over.
+static constexpr int64_t kMinErasedRowsToCompact = 1024;
+static constexpr double kMinErasedRowsFractionToCompact = 0.5;
+
+// Deletes of key ranges holding at least this many rows record a range
+// tombstone rather than marking each row deleted.
+static constexpr int kMinRowsPerRangeTombstone = 256;
+
+// Maximum number of range tombstones held by a table. Reads and writes check
+// rows against the tombstones of their table, so once a table holds this many,
+// further ranges are deleted row by row until garbage collection drops some.
+static constexpr int kMaxRangeTombstonesPerTable = 16;
+
+// Approximate bytes of bookkeeping of a node of the std::map holding the rows
+// of a table, besides the row and its key.
+static constexpr int64_t kMapNodeOverheadBytes = 32;
+
+// Maximum number of keys sampled per table. Tables with at most this many rows
+// hold the keys of all their rows in their sample.
+static constexpr int kMaxSampledKeysPerTable = 512;
+
+// Longest STRING or BYTES value which is interned. Low-cardinality values are
+// usually short, while long values are rarely repeated.
+static constexpr int kMaxInternedValueBytes = 256;
+
+// Maximum number of distinct values interned per table, which bounds the memory
+// held by dictionaries of columns which turn out to have high cardinality.
+static constexpr int kMaxInternedValuesPerTable = 1 << 16;
+
+// Approximate bytes of bookkeeping of a slot of a dictionary of interned
+// values, besides the value.
+static constexpr int64_t kDictionarySlotOverheadBytes = 8;
+
+// Values are only kept compressed if compression saves at least this fraction
+// of their size, since incompressible payloads would otherwise cost a
+// decompression on each read for little gain.
+static constexpr double kMinCompressionSavings = 0.1;
+
+// Returns the contents of a STRING or BYTES value.
+const std::string& StringOrBytesContents(const zetasql::Value& value) {
+  return value.type_kind() == zetasql::TYPE_STRING ? value.string_value()
+                                                     : value.bytes_value();
+}
+
+// Compresses `contents` into `compressed`. Returns false if compression does
+// not save enough to be worth it.
+bool CompressContents(const std::string& contents, std::string* compressed) {
+  uLongf compressed_size = compressBound(contents.size());
+  compressed->resize(compressed_size);
+  if (compress2(reinterpret_cast<Bytef*>(&(*compressed)[0]), &compressed_size,
+                reinterpret_cast<const Bytef*>(contents.data()),
+                contents.size(), Z_BEST_SPEED) != Z_OK) {
+    return false;
+  }
+  if (compressed_size > contents.size() * (1 - kMinCompressionSavings)) {
+    return false;
+  }
+  compressed->resize(compressed_size);
+  compressed->shrink_to_fit();
+  return true;
+}
+
+// Decompresses `compressed` into `contents`, which must hold `size` bytes.
+bool DecompressContents(const std::string& compressed, size_t size,
+                        std::string* contents) {
+  contents->resize(size);
+  uLongf contents_size = size;
+  return uncompress(reinterpret_cast<Bytef*>(&(*contents)[0]), &contents_size,
+                    reinterpret_cast<const Bytef*>(compressed.data()),
+                    compressed.size()) == Z_OK &&
+         contents_size == size;
+}
 
 }  // namespace
 
-zetasql::Value InMemoryStorage::GetCellValueAtTimestamp(
-    const Row& row, const ColumnID& column_id, absl::Time timestamp) const {
-  // Perform the lookup for given cell.
-  auto cell_itr = row.find(column_id);
-  if (cell_itr == row.end()) {
+// InMemoryStorage::TableIterator yields the rows of a table within a key range
+// as seen at a given timestamp.
+//
+// Rows are copied out of the table in batches while holding the table's reader
+// lock, so peak memory is bounded by the batch size instead of the size of the
+// key range, and the first row is available without scanning the whole range.
+// Insertions do not invalidate std::map iterators, so the position within the
+// table stays valid between batches unless garbage collection erased rows in
+// the meantime (or rows were inserted into a BPlusTree), in which case the
+// iterator seeks back to the next key. Keys are decoded only for the rows
+// yielded.
+//
+// The cells of a batch are kept in a single row-major vector which is reused
+// from batch to batch, so yielding a row allocates nothing beyond its decoded
+// key. Cells are copies of the values in the table, which only share their
+// contents: STRING, BYTES and ARRAY values are reference counted.
+//
+// An iterator destroyed before the end of its key range (e.g. once a read has
+// returned as many rows as its limit allows) leaves a read cursor at the last
+// row it yielded, so that a read of the next page starts there.
+class InMemoryStorage::TableIterator : public StorageIterator {
+ public:
+  TableIterator(std::shared_ptr<const Table> table, absl::Time timestamp,
+                const KeyRange& key_range,
+                const std::vector<ColumnID>& column_ids)
+      : table_(std::move(table)),
+        timestamp_(timestamp),
+        start_key_(EncodeKey(key_range.start_key())),
+        limit_key_(EncodeKey(key_range.limit_key())),
+        column_ids_(column_ids) {}
+
+  ~TableIterator() override {
+    const int batch_size = batch_keys_.size();
+    const bool stopped_early =
+        pos_ >= 0 && pos_ < batch_size && !(done_ && pos_ + 1 == batch_size);
+    if (stopped_early) {
+      AddReadCursor(*table_, batch_rows_[pos_], generation_);
+    }
+  }
+
+  // Implementation of the StorageIterator interface.
+  bool Next() override {
+    if (++pos_ < batch_keys_.size()) {
+      return true;
+    }
+    FetchBatch();
+    pos_ = 0;
+    return !batch_keys_.empty();
+  }
+  absl::Status Status() const override { return absl::OkStatus(); }
+  const class Key& Key() const override { return batch_keys_[pos_]; }
+  int NumColumns() const override { return column_ids_.size(); }
+  const zetasql::Value& ColumnValue(int i) const override {
+    return batch_values_[pos_ * column_ids_.size() + i];
+  }
+
+  // Rows are moved out of the buffered batch rather than copied, which is why
+  // the current row is not valid after this call.
+  bool NextBatch(int max_rows, Batch* batch) override {
+    batch->Reset();
+    batch->columns.resize(column_ids_.size());
+    const int num_columns = column_ids_.size();
+    while (static_cast<int>(batch->keys.size()) < max_rows) {
+      if (++pos_ >= batch_keys_.size()) {
+        FetchBatch();
+        pos_ = 0;
+        if (batch_keys_.empty()) {
+          break;
+        }
+      }
+      batch->keys.push_back(std::move(batch_keys_[pos_]));
+      for (int i = 0; i < num_columns; ++i) {
+        batch->columns[i].push_back(
+            std::move(batch_values_[pos_ * num_columns + i]));
+      }
+    }
+    return !batch->keys.empty();
+  }
+
+ private:
+  // Replaces the current batch with the next rows from the table.
+  void FetchBatch() {
+    batch_keys_.clear();
+    batch_values_.clear();
+    batch_rows_.clear();
+    if (done_) {
+      return;
+    }
+
+    absl::ReaderMutexLock lock(&table_->mu);
+    if (!started_) {
+      row_itr_ = SeekRow(*table_, start_key_);
+      started_ = true;
+    } else if (generation_ != table_->generation) {
+      row_itr_ = table_->rows.lower_bound(next_key_);
+    }
+    generation_ = table_->generation;
+    std::vector<int> slots = GetColumnSlots(*table_, column_ids_);
+    int64_t rows_scanned = 0;
+    while (batch_keys_.size() < kReadBatchSize) {
+      if (row_itr_ == table_->rows.end() ||
+          row_itr_->first >= limit_key_) {
+        done_ = true;
+        break;
+      }
+      ++rows_scanned;
+      const RowVersion* version = VisibleVersionAt(
+          *table_, row_itr_->first, row_itr_->second, timestamp_);
+      if (version != nullptr) {
+        for (int slot : slots) {
+          batch_values_.emplace_back(GetColumnValue(*version, slot));
+        }
+        batch_keys_.push_back(DecodeKey(row_itr_->first));
+        batch_rows_.push_back(row_itr_);
+      }
+      ++row_itr_;
+    }
+    if (row_itr_ == table_->rows.end()) {
+      done_ = true;
+    } else if (!done_) {
+      next_key_ = row_itr_->first;
+    }
+
+    static metrics::Counter* const rows_scanned_counter = metrics::GetCounter(
+        "spanner_emulator_storage_rows_scanned_total",
+        "Number of rows visited by storage reads, including rows which are "
+        "not visible at the read timestamp.");
+    rows_scanned_counter->Increment(rows_scanned);
+  }
+
+  // The table being read, which is kept alive by the iterator even if it is
+  // dropped and garbage collected meanwhile.
+  std::shared_ptr<const Table> table_;
+
+  // The timestamp at which rows are read.
+  const absl::Time timestamp_;
+
+  // The encoded start and limit keys of the range of keys to read.
+  const std::string start_key_;
+  const std::string limit_key_;
+
+  // The columns to read.
+  const std::vector<ColumnID> column_ids_;
+
+  // Position of the next row to visit within the table.
+  Rows::const_iterator row_itr_;
+
+  // Encoded key of the row at row_itr_, used to reposition it if rows were
+  // erased.
+  std::string next_key_;
+
+  // Generation of the table when row_itr_ was last positioned.
+  int64_t generation_ = 0;
+
+  // True once row_itr_ has been positioned at the start of the key range.
+  bool started_ = false;
+
+  // True once all rows in the key range have been visited.
+  bool done_ = false;
+
+  // Rows copied out of the table by the last call to FetchBatch(): their keys,
+  // their cells with NumColumns() cells per row, and their positions within
+  // the table.
+  std::vector<class Key> batch_keys_;
+  std::vector<zetasql::Value> batch_values_;
+  std::vector<Rows::const_iterator> batch_rows_;
+
+  // Index of the current row within batch_keys_.
+  int pos_ = -1;
+};
+
+// InMemoryStorage::InterleavedIterator yields the rows of co-located tables
+// out of an iterator over the stored rows of their interleave root. It skips
+// the rows of the other tables of the root, strips the tags from the keys of
+// the rows it yields, and picks the columns of the table of each row out of
+// those read for all the tables, which are read side by side.
+class InMemoryStorage::InterleavedIterator : public InterleavedStorageIterator {
+ public:
+  InterleavedIterator(std::unique_ptr<StorageIterator> rows,
+                      std::vector<std::shared_ptr<const Interleaving>> tables,
+                      std::vector<int> column_offsets,
+                      std::vector<int> num_columns)
+      : rows_(std::move(rows)),
+        tables_(std::move(tables)),
+        column_offsets_(std::move(column_offsets)),
+        num_columns_(std::move(num_columns)) {}
+
+  // Implementation of the InterleavedStorageIterator interface.
+  bool Next() override {
+    while (rows_->Next()) {
+      for (int i = 0; i < tables_.size(); ++i) {
+        if (IsStoredKeyOf(*tables_[i], rows_->Key())) {
+          table_index_ = i;
+          key_ = FromStoredKey(*tables_[i], rows_->Key());
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+  absl::Status Status() const override { return rows_->Status(); }
+  const class Key& Key() const override { return key_; }
+  int NumColumns() const override { return num_columns_[table_index_]; }
+  const zetasql::Value& ColumnValue(int i) const override {
+    return rows_->ColumnValue(column_offsets_[table_index_] + i);
+  }
+  int TableIndex() const override { return table_index_; }
+
+ private:
+  // The stored rows of the root.
+  std::unique_ptr<StorageIterator> rows_;
+
+  // The tables whose rows are yielded.
+  const std::vector<std::shared_ptr<const Interleaving>> tables_;
+
+  // Position of the first column of each table among those of the stored
+  // rows, and number of columns of each table.
+  const std::vector<int> column_offsets_;
+  const std::vector<int> num_columns_;
+
+  // The table and the key of the current row.
+  int table_index_ = 0;
+  class Key key_;
+};
+
+const InMemoryStorage::RowVersion* InMemoryStorage::VersionAt(
+    const Row& row, absl::Time timestamp) {
+  // Most reads are at recent timestamps, so check the latest version first.
+  if (timestamp >= row.latest.timestamp) {
+    return &row.latest;
+  }
+  auto version_itr = FirstVersionAfter(row, timestamp);
+
+  // Timestamp is earlier than the time the row was first written to.
+  if (version_itr == row.history.begin()) {
+    return nullptr;
+  }
+  return &*(--version_itr);
+}
+
+std::vector<InMemoryStorage::RowVersion>::const_iterator
+InMemoryStorage::FirstVersionAfter(const Row& row, absl::Time timestamp) {
+  return std::upper_bound(row.history.begin(), row.history.end(), timestamp,
+                          [](absl::Time timestamp, const RowVersion& version) {
+                            return timestamp < version.timestamp;
+                          });
+}
+
+bool InMemoryStorage::Exists(const Row& row, absl::Time timestamp) {
+  const RowVersion* version = VersionAt(row, timestamp);
+  return version != nullptr && version->exists;
+}
+
+InMemoryStorage::Rows::const_iterator InMemoryStorage::SeekRow(
+    const Table& table, const std::string& start_key) {
+  static metrics::Counter* const position_hits_counter = metrics::GetCounter(
+      "spanner_emulator_storage_position_cache_hits_total",
+      "Number of storage reads which started at a cached position instead of "
+      "searching the table for their start key.");
+  {
+    absl::MutexLock lock(&table.cursors_mu);
+    for (auto cursor = table.cursors.rbegin(); cursor != table.cursors.rend();
+         ++cursor) {
+      if (cursor->generation != table.generation ||
+          cursor->last_row->first >= start_key) {
+        continue;
+      }
+      // The rows are sorted, so if the row after the last one returned is at
+      // or after the start key, it is the first such row.
+      auto next_row = std::next(cursor->last_row);
+      if (next_row == table.rows.end() || next_row->first >= start_key) {
+        table.cursors.erase(std::next(cursor).base());
+        return next_row;
+      }
+    }
+
+    // The cached row is still the first at or after the start key unless a
+    // row was inserted between the start key and it since.
+    auto position = table.positions.find(start_key);
+    if (position != table.positions.end() &&
+        position->second.generation == table.generation) {
+      Rows::const_iterator row = position->second.row;
+      if ((row == table.rows.end() || row->first >= start_key) &&
+          (row == table.rows.begin() || std::prev(row)->first < start_key)) {
+        table.positions_lru.splice(table.positions_lru.end(),
+                                   table.positions_lru,
+                                   position->second.lru_position);
+        position_hits_counter->Increment();
+        return row;
+      }
+    }
+  }
+
+  // The rows do not change while the table's lock is held, so the table is
+  // searched without holding up other readers of the positions.
+  Rows::const_iterator row = table.rows.lower_bound(start_key);
+  absl::MutexLock lock(&table.cursors_mu);
+  auto position = table.positions.find(start_key);
+  if (position == table.positions.end()) {
+    if (table.positions_lru.size() >= kMaxCachedPositionsPerTable) {
+      table.positions.erase(table.positions_lru.front());
+      table.positions_lru.pop_front();
+    }
+    position = table.positions.emplace(start_key, CachedPosition()).first;
+    table.positions_lru.push_back(start_key);
+    position->second.lru_position = std::prev(table.positions_lru.end());
+  } else {
+    table.positions_lru.splice(table.positions_lru.end(), table.positions_lru,
+                               position->second.lru_position);
+  }
+  position->second.row = row;
+  position->second.generation = table.generation;
+  return row;
+}
+
+void InMemoryStorage::AddReadCursor(const Table& table,
+                                    Rows::const_iterator last_row,
+                                    int64_t generation) {
+  absl::MutexLock lock(&table.cursors_mu);
+  if (table.cursors.size() >= kMaxReadCursorsPerTable) {
+    table.cursors.pop_front();
+  }
+  table.cursors.push_back({last_row, generation});
+}
+
+const InMemoryStorage::RowVersion* InMemoryStorage::VisibleVersionAt(
+    const Table& table, const std::string& encoded_key, const Row& row,
+    absl::Time timestamp) {
+  const RowVersion* version = VersionAt(row, timestamp);
+  if (version == nullptr || !version->exists) {
+    return nullptr;
+  }
+  for (const RangeTombstone& tombstone : table.tombstones) {
+    if (version->timestamp < tombstone.timestamp &&
+        tombstone.timestamp <= timestamp &&
+        encoded_key >= tombstone.start_key &&
+        encoded_key < tombstone.limit_key) {
+      return nullptr;
+    }
+  }
+  return version;
+}
+
+absl::Status InMemoryStorage::ApplyTombstones(Table* table,
+                                              const std::string& encoded_key,
+                                              Row* row, absl::Time timestamp) {
+  if (table->tombstones.empty() || !row->latest.exists) {
+    return absl::OkStatus();
+  }
+  const RangeTombstone* earliest = nullptr;
+  for (const RangeTombstone& tombstone : table->tombstones) {
+    if (row->latest.timestamp < tombstone.timestamp &&
+        tombstone.timestamp <= timestamp &&
+        encoded_key >= tombstone.start_key &&
+        encoded_key < tombstone.limit_key &&
+        (earliest == nullptr || tombstone.timestamp < earliest->timestamp)) {
+      earliest = &tombstone;
+    }
+  }
+  if (earliest == nullptr) {
+    return absl::OkStatus();
+  }
+  return DeleteRow(table, row, earliest->timestamp);
+}
+
+void InMemoryStorage::CollectTombstones(Table* table, absl::Time horizon) {
+  if (table->tombstones.empty()) {
+    return;
+  }
+  std::vector<RangeTombstone> remaining;
+  int64_t pruned_bytes = 0;
+  bool erased = false;
+  for (RangeTombstone& tombstone : table->tombstones) {
+    if (tombstone.timestamp > horizon) {
+      remaining.push_back(std::move(tombstone));
+      continue;
+    }
+    pruned_bytes += TombstoneBytes(tombstone);
+
+    // Rows last written before the tombstone are not visible at or after the
+    // horizon. Rows written since were marked deleted by ApplyTombstones.
+    auto row_itr = table->rows.lower_bound(tombstone.start_key);
+    while (row_itr != table->rows.end() &&
+           row_itr->first < tombstone.limit_key) {
+      if (row_itr->second.latest.timestamp >= tombstone.timestamp) {
+        ++row_itr;
+        continue;
+      }
+      row_itr = EraseRow(table, row_itr, &pruned_bytes);
+      erased = true;
+    }
+  }
+  table->tombstones.swap(remaining);
+  AddBytes(table, -pruned_bytes);
+  if (erased) {
+    ++table->generation;
+    RebuildKeyFilter(table);
+    RebuildKeySample(table);
+  }
+}
+
+bool InMemoryStorage::ShouldCompact(const Table& table) {
+  const int64_t erased_rows = table.rows_erased_since_compaction;
+  return erased_rows >= kMinErasedRowsToCompact &&
+         erased_rows >= kMinErasedRowsFractionToCompact *
+                            (table.rows.size() + erased_rows);
+}
+
+void InMemoryStorage::CompactRows(Table* table) {
+  // Rows are inserted in key order at the end of the new container, which
+  // allocates them in scan order and fills the leaves of a BPlusTree, rather
+  // than leaving them scattered among the holes left by erased rows.
+  Rows compacted;
+  for (auto&& [encoded_key, row] : table->rows) {
+    row.history.shrink_to_fit();
+    compacted.emplace_hint(compacted.end(), encoded_key, std::move(row));
+  }
+  table->rows.swap(compacted);
+  ++table->generation;
+  table->rows_erased_since_compaction = 0;
+  compactions_.fetch_add(1, std::memory_order_relaxed);
+  rows_compacted_.fetch_add(table->rows.size(), std::memory_order_relaxed);
+}
+
+std::vector<int> InMemoryStorage::GetColumnSlots(
+    const Table& table, const std::vector<ColumnID>& column_ids) {
+  std::vector<int> slots;
+  slots.reserve(column_ids.size());
+  for (const ColumnID& column_id : column_ids) {
+    auto slot_itr = table.column_slots.find(column_id);
+    slots.push_back(slot_itr == table.column_slots.end() ? -1
+                                                         : slot_itr->second);
+  }
+  return slots;
+}
+
+zetasql::Value InMemoryStorage::GetColumnValue(const RowVersion& version,
+                                                 int slot) {
+  if (slot < 0 || slot >= version.values.size()) {
     return zetasql::Value();
   }
-  const Cell& cell = cell_itr->second;
-  auto val_itr = cell.upper_bound(timestamp);
+  const zetasql::Value& value = version.values[slot];
+  if (value.is_valid() || version.compressed.empty()) {
+    return value;
+  }
+  return DecompressValue(version, slot);
+}
+
+zetasql::Value InMemoryStorage::DecompressValue(const RowVersion& version,
+                                                  int slot) {
+  for (const CompressedValue& compressed : version.compressed) {
+    if (compressed.slot != slot) {
+      continue;
+    }
+    std::string contents;
+    if (!DecompressContents(*compressed.data, compressed.size, &contents)) {
+      LOG(DFATAL) << "Failed to decompress a value of " << compressed.size
+                  << " bytes";
+      return zetasql::Value();
+    }
+    return compressed.type_kind == zetasql::TYPE_STRING
+               ? zetasql::values::String(std::move(contents))
+               : zetasql::values::Bytes(std::move(contents));
+  }
+  return zetasql::Value();
+}
+
+void InMemoryStorage::CompressValues(RowVersion* version) {
+  if (compression_threshold_bytes_ <= 0) {
+    return;
+  }
+  for (int slot = 0; slot < version->values.size(); ++slot) {
+    zetasql::Value& value = version->values[slot];
+    if (!value.is_valid() || value.is_null() ||
+        (value.type_kind() != zetasql::TYPE_STRING &&
+         value.type_kind() != zetasql::TYPE_BYTES)) {
+      continue;
+    }
+    const std::string& contents = StringOrBytesContents(value);
+    if (contents.size() < compression_threshold_bytes_) {
+      continue;
+    }
+    std::string compressed;
+    if (!CompressContents(contents, &compressed)) {
+      continue;
+    }
+    compressed_values_.fetch_add(1, std::memory_order_relaxed);
+    compressed_bytes_saved_.fetch_add(contents.size() - compressed.size(),
+                                      std::memory_order_relaxed);
+    version->compressed.push_back(CompressedValue{
+        slot, value.type_kind(), contents.size(),
+        std::make_shared<const std::string>(std::move(compressed))});
+    value = zetasql::Value();
+  }
+}
+
+void InMemoryStorage::SetColumnValue(RowVersion* version, int slot,
+                                     const zetasql::Value& value) {
+  if (!version->compressed.empty()) {
+    version->compressed.erase(
+        std::remove_if(version->compressed.begin(), version->compressed.end(),
+                       [slot](const CompressedValue& compressed) {
+                         return compressed.slot == slot;
+                       }),
+        version->compressed.end());
+  }
+  version->values[slot] = value;
+}
+
+size_t InMemoryStorage::InternedValueHash::operator()(
+    const zetasql::Value& value) const {
+  return absl::Hash<std::pair<int, absl::string_view>>()(
+      {value.type_kind(), StringOrBytesContents(value)});
+}
+
+bool InMemoryStorage::InternedValueEq::operator()(
+    const zetasql::Value& a, const zetasql::Value& b) const {
+  return a.type_kind() == b.type_kind() && a.Equals(b);
+}
+
+bool InMemoryStorage::IsInternable(const zetasql::Value& value) {
+  if (!value.is_valid() || value.is_null()) {
+    return false;
+  }
+  switch (value.type_kind()) {
+    case zetasql::TYPE_STRING:
+      return value.string_value().size() <= kMaxInternedValueBytes;
+    case zetasql::TYPE_BYTES:
+      return value.bytes_value().size() <= kMaxInternedValueBytes;
+    default:
+      return false;
+  }
+}
+
+const zetasql::Value& InMemoryStorage::Intern(InternedValues* interned,
+                                                const zetasql::Value& value,
+                                                int64_t* dictionary_bytes) {
+  if (!intern_values_ || !IsInternable(value)) {
+    return value;
+  }
+  auto itr = interned->refs.find(value);
+  if (itr != interned->refs.end()) {
+    ++itr->second;
+    interned_shared_values_.fetch_add(1, std::memory_order_relaxed);
+    interned_bytes_saved_.fetch_add(
+        std::max<int64_t>(static_cast<int64_t>(value.physical_byte_size()) -
+                              static_cast<int64_t>(sizeof(zetasql::Value)),
+                          0),
+        std::memory_order_relaxed);
+    return itr->first;
+  }
+  if (interned->full) {
+    return value;
+  }
+  const int64_t entry_bytes =
+      value.physical_byte_size() + kDictionarySlotOverheadBytes;
+  interned->bytes += entry_bytes;
+  *dictionary_bytes += entry_bytes;
+  interned->full = interned->refs.size() + 1 >= kMaxInternedValuesPerTable;
+  interned_distinct_values_.fetch_add(1, std::memory_order_relaxed);
+  return interned->refs.emplace(value, 1).first->first;
+}
+
+void InMemoryStorage::Release(InternedValues* interned,
+                              const zetasql::Value& value,
+                              int64_t* dictionary_bytes) {
+  if (interned->refs.empty() || !IsInternable(value)) {
+    return;
+  }
+  auto itr = interned->refs.find(value);
+  if (itr == interned->refs.end() || --itr->second > 0) {
+    return;
+  }
+  const int64_t entry_bytes =
+      itr->first.physical_byte_size() + kDictionarySlotOverheadBytes;
+  interned->bytes -= entry_bytes;
+  *dictionary_bytes -= entry_bytes;
+  interned->refs.erase(itr);
+  interned_distinct_values_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void InMemoryStorage::Release(InternedValues* interned,
+                              const RowVersion& version,
+                              int64_t* dictionary_bytes) {
+  for (const zetasql::Value& value : version.values) {
+    Release(interned, value, dictionary_bytes);
+  }
+}
+
+void InMemoryStorage::Retain(InternedValues* interned,
+                             const RowVersion& version) {
+  if (interned->refs.empty()) {
+    return;
+  }
+  for (const zetasql::Value& value : version.values) {
+    if (IsInternable(value)) {
+      auto itr = interned->refs.find(value);
+      if (itr != interned->refs.end()) {
+        ++itr->second;
+      }
+    }
+  }
+}
+
+zetasql_base::StatusOr<InMemoryStorage::RowVersion*>
+InMemoryStorage::MutableVersionAt(Row* row, absl::Time timestamp) {
+  RowVersion& latest = row->latest;
+  if (timestamp < latest.timestamp) {
+    return error::Internal(absl::StrCat(
+        "InMemoryStorage cannot write at timestamp ",
+        absl::FormatTime(timestamp), " which is older than the latest version ",
+        "of the row at ", absl::FormatTime(latest.timestamp)));
+  }
+
+  // Writes at the timestamp of the latest version overwrite it in place.
+  if (timestamp > latest.timestamp) {
+    if (latest.timestamp != absl::InfinitePast()) {
+      row->history.push_back(latest);
+    }
+    latest.timestamp = timestamp;
+  }
+  return &latest;
+}
+
+bool InMemoryStorage::PruneVersions(InternedValues* interned, Row* row,
+                                    absl::Time horizon,
+                                    int64_t* pruned_bytes) {
+  // The bytes of a version are those of its values as interned, so they are
+  // computed before the values are released.
+  auto prune = [&](const RowVersion& version) {
+    const int64_t version_bytes = VersionBytes(*interned, version);
+    int64_t dictionary_bytes = 0;
+    Release(interned, version, &dictionary_bytes);
+    *pruned_bytes += version_bytes - dictionary_bytes;
+  };
+
+  // Reads at or after the horizon see the latest version or not the row at all.
+  if (horizon >= row->latest.timestamp) {
+    if (!row->history.empty()) {
+      for (const RowVersion& version : row->history) {
+        prune(version);
+      }
+      std::vector<RowVersion>().swap(row->history);
+    }
+    return !row->latest.exists;
+  }
+
+  // Keep the newest version at or before the horizon, since it is visible to
+  // reads at the horizon. A row without versions at a timestamp reads as not
+  // existing, so that version can be dropped as well if it is a delete.
+  auto version_itr = FirstVersionAfter(*row, horizon);
+  if (version_itr == row->history.begin()) {
+    return false;
+  }
+  --version_itr;
+  if (!version_itr->exists) {
+    ++version_itr;
+  }
+  for (auto itr = row->history.cbegin(); itr != version_itr; ++itr) {
+    prune(*itr);
+  }
+  row->history.erase(row->history.cbegin(), version_itr);
+  return false;
+}
+
+int64_t InMemoryStorage::ValueBytes(const InternedValues& interned,
+                                    const zetasql::Value& value) {
+  if (!value.is_valid()) {
+    return sizeof(zetasql::Value);
+  }
+  if (!interned.refs.empty() && IsInternable(value) &&
+      interned.refs.contains(value)) {
+    return sizeof(zetasql::Value);
+  }
+  return value.physical_byte_size();
+}
+
+int64_t InMemoryStorage::VersionBytes(const InternedValues& interned,
+                                      const RowVersion& version) {
+  int64_t bytes = sizeof(RowVersion);
+  for (const zetasql::Value& value : version.values) {
+    bytes += ValueBytes(interned, value);
+  }
+  for (const CompressedValue& compressed : version.compressed) {
+    bytes += sizeof(CompressedValue) + sizeof(std::string) +
+             compressed.data->size();
+  }
+  return bytes;
+}
+
+int64_t InMemoryStorage::RowBytes(const InternedValues& interned,
+                                  const std::string& encoded_key,
+                                  const Row& row) {
+  int64_t bytes = kMapNodeOverheadBytes + sizeof(std::string) +
+                  encoded_key.size() + sizeof(std::vector<RowVersion>) +
+                  VersionBytes(interned, row.latest);
+  for (const RowVersion& version : row.history) {
+    bytes += VersionBytes(interned, version);
+  }
+  return bytes;
+}
+
+int64_t InMemoryStorage::TombstoneBytes(const RangeTombstone& tombstone) {
+  return sizeof(RangeTombstone) + tombstone.start_key.size() +
+         tombstone.limit_key.size();
+}
+
+int64_t InMemoryStorage::ChangedBytes(const InternedValues& interned,
+                                      const Row& row, int64_t latest_bytes,
+                                      size_t history_size) {
+  // A write either modifies the latest version in place, or first pushes it
+  // to the history.
+  int64_t delta = VersionBytes(interned, row.latest) - latest_bytes;
+  if (row.history.size() > history_size) {
+    delta += VersionBytes(interned, row.history.back());
+  }
+  return delta;
+}
+
+void InMemoryStorage::AddBytes(Table* table, int64_t delta) {
+  if (delta != 0) {
+    table->bytes.fetch_add(delta, std::memory_order_relaxed);
+    total_bytes_.fetch_add(delta, std::memory_order_relaxed);
+  }
+}
+
+void InMemoryStorage::RecordChange(Table* table, absl::Time timestamp) {
+  table->version.change =
+      num_changes_.fetch_add(1, std::memory_order_relaxed) + 1;
+  table->version.max_change_timestamp =
+      std::max(table->version.max_change_timestamp, timestamp);
+}
+
+absl::optional<TableVersion> InMemoryStorage::GetTableVersion(
+    const TableID& table_id) const {
+  std::shared_ptr<const Interleaving> interleaving = FindInterleaving(table_id);
+  return GetTableVersionStored(interleaving == nullptr ? table_id
+                                                       : interleaving->root_id);
+}
+
+absl::optional<TableVersion> InMemoryStorage::GetTableVersionStored(
+    const TableID& table_id) const {
+  std::shared_ptr<Table> table = FindTable(table_id);
+  if (table == nullptr) {
+    // A table which does not exist has no rows, as a table which was never
+    // written to, unless it was dropped.
+    absl::ReaderMutexLock lock(&mu_);
+    auto itr = dropped_versions_.find(table_id);
+    return itr == dropped_versions_.end() ? TableVersion() : itr->second;
+  }
+  absl::ReaderMutexLock lock(&table->mu);
+  return table->version;
+}
+
+zetasql_base::StatusOr<bool> InMemoryStorage::ChangedSince(
+    absl::Time timestamp, const TableID& table_id,
+    const KeyRange& key_range) const {
+  // Ranges which are not ClosedOpen are rejected by ChangedSinceStored. Rows
+  // of other tables within the stored range count as changes, which is only
+  // a false positive.
+  std::shared_ptr<const Interleaving> interleaving = FindInterleaving(table_id);
+  if (interleaving == nullptr || !key_range.IsClosedOpen()) {
+    return ChangedSinceStored(timestamp, table_id, key_range);
+  }
+  return ChangedSinceStored(timestamp, interleaving->root_id,
+                            ToStoredRange(*interleaving, key_range));
+}
+
+zetasql_base::StatusOr<bool> InMemoryStorage::ChangedSinceStored(
+    absl::Time timestamp, const TableID& table_id,
+    const KeyRange& key_range) const {
+  if (!key_range.IsClosedOpen()) {
+    return error::Internal(
+        absl::StrCat("InMemoryStorage::ChangedSince should be called "
+                     "with ClosedOpen key range, found: ",
+                     key_range.DebugString()));
+  }
+  std::shared_ptr<const Table> table = FindTable(table_id);
+  if (table == nullptr) {
+    absl::optional<TableVersion> version = GetTableVersionStored(table_id);
+    return version->max_change_timestamp > timestamp;
+  }
+  // Rows of a table dropped since the timestamp are all gone, even if the
+  // table was recreated.
+  if (FindTable(table_id, timestamp) != table) {
+    return true;
+  }
+  if (key_range.start_key() >= key_range.limit_key()) {
+    return false;
+  }
+
+  const std::string start_key = EncodeKey(key_range.start_key());
+  const std::string limit_key = EncodeKey(key_range.limit_key());
+  absl::ReaderMutexLock lock(&table->mu);
+  if (table->version.max_change_timestamp <= timestamp) {
+    return false;
+  }
+  for (const RangeTombstone& tombstone : table->tombstones) {
+    if (tombstone.timestamp > timestamp && tombstone.start_key < limit_key &&
+        start_key < tombstone.limit_key) {
+      return true;
+    }
+  }
+  // The latest version of a row is its most recent write or delete, so rows
+  // erased by garbage collection were last changed before the timestamp.
+  const auto row_end_itr = table->rows.lower_bound(limit_key);
+  for (auto row_itr = table->rows.lower_bound(start_key);
+       row_itr != row_end_itr; ++row_itr) {
+    if (row_itr->second.latest.timestamp > timestamp) {
+      return true;
+    }
+  }
+  return false;
+}
+
+absl::optional<TableStatistics> InMemoryStorage::GetTableStatistics(
+    const TableID& table_id) const {
+  std::shared_ptr<const Interleaving> interleaving = FindInterleaving(table_id);
+  if (interleaving == nullptr) {
+    return GetTableStatisticsStored(table_id);
+  }
+  // The sample of the root's keys is uniform over the rows of all its tables,
+  // so the rows and bytes of the table are estimated from its share of it.
+  absl::optional<TableStatistics> statistics =
+      GetTableStatisticsStored(interleaving->root_id);
+  if (statistics.has_value() && !statistics->sample_keys.empty()) {
+    const double num_sampled = statistics->sample_keys.size();
+    ToKeysOf(*interleaving, &statistics->sample_keys);
+    const double share = statistics->sample_keys.size() / num_sampled;
+    statistics->num_rows = static_cast<int64_t>(statistics->num_rows * share);
+    statistics->bytes = static_cast<int64_t>(statistics->bytes * share);
+  }
+  return statistics;
+}
+
+absl::optional<TableStatistics> InMemoryStorage::GetTableStatisticsStored(
+    const TableID& table_id) const {
+  TableStatistics statistics;
+  std::shared_ptr<Table> table = FindTable(table_id);
+  if (table == nullptr) {
+    return statistics;
+  }
+  std::vector<std::string> encoded_keys;
+  {
+    absl::ReaderMutexLock lock(&table->mu);
+    statistics.num_rows = table->rows.size();
+    statistics.bytes = table->bytes.load(std::memory_order_relaxed);
+    encoded_keys.reserve(table->key_sample.size());
+    for (const auto& [hash, encoded_key] : table->key_sample) {
+      encoded_keys.push_back(encoded_key);
+    }
+  }
+  // Encoded keys sort in the order of the keys they encode.
+  std::sort(encoded_keys.begin(), encoded_keys.end());
+  statistics.sample_keys.reserve(encoded_keys.size());
+  for (const std::string& encoded_key : encoded_keys) {
+    statistics.sample_keys.push_back(DecodeKey(encoded_key));
+  }
+  return statistics;
+}
+
+absl::flat_hash_map<TableID, int64_t> InMemoryStorage::TableBytes() const {
+  absl::flat_hash_map<TableID, int64_t> table_bytes;
+  absl::ReaderMutexLock lock(&mu_);
+  for (const auto& [table_id, table] : tables_) {
+    table_bytes[table_id] = table->bytes.load(std::memory_order_relaxed);
+  }
+  return table_bytes;
+}
+
+InMemoryStorage::InMemoryStorage()
+    : InMemoryStorage(config::storage_key_filters_enabled()) {}
+
+InMemoryStorage::InMemoryStorage(bool use_key_filters)
+    : InMemoryStorage(use_key_filters,
+                      config::storage_value_interning_enabled()) {}
+
+InMemoryStorage::InMemoryStorage(bool use_key_filters, bool intern_values)
+    : InMemoryStorage(use_key_filters, intern_values,
+                      config::storage_compression_threshold_bytes()) {}
+
+InMemoryStorage::InMemoryStorage(bool use_key_filters, bool intern_values,
+                                 int64_t compression_threshold_bytes)
+    : InMemoryStorage(use_key_filters, intern_values,
+                      compression_threshold_bytes,
+                      config::storage_interleaved_layout_enabled()) {}
+
+InMemoryStorage::InMemoryStorage(bool use_key_filters, bool intern_values,
+                                 int64_t compression_threshold_bytes,
+                                 bool colocate_interleaved_tables)
+    : use_key_filters_(use_key_filters),
+      intern_values_(intern_values),
+      compression_threshold_bytes_(compression_threshold_bytes),
+      colocate_interleaved_tables_(colocate_interleaved_tables) {}
+
+bool InMemoryStorage::MayContain(const Table& table, const Key& prefix) const {
+  if (!use_key_filters_) {
+    return true;
+  }
+  key_filter_probes_.fetch_add(1, std::memory_order_relaxed);
+  if (table.key_filter.MayContain(prefix)) {
+    return true;
+  }
+  key_filter_negatives_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void InMemoryStorage::AddToKeyFilter(Table* table, const Key& key) const {
+  if (!use_key_filters_) {
+    return;
+  }
+  table->key_filter.Add(key);
+  if (table->key_filter.IsFull()) {
+    RebuildKeyFilter(table);
+  }
+}
+
+void InMemoryStorage::RebuildKeyFilter(Table* table) const {
+  if (!use_key_filters_) {
+    return;
+  }
+  int64_t num_prefixes = 0;
+  std::vector<Key> keys;
+  keys.reserve(table->rows.size());
+  for (const auto& [encoded_key, row] : table->rows) {
+    keys.push_back(DecodeKey(encoded_key));
+    num_prefixes += keys.back().NumColumns();
+  }
+  table->key_filter = KeyFilter(2 * num_prefixes);
+  for (const Key& key : keys) {
+    table->key_filter.Add(key);
+  }
+}
+
+void InMemoryStorage::AddToKeySample(Table* table,
+                                     const std::string& encoded_key) {
+  const size_t hash = absl::Hash<std::string>()(encoded_key);
+  if (table->key_sample.size() >= kMaxSampledKeysPerTable) {
+    auto last_itr = std::prev(table->key_sample.end());
+    if (hash >= last_itr->first) {
+      return;
+    }
+    table->key_sample.erase(last_itr);
+  }
+  table->key_sample.emplace(hash, encoded_key);
+}
+
+void InMemoryStorage::RebuildKeySample(Table* table) {
+  table->key_sample.clear();
+  for (const auto& [encoded_key, row] : table->rows) {
+    AddToKeySample(table, encoded_key);
+  }
+}
+
+InMemoryStorage::KeyFilterStats InMemoryStorage::key_filter_stats() const {
+  KeyFilterStats stats;
+  stats.probes = key_filter_probes_.load(std::memory_order_relaxed);
+  stats.negatives = key_filter_negatives_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+InMemoryStorage::InterningStats InMemoryStorage::interning_stats() const {
+  InterningStats stats;
+  stats.distinct_values =
+      interned_distinct_values_.load(std::memory_order_relaxed);
+  stats.shared_values = interned_shared_values_.load(std::memory_order_relaxed);
+  stats.bytes_saved = interned_bytes_saved_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+InMemoryStorage::CompressionStats InMemoryStorage::compression_stats() const {
+  CompressionStats stats;
+  stats.compressed_values = compressed_values_.load(std::memory_order_relaxed);
+  stats.bytes_saved = compressed_bytes_saved_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+InMemoryStorage::CompactionStats InMemoryStorage::compaction_stats() const {
+  CompactionStats stats;
+  stats.compactions = compactions_.load(std::memory_order_relaxed);
+  stats.rows_compacted = rows_compacted_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+std::shared_ptr<InMemoryStorage::Table> InMemoryStorage::FindTable(
+    const TableID& table_id, absl::Time timestamp) const {
+  absl::ReaderMutexLock lock(&mu_);
+  if (!dropped_tables_.empty()) {
+    auto dropped_itr = dropped_tables_.find(table_id);
+    if (dropped_itr != dropped_tables_.end()) {
+      for (const DroppedTable& dropped : dropped_itr->second) {
+        if (timestamp < dropped.timestamp) {
+          return dropped.table;
+        }
+      }
+    }
+  }
+  auto table_itr = tables_.find(table_id);
+  if (table_itr == tables_.end()) {
+    return nullptr;
+  }
+  return table_itr->second;
+}
+
+std::vector<std::pair<TableID, std::shared_ptr<InMemoryStorage::Table>>>
+InMemoryStorage::TablesAt(absl::Time timestamp) const {
+  std::vector<TableID> table_ids;
+  {
+    absl::ReaderMutexLock lock(&mu_);
+    for (const auto& [table_id, table] : tables_) {
+      table_ids.push_back(table_id);
+    }
+    for (const auto& [table_id, dropped] : dropped_tables_) {
+      if (!tables_.contains(table_id)) {
+        table_ids.push_back(table_id);
+      }
+    }
+  }
+  std::vector<std::pair<TableID, std::shared_ptr<Table>>> tables;
+  for (const TableID& table_id : table_ids) {
+    std::shared_ptr<Table> table = FindTable(table_id, timestamp);
+    if (table != nullptr) {
+      tables.emplace_back(table_id, std::move(table));
+    }
+  }
+  return tables;
+}
+
+InMemoryStorage::Table* InMemoryStorage::FindOrCreateTable(
+    const TableID& table_id) {
+  {
+    absl::ReaderMutexLock lock(&mu_);
+    auto table_itr = tables_.find(table_id);
+    if (table_itr != tables_.end()) {
+      return table_itr->second.get();
+    }
+  }
+  absl::MutexLock lock(&mu_);
+  std::shared_ptr<Table>& table = tables_[table_id];
+  if (table == nullptr) {
+    table = std::make_shared<Table>();
+    auto itr = dropped_versions_.find(table_id);
+    if (itr != dropped_versions_.end()) {
+      absl::MutexLock table_lock(&table->mu);
+      table->version = itr->second;
+      dropped_versions_.erase(itr);
+    }
+  }
+  return table.get();
+}
+
+std::shared_ptr<const InMemoryStorage::Interleaving>
+InMemoryStorage::FindInterleaving(const TableID& table_id,
+                                  absl::Time timestamp) const {
+  if (!colocate_interleaved_tables_) {
+    return nullptr;
+  }
+  absl::ReaderMutexLock lock(&mu_);
+  auto itr = interleavings_.find(table_id);
+  if (itr == interleavings_.end() ||
+      itr->second->drop_timestamp <= timestamp) {
+    return nullptr;
+  }
+  return itr->second;
+}
+
+std::vector<std::shared_ptr<const InMemoryStorage::Interleaving>>
+InMemoryStorage::DroppedInterleavings(const TableID& root_id,
+                                      absl::Time timestamp) const {
+  std::vector<std::shared_ptr<const Interleaving>> dropped;
+  if (!colocate_interleaved_tables_) {
+    return dropped;
+  }
+  absl::ReaderMutexLock lock(&mu_);
+  for (const auto& [table_id, interleaving] : interleavings_) {
+    if (interleaving->root_id == root_id && !interleaving->tags.empty() &&
+        interleaving->drop_timestamp <= timestamp) {
+      dropped.push_back(interleaving);
+    }
+  }
+  return dropped;
+}
+
+Key InMemoryStorage::ToStoredKey(const Interleaving& interleaving,
+                                 const Key& key) {
+  if (interleaving.tags.empty() || key.IsInfinity()) {
+    return key;
+  }
+  Key stored_key;
+  int tag = 0;
+  for (int i = 0; i <= key.NumColumns(); ++i) {
+    while (tag < interleaving.tags.size() &&
+           interleaving.boundaries[tag] == i) {
+      stored_key.AddColumn(zetasql::Value::Int64(interleaving.tags[tag++]));
+    }
+    if (i < key.NumColumns()) {
+      stored_key.AddColumn(key.ColumnValue(i), key.IsColumnDescending(i));
+    }
+  }
+  return key.IsPrefixLimit() ? stored_key.ToPrefixLimit() : stored_key;
+}
+
+KeyRange InMemoryStorage::ToStoredRange(const Interleaving& interleaving,
+                                        const KeyRange& key_range) {
+  return KeyRange(key_range.start_type(),
+                  ToStoredKey(interleaving, key_range.start_key()),
+                  key_range.limit_type(),
+                  ToStoredKey(interleaving, key_range.limit_key()));
+}
+
+bool InMemoryStorage::IsStoredKeyOf(const Interleaving& interleaving,
+                                    const Key& stored_key) {
+  if (stored_key.NumColumns() !=
+      interleaving.num_key_columns + interleaving.tags.size()) {
+    return false;
+  }
+  // The tags of the ancestors are checked from the root down, since the
+  // positions of the tags of a row depend on those of the tables above.
+  for (int i = 0; i < interleaving.tags.size(); ++i) {
+    const zetasql::Value& tag =
+        stored_key.ColumnValue(interleaving.boundaries[i] + i);
+    if (tag.type_kind() != zetasql::TYPE_INT64 || tag.is_null() ||
+        tag.int64_value() != interleaving.tags[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Key InMemoryStorage::FromStoredKey(const Interleaving& interleaving,
+                                   const Key& stored_key) {
+  if (interleaving.tags.empty()) {
+    return stored_key;
+  }
+  Key key;
+  int tag = 0;
+  for (int i = 0; i < stored_key.NumColumns(); ++i) {
+    if (tag < interleaving.tags.size() &&
+        i == interleaving.boundaries[tag] + tag) {
+      ++tag;
+      continue;
+    }
+    key.AddColumn(stored_key.ColumnValue(i), stored_key.IsColumnDescending(i));
+  }
+  return key;
+}
+
+bool InMemoryStorage::IsStoredKeyOfAny(
+    const std::vector<std::shared_ptr<const Interleaving>>& interleavings,
+    const std::string& encoded_key) {
+  if (interleavings.empty()) {
+    return false;
+  }
+  const Key stored_key = DecodeKey(encoded_key);
+  for (const std::shared_ptr<const Interleaving>& interleaving :
+       interleavings) {
+    if (IsStoredKeyOf(*interleaving, stored_key)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void InMemoryStorage::ToKeysOf(const Interleaving& interleaving,
+                               std::vector<Key>* stored_keys) {
+  auto keys_end = stored_keys->begin();
+  for (Key& stored_key : *stored_keys) {
+    if (IsStoredKeyOf(interleaving, stored_key)) {
+      *keys_end++ = FromStoredKey(interleaving, stored_key);
+    }
+  }
+  stored_keys->erase(keys_end, stored_keys->end());
+}
+
+bool InMemoryStorage::IsUnderSingleParent(const Interleaving& interleaving,
+                                          const KeyRange& stored_range) {
+  // The rows of the root within a range are followed by their descendants.
+  if (interleaving.tags.empty()) {
+    return true;
+  }
+  const Key& start_key = stored_range.start_key();
+  const Key& limit_key = stored_range.limit_key();
+  const int num_columns =
+      interleaving.boundaries.back() + interleaving.tags.size();
+  if (start_key.NumColumns() < num_columns ||
+      limit_key.NumColumns() < num_columns) {
+    return false;
+  }
+  for (int i = 0; i < num_columns; ++i) {
+    if (!start_key.ColumnValue(i).Equals(limit_key.ColumnValue(i))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+absl::Status InMemoryStorage::DeleteRowsOf(absl::Time timestamp,
+                                           const Interleaving& interleaving,
+                                           const KeyRange& stored_range,
+                                           bool with_descendants) {
+  if (stored_range.start_key() >= stored_range.limit_key()) {
+    return absl::OkStatus();
+  }
+  std::shared_ptr<Table> found_table = FindTable(interleaving.root_id);
+  if (found_table == nullptr) {
+    return absl::OkStatus();
+  }
+  Table* table = found_table.get();
+  absl::MutexLock lock(&table->mu);
+  const std::string limit_key = EncodeKey(stored_range.limit_key());
+  auto row_itr = table->rows.lower_bound(EncodeKey(stored_range.start_key()));
+  if (row_itr == table->rows.end() || row_itr->first >= limit_key) {
+    return absl::OkStatus();
+  }
+  RecordChange(table, timestamp);
+
+  // The encoded keys of the rows interleaved in a row are prefixed by its
+  // own, and directly follow it.
+  std::string deleted_key;
+  bool in_deleted_subtree = false;
+  while (row_itr != table->rows.end()) {
+    if (in_deleted_subtree && absl::StartsWith(row_itr->first, deleted_key)) {
+      ZETASQL_RETURN_IF_ERROR(DeleteRow(table, &row_itr->second, timestamp));
+      ++row_itr;
+      continue;
+    }
+    in_deleted_subtree = false;
+    if (row_itr->first >= limit_key) {
+      break;
+    }
+    const Key stored_key = DecodeKey(row_itr->first);
+    if (!IsStoredKeyOf(interleaving, stored_key)) {
+      ++row_itr;
+      continue;
+    }
+    ZETASQL_RETURN_IF_ERROR(DeleteRow(table, &row_itr->second, timestamp));
+    if (with_descendants) {
+      deleted_key = row_itr->first;
+      in_deleted_subtree = true;
+      ++row_itr;
+    } else {
+      row_itr =
+          table->rows.lower_bound(EncodeKey(stored_key.ToPrefixLimit()));
+    }
+  }
+  return absl::OkStatus();
+}
+
+InMemoryStorage::Rows::iterator InMemoryStorage::EraseRow(
+    Table* table, Rows::iterator row_itr, int64_t* pruned_bytes) {
+  const Row& row = row_itr->second;
+  *pruned_bytes += RowBytes(table->interned, row_itr->first, row);
+  int64_t dictionary_bytes = 0;
+  for (const RowVersion& version : row.history) {
+    Release(&table->interned, version, &dictionary_bytes);
+  }
+  Release(&table->interned, row.latest, &dictionary_bytes);
+  *pruned_bytes -= dictionary_bytes;
+  ++table->rows_erased_since_compaction;
+  return table->rows.erase(row_itr);
+}
+
+absl::Status InMemoryStorage::InterleaveTable(const TableID& child_id,
+                                              const TableID& parent_id,
+                                              int num_key_columns,
+                                              int num_parent_key_columns) {
+  if (!colocate_interleaved_tables_) {
+    return absl::OkStatus();
+  }
+  absl::MutexLock lock(&mu_);
+  auto child_itr = interleavings_.find(child_id);
+  if (child_itr != interleavings_.end()) {
+    if (child_itr->second->parent_id == parent_id) {
+      return absl::OkStatus();
+    }
+    return error::Internal(absl::StrCat(
+        "InMemoryStorage cannot interleave table ", child_id, " in ",
+        parent_id,
+        " since it is an interleave root or is interleaved in another table"));
+  }
+  if (tables_.contains(child_id) || dropped_tables_.contains(child_id)) {
+    return error::Internal(
+        absl::StrCat("InMemoryStorage cannot interleave table ", child_id,
+                     " in ", parent_id, " since it already has rows"));
+  }
 
-  // Timestamp is earlier than the time the cell was first written to.
-  if (val_itr == cell.begin()) {
-    return zetasql::Value();
+  auto parent = std::make_shared<Interleaving>();
+  auto parent_itr = interleavings_.find(parent_id);
+  if (parent_itr == interleavings_.end()) {
+    parent->root_id = parent_id;
+    parent->num_key_columns = num_parent_key_columns;
+  } else {
+    *parent = *parent_itr->second;
+  }
+  if (parent->num_key_columns != num_parent_key_columns ||
+      num_key_columns < num_parent_key_columns) {
+    return error::Internal(absl::StrCat(
+        "InMemoryStorage cannot interleave table ", child_id, " in ",
+        parent_id, " since the keys of the parent do not prefix its own"));
   }
+  parent->has_children = true;
 
-  // Fetch the value from the column.
-  --val_itr;
-  return val_itr->second;
+  auto child = std::make_shared<Interleaving>();
+  child->root_id = parent->root_id;
+  child->parent_id = parent_id;
+  child->num_key_columns = num_key_columns;
+  child->boundaries = parent->boundaries;
+  child->boundaries.push_back(num_parent_key_columns);
+  child->tags = parent->tags;
+  child->tags.push_back(next_interleave_tag_++);
+  interleavings_[parent_id] = std::move(parent);
+  interleavings_[child_id] = std::move(child);
+  return absl::OkStatus();
 }
 
-bool InMemoryStorage::Exists(const Row& row, absl::Time timestamp) const {
-  zetasql::Value value =
-      GetCellValueAtTimestamp(row, kExistsColumn, timestamp);
-  return value.is_valid() && value.bool_value();
+absl::Status InMemoryStorage::Lookup(
+    absl::Time timestamp, const TableID& table_id, const Key& key,
+    const std::vector<ColumnID>& column_ids,
+    std::vector<zetasql::Value>* values) const {
+  ZETASQL_ASSIGN_OR_RETURN(bool exists, LookupIfExists(timestamp, table_id, key,
+                                               column_ids, values));
+  if (!exists) {
+    return absl::Status(
+        absl::StatusCode::kNotFound,
+        absl::StrCat("Key: ", key.DebugString(), " not found for table: ",
+                     table_id, " at timestamp: ", absl::FormatTime(timestamp)));
+  }
+  return absl::OkStatus();
 }
 
-absl::Status InMemoryStorage::Lookup(
+zetasql_base::StatusOr<bool> InMemoryStorage::LookupIfExists(
     absl::Time timestamp, const TableID& table_id, const Key& key,
     const std::vector<ColumnID>& column_ids,
     std::vector<zetasql::Value>* values) const {
-  absl::MutexLock lock(&mu_);
+  std::shared_ptr<const Interleaving> interleaving =
+      FindInterleaving(table_id, timestamp);
+  if (interleaving == nullptr) {
+    return LookupIfExistsStored(timestamp, table_id, key, column_ids, values);
+  }
+  return LookupIfExistsStored(timestamp, interleaving->root_id,
+                              ToStoredKey(*interleaving, key), column_ids,
+                              values);
+}
 
+zetasql_base::StatusOr<bool> InMemoryStorage::LookupIfExistsStored(
+    absl::Time timestamp, const TableID& table_id, const Key& key,
+    const std::vector<ColumnID>& column_ids,
+    std::vector<zetasql::Value>* values) const {
   // Validate the request.
   if (!column_ids.empty() && values == nullptr) {
     return error::Internal(
@@ -79,54 +1509,122 @@ absl::Status InMemoryStorage::Lookup(
   }
 
   // Lookup for given table.
-  auto table_itr = tables_.find(table_id);
-  if (table_itr == tables_.end()) {
-    return absl::Status(
-        absl::StatusCode::kNotFound,
-        absl::StrCat("Key: ", key.DebugString(), " not found for table: ",
-                     table_id, " at timestamp: ", absl::FormatTime(timestamp)));
+  std::shared_ptr<const Table> table = FindTable(table_id, timestamp);
+  if (table == nullptr) {
+    return false;
   }
-  const Table& table = table_itr->second;
+  absl::ReaderMutexLock lock(&table->mu);
 
-  // Lookup for given key.
-  auto row_itr = table.find(key);
-  if (row_itr == table.end()) {
-    return absl::Status(
-        absl::StatusCode::kNotFound,
-        absl::StrCat("Key: ", key.DebugString(), " not found for table: ",
-                     table_id, " at timestamp: ", absl::FormatTime(timestamp)));
+  // Lookup for given key, unless the key filter rules it out.
+  auto row_itr = MayContain(*table, key) ? table->rows.find(EncodeKey(key))
+                                         : table->rows.end();
+  if (row_itr == table->rows.end()) {
+    return false;
   }
-  const Row& row = row_itr->second;
 
   // Verify if the row exists at the given timestamp.
-  if (!Exists(row, timestamp)) {
-    return absl::Status(
-        absl::StatusCode::kNotFound,
-        absl::StrCat(
-            "Key: ", key.DebugString(), " does not exist for table: ", table_id,
-            " at the given timestamp: " + absl::FormatTime(timestamp)));
+  const RowVersion* version =
+      VisibleVersionAt(*table, row_itr->first, row_itr->second, timestamp);
+  if (version == nullptr) {
+    return false;
   }
 
-  // For request without columns, return ok since the key exist.
+  // For request without columns, return true since the key exist.
   if (column_ids.empty()) {
-    return absl::OkStatus();
+    return true;
   }
 
-  // Fetch the value from the cell at the given timestamp.
-  for (int i = 0; i < column_ids.size(); ++i) {
-    values->emplace_back(
-        GetCellValueAtTimestamp(row, column_ids[i], timestamp));
+  // Fetch the column values from the version at the given timestamp.
+  values->reserve(column_ids.size());
+  for (int slot : GetColumnSlots(*table, column_ids)) {
+    values->emplace_back(GetColumnValue(*version, slot));
   }
 
-  return absl::OkStatus();
+  return true;
 }
 
 absl::Status InMemoryStorage::Read(
     absl::Time timestamp, const TableID& table_id, const KeyRange& key_range,
     const std::vector<ColumnID>& column_ids,
     std::unique_ptr<StorageIterator>* itr) const {
-  absl::MutexLock lock(&mu_);
+  // Ranges which are not ClosedOpen are rejected by ReadStored.
+  std::shared_ptr<const Interleaving> interleaving =
+      FindInterleaving(table_id, timestamp);
+  if (interleaving == nullptr || !key_range.IsClosedOpen()) {
+    return ReadStored(timestamp, table_id, key_range, column_ids, itr);
+  }
+  std::unique_ptr<StorageIterator> rows;
+  ZETASQL_RETURN_IF_ERROR(ReadStored(timestamp, interleaving->root_id,
+                             ToStoredRange(*interleaving, key_range),
+                             column_ids, &rows));
+  *itr = absl::make_unique<InterleavedIterator>(
+      std::move(rows),
+      std::vector<std::shared_ptr<const Interleaving>>{interleaving},
+      std::vector<int>{0},
+      std::vector<int>{static_cast<int>(column_ids.size())});
+  return absl::OkStatus();
+}
+
+absl::Status InMemoryStorage::ReadInterleaved(
+    absl::Time timestamp, const std::vector<TableID>& table_ids,
+    const KeyRange& key_range,
+    const std::vector<std::vector<ColumnID>>& column_ids,
+    std::unique_ptr<InterleavedStorageIterator>* itr) const {
+  if (!colocate_interleaved_tables_) {
+    return Storage::ReadInterleaved(timestamp, table_ids, key_range,
+                                    column_ids, itr);
+  }
+  if (table_ids.empty() || table_ids.size() != column_ids.size()) {
+    return error::Internal(
+        "InMemoryStorage::ReadInterleaved should be called with the columns "
+        "of each of one or more tables.");
+  }
+
+  // The descendants must be stored under the rows of the parent, which holds
+  // the tags of the parent and of its ancestors.
+  std::vector<std::shared_ptr<const Interleaving>> tables;
+  for (const TableID& table_id : table_ids) {
+    std::shared_ptr<const Interleaving> interleaving =
+        FindInterleaving(table_id, timestamp);
+    if (interleaving == nullptr ||
+        (!tables.empty() &&
+         (interleaving->root_id != tables[0]->root_id ||
+          interleaving->tags.size() <= tables[0]->tags.size() ||
+          !std::equal(tables[0]->tags.begin(), tables[0]->tags.end(),
+                      interleaving->tags.begin())))) {
+      return error::Internal(
+          absl::StrCat("InMemoryStorage::ReadInterleaved found table ",
+                       table_id, " which is not co-located under table ",
+                       table_ids[0]));
+    }
+    tables.push_back(std::move(interleaving));
+  }
+
+  // The columns of all the tables are read side by side.
+  std::vector<ColumnID> stored_column_ids;
+  std::vector<int> column_offsets;
+  std::vector<int> num_columns;
+  for (const std::vector<ColumnID>& table_column_ids : column_ids) {
+    column_offsets.push_back(stored_column_ids.size());
+    num_columns.push_back(table_column_ids.size());
+    stored_column_ids.insert(stored_column_ids.end(), table_column_ids.begin(),
+                             table_column_ids.end());
+  }
+
+  std::unique_ptr<StorageIterator> rows;
+  ZETASQL_RETURN_IF_ERROR(ReadStored(timestamp, tables[0]->root_id,
+                             ToStoredRange(*tables[0], key_range),
+                             stored_column_ids, &rows));
+  *itr = absl::make_unique<InterleavedIterator>(
+      std::move(rows), std::move(tables), std::move(column_offsets),
+      std::move(num_columns));
+  return absl::OkStatus();
+}
 
+absl::Status InMemoryStorage::ReadStored(
+    absl::Time timestamp, const TableID& table_id, const KeyRange& key_range,
+    const std::vector<ColumnID>& column_ids,
+    std::unique_ptr<StorageIterator>* itr) const {
   // Validate the request.
   if (!key_range.IsClosedOpen()) {
     return error::Internal(
@@ -135,7 +1633,6 @@ absl::Status InMemoryStorage::Read(
                      key_range.DebugString()));
   }
 
-  std::vector<FixedRowStorageIterator::Row> rows;
   // Return an empty iterator for empty key_range.
   if (key_range.start_key() >= key_range.limit_key()) {
     *itr = absl::make_unique<FixedRowStorageIterator>();
@@ -143,61 +1640,354 @@ absl::Status InMemoryStorage::Read(
   }
 
   // Lookup for given table.
-  auto table_itr = tables_.find(table_id);
-  if (table_itr == tables_.end()) {
+  std::shared_ptr<const Table> table = FindTable(table_id, timestamp);
+  if (table == nullptr) {
     *itr = absl::make_unique<FixedRowStorageIterator>();
     return absl::OkStatus();
   }
-  const Table& table = table_itr->second;
 
-  // Lookup keys from the given key range.
-  auto row_start_itr = table.lower_bound(key_range.start_key());
-  auto row_end_itr = table.lower_bound(key_range.limit_key());
-  for (auto itr = row_start_itr; itr != row_end_itr; ++itr) {
-    const InMemoryStorage::Row& row = itr->second;
-    if (!Exists(row, timestamp)) {
-      continue;
+  // Reads of a key prefix (such as the children of a row, or the entries for a
+  // unique index key) return nothing if the prefix was never written.
+  if (!key_range.start_key().IsEmpty() &&
+      key_range.limit_key() == key_range.start_key().ToPrefixLimit()) {
+    absl::ReaderMutexLock lock(&table->mu);
+    if (!MayContain(*table, key_range.start_key())) {
+      *itr = absl::make_unique<FixedRowStorageIterator>();
+      return absl::OkStatus();
     }
+  }
+
+  // Rows are read lazily as the iterator advances.
+  *itr = absl::make_unique<TableIterator>(table, timestamp, key_range,
+                                          column_ids);
+  return absl::OkStatus();
+}
+
+absl::Status InMemoryStorage::MultiLookup(
+    absl::Time timestamp, const TableID& table_id, const std::vector<Key>& keys,
+    const std::vector<ColumnID>& column_ids,
+    std::unique_ptr<StorageIterator>* itr) const {
+  std::shared_ptr<const Interleaving> interleaving =
+      FindInterleaving(table_id, timestamp);
+  if (interleaving == nullptr) {
+    return MultiLookupStored(timestamp, table_id, keys, column_ids, itr);
+  }
+  std::vector<Key> stored_keys;
+  stored_keys.reserve(keys.size());
+  for (const Key& key : keys) {
+    stored_keys.push_back(ToStoredKey(*interleaving, key));
+  }
+  std::unique_ptr<StorageIterator> rows;
+  ZETASQL_RETURN_IF_ERROR(MultiLookupStored(timestamp, interleaving->root_id,
+                                    stored_keys, column_ids, &rows));
+  *itr = absl::make_unique<InterleavedIterator>(
+      std::move(rows),
+      std::vector<std::shared_ptr<const Interleaving>>{interleaving},
+      std::vector<int>{0},
+      std::vector<int>{static_cast<int>(column_ids.size())});
+  return absl::OkStatus();
+}
+
+absl::Status InMemoryStorage::MultiLookupStored(
+    absl::Time timestamp, const TableID& table_id, const std::vector<Key>& keys,
+    const std::vector<ColumnID>& column_ids,
+    std::unique_ptr<StorageIterator>* itr) const {
+  // Lookup for given table.
+  std::shared_ptr<const Table> table = FindTable(table_id, timestamp);
+  if (table == nullptr || keys.empty()) {
+    *itr = absl::make_unique<FixedRowStorageIterator>();
+    return absl::OkStatus();
+  }
+
+  std::vector<FixedRowStorageIterator::Row> rows;
+  int64_t rows_scanned = 0;
+  {
+    absl::ReaderMutexLock lock(&table->mu);
+    const std::vector<int> slots = GetColumnSlots(*table, column_ids);
+    auto row_itr = table->rows.begin();
+    std::string encoded_key;
+    std::string previous_key;
+    for (int i = 0; i < keys.size(); ++i) {
+      if (i > 0 && keys[i] < keys[i - 1]) {
+        return error::Internal(absl::StrCat(
+            "InMemoryStorage::MultiLookup should be called with sorted keys, "
+            "found: ",
+            keys[i].DebugString(), " after ", keys[i - 1].DebugString()));
+      }
+      if (!MayContain(*table, keys[i])) {
+        continue;
+      }
+      encoded_key = EncodeKey(keys[i]);
+      if (i > 0 && encoded_key == previous_key) {
+        continue;
+      }
+
+      // Keys are sorted, so the row is at or after the current position. Step
+      // forward a few rows before falling back to searching the table.
+      int steps = 0;
+      while (row_itr != table->rows.end() && row_itr->first < encoded_key &&
+             steps < kMultiLookupMaxSteps) {
+        ++row_itr;
+        ++steps;
+      }
+      if (row_itr != table->rows.end() && row_itr->first < encoded_key) {
+        row_itr = table->rows.lower_bound(encoded_key);
+      }
+      if (row_itr == table->rows.end()) {
+        break;
+      }
+      previous_key.swap(encoded_key);
+      if (row_itr->first != previous_key) {
+        continue;
+      }
 
-    std::vector<zetasql::Value> values;
-    values.reserve(column_ids.size());
-    for (const ColumnID& column_id : column_ids) {
-      values.emplace_back(GetCellValueAtTimestamp(row, column_id, timestamp));
+      ++rows_scanned;
+      const RowVersion* version =
+          VisibleVersionAt(*table, row_itr->first, row_itr->second, timestamp);
+      if (version == nullptr) {
+        continue;
+      }
+      std::vector<zetasql::Value> values;
+      values.reserve(slots.size());
+      for (int slot : slots) {
+        values.emplace_back(GetColumnValue(*version, slot));
+      }
+      rows.emplace_back(keys[i], std::move(values));
     }
-    rows.emplace_back(std::make_pair(itr->first, values));
   }
+
+  static metrics::Counter* const rows_scanned_counter = metrics::GetCounter(
+      "spanner_emulator_storage_rows_scanned_total",
+      "Number of rows visited by storage reads, including rows which are "
+      "not visible at the read timestamp.");
+  rows_scanned_counter->Increment(rows_scanned);
+
   *itr = absl::make_unique<FixedRowStorageIterator>(std::move(rows));
   return absl::OkStatus();
 }
 
-absl::Status InMemoryStorage::Write(
-    absl::Time timestamp, const TableID& table_id, const Key& key,
+absl::Status InMemoryStorage::WriteRow(
+    Table* table, Row* row, absl::Time timestamp,
     const std::vector<ColumnID>& column_ids,
     const std::vector<zetasql::Value>& values) {
-  absl::MutexLock lock(&mu_);
-
-  // Add the table if it does not exist.
-  Table& table = tables_[table_id];
+  const int64_t latest_bytes = VersionBytes(table->interned, row->latest);
+  const size_t history_size = row->history.size();
 
-  // Add the row with _exists system column if it does not exist.
-  Row& row = table[key];
-  if (!Exists(row, timestamp)) {
-    row[kExistsColumn][timestamp] = zetasql::values::Bool(true);
+  // Mark the row as existing at the given timestamp.
+  ZETASQL_ASSIGN_OR_RETURN(RowVersion * version, MutableVersionAt(row, timestamp));
+  version->exists = true;
+  table->max_write_timestamp = std::max(table->max_write_timestamp, timestamp);
+  if (row->history.size() > history_size) {
+    Retain(&table->interned, row->history.back());
+    CompressValues(&row->history.back());
   }
 
-  // Add the values for the given columns.
+  // Add the values for the given columns, assigning slots to new columns.
+  int64_t dictionary_bytes = 0;
   for (int i = 0; i < column_ids.size(); ++i) {
-    row[column_ids[i]][timestamp] = values[i];
+    auto slot_itr =
+        table->column_slots.emplace(column_ids[i], table->column_slots.size())
+            .first;
+    int slot = slot_itr->second;
+    if (slot >= version->values.size()) {
+      version->values.resize(slot + 1);
+    }
+    // Intern the new value before releasing the old one, so that rewriting a
+    // value does not remove it from the dictionary in between.
+    const zetasql::Value& value =
+        Intern(&table->interned, values[i], &dictionary_bytes);
+    Release(&table->interned, version->values[slot], &dictionary_bytes);
+    SetColumnValue(version, slot, value);
+  }
+  AddBytes(table, dictionary_bytes + ChangedBytes(table->interned, *row,
+                                                  latest_bytes, history_size));
+  return absl::OkStatus();
+}
+
+absl::Status InMemoryStorage::DeleteRow(Table* table, Row* row,
+                                        absl::Time timestamp) {
+  if (!Exists(*row, timestamp)) {
+    return absl::OkStatus();
+  }
+  const int64_t latest_bytes = VersionBytes(table->interned, row->latest);
+  const size_t history_size = row->history.size();
+
+  // Column values are cleared to avoid reading the values of the row before
+  // the delete.
+  ZETASQL_ASSIGN_OR_RETURN(RowVersion * version, MutableVersionAt(row, timestamp));
+  table->max_write_timestamp = std::max(table->max_write_timestamp, timestamp);
+  if (row->history.size() > history_size) {
+    Retain(&table->interned, row->history.back());
+    CompressValues(&row->history.back());
+  }
+  int64_t dictionary_bytes = 0;
+  Release(&table->interned, *version, &dictionary_bytes);
+  version->exists = false;
+  version->values.clear();
+  version->compressed.clear();
+  AddBytes(table, dictionary_bytes + ChangedBytes(table->interned, *row,
+                                                  latest_bytes, history_size));
+  return absl::OkStatus();
+}
+
+absl::Status InMemoryStorage::SplitKeyRange(
+    const TableID& table_id, const KeyRange& key_range, int max_ranges,
+    int64_t min_rows_per_range, std::vector<Key>* split_keys) const {
+  // Ranges which are not ClosedOpen are rejected by SplitKeyRangeStored.
+  std::shared_ptr<const Interleaving> interleaving = FindInterleaving(table_id);
+  if (interleaving == nullptr || !key_range.IsClosedOpen()) {
+    return SplitKeyRangeStored(table_id, key_range, max_ranges,
+                               min_rows_per_range, split_keys);
+  }
+  // Rows of all the tables of the root are counted, and only the split keys
+  // which fall on rows of the table are kept.
+  ZETASQL_RETURN_IF_ERROR(SplitKeyRangeStored(interleaving->root_id,
+                                      ToStoredRange(*interleaving, key_range),
+                                      max_ranges, min_rows_per_range,
+                                      split_keys));
+  ToKeysOf(*interleaving, split_keys);
+  return absl::OkStatus();
+}
+
+absl::Status InMemoryStorage::SplitKeyRangeStored(
+    const TableID& table_id, const KeyRange& key_range, int max_ranges,
+    int64_t min_rows_per_range, std::vector<Key>* split_keys) const {
+  split_keys->clear();
+  if (!key_range.IsClosedOpen()) {
+    return error::Internal(
+        absl::StrCat("InMemoryStorage::SplitKeyRange should be called "
+                     "with ClosedOpen key range, found: ",
+                     key_range.DebugString()));
+  }
+  std::shared_ptr<const Table> table = FindTable(table_id);
+  if (table == nullptr || max_ranges < 2 ||
+      key_range.start_key() >= key_range.limit_key()) {
+    return absl::OkStatus();
+  }
+
+  const std::string start_key = EncodeKey(key_range.start_key());
+  const std::string limit_key = EncodeKey(key_range.limit_key());
+  absl::ReaderMutexLock lock(&table->mu);
+  if (table->rows.size() > kMaxSampledKeysPerTable) {
+    // The range is split at the sampled keys within it, which are spread
+    // across its rows as evenly as the sample is across those of the table.
+    std::vector<absl::string_view> sampled_keys;
+    for (const auto& [hash, encoded_key] : table->key_sample) {
+      if (encoded_key >= start_key && encoded_key < limit_key) {
+        sampled_keys.push_back(encoded_key);
+      }
+    }
+    std::sort(sampled_keys.begin(), sampled_keys.end());
+    const int64_t num_sampled_keys = sampled_keys.size();
+    const int64_t num_rows =
+        num_sampled_keys * table->rows.size() / table->key_sample.size();
+    const int64_t num_ranges = std::min<int64_t>(
+        {max_ranges, num_sampled_keys,
+         num_rows / std::max<int64_t>(min_rows_per_range, 1)});
+    for (int64_t i = 1; i < num_ranges; ++i) {
+      split_keys->push_back(
+          DecodeKey(sampled_keys[i * num_sampled_keys / num_ranges]));
+    }
+    return absl::OkStatus();
   }
 
+  // Walking the rows of a small table only follows pointers between the nodes
+  // of the map, which is much cheaper than copying out their values as a read
+  // does.
+  auto row_itr = table->rows.lower_bound(start_key);
+  auto row_end_itr = table->rows.lower_bound(limit_key);
+  const int64_t num_rows = std::distance(row_itr, row_end_itr);
+  const int64_t num_ranges = std::min<int64_t>(
+      max_ranges, num_rows / std::max<int64_t>(min_rows_per_range, 1));
+  int64_t row = 0;
+  for (int64_t i = 1; i < num_ranges; ++i) {
+    const int64_t split_row = i * num_rows / num_ranges;
+    std::advance(row_itr, split_row - row);
+    row = split_row;
+    split_keys->push_back(DecodeKey(row_itr->first));
+  }
   return absl::OkStatus();
 }
 
+absl::Status InMemoryStorage::Write(
+    absl::Time timestamp, const TableID& table_id, const Key& key,
+    const std::vector<ColumnID>& column_ids,
+    const std::vector<zetasql::Value>& values) {
+  std::shared_ptr<const Interleaving> interleaving =
+      FindInterleaving(table_id, timestamp);
+  if (interleaving == nullptr) {
+    return WriteStored(timestamp, table_id, key, column_ids, values);
+  }
+  return WriteStored(timestamp, interleaving->root_id,
+                     ToStoredKey(*interleaving, key), column_ids, values);
+}
+
+absl::Status InMemoryStorage::WriteStored(
+    absl::Time timestamp, const TableID& table_id, const Key& key,
+    const std::vector<ColumnID>& column_ids,
+    const std::vector<zetasql::Value>& values) {
+  // Add the table if it does not exist.
+  Table* table = FindOrCreateTable(table_id);
+  absl::MutexLock lock(&table->mu);
+  RecordChange(table, timestamp);
+
+  // Add the row if it does not exist.
+  auto [row_itr, inserted] = table->rows.try_emplace(EncodeKey(key));
+  if (inserted) {
+    if (!kInsertsKeepRowIterators) {
+      ++table->generation;
+    }
+    AddToKeyFilter(table, key);
+    AddToKeySample(table, row_itr->first);
+    AddBytes(table,
+             RowBytes(table->interned, row_itr->first, row_itr->second));
+  }
+  ZETASQL_RETURN_IF_ERROR(
+      ApplyTombstones(table, row_itr->first, &row_itr->second, timestamp));
+  return WriteRow(table, &row_itr->second, timestamp, column_ids, values);
+}
+
 absl::Status InMemoryStorage::Delete(absl::Time timestamp,
                                      const TableID& table_id,
                                      const KeyRange& key_range) {
-  absl::MutexLock lock(&mu_);
+  // Ranges which are not ClosedOpen are rejected by DeleteStored.
+  std::shared_ptr<const Interleaving> interleaving =
+      FindInterleaving(table_id, timestamp);
+  if (interleaving == nullptr || !key_range.IsClosedOpen()) {
+    return DeleteStored(timestamp, table_id, key_range);
+  }
+  const KeyRange stored_range = ToStoredRange(*interleaving, key_range);
+  if (!interleaving->has_children &&
+      IsUnderSingleParent(*interleaving, stored_range)) {
+    return DeleteStored(timestamp, interleaving->root_id, stored_range);
+  }
+  return DeleteRowsOf(timestamp, *interleaving, stored_range,
+                      /*with_descendants=*/false);
+}
+
+absl::Status InMemoryStorage::DeleteWithDescendants(absl::Time timestamp,
+                                                    const TableID& table_id,
+                                                    const KeyRange& key_range) {
+  if (!colocate_interleaved_tables_) {
+    return Storage::DeleteWithDescendants(timestamp, table_id, key_range);
+  }
+  // A table which is not co-located has no descendants stored with it.
+  std::shared_ptr<const Interleaving> interleaving =
+      FindInterleaving(table_id, timestamp);
+  if (interleaving == nullptr || !key_range.IsClosedOpen()) {
+    return DeleteStored(timestamp, table_id, key_range);
+  }
+  const KeyRange stored_range = ToStoredRange(*interleaving, key_range);
+  if (IsUnderSingleParent(*interleaving, stored_range)) {
+    return DeleteStored(timestamp, interleaving->root_id, stored_range);
+  }
+  return DeleteRowsOf(timestamp, *interleaving, stored_range,
+                      /*with_descendants=*/true);
+}
 
+absl::Status InMemoryStorage::DeleteStored(absl::Time timestamp,
+                                           const TableID& table_id,
+                                           const KeyRange& key_range) {
   if (!key_range.IsClosedOpen()) {
     return error::Internal(
         absl::StrCat("InMemoryStorage::Delete should be called "
@@ -209,33 +1999,438 @@ absl::Status InMemoryStorage::Delete(absl::Time timestamp,
   }
 
   // Lookup for given table.
-  auto table_itr = tables_.find(table_id);
-  if (table_itr == tables_.end()) {
+  std::shared_ptr<Table> found_table = FindTable(table_id);
+  if (found_table == nullptr) {
     return absl::OkStatus();
   }
-  Table& table = table_itr->second;
+  Table* table = found_table.get();
+  absl::MutexLock lock(&table->mu);
 
   // Lookup keys from the given key range.
-  auto row_start_itr = table.lower_bound(key_range.start_key());
-  if (row_start_itr == table.end()) {
+  std::string start_key = EncodeKey(key_range.start_key());
+  std::string limit_key = EncodeKey(key_range.limit_key());
+  auto row_start_itr = table->rows.lower_bound(start_key);
+  if (row_start_itr == table->rows.end()) {
     return absl::OkStatus();
   }
-  auto row_end_itr = table.lower_bound(key_range.limit_key());
+  RecordChange(table, timestamp);
+
+  // Large ranges are deleted with a tombstone. This requires that no row of
+  // the table was written at the timestamp of the delete yet, since the
+  // tombstone would not tell such writes from those which follow the delete.
+  if (table->max_write_timestamp < timestamp &&
+      table->tombstones.size() < kMaxRangeTombstonesPerTable) {
+    int num_rows = 0;
+    for (auto itr = row_start_itr; itr != table->rows.end() &&
+                                   itr->first < limit_key &&
+                                   num_rows < kMinRowsPerRangeTombstone;
+         ++itr) {
+      ++num_rows;
+    }
+    if (num_rows == kMinRowsPerRangeTombstone) {
+      table->tombstones.push_back(RangeTombstone{
+          std::move(start_key), std::move(limit_key), timestamp});
+      AddBytes(table, TombstoneBytes(table->tombstones.back()));
+      return absl::OkStatus();
+    }
+  }
 
   // Mark the keys as deleted.
+  auto row_end_itr = table->rows.lower_bound(limit_key);
   for (auto itr = row_start_itr; itr != row_end_itr; ++itr) {
-    if (!Exists(itr->second, timestamp)) {
-      continue;
+    ZETASQL_RETURN_IF_ERROR(DeleteRow(table, &itr->second, timestamp));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status InMemoryStorage::WriteBatch(
+    absl::Time timestamp, const TableID& table_id,
+    const std::vector<StorageWrite>& writes) {
+  std::shared_ptr<const Interleaving> interleaving =
+      FindInterleaving(table_id, timestamp);
+  if (interleaving == nullptr) {
+    return WriteBatchStored(timestamp, table_id, writes);
+  }
+  std::vector<StorageWrite> stored_writes = writes;
+  for (StorageWrite& write : stored_writes) {
+    write.key = ToStoredKey(*interleaving, write.key);
+  }
+  return WriteBatchStored(timestamp, interleaving->root_id, stored_writes);
+}
+
+absl::Status InMemoryStorage::WriteBatchStored(
+    absl::Time timestamp, const TableID& table_id,
+    const std::vector<StorageWrite>& writes) {
+  if (writes.empty()) {
+    return absl::OkStatus();
+  }
+  Table* table = FindOrCreateTable(table_id);
+  absl::MutexLock lock(&table->mu);
+  RecordChange(table, timestamp);
+
+  // For writes sorted by key, the row of each write is at or just after the
+  // row of the previous write, so it is usually found (or inserted) next to
+  // the previous row without searching the table from the root.
+  Rows& rows = table->rows;
+  auto row_itr = rows.end();
+  for (const StorageWrite& write : writes) {
+    std::string key = EncodeKey(write.key);
+    bool same_row = row_itr != rows.end() && row_itr->first == key;
+    if (!same_row) {
+      // Find the first row which is not before the key of the write.
+      auto next_itr = rows.end();
+      if (row_itr != rows.end() && row_itr->first < key) {
+        next_itr = std::next(row_itr);
+      }
+      if (next_itr == rows.end() || next_itr->first < key) {
+        next_itr = rows.lower_bound(key);
+      }
+
+      if (next_itr != rows.end() && next_itr->first == key) {
+        row_itr = next_itr;
+      } else if (write.is_delete) {
+        // Deleting a row which does not exist must not insert it.
+        continue;
+      } else {
+        row_itr = rows.emplace_hint(next_itr, std::move(key), Row());
+        if (!kInsertsKeepRowIterators) {
+          ++table->generation;
+        }
+        AddToKeyFilter(table, write.key);
+        AddToKeySample(table, row_itr->first);
+        AddBytes(table,
+                 RowBytes(table->interned, row_itr->first, row_itr->second));
+      }
+    }
+    ZETASQL_RETURN_IF_ERROR(
+        ApplyTombstones(table, row_itr->first, &row_itr->second, timestamp));
+    if (write.is_delete) {
+      ZETASQL_RETURN_IF_ERROR(DeleteRow(table, &row_itr->second, timestamp));
+    } else {
+      ZETASQL_RETURN_IF_ERROR(WriteRow(table, &row_itr->second, timestamp,
+                               write.column_ids, write.values));
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status InMemoryStorage::DropTable(absl::Time timestamp,
+                                        const TableID& table_id) {
+  // The rows of a co-located table are stored among those of the other tables
+  // of its root, so rather than detached, they are hidden from later reads.
+  std::shared_ptr<const Interleaving> interleaving =
+      FindInterleaving(table_id, timestamp);
+  if (interleaving == nullptr || interleaving->tags.empty()) {
+    return DropTableStored(timestamp, table_id);
+  }
+  return DropInterleavedTable(timestamp, table_id);
+}
+
+absl::Status InMemoryStorage::DropInterleavedTable(absl::Time timestamp,
+                                                   const TableID& table_id) {
+  absl::MutexLock lock(&mu_);
+  auto itr = interleavings_.find(table_id);
+  if (itr == interleavings_.end() ||
+      itr->second->drop_timestamp != absl::InfiniteFuture()) {
+    return absl::OkStatus();
+  }
+  TableVersion version;
+  auto root_itr = tables_.find(itr->second->root_id);
+  if (root_itr != tables_.end()) {
+    Table* root = root_itr->second.get();
+    absl::MutexLock table_lock(&root->mu);
+    if (root->max_write_timestamp > timestamp) {
+      return error::Internal(
+          absl::StrCat("InMemoryStorage cannot drop table ", table_id,
+                       " at timestamp ", absl::FormatTime(timestamp),
+                       " which is older than its latest write"));
+    }
+    RecordChange(root, timestamp);
+    version = root->version;
+  }
+  // A table later written under the same id is stored apart, and continues
+  // from the version of the root.
+  dropped_versions_[table_id] = version;
+  auto dropped = std::make_shared<Interleaving>(*itr->second);
+  dropped->drop_timestamp = timestamp;
+  itr->second = std::move(dropped);
+  return absl::OkStatus();
+}
+
+absl::Status InMemoryStorage::DropTableStored(absl::Time timestamp,
+                                              const TableID& table_id) {
+  absl::MutexLock lock(&mu_);
+  auto table_itr = tables_.find(table_id);
+  if (table_itr == tables_.end()) {
+    return absl::OkStatus();
+  }
+  {
+    absl::MutexLock table_lock(&table_itr->second->mu);
+    if (table_itr->second->max_write_timestamp > timestamp) {
+      return error::Internal(
+          absl::StrCat("InMemoryStorage cannot drop table ", table_id,
+                       " at timestamp ", absl::FormatTime(timestamp),
+                       " which is older than its latest write"));
     }
+    RecordChange(table_itr->second.get(), timestamp);
+    dropped_versions_[table_id] = table_itr->second->version;
+  }
 
-    for (const auto& columns : itr->second) {
-      if (columns.first == kExistsColumn) {
-        itr->second[kExistsColumn][timestamp] = zetasql::values::Bool(false);
+  // The rows are kept aside for reads before the drop, until they are freed
+  // by garbage collection.
+  dropped_tables_[table_id].push_back(
+      DroppedTable{timestamp, std::move(table_itr->second)});
+  tables_.erase(table_itr);
+  return absl::OkStatus();
+}
+
+void InMemoryStorage::FreeDroppedTables(absl::Time horizon) {
+  std::vector<std::shared_ptr<Table>> freed;
+  {
+    absl::MutexLock lock(&mu_);
+    for (auto itr = dropped_tables_.begin(); itr != dropped_tables_.end();) {
+      std::vector<DroppedTable>& dropped = itr->second;
+      auto first_kept = std::find_if(
+          dropped.begin(), dropped.end(), [&](const DroppedTable& table) {
+            return table.timestamp > horizon;
+          });
+      for (auto dropped_itr = dropped.begin(); dropped_itr != first_kept;
+           ++dropped_itr) {
+        freed.push_back(std::move(dropped_itr->table));
+      }
+      dropped.erase(dropped.begin(), first_kept);
+      if (dropped.empty()) {
+        dropped_tables_.erase(itr++);
       } else {
-        // Column values are marked invalid zetasql::Value to avoid reading
-        // the value of the cell before the delete.
-        itr->second[columns.first][timestamp] = zetasql::Value();
+        ++itr;
+      }
+    }
+  }
+
+  // Tables are freed outside of the storage's lock, and a table still read by
+  // an iterator is only freed once the iterator is done with it.
+  for (const std::shared_ptr<Table>& table : freed) {
+    absl::ReaderMutexLock lock(&table->mu);
+    total_bytes_.fetch_sub(table->bytes.load(std::memory_order_relaxed),
+                           std::memory_order_relaxed);
+    interned_distinct_values_.fetch_sub(table->interned.refs.size(),
+                                        std::memory_order_relaxed);
+  }
+}
+
+void InMemoryStorage::CollectGarbage(absl::Time horizon) {
+  FreeDroppedTables(horizon);
+
+  std::vector<std::pair<TableID, Table*>> tables;
+  {
+    absl::ReaderMutexLock lock(&mu_);
+    for (const auto& [table_id, table] : tables_) {
+      tables.emplace_back(table_id, table.get());
+    }
+  }
+
+  // The rows of the co-located tables dropped at or before the horizon are
+  // erased from the tables of their roots, which are visited row by row
+  // anyway, after which the tables are forgotten.
+  std::vector<std::shared_ptr<const Interleaving>> erased_interleavings;
+  for (const auto& [table_id, table] : tables) {
+    const std::vector<std::shared_ptr<const Interleaving>> dropped =
+        DroppedInterleavings(table_id, horizon);
+    erased_interleavings.insert(erased_interleavings.end(), dropped.begin(),
+                                dropped.end());
+    {
+      absl::MutexLock lock(&table->mu);
+      CollectTombstones(table, horizon);
+    }
+
+    // Visit the rows in batches, releasing the table's lock between batches.
+    std::string next_key;
+    bool started = false;
+    bool erased_any = false;
+    while (true) {
+      absl::MutexLock lock(&table->mu);
+      auto row_itr = started ? table->rows.lower_bound(next_key)
+                             : table->rows.begin();
+      started = true;
+      bool erased = false;
+      int64_t pruned_bytes = 0;
+      for (int i = 0;
+           i < kGarbageCollectionBatchSize && row_itr != table->rows.end();
+           ++i) {
+        if (IsStoredKeyOfAny(dropped, row_itr->first)) {
+          row_itr = EraseRow(table, row_itr, &pruned_bytes);
+          erased = true;
+        } else if (PruneVersions(&table->interned, &row_itr->second,
+                                 horizon, &pruned_bytes)) {
+          pruned_bytes +=
+              RowBytes(table->interned, row_itr->first, row_itr->second);
+          int64_t dictionary_bytes = 0;
+          Release(&table->interned, row_itr->second.latest, &dictionary_bytes);
+          pruned_bytes -= dictionary_bytes;
+          row_itr = table->rows.erase(row_itr);
+          ++table->rows_erased_since_compaction;
+          erased = true;
+        } else {
+          ++row_itr;
+        }
+      }
+      AddBytes(table, -pruned_bytes);
+      if (erased) {
+        ++table->generation;
+        erased_any = true;
+      }
+      if (row_itr == table->rows.end()) {
+        // Drop the keys of erased rows from the key filter.
+        if (erased_any) {
+          RebuildKeyFilter(table);
+          RebuildKeySample(table);
+        }
+        if (ShouldCompact(*table)) {
+          CompactRows(table);
+        }
+        break;
+      }
+      next_key = row_itr->first;
+    }
+  }
+
+  if (!erased_interleavings.empty()) {
+    absl::MutexLock lock(&mu_);
+    for (const std::shared_ptr<const Interleaving>& interleaving :
+         erased_interleavings) {
+      for (auto itr = interleavings_.begin(); itr != interleavings_.end();
+           ++itr) {
+        if (itr->second == interleaving) {
+          interleavings_.erase(itr);
+          break;
+        }
+      }
+    }
+  }
+}
+
+// CheckpointData holds the tables of a storage as of the checkpoint timestamp.
+// Copies of column values share their contents with the storage, so taking a
+// checkpoint, and resetting to one, copies only the row structure.
+class InMemoryStorage::CheckpointData : public StorageCheckpoint {
+ public:
+  CheckpointData(const InMemoryStorage* storage, absl::Time timestamp,
+                 absl::flat_hash_map<TableID, TableCheckpoint> tables)
+      : storage_(storage), timestamp_(timestamp), tables_(std::move(tables)) {}
+
+  const InMemoryStorage* storage() const { return storage_; }
+
+  absl::Time timestamp() const { return timestamp_; }
+
+  const absl::flat_hash_map<TableID, TableCheckpoint>& tables() const {
+    return tables_;
+  }
+
+ private:
+  const InMemoryStorage* storage_;
+  absl::Time timestamp_;
+  absl::flat_hash_map<TableID, TableCheckpoint> tables_;
+};
+
+zetasql_base::StatusOr<std::unique_ptr<StorageCheckpoint>>
+InMemoryStorage::Checkpoint(absl::Time timestamp) const {
+  std::vector<std::pair<TableID, std::shared_ptr<Table>>> tables =
+      TablesAt(timestamp);
+
+  absl::flat_hash_map<TableID, TableCheckpoint> checkpoint_tables;
+  for (const auto& [table_id, table] : tables) {
+    // The rows of co-located tables dropped by then are left out.
+    const std::vector<std::shared_ptr<const Interleaving>> dropped =
+        DroppedInterleavings(table_id, timestamp);
+    TableCheckpoint& checkpoint = checkpoint_tables[table_id];
+    absl::ReaderMutexLock lock(&table->mu);
+    checkpoint.column_slots = table->column_slots;
+    for (const auto& [encoded_key, row] : table->rows) {
+      const RowVersion* version =
+          VisibleVersionAt(*table, encoded_key, row, timestamp);
+      if (version != nullptr && !IsStoredKeyOfAny(dropped, encoded_key)) {
+        checkpoint.rows.emplace_hint(checkpoint.rows.end(), encoded_key,
+                                     Row{*version, {}});
+      }
+    }
+  }
+  return absl::make_unique<CheckpointData>(this, timestamp,
+                                           std::move(checkpoint_tables));
+}
+
+absl::Status InMemoryStorage::ResetToCheckpoint(
+    const StorageCheckpoint& checkpoint) {
+  const auto* data = dynamic_cast<const CheckpointData*>(&checkpoint);
+  ZETASQL_RET_CHECK(data != nullptr && data->storage() == this)
+      << "Checkpoint was created by another storage";
+
+  std::vector<std::pair<TableID, Table*>> tables;
+  {
+    absl::ReaderMutexLock lock(&mu_);
+    for (const auto& [table_id, table] : tables_) {
+      tables.emplace_back(table_id, table.get());
+    }
+  }
+  for (const auto& [table_id, table_checkpoint] : data->tables()) {
+    if (FindTable(table_id) == nullptr) {
+      tables.emplace_back(table_id, FindOrCreateTable(table_id));
+    }
+  }
+
+  for (const auto& [table_id, table] : tables) {
+    Rows rows;
+    absl::flat_hash_map<ColumnID, int> column_slots;
+    InternedValues interned;
+    absl::Time max_write_timestamp = absl::InfinitePast();
+    auto itr = data->tables().find(table_id);
+    int64_t bytes = 0;
+    if (itr != data->tables().end()) {
+      rows = itr->second.rows;
+      column_slots = itr->second.column_slots;
+      // The values of the rows are interned anew, so that the dictionary only
+      // holds the values of the rows of the checkpoint.
+      for (auto&& [encoded_key, row] : rows) {
+        for (zetasql::Value& value : row.latest.values) {
+          value = Intern(&interned, value, &bytes);
+        }
       }
+      for (const auto& [encoded_key, row] : rows) {
+        bytes += RowBytes(interned, encoded_key, row);
+        max_write_timestamp =
+            std::max(max_write_timestamp, row.latest.timestamp);
+      }
+    }
+    // The rows being replaced are released after the table's lock, so that
+    // resetting a large table does not block its readers meanwhile.
+    absl::MutexLock lock(&table->mu);
+    table->rows.swap(rows);
+    table->column_slots.swap(column_slots);
+    std::swap(table->interned, interned);
+    table->tombstones.clear();
+    table->rows_erased_since_compaction = 0;
+    table->max_write_timestamp = max_write_timestamp;
+    table->version = TableVersion();
+    RecordChange(table, max_write_timestamp);
+    interned_distinct_values_.fetch_sub(interned.refs.size(),
+                                        std::memory_order_relaxed);
+    AddBytes(table, bytes - table->bytes.load(std::memory_order_relaxed));
+    ++table->generation;
+    RebuildKeyFilter(table);
+    RebuildKeySample(table);
+  }
+
+  // Tables dropped since the checkpoint only hold versions older than it.
+  FreeDroppedTables(absl::InfiniteFuture());
+
+  // Co-located tables dropped since the checkpoint have their rows back, as
+  // the tables detached since then do.
+  absl::MutexLock lock(&mu_);
+  for (auto& [table_id, interleaving] : interleavings_) {
+    if (interleaving->drop_timestamp > data->timestamp() &&
+        interleaving->drop_timestamp != absl::InfiniteFuture()) {
+      auto restored = std::make_shared<Interleaving>(*interleaving);
+      restored->drop_timestamp = absl::InfiniteFuture();
+      interleaving = std::move(restored);
     }
   }
   return absl::OkStatus();
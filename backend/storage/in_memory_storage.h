@@ -17,14 +17,34 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_IN_MEMORY_STORAGE_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_IN_MEMORY_STORAGE_H_
 
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/type.h"
 #include "zetasql/public/value.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
+#include "absl/types/optional.h"
 #include "backend/common/ids.h"
 #include "backend/datamodel/key.h"
 #include "backend/datamodel/key_range.h"
+#include "backend/storage/bplus_tree.h"
 #include "backend/storage/iterator.h"
+#include "backend/storage/key_filter.h"
 #include "backend/storage/storage.h"
 #include "absl/status/status.h"
+#include "zetasql/base/statusor.h"
 
 namespace google {
 namespace spanner {
@@ -33,26 +53,161 @@ namespace backend {
 
 // InMemoryStorage implements an in-memory multi-version data store.
 //
-// Keys are stored in sorted order. Value versions for a given column are also
-// sorted in order of the timestamp written. Keys are never deleted, but are
-// marked deleted for multi-version lookup.
+// Keys are stored in sorted order, by their order-preserving encoding (see
+// EncodeKey) so that searching a table compares flat byte strings. Each row
+// keeps its latest version inline, with column values laid out contiguously,
+// and older versions in a side chain
+// sorted in order of the timestamp written. Writes to a row must not be older
+// than its latest version. Deleted keys are marked deleted for multi-version
+// lookup, and are only removed once garbage collected.
+//
+// Rows are kept in a std::map by default. Builds with --config=bplus_tree_rows
+// keep them in a BPlusTree instead, whose wide nodes hold keys contiguously
+// and whose leaves are scanned sequentially, at the cost of invalidating the
+// positions of reads within a table whenever rows are inserted into it.
 //
 // Lookup and Read return invalid zetasql::Value(s) for non-existent columns.
 //
-// This class is thread-safe.
+// Read returns an iterator which walks the table on demand rather than copying
+// the whole key range upfront. The iterator must not outlive the storage.
+// MultiLookup instead copies the rows of its keys out of the table under a
+// single acquisition of the table's lock, walking the table in key order.
+//
+// Each table can keep a KeyFilter over the keys ever written to it, so that
+// lookups of keys (and reads of key prefixes) which were never written return
+// without searching the table, as is common for the existence checks of bulk
+// inserts.
+//
+// Each table can also intern the short STRING and BYTES values written to it:
+// a value equal to one written before is stored as a copy of the earlier one,
+// which shares its buffer, so that low-cardinality columns (such as enums,
+// country codes or tenant IDs) hold each distinct value once rather than once
+// per row and version. Interning is transparent to readers.
+//
+// Large STRING and BYTES values of older versions are kept compressed, since
+// rows which are rewritten often would otherwise hold a full copy of such
+// values for each version until it is garbage collected. They are decompressed
+// on each read at a past timestamp, while reads of latest versions are
+// unaffected.
+//
+// Deletes of large key ranges record a range tombstone instead of marking each
+// row in the range deleted. Reads skip the rows a tombstone hides, writes to
+// such a row first mark it deleted at the tombstone's timestamp, and garbage
+// collection erases the hidden rows once the tombstone is past the horizon.
+//
+// Once garbage collection has erased a large fraction of the rows of a table,
+// such as after a bulk delete, the table's rows are rebuilt compactly: the
+// surviving rows are moved into a freshly built container, and the histories
+// of their versions are trimmed to size, so that scans of the table no longer
+// walk the sparse structure the erased rows left behind.
+//
+// Each table keeps a sample of the keys of its rows, from which reads of large
+// tables are split into ranges of about equal rows without walking the rows,
+// see GetTableStatistics.
+//
+// With --enable_interleaved_storage_layout, the rows of interleaved tables are
+// co-located with those of their parents, see InterleaveTable: the rows of all
+// the tables of an interleave root are kept in the root's table, with the key
+// of each row prefixed by the key of its parent row, so that a parent row is
+// followed by the rows interleaved in it. Reading a parent along with its
+// children (see ReadInterleaved) or deleting them (see DeleteWithDescendants)
+// then walks a single range of rows instead of one range per table. Reads of a
+// single table skip over the rows of the other tables of its root, and deletes
+// of its rows which do not cover whole subtrees of its ancestors visit them
+// too, in one pass. Dropping a co-located table only marks it dropped, and its
+// rows are erased by garbage collection. Versions and bytes are those of the
+// root's table as a whole, while statistics are scaled to the table's share of
+// the sampled keys.
+//
+// Dropping a table detaches all its rows at once. They are kept aside for
+// reads at timestamps before the drop, and freed by garbage collection once no
+// such read can happen; writes after the drop start from an empty table.
+//
+// This class is thread-safe. Each table is guarded by its own reader-writer
+// mutex: reads of a table proceed in parallel and only writes to the same
+// table are serialized.
 class InMemoryStorage : public Storage {
  public:
+  // Counters of the key filter probes made by lookups and reads.
+  struct KeyFilterStats {
+    // Number of times the key filter was consulted.
+    int64_t probes = 0;
+
+    // Number of probes which found the key (or prefix) was never written, and
+    // so were answered without searching the table.
+    int64_t negatives = 0;
+  };
+
+  // Counters of the values interned by writes.
+  struct InterningStats {
+    // Number of distinct values currently held by the tables' dictionaries.
+    int64_t distinct_values = 0;
+
+    // Number of values written which shared the buffer of an interned value.
+    int64_t shared_values = 0;
+
+    // Approximate bytes which the shared values would otherwise have held.
+    int64_t bytes_saved = 0;
+  };
+
+  // Counters of the values compressed in older versions.
+  struct CompressionStats {
+    // Number of values which were compressed.
+    int64_t compressed_values = 0;
+
+    // Bytes by which compression reduced those values.
+    int64_t bytes_saved = 0;
+  };
+
+  // Counters of the tables compacted by garbage collection.
+  struct CompactionStats {
+    // Number of times the rows of a table were rebuilt.
+    int64_t compactions = 0;
+
+    // Number of rows which the rebuilt tables held.
+    int64_t rows_compacted = 0;
+  };
+
+  // Constructs a storage which uses key filters, interns values and compresses
+  // large values of older versions as enabled in the config.
+  InMemoryStorage();
+  explicit InMemoryStorage(bool use_key_filters);
+  InMemoryStorage(bool use_key_filters, bool intern_values);
+  InMemoryStorage(bool use_key_filters, bool intern_values,
+                  int64_t compression_threshold_bytes);
+  InMemoryStorage(bool use_key_filters, bool intern_values,
+                  int64_t compression_threshold_bytes,
+                  bool colocate_interleaved_tables);
+
   absl::Status Lookup(absl::Time timestamp, const TableID& table_id,
                       const Key& key, const std::vector<ColumnID>& column_ids,
                       std::vector<zetasql::Value>* values) const override
       ABSL_LOCKS_EXCLUDED(mu_);
 
+  zetasql_base::StatusOr<bool> LookupIfExists(
+      absl::Time timestamp, const TableID& table_id, const Key& key,
+      const std::vector<ColumnID>& column_ids,
+      std::vector<zetasql::Value>* values) const override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
   absl::Status Read(absl::Time timestamp, const TableID& table_id,
                     const KeyRange& key_range,
                     const std::vector<ColumnID>& column_ids,
                     std::unique_ptr<StorageIterator>* itr) const override
       ABSL_LOCKS_EXCLUDED(mu_);
 
+  absl::Status MultiLookup(absl::Time timestamp, const TableID& table_id,
+                           const std::vector<Key>& keys,
+                           const std::vector<ColumnID>& column_ids,
+                           std::unique_ptr<StorageIterator>* itr) const override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  absl::Status SplitKeyRange(const TableID& table_id,
+                             const KeyRange& key_range, int max_ranges,
+                             int64_t min_rows_per_range,
+                             std::vector<Key>* split_keys) const override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
   absl::Status Write(absl::Time timestamp, const TableID& table_id,
                      const Key& key, const std::vector<ColumnID>& column_ids,
                      const std::vector<zetasql::Value>& values) override
@@ -62,24 +217,671 @@ class InMemoryStorage : public Storage {
                       const KeyRange& key_range) override
       ABSL_LOCKS_EXCLUDED(mu_);
 
+  absl::Status WriteBatch(absl::Time timestamp, const TableID& table_id,
+                          const std::vector<StorageWrite>& writes) override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  absl::Status DropTable(absl::Time timestamp, const TableID& table_id) override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns INTERNAL if the child already has rows stored apart, or was
+  // declared interleaved in another table. Declaring the same interleaving
+  // again has no effect.
+  absl::Status InterleaveTable(const TableID& child_id,
+                               const TableID& parent_id, int num_key_columns,
+                               int num_parent_key_columns) override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  bool ColocatesInterleavedTables() const override {
+    return colocate_interleaved_tables_;
+  }
+
+  absl::Status ReadInterleaved(
+      absl::Time timestamp, const std::vector<TableID>& table_ids,
+      const KeyRange& key_range,
+      const std::vector<std::vector<ColumnID>>& column_ids,
+      std::unique_ptr<InterleavedStorageIterator>* itr) const override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  absl::Status DeleteWithDescendants(absl::Time timestamp,
+                                     const TableID& table_id,
+                                     const KeyRange& key_range) override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  void CollectGarbage(absl::Time horizon) override ABSL_LOCKS_EXCLUDED(mu_);
+
+  zetasql_base::StatusOr<std::unique_ptr<StorageCheckpoint>> Checkpoint(
+      absl::Time timestamp) const override ABSL_LOCKS_EXCLUDED(mu_);
+
+  absl::Status ResetToCheckpoint(const StorageCheckpoint& checkpoint) override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  absl::optional<TableVersion> GetTableVersion(
+      const TableID& table_id) const override ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Checks the timestamps of the latest versions of the rows in the range and
+  // of the range tombstones overlapping it, so only changes to these rows
+  // count.
+  zetasql_base::StatusOr<bool> ChangedSince(absl::Time timestamp,
+                                    const TableID& table_id,
+                                    const KeyRange& key_range) const override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  absl::optional<TableStatistics> GetTableStatistics(
+      const TableID& table_id) const override ABSL_LOCKS_EXCLUDED(mu_);
+
+  absl::flat_hash_map<TableID, int64_t> TableBytes() const override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  int64_t TotalBytes() const override {
+    return total_bytes_.load(std::memory_order_relaxed);
+  }
+
+  // Returns a snapshot of the key filter counters.
+  KeyFilterStats key_filter_stats() const;
+
+  // Returns a snapshot of the interning counters.
+  InterningStats interning_stats() const;
+
+  // Returns a snapshot of the compression counters.
+  CompressionStats compression_stats() const;
+
+  // Returns a snapshot of the compaction counters.
+  CompactionStats compaction_stats() const;
+
  private:
-  using Cell = std::map<absl::Time, zetasql::Value>;
-  using Row = absl::flat_hash_map<ColumnID, Cell>;
-  using Table = std::map<Key, Row>;
-  using Tables = absl::flat_hash_map<TableID, Table>;
+  // RowVersion is the image of a row as of the timestamp it was written at.
+  // Column values are stored contiguously, indexed by the column's slot within
+  // the table. Slots beyond the end of values hold no value.
+  // Large values of older versions are moved to `compressed`, leaving an
+  // invalid value at their slot.
+  struct CompressedValue {
+    int slot;
+    zetasql::TypeKind type_kind;
+    size_t size;
+
+    // Compressed contents, shared by the copies of the version.
+    std::shared_ptr<const std::string> data;
+  };
+  struct RowVersion {
+    absl::Time timestamp = absl::InfinitePast();
+    bool exists = false;
+    std::vector<zetasql::Value> values;
+    std::vector<CompressedValue> compressed;
+  };
+
+  // RangeTombstone records the delete of the rows with encoded keys in
+  // [start_key, limit_key) at a timestamp. It hides the versions of these rows
+  // written before the timestamp from reads at or after it.
+  struct RangeTombstone {
+    std::string start_key;
+    std::string limit_key;
+    absl::Time timestamp;
+  };
+
+  // Row keeps its latest version inline so that reads at recent timestamps
+  // touch a single contiguous vector. Older versions are pushed to a side chain
+  // sorted in increasing order of timestamp.
+  struct Row {
+    RowVersion latest;
+    std::vector<RowVersion> history;
+  };
+#ifdef SPANNER_EMULATOR_BPLUS_TREE_ROWS
+  using Rows = BPlusTree<Row>;
+#else
+  using Rows = std::map<std::string, Row>;
+#endif
+
+  // True if inserting rows leaves iterators to other rows valid, as it does
+  // for std::map but not for BPlusTree.
+  static constexpr bool kInsertsKeepRowIterators =
+      !std::is_same<Rows, BPlusTree<Row>>::value;
+
+  // Position at which a read of a table stopped before the end of its key
+  // range: the last row it returned, which remains valid for as long as the
+  // table's generation is unchanged.
+  struct ReadCursor {
+    Rows::const_iterator last_row;
+    int64_t generation;
+  };
+
+  // Position found by a read which searched a table for its start key: the
+  // first row at or after the key, which remains valid for as long as the
+  // table's generation is unchanged. Rows inserted since may have moved the
+  // first row at or after the key, so the position is checked against its
+  // neighbors before it is used.
+  struct CachedPosition {
+    Rows::const_iterator row;
+    int64_t generation;
+
+    // Position of the start key in Table::positions_lru.
+    std::list<std::string>::iterator lru_position;
+  };
+
+  // TableIterator yields the rows of a table lazily, see the definition in
+  // in_memory_storage.cc for details.
+  class TableIterator;
+
+  // Interleaving places the rows of a table within the table of its
+  // interleave root, see InterleaveTable. The stored key of a row is its key
+  // with a tag column inserted after the key columns of each of its ancestors,
+  // which tells apart the tables interleaved in the same parent. The root
+  // keeps its keys as they are.
+  struct Interleaving {
+    // The interleave root, whose table holds the rows.
+    TableID root_id;
+
+    // The table this one is interleaved in, empty for the root.
+    TableID parent_id;
+
+    // Number of key columns of the table.
+    int num_key_columns = 0;
+
+    // Numbers of key columns of the ancestors of the table below which its
+    // rows are stored, from the root down, and the tags inserted after them.
+    // Both are empty for the root.
+    std::vector<int> boundaries;
+    std::vector<int64_t> tags;
+
+    // True if tables are interleaved in this one.
+    bool has_children = false;
+
+    // Timestamp of the drop of the table. Reads at or after it skip the rows
+    // of the table, which garbage collection erases once it is past the
+    // horizon.
+    absl::Time drop_timestamp = absl::InfiniteFuture();
+  };
+
+  // InterleavedIterator yields the rows of co-located tables out of a read of
+  // their root, see the definition in in_memory_storage.cc for details.
+  class InterleavedIterator;
+
+  // Hashes and compares interned values by their type and contents.
+  struct InternedValueHash {
+    size_t operator()(const zetasql::Value& value) const;
+  };
+  struct InternedValueEq {
+    bool operator()(const zetasql::Value& a, const zetasql::Value& b) const;
+  };
+
+  // InternedValues is the dictionary of the values interned by writes to a
+  // table. Each entry counts the column values stored in the table's rows
+  // which share its buffer, and is removed once none does.
+  struct InternedValues {
+    absl::flat_hash_map<zetasql::Value, int64_t, InternedValueHash,
+                        InternedValueEq>
+        refs;
+
+    // Approximate bytes of memory held by the entries.
+    int64_t bytes = 0;
+
+    // Set once the dictionary has held kMaxInternedValuesPerTable entries,
+    // after which no value is added to it. This keeps values which were
+    // stored without being interned from being mistaken for interned ones.
+    bool full = false;
+  };
+
+  // Table holds the rows of a single table along with the mutex guarding them.
+  // Readers acquire the mutex in shared mode, so concurrent reads never block
+  // each other, and writers only contend with operations on the same table.
+  struct Table {
+    mutable absl::Mutex mu;
+
+    // Position of each column's value within RowVersion::values. Slots are
+    // assigned in the order columns are first written, which follows the
+    // schema order of columns for writes flushed by transactions.
+    absl::flat_hash_map<ColumnID, int> column_slots ABSL_GUARDED_BY(mu);
+
+    Rows rows ABSL_GUARDED_BY(mu);
+
+    // Incremented whenever rows are erased, or inserted unless
+    // kInsertsKeepRowIterators, which invalidates iterators into rows.
+    int64_t generation ABSL_GUARDED_BY(mu) = 0;
+
+    // Range deletes which have not been applied to the rows they cover, in the
+    // order they were made.
+    std::vector<RangeTombstone> tombstones ABSL_GUARDED_BY(mu);
+
+    // Latest timestamp at which a row of the table was written or deleted.
+    absl::Time max_write_timestamp ABSL_GUARDED_BY(mu) = absl::InfinitePast();
+
+    // Number of rows erased by garbage collection since the rows were last
+    // rebuilt, see CompactRows.
+    int64_t rows_erased_since_compaction ABSL_GUARDED_BY(mu) = 0;
+
+    // Version of the rows, see Storage::GetTableVersion. Unlike
+    // max_write_timestamp, it also accounts for range tombstones and resets to
+    // checkpoints.
+    TableVersion version ABSL_GUARDED_BY(mu);
+
+    // Filter over the keys of rows, used only if key filters are enabled.
+    KeyFilter key_filter ABSL_GUARDED_BY(mu);
+
+    // Sample of the encoded keys of rows: the (up to) kMaxSampledKeysPerTable
+    // keys with the lowest hashes, along with their hashes. Since hashes are
+    // independent of keys, this is a uniform sample of the rows, and a key's
+    // place in it does not depend on the order rows were inserted in.
+    std::set<std::pair<size_t, std::string>> key_sample ABSL_GUARDED_BY(mu);
+
+    // Values interned by writes to the table, used only if interning is
+    // enabled. The bytes of the dictionary are included in those of the table.
+    InternedValues interned ABSL_GUARDED_BY(mu);
+
+    // Approximate bytes of memory held by the rows, see RowBytes. Only updated
+    // with mu held, but read without it.
+    std::atomic<int64_t> bytes{0};
+
+    // Positions at which the latest reads of the table stopped, most recent
+    // last, so that a read starting right after the last row returned by one
+    // (such as the next page of a paginated read) continues from there
+    // instead of searching the rows. Guarded by their own mutex, since they
+    // are updated by readers, which hold mu in shared mode.
+    mutable absl::Mutex cursors_mu;
+    mutable std::deque<ReadCursor> cursors ABSL_GUARDED_BY(cursors_mu);
+
+    // Positions of the start keys of the latest reads which searched the
+    // rows, by encoded start key, so that reads of the same hot ranges skip
+    // the search. The least recently used position is evicted first.
+    mutable absl::flat_hash_map<std::string, CachedPosition> positions
+        ABSL_GUARDED_BY(cursors_mu);
+    mutable std::list<std::string> positions_lru ABSL_GUARDED_BY(cursors_mu);
+  };
+
+  // The rows of a table visible at the timestamp of a checkpoint, each reduced
+  // to the version visible then, along with the slots their values are laid
+  // out by.
+  struct TableCheckpoint {
+    absl::flat_hash_map<ColumnID, int> column_slots;
+    Rows rows;
+  };
+
+  // A table detached by DropTable, along with the timestamp it was dropped at.
+  struct DroppedTable {
+    absl::Time timestamp;
+    std::shared_ptr<Table> table;
+  };
+
+  // A checkpoint of this storage, see the definition in in_memory_storage.cc.
+  class CheckpointData;
+
+  // Returns the table with the given id as seen by reads at the specified
+  // timestamp, or nullptr if it does not exist. Reads before a table was
+  // dropped find the dropped table. The table remains valid for as long as the
+  // returned pointer is held, even if garbage collection frees it meanwhile.
+  std::shared_ptr<Table> FindTable(
+      const TableID& table_id,
+      absl::Time timestamp = absl::InfiniteFuture()) const
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Frees the tables dropped at or before the horizon.
+  void FreeDroppedTables(absl::Time horizon) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the ids of the tables visible at the specified timestamp, along
+  // with the tables as FindTable returns them.
+  std::vector<std::pair<TableID, std::shared_ptr<Table>>> TablesAt(
+      absl::Time timestamp) const ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the table with the given id, creating it if it does not exist.
+  Table* FindOrCreateTable(const TableID& table_id) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the placement of the rows of the given table within its
+  // interleave root, or nullptr if its rows are stored in a table of its own,
+  // or if it was dropped at or before the specified timestamp.
+  std::shared_ptr<const Interleaving> FindInterleaving(
+      const TableID& table_id,
+      absl::Time timestamp = absl::InfiniteFuture()) const
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the co-located tables of the given root which were dropped at or
+  // before the specified timestamp.
+  std::vector<std::shared_ptr<const Interleaving>> DroppedInterleavings(
+      const TableID& root_id, absl::Time timestamp) const
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the stored key of a key (or key prefix) of a co-located table.
+  // Tags are inserted up to the end of the key, so that the stored keys of
+  // the rows with a given key prefix are those with the stored prefix.
+  static Key ToStoredKey(const Interleaving& interleaving, const Key& key);
+  static KeyRange ToStoredRange(const Interleaving& interleaving,
+                                const KeyRange& key_range);
+
+  // Returns true if the stored key is that of a row of the co-located table,
+  // rather than of another table of the same root.
+  static bool IsStoredKeyOf(const Interleaving& interleaving,
+                            const Key& stored_key);
+
+  // Returns true if the encoded stored key is that of a row of any of the
+  // given co-located tables. Only decodes the key if there are any.
+  static bool IsStoredKeyOfAny(
+      const std::vector<std::shared_ptr<const Interleaving>>& interleavings,
+      const std::string& encoded_key);
+
+  // Returns the key of a row of a co-located table given its stored key.
+  static Key FromStoredKey(const Interleaving& interleaving,
+                           const Key& stored_key);
+
+  // Replaces stored keys with the keys of the rows of the co-located table
+  // among them, dropping the keys of the rows of other tables.
+  static void ToKeysOf(const Interleaving& interleaving,
+                       std::vector<Key>* stored_keys);
+
+  // Returns true if the stored range of a co-located table lies under a
+  // single row of each of its ancestors, so that it holds no rows of other
+  // tables than the table itself and those interleaved in it.
+  static bool IsUnderSingleParent(const Interleaving& interleaving,
+                                  const KeyRange& stored_range);
+
+  // Deletes the rows of a co-located table within its stored range, along
+  // with the rows interleaved in them if `with_descendants`, in a single pass
+  // over the range which leaves the rows of the other tables in place. Unless
+  // they are deleted, the rows interleaved in a deleted row are skipped with a
+  // single seek.
+  absl::Status DeleteRowsOf(absl::Time timestamp,
+                            const Interleaving& interleaving,
+                            const KeyRange& stored_range, bool with_descendants)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Marks a co-located table dropped, see DropTable.
+  absl::Status DropInterleavedTable(absl::Time timestamp,
+                                    const TableID& table_id)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Erases the row at `row_itr` along with all its versions, adding the bytes
+  // it held to `pruned_bytes`. Returns the iterator to the next row.
+  Rows::iterator EraseRow(Table* table, Rows::iterator row_itr,
+                          int64_t* pruned_bytes)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(table->mu);
+
+  // Implementations of the methods of the same names for the table with the
+  // given id and the stored keys of its rows, which is the interleave root of
+  // co-located tables.
+  zetasql_base::StatusOr<bool> LookupIfExistsStored(
+      absl::Time timestamp, const TableID& table_id, const Key& key,
+      const std::vector<ColumnID>& column_ids,
+      std::vector<zetasql::Value>* values) const ABSL_LOCKS_EXCLUDED(mu_);
+  absl::Status ReadStored(absl::Time timestamp, const TableID& table_id,
+                          const KeyRange& key_range,
+                          const std::vector<ColumnID>& column_ids,
+                          std::unique_ptr<StorageIterator>* itr) const
+      ABSL_LOCKS_EXCLUDED(mu_);
+  absl::Status MultiLookupStored(absl::Time timestamp, const TableID& table_id,
+                                 const std::vector<Key>& keys,
+                                 const std::vector<ColumnID>& column_ids,
+                                 std::unique_ptr<StorageIterator>* itr) const
+      ABSL_LOCKS_EXCLUDED(mu_);
+  absl::Status SplitKeyRangeStored(const TableID& table_id,
+                                   const KeyRange& key_range, int max_ranges,
+                                   int64_t min_rows_per_range,
+                                   std::vector<Key>* split_keys) const
+      ABSL_LOCKS_EXCLUDED(mu_);
+  absl::Status WriteStored(absl::Time timestamp, const TableID& table_id,
+                           const Key& key,
+                           const std::vector<ColumnID>& column_ids,
+                           const std::vector<zetasql::Value>& values)
+      ABSL_LOCKS_EXCLUDED(mu_);
+  absl::Status DeleteStored(absl::Time timestamp, const TableID& table_id,
+                            const KeyRange& key_range) ABSL_LOCKS_EXCLUDED(mu_);
+  absl::Status WriteBatchStored(absl::Time timestamp, const TableID& table_id,
+                                const std::vector<StorageWrite>& writes)
+      ABSL_LOCKS_EXCLUDED(mu_);
+  absl::Status DropTableStored(absl::Time timestamp, const TableID& table_id)
+      ABSL_LOCKS_EXCLUDED(mu_);
+  absl::optional<TableVersion> GetTableVersionStored(
+      const TableID& table_id) const ABSL_LOCKS_EXCLUDED(mu_);
+  zetasql_base::StatusOr<bool> ChangedSinceStored(absl::Time timestamp,
+                                          const TableID& table_id,
+                                          const KeyRange& key_range) const
+      ABSL_LOCKS_EXCLUDED(mu_);
+  absl::optional<TableStatistics> GetTableStatisticsStored(
+      const TableID& table_id) const ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns false if no key of the table has the given prefix, according to
+  // the table's key filter. Always returns true if key filters are disabled.
+  bool MayContain(const Table& table, const Key& prefix) const
+      ABSL_SHARED_LOCKS_REQUIRED(table.mu);
+
+  // Adds the key of a new row to the table's key filter, rebuilding the filter
+  // with a larger capacity once it is full.
+  void AddToKeyFilter(Table* table, const Key& key) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(table->mu);
+
+  // Rebuilds the table's key filter from the keys of its rows, sized for
+  // twice as many prefixes as it holds.
+  void RebuildKeyFilter(Table* table) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(table->mu);
+
+  // Adds the encoded key of a new row to the table's key sample.
+  static void AddToKeySample(Table* table, const std::string& encoded_key)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(table->mu);
+
+  // Rebuilds the table's key sample from the keys of its rows, dropping the
+  // keys of rows which were erased.
+  static void RebuildKeySample(Table* table)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(table->mu);
+
+  // Returns the version of the row visible at the specified timestamp, or
+  // nullptr if the row was not written at or before the timestamp.
+  static const RowVersion* VersionAt(const Row& row, absl::Time timestamp);
+
+  // Returns an iterator to the first version in the row's history which is
+  // newer than the specified timestamp.
+  static std::vector<RowVersion>::const_iterator FirstVersionAfter(
+      const Row& row, absl::Time timestamp);
 
   // Returns true if the given row is valid at the specified timestamp.
-  bool Exists(const Row& row, absl::Time timestamp) const
-      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  static bool Exists(const Row& row, absl::Time timestamp);
+
+  // Returns the first row of the table whose encoded key is at or after
+  // `start_key`, resuming from a read cursor of the table if one stopped
+  // right before it, or from the cached position of an earlier read with the
+  // same start key.
+  static Rows::const_iterator SeekRow(const Table& table,
+                                      const std::string& start_key)
+      ABSL_SHARED_LOCKS_REQUIRED(table.mu);
+
+  // Records the position of a read of the table which stopped before the end
+  // of its key range, evicting the oldest cursor if the table has too many.
+  static void AddReadCursor(const Table& table, Rows::const_iterator last_row,
+                            int64_t generation);
+
+  // Returns the version of the row with the given encoded key visible at the
+  // specified timestamp, or nullptr if the row does not exist then, either
+  // because it was not written or deleted, or because a range tombstone of the
+  // table hides it.
+  static const RowVersion* VisibleVersionAt(const Table& table,
+                                            const std::string& encoded_key,
+                                            const Row& row,
+                                            absl::Time timestamp)
+      ABSL_SHARED_LOCKS_REQUIRED(table.mu);
+
+  // Marks the row with the given encoded key deleted at the timestamp of the
+  // earliest range tombstone of the table which hides it from reads at the
+  // specified timestamp. Called before the row is written at that timestamp,
+  // so that the write does not carry over values of the deleted row.
+  absl::Status ApplyTombstones(Table* table, const std::string& encoded_key,
+                               Row* row, absl::Time timestamp)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(table->mu);
+
+  // Erases the rows hidden by the range tombstones of the table which are at
+  // or before the horizon, and drops these tombstones.
+  void CollectTombstones(Table* table, absl::Time horizon)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(table->mu);
+
+  // Returns true if enough of the rows of the table were erased since it was
+  // last compacted for CompactRows to be worth it.
+  static bool ShouldCompact(const Table& table)
+      ABSL_SHARED_LOCKS_REQUIRED(table.mu);
+
+  // Rebuilds the rows of the table into a new container holding the same
+  // rows, and trims the histories of their versions to size.
+  void CompactRows(Table* table) ABSL_EXCLUSIVE_LOCKS_REQUIRED(table->mu);
+
+  // Returns the slots of the given columns, or -1 for columns which have never
+  // been written to the table.
+  static std::vector<int> GetColumnSlots(const Table& table,
+                                         const std::vector<ColumnID>& column_ids)
+      ABSL_SHARED_LOCKS_REQUIRED(table.mu);
+
+  // Returns the value stored at the given slot of a row version.
+  static zetasql::Value GetColumnValue(const RowVersion& version, int slot);
+
+  // Returns the compressed value stored at the given slot of a row version,
+  // decompressed, or an invalid value if there is none.
+  static zetasql::Value DecompressValue(const RowVersion& version, int slot);
+
+  // Compresses the large values of a version pushed to the history of a row.
+  void CompressValues(RowVersion* version);
+
+  // Sets the value at the given slot of a version, dropping the compressed
+  // value previously stored there if any.
+  static void SetColumnValue(RowVersion* version, int slot,
+                             const zetasql::Value& value);
+
+  // Returns true if the value may be interned.
+  static bool IsInternable(const zetasql::Value& value);
+
+  // Returns the interned copy of a value about to be stored, adding it to the
+  // dictionary if it has room and adding the bytes of a new entry to
+  // `dictionary_bytes`. Returns the value itself if it is not internable or
+  // interning is disabled.
+  const zetasql::Value& Intern(InternedValues* interned,
+                               const zetasql::Value& value,
+                               int64_t* dictionary_bytes);
+
+  // Releases the values of a version which is no longer stored, removing the
+  // entries no longer shared by any stored value and subtracting their bytes
+  // from `dictionary_bytes`.
+  void Release(InternedValues* interned, const RowVersion& version,
+               int64_t* dictionary_bytes);
+  void Release(InternedValues* interned, const zetasql::Value& value,
+               int64_t* dictionary_bytes);
+
+  // Accounts for a new copy of a stored version, such as the one kept in the
+  // history of a row when it is written again.
+  static void Retain(InternedValues* interned, const RowVersion& version);
+
+  // Returns the version of the row to modify at the specified timestamp,
+  // pushing the current latest version to the history if it is older.
+  // Versions can only be appended, so timestamps older than the latest version
+  // of the row result in INTERNAL.
+  static zetasql_base::StatusOr<RowVersion*> MutableVersionAt(
+      Row* row, absl::Time timestamp);
+
+  // Writes the given column values to the row at the specified timestamp.
+  absl::Status WriteRow(Table* table, Row* row, absl::Time timestamp,
+                        const std::vector<ColumnID>& column_ids,
+                        const std::vector<zetasql::Value>& values)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(table->mu);
+
+  // Marks the row as deleted at the specified timestamp if it exists.
+  absl::Status DeleteRow(Table* table, Row* row, absl::Time timestamp)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(table->mu);
+
+  // Removes the versions of the row which are not visible at or after the
+  // horizon, adding their bytes to `pruned_bytes`. Returns true if the row is
+  // not visible at all and can be erased.
+  bool PruneVersions(InternedValues* interned, Row* row, absl::Time horizon,
+                     int64_t* pruned_bytes);
 
-  // Returns the value for given row and column_id at the specified timestamp.
-  zetasql::Value GetCellValueAtTimestamp(const Row& row,
-                                           const ColumnID& column_id,
-                                           absl::Time timestamp) const
-      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Returns the approximate bytes of memory held by a stored column value.
+  // Interned values share their buffer with an entry of the dictionary, whose
+  // bytes are accounted for separately.
+  static int64_t ValueBytes(const InternedValues& interned,
+                            const zetasql::Value& value);
 
+  // Returns the approximate bytes of memory held by a version of a row: the
+  // version itself and its column values.
+  static int64_t VersionBytes(const InternedValues& interned,
+                              const RowVersion& version);
+
+  // Returns the approximate bytes of memory held by a row of a table: its key,
+  // its versions and the overhead of its entry in the table.
+  static int64_t RowBytes(const InternedValues& interned,
+                          const std::string& encoded_key, const Row& row);
+
+  // Returns the approximate bytes of memory held by a range tombstone.
+  static int64_t TombstoneBytes(const RangeTombstone& tombstone);
+
+  // Returns the change in the bytes of `row` since its latest version held
+  // `latest_bytes` and its history had `history_size` versions, given that it
+  // was modified by a single write or delete.
+  static int64_t ChangedBytes(const InternedValues& interned, const Row& row,
+                              int64_t latest_bytes, size_t history_size);
+
+  // Records a change to the rows of `table` made at the specified timestamp
+  // in its version.
+  void RecordChange(Table* table, absl::Time timestamp)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(table->mu);
+
+  // Adds `delta` to the bytes of `table` and of the storage.
+  void AddBytes(Table* table, int64_t delta)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(table->mu);
+
+  // Mutex to guard the set of tables. It is only held while looking up a
+  // table. Tables are shared with the callers which found them, so a table
+  // remains valid after the mutex is released even if it is dropped.
   mutable absl::Mutex mu_;
-  Tables tables_ ABSL_GUARDED_BY(mu_);
+  absl::flat_hash_map<TableID, std::shared_ptr<Table>> tables_
+      ABSL_GUARDED_BY(mu_);
+
+  // Tables detached by DropTable and not yet freed by garbage collection, in
+  // the order they were dropped.
+  absl::flat_hash_map<TableID, std::vector<DroppedTable>> dropped_tables_
+      ABSL_GUARDED_BY(mu_);
+
+  // Versions of the tables last dropped, which tables recreated under the
+  // same ids start from, so that the version of a table never goes back.
+  // Kept after the dropped tables are freed.
+  absl::flat_hash_map<TableID, TableVersion> dropped_versions_
+      ABSL_GUARDED_BY(mu_);
+
+  // Placements of the co-located tables and of their roots, by table id.
+  // Entries are replaced rather than modified, so that they remain valid for
+  // the callers which found them.
+  absl::flat_hash_map<TableID, std::shared_ptr<const Interleaving>>
+      interleavings_ ABSL_GUARDED_BY(mu_);
+
+  // Tag of the next table declared interleaved.
+  int64_t next_interleave_tag_ ABSL_GUARDED_BY(mu_) = 0;
+
+  // True if tables keep key filters.
+  const bool use_key_filters_;
+
+  // True if tables intern the values written to them.
+  const bool intern_values_;
+
+  // Size from which values of older versions are compressed, or 0 if they
+  // are never compressed.
+  const int64_t compression_threshold_bytes_;
+
+  // True if the rows of interleaved tables are stored with those of their
+  // interleave roots.
+  const bool colocate_interleaved_tables_;
+
+  // Number of changes made to the rows of all tables, from which the versions
+  // of tables are assigned so that a table recreated after a drop never reuses
+  // the version of the dropped one.
+  std::atomic<int64_t> num_changes_{0};
+
+  // Approximate bytes of memory held by the rows of all tables.
+  std::atomic<int64_t> total_bytes_{0};
+
+  // Key filter counters, see KeyFilterStats.
+  mutable std::atomic<int64_t> key_filter_probes_{0};
+  mutable std::atomic<int64_t> key_filter_negatives_{0};
+
+  // Interning counters, see InterningStats.
+  std::atomic<int64_t> interned_distinct_values_{0};
+  std::atomic<int64_t> interned_shared_values_{0};
+  std::atomic<int64_t> interned_bytes_saved_{0};
+
+  // Compression counters, see CompressionStats.
+  std::atomic<int64_t> compressed_values_{0};
+  std::atomic<int64_t> compressed_bytes_saved_{0};
+
+  // Compaction counters, see CompactionStats.
+  std::atomic<int64_t> compactions_{0};
+  std::atomic<int64_t> rows_compacted_{0};
 };
 
 }  // namespace backend
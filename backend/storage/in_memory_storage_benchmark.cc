@@ -0,0 +1,168 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Measures the latency of InMemoryStorage lookups, reads and writes for tables
+// of increasing size and width.
+//
+// Usage: in_memory_storage_benchmark [--benchmark_format=table|json]
+//            [--benchmark_min_time=500ms] [--benchmark_filter=...]
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "zetasql/public/value.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "backend/common/ids.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/storage/in_memory_storage.h"
+#include "backend/storage/iterator.h"
+#include "common/benchmark.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+constexpr int kNumRows[] = {1000, 100000};
+constexpr int kNumColumns[] = {1, 16};
+
+// Number of rows returned by each read.
+constexpr int kRowsPerRead = 100;
+
+const TableID kTableId = "table:0";
+
+std::vector<ColumnID> MakeColumnIDs(int num_columns) {
+  std::vector<ColumnID> column_ids;
+  for (int i = 0; i < num_columns; ++i) {
+    column_ids.push_back(absl::StrCat("column:", i));
+  }
+  return column_ids;
+}
+
+std::vector<zetasql::Value> MakeValues(int num_columns, int64_t row) {
+  std::vector<zetasql::Value> values;
+  for (int i = 0; i < num_columns; ++i) {
+    values.push_back(zetasql::values::Int64(row * num_columns + i));
+  }
+  return values;
+}
+
+Key MakeKey(int64_t row) { return Key({zetasql::values::Int64(row)}); }
+
+// Writes `num_rows` rows of `column_ids` to the table at `timestamp`.
+void Populate(InMemoryStorage* storage, absl::Time timestamp, int num_rows,
+              const std::vector<ColumnID>& column_ids) {
+  for (int64_t row = 0; row < num_rows; ++row) {
+    absl::Status status =
+        storage->Write(timestamp, kTableId, MakeKey(row), column_ids,
+                       MakeValues(column_ids.size(), row));
+    if (!status.ok()) {
+      std::fprintf(stderr, "%s\n", status.ToString().c_str());
+      return;
+    }
+  }
+}
+
+// Reads kRowsPerRead rows of the table, starting at row `start`.
+absl::Status ReadRows(const InMemoryStorage& storage, absl::Time timestamp,
+                      const std::vector<ColumnID>& column_ids, int64_t start) {
+  std::unique_ptr<StorageIterator> itr;
+  ZETASQL_RETURN_IF_ERROR(storage.Read(
+      timestamp, kTableId,
+      KeyRange::ClosedOpen(MakeKey(start), MakeKey(start + kRowsPerRead)),
+      column_ids, &itr));
+  while (itr->Next()) {
+  }
+  return itr->Status();
+}
+
+void RunBenchmark() {
+  BenchmarkRunner runner;
+  for (int num_columns : kNumColumns) {
+    std::vector<ColumnID> column_ids = MakeColumnIDs(num_columns);
+    for (int num_rows : kNumRows) {
+      std::string suffix =
+          absl::StrCat("/rows:", num_rows, "/columns:", num_columns);
+      InMemoryStorage storage;
+      absl::Time timestamp = absl::Now();
+      Populate(&storage, timestamp, num_rows, column_ids);
+
+      runner.Run(absl::StrCat("Lookup", suffix), [&](int64_t iterations) {
+        std::vector<zetasql::Value> values;
+        for (int64_t i = 0; i < iterations; ++i) {
+          absl::Status status =
+              storage.Lookup(timestamp, kTableId, MakeKey(i % num_rows),
+                             column_ids, &values);
+          if (!status.ok()) {
+            std::fprintf(stderr, "%s\n", status.ToString().c_str());
+            return;
+          }
+        }
+      });
+
+      runner.Run(absl::StrCat("Read", suffix, "/rows_per_read:", kRowsPerRead),
+                 [&](int64_t iterations) {
+                   for (int64_t i = 0; i < iterations; ++i) {
+                     absl::Status status =
+                         ReadRows(storage, timestamp, column_ids,
+                                  i * kRowsPerRead % num_rows);
+                     if (!status.ok()) {
+                       std::fprintf(stderr, "%s\n", status.ToString().c_str());
+                       return;
+                     }
+                   }
+                 });
+
+      // Each write adds a version to an existing row, at a new timestamp as
+      // commits do.
+      runner.Run(absl::StrCat("Write", suffix), [&](int64_t iterations) {
+        for (int64_t i = 0; i < iterations; ++i) {
+          timestamp += absl::Microseconds(1);
+          absl::Status status =
+              storage.Write(timestamp, kTableId, MakeKey(i % num_rows),
+                            column_ids, MakeValues(num_columns, i));
+          if (!status.ok()) {
+            std::fprintf(stderr, "%s\n", status.ToString().c_str());
+            return;
+          }
+        }
+      });
+    }
+  }
+  runner.Report();
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  google::spanner::emulator::backend::RunBenchmark();
+  return 0;
+}
@@ -16,10 +16,18 @@
 
 #include "backend/storage/in_memory_storage.h"
 
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "zetasql/base/testing/status_matchers.h"
 #include "tests/common/proto_matchers.h"
+#include "absl/strings/str_cat.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "backend/datamodel/key_range.h"
@@ -33,6 +41,7 @@ namespace backend {
 namespace {
 
 using zetasql::values::Bool;
+using zetasql::values::Bytes;
 using zetasql::values::Int64;
 using zetasql::values::String;
 
@@ -111,6 +120,207 @@ TEST_F(InMemoryStorageTest, ReadRangeFromSingleTable) {
   EXPECT_FALSE(itr_->Next());
 }
 
+TEST_F(InMemoryStorageTest, ReadsRowsInBatches) {
+  absl::Time t0 = absl::Now();
+  const int kNumRows = 300;
+  for (int i = 0; i < kNumRows; ++i) {
+    ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(i)}), {kColumnID},
+                             {String(absl::StrCat("value-", i))}));
+  }
+
+  // Batches span the rows buffered by the iterator, and can be interleaved
+  // with reads of single rows.
+  ZETASQL_EXPECT_OK(
+      storage_.Read(t0, kTableId0, KeyRange::All(), {kColumnID}, &itr_));
+  std::vector<Key> keys;
+  std::vector<zetasql::Value> values;
+  StorageIterator::Batch batch;
+  ASSERT_TRUE(itr_->NextBatch(100, &batch));
+  EXPECT_EQ(batch.keys.size(), 100);
+  keys = batch.keys;
+  values = batch.columns[0];
+  ASSERT_TRUE(itr_->Next());
+  keys.push_back(itr_->Key());
+  values.push_back(itr_->ColumnValue(0));
+  while (itr_->NextBatch(1000, &batch)) {
+    keys.insert(keys.end(), batch.keys.begin(), batch.keys.end());
+    values.insert(values.end(), batch.columns[0].begin(),
+                  batch.columns[0].end());
+  }
+  ZETASQL_EXPECT_OK(itr_->Status());
+  EXPECT_FALSE(itr_->Next());
+
+  ASSERT_EQ(keys.size(), kNumRows);
+  ASSERT_EQ(values.size(), kNumRows);
+  for (int i = 0; i < kNumRows; ++i) {
+    EXPECT_EQ(keys[i], Key({Int64(i)}));
+    EXPECT_EQ(values[i], String(absl::StrCat("value-", i)));
+  }
+}
+
+TEST_F(InMemoryStorageTest, ReadsCellsOfEachColumnAcrossBatches) {
+  absl::Time t0 = absl::Now();
+  const ColumnID kColumnID1 = "test_column:1";
+  const ColumnID kMissingColumnID = "test_column:2";
+  const int kNumRows = 300;
+  for (int i = 0; i < kNumRows; ++i) {
+    // Every third row leaves the second column unset.
+    if (i % 3 == 0) {
+      ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(i)}), {kColumnID},
+                               {Int64(i)}));
+    } else {
+      ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(i)}),
+                               {kColumnID, kColumnID1},
+                               {Int64(i), String(absl::StrCat("value-", i))}));
+    }
+  }
+  auto expect_row = [&](int i, const zetasql::Value& value0,
+                        const zetasql::Value& value1,
+                        const zetasql::Value& missing_value) {
+    EXPECT_EQ(value0, Int64(i));
+    if (i % 3 == 0) {
+      EXPECT_FALSE(value1.is_valid());
+    } else {
+      EXPECT_EQ(value1, String(absl::StrCat("value-", i)));
+    }
+    EXPECT_FALSE(missing_value.is_valid());
+  };
+
+  // Cells are yielded in the order of the columns read, both by single rows
+  // and by batches which span the rows buffered by the iterator.
+  ZETASQL_EXPECT_OK(storage_.Read(t0, kTableId0, KeyRange::All(),
+                          {kColumnID1, kMissingColumnID, kColumnID}, &itr_));
+  int i = 0;
+  for (; i < 150; ++i) {
+    ASSERT_TRUE(itr_->Next());
+    EXPECT_EQ(itr_->Key(), Key({Int64(i)}));
+    expect_row(i, itr_->ColumnValue(2), itr_->ColumnValue(0),
+               itr_->ColumnValue(1));
+  }
+  StorageIterator::Batch batch;
+  while (itr_->NextBatch(100, &batch)) {
+    ASSERT_EQ(batch.columns.size(), 3);
+    for (int row = 0; row < batch.keys.size(); ++row, ++i) {
+      EXPECT_EQ(batch.keys[row], Key({Int64(i)}));
+      expect_row(i, batch.columns[2][row], batch.columns[0][row],
+                 batch.columns[1][row]);
+    }
+  }
+  ZETASQL_EXPECT_OK(itr_->Status());
+  EXPECT_EQ(i, kNumRows);
+
+  // Lookups return the cells of the columns in the same order.
+  std::vector<zetasql::Value> values;
+  ZETASQL_EXPECT_OK(storage_.Lookup(t0, kTableId0, Key({Int64(4)}),
+                            {kColumnID1, kMissingColumnID, kColumnID},
+                            &values));
+  ASSERT_EQ(values.size(), 3);
+  expect_row(4, values[2], values[0], values[1]);
+}
+
+// Reads of successive pages, each starting after the last key of the previous
+// one, resume from where the previous read stopped.
+TEST_F(InMemoryStorageTest, ReadsSuccessivePages) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  absl::Time t2 = t0 + absl::Seconds(2);
+  const int kNumRows = 1000;
+  const int kPageSize = 100;
+  for (int i = 0; i < kNumRows; i += 2) {
+    ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(i)}), {kColumnID},
+                             {String(absl::StrCat("value-", i))}));
+  }
+
+  std::vector<Key> keys;
+  Key start_key;
+  absl::Time timestamp = t0;
+  for (int num_rows = kPageSize; num_rows == kPageSize;) {
+    ZETASQL_ASSERT_OK(storage_.Read(timestamp, kTableId0,
+                            KeyRange::ClosedOpen(start_key, Key::Infinity()),
+                            {kColumnID}, &itr_));
+    for (num_rows = 0; num_rows < kPageSize && itr_->Next(); ++num_rows) {
+      keys.push_back(itr_->Key());
+      start_key = itr_->Key().ToPrefixLimit();
+    }
+    itr_.reset();
+
+    // Rows written between pages are returned by later pages which read them,
+    // and rows erased by garbage collection are not.
+    if (keys.size() == 2 * kPageSize) {
+      ZETASQL_EXPECT_OK(storage_.Write(t1, kTableId0, Key({Int64(401)}),
+                               {kColumnID}, {String("value-401")}));
+      ZETASQL_EXPECT_OK(storage_.Write(t1, kTableId0, Key({Int64(403)}),
+                               {kColumnID}, {String("value-403")}));
+      ZETASQL_EXPECT_OK(storage_.Delete(t1, kTableId0,
+                                KeyRange::Point(Key({Int64(404)}))));
+      timestamp = t1;
+    }
+    if (keys.size() == 3 * kPageSize + 2) {
+      ZETASQL_EXPECT_OK(storage_.Delete(t2, kTableId0,
+                                KeyRange::Point(Key({Int64(600)}))));
+      storage_.CollectGarbage(t2);
+      timestamp = t2;
+    }
+  }
+
+  std::vector<Key> expected;
+  for (int i = 0; i < kNumRows; i += 2) {
+    if (i == 402) {
+      expected.push_back(Key({Int64(401)}));
+      expected.push_back(Key({Int64(402)}));
+      expected.push_back(Key({Int64(403)}));
+    } else if (i != 404 && i != 600) {
+      expected.push_back(Key({Int64(i)}));
+    }
+  }
+  EXPECT_THAT(keys, testing::ElementsAreArray(expected));
+}
+
+TEST_F(InMemoryStorageTest, RepeatedRangeReadsSeeRowsChangedSinceLastRead) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  absl::Time t2 = t0 + absl::Seconds(2);
+  for (int i = 0; i < 10; i += 2) {
+    ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(i)}), {kColumnID},
+                             {String(absl::StrCat("value-", i))}));
+  }
+  auto read_keys = [this](absl::Time timestamp) {
+    std::vector<Key> keys;
+    ZETASQL_EXPECT_OK(storage_.Read(
+        timestamp, kTableId0,
+        KeyRange::ClosedOpen(Key({Int64(3)}), Key({Int64(9)})), {kColumnID},
+        &itr_));
+    while (itr_->Next()) {
+      keys.push_back(itr_->Key());
+    }
+    itr_.reset();
+    return keys;
+  };
+
+  // Reads of the same range start from the position found by the first read.
+  EXPECT_THAT(read_keys(t0), testing::ElementsAre(Key({Int64(4)}),
+                                                  Key({Int64(6)}),
+                                                  Key({Int64(8)})));
+  EXPECT_THAT(read_keys(t0), testing::ElementsAre(Key({Int64(4)}),
+                                                  Key({Int64(6)}),
+                                                  Key({Int64(8)})));
+
+  // A row inserted just before the cached position is read.
+  ZETASQL_EXPECT_OK(storage_.Write(t1, kTableId0, Key({Int64(3)}), {kColumnID},
+                           {String("value-3")}));
+  EXPECT_THAT(read_keys(t1), testing::ElementsAre(
+                                 Key({Int64(3)}), Key({Int64(4)}),
+                                 Key({Int64(6)}), Key({Int64(8)})));
+
+  // A cached row erased by garbage collection is not.
+  ZETASQL_EXPECT_OK(
+      storage_.Delete(t2, kTableId0, KeyRange::Point(Key({Int64(3)}))));
+  storage_.CollectGarbage(t2);
+  EXPECT_THAT(read_keys(t2), testing::ElementsAre(Key({Int64(4)}),
+                                                  Key({Int64(6)}),
+                                                  Key({Int64(8)})));
+}
+
 TEST_F(InMemoryStorageTest, LookupByTimestamp) {
   absl::Time write_ts = absl::Now();
 
@@ -209,6 +419,29 @@ TEST_F(InMemoryStorageTest, LookupMissingKeyReturnsNotFound) {
       zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
 }
 
+TEST_F(InMemoryStorageTest, LookupIfExistsReturnsFalseForMissingKeys) {
+  absl::Time t0 = absl::Now();
+
+  std::vector<zetasql::Value> values;
+  ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(1)}), {kColumnID},
+                           {String("value-1")}));
+  EXPECT_THAT(storage_.LookupIfExists(t0, kTableId0, Key({Int64(100)}),
+                                      {kColumnID}, &values),
+              zetasql_base::testing::IsOkAndHolds(false));
+  EXPECT_TRUE(values.empty());
+  EXPECT_THAT(storage_.LookupIfExists(t0, "invalid-table_id_", Key({Int64(1)}),
+                                      {kColumnID}, &values),
+              zetasql_base::testing::IsOkAndHolds(false));
+  EXPECT_THAT(storage_.LookupIfExists(t0 - absl::Seconds(1), kTableId0,
+                                      Key({Int64(1)}), {kColumnID}, &values),
+              zetasql_base::testing::IsOkAndHolds(false));
+
+  EXPECT_THAT(storage_.LookupIfExists(t0, kTableId0, Key({Int64(1)}),
+                                      {kColumnID}, &values),
+              zetasql_base::testing::IsOkAndHolds(true));
+  EXPECT_THAT(values, testing::ElementsAre(String("value-1")));
+}
+
 TEST_F(InMemoryStorageTest, ReadMissingKeyReturnsEmptyItr) {
   absl::Time t0 = absl::Now();
   KeyRange key_range = KeyRange::ClosedOpen(Key({Int64(10)}), Key({Int64(50)}));
@@ -655,6 +888,159 @@ TEST_F(InMemoryStorageTest, ReadUsingPointKeyRange) {
   EXPECT_FALSE(itr_->Next());
 }
 
+TEST_F(InMemoryStorageTest, MultiLookupReturnsExistingRowsInKeyOrder) {
+  absl::Time write_ts = absl::Now();
+  absl::Time delete_ts = write_ts + absl::Seconds(1);
+  absl::Time read_ts = delete_ts + absl::Seconds(1);
+
+  for (int i = 0; i < 20; i += 2) {
+    ZETASQL_EXPECT_OK(storage_.Write(write_ts, kTableId0, Key({Int64(i)}),
+                             {kColumnID}, {Int64(i)}));
+  }
+  ZETASQL_EXPECT_OK(
+      storage_.Delete(delete_ts, kTableId0, KeyRange::Point(Key({Int64(4)}))));
+
+  // Odd keys were never written, key 4 was deleted and key 18 is far enough
+  // from key 2 that the table has to be searched for it.
+  ZETASQL_EXPECT_OK(storage_.MultiLookup(
+      read_ts, kTableId0,
+      {Key({Int64(1)}), Key({Int64(2)}), Key({Int64(2)}), Key({Int64(4)}),
+       Key({Int64(6)}), Key({Int64(18)}), Key({Int64(30)})},
+      {kColumnID}, &itr_));
+  std::vector<int64_t> keys;
+  while (itr_->Next()) {
+    EXPECT_EQ(itr_->Key().ColumnValue(0), itr_->ColumnValue(0));
+    keys.push_back(itr_->Key().ColumnValue(0).int64_value());
+  }
+  ZETASQL_EXPECT_OK(itr_->Status());
+  EXPECT_THAT(keys, testing::ElementsAre(2, 6, 18));
+
+  // Reads before the delete still see key 4.
+  ZETASQL_EXPECT_OK(storage_.MultiLookup(write_ts, kTableId0, {Key({Int64(4)})},
+                                 {kColumnID}, &itr_));
+  EXPECT_TRUE(itr_->Next());
+  EXPECT_EQ(itr_->Key(), Key({Int64(4)}));
+  EXPECT_FALSE(itr_->Next());
+}
+
+TEST_F(InMemoryStorageTest, MultiLookupOfUnsortedKeysReturnsInternalError) {
+  ZETASQL_EXPECT_OK(storage_.Write(absl::Now(), kTableId0, Key({Int64(1)}),
+                           {kColumnID}, {Int64(1)}));
+  EXPECT_THAT(storage_.MultiLookup(absl::Now(), kTableId0,
+                                   {Key({Int64(2)}), Key({Int64(1)})},
+                                   {kColumnID}, &itr_),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST_F(InMemoryStorageTest, SplitKeyRangeIntoRangesOfEqualRows) {
+  absl::Time write_ts = absl::Now();
+  for (int i = 0; i < 100; ++i) {
+    ZETASQL_EXPECT_OK(storage_.Write(write_ts, kTableId0, Key({Int64(i)}),
+                             {kColumnID}, {Int64(i)}));
+  }
+
+  std::vector<Key> split_keys;
+  ZETASQL_EXPECT_OK(storage_.SplitKeyRange(kTableId0, KeyRange::All(),
+                                   /*max_ranges=*/4,
+                                   /*min_rows_per_range=*/10, &split_keys));
+  EXPECT_THAT(split_keys, testing::ElementsAre(Key({Int64(25)}),
+                                               Key({Int64(50)}),
+                                               Key({Int64(75)})));
+
+  // Ranges are not made smaller than the minimum number of rows.
+  ZETASQL_EXPECT_OK(storage_.SplitKeyRange(
+      kTableId0,
+      KeyRange::ClosedOpen(Key({Int64(10)}), Key({Int64(40)})),
+      /*max_ranges=*/4, /*min_rows_per_range=*/10, &split_keys));
+  EXPECT_THAT(split_keys,
+              testing::ElementsAre(Key({Int64(20)}), Key({Int64(30)})));
+  ZETASQL_EXPECT_OK(storage_.SplitKeyRange(kTableId0, KeyRange::All(),
+                                   /*max_ranges=*/4,
+                                   /*min_rows_per_range=*/1000, &split_keys));
+  EXPECT_THAT(split_keys, testing::IsEmpty());
+}
+
+TEST_F(InMemoryStorageTest, SplitKeyRangeOfLargeTableAtSampledKeys) {
+  absl::Time write_ts = absl::Now();
+  constexpr int kNumRows = 8000;
+  for (int i = 0; i < kNumRows; ++i) {
+    ZETASQL_EXPECT_OK(storage_.Write(write_ts, kTableId0, Key({Int64(i)}),
+                             {kColumnID}, {Int64(i)}));
+  }
+
+  // The split keys are sampled, so the ranges only hold about the same number
+  // of rows.
+  std::vector<Key> split_keys;
+  ZETASQL_EXPECT_OK(storage_.SplitKeyRange(kTableId0, KeyRange::All(),
+                                   /*max_ranges=*/4,
+                                   /*min_rows_per_range=*/10, &split_keys));
+  ASSERT_EQ(split_keys.size(), 3);
+  int64_t range_start = 0;
+  for (int i = 0; i <= split_keys.size(); ++i) {
+    const int64_t range_limit = i < split_keys.size()
+                                    ? split_keys[i].ColumnValue(0).int64_value()
+                                    : kNumRows;
+    EXPECT_GT(range_limit - range_start, kNumRows / 8);
+    EXPECT_LT(range_limit - range_start, 3 * kNumRows / 8);
+    range_start = range_limit;
+  }
+
+  ZETASQL_EXPECT_OK(storage_.SplitKeyRange(kTableId0, KeyRange::All(),
+                                   /*max_ranges=*/4,
+                                   /*min_rows_per_range=*/kNumRows,
+                                   &split_keys));
+  EXPECT_THAT(split_keys, testing::IsEmpty());
+}
+
+TEST_F(InMemoryStorageTest, TableStatisticsFollowRowsOfTable) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  absl::Time t2 = t1 + absl::Seconds(1);
+
+  absl::optional<TableStatistics> statistics =
+      storage_.GetTableStatistics(kTableId0);
+  ASSERT_TRUE(statistics.has_value());
+  EXPECT_EQ(statistics->num_rows, 0);
+  EXPECT_THAT(statistics->sample_keys, testing::IsEmpty());
+
+  // The sample of a small table holds all its keys.
+  for (int i = 0; i < 10; ++i) {
+    ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(9 - i)}),
+                             {kColumnID}, {Int64(i)}));
+  }
+  statistics = storage_.GetTableStatistics(kTableId0);
+  EXPECT_EQ(statistics->num_rows, 10);
+  EXPECT_EQ(statistics->bytes, storage_.TotalBytes());
+  ASSERT_EQ(statistics->sample_keys.size(), 10);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(statistics->sample_keys[i], Key({Int64(i)}));
+  }
+
+  // The sample of a large table holds some of its keys, in order.
+  for (int i = 10; i < 5000; ++i) {
+    ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(i)}),
+                             {kColumnID}, {Int64(i)}));
+  }
+  statistics = storage_.GetTableStatistics(kTableId0);
+  EXPECT_EQ(statistics->num_rows, 5000);
+  EXPECT_GT(statistics->sample_keys.size(), 0);
+  EXPECT_LT(statistics->sample_keys.size(), 5000);
+  for (int i = 1; i < statistics->sample_keys.size(); ++i) {
+    EXPECT_LT(statistics->sample_keys[i - 1], statistics->sample_keys[i]);
+  }
+
+  // Rows erased by garbage collection are no longer counted nor sampled.
+  ZETASQL_EXPECT_OK(storage_.Delete(
+      t1, kTableId0, KeyRange::ClosedOpen(Key({Int64(5)}), Key::Infinity())));
+  storage_.CollectGarbage(t2);
+  statistics = storage_.GetTableStatistics(kTableId0);
+  EXPECT_EQ(statistics->num_rows, 5);
+  EXPECT_THAT(statistics->sample_keys,
+              testing::ElementsAre(Key({Int64(0)}), Key({Int64(1)}),
+                                   Key({Int64(2)}), Key({Int64(3)}),
+                                   Key({Int64(4)})));
+}
+
 TEST_F(InMemoryStorageTest, ReadUsingPrefixKeyRange) {
   absl::Time write_ts = absl::Now();
   absl::Time read_ts = write_ts + absl::Seconds(1);
@@ -699,6 +1085,1055 @@ TEST_F(InMemoryStorageTest,
       zetasql_base::testing::StatusIs(absl::StatusCode::kInternal));
 }
 
+TEST_F(InMemoryStorageTest, LookupOlderVersionsOfRow) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  absl::Time t2 = t1 + absl::Seconds(1);
+  const ColumnID kColumnID1 = "test_column:1";
+  Key key({Int64(1)});
+
+  ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, key, {kColumnID, kColumnID1},
+                           {String("value-0"), String("other-0")}));
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t1, kTableId0, key, {kColumnID}, {String("value-1")}));
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t2, kTableId0, key, {kColumnID1}, {String("other-2")}));
+
+  std::vector<zetasql::Value> values;
+  ZETASQL_EXPECT_OK(
+      storage_.Lookup(t0, kTableId0, key, {kColumnID, kColumnID1}, &values));
+  EXPECT_THAT(values,
+              testing::ElementsAre(String("value-0"), String("other-0")));
+  ZETASQL_EXPECT_OK(
+      storage_.Lookup(t1, kTableId0, key, {kColumnID, kColumnID1}, &values));
+  EXPECT_THAT(values,
+              testing::ElementsAre(String("value-1"), String("other-0")));
+  ZETASQL_EXPECT_OK(
+      storage_.Lookup(t2, kTableId0, key, {kColumnID1, kColumnID}, &values));
+  EXPECT_THAT(values,
+              testing::ElementsAre(String("other-2"), String("value-1")));
+}
+
+TEST_F(InMemoryStorageTest, WriteAfterDeleteAtSameTimestampClearsColumns) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  const ColumnID kColumnID1 = "test_column:1";
+  Key key({Int64(1)});
+
+  ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, key, {kColumnID, kColumnID1},
+                           {String("value-0"), String("other-0")}));
+  ZETASQL_EXPECT_OK(storage_.Delete(t1, kTableId0, KeyRange::Point(key)));
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t1, kTableId0, key, {kColumnID}, {String("value-1")}));
+
+  std::vector<zetasql::Value> values;
+  ZETASQL_EXPECT_OK(
+      storage_.Lookup(t1, kTableId0, key, {kColumnID, kColumnID1}, &values));
+  EXPECT_EQ(values[0], String("value-1"));
+  EXPECT_FALSE(values[1].is_valid());
+}
+
+TEST_F(InMemoryStorageTest, WriteOlderThanLatestVersionReturnsInternalError) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  Key key({Int64(1)});
+
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t0, kTableId0, key, {kColumnID}, {String("value-0")}));
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t1, kTableId0, key, {kColumnID}, {String("value-1")}));
+  EXPECT_THAT(
+      storage_.Write(t0, kTableId0, key, {kColumnID}, {String("value-0")}),
+      zetasql_base::testing::StatusIs(absl::StatusCode::kInternal));
+  EXPECT_THAT(storage_.Delete(t0, kTableId0, KeyRange::Point(key)),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST_F(InMemoryStorageTest, CollectGarbageRetainsVersionsVisibleAtHorizon) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  absl::Time t2 = t1 + absl::Seconds(1);
+  Key key({Int64(1)});
+
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t0, kTableId0, key, {kColumnID}, {String("value-0")}));
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t1, kTableId0, key, {kColumnID}, {String("value-1")}));
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t2, kTableId0, key, {kColumnID}, {String("value-2")}));
+
+  storage_.CollectGarbage(t1 + absl::Milliseconds(500));
+
+  // Versions visible at or after the horizon are still readable.
+  std::vector<zetasql::Value> values;
+  ZETASQL_EXPECT_OK(storage_.Lookup(t1 + absl::Milliseconds(500), kTableId0, key,
+                            {kColumnID}, &values));
+  EXPECT_THAT(values, testing::ElementsAre(String("value-1")));
+  ZETASQL_EXPECT_OK(storage_.Lookup(t2, kTableId0, key, {kColumnID}, &values));
+  EXPECT_THAT(values, testing::ElementsAre(String("value-2")));
+
+  // Versions superseded before the horizon are gone.
+  EXPECT_THAT(storage_.Lookup(t0, kTableId0, key, {kColumnID}, &values),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST_F(InMemoryStorageTest, CollectGarbageRemovesDeletedRows) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  absl::Time t2 = t1 + absl::Seconds(1);
+  constexpr int kNumKeys = 300;
+  constexpr int kNumLiveKeys = 150;
+
+  for (int i = 0; i < kNumKeys; ++i) {
+    ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(i)}), {kColumnID},
+                             {Int64(i)}));
+  }
+  ZETASQL_EXPECT_OK(storage_.Delete(t1, kTableId0,
+                            KeyRange::ClosedOpen(Key({Int64(kNumLiveKeys)}),
+                                                 Key({Int64(kNumKeys)}))));
+
+  // An iterator opened before garbage collection continues past erased rows.
+  ZETASQL_EXPECT_OK(
+      storage_.Read(t2, kTableId0, KeyRange::All(), {kColumnID}, &itr_));
+  ASSERT_TRUE(itr_->Next());
+  EXPECT_EQ(itr_->Key(), Key({Int64(0)}));
+
+  storage_.CollectGarbage(t2);
+
+  for (int i = 1; i < kNumLiveKeys; ++i) {
+    ASSERT_TRUE(itr_->Next());
+    EXPECT_EQ(itr_->Key(), Key({Int64(i)}));
+  }
+  EXPECT_FALSE(itr_->Next());
+
+  // Deleted rows can be written again after being collected.
+  ZETASQL_EXPECT_OK(storage_.Write(t2, kTableId0, Key({Int64(kNumLiveKeys)}),
+                           {kColumnID}, {Int64(0)}));
+  std::vector<zetasql::Value> values;
+  ZETASQL_EXPECT_OK(storage_.Lookup(t2, kTableId0, Key({Int64(kNumLiveKeys)}),
+                            {kColumnID}, &values));
+  EXPECT_THAT(values, testing::ElementsAre(Int64(0)));
+  EXPECT_THAT(storage_.Lookup(t2, kTableId0, Key({Int64(kNumLiveKeys + 1)}),
+                              {kColumnID}, &values),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST_F(InMemoryStorageTest, DeleteOfLargeRangeHidesRowsUntilWrittenAgain) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  absl::Time t2 = t1 + absl::Seconds(1);
+  const ColumnID kColumnID1 = "test_column:1";
+  constexpr int kNumKeys = 1000;
+  constexpr int kNumLiveKeys = 10;
+
+  for (int i = 0; i < kNumKeys; ++i) {
+    ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(i)}),
+                             {kColumnID, kColumnID1}, {Int64(i), Int64(i)}));
+  }
+  ZETASQL_EXPECT_OK(storage_.Delete(t1, kTableId0,
+                            KeyRange::ClosedOpen(Key({Int64(kNumLiveKeys)}),
+                                                 Key({Int64(kNumKeys)}))));
+
+  // Reads at or after the delete do not see the rows in the range, while reads
+  // before it still do.
+  ZETASQL_EXPECT_OK(
+      storage_.Read(t1, kTableId0, KeyRange::All(), {kColumnID}, &itr_));
+  for (int i = 0; i < kNumLiveKeys; ++i) {
+    ASSERT_TRUE(itr_->Next());
+    EXPECT_EQ(itr_->Key(), Key({Int64(i)}));
+  }
+  EXPECT_FALSE(itr_->Next());
+  std::vector<zetasql::Value> values;
+  EXPECT_THAT(storage_.Lookup(t1, kTableId0, Key({Int64(500)}), {kColumnID},
+                              &values),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+  ZETASQL_EXPECT_OK(
+      storage_.Lookup(t0, kTableId0, Key({Int64(500)}), {kColumnID}, &values));
+  EXPECT_THAT(values, testing::ElementsAre(Int64(500)));
+  ZETASQL_EXPECT_OK(storage_.MultiLookup(t1, kTableId0,
+                                 {Key({Int64(5)}), Key({Int64(500)})},
+                                 {kColumnID}, &itr_));
+  ASSERT_TRUE(itr_->Next());
+  EXPECT_EQ(itr_->Key(), Key({Int64(5)}));
+  EXPECT_FALSE(itr_->Next());
+
+  // A row written again does not carry over the values of the deleted row.
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t2, kTableId0, Key({Int64(500)}), {kColumnID}, {Int64(-1)}));
+  ZETASQL_EXPECT_OK(storage_.Lookup(t2, kTableId0, Key({Int64(500)}),
+                            {kColumnID, kColumnID1}, &values));
+  EXPECT_THAT(values, testing::ElementsAre(Int64(-1), zetasql::Value()));
+  EXPECT_THAT(storage_.Lookup(t1, kTableId0, Key({Int64(500)}), {kColumnID},
+                              &values),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+
+  // Garbage collection erases the deleted rows.
+  const int64_t bytes = storage_.TotalBytes();
+  storage_.CollectGarbage(t2);
+  EXPECT_LT(storage_.TotalBytes(), bytes);
+  ZETASQL_EXPECT_OK(
+      storage_.Read(t2, kTableId0, KeyRange::All(), {kColumnID}, &itr_));
+  int num_rows = 0;
+  while (itr_->Next()) {
+    ++num_rows;
+  }
+  EXPECT_EQ(num_rows, kNumLiveKeys + 1);
+  ZETASQL_EXPECT_OK(
+      storage_.Lookup(t2, kTableId0, Key({Int64(500)}), {kColumnID}, &values));
+  EXPECT_THAT(values, testing::ElementsAre(Int64(-1)));
+}
+
+TEST_F(InMemoryStorageTest, CollectGarbageCompactsTablesAfterBulkDeletes) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  absl::Time t2 = t1 + absl::Seconds(1);
+  constexpr int kNumKeys = 4000;
+
+  // Every row but one in four is deleted, row by row.
+  for (int i = 0; i < kNumKeys; ++i) {
+    ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(i)}), {kColumnID},
+                             {Int64(i)}));
+  }
+  for (int i = 0; i < kNumKeys; ++i) {
+    if (i % 4 != 0) {
+      ZETASQL_EXPECT_OK(
+          storage_.Delete(t1, kTableId0, KeyRange::Point(Key({Int64(i)}))));
+    }
+  }
+
+  // The deleted rows are still visible to reads before the delete, so the
+  // table is not compacted yet.
+  storage_.CollectGarbage(t1 - absl::Milliseconds(500));
+  EXPECT_EQ(storage_.compaction_stats().compactions, 0);
+
+  // An iterator opened before the table is compacted continues with the rows
+  // of the compacted table.
+  ZETASQL_EXPECT_OK(
+      storage_.Read(t2, kTableId0, KeyRange::All(), {kColumnID}, &itr_));
+  ASSERT_TRUE(itr_->Next());
+  EXPECT_EQ(itr_->Key(), Key({Int64(0)}));
+
+  storage_.CollectGarbage(t2);
+  EXPECT_EQ(storage_.compaction_stats().compactions, 1);
+  EXPECT_EQ(storage_.compaction_stats().rows_compacted, kNumKeys / 4);
+
+  for (int i = 4; i < kNumKeys; i += 4) {
+    ASSERT_TRUE(itr_->Next());
+    EXPECT_EQ(itr_->Key(), Key({Int64(i)}));
+    EXPECT_EQ(itr_->ColumnValue(0), Int64(i));
+  }
+  EXPECT_FALSE(itr_->Next());
+  ZETASQL_EXPECT_OK(itr_->Status());
+
+  // Collecting garbage again does not compact the table again.
+  storage_.CollectGarbage(t2);
+  EXPECT_EQ(storage_.compaction_stats().compactions, 1);
+}
+
+TEST_F(InMemoryStorageTest, DropTableKeepsRowsForOlderReadsUntilCollected) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  absl::Time t2 = t1 + absl::Seconds(1);
+
+  ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(1)}), {kColumnID},
+                           {Int64(1)}));
+  ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId1, Key({Int64(1)}), {kColumnID},
+                           {Int64(1)}));
+  const int64_t row_bytes = storage_.TableBytes()[kTableId1];
+  ZETASQL_EXPECT_OK(storage_.DropTable(t1, kTableId0));
+
+  // Reads before the drop still see the rows, reads after it see none. An
+  // iterator opened before the drop outlives the collection of the table.
+  std::vector<zetasql::Value> values;
+  ZETASQL_EXPECT_OK(
+      storage_.Lookup(t0, kTableId0, Key({Int64(1)}), {kColumnID}, &values));
+  EXPECT_THAT(values, testing::ElementsAre(Int64(1)));
+  EXPECT_THAT(
+      storage_.Lookup(t1, kTableId0, Key({Int64(1)}), {kColumnID}, &values),
+      zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+  ZETASQL_EXPECT_OK(
+      storage_.Read(t0, kTableId0, KeyRange::All(), {kColumnID}, &itr_));
+  EXPECT_FALSE(storage_.TableBytes().contains(kTableId0));
+  EXPECT_EQ(storage_.TotalBytes(), 2 * row_bytes);
+
+  // Writes after the drop start from an empty table.
+  ZETASQL_EXPECT_OK(storage_.Write(t2, kTableId0, Key({Int64(2)}), {kColumnID},
+                           {Int64(2)}));
+  ZETASQL_EXPECT_OK(
+      storage_.Read(t2, kTableId0, KeyRange::All(), {kColumnID}, &itr_));
+  ASSERT_TRUE(itr_->Next());
+  EXPECT_EQ(itr_->Key(), Key({Int64(2)}));
+  EXPECT_FALSE(itr_->Next());
+
+  // Garbage collection past the drop frees the dropped rows.
+  ZETASQL_EXPECT_OK(
+      storage_.Read(t0, kTableId0, KeyRange::All(), {kColumnID}, &itr_));
+  storage_.CollectGarbage(t1);
+  EXPECT_EQ(storage_.TotalBytes(), storage_.TableBytes()[kTableId0] +
+                                       storage_.TableBytes()[kTableId1]);
+  ASSERT_TRUE(itr_->Next());
+  EXPECT_EQ(itr_->Key(), Key({Int64(1)}));
+  EXPECT_FALSE(itr_->Next());
+}
+
+TEST_F(InMemoryStorageTest, ReadSpanningMultipleBatches) {
+  absl::Time t0 = absl::Now();
+  constexpr int kNumKeys = 1000;
+
+  for (int i = 0; i < kNumKeys; ++i) {
+    ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(i)}), {kColumnID},
+                             {Int64(i)}));
+  }
+  // Delete every other key so that batches skip rows which do not exist.
+  for (int i = 0; i < kNumKeys; i += 2) {
+    ZETASQL_EXPECT_OK(
+        storage_.Delete(t0, kTableId0, KeyRange::Point(Key({Int64(i)}))));
+  }
+
+  ZETASQL_EXPECT_OK(storage_.Read(t0, kTableId0,
+                          KeyRange::ClosedOpen(Key({Int64(1)}),
+                                               Key({Int64(kNumKeys - 1)})),
+                          {kColumnID}, &itr_));
+  for (int i = 1; i < kNumKeys - 1; i += 2) {
+    ASSERT_TRUE(itr_->Next());
+    EXPECT_EQ(itr_->Key(), Key({Int64(i)}));
+    EXPECT_EQ(itr_->ColumnValue(0), Int64(i));
+  }
+  EXPECT_FALSE(itr_->Next());
+  ZETASQL_EXPECT_OK(itr_->Status());
+}
+
+TEST_F(InMemoryStorageTest, ReadIsNotAffectedByLaterWrites) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  constexpr int kNumKeys = 500;
+
+  for (int i = 0; i < kNumKeys; i += 2) {
+    ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(i)}), {kColumnID},
+                             {Int64(i)}));
+  }
+
+  ZETASQL_EXPECT_OK(
+      storage_.Read(t0, kTableId0, KeyRange::All(), {kColumnID}, &itr_));
+  ASSERT_TRUE(itr_->Next());
+  EXPECT_EQ(itr_->Key(), Key({Int64(0)}));
+
+  // Insert new keys and overwrite existing ones after the read has started.
+  for (int i = 0; i < kNumKeys; ++i) {
+    ZETASQL_EXPECT_OK(storage_.Write(t1, kTableId0, Key({Int64(i)}), {kColumnID},
+                             {Int64(-i)}));
+  }
+
+  for (int i = 2; i < kNumKeys; i += 2) {
+    ASSERT_TRUE(itr_->Next());
+    EXPECT_EQ(itr_->Key(), Key({Int64(i)}));
+    EXPECT_EQ(itr_->ColumnValue(0), Int64(i));
+  }
+  EXPECT_FALSE(itr_->Next());
+}
+
+TEST_F(InMemoryStorageTest, ResetToCheckpointRestoresRowsAtCheckpoint) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  absl::Time t2 = t1 + absl::Seconds(1);
+  absl::Time t3 = t2 + absl::Seconds(1);
+
+  for (int i = 0; i < 3; ++i) {
+    ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(i)}), {kColumnID},
+                             {Int64(i)}));
+  }
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t1, kTableId0, Key({Int64(1)}), {kColumnID}, {Int64(-1)}));
+  ZETASQL_EXPECT_OK(
+      storage_.Delete(t1, kTableId0, KeyRange::Point(Key({Int64(2)}))));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<StorageCheckpoint> checkpoint,
+                       storage_.Checkpoint(t1));
+
+  // Writes after the checkpoint, including to new tables, are discarded.
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t2, kTableId0, Key({Int64(0)}), {kColumnID}, {Int64(10)}));
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t2, kTableId0, Key({Int64(3)}), {kColumnID}, {Int64(3)}));
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t2, kTableId1, Key({Int64(0)}), {kColumnID}, {Int64(0)}));
+  ZETASQL_EXPECT_OK(storage_.ResetToCheckpoint(*checkpoint));
+
+  ZETASQL_EXPECT_OK(
+      storage_.Read(t3, kTableId0, KeyRange::All(), {kColumnID}, &itr_));
+  std::vector<std::pair<Key, zetasql::Value>> rows;
+  while (itr_->Next()) {
+    rows.emplace_back(itr_->Key(), itr_->ColumnValue(0));
+  }
+  EXPECT_THAT(rows, testing::ElementsAre(
+                        std::make_pair(Key({Int64(0)}), Int64(0)),
+                        std::make_pair(Key({Int64(1)}), Int64(-1))));
+  std::vector<zetasql::Value> values;
+  EXPECT_THAT(
+      storage_.Lookup(t3, kTableId1, Key({Int64(0)}), {kColumnID}, &values),
+      zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+
+  // The storage can be written to again, and reset to the same checkpoint.
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t3, kTableId0, Key({Int64(2)}), {kColumnID}, {Int64(2)}));
+  ZETASQL_EXPECT_OK(storage_.ResetToCheckpoint(*checkpoint));
+  EXPECT_THAT(
+      storage_.Lookup(t3, kTableId0, Key({Int64(2)}), {kColumnID}, &values),
+      zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+
+  InMemoryStorage other_storage;
+  EXPECT_THAT(other_storage.ResetToCheckpoint(*checkpoint),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST_F(InMemoryStorageTest, TableVersionChangesWithRowsOfTable) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  absl::Time t2 = t1 + absl::Seconds(1);
+
+  // Tables which were never written to have the same version.
+  ASSERT_TRUE(storage_.GetTableVersion(kTableId0).has_value());
+  EXPECT_EQ(*storage_.GetTableVersion(kTableId0),
+            *storage_.GetTableVersion(kTableId1));
+
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t0, kTableId0, Key({Int64(0)}), {kColumnID}, {Int64(0)}));
+  TableVersion version = *storage_.GetTableVersion(kTableId0);
+  EXPECT_EQ(version.max_change_timestamp, t0);
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<StorageCheckpoint> checkpoint,
+                       storage_.Checkpoint(t0));
+
+  // Reads and writes to other tables leave the version as is.
+  ZETASQL_EXPECT_OK(
+      storage_.Read(t1, kTableId0, KeyRange::All(), {kColumnID}, &itr_));
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t1, kTableId1, Key({Int64(0)}), {kColumnID}, {Int64(0)}));
+  EXPECT_EQ(*storage_.GetTableVersion(kTableId0), version);
+
+  // Writes and deletes change it, even at the same timestamp.
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t0, kTableId0, Key({Int64(0)}), {kColumnID}, {Int64(1)}));
+  EXPECT_NE(*storage_.GetTableVersion(kTableId0), version);
+  version = *storage_.GetTableVersion(kTableId0);
+  ZETASQL_EXPECT_OK(storage_.Delete(t2, kTableId0, KeyRange::All()));
+  EXPECT_NE(*storage_.GetTableVersion(kTableId0), version);
+  EXPECT_EQ(storage_.GetTableVersion(kTableId0)->max_change_timestamp, t2);
+
+  // Resetting to a checkpoint changes it to one at the checkpoint's rows.
+  version = *storage_.GetTableVersion(kTableId0);
+  ZETASQL_EXPECT_OK(storage_.ResetToCheckpoint(*checkpoint));
+  EXPECT_NE(*storage_.GetTableVersion(kTableId0), version);
+  EXPECT_EQ(storage_.GetTableVersion(kTableId0)->max_change_timestamp, t0);
+}
+
+TEST_F(InMemoryStorageTest, TableVersionChangesWhenTableIsDropped) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t0, kTableId0, Key({Int64(0)}), {kColumnID}, {Int64(0)}));
+  TableVersion version = *storage_.GetTableVersion(kTableId0);
+  ZETASQL_EXPECT_OK(storage_.DropTable(t1, kTableId0));
+  TableVersion dropped_version = *storage_.GetTableVersion(kTableId0);
+  EXPECT_NE(dropped_version, version);
+  EXPECT_EQ(dropped_version.max_change_timestamp, t1);
+
+  // The version is kept once the dropped rows are freed, and a table
+  // recreated under the same id starts from it.
+  storage_.CollectGarbage(t1);
+  EXPECT_EQ(*storage_.GetTableVersion(kTableId0), dropped_version);
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t1, kTableId0, Key({Int64(0)}), {kColumnID}, {Int64(1)}));
+  EXPECT_GT(storage_.GetTableVersion(kTableId0)->change,
+            dropped_version.change);
+  EXPECT_EQ(storage_.GetTableVersion(kTableId0)->max_change_timestamp, t1);
+}
+
+TEST_F(InMemoryStorageTest, ChangedSinceOnlyCountsChangesToRowsInRange) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  absl::Time t2 = t0 + absl::Seconds(2);
+  const KeyRange key_range_5_to_10 =
+      KeyRange::ClosedOpen(Key({Int64(5)}), Key({Int64(10)}));
+
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t0, kTableId0, Key({Int64(1)}), {kColumnID}, {Int64(1)}));
+  EXPECT_THAT(storage_.ChangedSince(t0, kTableId0, kKeyRange0To5),
+              zetasql_base::testing::IsOkAndHolds(false));
+  EXPECT_THAT(storage_.ChangedSince(t0, kTableId1, kKeyRange0To5),
+              zetasql_base::testing::IsOkAndHolds(false));
+
+  // A write at a later timestamp changes its row, and not rows out of range.
+  ZETASQL_EXPECT_OK(
+      storage_.Write(t1, kTableId0, Key({Int64(2)}), {kColumnID}, {Int64(2)}));
+  EXPECT_THAT(storage_.ChangedSince(t0, kTableId0, kKeyRange0To5),
+              zetasql_base::testing::IsOkAndHolds(true));
+  EXPECT_THAT(storage_.ChangedSince(t1, kTableId0, kKeyRange0To5),
+              zetasql_base::testing::IsOkAndHolds(false));
+  EXPECT_THAT(storage_.ChangedSince(t0, kTableId0, key_range_5_to_10),
+              zetasql_base::testing::IsOkAndHolds(false));
+
+  // So do deletes, and drops of the table.
+  ZETASQL_EXPECT_OK(storage_.Delete(
+      t2, kTableId0, KeyRange::Point(Key({Int64(1)})).ToClosedOpen()));
+  EXPECT_THAT(storage_.ChangedSince(t1, kTableId0, kKeyRange0To5),
+              zetasql_base::testing::IsOkAndHolds(true));
+  ZETASQL_EXPECT_OK(storage_.DropTable(t2, kTableId0));
+  EXPECT_THAT(storage_.ChangedSince(t1, kTableId0, key_range_5_to_10),
+              zetasql_base::testing::IsOkAndHolds(true));
+  EXPECT_THAT(storage_.ChangedSince(t2, kTableId0, key_range_5_to_10),
+              zetasql_base::testing::IsOkAndHolds(false));
+}
+
+TEST_F(InMemoryStorageTest, ChangedSinceCountsRangeDeletes) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  constexpr int kNumKeys = 1000;
+  for (int i = 0; i < kNumKeys; ++i) {
+    ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(i)}), {kColumnID},
+                             {Int64(i)}));
+  }
+
+  // Deleting this many rows leaves a range tombstone rather than marking each
+  // row deleted.
+  ZETASQL_EXPECT_OK(storage_.Delete(
+      t1, kTableId0, KeyRange::ClosedOpen(Key({Int64(0)}), Key({Int64(500)}))));
+  EXPECT_THAT(storage_.ChangedSince(t0, kTableId0, kKeyRange0To5),
+              zetasql_base::testing::IsOkAndHolds(true));
+  EXPECT_THAT(
+      storage_.ChangedSince(
+          t0, kTableId0,
+          KeyRange::ClosedOpen(Key({Int64(500)}), Key({Int64(kNumKeys)}))),
+      zetasql_base::testing::IsOkAndHolds(false));
+}
+
+TEST_F(InMemoryStorageTest, ConcurrentReadsAndWritesToDifferentTables) {
+  absl::Time t0 = absl::Now();
+  constexpr int kNumKeys = 100;
+
+  // Writers populate one table each while readers scan both tables.
+  std::vector<std::thread> threads;
+  for (const TableID& table_id : {kTableId0, kTableId1}) {
+    threads.emplace_back([&, table_id]() {
+      for (int i = 0; i < kNumKeys; ++i) {
+        ZETASQL_EXPECT_OK(storage_.Write(t0, table_id, Key({Int64(i)}), {kColumnID},
+                                 {Int64(i)}));
+      }
+    });
+    threads.emplace_back([&, table_id]() {
+      for (int i = 0; i < kNumKeys; ++i) {
+        std::unique_ptr<StorageIterator> itr;
+        ZETASQL_EXPECT_OK(
+            storage_.Read(t0, table_id, KeyRange::All(), {kColumnID}, &itr));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  for (const TableID& table_id : {kTableId0, kTableId1}) {
+    ZETASQL_EXPECT_OK(
+        storage_.Read(t0, table_id, KeyRange::All(), {kColumnID}, &itr_));
+    for (int i = 0; i < kNumKeys; ++i) {
+      ASSERT_TRUE(itr_->Next());
+      EXPECT_EQ(itr_->ColumnValue(0), Int64(i));
+    }
+    EXPECT_FALSE(itr_->Next());
+  }
+}
+
+TEST_F(InMemoryStorageTest, WriteBatchAppliesWritesInOrder) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  for (int i : {1, 3, 5}) {
+    ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(i)}), {kColumnID},
+                             {String("old")}));
+  }
+
+  // Writes are interleaved with existing rows, and the last two writes are
+  // out of key order.
+  std::vector<StorageWrite> writes;
+  for (int i : {0, 1, 2, 2, 4, 3, 1}) {
+    StorageWrite write;
+    write.key = Key({Int64(i)});
+    write.column_ids = {kColumnID};
+    write.values = {String(absl::StrCat("new-", writes.size()))};
+    writes.push_back(write);
+  }
+  // Delete key 2 after writing it, and delete a key which does not exist.
+  writes[3].is_delete = true;
+  StorageWrite delete_missing;
+  delete_missing.key = Key({Int64(7)});
+  delete_missing.is_delete = true;
+  writes.push_back(delete_missing);
+  ZETASQL_EXPECT_OK(storage_.WriteBatch(t1, kTableId0, writes));
+
+  ZETASQL_EXPECT_OK(storage_.Read(t1, kTableId0, KeyRange::All(), {kColumnID}, &itr_));
+  std::vector<std::pair<Key, zetasql::Value>> rows;
+  while (itr_->Next()) {
+    rows.emplace_back(itr_->Key(), itr_->ColumnValue(0));
+  }
+  EXPECT_THAT(rows, testing::ElementsAre(
+                        std::make_pair(Key({Int64(0)}), String("new-0")),
+                        std::make_pair(Key({Int64(1)}), String("new-6")),
+                        std::make_pair(Key({Int64(3)}), String("new-5")),
+                        std::make_pair(Key({Int64(4)}), String("new-4")),
+                        std::make_pair(Key({Int64(5)}), String("old"))));
+
+  // Older versions are unaffected.
+  std::vector<zetasql::Value> values;
+  ZETASQL_EXPECT_OK(
+      storage_.Lookup(t0, kTableId0, Key({Int64(1)}), {kColumnID}, &values));
+  EXPECT_THAT(values, testing::ElementsAre(String("old")));
+}
+
+TEST_F(InMemoryStorageTest, KeyFilterAnswersLookupsOfUnwrittenKeys) {
+  absl::Time t0 = absl::Now();
+
+  // Write enough rows that the key filter is rebuilt along the way.
+  for (int i = 0; i < 4 * KeyFilter::kMinCapacity; ++i) {
+    ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(2 * i), Int64(0)}),
+                             {kColumnID}, {Int64(i)}));
+  }
+
+  // All written keys and their prefixes are still found.
+  for (int i = 0; i < 4 * KeyFilter::kMinCapacity; ++i) {
+    ZETASQL_EXPECT_OK(storage_.Lookup(t0, kTableId0, Key({Int64(2 * i), Int64(0)}),
+                              {}, nullptr));
+    ZETASQL_EXPECT_OK(storage_.Read(t0, kTableId0,
+                            KeyRange::Point(Key({Int64(2 * i)})), {}, &itr_));
+    EXPECT_TRUE(itr_->Next());
+  }
+  EXPECT_EQ(storage_.key_filter_stats().negatives, 0);
+
+  // Most keys which were never written are answered by the filter alone.
+  for (int i = 0; i < 4 * KeyFilter::kMinCapacity; ++i) {
+    EXPECT_THAT(storage_.Lookup(t0, kTableId0,
+                                Key({Int64(2 * i + 1), Int64(0)}), {}, nullptr),
+                zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+    ZETASQL_EXPECT_OK(storage_.Read(
+        t0, kTableId0, KeyRange::Point(Key({Int64(2 * i + 1)})), {}, &itr_));
+    EXPECT_FALSE(itr_->Next());
+  }
+  InMemoryStorage::KeyFilterStats stats = storage_.key_filter_stats();
+  EXPECT_EQ(stats.probes, 16 * KeyFilter::kMinCapacity);
+  EXPECT_GT(stats.negatives, 7 * KeyFilter::kMinCapacity);
+}
+
+TEST_F(InMemoryStorageTest, AccountsForBytesOfRowsAndVersions) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  absl::Time t2 = t0 + absl::Seconds(2);
+  EXPECT_EQ(storage_.TotalBytes(), 0);
+
+  ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId0, Key({Int64(1)}), {kColumnID},
+                           {String("value-1")}));
+  const int64_t row_bytes = storage_.TotalBytes();
+  EXPECT_GT(row_bytes, 0);
+  ZETASQL_EXPECT_OK(storage_.Write(t0, kTableId1, Key({Int64(1)}), {kColumnID},
+                           {String("value-1")}));
+  EXPECT_EQ(storage_.TotalBytes(), 2 * row_bytes);
+
+  // Older versions are accounted for until they are garbage collected.
+  ZETASQL_EXPECT_OK(storage_.Write(t1, kTableId0, Key({Int64(1)}), {kColumnID},
+                           {String("value-2")}));
+  const int64_t versions_bytes = storage_.TableBytes()[kTableId0];
+  EXPECT_GT(versions_bytes, row_bytes);
+  EXPECT_EQ(storage_.TotalBytes(), versions_bytes + row_bytes);
+  storage_.CollectGarbage(t1);
+  EXPECT_EQ(storage_.TableBytes()[kTableId0], row_bytes);
+
+  // Deleted rows are accounted for until they are garbage collected.
+  ZETASQL_EXPECT_OK(storage_.Delete(t2, kTableId0, kKeyRange0To5));
+  EXPECT_GT(storage_.TableBytes()[kTableId0], 0);
+  storage_.CollectGarbage(t2);
+  EXPECT_EQ(storage_.TableBytes()[kTableId0], 0);
+  EXPECT_EQ(storage_.TotalBytes(), row_bytes);
+
+  // Resetting to a checkpoint accounts for the rows of the checkpoint.
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<StorageCheckpoint> checkpoint,
+                       storage_.Checkpoint(t2));
+  ZETASQL_EXPECT_OK(storage_.WriteBatch(
+      t2 + absl::Seconds(1), kTableId0,
+      {StorageWrite{Key({Int64(2)}), false, {kColumnID},
+                    {String("value-3")}}}));
+  EXPECT_EQ(storage_.TotalBytes(), 2 * row_bytes);
+  ZETASQL_EXPECT_OK(storage_.ResetToCheckpoint(*checkpoint));
+  EXPECT_EQ(storage_.TotalBytes(), row_bytes);
+  EXPECT_EQ(storage_.TableBytes()[kTableId1], row_bytes);
+}
+
+TEST(InMemoryStorageInterningTest, SharesRepeatedStringValues) {
+  InMemoryStorage storage(/*use_key_filters=*/true, /*intern_values=*/true);
+  absl::Time t0 = absl::Now();
+  for (int i = 0; i < 10; ++i) {
+    ZETASQL_EXPECT_OK(storage.Write(t0, "test_table:0", Key({Int64(i)}), {"c"},
+                            {String("active")}));
+  }
+  InMemoryStorage::InterningStats stats = storage.interning_stats();
+  EXPECT_EQ(stats.distinct_values, 1);
+  EXPECT_EQ(stats.shared_values, 9);
+  EXPECT_GT(stats.bytes_saved, 0);
+
+  std::vector<zetasql::Value> values;
+  ZETASQL_EXPECT_OK(
+      storage.Lookup(t0, "test_table:0", Key({Int64(7)}), {"c"}, &values));
+  EXPECT_THAT(values, testing::ElementsAre(String("active")));
+}
+
+TEST(InMemoryStorageInterningTest, ReleasesValuesNoLongerStored) {
+  InMemoryStorage storage(/*use_key_filters=*/true, /*intern_values=*/true);
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  for (int i = 0; i < 10; ++i) {
+    ZETASQL_EXPECT_OK(storage.Write(t0, "test_table:0", Key({Int64(i)}), {"c"},
+                            {String("pending")}));
+  }
+  for (int i = 0; i < 10; ++i) {
+    ZETASQL_EXPECT_OK(storage.Write(t1, "test_table:0", Key({Int64(i)}), {"c"},
+                            {String("done")}));
+  }
+  EXPECT_EQ(storage.interning_stats().distinct_values, 2);
+
+  // Once the older versions are garbage collected, only the values of the
+  // latest versions remain interned.
+  storage.CollectGarbage(t1);
+  EXPECT_EQ(storage.interning_stats().distinct_values, 1);
+
+  ZETASQL_EXPECT_OK(storage.Delete(t1 + absl::Seconds(1), "test_table:0",
+                           KeyRange::All()));
+  EXPECT_EQ(storage.interning_stats().distinct_values, 1);
+  storage.CollectGarbage(t1 + absl::Seconds(1));
+  EXPECT_EQ(storage.interning_stats().distinct_values, 0);
+  EXPECT_EQ(storage.TotalBytes(), 0);
+}
+
+TEST(InMemoryStorageInterningTest, InterningCanBeDisabled) {
+  InMemoryStorage interned(/*use_key_filters=*/true, /*intern_values=*/true);
+  InMemoryStorage plain(/*use_key_filters=*/true, /*intern_values=*/false);
+  absl::Time t0 = absl::Now();
+  const std::string value(64, 'x');
+  for (int i = 0; i < 10; ++i) {
+    ZETASQL_EXPECT_OK(interned.Write(t0, "test_table:0", Key({Int64(i)}), {"c"},
+                             {String(value)}));
+    ZETASQL_EXPECT_OK(plain.Write(t0, "test_table:0", Key({Int64(i)}), {"c"},
+                          {String(value)}));
+  }
+  EXPECT_EQ(plain.interning_stats().distinct_values, 0);
+  EXPECT_EQ(plain.interning_stats().shared_values, 0);
+  EXPECT_LT(interned.TotalBytes(), plain.TotalBytes());
+}
+
+TEST(InMemoryStorageCompressionTest, CompressesLargeValuesOfOlderVersions) {
+  InMemoryStorage storage(/*use_key_filters=*/true, /*intern_values=*/true,
+                          /*compression_threshold_bytes=*/1024);
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  absl::Time t2 = t0 + absl::Seconds(2);
+  const std::string document_0 =
+      absl::StrCat("{\"payload\": \"", std::string(4096, 'a'), "\"}");
+  const std::string document_1 =
+      absl::StrCat("{\"payload\": \"", std::string(4096, 'b'), "\"}");
+  ZETASQL_EXPECT_OK(storage.Write(t0, "test_table:0", Key({Int64(1)}),
+                          {"c", "d"}, {String(document_0), String("small")}));
+  const int64_t row_bytes = storage.TotalBytes();
+  ZETASQL_EXPECT_OK(storage.Write(t1, "test_table:0", Key({Int64(1)}), {"c"},
+                          {String(document_1)}));
+  EXPECT_EQ(storage.compression_stats().compressed_values, 1);
+  EXPECT_GT(storage.compression_stats().bytes_saved, 4000);
+  EXPECT_LT(storage.TotalBytes(), row_bytes + 1024);
+
+  // Reads at past and latest timestamps see the values as written.
+  std::vector<zetasql::Value> values;
+  ZETASQL_EXPECT_OK(storage.Lookup(t0, "test_table:0", Key({Int64(1)}),
+                           {"c", "d"}, &values));
+  EXPECT_THAT(values,
+              testing::ElementsAre(String(document_0), String("small")));
+  ZETASQL_EXPECT_OK(storage.Lookup(t1, "test_table:0", Key({Int64(1)}),
+                           {"c", "d"}, &values));
+  EXPECT_THAT(values,
+              testing::ElementsAre(String(document_1), String("small")));
+
+  // Resetting to a checkpoint of a past timestamp makes a compressed version
+  // the latest one, which can be written again.
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<StorageCheckpoint> checkpoint,
+                       storage.Checkpoint(t0));
+  ZETASQL_EXPECT_OK(storage.ResetToCheckpoint(*checkpoint));
+  ZETASQL_EXPECT_OK(storage.Write(t2, "test_table:0", Key({Int64(1)}), {"c"},
+                          {String("rewritten")}));
+  ZETASQL_EXPECT_OK(storage.Lookup(t2, "test_table:0", Key({Int64(1)}),
+                           {"c", "d"}, &values));
+  EXPECT_THAT(values,
+              testing::ElementsAre(String("rewritten"), String("small")));
+}
+
+TEST(InMemoryStorageCompressionTest, KeepsIncompressibleValuesAsIs) {
+  InMemoryStorage storage(/*use_key_filters=*/true, /*intern_values=*/true,
+                          /*compression_threshold_bytes=*/16);
+  absl::Time t0 = absl::Now();
+  std::string random_bytes;
+  uint32_t state = 1;
+  for (int i = 0; i < 4096; ++i) {
+    state = state * 1664525 + 1013904223;
+    random_bytes.push_back(static_cast<char>(state >> 24));
+  }
+  ZETASQL_EXPECT_OK(storage.Write(t0, "test_table:0", Key({Int64(1)}), {"c"},
+                          {Bytes(random_bytes)}));
+  ZETASQL_EXPECT_OK(storage.Write(t0 + absl::Seconds(1), "test_table:0",
+                          Key({Int64(1)}), {"c"}, {Bytes("")}));
+  EXPECT_EQ(storage.compression_stats().compressed_values, 0);
+
+  std::vector<zetasql::Value> values;
+  ZETASQL_EXPECT_OK(
+      storage.Lookup(t0, "test_table:0", Key({Int64(1)}), {"c"}, &values));
+  EXPECT_THAT(values, testing::ElementsAre(Bytes(random_bytes)));
+}
+
+TEST(InMemoryStorageWithoutKeyFiltersTest, LookupsDoNotProbeKeyFilters) {
+  InMemoryStorage storage(/*use_key_filters=*/false);
+  absl::Time t0 = absl::Now();
+  ZETASQL_EXPECT_OK(storage.Write(t0, "test_table:0", Key({Int64(1)}), {}, {}));
+  ZETASQL_EXPECT_OK(storage.Lookup(t0, "test_table:0", Key({Int64(1)}), {}, nullptr));
+  EXPECT_THAT(storage.Lookup(t0, "test_table:0", Key({Int64(2)}), {}, nullptr),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+  EXPECT_EQ(storage.key_filter_stats().probes, 0);
+}
+
+class InMemoryStorageColocationTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ZETASQL_ASSERT_OK(storage_.InterleaveTable(kChildId, kParentId,
+                                       /*num_key_columns=*/2,
+                                       /*num_parent_key_columns=*/1));
+    ZETASQL_ASSERT_OK(storage_.InterleaveTable(kGrandchildId, kChildId,
+                                       /*num_key_columns=*/3,
+                                       /*num_parent_key_columns=*/2));
+    ZETASQL_ASSERT_OK(storage_.Write(t0_, kParentId, Key({Int64(1)}),
+                             {kColumnID}, {String("parent-1")}));
+    ZETASQL_ASSERT_OK(storage_.Write(t0_, kParentId, Key({Int64(2)}),
+                             {kColumnID}, {String("parent-2")}));
+    ZETASQL_ASSERT_OK(storage_.Write(t0_, kChildId, Key({Int64(1), Int64(10)}),
+                             {kColumnID}, {String("child-1-10")}));
+    ZETASQL_ASSERT_OK(storage_.Write(t0_, kChildId, Key({Int64(1), Int64(20)}),
+                             {kColumnID}, {String("child-1-20")}));
+    ZETASQL_ASSERT_OK(storage_.Write(t0_, kChildId, Key({Int64(2), Int64(10)}),
+                             {kColumnID}, {String("child-2-10")}));
+    ZETASQL_ASSERT_OK(storage_.Write(t0_, kGrandchildId,
+                             Key({Int64(1), Int64(10), Int64(100)}),
+                             {kColumnID}, {String("grandchild-1-10-100")}));
+  }
+
+  // Returns the values of the column read from `table_id` over `key_range`.
+  std::vector<zetasql::Value> ReadValues(absl::Time timestamp,
+                                         const TableID& table_id,
+                                         const KeyRange& key_range) {
+    std::vector<zetasql::Value> values;
+    std::unique_ptr<StorageIterator> itr;
+    ZETASQL_EXPECT_OK(
+        storage_.Read(timestamp, table_id, key_range, {kColumnID}, &itr));
+    while (itr->Next()) {
+      values.push_back(itr->ColumnValue(0));
+    }
+    ZETASQL_EXPECT_OK(itr->Status());
+    return values;
+  }
+
+  const TableID kParentId = "parent_table:0";
+  const TableID kChildId = "child_table:0";
+  const TableID kGrandchildId = "grandchild_table:0";
+  const ColumnID kColumnID = "test_column:0";
+  const absl::Time t0_ = absl::Now();
+  const absl::Time t1_ = t0_ + absl::Seconds(1);
+  InMemoryStorage storage_{/*use_key_filters=*/true, /*intern_values=*/true,
+                           /*compression_threshold_bytes=*/0,
+                           /*colocate_interleaved_tables=*/true};
+};
+
+TEST_F(InMemoryStorageColocationTest, ReadsReturnOnlyRowsOfTheTableRead) {
+  EXPECT_THAT(ReadValues(t0_, kParentId, KeyRange::All()),
+              testing::ElementsAre(String("parent-1"), String("parent-2")));
+  EXPECT_THAT(ReadValues(t0_, kChildId, KeyRange::All()),
+              testing::ElementsAre(String("child-1-10"), String("child-1-20"),
+                                   String("child-2-10")));
+  EXPECT_THAT(ReadValues(t0_, kChildId, KeyRange::Prefix(Key({Int64(1)}))),
+              testing::ElementsAre(String("child-1-10"), String("child-1-20")));
+  EXPECT_THAT(ReadValues(t0_, kGrandchildId, KeyRange::All()),
+              testing::ElementsAre(String("grandchild-1-10-100")));
+
+  // Rows are read back with their own keys.
+  std::unique_ptr<StorageIterator> itr;
+  ZETASQL_ASSERT_OK(storage_.Read(t0_, kChildId,
+                          KeyRange::Prefix(Key({Int64(2)})), {kColumnID},
+                          &itr));
+  ASSERT_TRUE(itr->Next());
+  EXPECT_EQ(itr->Key(), Key({Int64(2), Int64(10)}));
+  EXPECT_FALSE(itr->Next());
+}
+
+TEST_F(InMemoryStorageColocationTest, LooksUpRowsOfChildTables) {
+  std::vector<zetasql::Value> values;
+  ZETASQL_EXPECT_OK(storage_.Lookup(t0_, kChildId, Key({Int64(1), Int64(20)}),
+                            {kColumnID}, &values));
+  EXPECT_THAT(values, testing::ElementsAre(String("child-1-20")));
+  EXPECT_THAT(storage_.Lookup(t0_, kChildId, Key({Int64(1)}), {kColumnID},
+                              &values),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+
+  std::unique_ptr<StorageIterator> itr;
+  ZETASQL_ASSERT_OK(storage_.MultiLookup(
+      t0_, kChildId, {Key({Int64(1), Int64(10)}), Key({Int64(2), Int64(10)})},
+      {kColumnID}, &itr));
+  std::vector<zetasql::Value> found;
+  while (itr->Next()) {
+    found.push_back(itr->ColumnValue(0));
+  }
+  ZETASQL_EXPECT_OK(itr->Status());
+  EXPECT_THAT(found, testing::ElementsAre(String("child-1-10"),
+                                          String("child-2-10")));
+}
+
+TEST_F(InMemoryStorageColocationTest, ReadsParentsWithTheirChildren) {
+  std::unique_ptr<InterleavedStorageIterator> itr;
+  ZETASQL_ASSERT_OK(storage_.ReadInterleaved(t0_, {kParentId, kChildId},
+                                     KeyRange::All(),
+                                     {{kColumnID}, {}}, &itr));
+  std::vector<std::pair<int, Key>> rows;
+  while (itr->Next()) {
+    EXPECT_EQ(itr->NumColumns(), itr->TableIndex() == 0 ? 1 : 0);
+    rows.push_back({itr->TableIndex(), itr->Key()});
+  }
+  ZETASQL_EXPECT_OK(itr->Status());
+  EXPECT_THAT(rows,
+              testing::ElementsAre(
+                  testing::Pair(0, Key({Int64(1)})),
+                  testing::Pair(1, Key({Int64(1), Int64(10)})),
+                  testing::Pair(1, Key({Int64(1), Int64(20)})),
+                  testing::Pair(0, Key({Int64(2)})),
+                  testing::Pair(1, Key({Int64(2), Int64(10)}))));
+
+  // Tables must be read under an ancestor of the same interleave root.
+  EXPECT_THAT(storage_.ReadInterleaved(t0_, {kChildId, kParentId},
+                                       KeyRange::All(), {{}, {}}, &itr),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST_F(InMemoryStorageColocationTest, DeletesRowsWithTheirDescendants) {
+  ZETASQL_EXPECT_OK(storage_.DeleteWithDescendants(t1_, kParentId,
+                                           KeyRange::Prefix(Key({Int64(1)}))));
+  EXPECT_THAT(ReadValues(t1_, kParentId, KeyRange::All()),
+              testing::ElementsAre(String("parent-2")));
+  EXPECT_THAT(ReadValues(t1_, kChildId, KeyRange::All()),
+              testing::ElementsAre(String("child-2-10")));
+  EXPECT_THAT(ReadValues(t1_, kGrandchildId, KeyRange::All()),
+              testing::IsEmpty());
+
+  // Reads at an older timestamp still see the deleted rows.
+  EXPECT_THAT(ReadValues(t0_, kGrandchildId, KeyRange::All()),
+              testing::ElementsAre(String("grandchild-1-10-100")));
+}
+
+TEST_F(InMemoryStorageColocationTest, DeletesOnlyRowsOfTheTableDeleted) {
+  ZETASQL_EXPECT_OK(storage_.Delete(t1_, kChildId, KeyRange::All()));
+  EXPECT_THAT(ReadValues(t1_, kChildId, KeyRange::All()), testing::IsEmpty());
+  EXPECT_THAT(ReadValues(t1_, kParentId, KeyRange::All()),
+              testing::ElementsAre(String("parent-1"), String("parent-2")));
+  EXPECT_THAT(ReadValues(t1_, kGrandchildId, KeyRange::All()),
+              testing::ElementsAre(String("grandchild-1-10-100")));
+}
+
+TEST_F(InMemoryStorageColocationTest, DeletesDescendantsAcrossParents) {
+  ZETASQL_EXPECT_OK(
+      storage_.DeleteWithDescendants(t1_, kChildId, KeyRange::All()));
+  EXPECT_THAT(ReadValues(t1_, kChildId, KeyRange::All()), testing::IsEmpty());
+  EXPECT_THAT(ReadValues(t1_, kGrandchildId, KeyRange::All()),
+              testing::IsEmpty());
+  EXPECT_THAT(ReadValues(t1_, kParentId, KeyRange::All()),
+              testing::ElementsAre(String("parent-1"), String("parent-2")));
+}
+
+TEST_F(InMemoryStorageColocationTest, DropsChildTablesWithoutVisitingRows) {
+  ZETASQL_EXPECT_OK(storage_.DropTable(t1_, kGrandchildId));
+  ZETASQL_EXPECT_OK(storage_.DropTable(t1_, kChildId));
+  EXPECT_THAT(ReadValues(t1_, kChildId, KeyRange::All()), testing::IsEmpty());
+  EXPECT_THAT(ReadValues(t1_, kParentId, KeyRange::All()),
+              testing::ElementsAre(String("parent-1"), String("parent-2")));
+  EXPECT_THAT(ReadValues(t0_, kChildId, KeyRange::All()),
+              testing::ElementsAre(String("child-1-10"), String("child-1-20"),
+                                   String("child-2-10")));
+  std::vector<zetasql::Value> values;
+  EXPECT_THAT(storage_.Lookup(t1_, kChildId, Key({Int64(1), Int64(10)}),
+                              {kColumnID}, &values),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+
+  // Garbage collection erases the rows of the dropped tables from the table
+  // of their root once reads before the drop can no longer happen.
+  const int64_t bytes = storage_.TotalBytes();
+  storage_.CollectGarbage(t0_);
+  EXPECT_EQ(storage_.TotalBytes(), bytes);
+  storage_.CollectGarbage(t1_);
+  EXPECT_LT(storage_.TotalBytes(), bytes);
+  EXPECT_THAT(ReadValues(t1_, kParentId, KeyRange::All()),
+              testing::ElementsAre(String("parent-1"), String("parent-2")));
+  absl::optional<TableStatistics> statistics =
+      storage_.GetTableStatistics(kParentId);
+  ASSERT_TRUE(statistics.has_value());
+  EXPECT_EQ(statistics->num_rows, 2);
+}
+
+TEST_F(InMemoryStorageColocationTest, ResetRestoresDroppedChildTables) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<StorageCheckpoint> checkpoint,
+                       storage_.Checkpoint(t0_));
+  ZETASQL_EXPECT_OK(storage_.DropTable(t1_, kGrandchildId));
+  ZETASQL_EXPECT_OK(storage_.ResetToCheckpoint(*checkpoint));
+  EXPECT_THAT(ReadValues(t1_, kGrandchildId, KeyRange::All()),
+              testing::ElementsAre(String("grandchild-1-10-100")));
+}
+
+TEST_F(InMemoryStorageColocationTest, EstimatesStatisticsOfChildTables) {
+  absl::optional<TableStatistics> statistics =
+      storage_.GetTableStatistics(kChildId);
+  ASSERT_TRUE(statistics.has_value());
+  EXPECT_EQ(statistics->num_rows, 3);
+  EXPECT_THAT(statistics->sample_keys,
+              testing::ElementsAre(Key({Int64(1), Int64(10)}),
+                                   Key({Int64(1), Int64(20)}),
+                                   Key({Int64(2), Int64(10)})));
+}
+
+TEST_F(InMemoryStorageColocationTest, RejectsTablesWhichCannotBeInterleaved) {
+  // Interleaving a table again in the same parent has no effect.
+  ZETASQL_EXPECT_OK(storage_.InterleaveTable(kChildId, kParentId, 2, 1));
+
+  EXPECT_THAT(storage_.InterleaveTable(kChildId, kGrandchildId, 4, 3),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kInternal));
+  EXPECT_THAT(storage_.InterleaveTable(kParentId, kChildId, 3, 2),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kInternal));
+  EXPECT_THAT(storage_.InterleaveTable("other_table:0", kParentId, 1, 2),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kInternal));
+
+  // Rows already stored by themselves cannot be moved under a parent.
+  ZETASQL_ASSERT_OK(storage_.Write(t0_, "other_table:0",
+                           Key({Int64(1), Int64(1)}), {kColumnID},
+                           {String("other")}));
+  EXPECT_THAT(storage_.InterleaveTable("other_table:0", kParentId, 2, 1),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST(InMemoryStorageWithoutColocationTest, IgnoresInterleavedTables) {
+  InMemoryStorage storage(/*use_key_filters=*/true, /*intern_values=*/true,
+                          /*compression_threshold_bytes=*/0,
+                          /*colocate_interleaved_tables=*/false);
+  EXPECT_FALSE(storage.ColocatesInterleavedTables());
+  ZETASQL_EXPECT_OK(
+      storage.InterleaveTable("child_table:0", "parent_table:0", 2, 1));
+
+  std::unique_ptr<InterleavedStorageIterator> itr;
+  EXPECT_THAT(
+      storage.ReadInterleaved(absl::Now(), {"parent_table:0", "child_table:0"},
+                              KeyRange::All(), {{}, {}}, &itr),
+      zetasql_base::testing::StatusIs(absl::StatusCode::kUnimplemented));
+}
+
 }  // namespace
 
 }  // namespace backend
@@ -17,6 +17,8 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_ITERATOR_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_ITERATOR_H_
 
+#include <vector>
+
 #include "zetasql/public/value.h"
 #include "backend/datamodel/key.h"
 #include "absl/status/status.h"
@@ -51,6 +53,25 @@ namespace backend {
 //    ZETASQL_RETURN_IF_ERROR(itr->Status()) << "Failed to read rows."
 class StorageIterator {
  public:
+  // Batch holds consecutive rows of an iterator column by column, see
+  // NextBatch().
+  struct Batch {
+    // Keys of the rows, in order.
+    std::vector<class Key> keys;
+
+    // Values of each column, one per row, as returned by ColumnValue().
+    std::vector<std::vector<zetasql::Value>> columns;
+
+    // Removes all rows. Columns are resized when rows are added, since
+    // iterators only know their number of columns when positioned at a row.
+    void Reset() {
+      keys.clear();
+      for (std::vector<zetasql::Value>& column : columns) {
+        column.clear();
+      }
+    }
+  };
+
   virtual ~StorageIterator() {}
 
   // Returns true on successfully advancing to the next row. Returns false if
@@ -74,6 +95,37 @@ class StorageIterator {
   //
   // REQUIRES: 0 <= i < NumColumns()
   virtual const zetasql::Value& ColumnValue(int i) const = 0;
+
+  // Moves past the next rows, up to `max_rows` of them, and replaces the
+  // contents of `batch` with their keys and column values. Returns false, with
+  // an empty batch, if there are no more rows or if there is an error, as
+  // Next() does. Key() and ColumnValue() may not be called after NextBatch()
+  // until Next() returns true again. The default implementation calls Next()
+  // for each row; iterators which buffer rows override it to move them out in
+  // bulk.
+  virtual bool NextBatch(int max_rows, Batch* batch) {
+    batch->Reset();
+    while (static_cast<int>(batch->keys.size()) < max_rows && Next()) {
+      batch->columns.resize(NumColumns());
+      batch->keys.push_back(Key());
+      for (int i = 0; i < NumColumns(); ++i) {
+        batch->columns[i].push_back(ColumnValue(i));
+      }
+    }
+    return !batch->keys.empty();
+  }
+};
+
+// InterleavedStorageIterator iterates through the rows returned from a call
+// to Storage::ReadInterleaved(), which belong to several tables. Each row
+// holds the columns read from its table, so NumColumns() varies from row to
+// row, and callers read rows with Next() rather than NextBatch().
+class InterleavedStorageIterator : public StorageIterator {
+ public:
+  // Returns the index of the table of the current row within the tables
+  // passed to ReadInterleaved(). A call to TableIndex() is only valid if a
+  // previous call to Next() returned true.
+  virtual int TableIndex() const = 0;
 };
 
 }  // namespace backend
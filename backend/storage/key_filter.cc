@@ -0,0 +1,101 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/storage/key_filter.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include "zetasql/public/value.h"
+#include "absl/hash/hash.h"
+#include "backend/datamodel/key.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// Number of filter bits per prefix and number of bits set per prefix, which
+// give a false positive rate of about 1% at capacity.
+constexpr int64_t kBitsPerPrefix = 10;
+constexpr int kNumProbes = 7;
+
+// Returns the hash of the prefix extended by the given column value.
+uint64_t ExtendPrefixHash(uint64_t prefix_hash, const zetasql::Value& value) {
+  return absl::Hash<std::pair<uint64_t, uint64_t>>()(
+      std::make_pair(prefix_hash, static_cast<uint64_t>(value.HashCode())));
+}
+
+}  // namespace
+
+KeyFilter::KeyFilter(int64_t capacity)
+    : capacity_(std::max(capacity, kMinCapacity)),
+      bits_((capacity_ * kBitsPerPrefix + 63) / 64) {}
+
+void KeyFilter::Add(const Key& key) {
+  uint64_t hash = 0;
+  for (int i = 0; i < key.NumColumns(); ++i) {
+    hash = ExtendPrefixHash(hash, key.ColumnValue(i));
+    SetBits(hash);
+    ++num_prefixes_;
+  }
+}
+
+bool KeyFilter::MayContain(const Key& prefix) const {
+  // Every key has the empty prefix.
+  if (prefix.IsEmpty()) {
+    return num_prefixes_ > 0;
+  }
+  uint64_t hash = 0;
+  for (int i = 0; i < prefix.NumColumns(); ++i) {
+    hash = ExtendPrefixHash(hash, prefix.ColumnValue(i));
+  }
+  return TestBits(hash);
+}
+
+// Probes are derived from the two halves of the hash (double hashing), which
+// is as effective as independent hash functions for a Bloom filter.
+void KeyFilter::SetBits(uint64_t hash) {
+  const uint64_t num_bits = bits_.size() * 64;
+  const uint64_t delta = (hash >> 32) | 1;
+  for (int i = 0; i < kNumProbes; ++i) {
+    const uint64_t bit = hash % num_bits;
+    bits_[bit / 64] |= uint64_t{1} << (bit % 64);
+    hash += delta;
+  }
+}
+
+bool KeyFilter::TestBits(uint64_t hash) const {
+  const uint64_t num_bits = bits_.size() * 64;
+  const uint64_t delta = (hash >> 32) | 1;
+  for (int i = 0; i < kNumProbes; ++i) {
+    const uint64_t bit = hash % num_bits;
+    if ((bits_[bit / 64] & (uint64_t{1} << (bit % 64))) == 0) {
+      return false;
+    }
+    hash += delta;
+  }
+  return true;
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
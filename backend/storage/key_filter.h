@@ -0,0 +1,82 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_KEY_FILTER_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_KEY_FILTER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "backend/datamodel/key.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// KeyFilter is a Bloom filter over a set of keys and all of their prefixes.
+//
+// MayContain(prefix) returns false only if no key added to the filter has the
+// given prefix (a key is a prefix of itself), so callers can skip searching
+// for keys which have never been written. It may return true for prefixes
+// which were never added, at a rate of about 1% while the number of added
+// prefixes stays within the filter's capacity. Keys cannot be removed; stale
+// keys are dropped by rebuilding the filter from scratch.
+//
+// This class is not thread-safe.
+class KeyFilter {
+ public:
+  // Constructs a filter sized for the given number of prefixes.
+  explicit KeyFilter(int64_t capacity = kMinCapacity);
+
+  // Adds the key and each of its non-empty prefixes to the filter.
+  void Add(const Key& key);
+
+  // Returns false if no key added to the filter has the given prefix.
+  bool MayContain(const Key& prefix) const;
+
+  // Returns true if more prefixes were added than the filter was sized for, at
+  // which point its false positive rate increases quickly.
+  bool IsFull() const { return num_prefixes_ > capacity_; }
+
+  // Returns the number of prefixes added to the filter.
+  int64_t num_prefixes() const { return num_prefixes_; }
+
+  // Minimum number of prefixes a filter is sized for.
+  static constexpr int64_t kMinCapacity = 1024;
+
+ private:
+  // Sets (or tests) the bits of the filter for the given prefix hash.
+  void SetBits(uint64_t hash);
+  bool TestBits(uint64_t hash) const;
+
+  // Number of prefixes the filter is sized for.
+  int64_t capacity_;
+
+  // Number of prefixes added to the filter.
+  int64_t num_prefixes_ = 0;
+
+  // Bit array of the filter.
+  std::vector<uint64_t> bits_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_KEY_FILTER_H_
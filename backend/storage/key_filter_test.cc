@@ -0,0 +1,81 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/storage/key_filter.h"
+
+#include "zetasql/public/value.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "backend/datamodel/key.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql::values::Int64;
+using zetasql::values::String;
+
+TEST(KeyFilterTest, EmptyFilterContainsNothing) {
+  KeyFilter filter;
+  EXPECT_FALSE(filter.MayContain(Key()));
+  EXPECT_FALSE(filter.MayContain(Key({Int64(1)})));
+}
+
+TEST(KeyFilterTest, ContainsAddedKeysAndTheirPrefixes) {
+  KeyFilter filter;
+  filter.Add(Key({Int64(1), String("a")}));
+
+  EXPECT_TRUE(filter.MayContain(Key()));
+  EXPECT_TRUE(filter.MayContain(Key({Int64(1)})));
+  EXPECT_TRUE(filter.MayContain(Key({Int64(1), String("a")})));
+  EXPECT_EQ(filter.num_prefixes(), 2);
+}
+
+TEST(KeyFilterTest, RejectsMostKeysWhichWereNotAdded) {
+  KeyFilter filter(/*capacity=*/1000);
+  for (int i = 0; i < 1000; ++i) {
+    filter.Add(Key({Int64(2 * i)}));
+  }
+  EXPECT_FALSE(filter.IsFull());
+
+  int false_positives = 0;
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_TRUE(filter.MayContain(Key({Int64(2 * i)})));
+    if (filter.MayContain(Key({Int64(2 * i + 1)}))) {
+      ++false_positives;
+    }
+  }
+  EXPECT_LT(false_positives, 50);
+}
+
+TEST(KeyFilterTest, IsFullBeyondCapacity) {
+  KeyFilter filter(/*capacity=*/0);
+  for (int i = 0; i < KeyFilter::kMinCapacity; ++i) {
+    filter.Add(Key({Int64(i)}));
+  }
+  EXPECT_FALSE(filter.IsFull());
+  filter.Add(Key({Int64(-1)}));
+  EXPECT_TRUE(filter.IsFull());
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
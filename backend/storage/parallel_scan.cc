@@ -0,0 +1,68 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/storage/parallel_scan.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "backend/datamodel/key.h"
+#include "common/executor.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+zetasql_base::StatusOr<std::vector<KeyRange>> SplitKeyRangeForScan(
+    const Storage* storage, const TableID& table_id, const KeyRange& key_range,
+    int max_ranges, int64_t min_rows_per_range) {
+  std::vector<Key> split_keys;
+  ZETASQL_RETURN_IF_ERROR(storage->SplitKeyRange(
+      table_id, key_range, max_ranges, min_rows_per_range, &split_keys));
+  std::vector<KeyRange> ranges;
+  ranges.reserve(split_keys.size() + 1);
+  Key range_start = key_range.start_key();
+  for (Key& split_key : split_keys) {
+    ranges.push_back(KeyRange::ClosedOpen(range_start, split_key));
+    range_start = std::move(split_key);
+  }
+  ranges.push_back(KeyRange::ClosedOpen(range_start, key_range.limit_key()));
+  return ranges;
+}
+
+absl::Status ForEachInParallel(int num_tasks, int max_threads,
+                               const std::function<absl::Status(int)>& fn) {
+  if (num_tasks <= 1 || max_threads <= 1) {
+    for (int i = 0; i < num_tasks; ++i) {
+      ZETASQL_RETURN_IF_ERROR(fn(i));
+    }
+    return absl::OkStatus();
+  }
+  TaskGroup group(Executor::Default(), TaskPriority::kBackground, max_threads);
+  for (int i = 0; i < num_tasks; ++i) {
+    group.Schedule([&fn, i]() { return fn(i); });
+  }
+  return group.Wait();
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,75 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_PARALLEL_SCAN_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_PARALLEL_SCAN_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "backend/common/ids.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/storage/storage.h"
+#include "absl/status/status.h"
+#include "zetasql/base/statusor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// Helpers for internal consumers which scan a whole table (or a large range of
+// it), such as backfills, schema verifiers and partitioned DML, to do so in
+// parallel:
+//
+//    ZETASQL_ASSIGN_OR_RETURN(std::vector<KeyRange> ranges,
+//                     SplitKeyRangeForScan(storage, table_id, KeyRange::All(),
+//                                          max_ranges, min_rows_per_range));
+//    ZETASQL_RETURN_IF_ERROR(ForEachInParallel(ranges.size(), max_threads,
+//                                      [&](int i) {
+//      std::unique_ptr<StorageIterator> itr;
+//      ZETASQL_RETURN_IF_ERROR(storage->Read(timestamp, table_id, ranges[i],
+//                                    column_ids, &itr));
+//      ...
+//    }));
+//
+// Each range is read by a Read of its own at the same timestamp, so together
+// the ranges see a consistent snapshot of the table.
+
+// Splits `key_range` of the table into at most `max_ranges` consecutive
+// closed-open ranges of about the same number of rows, each of at least
+// `min_rows_per_range` rows, using the key sample kept by the storage (see
+// Storage::SplitKeyRange). Returns `key_range` alone if the range is too small
+// to split, or the storage cannot sample its keys.
+zetasql_base::StatusOr<std::vector<KeyRange>> SplitKeyRangeForScan(
+    const Storage* storage, const TableID& table_id, const KeyRange& key_range,
+    int max_ranges, int64_t min_rows_per_range);
+
+// Calls `fn` with each index in [0, num_tasks), as background tasks of the
+// shared executor of which up to `max_threads` run at once, counting the
+// calling thread, if there is more than one task. Returns the error of the
+// lowest failing index, as calling `fn` for each index in turn would. Indexes
+// above a failing one are not started once its failure is known.
+absl::Status ForEachInParallel(int num_tasks, int max_threads,
+                               const std::function<absl::Status(int)>& fn);
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_PARALLEL_SCAN_H_
@@ -0,0 +1,116 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/storage/parallel_scan.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "tests/common/proto_matchers.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/storage/in_memory_storage.h"
+#include "backend/storage/iterator.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql::values::Int64;
+using zetasql_base::testing::StatusIs;
+
+const TableID kTableId = "test_table:0";
+const ColumnID kColumnId = "test_column:0";
+
+TEST(ParallelScan, DoesNotSplitSmallRanges) {
+  InMemoryStorage storage;
+  ZETASQL_ASSERT_OK(storage.Write(absl::Now(), kTableId, Key({Int64(1)}),
+                          {kColumnId}, {Int64(1)}));
+  KeyRange range = KeyRange::ClosedOpen(Key({Int64(0)}), Key({Int64(10)}));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::vector<KeyRange> ranges,
+                       SplitKeyRangeForScan(&storage, kTableId, range,
+                                            /*max_ranges=*/4,
+                                            /*min_rows_per_range=*/100));
+  ASSERT_EQ(ranges.size(), 1);
+  EXPECT_EQ(ranges[0].start_key(), range.start_key());
+  EXPECT_EQ(ranges[0].limit_key(), range.limit_key());
+}
+
+TEST(ParallelScan, ScansEachRowOnceAcrossRanges) {
+  constexpr int kNumRows = 1000;
+  InMemoryStorage storage;
+  absl::Time timestamp = absl::Now();
+  for (int i = 0; i < kNumRows; ++i) {
+    ZETASQL_ASSERT_OK(storage.Write(timestamp, kTableId, Key({Int64(i)}),
+                            {kColumnId}, {Int64(i)}));
+  }
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::vector<KeyRange> ranges,
+                       SplitKeyRangeForScan(&storage, kTableId,
+                                            KeyRange::All(), /*max_ranges=*/8,
+                                            /*min_rows_per_range=*/100));
+  EXPECT_EQ(ranges.size(), 8);
+
+  absl::Mutex mu;
+  std::vector<int64_t> keys;
+  auto scan_range = [&](int i) -> absl::Status {
+    std::unique_ptr<StorageIterator> itr;
+    ZETASQL_RETURN_IF_ERROR(storage.Read(timestamp, kTableId, ranges[i],
+                                 {kColumnId}, &itr));
+    while (itr->Next()) {
+      absl::MutexLock lock(&mu);
+      keys.push_back(itr->Key().ColumnValue(0).int64_value());
+    }
+    return itr->Status();
+  };
+  ZETASQL_ASSERT_OK(
+      ForEachInParallel(ranges.size(), /*max_threads=*/4, scan_range));
+  std::sort(keys.begin(), keys.end());
+  ASSERT_EQ(keys.size(), kNumRows);
+  for (int i = 0; i < kNumRows; ++i) {
+    EXPECT_EQ(keys[i], i);
+  }
+}
+
+TEST(ParallelScan, ReturnsErrorOfLowestFailingTask) {
+  EXPECT_THAT(ForEachInParallel(16, /*max_threads=*/4,
+                                [](int i) -> absl::Status {
+                                  if (i == 5) {
+                                    return absl::InternalError("five");
+                                  }
+                                  if (i == 9) {
+                                    return absl::NotFoundError("nine");
+                                  }
+                                  return absl::OkStatus();
+                                }),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,208 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/storage/staged_storage.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/value.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "backend/common/ids.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/storage/iterator.h"
+#include "common/errors.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+StagedStorage::StagedStorage(Storage* base,
+                             absl::flat_hash_set<TableID> base_table_ids)
+    : base_(base), base_table_ids_(std::move(base_table_ids)) {}
+
+const Storage* StagedStorage::StorageToRead(const TableID& table_id) const {
+  if (!base_table_ids_.contains(table_id)) {
+    return &staged_;
+  }
+  absl::MutexLock lock(&mu_);
+  read_table_ids_.insert(table_id);
+  return base_;
+}
+
+absl::Status StagedStorage::StageWrite(
+    const TableID& table_id, const std::vector<ColumnID>& column_ids) {
+  absl::MutexLock lock(&mu_);
+  if (base_table_ids_.contains(table_id)) {
+    deferred_ = true;
+    return absl::Status(
+        absl::StatusCode::kFailedPrecondition,
+        absl::StrCat("Cannot stage changes to existing table: ", table_id));
+  }
+  staged_columns_[table_id].insert(column_ids.begin(), column_ids.end());
+  return absl::OkStatus();
+}
+
+absl::Status StagedStorage::Lookup(absl::Time timestamp,
+                                   const TableID& table_id, const Key& key,
+                                   const std::vector<ColumnID>& column_ids,
+                                   std::vector<zetasql::Value>* values) const {
+  return StorageToRead(table_id)->Lookup(timestamp, table_id, key, column_ids,
+                                         values);
+}
+
+absl::Status StagedStorage::Read(absl::Time timestamp, const TableID& table_id,
+                                 const KeyRange& key_range,
+                                 const std::vector<ColumnID>& column_ids,
+                                 std::unique_ptr<StorageIterator>* itr) const {
+  return StorageToRead(table_id)->Read(timestamp, table_id, key_range,
+                                       column_ids, itr);
+}
+
+absl::Status StagedStorage::MultiLookup(
+    absl::Time timestamp, const TableID& table_id, const std::vector<Key>& keys,
+    const std::vector<ColumnID>& column_ids,
+    std::unique_ptr<StorageIterator>* itr) const {
+  return StorageToRead(table_id)->MultiLookup(timestamp, table_id, keys,
+                                              column_ids, itr);
+}
+
+absl::Status StagedStorage::SplitKeyRange(const TableID& table_id,
+                                          const KeyRange& key_range,
+                                          int max_ranges,
+                                          int64_t min_rows_per_range,
+                                          std::vector<Key>* split_keys) const {
+  return StorageToRead(table_id)->SplitKeyRange(
+      table_id, key_range, max_ranges, min_rows_per_range, split_keys);
+}
+
+absl::Status StagedStorage::Write(absl::Time timestamp,
+                                  const TableID& table_id, const Key& key,
+                                  const std::vector<ColumnID>& column_ids,
+                                  const std::vector<zetasql::Value>& values) {
+  ZETASQL_RETURN_IF_ERROR(StageWrite(table_id, column_ids));
+  return staged_.Write(timestamp, table_id, key, column_ids, values);
+}
+
+absl::Status StagedStorage::Delete(absl::Time timestamp,
+                                   const TableID& table_id,
+                                   const KeyRange& key_range) {
+  ZETASQL_RETURN_IF_ERROR(StageWrite(table_id, /*column_ids=*/{}));
+  return staged_.Delete(timestamp, table_id, key_range);
+}
+
+absl::Status StagedStorage::DropTable(absl::Time timestamp,
+                                      const TableID& table_id) {
+  ZETASQL_RETURN_IF_ERROR(StageWrite(table_id, /*column_ids=*/{}));
+  {
+    absl::MutexLock lock(&mu_);
+    staged_columns_.erase(table_id);
+  }
+  return staged_.DropTable(timestamp, table_id);
+}
+
+absl::Status StagedStorage::WriteBatch(
+    absl::Time timestamp, const TableID& table_id,
+    const std::vector<StorageWrite>& writes) {
+  std::vector<ColumnID> column_ids;
+  for (const StorageWrite& write : writes) {
+    column_ids.insert(column_ids.end(), write.column_ids.begin(),
+                      write.column_ids.end());
+  }
+  ZETASQL_RETURN_IF_ERROR(StageWrite(table_id, column_ids));
+  return staged_.WriteBatch(timestamp, table_id, writes);
+}
+
+absl::Status StagedStorage::InterleaveTable(const TableID& child_id,
+                                            const TableID& parent_id,
+                                            int num_key_columns,
+                                            int num_parent_key_columns) {
+  return base_->InterleaveTable(child_id, parent_id, num_key_columns,
+                                num_parent_key_columns);
+}
+
+zetasql_base::StatusOr<std::unique_ptr<StorageCheckpoint>>
+StagedStorage::Checkpoint(absl::Time timestamp) const {
+  return error::Internal("StagedStorage does not support checkpoints.");
+}
+
+absl::Status StagedStorage::ResetToCheckpoint(
+    const StorageCheckpoint& checkpoint) {
+  return error::Internal("StagedStorage does not support checkpoints.");
+}
+
+absl::optional<TableStatistics> StagedStorage::GetTableStatistics(
+    const TableID& table_id) const {
+  return StorageToRead(table_id)->GetTableStatistics(table_id);
+}
+
+bool StagedStorage::deferred() const {
+  absl::MutexLock lock(&mu_);
+  return deferred_;
+}
+
+zetasql_base::StatusOr<bool> StagedStorage::BaseChangedSince(
+    absl::Time timestamp) const {
+  absl::MutexLock lock(&mu_);
+  for (const TableID& table_id : read_table_ids_) {
+    ZETASQL_ASSIGN_OR_RETURN(
+        bool changed,
+        base_->ChangedSince(timestamp, table_id, KeyRange::All()));
+    if (changed) {
+      return true;
+    }
+  }
+  return false;
+}
+
+absl::Status StagedStorage::ApplyTo(absl::Time timestamp,
+                                    Storage* storage) const {
+  absl::MutexLock lock(&mu_);
+  for (const auto& [table_id, columns] : staged_columns_) {
+    std::vector<ColumnID> column_ids(columns.begin(), columns.end());
+    std::unique_ptr<StorageIterator> itr;
+    ZETASQL_RETURN_IF_ERROR(staged_.Read(absl::InfiniteFuture(), table_id,
+                                 KeyRange::All(), column_ids, &itr));
+    std::vector<StorageWrite> writes;
+    while (itr->Next()) {
+      StorageWrite write;
+      write.key = itr->Key();
+      for (int i = 0; i < column_ids.size(); ++i) {
+        // Only the columns which were written to the row are copied.
+        if (itr->ColumnValue(i).is_valid()) {
+          write.column_ids.push_back(column_ids[i]);
+          write.values.push_back(itr->ColumnValue(i));
+        }
+      }
+      writes.push_back(std::move(write));
+    }
+    ZETASQL_RETURN_IF_ERROR(itr->Status());
+    ZETASQL_RETURN_IF_ERROR(storage->WriteBatch(timestamp, table_id, writes));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
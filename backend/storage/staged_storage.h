@@ -0,0 +1,180 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_STAGED_STORAGE_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_STAGED_STORAGE_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "zetasql/public/value.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "backend/common/ids.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/storage/in_memory_storage.h"
+#include "backend/storage/iterator.h"
+#include "backend/storage/storage.h"
+#include "absl/status/status.h"
+#include "zetasql/base/statusor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// StagedStorage lets the backfills and verifications of a schema change run
+// against a snapshot of a database's storage while transactions keep writing
+// to it, so that the schema change only needs to hold its database lock to
+// apply the result:
+//
+//    StagedStorage staged(storage, base_table_ids);
+//    ... run the schema change against `staged` at a snapshot timestamp ...
+//    ... acquire the schema change lock and reserve its commit timestamp ...
+//    ZETASQL_ASSIGN_OR_RETURN(bool changed,
+//                     staged.BaseChangedSince(snapshot_timestamp));
+//    if (staged.deferred() || changed) {
+//      ... run the schema change again against `storage` ...
+//    } else {
+//      ZETASQL_RETURN_IF_ERROR(staged.ApplyTo(commit_timestamp, storage));
+//    }
+//
+// The tables of `base_table_ids`, which the schema had before the change, are
+// read from the base storage. All other tables are those the schema change
+// creates, such as the data tables of new indexes: they are read from and
+// written to a storage of the StagedStorage's own, until ApplyTo copies their
+// rows to the base storage. Changes to the tables of the base storage, such
+// as the backfill of a column whose type changes, cannot be staged: they fail
+// with FAILED_PRECONDITION and mark the staged run as deferred, so that the
+// schema change is run under its lock instead. Interleavings are declared in
+// the base storage right away, since they only take effect for tables once
+// rows are written to them.
+//
+// StagedStorage is thread-safe, as backfills read and write in parallel.
+class StagedStorage : public Storage {
+ public:
+  StagedStorage(Storage* base, absl::flat_hash_set<TableID> base_table_ids);
+
+  absl::Status Lookup(absl::Time timestamp, const TableID& table_id,
+                      const Key& key, const std::vector<ColumnID>& column_ids,
+                      std::vector<zetasql::Value>* values) const override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  absl::Status Read(absl::Time timestamp, const TableID& table_id,
+                    const KeyRange& key_range,
+                    const std::vector<ColumnID>& column_ids,
+                    std::unique_ptr<StorageIterator>* itr) const override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  absl::Status MultiLookup(absl::Time timestamp, const TableID& table_id,
+                           const std::vector<Key>& keys,
+                           const std::vector<ColumnID>& column_ids,
+                           std::unique_ptr<StorageIterator>* itr) const override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  absl::Status SplitKeyRange(const TableID& table_id,
+                             const KeyRange& key_range, int max_ranges,
+                             int64_t min_rows_per_range,
+                             std::vector<Key>* split_keys) const override;
+
+  absl::Status Write(absl::Time timestamp, const TableID& table_id,
+                     const Key& key, const std::vector<ColumnID>& column_ids,
+                     const std::vector<zetasql::Value>& values) override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  absl::Status Delete(absl::Time timestamp, const TableID& table_id,
+                      const KeyRange& key_range) override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  absl::Status DropTable(absl::Time timestamp,
+                         const TableID& table_id) override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  absl::Status WriteBatch(absl::Time timestamp, const TableID& table_id,
+                          const std::vector<StorageWrite>& writes) override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  absl::Status InterleaveTable(const TableID& child_id,
+                               const TableID& parent_id, int num_key_columns,
+                               int num_parent_key_columns) override;
+
+  // The staged rows are only kept for the duration of the schema change, so
+  // there is nothing to collect or checkpoint.
+  void CollectGarbage(absl::Time horizon) override {}
+  zetasql_base::StatusOr<std::unique_ptr<StorageCheckpoint>> Checkpoint(
+      absl::Time timestamp) const override;
+  absl::Status ResetToCheckpoint(const StorageCheckpoint& checkpoint) override;
+
+  absl::optional<TableStatistics> GetTableStatistics(
+      const TableID& table_id) const override;
+
+  // Returns true if a change to a table of the base storage was attempted, in
+  // which case the staged run must be discarded.
+  bool deferred() const ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns true if a table of the base storage which was read may have
+  // changed after `timestamp`, the snapshot the reads were made at. The
+  // caller must hold a lock which keeps the tables from changing further.
+  zetasql_base::StatusOr<bool> BaseChangedSince(absl::Time timestamp) const
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Writes the staged rows of the tables which still exist (i.e. which were
+  // not dropped by a failed backfill) to `storage` at `timestamp`.
+  absl::Status ApplyTo(absl::Time timestamp, Storage* storage) const
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  // Returns the storage which holds the rows of `table_id`, recording reads of
+  // the base storage.
+  const Storage* StorageToRead(const TableID& table_id) const
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns an error if `table_id` cannot be written to, or records that it
+  // has staged rows, written with `column_ids`.
+  absl::Status StageWrite(const TableID& table_id,
+                          const std::vector<ColumnID>& column_ids)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  Storage* base_;
+  const absl::flat_hash_set<TableID> base_table_ids_;
+
+  // Holds the rows written to the tables created by the schema change.
+  InMemoryStorage staged_;
+
+  mutable absl::Mutex mu_;
+
+  // Tables of the base storage which were read.
+  mutable absl::flat_hash_set<TableID> read_table_ids_ ABSL_GUARDED_BY(mu_);
+
+  // Columns written to each table with staged rows.
+  absl::flat_hash_map<TableID, absl::flat_hash_set<ColumnID>> staged_columns_
+      ABSL_GUARDED_BY(mu_);
+
+  bool deferred_ ABSL_GUARDED_BY(mu_) = false;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_STAGED_STORAGE_H_
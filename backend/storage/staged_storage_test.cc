@@ -0,0 +1,143 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/storage/staged_storage.h"
+
+#include <memory>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "tests/common/proto_matchers.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/storage/in_memory_storage.h"
+#include "backend/storage/iterator.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql::values::Int64;
+using zetasql::values::String;
+
+class StagedStorageTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ZETASQL_ASSERT_OK(base_.Write(t0_, kBaseTableId, Key({Int64(1)}), {kColumnID},
+                          {String("value-1")}));
+  }
+
+  // Returns the values of the column read from `storage` for `table_id`.
+  std::vector<zetasql::Value> ReadValues(const Storage& storage,
+                                         absl::Time timestamp,
+                                         const TableID& table_id) {
+    std::vector<zetasql::Value> values;
+    std::unique_ptr<StorageIterator> itr;
+    ZETASQL_EXPECT_OK(storage.Read(timestamp, table_id, KeyRange::All(),
+                           {kColumnID}, &itr));
+    while (itr->Next()) {
+      values.push_back(itr->ColumnValue(0));
+    }
+    ZETASQL_EXPECT_OK(itr->Status());
+    return values;
+  }
+
+  const TableID kBaseTableId = "test_table:0";
+  const TableID kNewTableId = "test_table:1";
+  const ColumnID kColumnID = "test_column:0";
+  const absl::Time t0_ = absl::Now();
+  const absl::Time t1_ = t0_ + absl::Seconds(1);
+  const absl::Time t2_ = t1_ + absl::Seconds(1);
+  InMemoryStorage base_;
+  StagedStorage staged_{&base_, {kBaseTableId}};
+};
+
+TEST_F(StagedStorageTest, ReadsExistingTablesFromBaseStorage) {
+  EXPECT_THAT(ReadValues(staged_, t0_, kBaseTableId),
+              testing::ElementsAre(String("value-1")));
+  std::vector<zetasql::Value> values;
+  ZETASQL_EXPECT_OK(staged_.Lookup(t0_, kBaseTableId, Key({Int64(1)}), {kColumnID},
+                           &values));
+  EXPECT_THAT(values, testing::ElementsAre(String("value-1")));
+}
+
+TEST_F(StagedStorageTest, KeepsWritesToNewTablesApart) {
+  ZETASQL_EXPECT_OK(staged_.Write(t0_, kNewTableId, Key({Int64(2)}), {kColumnID},
+                          {String("value-2")}));
+  EXPECT_THAT(ReadValues(staged_, t0_, kNewTableId),
+              testing::ElementsAre(String("value-2")));
+  EXPECT_THAT(ReadValues(base_, t0_, kNewTableId), testing::IsEmpty());
+  EXPECT_FALSE(staged_.deferred());
+}
+
+TEST_F(StagedStorageTest, DefersChangesToExistingTables) {
+  EXPECT_THAT(staged_.Write(t0_, kBaseTableId, Key({Int64(2)}), {kColumnID},
+                            {String("value-2")}),
+              zetasql_base::testing::StatusIs(
+                  absl::StatusCode::kFailedPrecondition));
+  EXPECT_TRUE(staged_.deferred());
+  EXPECT_THAT(ReadValues(base_, t0_, kBaseTableId),
+              testing::ElementsAre(String("value-1")));
+}
+
+TEST_F(StagedStorageTest, AppliesStagedRowsToStorage) {
+  ZETASQL_EXPECT_OK(staged_.WriteBatch(
+      t0_, kNewTableId,
+      {StorageWrite{Key({Int64(2)}), false, {kColumnID}, {String("value-2")}},
+       StorageWrite{Key({Int64(3)}), false, {kColumnID},
+                    {String("value-3")}}}));
+  ZETASQL_EXPECT_OK(staged_.ApplyTo(t1_, &base_));
+  EXPECT_THAT(ReadValues(base_, t0_, kNewTableId), testing::IsEmpty());
+  EXPECT_THAT(ReadValues(base_, t1_, kNewTableId),
+              testing::ElementsAre(String("value-2"), String("value-3")));
+}
+
+TEST_F(StagedStorageTest, DoesNotApplyDroppedTables) {
+  ZETASQL_EXPECT_OK(staged_.Write(t0_, kNewTableId, Key({Int64(2)}), {kColumnID},
+                          {String("value-2")}));
+  ZETASQL_EXPECT_OK(staged_.DropTable(t0_, kNewTableId));
+  ZETASQL_EXPECT_OK(staged_.ApplyTo(t1_, &base_));
+  EXPECT_THAT(ReadValues(base_, t1_, kNewTableId), testing::IsEmpty());
+}
+
+TEST_F(StagedStorageTest, DetectsChangesToTablesRead) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(bool changed, staged_.BaseChangedSince(t0_));
+  EXPECT_FALSE(changed);
+
+  // Changes to tables which were not read do not matter.
+  ZETASQL_EXPECT_OK(base_.Write(t1_, kBaseTableId, Key({Int64(2)}), {kColumnID},
+                        {String("value-2")}));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(changed, staged_.BaseChangedSince(t0_));
+  EXPECT_FALSE(changed);
+
+  ReadValues(staged_, t0_, kBaseTableId);
+  ZETASQL_ASSERT_OK_AND_ASSIGN(changed, staged_.BaseChangedSince(t1_));
+  EXPECT_FALSE(changed);
+  ZETASQL_ASSERT_OK_AND_ASSIGN(changed, staged_.BaseChangedSince(t0_));
+  EXPECT_TRUE(changed);
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
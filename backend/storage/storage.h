@@ -17,24 +17,81 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_STORAGE_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_STORAGE_STORAGE_H_
 
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 #include "zetasql/public/value.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/time/time.h"
+#include "absl/types/optional.h"
 #include "backend/common/ids.h"
 #include "backend/datamodel/key.h"
 #include "backend/datamodel/key_range.h"
 #include "backend/storage/iterator.h"
 #include "absl/status/status.h"
+#include "zetasql/base/statusor.h"
 
 namespace google {
 namespace spanner {
 namespace emulator {
 namespace backend {
 
+// StorageWrite is a write to a single row, applied by Storage::WriteBatch.
+struct StorageWrite {
+  Key key;
+
+  // If true the row is deleted, and column_ids and values are ignored.
+  bool is_delete = false;
+
+  std::vector<ColumnID> column_ids;
+  std::vector<zetasql::Value> values;
+};
+
+// TableVersion identifies the state of the rows of a table, see
+// Storage::GetTableVersion.
+struct TableVersion {
+  // Changes whenever rows of the table are written or deleted.
+  int64_t change = 0;
+
+  // Latest timestamp at which rows of the table were written or deleted.
+  absl::Time max_change_timestamp = absl::InfinitePast();
+
+  bool operator==(const TableVersion& other) const {
+    return change == other.change &&
+           max_change_timestamp == other.max_change_timestamp;
+  }
+  bool operator!=(const TableVersion& other) const { return !(*this == other); }
+};
+
+// TableStatistics summarizes the rows of a table, see
+// Storage::GetTableStatistics.
+struct TableStatistics {
+  // Number of rows, including deleted rows which are not yet garbage
+  // collected.
+  int64_t num_rows = 0;
+
+  // Approximate bytes of memory held by the rows, including their older
+  // versions.
+  int64_t bytes = 0;
+
+  // Keys of a uniform sample of the rows, in increasing order. Holds the keys
+  // of all rows if the table is small enough.
+  std::vector<Key> sample_keys;
+};
+
+// StorageCheckpoint holds the data of a storage visible at a timestamp, see
+// Storage::Checkpoint. It can only be used with the storage which created it.
+class StorageCheckpoint {
+ public:
+  virtual ~StorageCheckpoint() {}
+};
+
 // Storage defines the interface for a multi-version data store.
 //
-// There will be a Storage instance for each database created. The current
-// interface is grow-only, i.e. once data is added, it will not be deleted.
-// Storage is thread-safe.
+// There will be a Storage instance for each database created. Data is only
+// removed by garbage collection of versions which are no longer visible to
+// reads at or after a given timestamp. Storage is thread-safe.
 class Storage {
  public:
   virtual ~Storage() {}
@@ -49,6 +106,24 @@ class Storage {
                               const std::vector<ColumnID>& column_ids,
                               std::vector<zetasql::Value>* values) const = 0;
 
+  // Like Lookup, but returns false instead of NOT_FOUND if the given key does
+  // not exist, leaving `values` empty. Used by callers for which a missing key
+  // is an expected outcome, such as checking that an inserted row does not
+  // exist yet, so that no error message is built for them.
+  virtual zetasql_base::StatusOr<bool> LookupIfExists(
+      absl::Time timestamp, const TableID& table_id, const Key& key,
+      const std::vector<ColumnID>& column_ids,
+      std::vector<zetasql::Value>* values) const {
+    absl::Status status = Lookup(timestamp, table_id, key, column_ids, values);
+    if (absl::IsNotFound(status)) {
+      return false;
+    }
+    if (!status.ok()) {
+      return status;
+    }
+    return true;
+  }
+
   // Returns zero or more rows for given key range. Keys are returned in
   // sorted order. See comments on StorageIterator for more details. KeyRange
   // interval should be in KeyRange::ClosedOpen format. Non ClosedOpen ranges
@@ -58,6 +133,32 @@ class Storage {
                             const std::vector<ColumnID>& column_ids,
                             std::unique_ptr<StorageIterator>* itr) const = 0;
 
+  // Returns the rows for the given keys which exist at the specified timestamp,
+  // in the order of keys, as a single iterator. Keys must be sorted in
+  // increasing order; duplicates are returned once. Keys which do not exist
+  // are skipped. Unlike a Read of a point range per key, the table is searched
+  // once for the whole batch.
+  virtual absl::Status MultiLookup(absl::Time timestamp,
+                                   const TableID& table_id,
+                                   const std::vector<Key>& keys,
+                                   const std::vector<ColumnID>& column_ids,
+                                   std::unique_ptr<StorageIterator>* itr)
+      const = 0;
+
+  // Sets `split_keys` to at most `max_ranges - 1` increasing keys which split
+  // the rows of `key_range` of the table into ranges of about the same number
+  // of rows, each of at least `min_rows_per_range` rows. Rows are counted
+  // whichever of their versions exist, so the split is only approximate. Used
+  // to read a large range in parallel; storages which cannot sample their
+  // keys return no split keys.
+  virtual absl::Status SplitKeyRange(const TableID& table_id,
+                                     const KeyRange& key_range, int max_ranges,
+                                     int64_t min_rows_per_range,
+                                     std::vector<Key>* split_keys) const {
+    split_keys->clear();
+    return absl::OkStatus();
+  }
+
   // Writes column values for given key at the specified timestamp. Column value
   // will be overwritten for non-unique <timestamp, table_id, key, column_id>
   // combination.
@@ -72,6 +173,125 @@ class Storage {
   // ranges will result in INVALID_ARGUMENT.
   virtual absl::Status Delete(absl::Time timestamp, const TableID& table_id,
                               const KeyRange& key_range) = 0;
+
+  // Deletes all rows of the given table at the specified timestamp, as a
+  // Delete of KeyRange::All() does. Reads at older timestamps still see the
+  // rows until they are garbage collected. Used when a table or index is
+  // dropped; storages which can do so detach the rows of the table as a whole
+  // instead of deleting them one by one.
+  virtual absl::Status DropTable(absl::Time timestamp,
+                                 const TableID& table_id) {
+    return Delete(timestamp, table_id, KeyRange::All());
+  }
+
+  // Applies `writes` to rows of the given table at the specified timestamp, in
+  // order, with the same effect as calling Write (or Delete for the key) for
+  // each of them. Writes sorted by key are applied most efficiently, and
+  // writes to the same key must be in the order they should take effect. On
+  // error, writes before the failing one may have been applied.
+  virtual absl::Status WriteBatch(absl::Time timestamp, const TableID& table_id,
+                                  const std::vector<StorageWrite>& writes) = 0;
+
+  // Declares that the table `child_id`, whose keys have `num_key_columns`
+  // columns, is interleaved in the table `parent_id`, whose keys are the first
+  // `num_parent_key_columns` of these columns. Must be called before any row
+  // is written to the child, and for the parent before its own children.
+  // Storages which co-locate interleaved tables store the rows of the child
+  // with those of its parent from then on; others ignore it.
+  virtual absl::Status InterleaveTable(const TableID& child_id,
+                                       const TableID& parent_id,
+                                       int num_key_columns,
+                                       int num_parent_key_columns) {
+    return absl::OkStatus();
+  }
+
+  // Returns true if the rows of interleaved tables are stored with those of
+  // their parents, in which case ReadInterleaved and DeleteWithDescendants
+  // are supported.
+  virtual bool ColocatesInterleavedTables() const { return false; }
+
+  // Returns the rows of the table `table_ids[0]` within the ClosedOpen
+  // `key_range`, each followed by the rows of the tables `table_ids[1..]`
+  // interleaved in it (directly or not), as a single iterator. `column_ids[i]`
+  // are the columns read from the table `table_ids[i]`. Used to read a parent
+  // along with its descendants in a single pass.
+  virtual absl::Status ReadInterleaved(
+      absl::Time timestamp, const std::vector<TableID>& table_ids,
+      const KeyRange& key_range,
+      const std::vector<std::vector<ColumnID>>& column_ids,
+      std::unique_ptr<InterleavedStorageIterator>* itr) const {
+    return absl::Status(absl::StatusCode::kUnimplemented,
+                        "Storage does not co-locate interleaved tables.");
+  }
+
+  // Deletes the rows of the given table within the ClosedOpen `key_range`
+  // along with the rows of all tables interleaved in them, as a cascading
+  // delete of these rows does.
+  virtual absl::Status DeleteWithDescendants(absl::Time timestamp,
+                                             const TableID& table_id,
+                                             const KeyRange& key_range) {
+    return absl::Status(absl::StatusCode::kUnimplemented,
+                        "Storage does not co-locate interleaved tables.");
+  }
+
+  // Removes column values and rows which are not visible to any read at or
+  // after `horizon`. Lookup and Read at timestamps older than `horizon` may
+  // return incorrect results after this call.
+  virtual void CollectGarbage(absl::Time horizon) = 0;
+
+  // Returns a checkpoint of the rows visible at `timestamp`, to which the
+  // storage can later be reset.
+  virtual zetasql_base::StatusOr<std::unique_ptr<StorageCheckpoint>> Checkpoint(
+      absl::Time timestamp) const = 0;
+
+  // Replaces all data of the storage, including older versions, with the rows
+  // of `checkpoint`. Reads at or after the checkpoint timestamp see the rows
+  // of the checkpoint, and writes must be newer than that timestamp. Returns
+  // INTERNAL if `checkpoint` was created by another storage.
+  virtual absl::Status ResetToCheckpoint(const StorageCheckpoint& checkpoint) = 0;
+
+  // Returns the current version of the given table. As long as a table keeps
+  // the same version, reads at timestamps at or after its
+  // max_change_timestamp return the same rows, which lets results computed
+  // from the table be reused. Storages which do not track the versions of
+  // their tables return nullopt.
+  virtual absl::optional<TableVersion> GetTableVersion(
+      const TableID& table_id) const {
+    return absl::nullopt;
+  }
+
+  // Returns true if rows of the given table with keys in the ClosedOpen
+  // `key_range` may have been written or deleted at a timestamp after
+  // `timestamp`, which must still be retained from garbage collection. Used to
+  // validate the reads of optimistic transactions, for which a false positive
+  // only costs a retry. Storages which do not track the versions of rows answer
+  // from the version of the table, or always return true if they do not track
+  // that either.
+  virtual zetasql_base::StatusOr<bool> ChangedSince(
+      absl::Time timestamp, const TableID& table_id,
+      const KeyRange& key_range) const {
+    absl::optional<TableVersion> version = GetTableVersion(table_id);
+    return !version.has_value() || version->max_change_timestamp > timestamp;
+  }
+
+  // Returns statistics of the rows of the given table, maintained as rows are
+  // written so that they are cheap to get, for use in choosing how to split or
+  // scan the table. Storages which do not keep statistics return nullopt.
+  virtual absl::optional<TableStatistics> GetTableStatistics(
+      const TableID& table_id) const {
+    return absl::nullopt;
+  }
+
+  // Returns the approximate number of bytes of memory held by the rows of each
+  // table, including their older versions. Storages which do not account for
+  // their memory return no tables.
+  virtual absl::flat_hash_map<TableID, int64_t> TableBytes() const {
+    return {};
+  }
+
+  // Returns the approximate number of bytes of memory held by the rows of all
+  // tables, including their older versions.
+  virtual int64_t TotalBytes() const { return 0; }
 };
 
 }  // namespace backend
@@ -17,10 +17,12 @@
 #include "backend/transaction/actions.h"
 
 #include <memory>
+#include <utility>
 
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "zetasql/base/statusor.h"
+#include "absl/types/optional.h"
 #include "backend/actions/context.h"
 #include "backend/actions/existence.h"
 #include "backend/actions/interleave.h"
@@ -30,6 +32,7 @@
 #include "backend/storage/iterator.h"
 #include "backend/transaction/transaction_store.h"
 #include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
 
 namespace google {
 namespace spanner {
@@ -38,14 +41,9 @@ namespace backend {
 
 zetasql_base::StatusOr<bool> TransactionReadOnlyStore::Exists(const Table* table,
                                                       const Key& key) const {
-  zetasql_base::StatusOr<ValueList> maybe_row =
-      read_only_store_->Lookup(table, key, {});
-  if (maybe_row.status().code() == absl::StatusCode::kNotFound) {
-    return false;
-  } else if (!maybe_row.ok()) {
-    return maybe_row.status();
-  }
-  return true;
+  ZETASQL_ASSIGN_OR_RETURN(absl::optional<ValueList> row,
+                   read_only_store_->LookupIfExists(table, key, {}));
+  return row.has_value();
 }
 
 zetasql_base::StatusOr<bool> TransactionReadOnlyStore::PrefixExists(
@@ -68,22 +66,24 @@ zetasql_base::StatusOr<std::unique_ptr<StorageIterator>> TransactionReadOnlyStor
   return itr;
 }
 
-void TransactionEffectsBuffer::Insert(
-    const Table* table, const Key& key, absl::Span<const Column* const> columns,
-    const std::vector<zetasql::Value>& values) {
-  ops_queue_->push(
-      InsertOp{table, key, {columns.begin(), columns.end()}, values});
+void TransactionEffectsBuffer::Insert(const Table* table, Key key,
+                                      absl::Span<const Column* const> columns,
+                                      std::vector<zetasql::Value> values) {
+  ops_queue_->push(InsertOp{table, std::move(key),
+                            {columns.begin(), columns.end()},
+                            std::move(values)});
 }
 
-void TransactionEffectsBuffer::Update(
-    const Table* table, const Key& key, absl::Span<const Column* const> columns,
-    const std::vector<zetasql::Value>& values) {
-  ops_queue_->push(
-      UpdateOp{table, key, {columns.begin(), columns.end()}, values});
+void TransactionEffectsBuffer::Update(const Table* table, Key key,
+                                      absl::Span<const Column* const> columns,
+                                      std::vector<zetasql::Value> values) {
+  ops_queue_->push(UpdateOp{table, std::move(key),
+                            {columns.begin(), columns.end()},
+                            std::move(values)});
 }
 
-void TransactionEffectsBuffer::Delete(const Table* table, const Key& key) {
-  ops_queue_->push(DeleteOp{table, key});
+void TransactionEffectsBuffer::Delete(const Table* table, Key key) {
+  ops_queue_->push(DeleteOp{table, std::move(key)});
 }
 
 }  // namespace backend
@@ -66,15 +66,15 @@ class TransactionEffectsBuffer : public EffectsBuffer {
   explicit TransactionEffectsBuffer(std::queue<WriteOp>* ops_queue)
       : ops_queue_(ops_queue) {}
 
-  void Insert(const Table* table, const Key& key,
+  void Insert(const Table* table, Key key,
               absl::Span<const Column* const> columns,
-              const std::vector<zetasql::Value>& values) override;
+              std::vector<zetasql::Value> values) override;
 
-  void Update(const Table* table, const Key& key,
+  void Update(const Table* table, Key key,
               absl::Span<const Column* const> columns,
-              const std::vector<zetasql::Value>& values) override;
+              std::vector<zetasql::Value> values) override;
 
-  void Delete(const Table* table, const Key& key) override;
+  void Delete(const Table* table, Key key) override;
 
  private:
   std::queue<WriteOp>* ops_queue_;
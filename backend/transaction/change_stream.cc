@@ -0,0 +1,144 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/transaction/change_stream.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/variant.h"
+#include "backend/common/variant.h"
+#include "backend/schema/catalog/column.h"
+#include "backend/schema/catalog/table.h"
+#include "common/errors.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// Returns the change made by a write op to `table`.
+Change MakeChange(absl::Time commit_timestamp, const std::string& table,
+                  Change::Type type, const Key& key,
+                  const std::vector<const Column*>& columns,
+                  const std::vector<zetasql::Value>& values) {
+  Change change{commit_timestamp, table, type, key};
+  change.columns.reserve(columns.size());
+  for (const Column* column : columns) {
+    change.columns.push_back(column->Name());
+  }
+  change.values = values;
+  return change;
+}
+
+}  // namespace
+
+ChangeStream::ChangeStream(int64_t max_retained_changes)
+    : max_retained_changes_(max_retained_changes) {}
+
+void ChangeStream::Append(absl::Time commit_timestamp,
+                          const std::vector<WriteOp>& write_ops) {
+  Commit commit{commit_timestamp};
+  for (const WriteOp& write_op : write_ops) {
+    const Table* table = TableOf(write_op);
+    if (table->owner_index() != nullptr) {
+      continue;
+    }
+    commit.changes.push_back(std::visit(
+        overloaded{
+            [&](const InsertOp& op) {
+              return MakeChange(commit_timestamp, table->Name(),
+                                Change::Type::kInsert, op.key, op.columns,
+                                op.values);
+            },
+            [&](const UpdateOp& op) {
+              return MakeChange(commit_timestamp, table->Name(),
+                                Change::Type::kUpdate, op.key, op.columns,
+                                op.values);
+            },
+            [&](const DeleteOp& op) {
+              return MakeChange(commit_timestamp, table->Name(),
+                                Change::Type::kDelete, op.key, {}, {});
+            },
+        },
+        write_op));
+  }
+  if (commit.changes.empty()) {
+    return;
+  }
+
+  absl::MutexLock lock(&mu_);
+  num_changes_ += commit.changes.size();
+  commits_.push_back(std::move(commit));
+  // Drop the oldest transactions, but always keep the latest one.
+  while (num_changes_ > max_retained_changes_ && commits_.size() > 1) {
+    num_changes_ -= commits_.front().changes.size();
+    dropped_through_ = commits_.front().timestamp;
+    commits_.pop_front();
+  }
+  appended_.SignalAll();
+}
+
+absl::Status ChangeStream::Read(absl::Time after,
+                                const std::vector<std::string>& tables,
+                                int64_t max_changes, absl::Time deadline,
+                                std::vector<Change>* changes) const {
+  changes->clear();
+  absl::MutexLock lock(&mu_);
+  while (true) {
+    if (after < dropped_through_) {
+      return error::ChangesNotRetained(after, dropped_through_);
+    }
+    auto commit_itr = std::upper_bound(
+        commits_.begin(), commits_.end(), after,
+        [](absl::Time timestamp, const Commit& commit) {
+          return timestamp < commit.timestamp;
+        });
+    for (; commit_itr != commits_.end() &&
+           static_cast<int64_t>(changes->size()) < max_changes;
+         ++commit_itr) {
+      for (const Change& change : commit_itr->changes) {
+        if (tables.empty() || std::find(tables.begin(), tables.end(),
+                                        change.table) != tables.end()) {
+          changes->push_back(change);
+        }
+      }
+    }
+    if (!changes->empty() || absl::Now() >= deadline) {
+      return absl::OkStatus();
+    }
+    // Wait for the next transaction, and look again for changes to the given
+    // tables past the ones already scanned.
+    if (!commits_.empty()) {
+      after = commits_.back().timestamp;
+    }
+    appended_.WaitWithDeadline(&mu_, deadline);
+  }
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,122 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_CHANGE_STREAM_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_CHANGE_STREAM_H_
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "zetasql/public/value.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "backend/actions/ops.h"
+#include "backend/datamodel/key.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// A change to a row of a table, as committed by a read-write transaction.
+struct Change {
+  enum class Type { kInsert, kUpdate, kDelete };
+
+  absl::Time commit_timestamp;
+
+  // Name of the changed table.
+  std::string table;
+
+  Type type;
+
+  // Key of the changed row. For deletes of a range of rows by prefix (e.g.
+  // the children of a deleted parent row), a prefix of the deleted keys.
+  Key key;
+
+  // Names and new values of the written columns. Empty for deletes.
+  std::vector<std::string> columns;
+  std::vector<zetasql::Value> values;
+};
+
+// ChangeStream keeps the most recent changes committed to a database, so that
+// consumers can tail them instead of polling the tables for changes.
+//
+// Changes are appended by the commit pipeline as each transaction is flushed
+// to storage, in commit timestamp order. Inserts or updates are recorded as
+// they were flushed: replaces are a delete followed by an insert, and inserts
+// or updates are whichever of the two applied. Changes to index data tables
+// are not recorded.
+//
+// Only the last `max_retained_changes` changes are kept, in whole
+// transactions. A consumer resumes from the commit timestamp of the last
+// change it read, and is told if changes after it were dropped.
+//
+// This class is thread-safe.
+class ChangeStream {
+ public:
+  explicit ChangeStream(int64_t max_retained_changes);
+
+  // Records the changes of `write_ops`, committed at `commit_timestamp`, which
+  // must be later than that of the transactions appended before.
+  void Append(absl::Time commit_timestamp,
+              const std::vector<WriteOp>& write_ops) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Sets `changes` to the changes committed after `after` to any of `tables`
+  // (or to any table if `tables` is empty), in commit timestamp order. Waits
+  // until there is at least one such change or `deadline` passes, in which
+  // case `changes` is left empty. About `max_changes` changes are returned at
+  // most, but the changes of a transaction are never split across calls.
+  //
+  // Returns FAILED_PRECONDITION if changes after `after` were already dropped.
+  absl::Status Read(absl::Time after, const std::vector<std::string>& tables,
+                    int64_t max_changes, absl::Time deadline,
+                    std::vector<Change>* changes) const
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  // The changes of a transaction.
+  struct Commit {
+    absl::Time timestamp;
+    std::vector<Change> changes;
+  };
+
+  const int64_t max_retained_changes_;
+
+  mutable absl::Mutex mu_;
+
+  // Retained transactions, in commit timestamp order.
+  std::deque<Commit> commits_ ABSL_GUARDED_BY(mu_);
+
+  // Number of changes in commits_.
+  int64_t num_changes_ ABSL_GUARDED_BY(mu_) = 0;
+
+  // Commit timestamp of the last transaction dropped from commits_.
+  absl::Time dropped_through_ ABSL_GUARDED_BY(mu_) = absl::InfinitePast();
+
+  // Signalled when a transaction is appended.
+  mutable absl::CondVar appended_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_CHANGE_STREAM_H_
@@ -0,0 +1,202 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/transaction/change_stream.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "backend/actions/ops.h"
+#include "backend/datamodel/key.h"
+#include "tests/common/schema_constructor.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql::values::Int64;
+using zetasql::values::String;
+using zetasql_base::testing::StatusIs;
+
+class ChangeStreamTest : public testing::Test {
+ public:
+  ChangeStreamTest()
+      : type_factory_(absl::make_unique<zetasql::TypeFactory>()),
+        schema_(test::CreateSchemaFromDDL(
+                    {
+                        R"(
+                          CREATE TABLE A (
+                            K INT64 NOT NULL,
+                            V STRING(MAX),
+                          ) PRIMARY KEY (K)
+                        )",
+                        R"(
+                          CREATE TABLE B (
+                            K INT64 NOT NULL,
+                          ) PRIMARY KEY (K)
+                        )",
+                        "CREATE INDEX AByV ON A(V)"},
+                    type_factory_.get())
+                    .ValueOrDie()),
+        a_(schema_->FindTable("A")),
+        b_(schema_->FindTable("B")) {}
+
+ protected:
+  // The type factory must outlive the type objects that it has made.
+  std::unique_ptr<zetasql::TypeFactory> type_factory_;
+  std::unique_ptr<const Schema> schema_;
+
+  const Table* a_;
+  const Table* b_;
+
+  const absl::Time t0_ = absl::FromUnixSeconds(1000);
+
+  WriteOp InsertA(int64_t key) {
+    return InsertOp{a_,
+                    Key({Int64(key)}),
+                    {a_->FindColumn("K"), a_->FindColumn("V")},
+                    {Int64(key), String("value")}};
+  }
+
+  WriteOp DeleteB(int64_t key) { return DeleteOp{b_, Key({Int64(key)})}; }
+
+  zetasql_base::StatusOr<std::vector<Change>> Read(
+      const ChangeStream& stream, absl::Time after,
+      const std::vector<std::string>& tables = {},
+      int64_t max_changes = 100) {
+    std::vector<Change> changes;
+    ZETASQL_RETURN_IF_ERROR(stream.Read(after, tables, max_changes,
+                                /*deadline=*/absl::InfinitePast(), &changes));
+    return changes;
+  }
+};
+
+TEST_F(ChangeStreamTest, ReadsChangesAfterTimestampInCommitOrder) {
+  ChangeStream stream(/*max_retained_changes=*/100);
+  stream.Append(t0_ + absl::Seconds(1), {InsertA(1), DeleteB(2)});
+  stream.Append(t0_ + absl::Seconds(2), {InsertA(3)});
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::vector<Change> changes, Read(stream, t0_));
+  ASSERT_EQ(changes.size(), 3);
+  EXPECT_EQ(changes[0].commit_timestamp, t0_ + absl::Seconds(1));
+  EXPECT_EQ(changes[0].table, "A");
+  EXPECT_EQ(changes[0].type, Change::Type::kInsert);
+  EXPECT_EQ(changes[0].key, Key({Int64(1)}));
+  EXPECT_THAT(changes[0].columns, testing::ElementsAre("K", "V"));
+  EXPECT_THAT(changes[0].values,
+              testing::ElementsAre(Int64(1), String("value")));
+  EXPECT_EQ(changes[1].table, "B");
+  EXPECT_EQ(changes[1].type, Change::Type::kDelete);
+  EXPECT_TRUE(changes[1].columns.empty());
+  EXPECT_EQ(changes[2].key, Key({Int64(3)}));
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(changes, Read(stream, t0_ + absl::Seconds(1)));
+  ASSERT_EQ(changes.size(), 1);
+  EXPECT_EQ(changes[0].commit_timestamp, t0_ + absl::Seconds(2));
+}
+
+TEST_F(ChangeStreamTest, FiltersChangesByTable) {
+  ChangeStream stream(/*max_retained_changes=*/100);
+  stream.Append(t0_ + absl::Seconds(1), {InsertA(1), DeleteB(2)});
+  stream.Append(t0_ + absl::Seconds(2), {InsertA(3)});
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::vector<Change> changes,
+                       Read(stream, t0_, {"B"}));
+  ASSERT_EQ(changes.size(), 1);
+  EXPECT_EQ(changes[0].table, "B");
+}
+
+TEST_F(ChangeStreamTest, DoesNotRecordIndexChanges) {
+  ChangeStream stream(/*max_retained_changes=*/100);
+  const Table* index_data_table =
+      schema_->FindIndex("AByV")->index_data_table();
+  stream.Append(t0_ + absl::Seconds(1),
+                {InsertA(1), DeleteOp{index_data_table, Key()}});
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::vector<Change> changes, Read(stream, t0_));
+  ASSERT_EQ(changes.size(), 1);
+  EXPECT_EQ(changes[0].table, "A");
+}
+
+TEST_F(ChangeStreamTest, DoesNotSplitTransactions) {
+  ChangeStream stream(/*max_retained_changes=*/100);
+  stream.Append(t0_ + absl::Seconds(1), {InsertA(1), InsertA(2)});
+  stream.Append(t0_ + absl::Seconds(2), {InsertA(3)});
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::vector<Change> changes,
+                       Read(stream, t0_, {}, /*max_changes=*/1));
+  EXPECT_EQ(changes.size(), 2);
+}
+
+TEST_F(ChangeStreamTest, FailsToReadDroppedChanges) {
+  ChangeStream stream(/*max_retained_changes=*/2);
+  stream.Append(t0_ + absl::Seconds(1), {InsertA(1)});
+  stream.Append(t0_ + absl::Seconds(2), {InsertA(2)});
+  stream.Append(t0_ + absl::Seconds(3), {InsertA(3)});
+
+  EXPECT_THAT(Read(stream, t0_),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::vector<Change> changes,
+                       Read(stream, t0_ + absl::Seconds(1)));
+  EXPECT_EQ(changes.size(), 2);
+}
+
+TEST_F(ChangeStreamTest, ReturnsNoChangesAtDeadline) {
+  ChangeStream stream(/*max_retained_changes=*/100);
+  stream.Append(t0_ + absl::Seconds(1), {InsertA(1)});
+
+  std::vector<Change> changes;
+  ZETASQL_EXPECT_OK(stream.Read(t0_ + absl::Seconds(1), {}, 100,
+                        absl::Now() + absl::Milliseconds(10), &changes));
+  EXPECT_TRUE(changes.empty());
+}
+
+TEST_F(ChangeStreamTest, WaitsForChanges) {
+  ChangeStream stream(/*max_retained_changes=*/100);
+  std::thread appender([&]() {
+    absl::SleepFor(absl::Milliseconds(10));
+    stream.Append(t0_ + absl::Seconds(1), {InsertA(1)});
+    stream.Append(t0_ + absl::Seconds(2), {DeleteB(1)});
+  });
+
+  std::vector<Change> changes;
+  ZETASQL_EXPECT_OK(
+      stream.Read(t0_, {"B"}, 100, absl::InfiniteFuture(), &changes));
+  appender.join();
+  ASSERT_EQ(changes.size(), 1);
+  EXPECT_EQ(changes[0].table, "B");
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,341 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/transaction/commit_log.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "zetasql/public/value.h"
+#include "zetasql/public/value.pb.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "backend/actions/ops.h"
+#include "backend/common/variant.h"
+#include "backend/datamodel/key.h"
+#include "backend/schema/catalog/column.h"
+#include "backend/schema/catalog/index.h"
+#include "backend/schema/catalog/table.h"
+#include "backend/transaction/commit_log.pb.h"
+#include "common/errors.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+namespace {
+
+// Size of the length prefix of each record.
+constexpr size_t kRecordSizeBytes = sizeof(uint64_t);
+
+// Appends `serialized` to `data`, prefixed by its size.
+void AppendFramedRecord(const std::string& serialized, std::string* data) {
+  uint64_t record_size = serialized.size();
+  for (int i = 0; i < kRecordSizeBytes; ++i) {
+    data->push_back(static_cast<char>((record_size >> (8 * i)) & 0xff));
+  }
+  data->append(serialized);
+}
+
+// Reads the complete records of the log at `path` from the record starting at
+// offset `valid_size`, calling `callback` (if not null) for each of them. On
+// return `valid_size` holds the offset just past the last complete record.
+absl::Status ReadRecords(
+    const std::string& path,
+    const std::function<absl::Status(const CommitLogRecord&)>& callback,
+    int64_t* valid_size) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    if (errno == ENOENT) {
+      return absl::OkStatus();
+    }
+    return error::CommitLogIOError(path, "open", std::strerror(errno));
+  }
+  file.seekg(0, std::ios::end);
+  const int64_t file_size = file.tellg();
+  if (*valid_size > file_size) {
+    return error::InvalidCommitLog(
+        path, absl::StrCat("log is shorter than offset ", *valid_size));
+  }
+  file.seekg(*valid_size, std::ios::beg);
+
+  char size[kRecordSizeBytes];
+  std::string serialized;
+  CommitLogRecord record;
+  while (file.read(size, kRecordSizeBytes)) {
+    uint64_t record_size = 0;
+    for (int i = 0; i < kRecordSizeBytes; ++i) {
+      record_size |= static_cast<uint64_t>(static_cast<unsigned char>(size[i]))
+                     << (8 * i);
+    }
+    // A record extending past the end of the file was only partially written.
+    if (record_size > file_size - *valid_size - kRecordSizeBytes) {
+      break;
+    }
+    if (callback == nullptr) {
+      file.seekg(record_size, std::ios::cur);
+    } else {
+      serialized.resize(record_size);
+      file.read(&serialized[0], record_size);
+      if (!record.ParseFromString(serialized)) {
+        return error::InvalidCommitLog(
+            path, absl::StrCat("unparseable record at offset ", *valid_size));
+      }
+      ZETASQL_RETURN_IF_ERROR(callback(record));
+    }
+    if (!file.good()) {
+      return error::CommitLogIOError(path, "read", std::strerror(errno));
+    }
+    *valid_size += kRecordSizeBytes + record_size;
+  }
+  if (file.bad()) {
+    return error::CommitLogIOError(path, "read", std::strerror(errno));
+  }
+  return absl::OkStatus();
+}
+
+// Returns the name recorded for writes to `table`.
+std::string LoggedTableName(const Table* table, bool* is_index) {
+  *is_index = table->owner_index() != nullptr;
+  return *is_index ? table->owner_index()->Name() : table->Name();
+}
+
+// Adds an op to `record` for a write of `key` in `table`.
+zetasql_base::StatusOr<CommitLogRecord::Op*> AddOp(
+    CommitLogRecord::Op::Type type, const Table* table, const Key& key,
+    CommitLogRecord* record) {
+  CommitLogRecord::Op* op = record->add_ops();
+  op->set_type(type);
+  bool is_index = false;
+  op->set_table_name(LoggedTableName(table, &is_index));
+  op->set_is_index(is_index);
+  for (const zetasql::Value& value : key.column_values()) {
+    ZETASQL_RETURN_IF_ERROR(value.Serialize(op->add_key()));
+  }
+  return op;
+}
+
+// Adds the columns and values written by an insert or update to `op`.
+absl::Status AddColumnValues(const std::vector<const Column*>& columns,
+                             const std::vector<zetasql::Value>& values,
+                             CommitLogRecord::Op* op) {
+  for (int i = 0; i < columns.size(); ++i) {
+    op->add_column_names(columns[i]->Name());
+    const zetasql::Value& value = values[i];
+    zetasql::ValueProto* value_proto = op->add_values();
+    if (value.is_valid()) {
+      ZETASQL_RETURN_IF_ERROR(value.Serialize(value_proto));
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Returns the record for `write_ops` committed at `commit_timestamp`.
+zetasql_base::StatusOr<CommitLogRecord> WriteOpsRecord(
+    absl::Time commit_timestamp, const std::vector<WriteOp>& write_ops) {
+  CommitLogRecord record;
+  record.set_commit_timestamp_micros(absl::ToUnixMicros(commit_timestamp));
+  for (const WriteOp& write_op : write_ops) {
+    ZETASQL_RETURN_IF_ERROR(std::visit(
+        overloaded{
+            [&](const InsertOp& insert_op) -> absl::Status {
+              ZETASQL_ASSIGN_OR_RETURN(
+                  CommitLogRecord::Op * op,
+                  AddOp(CommitLogRecord::Op::INSERT, insert_op.table,
+                        insert_op.key, &record));
+              return AddColumnValues(insert_op.columns, insert_op.values, op);
+            },
+            [&](const UpdateOp& update_op) -> absl::Status {
+              ZETASQL_ASSIGN_OR_RETURN(
+                  CommitLogRecord::Op * op,
+                  AddOp(CommitLogRecord::Op::UPDATE, update_op.table,
+                        update_op.key, &record));
+              return AddColumnValues(update_op.columns, update_op.values, op);
+            },
+            [&](const DeleteOp& delete_op) -> absl::Status {
+              return AddOp(CommitLogRecord::Op::DELETE, delete_op.table,
+                           delete_op.key, &record)
+                  .status();
+            },
+        },
+        write_op));
+  }
+  return record;
+}
+
+}  // namespace
+
+CommitLog::CommitLog(const std::string& path, int fd, SyncPolicy sync_policy)
+    : path_(path), fd_(fd), sync_policy_(sync_policy) {}
+
+CommitLog::~CommitLog() { close(fd_); }
+
+zetasql_base::StatusOr<std::unique_ptr<CommitLog>> CommitLog::Open(
+    const std::string& path, SyncPolicy sync_policy) {
+  int64_t valid_size = 0;
+  ZETASQL_RETURN_IF_ERROR(ReadRecords(path, /*callback=*/nullptr, &valid_size));
+
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return error::CommitLogIOError(path, "open", std::strerror(errno));
+  }
+  auto commit_log = absl::WrapUnique(new CommitLog(path, fd, sync_policy));
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    return error::CommitLogIOError(path, "stat", std::strerror(errno));
+  }
+  if (file_stat.st_size > valid_size && ftruncate(fd, valid_size) != 0) {
+    return error::CommitLogIOError(path, "truncate", std::strerror(errno));
+  }
+  return commit_log;
+}
+
+absl::Status CommitLog::Replay(
+    const std::string& path,
+    const std::function<absl::Status(const CommitLogRecord&)>& callback) {
+  int64_t valid_size = 0;
+  return ReadRecords(path, callback, &valid_size);
+}
+
+absl::Status CommitLog::ReplayFrom(
+    const std::string& path, int64_t* offset,
+    const std::function<absl::Status(const CommitLogRecord&)>& callback) {
+  return ReadRecords(path, callback, offset);
+}
+
+absl::Status CommitLog::AppendWriteOps(absl::Time commit_timestamp,
+                                       const std::vector<WriteOp>& write_ops) {
+  if (write_ops.empty()) {
+    return absl::OkStatus();
+  }
+  ZETASQL_ASSIGN_OR_RETURN(CommitLogRecord record,
+                   WriteOpsRecord(commit_timestamp, write_ops));
+  return Append(record);
+}
+
+absl::Status CommitLog::AppendWriteOpsGroup(
+    absl::Span<const absl::Time> commit_timestamps,
+    absl::Span<const std::vector<WriteOp>* const> write_ops) {
+  std::vector<CommitLogRecord> records;
+  for (int i = 0; i < write_ops.size(); ++i) {
+    if (write_ops[i]->empty()) {
+      continue;
+    }
+    ZETASQL_ASSIGN_OR_RETURN(records.emplace_back(),
+                     WriteOpsRecord(commit_timestamps[i], *write_ops[i]));
+  }
+  return AppendRecords(records);
+}
+
+absl::Status CommitLog::AppendSchemaChange(
+    absl::Time commit_timestamp, absl::Span<const std::string> statements) {
+  CommitLogRecord record;
+  record.set_commit_timestamp_micros(absl::ToUnixMicros(commit_timestamp));
+  for (const std::string& statement : statements) {
+    record.add_ddl_statements(statement);
+  }
+  return Append(record);
+}
+
+absl::Status CommitLog::Append(const CommitLogRecord& record) {
+  return AppendRecords(absl::MakeConstSpan(&record, 1));
+}
+
+absl::Status CommitLog::AppendRecords(
+    absl::Span<const CommitLogRecord> records) {
+  if (records.empty()) {
+    return absl::OkStatus();
+  }
+  std::vector<std::string> serialized(records.size());
+  for (int i = 0; i < records.size(); ++i) {
+    if (!records[i].SerializeToString(&serialized[i])) {
+      return error::Internal("Failed to serialize commit log record");
+    }
+  }
+
+  // The records are framed together, so that they are written by the same
+  // writer and this call waits for a single sequence number.
+  mu_.Lock();
+  for (const std::string& record : serialized) {
+    AppendFramedRecord(record, &pending_);
+  }
+  const int64_t sequence = ++last_appended_;
+  while (last_written_ < sequence && write_status_.ok()) {
+    if (writing_) {
+      write_done_.Wait(&mu_);
+      continue;
+    }
+    // Become the writer of all the pending records, including this one.
+    writing_ = true;
+    std::string data;
+    data.swap(pending_);
+    const int64_t last_in_group = last_appended_;
+    mu_.Unlock();
+    absl::Status status = WriteAndSync(data);
+    mu_.Lock();
+    writing_ = false;
+    if (status.ok()) {
+      last_written_ = last_in_group;
+    } else {
+      write_status_ = status;
+    }
+    write_done_.SignalAll();
+  }
+  absl::Status status =
+      last_written_ >= sequence ? absl::OkStatus() : write_status_;
+  mu_.Unlock();
+  return status;
+}
+
+absl::Status CommitLog::WriteAndSync(const std::string& data) {
+  size_t offset = 0;
+  while (offset < data.size()) {
+    ssize_t written = write(fd_, data.data() + offset, data.size() - offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return error::CommitLogIOError(path_, "write", std::strerror(errno));
+    }
+    offset += written;
+  }
+  if (sync_policy_ == SyncPolicy::kAlways && fdatasync(fd_) != 0) {
+    return error::CommitLogIOError(path_, "sync", std::strerror(errno));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,159 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_COMMIT_LOG_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_COMMIT_LOG_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "backend/actions/ops.h"
+#include "backend/transaction/commit_log.pb.h"
+#include "absl/status/status.h"
+#include "zetasql/base/statusor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// CommitLog is an append-only write-ahead log of the schema changes and
+// transactions committed to a database, which allows the database to be
+// recovered after the emulator process exits.
+//
+// The log file is a sequence of records. Each record is a serialized
+// CommitLogRecord prefixed by its size as a 64-bit little-endian integer (the
+// same framing as database snapshots). A record which was only partially
+// written when the process exited is ignored by Replay() and truncated by
+// Open().
+//
+// Concurrent appends are group committed: while one caller writes (and syncs)
+// the records pending at that point, the records of other callers accumulate
+// and are written together by the next caller to become the writer. Each call
+// returns only once its own record has been written.
+//
+// This class is thread-safe.
+class CommitLog {
+ public:
+  // Controls when appended records are synced to disk.
+  enum class SyncPolicy {
+    // Records are handed to the operating system but not synced. Commits
+    // survive the emulator process exiting, but not a machine crash.
+    kNone,
+
+    // Each group of records is synced with fdatasync before the appends
+    // return.
+    kAlways,
+  };
+
+  // Opens the commit log at `path` for appending, creating it if it does not
+  // exist. A partially written record at the end of the log is truncated.
+  static zetasql_base::StatusOr<std::unique_ptr<CommitLog>> Open(
+      const std::string& path, SyncPolicy sync_policy);
+
+  // Calls `callback` for each complete record in the commit log at `path`, in
+  // the order they were appended. Returns the first error returned by
+  // `callback`. A missing log is treated as an empty one.
+  static absl::Status Replay(
+      const std::string& path,
+      const std::function<absl::Status(const CommitLogRecord&)>& callback);
+
+  // Like Replay, but starts from the record at `*offset`, which must be 0 or
+  // an offset returned by a previous call, and advances `*offset` past the
+  // last complete record. Calling it repeatedly tails a log which another
+  // CommitLog, possibly in another process, appends to: records which are
+  // only partially written are returned by a later call. If `callback` fails,
+  // `*offset` is left at the start of the record it failed on.
+  static absl::Status ReplayFrom(
+      const std::string& path, int64_t* offset,
+      const std::function<absl::Status(const CommitLogRecord&)>& callback);
+
+  ~CommitLog();
+
+  // Appends a record for `write_ops` committed at `commit_timestamp`. Does
+  // nothing if `write_ops` is empty. The commit timestamp sentinels in
+  // `write_ops` must already be resolved, see ResolveCommitTimestamps.
+  absl::Status AppendWriteOps(absl::Time commit_timestamp,
+                              const std::vector<WriteOp>& write_ops);
+
+  // Appends a record for each of a group of transactions committed together,
+  // where `write_ops[i]` was committed at `commit_timestamps[i]`. The records
+  // are written in order by a single write, and transactions without write ops
+  // are skipped. Either all records are appended or the call fails.
+  absl::Status AppendWriteOpsGroup(
+      absl::Span<const absl::Time> commit_timestamps,
+      absl::Span<const std::vector<WriteOp>* const> write_ops);
+
+  // Appends a record for the DDL `statements` applied at `commit_timestamp`.
+  absl::Status AppendSchemaChange(absl::Time commit_timestamp,
+                                  absl::Span<const std::string> statements);
+
+  // Appends `record` to the log.
+  absl::Status Append(const CommitLogRecord& record);
+
+  // Appends `records` to the log, in order, as a single group.
+  absl::Status AppendRecords(absl::Span<const CommitLogRecord> records);
+
+ private:
+  CommitLog(const std::string& path, int fd, SyncPolicy sync_policy);
+
+  // Writes `data` to the log file and syncs it according to the sync policy.
+  absl::Status WriteAndSync(const std::string& data);
+
+  // Path of the log file.
+  const std::string path_;
+
+  // File descriptor of the log file, opened for appending.
+  const int fd_;
+
+  const SyncPolicy sync_policy_;
+
+  absl::Mutex mu_;
+
+  // Framed records waiting to be written by the next writer.
+  std::string pending_ ABSL_GUARDED_BY(mu_);
+
+  // Sequence number of the last record added to pending_.
+  int64_t last_appended_ ABSL_GUARDED_BY(mu_) = 0;
+
+  // Sequence number of the last record written to the log file.
+  int64_t last_written_ ABSL_GUARDED_BY(mu_) = 0;
+
+  // True while a caller is writing to the log file outside of mu_.
+  bool writing_ ABSL_GUARDED_BY(mu_) = false;
+
+  // The first write error. Once a write fails, the contents of the log file
+  // are unknown and all later appends fail.
+  absl::Status write_status_ ABSL_GUARDED_BY(mu_);
+
+  // Signalled when a writer finishes.
+  absl::CondVar write_done_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_COMMIT_LOG_H_
@@ -0,0 +1,220 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/transaction/commit_log.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "tests/common/proto_matchers.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "backend/transaction/commit_log.pb.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+class CommitLogTest : public testing::Test {
+ protected:
+  void SetUp() override { std::remove(path_.c_str()); }
+
+  // Returns all the complete records in the log.
+  std::vector<CommitLogRecord> ReplayAll() {
+    std::vector<CommitLogRecord> records;
+    ZETASQL_EXPECT_OK(CommitLog::Replay(path_, [&](const CommitLogRecord& record) {
+      records.push_back(record);
+      return absl::OkStatus();
+    }));
+    return records;
+  }
+
+  std::string path_ = testing::TempDir() + "/commit_log_test";
+};
+
+CommitLogRecord SchemaChangeRecord(const std::string& statement) {
+  CommitLogRecord record;
+  record.add_ddl_statements(statement);
+  return record;
+}
+
+TEST_F(CommitLogTest, ReplaysRecordsInAppendedOrder) {
+  CommitLogRecord first = SchemaChangeRecord("CREATE TABLE T1");
+  CommitLogRecord second = SchemaChangeRecord("CREATE TABLE T2");
+  {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<CommitLog> commit_log,
+        CommitLog::Open(path_, CommitLog::SyncPolicy::kAlways));
+    ZETASQL_ASSERT_OK(commit_log->Append(first));
+    ZETASQL_ASSERT_OK(commit_log->Append(second));
+  }
+
+  std::vector<CommitLogRecord> records = ReplayAll();
+  ASSERT_EQ(records.size(), 2);
+  EXPECT_THAT(records[0], test::EqualsProto(first));
+  EXPECT_THAT(records[1], test::EqualsProto(second));
+}
+
+TEST_F(CommitLogTest, ReopenedLogAppendsAfterExistingRecords) {
+  for (int i = 0; i < 2; ++i) {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<CommitLog> commit_log,
+        CommitLog::Open(path_, CommitLog::SyncPolicy::kNone));
+    ZETASQL_ASSERT_OK(commit_log->Append(SchemaChangeRecord(absl::StrCat(i))));
+  }
+
+  std::vector<CommitLogRecord> records = ReplayAll();
+  ASSERT_EQ(records.size(), 2);
+  EXPECT_EQ(records[0].ddl_statements(0), "0");
+  EXPECT_EQ(records[1].ddl_statements(0), "1");
+}
+
+TEST_F(CommitLogTest, MissingLogHasNoRecords) {
+  EXPECT_TRUE(ReplayAll().empty());
+}
+
+TEST_F(CommitLogTest, PartiallyWrittenRecordIsIgnoredAndTruncated) {
+  {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<CommitLog> commit_log,
+        CommitLog::Open(path_, CommitLog::SyncPolicy::kNone));
+    ZETASQL_ASSERT_OK(commit_log->Append(SchemaChangeRecord("complete")));
+  }
+  {
+    // Simulate a crash in the middle of writing a record.
+    std::ofstream file(path_, std::ios::binary | std::ios::app);
+    file.write("\x40\0\0\0\0\0\0\0partial", 15);
+  }
+  EXPECT_EQ(ReplayAll().size(), 1);
+
+  {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<CommitLog> commit_log,
+        CommitLog::Open(path_, CommitLog::SyncPolicy::kNone));
+    ZETASQL_ASSERT_OK(commit_log->Append(SchemaChangeRecord("after")));
+  }
+  std::vector<CommitLogRecord> records = ReplayAll();
+  ASSERT_EQ(records.size(), 2);
+  EXPECT_EQ(records[0].ddl_statements(0), "complete");
+  EXPECT_EQ(records[1].ddl_statements(0), "after");
+}
+
+TEST_F(CommitLogTest, ReplayStopsAtCallbackError) {
+  {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<CommitLog> commit_log,
+        CommitLog::Open(path_, CommitLog::SyncPolicy::kNone));
+    ZETASQL_ASSERT_OK(commit_log->Append(SchemaChangeRecord("first")));
+    ZETASQL_ASSERT_OK(commit_log->Append(SchemaChangeRecord("second")));
+  }
+
+  int num_records = 0;
+  EXPECT_THAT(CommitLog::Replay(path_,
+                                [&](const CommitLogRecord& record) {
+                                  ++num_records;
+                                  return absl::InternalError("replay failed");
+                                }),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kInternal));
+  EXPECT_EQ(num_records, 1);
+}
+
+TEST_F(CommitLogTest, ReplayFromTailsRecordsAppendedSince) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<CommitLog> commit_log,
+      CommitLog::Open(path_, CommitLog::SyncPolicy::kNone));
+  int64_t offset = 0;
+  std::vector<std::string> statements;
+  auto tail = [&]() {
+    return CommitLog::ReplayFrom(path_, &offset,
+                                 [&](const CommitLogRecord& record) {
+                                   statements.push_back(
+                                       record.ddl_statements(0));
+                                   return absl::OkStatus();
+                                 });
+  };
+
+  ZETASQL_ASSERT_OK(commit_log->Append(SchemaChangeRecord("first")));
+  ZETASQL_ASSERT_OK(tail());
+  EXPECT_THAT(statements, testing::ElementsAre("first"));
+
+  // Only the records appended since are replayed, once they are complete.
+  {
+    std::ofstream file(path_, std::ios::binary | std::ios::app);
+    file.write("\x40\0\0", 3);
+  }
+  const int64_t complete_offset = offset;
+  ZETASQL_ASSERT_OK(tail());
+  EXPECT_EQ(offset, complete_offset);
+  EXPECT_THAT(statements, testing::ElementsAre("first"));
+
+  commit_log.reset();
+  ZETASQL_ASSERT_OK_AND_ASSIGN(commit_log,
+                       CommitLog::Open(path_, CommitLog::SyncPolicy::kNone));
+  ZETASQL_ASSERT_OK(commit_log->Append(SchemaChangeRecord("second")));
+  ZETASQL_ASSERT_OK(tail());
+  EXPECT_THAT(statements, testing::ElementsAre("first", "second"));
+}
+
+TEST_F(CommitLogTest, ConcurrentAppendsAreAllWritten) {
+  constexpr int kNumThreads = 8;
+  constexpr int kAppendsPerThread = 50;
+  {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<CommitLog> commit_log,
+        CommitLog::Open(path_, CommitLog::SyncPolicy::kAlways));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kNumThreads; ++t) {
+      threads.emplace_back([&, t]() {
+        for (int i = 0; i < kAppendsPerThread; ++i) {
+          ZETASQL_EXPECT_OK(commit_log->Append(
+              SchemaChangeRecord(absl::StrCat(t, ":", i))));
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+  }
+
+  // Records of each thread are written in the order it appended them.
+  std::vector<int> next_append(kNumThreads, 0);
+  std::vector<CommitLogRecord> records = ReplayAll();
+  ASSERT_EQ(records.size(), kNumThreads * kAppendsPerThread);
+  for (const CommitLogRecord& record : records) {
+    std::vector<std::string> parts =
+        absl::StrSplit(record.ddl_statements(0), ':');
+    int t = std::stoi(parts[0]);
+    EXPECT_EQ(std::stoi(parts[1]), next_append[t]++);
+  }
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
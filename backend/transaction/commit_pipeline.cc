@@ -0,0 +1,196 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/transaction/commit_pipeline.h"
+
+#include <utility>
+#include <vector>
+
+#include "zetasql/base/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "backend/actions/ops.h"
+#include "backend/locking/handle.h"
+#include "backend/locking/manager.h"
+#include "backend/storage/storage.h"
+#include "backend/transaction/change_stream.h"
+#include "backend/transaction/commit_log.h"
+#include "backend/transaction/commit_timestamp.h"
+#include "backend/transaction/flush.h"
+#include "backend/transaction/read_set.h"
+#include "common/errors.h"
+#include "common/metrics.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+CommitPipeline::CommitPipeline(LockManager* lock_manager, Storage* storage,
+                               CommitLog* commit_log,
+                               ChangeStream* change_stream)
+    : lock_manager_(lock_manager),
+      storage_(storage),
+      commit_log_(commit_log),
+      change_stream_(change_stream) {}
+
+zetasql_base::StatusOr<absl::Time> CommitPipeline::Commit(
+    LockHandle* lock_handle, std::vector<WriteOp> write_ops,
+    std::vector<CommitTimestampSlot> commit_timestamp_slots,
+    const ReadSet* read_set) {
+  Request request{lock_handle, std::move(write_ops),
+                  std::move(commit_timestamp_slots), read_set};
+
+  absl::MutexLock lock(&mu_);
+  queue_.push_back(&request);
+  while (!request.done) {
+    if (committing_) {
+      group_done_.Wait(&mu_);
+      continue;
+    }
+    // Become the committer of all the queued requests, including this one.
+    committing_ = true;
+    std::vector<Request*> group;
+    group.swap(queue_);
+    mu_.Unlock();
+    CommitGroup(group);
+    mu_.Lock();
+    for (Request* member : group) {
+      member->done = true;
+    }
+    committing_ = false;
+    group_done_.SignalAll();
+  }
+  return request.result;
+}
+
+std::vector<CommitPipeline::Request*> CommitPipeline::ValidateReads(
+    absl::Span<Request* const> group) {
+  std::vector<Request*> validated;
+  validated.reserve(group.size());
+  int num_unvalidated = 0;
+  for (Request* request : group) {
+    if (request->read_set != nullptr) {
+      ++num_unvalidated;
+    }
+  }
+  // The writes of a transaction committing ahead of an optimistic one in the
+  // group are not flushed yet, so they are checked separately.
+  WrittenRows written;
+  for (Request* request : group) {
+    if (request->read_set != nullptr) {
+      --num_unvalidated;
+      zetasql_base::StatusOr<bool> conflicts =
+          request->read_set->Conflicts(*storage_, written);
+      if (!conflicts.ok()) {
+        request->result = conflicts.status();
+        continue;
+      }
+      if (conflicts.ValueOrDie()) {
+        request->result =
+            error::AbortDueToConflictingReads(request->lock_handle->tid());
+        continue;
+      }
+    }
+    if (num_unvalidated > 0) {
+      written.Add(request->write_ops);
+    }
+    validated.push_back(request);
+  }
+  return validated;
+}
+
+void CommitPipeline::CommitGroup(absl::Span<Request* const> requests) {
+  static metrics::Counter* const groups_counter = metrics::GetCounter(
+      "spanner_emulator_commit_groups_total",
+      "Number of groups of read-write transactions committed together.");
+  static metrics::Counter* const grouped_commits_counter = metrics::GetCounter(
+      "spanner_emulator_grouped_commits_total",
+      "Number of read-write transactions committed as part of a group.");
+  groups_counter->Increment();
+  grouped_commits_counter->Increment(requests.size());
+
+  const std::vector<Request*> group = ValidateReads(requests);
+  if (group.empty()) {
+    return;
+  }
+
+  std::vector<LockHandle*> handles;
+  handles.reserve(group.size());
+  for (Request* request : group) {
+    handles.push_back(request->lock_handle);
+  }
+  std::vector<zetasql_base::StatusOr<absl::Time>> commit_timestamps =
+      lock_manager_->ReserveCommitTimestamps(handles);
+
+  // Only the transactions which reserved a commit timestamp are committed.
+  std::vector<Request*> committing;
+  std::vector<LockHandle*> committing_handles;
+  std::vector<absl::Time> timestamps;
+  std::vector<const std::vector<WriteOp>*> write_ops;
+  for (int i = 0; i < group.size(); ++i) {
+    group[i]->result = commit_timestamps[i];
+    if (!commit_timestamps[i].ok()) {
+      continue;
+    }
+    committing.push_back(group[i]);
+    committing_handles.push_back(handles[i]);
+    timestamps.push_back(commit_timestamps[i].ValueOrDie());
+    ResolveCommitTimestamps(group[i]->commit_timestamp_slots, timestamps.back(),
+                            &group[i]->write_ops);
+    write_ops.push_back(&group[i]->write_ops);
+  }
+  if (committing.empty()) {
+    return;
+  }
+
+  // Nothing is flushed unless all the records of the group were logged.
+  std::vector<absl::Status> flush_statuses(committing.size());
+  if (commit_log_ != nullptr) {
+    absl::Status log_status =
+        commit_log_->AppendWriteOpsGroup(timestamps, write_ops);
+    if (!log_status.ok()) {
+      flush_statuses.assign(committing.size(), log_status);
+    }
+  }
+  for (int i = 0; i < committing.size(); ++i) {
+    if (flush_statuses[i].ok()) {
+      flush_statuses[i] =
+          FlushWriteOpsToStorage(*write_ops[i], storage_, timestamps[i]);
+    }
+    if (flush_statuses[i].ok() && change_stream_ != nullptr) {
+      change_stream_->Append(timestamps[i], *write_ops[i]);
+    }
+  }
+
+  std::vector<absl::Status> mark_statuses =
+      lock_manager_->MarkCommitted(committing_handles);
+  for (int i = 0; i < committing.size(); ++i) {
+    if (!mark_statuses[i].ok()) {
+      committing[i]->result = mark_statuses[i];
+    } else if (!flush_statuses[i].ok()) {
+      committing[i]->result = flush_statuses[i];
+    }
+  }
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,128 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_COMMIT_PIPELINE_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_COMMIT_PIPELINE_H_
+
+#include <vector>
+
+#include "zetasql/base/statusor.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "backend/actions/ops.h"
+#include "backend/locking/handle.h"
+#include "backend/locking/manager.h"
+#include "backend/storage/storage.h"
+#include "backend/transaction/change_stream.h"
+#include "backend/transaction/commit_log.h"
+#include "backend/transaction/commit_timestamp.h"
+#include "backend/transaction/read_set.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// CommitPipeline group commits the read-write transactions of a database.
+//
+// A transaction which is ready to commit holds exclusive locks on all the rows
+// it writes, so the transactions committing at the same time are independent
+// of each other. While one caller commits a group of transactions, the
+// transactions arriving in the meantime queue up, and the first of them to
+// find the pipeline idle commits them all as the next group:
+// - their commit timestamps are reserved under a single acquisition of the
+//   lock manager's mutex, so they are consecutive,
+// - their commit log records are written (and synced) together,
+// - their writes are flushed to storage in commit timestamp order, and
+// - they are marked committed together, waking up waiting reads once.
+// The fixed costs of a commit are so paid once per group, and commit
+// throughput grows with the number of concurrent committers.
+//
+// The reads of optimistic transactions, which are not locked, are validated
+// before the group reserves its commit timestamps: against storage, to which
+// all earlier groups are flushed, and against the writes of the transactions
+// ahead of them in the group. Groups are committed one at a time, so no commit
+// can come between the validation and the commit. Transactions whose reads
+// conflict are aborted without reserving a commit timestamp.
+//
+// This class is thread-safe.
+class CommitPipeline {
+ public:
+  // The pipeline does not take ownership of its arguments. `commit_log` and
+  // `change_stream` may be null. The changes of each transaction are appended
+  // to `change_stream` once they are flushed to storage.
+  CommitPipeline(LockManager* lock_manager, Storage* storage,
+                 CommitLog* commit_log, ChangeStream* change_stream = nullptr);
+
+  // Commits `write_ops` for the transaction owning `lock_handle` and returns
+  // its commit timestamp, once the group it was committed with is complete.
+  // The commit timestamp sentinels at `commit_timestamp_slots` are resolved to
+  // the commit timestamp. An optimistic transaction passes the `read_set` of
+  // its reads, and is aborted if any of the rows it read changed since.
+  // If no commit timestamp could be reserved (e.g. the transaction was
+  // aborted), returns that error. Otherwise the transaction is marked
+  // committed even if its writes could not be logged or flushed, in which case
+  // that error is returned.
+  zetasql_base::StatusOr<absl::Time> Commit(
+      LockHandle* lock_handle, std::vector<WriteOp> write_ops,
+      std::vector<CommitTimestampSlot> commit_timestamp_slots = {},
+      const ReadSet* read_set = nullptr) ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  // A transaction waiting to be committed.
+  struct Request {
+    LockHandle* lock_handle;
+    std::vector<WriteOp> write_ops;
+    std::vector<CommitTimestampSlot> commit_timestamp_slots;
+    const ReadSet* read_set;
+    zetasql_base::StatusOr<absl::Time> result;
+    bool done = false;
+  };
+
+  // Commits a group of requests, setting their results.
+  void CommitGroup(absl::Span<Request* const> requests)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the requests of `group` which are not aborted by validating their
+  // reads, setting the results of the others.
+  std::vector<Request*> ValidateReads(absl::Span<Request* const> group);
+
+  LockManager* const lock_manager_;
+  Storage* const storage_;
+  CommitLog* const commit_log_;
+  ChangeStream* const change_stream_;
+
+  absl::Mutex mu_;
+
+  // Requests waiting for the next group.
+  std::vector<Request*> queue_ ABSL_GUARDED_BY(mu_);
+
+  // True while a caller is committing a group outside of mu_.
+  bool committing_ ABSL_GUARDED_BY(mu_) = false;
+
+  // Signalled when a group is committed.
+  absl::CondVar group_done_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_COMMIT_PIPELINE_H_
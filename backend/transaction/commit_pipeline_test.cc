@@ -0,0 +1,201 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "backend/transaction/commit_pipeline.h"
+
+#include <algorithm>
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "backend/actions/ops.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/locking/manager.h"
+#include "backend/storage/in_memory_storage.h"
+#include "backend/transaction/read_set.h"
+#include "common/clock.h"
+#include "tests/common/schema_constructor.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql::values::Int64;
+using zetasql::values::String;
+using zetasql_base::testing::StatusIs;
+
+class CommitPipelineTest : public testing::Test {
+ public:
+  CommitPipelineTest()
+      : type_factory_(absl::make_unique<zetasql::TypeFactory>()),
+        schema_(test::CreateSchemaFromDDL(
+                    {
+                        R"(
+                          CREATE TABLE TestTable (
+                            Int64Col    INT64 NOT NULL,
+                            StringCol   STRING(MAX),
+                          ) PRIMARY KEY (Int64Col)
+                        )"},
+                    type_factory_.get())
+                    .ValueOrDie()),
+        table_(schema_->FindTable("TestTable")),
+        int64_col_(table_->FindColumn("Int64Col")),
+        string_col_(table_->FindColumn("StringCol")) {}
+
+ protected:
+  Clock clock_;
+  LockManager lock_manager_ =
+      LockManager(&clock_, /*lock_wait_timeout=*/absl::ZeroDuration());
+  InMemoryStorage storage_;
+  CommitPipeline pipeline_ = CommitPipeline(&lock_manager_, &storage_,
+                                            /*commit_log=*/nullptr);
+
+  // The type factory must outlive the type objects that it has made.
+  std::unique_ptr<zetasql::TypeFactory> type_factory_;
+  std::unique_ptr<const Schema> schema_;
+
+  // Constants
+  const Table* table_;
+  const Column* int64_col_;
+  const Column* string_col_;
+
+  // Helper functions to use in tests.
+  std::vector<WriteOp> InsertRow(int64_t key) {
+    return {InsertOp{table_,
+                     Key({Int64(key)}),
+                     {int64_col_, string_col_},
+                     {Int64(key), String("value")}}};
+  }
+
+  zetasql_base::StatusOr<int> CountRows(absl::Time timestamp) {
+    std::unique_ptr<StorageIterator> itr;
+    ZETASQL_RETURN_IF_ERROR(storage_.Read(timestamp, table_->id(), KeyRange::All(),
+                                  {int64_col_->id()}, &itr));
+    int num_rows = 0;
+    while (itr->Next()) {
+      ++num_rows;
+    }
+    return num_rows;
+  }
+};
+
+TEST_F(CommitPipelineTest, CommitsWriteOpsAtReservedTimestamp) {
+  std::unique_ptr<LockHandle> lh =
+      lock_manager_.CreateHandle(TransactionID(1), TransactionPriority(1));
+  absl::Time before = clock_.Now();
+  ZETASQL_ASSERT_OK_AND_ASSIGN(absl::Time commit_timestamp,
+                       pipeline_.Commit(lh.get(), InsertRow(1)));
+  EXPECT_GT(commit_timestamp, before);
+
+  EXPECT_THAT(CountRows(commit_timestamp - absl::Microseconds(1)),
+              zetasql_base::testing::IsOkAndHolds(0));
+  EXPECT_THAT(CountRows(commit_timestamp),
+              zetasql_base::testing::IsOkAndHolds(1));
+}
+
+TEST_F(CommitPipelineTest, ConcurrentCommitsGetDistinctTimestamps) {
+  constexpr int kNumTransactions = 16;
+  absl::Mutex mu;
+  std::vector<absl::Time> commit_timestamps;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumTransactions; ++i) {
+    threads.emplace_back([&, i]() {
+      std::unique_ptr<LockHandle> lh = lock_manager_.CreateHandle(
+          TransactionID(i + 1), TransactionPriority(1));
+      zetasql_base::StatusOr<absl::Time> commit_timestamp =
+          pipeline_.Commit(lh.get(), InsertRow(i));
+      ZETASQL_EXPECT_OK(commit_timestamp.status());
+      lh->UnlockAll();
+      if (commit_timestamp.ok()) {
+        absl::MutexLock lock(&mu);
+        commit_timestamps.push_back(commit_timestamp.ValueOrDie());
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(commit_timestamps.size(), kNumTransactions);
+  std::sort(commit_timestamps.begin(), commit_timestamps.end());
+  EXPECT_EQ(std::adjacent_find(commit_timestamps.begin(),
+                               commit_timestamps.end()),
+            commit_timestamps.end());
+  EXPECT_THAT(CountRows(commit_timestamps.back()),
+              zetasql_base::testing::IsOkAndHolds(kNumTransactions));
+}
+
+TEST_F(CommitPipelineTest, AbortedTransactionIsNotCommitted) {
+  std::unique_ptr<LockHandle> lh1 =
+      lock_manager_.CreateHandle(TransactionID(1), TransactionPriority(1));
+  std::unique_ptr<LockHandle> lh2 =
+      lock_manager_.CreateHandle(TransactionID(2), TransactionPriority(1));
+  LockRequest request(LockMode::kExclusive, "TestTable", KeyRange::All(), {});
+  lh1->EnqueueLock(request);
+  ZETASQL_ASSERT_OK(lh1->Wait());
+  lh2->EnqueueLock(request);
+  ASSERT_TRUE(lh2->IsAborted());
+
+  EXPECT_THAT(pipeline_.Commit(lh2.get(), InsertRow(2)),
+              StatusIs(absl::StatusCode::kAborted));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(absl::Time commit_timestamp,
+                       pipeline_.Commit(lh1.get(), InsertRow(1)));
+  EXPECT_THAT(CountRows(commit_timestamp),
+              zetasql_base::testing::IsOkAndHolds(1));
+}
+
+TEST_F(CommitPipelineTest, ValidatesReadsOfOptimisticTransactions) {
+  std::unique_ptr<LockHandle> lh1 =
+      lock_manager_.CreateHandle(TransactionID(1), TransactionPriority(1));
+  std::unique_ptr<LockHandle> lh2 =
+      lock_manager_.CreateHandle(TransactionID(2), TransactionPriority(1));
+  std::unique_ptr<LockHandle> lh3 =
+      lock_manager_.CreateHandle(TransactionID(3), TransactionPriority(1));
+
+  // Both optimistic transactions read row 1 before it is inserted, and only
+  // the first of them reads it again afterwards.
+  ReadSet stale_read;
+  stale_read.Add(table_->id(), KeyRange::Point(Key({Int64(1)})),
+                 clock_.Now());
+  ZETASQL_ASSERT_OK_AND_ASSIGN(absl::Time commit_timestamp,
+                       pipeline_.Commit(lh1.get(), InsertRow(1)));
+  ReadSet fresh_read;
+  fresh_read.Add(table_->id(), KeyRange::Point(Key({Int64(1)})),
+                 commit_timestamp);
+
+  EXPECT_THAT(pipeline_.Commit(lh2.get(), InsertRow(2), {}, &stale_read),
+              StatusIs(absl::StatusCode::kAborted));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(commit_timestamp, pipeline_.Commit(lh3.get(),
+                                                          InsertRow(3), {},
+                                                          &fresh_read));
+  EXPECT_THAT(CountRows(commit_timestamp),
+              zetasql_base::testing::IsOkAndHolds(2));
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
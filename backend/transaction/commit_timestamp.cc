@@ -17,8 +17,13 @@
 #include "backend/transaction/commit_timestamp.h"
 
 #include <queue>
+#include <vector>
 
 #include "zetasql/base/statusor.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "backend/actions/ops.h"
+#include "backend/common/variant.h"
 #include "backend/schema/catalog/column.h"
 #include "backend/schema/catalog/table.h"
 #include "common/constants.h"
@@ -124,6 +129,30 @@ zetasql_base::StatusOr<Key> MaybeSetCommitTimestampSentinel(
   return key;
 }
 
+// Appends the locations of the commit timestamp sentinels among the values
+// written by an insert or update to `slots`.
+void FindCommitTimestampValues(const std::vector<const Column*>& columns,
+                               const std::vector<zetasql::Value>& values,
+                               int op_index,
+                               std::vector<CommitTimestampSlot>* slots) {
+  for (int i = 0; i < columns.size(); i++) {
+    if (IsPendingCommitTimestamp(columns[i], values[i])) {
+      slots->push_back(CommitTimestampSlot{op_index, /*in_key=*/false, i});
+    }
+  }
+}
+
+// Replaces the commit timestamp sentinel at `slot` in an insert or update.
+template <typename Op>
+void ResolveSlot(const CommitTimestampSlot& slot,
+                 const zetasql::Value& timestamp, Op* op) {
+  if (slot.in_key) {
+    op->key.SetColumnValue(slot.index, timestamp);
+  } else {
+    op->values[slot.index] = timestamp;
+  }
+}
+
 }  // namespace
 
 absl::Status ValidateCommitTimestampValueNotInFuture(
@@ -160,6 +189,7 @@ zetasql_base::StatusOr<ValueList> MaybeSetCommitTimestampSentinel(
     absl::Span<const Column* const> columns, const ValueList& row) {
   if (row.empty()) return row;
   ValueList ret_val;
+  ret_val.reserve(row.size());
   for (int i = 0; i < row.size(); i++) {
     ZETASQL_ASSIGN_OR_RETURN(ret_val.emplace_back(),
                      MaybeSetCommitTimestampSentinel(columns[i], row[i]));
@@ -206,23 +236,44 @@ bool HasPendingCommitTimestampInKey(const Table* table, const Key& key) {
   return false;
 }
 
-zetasql::Value MaybeSetCommitTimestamp(const Column* column,
-                                         const zetasql::Value& column_value,
-                                         absl::Time commit_timestamp) {
-  if (IsPendingCommitTimestamp(column, column_value)) {
-    return zetasql::values::Timestamp(commit_timestamp);
+void FindCommitTimestampSlots(const WriteOp& op, int op_index,
+                              std::vector<CommitTimestampSlot>* slots) {
+  const Table* table = TableOf(op);
+  const Key& key = KeyOf(op);
+  for (int i = 0; i < key.NumColumns(); i++) {
+    if (IsPendingCommitTimestamp(table->primary_key()[i]->column(),
+                                 key.ColumnValue(i))) {
+      slots->push_back(CommitTimestampSlot{op_index, /*in_key=*/true, i});
+    }
   }
-  return column_value;
+  std::visit(
+      overloaded{
+          [&](const InsertOp& op) {
+            FindCommitTimestampValues(op.columns, op.values, op_index, slots);
+          },
+          [&](const UpdateOp& op) {
+            FindCommitTimestampValues(op.columns, op.values, op_index, slots);
+          },
+          [&](const DeleteOp& op) {},
+      },
+      op);
 }
 
-Key MaybeSetCommitTimestamp(absl::Span<const KeyColumn* const> primary_key,
-                            Key key, absl::Time commit_timestamp) {
-  for (int i = 0; i < key.NumColumns(); i++) {
-    key.SetColumnValue(
-        i, MaybeSetCommitTimestamp(primary_key[i]->column(), key.ColumnValue(i),
-                                   commit_timestamp));
+void ResolveCommitTimestamps(absl::Span<const CommitTimestampSlot> slots,
+                             absl::Time commit_timestamp,
+                             std::vector<WriteOp>* write_ops) {
+  const zetasql::Value timestamp =
+      zetasql::values::Timestamp(commit_timestamp);
+  for (const CommitTimestampSlot& slot : slots) {
+    std::visit(overloaded{
+                   [&](InsertOp& op) { ResolveSlot(slot, timestamp, &op); },
+                   [&](UpdateOp& op) { ResolveSlot(slot, timestamp, &op); },
+                   [&](DeleteOp& op) {
+                     op.key.SetColumnValue(slot.index, timestamp);
+                   },
+               },
+               (*write_ops)[slot.op_index]);
   }
-  return key;
 }
 
 }  // namespace backend
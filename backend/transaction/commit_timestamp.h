@@ -17,7 +17,12 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_COMMIT_TIMESTAMP_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_COMMIT_TIMESTAMP_H_
 
+#include <vector>
+
 #include "zetasql/public/type.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "backend/actions/ops.h"
 #include "backend/datamodel/key_set.h"
 #include "backend/datamodel/value.h"
 #include "backend/schema/catalog/column.h"
@@ -54,16 +59,30 @@ bool IsPendingCommitTimestamp(const Column* column,
 // Returns true if given key contains key part with timestamp sentinel value.
 bool HasPendingCommitTimestampInKey(const Table* table, const Key& key);
 
-// Replace commit timestamp sentinel value, if present, with transaction
-// commit timestamp for the given column value.
-zetasql::Value MaybeSetCommitTimestamp(const Column* column,
-                                         const zetasql::Value& column_value,
-                                         absl::Time commit_timestamp);
+// Location of a commit timestamp sentinel within a list of write ops.
+struct CommitTimestampSlot {
+  // Index of the write op holding the sentinel.
+  int op_index;
+
+  // True if the sentinel is a key column value, false if it is one of the
+  // values written by an insert or update.
+  bool in_key;
+
+  // Index of the sentinel within the key column values or the written values.
+  int index;
+};
+
+// Appends the locations of the commit timestamp sentinels in `op`, which is at
+// `op_index` within its list of write ops, to `slots`.
+void FindCommitTimestampSlots(const WriteOp& op, int op_index,
+                              std::vector<CommitTimestampSlot>* slots);
 
-// Replace commit timestamp sentinel value, if present, with transaction
-// commit timestamp for the given key column values.
-Key MaybeSetCommitTimestamp(absl::Span<const KeyColumn* const> primary_key,
-                            Key key, absl::Time commit_timestamp);
+// Replaces the commit timestamp sentinels at `slots` within `write_ops` with
+// the transaction commit timestamp. Only the sentinels are visited, so the
+// cost does not depend on the number of write ops without any.
+void ResolveCommitTimestamps(absl::Span<const CommitTimestampSlot> slots,
+                             absl::Time commit_timestamp,
+                             std::vector<WriteOp>* write_ops);
 
 }  // namespace backend
 }  // namespace emulator
@@ -20,6 +20,11 @@
 #include "gtest/gtest.h"
 #include "zetasql/base/testing/status_matchers.h"
 #include "tests/common/proto_matchers.h"
+#include "zetasql/public/value.h"
+#include "absl/time/time.h"
+#include "backend/actions/ops.h"
+#include "common/constants.h"
+#include "tests/common/schema_constructor.h"
 
 namespace google {
 namespace spanner {
@@ -27,7 +32,84 @@ namespace emulator {
 namespace backend {
 namespace {
 
-// TODO : Fill in unit tests for commit timestamp helper functions.
+using zetasql::values::Int64;
+using zetasql::values::String;
+using zetasql::values::Timestamp;
+
+class CommitTimestampTest : public testing::Test {
+ public:
+  CommitTimestampTest()
+      : type_factory_(absl::make_unique<zetasql::TypeFactory>()),
+        schema_(test::CreateSchemaFromDDL(
+                    {
+                        R"(
+                          CREATE TABLE Events (
+                            Ts        TIMESTAMP NOT NULL
+                                OPTIONS (allow_commit_timestamp = true),
+                            Id        INT64 NOT NULL,
+                            Value     STRING(MAX),
+                            UpdatedAt TIMESTAMP
+                                OPTIONS (allow_commit_timestamp = true),
+                          ) PRIMARY KEY (Ts, Id)
+                        )"},
+                    type_factory_.get())
+                    .ValueOrDie()),
+        table_(schema_->FindTable("Events")),
+        columns_({table_->FindColumn("Ts"), table_->FindColumn("Id"),
+                  table_->FindColumn("Value"),
+                  table_->FindColumn("UpdatedAt")}) {}
+
+ protected:
+  // The type factory must outlive the type objects that it has made.
+  std::unique_ptr<zetasql::TypeFactory> type_factory_;
+  std::unique_ptr<const Schema> schema_;
+
+  const Table* table_;
+  const std::vector<const Column*> columns_;
+};
+
+TEST_F(CommitTimestampTest, ResolvesOnlyTheSentinelSlots) {
+  const zetasql::Value sentinel = Timestamp(kCommitTimestampValueSentinel);
+  const absl::Time past = absl::FromUnixSeconds(1);
+  std::vector<WriteOp> write_ops = {
+      InsertOp{table_,
+               Key({sentinel, Int64(1)}),
+               columns_,
+               {sentinel, Int64(1), String("value"), sentinel}},
+      InsertOp{table_,
+               Key({Timestamp(past), Int64(2)}),
+               columns_,
+               {Timestamp(past), Int64(2), String("value"), Timestamp(past)}},
+      UpdateOp{table_,
+               Key({Timestamp(past), Int64(3)}),
+               {columns_[3]},
+               {sentinel}},
+  };
+
+  std::vector<CommitTimestampSlot> slots;
+  for (int i = 0; i < write_ops.size(); ++i) {
+    FindCommitTimestampSlots(write_ops[i], i, &slots);
+  }
+  ASSERT_EQ(slots.size(), 4);
+
+  const absl::Time commit_timestamp = absl::FromUnixSeconds(100);
+  ResolveCommitTimestamps(slots, commit_timestamp, &write_ops);
+
+  const InsertOp& insert_op = absl::get<InsertOp>(write_ops[0]);
+  EXPECT_EQ(insert_op.key, Key({Timestamp(commit_timestamp), Int64(1)}));
+  EXPECT_EQ(insert_op.values[0], Timestamp(commit_timestamp));
+  EXPECT_EQ(insert_op.values[3], Timestamp(commit_timestamp));
+  EXPECT_EQ(absl::get<InsertOp>(write_ops[1]).values[3], Timestamp(past));
+  EXPECT_EQ(absl::get<UpdateOp>(write_ops[2]).values[0],
+            Timestamp(commit_timestamp));
+
+  // Resolved ops no longer have pending commit timestamps.
+  slots.clear();
+  for (int i = 0; i < write_ops.size(); ++i) {
+    FindCommitTimestampSlots(write_ops[i], i, &slots);
+  }
+  EXPECT_TRUE(slots.empty());
+}
 
 }  // namespace
 }  // namespace backend
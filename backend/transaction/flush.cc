@@ -16,8 +16,21 @@
 
 #include "backend/transaction/flush.h"
 
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/variant.h"
+#include "backend/common/ids.h"
 #include "backend/common/variant.h"
-#include "backend/transaction/commit_timestamp.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/schema/catalog/table.h"
+#include "backend/storage/storage.h"
+#include "backend/transaction/commit_log.h"
+#include "common/metrics.h"
+#include "common/trace.h"
 
 namespace google {
 namespace spanner {
@@ -26,64 +39,137 @@ namespace backend {
 
 namespace {
 
-absl::Status FlushInsert(const InsertOp& insert_op, Storage* base_storage,
-                         absl::Time commit_timestamp) {
-  const Table* table = insert_op.table;
-  const Key key = MaybeSetCommitTimestamp(table->primary_key(), insert_op.key,
-                                          commit_timestamp);
-  std::vector<ColumnID> column_ids;
-  ValueList column_values;
-  for (int i = 0; i < insert_op.columns.size(); i++) {
-    column_ids.push_back(insert_op.columns[i]->id());
-    column_values.push_back(MaybeSetCommitTimestamp(
-        insert_op.columns[i], insert_op.values[i], commit_timestamp));
+// Returns the storage write of `values` to `columns` of the row at `key`.
+StorageWrite ColumnsWrite(const Key& key,
+                          const std::vector<const Column*>& columns,
+                          const std::vector<zetasql::Value>& values) {
+  StorageWrite write;
+  write.key = key;
+  write.column_ids.reserve(columns.size());
+  for (const Column* column : columns) {
+    write.column_ids.push_back(column->id());
   }
-  return base_storage->Write(commit_timestamp, table->id(), key, column_ids,
-                             column_values);
+  write.values = values;
+  return write;
 }
 
-absl::Status FlushUpdate(const UpdateOp& update_op, Storage* base_storage,
-                         absl::Time commit_timestamp) {
-  const Table* table = update_op.table;
-  const Key key = MaybeSetCommitTimestamp(table->primary_key(), update_op.key,
-                                          commit_timestamp);
-  std::vector<ColumnID> column_ids;
-  ValueList column_values;
-  for (int i = 0; i < update_op.columns.size(); i++) {
-    column_ids.push_back(update_op.columns[i]->id());
-    column_values.push_back(MaybeSetCommitTimestamp(
-        update_op.columns[i], update_op.values[i], commit_timestamp));
+// Returns true if a prefix delete of an ancestor of `table` covers the rows
+// of `table` with the given prefix.
+bool IsCoveredByAncestor(
+    const Table* table, const Key& prefix,
+    const absl::flat_hash_map<TableID, std::set<Key>>& prefix_deletes) {
+  // The data tables of indexes are not co-located with their parents.
+  if (!table->is_public()) {
+    return false;
+  }
+  for (const Table* ancestor = table->parent(); ancestor != nullptr;
+       ancestor = ancestor->parent()) {
+    auto itr = prefix_deletes.find(ancestor->id());
+    if (itr == prefix_deletes.end()) {
+      continue;
+    }
+    for (int i = 0; i <= prefix.NumColumns(); ++i) {
+      if (itr->second.count(prefix.Prefix(i)) > 0) {
+        return true;
+      }
+    }
   }
-  return base_storage->Write(commit_timestamp, table->id(), key, column_ids,
-                             column_values);
+  return false;
 }
 
-absl::Status FlushDelete(const DeleteOp& delete_op, Storage* base_storage,
-                         absl::Time commit_timestamp) {
-  return base_storage->Delete(commit_timestamp, delete_op.table->id(),
-                              KeyRange::Point(delete_op.key));
+// Returns the storage write for `delete_op`.
+StorageWrite DeleteWrite(const DeleteOp& delete_op) {
+  StorageWrite write;
+  write.key = delete_op.key;
+  write.is_delete = true;
+  return write;
 }
 
 }  // namespace
 
 absl::Status FlushWriteOpsToStorage(const std::vector<WriteOp>& write_ops,
                                     Storage* base_storage,
-                                    absl::Time commit_timestamp) {
+                                    absl::Time commit_timestamp,
+                                    CommitLog* commit_log) {
+  static metrics::Histogram* const commit_flush_latency =
+      metrics::StageLatency("commit_flush");
+  metrics::ScopedLatencyRecorder recorder(commit_flush_latency);
+  trace::ScopedSpan span("CommitFlush");
+  if (commit_log != nullptr) {
+    ZETASQL_RETURN_IF_ERROR(commit_log->AppendWriteOps(commit_timestamp, write_ops));
+  }
+  // Group the writes by table, so that each table is written in a single
+  // batch. Tables are written in the order they are first written to.
+  std::vector<const Table*> tables;
+  absl::flat_hash_map<TableID, std::vector<StorageWrite>> writes_by_table;
+  absl::flat_hash_map<TableID, std::set<Key>> prefix_deletes_by_table;
   for (const auto& write_op : write_ops) {
-    ZETASQL_RETURN_IF_ERROR(std::visit(
+    const TableID& table_id = TableOf(write_op)->id();
+    auto [itr, inserted] = writes_by_table.try_emplace(table_id);
+    if (inserted) {
+      tables.push_back(TableOf(write_op));
+    }
+    if (absl::holds_alternative<DeleteOp>(write_op) &&
+        IsPrefixDelete(absl::get<DeleteOp>(write_op))) {
+      prefix_deletes_by_table[table_id].insert(
+          absl::get<DeleteOp>(write_op).key);
+      continue;
+    }
+    itr->second.push_back(std::visit(
         overloaded{
             [&](const InsertOp& insert_op) {
-              return FlushInsert(insert_op, base_storage, commit_timestamp);
+              return ColumnsWrite(insert_op.key, insert_op.columns,
+                                  insert_op.values);
             },
             [&](const UpdateOp& update_op) {
-              return FlushUpdate(update_op, base_storage, commit_timestamp);
-            },
-            [&](const DeleteOp& delete_op) {
-              return FlushDelete(delete_op, base_storage, commit_timestamp);
+              return ColumnsWrite(update_op.key, update_op.columns,
+                                  update_op.values);
             },
+            [&](const DeleteOp& delete_op) { return DeleteWrite(delete_op); },
         },
         write_op));
   }
+
+  // Prefix deletes are applied as range deletes ahead of the other writes. The
+  // transaction store drops the writes buffered before a prefix delete to the
+  // rows it covers, so any remaining writes to these rows come after it.
+  //
+  // Prefix deletes come from cascading deletes, which apply to all the tables
+  // interleaved below the table deleted from. Storages which co-locate
+  // interleaved tables delete the rows of these tables along with those under
+  // the prefix in a single range, which leaves nothing for the prefix deletes
+  // of the descendants with the same prefix to do.
+  const bool delete_descendants = base_storage->ColocatesInterleavedTables();
+  for (const Table* table : tables) {
+    auto itr = prefix_deletes_by_table.find(table->id());
+    if (itr == prefix_deletes_by_table.end()) {
+      continue;
+    }
+    for (const Key& prefix : itr->second) {
+      if (!delete_descendants) {
+        ZETASQL_RETURN_IF_ERROR(base_storage->Delete(
+            commit_timestamp, table->id(), KeyRange::Prefix(prefix)));
+      } else if (!IsCoveredByAncestor(table, prefix,
+                                      prefix_deletes_by_table)) {
+        ZETASQL_RETURN_IF_ERROR(base_storage->DeleteWithDescendants(
+            commit_timestamp, table->id(), KeyRange::Prefix(prefix)));
+      }
+    }
+  }
+
+  for (const Table* table : tables) {
+    const TableID& table_id = table->id();
+    // Sorting by key lets storage apply the writes in a single pass over the
+    // table. The sort is stable so that writes to the same key keep their
+    // order.
+    std::vector<StorageWrite>& writes = writes_by_table[table_id];
+    std::stable_sort(writes.begin(), writes.end(),
+                     [](const StorageWrite& a, const StorageWrite& b) {
+                       return a.key < b.key;
+                     });
+    ZETASQL_RETURN_IF_ERROR(
+        base_storage->WriteBatch(commit_timestamp, table_id, writes));
+  }
   return absl::OkStatus();
 }
 
@@ -18,6 +18,7 @@
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_FLUSH_H_
 
 #include "backend/actions/ops.h"
+#include "backend/transaction/commit_log.h"
 
 namespace google {
 namespace spanner {
@@ -30,9 +31,16 @@ namespace backend {
 // Flushes each of the write ops to base storage at the given timestamp. Note
 // that calling this function isn't thread safe and appropriate database locks
 // should be acquired.
+//
+// The commit timestamp sentinels in `write_ops` must already be resolved to
+// `commit_timestamp`, see ResolveCommitTimestamps.
+//
+// If `commit_log` is not null, the write ops are appended to it before any of
+// them are written to storage, and nothing is written if that fails.
 absl::Status FlushWriteOpsToStorage(const std::vector<WriteOp>& write_ops,
                                     Storage* base_storage,
-                                    absl::Time commit_timestamp);
+                                    absl::Time commit_timestamp,
+                                    CommitLog* commit_log = nullptr);
 
 }  // namespace backend
 }  // namespace emulator
@@ -129,6 +129,51 @@ TEST_F(FlushTest, CanFlushWriteOpsToStorage) {
                                              {Int64(3), String("value")}}));
 }
 
+TEST_F(FlushTest, WriteOpsToSameKeyAreFlushedInOrder) {
+  absl::Time t0 = absl::Now();
+
+  // Ops on key 2 are interleaved with ops on other keys, out of key order.
+  InsertOp insert_op{table_,
+                     Key({Int64(2)}),
+                     {int64_col_, string_col_},
+                     {Int64(2), String("first")}};
+  InsertOp other_insert_op{table_,
+                           Key({Int64(1)}),
+                           {int64_col_, string_col_},
+                           {Int64(1), String("value")}};
+  DeleteOp delete_op{table_, Key({Int64(2)})};
+  InsertOp reinsert_op{table_,
+                       Key({Int64(2)}),
+                       {int64_col_, string_col_},
+                       {Int64(2), String("second")}};
+  UpdateOp update_op{table_, Key({Int64(1)}), {string_col_}, {String("new")}};
+
+  ZETASQL_ASSERT_OK(FlushWriteOpsToStorage(
+      {insert_op, other_insert_op, delete_op, reinsert_op, update_op},
+      storage_.get(), t0));
+
+  EXPECT_THAT(ReadAll(t0), IsOkAndHoldsRows({{Int64(1), String("new")},
+                                             {Int64(2), String("second")}}));
+}
+
+TEST_F(FlushTest, PrefixDeletesAreFlushedAsRangeDeletes) {
+  absl::Time t0 = absl::Now();
+  ZETASQL_ASSERT_OK(Write(t0, Key({Int64(1)}), {Int64(1), String("value")}));
+  ZETASQL_ASSERT_OK(Write(t0, Key({Int64(2)}), {Int64(2), String("value")}));
+
+  // The empty key prefix deletes every row, ahead of the later insert.
+  absl::Time t1 = t0 + absl::Seconds(1);
+  DeleteOp delete_op{table_, Key()};
+  InsertOp insert_op{table_,
+                     Key({Int64(2)}),
+                     {int64_col_, string_col_},
+                     {Int64(2), String("new")}};
+  ZETASQL_ASSERT_OK(
+      FlushWriteOpsToStorage({delete_op, insert_op}, storage_.get(), t1));
+
+  EXPECT_THAT(ReadAll(t1), IsOkAndHoldsRows({{Int64(2), String("new")}}));
+}
+
 }  // namespace
 }  // namespace backend
 }  // namespace emulator
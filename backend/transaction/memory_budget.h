@@ -0,0 +1,81 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_MEMORY_BUDGET_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_MEMORY_BUDGET_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "backend/storage/storage.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// MemoryBudget tracks the approximate memory held by a database: the rows of
+// its storage, including their older versions, and the mutations buffered by
+// its read-write transactions. Schemas are not accounted for.
+//
+// Transactions report changes in the size of their buffered mutations, and
+// check the budget before buffering inserts and updates, so that a database
+// which grows past its limit stops growing while its rows can still be
+// deleted.
+//
+// This class is thread safe.
+class MemoryBudget {
+ public:
+  // Creates a budget for the rows of `storage`, which must outlive it. A
+  // `limit_bytes` of 0 makes the budget unlimited.
+  MemoryBudget(const Storage* storage, int64_t limit_bytes)
+      : storage_(storage), limit_bytes_(limit_bytes) {}
+
+  // Adds `delta` bytes, which may be negative, to the buffered mutations.
+  void AddTransactionBytes(int64_t delta) {
+    transaction_bytes_.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+  // Returns the bytes held by mutations buffered in transactions.
+  int64_t transaction_bytes() const {
+    return transaction_bytes_.load(std::memory_order_relaxed);
+  }
+
+  // Returns the bytes held by the rows and the buffered mutations.
+  int64_t used_bytes() const {
+    return storage_->TotalBytes() + transaction_bytes();
+  }
+
+  // Returns the limit in bytes, or 0 if the budget is unlimited.
+  int64_t limit_bytes() const { return limit_bytes_; }
+
+  // Returns RESOURCE_EXHAUSTED if the database holds more memory than its
+  // limit.
+  absl::Status CheckWithinLimit() const;
+
+ private:
+  const Storage* storage_;
+  const int64_t limit_bytes_;
+  std::atomic<int64_t> transaction_bytes_ = 0;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_MEMORY_BUDGET_H_
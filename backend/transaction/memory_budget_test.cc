@@ -0,0 +1,70 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/transaction/memory_budget.h"
+
+#include "zetasql/public/value.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "tests/common/proto_matchers.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "backend/common/ids.h"
+#include "backend/datamodel/key.h"
+#include "backend/storage/in_memory_storage.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql::values::String;
+using zetasql_base::testing::StatusIs;
+
+TEST(MemoryBudgetTest, UnlimitedBudgetIsNeverExceeded) {
+  InMemoryStorage storage;
+  MemoryBudget budget(&storage, /*limit_bytes=*/0);
+  budget.AddTransactionBytes(1 << 30);
+  ZETASQL_EXPECT_OK(budget.CheckWithinLimit());
+}
+
+TEST(MemoryBudgetTest, AccountsForRowsAndBufferedMutations) {
+  InMemoryStorage storage;
+  MemoryBudget budget(&storage, /*limit_bytes=*/1000);
+  ZETASQL_EXPECT_OK(storage.Write(absl::Now(), "test_table",
+                          Key({String("key")}), {"test_column"},
+                          {String("value")}));
+  EXPECT_EQ(budget.used_bytes(), storage.TotalBytes());
+
+  budget.AddTransactionBytes(700);
+  EXPECT_EQ(budget.transaction_bytes(), 700);
+  EXPECT_EQ(budget.used_bytes(), storage.TotalBytes() + 700);
+
+  budget.AddTransactionBytes(1000);
+  EXPECT_THAT(budget.CheckWithinLimit(),
+              StatusIs(absl::StatusCode::kResourceExhausted));
+
+  budget.AddTransactionBytes(-1700);
+  ZETASQL_EXPECT_OK(budget.CheckWithinLimit());
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
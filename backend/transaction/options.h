@@ -66,8 +66,23 @@ struct RetryState {
   TransactionPriority priority = 0;
 };
 
+// Ways in which a read-write transaction is isolated from concurrent writes
+// to the rows it reads.
+enum class ConcurrencyMode {
+  // Reads lock the rows they read, so conflicting writers wait for the
+  // transaction or abort it.
+  kPessimistic,
+
+  // Reads take no locks. The rows read are recorded, and the transaction is
+  // aborted at commit if a transaction which committed after a read wrote any
+  // of them. Writes still lock the rows they write.
+  kOptimistic,
+};
+
 // Options for creating a read write transaction.
-struct ReadWriteOptions {};
+struct ReadWriteOptions {
+  ConcurrencyMode concurrency_mode = ConcurrencyMode::kPessimistic;
+};
 
 }  // namespace backend
 }  // namespace emulator
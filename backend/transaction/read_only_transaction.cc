@@ -16,7 +16,10 @@
 
 #include "backend/transaction/read_only_transaction.h"
 
+#include <algorithm>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "absl/random/random.h"
 #include "absl/status/status.h"
@@ -24,6 +27,8 @@
 #include "absl/time/time.h"
 #include "backend/access/read.h"
 #include "backend/common/ids.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
 #include "backend/datamodel/key_set.h"
 #include "backend/locking/manager.h"
 #include "backend/storage/in_memory_iterator.h"
@@ -32,7 +37,10 @@
 #include "backend/transaction/resolve.h"
 #include "backend/transaction/row_cursor.h"
 #include "common/clock.h"
+#include "common/config.h"
+#include "common/executor.h"
 #include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
 
 namespace google {
 namespace spanner {
@@ -41,38 +49,87 @@ namespace backend {
 
 namespace {
 
-absl::Duration kMaxStaleReadDuration = absl::Hours(1);
+// Minimum number of rows in each of the ranges into which a single key range
+// is split to be read in parallel. Smaller ranges are read by one thread.
+constexpr int64_t kMinRowsPerParallelRange = 16 * 1024;
+
+// Reads all the rows of `key_range` from storage.
+absl::Status ReadRange(Storage* storage, absl::Time read_timestamp,
+                       const TableID& table_id, const KeyRange& key_range,
+                       const std::vector<ColumnID>& column_ids,
+                       std::vector<FixedRowStorageIterator::Row>* rows) {
+  std::unique_ptr<StorageIterator> itr;
+  ZETASQL_RETURN_IF_ERROR(storage->Read(read_timestamp, table_id, key_range,
+                                column_ids, &itr));
+  while (itr->Next()) {
+    std::vector<zetasql::Value> values;
+    values.reserve(itr->NumColumns());
+    for (int i = 0; i < itr->NumColumns(); ++i) {
+      values.push_back(itr->ColumnValue(i));
+    }
+    rows->emplace_back(itr->Key(), std::move(values));
+  }
+  return itr->Status();
+}
 
 }  // namespace
 
 ReadOnlyTransaction::ReadOnlyTransaction(
     const ReadOnlyOptions& options, TransactionID transaction_id, Clock* clock,
     Storage* storage, LockManager* lock_manager,
-    const VersionedCatalog* const versioned_catalog)
+    const VersionedCatalog* const versioned_catalog, int read_parallelism)
     : options_(options),
       id_(transaction_id),
       clock_(clock),
       base_storage_(storage),
       versioned_catalog_(versioned_catalog),
-      lock_manager_(lock_manager) {
+      lock_manager_(lock_manager),
+      read_parallelism_(read_parallelism) {
   lock_handle_ = lock_manager_->CreateHandle(transaction_id, /*priority=*/1);
   read_timestamp_ = PickReadTimestamp();
 }
 
-absl::Status ReadOnlyTransaction::Read(const ReadArg& read_arg,
-                                       std::unique_ptr<RowCursor>* cursor) {
-  absl::MutexLock lock(&mu_);
+absl::Status ReadOnlyTransaction::WaitForSafeRead() {
   // Wait for any concurrent schema change or read-write transactions to commit
-  // before accessing database state to perform a read.
+  // before accessing database state to perform a read. This also registers the
+  // read timestamp with the lock manager, so versions visible to the read are
+  // not garbage collected once it passes the check below.
   lock_handle_->WaitForSafeRead(read_timestamp_);
-  if (clock_->Now() - read_timestamp_ >= kMaxStaleReadDuration) {
+  if (clock_->Now() - read_timestamp_ >= config::version_retention_period()) {
     return error::ReadTimestampPastVersionGCLimit(read_timestamp_);
   }
+  return absl::OkStatus();
+}
+
+absl::Status ReadOnlyTransaction::Read(const ReadArg& read_arg,
+                                       std::unique_ptr<RowCursor>* cursor) {
+  ZETASQL_RETURN_IF_ERROR(WaitForSafeRead());
 
   ZETASQL_ASSIGN_OR_RETURN(const ResolvedReadArg resolved_read_arg,
                    ResolveReadArg(read_arg, schema()));
 
   std::vector<std::unique_ptr<StorageIterator>> iterators;
+  // Batches of point keys (e.g. IN-list reads) are looked up together, since
+  // a storage read per key would search the table once for each of them.
+  std::vector<Key> point_keys;
+  if (resolved_read_arg.key_ranges.size() > 1 &&
+      GetPointLookupKeys(resolved_read_arg, &point_keys)) {
+    std::unique_ptr<StorageIterator> itr;
+    ZETASQL_RETURN_IF_ERROR(base_storage_->MultiLookup(
+        read_timestamp_, resolved_read_arg.table->id(), point_keys,
+        GetColumnIDs(resolved_read_arg.columns), &itr));
+    iterators.push_back(std::move(itr));
+    *cursor = absl::make_unique<StorageIteratorRowCursor>(
+        std::move(iterators), resolved_read_arg.columns);
+    return absl::OkStatus();
+  }
+  if (read_parallelism_ > 1) {
+    std::vector<KeyRange> ranges;
+    ZETASQL_RETURN_IF_ERROR(SplitKeyRanges(resolved_read_arg, &ranges));
+    if (ranges.size() > 1) {
+      return ReadInParallel(resolved_read_arg, ranges, cursor);
+    }
+  }
   for (const auto& key_range : resolved_read_arg.key_ranges) {
     std::unique_ptr<StorageIterator> itr;
     ZETASQL_RETURN_IF_ERROR(base_storage_->Read(
@@ -85,6 +142,91 @@ absl::Status ReadOnlyTransaction::Read(const ReadArg& read_arg,
   return absl::OkStatus();
 }
 
+absl::Status ReadOnlyTransaction::ReadInterleaved(
+    const ReadArg& parent_arg, const ReadArg& child_arg,
+    std::unique_ptr<RowCursor>* parent_cursor,
+    std::unique_ptr<RowCursor>* child_cursor) {
+  if (!base_storage_->ColocatesInterleavedTables() ||
+      !parent_arg.index.empty() || !child_arg.index.empty()) {
+    return RowReader::ReadInterleaved(parent_arg, child_arg, parent_cursor,
+                                      child_cursor);
+  }
+  ZETASQL_RETURN_IF_ERROR(WaitForSafeRead());
+
+  // The child rows read are those under the parent key ranges, so only the
+  // columns of the child read arg are used.
+  ZETASQL_ASSIGN_OR_RETURN(const ResolvedReadArg resolved_parent_arg,
+                   ResolveReadArg(parent_arg, schema()));
+  ZETASQL_ASSIGN_OR_RETURN(const ResolvedReadArg resolved_child_arg,
+                   ResolveReadArg(child_arg, schema()));
+  const std::vector<TableID> table_ids = {resolved_parent_arg.table->id(),
+                                          resolved_child_arg.table->id()};
+  const std::vector<std::vector<ColumnID>> column_ids = {
+      GetColumnIDs(resolved_parent_arg.columns),
+      GetColumnIDs(resolved_child_arg.columns)};
+  std::vector<std::unique_ptr<InterleavedStorageIterator>> iterators;
+  for (const KeyRange& key_range : resolved_parent_arg.key_ranges) {
+    std::unique_ptr<InterleavedStorageIterator> itr;
+    ZETASQL_RETURN_IF_ERROR(base_storage_->ReadInterleaved(
+        read_timestamp_, table_ids, key_range, column_ids, &itr));
+    iterators.push_back(std::move(itr));
+  }
+  std::vector<std::unique_ptr<RowCursor>> cursors = MakeInterleavedRowCursors(
+      std::move(iterators),
+      {resolved_parent_arg.columns, resolved_child_arg.columns});
+  *parent_cursor = std::move(cursors[0]);
+  *child_cursor = std::move(cursors[1]);
+  return absl::OkStatus();
+}
+
+absl::Status ReadOnlyTransaction::SplitKeyRanges(
+    const ResolvedReadArg& read_arg, std::vector<KeyRange>* ranges) const {
+  // The resolved key ranges are disjoint and sorted, so are the ranges they
+  // are split into.
+  std::vector<Key> split_keys;
+  for (const KeyRange& key_range : read_arg.key_ranges) {
+    ZETASQL_RETURN_IF_ERROR(base_storage_->SplitKeyRange(
+        read_arg.table->id(), key_range, read_parallelism_,
+        kMinRowsPerParallelRange, &split_keys));
+    Key range_start = key_range.start_key();
+    for (Key& split_key : split_keys) {
+      ranges->push_back(KeyRange::ClosedOpen(range_start, split_key));
+      range_start = std::move(split_key);
+    }
+    ranges->push_back(KeyRange::ClosedOpen(range_start, key_range.limit_key()));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ReadOnlyTransaction::ReadInParallel(
+    const ResolvedReadArg& read_arg, const std::vector<KeyRange>& ranges,
+    std::unique_ptr<RowCursor>* cursor) const {
+  const std::vector<ColumnID> column_ids = GetColumnIDs(read_arg.columns);
+  std::vector<std::vector<FixedRowStorageIterator::Row>> range_rows(
+      ranges.size());
+  TaskGroup group(Executor::Default(), TaskPriority::kInteractive,
+                  read_parallelism_);
+  for (int i = 0; i < ranges.size(); ++i) {
+    group.Schedule([&, i]() {
+      return ReadRange(base_storage_, read_timestamp_, read_arg.table->id(),
+                       ranges[i], column_ids, &range_rows[i]);
+    });
+  }
+
+  // Report the error of the earliest failing range, as a serial read of the
+  // ranges would, and otherwise return the rows of the ranges in key order.
+  ZETASQL_RETURN_IF_ERROR(group.Wait());
+  std::vector<std::unique_ptr<StorageIterator>> iterators;
+  iterators.reserve(range_rows.size());
+  for (std::vector<FixedRowStorageIterator::Row>& rows : range_rows) {
+    iterators.push_back(
+        absl::make_unique<FixedRowStorageIterator>(std::move(rows)));
+  }
+  *cursor = absl::make_unique<StorageIteratorRowCursor>(std::move(iterators),
+                                                        read_arg.columns);
+  return absl::OkStatus();
+}
+
 const Schema* ReadOnlyTransaction::schema() const {
   // Wait for any concurrent schema change or read-write transactions to commit
   // before accessing database state to read schemas in versioned_catalog.
@@ -95,21 +237,32 @@ const Schema* ReadOnlyTransaction::schema() const {
 absl::Time ReadOnlyTransaction::PickReadTimestamp() {
   auto get_random_stale_timestamp =
       [this](absl::Time min_timestamp) -> absl::Time {
+    // Bounded staleness reads should not wait for commits in progress,
+    // including a schema change, unless their bound requires it. Neither
+    // bound below acquires the lock manager's mutex.
+    absl::Time max_timestamp = lock_manager_->SafeReadTimestamp();
     // Any reads performed on or before last_commit_timestamp are guaranteed to
     // see a consistent snapshots of all the commits that have already finished.
-    // Thus, picked read timestamp need not be older than last_commit_timestamp.
-    absl::Time last_commit_timestamp = lock_manager_->LastCommitTimestamp();
+    // Thus, picked read timestamp need not be older than last_commit_timestamp,
+    // unless an older commit is still in progress.
+    absl::Time last_commit_timestamp =
+        std::min(lock_manager_->LastCommitTimestamp(), max_timestamp);
     if (min_timestamp < last_commit_timestamp) {
       min_timestamp = last_commit_timestamp;
     }
+    if (min_timestamp >= max_timestamp) {
+      return min_timestamp;
+    }
     absl::BitGen gen;
     int64_t random_staleness = absl::Uniform<int64_t>(
-        gen, 0, absl::ToInt64Microseconds(clock_->Now() - min_timestamp));
-    return clock_->Now() - absl::Microseconds(random_staleness);
+        gen, 0, absl::ToInt64Microseconds(max_timestamp - min_timestamp));
+    return max_timestamp - absl::Microseconds(random_staleness);
   };
   switch (options_.bound) {
     case TimestampBound::kStrongRead: {
-      read_timestamp_ = clock_->Now();
+      // Strong reads are served before a schema change in progress, if any,
+      // using the previous schema.
+      read_timestamp_ = lock_manager_->StrongReadTimestamp();
       break;
     }
     case TimestampBound::kExactTimestamp: {
@@ -117,11 +270,11 @@ absl::Time ReadOnlyTransaction::PickReadTimestamp() {
       break;
     }
     case TimestampBound::kExactStaleness: {
-      read_timestamp_ = clock_->Now() - options_.staleness;
+      read_timestamp_ = clock_->NowForRead() - options_.staleness;
       break;
     }
     case TimestampBound::kMinTimestamp: {
-      if (options_.timestamp >= clock_->Now()) {
+      if (options_.timestamp >= clock_->NowForRead()) {
         // If min timestamp bound is set in future, we want to wait until that
         // time arrives before returning a read result, thus set read_timestamp
         // to be same as the min timestamp provided.
@@ -137,7 +290,8 @@ absl::Time ReadOnlyTransaction::PickReadTimestamp() {
       // Randomly choose staleness to mimic production behavior of reading from
       // potentially lagging replicas. Bounded staleness cannot be negative.
       read_timestamp_ =
-          get_random_stale_timestamp(clock_->Now() - options_.staleness);
+          get_random_stale_timestamp(clock_->NowForRead() -
+                                     options_.staleness);
       break;
     }
   }
@@ -18,17 +18,18 @@
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_READ_ONLY_TRANSACTION_H_
 
 #include <memory>
+#include <vector>
 
-#include "absl/base/thread_annotations.h"
-#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "backend/access/read.h"
 #include "backend/access/write.h"
 #include "backend/common/ids.h"
+#include "backend/datamodel/key_range.h"
 #include "backend/locking/manager.h"
 #include "backend/schema/catalog/versioned_catalog.h"
 #include "backend/storage/storage.h"
 #include "backend/transaction/options.h"
+#include "backend/transaction/resolve.h"
 #include "backend/transaction/transaction_store.h"
 #include "common/clock.h"
 #include "common/errors.h"
@@ -44,16 +45,33 @@ namespace backend {
 // any locks.
 //
 // ReadOnlyTransaction cannot be committed, rolled-back, or be used to run DMLs.
+//
+// ReadOnlyTransaction is thread-safe: its read timestamp is fixed at creation,
+// so concurrent reads all see the same snapshot.
+//
+// If given a read parallelism above 1, reads of several key ranges, or of a
+// range holding many rows, are split into ranges of which up to that many are
+// read in parallel on the shared executor.
+// The rows of each range are buffered, and returned in key order once all of
+// them have been read.
 class ReadOnlyTransaction : public RowReader {
  public:
   ReadOnlyTransaction(const ReadOnlyOptions& options,
                       TransactionID transaction_id, Clock* clock,
                       Storage* storage, LockManager* lock_manager,
-                      const VersionedCatalog* const versioned_catalog);
+                      const VersionedCatalog* const versioned_catalog,
+                      int read_parallelism = 0);
 
   absl::Status Read(const ReadArg& read_arg,
-                    std::unique_ptr<RowCursor>* cursor) override
-      ABSL_LOCKS_EXCLUDED(mu_);
+                    std::unique_ptr<RowCursor>* cursor) override;
+
+  // Reads the parent and child rows in a single pass over the rows of the
+  // parent if the storage co-locates interleaved tables, unless either read
+  // is of an index.
+  absl::Status ReadInterleaved(
+      const ReadArg& parent_arg, const ReadArg& child_arg,
+      std::unique_ptr<RowCursor>* parent_cursor,
+      std::unique_ptr<RowCursor>* child_cursor) override;
 
   absl::Time read_timestamp() const { return read_timestamp_; }
 
@@ -67,12 +85,24 @@ class ReadOnlyTransaction : public RowReader {
   const ReadOnlyOptions& options() const { return options_; }
 
  private:
-  // Mutex that guards the Read method.
-  absl::Mutex mu_;
-
   // Picks a read timestamp given transaction type and timestamp bound.
   absl::Time PickReadTimestamp();
 
+  // Waits until the database state at the read timestamp can be read, and
+  // returns an error if its versions may have been garbage collected.
+  absl::Status WaitForSafeRead();
+
+  // Splits the key ranges of a read into the ranges read in parallel by
+  // ReadInParallel, in key order.
+  absl::Status SplitKeyRanges(const ResolvedReadArg& read_arg,
+                              std::vector<KeyRange>* ranges) const;
+
+  // Reads `ranges` of the table on the shared executor, and returns their rows
+  // in the order of the ranges.
+  absl::Status ReadInParallel(const ResolvedReadArg& read_arg,
+                              const std::vector<KeyRange>& ranges,
+                              std::unique_ptr<RowCursor>* cursor) const;
+
   // Options with which the transaction was created.
   ReadOnlyOptions options_;
 
@@ -94,6 +124,10 @@ class ReadOnlyTransaction : public RowReader {
 
   // The read timestamp picked by this transaction.
   absl::Time read_timestamp_;
+
+  // Number of ranges of large reads read in parallel, or 0 if reads are always
+  // performed by the calling thread.
+  const int read_parallelism_;
 };
 
 }  // namespace backend
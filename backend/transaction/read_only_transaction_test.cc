@@ -17,6 +17,8 @@
 #include "backend/transaction/read_only_transaction.h"
 
 #include <ctime>
+#include <memory>
+#include <vector>
 
 #include "zetasql/public/type.h"
 #include "gmock/gmock.h"
@@ -26,7 +28,11 @@
 #include "absl/status/status.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
+#include "backend/access/read.h"
 #include "backend/common/ids.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/datamodel/key_set.h"
 #include "backend/schema/catalog/schema.h"
 #include "backend/schema/catalog/versioned_catalog.h"
 #include "backend/storage/in_memory_storage.h"
@@ -40,6 +46,8 @@ namespace emulator {
 namespace backend {
 namespace {
 
+using zetasql::values::Int64;
+
 class ReadOnlyTransactionTest : public testing::Test {
  protected:
   TransactionID txn_id_ = 1;
@@ -153,6 +161,45 @@ TEST_F(ReadOnlyTransactionTest, WaitsForFutureReadTime) {
   EXPECT_GE(clock_.Now(), opts.timestamp);
 }
 
+TEST_F(ReadOnlyTransactionTest, ParallelReadReturnsRowsInKeyOrder) {
+  VersionedCatalog catalog;
+  zetasql::TypeFactory type_factory{};
+  ZETASQL_EXPECT_OK(
+      catalog.AddSchema(t0_, test::CreateSchemaWithOneTable(&type_factory)));
+  const Table* table = catalog.GetLatestSchema()->FindTable("test_table");
+  const Column* column = table->FindColumn("int64_col");
+  for (int i = 0; i < 100; ++i) {
+    ZETASQL_EXPECT_OK(storage_.Write(t0_, table->id(), Key({Int64(i)}),
+                             {column->id()}, {Int64(i)}));
+  }
+
+  ReadOnlyOptions opts;
+  opts.bound = TimestampBound::kStrongRead;
+  ReadOnlyTransaction txn(opts, txn_id_, &clock_, &storage_, &lock_manager_,
+                          &catalog, /*read_parallelism=*/4);
+
+  // The ranges are given out of order, and may be read in any order by the
+  // executor, but their rows are returned in key order.
+  ReadArg read_arg;
+  read_arg.table = "test_table";
+  read_arg.columns = {"int64_col"};
+  read_arg.key_set.AddRange(
+      KeyRange::ClosedOpen(Key({Int64(60)}), Key({Int64(63)})));
+  read_arg.key_set.AddRange(
+      KeyRange::ClosedOpen(Key({Int64(10)}), Key({Int64(12)})));
+  read_arg.key_set.AddRange(
+      KeyRange::ClosedOpen(Key({Int64(95)}), Key({Int64(200)})));
+  std::unique_ptr<RowCursor> cursor;
+  ZETASQL_ASSERT_OK(txn.Read(read_arg, &cursor));
+  std::vector<int64_t> keys;
+  while (cursor->Next()) {
+    keys.push_back(cursor->ColumnValue(0).int64_value());
+  }
+  ZETASQL_EXPECT_OK(cursor->Status());
+  EXPECT_THAT(keys, testing::ElementsAre(10, 11, 60, 61, 62, 95, 96, 97, 98,
+                                         99));
+}
+
 }  // namespace
 }  // namespace backend
 }  // namespace emulator
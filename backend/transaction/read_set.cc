@@ -0,0 +1,101 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/transaction/read_set.h"
+
+#include <vector>
+
+#include "zetasql/base/statusor.h"
+#include "absl/time/time.h"
+#include "absl/types/variant.h"
+#include "backend/actions/ops.h"
+#include "backend/common/ids.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/schema/catalog/table.h"
+#include "backend/storage/storage.h"
+#include "backend/transaction/commit_timestamp.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+void WrittenRows::Add(const std::vector<WriteOp>& write_ops) {
+  for (const WriteOp& op : write_ops) {
+    const Key& key = KeyOf(op);
+    const DeleteOp* delete_op = absl::get_if<DeleteOp>(&op);
+    KeyRange key_range;
+    if (HasPendingCommitTimestampInKey(TableOf(op), key)) {
+      // The key is only known once the commit timestamp is reserved, which
+      // happens after the validation, so any row of the table may be written.
+      key_range = KeyRange::All().ToClosedOpen();
+    } else if (delete_op != nullptr && IsPrefixDelete(*delete_op)) {
+      key_range = KeyRange::Prefix(key).ToClosedOpen();
+    } else {
+      key_range = KeyRange::Point(key).ToClosedOpen();
+    }
+    tables_[TableOf(op)->id()].Insert(std::move(key_range.start_key()),
+                                      std::move(key_range.limit_key()), true);
+  }
+}
+
+bool WrittenRows::Overlaps(const TableID& table_id,
+                           const KeyRange& key_range) const {
+  auto itr = tables_.find(table_id);
+  if (itr == tables_.end()) {
+    return false;
+  }
+  bool overlaps = false;
+  itr->second.ForEachOverlapping(key_range.start_key(), key_range.limit_key(),
+                                 [&](const bool&) { overlaps = true; });
+  return overlaps;
+}
+
+void ReadSet::Add(const TableID& table_id, const KeyRange& key_range,
+                  absl::Time timestamp) {
+  KeyRange closed_open = key_range.ToClosedOpen();
+  // Rows are often read again in the same way, such as a row which is looked
+  // up before each of its updates. The earlier read is validated against the
+  // longer span of commits, so it covers the later one.
+  if (!reads_.empty() && reads_.back().table_id == table_id &&
+      reads_.back().key_range == closed_open) {
+    return;
+  }
+  reads_.push_back(Read{table_id, std::move(closed_open), timestamp});
+}
+
+zetasql_base::StatusOr<bool> ReadSet::Conflicts(const Storage& storage,
+                                        const WrittenRows& written) const {
+  for (const Read& read : reads_) {
+    if (!written.empty() && written.Overlaps(read.table_id, read.key_range)) {
+      return true;
+    }
+    ZETASQL_ASSIGN_OR_RETURN(bool changed,
+                     storage.ChangedSince(read.timestamp, read.table_id,
+                                          read.key_range));
+    if (changed) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,107 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_READ_SET_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_READ_SET_H_
+
+#include <vector>
+
+#include "absl/container/node_hash_map.h"
+#include "zetasql/base/statusor.h"
+#include "absl/time/time.h"
+#include "backend/actions/ops.h"
+#include "backend/common/ids.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/locking/interval_tree.h"
+#include "backend/storage/storage.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+
+// WrittenRows holds the rows written by the transactions of a commit group
+// which commit before the others, and whose writes are validated against the
+// reads of the later ones before any of them is flushed to storage.
+//
+// This class is not thread safe.
+class WrittenRows {
+ public:
+  // Adds the rows written by `write_ops`. A prefix delete writes all the rows
+  // with its key as a prefix, and a write to a row whose key holds a pending
+  // commit timestamp may write any row of its table.
+  void Add(const std::vector<WriteOp>& write_ops);
+
+  // Returns true if any row of `table_id` in the ClosedOpen `key_range` was
+  // added.
+  bool Overlaps(const TableID& table_id, const KeyRange& key_range) const;
+
+  bool empty() const { return tables_.empty(); }
+
+ private:
+  // Key ranges of the rows written to each table, in ClosedOpen form.
+  absl::node_hash_map<TableID, IntervalTree<Key, bool>> tables_;
+};
+
+// ReadSet records the rows read by an optimistic read-write transaction (see
+// ConcurrencyMode::kOptimistic), which reads without locks, so that its reads
+// can be validated when it commits.
+//
+// Each read records the key range it read and the timestamp up to which it
+// observed all commits. The read remains valid as long as no later commit
+// changed a row in its range; changes are tracked per row, so a write of other
+// columns of the rows read still invalidates the read.
+//
+// This class is not thread safe.
+class ReadSet {
+ public:
+  // Records a read of the rows of `table_id` in `key_range`, which observed
+  // the writes of all commits at or before `timestamp`.
+  void Add(const TableID& table_id, const KeyRange& key_range,
+           absl::Time timestamp);
+
+  // Returns true if a row read was changed in `storage` since it was read, or
+  // is among `written`. All commits at or before the time of the call must be
+  // flushed to `storage`, and the timestamps of the reads retained from its
+  // garbage collection.
+  zetasql_base::StatusOr<bool> Conflicts(const Storage& storage,
+                                 const WrittenRows& written) const;
+
+  // Removes all the reads recorded.
+  void Clear() { reads_.clear(); }
+
+  bool empty() const { return reads_.empty(); }
+
+ private:
+  struct Read {
+    TableID table_id;
+
+    // The key range read, in ClosedOpen form.
+    KeyRange key_range;
+
+    absl::Time timestamp;
+  };
+
+  std::vector<Read> reads_;
+};
+
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_READ_SET_H_
@@ -0,0 +1,152 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "backend/transaction/read_set.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "absl/time/time.h"
+#include "backend/actions/ops.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/storage/in_memory_storage.h"
+#include "tests/common/schema_constructor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace backend {
+namespace {
+
+using zetasql::values::Int64;
+using zetasql::values::String;
+using zetasql_base::testing::IsOkAndHolds;
+
+class ReadSetTest : public testing::Test {
+ public:
+  ReadSetTest()
+      : type_factory_(absl::make_unique<zetasql::TypeFactory>()),
+        schema_(test::CreateSchemaFromDDL(
+                    {
+                        R"(
+                          CREATE TABLE TestTable (
+                            Int64Col    INT64 NOT NULL,
+                            StringCol   STRING(MAX),
+                          ) PRIMARY KEY (Int64Col)
+                        )"},
+                    type_factory_.get())
+                    .ValueOrDie()),
+        table_(schema_->FindTable("TestTable")),
+        int64_col_(table_->FindColumn("Int64Col")),
+        string_col_(table_->FindColumn("StringCol")) {}
+
+ protected:
+  absl::Status Write(absl::Time timestamp, int64_t key) {
+    return storage_.Write(timestamp, table_->id(), Key({Int64(key)}),
+                          {int64_col_->id(), string_col_->id()},
+                          {Int64(key), String("value")});
+  }
+
+  KeyRange Range(int64_t start, int64_t limit) {
+    return KeyRange::ClosedOpen(Key({Int64(start)}), Key({Int64(limit)}));
+  }
+
+  InMemoryStorage storage_;
+
+  // The type factory must outlive the type objects that it has made.
+  std::unique_ptr<zetasql::TypeFactory> type_factory_;
+  std::unique_ptr<const Schema> schema_;
+
+  const Table* table_;
+  const Column* int64_col_;
+  const Column* string_col_;
+
+  const WrittenRows no_written_rows_;
+};
+
+TEST_F(ReadSetTest, ReadsOfUnchangedRowsDoNotConflict) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  ZETASQL_ASSERT_OK(Write(t0, 1));
+
+  ReadSet read_set;
+  EXPECT_TRUE(read_set.empty());
+  read_set.Add(table_->id(), KeyRange::Point(Key({Int64(1)})), t1);
+  read_set.Add(table_->id(), Range(0, 10), t1);
+  EXPECT_FALSE(read_set.empty());
+  EXPECT_THAT(read_set.Conflicts(storage_, no_written_rows_),
+              IsOkAndHolds(false));
+}
+
+TEST_F(ReadSetTest, ReadsConflictWithLaterChangesToTheRowsRead) {
+  absl::Time t0 = absl::Now();
+  absl::Time t1 = t0 + absl::Seconds(1);
+  absl::Time t2 = t0 + absl::Seconds(2);
+  ZETASQL_ASSERT_OK(Write(t0, 1));
+
+  ReadSet point_read;
+  point_read.Add(table_->id(), KeyRange::Point(Key({Int64(1)})), t1);
+  ReadSet range_read;
+  range_read.Add(table_->id(), Range(0, 10), t1);
+  ReadSet other_rows_read;
+  other_rows_read.Add(table_->id(), Range(10, 20), t1);
+
+  // Inserting a row into a range read conflicts with the read as well.
+  ZETASQL_ASSERT_OK(Write(t2, 1));
+  ZETASQL_ASSERT_OK(Write(t2, 5));
+  EXPECT_THAT(point_read.Conflicts(storage_, no_written_rows_),
+              IsOkAndHolds(true));
+  EXPECT_THAT(range_read.Conflicts(storage_, no_written_rows_),
+              IsOkAndHolds(true));
+  EXPECT_THAT(other_rows_read.Conflicts(storage_, no_written_rows_),
+              IsOkAndHolds(false));
+
+  other_rows_read.Clear();
+  EXPECT_TRUE(other_rows_read.empty());
+}
+
+TEST_F(ReadSetTest, ReadsConflictWithWrittenRows) {
+  absl::Time t0 = absl::Now();
+  ReadSet read_set;
+  read_set.Add(table_->id(), KeyRange::Point(Key({Int64(1)})), t0);
+
+  WrittenRows other_row_written;
+  other_row_written.Add(
+      {UpdateOp{table_, Key({Int64(2)}), {string_col_}, {String("new")}}});
+  EXPECT_THAT(read_set.Conflicts(storage_, other_row_written),
+              IsOkAndHolds(false));
+
+  WrittenRows row_written;
+  row_written.Add({DeleteOp{table_, Key({Int64(1)})}});
+  EXPECT_THAT(read_set.Conflicts(storage_, row_written), IsOkAndHolds(true));
+
+  // A delete of a key prefix writes all the rows with the prefix.
+  WrittenRows all_rows_written;
+  all_rows_written.Add({DeleteOp{table_, Key()}});
+  EXPECT_THAT(read_set.Conflicts(storage_, all_rows_written),
+              IsOkAndHolds(true));
+}
+
+}  // namespace
+}  // namespace backend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -16,7 +16,11 @@
 
 #include "backend/transaction/read_write_transaction.h"
 
+#include <algorithm>
+#include <map>
 #include <memory>
+#include <numeric>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -29,11 +33,15 @@
 #include "absl/status/status.h"
 #include "zetasql/base/statusor.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
+#include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "backend/access/read.h"
 #include "backend/access/write.h"
+#include "backend/actions/column_value.h"
 #include "backend/actions/context.h"
+#include "backend/actions/interleave.h"
 #include "backend/actions/manager.h"
 #include "backend/actions/ops.h"
 #include "backend/common/case.h"
@@ -49,14 +57,19 @@
 #include "backend/storage/iterator.h"
 #include "backend/storage/storage.h"
 #include "backend/transaction/actions.h"
+#include "backend/transaction/commit_pipeline.h"
+#include "backend/transaction/commit_timestamp.h"
 #include "backend/transaction/flush.h"
 #include "backend/transaction/options.h"
+#include "backend/transaction/read_set.h"
 #include "backend/transaction/resolve.h"
 #include "backend/transaction/row_cursor.h"
 #include "common/clock.h"
 #include "common/config.h"
 #include "common/constants.h"
 #include "common/errors.h"
+#include "common/metrics.h"
+#include "common/trace.h"
 #include "absl/status/status.h"
 #include "zetasql/base/status_macros.h"
 
@@ -67,12 +80,39 @@ namespace backend {
 
 namespace {
 
+// Returns true if the key range covers exactly the rows of the table with a
+// given key prefix, without NULL values, so that it can be deleted with a
+// prefix delete (see IsPrefixDelete).
+bool IsDeletablePrefixRange(const Table* table, const KeyRange& key_range) {
+  const Key& prefix = key_range.start_key();
+  if (prefix.NumColumns() == 0 ||
+      prefix.NumColumns() >= table->primary_key().size() ||
+      !(key_range.limit_key() == prefix.ToPrefixLimit())) {
+    return false;
+  }
+  for (int i = 0; i < prefix.NumColumns(); ++i) {
+    if (prefix.ColumnValue(i).is_null()) {
+      return false;
+    }
+  }
+  return true;
+}
+
 // Flattens delete mutation to one write op for each key being deleted.
+//
+// Ranges of all the rows with a key prefix are instead flattened to a single
+// prefix delete when deleting the rows needs no per-row actions, so that the
+// rows are not read one at a time and storage deletes them as a range.
 zetasql_base::StatusOr<std::vector<WriteOp>> FlattenDeleteOp(
     const Table* table, const std::vector<KeyRange>& key_ranges,
     const TransactionStore* transaction_store) {
   std::vector<WriteOp> write_ops;
+  const bool can_delete_by_prefix = CanDeleteByPrefix(table);
   for (const KeyRange& key_range : key_ranges) {
+    if (can_delete_by_prefix && IsDeletablePrefixRange(table, key_range)) {
+      write_ops.push_back(DeleteOp{table, key_range.start_key()});
+      continue;
+    }
     std::unique_ptr<StorageIterator> itr;
     ZETASQL_RETURN_IF_ERROR(transaction_store->Read(table, key_range,
                                             /*columns= */ {}, &itr));
@@ -89,44 +129,50 @@ zetasql_base::StatusOr<std::vector<WriteOp>> FlattenDeleteOp(
 //   to UpdateOp. Otherwise converts to InsertOp.
 // - MutationOpType::kInsert | kDelete | kUpdate: converts to
 //   corresponding WriteOp of the same type.
-zetasql_base::StatusOr<std::vector<WriteOp>> FlattenNonDeleteOpRow(
-    MutationOpType type, const Table* table,
-    const std::vector<const Column*>& columns, const Key& key,
-    const ValueList& row, const TransactionStore* transaction_store) {
-  std::vector<WriteOp> write_ops;
+//
+// The key and row are moved into the operations, which are appended to
+// `write_ops`.
+absl::Status FlattenNonDeleteOpRow(MutationOpType type, const Table* table,
+                                   const std::vector<const Column*>& columns,
+                                   Key key, ValueList row,
+                                   const TransactionStore* transaction_store,
+                                   std::vector<WriteOp>* write_ops) {
   switch (type) {
     case MutationOpType::kInsert: {
-      write_ops.push_back(InsertOp{table, key, columns, row});
+      write_ops->emplace_back(
+          InsertOp{table, std::move(key), columns, std::move(row)});
       break;
     }
     case MutationOpType::kUpdate: {
-      write_ops.push_back(UpdateOp{table, key, columns, row});
+      write_ops->emplace_back(
+          UpdateOp{table, std::move(key), columns, std::move(row)});
       break;
     }
     case MutationOpType::kInsertOrUpdate: {
-      zetasql_base::StatusOr<ValueList> maybe_row =
-          transaction_store->Lookup(table, key,
-                                    /*columns= */ {});
-      if (maybe_row.ok()) {
+      ZETASQL_ASSIGN_OR_RETURN(absl::optional<ValueList> existing_row,
+                       transaction_store->LookupIfExists(table, key,
+                                                         /*columns= */ {}));
+      if (existing_row.has_value()) {
         // Row exists and therefore we should only update.
-        write_ops.push_back(UpdateOp{table, key, columns, row});
-      } else if (maybe_row.status().code() == absl::StatusCode::kNotFound) {
-        write_ops.push_back(InsertOp{table, key, columns, row});
+        write_ops->emplace_back(
+            UpdateOp{table, std::move(key), columns, std::move(row)});
       } else {
-        return maybe_row.status();
+        write_ops->emplace_back(
+            InsertOp{table, std::move(key), columns, std::move(row)});
       }
       break;
     }
     case MutationOpType::kReplace: {
-      write_ops.push_back(DeleteOp{table, key});
-      write_ops.push_back(InsertOp{table, key, columns, row});
+      write_ops->emplace_back(DeleteOp{table, key});
+      write_ops->emplace_back(
+          InsertOp{table, std::move(key), columns, std::move(row)});
       break;
     }
     case MutationOpType::kDelete: {
       break;
     }
   }
-  return std::move(write_ops);
+  return absl::OkStatus();
 }
 
 bool ShouldAbortOnFirstCommit() {
@@ -142,13 +188,113 @@ RetryState MakeRetryState(const RetryState& retry_state, Clock* clock) {
   return state;
 }
 
+// Orders positions in a batch of operations by the keys of the operations at
+// those positions. Keys can be looked up directly.
+struct BatchKeyLess {
+  using is_transparent = void;
+
+  bool operator()(int lhs, int rhs) const {
+    return KeyOf((*batch)[lhs]) < KeyOf((*batch)[rhs]);
+  }
+  bool operator()(int lhs, const Key& rhs) const {
+    return KeyOf((*batch)[lhs]) < rhs;
+  }
+  bool operator()(const Key& lhs, int rhs) const {
+    return lhs < KeyOf((*batch)[rhs]);
+  }
+
+  const std::vector<WriteOp>* batch;
+};
+
+// A row written by one or more coalesced operations of a mutation.
+struct CoalescedRow {
+  MutationOpType type;
+  const Table* table;
+  Key key;
+  std::vector<const Column*> columns;
+  ValueList values;
+};
+
+// Merges a later write of `values` to `columns` into `row`, moving from
+// `values`, and returns false if the write cannot be merged.
+//
+// Updates and inserts-or-updates merge into any earlier insert, update or
+// insert-or-update of the row, which keeps its type: the earlier operation
+// decides whether the row must exist, and afterwards the row always exists.
+// Inserts never merge, as they fail on a row which was written before. The
+// values the write overrides are validated first, as they would have been
+// had the operations been processed one by one.
+zetasql_base::StatusOr<bool> MergeIntoRow(
+    MutationOpType type, const std::vector<const Column*>& columns,
+    ValueList* values, Clock* clock, CoalescedRow* row) {
+  if (type == MutationOpType::kInsert) {
+    return false;
+  }
+  for (int i = 0; i < columns.size(); ++i) {
+    auto it = std::find(row->columns.begin(), row->columns.end(), columns[i]);
+    if (it == row->columns.end()) {
+      row->columns.push_back(columns[i]);
+      row->values.push_back(std::move((*values)[i]));
+      continue;
+    }
+    zetasql::Value& value = row->values[it - row->columns.begin()];
+    ZETASQL_RETURN_IF_ERROR(ValidateColumnValues(row->table, columns[i],
+                                         absl::MakeConstSpan(&value, 1),
+                                         clock));
+    value = std::move((*values)[i]);
+  }
+  return true;
+}
+
+// Latency histograms of the stages of processing mutations. Each is recorded
+// around every call which performs its stage, so that its sum is the total
+// time spent in the stage. Flushing to storage at commit is recorded as the
+// commit_flush stage by FlushWriteOpsToStorage.
+metrics::Histogram* ResolveLatency() {
+  static metrics::Histogram* const latency =
+      metrics::StageLatency("mutation_resolve");
+  return latency;
+}
+metrics::Histogram* FlattenLatency() {
+  static metrics::Histogram* const latency =
+      metrics::StageLatency("mutation_flatten");
+  return latency;
+}
+metrics::Histogram* ValidateLatency() {
+  static metrics::Histogram* const latency =
+      metrics::StageLatency("mutation_validate");
+  return latency;
+}
+metrics::Histogram* EffectLatency() {
+  static metrics::Histogram* const latency =
+      metrics::StageLatency("mutation_effect");
+  return latency;
+}
+metrics::Histogram* BufferLatency() {
+  static metrics::Histogram* const latency =
+      metrics::StageLatency("mutation_buffer");
+  return latency;
+}
+metrics::Histogram* VerifyLatency() {
+  static metrics::Histogram* const latency =
+      metrics::StageLatency("mutation_verify");
+  return latency;
+}
+
+zetasql_base::StatusOr<ResolvedMutationOp> TimedResolveMutationOp(
+    const MutationOp& mutation_op, const Schema* schema, absl::Time now) {
+  metrics::ScopedLatencyRecorder recorder(ResolveLatency());
+  return ResolveMutationOp(mutation_op, schema, now);
+}
+
 }  // namespace
 
 ReadWriteTransaction::ReadWriteTransaction(
     const ReadWriteOptions& options, const RetryState& retry_state,
     TransactionID transaction_id, Clock* clock, Storage* storage,
     LockManager* lock_manager, const VersionedCatalog* const versioned_catalog,
-    ActionManager* action_manager)
+    ActionManager* action_manager, CommitLog* commit_log,
+    CommitPipeline* commit_pipeline, MemoryBudget* memory_budget)
     : options_(options),
       retry_state_(MakeRetryState(retry_state, clock)),
       id_(transaction_id),
@@ -164,7 +310,21 @@ ReadWriteTransaction::ReadWriteTransaction(
           absl::make_unique<TransactionReadOnlyStore>(transaction_store_.get()),
           absl::make_unique<TransactionEffectsBuffer>(&write_ops_queue_),
           clock)),
-      schema_(versioned_catalog_->GetLatestSchema()) {}
+      commit_log_(commit_log),
+      commit_pipeline_(commit_pipeline),
+      memory_budget_(memory_budget),
+      schema_(versioned_catalog_->GetLatestSchema()) {
+  if (options_.concurrency_mode == ConcurrencyMode::kOptimistic) {
+    transaction_store_->set_read_set(&read_set_);
+  }
+}
+
+ReadWriteTransaction::~ReadWriteTransaction() {
+  absl::MutexLock lock(&mu_);
+  if (memory_budget_ != nullptr) {
+    memory_budget_->AddTransactionBytes(-reported_bytes_);
+  }
+}
 
 zetasql_base::StatusOr<absl::Time> ReadWriteTransaction::GetCommitTimestamp() {
   absl::MutexLock lock(&mu_);
@@ -186,6 +346,21 @@ absl::Status ReadWriteTransaction::Read(const ReadArg& read_arg,
                      ResolveReadArg(read_arg, schema_));
 
     std::vector<std::unique_ptr<StorageIterator>> iterators;
+    // Batches of point keys, such as the rows looked up by a query through a
+    // secondary index which does not store all of its columns, are looked up
+    // together rather than read as a range each.
+    std::vector<Key> point_keys;
+    if (resolved_read_arg.key_ranges.size() > 1 &&
+        GetPointLookupKeys(resolved_read_arg, &point_keys)) {
+      std::unique_ptr<StorageIterator> itr;
+      ZETASQL_RETURN_IF_ERROR(transaction_store_->MultiLookup(
+          resolved_read_arg.table, point_keys, resolved_read_arg.columns, &itr,
+          false /*allow_pending_commit_timestamps_in_read*/));
+      iterators.push_back(std::move(itr));
+      *cursor = absl::make_unique<StorageIteratorRowCursor>(
+          std::move(iterators), resolved_read_arg.columns);
+      return absl::OkStatus();
+    }
     for (const auto& key_range : resolved_read_arg.key_ranges) {
       std::unique_ptr<StorageIterator> itr;
       ZETASQL_RETURN_IF_ERROR(transaction_store_->Read(
@@ -208,9 +383,36 @@ absl::Status ReadWriteTransaction::ApplyEffectors(const WriteOp& op) {
 }
 
 absl::Status ReadWriteTransaction::ApplyStatementVerifiers() {
-  for (const auto& write_op : transaction_store_->GetBufferedOps()) {
-    ZETASQL_RETURN_IF_ERROR(
-        action_registry_->ExecuteVerifiers(action_context_.get(), write_op));
+  metrics::ScopedLatencyRecorder recorder(VerifyLatency());
+  action_context_->ClearRowCache();
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<WriteOp> buffered_ops,
+                   transaction_store_->GetBufferedOps());
+  absl::Span<const WriteOp> ops = absl::MakeConstSpan(buffered_ops);
+  while (!ops.empty()) {
+    // Verify the longest run of operations of the same type on the same table
+    // in increasing key order at once, so that verifiers can share their reads
+    // across the run.
+    size_t run_size = 1;
+    while (run_size < ops.size() &&
+           TableOf(ops[run_size]) == TableOf(ops.front()) &&
+           ops[run_size].index() == ops.front().index() &&
+           KeyOf(ops[run_size - 1]) < KeyOf(ops[run_size])) {
+      ++run_size;
+    }
+    absl::Span<const WriteOp> run = ops.subspan(0, run_size);
+    ops.remove_prefix(run_size);
+
+    absl::Status status =
+        action_registry_->ExecuteVerifiers(action_context_.get(), run);
+    if (!status.ok()) {
+      // Replay the run one operation at a time, so that the error reported is
+      // the one sequential verification would report.
+      for (const WriteOp& write_op : run) {
+        ZETASQL_RETURN_IF_ERROR(action_registry_->ExecuteVerifiers(
+            action_context_.get(), write_op));
+      }
+      return status;
+    }
   }
   return absl::OkStatus();
 }
@@ -228,9 +430,30 @@ void ReadWriteTransaction::Reset() {
 
   lock_handle_->UnlockAll();
   transaction_store_->Clear();
+  read_set_.Clear();
   std::queue<WriteOp> empty;
   write_ops_queue_.swap(empty);
   state_ = State::kUninitialized;
+  ReportBufferedBytes();
+}
+
+void ReadWriteTransaction::ReportBufferedBytes() {
+  mu_.AssertHeld();
+  if (memory_budget_ == nullptr) {
+    return;
+  }
+  const int64_t bytes = transaction_store_->bytes();
+  memory_budget_->AddTransactionBytes(bytes - reported_bytes_);
+  reported_bytes_ = bytes;
+}
+
+absl::Status ReadWriteTransaction::CheckMemoryBudget() {
+  mu_.AssertHeld();
+  if (memory_budget_ == nullptr) {
+    return absl::OkStatus();
+  }
+  ReportBufferedBytes();
+  return memory_budget_->CheckWithinLimit();
 }
 
 absl::Status ReadWriteTransaction::GuardedCall(
@@ -260,7 +483,7 @@ absl::Status ReadWriteTransaction::GuardedCall(
         Reset();
         return maybe_action_registry.status();
       }
-      action_registry_ = maybe_action_registry.ValueOrDie();
+      action_registry_ = std::move(maybe_action_registry).ValueOrDie();
       state_ = State::kActive;
       break;
     }
@@ -275,6 +498,7 @@ absl::Status ReadWriteTransaction::GuardedCall(
   }
 
   absl::Status status = fn();
+  last_active_time_ = absl::Now();
 
   if (!status.ok()) {
     if (status.code() == absl::StatusCode::kAborted) {
@@ -290,65 +514,298 @@ absl::Status ReadWriteTransaction::GuardedCall(
       status.SetPayload(kConstraintError, absl::Cord(""));
     }
   }
+  ReportBufferedBytes();
   return status;
 }
 
 absl::Status ReadWriteTransaction::ProcessWriteOps(
-    const std::vector<WriteOp>& write_ops) {
+    std::vector<WriteOp> write_ops) {
   mu_.AssertHeld();
 
-  for (const auto& write_op : write_ops) {
-    write_ops_queue_.push(write_op);
+  for (WriteOp& write_op : write_ops) {
+    write_ops_queue_.push(std::move(write_op));
   }
 
   while (!write_ops_queue_.empty()) {
-    WriteOp write_op = write_ops_queue_.front();
-    write_ops_queue_.pop();
+    // Pop the longest run of operations of the same type on the same table
+    // with distinct keys. Such operations do not observe each other's effects,
+    // so their actions can be executed over the whole batch at once.
+    // The keys are tracked by their position in the batch rather than copied.
+    std::vector<WriteOp> batch;
+    std::set<int, BatchKeyLess> batch_keys(BatchKeyLess{&batch});
+    do {
+      const WriteOp& write_op = write_ops_queue_.front();
+      if (!batch.empty() &&
+          (TableOf(write_op) != TableOf(batch.front()) ||
+           write_op.index() != batch.front().index() ||
+           batch_keys.count(KeyOf(write_op)) > 0)) {
+        break;
+      }
+      batch.push_back(std::move(write_ops_queue_.front()));
+      batch_keys.insert(batch.size() - 1);
+      write_ops_queue_.pop();
+    } while (!write_ops_queue_.empty());
+
+    ZETASQL_RETURN_IF_ERROR(ProcessWriteOpBatch(std::move(batch)));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ReadWriteTransaction::ProcessWriteOp(WriteOp write_op) {
+  mu_.AssertHeld();
 
-    // Process the operation.
+  // Process the operation. Its actions share the rows they look up, which are
+  // read from the store as it is before the operation is buffered.
+  action_context_->ClearRowCache();
+  {
+    metrics::ScopedLatencyRecorder recorder(ValidateLatency());
     ZETASQL_RETURN_IF_ERROR(ApplyValidators(write_op));
+  }
+  {
+    metrics::ScopedLatencyRecorder recorder(EffectLatency());
     ZETASQL_RETURN_IF_ERROR(ApplyEffectors(write_op));
+  }
+
+  // Apply to transaction store.
+  metrics::ScopedLatencyRecorder recorder(BufferLatency());
+  return transaction_store_->BufferWriteOp(std::move(write_op));
+}
+
+absl::Status ReadWriteTransaction::ProcessWriteOpBatch(
+    std::vector<WriteOp> batch) {
+  mu_.AssertHeld();
+
+  if (batch.size() == 1) {
+    return ProcessWriteOp(std::move(batch.front()));
+  }
+
+  // Batched actions merge their reads over the operations in key order. The
+  // operations are sorted in place; `original_position` remembers where each
+  // one came from so that a replay does not need a copy of the batch.
+  std::vector<int> original_position(batch.size());
+  std::iota(original_position.begin(), original_position.end(), 0);
+  auto key_less = [](const WriteOp& lhs, const WriteOp& rhs) {
+    return KeyOf(lhs) < KeyOf(rhs);
+  };
+  if (!std::is_sorted(batch.begin(), batch.end(), key_less)) {
+    std::vector<int> sorted_order = original_position;
+    std::stable_sort(sorted_order.begin(), sorted_order.end(),
+                     [&batch](int lhs, int rhs) {
+                       return KeyOf(batch[lhs]) < KeyOf(batch[rhs]);
+                     });
+    std::vector<WriteOp> sorted_batch;
+    sorted_batch.reserve(batch.size());
+    for (int i = 0; i < sorted_order.size(); ++i) {
+      sorted_batch.push_back(std::move(batch[sorted_order[i]]));
+      original_position[sorted_order[i]] = i;
+    }
+    batch = std::move(sorted_batch);
+  }
+
+  action_context_->ClearRowCache();
+  absl::Status status;
+  {
+    metrics::ScopedLatencyRecorder recorder(ValidateLatency());
+    status = action_registry_->ExecuteValidators(action_context_.get(), batch);
+  }
+  if (!status.ok()) {
+    // Replay the operations one at a time, in their original order, so that
+    // the error reported is the one sequential processing would report.
+    for (int position : original_position) {
+      ZETASQL_RETURN_IF_ERROR(ProcessWriteOp(std::move(batch[position])));
+    }
+    return status;
+  }
+  {
+    metrics::ScopedLatencyRecorder recorder(EffectLatency());
+    ZETASQL_RETURN_IF_ERROR(
+        action_registry_->ExecuteEffectors(action_context_.get(), batch));
+  }
+
+  // Apply to transaction store.
+  metrics::ScopedLatencyRecorder recorder(BufferLatency());
+  for (WriteOp& write_op : batch) {
+    ZETASQL_RETURN_IF_ERROR(
+        transaction_store_->BufferWriteOp(std::move(write_op)));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ReadWriteTransaction::ProcessMutation(const Mutation& mutation) {
+  mu_.AssertHeld();
+
+  // Commit timestamps written by the mutation are checked not to be in the
+  // future against a single reading of the clock, which does not advance it.
+  const absl::Time now = clock_->NowForRead();
+  for (const MutationOp& mutation_op : mutation.ops()) {
+    ZETASQL_ASSIGN_OR_RETURN(ResolvedMutationOp resolved_mutation_op,
+                     TimedResolveMutationOp(mutation_op, schema_, now));
+    // Deletes are always allowed, so that a database which exceeds its memory
+    // budget can free memory.
+    if (resolved_mutation_op.type != MutationOpType::kDelete) {
+      ZETASQL_RETURN_IF_ERROR(CheckMemoryBudget());
+    }
+    ZETASQL_RETURN_IF_ERROR(
+        ProcessResolvedMutationOp(std::move(resolved_mutation_op)));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ReadWriteTransaction::ProcessResolvedMutationOp(
+    ResolvedMutationOp resolved_mutation_op) {
+  mu_.AssertHeld();
+
+  // Process Delete.
+  if (resolved_mutation_op.type == MutationOpType::kDelete) {
+    std::vector<WriteOp> write_ops;
+    {
+      metrics::ScopedLatencyRecorder recorder(FlattenLatency());
+      ZETASQL_ASSIGN_OR_RETURN(write_ops,
+                       FlattenDeleteOp(resolved_mutation_op.table,
+                                       resolved_mutation_op.key_ranges,
+                                       transaction_store_.get()));
+    }
+
+    ZETASQL_RETURN_IF_ERROR(ProcessWriteOps(std::move(write_ops)));
+  } else if (resolved_mutation_op.type == MutationOpType::kInsert ||
+             resolved_mutation_op.type == MutationOpType::kUpdate) {
+    // Process Insert and Update. Each row flattens to a single operation
+    // which depends only on the row itself, so all the rows are processed
+    // together to allow their actions to be batched.
+    std::vector<WriteOp> write_ops;
+    write_ops.reserve(resolved_mutation_op.rows.size());
+    {
+      metrics::ScopedLatencyRecorder recorder(FlattenLatency());
+      for (int i = 0; i < resolved_mutation_op.rows.size(); i++) {
+        ZETASQL_RETURN_IF_ERROR(FlattenNonDeleteOpRow(
+            resolved_mutation_op.type, resolved_mutation_op.table,
+            resolved_mutation_op.columns,
+            std::move(resolved_mutation_op.keys[i]),
+            std::move(resolved_mutation_op.rows[i]), transaction_store_.get(),
+            &write_ops));
+      }
+    }
+    ZETASQL_RETURN_IF_ERROR(ProcessWriteOps(std::move(write_ops)));
+  } else {
+    // Process Replace and InsertOrUpdate, which depend on whether the row
+    // already exists in the transaction.
+    for (int i = 0; i < resolved_mutation_op.rows.size(); i++) {
+      std::vector<WriteOp> write_ops;
+      {
+        metrics::ScopedLatencyRecorder recorder(FlattenLatency());
+        ZETASQL_RETURN_IF_ERROR(FlattenNonDeleteOpRow(
+            resolved_mutation_op.type, resolved_mutation_op.table,
+            resolved_mutation_op.columns,
+            std::move(resolved_mutation_op.keys[i]),
+            std::move(resolved_mutation_op.rows[i]), transaction_store_.get(),
+            &write_ops));
+      }
 
-    // Apply to transaction store.
-    ZETASQL_RETURN_IF_ERROR(transaction_store_->BufferWriteOp(write_op));
+      ZETASQL_RETURN_IF_ERROR(ProcessWriteOps(std::move(write_ops)));
+    }
   }
   return absl::OkStatus();
 }
 
+absl::Status ReadWriteTransaction::ProcessCoalescedMutation(
+    const Mutation& mutation) {
+  mu_.AssertHeld();
+
+  // Rows written by runs of inserts and updates, in the order in which they
+  // were first written, and the position of each row in `rows`.
+  std::vector<CoalescedRow> rows;
+  std::map<std::pair<const Table*, Key>, int> row_positions;
+  auto process_rows = [&]() -> absl::Status {
+    std::vector<WriteOp> write_ops;
+    write_ops.reserve(rows.size());
+    {
+      metrics::ScopedLatencyRecorder recorder(FlattenLatency());
+      for (CoalescedRow& row : rows) {
+        ZETASQL_RETURN_IF_ERROR(FlattenNonDeleteOpRow(
+            row.type, row.table, row.columns, std::move(row.key),
+            std::move(row.values), transaction_store_.get(), &write_ops));
+      }
+    }
+    rows.clear();
+    row_positions.clear();
+    return ProcessWriteOps(std::move(write_ops));
+  };
+
+  const absl::Time now = clock_->NowForRead();
+  for (const MutationOp& mutation_op : mutation.ops()) {
+    ZETASQL_ASSIGN_OR_RETURN(ResolvedMutationOp resolved_mutation_op,
+                     TimedResolveMutationOp(mutation_op, schema_, now));
+    if (resolved_mutation_op.type != MutationOpType::kDelete) {
+      ZETASQL_RETURN_IF_ERROR(CheckMemoryBudget());
+    }
+
+    // Deletes and replaces remove rows, and with them the interleaved rows of
+    // child tables, so the operations before them cannot move past them.
+    if (resolved_mutation_op.type == MutationOpType::kDelete ||
+        resolved_mutation_op.type == MutationOpType::kReplace) {
+      ZETASQL_RETURN_IF_ERROR(process_rows());
+      ZETASQL_RETURN_IF_ERROR(
+          ProcessResolvedMutationOp(std::move(resolved_mutation_op)));
+      continue;
+    }
+
+    // Inserts and updates of rows in between do not affect each other, and
+    // their rows do not depend on the order in which they are processed.
+    for (int i = 0; i < resolved_mutation_op.rows.size(); ++i) {
+      Key& key = resolved_mutation_op.keys[i];
+      auto [it, inserted] = row_positions.try_emplace(
+          std::make_pair(resolved_mutation_op.table, key), rows.size());
+      if (!inserted) {
+        ZETASQL_ASSIGN_OR_RETURN(
+            bool merged,
+            MergeIntoRow(resolved_mutation_op.type,
+                         resolved_mutation_op.columns,
+                         &resolved_mutation_op.rows[i], clock_,
+                         &rows[it->second]));
+        if (merged) {
+          continue;
+        }
+        it->second = rows.size();
+      }
+      rows.push_back(CoalescedRow{resolved_mutation_op.type,
+                                  resolved_mutation_op.table, std::move(key),
+                                  resolved_mutation_op.columns,
+                                  std::move(resolved_mutation_op.rows[i])});
+    }
+  }
+  return process_rows();
+}
+
 absl::Status ReadWriteTransaction::Write(const Mutation& mutation) {
   return GuardedCall(OpType::kWrite, [&]() -> absl::Status {
     mu_.AssertHeld();
+    ZETASQL_RETURN_IF_ERROR(ProcessMutation(mutation));
+    return ApplyStatementVerifiers();
+  });
+}
 
-    for (const MutationOp& mutation_op : mutation.ops()) {
-      ZETASQL_ASSIGN_OR_RETURN(ResolvedMutationOp resolved_mutation_op,
-                       ResolveMutationOp(mutation_op, schema_, clock_->Now()));
-      // Process Delete.
-      if (resolved_mutation_op.type == MutationOpType::kDelete) {
-        ZETASQL_ASSIGN_OR_RETURN(std::vector<WriteOp> write_ops,
-                         FlattenDeleteOp(resolved_mutation_op.table,
-                                         resolved_mutation_op.key_ranges,
-                                         transaction_store_.get()));
-
-        ZETASQL_RETURN_IF_ERROR(ProcessWriteOps(write_ops));
-      } else {
-        // Process Insert, Update, Replace and InsertOrUpdate.
-        for (int i = 0; i < resolved_mutation_op.rows.size(); i++) {
-          ZETASQL_ASSIGN_OR_RETURN(
-              std::vector<WriteOp> write_ops,
-              FlattenNonDeleteOpRow(
-                  resolved_mutation_op.type, resolved_mutation_op.table,
-                  resolved_mutation_op.columns, resolved_mutation_op.keys[i],
-                  resolved_mutation_op.rows[i], transaction_store_.get()));
-
-          ZETASQL_RETURN_IF_ERROR(ProcessWriteOps(write_ops));
-        }
-      }
+absl::Status ReadWriteTransaction::WriteCoalesced(const Mutation& mutation) {
+  return GuardedCall(OpType::kWrite, [&]() -> absl::Status {
+    mu_.AssertHeld();
+    ZETASQL_RETURN_IF_ERROR(ProcessCoalescedMutation(mutation));
+    return ApplyStatementVerifiers();
+  });
+}
+
+absl::Status ReadWriteTransaction::WriteBatch(const Mutation& mutation,
+                                              bool last_batch) {
+  return GuardedCall(OpType::kWrite, [&]() -> absl::Status {
+    mu_.AssertHeld();
+    ZETASQL_RETURN_IF_ERROR(ProcessMutation(mutation));
+    if (!last_batch) {
+      return absl::OkStatus();
     }
     return ApplyStatementVerifiers();
   });
 }
 
 absl::Status ReadWriteTransaction::Commit() {
+  trace::ScopedSpan span("Commit");
   return GuardedCall(OpType::kCommit, [&]() -> absl::Status {
     mu_.AssertHeld();
 
@@ -356,15 +813,48 @@ absl::Status ReadWriteTransaction::Commit() {
       return error::AbortReadWriteTransactionOnFirstCommit(id_);
     }
 
-    // Pick a commit timestamp.
-    ZETASQL_ASSIGN_OR_RETURN(commit_timestamp_, lock_handle_->ReserveCommitTimestamp());
+    // The buffered mutations are not needed once flushed, so they are moved
+    // out of the store.
+    std::vector<CommitTimestampSlot> commit_timestamp_slots;
+    ZETASQL_ASSIGN_OR_RETURN(
+        std::vector<WriteOp> write_ops,
+        transaction_store_->TakeBufferedOps(&commit_timestamp_slots));
+    if (commit_pipeline_ != nullptr) {
+      // The pipeline picks the commit timestamp and writes the mutations to
+      // the base storage, together with those of concurrent commits. It also
+      // validates the reads of an optimistic transaction.
+      ZETASQL_ASSIGN_OR_RETURN(
+          commit_timestamp_,
+          commit_pipeline_->Commit(lock_handle_.get(), std::move(write_ops),
+                                   std::move(commit_timestamp_slots),
+                                   read_set_.empty() ? nullptr : &read_set_));
+    } else {
+      // Pick a commit timestamp.
+      ZETASQL_ASSIGN_OR_RETURN(commit_timestamp_,
+                       lock_handle_->ReserveCommitTimestamp());
+
+      // Validate the reads of an optimistic transaction once the commits
+      // before this one are flushed.
+      if (!read_set_.empty()) {
+        lock_handle_->WaitForSafeRead(commit_timestamp_);
+        zetasql_base::StatusOr<bool> conflicts =
+            read_set_.Conflicts(*base_storage_, WrittenRows());
+        if (!conflicts.ok() || conflicts.ValueOrDie()) {
+          ZETASQL_RETURN_IF_ERROR(lock_handle_->MarkCommitted());
+          return conflicts.ok() ? error::AbortDueToConflictingReads(id_)
+                                : conflicts.status();
+        }
+      }
 
-    // Write the mutations to the base storage.
-    absl::Status flush_status = FlushWriteOpsToStorage(
-        transaction_store_->GetBufferedOps(), base_storage_, commit_timestamp_);
-    ZETASQL_RETURN_IF_ERROR(lock_handle_->MarkCommitted());
-    if (!flush_status.ok()) {
-      return flush_status;
+      // Write the mutations to the base storage.
+      ResolveCommitTimestamps(commit_timestamp_slots, commit_timestamp_,
+                              &write_ops);
+      absl::Status flush_status = FlushWriteOpsToStorage(
+          write_ops, base_storage_, commit_timestamp_, commit_log_);
+      ZETASQL_RETURN_IF_ERROR(lock_handle_->MarkCommitted());
+      if (!flush_status.ok()) {
+        return flush_status;
+      }
     }
 
     // Mark the transaction as committed.
@@ -392,6 +882,32 @@ absl::Status ReadWriteTransaction::Rollback() {
   });
 }
 
+absl::Time ReadWriteTransaction::AbortIfIdle(absl::Duration max_idle_time) {
+  const absl::Time now = absl::Now();
+  // An operation in progress holds the mutex.
+  if (!mu_.TryLock()) {
+    return now + max_idle_time;
+  }
+  absl::Time deadline = last_active_time_ + max_idle_time;
+  switch (state_) {
+    case State::kUninitialized:
+      break;
+    case State::kActive:
+      if (deadline <= now) {
+        lock_handle_->Expire(error::AbortIdleTransaction(id_, max_idle_time));
+        deadline = now + max_idle_time;
+      }
+      break;
+    case State::kCommitted:
+    case State::kRolledback:
+    case State::kInvalid:
+      deadline = absl::InfiniteFuture();
+      break;
+  }
+  mu_.Unlock();
+  return deadline;
+}
+
 absl::Status ReadWriteTransaction::Invalidate() {
   return GuardedCall(OpType::kInvalidate, [&]() -> absl::Status {
     mu_.AssertHeld();
@@ -17,12 +17,15 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_READ_WRITE_TRANSACTION_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_READ_WRITE_TRANSACTION_H_
 
+#include <cstdint>
 #include <memory>
 #include <queue>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/status/status.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "backend/access/read.h"
 #include "backend/access/write.h"
@@ -37,7 +40,12 @@
 #include "backend/schema/catalog/versioned_catalog.h"
 #include "backend/storage/storage.h"
 #include "backend/transaction/actions.h"
+#include "backend/transaction/commit_log.h"
+#include "backend/transaction/commit_pipeline.h"
+#include "backend/transaction/memory_budget.h"
 #include "backend/transaction/options.h"
+#include "backend/transaction/read_set.h"
+#include "backend/transaction/resolve.h"
 #include "backend/transaction/transaction_store.h"
 #include "common/clock.h"
 #include "absl/status/status.h"
@@ -77,7 +85,12 @@ class ReadWriteTransaction : public RowReader, public RowWriter {
                        TransactionID transaction_id, Clock* clock,
                        Storage* storage, LockManager* lock_manager,
                        const VersionedCatalog* const versioned_catalog,
-                       ActionManager* action_manager);
+                       ActionManager* action_manager,
+                       CommitLog* commit_log = nullptr,
+                       CommitPipeline* commit_pipeline = nullptr,
+                       MemoryBudget* memory_budget = nullptr);
+
+  ~ReadWriteTransaction();
 
   absl::Status Read(const ReadArg& read_arg,
                     std::unique_ptr<RowCursor>* cursor) override
@@ -86,12 +99,32 @@ class ReadWriteTransaction : public RowReader, public RowWriter {
   absl::Status Write(const Mutation& mutation) override
       ABSL_LOCKS_EXCLUDED(mu_);
 
+  absl::Status WriteBatch(const Mutation& mutation, bool last_batch) override
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Writes `mutation` like Write, but first coalesces the inserts and updates
+  // of the mutation on the same row, so that the actions run once per row and
+  // over longer batches. Only for use when nothing observes the transaction
+  // between the operations of the mutation, such as for the mutations of a
+  // commit request. If several operations fail, the error reported may not be
+  // that of the first of them.
+  absl::Status WriteCoalesced(const Mutation& mutation)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
   absl::Status Commit() ABSL_LOCKS_EXCLUDED(mu_);
 
   absl::Status Rollback() ABSL_LOCKS_EXCLUDED(mu_);
 
   absl::Status Invalidate() ABSL_LOCKS_EXCLUDED(mu_);
 
+  // Aborts the transaction, releasing its locks, if no operation ran on it for
+  // longer than `max_idle_time`. Transactions which are committing, or with
+  // an operation in progress, are not idle. The transaction finds out that it
+  // was aborted on its next operation, which fails with ABORTED. Returns the
+  // time at which the transaction may next be idle for too long, or
+  // absl::InfiniteFuture() once it is committed, rolled back or invalidated.
+  absl::Time AbortIfIdle(absl::Duration max_idle_time) ABSL_LOCKS_EXCLUDED(mu_);
+
   zetasql_base::StatusOr<absl::Time> GetCommitTimestamp() ABSL_LOCKS_EXCLUDED(mu_);
 
   const State state() const ABSL_LOCKS_EXCLUDED(mu_) {
@@ -125,11 +158,41 @@ class ReadWriteTransaction : public RowReader, public RowWriter {
 
   absl::Status GuardedCall(OpType op, const std::function<absl::Status()>& fn)
       ABSL_LOCKS_EXCLUDED(mu_);
-  absl::Status ProcessWriteOps(const std::vector<WriteOp>& write_ops);
+  // Processes `write_ops`, and the operations their effectors add, in order.
+  // The operations are moved through the queue into the transaction store, so
+  // their keys and values are never copied.
+  absl::Status ProcessWriteOps(std::vector<WriteOp> write_ops);
+
+  // Flattens the operations of the mutation and processes them, without
+  // applying the statement verifiers.
+  absl::Status ProcessMutation(const Mutation& mutation);
+
+  // Flattens a single resolved operation of a mutation and processes it.
+  absl::Status ProcessResolvedMutationOp(
+      ResolvedMutationOp resolved_mutation_op);
+
+  // Like ProcessMutation, but coalesces the inserts and updates of the
+  // mutation on the same row before processing them.
+  absl::Status ProcessCoalescedMutation(const Mutation& mutation);
+
+  // Processes a single operation: applies the validators and effectors, and
+  // buffers the operation in the transaction store.
+  absl::Status ProcessWriteOp(WriteOp write_op);
+
+  // Processes a batch of operations of the same type on the same table with
+  // distinct keys, executing each action over the whole batch at once.
+  absl::Status ProcessWriteOpBatch(std::vector<WriteOp> batch);
 
   // Resets the transaction and marks it Active.
   void Reset();
 
+  // Reports the change in the size of the buffered mutations since the last
+  // report to the memory budget.
+  void ReportBufferedBytes();
+
+  // Returns RESOURCE_EXHAUSTED if the database exceeds its memory budget.
+  absl::Status CheckMemoryBudget();
+
   // Apply the constraint checks and effects to the writes.
   absl::Status ApplyValidators(const WriteOp& op);
   absl::Status ApplyEffectors(const WriteOp& op);
@@ -166,11 +229,34 @@ class ReadWriteTransaction : public RowReader, public RowWriter {
   // semantics.
   std::unique_ptr<TransactionStore> transaction_store_;
 
+  // Rows read by the transaction, recorded by transaction_store_ instead of
+  // locking them if the transaction is optimistic, and validated at commit.
+  ReadSet read_set_ ABSL_GUARDED_BY(mu_);
+
   // Action Manager for the transaction.
   ActionManager* action_manager_;
-  ActionRegistry* action_registry_;
+
+  // Action registry for the schema of the transaction. Shared with other
+  // transactions on the same schema.
+  std::shared_ptr<ActionRegistry> action_registry_;
   std::unique_ptr<ActionContext> action_context_;
 
+  // Log to which committed mutations are appended before they are flushed to
+  // storage. May be null.
+  CommitLog* commit_log_;
+
+  // Pipeline through which the transaction is committed together with other
+  // concurrently committing transactions. May be null, in which case the
+  // transaction commits on its own.
+  CommitPipeline* commit_pipeline_;
+
+  // Budget of the memory held by the database, which the buffered mutations
+  // are accounted against. May be null, in which case memory is not limited.
+  MemoryBudget* memory_budget_;
+
+  // Size of the buffered mutations last reported to the memory budget.
+  int64_t reported_bytes_ ABSL_GUARDED_BY(mu_) = 0;
+
   // The commit timestamp chosen for this transaction.
   absl::Time commit_timestamp_ ABSL_GUARDED_BY(mu_);
 
@@ -180,6 +266,10 @@ class ReadWriteTransaction : public RowReader, public RowWriter {
   // The state of this transaction.
   State state_ ABSL_GUARDED_BY(mu_) = State::kUninitialized;
 
+  // The time at which the transaction was created or its last operation
+  // completed.
+  absl::Time last_active_time_ ABSL_GUARDED_BY(mu_) = absl::Now();
+
   // The schema that is in effect at the timestamp picked for this transaction.
   const Schema* schema_ ABSL_GUARDED_BY(mu_);
 };
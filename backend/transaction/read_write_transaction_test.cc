@@ -16,6 +16,7 @@
 
 #include "backend/transaction/read_write_transaction.h"
 
+#include <cstdint>
 #include <functional>
 #include <thread>  // NOLINT
 #include <vector>
@@ -26,6 +27,7 @@
 #include "tests/common/proto_matchers.h"
 #include "absl/status/status.h"
 #include "zetasql/base/statusor.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "backend/access/write.h"
 #include "backend/actions/manager.h"
@@ -37,8 +39,10 @@
 #include "backend/schema/catalog/versioned_catalog.h"
 #include "backend/storage/in_memory_storage.h"
 #include "backend/transaction/actions.h"
+#include "backend/transaction/memory_budget.h"
 #include "backend/transaction/options.h"
 #include "common/clock.h"
+#include "common/errors.h"
 #include "tests/common/schema_constructor.h"
 #include "absl/status/status.h"
 
@@ -50,6 +54,7 @@ namespace {
 
 using zetasql::values::Int64;
 using zetasql::values::String;
+using zetasql::values::Timestamp;
 using zetasql_base::testing::StatusIs;
 
 class ReadWriteTransactionTest : public testing::Test {
@@ -70,6 +75,13 @@ class ReadWriteTransactionTest : public testing::Test {
                 )",
                               R"(
                   CREATE UNIQUE INDEX test_index ON test_table(string_col DESC)
+                )",
+                              R"(
+                  CREATE TABLE commit_timestamp_table (
+                    int64_col INT64 NOT NULL,
+                    timestamp_col TIMESTAMP
+                        OPTIONS (allow_commit_timestamp = true)
+                  ) PRIMARY KEY (int64_col)
                 )"},
                           type_factory_.get())
                           .ValueOrDie()))),
@@ -93,9 +105,10 @@ class ReadWriteTransactionTest : public testing::Test {
   // Counter to generate TransactionID.
   std::atomic<int> id_counter_ = 0;
 
-  std::unique_ptr<ReadWriteTransaction> CreateReadWriteTransaction() {
+  std::unique_ptr<ReadWriteTransaction> CreateReadWriteTransaction(
+      const ReadWriteOptions& options = ReadWriteOptions()) {
     return absl::make_unique<ReadWriteTransaction>(
-        ReadWriteOptions(), RetryState(), ++id_counter_, &clock_,
+        options, RetryState(), ++id_counter_, &clock_,
         storage_.get(), lock_manager_.get(), versioned_catalog_.get(),
         action_manager_.get());
   }
@@ -135,6 +148,32 @@ class ReadWriteTransactionTest : public testing::Test {
   auto IsOkAndHoldsRows(const std::vector<ValueList>& rows) {
     return zetasql_base::testing::IsOkAndHolds(testing::ElementsAreArray(rows));
   }
+
+  // Draws timestamps from the clock until it runs a second ahead of the
+  // system clock, so that it only moves while the test runs if timestamps are
+  // drawn from it. Returns the last timestamp handed out.
+  absl::Time MoveClockAheadOfSystemClock() {
+    absl::Time now;
+    do {
+      for (int i = 0; i < 1000; ++i) {
+        now = clock_.Now();
+      }
+    } while (now < absl::Now() + absl::Seconds(1));
+    return now;
+  }
+
+  // Returns a mutation inserting a row of commit_timestamp_table for each of
+  // `timestamps`, one mutation op per row, with keys from `first_key` on.
+  Mutation InsertTimestamps(int64_t first_key,
+                            const std::vector<absl::Time>& timestamps) {
+    Mutation m;
+    for (int i = 0; i < timestamps.size(); ++i) {
+      m.AddWriteOp(MutationOpType::kInsert, "commit_timestamp_table",
+                   {"int64_col", "timestamp_col"},
+                   {{Int64(first_key + i), Timestamp(timestamps[i])}});
+    }
+    return m;
+  }
 };
 
 TEST_F(ReadWriteTransactionTest, CanReadAfterFlush) {
@@ -277,7 +316,7 @@ TEST_F(ReadWriteTransactionTest, CommitWithMultipleChangesToDatabase) {
 }
 
 TEST_F(ReadWriteTransactionTest,
-       ConcurrentReadWriteTransactionsReturnsAborted) {
+       ConflictingReadWriteTransactionsReturnsAborted) {
   // Started "writes" on first transaction.
   Mutation m1;
   m1.AddWriteOp(MutationOpType::kInsert, "test_table",
@@ -286,12 +325,12 @@ TEST_F(ReadWriteTransactionTest,
   auto txn1 = CreateReadWriteTransaction();
   ZETASQL_EXPECT_OK(txn1->Write(m1));
 
-  // Before commiting first transaction, starting another transaction is in
-  // progress. Write for second transaction should consistently ABORT.
+  // Before commiting first transaction, another transaction writes to the same
+  // row. Write for second transaction should consistently ABORT.
   auto txn2 = CreateReadWriteTransaction();
   Mutation m2;
-  m2.AddWriteOp(MutationOpType::kInsert, "test_table",
-                {"int64_col", "string_col"}, {{Int64(2), String("value-2")}});
+  m2.AddWriteOp(MutationOpType::kInsertOrUpdate, "test_table",
+                {"int64_col", "string_col"}, {{Int64(1), String("value-2")}});
   for (int i = 0; i < 5; i++) {
     EXPECT_THAT(txn2->Write(m2), StatusIs(absl::StatusCode::kAborted));
   }
@@ -306,6 +345,121 @@ TEST_F(ReadWriteTransactionTest,
   EXPECT_EQ(txn2->state(), ReadWriteTransaction::State::kCommitted);
 }
 
+TEST_F(ReadWriteTransactionTest, DisjointReadWriteTransactionsBothCommit) {
+  auto txn1 = CreateReadWriteTransaction();
+  Mutation m1;
+  m1.AddWriteOp(MutationOpType::kInsert, "test_table",
+                {"int64_col", "string_col"}, {{Int64(1), String("value-1")}});
+  ZETASQL_EXPECT_OK(txn1->Write(m1));
+
+  // A concurrent transaction writing a different row does not conflict.
+  auto txn2 = CreateReadWriteTransaction();
+  Mutation m2;
+  m2.AddWriteOp(MutationOpType::kInsert, "test_table",
+                {"int64_col", "string_col"}, {{Int64(2), String("value-2")}});
+  ZETASQL_EXPECT_OK(txn2->Write(m2));
+
+  ZETASQL_EXPECT_OK(txn2->Commit());
+  ZETASQL_EXPECT_OK(txn1->Commit());
+
+  auto txn3 = CreateReadWriteTransaction();
+  EXPECT_THAT(ReadAll(txn3.get(), {"int64_col", "string_col"}),
+              IsOkAndHoldsRows({{Int64(1), String("value-1")},
+                                {Int64(2), String("value-2")}}));
+}
+
+TEST_F(ReadWriteTransactionTest, ReadRangeConflictsWithConcurrentInsert) {
+  // The first transaction scans the whole table.
+  auto txn1 = CreateReadWriteTransaction();
+  EXPECT_THAT(ReadAll(txn1.get(), {"int64_col"}), IsOkAndHoldsRows({}));
+
+  // An insert into the scanned range by a younger transaction is aborted.
+  auto txn2 = CreateReadWriteTransaction();
+  Mutation m;
+  m.AddWriteOp(MutationOpType::kInsert, "test_table",
+               {"int64_col", "string_col"}, {{Int64(1), String("value")}});
+  EXPECT_THAT(txn2->Write(m), StatusIs(absl::StatusCode::kAborted));
+}
+
+TEST_F(ReadWriteTransactionTest, OptimisticReadsAreValidatedAtCommit) {
+  ReadWriteOptions optimistic;
+  optimistic.concurrency_mode = ConcurrencyMode::kOptimistic;
+
+  // The first transaction scans the whole table without locking it.
+  auto txn1 = CreateReadWriteTransaction(optimistic);
+  EXPECT_THAT(ReadAll(txn1.get(), {"int64_col"}), IsOkAndHoldsRows({}));
+
+  // So an insert into the scanned range by a younger transaction commits.
+  auto txn2 = CreateReadWriteTransaction();
+  Mutation m1;
+  m1.AddWriteOp(MutationOpType::kInsert, "test_table",
+                {"int64_col", "string_col"}, {{Int64(1), String("value-1")}});
+  ZETASQL_EXPECT_OK(txn2->Write(m1));
+  ZETASQL_EXPECT_OK(txn2->Commit());
+
+  // The first transaction then fails to commit, as its scan missed the row.
+  Mutation m2;
+  m2.AddWriteOp(MutationOpType::kInsert, "test_table",
+                {"int64_col", "string_col"}, {{Int64(2), String("value-2")}});
+  ZETASQL_EXPECT_OK(txn1->Write(m2));
+  EXPECT_THAT(txn1->Commit(), StatusIs(absl::StatusCode::kAborted));
+
+  // Once retried, it sees the row and commits.
+  EXPECT_THAT(ReadAll(txn1.get(), {"int64_col"}),
+              IsOkAndHoldsRows({{Int64(1)}}));
+  ZETASQL_EXPECT_OK(txn1->Write(m2));
+  ZETASQL_EXPECT_OK(txn1->Commit());
+}
+
+TEST_F(ReadWriteTransactionTest, DisjointOptimisticTransactionsBothCommit) {
+  ReadWriteOptions optimistic;
+  optimistic.concurrency_mode = ConcurrencyMode::kOptimistic;
+
+  // Each transaction reads the row it then inserts.
+  auto txn1 = CreateReadWriteTransaction(optimistic);
+  auto txn2 = CreateReadWriteTransaction(optimistic);
+  EXPECT_THAT(ReadUsingIndex(txn1.get(), KeySet(Key({Int64(1)})), "",
+                             {"int64_col"}),
+              IsOkAndHoldsRows({}));
+  EXPECT_THAT(ReadUsingIndex(txn2.get(), KeySet(Key({Int64(2)})), "",
+                             {"int64_col"}),
+              IsOkAndHoldsRows({}));
+
+  Mutation m1;
+  m1.AddWriteOp(MutationOpType::kInsert, "test_table",
+                {"int64_col", "string_col"}, {{Int64(1), String("value-1")}});
+  Mutation m2;
+  m2.AddWriteOp(MutationOpType::kInsert, "test_table",
+                {"int64_col", "string_col"}, {{Int64(2), String("value-2")}});
+  ZETASQL_EXPECT_OK(txn1->Write(m1));
+  ZETASQL_EXPECT_OK(txn2->Write(m2));
+  ZETASQL_EXPECT_OK(txn2->Commit());
+  ZETASQL_EXPECT_OK(txn1->Commit());
+}
+
+TEST_F(ReadWriteTransactionTest, IdleTransactionIsAbortedAndReleasesLocks) {
+  auto txn1 = CreateReadWriteTransaction();
+  EXPECT_THAT(ReadAll(txn1.get(), {"int64_col"}), IsOkAndHoldsRows({}));
+
+  // Not idle for long enough yet.
+  EXPECT_GT(txn1->AbortIfIdle(absl::Hours(1)), absl::Now());
+  EXPECT_EQ(txn1->state(), ReadWriteTransaction::State::kActive);
+
+  // Once aborted, the first transaction no longer blocks the second one, and
+  // finds out that it was aborted on its next operation.
+  EXPECT_NE(txn1->AbortIfIdle(absl::ZeroDuration()), absl::InfiniteFuture());
+  auto txn2 = CreateReadWriteTransaction();
+  Mutation m;
+  m.AddWriteOp(MutationOpType::kInsert, "test_table",
+               {"int64_col", "string_col"}, {{Int64(1), String("value")}});
+  ZETASQL_EXPECT_OK(txn2->Write(m));
+  ZETASQL_EXPECT_OK(txn2->Commit());
+  EXPECT_THAT(txn1->Commit(), StatusIs(absl::StatusCode::kAborted));
+
+  // Committed transactions are never idle.
+  EXPECT_EQ(txn2->AbortIfIdle(absl::ZeroDuration()), absl::InfiniteFuture());
+}
+
 TEST_F(ReadWriteTransactionTest, ConcurrentTransactionsEventuallySucceed) {
   // Start n threads each doing a transactional increment k times.
   int n = 20;
@@ -627,6 +781,151 @@ TEST_F(ReadWriteTransactionTest, IndexUniquenessFailTest) {
   EXPECT_THAT(txn->Write(m), StatusIs(absl::StatusCode::kAlreadyExists));
 }
 
+TEST_F(ReadWriteTransactionTest, CoalescedWritesToSameRowAreMerged) {
+  Mutation m;
+  m.AddWriteOp(MutationOpType::kInsert, "test_table",
+               {"int64_col", "string_col"}, {{Int64(3), String("value")}});
+  m.AddWriteOp(MutationOpType::kUpdate, "test_table",
+               {"int64_col", "string_col"}, {{Int64(3), String("new-value")}});
+  m.AddWriteOp(MutationOpType::kInsertOrUpdate, "test_table",
+               {"int64_col", "int64_val_col"}, {{Int64(3), Int64(7)}});
+
+  auto txn1 = CreateReadWriteTransaction();
+  ZETASQL_EXPECT_OK(txn1->WriteCoalesced(m));
+  ZETASQL_EXPECT_OK(txn1->Commit());
+
+  auto txn2 = CreateReadWriteTransaction();
+  EXPECT_THAT(ReadAll(txn2.get(), {"int64_col", "string_col", "int64_val_col"}),
+              IsOkAndHoldsRows({{Int64(3), String("new-value"), Int64(7)}}));
+  EXPECT_THAT(
+      ReadAllUsingIndex(txn2.get(), "test_index", {"string_col", "int64_col"}),
+      IsOkAndHoldsRows({{String("new-value"), Int64(3)}}));
+}
+
+TEST_F(ReadWriteTransactionTest, CoalescedWritesKeepExistenceChecks) {
+  Mutation insert_twice;
+  insert_twice.AddWriteOp(MutationOpType::kInsertOrUpdate, "test_table",
+                          {"int64_col"}, {{Int64(1)}});
+  insert_twice.AddWriteOp(MutationOpType::kInsert, "test_table",
+                          {"int64_col"}, {{Int64(1)}});
+  auto txn1 = CreateReadWriteTransaction();
+  EXPECT_THAT(txn1->WriteCoalesced(insert_twice),
+              StatusIs(absl::StatusCode::kAlreadyExists));
+
+  Mutation update_missing;
+  update_missing.AddWriteOp(MutationOpType::kUpdate, "test_table",
+                            {"int64_col"}, {{Int64(2)}});
+  update_missing.AddWriteOp(MutationOpType::kInsertOrUpdate, "test_table",
+                            {"int64_col"}, {{Int64(2)}});
+  auto txn2 = CreateReadWriteTransaction();
+  EXPECT_THAT(txn2->WriteCoalesced(update_missing),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST_F(ReadWriteTransactionTest, CoalescedWritesDoNotMovePastDeletes) {
+  Mutation m;
+  m.AddWriteOp(MutationOpType::kInsert, "test_table",
+               {"int64_col", "string_col"}, {{Int64(3), String("value")}});
+  m.AddDeleteOp("test_table", KeySet(Key({Int64(3)})));
+  m.AddWriteOp(MutationOpType::kInsert, "test_table",
+               {"int64_col", "string_col"}, {{Int64(3), String("new-value")}});
+
+  auto txn1 = CreateReadWriteTransaction();
+  ZETASQL_EXPECT_OK(txn1->WriteCoalesced(m));
+  ZETASQL_EXPECT_OK(txn1->Commit());
+
+  auto txn2 = CreateReadWriteTransaction();
+  EXPECT_THAT(ReadAll(txn2.get(), {"int64_col", "string_col"}),
+              IsOkAndHoldsRows({{Int64(3), String("new-value")}}));
+}
+
+TEST_F(ReadWriteTransactionTest, ReportsBufferedBytesToMemoryBudget) {
+  MemoryBudget budget(storage_.get(), /*limit_bytes=*/0);
+  auto txn = absl::make_unique<ReadWriteTransaction>(
+      ReadWriteOptions(), RetryState(), ++id_counter_, &clock_, storage_.get(),
+      lock_manager_.get(), versioned_catalog_.get(), action_manager_.get(),
+      /*commit_log=*/nullptr, /*commit_pipeline=*/nullptr, &budget);
+  Mutation m;
+  m.AddWriteOp(MutationOpType::kInsert, "test_table",
+               {"int64_col", "string_col"}, {{Int64(1), String("value")}});
+  ZETASQL_EXPECT_OK(txn->Write(m));
+  EXPECT_GT(budget.transaction_bytes(), 0);
+
+  // The buffered mutations are released once the transaction is destroyed.
+  txn.reset();
+  EXPECT_EQ(budget.transaction_bytes(), 0);
+}
+
+TEST_F(ReadWriteTransactionTest, RejectsInsertsIntoDatabaseOverMemoryBudget) {
+  MemoryBudget budget(storage_.get(), /*limit_bytes=*/1);
+  auto create_transaction = [&]() {
+    return absl::make_unique<ReadWriteTransaction>(
+        ReadWriteOptions(), RetryState(), ++id_counter_, &clock_,
+        storage_.get(), lock_manager_.get(), versioned_catalog_.get(),
+        action_manager_.get(), /*commit_log=*/nullptr,
+        /*commit_pipeline=*/nullptr, &budget);
+  };
+  Mutation insert;
+  insert.AddWriteOp(MutationOpType::kInsert, "test_table",
+                    {"int64_col", "string_col"}, {{Int64(1), String("value")}});
+  auto txn1 = create_transaction();
+  ZETASQL_EXPECT_OK(txn1->Write(insert));
+  ZETASQL_EXPECT_OK(txn1->Commit());
+
+  // The committed row exceeds the budget, so further inserts are rejected.
+  Mutation another_insert;
+  another_insert.AddWriteOp(MutationOpType::kInsert, "test_table",
+                            {"int64_col", "string_col"},
+                            {{Int64(2), String("value2")}});
+  auto txn2 = create_transaction();
+  EXPECT_THAT(txn2->Write(another_insert),
+              StatusIs(absl::StatusCode::kResourceExhausted));
+
+  // Deletes are still allowed.
+  Mutation remove;
+  remove.AddDeleteOp("test_table", KeySet(Key({Int64(1)})));
+  auto txn3 = create_transaction();
+  ZETASQL_EXPECT_OK(txn3->Write(remove));
+  ZETASQL_EXPECT_OK(txn3->Commit());
+}
+
+// Transactions draw their priority from the clock, so the tests below create
+// them before moving the clock ahead.
+
+TEST_F(ReadWriteTransactionTest, AcceptsTimestampsHandedOutByTheClock) {
+  auto txn1 = CreateReadWriteTransaction();
+  auto txn2 = CreateReadWriteTransaction();
+  absl::Time last_timestamp = MoveClockAheadOfSystemClock();
+
+  ZETASQL_EXPECT_OK(txn1->Write(InsertTimestamps(0, {last_timestamp})));
+  ZETASQL_EXPECT_OK(
+      txn2->WriteCoalesced(InsertTimestamps(1, {last_timestamp})));
+}
+
+TEST_F(ReadWriteTransactionTest, RejectsTimestampsPastTheClock) {
+  auto txn1 = CreateReadWriteTransaction();
+  auto txn2 = CreateReadWriteTransaction();
+  absl::Time future = MoveClockAheadOfSystemClock() + absl::Microseconds(1);
+
+  EXPECT_EQ(txn1->Write(InsertTimestamps(0, {future})),
+            error::CommitTimestampInFuture(future));
+  EXPECT_EQ(txn2->WriteCoalesced(InsertTimestamps(1, {future})),
+            error::CommitTimestampInFuture(future));
+}
+
+TEST_F(ReadWriteTransactionTest, WritesDoNotDrawTimestampsFromTheClock) {
+  auto txn1 = CreateReadWriteTransaction();
+  auto txn2 = CreateReadWriteTransaction();
+  absl::Time last_timestamp = MoveClockAheadOfSystemClock();
+
+  // All ops of a write are checked against one reading of the clock, which
+  // does not advance it: the next timestamp handed out follows the last one.
+  std::vector<absl::Time> timestamps(100, last_timestamp);
+  ZETASQL_EXPECT_OK(txn1->Write(InsertTimestamps(0, timestamps)));
+  ZETASQL_EXPECT_OK(txn2->WriteCoalesced(InsertTimestamps(100, timestamps)));
+  EXPECT_EQ(clock_.Now(), last_timestamp + absl::Microseconds(1));
+}
+
 }  // namespace
 }  // namespace backend
 }  // namespace emulator
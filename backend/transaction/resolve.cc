@@ -36,37 +36,34 @@ namespace backend {
 
 namespace {
 
-KeySet SetSortOrder(const Table* table, const KeySet& key_set) {
-  KeySet result_set;
-  for (auto& key : key_set.keys()) {
-    Key new_key(key);
-    // Set ascending and descending values for the keys.
-    for (int i = 0; i < new_key.NumColumns(); ++i) {
-      new_key.SetColumnDescending(i, table->primary_key()[i]->is_descending());
-    }
-    result_set.AddKey(new_key);
-  }
-
-  for (auto& range : key_set.ranges()) {
-    KeyRange new_range(range);
-    // Set ascending and descending values for the keys.
-    for (int i = 0; i < range.start_key().NumColumns(); ++i) {
-      new_range.start_key().SetColumnDescending(
-          i, table->primary_key()[i]->is_descending());
-    }
-    for (int i = 0; i < range.limit_key().NumColumns(); ++i) {
-      new_range.limit_key().SetColumnDescending(
-          i, table->primary_key()[i]->is_descending());
-    }
-    result_set.AddRange(new_range);
+// Sets the sort order of the columns of key to that of the table's primary
+// key.
+void SetSortOrder(const Table* table, Key* key) {
+  for (int i = 0; i < key->NumColumns(); ++i) {
+    key->SetColumnDescending(i, table->primary_key()[i]->is_descending());
   }
-  return result_set;
 }
 
+// Converts set to sorted, disjoint, closed-open key ranges ordered like the
+// table's primary key. Keys and ranges are converted directly into the output
+// and then sorted and merged together in one pass, so large sets of point keys
+// are canonicalized in O(n log n) time without intermediate copies.
 void CanonicalizeKeySetForTable(const KeySet& set, const Table* table,
                                 std::vector<KeyRange>* ranges) {
-  KeySet ordered_set = SetSortOrder(table, set);
-  MakeDisjointKeyRanges(ordered_set, ranges);
+  ranges->clear();
+  ranges->reserve(set.keys().size() + set.ranges().size());
+  for (const Key& key : set.keys()) {
+    Key ordered_key(key);
+    SetSortOrder(table, &ordered_key);
+    ranges->push_back(KeyRange::Point(ordered_key));
+  }
+  for (const KeyRange& range : set.ranges()) {
+    KeyRange ordered_range(range);
+    SetSortOrder(table, &ordered_range.start_key());
+    SetSortOrder(table, &ordered_range.limit_key());
+    ranges->push_back(ordered_range.ToClosedOpen());
+  }
+  MakeDisjointKeyRanges(ranges);
 }
 
 absl::Status ValidateColumnsAreNotDuplicate(
@@ -92,7 +89,9 @@ absl::Status ValidateNotNullColumnsPresent(
     }
   }
   for (const auto column : table->columns()) {
-    if (!column->is_nullable() && !inserted_columns.contains(column)) {
+    // The values of generated columns are computed, not written.
+    if (!column->is_nullable() && !column->is_generated() &&
+        !inserted_columns.contains(column)) {
       return error::NonNullValueNotSpecifiedForInsert(table->Name(),
                                                       column->Name());
     }
@@ -140,17 +139,32 @@ zetasql_base::StatusOr<std::vector<absl::optional<int>>> ExtractPrimaryKeyIndice
 Key ComputeKey(const ValueList& row,
                absl::Span<const KeyColumn* const> primary_key,
                const std::vector<absl::optional<int>>& key_indices) {
-  Key key;
+  std::vector<zetasql::Value> key_values;
+  key_values.reserve(primary_key.size());
   for (int i = 0; i < primary_key.size(); i++) {
-    key.AddColumn(
+    key_values.push_back(
         key_indices[i].has_value()
             ? row[key_indices[i].value()]
-            : zetasql::Value::Null(primary_key[i]->column()->GetType()),
-        primary_key[i]->is_descending());
+            : zetasql::Value::Null(primary_key[i]->column()->GetType()));
+  }
+  Key key(std::move(key_values));
+  for (int i = 0; i < primary_key.size(); i++) {
+    if (primary_key[i]->is_descending()) {
+      key.SetColumnDescending(i, true);
+    }
   }
   return key;
 }
 
+// Returns true if any of the columns can hold a commit timestamp, i.e. if
+// MaybeSetCommitTimestampSentinel may need to rewrite the values of a row.
+bool HasTimestampColumns(absl::Span<const Column* const> columns) {
+  for (const Column* column : columns) {
+    if (column->GetType()->IsTimestamp()) return true;
+  }
+  return false;
+}
+
 }  // namespace
 
 zetasql_base::StatusOr<ResolvedReadArg> ResolveReadArg(const ReadArg& read_arg,
@@ -207,6 +221,21 @@ zetasql_base::StatusOr<ResolvedReadArg> ResolveReadArg(const ReadArg& read_arg,
   return resolved_read_arg;
 }
 
+bool GetPointLookupKeys(const ResolvedReadArg& resolved_read_arg,
+                        std::vector<Key>* keys) {
+  keys->clear();
+  const int num_key_columns = resolved_read_arg.table->primary_key().size();
+  for (const KeyRange& key_range : resolved_read_arg.key_ranges) {
+    if (key_range.start_key().NumColumns() != num_key_columns ||
+        !(key_range.limit_key() == key_range.start_key().ToPrefixLimit())) {
+      keys->clear();
+      return false;
+    }
+    keys->push_back(key_range.start_key());
+  }
+  return true;
+}
+
 zetasql_base::StatusOr<ResolvedMutationOp> ResolveMutationOp(
     const MutationOp& mutation_op, const Schema* schema, absl::Time now) {
   const Table* table = schema->FindTable(mutation_op.table);
@@ -240,29 +269,48 @@ zetasql_base::StatusOr<ResolvedMutationOp> ResolveMutationOp(
 
     ZETASQL_ASSIGN_OR_RETURN(std::vector<const Column*> columns,
                      GetColumnsByName(table, mutation_op.columns));
+    for (const Column* column : columns) {
+      if (column->is_generated()) {
+        return error::CannotWriteToGeneratedColumn(table->Name(),
+                                                   column->Name());
+      }
+    }
 
     ZETASQL_ASSIGN_OR_RETURN(std::vector<absl::optional<int>> key_indices,
                      ExtractPrimaryKeyIndices(columns, table->primary_key()));
 
+    // Columns are resolved and validated once for the whole op rather than
+    // for each of its rows.
+    //
+    // Insert, InsertOrUpdate and Replace mutation ops require that all
+    // not-null columns be present in the mutation. Note: this check is
+    // specifically done before InsertOrUpdate & Replace mutation ops are
+    // flattened.
+    if (!mutation_op.rows.empty() &&
+        (mutation_op.type == MutationOpType::kInsert ||
+         mutation_op.type == MutationOpType::kInsertOrUpdate ||
+         mutation_op.type == MutationOpType::kReplace)) {
+      ZETASQL_RETURN_IF_ERROR(ValidateNotNullColumnsPresent(table, columns));
+    }
+    const bool has_timestamp_columns = HasTimestampColumns(columns);
+
+    resolved_mutation_op.rows.reserve(mutation_op.rows.size());
+    resolved_mutation_op.keys.reserve(mutation_op.rows.size());
     for (const ValueList& row : mutation_op.rows) {
       ZETASQL_RET_CHECK_EQ(row.size(), columns.size())
           << "MutationOp has difference in size of column and value vectors, "
              "mutation op: "
           << mutation_op.DebugString();
 
-      // Insert, InsertOrUpdate and Replace mutation ops require that all
-      // not-null columns be present in the mutation. Note: this check is
-      // specifically done before InsertOrUpdate & Replace mutation ops are
-      // flattened.
-      if (mutation_op.type == MutationOpType::kInsert ||
-          mutation_op.type == MutationOpType::kInsertOrUpdate ||
-          mutation_op.type == MutationOpType::kReplace) {
-        ZETASQL_RETURN_IF_ERROR(ValidateNotNullColumnsPresent(table, columns));
+      // Rows without timestamp columns never hold a commit timestamp, so they
+      // are copied as they are.
+      if (has_timestamp_columns) {
+        ZETASQL_ASSIGN_OR_RETURN(resolved_mutation_op.rows.emplace_back(),
+                         MaybeSetCommitTimestampSentinel(columns, row));
+      } else {
+        resolved_mutation_op.rows.push_back(row);
       }
 
-      ZETASQL_ASSIGN_OR_RETURN(resolved_mutation_op.rows.emplace_back(),
-                       MaybeSetCommitTimestampSentinel(columns, row));
-
       resolved_mutation_op.keys.push_back(ComputeKey(
           resolved_mutation_op.rows.back(), table->primary_key(), key_indices));
     }
@@ -72,6 +72,13 @@ struct ResolvedMutationOp {
 zetasql_base::StatusOr<ResolvedReadArg> ResolveReadArg(const ReadArg& read_arg,
                                                const Schema* schema);
 
+// Returns true if every key range of resolved_read_arg is a point range of a
+// whole primary key of the table, in which case keys is set to those keys in
+// sorted order. Such reads can be served by a single Storage::MultiLookup
+// instead of one Storage::Read per range.
+bool GetPointLookupKeys(const ResolvedReadArg& resolved_read_arg,
+                        std::vector<Key>* keys);
+
 // Converts input MutationOp into ResolvedMutationOp after validating that input
 // table, columns and rows are valid schema objects. Validates that user
 // supplied values for commit timestamp are not in future by comparing against
@@ -163,6 +163,24 @@ TEST_F(ResolveTest, CanResolveInsertMutationOp) {
               testing::ElementsAre(Key({Int64(1)}), Key({Int64(2)})));
 }
 
+TEST_F(ResolveTest, ResolvedMutationOpKeepsRowValuesInColumnOrder) {
+  backend::MutationOp mutation_op;
+  mutation_op.type = MutationOpType::kUpdate;
+  mutation_op.table = "TestTable";
+  mutation_op.columns = {"Int64ValCol", "Int64Col"};
+  mutation_op.rows = {{Int64(10), Int64(1)}, {Int64(20), Int64(2)}};
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      const ResolvedMutationOp& resolved_mutation_op,
+      ResolveMutationOp(mutation_op, schema_.get(), clock_.Now()));
+
+  EXPECT_THAT(resolved_mutation_op.rows,
+              testing::ElementsAre(ValueList{Int64(10), Int64(1)},
+                                   ValueList{Int64(20), Int64(2)}));
+  EXPECT_THAT(resolved_mutation_op.keys,
+              testing::ElementsAre(Key({Int64(1)}), Key({Int64(2)})));
+}
+
 TEST_F(ResolveTest, CannotResolveInsertMutationOpWithEmptyColumns) {
   backend::MutationOp mutation_op;
   mutation_op.type = MutationOpType::kInsert;
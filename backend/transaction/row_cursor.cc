@@ -16,18 +16,148 @@
 
 #include "backend/transaction/row_cursor.h"
 
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/value.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
 #include "backend/storage/iterator.h"
+#include "common/cancellation.h"
+#include "common/slow_log.h"
 
 namespace google {
 namespace spanner {
 namespace emulator {
 namespace backend {
 
+namespace {
+
+// Rows read by interleaved storage iterators, queued by table until the
+// cursor of their table reaches them.
+class InterleavedRowSource {
+ public:
+  InterleavedRowSource(
+      std::vector<std::unique_ptr<InterleavedStorageIterator>> iterators,
+      int num_tables)
+      : iterators_(std::move(iterators)), queued_rows_(num_tables) {}
+
+  // Moves the next row of the table with the given index into `values`,
+  // reading rows from the iterators until one of the table is found. Returns
+  // false if the iterators have no more rows of the table, or on error.
+  bool NextRow(int table_index, std::vector<zetasql::Value>* values) {
+    std::deque<std::vector<zetasql::Value>>& rows = queued_rows_[table_index];
+    while (rows.empty()) {
+      if (!ReadRow()) {
+        return false;
+      }
+    }
+    *values = std::move(rows.front());
+    rows.pop_front();
+    return true;
+  }
+
+  absl::Status Status() const { return status_; }
+
+ private:
+  // Queues the next row of the iterators for its table. Returns false once
+  // the iterators are exhausted, or on error.
+  bool ReadRow() {
+    while (current_ < iterators_.size()) {
+      InterleavedStorageIterator* itr = iterators_[current_].get();
+      if (itr->Next()) {
+        std::vector<zetasql::Value> values;
+        values.reserve(itr->NumColumns());
+        for (int i = 0; i < itr->NumColumns(); ++i) {
+          values.push_back(itr->ColumnValue(i));
+        }
+        queued_rows_[itr->TableIndex()].push_back(std::move(values));
+        return true;
+      }
+      status_ = itr->Status();
+      if (!status_.ok()) {
+        return false;
+      }
+      ++current_;
+    }
+    return false;
+  }
+
+  const std::vector<std::unique_ptr<InterleavedStorageIterator>> iterators_;
+
+  // Index of the iterator being read in iterators_.
+  int current_ = 0;
+
+  // Rows read from the iterators and not yet returned, by table.
+  std::vector<std::deque<std::vector<zetasql::Value>>> queued_rows_;
+
+  // Status of the iterator which failed, if any.
+  absl::Status status_;
+};
+
+// InterleavedRowCursor returns the rows of one of the tables of an
+// InterleavedRowSource.
+class InterleavedRowCursor : public RowCursor {
+ public:
+  InterleavedRowCursor(std::shared_ptr<InterleavedRowSource> source,
+                       int table_index, std::vector<const Column*> columns)
+      : source_(std::move(source)),
+        table_index_(table_index),
+        columns_(std::move(columns)) {}
+  ~InterleavedRowCursor() override { slow_log::AddRowsScanned(rows_scanned_); }
+
+  // Implementation of the RowCursor interface
+  bool Next() override {
+    if (!source_->NextRow(table_index_, &values_)) {
+      return false;
+    }
+    ++rows_scanned_;
+    return true;
+  }
+  absl::Status Status() const override { return source_->Status(); }
+  int NumColumns() const override { return columns_.size(); }
+  const std::string ColumnName(int i) const override {
+    return columns_.at(i)->Name();
+  }
+  const zetasql::Value ColumnValue(int i) const override {
+    // Storage returns invalid values for columns without a value, which are
+    // read as NULL.
+    if (!values_.at(i).is_valid()) {
+      return zetasql::Value::Null(ColumnType(i));
+    }
+    return values_.at(i);
+  }
+  const zetasql::Type* ColumnType(int i) const override {
+    return columns_.at(i)->GetType();
+  }
+
+ private:
+  const std::shared_ptr<InterleavedRowSource> source_;
+  const int table_index_;
+  const std::vector<const Column*> columns_;
+
+  // Values of the current row.
+  std::vector<zetasql::Value> values_;
+
+  // Number of rows returned so far.
+  int64_t rows_scanned_ = 0;
+};
+
+}  // namespace
+
+StorageIteratorRowCursor::~StorageIteratorRowCursor() {
+  slow_log::AddRowsScanned(rows_scanned_);
+}
+
 bool StorageIteratorRowCursor::Next() {
   // Loop over underlying iterators until a Next value is obtained.
   while (current_ < iterators_.size()) {
     if (iterators_.at(current_)->Next()) {
       // Current iterator yeilded a next element.
+      ++rows_scanned_;
       return true;
     }
     if (iterators_.at(current_)->Status().ok()) {
@@ -66,6 +196,85 @@ const zetasql::Type* StorageIteratorRowCursor::ColumnType(int i) const {
   return columns_.at(i)->GetType();
 }
 
+bool StorageIteratorRowCursor::NextBatch(int max_rows, RowBatch* batch) {
+  batch->Reset(NumColumns());
+  while (batch->num_rows < max_rows && current_ < iterators_.size()) {
+    StorageIterator* itr = iterators_[current_].get();
+    if (!itr->NextBatch(max_rows - batch->num_rows, &storage_batch_)) {
+      if (!itr->Status().ok()) {
+        break;
+      }
+      // Current iterator is exhausted, try next iterator.
+      ++current_;
+      continue;
+    }
+    for (int i = 0; i < NumColumns(); ++i) {
+      // Storage returns invalid values for columns without a value, which are
+      // read as NULL.
+      for (zetasql::Value& value : storage_batch_.columns[i]) {
+        batch->AddValue(i, value.is_valid()
+                               ? std::move(value)
+                               : zetasql::Value::Null(ColumnType(i)));
+      }
+    }
+    batch->num_rows += storage_batch_.keys.size();
+  }
+  rows_scanned_ += batch->num_rows;
+  return batch->num_rows > 0;
+}
+
+std::vector<std::unique_ptr<RowCursor>> MakeInterleavedRowCursors(
+    std::vector<std::unique_ptr<InterleavedStorageIterator>> iterators,
+    std::vector<std::vector<const Column*>> columns) {
+  auto source = std::make_shared<InterleavedRowSource>(std::move(iterators),
+                                                       columns.size());
+  std::vector<std::unique_ptr<RowCursor>> cursors;
+  for (int i = 0; i < columns.size(); ++i) {
+    cursors.push_back(absl::make_unique<InterleavedRowCursor>(
+        source, i, std::move(columns[i])));
+  }
+  return cursors;
+}
+
+bool CancellableRowCursor::Next() {
+  if (!status_.ok()) {
+    return false;
+  }
+  status_ = check_.OnRow();
+  return status_.ok() && wrapped_cursor_->Next();
+}
+
+absl::Status CancellableRowCursor::Status() const {
+  return status_.ok() ? wrapped_cursor_->Status() : status_;
+}
+
+int CancellableRowCursor::NumColumns() const {
+  return wrapped_cursor_->NumColumns();
+}
+
+const std::string CancellableRowCursor::ColumnName(int i) const {
+  return wrapped_cursor_->ColumnName(i);
+}
+
+const zetasql::Value CancellableRowCursor::ColumnValue(int i) const {
+  return wrapped_cursor_->ColumnValue(i);
+}
+
+const zetasql::Type* CancellableRowCursor::ColumnType(int i) const {
+  return wrapped_cursor_->ColumnType(i);
+}
+
+bool CancellableRowCursor::NextBatch(int max_rows, RowBatch* batch) {
+  if (status_.ok()) {
+    status_ = check_.Check();
+  }
+  if (!status_.ok()) {
+    batch->Reset(NumColumns());
+    return false;
+  }
+  return wrapped_cursor_->NextBatch(max_rows, batch);
+}
+
 }  // namespace backend
 }  // namespace emulator
 }  // namespace spanner
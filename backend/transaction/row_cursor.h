@@ -17,9 +17,15 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_ROW_CURSOR_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_ROW_CURSOR_H_
 
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 #include "backend/access/read.h"
 #include "backend/schema/catalog/table.h"
 #include "backend/storage/in_memory_iterator.h"
+#include "backend/storage/iterator.h"
+#include "common/cancellation.h"
 
 namespace google {
 namespace spanner {
@@ -27,7 +33,8 @@ namespace emulator {
 namespace backend {
 
 // StorageIteratorRowCursor is an implementation of RowCursor that reads from
-// storage using an array of storage iterators.
+// storage using an array of storage iterators. The rows it returned are counted
+// as scanned by the request once it is destroyed.
 //
 // This class is not thread-safe.
 class StorageIteratorRowCursor : public RowCursor {
@@ -36,6 +43,7 @@ class StorageIteratorRowCursor : public RowCursor {
       std::vector<std::unique_ptr<StorageIterator>> iterators,
       std::vector<const Column*> columns)
       : iterators_(std::move(iterators)), columns_(std::move(columns)) {}
+  ~StorageIteratorRowCursor() override;
 
   // Implementation of the RowCursor interface
   bool Next() override;
@@ -44,17 +52,68 @@ class StorageIteratorRowCursor : public RowCursor {
   const std::string ColumnName(int i) const override;
   const zetasql::Value ColumnValue(int i) const override;
   const zetasql::Type* ColumnType(int i) const override;
+  bool NextBatch(int max_rows, RowBatch* batch) override;
 
  private:
   const std::vector<std::unique_ptr<StorageIterator>> iterators_;
 
+  // Rows moved out of the current iterator by NextBatch(), kept to reuse its
+  // buffers across batches.
+  StorageIterator::Batch storage_batch_;
+
   // Index of the iterator being read by row cursor in iterators_.
   int current_ = 0;
 
   // Set of columns to read.
   const std::vector<const Column*> columns_;
+
+  // Number of rows returned so far.
+  int64_t rows_scanned_ = 0;
 };
 
+// CancellableRowCursor returns the rows of a wrapped cursor until a
+// cancellation token is cancelled, after which it fails with the status of
+// the token. The token is checked once per batch of rows, so that the wrapped
+// cursor stops scanning storage shortly after the request is abandoned.
+//
+// This class is not thread-safe.
+class CancellableRowCursor : public RowCursor {
+ public:
+  CancellableRowCursor(std::unique_ptr<RowCursor> wrapped_cursor,
+                       const CancellationToken* cancellation)
+      : wrapped_cursor_(std::move(wrapped_cursor)), check_(cancellation) {}
+
+  // Implementation of the RowCursor interface
+  bool Next() override;
+  absl::Status Status() const override;
+  int NumColumns() const override;
+  const std::string ColumnName(int i) const override;
+  const zetasql::Value ColumnValue(int i) const override;
+  const zetasql::Type* ColumnType(int i) const override;
+  bool NextBatch(int max_rows, RowBatch* batch) override;
+
+ private:
+  std::unique_ptr<RowCursor> wrapped_cursor_;
+  CancellationCheck check_;
+
+  // Status of the token once it was found cancelled.
+  absl::Status status_;
+};
+
+// Returns one cursor per table over the rows read by `iterators`, which belong
+// to several tables as read by Storage::ReadInterleaved, with `columns[i]` the
+// columns read from the table of index i. The cursors share the iterators:
+// each pulls rows from them as it advances, and buffers the rows of the other
+// tables until the cursors of these tables reach them. Cursors advanced in
+// step, as by a merge join of a table with its children, thus only buffer the
+// rows found between consecutive rows of the same table. The rows returned
+// are counted as scanned by the request once the cursors are destroyed.
+//
+// The cursors are not thread-safe, and must all be read by the same thread.
+std::vector<std::unique_ptr<RowCursor>> MakeInterleavedRowCursors(
+    std::vector<std::unique_ptr<InterleavedStorageIterator>> iterators,
+    std::vector<std::vector<const Column*>> columns);
+
 }  // namespace backend
 }  // namespace emulator
 }  // namespace spanner
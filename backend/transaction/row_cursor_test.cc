@@ -22,6 +22,7 @@
 #include "tests/common/proto_matchers.h"
 #include "backend/storage/in_memory_iterator.h"
 #include "tests/common/schema_constructor.h"
+#include "common/cancellation.h"
 
 namespace google {
 namespace spanner {
@@ -213,6 +214,71 @@ TEST_F(StorageIteratorRowCursorTest, CreateRowCursorMultipleMultiRowIterators) {
   ZETASQL_EXPECT_OK(rowc.Status());
 }
 
+TEST_F(StorageIteratorRowCursorTest, ReadsBatchesAcrossIterators) {
+  std::vector<std::pair<Key, std::vector<Value>>> first_rows = {
+      {Key({Int64(1)}), {Int64(10), String("test_string1")}},
+      {Key({Int64(2)}), {Int64(20), zetasql::Value()}}};
+  std::vector<std::pair<Key, std::vector<Value>>> second_rows = {
+      {Key({Int64(3)}), {Int64(30), String("test_string3")}}};
+  iterators_.push_back(
+      absl::make_unique<FixedRowStorageIterator>(std::move(first_rows)));
+  iterators_.push_back(absl::make_unique<FixedRowStorageIterator>());
+  iterators_.push_back(
+      absl::make_unique<FixedRowStorageIterator>(std::move(second_rows)));
+
+  StorageIteratorRowCursor rowc(std::move(iterators_), std::move(columns_));
+
+  RowBatch batch;
+  ASSERT_TRUE(rowc.NextBatch(/*max_rows=*/10, &batch));
+  EXPECT_EQ(3, batch.num_rows);
+  ASSERT_EQ(2, batch.columns.size());
+  EXPECT_THAT(batch.columns[0].values,
+              testing::ElementsAre(Int64(10), Int64(20), Int64(30)));
+  EXPECT_THAT(batch.columns[0].is_null,
+              testing::ElementsAre(false, false, false));
+
+  // Invalid values are returned as NULLs.
+  EXPECT_THAT(batch.columns[1].values,
+              testing::ElementsAre(String("test_string1"),
+                                   zetasql::values::NullString(),
+                                   String("test_string3")));
+  EXPECT_THAT(batch.columns[1].is_null,
+              testing::ElementsAre(false, true, false));
+
+  EXPECT_FALSE(rowc.NextBatch(/*max_rows=*/10, &batch));
+  EXPECT_EQ(0, batch.num_rows);
+  ZETASQL_EXPECT_OK(rowc.Status());
+}
+
+TEST_F(StorageIteratorRowCursorTest, CancellableCursorStopsOnceCancelled) {
+  std::vector<std::pair<Key, std::vector<Value>>> rows;
+  for (int i = 0; i < 2 * CancellationCheck::kRowsPerCheck; ++i) {
+    rows.push_back({Key({Int64(i)}), {Int64(i), String("test_string")}});
+  }
+  iterators_.push_back(
+      absl::make_unique<FixedRowStorageIterator>(std::move(rows)));
+  CancellationToken cancellation;
+  CancellableRowCursor rowc(
+      absl::make_unique<StorageIteratorRowCursor>(std::move(iterators_),
+                                                  std::move(columns_)),
+      &cancellation);
+
+  ASSERT_TRUE(rowc.Next());
+  EXPECT_EQ(Int64(0), rowc.ColumnValue(0));
+  cancellation.Cancel();
+  int num_rows = 1;
+  while (rowc.Next()) {
+    ++num_rows;
+  }
+  EXPECT_EQ(CancellationCheck::kRowsPerCheck, num_rows);
+  EXPECT_THAT(rowc.Status(),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kCancelled));
+
+  RowBatch batch;
+  EXPECT_FALSE(rowc.NextBatch(/*max_rows=*/10, &batch));
+  EXPECT_EQ(0, batch.num_rows);
+}
+
 }  // namespace
 }  // namespace backend
 }  // namespace emulator
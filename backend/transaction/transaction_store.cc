@@ -16,22 +16,35 @@
 
 #include "backend/transaction/transaction_store.h"
 
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "zetasql/public/value.h"
+#include "zetasql/public/value.pb.h"
 #include "absl/container/flat_hash_map.h"
 #include "zetasql/base/statusor.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
 #include "absl/time/time.h"
+#include "absl/types/optional.h"
 #include "backend/common/rows.h"
+#include "backend/common/sorted_run.h"
+#include "backend/datamodel/key_encoding.h"
 #include "backend/datamodel/key_range.h"
 #include "backend/locking/request.h"
 #include "backend/schema/catalog/index.h"
 #include "backend/schema/catalog/table.h"
 #include "backend/storage/iterator.h"
 #include "backend/transaction/commit_timestamp.h"
+#include "backend/transaction/read_set.h"
+#include "backend/transaction/transaction_store.pb.h"
+#include "common/config.h"
 #include "common/errors.h"
 #include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
 
 namespace google {
 namespace spanner {
@@ -40,11 +53,6 @@ namespace backend {
 
 namespace {
 
-bool SortByKey(const FixedRowStorageIterator::Row& a,
-               const FixedRowStorageIterator::Row& b) {
-  return a.first < b.first;
-}
-
 void ResetInvalidValuesToNull(absl::Span<const Column* const> columns,
                               ValueList* values) {
   if (!values) {
@@ -62,9 +70,36 @@ void ResetInvalidValuesToNull(absl::Span<const Column* const> columns,
 
 }  // namespace
 
+TransactionStore::TransactionStore(Storage* base_storage,
+                                   LockHandle* lock_handle)
+    : TransactionStore(base_storage, lock_handle,
+                       config::transaction_spill_threshold_bytes()) {}
+
+TransactionStore::TransactionStore(Storage* base_storage,
+                                   LockHandle* lock_handle,
+                                   int64_t spill_threshold_bytes)
+    : base_storage_(base_storage),
+      lock_handle_(lock_handle),
+      spill_threshold_bytes_(spill_threshold_bytes),
+      spill_directory_(config::transaction_spill_directory()) {}
+
 absl::Status TransactionStore::AcquireReadLock(
     const Table* table, const KeyRange& key_range,
     absl::Span<const Column* const> columns) const {
+  if (read_set_ != nullptr) {
+    // All commits at or before the safe read timestamp are flushed, so the
+    // read observes them. Later commits may be seen in part, and are checked
+    // for changes to the rows read when the transaction commits.
+    const absl::Time timestamp = lock_handle_->SafeReadTimestamp();
+    if (read_set_->empty()) {
+      // Registers the first (and so oldest) timestamp of the reads, so that
+      // the versions needed to validate them are retained until the
+      // transaction releases its locks.
+      lock_handle_->WaitForSafeRead(timestamp);
+    }
+    read_set_->Add(table->id(), key_range, timestamp);
+    return absl::OkStatus();
+  }
   lock_handle_->EnqueueLock(LockRequest(LockMode::kShared, table->id(),
                                         key_range, GetColumnIDs(columns)));
   return lock_handle_->Wait();
@@ -80,60 +115,63 @@ absl::Status TransactionStore::AcquireWriteLock(
 
 absl::Status TransactionStore::BufferInsert(
     const Table* table, const Key& key, absl::Span<const Column* const> columns,
-    const ValueList& values) {
-  // Acquire locks to prevent another transaction to modify this entity.
-  ZETASQL_RETURN_IF_ERROR(AcquireWriteLock(table, KeyRange::Point(key), columns));
-
-  RowOp row_op;
-  bool row_exists = RowExistsInBuffer(table, key, &row_op);
-  Row row_values;
-  if (row_exists) {
-    // There is an existing delete on this row. Normalize this insert
-    // with the previous delete mutation.
-    row_values = row_op.second;
-  }
+    ValueList values) {
+  // Acquire locks to prevent another transaction to modify this entity. An
+  // insert changes the existence of the row, so the entire row is locked.
+  ZETASQL_RETURN_IF_ERROR(AcquireWriteLock(table, KeyRange::Point(key), {}));
 
-  // Buffer the insert mutation with the row values to be inserted.
+  // Buffer the insert mutation with the row values to be inserted. If there is
+  // an existing delete on this row, normalize this insert with the previous
+  // delete mutation. The values are accounted for before they are moved into
+  // the buffer.
+  AccountForValues(values);
+  const bool has_commit_ts_values =
+      TrackColumnsForCommitTimestamp(columns, values);
+  RowOp& row_op = MutableTableOps(table)[key];
+  row_op.first = OpType::kInsert;
   for (int i = 0; i < columns.size(); ++i) {
-    row_values[columns[i]] = values[i];
+    row_op.second[columns[i]] = std::move(values[i]);
   }
-  buffered_ops_[table][key] = std::make_pair(OpType::kInsert, row_values);
 
-  TrackColumnsForCommitTimestamp(columns, values);
-  TrackTableForCommitTimestamp(table, key);
+  if (TrackTableForCommitTimestamp(table, key) || has_commit_ts_values) {
+    commit_ts_rows_[table].insert(key);
+  }
   return absl::OkStatus();
 }
 
+void TransactionStore::AccountForValues(const ValueList& values) {
+  for (const zetasql::Value& value : values) {
+    value_bytes_ += sizeof(Row::value_type) +
+                    (value.is_valid() ? value.physical_byte_size() : 0);
+  }
+}
+
 absl::Status TransactionStore::BufferUpdate(
     const Table* table, const Key& key, absl::Span<const Column* const> columns,
-    const ValueList& values) {
+    ValueList values) {
   // Acquire locks to prevent another transaction to modify this entity.
   ZETASQL_RETURN_IF_ERROR(AcquireWriteLock(table, KeyRange::Point(key), columns));
 
-  RowOp row_op;
-  bool row_exists = RowExistsInBuffer(table, key, &row_op);
-
-  // Buffer the update mutation with the cell values to be updated.
-  OpType op_type;
-  Row row_values;
-  if (row_exists) {
-    // There is an existing insert or update on this row. Normalize this update
-    // with the previous mutation.
-    row_values = row_op.second;
-    // If the previous mutation on this row is an insert, keep the OpType
-    // as insert, since updating an inserted row will appear as a single insert.
-    op_type = row_op.first;
-  } else {
-    op_type = OpType::kUpdate;
+  // Buffer the update mutation with the cell values to be updated. If there is
+  // an existing insert or update on this row, normalize this update with the
+  // previous mutation in place. If the previous mutation on this row is an
+  // insert, keep the OpType as insert, since updating an inserted row will
+  // appear as a single insert.
+  AccountForValues(values);
+  const bool has_commit_ts_values =
+      TrackColumnsForCommitTimestamp(columns, values);
+  auto [row_op_itr, inserted] = MutableTableOps(table).try_emplace(key);
+  RowOp& row_op = row_op_itr->second;
+  if (inserted) {
+    row_op.first = OpType::kUpdate;
   }
-
   for (int i = 0; i < columns.size(); ++i) {
-    row_values[columns[i]] = values[i];
+    row_op.second[columns[i]] = std::move(values[i]);
   }
-  buffered_ops_[table][key] = std::make_pair(op_type, row_values);
 
-  TrackColumnsForCommitTimestamp(columns, values);
-  TrackTableForCommitTimestamp(table, key);
+  if (TrackTableForCommitTimestamp(table, key) || has_commit_ts_values) {
+    commit_ts_rows_[table].insert(key);
+  }
   return absl::OkStatus();
 }
 
@@ -142,199 +180,793 @@ absl::Status TransactionStore::BufferDelete(const Table* table,
   // Acquire locks to prevent another transaction to modify this entity.
   ZETASQL_RETURN_IF_ERROR(AcquireWriteLock(table, KeyRange::Point(key), {}));
 
+  // A row inserted by this transaction where no row existed before is simply
+  // cleared, so that rows which only exist between statements, such as the
+  // entries of an index on a column updated many times, are never flushed.
+  RowOps& table_ops = MutableTableOps(table);
+  auto row_op_itr = table_ops.find(key);
+  if (row_op_itr != table_ops.end() &&
+      row_op_itr->second.first == OpType::kInsert &&
+      !spilled_ops_.contains(table)) {
+    ZETASQL_ASSIGN_OR_RETURN(bool exists_before,
+                     ExistsBeforeBufferedOps(table, key));
+    if (!exists_before) {
+      table_ops.erase(row_op_itr);
+      ++generation_;
+      return absl::OkStatus();
+    }
+  }
+
   // Marking all columns null to indicate a delete.
-  Row row_values;
+  RowOp& row_op = table_ops[key];
+  row_op.first = OpType::kDelete;
+  row_op.second.clear();
   for (auto column : table->columns()) {
-    row_values[column] = zetasql::values::Null(column->GetType());
+    row_op.second[column] = zetasql::values::Null(column->GetType());
+  }
+
+  if (TrackTableForCommitTimestamp(table, key)) {
+    commit_ts_rows_[table].insert(key);
+  }
+  return absl::OkStatus();
+}
+
+zetasql_base::StatusOr<bool> TransactionStore::ExistsBeforeBufferedOps(
+    const Table* table, const Key& key) const {
+  if (IsDeletedByPrefix(table, key)) {
+    return false;
   }
-  buffered_ops_[table][key] = std::make_pair(OpType::kDelete, row_values);
+  ValueList values;
+  return base_storage_->LookupIfExists(absl::InfiniteFuture(), table->id(),
+                                       key, {}, &values);
+}
+
+absl::Status TransactionStore::BufferDeletePrefix(const Table* table,
+                                                  const Key& prefix) {
+  // Acquire locks on the whole prefix range to prevent another transaction to
+  // modify any of the deleted rows.
+  ZETASQL_RETURN_IF_ERROR(AcquireWriteLock(table, KeyRange::Prefix(prefix), {}));
 
-  TrackTableForCommitTimestamp(table, key);
+  // Buffered mutations to rows with the prefix are superseded by the delete.
+  RowOps& table_ops = MutableTableOps(table);
+  table_ops.erase(table_ops.lower_bound(prefix),
+                  table_ops.lower_bound(prefix.ToPrefixLimit()));
+  table_ops[prefix] = std::make_pair(OpType::kDeletePrefix, Row());
+  prefix_deleted_tables_.insert(table);
+
+  if (TrackTableForCommitTimestamp(table, prefix)) {
+    commit_ts_rows_[table].insert(prefix);
+  }
   return absl::OkStatus();
 }
 
-absl::Status TransactionStore::BufferWriteOp(const WriteOp& op) {
-  return std::visit(
+absl::Status TransactionStore::BufferWriteOp(WriteOp op) {
+  ZETASQL_RETURN_IF_ERROR(std::visit(
       overloaded{
-          [&](const InsertOp& op) {
-            return BufferInsert(op.table, op.key, op.columns, op.values);
+          [&](InsertOp& op) {
+            return BufferInsert(op.table, op.key, op.columns,
+                                std::move(op.values));
           },
-          [&](const UpdateOp& op) {
-            return BufferUpdate(op.table, op.key, op.columns, op.values);
+          [&](UpdateOp& op) {
+            return BufferUpdate(op.table, op.key, op.columns,
+                                std::move(op.values));
+          },
+          [&](const DeleteOp& op) {
+            return IsPrefixDelete(op) ? BufferDeletePrefix(op.table, op.key)
+                                      : BufferDelete(op.table, op.key);
           },
-          [&](const DeleteOp& op) { return BufferDelete(op.table, op.key); },
       },
-      op);
+      op));
+  if (spill_threshold_bytes_ > 0 && bytes() > spill_threshold_bytes_) {
+    return SpillBufferedOps();
+  }
+  return absl::OkStatus();
 }
 
-// Reads keys within the given range and add to StorageIterator. This is done by
-// reading from both the base storage & transaction store.
-// - Read keys from base storage (and apply merges as mentioned below).
-// - Read keys from transaction store and perform the following action
-//   for each of OpType as:
-//   - insert: add to output storage iterator
-//   - update: these updates should be applied over the base storage row.
-//   - delete: should remove the key read from the base storage.
-absl::Status TransactionStore::Read(
-    const Table* table, const KeyRange& key_range,
-    absl::Span<const Column* const> columns,
-    std::unique_ptr<StorageIterator>* storage_itr,
-    bool allow_pending_commit_timestamps_in_read) const {
-  // Acquire locks to prevent another transaction to modify this entity.
-  ZETASQL_RETURN_IF_ERROR(AcquireReadLock(table, key_range, columns));
+absl::Status TransactionStore::SerializeRowOp(
+    const absl::flat_hash_map<const Column*, int>& column_indexes,
+    const RowOp& row_op, std::string* serialized) {
+  SpilledRowOp spilled;
+  spilled.set_type(static_cast<int>(row_op.first));
+  for (const auto& [column, value] : row_op.second) {
+    auto index_itr = column_indexes.find(column);
+    if (index_itr == column_indexes.end()) {
+      return error::Internal(absl::StrCat("Cannot spill a mutation of column ",
+                                          column->FullName(),
+                                          " which is not in its table"));
+    }
+    spilled.add_column_indexes(index_itr->second);
+    ZETASQL_RETURN_IF_ERROR(value.Serialize(spilled.add_values()));
+  }
+  if (!spilled.SerializeToString(serialized)) {
+    return error::Internal("Failed to serialize a spilled mutation");
+  }
+  return absl::OkStatus();
+}
 
-  // Read rows buffered within transaction store.
-  // Table lookup.
-  std::vector<FixedRowStorageIterator::Row> rows;
+absl::Status TransactionStore::ParseRowOp(const Table* table,
+                                          absl::string_view serialized,
+                                          RowOp* row_op) {
+  SpilledRowOp spilled;
+  if (!spilled.ParseFromArray(serialized.data(), serialized.size()) ||
+      spilled.column_indexes_size() != spilled.values_size()) {
+    return error::Internal("Failed to parse a spilled mutation");
+  }
+  row_op->first = static_cast<OpType>(spilled.type());
+  row_op->second.clear();
+  absl::Span<const Column* const> columns = table->columns();
+  for (int i = 0; i < spilled.column_indexes_size(); ++i) {
+    const int index = spilled.column_indexes(i);
+    if (index < 0 || index >= columns.size()) {
+      return error::Internal(absl::StrCat(
+          "Spilled mutation of table ", table->Name(), " has column index ",
+          index, " out of range"));
+    }
+    ZETASQL_ASSIGN_OR_RETURN(
+        row_op->second[columns[index]],
+        zetasql::Value::Deserialize(spilled.values(i),
+                                      columns[index]->GetType()));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status TransactionStore::SpillBufferedOps() {
+  // The runs are only added once all of them are written, so that a failure
+  // leaves the buffered mutations as they were.
+  std::vector<std::pair<const Table*, SpilledRun>> spilled_runs;
+  std::string encoded_key;
+  std::string serialized;
+  for (const auto& [table, table_ops] : buffered_ops_) {
+    if (table_ops.empty()) {
+      continue;
+    }
+    absl::flat_hash_map<const Column*, int> column_indexes;
+    for (int i = 0; i < table->columns().size(); ++i) {
+      column_indexes[table->columns()[i]] = i;
+    }
+    ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<SortedRun::Writer> writer,
+                     SortedRun::Writer::Create(spill_directory_));
+    SpilledRun spilled;
+    for (const auto& [key, row_op] : table_ops) {
+      ZETASQL_RETURN_IF_ERROR(SerializeRowOp(column_indexes, row_op, &serialized));
+      ZETASQL_RETURN_IF_ERROR(writer->Add(EncodeKey(key), serialized));
+      if (row_op.first == OpType::kDeletePrefix) {
+        spilled.prefix_deletes.insert(key);
+      }
+    }
+    ZETASQL_ASSIGN_OR_RETURN(spilled.run, writer->Finish());
+    spilled_runs.emplace_back(table, std::move(spilled));
+  }
+  for (auto& [table, spilled] : spilled_runs) {
+    spilled_bytes_ += spilled.run->size_bytes();
+    spilled_ops_[table].push_back(std::move(spilled));
+  }
+  buffered_ops_.clear();
+  arena_.Reset();
+  value_bytes_ = 0;
+  ++generation_;
+  return absl::OkStatus();
+}
+
+void TransactionStore::ApplyRowOp(const RowOp& row_op,
+                                  absl::optional<RowOp>* applied) {
+  if (!applied->has_value() || row_op.first == OpType::kDelete ||
+      row_op.first == OpType::kDeletePrefix) {
+    *applied = row_op;
+    return;
+  }
+  // Inserts and updates write their columns over those of the older mutation.
+  // An update keeps the type of the older mutation, as in BufferUpdate.
+  if (row_op.first == OpType::kInsert) {
+    (*applied)->first = OpType::kInsert;
+  }
+  for (const auto& [column, value] : row_op.second) {
+    (*applied)->second[column] = value;
+  }
+}
+
+absl::Status TransactionStore::FindSpilledRow(const Table* table,
+                                              const Key& key,
+                                              absl::optional<RowOp>* row_op,
+                                              bool* deleted_by_prefix) const {
+  row_op->reset();
+  *deleted_by_prefix = false;
+  const std::string encoded_key = EncodeKey(key);
+  std::string serialized;
+  RowOp spilled_row_op;
+  for (const SpilledRun& spilled : spilled_ops_.at(table)) {
+    // A prefix delete supersedes the mutations buffered before it.
+    if (HasPrefixDelete(spilled.prefix_deletes, key)) {
+      row_op->reset();
+      *deleted_by_prefix = true;
+    }
+    ZETASQL_ASSIGN_OR_RETURN(bool found, spilled.run->Find(encoded_key, &serialized));
+    if (found) {
+      ZETASQL_RETURN_IF_ERROR(ParseRowOp(table, serialized, &spilled_row_op));
+      ApplyRowOp(spilled_row_op, row_op);
+    }
+  }
   auto table_itr = buffered_ops_.find(table);
   if (table_itr != buffered_ops_.end()) {
-    auto table = table_itr->second;
-    // Key range lookup.
-    auto begin_itr = table.lower_bound(key_range.start_key());
-    auto end_itr = table.lower_bound(key_range.limit_key());
-
-    for (auto itr = begin_itr; itr != end_itr; ++itr) {
-      if (itr->second.first == OpType::kInsert) {
-        // Add inserts into the StorageIterator.
-        Row row_values = itr->second.second;
-        ValueList values;
-        values.reserve(columns.size());
-        for (const Column* column : columns) {
-          if (row_values.find(column) == row_values.end()) {
-            values.emplace_back(zetasql::values::Null(column->GetType()));
-          } else {
-            values.emplace_back(row_values[column]);
+    if (HasPrefixDelete(table_itr->second, key)) {
+      row_op->reset();
+      *deleted_by_prefix = true;
+    }
+    auto row_op_itr = table_itr->second.find(key);
+    if (row_op_itr != table_itr->second.end()) {
+      ApplyRowOp(row_op_itr->second, row_op);
+    }
+  }
+  return absl::OkStatus();
+}
+
+// TransactionStore::SpilledCursor visits the rows of a table with spilled runs
+// which have buffered mutations, in key order, by walking the runs and the
+// mutations buffered in memory in lockstep. The mutations buffered for each
+// row are applied over one another as FindSpilledRow does.
+//
+// The cursor holds a position within the mutations buffered in memory, so it
+// must not be used once they may have changed (see generation_).
+class TransactionStore::SpilledCursor {
+ public:
+  // Positions the cursor before the first row whose key is not less than
+  // `start`, or greater than `start` if `exclusive`.
+  SpilledCursor(const TransactionStore* store, const Table* table,
+                const class Key& start, bool exclusive)
+      : store_(store), table_(table) {
+    const std::string encoded_start = EncodeKey(start);
+    const std::vector<SpilledRun>& spilled_runs =
+        store_->spilled_ops_.at(table);
+    runs_.reserve(spilled_runs.size());
+    for (const SpilledRun& spilled : spilled_runs) {
+      runs_.push_back(RunCursor{&spilled, spilled.run->Seek(encoded_start)});
+      Advance(&runs_.back());
+      if (exclusive && runs_.back().has_row && runs_.back().key == start) {
+        Advance(&runs_.back());
+      }
+    }
+    auto table_itr = store_->buffered_ops_.find(table);
+    if (table_itr != store_->buffered_ops_.end()) {
+      table_ops_ = &table_itr->second;
+      table_ops_itr_ = exclusive ? table_ops_->upper_bound(start)
+                                 : table_ops_->lower_bound(start);
+    }
+  }
+
+  // Advances to the next row with a key less than `limit`. Returns false if
+  // there is none, or if reading the runs failed, which is reported by
+  // status().
+  bool Next(const class Key& limit) {
+    while (status_.ok()) {
+      const class Key* next = nullptr;
+      for (const RunCursor& run : runs_) {
+        if (run.has_row && (next == nullptr || run.key < *next)) {
+          next = &run.key;
+        }
+      }
+      if (table_ops_ != nullptr && table_ops_itr_ != table_ops_->end() &&
+          (next == nullptr || table_ops_itr_->first < *next)) {
+        next = &table_ops_itr_->first;
+      }
+      if (next == nullptr || !(*next < limit)) {
+        return false;
+      }
+      key_ = *next;
+      row_op_.reset();
+      for (RunCursor& run : runs_) {
+        if (HasPrefixDelete(run.spilled->prefix_deletes, key_)) {
+          row_op_.reset();
+        }
+        if (run.has_row && run.key == key_) {
+          status_ = ParseRowOp(table_, run.itr->value(), &spilled_row_op_);
+          if (!status_.ok()) {
+            return false;
           }
+          ApplyRowOp(spilled_row_op_, &row_op_);
+          Advance(&run);
+        }
+      }
+      if (table_ops_ != nullptr) {
+        if (HasPrefixDelete(*table_ops_, key_)) {
+          row_op_.reset();
         }
-        rows.emplace_back(std::make_pair(itr->first, values));
+        if (table_ops_itr_ != table_ops_->end() &&
+            table_ops_itr_->first == key_) {
+          ApplyRowOp(table_ops_itr_->second, &row_op_);
+          ++table_ops_itr_;
+        }
+      }
+      if (row_op_.has_value()) {
+        return true;
       }
     }
+    return false;
   }
 
-  // Read from the base storage and apply the changes buffered in transaction
-  // store.
-  std::unique_ptr<StorageIterator> base_itr;
-  ZETASQL_RETURN_IF_ERROR(base_storage_->Read(absl::InfiniteFuture(), table->id(),
-                                      key_range, GetColumnIDs(columns),
-                                      &base_itr));
-  while (base_itr->Next()) {
-    ValueList values;
-    values.reserve(columns.size());
-
-    RowOp row_op;
-    // Merge column values from transaction store & base storage.
-    if (RowExistsInBuffer(table, base_itr->Key(), &row_op)) {
-      if (row_op.first == OpType::kDelete || row_op.first == OpType::kInsert) {
-        // Omit the deletes from the output. The buffered inserts have already
-        // been added to the output.
-        continue;
+  absl::Status status() const { return status_; }
+  const class Key& key() const { return key_; }
+  const RowOp& row_op() const { return *row_op_; }
+  RowOp& mutable_row_op() { return *row_op_; }
+
+ private:
+  // Position within a run, and the key of its current record if any.
+  struct RunCursor {
+    const SpilledRun* spilled;
+    std::unique_ptr<SortedRun::Iterator> itr;
+    bool has_row = false;
+    class Key key;
+  };
+
+  void Advance(RunCursor* run) {
+    run->has_row = run->itr->Next();
+    if (run->has_row) {
+      run->key = DecodeKey(run->itr->key());
+    } else if (!run->itr->Status().ok()) {
+      status_ = run->itr->Status();
+    }
+  }
+
+  const TransactionStore* store_;
+  const Table* table_;
+  std::vector<RunCursor> runs_;
+
+  // Mutations of the table buffered in memory, or nullptr if there are none,
+  // and the position of the next one to visit.
+  const RowOps* table_ops_ = nullptr;
+  RowOps::const_iterator table_ops_itr_;
+
+  // The current row.
+  class Key key_;
+  absl::optional<RowOp> row_op_;
+
+  // Scratch space for parsing spilled mutations.
+  RowOp spilled_row_op_;
+
+  absl::Status status_;
+};
+
+// TransactionStore::MergingIterator yields the rows of a key range with the
+// buffered mutations applied, by walking the rows of the base storage and the
+// buffered mutations of the table in lockstep. Rows are merged as they are
+// consumed, so reading the first rows of a large range is cheap:
+// - buffered inserts are yielded with the buffered values.
+// - buffered updates are applied over the base storage row.
+// - base storage rows with a buffered insert or delete, or covered by a
+//   buffered prefix delete, are omitted.
+//
+// The iterator must not outlive the store. Mutations buffered while iterating
+// may invalidate the position within the buffered mutations, in which case the
+// iterator seeks back to the key following the last row it yielded.
+//
+// If the table has spilled runs, the buffered inserts are visited through a
+// SpilledCursor instead, and the mutations buffered for base storage rows are
+// looked up with FindSpilledRow.
+class TransactionStore::MergingIterator : public StorageIterator {
+ public:
+  MergingIterator(const TransactionStore* store, const Table* table,
+                  const KeyRange& key_range,
+                  absl::Span<const Column* const> columns,
+                  std::unique_ptr<StorageIterator> base_itr)
+      : store_(store),
+        table_(table),
+        key_range_(key_range),
+        columns_(columns.begin(), columns.end()),
+        base_itr_(std::move(base_itr)) {}
+
+  // Implementation of the StorageIterator interface.
+  bool Next() override {
+    while (true) {
+      if (!base_has_row_ && !base_done_) {
+        base_has_row_ = base_itr_->Next();
+        base_done_ = !base_has_row_;
+        if (!base_itr_->Status().ok()) {
+          return false;
+        }
       }
-      if (row_op.first == OpType::kUpdate) {
-        // Update the column values to reflect the changes in transaction store.
-        for (int i = 0; i < columns.size(); i++) {
-          if (row_op.second.find(columns[i]) != row_op.second.end()) {
-            values.emplace_back(row_op.second[columns[i]]);
-          } else if (base_itr->ColumnValue(i).is_valid()) {
-            values.emplace_back(base_itr->ColumnValue(i));
-          } else {
-            values.emplace_back(zetasql::values::Null(columns[i]->GetType()));
-          }
+      const std::pair<const class Key, RowOp>* insert = NextBufferedInsert();
+      if (!status_.ok()) {
+        return false;
+      }
+      if (base_has_row_ &&
+          (insert == nullptr || base_itr_->Key() < insert->first)) {
+        base_has_row_ = false;
+        if (MergeBaseRow()) {
+          return true;
+        }
+        if (!status_.ok()) {
+          return false;
+        }
+      } else if (insert != nullptr) {
+        // A base storage row with the same key is omitted when it is visited,
+        // since the insert is buffered over it.
+        SetBufferedRow(insert->first, insert->second.second);
+        if (spilled_) {
+          spilled_insert_.reset();
+        } else {
+          ++buffered_itr_;
         }
+        return true;
+      } else {
+        return false;
+      }
+    }
+  }
+  absl::Status Status() const override {
+    return status_.ok() ? base_itr_->Status() : status_;
+  }
+  const class Key& Key() const override { return key_; }
+  int NumColumns() const override { return columns_.size(); }
+  const zetasql::Value& ColumnValue(int i) const override {
+    return values_[i];
+  }
+
+ private:
+  // Returns the next buffered insert within the key range, or nullptr if there
+  // is none, positioning buffered_itr_ at it.
+  const std::pair<const class Key, RowOp>* NextBufferedInsert() {
+    if (!buffered_positioned_ || generation_ != store_->generation_) {
+      spilled_ = store_->spilled_ops_.contains(table_);
+      if (spilled_) {
+        generation_ = store_->generation_;
+        buffered_positioned_ = true;
+        spilled_insert_.reset();
+        spilled_cursor_ = absl::make_unique<SpilledCursor>(
+            store_, table_, yielded_any_ ? key_ : key_range_.start_key(),
+            /*exclusive=*/yielded_any_);
+      }
+    }
+    if (spilled_) {
+      return NextSpilledInsert();
+    }
+    if (!buffered_positioned_ || generation_ != store_->generation_) {
+      generation_ = store_->generation_;
+      buffered_positioned_ = true;
+      auto table_itr = store_->buffered_ops_.find(table_);
+      if (table_itr == store_->buffered_ops_.end()) {
+        table_ops_ = nullptr;
+        return nullptr;
+      }
+      table_ops_ = &table_itr->second;
+      buffered_itr_ = yielded_any_ ? table_ops_->upper_bound(key_)
+                                   : table_ops_->lower_bound(
+                                         key_range_.start_key());
+    }
+    if (table_ops_ == nullptr) {
+      return nullptr;
+    }
+    for (; buffered_itr_ != table_ops_->end() &&
+           buffered_itr_->first < key_range_.limit_key();
+         ++buffered_itr_) {
+      if (buffered_itr_->second.first == OpType::kInsert) {
+        return &*buffered_itr_;
+      }
+    }
+    return nullptr;
+  }
+
+  // Returns the next buffered insert of a table with spilled runs.
+  const std::pair<const class Key, RowOp>* NextSpilledInsert() {
+    if (spilled_insert_.has_value()) {
+      return &*spilled_insert_;
+    }
+    while (spilled_cursor_->Next(key_range_.limit_key())) {
+      if (spilled_cursor_->row_op().first == OpType::kInsert) {
+        spilled_insert_.emplace(spilled_cursor_->key(),
+                                std::move(spilled_cursor_->mutable_row_op()));
+        return &*spilled_insert_;
+      }
+    }
+    status_ = spilled_cursor_->status();
+    return nullptr;
+  }
+
+  // Merges the current base storage row with the mutation buffered for it.
+  // Returns false if the row is omitted.
+  bool MergeBaseRow() {
+    const class Key& key = base_itr_->Key();
+    const RowOp* row_op = nullptr;
+    bool deleted_by_prefix = false;
+    if (spilled_) {
+      status_ = store_->FindSpilledRow(table_, key, &spilled_row_op_,
+                                       &deleted_by_prefix);
+      if (!status_.ok()) {
+        return false;
+      }
+      if (spilled_row_op_.has_value()) {
+        row_op = &*spilled_row_op_;
       }
     } else {
-      // Copy the base storage column values since this row does not exists in
-      // transaction store.
-      for (int i = 0; i < columns.size(); i++) {
-        if (base_itr->ColumnValue(i).is_valid()) {
-          values.emplace_back(base_itr->ColumnValue(i));
-        } else {
-          values.emplace_back(zetasql::values::Null(columns[i]->GetType()));
+      row_op = store_->FindBufferedRow(table_, key);
+    }
+    if (row_op != nullptr) {
+      if (row_op->first != OpType::kUpdate) {
+        // Omit the deletes from the output. The buffered inserts are yielded
+        // from the buffer.
+        return false;
+      }
+    } else if (spilled_ ? deleted_by_prefix
+                        : store_->IsDeletedByPrefix(table_, key)) {
+      return false;
+    }
+    key_ = key;
+    yielded_any_ = true;
+    values_.clear();
+    values_.reserve(columns_.size());
+    for (int i = 0; i < columns_.size(); ++i) {
+      if (row_op != nullptr) {
+        // Update the column values to reflect the changes in transaction store.
+        auto value_itr = row_op->second.find(columns_[i]);
+        if (value_itr != row_op->second.end()) {
+          values_.emplace_back(value_itr->second);
+          continue;
         }
       }
+      if (base_itr_->ColumnValue(i).is_valid()) {
+        values_.emplace_back(base_itr_->ColumnValue(i));
+      } else {
+        values_.emplace_back(zetasql::values::Null(columns_[i]->GetType()));
+      }
+    }
+    return true;
+  }
+
+  // Makes the current row the given buffered insert.
+  void SetBufferedRow(const class Key& key, const Row& row) {
+    key_ = key;
+    yielded_any_ = true;
+    values_.clear();
+    values_.reserve(columns_.size());
+    for (const Column* column : columns_) {
+      auto value_itr = row.find(column);
+      if (value_itr == row.end()) {
+        values_.emplace_back(zetasql::values::Null(column->GetType()));
+      } else {
+        values_.emplace_back(value_itr->second);
+      }
     }
-    rows.emplace_back(std::make_pair(base_itr->Key(), values));
   }
 
+  // The store whose buffered mutations are merged.
+  const TransactionStore* store_;
+
+  // The table being read.
+  const Table* table_;
+
+  // The range of keys to read.
+  const KeyRange key_range_;
+
+  // The columns to read.
+  const std::vector<const Column*> columns_;
+
+  // Iterator over the rows of the base storage within the key range.
+  std::unique_ptr<StorageIterator> base_itr_;
+
+  // True if the current row of base_itr_ has not been consumed yet.
+  bool base_has_row_ = false;
+
+  // True once base_itr_ is exhausted.
+  bool base_done_ = false;
+
+  // Buffered mutations of the table, or nullptr if there are none, and the
+  // position of the next one to visit. Only valid while generation_ matches
+  // the generation of the store.
+  const RowOps* table_ops_ = nullptr;
+  RowOps::const_iterator buffered_itr_;
+  int64_t generation_ = 0;
+  bool buffered_positioned_ = false;
+
+  // True if the table has spilled runs, in which case the buffered inserts
+  // are visited by spilled_cursor_, and the next one is held in
+  // spilled_insert_ until it is yielded.
+  bool spilled_ = false;
+  std::unique_ptr<SpilledCursor> spilled_cursor_;
+  absl::optional<std::pair<const class Key, RowOp>> spilled_insert_;
+
+  // Mutation buffered for the current base storage row of a table with
+  // spilled runs.
+  absl::optional<RowOp> spilled_row_op_;
+
+  // Error reading the spilled runs, if any.
+  absl::Status status_;
+
+  // The current row.
+  class Key key_;
+  ValueList values_;
+
+  // True once a row has been yielded, so that key_ is the last yielded key.
+  bool yielded_any_ = false;
+};
+
+absl::Status TransactionStore::Read(
+    const Table* table, const KeyRange& key_range,
+    absl::Span<const Column* const> columns,
+    std::unique_ptr<StorageIterator>* storage_itr,
+    bool allow_pending_commit_timestamps_in_read) const {
+  // Acquire locks to prevent another transaction to modify this entity.
+  ZETASQL_RETURN_IF_ERROR(AcquireReadLock(table, key_range, columns));
+
   // Pending commit timestamp values in buffer cannot be returned to
   // clients.
   if (!allow_pending_commit_timestamps_in_read) {
-    if (commit_ts_tables_.contains(table)) {
-      return error::CannotReadPendingCommitTimestamp(
-          absl::StrCat("Table ", table->Name()));
-    }
-    for (const auto column : columns) {
-      if (commit_ts_columns_.contains(column) ||
-          (column->source_column() != nullptr &&
-           commit_ts_columns_.contains(column->source_column()))) {
-        return error::CannotReadPendingCommitTimestamp(
-            absl::StrCat("Column ", column->Name()));
-      }
-    }
+    ZETASQL_RETURN_IF_ERROR(CheckNoPendingCommitTimestamps(table, columns));
   }
 
-  // Sort the keys to provide iterating in order.
-  // Note: this can be optimized by iterating the base_store_iterator and
-  // transaction_store_ietrator in parallel and comparing the keys.
-  sort(rows.begin(), rows.end(), SortByKey);
+  // Rows of the base storage are merged with the buffered mutations as the
+  // returned iterator advances.
+  std::unique_ptr<StorageIterator> base_itr;
+  ZETASQL_RETURN_IF_ERROR(base_storage_->Read(absl::InfiniteFuture(), table->id(),
+                                      key_range, GetColumnIDs(columns),
+                                      &base_itr));
+  *storage_itr = absl::make_unique<MergingIterator>(
+      this, table, key_range, columns, std::move(base_itr));
+  return absl::OkStatus();
+}
+
+absl::Status TransactionStore::MultiLookup(
+    const Table* table, absl::Span<const Key> keys,
+    absl::Span<const Column* const> columns,
+    std::unique_ptr<StorageIterator>* storage_itr,
+    bool allow_pending_commit_timestamps_in_read) const {
+  if (!allow_pending_commit_timestamps_in_read) {
+    ZETASQL_RETURN_IF_ERROR(CheckNoPendingCommitTimestamps(table, columns));
+  }
+  std::vector<FixedRowStorageIterator::Row> rows;
+  rows.reserve(keys.size());
+  for (const Key& key : keys) {
+    ZETASQL_ASSIGN_OR_RETURN(absl::optional<ValueList> values,
+                     LookupIfExists(table, key, columns));
+    if (values.has_value()) {
+      rows.emplace_back(key, *std::move(values));
+    }
+  }
   *storage_itr = absl::make_unique<FixedRowStorageIterator>(std::move(rows));
   return absl::OkStatus();
 }
 
-bool TransactionStore::RowExistsInBuffer(const Table* table, const Key& key,
-                                         RowOp* row_op) const {
+absl::Status TransactionStore::CheckNoPendingCommitTimestamps(
+    const Table* table, absl::Span<const Column* const> columns) const {
+  if (commit_ts_tables_.contains(table)) {
+    return error::CannotReadPendingCommitTimestamp(
+        absl::StrCat("Table ", table->Name()));
+  }
+  for (const auto column : columns) {
+    if (commit_ts_columns_.contains(column) ||
+        (column->source_column() != nullptr &&
+         commit_ts_columns_.contains(column->source_column()))) {
+      return error::CannotReadPendingCommitTimestamp(
+          absl::StrCat("Column ", column->Name()));
+    }
+  }
+  return absl::OkStatus();
+}
+
+TransactionStore::RowOps& TransactionStore::MutableTableOps(
+    const Table* table) {
+  ++generation_;
+  return buffered_ops_
+      .try_emplace(table, ArenaAllocator<std::pair<const Key, RowOp>>(&arena_))
+      .first->second;
+}
+
+const TransactionStore::RowOp* TransactionStore::FindBufferedRow(
+    const Table* table, const Key& key) const {
   const auto table_itr = buffered_ops_.find(table);
   if (table_itr == buffered_ops_.end()) {
     // Table does not exist. This can happen if the table is empty.
-    return false;
+    return nullptr;
   }
   const auto row_op_itr = table_itr->second.find(key);
   if (row_op_itr == table_itr->second.end()) {
     // Key does not exist.
+    return nullptr;
+  }
+  return &row_op_itr->second;
+}
+
+bool TransactionStore::IsDeletedByPrefix(const Table* table,
+                                         const Key& key) const {
+  if (!prefix_deleted_tables_.contains(table)) {
     return false;
   }
-  *row_op = row_op_itr->second;
-  return true;
+  // The prefix deletes of a table with spilled runs may all have been spilled.
+  auto table_itr = buffered_ops_.find(table);
+  return table_itr != buffered_ops_.end() &&
+         HasPrefixDelete(table_itr->second, key);
+}
+
+bool TransactionStore::HasPrefixDelete(const RowOps& table_ops,
+                                       const Key& key) {
+  for (int i = 0; i < key.NumColumns(); ++i) {
+    auto row_op_itr = table_ops.find(key.Prefix(i));
+    if (row_op_itr != table_ops.end() &&
+        row_op_itr->second.first == OpType::kDeletePrefix) {
+      return true;
+    }
+  }
+  return false;
 }
 
-void TransactionStore::TrackColumnsForCommitTimestamp(
+bool TransactionStore::HasPrefixDelete(const std::set<Key>& prefix_deletes,
+                                       const Key& key) {
+  if (prefix_deletes.empty()) {
+    return false;
+  }
+  for (int i = 0; i < key.NumColumns(); ++i) {
+    if (prefix_deletes.count(key.Prefix(i)) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TransactionStore::TrackColumnsForCommitTimestamp(
     absl::Span<const Column* const> columns, const ValueList& values) {
   DCHECK_EQ(columns.size(), values.size());
+  bool tracked = false;
   for (int i = 0; i < columns.size(); ++i) {
     if (IsPendingCommitTimestamp(columns[i], values[i])) {
       commit_ts_columns_.insert(columns[i]);
+      tracked = true;
     }
   }
+  return tracked;
 }
 
-void TransactionStore::TrackTableForCommitTimestamp(const Table* table,
+bool TransactionStore::TrackTableForCommitTimestamp(const Table* table,
                                                     const Key& key) {
-  if (HasPendingCommitTimestampInKey(table, key)) {
-    commit_ts_tables_.insert(table);
+  if (!HasPendingCommitTimestampInKey(table, key)) {
+    return false;
+  }
+  commit_ts_tables_.insert(table);
 
-    // Any time a table has a pending commit-ts in key, include all its indexes.
-    for (const Index* index : table->indexes()) {
-      commit_ts_tables_.insert(index->index_data_table());
-    }
+  // Any time a table has a pending commit-ts in key, include all its indexes.
+  for (const Index* index : table->indexes()) {
+    commit_ts_tables_.insert(index->index_data_table());
   }
+  return true;
 }
 
 zetasql_base::StatusOr<ValueList> TransactionStore::Lookup(
     const Table* table, const Key& key,
     absl::Span<const Column* const> columns) const {
+  ZETASQL_ASSIGN_OR_RETURN(absl::optional<ValueList> values,
+                   LookupIfExists(table, key, columns));
+  if (!values.has_value()) {
+    return error::RowNotFound(table->id(), key.DebugString());
+  }
+  return *std::move(values);
+}
+
+zetasql_base::StatusOr<absl::optional<ValueList>>
+TransactionStore::LookupIfExists(
+    const Table* table, const Key& key,
+    absl::Span<const Column* const> columns) const {
   ValueList values;
 
   // Acquire locks to prevent another transaction to modify this entity.
   ZETASQL_RETURN_IF_ERROR(AcquireReadLock(table, KeyRange::Point(key), columns));
 
   // Check if row exists within the buffer.
-  RowOp row_op;
-  if (RowExistsInBuffer(table, key, &row_op)) {
-    switch (row_op.first) {
+  const RowOp* row_op = nullptr;
+  bool deleted_by_prefix = false;
+  absl::optional<RowOp> spilled_row_op;
+  if (spilled_ops_.contains(table)) {
+    ZETASQL_RETURN_IF_ERROR(
+        FindSpilledRow(table, key, &spilled_row_op, &deleted_by_prefix));
+    if (spilled_row_op.has_value()) {
+      row_op = &*spilled_row_op;
+    }
+  } else {
+    row_op = FindBufferedRow(table, key);
+    deleted_by_prefix = row_op == nullptr && IsDeletedByPrefix(table, key);
+  }
+  if (row_op != nullptr) {
+    switch (row_op->first) {
       case OpType::kInsert: {
         // Fetch the latest value from the cell.
         for (auto column : columns) {
-          auto row_value = row_op.second.find(column);
-          if (row_value != row_op.second.end()) {
+          auto row_value = row_op->second.find(column);
+          if (row_value != row_op->second.end()) {
             values.emplace_back(row_value->second);
           } else {
             values.emplace_back(zetasql::values::Null(column->GetType()));
@@ -345,62 +977,149 @@ zetasql_base::StatusOr<ValueList> TransactionStore::Lookup(
       case OpType::kUpdate: {
         // For update, the base storage needs to be checked to retrieve values
         // which might not be included in the update.
-        ZETASQL_RETURN_IF_ERROR(base_storage_->Lookup(absl::InfiniteFuture(),
-                                              table->id(), key,
-                                              GetColumnIDs(columns), &values));
+        ZETASQL_ASSIGN_OR_RETURN(
+            bool exists,
+            base_storage_->LookupIfExists(absl::InfiniteFuture(), table->id(),
+                                          key, GetColumnIDs(columns), &values));
+        if (!exists) {
+          return absl::nullopt;
+        }
         ResetInvalidValuesToNull(columns, &values);
         for (int i = 0; i < columns.size(); ++i) {
           // Update values retrieved from base storage with new values.
-          auto row_value = row_op.second.find(columns[i]);
-          if (row_value != row_op.second.end()) {
+          auto row_value = row_op->second.find(columns[i]);
+          if (row_value != row_op->second.end()) {
             values[i] = row_value->second;
           }
         }
         break;
       }
       // Ignore delete operations.
-      case OpType::kDelete: {
-        return error::RowNotFound(table->id(), key.DebugString());
-        break;
+      case OpType::kDelete:
+      case OpType::kDeletePrefix: {
+        return absl::nullopt;
       }
     }
     return values;
   }
-  ZETASQL_RETURN_IF_ERROR(base_storage_->Lookup(absl::InfiniteFuture(), table->id(),
-                                        key, GetColumnIDs(columns), &values));
+  if (deleted_by_prefix) {
+    return absl::nullopt;
+  }
+  ZETASQL_ASSIGN_OR_RETURN(
+      bool exists,
+      base_storage_->LookupIfExists(absl::InfiniteFuture(), table->id(), key,
+                                    GetColumnIDs(columns), &values));
+  if (!exists) {
+    return absl::nullopt;
+  }
   ResetInvalidValuesToNull(columns, &values);
   return values;
 }
 
-std::vector<WriteOp> TransactionStore::GetBufferedOps() const {
+WriteOp TransactionStore::MakeWriteOp(const Table* table, Key key,
+                                      RowOp row_op) {
+  std::vector<const Column*> columns;
+  ValueList values;
+  columns.reserve(row_op.second.size());
+  values.reserve(row_op.second.size());
+  for (auto& cell : row_op.second) {
+    columns.emplace_back(cell.first);
+    values.emplace_back(std::move(cell.second));
+  }
+  switch (row_op.first) {
+    case OpType::kInsert:
+      return InsertOp{table, std::move(key), std::move(columns),
+                      std::move(values)};
+    case OpType::kUpdate:
+      return UpdateOp{table, std::move(key), std::move(columns),
+                      std::move(values)};
+    case OpType::kDelete:
+    case OpType::kDeletePrefix:
+      return DeleteOp{table, std::move(key)};
+  }
+}
+
+absl::Status TransactionStore::AppendSpilledOps(
+    const Table* table, const std::set<Key>* commit_ts_rows,
+    std::vector<CommitTimestampSlot>* commit_timestamp_slots,
+    std::vector<WriteOp>* buffered_ops) const {
+  SpilledCursor cursor(this, table, Key::Empty(), /*exclusive=*/false);
+  while (cursor.Next(Key::Infinity())) {
+    const bool has_commit_ts =
+        commit_ts_rows != nullptr && commit_ts_rows->count(cursor.key()) > 0;
+    buffered_ops->emplace_back(MakeWriteOp(
+        table, cursor.key(), std::move(cursor.mutable_row_op())));
+    if (has_commit_ts) {
+      FindCommitTimestampSlots(buffered_ops->back(), buffered_ops->size() - 1,
+                               commit_timestamp_slots);
+    }
+  }
+  return cursor.status();
+}
+
+zetasql_base::StatusOr<std::vector<WriteOp>> TransactionStore::GetBufferedOps()
+    const {
   std::vector<WriteOp> buffered_ops;
-  for (const auto& entry : buffered_ops_) {
-    const Table* table = entry.first;
-    for (const auto& row : entry.second) {
-      const Key& key = row.first;
-      const RowOp& row_op = row.second;
-      std::vector<const Column*> columns;
-      ValueList values;
-      for (const auto& cell : row_op.second) {
-        columns.emplace_back(cell.first);
-        values.emplace_back(cell.second);
-      }
-      switch (row_op.first) {
-        case OpType::kInsert: {
-          buffered_ops.emplace_back(InsertOp{table, key, columns, values});
-          break;
-        }
-        case OpType::kUpdate: {
-          buffered_ops.emplace_back(UpdateOp{table, key, columns, values});
-          break;
-        }
-        case OpType::kDelete: {
-          buffered_ops.emplace_back(DeleteOp{table, key});
-          break;
-        }
+  for (const auto& [table, table_ops] : buffered_ops_) {
+    if (spilled_ops_.contains(table)) {
+      continue;
+    }
+    for (const auto& [key, row_op] : table_ops) {
+      buffered_ops.emplace_back(MakeWriteOp(table, key, row_op));
+    }
+  }
+  for (const auto& [table, spilled_runs] : spilled_ops_) {
+    ZETASQL_RETURN_IF_ERROR(AppendSpilledOps(table, /*commit_ts_rows=*/nullptr,
+                                     /*commit_timestamp_slots=*/nullptr,
+                                     &buffered_ops));
+  }
+  return buffered_ops;
+}
+
+zetasql_base::StatusOr<std::vector<WriteOp>> TransactionStore::TakeBufferedOps(
+    std::vector<CommitTimestampSlot>* commit_timestamp_slots) {
+  size_t num_ops = 0;
+  for (const auto& [table, table_ops] : buffered_ops_) {
+    num_ops += table_ops.size();
+  }
+  for (const auto& [table, spilled_runs] : spilled_ops_) {
+    for (const SpilledRun& spilled : spilled_runs) {
+      num_ops += spilled.run->num_records();
+    }
+  }
+  std::vector<WriteOp> buffered_ops;
+  buffered_ops.reserve(num_ops);
+  auto find_commit_ts_rows = [&](const Table* table) -> const std::set<Key>* {
+    if (commit_timestamp_slots == nullptr) {
+      return nullptr;
+    }
+    auto rows_itr = commit_ts_rows_.find(table);
+    return rows_itr == commit_ts_rows_.end() ? nullptr : &rows_itr->second;
+  };
+  // The mutations of tables with spilled runs are read back from them, and
+  // applied over one another, first.
+  for (const auto& [table, spilled_runs] : spilled_ops_) {
+    ZETASQL_RETURN_IF_ERROR(AppendSpilledOps(table, find_commit_ts_rows(table),
+                                     commit_timestamp_slots, &buffered_ops));
+    buffered_ops_.erase(table);
+  }
+  for (auto& [table, table_ops] : buffered_ops_) {
+    const std::set<Key>* commit_ts_rows = find_commit_ts_rows(table);
+    // Extracting the entries gives mutable access to their keys, so that both
+    // keys and values are moved into the write ops.
+    while (!table_ops.empty()) {
+      auto entry = table_ops.extract(table_ops.begin());
+      const bool has_commit_ts =
+          commit_ts_rows != nullptr && commit_ts_rows->count(entry.key()) > 0;
+      buffered_ops.emplace_back(MakeWriteOp(table, std::move(entry.key()),
+                                            std::move(entry.mapped())));
+      if (has_commit_ts) {
+        FindCommitTimestampSlots(buffered_ops.back(), buffered_ops.size() - 1,
+                                 commit_timestamp_slots);
       }
     }
   }
+  Clear();
   return buffered_ops;
 }
 
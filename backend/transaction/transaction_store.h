@@ -17,13 +17,23 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_TRANSACTION_STORE_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_BACKEND_TRANSACTION_TRANSACTION_STORE_H_
 
+#include <cstdint>
+#include <map>
 #include <memory>
+#include <set>
+#include <string>
+#include <vector>
 
 #include "zetasql/public/value.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "zetasql/base/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
 #include "backend/actions/ops.h"
+#include "backend/common/arena.h"
 #include "backend/common/ids.h"
+#include "backend/common/sorted_run.h"
 #include "backend/datamodel/key.h"
 #include "backend/datamodel/value.h"
 #include "backend/locking/handle.h"
@@ -32,6 +42,8 @@
 #include "backend/schema/catalog/table.h"
 #include "backend/storage/in_memory_iterator.h"
 #include "backend/storage/storage.h"
+#include "backend/transaction/commit_timestamp.h"
+#include "backend/transaction/read_set.h"
 #include "absl/status/status.h"
 
 namespace google {
@@ -45,28 +57,57 @@ namespace backend {
 // base database storage and not actually applied to the base database storage.
 //
 // Multiple writes to the same row are collapsed together. For instance, an
-// insert followed by a delete of the same row will clear the row from the
-// TransactionStore. A delete followed by an insert followed by multiple updates
-// of the same row will be collapsed into a delete and an insert for that row.
+// insert followed by a delete of a row which did not exist before the
+// transaction will clear the row from the TransactionStore, so a row which is
+// repeatedly inserted and deleted, such as an index entry for a column that
+// is updated many times, leaves no mutation behind. A delete followed by an
+// insert followed by multiple updates of the same row will be collapsed into a
+// delete and an insert for that row.
+// A prefix delete (see IsPrefixDelete) replaces the buffered mutations of all
+// the rows with the prefix, and later mutations of these rows are buffered on
+// top of it.
 //
 // Reads from the transaction store combine information from the buffered
 // mutations and the base storage to provide a view of the database with the
 // mutations applied. This enables read-your-write semantics provided by DML.
 //
 // TransactionStore is also responsible for acquiring read/write locks for
-// rows and columns accessed via its interface.
+// rows and columns accessed via its interface. The reads of optimistic
+// transactions take no locks, and are recorded in a ReadSet instead.
 //
 // At commit time, the read-write transaction which owns this store flushes all
 // buffered mutations to the underlying database storage in an atomic fashion.
 //
+// The buffered mutations are kept in an arena owned by the store, which is
+// released as a whole once the mutations are cleared or taken for commit.
+//
+// Once the buffered mutations hold more than the spill threshold, they are
+// spilled to disk: the mutations of each table are written in key order to a
+// new SortedRun, and the arena is released. The runs of a table are layers
+// below the mutations buffered in memory, which are applied over those of the
+// runs, oldest first, whenever a row is read or the mutations are taken. Very
+// large transactions thus only hold the mutations buffered since their last
+// spill in memory, at the cost of reading the runs back from disk.
+//
 // This class is not thread safe.
 class TransactionStore {
  public:
-  explicit TransactionStore(Storage* base_storage, LockHandle* lock_handle)
-      : base_storage_(base_storage), lock_handle_(lock_handle) {}
+  // Constructs a store which spills the buffered mutations as configured by
+  // config::transaction_spill_threshold_bytes.
+  TransactionStore(Storage* base_storage, LockHandle* lock_handle);
+
+  // Constructs a store which spills the buffered mutations once they hold more
+  // than `spill_threshold_bytes` bytes, or never if it is 0.
+  TransactionStore(Storage* base_storage, LockHandle* lock_handle,
+                   int64_t spill_threshold_bytes);
 
-  // Buffers a write operation. Acquires write locks.
-  absl::Status BufferWriteOp(const WriteOp& op);
+  // Makes reads record the rows they read in `read_set` instead of acquiring
+  // read locks, for an optimistic transaction. Does not take ownership.
+  void set_read_set(ReadSet* read_set) { read_set_ = read_set; }
+
+  // Buffers a write operation, moving its values into the buffer. Acquires
+  // write locks.
+  absl::Status BufferWriteOp(WriteOp op);
 
   // Returns the column values for 'key' by merging information from the
   // buffered mutations and the base storage. Returns NOT_FOUND if 'key'
@@ -75,8 +116,17 @@ class TransactionStore {
       const Table* table, const Key& key,
       absl::Span<const Column* const> columns) const;
 
+  // Like Lookup, but returns no values instead of NOT_FOUND if 'key' does not
+  // exist in the merged view, so that callers which expect misses do not build
+  // an error for them.
+  zetasql_base::StatusOr<absl::optional<ValueList>> LookupIfExists(
+      const Table* table, const Key& key,
+      absl::Span<const Column* const> columns) const;
+
   // Returns an iterator for column values of 'key_range' by merging information
   // from the buffered mutations and the base storage. Acquires read locks.
+  // Rows are merged lazily as the iterator advances, so the iterator must not
+  // outlive the store.
   //
   // Boolean flag allow_pending_commit_timestamps_in_read can be set to false to
   // disallow returning pending_commit_timestamp values to clients.
@@ -85,11 +135,48 @@ class TransactionStore {
                     std::unique_ptr<StorageIterator>* storage_itr,
                     bool allow_pending_commit_timestamps_in_read = true) const;
 
+  // Returns an iterator over the rows of 'keys' which exist in the merged view,
+  // in the order of the keys, which must be sorted and distinct. Acquires a
+  // read lock on each key, as a Lookup of it would. Unlike a Read of a point
+  // range per key, no iterator is created over the base storage for each key.
+  // See Read for allow_pending_commit_timestamps_in_read.
+  absl::Status MultiLookup(
+      const Table* table, absl::Span<const Key> keys,
+      absl::Span<const Column* const> columns,
+      std::unique_ptr<StorageIterator>* storage_itr,
+      bool allow_pending_commit_timestamps_in_read = true) const;
+
   // Returns the buffered mutations.
-  std::vector<WriteOp> GetBufferedOps() const;
+  zetasql_base::StatusOr<std::vector<WriteOp>> GetBufferedOps() const;
+
+  // Returns the buffered mutations, moving them out of the store, which is
+  // left without buffered mutations as if Clear() was called. If
+  // `commit_timestamp_slots` is not null, the locations of the commit timestamp
+  // sentinels in the returned mutations are stored in it, for them to be
+  // resolved with ResolveCommitTimestamps. Only the mutations which were
+  // buffered with sentinels are searched for them.
+  zetasql_base::StatusOr<std::vector<WriteOp>> TakeBufferedOps(
+      std::vector<CommitTimestampSlot>* commit_timestamp_slots = nullptr);
+
+  // Returns the approximate number of bytes of memory held by the buffered
+  // mutations. Values overwritten by later mutations of the same row are still
+  // accounted for until the mutations are cleared or spilled.
+  int64_t bytes() const { return arena_.bytes_reserved() + value_bytes_; }
+
+  // Returns the number of bytes of the runs holding spilled mutations.
+  int64_t spilled_bytes() const { return spilled_bytes_; }
 
   // Clears the buffered mutations.
-  void Clear() { buffered_ops_.clear(); }
+  void Clear() {
+    buffered_ops_.clear();
+    spilled_ops_.clear();
+    spilled_bytes_ = 0;
+    prefix_deleted_tables_.clear();
+    commit_ts_rows_.clear();
+    arena_.Reset();
+    value_bytes_ = 0;
+    ++generation_;
+  }
 
  private:
   // Types of mutations.
@@ -97,11 +184,38 @@ class TransactionStore {
     kInsert,
     kUpdate,
     kDelete,
+    // Deletes every row with the key of the op as a prefix. Only ever buffered
+    // at key prefixes, so never conflicts with the mutation of a single row.
+    kDeletePrefix,
   };
 
   using RowOp = std::pair<OpType, Row>;
 
-  // Acquires read locks for the specified column ranges.
+  // Buffered mutations of a table, allocated from the arena of the store.
+  using RowOps = std::map<Key, RowOp, std::less<Key>,
+                          ArenaAllocator<std::pair<const Key, RowOp>>>;
+
+  // Mutations of a table spilled to disk, and the keys of the prefix deletes
+  // among them.
+  struct SpilledRun {
+    std::unique_ptr<SortedRun> run;
+    std::set<Key> prefix_deletes;
+  };
+
+  // Iterator returned by Read(), see the definition in transaction_store.cc.
+  class MergingIterator;
+
+  // Cursor over the mutations of a table with spilled runs, see the definition
+  // in transaction_store.cc.
+  class SpilledCursor;
+
+  // Returns an error if reading 'columns' of 'table' could return pending
+  // commit timestamp values.
+  absl::Status CheckNoPendingCommitTimestamps(
+      const Table* table, absl::Span<const Column* const> columns) const;
+
+  // Acquires read locks for the specified column ranges, or records the read
+  // in read_set_ if set.
   absl::Status AcquireReadLock(const Table* table, const KeyRange& key_range,
                                absl::Span<const Column* const> columns) const;
 
@@ -112,27 +226,89 @@ class TransactionStore {
   // Buffers an insert mutation. Acquires write locks.
   absl::Status BufferInsert(const Table* table, const Key& key,
                             absl::Span<const Column* const> columns,
-                            const ValueList& values);
+                            ValueList values);
 
   // Buffers an update mutation. Acquires write locks.
   absl::Status BufferUpdate(const Table* table, const Key& key,
                             absl::Span<const Column* const> columns,
-                            const ValueList& values);
+                            ValueList values);
 
   // Buffers a delete mutation. Acquires write locks.
   absl::Status BufferDelete(const Table* table, const Key& key);
 
-  // Returns true if a mutation has been buffered for 'key' and fills 'row'.
-  bool RowExistsInBuffer(const Table* table, const Key& key, RowOp* row) const;
+  // Buffers a delete of all rows with the given key prefix. Acquires write
+  // locks on the whole prefix range.
+  absl::Status BufferDeletePrefix(const Table* table, const Key& prefix);
+
+  // Returns true if 'key' existed in the base storage and was not deleted by a
+  // buffered prefix delete, regardless of the mutations buffered for the row
+  // itself. The table must have no spilled runs.
+  zetasql_base::StatusOr<bool> ExistsBeforeBufferedOps(const Table* table,
+                                               const Key& key) const;
+
+  // Returns true if 'key' is covered by a buffered prefix delete.
+  bool IsDeletedByPrefix(const Table* table, const Key& key) const;
+
+  // Returns true if 'key' is covered by one of the given prefix deletes.
+  static bool HasPrefixDelete(const RowOps& table_ops, const Key& key);
+  static bool HasPrefixDelete(const std::set<Key>& prefix_deletes,
+                              const Key& key);
+
+  // Applies a mutation of a row over the mutation buffered before it in an
+  // older layer, if any, as buffering them one after the other would have.
+  static void ApplyRowOp(const RowOp& row_op, absl::optional<RowOp>* applied);
+
+  // Spills the mutations buffered in memory to a new run per table.
+  absl::Status SpillBufferedOps();
+
+  // Sets `row_op` to the mutations buffered for 'key' in the spilled runs and
+  // in memory applied over one another, or to nullopt if there are none, and
+  // `deleted_by_prefix` to whether a prefix delete covers the key in any of
+  // them. The table must have spilled runs.
+  absl::Status FindSpilledRow(const Table* table, const Key& key,
+                              absl::optional<RowOp>* row_op,
+                              bool* deleted_by_prefix) const;
+
+  // Encodes a spilled mutation of a row, given the positions of the columns
+  // within its table.
+  static absl::Status SerializeRowOp(
+      const absl::flat_hash_map<const Column*, int>& column_indexes,
+      const RowOp& row_op, std::string* serialized);
+
+  // Appends the mutations of a table with spilled runs to `buffered_ops`, in
+  // key order, finding the commit timestamp slots of the rows in
+  // `commit_ts_rows` if not null.
+  absl::Status AppendSpilledOps(
+      const Table* table, const std::set<Key>* commit_ts_rows,
+      std::vector<CommitTimestampSlot>* commit_timestamp_slots,
+      std::vector<WriteOp>* buffered_ops) const;
+
+  // Decodes a spilled mutation of a row of 'table'.
+  static absl::Status ParseRowOp(const Table* table,
+                                 absl::string_view serialized, RowOp* row_op);
+
+  // Returns the buffered mutations of 'table', allocating them if needed. The
+  // mutations may be modified, so this invalidates the positions of iterators
+  // within the buffered mutations.
+  RowOps& MutableTableOps(const Table* table);
+
+  // Returns the mutation buffered for 'key', or nullptr if there is none.
+  const RowOp* FindBufferedRow(const Table* table, const Key& key) const;
+
+  // Returns the write op for a buffered mutation.
+  static WriteOp MakeWriteOp(const Table* table, Key key, RowOp row_op);
 
   // Mark a given column non-readable if one or more values being written to it
-  // in the mutation contain pending commit timestamp.
-  void TrackColumnsForCommitTimestamp(absl::Span<const Column* const> columns,
+  // in the mutation contain pending commit timestamp. Returns true if any did.
+  bool TrackColumnsForCommitTimestamp(absl::Span<const Column* const> columns,
                                       const ValueList& values);
 
   // Mark table and it's associated indices as non-readable if key in the
-  // mutation contains pending commit timestamp.
-  void TrackTableForCommitTimestamp(const Table* table, const Key& key);
+  // mutation contains pending commit timestamp. Returns true if it did.
+  bool TrackTableForCommitTimestamp(const Table* table, const Key& key);
+
+  // Accounts for the memory of buffered column values.
+  void AccountForValues(const ValueList& values);
 
   // Underlying storage for the database.
   const Storage* base_storage_;
@@ -140,8 +316,38 @@ class TransactionStore {
   // Handle for the lock manager.
   LockHandle* lock_handle_;
 
+  // Reads recorded instead of locked, or null if reads acquire locks.
+  ReadSet* read_set_ = nullptr;
+
+  // Arena which the buffered mutations are allocated from. Declared before
+  // buffered_ops_ so that it outlives them.
+  Arena arena_;
+
+  // Approximate number of bytes of the buffered column values, which are not
+  // allocated from the arena.
+  int64_t value_bytes_ = 0;
+
   // Map that stores the buffered mutations.
-  absl::flat_hash_map<const Table*, std::map<Key, RowOp>> buffered_ops_;
+  absl::flat_hash_map<const Table*, RowOps> buffered_ops_;
+
+  // Bytes of buffered mutations from which they are spilled, or 0 if never.
+  const int64_t spill_threshold_bytes_;
+
+  // Directory of the runs of spilled mutations.
+  const std::string spill_directory_;
+
+  // Runs of the spilled mutations of each table, oldest first.
+  absl::flat_hash_map<const Table*, std::vector<SpilledRun>> spilled_ops_;
+
+  // Total size of the runs in spilled_ops_.
+  int64_t spilled_bytes_ = 0;
+
+  // Incremented whenever the buffered mutations may change, which invalidates
+  // the positions of MergingIterators within them.
+  int64_t generation_ = 0;
+
+  // Set of tables which have buffered prefix deletes.
+  absl::flat_hash_set<const Table*> prefix_deleted_tables_;
 
   // Set of non-key columns which have mutation with pending commit timestamp
   // and are thus marked as non-readable in read-your-writes transactions.
@@ -151,6 +357,11 @@ class TransactionStore {
   // thus marked as non-readable in read-your-writes transactions. This also
   // includes backing tables for indices of all such tables.
   absl::flat_hash_set<const Table*> commit_ts_tables_;
+
+  // Keys of the buffered rows of each table which were written with a pending
+  // commit timestamp in their key or values. Later mutations may overwrite the
+  // sentinels, so these rows may no longer contain any.
+  absl::flat_hash_map<const Table*, std::set<Key>> commit_ts_rows_;
 };
 
 }  // namespace backend
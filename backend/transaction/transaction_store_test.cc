@@ -16,6 +16,7 @@
 
 #include "backend/transaction/transaction_store.h"
 
+#include <cstdint>
 #include <memory>
 
 #include "gmock/gmock.h"
@@ -24,6 +25,7 @@
 #include "tests/common/proto_matchers.h"
 #include "zetasql/base/statusor.h"
 #include "absl/time/time.h"
+#include "absl/types/optional.h"
 #include "backend/actions/ops.h"
 #include "backend/common/rows.h"
 #include "backend/datamodel/key_range.h"
@@ -209,6 +211,32 @@ TEST_F(TransactionStoreTest, CanBufferDeleteAfterInsert) {
   EXPECT_THAT(ReadAll(), IsOkAndHoldsRows({}));
 }
 
+TEST_F(TransactionStoreTest, DeleteAfterInsertOfNewRowLeavesNoMutation) {
+  ZETASQL_EXPECT_OK(BufferInsert(Key({Int64(1)}), {int64_col_, string_col_},
+                         {Int64(1), String("value")}));
+  ZETASQL_EXPECT_OK(BufferDelete(Key({Int64(1)})));
+
+  EXPECT_THAT(transaction_store_.GetBufferedOps(),
+              zetasql_base::testing::IsOkAndHolds(testing::IsEmpty()));
+}
+
+TEST_F(TransactionStoreTest, DeleteAfterReinsertOfExistingRowIsKept) {
+  absl::Time t0 = absl::Now();
+  ZETASQL_EXPECT_OK(Write(t0, Key({Int64(1)}), {Int64(1), String("value-1")}));
+
+  ZETASQL_EXPECT_OK(BufferDelete(Key({Int64(1)})));
+  ZETASQL_EXPECT_OK(BufferInsert(Key({Int64(1)}), {int64_col_, string_col_},
+                         {Int64(1), String("value-2")}));
+  ZETASQL_EXPECT_OK(BufferDelete(Key({Int64(1)})));
+
+  EXPECT_THAT(ReadAll(), IsOkAndHoldsRows({}));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::vector<WriteOp> buffered_ops,
+                       transaction_store_.GetBufferedOps());
+  ASSERT_EQ(buffered_ops.size(), 1);
+  EXPECT_THAT(buffered_ops[0], testing::VariantWith<DeleteOp>(
+                                   DeleteOp{table_, Key({Int64(1)})}));
+}
+
 TEST_F(TransactionStoreTest, CanBufferMultipleUpdates) {
   absl::Time t0 = absl::Now();
   ZETASQL_EXPECT_OK(Write(t0, Key({Int64(1)}), {Int64(1), String("value-1")}));
@@ -317,6 +345,30 @@ TEST_F(TransactionStoreTest, LookupBaseStorage) {
               IsOkAndHoldsRow({Int64(1), String("new-value")}));
 }
 
+TEST_F(TransactionStoreTest, LookupIfExistsReturnsNoValuesForMissingRows) {
+  absl::Time t0 = absl::Now();
+  ZETASQL_EXPECT_OK(Write(t0, Key({Int64(1)}), {Int64(1), String("value")}));
+  ZETASQL_EXPECT_OK(BufferInsert(Key({Int64(2)}), {int64_col_, string_col_},
+                         {Int64(2), String("value")}));
+  ZETASQL_EXPECT_OK(BufferDelete(Key({Int64(1)})));
+
+  // Neither the deleted base row nor a row that never existed is found.
+  for (int64_t key : {1, 3}) {
+    zetasql_base::StatusOr<absl::optional<ValueList>> values =
+        transaction_store_.LookupIfExists(table_, Key({Int64(key)}),
+                                          {int64_col_, string_col_});
+    ZETASQL_ASSERT_OK(values.status());
+    EXPECT_FALSE(values->has_value());
+  }
+
+  zetasql_base::StatusOr<absl::optional<ValueList>> values =
+      transaction_store_.LookupIfExists(table_, Key({Int64(2)}),
+                                        {int64_col_, string_col_});
+  ZETASQL_ASSERT_OK(values.status());
+  ASSERT_TRUE(values->has_value());
+  EXPECT_EQ(**values, ValueList({Int64(2), String("value")}));
+}
+
 TEST_F(TransactionStoreTest, LookupEmptyColumns) {
   absl::Time t0 = absl::Now();
   ZETASQL_EXPECT_OK(Write(t0, Key({Int64(1)}), {Int64(1), String("value")}));
@@ -368,6 +420,216 @@ TEST_F(TransactionStoreTest, ReadsClosedOpenRange) {
               IsOkAndHoldsRows({}));
 }
 
+TEST_F(TransactionStoreTest, PrefixDeleteHidesAllRowsWithThePrefix) {
+  absl::Time t0 = absl::Now();
+  ZETASQL_EXPECT_OK(Write(t0, Key({Int64(1)}), {Int64(1), String("value")}));
+  ZETASQL_EXPECT_OK(Write(t0, Key({Int64(2)}), {Int64(2), String("value")}));
+  ZETASQL_EXPECT_OK(BufferInsert(Key({Int64(3)}), {int64_col_, string_col_},
+                         {Int64(3), String("value")}));
+
+  // The empty key is a prefix of all the rows of the table.
+  ZETASQL_EXPECT_OK(BufferDelete(Key()));
+  EXPECT_THAT(ReadAll(), IsOkAndHoldsRows({}));
+  for (const int key : {1, 2, 3}) {
+    EXPECT_THAT(Lookup(Key({Int64(key)})),
+                StatusIs(absl::StatusCode::kNotFound));
+  }
+
+  // Rows inserted after the prefix delete are visible.
+  ZETASQL_EXPECT_OK(BufferInsert(Key({Int64(2)}), {int64_col_}, {Int64(2)}));
+  EXPECT_THAT(ReadAll(), IsOkAndHoldsRows({{Int64(2), Null(StringType())}}));
+  EXPECT_THAT(Lookup(Key({Int64(2)})),
+              IsOkAndHoldsRow({Int64(2), Null(StringType())}));
+
+  // The prefix delete supersedes the insert buffered before it, and is
+  // flushed ahead of the insert buffered after it.
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::vector<WriteOp> buffered_ops,
+                       transaction_store_.GetBufferedOps());
+  ASSERT_EQ(buffered_ops.size(), 2);
+  EXPECT_THAT(buffered_ops[0],
+              testing::VariantWith<DeleteOp>(DeleteOp{table_, Key()}));
+  EXPECT_THAT(buffered_ops[1], testing::VariantWith<InsertOp>(testing::_));
+}
+
+TEST_F(TransactionStoreTest, ReadMergesBufferedMutationsInKeyOrder) {
+  absl::Time t0 = absl::Now();
+  for (const int key : {1, 3, 5, 7}) {
+    ZETASQL_EXPECT_OK(Write(t0, Key({Int64(key)}), {Int64(key), String("base")}));
+  }
+  for (const int key : {0, 2, 8}) {
+    ZETASQL_EXPECT_OK(BufferInsert(Key({Int64(key)}), {int64_col_, string_col_},
+                           {Int64(key), String("buffered")}));
+  }
+  ZETASQL_EXPECT_OK(BufferUpdate(Key({Int64(3)}), {string_col_}, {String("updated")}));
+  ZETASQL_EXPECT_OK(BufferDelete(Key({Int64(5)})));
+  ZETASQL_EXPECT_OK(BufferDelete(Key({Int64(7)})));
+  ZETASQL_EXPECT_OK(BufferInsert(Key({Int64(7)}), {int64_col_, string_col_},
+                         {Int64(7), String("reinserted")}));
+
+  EXPECT_THAT(ReadAll(), IsOkAndHoldsRows({{Int64(0), String("buffered")},
+                                           {Int64(1), String("base")},
+                                           {Int64(2), String("buffered")},
+                                           {Int64(3), String("updated")},
+                                           {Int64(7), String("reinserted")},
+                                           {Int64(8), String("buffered")}}));
+}
+
+TEST_F(TransactionStoreTest, MultiLookupMergesBufferedMutations) {
+  absl::Time t0 = absl::Now();
+  for (const int key : {1, 3, 5}) {
+    ZETASQL_EXPECT_OK(Write(t0, Key({Int64(key)}), {Int64(key), String("base")}));
+  }
+  ZETASQL_EXPECT_OK(BufferInsert(Key({Int64(2)}), {int64_col_, string_col_},
+                         {Int64(2), String("buffered")}));
+  ZETASQL_EXPECT_OK(BufferUpdate(Key({Int64(3)}), {string_col_}, {String("updated")}));
+  ZETASQL_EXPECT_OK(BufferDelete(Key({Int64(5)})));
+
+  // Keys which do not exist in the merged view are skipped.
+  std::unique_ptr<StorageIterator> itr;
+  ZETASQL_ASSERT_OK(transaction_store_.MultiLookup(
+      table_,
+      {Key({Int64(1)}), Key({Int64(2)}), Key({Int64(3)}), Key({Int64(4)}),
+       Key({Int64(5)})},
+      {int64_col_, string_col_}, &itr));
+  std::vector<ValueList> rows;
+  while (itr->Next()) {
+    rows.push_back({itr->ColumnValue(0), itr->ColumnValue(1)});
+  }
+  ZETASQL_EXPECT_OK(itr->Status());
+  EXPECT_THAT(rows, testing::ElementsAre(
+                        ValueList{Int64(1), String("base")},
+                        ValueList{Int64(2), String("buffered")},
+                        ValueList{Int64(3), String("updated")}));
+}
+
+TEST_F(TransactionStoreTest, ReadSurvivesMutationsBufferedWhileIterating) {
+  for (const int key : {1, 2, 3}) {
+    ZETASQL_EXPECT_OK(BufferInsert(Key({Int64(key)}), {int64_col_},
+                           {Int64(key)}));
+  }
+
+  std::unique_ptr<StorageIterator> itr;
+  ZETASQL_ASSERT_OK(transaction_store_.Read(table_, KeyRange::All(), {int64_col_},
+                                    &itr));
+  ASSERT_TRUE(itr->Next());
+  EXPECT_EQ(itr->Key(), Key({Int64(1)}));
+
+  // Mutations buffered after the current row are seen by the iterator.
+  ZETASQL_EXPECT_OK(BufferDelete(Key({Int64(2)})));
+  ZETASQL_EXPECT_OK(BufferInsert(Key({Int64(4)}), {int64_col_}, {Int64(4)}));
+  std::vector<Key> keys;
+  while (itr->Next()) {
+    keys.push_back(itr->Key());
+  }
+  ZETASQL_EXPECT_OK(itr->Status());
+  EXPECT_THAT(keys, testing::ElementsAre(Key({Int64(3)}), Key({Int64(4)})));
+}
+
+TEST_F(TransactionStoreTest, TakeBufferedOpsClearsBufferedMutations) {
+  absl::Time t0 = absl::Now();
+  ZETASQL_EXPECT_OK(Write(t0, Key({Int64(1)}), {Int64(1), String("value")}));
+  ZETASQL_EXPECT_OK(BufferInsert(Key({Int64(2)}), {int64_col_, string_col_},
+                         {Int64(2), String("value")}));
+  ZETASQL_EXPECT_OK(BufferDelete(Key({Int64(1)})));
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::vector<WriteOp> buffered_ops,
+                       transaction_store_.TakeBufferedOps());
+  ASSERT_EQ(buffered_ops.size(), 2);
+  EXPECT_THAT(buffered_ops[0], testing::VariantWith<DeleteOp>(
+                                   DeleteOp{table_, Key({Int64(1)})}));
+  EXPECT_THAT(buffered_ops[1], testing::VariantWith<InsertOp>(testing::_));
+  EXPECT_EQ(std::get<InsertOp>(buffered_ops[1]).key, Key({Int64(2)}));
+
+  // The store reads through to the base storage again.
+  EXPECT_THAT(transaction_store_.GetBufferedOps(),
+              zetasql_base::testing::IsOkAndHolds(testing::IsEmpty()));
+  EXPECT_THAT(ReadAll(), IsOkAndHoldsRows({{Int64(1), String("value")}}));
+
+  // The store can buffer mutations again after its arena was released.
+  ZETASQL_EXPECT_OK(BufferInsert(Key({Int64(3)}), {int64_col_}, {Int64(3)}));
+  EXPECT_THAT(ReadAll(), IsOkAndHoldsRows({{Int64(1), String("value")},
+                                           {Int64(3), Null(StringType())}}));
+}
+
+TEST_F(TransactionStoreTest, AccountsForBytesOfBufferedMutations) {
+  EXPECT_EQ(transaction_store_.bytes(), 0);
+  ZETASQL_EXPECT_OK(BufferInsert(Key({Int64(1)}), {int64_col_, string_col_},
+                         {Int64(1), String("value")}));
+  const int64_t insert_bytes = transaction_store_.bytes();
+  EXPECT_GT(insert_bytes, 0);
+  ZETASQL_EXPECT_OK(BufferUpdate(Key({Int64(1)}), {string_col_},
+                         {String("other value")}));
+  EXPECT_GT(transaction_store_.bytes(), insert_bytes);
+
+  transaction_store_.Clear();
+  EXPECT_EQ(transaction_store_.bytes(), 0);
+}
+
+TEST_F(TransactionStoreTest, SpillsBufferedMutationsOverThreshold) {
+  absl::Time t0 = absl::Now();
+  for (const int key : {1, 3, 5}) {
+    ZETASQL_EXPECT_OK(Write(t0, Key({Int64(key)}), {Int64(key), String("base")}));
+  }
+
+  // Every mutation is spilled as soon as it is buffered.
+  TransactionStore store(base_storage_.get(), lock_handle_.get(),
+                         /*spill_threshold_bytes=*/1);
+  const std::vector<const Column*> columns = {int64_col_, string_col_};
+  ZETASQL_EXPECT_OK(store.BufferWriteOp(
+      InsertOp{table_, Key({Int64(2)}), columns, {Int64(2), String("new")}}));
+  ZETASQL_EXPECT_OK(store.BufferWriteOp(UpdateOp{
+      table_, Key({Int64(2)}), {string_col_}, {String("updated")}}));
+  ZETASQL_EXPECT_OK(store.BufferWriteOp(UpdateOp{
+      table_, Key({Int64(3)}), {string_col_}, {String("updated")}}));
+  ZETASQL_EXPECT_OK(store.BufferWriteOp(DeleteOp{table_, Key({Int64(5)})}));
+  EXPECT_GT(store.spilled_bytes(), 0);
+  EXPECT_EQ(store.bytes(), 0);
+
+  EXPECT_THAT(store.Lookup(table_, Key({Int64(2)}), columns),
+              IsOkAndHoldsRow({Int64(2), String("updated")}));
+  EXPECT_THAT(store.Lookup(table_, Key({Int64(5)}), columns),
+              StatusIs(absl::StatusCode::kNotFound));
+
+  std::unique_ptr<StorageIterator> itr;
+  ZETASQL_ASSERT_OK(store.Read(table_, KeyRange::All(), columns, &itr));
+  std::vector<ValueList> rows;
+  while (itr->Next()) {
+    rows.push_back({itr->ColumnValue(0), itr->ColumnValue(1)});
+  }
+  ZETASQL_EXPECT_OK(itr->Status());
+  EXPECT_THAT(rows, testing::ElementsAre(
+                        ValueList{Int64(1), String("base")},
+                        ValueList{Int64(2), String("updated")},
+                        ValueList{Int64(3), String("updated")}));
+
+  // Spilled mutations are folded into one operation per row on flush.
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::vector<WriteOp> buffered_ops,
+                       store.TakeBufferedOps());
+  ASSERT_EQ(buffered_ops.size(), 3);
+  EXPECT_THAT(buffered_ops[0], testing::VariantWith<InsertOp>(testing::_));
+  EXPECT_THAT(buffered_ops[1], testing::VariantWith<UpdateOp>(testing::_));
+  EXPECT_THAT(buffered_ops[2], testing::VariantWith<DeleteOp>(
+                                   DeleteOp{table_, Key({Int64(5)})}));
+  EXPECT_EQ(store.spilled_bytes(), 0);
+}
+
+TEST_F(TransactionStoreTest, PrefixDeleteHidesSpilledRows) {
+  TransactionStore store(base_storage_.get(), lock_handle_.get(),
+                         /*spill_threshold_bytes=*/1);
+  for (const int key : {1, 2}) {
+    ZETASQL_EXPECT_OK(store.BufferWriteOp(
+        InsertOp{table_, Key({Int64(key)}), {int64_col_}, {Int64(key)}}));
+  }
+  ZETASQL_EXPECT_OK(store.BufferWriteOp(DeleteOp{table_, Key()}));
+  EXPECT_THAT(store.Lookup(table_, Key({Int64(1)}), {int64_col_}),
+              StatusIs(absl::StatusCode::kNotFound));
+
+  std::unique_ptr<StorageIterator> itr;
+  ZETASQL_ASSERT_OK(store.Read(table_, KeyRange::All(), {int64_col_}, &itr));
+  EXPECT_FALSE(itr->Next());
+  ZETASQL_EXPECT_OK(itr->Status());
+}
+
 }  // namespace
 }  // namespace backend
 }  // namespace emulator
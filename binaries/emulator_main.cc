@@ -16,32 +16,148 @@
 
 #include <algorithm>
 #include <memory>
+#include <string>
+#include <thread>  // NOLINT
 
 #include "absl/flags/parse.h"
+#include "absl/status/status.h"
 #include "zetasql/base/logging.h"
 #include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "backend/query/query_engine.h"
 #include "common/config.h"
+#include "common/cpu_placement.h"
+#include "common/slow_log.h"
+#include "common/trace.h"
+#include "frontend/server/metrics_server.h"
+#include "frontend/server/rest_server.h"
 #include "frontend/server/server.h"
+#include "frontend/server/workload_capture.h"
 
+using QueryEngine = ::google::spanner::emulator::backend::QueryEngine;
+using MetricsServer = ::google::spanner::emulator::frontend::MetricsServer;
+using RestServer = ::google::spanner::emulator::frontend::RestServer;
 using Server = ::google::spanner::emulator::frontend::Server;
+namespace cpu_placement = ::google::spanner::emulator::cpu_placement;
+namespace workload_capture =
+    ::google::spanner::emulator::frontend::workload_capture;
 
 int main(int argc, char** argv) {
+  const absl::Time start_time = absl::Now();
+
   // Start the emulator gRPC server.
   absl::ParseCommandLine(argc, argv);
+
+  // Place threads before any is created, so that they all inherit the CPUs of
+  // the placement.
+  const auto placement = cpu_placement::ParsePlacement(
+      google::spanner::emulator::config::thread_placement());
+  if (!placement.ok()) {
+    LOG(ERROR) << placement.status();
+    return EXIT_FAILURE;
+  }
+  absl::Status placement_status = cpu_placement::Configure(
+      *placement, google::spanner::emulator::config::cpu_list());
+  if (!placement_status.ok()) {
+    LOG(ERROR) << "Failed to place threads: " << placement_status;
+    return EXIT_FAILURE;
+  }
+  google::spanner::emulator::trace::SetSamplingRate(
+      google::spanner::emulator::config::trace_sampling_rate());
+  google::spanner::emulator::slow_log::Configure(
+      google::spanner::emulator::config::slow_request_threshold(),
+      google::spanner::emulator::config::slow_request_log_max_per_second());
+  const std::string capture_path =
+      google::spanner::emulator::config::capture_workload_path();
+  if (!capture_path.empty()) {
+    absl::Status status = workload_capture::Start(capture_path);
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to start capturing calls: " << status;
+      return EXIT_FAILURE;
+    }
+    LOG(INFO) << "Capturing calls to " << capture_path;
+  }
+
   Server::Options options;
   options.server_address = google::spanner::emulator::config::grpc_host_port();
+  options.unix_socket_path =
+      google::spanner::emulator::config::grpc_unix_socket_path();
+  options.enable_async_server =
+      google::spanner::emulator::config::async_grpc_server_enabled();
+  options.num_completion_queue_threads =
+      google::spanner::emulator::config::grpc_completion_queue_threads();
+  options.num_handler_threads =
+      google::spanner::emulator::config::grpc_handler_threads();
+  options.response_compression =
+      google::spanner::emulator::config::grpc_response_compression();
+  options.stream_window_bytes =
+      google::spanner::emulator::config::grpc_stream_window_bytes();
+  options.max_concurrent_streams =
+      google::spanner::emulator::config::grpc_max_concurrent_streams();
+  options.keepalive_time =
+      google::spanner::emulator::config::grpc_keepalive_time();
+  options.keepalive_timeout =
+      google::spanner::emulator::config::grpc_keepalive_timeout();
   std::unique_ptr<Server> server = Server::Create(options);
   if (!server) {
     LOG(ERROR) << "Failed to start gRPC server.";
     return EXIT_FAILURE;
   }
 
+  // Start serving metrics, which also enables their collection.
+  std::unique_ptr<MetricsServer> metrics_server;
+  const std::string metrics_host_port =
+      google::spanner::emulator::config::metrics_host_port();
+  if (!metrics_host_port.empty()) {
+    metrics_server = MetricsServer::Create(metrics_host_port);
+    if (!metrics_server) {
+      LOG(ERROR) << "Failed to start metrics server.";
+      return EXIT_FAILURE;
+    }
+    LOG(INFO) << "Serving metrics at http://" << metrics_host_port
+              << "/metrics";
+  }
+
+  // Serve the REST API by transcoding requests to the gRPC handlers.
+  std::unique_ptr<RestServer> rest_server;
+  const std::string rest_host_port =
+      google::spanner::emulator::config::rest_host_port();
+  if (!rest_host_port.empty()) {
+    rest_server = RestServer::Create(rest_host_port, server->env());
+    if (!rest_server) {
+      LOG(ERROR) << "Failed to start REST server.";
+      return EXIT_FAILURE;
+    }
+    LOG(INFO) << "Serving REST at http://" << rest_host_port;
+  }
+
   LOG(INFO) << "Cloud Spanner Emulator running.";
   LOG(INFO) << "Server address: "
             << absl::StrCat(server->host(), ":", server->port());
+  if (!server->unix_socket_path().empty()) {
+    LOG(INFO) << "Serving gRPC on unix:" << server->unix_socket_path();
+  }
+  LOG(INFO) << "Ready in " << absl::Now() - start_time << ".";
+
+  // Initialize the query engine while clients connect, rather than on the
+  // first query. Requests are served meanwhile.
+  if (google::spanner::emulator::config::warm_up_query_engine()) {
+    std::thread([] {
+      const absl::Time warm_up_start = absl::Now();
+      absl::Status status = QueryEngine::WarmUp();
+      if (!status.ok()) {
+        LOG(WARNING) << "Failed to warm up the query engine: " << status;
+        return;
+      }
+      LOG(INFO) << "Query engine warmed up in "
+                << absl::Now() - warm_up_start << ".";
+    }).detach();
+  }
 
   // Block forever until the server is terminated.
   server->WaitForShutdown();
+  workload_capture::Stop();
 
   return EXIT_SUCCESS;
 }
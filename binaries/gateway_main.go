@@ -36,6 +36,12 @@ var (
 	grpcPort = flag.Int("grpc_port", 9010, "Port on which to run the emulator grpc server.")
 	httpPort = flag.Int("http_port", 9020, "Port on which to run the emulator http server.")
 
+	// Scaling related flags.
+	numBackends = flag.Int("num_backends", 1,
+		"Number of emulator grpc servers to place databases on. If more than 1, the grpc port "+
+			"is served by a router which forwards the requests of each database to one of the "+
+			"servers, which run on the ports following the grpc port.")
+
 	// Subprocess related flags.
 	grpcBinary = flag.String("grpc_binary", "emulator_main", "Location of the grpc binary.")
 
@@ -99,6 +105,7 @@ func main() {
 		CopyEmulatorStderr:   *copyEmulatorStderr,
 		LogRequests:          *logRequests,
 		EnableFaultInjection: *enableFaultInjection,
+		NumBackends:          *numBackends,
 	}
 	gw := gateway.New(gwopts)
 	gw.Run()
@@ -0,0 +1,211 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "common/benchmark.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/flags/flag.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_replace.h"
+#include "absl/strings/str_split.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+ABSL_FLAG(std::string, benchmark_format, "table",
+          "Format of the benchmark results: table or json.");
+ABSL_FLAG(absl::Duration, benchmark_min_time, absl::Milliseconds(500),
+          "Minimum time spent running each benchmark case.");
+ABSL_FLAG(std::string, benchmark_filter, "",
+          "Only run the benchmark cases whose name contains this string.");
+ABSL_FLAG(std::string, benchmark_baseline, "",
+          "Results of an earlier run, saved with --benchmark_format=json, "
+          "against which the results of this run are checked.");
+ABSL_FLAG(double, benchmark_max_regression, 0.1,
+          "Fraction by which a case may be slower than in the baseline.");
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+namespace {
+
+// Upper bound on the growth of the number of iterations between two calls, so
+// that a mis-estimate from a short first call cannot overshoot by far.
+constexpr int64_t kMaxIterationsGrowth = 10;
+
+double NanosPerIteration(absl::Duration elapsed, int64_t iterations) {
+  return absl::ToDoubleNanoseconds(elapsed) / iterations;
+}
+
+// Returns the time per iteration of each case of results printed as JSON by
+// Report, by case name. Each result is printed on a line of its own.
+absl::flat_hash_map<std::string, double> ParseResults(absl::string_view json) {
+  absl::flat_hash_map<std::string, double> results;
+  constexpr absl::string_view kName = "{\"name\": \"";
+  constexpr absl::string_view kNanosPerOp = "\"ns_per_op\": ";
+  for (absl::string_view line : absl::StrSplit(json, '\n')) {
+    size_t pos = line.find(kName);
+    if (pos == absl::string_view::npos) {
+      continue;
+    }
+    std::string name;
+    for (pos += kName.size(); pos < line.size() && line[pos] != '"'; ++pos) {
+      if (line[pos] == '\\' && pos + 1 < line.size()) {
+        ++pos;
+      }
+      name.push_back(line[pos]);
+    }
+    pos = line.find(kNanosPerOp, pos);
+    if (pos == absl::string_view::npos) {
+      continue;
+    }
+    absl::string_view value = line.substr(pos + kNanosPerOp.size());
+    value = value.substr(0, value.find_first_of(",}"));
+    double nanos_per_op;
+    if (absl::SimpleAtod(value, &nanos_per_op)) {
+      results[name] = nanos_per_op;
+    }
+  }
+  return results;
+}
+
+}  // namespace
+
+bool BenchmarkRunner::Run(const std::string& name,
+                          const std::function<void(int64_t iterations)>& fn) {
+  if (!absl::StrContains(name, absl::GetFlag(FLAGS_benchmark_filter))) {
+    return false;
+  }
+  const absl::Duration min_time = absl::GetFlag(FLAGS_benchmark_min_time);
+  int64_t iterations = 1;
+  while (true) {
+    absl::Time start = absl::Now();
+    fn(iterations);
+    absl::Duration elapsed = absl::Now() - start;
+    if (elapsed >= min_time) {
+      results_.push_back({name, iterations, elapsed, {}});
+      return true;
+    }
+    // Aim past the minimum time so that the next call is likely the last.
+    int64_t next_iterations = iterations * kMaxIterationsGrowth;
+    if (elapsed > absl::ZeroDuration()) {
+      next_iterations = std::min<int64_t>(
+          next_iterations, 1.2 * iterations * (min_time / elapsed) + 1);
+    }
+    iterations = std::max(iterations + 1, next_iterations);
+  }
+}
+
+void BenchmarkRunner::AddBreakdown(const std::string& part,
+                                   absl::Duration per_iteration) {
+  if (!results_.empty()) {
+    results_.back().breakdown.emplace_back(part, per_iteration);
+  }
+}
+
+bool BenchmarkRunner::CheckBaseline() const {
+  const std::string path = absl::GetFlag(FLAGS_benchmark_baseline);
+  if (path.empty()) {
+    return true;
+  }
+  std::ifstream file(path);
+  if (!file) {
+    std::fprintf(stderr, "Failed to open %s\n", path.c_str());
+    return false;
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return CheckBaseline(contents.str());
+}
+
+bool BenchmarkRunner::CheckBaseline(absl::string_view baseline_json) const {
+  const absl::flat_hash_map<std::string, double> baseline =
+      ParseResults(baseline_json);
+  const double max_regression = absl::GetFlag(FLAGS_benchmark_max_regression);
+  bool passed = true;
+  for (const Result& result : results_) {
+    auto itr = baseline.find(result.name);
+    if (itr == baseline.end()) {
+      continue;
+    }
+    const double nanos_per_op =
+        NanosPerIteration(result.elapsed, result.iterations);
+    if (nanos_per_op > itr->second * (1 + max_regression)) {
+      std::fprintf(stderr, "%s regressed: %.2f ns/op, baseline %.2f ns/op\n",
+                   result.name.c_str(), nanos_per_op, itr->second);
+      passed = false;
+    }
+  }
+  return passed;
+}
+
+void BenchmarkRunner::Report() const {
+  if (absl::GetFlag(FLAGS_benchmark_format) == "json") {
+    std::printf("[\n");
+    for (int i = 0; i < results_.size(); ++i) {
+      const Result& result = results_[i];
+      // Parts of the operation, if any, are reported as a nested object.
+      std::string breakdown;
+      for (const auto& [part, per_iteration] : result.breakdown) {
+        absl::StrAppend(&breakdown, breakdown.empty() ? "" : ", ",
+                        absl::StrFormat("\"%s\": %.2f", part,
+                                        absl::ToDoubleNanoseconds(
+                                            per_iteration)));
+      }
+      if (!breakdown.empty()) {
+        breakdown =
+            absl::StrCat(", \"breakdown_ns_per_op\": {", breakdown, "}");
+      }
+      std::printf(
+          "  {\"name\": \"%s\", \"iterations\": %lld, \"ns_per_op\": "
+          "%.2f%s}%s\n",
+          absl::StrReplaceAll(result.name, {{"\\", "\\\\"}, {"\"", "\\\""}})
+              .c_str(),
+          static_cast<long long>(result.iterations),  // NOLINT
+          NanosPerIteration(result.elapsed, result.iterations),
+          breakdown.c_str(),
+          i + 1 < results_.size() ? "," : "");
+    }
+    std::printf("]\n");
+    return;
+  }
+
+  std::printf("%-56s %14s %14s\n", "benchmark", "iterations", "ns/op");
+  for (const Result& result : results_) {
+    std::printf("%-56s %14lld %14.2f\n", result.name.c_str(),
+                static_cast<long long>(result.iterations),  // NOLINT
+                NanosPerIteration(result.elapsed, result.iterations));
+    for (const auto& [part, per_iteration] : result.breakdown) {
+      std::printf("  %-54s %14s %14.2f\n", part.c_str(), "",
+                  absl::ToDoubleNanoseconds(per_iteration));
+    }
+  }
+}
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,110 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_BENCHMARK_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_BENCHMARK_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+// BenchmarkRunner times the cases of a microbenchmark binary.
+//
+// Each case is a function performing a given number of iterations of the
+// measured operation. Run calls it with an increasing number of iterations
+// until a call takes at least --benchmark_min_time, and records the time per
+// iteration. Report prints the recorded results as a table or, with
+// --benchmark_format=json, as a JSON array so that results can be tracked over
+// time.
+//
+// Usage:
+//    BenchmarkRunner runner;
+//    runner.Run("Lookup/rows:1000", [&](int64_t iterations) {
+//      for (int64_t i = 0; i < iterations; ++i) { ... }
+//    });
+//    runner.Report();
+//
+// Cases whose name does not contain --benchmark_filter are skipped.
+//
+// A case can also report how its time splits between the parts of the
+// measured operation. The case measures the parts itself, and attaches them to
+// its result with AddBreakdown once Run returns:
+//    if (runner.Run("Query", fn)) {
+//      runner.AddBreakdown("analyze", analyze_time / total_iterations);
+//    }
+//
+// Results can be gated against those of an earlier run, saved with
+// --benchmark_format=json and passed back with --benchmark_baseline, so that
+// a binary can fail when a case gets slower than --benchmark_max_regression
+// allows:
+//    runner.Report();
+//    return runner.CheckBaseline() ? 0 : 1;
+class BenchmarkRunner {
+ public:
+  // Times `fn` and records the result under `name`. Returns false if the case
+  // was skipped by --benchmark_filter.
+  bool Run(const std::string& name,
+           const std::function<void(int64_t iterations)>& fn);
+
+  // Attaches the time per iteration spent in `part` of the operation to the
+  // result of the last case run.
+  void AddBreakdown(const std::string& part, absl::Duration per_iteration);
+
+  // Prints the results recorded so far to stdout.
+  void Report() const;
+
+  // Returns false if any case recorded so far took longer per iteration than
+  // the same case of the --benchmark_baseline file, by more than the fraction
+  // --benchmark_max_regression, after printing such cases to stderr. Cases
+  // missing from either run are ignored. Returns true if no baseline is given.
+  bool CheckBaseline() const;
+
+  // As CheckBaseline, but against the given baseline results, as printed by
+  // Report with --benchmark_format=json.
+  bool CheckBaseline(absl::string_view baseline_json) const;
+
+ private:
+  struct Result {
+    std::string name;
+    int64_t iterations;
+    absl::Duration elapsed;
+    std::vector<std::pair<std::string, absl::Duration>> breakdown;
+  };
+
+  std::vector<Result> results_;
+};
+
+// Prevents the compiler from optimizing away the computation of `value`,
+// whose result a benchmark case would otherwise discard.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_BENCHMARK_H_
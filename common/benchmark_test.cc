@@ -0,0 +1,78 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "common/benchmark.h"
+
+#include <cstdint>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace {
+
+// Runs a case named `name` which takes a millisecond per iteration.
+void RunSleep(BenchmarkRunner* runner, const std::string& name) {
+  runner->Run(name, [](int64_t iterations) {
+    absl::SleepFor(iterations * absl::Milliseconds(1));
+  });
+}
+
+TEST(BenchmarkRunnerTest, PassesWithoutBaseline) {
+  BenchmarkRunner runner;
+  RunSleep(&runner, "Sleep");
+  EXPECT_TRUE(runner.CheckBaseline());
+}
+
+TEST(BenchmarkRunnerTest, FailsOnCasesSlowerThanTheBaseline) {
+  BenchmarkRunner runner;
+  RunSleep(&runner, "Sleep");
+
+  EXPECT_TRUE(runner.CheckBaseline(
+      "[\n"
+      "  {\"name\": \"Sleep\", \"iterations\": 1, \"ns_per_op\": 1e9}\n"
+      "]\n"));
+  EXPECT_FALSE(runner.CheckBaseline(
+      "[\n"
+      "  {\"name\": \"Sleep\", \"iterations\": 1, \"ns_per_op\": 1000.00, "
+      "\"breakdown_ns_per_op\": {\"sleep\": 1000.00}}\n"
+      "]\n"));
+}
+
+TEST(BenchmarkRunnerTest, IgnoresCasesMissingFromTheBaseline) {
+  BenchmarkRunner runner;
+  RunSleep(&runner, "Sleep/\"quoted\"");
+
+  EXPECT_TRUE(runner.CheckBaseline(
+      "[\n"
+      "  {\"name\": \"Other\", \"iterations\": 1, \"ns_per_op\": 1.00}\n"
+      "]\n"));
+  EXPECT_FALSE(runner.CheckBaseline(
+      "[\n"
+      "  {\"name\": \"Other\", \"iterations\": 1, \"ns_per_op\": 1.00},\n"
+      "  {\"name\": \"Sleep/\\\"quoted\\\"\", \"iterations\": 1, "
+      "\"ns_per_op\": 1.00}\n"
+      "]\n"));
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,42 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "common/cancellation.h"
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "common/errors.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+absl::Status CancellationToken::Check() const {
+  if (cancelled_.load(std::memory_order_relaxed) ||
+      (is_cancelled_ && is_cancelled_())) {
+    return error::RequestCancelled();
+  }
+  if (deadline_ != absl::InfiniteFuture() && absl::Now() >= deadline_) {
+    return error::RequestDeadlineExceeded();
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,102 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_CANCELLATION_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_CANCELLATION_H_
+
+#include <atomic>
+#include <functional>
+#include <utility>
+
+#include "absl/time/time.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+// CancellationToken tells work done on behalf of a request, such as evaluating
+// a query, streaming the rows of a read or backfilling an index, whether the
+// request was abandoned, either cancelled or past its deadline, so that the
+// work stops and frees its thread. Checking a token is cheap but not free, so
+// loops over rows check it once per batch of rows, see CancellationCheck.
+//
+// This class is thread-safe.
+class CancellationToken {
+ public:
+  // Creates a token which is only cancelled by Cancel().
+  CancellationToken() = default;
+
+  // Creates a token which is also cancelled once `deadline` passes, or once
+  // `is_cancelled` returns true. `is_cancelled` must be thread-safe.
+  CancellationToken(absl::Time deadline, std::function<bool()> is_cancelled)
+      : deadline_(deadline), is_cancelled_(std::move(is_cancelled)) {}
+
+  CancellationToken(const CancellationToken&) = delete;
+  CancellationToken& operator=(const CancellationToken&) = delete;
+
+  // Cancels the token.
+  void Cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+  // Returns CANCELLED if the token was cancelled, DEADLINE_EXCEEDED if its
+  // deadline passed, and OK otherwise.
+  absl::Status Check() const;
+
+ private:
+  const absl::Time deadline_ = absl::InfiniteFuture();
+  const std::function<bool()> is_cancelled_;
+  std::atomic<bool> cancelled_{false};
+};
+
+// CancellationCheck checks a token at the first row of a loop, and then once
+// every kRowsPerCheck rows. A null token is never cancelled.
+//
+// This class is not thread-safe.
+class CancellationCheck {
+ public:
+  static constexpr int kRowsPerCheck = 256;
+
+  explicit CancellationCheck(const CancellationToken* token) : token_(token) {}
+
+  // Counts one row, and returns the status of the token if it is checked at
+  // this row, or OK otherwise.
+  absl::Status OnRow() {
+    if (rows_until_check_ > 0) {
+      --rows_until_check_;
+      return absl::OkStatus();
+    }
+    return Check();
+  }
+
+  // Returns the status of the token, for batch boundaries.
+  absl::Status Check() {
+    rows_until_check_ = kRowsPerCheck - 1;
+    return token_ == nullptr ? absl::OkStatus() : token_->Check();
+  }
+
+ private:
+  const CancellationToken* const token_;
+
+  // Rows to count before the token is checked again.
+  int rows_until_check_ = 0;
+};
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_CANCELLATION_H_
@@ -0,0 +1,97 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "common/cancellation.h"
+
+#include <atomic>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+namespace {
+
+using zetasql_base::testing::StatusIs;
+
+TEST(CancellationToken, IsNotCancelledByDefault) {
+  CancellationToken token;
+  ZETASQL_EXPECT_OK(token.Check());
+}
+
+TEST(CancellationToken, IsCancelledByCancel) {
+  CancellationToken token;
+  token.Cancel();
+  EXPECT_THAT(token.Check(), StatusIs(absl::StatusCode::kCancelled));
+}
+
+TEST(CancellationToken, IsCancelledOnceCallbackReturnsTrue) {
+  std::atomic<bool> cancelled(false);
+  CancellationToken token(absl::InfiniteFuture(),
+                          [&cancelled]() { return cancelled.load(); });
+  ZETASQL_EXPECT_OK(token.Check());
+  cancelled = true;
+  EXPECT_THAT(token.Check(), StatusIs(absl::StatusCode::kCancelled));
+}
+
+TEST(CancellationToken, ExpiresOnceDeadlinePassed) {
+  CancellationToken future_token(absl::Now() + absl::Hours(1), nullptr);
+  ZETASQL_EXPECT_OK(future_token.Check());
+
+  CancellationToken past_token(absl::Now() - absl::Seconds(1), nullptr);
+  EXPECT_THAT(past_token.Check(),
+              StatusIs(absl::StatusCode::kDeadlineExceeded));
+}
+
+TEST(CancellationCheck, ChecksTokenOncePerBatchOfRows) {
+  CancellationToken token;
+  CancellationCheck check(&token);
+  ZETASQL_EXPECT_OK(check.OnRow());
+  token.Cancel();
+  for (int i = 1; i < CancellationCheck::kRowsPerCheck; ++i) {
+    ZETASQL_EXPECT_OK(check.OnRow());
+  }
+  EXPECT_THAT(check.OnRow(), StatusIs(absl::StatusCode::kCancelled));
+  EXPECT_THAT(check.Check(), StatusIs(absl::StatusCode::kCancelled));
+}
+
+TEST(CancellationCheck, ChecksTokenAtFirstRow) {
+  CancellationToken token;
+  token.Cancel();
+  CancellationCheck check(&token);
+  EXPECT_THAT(check.OnRow(), StatusIs(absl::StatusCode::kCancelled));
+}
+
+TEST(CancellationCheck, NullTokenIsNeverCancelled) {
+  CancellationCheck check(nullptr);
+  for (int i = 0; i < CancellationCheck::kRowsPerCheck; ++i) {
+    ZETASQL_EXPECT_OK(check.OnRow());
+  }
+  ZETASQL_EXPECT_OK(check.Check());
+}
+
+}  // namespace
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
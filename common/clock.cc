@@ -16,6 +16,9 @@
 
 #include "common/clock.h"
 
+#include <algorithm>
+#include <cstdint>
+
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
 
@@ -23,29 +26,34 @@ namespace google {
 namespace spanner {
 namespace emulator {
 
-namespace {
-
-// Returns the current time at microsecond granularity.
-absl::Time NowMicros() {
-  return absl::FromUnixMicros(absl::ToUnixMicros(absl::Now()));
-}
-
-}  // namespace
-
-Clock::Clock()
-    : last_system_time_(NowMicros()), last_dispensed_time_(last_system_time_) {}
+Clock::Clock() : last_dispensed_micros_(absl::ToUnixMicros(absl::Now())) {}
 
 absl::Time Clock::Now() {
-  absl::MutexLock lock(&mu_);
-
-  absl::Time now = NowMicros();
-  absl::Time next_dispensed_time =
-      last_dispensed_time_ +
-      std::max(absl::Microseconds(1), now - last_system_time_);
-  last_system_time_ = now;
-  last_dispensed_time_ = next_dispensed_time;
+  const int64_t now_micros = absl::ToUnixMicros(absl::Now());
+  int64_t last_micros = last_dispensed_micros_.load(std::memory_order_relaxed);
+  int64_t next_micros;
+  // Each successful exchange hands out a value past the one it replaced, so
+  // concurrent callers never receive the same value. A failed exchange
+  // reloads the last value and retries.
+  do {
+    next_micros = std::max(now_micros, last_micros + 1);
+  } while (!last_dispensed_micros_.compare_exchange_weak(last_micros,
+                                                         next_micros));
+  return absl::FromUnixMicros(next_micros);
+}
 
-  return last_dispensed_time_;
+absl::Time Clock::NowForRead() {
+  const int64_t now_micros = absl::ToUnixMicros(absl::Now());
+  // The clock is only advanced if the system clock moved past the last value,
+  // which happens at most once per microsecond.
+  int64_t last_micros = last_dispensed_micros_.load();
+  while (last_micros < now_micros) {
+    if (last_dispensed_micros_.compare_exchange_weak(last_micros,
+                                                     now_micros)) {
+      return absl::FromUnixMicros(now_micros);
+    }
+  }
+  return absl::FromUnixMicros(last_micros);
 }
 
 }  // namespace emulator
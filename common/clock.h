@@ -17,7 +17,9 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_CLOCK_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_CLOCK_H_
 
-#include "absl/synchronization/mutex.h"
+#include <atomic>
+#include <cstdint>
+
 #include "absl/time/time.h"
 
 namespace google {
@@ -37,23 +39,31 @@ namespace emulator {
 //   This is to conform with Cloud Spanner's commit timestamps which also
 //   operate at microsecond resolution.
 //
-// This class is thread safe.
+// Values follow the system clock, except that a call which would not return a
+// later value than the previous one (because several calls happen within the
+// same microsecond, or the system clock stepped back) returns one microsecond
+// past the previous value instead.
+//
+// This class is thread safe and lock-free, as it is called for every commit
+// and read timestamp of all databases.
 class Clock {
  public:
   Clock();
 
   // Returns the current time.
-  absl::Time Now() ABSL_LOCKS_EXCLUDED(mu_);
+  absl::Time Now();
 
- private:
-  // Mutex to guard state below.
-  absl::Mutex mu_;
+  // Returns the current time for use as a read timestamp. Unlike Now(), the
+  // value is not necessarily distinct: it may equal the value last returned by
+  // Now() or NowForRead(), so that concurrent callers within a microsecond
+  // share a value instead of contending to advance the clock. Later calls to
+  // Now() still return greater values.
+  absl::Time NowForRead();
 
-  // The last value we got from the system clock.
-  absl::Time last_system_time_ ABSL_GUARDED_BY(mu_);
-
-  // The last value we handed out in a call to Clock::Now().
-  absl::Time last_dispensed_time_ ABSL_GUARDED_BY(mu_);
+ private:
+  // The last value we handed out in a call to Clock::Now(), in microseconds
+  // since the Unix epoch.
+  std::atomic<int64_t> last_dispensed_micros_;
 };
 
 }  // namespace emulator
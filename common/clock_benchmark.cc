@@ -0,0 +1,106 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Measures the throughput of Clock::Now() when called concurrently by an
+// increasing number of threads, along with that of a clock which serializes
+// its callers on a mutex, as Clock did before it was made lock-free. Results
+// are reported as the wall time per call across all threads.
+//
+// Usage: clock_benchmark [--max_threads=64] [--benchmark_format=table|json]
+//            [--benchmark_min_time=500ms] [--benchmark_filter=...]
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "common/benchmark.h"
+#include "common/clock.h"
+
+ABSL_FLAG(int, max_threads, 64, "Largest number of concurrent callers.");
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace {
+
+// A strictly monotonic clock guarding its state with a mutex.
+class MutexClock {
+ public:
+  absl::Time Now() ABSL_LOCKS_EXCLUDED(mu_) {
+    absl::MutexLock lock(&mu_);
+    absl::Time now = absl::FromUnixMicros(absl::ToUnixMicros(absl::Now()));
+    last_dispensed_time_ =
+        std::max(now, last_dispensed_time_ + absl::Microseconds(1));
+    return last_dispensed_time_;
+  }
+
+ private:
+  absl::Mutex mu_;
+  absl::Time last_dispensed_time_ ABSL_GUARDED_BY(mu_) = absl::UnixEpoch();
+};
+
+// Calls clock->Now() `iterations` times in total, split evenly between
+// `num_threads` threads.
+template <typename ClockType>
+void CallNow(ClockType* clock, int num_threads, int64_t iterations) {
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([=]() {
+      for (int64_t i = t; i < iterations; i += num_threads) {
+        DoNotOptimize(clock->Now());
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+void RunBenchmark() {
+  BenchmarkRunner runner;
+  for (int num_threads = 1; num_threads <= absl::GetFlag(FLAGS_max_threads);
+       num_threads *= 2) {
+    Clock clock;
+    MutexClock mutex_clock;
+    runner.Run(absl::StrCat("Clock::Now/threads:", num_threads),
+               [&](int64_t iterations) {
+                 CallNow(&clock, num_threads, iterations);
+               });
+    runner.Run(absl::StrCat("MutexClock::Now/threads:", num_threads),
+               [&](int64_t iterations) {
+                 CallNow(&mutex_clock, num_threads, iterations);
+               });
+  }
+  runner.Report();
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  google::spanner::emulator::RunBenchmark();
+  return 0;
+}
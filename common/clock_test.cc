@@ -16,10 +16,15 @@
 
 #include "common/clock.h"
 
+#include <algorithm>
+#include <thread>  // NOLINT
+#include <vector>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "zetasql/base/testing/status_matchers.h"
 #include "tests/common/proto_matchers.h"
+#include "absl/time/time.h"
 
 namespace google {
 namespace spanner {
@@ -42,6 +47,48 @@ TEST(Clock, ClockReturnsValuesAtMicrosecondGranularity) {
   EXPECT_EQ(t1, absl::FromUnixMicros(absl::ToUnixMicros(t1)));
 }
 
+TEST(Clock, ClockReturnsDistinctIncreasingValuesToConcurrentCallers) {
+  constexpr int kNumThreads = 8;
+  constexpr int kCallsPerThread = 10000;
+  Clock clock;
+  std::vector<std::vector<absl::Time>> values(kNumThreads);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&clock, &values, i]() {
+      for (int j = 0; j < kCallsPerThread; ++j) {
+        values[i].push_back(clock.Now());
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<absl::Time> all_values;
+  for (const std::vector<absl::Time>& thread_values : values) {
+    EXPECT_TRUE(std::is_sorted(thread_values.begin(), thread_values.end()));
+    all_values.insert(all_values.end(), thread_values.begin(),
+                      thread_values.end());
+  }
+  std::sort(all_values.begin(), all_values.end());
+  EXPECT_EQ(std::adjacent_find(all_values.begin(), all_values.end()),
+            all_values.end());
+}
+
+TEST(Clock, ReadTimestampsAreNotBeforeAndNotAfterClockValues) {
+  Clock clock;
+  absl::Time t1 = clock.Now();
+  absl::Time read_timestamp = clock.NowForRead();
+  absl::Time t2 = clock.Now();
+
+  // Read timestamps may be shared with the last value of the clock, but later
+  // values of the clock are greater.
+  EXPECT_GE(read_timestamp, t1);
+  EXPECT_GT(t2, read_timestamp);
+  EXPECT_EQ(read_timestamp,
+            absl::FromUnixMicros(absl::ToUnixMicros(read_timestamp)));
+}
+
 }  // namespace
 
 }  // namespace frontend
@@ -17,20 +17,263 @@
 #include "common/config.h"
 
 #include "absl/flags/flag.h"
+#include "absl/time/time.h"
 
 ABSL_FLAG(std::string, host_port, "localhost:10007",
           "Emulator host IP and port that serves Cloud Spanner gRPC requests.");
 
+ABSL_FLAG(std::string, unix_socket_path, "",
+          "If set, the emulator also serves Cloud Spanner gRPC requests on a "
+          "Unix domain socket at this path, which clients on the same host "
+          "reach as unix:<path> with less overhead per request than over TCP "
+          "loopback. A socket left at the path by a previous run is replaced.");
+
 ABSL_FLAG(bool, log_requests, false,
           "If true, gRPC request and response messages are streamed to the "
           "INFO log. This switch is intended for emulator debugging.");
 
+ABSL_FLAG(std::string, capture_workload_path, "",
+          "If set, every gRPC call served (with its request, first response "
+          "and timing) is appended to a capture file at this path, which "
+          "tests/load:workload_replay replays against another emulator to "
+          "compare their latencies.");
+
 ABSL_FLAG(
     bool, enable_fault_injection, false,
     "If true, the emulator will inject faults to allow testing application "
     "error handling behavior. For instance, transaction Commits may be aborted "
     "to facilitate application abort-retry testing.");
 
+ABSL_FLAG(absl::Duration, version_retention_period, absl::Hours(1),
+          "The period for which old versions of data are retained to serve "
+          "stale reads. Older versions are garbage collected in the "
+          "background.");
+
+ABSL_FLAG(bool, enable_async_grpc_server, false,
+          "If true, the emulator serves gRPC requests asynchronously: a small "
+          "number of completion queue threads accept requests and hand them "
+          "to a bounded pool of handler threads, instead of dedicating a "
+          "synchronous gRPC server thread to each in-flight request.");
+
+ABSL_FLAG(int, grpc_completion_queue_threads, 4,
+          "Number of threads polling gRPC completion queues when "
+          "--enable_async_grpc_server is set.");
+
+ABSL_FLAG(int, grpc_handler_threads, 64,
+          "Number of threads running request handlers (which may block on "
+          "locks and reads) when --enable_async_grpc_server is set. Requests "
+          "beyond this many wait in a queue.");
+
+ABSL_FLAG(std::string, grpc_response_compression, "",
+          "If set to gzip or deflate, gRPC responses are compressed with this "
+          "algorithm for clients which accept it, which speeds up large "
+          "result sets of text over slow networks at the cost of CPU. Empty "
+          "leaves responses uncompressed.");
+
+ABSL_FLAG(int, grpc_stream_window_bytes, 0,
+          "If positive, the initial HTTP/2 flow-control window of each gRPC "
+          "stream, so that large responses are not stalled waiting for "
+          "window updates over high-latency networks. 0 keeps the gRPC "
+          "default, which grows the window with the measured bandwidth.");
+
+ABSL_FLAG(int, grpc_max_concurrent_streams, 0,
+          "If positive, the maximum number of concurrent gRPC streams on each "
+          "HTTP/2 connection. 0 does not limit them.");
+
+ABSL_FLAG(absl::Duration, grpc_keepalive_time, absl::ZeroDuration(),
+          "If positive, the server pings each idle gRPC connection this often, "
+          "and accepts keepalive pings from clients at this rate, so that "
+          "connections through proxies and load balancers are kept open. 0 "
+          "keeps the gRPC default.");
+
+ABSL_FLAG(absl::Duration, grpc_keepalive_timeout, absl::Seconds(20),
+          "Time after which a gRPC connection is closed if a keepalive ping "
+          "is not acknowledged, when --grpc_keepalive_time is set.");
+
+ABSL_FLAG(bool, enable_storage_key_filters, true,
+          "If true, storage keeps a Bloom filter over the keys written to "
+          "each table, so that lookups and prefix reads of keys which were "
+          "never written (such as the existence checks of bulk inserts) "
+          "return without searching the table.");
+
+ABSL_FLAG(bool, enable_storage_value_interning, true,
+          "If true, storage interns the short STRING and BYTES values written "
+          "to each table, so that repeated values (such as those of enum-like "
+          "columns) share a single buffer instead of each row and version "
+          "holding its own copy.");
+
+ABSL_FLAG(int64_t, storage_compression_threshold_bytes, 4096,
+          "STRING and BYTES values of at least this many bytes are kept "
+          "compressed in the older versions of rows, and decompressed when "
+          "read at a past timestamp. 0 disables compression.");
+
+ABSL_FLAG(bool, enable_interleaved_storage_layout, false,
+          "If true, storage keeps the rows of interleaved tables in the table "
+          "of their interleave root, each under its parent row, so that "
+          "reading a parent row with its children and cascading deletes walk "
+          "a single range of rows. Otherwise each table keeps its own rows.");
+
+ABSL_FLAG(int, executor_threads, 0,
+          "Number of worker threads shared by all work the emulator runs in "
+          "parallel, such as parallel queries and reads, index backfills, "
+          "schema verifiers, partitioned DML and exports. 0 uses one thread "
+          "per hardware thread of the machine (or of --cpu_list).");
+
+ABSL_FLAG(std::string, thread_placement, "none",
+          "How the threads of the emulator's pools (the shared executor, the "
+          "completion queue pollers and handlers of the asynchronous gRPC "
+          "server) are pinned to CPUs on Linux: \"none\" lets them run on "
+          "any CPU, \"numa\" pins each thread to the CPUs of one NUMA node "
+          "and \"core\" to a single CPU, with successive threads spread "
+          "over the nodes in turn, so that threads and the memory they "
+          "allocate stay on one node of multi-socket machines.");
+
+ABSL_FLAG(std::string, cpu_list, "",
+          "If set, the CPUs the emulator runs on, in the format of Linux's "
+          "cpulist files (e.g. \"0-7,16-23\"), to which all its threads, "
+          "including those created by gRPC, are restricted. Empty uses all "
+          "the CPUs the process may run on.");
+
+ABSL_FLAG(int, parallel_query_threads, 0,
+          "If positive, queries in read-only transactions which are simple "
+          "scans of a large table (i.e. root-partitionable queries) are split "
+          "by key range and up to this many ranges of each query are "
+          "evaluated in parallel on the shared executor (see "
+          "--executor_threads). 0 evaluates every query on the thread "
+          "handling the request.");
+
+ABSL_FLAG(int, parallel_read_threads, 0,
+          "If positive, reads in read-only transactions of several key ranges, "
+          "or of a range of many rows, are split into ranges of which up to "
+          "this many are read in parallel on the shared executor (see "
+          "--executor_threads), and their rows are returned in key order. 0 "
+          "performs every read on the thread handling the request.");
+
+ABSL_FLAG(int64_t, query_result_cache_bytes, 0,
+          "If positive, the rows of queries in read-only transactions are "
+          "cached, up to this many bytes per database, and returned for "
+          "later executions of the same query with the same parameters as "
+          "long as the tables it read have not changed. Queries calling "
+          "functions such as CURRENT_TIMESTAMP() or RAND() are not cached. 0 "
+          "disables the cache.");
+
+ABSL_FLAG(absl::Duration, lock_wait_timeout, absl::Milliseconds(100),
+          "How long a transaction waits for a conflicting lock held by an "
+          "older or committing transaction to be released before it is "
+          "aborted. Older transactions never wait for younger ones, they "
+          "abort them instead (wound-wait), so waits cannot deadlock. 0 "
+          "aborts conflicting transactions right away.");
+
+ABSL_FLAG(bool, optimistic_read_write_transactions, false,
+          "If true, read-write transactions read without taking locks. The "
+          "rows each transaction read are validated when it commits, and it "
+          "is aborted if a transaction which committed in the meantime wrote "
+          "any of them. Writes still take locks. Suits workloads whose reads "
+          "rarely conflict with concurrent writes.");
+
+ABSL_FLAG(std::string, metrics_host_port, "",
+          "If set, the emulator collects request and stage latency "
+          "histograms and counters, and serves them in the Prometheus text "
+          "format at http://<metrics_host_port>/metrics. For example, "
+          "localhost:9090. Emulators built with --config=tcmalloc also serve "
+          "pprof heap and CPU profiles under /debug/pprof/.");
+
+ABSL_FLAG(std::string, rest_host_port, "",
+          "If set, the emulator serves the Cloud Spanner REST API at "
+          "http://<rest_host_port> by transcoding HTTP/JSON requests to its "
+          "gRPC handlers in process, without the separate gateway. For "
+          "example, localhost:9020.");
+
+ABSL_FLAG(double, trace_sampling_rate, 0,
+          "Fraction of requests, between 0 and 1, whose per-stage spans are "
+          "traced. Requests which propagate a sampled traceparent or "
+          "x-cloud-trace-context header are traced whenever this is nonzero. "
+          "Recent traces are served at http://<metrics_host_port>/traces.");
+
+ABSL_FLAG(int64_t, max_database_memory_bytes, 0,
+          "If nonzero, the approximate number of bytes of memory which the "
+          "rows and the buffered mutations of each database may hold. Inserts "
+          "and updates into a database which exceeds it fail with "
+          "RESOURCE_EXHAUSTED, while deletes are always allowed.");
+
+ABSL_FLAG(int64_t, transaction_spill_threshold_bytes, 0,
+          "If nonzero, the approximate number of bytes of memory which the "
+          "mutations buffered by a read-write transaction may hold before "
+          "they are spilled to sorted runs in temporary files.");
+
+ABSL_FLAG(std::string, transaction_spill_directory, "",
+          "Directory holding the temporary files of spilled transaction "
+          "mutations. Defaults to $TMPDIR, or /tmp if it is not set.");
+
+ABSL_FLAG(absl::Duration, slow_request_threshold, absl::ZeroDuration(),
+          "If nonzero, requests which take longer are logged on a single line "
+          "with the fingerprint of their SQL text, the rows they scanned, the "
+          "time they waited for locks and the transaction which caused them "
+          "to abort, if any. Unlike --log_requests, this is cheap enough to "
+          "leave on under load.");
+
+ABSL_FLAG(int, slow_request_log_max_per_second, 10,
+          "Maximum number of slow requests logged per second, or 0 for no "
+          "limit. Requests over the limit are counted in the next line "
+          "logged.");
+
+ABSL_FLAG(int64_t, streaming_chunk_size_bytes, 1024 * 1024,
+          "Approximate size up to which rows are coalesced into each "
+          "PartialResultSet returned by ExecuteStreamingSql and StreamingRead. "
+          "Smaller values shorten the time to the first response, larger ones "
+          "send fewer messages. Values are only split across responses if "
+          "they do not fit into one. Clamped to between 1 KiB and the 1 MiB "
+          "limit of Cloud Spanner.");
+
+ABSL_FLAG(int, database_creation_threads, 8,
+          "Number of threads creating databases. CreateDatabase returns its "
+          "operation right away, and the database, with its initial schema, "
+          "is created on one of these threads, so that databases created at "
+          "once are built in parallel without holding up request handlers.");
+
+ABSL_FLAG(bool, warm_up_query_engine, true,
+          "If true, the query engine is initialized on a background thread "
+          "once the emulator is serving, so that the first query does not pay "
+          "for setting up the builtin functions, analyzer and evaluator.");
+
+ABSL_FLAG(absl::Duration, max_transaction_idle_time, absl::Seconds(10),
+          "Read-write transactions which run no operation for longer than "
+          "this are aborted, releasing their locks, so that transactions "
+          "abandoned by their clients do not block others. Zero disables "
+          "aborting idle transactions.");
+
+ABSL_FLAG(int64_t, change_stream_retained_changes, 0,
+          "If nonzero, each database keeps about this many of its most "
+          "recently committed row changes, which consumers can tail in commit "
+          "timestamp order instead of polling tables for changes. Zero "
+          "disables recording changes.");
+
+ABSL_FLAG(int, max_concurrent_queries_per_database, 0,
+          "If positive, queries and DML statements beyond this many running "
+          "at once in a database fail with RESOURCE_EXHAUSTED. A query runs "
+          "until its results are read. 0 does not limit concurrent queries.");
+
+ABSL_FLAG(int64_t, max_rows_scanned_per_query, 0,
+          "If positive, queries and DML statements which read more than this "
+          "many rows from tables and indexes fail with RESOURCE_EXHAUSTED. 0 "
+          "does not limit the rows scanned.");
+
+ABSL_FLAG(int64_t, max_query_memory_bytes, 0,
+          "If positive, queries and DML statements whose intermediate results "
+          "(such as rows being sorted, aggregated or joined) need more than "
+          "this many bytes fail with RESOURCE_EXHAUSTED. 0 uses the default "
+          "limit of the query evaluator.");
+
+ABSL_FLAG(int64_t, query_sort_spill_threshold_bytes, 0,
+          "If nonzero, the rows of queries with an outermost ORDER BY are "
+          "sorted by the emulator rather than by the query evaluator, and "
+          "the rows being sorted are spilled to sorted runs in temporary "
+          "files once they hold approximately this many bytes.");
+
+ABSL_FLAG(std::string, query_sort_spill_directory, "",
+          "Directory holding the temporary files of spilled query sorts. "
+          "Defaults to $TMPDIR, or /tmp if it is not set.");
+
 namespace google {
 namespace spanner {
 namespace emulator {
@@ -38,12 +281,168 @@ namespace config {
 
 std::string grpc_host_port() { return absl::GetFlag(FLAGS_host_port); }
 
+std::string grpc_unix_socket_path() {
+  return absl::GetFlag(FLAGS_unix_socket_path);
+}
+
 bool should_log_requests() { return absl::GetFlag(FLAGS_log_requests); }
 
+std::string capture_workload_path() {
+  return absl::GetFlag(FLAGS_capture_workload_path);
+}
+
 bool fault_injection_enabled() {
   return absl::GetFlag(FLAGS_enable_fault_injection);
 }
 
+absl::Duration version_retention_period() {
+  return absl::GetFlag(FLAGS_version_retention_period);
+}
+
+bool async_grpc_server_enabled() {
+  return absl::GetFlag(FLAGS_enable_async_grpc_server);
+}
+
+int grpc_completion_queue_threads() {
+  return absl::GetFlag(FLAGS_grpc_completion_queue_threads);
+}
+
+int grpc_handler_threads() { return absl::GetFlag(FLAGS_grpc_handler_threads); }
+
+std::string grpc_response_compression() {
+  return absl::GetFlag(FLAGS_grpc_response_compression);
+}
+
+int grpc_stream_window_bytes() {
+  return absl::GetFlag(FLAGS_grpc_stream_window_bytes);
+}
+
+int grpc_max_concurrent_streams() {
+  return absl::GetFlag(FLAGS_grpc_max_concurrent_streams);
+}
+
+absl::Duration grpc_keepalive_time() {
+  return absl::GetFlag(FLAGS_grpc_keepalive_time);
+}
+
+absl::Duration grpc_keepalive_timeout() {
+  return absl::GetFlag(FLAGS_grpc_keepalive_timeout);
+}
+
+bool storage_key_filters_enabled() {
+  return absl::GetFlag(FLAGS_enable_storage_key_filters);
+}
+
+bool storage_value_interning_enabled() {
+  return absl::GetFlag(FLAGS_enable_storage_value_interning);
+}
+
+int64_t storage_compression_threshold_bytes() {
+  return absl::GetFlag(FLAGS_storage_compression_threshold_bytes);
+}
+
+bool storage_interleaved_layout_enabled() {
+  return absl::GetFlag(FLAGS_enable_interleaved_storage_layout);
+}
+
+int executor_threads() { return absl::GetFlag(FLAGS_executor_threads); }
+
+std::string thread_placement() {
+  return absl::GetFlag(FLAGS_thread_placement);
+}
+
+std::string cpu_list() { return absl::GetFlag(FLAGS_cpu_list); }
+
+int parallel_query_threads() {
+  return absl::GetFlag(FLAGS_parallel_query_threads);
+}
+
+int parallel_read_threads() {
+  return absl::GetFlag(FLAGS_parallel_read_threads);
+}
+
+int64_t query_result_cache_bytes() {
+  return absl::GetFlag(FLAGS_query_result_cache_bytes);
+}
+
+absl::Duration lock_wait_timeout() {
+  return absl::GetFlag(FLAGS_lock_wait_timeout);
+}
+
+bool optimistic_read_write_transactions() {
+  return absl::GetFlag(FLAGS_optimistic_read_write_transactions);
+}
+
+std::string metrics_host_port() {
+  return absl::GetFlag(FLAGS_metrics_host_port);
+}
+
+std::string rest_host_port() { return absl::GetFlag(FLAGS_rest_host_port); }
+
+double trace_sampling_rate() {
+  return absl::GetFlag(FLAGS_trace_sampling_rate);
+}
+
+absl::Duration slow_request_threshold() {
+  return absl::GetFlag(FLAGS_slow_request_threshold);
+}
+
+int slow_request_log_max_per_second() {
+  return absl::GetFlag(FLAGS_slow_request_log_max_per_second);
+}
+
+int64_t max_database_memory_bytes() {
+  return absl::GetFlag(FLAGS_max_database_memory_bytes);
+}
+
+int64_t transaction_spill_threshold_bytes() {
+  return absl::GetFlag(FLAGS_transaction_spill_threshold_bytes);
+}
+
+std::string transaction_spill_directory() {
+  return absl::GetFlag(FLAGS_transaction_spill_directory);
+}
+
+int64_t streaming_chunk_size_bytes() {
+  return absl::GetFlag(FLAGS_streaming_chunk_size_bytes);
+}
+
+int database_creation_threads() {
+  return absl::GetFlag(FLAGS_database_creation_threads);
+}
+
+bool warm_up_query_engine() {
+  return absl::GetFlag(FLAGS_warm_up_query_engine);
+}
+
+absl::Duration max_transaction_idle_time() {
+  return absl::GetFlag(FLAGS_max_transaction_idle_time);
+}
+
+int64_t change_stream_retained_changes() {
+  return absl::GetFlag(FLAGS_change_stream_retained_changes);
+}
+
+int max_concurrent_queries_per_database() {
+  return absl::GetFlag(FLAGS_max_concurrent_queries_per_database);
+}
+
+int64_t max_rows_scanned_per_query() {
+  return absl::GetFlag(FLAGS_max_rows_scanned_per_query);
+}
+
+int64_t max_query_memory_bytes() {
+  return absl::GetFlag(FLAGS_max_query_memory_bytes);
+}
+
+int64_t query_sort_spill_threshold_bytes() {
+  return absl::GetFlag(FLAGS_query_sort_spill_threshold_bytes);
+}
+
+std::string query_sort_spill_directory() {
+  return absl::GetFlag(FLAGS_query_sort_spill_directory);
+}
+
 }  // namespace config
 }  // namespace emulator
 }  // namespace spanner
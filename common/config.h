@@ -17,8 +17,11 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_CONFIG_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_CONFIG_H_
 
+#include <cstdint>
 #include <string>
 
+#include "absl/time/time.h"
+
 namespace google {
 namespace spanner {
 namespace emulator {
@@ -27,12 +30,175 @@ namespace config {
 // The address at which the emulator will serve gRPC requests.
 std::string grpc_host_port();
 
+// The path of the Unix domain socket at which the emulator also serves gRPC
+// requests, or an empty string if it only serves them over TCP.
+std::string grpc_unix_socket_path();
+
 // If true, gRPC requests and response messages are streamed to the INFO log.
 bool should_log_requests();
 
+// Returns the path of the file to which the calls served are captured, or an
+// empty string if they are not captured.
+std::string capture_workload_path();
+
 // Returns true if fault injection is enabled.
 bool fault_injection_enabled();
 
+// Returns the period for which old versions of data are retained. Reads at
+// timestamps older than this are rejected and the versions they would have
+// seen are garbage collected.
+absl::Duration version_retention_period();
+
+// Returns true if gRPC requests should be served by the asynchronous server.
+bool async_grpc_server_enabled();
+
+// Number of threads polling completion queues in the asynchronous server.
+int grpc_completion_queue_threads();
+
+// Number of threads running request handlers in the asynchronous server.
+int grpc_handler_threads();
+
+// Algorithm compressing gRPC responses for clients which accept it, "gzip" or
+// "deflate", or an empty string if responses are not compressed.
+std::string grpc_response_compression();
+
+// Initial HTTP/2 flow-control window of each gRPC stream, or 0 for the gRPC
+// default.
+int grpc_stream_window_bytes();
+
+// Maximum number of concurrent gRPC streams per connection, or 0 if they are
+// not limited.
+int grpc_max_concurrent_streams();
+
+// Interval of keepalive pings on idle gRPC connections, or zero for the gRPC
+// default.
+absl::Duration grpc_keepalive_time();
+
+// Time to wait for the acknowledgement of a keepalive ping.
+absl::Duration grpc_keepalive_timeout();
+
+// Returns true if storage keeps a filter over the keys of each table to speed
+// up lookups of keys which do not exist.
+bool storage_key_filters_enabled();
+
+// Returns true if storage interns short STRING and BYTES values, so that
+// repeated values share a single buffer.
+bool storage_value_interning_enabled();
+
+// Returns the size from which STRING and BYTES values of older versions of
+// rows are compressed by storage, or 0 if they are never compressed.
+int64_t storage_compression_threshold_bytes();
+
+// Returns true if storage keeps the rows of interleaved tables with those of
+// their parents, rather than in a table of their own.
+bool storage_interleaved_layout_enabled();
+
+// Number of worker threads of the executor shared by all parallel work, such
+// as parallel queries and reads, backfills and partitioned DML, or 0 for one
+// per CPU the emulator runs on.
+int executor_threads();
+
+// Returns how the threads of the emulator's pools are pinned to CPUs: "none",
+// "numa" or "core", see cpu_placement::Placement.
+std::string thread_placement();
+
+// Returns the CPUs the emulator runs on, in the format of Linux's cpulist
+// files, or an empty string for all the CPUs the process may run on.
+std::string cpu_list();
+
+// Number of partitions of a large partitionable query evaluated in parallel
+// on the shared executor, or 0 if queries are always evaluated by the calling
+// thread.
+int parallel_query_threads();
+
+// Number of key ranges of a large read read in parallel on the shared
+// executor, or 0 if reads are always performed by the calling thread.
+int parallel_read_threads();
+
+// Returns the maximum number of bytes of query results cached per database for
+// repeated read-only queries, or 0 if results are not cached.
+int64_t query_result_cache_bytes();
+
+// Returns how long a lock request which conflicts with locks held by an older
+// or committing transaction waits for them to be released before its
+// transaction is aborted. A zero timeout aborts such requests right away.
+absl::Duration lock_wait_timeout();
+
+// Returns true if read-write transactions read without locks and validate
+// their reads when they commit, instead of locking the rows they read.
+bool optimistic_read_write_transactions();
+
+// Host and port on which metrics are served over HTTP, or an empty string if
+// metrics are disabled.
+std::string metrics_host_port();
+
+// Host and port on which the REST API is served in process, or an empty string
+// if it is only served by the gateway.
+std::string rest_host_port();
+
+// Returns the fraction of requests whose per-stage spans are traced. Requests
+// which propagate a sampled trace context are traced whenever this is nonzero.
+double trace_sampling_rate();
+
+// Returns the latency above which requests are logged to the slow request log,
+// or zero if it is disabled.
+absl::Duration slow_request_threshold();
+
+// Returns the maximum number of slow requests logged per second, or 0 if it is
+// unlimited.
+int slow_request_log_max_per_second();
+
+// Returns the approximate number of bytes of memory which the rows and the
+// buffered mutations of each database may hold, or 0 if it is unlimited.
+int64_t max_database_memory_bytes();
+
+// Returns the number of bytes of buffered mutations from which a read-write
+// transaction spills them to disk, or 0 if they are always kept in memory.
+int64_t transaction_spill_threshold_bytes();
+
+// Returns the directory of the files of spilled mutations, or an empty string
+// for the system's temporary directory.
+std::string transaction_spill_directory();
+
+// Returns the approximate size up to which rows are coalesced into each
+// streamed PartialResultSet.
+int64_t streaming_chunk_size_bytes();
+
+// Number of threads creating databases in the background.
+int database_creation_threads();
+
+// Returns true if the query engine is warmed up once the emulator is serving.
+bool warm_up_query_engine();
+
+// Returns the time after which idle read-write transactions are aborted, or
+// zero if they are never aborted.
+absl::Duration max_transaction_idle_time();
+
+// Returns the number of recently committed changes kept by each database for
+// consumers tailing them, or 0 if changes are not recorded.
+int64_t change_stream_retained_changes();
+
+// Returns the maximum number of queries running at once in each database, or
+// 0 if concurrent queries are not limited.
+int max_concurrent_queries_per_database();
+
+// Returns the maximum number of rows read by each query, or 0 if the rows
+// scanned are not limited.
+int64_t max_rows_scanned_per_query();
+
+// Returns the maximum bytes of intermediate results of each query, or 0 if
+// the default limit of the query evaluator applies.
+int64_t max_query_memory_bytes();
+
+// Returns the approximate number of bytes of rows which the sort of a query
+// may buffer before spilling them to disk, or 0 if queries are sorted by the
+// query evaluator.
+int64_t query_sort_spill_threshold_bytes();
+
+// Returns the directory of the files of spilled query sorts, or an empty
+// string for the system's temporary directory.
+std::string query_sort_spill_directory();
+
 }  // namespace config
 }  // namespace emulator
 }  // namespace spanner
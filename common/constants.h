@@ -53,6 +53,11 @@ constexpr char kResourceInfoType[] =
 // error. This does not correspond with an actual proto.
 constexpr char kConstraintError[] = "google.spanner.ConstraintError";
 
+// Payload URL recording the ID of the transaction holding the lock which
+// caused a transaction to abort. This does not correspond with an actual proto.
+constexpr char kConflictingTransaction[] =
+    "google.spanner.emulator.ConflictingTransaction";
+
 // Session resource type.
 constexpr char kSessionResourceType[] =
     "type.googleapis.com/google.spanner.v1.Session";
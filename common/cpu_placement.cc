@@ -0,0 +1,283 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "common/cpu_placement.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "zetasql/base/logging.h"
+#include "zetasql/base/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace cpu_placement {
+
+namespace {
+
+// Largest CPU number accepted in CPU lists.
+constexpr int kMaxCpu = 4095;
+
+// Returns the contents of the file at `path`, or an empty string if it cannot
+// be read.
+std::string ReadFile(const std::string& path) {
+  std::ifstream file(path);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+// Returns the CPUs on which the calling thread may run, or an empty list if
+// they are unknown.
+std::vector<int> AllowedCpus() {
+  std::vector<int> cpus;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#endif
+  return cpus;
+}
+
+// The configured placement.
+struct State {
+  absl::Mutex mu;
+  Placement placement ABSL_GUARDED_BY(mu) = Placement::kNone;
+  CpuTopology topology ABSL_GUARDED_BY(mu) =
+      CpuTopology(std::vector<std::vector<int>>());
+  bool configured ABSL_GUARDED_BY(mu) = false;
+};
+
+State& GetState() {
+  static State* const state = new State();
+  return *state;
+}
+
+// Slot of the next thread placed.
+std::atomic<int> next_slot{0};
+
+}  // namespace
+
+zetasql_base::StatusOr<Placement> ParsePlacement(absl::string_view name) {
+  if (name == "none") {
+    return Placement::kNone;
+  }
+  if (name == "numa") {
+    return Placement::kNumaNode;
+  }
+  if (name == "core") {
+    return Placement::kCore;
+  }
+  return absl::InvalidArgumentError(absl::StrCat(
+      "Unknown thread placement \"", name, "\", expected none, numa or core"));
+}
+
+zetasql_base::StatusOr<std::vector<int>> ParseCpuList(absl::string_view list) {
+  std::vector<int> cpus;
+  list = absl::StripAsciiWhitespace(list);
+  if (list.empty()) {
+    return cpus;
+  }
+  for (absl::string_view range : absl::StrSplit(list, ',')) {
+    std::vector<absl::string_view> bounds = absl::StrSplit(range, '-');
+    int first = 0;
+    int last = 0;
+    if (bounds.size() > 2 || !absl::SimpleAtoi(bounds[0], &first) ||
+        !absl::SimpleAtoi(bounds.back(), &last) || first < 0 ||
+        last < first || last > kMaxCpu) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid CPU list \"", list, "\""));
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return cpus;
+}
+
+CpuTopology CpuTopology::Detect() {
+  std::vector<int> allowed = AllowedCpus();
+  if (allowed.empty()) {
+    const int num_cpus =
+        std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int cpu = 0; cpu < num_cpus; ++cpu) {
+      allowed.push_back(cpu);
+    }
+  }
+
+  std::vector<std::vector<int>> nodes;
+  const std::string kNodesDir = "/sys/devices/system/node/";
+  zetasql_base::StatusOr<std::vector<int>> node_ids =
+      ParseCpuList(ReadFile(kNodesDir + "online"));
+  if (node_ids.ok()) {
+    for (int node : *node_ids) {
+      zetasql_base::StatusOr<std::vector<int>> cpus = ParseCpuList(
+          ReadFile(absl::StrCat(kNodesDir, "node", node, "/cpulist")));
+      if (cpus.ok() && !cpus->empty()) {
+        nodes.push_back(*std::move(cpus));
+      }
+    }
+  }
+  if (nodes.empty()) {
+    return CpuTopology({allowed});
+  }
+  return CpuTopology(std::move(nodes)).Restrict(allowed);
+}
+
+CpuTopology CpuTopology::Restrict(const std::vector<int>& cpus) const {
+  std::vector<int> sorted = cpus;
+  std::sort(sorted.begin(), sorted.end());
+  std::vector<std::vector<int>> nodes;
+  for (const std::vector<int>& node : nodes_) {
+    std::vector<int> restricted;
+    std::set_intersection(node.begin(), node.end(), sorted.begin(),
+                          sorted.end(), std::back_inserter(restricted));
+    if (!restricted.empty()) {
+      nodes.push_back(std::move(restricted));
+    }
+  }
+  return CpuTopology(std::move(nodes));
+}
+
+std::vector<int> CpuTopology::cpus() const {
+  std::vector<int> cpus;
+  for (const std::vector<int>& node : nodes_) {
+    cpus.insert(cpus.end(), node.begin(), node.end());
+  }
+  std::sort(cpus.begin(), cpus.end());
+  return cpus;
+}
+
+std::vector<int> CpuTopology::CpusOfThread(Placement placement,
+                                           int slot) const {
+  if (placement == Placement::kNone || nodes_.empty()) {
+    return cpus();
+  }
+  const int num_nodes = static_cast<int>(nodes_.size());
+  const std::vector<int>& node = nodes_[slot % num_nodes];
+  if (placement == Placement::kNumaNode) {
+    return node;
+  }
+  return {node[(slot / num_nodes) % node.size()]};
+}
+
+absl::Status Configure(Placement placement, absl::string_view cpus) {
+  CpuTopology topology = CpuTopology::Detect();
+  const bool restricted = !absl::StripAsciiWhitespace(cpus).empty();
+  if (restricted) {
+    ZETASQL_ASSIGN_OR_RETURN(std::vector<int> listed, ParseCpuList(cpus));
+    topology = topology.Restrict(listed);
+    if (topology.nodes().empty()) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "None of the CPUs \"", cpus, "\" are available to the process"));
+    }
+  }
+  if (placement != Placement::kNone || restricted) {
+    ZETASQL_RETURN_IF_ERROR(PinCurrentThread(topology.cpus()));
+  }
+
+  State& state = GetState();
+  absl::MutexLock lock(&state.mu);
+  state.placement = placement;
+  state.topology = std::move(topology);
+  state.configured = true;
+  return absl::OkStatus();
+}
+
+int NumCpus() {
+  State& state = GetState();
+  {
+    absl::MutexLock lock(&state.mu);
+    if (state.configured) {
+      return static_cast<int>(state.topology.cpus().size());
+    }
+  }
+  return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+void PlaceCurrentThread() {
+  std::vector<int> cpus;
+  {
+    State& state = GetState();
+    absl::MutexLock lock(&state.mu);
+    if (state.placement == Placement::kNone) {
+      return;
+    }
+    cpus = state.topology.CpusOfThread(
+        state.placement, next_slot.fetch_add(1, std::memory_order_relaxed));
+  }
+  absl::Status status = PinCurrentThread(cpus);
+  if (!status.ok()) {
+    LOG(WARNING) << "Failed to place thread: " << status;
+  }
+}
+
+absl::Status PinCurrentThread(const std::vector<int>& cpus) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  const int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (error != 0) {
+    return absl::InternalError(absl::StrCat("Failed to pin thread to CPUs ",
+                                            absl::StrJoin(cpus, ","),
+                                            ": error ", error));
+  }
+  return absl::OkStatus();
+#else
+  return absl::UnimplementedError(
+      "Pinning threads to CPUs is only supported on Linux");
+#endif
+}
+
+}  // namespace cpu_placement
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,120 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_CPU_PLACEMENT_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_CPU_PLACEMENT_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/base/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace cpu_placement {
+
+// CPU placement pins the threads of the emulator to CPUs, so that on machines
+// with several NUMA nodes (e.g. sockets) threads stop migrating between nodes,
+// and the memory they allocate, which Linux places on the node of the thread
+// first touching it, stays local to the threads using it.
+//
+// It applies to the threads of the pools created by the emulator: the workers
+// of the shared Executor, of ThreadPools (such as the handlers of the
+// asynchronous gRPC server) and the completion queue pollers of the
+// asynchronous gRPC server. Threads created by gRPC itself, such as those of
+// the synchronous server, are only restricted to the CPUs of the placement,
+// which they inherit from the thread which calls Configure.
+//
+// Placement is only supported on Linux.
+
+// How the threads of the pools are placed.
+enum class Placement {
+  // Threads run on any of the CPUs of the placement.
+  kNone,
+
+  // Each thread runs on the CPUs of one NUMA node, with successive threads
+  // placed on successive nodes in turn.
+  kNumaNode,
+
+  // Each thread runs on a single CPU, with successive threads placed on
+  // successive nodes in turn, and on successive CPUs of each node.
+  kCore,
+};
+
+// Parses a placement named "none", "numa" or "core".
+zetasql_base::StatusOr<Placement> ParsePlacement(absl::string_view name);
+
+// Parses a list of CPUs in the format of Linux's cpulist files, e.g.
+// "0-3,8,10-11", into the sorted CPU numbers it holds.
+zetasql_base::StatusOr<std::vector<int>> ParseCpuList(absl::string_view list);
+
+// The CPUs of a machine, grouped by the NUMA node they belong to.
+class CpuTopology {
+ public:
+  explicit CpuTopology(std::vector<std::vector<int>> nodes)
+      : nodes_(std::move(nodes)) {}
+
+  // Returns the topology of the machine, restricted to the CPUs on which the
+  // calling thread may run. Machines which do not report their NUMA nodes
+  // have a single node.
+  static CpuTopology Detect();
+
+  // Returns the topology restricted to `cpus`, without nodes left empty.
+  CpuTopology Restrict(const std::vector<int>& cpus) const;
+
+  // The CPUs of each node, sorted. No node is empty.
+  const std::vector<std::vector<int>>& nodes() const { return nodes_; }
+
+  // Returns the CPUs of all the nodes, sorted.
+  std::vector<int> cpus() const;
+
+  // Returns the CPUs on which the `slot`-th thread placed by `placement` runs,
+  // or all the CPUs if `placement` is kNone.
+  std::vector<int> CpusOfThread(Placement placement, int slot) const;
+
+ private:
+  std::vector<std::vector<int>> nodes_;
+};
+
+// Places the threads of the pools created from now on by `placement`, on the
+// CPUs listed by `cpus` (in the format of ParseCpuList), or all the CPUs on
+// which the calling thread may run if `cpus` is empty. Restricts the calling
+// thread, and so the threads it creates from now on, to these CPUs. Should be
+// called once, before any pool is created.
+absl::Status Configure(Placement placement, absl::string_view cpus);
+
+// Returns the number of CPUs of the placement, or of the machine if Configure
+// was not called.
+int NumCpus();
+
+// Pins the calling thread, which was just started by a pool of threads, to
+// the CPUs of the next slot of the placement. Does nothing if the placement is
+// kNone or was not configured.
+void PlaceCurrentThread();
+
+// Pins the calling thread to `cpus`.
+absl::Status PinCurrentThread(const std::vector<int>& cpus);
+
+}  // namespace cpu_placement
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_CPU_PLACEMENT_H_
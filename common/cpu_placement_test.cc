@@ -0,0 +1,96 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "common/cpu_placement.h"
+
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace cpu_placement {
+namespace {
+
+using testing::ElementsAre;
+using testing::IsEmpty;
+using zetasql_base::testing::IsOkAndHolds;
+using zetasql_base::testing::StatusIs;
+
+TEST(CpuPlacementTest, ParsesCpuLists) {
+  EXPECT_THAT(ParseCpuList(""), IsOkAndHolds(IsEmpty()));
+  EXPECT_THAT(ParseCpuList("3"), IsOkAndHolds(ElementsAre(3)));
+  EXPECT_THAT(ParseCpuList("8,0-2,10-11\n"),
+              IsOkAndHolds(ElementsAre(0, 1, 2, 8, 10, 11)));
+  EXPECT_THAT(ParseCpuList("1,1-2"), IsOkAndHolds(ElementsAre(1, 2)));
+  EXPECT_THAT(ParseCpuList("2-1"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ParseCpuList("a"), StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ParseCpuList("1-2-3"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(CpuPlacementTest, ParsesPlacements) {
+  EXPECT_THAT(ParsePlacement("none"), IsOkAndHolds(Placement::kNone));
+  EXPECT_THAT(ParsePlacement("numa"), IsOkAndHolds(Placement::kNumaNode));
+  EXPECT_THAT(ParsePlacement("core"), IsOkAndHolds(Placement::kCore));
+  EXPECT_THAT(ParsePlacement("socket"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(CpuPlacementTest, SpreadsThreadsAcrossNodes) {
+  CpuTopology topology({{0, 1}, {2, 3}});
+  EXPECT_THAT(topology.CpusOfThread(Placement::kNone, 0),
+              ElementsAre(0, 1, 2, 3));
+  EXPECT_THAT(topology.CpusOfThread(Placement::kNumaNode, 0),
+              ElementsAre(0, 1));
+  EXPECT_THAT(topology.CpusOfThread(Placement::kNumaNode, 1),
+              ElementsAre(2, 3));
+  EXPECT_THAT(topology.CpusOfThread(Placement::kNumaNode, 2),
+              ElementsAre(0, 1));
+
+  std::vector<int> cores;
+  for (int slot = 0; slot < 5; ++slot) {
+    std::vector<int> cpus = topology.CpusOfThread(Placement::kCore, slot);
+    ASSERT_EQ(cpus.size(), 1);
+    cores.push_back(cpus[0]);
+  }
+  EXPECT_THAT(cores, ElementsAre(0, 2, 1, 3, 0));
+}
+
+TEST(CpuPlacementTest, RestrictsTopologyToCpus) {
+  CpuTopology topology = CpuTopology({{0, 1}, {2, 3}}).Restrict({3, 1});
+  EXPECT_THAT(topology.nodes(), ElementsAre(ElementsAre(1), ElementsAre(3)));
+  EXPECT_THAT(topology.cpus(), ElementsAre(1, 3));
+
+  topology = topology.Restrict({2, 3});
+  EXPECT_THAT(topology.nodes(), ElementsAre(ElementsAre(3)));
+}
+
+TEST(CpuPlacementTest, DetectsCpusOfTheProcess) {
+  CpuTopology topology = CpuTopology::Detect();
+  EXPECT_FALSE(topology.nodes().empty());
+  EXPECT_GE(topology.cpus().size(), 1);
+}
+
+}  // namespace
+}  // namespace cpu_placement
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
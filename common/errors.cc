@@ -20,13 +20,16 @@
 
 #include "google/rpc/error_details.pb.h"
 #include "absl/status/status.h"
+#include "absl/strings/cord.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
 #include "absl/strings/substitute.h"
+#include "absl/time/time.h"
 #include "backend/common/ids.h"
 #include "common/constants.h"
 #include "common/limits.h"
+#include "common/metrics.h"
 #include "absl/status/status.h"
 
 namespace google {
@@ -34,6 +37,22 @@ namespace spanner {
 namespace emulator {
 namespace error {
 
+namespace {
+
+// Counts a transaction abort for `reason`, if metrics are enabled. Aborts are
+// counted when their error is created, which happens once per aborted
+// transaction attempt.
+void CountAbort(absl::string_view reason) {
+  if (metrics::Enabled()) {
+    metrics::GetCounter("spanner_emulator_transaction_aborts_total",
+                        "Number of aborted transactions, by reason.",
+                        {{"reason", std::string(reason)}})
+        ->Increment();
+  }
+}
+
+}  // namespace
+
 // Generic errors.
 absl::Status Internal(absl::string_view msg) {
   return absl::Status(absl::StatusCode::kInternal, msg);
@@ -47,6 +66,12 @@ absl::Status CycleDetected(absl::string_view object_type,
                                        object_type, cycle));
 }
 
+absl::Status StreamingResponseNotDelivered() {
+  return absl::Status(absl::StatusCode::kCancelled,
+                      "Streaming response could not be delivered; the call "
+                      "was cancelled or the client disconnected.");
+}
+
 // Project errors.
 absl::Status InvalidProjectURI(absl::string_view uri) {
   return absl::Status(absl::StatusCode::kInvalidArgument,
@@ -161,6 +186,16 @@ absl::Status TooManyDatabasesPerInstance(absl::string_view instance_uri) {
           "more information."));
 }
 
+absl::Status DatabaseMemoryLimitExceeded(int64_t used_bytes,
+                                         int64_t limit_bytes) {
+  return absl::Status(
+      absl::StatusCode::kResourceExhausted,
+      absl::StrCat("The database holds approximately ", used_bytes,
+                   " bytes of memory, which exceeds the limit of ", limit_bytes,
+                   " bytes set by --max_database_memory_bytes. Delete rows to "
+                   "free memory before inserting or updating rows."));
+}
+
 absl::Status InvalidDatabaseName(absl::string_view database_id) {
   return absl::Status(
       absl::StatusCode::kInvalidArgument,
@@ -172,6 +207,56 @@ absl::Status InvalidDatabaseName(absl::string_view database_id) {
           database_id));
 }
 
+absl::Status SnapshotIOError(absl::string_view path,
+                             absl::string_view operation,
+                             absl::string_view reason) {
+  return absl::Status(absl::StatusCode::kInternal,
+                      absl::Substitute("Failed to $0 database snapshot $1: $2",
+                                       operation, path, reason));
+}
+
+absl::Status InvalidSnapshot(absl::string_view path, absl::string_view reason) {
+  return absl::Status(
+      absl::StatusCode::kInvalidArgument,
+      absl::Substitute("Invalid database snapshot $0: $1", path, reason));
+}
+
+absl::Status InvalidBulkImport(absl::string_view path,
+                               absl::string_view reason) {
+  return absl::Status(
+      absl::StatusCode::kInvalidArgument,
+      absl::Substitute("Invalid bulk import file $0: $1", path, reason));
+}
+
+absl::Status CommitLogIOError(absl::string_view path,
+                              absl::string_view operation,
+                              absl::string_view reason) {
+  return absl::Status(absl::StatusCode::kInternal,
+                      absl::Substitute("Failed to $0 commit log $1: $2",
+                                       operation, path, reason));
+}
+
+absl::Status InvalidCommitLog(absl::string_view path,
+                              absl::string_view reason) {
+  return absl::Status(
+      absl::StatusCode::kInvalidArgument,
+      absl::Substitute("Invalid commit log $0: $1", path, reason));
+}
+
+absl::Status SpillFileIOError(absl::string_view path,
+                              absl::string_view operation,
+                              absl::string_view reason) {
+  return absl::Status(absl::StatusCode::kInternal,
+                      absl::Substitute("Failed to $0 spill file $1: $2",
+                                       operation, path, reason));
+}
+
+absl::Status CannotResetToCheckpoint(absl::string_view reason) {
+  return absl::Status(
+      absl::StatusCode::kFailedPrecondition,
+      absl::StrCat("Cannot reset database to its checkpoint: ", reason));
+}
+
 // Operation errors.
 absl::Status InvalidOperationId(absl::string_view id) {
   return absl::Status(absl::StatusCode::kInvalidArgument,
@@ -421,15 +506,45 @@ absl::Status MutationTableRequired() {
 
 // Transaction errors.
 absl::Status AbortConcurrentTransaction(int64_t requestor_id, int64_t holder_id) {
-  return absl::Status(
+  CountAbort("lock_conflict");
+  absl::Status error(
       absl::StatusCode::kAborted,
       absl::StrCat("Transaction ", requestor_id,
-                   " aborted due to active transaction ", holder_id,
-                   ". The emulator only supports one transaction at a time. "
-                   "Some best practices to avoid ABORT errors in Cloud Spanner "
-                   "service are:\n1. Avoid use of nested transactions.\n2. "
-                   "Explicitly Rollback failed transactions.\n3. All "
-                   "transactions should be running inside of retry loops.\n"));
+                   " aborted due to a conflicting lock held by active "
+                   "transaction ",
+                   holder_id,
+                   ". Some best practices to avoid ABORT errors in Cloud "
+                   "Spanner service are:\n1. Avoid use of nested "
+                   "transactions.\n2. Explicitly Rollback failed "
+                   "transactions.\n3. All transactions should be running "
+                   "inside of retry loops.\n"));
+  error.SetPayload(kConflictingTransaction,
+                   absl::Cord(absl::StrCat(holder_id)));
+  return error;
+}
+
+absl::Status LockWaitTimeout(int64_t requestor_id, int64_t holder_id,
+                             absl::Duration timeout) {
+  CountAbort("lock_wait_timeout");
+  absl::Status error(
+      absl::StatusCode::kAborted,
+      absl::StrCat("Transaction ", requestor_id, " aborted after waiting ",
+                   absl::FormatDuration(timeout),
+                   " for a conflicting lock held by active transaction ",
+                   holder_id, "."));
+  error.SetPayload(kConflictingTransaction,
+                   absl::Cord(absl::StrCat(holder_id)));
+  return error;
+}
+
+absl::Status AbortIdleTransaction(int64_t id, absl::Duration idle_time) {
+  CountAbort("idle");
+  return absl::Status(
+      absl::StatusCode::kAborted,
+      absl::StrCat("Transaction ", id, " aborted after being idle for more "
+                   "than ",
+                   absl::FormatDuration(idle_time),
+                   ", to release its locks."));
 }
 
 absl::Status TransactionNotFound(backend::TransactionID id) {
@@ -583,6 +698,7 @@ absl::Status CannotUseTransactionAfterConstraintError() {
 }
 
 absl::Status AbortDueToConcurrentSchemaChange(backend::TransactionID id) {
+  CountAbort("schema_change");
   return absl::Status(
       absl::StatusCode::kAborted,
       absl::StrCat("Transaction: ", id,
@@ -590,6 +706,7 @@ absl::Status AbortDueToConcurrentSchemaChange(backend::TransactionID id) {
 }
 
 absl::Status AbortReadWriteTransactionOnFirstCommit(backend::TransactionID id) {
+  CountAbort("fault_injection");
   return absl::Status(
       absl::StatusCode::kAborted,
       absl::StrCat(
@@ -600,6 +717,15 @@ absl::Status AbortReadWriteTransactionOnFirstCommit(backend::TransactionID id) {
           "tolerate aborts (which will happen in production occasionally)."));
 }
 
+absl::Status AbortDueToConflictingReads(backend::TransactionID id) {
+  CountAbort("read_conflict");
+  return absl::Status(
+      absl::StatusCode::kAborted,
+      absl::StrCat("Transaction: ", id,
+                   " aborted because rows it read were changed by a "
+                   "transaction which committed after the read."));
+}
+
 absl::Status ReadTimestampPastVersionGCLimit(absl::Time timestamp) {
   return absl::Status(
       absl::StatusCode::kFailedPrecondition,
@@ -618,6 +744,16 @@ absl::Status ReadTimestampTooFarInFuture(absl::Time timestamp) {
           " will return with the DEADLINE_EXCEEDED error."));
 }
 
+absl::Status ReadTimestampPastReplicaWatermark(absl::Time timestamp,
+                                               absl::Time watermark) {
+  return absl::Status(
+      absl::StatusCode::kUnavailable,
+      absl::StrCat("Read-only transaction timestamp ",
+                   absl::FormatTime(timestamp),
+                   " is after the last commit applied to the replica at ",
+                   absl::FormatTime(watermark), ". Retry the read later."));
+}
+
 // DDL errors.
 absl::Status EmptyDDLStatement() {
   return absl::Status(absl::StatusCode::kInvalidArgument,
@@ -1553,6 +1689,14 @@ absl::Status ColumnExpressionMaxDepthExceeded(int depth, int max_depth) {
           depth, max_depth));
 }
 
+absl::Status CannotWriteToGeneratedColumn(absl::string_view table_name,
+                                          absl::string_view column_name) {
+  return absl::Status(
+      absl::StatusCode::kInvalidArgument,
+      absl::Substitute("Cannot write into generated column `$0.$1`.",
+                       table_name, column_name));
+}
+
 // Query errors.
 absl::Status UnableToInferUndeclaredParameter(
     absl::string_view parameter_name) {
@@ -1832,6 +1976,34 @@ absl::Status QueryStringTooLong(int query_length, int max_length) {
                                        query_length, max_length));
 }
 
+absl::Status TooManyConcurrentQueries(int max_concurrent_queries) {
+  return absl::Status(
+      absl::StatusCode::kResourceExhausted,
+      absl::Substitute("The database is already running $0 queries, the limit "
+                       "set by --max_concurrent_queries_per_database. Retry "
+                       "once other queries complete.",
+                       max_concurrent_queries));
+}
+
+absl::Status TooManyRowsScanned(int64_t max_rows_scanned) {
+  return absl::Status(
+      absl::StatusCode::kResourceExhausted,
+      absl::Substitute("The query read more than $0 rows, the limit set by "
+                       "--max_rows_scanned_per_query.",
+                       max_rows_scanned));
+}
+
+absl::Status RequestCancelled() {
+  return absl::Status(absl::StatusCode::kCancelled,
+                      "The request was cancelled before it completed.");
+}
+
+absl::Status RequestDeadlineExceeded() {
+  return absl::Status(absl::StatusCode::kDeadlineExceeded,
+                      "The deadline of the request expired before it "
+                      "completed.");
+}
+
 absl::Status EmulatorDoesNotSupportQueryPlans() {
   return absl::Status(absl::StatusCode::kUnimplemented,
                       "The emulator does not support the PLAN query mode.");
@@ -1902,6 +2074,36 @@ absl::Status InvalidPartitionedQueryMode() {
       "with partitioned queries.");
 }
 
+// Resume token errors.
+absl::Status InvalidResumeToken() {
+  return absl::Status(absl::StatusCode::kInvalidArgument,
+                      "Invalid resume token.");
+}
+
+absl::Status ResumedStreamChanged() {
+  return absl::Status(
+      absl::StatusCode::kFailedPrecondition,
+      "Cannot resume the stream: the rows returned before the resume token "
+      "differ from the rows returned when it was created. Retry the request "
+      "without a resume token.");
+}
+
+// Change stream errors.
+absl::Status ChangeStreamDisabled() {
+  return absl::Status(absl::StatusCode::kFailedPrecondition,
+                      "Change streams are disabled. Start the emulator with "
+                      "--change_stream_retained_changes to enable them.");
+}
+
+absl::Status ChangesNotRetained(absl::Time after, absl::Time dropped_through) {
+  return absl::Status(
+      absl::StatusCode::kFailedPrecondition,
+      absl::StrCat("Changes committed after ", absl::FormatTime(after),
+                   " are no longer retained: changes were dropped through ",
+                   absl::FormatTime(dropped_through),
+                   ". Resume from a later timestamp."));
+}
+
 }  // namespace error
 }  // namespace emulator
 }  // namespace spanner
@@ -19,6 +19,7 @@
 
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "backend/common/ids.h"
 #include "absl/status/status.h"
 
@@ -31,6 +32,7 @@ namespace error {
 absl::Status Internal(absl::string_view msg);
 absl::Status CycleDetected(absl::string_view object_type,
                            absl::string_view cycle);
+absl::Status StreamingResponseNotDelivered();
 
 // Project errors.
 absl::Status InvalidProjectURI(absl::string_view uri);
@@ -55,7 +57,23 @@ absl::Status CreateDatabaseMissingCreateStatement();
 absl::Status InvalidCreateDatabaseStatement(absl::string_view statement);
 absl::Status UpdateDatabaseMissingStatements();
 absl::Status TooManyDatabasesPerInstance(absl::string_view instance_uri);
+absl::Status DatabaseMemoryLimitExceeded(int64_t used_bytes,
+                                         int64_t limit_bytes);
 absl::Status InvalidDatabaseName(absl::string_view database_id);
+absl::Status SnapshotIOError(absl::string_view path,
+                             absl::string_view operation,
+                             absl::string_view reason);
+absl::Status InvalidSnapshot(absl::string_view path, absl::string_view reason);
+absl::Status InvalidBulkImport(absl::string_view path,
+                               absl::string_view reason);
+absl::Status CommitLogIOError(absl::string_view path,
+                              absl::string_view operation,
+                              absl::string_view reason);
+absl::Status SpillFileIOError(absl::string_view path,
+                              absl::string_view operation,
+                              absl::string_view reason);
+absl::Status InvalidCommitLog(absl::string_view path, absl::string_view reason);
+absl::Status CannotResetToCheckpoint(absl::string_view reason);
 
 // Operation errors.
 absl::Status InvalidOperationId(absl::string_view id);
@@ -112,6 +130,9 @@ absl::Status MutationTableRequired();
 
 // Transaction errors.
 absl::Status AbortConcurrentTransaction(int64_t requestor_id, int64_t holder_id);
+absl::Status LockWaitTimeout(int64_t requestor_id, int64_t holder_id,
+                             absl::Duration timeout);
+absl::Status AbortIdleTransaction(int64_t id, absl::Duration idle_time);
 absl::Status TransactionNotFound(backend::TransactionID id);
 absl::Status TransactionClosed(backend::TransactionID id);
 absl::Status InvalidTransactionID(backend::TransactionID id);
@@ -140,8 +161,11 @@ absl::Status CannotReadOrQueryAfterCommitOrRollback();
 absl::Status CannotUseTransactionAfterConstraintError();
 absl::Status ReadTimestampPastVersionGCLimit(absl::Time timestamp);
 absl::Status ReadTimestampTooFarInFuture(absl::Time timestamp);
+absl::Status ReadTimestampPastReplicaWatermark(absl::Time timestamp,
+                                               absl::Time watermark);
 absl::Status AbortDueToConcurrentSchemaChange(backend::TransactionID id);
 absl::Status AbortReadWriteTransactionOnFirstCommit(backend::TransactionID id);
+absl::Status AbortDueToConflictingReads(backend::TransactionID id);
 
 // DDL errors.
 absl::Status EmptyDDLStatement();
@@ -406,6 +430,8 @@ absl::Status GeneratedColumnDefinitionParseError(absl::string_view table_name,
                                                  absl::string_view message);
 absl::Status NonScalarExpressionInColumnExpression(absl::string_view type);
 absl::Status ColumnExpressionMaxDepthExceeded(int depth, int max_depth);
+absl::Status CannotWriteToGeneratedColumn(absl::string_view table_name,
+                                          absl::string_view column_name);
 
 // Query errors.
 absl::Status UnableToInferUndeclaredParameter(absl::string_view parameter_name);
@@ -461,6 +487,14 @@ absl::Status TooManyStructFields(int max_struct_fields);
 absl::Status TooManyNestedStructs(int max_nested_struct_depth);
 absl::Status QueryStringTooLong(int query_length, int max_length);
 
+// Query resource quota errors.
+absl::Status TooManyConcurrentQueries(int max_concurrent_queries);
+absl::Status TooManyRowsScanned(int64_t max_rows_scanned);
+
+// Request cancellation errors.
+absl::Status RequestCancelled();
+absl::Status RequestDeadlineExceeded();
+
 // Partition Read errors.
 absl::Status InvalidBytesPerBatch(absl::string_view message_name);
 absl::Status InvalidMaxPartitionCount(absl::string_view message_name);
@@ -470,6 +504,14 @@ absl::Status ReadFromDifferentTransaction();
 absl::Status ReadFromDifferentParameters();
 absl::Status InvalidPartitionedQueryMode();
 
+// Resume token errors.
+absl::Status InvalidResumeToken();
+absl::Status ResumedStreamChanged();
+
+// Change stream errors.
+absl::Status ChangeStreamDisabled();
+absl::Status ChangesNotRetained(absl::Time after, absl::Time dropped_through);
+
 }  // namespace error
 }  // namespace emulator
 }  // namespace spanner
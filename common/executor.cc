@@ -0,0 +1,241 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "common/executor.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "common/config.h"
+#include "common/cpu_placement.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+namespace {
+
+// The executor whose worker runs on this thread, if any, and the index of the
+// worker.
+thread_local const Executor* current_executor = nullptr;
+thread_local int current_worker = -1;
+
+}  // namespace
+
+Executor::Executor(int num_threads) {
+  num_threads = std::max(num_threads, 1);
+  workers_.reserve(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    workers_.push_back(absl::make_unique<Worker>());
+  }
+  threads_.reserve(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.push_back(
+        absl::make_unique<std::thread>(&Executor::WorkerLoop, this, i));
+  }
+}
+
+Executor::~Executor() {
+  {
+    absl::MutexLock lock(&mu_);
+    stopping_ = true;
+    work_cvar_.SignalAll();
+  }
+  for (auto& thread : threads_) {
+    thread->join();
+  }
+}
+
+Executor* Executor::Default() {
+  static Executor* const executor =
+      new Executor(config::executor_threads() > 0 ? config::executor_threads()
+                                                  : cpu_placement::NumCpus());
+  return executor;
+}
+
+void Executor::Schedule(TaskPriority priority, std::function<void()> fn) {
+  const int p = static_cast<int>(priority);
+  const bool on_worker = current_executor == this;
+  if (on_worker) {
+    Worker* worker = workers_[current_worker].get();
+    absl::MutexLock lock(&worker->mu);
+    worker->queues[p].push_back(std::move(fn));
+  }
+  absl::MutexLock lock(&mu_);
+  if (!on_worker) {
+    queues_[p].push_back(std::move(fn));
+  }
+  ++num_unreserved_;
+  work_cvar_.Signal();
+}
+
+bool Executor::TakeTask(int worker, std::function<void()>* fn) {
+  const int num_workers = static_cast<int>(workers_.size());
+  for (int p = 0; p < kNumPriorities; ++p) {
+    {
+      Worker* own = workers_[worker].get();
+      absl::MutexLock lock(&own->mu);
+      if (!own->queues[p].empty()) {
+        *fn = std::move(own->queues[p].back());
+        own->queues[p].pop_back();
+        return true;
+      }
+    }
+    {
+      absl::MutexLock lock(&mu_);
+      if (!queues_[p].empty()) {
+        *fn = std::move(queues_[p].front());
+        queues_[p].pop_front();
+        return true;
+      }
+    }
+    for (int i = 1; i < num_workers; ++i) {
+      Worker* victim = workers_[(worker + i) % num_workers].get();
+      absl::MutexLock lock(&victim->mu);
+      if (!victim->queues[p].empty()) {
+        *fn = std::move(victim->queues[p].front());
+        victim->queues[p].pop_front();
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void Executor::WorkerLoop(int worker) {
+  cpu_placement::PlaceCurrentThread();
+  current_executor = this;
+  current_worker = worker;
+  while (true) {
+    {
+      absl::MutexLock lock(&mu_);
+      while (num_unreserved_ == 0 && !stopping_) {
+        work_cvar_.Wait(&mu_);
+      }
+      if (num_unreserved_ == 0) {
+        return;
+      }
+      --num_unreserved_;
+    }
+    // The task reserved is queued, but other workers may take the task this
+    // one would have while it is looking, in which case it looks again.
+    std::function<void()> fn;
+    while (!TakeTask(worker, &fn)) {
+    }
+    fn();
+  }
+}
+
+struct TaskGroup::State {
+  State(int max_parallelism, const CancellationToken* token)
+      : max_parallelism(std::max(max_parallelism, 1)), token(token) {}
+
+  // Runs tasks of the group until none is left to start, or `max_parallelism`
+  // of them are running.
+  void RunTasks() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu);
+
+  const int max_parallelism;
+  const CancellationToken* const token;
+
+  // Mutex to guard state below.
+  absl::Mutex mu;
+
+  // Signalled when a task finishes running or is skipped.
+  absl::CondVar done_cvar;
+
+  // Tasks scheduled, of which those before `next_task` were started.
+  std::vector<std::function<absl::Status()>> tasks ABSL_GUARDED_BY(mu);
+  int next_task ABSL_GUARDED_BY(mu) = 0;
+
+  // Number of tasks running, and which finished running or were skipped.
+  int num_running ABSL_GUARDED_BY(mu) = 0;
+  int num_finished ABSL_GUARDED_BY(mu) = 0;
+
+  // Number of runs of RunTasks scheduled on the executor, which have not
+  // returned yet.
+  int num_runners ABSL_GUARDED_BY(mu) = 0;
+
+  // Index and error of the earliest scheduled failing task.
+  int failed_task ABSL_GUARDED_BY(mu) = std::numeric_limits<int>::max();
+  absl::Status status ABSL_GUARDED_BY(mu);
+};
+
+void TaskGroup::State::RunTasks() {
+  while (next_task < tasks.size() && num_running < max_parallelism) {
+    const int i = next_task++;
+    std::function<absl::Status()> fn = std::move(tasks[i]);
+    absl::Status task_status;
+    if (i < failed_task) {
+      ++num_running;
+      mu.Unlock();
+      task_status = token == nullptr ? absl::OkStatus() : token->Check();
+      if (task_status.ok()) {
+        task_status = fn();
+      }
+      fn = nullptr;
+      mu.Lock();
+      --num_running;
+    }
+    if (!task_status.ok() && i < failed_task) {
+      failed_task = i;
+      status = std::move(task_status);
+    }
+    ++num_finished;
+    done_cvar.SignalAll();
+  }
+}
+
+TaskGroup::TaskGroup(Executor* executor, TaskPriority priority,
+                     int max_parallelism, const CancellationToken* token)
+    : executor_(executor),
+      priority_(priority),
+      state_(std::make_shared<State>(max_parallelism, token)) {}
+
+TaskGroup::~TaskGroup() { Wait().IgnoreError(); }
+
+void TaskGroup::Schedule(std::function<absl::Status()> fn) {
+  absl::MutexLock lock(&state_->mu);
+  state_->tasks.push_back(std::move(fn));
+  // The thread waiting for the group runs one of its tasks, so one less runner
+  // is scheduled than tasks may run at once.
+  const int num_unstarted = state_->tasks.size() - state_->next_task;
+  if (state_->num_runners < state_->max_parallelism - 1 &&
+      state_->num_runners < num_unstarted) {
+    ++state_->num_runners;
+    executor_->Schedule(priority_, [state = state_]() {
+      absl::MutexLock lock(&state->mu);
+      state->RunTasks();
+      --state->num_runners;
+    });
+  }
+}
+
+absl::Status TaskGroup::Wait() {
+  absl::MutexLock lock(&state_->mu);
+  while (true) {
+    state_->RunTasks();
+    if (state_->num_finished == state_->tasks.size()) {
+      return state_->status;
+    }
+    state_->done_cvar.Wait(&state_->mu);
+  }
+}
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,180 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_EXECUTOR_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_EXECUTOR_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "common/cancellation.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+// Priority of the tasks run by an Executor. Workers always start a queued
+// interactive task before any queued background task.
+enum class TaskPriority {
+  // Work a request is waiting on, such as the partitions of a parallel query
+  // or the ranges of a parallel read.
+  kInteractive = 0,
+
+  // Work done on behalf of long-running operations, such as backfills and
+  // verifiers of schema changes, partitioned DML and exports.
+  kBackground = 1,
+};
+
+// Executor runs tasks on a fixed number of worker threads, which are shared by
+// all the work it is given, so that the number of threads stays bounded however
+// many operations run in parallel at once.
+//
+// Each worker has a queue of its own, to which the tasks scheduled by the tasks
+// it runs are added, and which it runs newest first. Tasks scheduled by other
+// threads are added to a shared queue. Idle workers take tasks from the shared
+// queue, or steal the oldest tasks of the other workers.
+//
+// Most code should not schedule tasks directly, but run them in a TaskGroup,
+// which limits how many of its tasks run at once and waits for them.
+//
+// The destructor waits for all scheduled tasks to finish running.
+//
+// This class is thread safe.
+class Executor {
+ public:
+  explicit Executor(int num_threads);
+  ~Executor();
+
+  Executor(const Executor&) = delete;
+  Executor& operator=(const Executor&) = delete;
+
+  // Returns the executor shared by the whole process, which has
+  // config::executor_threads() workers. It is never destroyed.
+  static Executor* Default();
+
+  // Schedules `fn` to run on one of the workers.
+  void Schedule(TaskPriority priority, std::function<void()> fn)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the number of worker threads.
+  int num_threads() const { return static_cast<int>(threads_.size()); }
+
+ private:
+  static constexpr int kNumPriorities = 2;
+
+  using Queues = std::deque<std::function<void()>>[kNumPriorities];
+
+  // Queues of the tasks scheduled by the tasks a worker runs.
+  struct Worker {
+    absl::Mutex mu;
+    Queues queues ABSL_GUARDED_BY(mu);
+  };
+
+  // Body of the worker thread `worker`.
+  void WorkerLoop(int worker) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Takes the next task for `worker` to run, of the highest priority queued,
+  // from its own queue, the shared queue or another worker's queue in turn.
+  // Returns false if no task is queued.
+  bool TakeTask(int worker, std::function<void()>* fn)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Mutex to guard state below.
+  absl::Mutex mu_;
+
+  // Signalled when a task is scheduled or the executor is stopping.
+  absl::CondVar work_cvar_;
+
+  // Tasks scheduled by threads other than the workers.
+  Queues queues_ ABSL_GUARDED_BY(mu_);
+
+  // Number of tasks queued which no worker has reserved. A worker reserves a
+  // task before taking one, so that it only looks for tasks which exist.
+  int num_unreserved_ ABSL_GUARDED_BY(mu_) = 0;
+
+  // Set by the destructor to stop workers once all tasks are taken.
+  bool stopping_ ABSL_GUARDED_BY(mu_) = false;
+
+  // Queues of each worker, and worker threads, which are only modified by
+  // the constructor and destructor.
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::unique_ptr<std::thread>> threads_;
+};
+
+// TaskGroup runs a set of tasks on an executor, at most `max_parallelism` at
+// once, and waits for them to finish:
+//
+//    TaskGroup group(Executor::Default(), TaskPriority::kBackground,
+//                    /*max_parallelism=*/8, cancellation_token);
+//    for (const KeyRange& range : ranges) {
+//      group.Schedule([&]() -> absl::Status { return Backfill(range); });
+//    }
+//    ZETASQL_RETURN_IF_ERROR(group.Wait());
+//
+// Wait runs the tasks which no worker has started yet on the calling thread,
+// which counts towards `max_parallelism`. A task may thus wait for a group of
+// its own without tying up a worker, and the tasks of a group make progress
+// even while every worker is busy.
+//
+// Tasks are started in the order in which they were scheduled. Once a task
+// fails, or the cancellation token is cancelled, the tasks not yet started are
+// skipped, and Wait returns the error of the earliest scheduled failing
+// task, as running the tasks in turn would.
+//
+// This class is thread safe, but Schedule should not be called once Wait may
+// have returned.
+class TaskGroup {
+ public:
+  // `token` may be null, in which case the group is only cancelled by errors.
+  // Otherwise it must outlive the group.
+  TaskGroup(Executor* executor, TaskPriority priority, int max_parallelism,
+            const CancellationToken* token = nullptr);
+
+  // Waits for the tasks scheduled.
+  ~TaskGroup();
+
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  // Schedules `fn` to run as a task of the group.
+  void Schedule(std::function<absl::Status()> fn);
+
+  // Blocks until all tasks scheduled so far have finished running or were
+  // skipped, and returns the error of the earliest scheduled failing task, or
+  // OK if none failed.
+  absl::Status Wait();
+
+ private:
+  // State shared with the runs of the group's tasks scheduled on the executor,
+  // which may still be queued once the group is destroyed.
+  struct State;
+
+  Executor* const executor_;
+  const TaskPriority priority_;
+  const std::shared_ptr<State> state_;
+};
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_EXECUTOR_H_
@@ -0,0 +1,247 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "common/executor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "common/cancellation.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+namespace {
+
+TEST(Executor, RunsAllScheduledTasks) {
+  std::atomic<int> count(0);
+  {
+    Executor executor(4);
+    absl::Notification done;
+    for (int i = 0; i < 100; ++i) {
+      executor.Schedule(TaskPriority::kBackground, [&]() {
+        if (++count == 100) {
+          done.Notify();
+        }
+      });
+    }
+    done.WaitForNotification();
+  }
+  EXPECT_EQ(100, count);
+}
+
+TEST(Executor, DestructorDrainsPendingTasks) {
+  std::atomic<int> count(0);
+  {
+    Executor executor(1);
+    for (int i = 0; i < 10; ++i) {
+      executor.Schedule(TaskPriority::kBackground, [&count]() { ++count; });
+    }
+  }
+  EXPECT_EQ(10, count);
+}
+
+TEST(Executor, RunsTasksScheduledByTasks) {
+  std::atomic<int> count(0);
+  {
+    Executor executor(4);
+    for (int i = 0; i < 10; ++i) {
+      executor.Schedule(TaskPriority::kBackground, [&]() {
+        for (int j = 0; j < 10; ++j) {
+          executor.Schedule(TaskPriority::kBackground, [&count]() { ++count; });
+        }
+      });
+    }
+  }
+  EXPECT_EQ(100, count);
+}
+
+TEST(Executor, RunsInteractiveTasksBeforeBackgroundTasks) {
+  Executor executor(1);
+  absl::Notification release;
+  executor.Schedule(TaskPriority::kBackground,
+                    [&]() { release.WaitForNotification(); });
+
+  absl::Mutex mu;
+  std::vector<TaskPriority> order;
+  absl::Notification done;
+  for (TaskPriority priority :
+       {TaskPriority::kBackground, TaskPriority::kInteractive}) {
+    executor.Schedule(priority, [&, priority]() {
+      absl::MutexLock lock(&mu);
+      order.push_back(priority);
+      if (order.size() == 2) {
+        done.Notify();
+      }
+    });
+  }
+  release.Notify();
+  done.WaitForNotification();
+  EXPECT_THAT(order, testing::ElementsAre(TaskPriority::kInteractive,
+                                          TaskPriority::kBackground));
+}
+
+TEST(Executor, UsesAtLeastOneThread) {
+  Executor executor(0);
+  EXPECT_EQ(1, executor.num_threads());
+}
+
+TEST(TaskGroup, RunsAllScheduledTasks) {
+  Executor executor(4);
+  std::atomic<int> count(0);
+  TaskGroup group(&executor, TaskPriority::kInteractive,
+                  /*max_parallelism=*/4);
+  for (int i = 0; i < 100; ++i) {
+    group.Schedule([&count]() {
+      ++count;
+      return absl::OkStatus();
+    });
+  }
+  ZETASQL_EXPECT_OK(group.Wait());
+  EXPECT_EQ(100, count);
+}
+
+TEST(TaskGroup, RunsAtMostMaxParallelismTasksAtOnce) {
+  Executor executor(8);
+  std::atomic<int> running(0);
+  std::atomic<int> max_running(0);
+  TaskGroup group(&executor, TaskPriority::kInteractive,
+                  /*max_parallelism=*/3);
+  for (int i = 0; i < 30; ++i) {
+    group.Schedule([&]() {
+      const int now_running = ++running;
+      int previous = max_running.load();
+      while (previous < now_running &&
+             !max_running.compare_exchange_weak(previous, now_running)) {
+      }
+      absl::SleepFor(absl::Milliseconds(1));
+      --running;
+      return absl::OkStatus();
+    });
+  }
+  ZETASQL_EXPECT_OK(group.Wait());
+  EXPECT_LE(max_running, 3);
+}
+
+TEST(TaskGroup, ReturnsErrorOfEarliestFailingTask) {
+  Executor executor(4);
+  TaskGroup group(&executor, TaskPriority::kBackground,
+                  /*max_parallelism=*/4);
+  for (int i = 0; i < 20; ++i) {
+    group.Schedule([i]() {
+      if (i == 7 || i == 15) {
+        return absl::InternalError(absl::StrCat("task ", i));
+      }
+      return absl::OkStatus();
+    });
+  }
+  EXPECT_EQ(group.Wait(), absl::InternalError("task 7"));
+}
+
+TEST(TaskGroup, SkipsTasksAfterFailure) {
+  Executor executor(1);
+  std::atomic<int> count(0);
+  TaskGroup group(&executor, TaskPriority::kBackground,
+                  /*max_parallelism=*/1);
+  group.Schedule([]() { return absl::InternalError("failed"); });
+  for (int i = 0; i < 10; ++i) {
+    group.Schedule([&count]() {
+      ++count;
+      return absl::OkStatus();
+    });
+  }
+  EXPECT_EQ(group.Wait(), absl::InternalError("failed"));
+  EXPECT_EQ(0, count);
+}
+
+TEST(TaskGroup, SkipsTasksOnceCancelled) {
+  Executor executor(1);
+  CancellationToken token;
+  std::atomic<int> count(0);
+  TaskGroup group(&executor, TaskPriority::kBackground,
+                  /*max_parallelism=*/1, &token);
+  group.Schedule([&]() {
+    token.Cancel();
+    return absl::OkStatus();
+  });
+  for (int i = 0; i < 10; ++i) {
+    group.Schedule([&count]() {
+      ++count;
+      return absl::OkStatus();
+    });
+  }
+  EXPECT_EQ(group.Wait().code(), absl::StatusCode::kCancelled);
+  EXPECT_EQ(0, count);
+}
+
+TEST(TaskGroup, RunsTasksOnWaitingThreadWhileWorkersAreBusy) {
+  Executor executor(1);
+  absl::Notification release;
+  executor.Schedule(TaskPriority::kBackground,
+                    [&]() { release.WaitForNotification(); });
+
+  std::atomic<int> count(0);
+  TaskGroup group(&executor, TaskPriority::kInteractive,
+                  /*max_parallelism=*/2);
+  for (int i = 0; i < 10; ++i) {
+    group.Schedule([&count]() {
+      ++count;
+      return absl::OkStatus();
+    });
+  }
+  ZETASQL_EXPECT_OK(group.Wait());
+  EXPECT_EQ(10, count);
+  release.Notify();
+}
+
+TEST(TaskGroup, NestedGroupsOnASingleWorkerDoNotDeadlock) {
+  Executor executor(1);
+  std::atomic<int> count(0);
+  TaskGroup group(&executor, TaskPriority::kBackground,
+                  /*max_parallelism=*/4);
+  for (int i = 0; i < 4; ++i) {
+    group.Schedule([&]() {
+      TaskGroup nested(&executor, TaskPriority::kBackground,
+                       /*max_parallelism=*/4);
+      for (int j = 0; j < 4; ++j) {
+        nested.Schedule([&count]() {
+          ++count;
+          return absl::OkStatus();
+        });
+      }
+      return nested.Wait();
+    });
+  }
+  ZETASQL_EXPECT_OK(group.Wait());
+  EXPECT_EQ(16, count);
+}
+
+}  // namespace
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -92,6 +92,11 @@ constexpr int kMaxStringColumnLength = (kMaxBytesColumnLength / 4);  // 2621440
 // pieces, each no larger than this limit.
 constexpr int64_t kMaxStreamingChunkSize = 1024 * 1024;  // 1 MB
 
+// Minimum size of a response returned by a streaming read or query, which
+// leaves room to repeat the lists which a value split across responses is
+// nested in.
+constexpr int64_t kMinStreamingChunkSize = 1024;  // 1 KB
+
 // Maximum size of a key in bytes.
 constexpr int kMaxKeySizeBytes = 8 * 1024;  // 8 KB
 
@@ -0,0 +1,287 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "common/metrics.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_replace.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace metrics {
+
+namespace internal {
+
+std::atomic<bool> enabled{false};
+
+}  // namespace internal
+
+namespace {
+
+// Formats labels as comma-separated name="value" pairs.
+std::string FormatLabels(const Labels& labels) {
+  return absl::StrJoin(
+      labels, ",", [](std::string* out, const auto& label) {
+        absl::StrAppend(out, label.first, "=\"",
+                        absl::StrReplaceAll(label.second, {{"\\", "\\\\"},
+                                                           {"\"", "\\\""},
+                                                           {"\n", "\\n"}}),
+                        "\"");
+      });
+}
+
+// Returns `labels` joined with `extra_label`, within braces, or an empty string
+// if both are empty.
+std::string BracedLabels(absl::string_view labels,
+                         absl::string_view extra_label = "") {
+  if (labels.empty() && extra_label.empty()) {
+    return "";
+  }
+  if (labels.empty() || extra_label.empty()) {
+    return absl::StrCat("{", labels, extra_label, "}");
+  }
+  return absl::StrCat("{", labels, ",", extra_label, "}");
+}
+
+// Registry holds all the metrics of the process, grouped into families of
+// metrics with the same name and different labels.
+class Registry {
+ public:
+  static Registry* Get() {
+    static Registry* registry = new Registry();
+    return registry;
+  }
+
+  Counter* GetCounter(absl::string_view name, absl::string_view help,
+                      const Labels& labels) ABSL_LOCKS_EXCLUDED(mu_) {
+    absl::MutexLock lock(&mu_);
+    Family& family = GetFamily(name, help);
+    std::unique_ptr<Counter>& counter = family.counters[FormatLabels(labels)];
+    if (counter == nullptr) {
+      counter = std::make_unique<Counter>();
+    }
+    return counter.get();
+  }
+
+  Histogram* GetHistogram(absl::string_view name, absl::string_view help,
+                          const Labels& labels) ABSL_LOCKS_EXCLUDED(mu_) {
+    absl::MutexLock lock(&mu_);
+    Family& family = GetFamily(name, help);
+    std::unique_ptr<Histogram>& histogram =
+        family.histograms[FormatLabels(labels)];
+    if (histogram == nullptr) {
+      histogram = std::make_unique<Histogram>();
+    }
+    return histogram.get();
+  }
+
+  int64_t RegisterGauge(absl::string_view name, absl::string_view help,
+                        GaugeCollector collector) ABSL_LOCKS_EXCLUDED(mu_) {
+    absl::MutexLock lock(&mu_);
+    const int64_t id = next_gauge_id_++;
+    GetFamily(name, help).gauges.emplace(id, std::move(collector));
+    gauge_names_.emplace(id, std::string(name));
+    return id;
+  }
+
+  void UnregisterGauge(int64_t id)
+      ABSL_LOCKS_EXCLUDED(collect_mu_, mu_) {
+    absl::MutexLock collect_lock(&collect_mu_);
+    absl::MutexLock lock(&mu_);
+    auto name_itr = gauge_names_.find(id);
+    if (name_itr == gauge_names_.end()) {
+      return;
+    }
+    families_[name_itr->second].gauges.erase(id);
+    gauge_names_.erase(name_itr);
+  }
+
+  std::string ExportText() ABSL_LOCKS_EXCLUDED(collect_mu_, mu_) {
+    // Gauge collectors are called without mu_ held. Holding collect_mu_ keeps
+    // them from being unregistered meanwhile.
+    absl::MutexLock collect_lock(&collect_mu_);
+    std::vector<std::pair<std::string, const GaugeCollector*>> collectors;
+    {
+      absl::MutexLock lock(&mu_);
+      for (const auto& [name, family] : families_) {
+        for (const auto& [id, collector] : family.gauges) {
+          collectors.emplace_back(name, &collector);
+        }
+      }
+    }
+    std::map<std::string, std::map<std::string, int64_t>> gauge_samples;
+    for (const auto& [name, collector] : collectors) {
+      for (const GaugeSample& sample : (*collector)()) {
+        gauge_samples[name][FormatLabels(sample.labels)] += sample.value;
+      }
+    }
+
+    absl::MutexLock lock(&mu_);
+    std::string text;
+    for (const auto& [name, family] : families_) {
+      absl::StrAppend(&text, "# HELP ", name, " ", family.help, "\n");
+      if (!family.counters.empty()) {
+        absl::StrAppend(&text, "# TYPE ", name, " counter\n");
+      } else if (!family.histograms.empty()) {
+        absl::StrAppend(&text, "# TYPE ", name, " histogram\n");
+      } else {
+        absl::StrAppend(&text, "# TYPE ", name, " gauge\n");
+        for (const auto& [labels, value] : gauge_samples[name]) {
+          absl::StrAppend(&text, name, BracedLabels(labels), " ", value, "\n");
+        }
+      }
+      for (const auto& [labels, counter] : family.counters) {
+        absl::StrAppend(&text, name, BracedLabels(labels), " ",
+                        counter->value(), "\n");
+      }
+      for (const auto& [labels, histogram] : family.histograms) {
+        std::vector<int64_t> counts = histogram->bucket_counts();
+        int64_t cumulative_count = 0;
+        for (int i = 0; i < Histogram::kBucketBounds.size(); ++i) {
+          cumulative_count += counts[i];
+          absl::StrAppend(
+              &text, name, "_bucket",
+              BracedLabels(labels, absl::StrCat("le=\"",
+                                                Histogram::kBucketBounds[i],
+                                                "\"")),
+              " ", cumulative_count, "\n");
+        }
+        cumulative_count += counts.back();
+        absl::StrAppend(&text, name, "_bucket",
+                        BracedLabels(labels, "le=\"+Inf\""), " ",
+                        cumulative_count, "\n");
+        absl::StrAppend(&text, name, "_sum", BracedLabels(labels), " ",
+                        absl::ToDoubleSeconds(histogram->sum()), "\n");
+        absl::StrAppend(&text, name, "_count", BracedLabels(labels), " ",
+                        cumulative_count, "\n");
+      }
+    }
+    return text;
+  }
+
+ private:
+  // Metrics with the same name. A family holds either counters, histograms or
+  // gauges.
+  struct Family {
+    std::string help;
+
+    // Metrics of the family, by their formatted labels.
+    std::map<std::string, std::unique_ptr<Counter>> counters;
+    std::map<std::string, std::unique_ptr<Histogram>> histograms;
+
+    // Collectors of the samples of gauges, by registration id.
+    std::map<int64_t, GaugeCollector> gauges;
+  };
+
+  Family& GetFamily(absl::string_view name, absl::string_view help)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    auto [itr, inserted] = families_.try_emplace(std::string(name));
+    if (inserted) {
+      itr->second.help = std::string(help);
+    }
+    return itr->second;
+  }
+
+  // Serializes calls of gauge collectors with their unregistration. Acquired
+  // before mu_.
+  absl::Mutex collect_mu_ ABSL_ACQUIRED_BEFORE(mu_);
+
+  absl::Mutex mu_;
+
+  // Families of metrics by name, sorted so that exports are stable.
+  std::map<std::string, Family> families_ ABSL_GUARDED_BY(mu_);
+
+  // Names of the gauges of registered collectors, by registration id.
+  std::map<int64_t, std::string> gauge_names_ ABSL_GUARDED_BY(mu_);
+  int64_t next_gauge_id_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace
+
+void SetEnabled(bool enabled) {
+  internal::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Histogram::Record(absl::Duration latency) {
+  if (!Enabled()) {
+    return;
+  }
+  const int bucket =
+      std::lower_bound(kBucketBounds.begin(), kBucketBounds.end(),
+                       absl::ToDoubleSeconds(latency)) -
+      kBucketBounds.begin();
+  counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+  sum_nanos_.fetch_add(absl::ToInt64Nanoseconds(latency),
+                       std::memory_order_relaxed);
+}
+
+std::vector<int64_t> Histogram::bucket_counts() const {
+  std::vector<int64_t> counts;
+  counts.reserve(counts_.size());
+  for (const std::atomic<int64_t>& count : counts_) {
+    counts.push_back(count.load(std::memory_order_relaxed));
+  }
+  return counts;
+}
+
+Counter* GetCounter(absl::string_view name, absl::string_view help,
+                    const Labels& labels) {
+  return Registry::Get()->GetCounter(name, help, labels);
+}
+
+Histogram* GetLatencyHistogram(absl::string_view name, absl::string_view help,
+                               const Labels& labels) {
+  return Registry::Get()->GetHistogram(name, help, labels);
+}
+
+GaugeRegistration::~GaugeRegistration() {
+  Registry::Get()->UnregisterGauge(id_);
+}
+
+std::unique_ptr<GaugeRegistration> RegisterGauge(absl::string_view name,
+                                                 absl::string_view help,
+                                                 GaugeCollector collector) {
+  return std::make_unique<GaugeRegistration>(
+      Registry::Get()->RegisterGauge(name, help, std::move(collector)));
+}
+
+std::string ExportText() { return Registry::Get()->ExportText(); }
+
+Histogram* StageLatency(absl::string_view stage) {
+  return GetLatencyHistogram(
+      "spanner_emulator_stage_latency_seconds",
+      "Latency of the internal stages of request processing.",
+      {{"stage", std::string(stage)}});
+}
+
+}  // namespace metrics
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
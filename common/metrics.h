@@ -0,0 +1,200 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_METRICS_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace metrics {
+
+// Metrics are lightweight counters and latency histograms which are updated on
+// the hot paths of the emulator and exported in the Prometheus text format.
+//
+// Metrics are registered once, typically in a function-local static, and then
+// updated through the returned pointer without any locking:
+//
+//   static metrics::Histogram* const latency = metrics::GetLatencyHistogram(
+//       "spanner_emulator_commit_latency_seconds", "Latency of commits.");
+//   metrics::ScopedLatencyRecorder recorder(latency);
+//
+// Collection is disabled by default, in which case updates return after a
+// single relaxed atomic load.
+
+// Labels of a metric, as (name, value) pairs.
+using Labels = std::vector<std::pair<std::string, std::string>>;
+
+namespace internal {
+
+// True if metrics are being collected.
+extern std::atomic<bool> enabled;
+
+}  // namespace internal
+
+// Enables or disables the collection of metrics.
+void SetEnabled(bool enabled);
+
+// Returns true if metrics are being collected.
+inline bool Enabled() {
+  return internal::enabled.load(std::memory_order_relaxed);
+}
+
+// A monotonically increasing count of events.
+//
+// This class is thread safe.
+class Counter {
+ public:
+  // Adds `delta` to the counter if metrics are enabled.
+  void Increment(int64_t delta = 1) {
+    if (Enabled()) {
+      value_.fetch_add(delta, std::memory_order_relaxed);
+    }
+  }
+
+  // Returns the current value of the counter.
+  int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<int64_t> value_{0};
+};
+
+// A distribution of latencies over fixed, exponentially growing buckets from
+// 10 microseconds to 10 seconds.
+//
+// This class is thread safe.
+class Histogram {
+ public:
+  // Upper bounds of the buckets in seconds. Latencies above the last bound are
+  // counted in an additional overflow bucket.
+  static constexpr std::array<double, 19> kBucketBounds = {
+      1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 5e-3, 1e-2,
+      2.5e-2, 5e-2, 1e-1, 2.5e-1, 5e-1, 1, 2.5, 5, 10};
+
+  // Records a single latency if metrics are enabled.
+  void Record(absl::Duration latency);
+
+  // Returns the number of latencies recorded in each bucket, the last one
+  // being the overflow bucket. Counts are not cumulative.
+  std::vector<int64_t> bucket_counts() const;
+
+  // Returns the sum of the recorded latencies.
+  absl::Duration sum() const {
+    return absl::Nanoseconds(sum_nanos_.load(std::memory_order_relaxed));
+  }
+
+ private:
+  std::array<std::atomic<int64_t>, kBucketBounds.size() + 1> counts_{};
+  std::atomic<int64_t> sum_nanos_{0};
+};
+
+// Returns the counter registered as `name` with `labels`, registering it with
+// `help` as its description if it does not exist yet. Counter names should end
+// in "_total". The returned counter lives for the lifetime of the process.
+Counter* GetCounter(absl::string_view name, absl::string_view help,
+                    const Labels& labels = {});
+
+// Returns the latency histogram registered as `name` with `labels`,
+// registering it with `help` as its description if it does not exist yet.
+// Histogram names should end in "_seconds". The returned histogram lives for
+// the lifetime of the process.
+Histogram* GetLatencyHistogram(absl::string_view name, absl::string_view help,
+                               const Labels& labels = {});
+
+// A sample of a gauge: the current value of a quantity which goes up and down,
+// such as the bytes of memory in use.
+struct GaugeSample {
+  Labels labels;
+  int64_t value = 0;
+};
+
+// Returns the current samples of a gauge. Collectors are called each time
+// metrics are exported, regardless of whether metrics are being collected.
+using GaugeCollector = std::function<std::vector<GaugeSample>()>;
+
+// Keeps a gauge collector registered until it is destroyed. Destruction waits
+// for an export calling the collector to finish, so the collector may refer to
+// objects which outlive the registration.
+class GaugeRegistration {
+ public:
+  explicit GaugeRegistration(int64_t id) : id_(id) {}
+  ~GaugeRegistration();
+
+  GaugeRegistration(const GaugeRegistration&) = delete;
+  GaugeRegistration& operator=(const GaugeRegistration&) = delete;
+
+ private:
+  const int64_t id_;
+};
+
+// Registers `collector` as a source of samples of the gauge `name`, registering
+// the gauge with `help` as its description if it does not exist yet. Several
+// collectors may provide samples of the same gauge, with distinct labels.
+// Collectors are called without the registry's lock held, so they may acquire
+// locks under which metrics are updated.
+std::unique_ptr<GaugeRegistration> RegisterGauge(absl::string_view name,
+                                                 absl::string_view help,
+                                                 GaugeCollector collector);
+
+// Returns all registered metrics in the Prometheus text exposition format.
+std::string ExportText();
+
+// Returns the latency histogram of `stage`, one of the internal stages of
+// request processing (e.g. "analyze" or "commit_flush").
+Histogram* StageLatency(absl::string_view stage);
+
+// Records the time elapsed between its construction and destruction in a
+// histogram. The clock is only read if metrics are enabled.
+class ScopedLatencyRecorder {
+ public:
+  explicit ScopedLatencyRecorder(Histogram* histogram)
+      : histogram_(Enabled() ? histogram : nullptr),
+        start_(histogram_ != nullptr ? absl::Now() : absl::InfinitePast()) {}
+
+  ~ScopedLatencyRecorder() {
+    if (histogram_ != nullptr) {
+      histogram_->Record(absl::Now() - start_);
+    }
+  }
+
+  ScopedLatencyRecorder(const ScopedLatencyRecorder&) = delete;
+  ScopedLatencyRecorder& operator=(const ScopedLatencyRecorder&) = delete;
+
+ private:
+  Histogram* const histogram_;
+  const absl::Time start_;
+};
+
+}  // namespace metrics
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_METRICS_H_
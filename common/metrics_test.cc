@@ -0,0 +1,149 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "common/metrics.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace metrics {
+
+namespace {
+
+using testing::HasSubstr;
+using testing::Not;
+
+class MetricsTest : public testing::Test {
+ protected:
+  MetricsTest() { SetEnabled(true); }
+  ~MetricsTest() override { SetEnabled(false); }
+};
+
+TEST_F(MetricsTest, CountersAreOnlyUpdatedWhileEnabled) {
+  Counter* counter = GetCounter("test_enabled_total", "Test counter.");
+  counter->Increment();
+  SetEnabled(false);
+  counter->Increment();
+  SetEnabled(true);
+  counter->Increment(2);
+  EXPECT_EQ(counter->value(), 3);
+}
+
+TEST_F(MetricsTest, ReturnsTheSameMetricForTheSameNameAndLabels) {
+  Counter* counter =
+      GetCounter("test_labels_total", "Test counter.", {{"method", "Read"}});
+  EXPECT_EQ(counter, GetCounter("test_labels_total", "Test counter.",
+                                {{"method", "Read"}}));
+  EXPECT_NE(counter, GetCounter("test_labels_total", "Test counter.",
+                                {{"method", "Commit"}}));
+}
+
+TEST_F(MetricsTest, HistogramsCountLatenciesInBuckets) {
+  Histogram* histogram =
+      GetLatencyHistogram("test_buckets_seconds", "Test histogram.");
+  histogram->Record(absl::Microseconds(10));
+  histogram->Record(absl::Milliseconds(3));
+  histogram->Record(absl::Seconds(60));
+
+  std::vector<int64_t> counts = histogram->bucket_counts();
+  ASSERT_EQ(counts.size(), Histogram::kBucketBounds.size() + 1);
+  EXPECT_EQ(counts[0], 1);
+  EXPECT_EQ(counts[8], 1);
+  EXPECT_EQ(counts.back(), 1);
+  EXPECT_EQ(histogram->sum(),
+            absl::Microseconds(10) + absl::Milliseconds(3) + absl::Seconds(60));
+}
+
+TEST_F(MetricsTest, ExportsMetricsInPrometheusTextFormat) {
+  GetCounter("test_export_total", "Exported counter.", {{"reason", "a\"b"}})
+      ->Increment(5);
+  GetLatencyHistogram("test_export_seconds", "Exported histogram.",
+                      {{"stage", "analyze"}})
+      ->Record(absl::Milliseconds(2));
+
+  std::string text = ExportText();
+  EXPECT_THAT(text, HasSubstr("# HELP test_export_total Exported counter.\n"
+                              "# TYPE test_export_total counter\n"
+                              "test_export_total{reason=\"a\\\"b\"} 5\n"));
+  EXPECT_THAT(text, HasSubstr("# TYPE test_export_seconds histogram\n"));
+  EXPECT_THAT(text, HasSubstr("test_export_seconds_bucket{stage=\"analyze\","
+                              "le=\"0.001\"} 0\n"));
+  EXPECT_THAT(text, HasSubstr("test_export_seconds_bucket{stage=\"analyze\","
+                              "le=\"0.0025\"} 1\n"));
+  EXPECT_THAT(text, HasSubstr("test_export_seconds_bucket{stage=\"analyze\","
+                              "le=\"+Inf\"} 1\n"));
+  EXPECT_THAT(text,
+              HasSubstr("test_export_seconds_sum{stage=\"analyze\"} 0.002\n"));
+  EXPECT_THAT(text,
+              HasSubstr("test_export_seconds_count{stage=\"analyze\"} 1\n"));
+  EXPECT_THAT(text, Not(HasSubstr("test_export_seconds_bucket{stage=\"analyze\""
+                                  ",le=\"0.005\"} 0")));
+}
+
+TEST_F(MetricsTest, ExportsGaugesFromCollectors) {
+  int64_t bytes = 10;
+  std::unique_ptr<GaugeRegistration> registration = RegisterGauge(
+      "test_gauge_bytes", "Test gauge.", [&bytes]() {
+        return std::vector<GaugeSample>{{{{"table", "Users"}}, bytes}};
+      });
+  std::unique_ptr<GaugeRegistration> other_registration =
+      RegisterGauge("test_gauge_bytes", "Test gauge.", []() {
+        return std::vector<GaugeSample>{{{{"table", "Albums"}}, 3}};
+      });
+  bytes = 20;
+
+  std::string text = ExportText();
+  EXPECT_THAT(text, HasSubstr("# HELP test_gauge_bytes Test gauge.\n"
+                              "# TYPE test_gauge_bytes gauge\n"
+                              "test_gauge_bytes{table=\"Albums\"} 3\n"
+                              "test_gauge_bytes{table=\"Users\"} 20\n"));
+
+  registration.reset();
+  text = ExportText();
+  EXPECT_THAT(text, HasSubstr("test_gauge_bytes{table=\"Albums\"} 3\n"));
+  EXPECT_THAT(text, Not(HasSubstr("Users")));
+}
+
+TEST_F(MetricsTest, ScopedLatencyRecorderRecordsElapsedTime) {
+  Histogram* histogram =
+      GetLatencyHistogram("test_scoped_seconds", "Test histogram.");
+  { ScopedLatencyRecorder recorder(histogram); }
+  SetEnabled(false);
+  { ScopedLatencyRecorder recorder(histogram); }
+  std::vector<int64_t> counts = histogram->bucket_counts();
+  int64_t total = 0;
+  for (int64_t count : counts) {
+    total += count;
+  }
+  EXPECT_EQ(total, 1);
+}
+
+}  // namespace
+
+}  // namespace metrics
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
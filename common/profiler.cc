@@ -0,0 +1,104 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "common/profiler.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef SPANNER_EMULATOR_WITH_TCMALLOC
+#include "gperftools/malloc_extension.h"
+#include "gperftools/profiler.h"
+#endif
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "zetasql/base/statusor.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace profiler {
+
+#ifdef SPANNER_EMULATOR_WITH_TCMALLOC
+
+bool Enabled() { return true; }
+
+zetasql_base::StatusOr<std::string> HeapProfile() {
+  std::string profile;
+  MallocExtension::instance()->GetHeapSample(&profile);
+  return profile;
+}
+
+zetasql_base::StatusOr<std::string> CpuProfile(absl::Duration duration) {
+  // The CPU profiler can only write the profile to a file.
+  const char* dir = std::getenv("TMPDIR");
+  const std::string path = absl::StrCat(dir != nullptr ? dir : "/tmp",
+                                        "/emulator-cpu-", getpid(), ".prof");
+  if (!ProfilerStart(path.c_str())) {
+    return absl::Status(absl::StatusCode::kFailedPrecondition,
+                        "A CPU profile is already being collected.");
+  }
+  absl::SleepFor(duration);
+  ProfilerStop();
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return absl::Status(absl::StatusCode::kInternal,
+                        absl::StrCat("Failed to read CPU profile ", path));
+  }
+  std::stringstream profile;
+  profile << file.rdbuf();
+  std::remove(path.c_str());
+  return profile.str();
+}
+
+#else
+
+namespace {
+
+absl::Status NotBuiltWithTcmalloc() {
+  return absl::Status(
+      absl::StatusCode::kUnimplemented,
+      "Profiling requires building the emulator with --config=tcmalloc.");
+}
+
+}  // namespace
+
+bool Enabled() { return false; }
+
+zetasql_base::StatusOr<std::string> HeapProfile() {
+  return NotBuiltWithTcmalloc();
+}
+
+zetasql_base::StatusOr<std::string> CpuProfile(absl::Duration duration) {
+  return NotBuiltWithTcmalloc();
+}
+
+#endif  // SPANNER_EMULATOR_WITH_TCMALLOC
+
+}  // namespace profiler
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,57 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_PROFILER_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_PROFILER_H_
+
+#include <string>
+
+#include "absl/time/time.h"
+#include "zetasql/base/statusor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace profiler {
+
+// Heap and CPU profiles of the emulator, in the format read by pprof (e.g.
+// `pprof --web http://<metrics_host_port>/debug/pprof/heap`).
+//
+// Profiles are provided by tcmalloc (from gperftools), which the emulator uses
+// as its allocator when built with `bazel build --config=tcmalloc`. In other
+// builds these functions return UNIMPLEMENTED.
+
+// Returns true if the emulator was built with tcmalloc and can be profiled.
+bool Enabled();
+
+// Returns a profile of the memory currently allocated on the heap. tcmalloc
+// only samples allocations if the TCMALLOC_SAMPLE_PARAMETER environment
+// variable is set to the average number of bytes between samples (e.g. 524288)
+// when the emulator starts; otherwise the profile is empty.
+zetasql_base::StatusOr<std::string> HeapProfile();
+
+// Profiles the CPU usage of the emulator for `duration` and returns the
+// profile. Blocks the caller for `duration`. Fails if a CPU profile is
+// already being collected.
+zetasql_base::StatusOr<std::string> CpuProfile(absl::Duration duration);
+
+}  // namespace profiler
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_PROFILER_H_
@@ -0,0 +1,284 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "common/slow_log.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+
+#include "zetasql/base/logging.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "common/constants.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace slow_log {
+
+namespace internal {
+
+std::atomic<bool> enabled{false};
+
+thread_local RequestStats* current = nullptr;
+
+}  // namespace internal
+
+namespace {
+
+// Longest SQL text recorded and logged for a request, so that enormous
+// statements do not flood the log.
+constexpr int kMaxSqlLength = 1024;
+
+std::atomic<int64_t> threshold_nanos{0};
+
+// Limits the number of requests logged per second, counting the requests over
+// the rate until the next one is logged.
+class RateLimiter {
+ public:
+  void set_max_per_second(int max_per_second) ABSL_LOCKS_EXCLUDED(mu_) {
+    absl::MutexLock lock(&mu_);
+    max_per_second_ = max_per_second;
+    logged_in_window_ = 0;
+    suppressed_ = 0;
+  }
+
+  // Returns true if a request may be logged, and the number of requests which
+  // were not logged since the last one in `suppressed`.
+  bool Allow(int64_t* suppressed) ABSL_LOCKS_EXCLUDED(mu_) {
+    absl::MutexLock lock(&mu_);
+    const int64_t second = absl::ToUnixSeconds(absl::Now());
+    if (second != window_second_) {
+      window_second_ = second;
+      logged_in_window_ = 0;
+    }
+    if (max_per_second_ > 0 && logged_in_window_ >= max_per_second_) {
+      ++suppressed_;
+      return false;
+    }
+    ++logged_in_window_;
+    *suppressed = suppressed_;
+    suppressed_ = 0;
+    return true;
+  }
+
+ private:
+  absl::Mutex mu_;
+  int max_per_second_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t window_second_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t logged_in_window_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t suppressed_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+RateLimiter& Limiter() {
+  static RateLimiter* const limiter = new RateLimiter();
+  return *limiter;
+}
+
+absl::Mutex sink_mu(absl::kConstInit);
+std::function<void(absl::string_view)>* sink ABSL_GUARDED_BY(sink_mu) =
+    nullptr;
+
+void Emit(absl::string_view line) {
+  absl::MutexLock lock(&sink_mu);
+  if (sink != nullptr) {
+    (*sink)(line);
+    return;
+  }
+  LOG(INFO) << line;
+}
+
+bool IsIdentifierChar(char c) { return absl::ascii_isalnum(c) || c == '_'; }
+
+// Returns the position just past the quoted literal starting at `pos`.
+size_t SkipQuoted(absl::string_view sql, size_t pos) {
+  const char quote = sql[pos];
+  const bool triple = sql.substr(pos, 3) == std::string(3, quote);
+  pos += triple ? 3 : 1;
+  while (pos < sql.size()) {
+    if (sql[pos] == '\\') {
+      pos += 2;
+      continue;
+    }
+    if (sql[pos] == quote &&
+        (!triple || sql.substr(pos, 3) == std::string(3, quote))) {
+      return pos + (triple ? 3 : 1);
+    }
+    ++pos;
+  }
+  return sql.size();
+}
+
+}  // namespace
+
+void RequestStats::RecordSql(absl::string_view sql) {
+  absl::MutexLock lock(&mu_);
+  if (sql_.size() >= kMaxSqlLength) {
+    return;
+  }
+  if (!sql_.empty()) {
+    absl::StrAppend(&sql_, "; ");
+  }
+  absl::StrAppend(&sql_, sql.substr(0, kMaxSqlLength - sql_.size()));
+}
+
+std::string RequestStats::sql() const {
+  absl::MutexLock lock(&mu_);
+  return sql_;
+}
+
+void Configure(absl::Duration threshold, int max_per_second) {
+  threshold_nanos.store(absl::ToInt64Nanoseconds(threshold),
+                        std::memory_order_relaxed);
+  Limiter().set_max_per_second(max_per_second);
+  internal::enabled.store(threshold > absl::ZeroDuration(),
+                          std::memory_order_relaxed);
+}
+
+ScopedRequest::ScopedRequest(absl::string_view name) {
+  if (!Enabled() || internal::current != nullptr) {
+    return;
+  }
+  active_ = true;
+  name_ = std::string(name);
+  start_ = absl::Now();
+  internal::current = &stats_;
+}
+
+ScopedRequest::~ScopedRequest() {
+  if (!active_) {
+    return;
+  }
+  internal::current = nullptr;
+  const absl::Duration latency = absl::Now() - start_;
+  if (latency < absl::Nanoseconds(
+                    threshold_nanos.load(std::memory_order_relaxed))) {
+    return;
+  }
+  int64_t suppressed = 0;
+  if (!Limiter().Allow(&suppressed)) {
+    return;
+  }
+
+  std::string line = absl::StrCat(
+      "Slow request ", name_, " took ", absl::FormatDuration(latency),
+      ": status=", absl::StatusCodeToString(status_.code()),
+      " rows_scanned=", stats_.rows_scanned(),
+      " lock_wait=", absl::FormatDuration(stats_.lock_wait()));
+  auto conflicting = status_.GetPayload(kConflictingTransaction);
+  if (conflicting.has_value()) {
+    absl::StrAppend(&line, " conflicting_transaction=",
+                    std::string(*conflicting));
+  }
+  const std::string sql = stats_.sql();
+  if (!sql.empty()) {
+    absl::StrAppendFormat(&line, " sql_fingerprint=%016x sql=\"%s\"",
+                          Fingerprint(sql), NormalizeSql(sql));
+  }
+  if (suppressed > 0) {
+    absl::StrAppend(&line, " (", suppressed,
+                    " slow requests were not logged over the rate limit)");
+  }
+  Emit(line);
+}
+
+std::string NormalizeSql(absl::string_view sql) {
+  std::string normalized;
+  normalized.reserve(sql.size());
+  bool pending_space = false;
+  auto append = [&](absl::string_view token) {
+    if (pending_space && !normalized.empty()) {
+      normalized.push_back(' ');
+    }
+    pending_space = false;
+    absl::StrAppend(&normalized, token);
+  };
+  size_t pos = 0;
+  while (pos < sql.size()) {
+    const char c = sql[pos];
+    if (absl::ascii_isspace(c)) {
+      pending_space = true;
+      ++pos;
+    } else if (c == '#' || sql.substr(pos, 2) == "--") {
+      pos = sql.find('\n', pos);
+      pos = pos == absl::string_view::npos ? sql.size() : pos;
+      pending_space = true;
+    } else if (sql.substr(pos, 2) == "/*") {
+      pos = sql.find("*/", pos + 2);
+      pos = pos == absl::string_view::npos ? sql.size() : pos + 2;
+      pending_space = true;
+    } else if (c == '\'' || c == '"') {
+      pos = SkipQuoted(sql, pos);
+      append("?");
+    } else if (c == '`') {
+      // Quoted identifiers are kept.
+      const size_t end = SkipQuoted(sql, pos);
+      append(sql.substr(pos, end - pos));
+      pos = end;
+    } else if (absl::ascii_isdigit(c) &&
+               (pos == 0 || !IsIdentifierChar(sql[pos - 1]))) {
+      // Numeric literals, including hexadecimal and floating point ones.
+      while (pos < sql.size() &&
+             (IsIdentifierChar(sql[pos]) || sql[pos] == '.' ||
+              ((sql[pos] == '+' || sql[pos] == '-') &&
+               absl::ascii_tolower(sql[pos - 1]) == 'e'))) {
+        ++pos;
+      }
+      append("?");
+    } else {
+      size_t end = pos + 1;
+      while (end < sql.size() && IsIdentifierChar(sql[pos]) &&
+             IsIdentifierChar(sql[end])) {
+        ++end;
+      }
+      append(sql.substr(pos, end - pos));
+      pos = end;
+    }
+  }
+  return normalized;
+}
+
+uint64_t Fingerprint(absl::string_view sql) {
+  // 64-bit FNV-1a, which is stable across processes unlike absl::Hash.
+  uint64_t hash = 0xcbf29ce484222325;
+  for (const char c : NormalizeSql(sql)) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+void SetSinkForTesting(std::function<void(absl::string_view)> new_sink) {
+  absl::MutexLock lock(&sink_mu);
+  delete sink;
+  sink = new_sink == nullptr
+             ? nullptr
+             : new std::function<void(absl::string_view)>(std::move(new_sink));
+}
+
+}  // namespace slow_log
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,170 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_SLOW_LOG_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_SLOW_LOG_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace slow_log {
+
+// The slow request log records a single line per request which takes longer
+// than a threshold, with what the request spent its time on: the fingerprint
+// of its SQL text, the rows it scanned, the time it waited for locks and, for
+// aborted requests, the transaction holding the conflicting lock, which is
+// read from the kConflictingTransaction payload of their status. Unlike
+// --log_requests, it does not log the requests themselves, and is rate limited
+// so that it can be left on under load.
+
+// Statistics of the request served by a thread.
+class RequestStats {
+ public:
+  void AddRowsScanned(int64_t rows) {
+    rows_scanned_.fetch_add(rows, std::memory_order_relaxed);
+  }
+  void AddLockWait(absl::Duration wait) {
+    lock_wait_nanos_.fetch_add(absl::ToInt64Nanoseconds(wait),
+                               std::memory_order_relaxed);
+  }
+  void RecordSql(absl::string_view sql) ABSL_LOCKS_EXCLUDED(mu_);
+
+  int64_t rows_scanned() const {
+    return rows_scanned_.load(std::memory_order_relaxed);
+  }
+  absl::Duration lock_wait() const {
+    return absl::Nanoseconds(lock_wait_nanos_.load(std::memory_order_relaxed));
+  }
+  std::string sql() const ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  std::atomic<int64_t> rows_scanned_ = 0;
+  std::atomic<int64_t> lock_wait_nanos_ = 0;
+  mutable absl::Mutex mu_;
+  std::string sql_ ABSL_GUARDED_BY(mu_);
+};
+
+namespace internal {
+
+// True if a nonzero threshold was set.
+extern std::atomic<bool> enabled;
+
+// The statistics of the request served by the current thread, if it may be
+// logged.
+extern thread_local RequestStats* current;
+
+}  // namespace internal
+
+// Sets the latency above which requests are logged, or disables the log if it
+// is zero, and the maximum number of requests logged per second. Requests over
+// the rate are counted and reported with the next logged request.
+void Configure(absl::Duration threshold, int max_per_second);
+
+// Returns true if slow requests are logged.
+inline bool Enabled() {
+  return internal::enabled.load(std::memory_order_relaxed);
+}
+
+// Returns the statistics of the request served by the current thread, or null
+// if it is not being recorded.
+inline RequestStats* Current() { return internal::current; }
+
+// Records the statistics of the request served by the current thread from its
+// construction to its destruction, and logs them if the request took longer
+// than the threshold. A request nested within another is recorded as part of
+// the outer one.
+class ScopedRequest {
+ public:
+  explicit ScopedRequest(absl::string_view name);
+  ~ScopedRequest();
+
+  ScopedRequest(const ScopedRequest&) = delete;
+  ScopedRequest& operator=(const ScopedRequest&) = delete;
+
+  // Sets the status the request completed with.
+  void set_status(const absl::Status& status) { status_ = status; }
+
+ private:
+  std::string name_;
+  absl::Time start_;
+  absl::Status status_;
+  RequestStats stats_;
+  bool active_ = false;
+};
+
+// Attaches the statistics of a request to the current thread from its
+// construction to its destruction, for work done on behalf of the request by
+// other threads, such as the partitions of a parallel query.
+class ScopedAttach {
+ public:
+  explicit ScopedAttach(RequestStats* stats) : previous_(internal::current) {
+    internal::current = stats;
+  }
+  ~ScopedAttach() { internal::current = previous_; }
+
+  ScopedAttach(const ScopedAttach&) = delete;
+  ScopedAttach& operator=(const ScopedAttach&) = delete;
+
+ private:
+  RequestStats* previous_;
+};
+
+// Helpers recording statistics of the request served by the current thread,
+// which do nothing if it is not being recorded.
+inline void AddRowsScanned(int64_t rows) {
+  if (internal::current != nullptr) {
+    internal::current->AddRowsScanned(rows);
+  }
+}
+inline void AddLockWait(absl::Duration wait) {
+  if (internal::current != nullptr) {
+    internal::current->AddLockWait(wait);
+  }
+}
+inline void RecordSql(absl::string_view sql) {
+  if (internal::current != nullptr) {
+    internal::current->RecordSql(sql);
+  }
+}
+
+// Returns `sql` with its literals replaced by '?' and its whitespace collapsed,
+// so that statements which only differ in their literals are logged alike.
+std::string NormalizeSql(absl::string_view sql);
+
+// Returns a stable 64-bit hash of the normalized `sql`.
+uint64_t Fingerprint(absl::string_view sql);
+
+// Replaces where logged lines are written, by default the INFO log, or restores
+// the default if `sink` is null. Used by tests.
+void SetSinkForTesting(std::function<void(absl::string_view)> sink);
+
+}  // namespace slow_log
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_SLOW_LOG_H_
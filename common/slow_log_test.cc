@@ -0,0 +1,168 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "common/slow_log.h"
+
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "common/constants.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace slow_log {
+
+namespace {
+
+using testing::AllOf;
+using testing::ElementsAre;
+using testing::HasSubstr;
+using testing::IsEmpty;
+using testing::Not;
+
+class SlowLogTest : public testing::Test {
+ protected:
+  SlowLogTest() {
+    SetSinkForTesting(
+        [this](absl::string_view line) { lines_.emplace_back(line); });
+  }
+
+  ~SlowLogTest() override {
+    Configure(absl::ZeroDuration(), /*max_per_second=*/0);
+    SetSinkForTesting(nullptr);
+  }
+
+  // Serves a request which takes at least a millisecond.
+  void SlowRequest(absl::Status status = absl::OkStatus()) {
+    ScopedRequest request("Spanner.ExecuteSql");
+    absl::SleepFor(absl::Milliseconds(1));
+    request.set_status(status);
+  }
+
+  std::vector<std::string> lines_;
+};
+
+TEST_F(SlowLogTest, DoesNotRecordRequestsWhenDisabled) {
+  ScopedRequest request("Spanner.ExecuteSql");
+  EXPECT_EQ(Current(), nullptr);
+}
+
+TEST_F(SlowLogTest, LogsRequestsOverTheThreshold) {
+  Configure(absl::Microseconds(10), /*max_per_second=*/0);
+  {
+    ScopedRequest request("Spanner.ExecuteSql");
+    ASSERT_NE(Current(), nullptr);
+    RecordSql("SELECT * FROM T WHERE K = 1");
+    AddRowsScanned(5);
+    AddRowsScanned(2);
+    AddLockWait(absl::Milliseconds(3));
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  EXPECT_EQ(Current(), nullptr);
+  ASSERT_EQ(lines_.size(), 1);
+  EXPECT_THAT(lines_[0],
+              AllOf(HasSubstr("Slow request Spanner.ExecuteSql took"),
+                    HasSubstr("status=OK"), HasSubstr("rows_scanned=7"),
+                    HasSubstr("lock_wait=3ms"),
+                    HasSubstr("sql=\"SELECT * FROM T WHERE K = ?\""),
+                    Not(HasSubstr("conflicting_transaction"))));
+}
+
+TEST_F(SlowLogTest, DoesNotLogFastRequests) {
+  Configure(absl::Hours(1), /*max_per_second=*/0);
+  SlowRequest();
+  EXPECT_THAT(lines_, IsEmpty());
+}
+
+TEST_F(SlowLogTest, LogsConflictingTransactionOfAbortedRequests) {
+  Configure(absl::Microseconds(10), /*max_per_second=*/0);
+  absl::Status aborted = absl::AbortedError("conflict");
+  aborted.SetPayload(kConflictingTransaction, absl::Cord("42"));
+  SlowRequest(aborted);
+  ASSERT_EQ(lines_.size(), 1);
+  EXPECT_THAT(lines_[0], AllOf(HasSubstr("status=ABORTED"),
+                               HasSubstr("conflicting_transaction=42")));
+}
+
+TEST_F(SlowLogTest, RateLimitsLoggedRequests) {
+  Configure(absl::Microseconds(10), /*max_per_second=*/2);
+  // Requests are logged at most twice per second, so at least three of the
+  // requests fall in a second which logged two already.
+  const absl::Time start = absl::Now();
+  for (int i = 0; i < 10; ++i) {
+    SlowRequest();
+  }
+  if (absl::Now() - start > absl::Seconds(1)) {
+    GTEST_SKIP() << "Requests spanned more than a second.";
+  }
+  EXPECT_LE(lines_.size(), 4);
+  EXPECT_GE(lines_.size(), 2);
+
+  // The requests which were not logged are reported with the next one.
+  absl::SleepFor(absl::Seconds(1));
+  lines_.clear();
+  SlowRequest();
+  ASSERT_EQ(lines_.size(), 1);
+  EXPECT_THAT(lines_[0], HasSubstr("slow requests were not logged"));
+}
+
+TEST_F(SlowLogTest, AttachesRequestToOtherThreads) {
+  Configure(absl::Microseconds(10), /*max_per_second=*/0);
+  {
+    ScopedRequest request("Spanner.ExecuteSql");
+    RequestStats* stats = Current();
+    std::thread worker([stats]() {
+      ScopedAttach attach(stats);
+      AddRowsScanned(3);
+    });
+    worker.join();
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  ASSERT_EQ(lines_.size(), 1);
+  EXPECT_THAT(lines_[0], HasSubstr("rows_scanned=3"));
+}
+
+TEST(NormalizeSqlTest, ReplacesLiteralsAndCollapsesWhitespace) {
+  EXPECT_EQ(NormalizeSql("SELECT a, 'x''s'  FROM T\n  WHERE b = 1.5e-3"
+                         " AND c = \"y\" -- comment\n AND d = @p1"),
+            "SELECT a, ?? FROM T WHERE b = ? AND c = ? AND d = @p1");
+  EXPECT_EQ(NormalizeSql("SELECT `col 1`, t2.x FROM t2 /* c */ LIMIT 10"),
+            "SELECT `col 1`, t2.x FROM t2 LIMIT ?");
+  EXPECT_EQ(NormalizeSql("SELECT '''a'b'''"), "SELECT ?");
+}
+
+TEST(NormalizeSqlTest, FingerprintsStatementsWhichDifferInLiterals) {
+  EXPECT_EQ(Fingerprint("SELECT * FROM T WHERE K = 1"),
+            Fingerprint("SELECT *  FROM T WHERE K = 2"));
+  EXPECT_NE(Fingerprint("SELECT * FROM T WHERE K = 1"),
+            Fingerprint("SELECT * FROM U WHERE K = 1"));
+}
+
+}  // namespace
+
+}  // namespace slow_log
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
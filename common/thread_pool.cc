@@ -0,0 +1,87 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "common/thread_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "common/cpu_placement.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+ThreadPool::ThreadPool(int num_threads) {
+  num_threads = std::max(num_threads, 1);
+  threads_.reserve(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.push_back(
+        absl::make_unique<std::thread>(&ThreadPool::WorkerLoop, this));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    absl::MutexLock lock(&mu_);
+    stopping_ = true;
+    work_cvar_.SignalAll();
+  }
+  for (auto& thread : threads_) {
+    thread->join();
+  }
+}
+
+void ThreadPool::Schedule(std::function<void()> fn) {
+  absl::MutexLock lock(&mu_);
+  queue_.push_back(std::move(fn));
+  work_cvar_.Signal();
+}
+
+void ThreadPool::WaitUntilIdle() {
+  absl::MutexLock lock(&mu_);
+  while (!queue_.empty() || num_running_ > 0) {
+    done_cvar_.Wait(&mu_);
+  }
+}
+
+void ThreadPool::WorkerLoop() {
+  cpu_placement::PlaceCurrentThread();
+  while (true) {
+    std::function<void()> fn;
+    {
+      absl::MutexLock lock(&mu_);
+      while (queue_.empty() && !stopping_) {
+        work_cvar_.Wait(&mu_);
+      }
+      if (queue_.empty()) {
+        return;
+      }
+      fn = std::move(queue_.front());
+      queue_.pop_front();
+      ++num_running_;
+    }
+    fn();
+    absl::MutexLock lock(&mu_);
+    --num_running_;
+    done_cvar_.SignalAll();
+  }
+}
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,88 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_THREAD_POOL_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_THREAD_POOL_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+// ThreadPool runs closures on a fixed number of worker threads.
+//
+// Closures are run in the order in which they were scheduled. Closures which
+// are scheduled while all workers are busy wait in an unbounded queue, so the
+// number of threads never grows with the amount of scheduled work.
+//
+// The destructor waits for all scheduled closures to finish running.
+//
+// This class is thread safe.
+class ThreadPool {
+ public:
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Schedules `fn` to run on one of the worker threads.
+  void Schedule(std::function<void()> fn) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Blocks until all closures scheduled so far have finished running.
+  void WaitUntilIdle() ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the number of worker threads.
+  int num_threads() const { return static_cast<int>(threads_.size()); }
+
+ private:
+  // Body of each worker thread.
+  void WorkerLoop() ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Mutex to guard state below.
+  absl::Mutex mu_;
+
+  // Signalled when a closure is scheduled or the pool is stopping.
+  absl::CondVar work_cvar_;
+
+  // Signalled when a worker finishes running a closure.
+  absl::CondVar done_cvar_;
+
+  // Closures waiting for a free worker.
+  std::deque<std::function<void()>> queue_ ABSL_GUARDED_BY(mu_);
+
+  // Number of closures currently being run by workers.
+  int num_running_ ABSL_GUARDED_BY(mu_) = 0;
+
+  // Set by the destructor to stop workers once the queue is drained.
+  bool stopping_ ABSL_GUARDED_BY(mu_) = false;
+
+  // Worker threads, which are only modified by the constructor and destructor.
+  std::vector<std::unique_ptr<std::thread>> threads_;
+};
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_THREAD_POOL_H_
@@ -0,0 +1,89 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "common/thread_pool.h"
+
+#include <atomic>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+namespace {
+
+TEST(ThreadPool, RunsAllScheduledClosures) {
+  std::atomic<int> count(0);
+  {
+    ThreadPool pool(4);
+    for (int i = 0; i < 100; ++i) {
+      pool.Schedule([&count]() { ++count; });
+    }
+    pool.WaitUntilIdle();
+    EXPECT_EQ(100, count);
+  }
+  EXPECT_EQ(100, count);
+}
+
+TEST(ThreadPool, DestructorDrainsPendingClosures) {
+  std::atomic<int> count(0);
+  {
+    ThreadPool pool(1);
+    for (int i = 0; i < 10; ++i) {
+      pool.Schedule([&count]() { ++count; });
+    }
+  }
+  EXPECT_EQ(10, count);
+}
+
+TEST(ThreadPool, QueuesClosuresWhileAllWorkersAreBusy) {
+  ThreadPool pool(2);
+  absl::Notification release;
+  std::atomic<int> started(0);
+  for (int i = 0; i < 3; ++i) {
+    pool.Schedule([&]() {
+      ++started;
+      release.WaitForNotification();
+    });
+  }
+
+  // Only two of the three closures can be running at once.
+  while (started < 2) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  absl::SleepFor(absl::Milliseconds(20));
+  EXPECT_EQ(2, started);
+
+  release.Notify();
+  pool.WaitUntilIdle();
+  EXPECT_EQ(3, started);
+}
+
+TEST(ThreadPool, UsesAtLeastOneThread) {
+  ThreadPool pool(0);
+  EXPECT_EQ(1, pool.num_threads());
+}
+
+}  // namespace
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,112 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "common/timer_service.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "common/timing_wheel.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+TimerService::TimerService(absl::Duration tick)
+    : tick_(tick), wheel_(absl::Now(), tick) {
+  thread_ = absl::make_unique<std::thread>([this]() { Run(); });
+}
+
+TimerService::~TimerService() {
+  {
+    absl::MutexLock lock(&mu_);
+    stopping_ = true;
+    cvar_.SignalAll();
+  }
+  thread_->join();
+}
+
+TimerService::TimerId TimerService::Schedule(absl::Time deadline,
+                                             std::function<void()> callback) {
+  absl::MutexLock lock(&mu_);
+  return wheel_.Schedule(deadline, std::move(callback));
+}
+
+bool TimerService::Cancel(TimerId id) {
+  absl::MutexLock lock(&mu_);
+  if (wheel_.Cancel(id)) {
+    return true;
+  }
+  auto itr = std::find_if(
+      expired_.begin(), expired_.end(),
+      [id](const TimingWheel::Timer& timer) { return timer.id == id; });
+  if (itr != expired_.end()) {
+    expired_.erase(itr);
+    return true;
+  }
+  if (std::this_thread::get_id() != thread_->get_id()) {
+    while (running_ && running_id_ == id) {
+      cvar_.Wait(&mu_);
+    }
+  }
+  return false;
+}
+
+void TimerService::Run() {
+  absl::MutexLock lock(&mu_);
+  absl::Time next_tick = absl::Now() + tick_;
+  while (!stopping_) {
+    if (expired_.empty()) {
+      // Wake up at each tick, and catch up with the ticks which were missed.
+      cvar_.WaitWithDeadline(&mu_, next_tick);
+      const absl::Time now = absl::Now();
+      if (now < next_tick) {
+        continue;
+      }
+      next_tick = now + tick_;
+      std::vector<TimingWheel::Timer> expired;
+      wheel_.Advance(now, &expired);
+      for (TimingWheel::Timer& timer : expired) {
+        expired_.push_back(std::move(timer));
+      }
+      continue;
+    }
+
+    TimingWheel::Timer timer = std::move(expired_.front());
+    expired_.pop_front();
+    running_ = true;
+    running_id_ = timer.id;
+    mu_.Unlock();
+    timer.callback();
+    // Destroy the callback, and whatever it holds, outside of the mutex.
+    timer.callback = nullptr;
+    mu_.Lock();
+    running_ = false;
+    cvar_.SignalAll();
+  }
+}
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,98 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_TIMER_SERVICE_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_TIMER_SERVICE_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>  // NOLINT
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "common/timing_wheel.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+// TimerService runs callbacks once their deadline passes, on a thread of its
+// own, which advances a TimingWheel once per tick. Callbacks run one at a
+// time, at most a tick late (unless earlier callbacks run long), and should
+// be short; they may schedule and cancel timers.
+//
+// The destructor stops the thread: timers which have not expired by then
+// never run. Objects referred to by callbacks must therefore either outlive
+// the service, or cancel their timers before they are destroyed.
+//
+// This class is thread safe.
+class TimerService {
+ public:
+  using TimerId = TimingWheel::TimerId;
+
+  explicit TimerService(absl::Duration tick = absl::Seconds(1));
+  ~TimerService();
+
+  TimerService(const TimerService&) = delete;
+  TimerService& operator=(const TimerService&) = delete;
+
+  // Schedules `callback` to run once `deadline` has passed, and returns the
+  // id of the timer.
+  TimerId Schedule(absl::Time deadline, std::function<void()> callback)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Cancels the timer with the given id, so that its callback never runs.
+  // Returns false if the callback already ran (or the timer was cancelled).
+  // If the callback is running, waits for it to finish first, unless called
+  // from the callback itself.
+  bool Cancel(TimerId id) ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  // Body of the thread running the callbacks.
+  void Run() ABSL_LOCKS_EXCLUDED(mu_);
+
+  const absl::Duration tick_;
+
+  // Mutex to guard state below.
+  absl::Mutex mu_;
+
+  // The scheduled timers.
+  TimingWheel wheel_ ABSL_GUARDED_BY(mu_);
+
+  // Timers which expired, but whose callbacks have not run yet.
+  std::deque<TimingWheel::Timer> expired_ ABSL_GUARDED_BY(mu_);
+
+  // The timer whose callback is running, if any.
+  bool running_ ABSL_GUARDED_BY(mu_) = false;
+  TimerId running_id_ ABSL_GUARDED_BY(mu_) = 0;
+
+  // Set by the destructor to stop the thread.
+  bool stopping_ ABSL_GUARDED_BY(mu_) = false;
+
+  // Signalled when the destructor is called, and when a callback finishes.
+  absl::CondVar cvar_;
+
+  std::unique_ptr<std::thread> thread_;
+};
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_TIMER_SERVICE_H_
@@ -0,0 +1,107 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "common/timer_service.h"
+
+#include <atomic>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+namespace {
+
+constexpr absl::Duration kTick = absl::Milliseconds(1);
+
+TEST(TimerService, RunsCallbacksOnceTheirDeadlinePassed) {
+  TimerService timers(kTick);
+  absl::Notification done;
+  const absl::Time deadline = absl::Now() + absl::Milliseconds(20);
+  absl::Time run_time;
+  timers.Schedule(deadline, [&]() {
+    run_time = absl::Now();
+    done.Notify();
+  });
+  done.WaitForNotification();
+  EXPECT_GE(run_time, deadline);
+}
+
+TEST(TimerService, CancelledCallbacksNeverRun) {
+  std::atomic<int> runs(0);
+  absl::Notification done;
+  {
+    TimerService timers(kTick);
+    TimerService::TimerId id = timers.Schedule(
+        absl::Now() + absl::Milliseconds(10), [&]() { ++runs; });
+    timers.Schedule(absl::Now() + absl::Milliseconds(20),
+                    [&]() { done.Notify(); });
+    EXPECT_TRUE(timers.Cancel(id));
+    EXPECT_FALSE(timers.Cancel(id));
+    done.WaitForNotification();
+  }
+  EXPECT_EQ(runs, 0);
+}
+
+TEST(TimerService, CancelWaitsForRunningCallback) {
+  TimerService timers(kTick);
+  absl::Notification started;
+  std::atomic<bool> finished(false);
+  TimerService::TimerId id = timers.Schedule(absl::Now(), [&]() {
+    started.Notify();
+    absl::SleepFor(absl::Milliseconds(20));
+    finished = true;
+  });
+  started.WaitForNotification();
+  EXPECT_FALSE(timers.Cancel(id));
+  EXPECT_TRUE(finished);
+}
+
+TEST(TimerService, CallbacksCanScheduleTimers) {
+  TimerService timers(kTick);
+  absl::Notification done;
+  std::atomic<int> runs(0);
+  std::function<void()> callback = [&]() {
+    if (++runs == 3) {
+      done.Notify();
+    } else {
+      timers.Schedule(absl::Now(), callback);
+    }
+  };
+  timers.Schedule(absl::Now(), callback);
+  done.WaitForNotification();
+  EXPECT_EQ(runs, 3);
+}
+
+TEST(TimerService, DestructorDropsPendingTimers) {
+  std::atomic<int> runs(0);
+  {
+    TimerService timers(kTick);
+    timers.Schedule(absl::Now() + absl::Hours(1), [&]() { ++runs; });
+  }
+  EXPECT_EQ(runs, 0);
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,115 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "common/timing_wheel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+TimingWheel::TimingWheel(absl::Time start, absl::Duration tick)
+    : start_(start), tick_(tick) {}
+
+TimingWheel::TimerId TimingWheel::Schedule(absl::Time deadline,
+                                           std::function<void()> callback) {
+  absl::Duration remainder;
+  int64_t tick = absl::IDivDuration(deadline - start_, tick_, &remainder);
+  if (remainder > absl::ZeroDuration()) {
+    ++tick;
+  }
+  const TimerId id = next_id_++;
+  Slot pending;
+  pending.push_back(
+      {Timer{id, std::move(callback)}, std::max(tick, current_tick_ + 1)});
+  Place(&pending, pending.begin());
+  return id;
+}
+
+bool TimingWheel::Cancel(TimerId id) {
+  auto itr = locations_.find(id);
+  if (itr == locations_.end()) {
+    return false;
+  }
+  itr->second.slot->erase(itr->second.entry);
+  locations_.erase(itr);
+  return true;
+}
+
+void TimingWheel::Place(Slot* from, Slot::iterator entry) {
+  // Timers beyond the span of the wheels are placed as if they expired at its
+  // end, and placed again when their slot is reached.
+  const int64_t delta = entry->tick - current_tick_;
+  const int64_t tick =
+      delta < kMaxTicks ? entry->tick : current_tick_ + kMaxTicks - 1;
+  int level = 0;
+  while (level < kNumLevels - 1 &&
+         delta >= (int64_t{1} << (kBitsPerLevel * (level + 1)))) {
+    ++level;
+  }
+  Slot* slot = &levels_[level][(tick >> (kBitsPerLevel * level)) &
+                               (kSlotsPerLevel - 1)];
+  slot->splice(slot->end(), *from, entry);
+  locations_[entry->timer.id] = Location{slot, entry};
+}
+
+void TimingWheel::Advance(absl::Time now, std::vector<Timer>* expired) {
+  absl::Duration remainder;
+  const int64_t target_tick =
+      absl::IDivDuration(now - start_, tick_, &remainder);
+  if (locations_.empty()) {
+    current_tick_ = std::max(current_tick_, target_tick);
+    return;
+  }
+  while (current_tick_ < target_tick && !locations_.empty()) {
+    ++current_tick_;
+
+    // Move the timers of the slots of higher levels which start at this tick
+    // down to lower levels, including the slot of this tick, if they expire
+    // within their span.
+    for (int level = 1; level < kNumLevels; ++level) {
+      const int shift = kBitsPerLevel * level;
+      if ((current_tick_ & ((int64_t{1} << shift) - 1)) != 0) {
+        break;
+      }
+      Slot* slot = &levels_[level][(current_tick_ >> shift) &
+                                   (kSlotsPerLevel - 1)];
+      while (!slot->empty()) {
+        Place(slot, slot->begin());
+      }
+    }
+
+    Slot& slot = levels_[0][current_tick_ & (kSlotsPerLevel - 1)];
+    for (Entry& entry : slot) {
+      locations_.erase(entry.timer.id);
+      expired->push_back(std::move(entry.timer));
+    }
+    slot.clear();
+  }
+  current_tick_ = std::max(current_tick_, target_tick);
+}
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,126 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_TIMING_WHEEL_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_TIMING_WHEEL_H_
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+// TimingWheel holds timers which expire at a later time, with a resolution of
+// one tick, and returns them once they expire as it is advanced.
+//
+// Timers are kept in a hierarchical timing wheel: a wheel of kSlotsPerLevel
+// slots per level, where each slot of level L spans kSlotsPerLevel^L ticks.
+// A timer is placed in the slot of the lowest level which spans its expiry,
+// relative to the current tick. Whenever the ticks of a slot of a higher
+// level are reached, its timers are moved down to lower levels, each of them
+// at most once per level. Scheduling and cancelling a timer is therefore
+// O(1), and so is advancing by a tick, amortized over the timers, however
+// many timers there are. Timers further away than the wheels span are moved
+// down again once they are within reach.
+//
+// This class is not thread safe, see TimerService for a thread-safe version
+// which advances the wheel on a thread of its own.
+class TimingWheel {
+ public:
+  using TimerId = int64_t;
+
+  // An expired timer.
+  struct Timer {
+    TimerId id;
+    std::function<void()> callback;
+  };
+
+  // Ticks are counted from `start`, which is the current time of the wheel.
+  TimingWheel(absl::Time start, absl::Duration tick);
+
+  TimingWheel(const TimingWheel&) = delete;
+  TimingWheel& operator=(const TimingWheel&) = delete;
+
+  // Schedules `callback` to be returned by Advance once `deadline` has
+  // passed. Deadlines are rounded up to the next tick, and deadlines which
+  // already passed expire at the next tick. Returns the id of the timer.
+  TimerId Schedule(absl::Time deadline, std::function<void()> callback);
+
+  // Cancels the timer with the given id. Returns false if there is no such
+  // timer, because it already expired or was cancelled.
+  bool Cancel(TimerId id);
+
+  // Advances the wheel to `now`, and appends the timers which expired at or
+  // before it to `expired`, in the order of their expiry ticks.
+  void Advance(absl::Time now, std::vector<Timer>* expired);
+
+  // Returns the number of scheduled timers.
+  int64_t size() const { return locations_.size(); }
+
+ private:
+  static constexpr int kBitsPerLevel = 6;
+  static constexpr int kSlotsPerLevel = 1 << kBitsPerLevel;
+  static constexpr int kNumLevels = 4;
+
+  // Number of ticks spanned by the wheels.
+  static constexpr int64_t kMaxTicks = int64_t{1}
+                                       << (kBitsPerLevel * kNumLevels);
+
+  // A scheduled timer, along with its expiry tick.
+  struct Entry {
+    Timer timer;
+    int64_t tick;
+  };
+  using Slot = std::list<Entry>;
+
+  // Position of a scheduled timer.
+  struct Location {
+    Slot* slot;
+    Slot::iterator entry;
+  };
+
+  // Moves the entry at `entry` of `from` to the slot which spans its expiry
+  // relative to the current tick.
+  void Place(Slot* from, Slot::iterator entry);
+
+  // The time of tick 0, and the duration of a tick.
+  const absl::Time start_;
+  const absl::Duration tick_;
+
+  // The current tick: the timers which expire at or before it have expired.
+  int64_t current_tick_ = 0;
+
+  TimerId next_id_ = 0;
+
+  std::array<std::array<Slot, kSlotsPerLevel>, kNumLevels> levels_;
+
+  // The position of each scheduled timer, by its id.
+  absl::flat_hash_map<TimerId, Location> locations_;
+};
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_TIMING_WHEEL_H_
@@ -0,0 +1,141 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "common/timing_wheel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace {
+
+using TimerId = TimingWheel::TimerId;
+
+class TimingWheelTest : public testing::Test {
+ protected:
+  // Advances the wheel to `now` and returns the ids of the expired timers.
+  std::vector<TimerId> Advance(absl::Time now) {
+    std::vector<TimingWheel::Timer> expired;
+    wheel_.Advance(now, &expired);
+    std::vector<TimerId> ids;
+    for (TimingWheel::Timer& timer : expired) {
+      timer.callback();
+      ids.push_back(timer.id);
+    }
+    return ids;
+  }
+
+  const absl::Time start_ = absl::FromUnixSeconds(1000);
+  TimingWheel wheel_ = TimingWheel(start_, absl::Seconds(1));
+};
+
+TEST_F(TimingWheelTest, ExpiresTimersAtTheirDeadline) {
+  int runs = 0;
+  TimerId id = wheel_.Schedule(start_ + absl::Seconds(5), [&]() { ++runs; });
+  EXPECT_EQ(wheel_.size(), 1);
+
+  EXPECT_THAT(Advance(start_ + absl::Seconds(4)), testing::IsEmpty());
+  EXPECT_THAT(Advance(start_ + absl::Seconds(5)), testing::ElementsAre(id));
+  EXPECT_EQ(runs, 1);
+  EXPECT_EQ(wheel_.size(), 0);
+  EXPECT_THAT(Advance(start_ + absl::Seconds(60)), testing::IsEmpty());
+}
+
+TEST_F(TimingWheelTest, RoundsDeadlinesUpToTheNextTick) {
+  TimerId id = wheel_.Schedule(start_ + absl::Milliseconds(1500), []() {});
+  TimerId past = wheel_.Schedule(start_ - absl::Seconds(10), []() {});
+
+  EXPECT_THAT(Advance(start_ + absl::Seconds(1)), testing::ElementsAre(past));
+  EXPECT_THAT(Advance(start_ + absl::Milliseconds(1999)), testing::IsEmpty());
+  EXPECT_THAT(Advance(start_ + absl::Seconds(2)), testing::ElementsAre(id));
+}
+
+TEST_F(TimingWheelTest, CancelsTimers) {
+  TimerId cancelled = wheel_.Schedule(start_ + absl::Hours(2), []() {});
+  TimerId kept = wheel_.Schedule(start_ + absl::Hours(2), []() {});
+  EXPECT_TRUE(wheel_.Cancel(cancelled));
+  EXPECT_FALSE(wheel_.Cancel(cancelled));
+  EXPECT_EQ(wheel_.size(), 1);
+
+  EXPECT_THAT(Advance(start_ + absl::Hours(3)), testing::ElementsAre(kept));
+  EXPECT_FALSE(wheel_.Cancel(kept));
+}
+
+TEST_F(TimingWheelTest, ExpiresTimersBeyondTheSpanOfTheWheels) {
+  // The wheels span 2^24 ticks.
+  const absl::Time deadline = start_ + absl::Seconds((int64_t{1} << 24) + 10);
+  TimerId id = wheel_.Schedule(deadline, []() {});
+
+  EXPECT_THAT(Advance(deadline - absl::Seconds(1)), testing::IsEmpty());
+  EXPECT_THAT(Advance(deadline), testing::ElementsAre(id));
+}
+
+TEST_F(TimingWheelTest, ExpiresTimersInDeadlineOrder) {
+  std::mt19937 random(17);
+  absl::flat_hash_map<TimerId, absl::Time> deadlines;
+  absl::flat_hash_set<TimerId> cancelled;
+  absl::Time now = start_;
+  std::vector<TimerId> expired;
+  for (int step = 0; step < 2000; ++step) {
+    // Spread deadlines over all levels of the wheels.
+    const int64_t ticks = random() % (int64_t{1} << (6 * (1 + step % 3)));
+    const absl::Time deadline = now + absl::Seconds(ticks);
+    TimerId id = wheel_.Schedule(deadline, []() {});
+    deadlines[id] = std::max(deadline, now + absl::Seconds(1));
+    if (random() % 4 == 0) {
+      EXPECT_TRUE(wheel_.Cancel(id));
+      cancelled.insert(id);
+    }
+    now += absl::Seconds(random() % 64);
+    for (TimerId expired_id : Advance(now)) {
+      // Timers expire once their deadline passed, and not before.
+      EXPECT_LE(deadlines[expired_id], now);
+      EXPECT_GT(deadlines[expired_id], now - absl::Seconds(64));
+      expired.push_back(expired_id);
+    }
+  }
+  for (TimerId expired_id : Advance(now + absl::Hours(24 * 365))) {
+    expired.push_back(expired_id);
+  }
+
+  // Timers which were not cancelled all expire once, in deadline order.
+  EXPECT_EQ(expired.size() + cancelled.size(), deadlines.size());
+  for (int i = 0; i < expired.size(); ++i) {
+    EXPECT_FALSE(cancelled.contains(expired[i]));
+    if (i > 0) {
+      EXPECT_LE(deadlines[expired[i - 1]], deadlines[expired[i]]);
+    }
+  }
+  EXPECT_EQ(absl::flat_hash_set<TimerId>(expired.begin(), expired.end()).size(),
+            expired.size());
+  EXPECT_EQ(wheel_.size(), 0);
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
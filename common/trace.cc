@@ -0,0 +1,274 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "common/trace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/random/distributions.h"
+#include "absl/random/random.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace trace {
+
+namespace internal {
+
+std::atomic<bool> enabled{false};
+
+thread_local ThreadState current;
+
+}  // namespace internal
+
+namespace {
+
+// Number of completed traces kept for inspection.
+constexpr int kMaxRecentTraces = 256;
+
+// Fraction of requests which are traced.
+std::atomic<double> sampling_rate{0};
+
+// Returns the random generator of the current thread.
+absl::InsecureBitGen& RandomGenerator() {
+  thread_local absl::InsecureBitGen generator;
+  return generator;
+}
+
+// Returns a random, nonzero span identifier.
+uint64_t NewSpanId() {
+  return absl::Uniform<uint64_t>(absl::IntervalClosed, RandomGenerator(), 1,
+                                 UINT64_MAX);
+}
+
+// Returns a random trace identifier.
+std::string NewTraceId() {
+  return absl::StrCat(absl::Hex(NewSpanId(), absl::kZeroPad16),
+                      absl::Hex(NewSpanId(), absl::kZeroPad16));
+}
+
+// Returns true if `id` consists of `length` hexadecimal digits, not all zero.
+bool IsHexId(absl::string_view id, size_t length) {
+  return id.size() == length &&
+         std::all_of(id.begin(), id.end(), absl::ascii_isxdigit) &&
+         id.find_first_not_of('0') != absl::string_view::npos;
+}
+
+// The traces completed most recently.
+class RecentTraceBuffer {
+ public:
+  static RecentTraceBuffer* Get() {
+    static RecentTraceBuffer* buffer = new RecentTraceBuffer();
+    return buffer;
+  }
+
+  void Add(std::shared_ptr<const Trace> trace) ABSL_LOCKS_EXCLUDED(mu_) {
+    absl::MutexLock lock(&mu_);
+    traces_.push_back(std::move(trace));
+    if (traces_.size() > kMaxRecentTraces) {
+      traces_.pop_front();
+    }
+  }
+
+  std::vector<std::shared_ptr<const Trace>> traces() const
+      ABSL_LOCKS_EXCLUDED(mu_) {
+    absl::MutexLock lock(&mu_);
+    return {traces_.begin(), traces_.end()};
+  }
+
+ private:
+  mutable absl::Mutex mu_;
+  std::deque<std::shared_ptr<const Trace>> traces_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace
+
+bool ParseTraceParent(absl::string_view header, TraceContext* context) {
+  std::vector<absl::string_view> parts =
+      absl::StrSplit(absl::StripAsciiWhitespace(header), '-');
+  uint64_t parent_span_id;
+  uint32_t flags;
+  if (parts.size() < 4 || parts[0].size() != 2 || parts[0] == "ff" ||
+      !IsHexId(parts[1], 32) || !IsHexId(parts[2], 16) ||
+      parts[3].size() != 2 ||
+      !absl::SimpleHexAtoi(parts[2], &parent_span_id) ||
+      !absl::SimpleHexAtoi(parts[3], &flags)) {
+    return false;
+  }
+  context->trace_id = absl::AsciiStrToLower(parts[1]);
+  context->parent_span_id = parent_span_id;
+  context->sampled = (flags & 1) != 0;
+  return true;
+}
+
+bool ParseCloudTraceContext(absl::string_view header, TraceContext* context) {
+  header = absl::StripAsciiWhitespace(header);
+  absl::string_view options;
+  size_t semicolon = header.find(';');
+  if (semicolon != absl::string_view::npos) {
+    options = header.substr(semicolon + 1);
+    header = header.substr(0, semicolon);
+  }
+  std::pair<absl::string_view, absl::string_view> ids =
+      absl::StrSplit(header, absl::MaxSplits('/', 1));
+  uint64_t parent_span_id = 0;
+  if (!IsHexId(ids.first, 32) ||
+      (!ids.second.empty() && !absl::SimpleAtoi(ids.second, &parent_span_id))) {
+    return false;
+  }
+  context->trace_id = absl::AsciiStrToLower(ids.first);
+  context->parent_span_id = parent_span_id;
+  context->sampled = options == "o=1";
+  return true;
+}
+
+void Trace::AddSpan(Span span) {
+  absl::MutexLock lock(&mu_);
+  spans_.push_back(std::move(span));
+}
+
+std::vector<Span> Trace::spans() const {
+  std::vector<Span> spans;
+  {
+    absl::MutexLock lock(&mu_);
+    spans = spans_;
+  }
+  std::stable_sort(spans.begin(), spans.end(),
+                   [](const Span& a, const Span& b) { return a.start < b.start; });
+  return spans;
+}
+
+void SetSamplingRate(double rate) {
+  rate = std::min(std::max(rate, 0.0), 1.0);
+  sampling_rate.store(rate, std::memory_order_relaxed);
+  internal::enabled.store(rate > 0, std::memory_order_relaxed);
+}
+
+ScopedTrace::ScopedTrace(absl::string_view name, const TraceContext& context) {
+  // Requests served within a traced request join its trace.
+  if (!Enabled() || Active()) {
+    return;
+  }
+  if (!context.sampled &&
+      !absl::Bernoulli(RandomGenerator(),
+                       sampling_rate.load(std::memory_order_relaxed))) {
+    return;
+  }
+  trace_ = absl::make_unique<Trace>(
+      context.trace_id.empty() ? NewTraceId() : context.trace_id,
+      std::string(name), NewSpanId());
+  parent_span_id_ = context.parent_span_id;
+  previous_ = internal::current;
+  internal::current = {trace_.get(), trace_->root_span_id()};
+  start_ = absl::Now();
+}
+
+ScopedTrace::~ScopedTrace() {
+  if (trace_ == nullptr) {
+    return;
+  }
+  Span root;
+  root.name = trace_->name();
+  root.span_id = trace_->root_span_id();
+  root.parent_span_id = parent_span_id_;
+  root.start = start_;
+  root.duration = absl::Now() - start_;
+  trace_->AddSpan(std::move(root));
+  internal::current = previous_;
+  RecentTraceBuffer::Get()->Add(std::move(trace_));
+}
+
+void ScopedSpan::Start(absl::string_view name) {
+  trace_ = internal::current.trace;
+  span_.name = std::string(name);
+  span_.span_id = NewSpanId();
+  span_.parent_span_id = internal::current.span_id;
+  internal::current.span_id = span_.span_id;
+  span_.start = absl::Now();
+}
+
+void ScopedSpan::End() {
+  span_.duration = absl::Now() - span_.start;
+  internal::current.span_id = span_.parent_span_id;
+  trace_->AddSpan(std::move(span_));
+}
+
+void RecordSpan(absl::string_view name, absl::Time start,
+                absl::Duration duration) {
+  if (!Active()) {
+    return;
+  }
+  Span span;
+  span.name = std::string(name);
+  span.span_id = NewSpanId();
+  span.parent_span_id = internal::current.span_id;
+  span.start = start;
+  span.duration = duration;
+  internal::current.trace->AddSpan(std::move(span));
+}
+
+std::vector<std::shared_ptr<const Trace>> RecentTraces() {
+  return RecentTraceBuffer::Get()->traces();
+}
+
+std::string ExportText() {
+  std::string text;
+  for (const std::shared_ptr<const Trace>& trace : RecentTraces()) {
+    std::vector<Span> spans = trace->spans();
+    absl::flat_hash_map<uint64_t, uint64_t> parents;
+    absl::Time start = absl::InfiniteFuture();
+    for (const Span& span : spans) {
+      parents[span.span_id] = span.parent_span_id;
+      start = std::min(start, span.start);
+    }
+    absl::StrAppend(&text, "trace ", trace->trace_id(), " ", trace->name(),
+                    "\n");
+    for (const Span& span : spans) {
+      int depth = 1;
+      for (auto it = parents.find(span.parent_span_id); it != parents.end();
+           it = parents.find(it->second)) {
+        ++depth;
+      }
+      absl::StrAppend(&text, std::string(2 * depth, ' '), span.name, " +",
+                      absl::FormatDuration(span.start - start), " ",
+                      absl::FormatDuration(span.duration), "\n");
+    }
+  }
+  return text;
+}
+
+}  // namespace trace
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
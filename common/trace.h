@@ -0,0 +1,210 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_TRACE_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_TRACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace trace {
+
+// Traces break the latency of individual requests down into spans, one for
+// each stage of request processing, so that slow requests can be attributed to
+// a stage instead of only showing up in the aggregate stage histograms.
+//
+// A request handler starts a trace on its thread, and the stages it runs open
+// nested spans on the same thread:
+//
+//   trace::ScopedTrace trace("Spanner.ExecuteSql", client_context);
+//   ...
+//   trace::ScopedSpan span("Analyze");
+//
+// Requests are sampled: a trace is only recorded for a fraction of them, and
+// for those whose client propagated a sampled trace context. Spans of requests
+// which are not sampled return after a thread-local load. Completed traces are
+// kept in a bounded buffer of recent traces for inspection.
+
+// Context of a trace propagated by a client, which recorded traces join.
+struct TraceContext {
+  // 32 lowercase hexadecimal digits, or empty if the client did not propagate
+  // a trace.
+  std::string trace_id;
+
+  // Identifier of the client span which issued the request.
+  uint64_t parent_span_id = 0;
+
+  // True if the client sampled the trace.
+  bool sampled = false;
+};
+
+// Parses a W3C trace context "traceparent" header, e.g.
+// "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01". Returns false if
+// the header is malformed.
+bool ParseTraceParent(absl::string_view header, TraceContext* context);
+
+// Parses a Google Cloud "x-cloud-trace-context" header, e.g.
+// "105445aa7843bc8bf206b12000100000/1;o=1". Returns false if the header is
+// malformed.
+bool ParseCloudTraceContext(absl::string_view header, TraceContext* context);
+
+// A completed span.
+struct Span {
+  std::string name;
+  uint64_t span_id = 0;
+
+  // Identifier of the enclosing span, or of the client span for the root span
+  // of a trace.
+  uint64_t parent_span_id = 0;
+
+  absl::Time start;
+  absl::Duration duration;
+};
+
+// A trace of a single request, which collects its spans as they complete.
+//
+// This class is thread safe.
+class Trace {
+ public:
+  Trace(std::string trace_id, std::string name, uint64_t root_span_id)
+      : trace_id_(std::move(trace_id)),
+        name_(std::move(name)),
+        root_span_id_(root_span_id) {}
+
+  const std::string& trace_id() const { return trace_id_; }
+  const std::string& name() const { return name_; }
+  uint64_t root_span_id() const { return root_span_id_; }
+
+  // Adds a completed span to the trace.
+  void AddSpan(Span span) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the completed spans of the trace in the order they started.
+  std::vector<Span> spans() const ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  const std::string trace_id_;
+  const std::string name_;
+  const uint64_t root_span_id_;
+
+  mutable absl::Mutex mu_;
+  std::vector<Span> spans_ ABSL_GUARDED_BY(mu_);
+};
+
+namespace internal {
+
+// True if a nonzero sampling rate was set.
+extern std::atomic<bool> enabled;
+
+// The trace and the innermost open span of the current thread, if the request
+// it serves is being traced.
+struct ThreadState {
+  Trace* trace = nullptr;
+  uint64_t span_id = 0;
+};
+extern thread_local ThreadState current;
+
+}  // namespace internal
+
+// Sets the fraction of requests which are traced, between 0 and 1. Requests
+// whose client sampled its trace are traced as well unless the rate is 0,
+// which disables tracing.
+void SetSamplingRate(double rate);
+
+// Returns true if requests may be traced.
+inline bool Enabled() {
+  return internal::enabled.load(std::memory_order_relaxed);
+}
+
+// Returns true if the request served by the current thread is being traced.
+inline bool Active() { return internal::current.trace != nullptr; }
+
+// Traces the request served by the current thread from its construction to its
+// destruction, if the request is sampled. The completed trace is added to the
+// recent traces.
+class ScopedTrace {
+ public:
+  ScopedTrace(absl::string_view name, const TraceContext& context);
+  ~ScopedTrace();
+
+  ScopedTrace(const ScopedTrace&) = delete;
+  ScopedTrace& operator=(const ScopedTrace&) = delete;
+
+ private:
+  std::unique_ptr<Trace> trace_;
+  uint64_t parent_span_id_ = 0;
+  absl::Time start_;
+  internal::ThreadState previous_;
+};
+
+// Records a span from its construction to its destruction, nested within the
+// innermost open span of the current thread, if its request is being traced.
+class ScopedSpan {
+ public:
+  explicit ScopedSpan(absl::string_view name) {
+    if (Active()) {
+      Start(name);
+    }
+  }
+
+  ~ScopedSpan() {
+    if (trace_ != nullptr) {
+      End();
+    }
+  }
+
+  ScopedSpan(const ScopedSpan&) = delete;
+  ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+ private:
+  void Start(absl::string_view name);
+  void End();
+
+  Trace* trace_ = nullptr;
+  Span span_;
+};
+
+// Records a span of `duration` starting at `start` within the innermost open
+// span of the current thread, if its request is being traced. This is used for
+// stages which run in many short intervals interleaved with others, such as the
+// evaluation of streamed rows, and are reported as their total time.
+void RecordSpan(absl::string_view name, absl::Time start,
+                absl::Duration duration);
+
+// Returns the traces completed most recently, oldest first.
+std::vector<std::shared_ptr<const Trace>> RecentTraces();
+
+// Returns the recent traces in a human readable text format, each listing its
+// spans indented by their nesting depth.
+std::string ExportText();
+
+}  // namespace trace
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_TRACE_H_
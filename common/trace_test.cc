@@ -0,0 +1,162 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "common/trace.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace trace {
+
+namespace {
+
+using testing::ElementsAre;
+using testing::Field;
+using testing::HasSubstr;
+
+class TraceTest : public testing::Test {
+ protected:
+  ~TraceTest() override { SetSamplingRate(0); }
+
+  // Returns the most recently completed trace.
+  std::shared_ptr<const Trace> LastTrace() {
+    std::vector<std::shared_ptr<const Trace>> traces = RecentTraces();
+    return traces.empty() ? nullptr : traces.back();
+  }
+};
+
+TEST_F(TraceTest, ParsesTraceParent) {
+  TraceContext context;
+  ASSERT_TRUE(ParseTraceParent(
+      "00-4BF92F3577B34DA6A3CE929D0E0E4736-00f067aa0ba902b7-01", &context));
+  EXPECT_EQ(context.trace_id, "4bf92f3577b34da6a3ce929d0e0e4736");
+  EXPECT_EQ(context.parent_span_id, 0x00f067aa0ba902b7);
+  EXPECT_TRUE(context.sampled);
+
+  ASSERT_TRUE(ParseTraceParent(
+      "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-00", &context));
+  EXPECT_FALSE(context.sampled);
+
+  EXPECT_FALSE(ParseTraceParent(
+      "00-00000000000000000000000000000000-00f067aa0ba902b7-01", &context));
+  EXPECT_FALSE(ParseTraceParent("00-4bf92f3577b34da6a3ce929d0e0e4736-01",
+                                &context));
+}
+
+TEST_F(TraceTest, ParsesCloudTraceContext) {
+  TraceContext context;
+  ASSERT_TRUE(ParseCloudTraceContext("105445aa7843bc8bf206b12000100000/12;o=1",
+                                     &context));
+  EXPECT_EQ(context.trace_id, "105445aa7843bc8bf206b12000100000");
+  EXPECT_EQ(context.parent_span_id, 12);
+  EXPECT_TRUE(context.sampled);
+
+  ASSERT_TRUE(
+      ParseCloudTraceContext("105445aa7843bc8bf206b12000100000", &context));
+  EXPECT_EQ(context.parent_span_id, 0);
+  EXPECT_FALSE(context.sampled);
+
+  EXPECT_FALSE(ParseCloudTraceContext("xyz/1;o=1", &context));
+}
+
+TEST_F(TraceTest, DoesNotTraceWhenDisabled) {
+  std::shared_ptr<const Trace> last = LastTrace();
+  TraceContext context;
+  context.sampled = true;
+  {
+    ScopedTrace trace("Request", context);
+    EXPECT_FALSE(Active());
+    ScopedSpan span("Stage");
+  }
+  EXPECT_EQ(LastTrace(), last);
+}
+
+TEST_F(TraceTest, RecordsNestedSpans) {
+  SetSamplingRate(1);
+  TraceContext context;
+  context.trace_id = "4bf92f3577b34da6a3ce929d0e0e4736";
+  context.parent_span_id = 7;
+  {
+    ScopedTrace trace("Request", context);
+    ASSERT_TRUE(Active());
+    {
+      ScopedSpan outer("Outer");
+      ScopedSpan inner("Inner");
+    }
+    RecordSpan("Total", absl::Now(), absl::Milliseconds(1));
+  }
+  EXPECT_FALSE(Active());
+
+  std::shared_ptr<const Trace> trace = LastTrace();
+  ASSERT_NE(trace, nullptr);
+  EXPECT_EQ(trace->trace_id(), "4bf92f3577b34da6a3ce929d0e0e4736");
+  std::vector<Span> spans = trace->spans();
+  ASSERT_THAT(spans, ElementsAre(Field(&Span::name, "Request"),
+                                 Field(&Span::name, "Outer"),
+                                 Field(&Span::name, "Inner"),
+                                 Field(&Span::name, "Total")));
+  EXPECT_EQ(spans[0].parent_span_id, 7);
+  EXPECT_EQ(spans[1].parent_span_id, spans[0].span_id);
+  EXPECT_EQ(spans[2].parent_span_id, spans[1].span_id);
+  EXPECT_EQ(spans[3].parent_span_id, spans[0].span_id);
+  EXPECT_EQ(spans[3].duration, absl::Milliseconds(1));
+
+  EXPECT_THAT(ExportText(),
+              HasSubstr("trace 4bf92f3577b34da6a3ce929d0e0e4736 Request\n"
+                        "  Request +0 "));
+  EXPECT_THAT(ExportText(), HasSubstr("\n      Inner +"));
+}
+
+TEST_F(TraceTest, SamplesRequestsWithoutClientContext) {
+  SetSamplingRate(1);
+  { ScopedTrace trace("Sampled", TraceContext()); }
+  std::shared_ptr<const Trace> trace = LastTrace();
+  ASSERT_NE(trace, nullptr);
+  EXPECT_EQ(trace->name(), "Sampled");
+  EXPECT_EQ(trace->trace_id().size(), 32);
+
+  SetSamplingRate(1e-300);
+  { ScopedTrace trace("NotSampled", TraceContext()); }
+  EXPECT_EQ(LastTrace(), trace);
+}
+
+TEST_F(TraceTest, NestedRequestsJoinTheOuterTrace) {
+  SetSamplingRate(1);
+  {
+    ScopedTrace outer("Outer", TraceContext());
+    ScopedTrace inner("Inner", TraceContext());
+    ScopedSpan span("Stage");
+  }
+  std::shared_ptr<const Trace> trace = LastTrace();
+  ASSERT_NE(trace, nullptr);
+  EXPECT_EQ(trace->name(), "Outer");
+  EXPECT_EQ(trace->spans().size(), 2);
+}
+
+}  // namespace
+
+}  // namespace trace
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
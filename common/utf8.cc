@@ -0,0 +1,127 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "common/utf8.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include "absl/strings/string_view.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+namespace {
+
+// Mask of the high bit of each byte of a word.
+constexpr uint64_t kHighBits = 0x8080808080808080ULL;
+
+// Returns true if `byte` is a continuation byte (0b10xxxxxx).
+inline bool IsContinuation(uint8_t byte) { return (byte & 0xc0) == 0x80; }
+
+// Returns the length of the character starting at `in`, which is not ASCII,
+// of which `remaining` bytes are available, or 0 if the bytes do not encode a
+// valid character.
+//
+// Char. number range  |        UTF-8 octet sequence
+//    (hexadecimal)    |              (binary)
+// --------------------+---------------------------------------------
+// 0000 0080-0000 07FF | 110xxxxx 10xxxxxx
+// 0000 0800-0000 FFFF | 1110xxxx 10xxxxxx 10xxxxxx
+// 0001 0000-0010 FFFF | 11110xxx 10xxxxxx 10xxxxxx 10xxxxxx
+//
+// The ranges of the second byte exclude overlong encodings, surrogates
+// (U+D800-U+DFFF) and code points past U+10FFFF, as in RFC 3629 section 4.
+int DecodeMultiByte(const uint8_t* in, size_t remaining) {
+  const uint8_t lead = in[0];
+  if (lead >= 0xc2 && lead <= 0xdf) {
+    return remaining >= 2 && IsContinuation(in[1]) ? 2 : 0;
+  }
+  if (lead >= 0xe0 && lead <= 0xef) {
+    if (remaining < 3) return 0;
+    const uint8_t low = lead == 0xe0 ? 0xa0 : 0x80;
+    const uint8_t high = lead == 0xed ? 0x9f : 0xbf;
+    return in[1] >= low && in[1] <= high && IsContinuation(in[2]) ? 3 : 0;
+  }
+  if (lead >= 0xf0 && lead <= 0xf4) {
+    if (remaining < 4) return 0;
+    const uint8_t low = lead == 0xf0 ? 0x90 : 0x80;
+    const uint8_t high = lead == 0xf4 ? 0x8f : 0xbf;
+    return in[1] >= low && in[1] <= high && IsContinuation(in[2]) &&
+                   IsContinuation(in[3])
+               ? 4
+               : 0;
+  }
+  return 0;
+}
+
+}  // namespace
+
+bool Utf8Length(absl::string_view str, int64_t* length) {
+  const uint8_t* in = reinterpret_cast<const uint8_t*>(str.data());
+  const uint8_t* end = in + str.size();
+  int64_t chars = 0;
+  while (in < end) {
+    // Skip whole words of ASCII.
+    while (end - in >= 8) {
+      uint64_t word;
+      std::memcpy(&word, in, sizeof(word));
+      if ((word & kHighBits) != 0) break;
+      in += 8;
+      chars += 8;
+    }
+    if (in == end) break;
+    if (*in < 0x80) {
+      ++in;
+    } else {
+      const int size = DecodeMultiByte(in, end - in);
+      if (size == 0) {
+        return false;
+      }
+      in += size;
+    }
+    ++chars;
+  }
+  *length = chars;
+  return true;
+}
+
+int64_t Utf8PrefixLength(absl::string_view str, int64_t size) {
+  if (size <= 0 || static_cast<uint8_t>(str[size - 1]) < 0x80) {
+    return size;
+  }
+  // Find the lead byte of the last character, and drop it if the character
+  // does not fit in the prefix.
+  for (int64_t pos = size - 1; pos >= 0 && pos >= size - 4; --pos) {
+    const uint8_t byte = static_cast<uint8_t>(str[pos]);
+    if (IsContinuation(byte)) continue;
+    int64_t char_size = 1;
+    if (byte >= 0xf0) {
+      char_size = 4;
+    } else if (byte >= 0xe0) {
+      char_size = 3;
+    } else if (byte >= 0xc0) {
+      char_size = 2;
+    }
+    return pos + char_size > size ? pos : size;
+  }
+  return size;
+}
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,47 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_UTF8_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_UTF8_H_
+
+#include <cstdint>
+
+#include "absl/strings/string_view.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+// Counts the characters of `str` into `length`, checking that it is valid
+// UTF-8 as Cloud Spanner requires of STRING values: no overlong encodings,
+// surrogates or code points past U+10FFFF. Returns false if it is not.
+//
+// Runs of ASCII are consumed a word at a time, since most text in STRING
+// columns is ASCII, so large values are checked in a fraction of the time a
+// byte at a time decoder takes.
+bool Utf8Length(absl::string_view str, int64_t* length);
+
+// Returns the length of the longest prefix of `str` which is at most `size`
+// bytes and does not end with an incomplete multi-byte character. `str` is
+// expected to be valid UTF-8; at most the last four bytes of the prefix are
+// inspected.
+int64_t Utf8PrefixLength(absl::string_view str, int64_t size);
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_COMMON_UTF8_H_
@@ -0,0 +1,81 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "common/utf8.h"
+
+#include <cstdint>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+
+namespace {
+
+int64_t LengthOrMinusOne(const std::string& str) {
+  int64_t length = 0;
+  return Utf8Length(str, &length) ? length : -1;
+}
+
+TEST(Utf8Length, CountsCharacters) {
+  EXPECT_EQ(LengthOrMinusOne(""), 0);
+  EXPECT_EQ(LengthOrMinusOne("abc"), 3);
+  EXPECT_EQ(LengthOrMinusOne("0123456789abcdefghij"), 20);
+  // 2, 3 and 4 byte characters at the boundaries of their ranges.
+  EXPECT_EQ(LengthOrMinusOne("\xc2\x80\xdf\xbf"), 2);
+  EXPECT_EQ(LengthOrMinusOne("\xe0\xa0\x80\xed\x9f\xbf\xef\xbf\xbf"), 3);
+  EXPECT_EQ(LengthOrMinusOne("\xf0\x90\x80\x80\xf4\x8f\xbf\xbf"), 2);
+  // Characters between and after runs of ASCII.
+  EXPECT_EQ(LengthOrMinusOne("abcdefgh\xc3\xa9ijklmnop\xe2\x82\xac q"), 20);
+}
+
+TEST(Utf8Length, RejectsInvalidEncodings) {
+  // Stray continuation bytes, and bytes which never appear in UTF-8.
+  EXPECT_EQ(LengthOrMinusOne("abc\x80"), -1);
+  EXPECT_EQ(LengthOrMinusOne("\xff"), -1);
+  // Overlong encodings.
+  EXPECT_EQ(LengthOrMinusOne("\xc0\x80"), -1);
+  EXPECT_EQ(LengthOrMinusOne("\xe0\x9f\xbf"), -1);
+  EXPECT_EQ(LengthOrMinusOne("\xf0\x8f\xbf\xbf"), -1);
+  // Surrogates.
+  EXPECT_EQ(LengthOrMinusOne("\xed\xa0\x80"), -1);
+  // Past U+10FFFF.
+  EXPECT_EQ(LengthOrMinusOne("\xf4\x90\x80\x80"), -1);
+  // Truncated characters, including after a run of ASCII.
+  EXPECT_EQ(LengthOrMinusOne("\xe2\x82"), -1);
+  EXPECT_EQ(LengthOrMinusOne("abcdefghijklmnop\xf0\x90\x80"), -1);
+}
+
+TEST(Utf8PrefixLength, DropsIncompleteLastCharacter) {
+  const std::string str = "a\xc3\xa9\xe2\x82\xac\xf0\x90\x80\x80";
+  EXPECT_EQ(Utf8PrefixLength(str, 0), 0);
+  EXPECT_EQ(Utf8PrefixLength(str, 1), 1);
+  EXPECT_EQ(Utf8PrefixLength(str, 2), 1);
+  EXPECT_EQ(Utf8PrefixLength(str, 3), 3);
+  EXPECT_EQ(Utf8PrefixLength(str, 4), 3);
+  EXPECT_EQ(Utf8PrefixLength(str, 5), 3);
+  EXPECT_EQ(Utf8PrefixLength(str, 6), 6);
+  EXPECT_EQ(Utf8PrefixLength(str, 9), 6);
+  EXPECT_EQ(Utf8PrefixLength(str, 10), 10);
+}
+
+}  // namespace
+
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
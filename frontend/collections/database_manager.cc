@@ -16,19 +16,25 @@
 
 #include "frontend/collections/database_manager.h"
 
-#include <map>
+#include <algorithm>
+#include <functional>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
+#include "absl/hash/hash.h"
 #include "zetasql/base/statusor.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
 #include "backend/database/database.h"
 #include "common/clock.h"
+#include "common/config.h"
 #include "common/errors.h"
 #include "common/limits.h"
+#include "common/metrics.h"
 #include "frontend/common/uris.h"
 #include "zetasql/base/status_macros.h"
 
@@ -37,25 +43,64 @@ namespace spanner {
 namespace emulator {
 namespace frontend {
 
-namespace {
+DatabaseManager::DatabaseManager(Clock* clock)
+    : DatabaseManager(clock, config::database_creation_threads()) {}
 
-std::vector<std::shared_ptr<Database>> GetDatabasesByInstance(
-    const std::map<std::string, std::shared_ptr<Database>>& database_map,
-    const std::string& instance_uri) {
-  std::string database_uri_prefix = absl::StrCat(instance_uri, "/");
+DatabaseManager::DatabaseManager(Clock* clock, int num_creation_threads)
+    : clock_(clock),
+      table_bytes_gauge_(metrics::RegisterGauge(
+          "spanner_emulator_table_bytes",
+          "Approximate bytes of memory held by the rows of each table and "
+          "index, including their older versions.",
+          [this] { return CollectTableBytes(); })),
+      transaction_bytes_gauge_(metrics::RegisterGauge(
+          "spanner_emulator_transaction_buffer_bytes",
+          "Approximate bytes of memory held by the mutations buffered in "
+          "read-write transactions of each database.",
+          [this] { return CollectTransactionBytes(); })),
+      creation_pool_(std::max(num_creation_threads, 1)) {}
+
+DatabaseManager::DatabaseShard& DatabaseManager::ShardOf(
+    const std::string& database_uri) const {
+  return shards_[absl::Hash<std::string>()(database_uri) % kNumDatabaseShards];
+}
+
+std::vector<std::shared_ptr<Database>> DatabaseManager::AllDatabases() const {
   std::vector<std::shared_ptr<Database>> databases;
-  auto itr = database_map.upper_bound(database_uri_prefix);
-  while (itr != database_map.end()) {
-    if (!absl::StartsWith(itr->first, database_uri_prefix)) {
-      break;
+  for (const DatabaseShard& shard : shards_) {
+    absl::ReaderMutexLock lock(&shard.mu);
+    for (const auto& [database_uri, database] : shard.databases) {
+      databases.push_back(database);
     }
-    databases.push_back(itr->second);
-    ++itr;
   }
   return databases;
 }
 
-}  // namespace
+std::vector<metrics::GaugeSample> DatabaseManager::CollectTableBytes() const {
+  std::vector<metrics::GaugeSample> samples;
+  for (const std::shared_ptr<Database>& database : AllDatabases()) {
+    backend::Database::MemoryUsage usage =
+        database->backend()->GetMemoryUsage();
+    for (const auto& [table_name, bytes] : usage.table_bytes) {
+      samples.push_back(metrics::GaugeSample{
+          .labels = {{"database", database->database_uri()},
+                     {"table", table_name}},
+          .value = bytes});
+    }
+  }
+  return samples;
+}
+
+std::vector<metrics::GaugeSample> DatabaseManager::CollectTransactionBytes()
+    const {
+  std::vector<metrics::GaugeSample> samples;
+  for (const std::shared_ptr<Database>& database : AllDatabases()) {
+    samples.push_back(metrics::GaugeSample{
+        .labels = {{"database", database->database_uri()}},
+        .value = database->backend()->GetMemoryUsage().transaction_bytes});
+  }
+  return samples;
+}
 
 zetasql_base::StatusOr<std::shared_ptr<Database>> DatabaseManager::CreateDatabase(
     const std::string& database_uri,
@@ -70,47 +115,149 @@ zetasql_base::StatusOr<std::shared_ptr<Database>> DatabaseManager::CreateDatabas
   std::string instance_uri = MakeInstanceUri(project_id, instance_id);
 
   ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<backend::Database> backend_db,
-                   backend::Database::Create(clock_, create_statements));
+                   backend::Database::Create(create_statements));
+  return AddDatabase(database_uri, instance_uri, std::move(backend_db));
+}
+
+absl::Status DatabaseManager::CreateDatabaseInBackground(
+    const std::string& database_uri,
+    const std::vector<std::string>& create_statements,
+    std::function<void(zetasql_base::StatusOr<std::shared_ptr<Database>>)>
+        done) {
+  absl::string_view project_id, instance_id, database_id;
+  ZETASQL_RETURN_IF_ERROR(
+      ParseDatabaseUri(database_uri, &project_id, &instance_id, &database_id));
+  std::string instance_uri = MakeInstanceUri(project_id, instance_id);
+
+  // Reserve the database, so that it is not created twice and its quota is
+  // not given to another database while it is being created.
+  {
+    absl::MutexLock lock(&mu_);
+    ZETASQL_RETURN_IF_ERROR(CheckCanAddDatabase(database_uri, instance_uri));
+    pending_databases_.insert(database_uri);
+    num_databases_per_instance_[instance_uri] += 1;
+  }
+
+  creation_pool_.Schedule([this, database_uri, instance_uri, create_statements,
+                           done = std::move(done)]() {
+    zetasql_base::StatusOr<std::unique_ptr<backend::Database>> backend_db =
+        backend::Database::Create(create_statements);
+    std::shared_ptr<Database> database;
+    if (backend_db.ok()) {
+      database = std::make_shared<Database>(
+          database_uri, std::move(backend_db).value(), clock_->Now());
+    }
+    {
+      absl::MutexLock lock(&mu_);
+      pending_databases_.erase(database_uri);
+      if (database != nullptr) {
+        DatabaseShard& shard = ShardOf(database_uri);
+        absl::MutexLock shard_lock(&shard.mu);
+        shard.databases[database_uri] = database;
+      } else {
+        num_databases_per_instance_[instance_uri] -= 1;
+      }
+    }
+    if (database == nullptr) {
+      done(backend_db.status());
+    } else {
+      done(database);
+    }
+  });
+  return absl::OkStatus();
+}
+
+zetasql_base::StatusOr<std::shared_ptr<Database>>
+DatabaseManager::CreateDatabaseFromTemplate(const std::string& database_uri,
+                                            const std::string& template_uri,
+                                            bool copy_data) {
+  absl::string_view project_id, instance_id, database_id;
+  ZETASQL_RETURN_IF_ERROR(
+      ParseDatabaseUri(database_uri, &project_id, &instance_id, &database_id));
+  std::string instance_uri = MakeInstanceUri(project_id, instance_id);
+
+  // The template is held while it is cloned, so it may be deleted from the
+  // database manager concurrently.
+  ZETASQL_ASSIGN_OR_RETURN(std::shared_ptr<Database> template_db,
+                   GetDatabase(template_uri));
+  ZETASQL_ASSIGN_OR_RETURN(
+      std::unique_ptr<backend::Database> backend_db,
+      backend::Database::CreateFromTemplate(template_db->backend(), copy_data));
+  return AddDatabase(database_uri, instance_uri, std::move(backend_db));
+}
+
+zetasql_base::StatusOr<std::shared_ptr<Database>> DatabaseManager::AddDatabase(
+    const std::string& database_uri, const std::string& instance_uri,
+    std::unique_ptr<backend::Database> backend_db) {
   auto database = std::make_shared<Database>(
       database_uri, std::move(backend_db), clock_->Now());
 
   // Now update the database manager state. We could do the validation checks
-  // at the top of this function, but we would have to do it here again anyway,
-  // so we don't bother optimizing that case.
+  // at the top of the create functions, but we would have to do it here again
+  // anyway, so we don't bother optimizing that case.
   absl::MutexLock lock(&mu_);
+  ZETASQL_RETURN_IF_ERROR(CheckCanAddDatabase(database_uri, instance_uri));
+
+  // Record this database in the database manager.
+  DatabaseShard& shard = ShardOf(database_uri);
+  {
+    absl::MutexLock shard_lock(&shard.mu);
+    shard.databases[database_uri] = database;
+  }
+  num_databases_per_instance_[instance_uri] += 1;
 
+  return database;
+}
+
+absl::Status DatabaseManager::CheckCanAddDatabase(
+    const std::string& database_uri, const std::string& instance_uri) const {
   // Check that a database with this name does not already exist.
-  auto itr = database_map_.find(database_uri);
-  if (itr != database_map_.end()) {
+  if (pending_databases_.contains(database_uri)) {
     return error::DatabaseAlreadyExists(database_uri);
   }
+  {
+    const DatabaseShard& shard = ShardOf(database_uri);
+    absl::ReaderMutexLock shard_lock(&shard.mu);
+    if (shard.databases.contains(database_uri)) {
+      return error::DatabaseAlreadyExists(database_uri);
+    }
+  }
 
   // Check that the user did not exceed their database quota.
-  if (num_databases_per_instance_[instance_uri] >=
-      limits::kMaxDatabasesPerInstance) {
+  auto itr = num_databases_per_instance_.find(instance_uri);
+  if (itr != num_databases_per_instance_.end() &&
+      itr->second >= limits::kMaxDatabasesPerInstance) {
     return error::TooManyDatabasesPerInstance(instance_uri);
   }
-
-  // Record this database in the database manager.
-  database_map_[database_uri] = database;
-  num_databases_per_instance_[instance_uri] += 1;
-
-  return database;
+  return absl::OkStatus();
 }
 
 zetasql_base::StatusOr<std::shared_ptr<Database>> DatabaseManager::GetDatabase(
     const std::string& database_uri) const {
-  absl::MutexLock lock(&mu_);
-  auto itr = database_map_.find(database_uri);
-  if (itr == database_map_.end()) {
+  const DatabaseShard& shard = ShardOf(database_uri);
+  absl::ReaderMutexLock lock(&shard.mu);
+  auto itr = shard.databases.find(database_uri);
+  if (itr == shard.databases.end()) {
     return error::DatabaseNotFound(database_uri);
   }
   return itr->second;
 }
 
 absl::Status DatabaseManager::DeleteDatabase(const std::string& database_uri) {
+  // Declared before the lock, so that the database is destroyed (if this was
+  // its last reference) once the lock is released.
+  std::shared_ptr<Database> database;
   absl::MutexLock lock(&mu_);
-  if (database_map_.erase(database_uri) > 0) {
+  {
+    DatabaseShard& shard = ShardOf(database_uri);
+    absl::MutexLock shard_lock(&shard.mu);
+    auto itr = shard.databases.find(database_uri);
+    if (itr != shard.databases.end()) {
+      database = std::move(itr->second);
+      shard.databases.erase(itr);
+    }
+  }
+  if (database != nullptr) {
     absl::string_view project_id, instance_id, database_id;
     ZETASQL_RETURN_IF_ERROR(ParseDatabaseUri(database_uri, &project_id, &instance_id,
                                      &database_id));
@@ -122,8 +269,22 @@ absl::Status DatabaseManager::DeleteDatabase(const std::string& database_uri) {
 
 zetasql_base::StatusOr<std::vector<std::shared_ptr<Database>>>
 DatabaseManager::ListDatabases(const std::string& instance_uri) const {
-  absl::MutexLock lock(&mu_);
-  return GetDatabasesByInstance(database_map_, instance_uri);
+  const std::string database_uri_prefix = absl::StrCat(instance_uri, "/");
+  std::vector<std::shared_ptr<Database>> databases;
+  for (const DatabaseShard& shard : shards_) {
+    absl::ReaderMutexLock lock(&shard.mu);
+    for (const auto& [database_uri, database] : shard.databases) {
+      if (absl::StartsWith(database_uri, database_uri_prefix)) {
+        databases.push_back(database);
+      }
+    }
+  }
+  std::sort(databases.begin(), databases.end(),
+            [](const std::shared_ptr<Database>& a,
+               const std::shared_ptr<Database>& b) {
+              return a->database_uri() < b->database_uri();
+            });
+  return databases;
 }
 
 }  // namespace frontend
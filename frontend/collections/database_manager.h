@@ -17,14 +17,19 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_DATABASE_MANAGER_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_DATABASE_MANAGER_H_
 
-#include <map>
+#include <array>
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/synchronization/mutex.h"
 #include "common/clock.h"
+#include "common/metrics.h"
+#include "common/thread_pool.h"
 #include "frontend/entities/database.h"
 #include "absl/status/status.h"
 
@@ -34,9 +39,24 @@ namespace emulator {
 namespace frontend {
 
 // DatabaseManager manages the set of active databases in the emulator.
+//
+// Databases can be created in the background, on a pool of
+// config::database_creation_threads() threads, so that requests creating many
+// databases at once do not each hold a request handler while their schemas
+// are built.
+//
+// The databases are spread over shards, each with a lock of its own, so that
+// looking a database up (as every session and data request does) only takes a
+// shared lock on its shard, and is not held up by the creation or deletion of
+// other databases. Creations and deletions are serialized by a separate lock,
+// which guards the bookkeeping of pending databases and quotas.
+//
+// The approximate memory held by each database is exported as the gauges
+// spanner_emulator_table_bytes and spanner_emulator_transaction_buffer_bytes.
 class DatabaseManager {
  public:
-  explicit DatabaseManager(Clock* clock) : clock_(clock) {}
+  explicit DatabaseManager(Clock* clock);
+  DatabaseManager(Clock* clock, int num_creation_threads);
 
   // Creates a database with a schema initialized from `create_statements`.
   zetasql_base::StatusOr<std::shared_ptr<Database>> CreateDatabase(
@@ -44,6 +64,26 @@ class DatabaseManager {
       const std::vector<std::string>& create_statements)
       ABSL_LOCKS_EXCLUDED(mu_);
 
+  // Creates a database like CreateDatabase, but on a background thread, and
+  // calls `done` on that thread with the database, or the error creating it.
+  // The database is only returned by GetDatabase and ListDatabases once it is
+  // created, but counts against the quota of its instance and cannot be
+  // created again meanwhile. Returns an error, and does not call `done`, if
+  // the database already exists, is being created, or would exceed the quota.
+  absl::Status CreateDatabaseInBackground(
+      const std::string& database_uri,
+      const std::vector<std::string>& create_statements,
+      std::function<void(zetasql_base::StatusOr<std::shared_ptr<Database>>)>
+          done) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Creates a database with the schema of the database at `template_uri`, and
+  // with its data too if `copy_data` is true. The schema is shared with the
+  // template rather than recreated from DDL statements, which keeps creating
+  // a database per test cheap when tests use the same schema.
+  zetasql_base::StatusOr<std::shared_ptr<Database>> CreateDatabaseFromTemplate(
+      const std::string& database_uri, const std::string& template_uri,
+      bool copy_data) ABSL_LOCKS_EXCLUDED(mu_);
+
   // Returns a database with the given URI.
   zetasql_base::StatusOr<std::shared_ptr<Database>> GetDatabase(
       const std::string& database_uri) const ABSL_LOCKS_EXCLUDED(mu_);
@@ -57,19 +97,71 @@ class DatabaseManager {
       const std::string& instance_uri) const ABSL_LOCKS_EXCLUDED(mu_);
 
  private:
-  // System-wide clock.
+  // Records `backend_db` as the database at `database_uri` in the instance at
+  // `instance_uri`, if it does not already exist and the instance's quota of
+  // databases allows it.
+  zetasql_base::StatusOr<std::shared_ptr<Database>> AddDatabase(
+      const std::string& database_uri, const std::string& instance_uri,
+      std::unique_ptr<backend::Database> backend_db) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Number of shards of the databases.
+  static constexpr int kNumDatabaseShards = 16;
+
+  // A shard of the databases, from database URI to database objects.
+  struct DatabaseShard {
+    mutable absl::Mutex mu;
+    absl::flat_hash_map<std::string, std::shared_ptr<Database>> databases
+        ABSL_GUARDED_BY(mu);
+  };
+
+  // Returns an error if the database at `database_uri` cannot be added to the
+  // instance at `instance_uri`, as it already exists (or is being created) or
+  // the instance's quota of databases is used up.
+  absl::Status CheckCanAddDatabase(const std::string& database_uri,
+                                   const std::string& instance_uri) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Returns the shard holding the database at `database_uri`.
+  DatabaseShard& ShardOf(const std::string& database_uri) const;
+
+  // Returns the memory usage gauge samples of all databases. The databases are
+  // queried outside the lock.
+  std::vector<metrics::GaugeSample> CollectTableBytes() const
+      ABSL_LOCKS_EXCLUDED(mu_);
+  std::vector<metrics::GaugeSample> CollectTransactionBytes() const
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns all the databases.
+  std::vector<std::shared_ptr<Database>> AllDatabases() const
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // System-wide clock, used for the creation time of databases. Each database
+  // has its own clock for commit and read timestamps.
   Clock* clock_;
 
-  // Mutex to guard state below.
+  // Mutex serializing the creation and deletion of databases, and guarding
+  // the state below. Acquired before the lock of any shard.
   mutable absl::Mutex mu_;
 
-  // Map from database URI to database objects.
-  std::map<std::string, std::shared_ptr<Database>> database_map_
-      ABSL_GUARDED_BY(mu_);
+  // URIs of the databases being created in the background.
+  absl::flat_hash_set<std::string> pending_databases_ ABSL_GUARDED_BY(mu_);
 
-  // Count of databases per instance.
+  // Count of databases per instance, including those being created.
   absl::flat_hash_map<std::string, int> num_databases_per_instance_
       ABSL_GUARDED_BY(mu_);
+
+  // The databases, sharded by the hash of their URI.
+  mutable std::array<DatabaseShard, kNumDatabaseShards> shards_;
+
+  // Registrations of the memory usage gauges. Declared after the databases so
+  // that they are unregistered before the databases are destroyed.
+  std::unique_ptr<metrics::GaugeRegistration> table_bytes_gauge_;
+  std::unique_ptr<metrics::GaugeRegistration> transaction_bytes_gauge_;
+
+  // Threads creating databases in the background. Declared last so that the
+  // databases being created are finished before the state they are added to
+  // is destroyed.
+  ThreadPool creation_pool_;
 };
 
 }  // namespace frontend
@@ -16,11 +16,15 @@
 
 #include "frontend/collections/database_manager.h"
 
+#include <thread>  // NOLINT
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "zetasql/base/testing/status_matchers.h"
 #include "tests/common/proto_matchers.h"
+#include "absl/status/status.h"
 #include "absl/strings/match.h"
+#include "absl/synchronization/notification.h"
 #include "frontend/entities/database.h"
 
 namespace google {
@@ -57,6 +61,72 @@ TEST_F(DatabaseManagerTest, CreateExistingDatabaseUriFailsWithAlreadyExists) {
               zetasql_base::testing::StatusIs(absl::StatusCode::kAlreadyExists));
 }
 
+TEST_F(DatabaseManagerTest, CreateDatabaseInBackground) {
+  absl::Notification created;
+  zetasql_base::StatusOr<std::shared_ptr<Database>> database;
+  ZETASQL_ASSERT_OK(database_manager_.CreateDatabaseInBackground(
+      database_uri_, {"CREATE TABLE T(k INT64) PRIMARY KEY(k)"},
+      [&](zetasql_base::StatusOr<std::shared_ptr<Database>> result) {
+        database = std::move(result);
+        created.Notify();
+      }));
+
+  // The database cannot be created again while it is being created.
+  EXPECT_THAT(database_manager_.CreateDatabase(database_uri_, empty_schema_),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kAlreadyExists));
+
+  created.WaitForNotification();
+  ZETASQL_ASSERT_OK(database);
+  EXPECT_EQ((*database)->database_uri(), database_uri_);
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::shared_ptr<Database> found,
+                       database_manager_.GetDatabase(database_uri_));
+  EXPECT_EQ(found, *database);
+}
+
+TEST_F(DatabaseManagerTest, FailedBackgroundCreationReleasesDatabase) {
+  absl::Notification created;
+  absl::Status status;
+  ZETASQL_ASSERT_OK(database_manager_.CreateDatabaseInBackground(
+      database_uri_, {"INVALID DDL"},
+      [&](zetasql_base::StatusOr<std::shared_ptr<Database>> result) {
+        status = result.status();
+        created.Notify();
+      }));
+  created.WaitForNotification();
+  EXPECT_THAT(status,
+              zetasql_base::testing::StatusIs(absl::StatusCode::kInvalidArgument));
+
+  EXPECT_THAT(database_manager_.GetDatabase(database_uri_),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+  ZETASQL_EXPECT_OK(
+      database_manager_.CreateDatabase(database_uri_, empty_schema_));
+}
+
+TEST_F(DatabaseManagerTest, CreateDatabaseFromTemplate) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::shared_ptr<Database> template_db,
+                       database_manager_.CreateDatabase(
+                           database_uri_, {"CREATE TABLE T(k INT64) "
+                                           "PRIMARY KEY(k)"}));
+  std::string clone_uri =
+      "projects/test-p/instances/test-instance/databases/clone";
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::shared_ptr<Database> clone,
+                       database_manager_.CreateDatabaseFromTemplate(
+                           clone_uri, database_uri_, /*copy_data=*/false));
+  EXPECT_EQ(clone->database_uri(), clone_uri);
+  EXPECT_EQ(clone->backend()->GetSchema(),
+            template_db->backend()->GetSchema());
+
+  EXPECT_THAT(database_manager_.CreateDatabaseFromTemplate(
+                  clone_uri, database_uri_, /*copy_data=*/false),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kAlreadyExists));
+  EXPECT_THAT(
+      database_manager_.CreateDatabaseFromTemplate(
+          "projects/test-p/instances/test-instance/databases/other",
+          "projects/test-p/instances/test-instance/databases/missing",
+          /*copy_data=*/false),
+      zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+}
+
 TEST_F(DatabaseManagerTest, GetExistingDatabase) {
   ZETASQL_ASSERT_OK_AND_ASSIGN(
       std::shared_ptr<Database> database,
@@ -80,6 +150,33 @@ TEST_F(DatabaseManagerTest, DeleteExistingDatabase) {
               zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
 }
 
+TEST_F(DatabaseManagerTest, GetDatabaseWhileOtherDatabasesChange) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::shared_ptr<Database> database,
+      database_manager_.CreateDatabase(database_uri_, empty_schema_));
+
+  std::thread admin([this] {
+    for (int i = 0; i < 50; ++i) {
+      std::string database_uri = absl::StrCat(
+          "projects/test-p/instances/test-instance/databases/other-", i);
+      ZETASQL_EXPECT_OK(
+          database_manager_.CreateDatabase(database_uri, empty_schema_));
+      ZETASQL_EXPECT_OK(database_manager_.DeleteDatabase(database_uri));
+    }
+  });
+  for (int i = 0; i < 1000; ++i) {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(std::shared_ptr<Database> found,
+                         database_manager_.GetDatabase(database_uri_));
+    EXPECT_EQ(found, database);
+  }
+  admin.join();
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::vector<std::shared_ptr<Database>> databases,
+                       database_manager_.ListDatabases(
+                           "projects/test-p/instances/test-instance"));
+  EXPECT_EQ(databases.size(), 1);
+}
+
 TEST_F(DatabaseManagerTest, ListDatabase) {
   std::string instance_uri = "projects/test-p/instances/test-i";
   int num_databases = 5;
@@ -17,6 +17,7 @@
 #include "frontend/collections/instance_manager.h"
 
 #include <memory>
+#include <utility>
 
 #include "google/spanner/admin/instance/v1/spanner_instance_admin.pb.h"
 #include "absl/memory/memory.h"
@@ -38,7 +39,7 @@ namespace instance_api = ::google::spanner::admin::instance::v1;
 
 zetasql_base::StatusOr<std::vector<std::shared_ptr<Instance>>>
 InstanceManager::ListInstances(const std::string& project_uri) const {
-  absl::MutexLock lock(&mu_);
+  absl::ReaderMutexLock lock(&mu_);
   std::vector<std::shared_ptr<Instance>> instances;
   // Find all instance that belongs to the project.
   auto itr = instances_.lower_bound(absl::StrCat(project_uri, "/"));
@@ -55,7 +56,7 @@ InstanceManager::ListInstances(const std::string& project_uri) const {
 
 zetasql_base::StatusOr<std::shared_ptr<Instance>> InstanceManager::GetInstance(
     const std::string& instance_uri) const {
-  absl::MutexLock lock(&mu_);
+  absl::ReaderMutexLock lock(&mu_);
   auto itr = instances_.find(instance_uri);
   if (itr == instances_.end()) {
     return error::InstanceNotFound(instance_uri);
@@ -66,13 +67,12 @@ zetasql_base::StatusOr<std::shared_ptr<Instance>> InstanceManager::GetInstance(
 zetasql_base::StatusOr<std::shared_ptr<Instance>> InstanceManager::CreateInstance(
     const std::string& instance_uri,
     const instance_api::Instance& instance_proto) {
-  absl::MutexLock lock(&mu_);
   Labels labels(instance_proto.labels().begin(), instance_proto.labels().end());
-  auto inserted = instances_.insert(
-      {instance_uri,
-       std::make_shared<Instance>(instance_uri, instance_proto.config(),
-                                  instance_proto.display_name(),
-                                  instance_proto.node_count(), labels)});
+  auto instance = std::make_shared<Instance>(
+      instance_uri, instance_proto.config(), instance_proto.display_name(),
+      instance_proto.node_count(), labels);
+  absl::MutexLock lock(&mu_);
+  auto inserted = instances_.insert({instance_uri, std::move(instance)});
   if (!inserted.second) {
     return error::InstanceAlreadyExists(instance_uri);
   }
@@ -50,7 +50,8 @@ class InstanceManager {
       const std::string& project_uri) const ABSL_LOCKS_EXCLUDED(mu_);
 
  private:
-  // Mutex to guard state below.
+  // Mutex to guard state below. Lookups only take it shared, so that they
+  // proceed concurrently with each other.
   mutable absl::Mutex mu_;
 
   // Map from instance URI to instance objects.
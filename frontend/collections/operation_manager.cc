@@ -16,14 +16,19 @@
 
 #include "frontend/collections/operation_manager.h"
 
+#include <atomic>
+#include <cstdint>
+#include <limits>
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "zetasql/base/statusor.h"
-#include "absl/strings/match.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "common/errors.h"
 #include "frontend/common/uris.h"
 
@@ -34,61 +39,163 @@ namespace frontend {
 
 const char OperationManager::kAutoGeneratedId[] = "";
 
-zetasql_base::StatusOr<std::shared_ptr<Operation>> OperationManager::CreateOperation(
-    const std::string& resource_uri, const std::string& operation_id) {
+OperationManager::~OperationManager() {
+  TimerService::TimerId eviction_timer;
+  {
+    absl::MutexLock lock(&mu_);
+    stopping_ = true;
+    if (!eviction_scheduled_) {
+      return;
+    }
+    eviction_timer = eviction_timer_;
+  }
+  // Cancelling waits for the timer if it is already running.
+  timers_->Cancel(eviction_timer);
+}
+
+void OperationManager::RemoveOperation(
+    absl::flat_hash_map<std::string, OperationEntry>::iterator itr) {
+  auto index_itr = operations_by_resource_.find(itr->second.resource_uri);
+  if (index_itr != operations_by_resource_.end()) {
+    index_itr->second.erase(itr->first);
+    if (index_itr->second.empty()) {
+      operations_by_resource_.erase(index_itr);
+    }
+  }
+  operations_.erase(itr);
+}
+
+void OperationManager::EvictOperations(absl::Time now) {
+  // Operations still running are queued again, so each entry is visited at
+  // most once per call.
+  for (size_t num_entries = eviction_queue_.size(); num_entries > 0;
+       --num_entries) {
+    const auto [queue_time, operation_uri] = eviction_queue_.front();
+    auto itr = operations_.find(operation_uri);
+    if (itr == operations_.end() || itr->second.queue_time != queue_time) {
+      // The operation was deleted, and possibly created again since.
+      eviction_queue_.pop_front();
+      continue;
+    }
+    if (now - queue_time <= completed_operation_ttl_ &&
+        operations_.size() <= static_cast<size_t>(max_operations_)) {
+      break;
+    }
+    eviction_queue_.pop_front();
+    if (itr->second.operation->done()) {
+      RemoveOperation(itr);
+    } else {
+      itr->second.queue_time = now;
+      eviction_queue_.emplace_back(now, operation_uri);
+    }
+  }
+}
+
+void OperationManager::MaybeScheduleEviction() {
+  if (timers_ == nullptr || stopping_ || eviction_scheduled_ ||
+      eviction_queue_.empty()) {
+    return;
+  }
+  // Operations are queued in time order, so the front expires first.
+  eviction_scheduled_ = true;
+  const absl::Time deadline =
+      eviction_queue_.front().first + completed_operation_ttl_;
+  eviction_timer_ = timers_->Schedule(deadline, [this]() { EvictOnTimer(); });
+}
+
+void OperationManager::EvictOnTimer() {
+  const absl::Time now = clock_->Now();
   absl::MutexLock lock(&mu_);
+  eviction_scheduled_ = false;
+  EvictOperations(now);
+  MaybeScheduleEviction();
+}
 
+zetasql_base::StatusOr<std::shared_ptr<Operation>> OperationManager::CreateOperation(
+    const std::string& resource_uri, const std::string& operation_id) {
   // Generate an operation id if the user did not specify one.
   std::string operation_uri = MakeOperationUri(
-      resource_uri, operation_id.empty()
-                        ? absl::StrCat("_auto", next_operation_id_++)
-                        : operation_id);
+      resource_uri,
+      operation_id.empty()
+          ? absl::StrCat("_auto", next_operation_id_.fetch_add(
+                                      1, std::memory_order_relaxed))
+          : operation_id);
+
+  const absl::Time now = clock_->Now();
+  absl::MutexLock lock(&mu_);
+  EvictOperations(now);
 
   // Double-check that the operation does not already exist.
-  auto itr = operations_map_.find(operation_uri);
-  if (itr != operations_map_.end()) {
+  auto itr = operations_.find(operation_uri);
+  if (itr != operations_.end()) {
     return error::OperationAlreadyExists(operation_uri);
   }
 
   // Finally, create the operation.
   std::shared_ptr<Operation> operation =
       std::make_shared<Operation>(operation_uri);
-  operations_map_[operation_uri] = operation;
+  operations_[operation_uri] = {operation, resource_uri, now};
+  operations_by_resource_[resource_uri][operation_uri] = operation;
+  eviction_queue_.emplace_back(now, operation_uri);
+  MaybeScheduleEviction();
 
   return operation;
 }
 
 zetasql_base::StatusOr<std::shared_ptr<Operation>> OperationManager::GetOperation(
     const std::string& operation_uri) {
+  const absl::Time now = clock_->Now();
   absl::MutexLock lock(&mu_);
+  EvictOperations(now);
 
-  auto itr = operations_map_.find(operation_uri);
-  if (itr == operations_map_.end()) {
+  auto itr = operations_.find(operation_uri);
+  if (itr == operations_.end()) {
     return error::OperationNotFound(operation_uri);
   }
-  return itr->second;
+  return itr->second.operation;
 }
 
 absl::Status OperationManager::DeleteOperation(
     const std::string& operation_uri) {
   absl::MutexLock lock(&mu_);
-  operations_map_.erase(operation_uri);
+  auto itr = operations_.find(operation_uri);
+  if (itr != operations_.end()) {
+    RemoveOperation(itr);
+  }
   return absl::OkStatus();
 }
 
 zetasql_base::StatusOr<std::vector<std::shared_ptr<Operation>>>
 OperationManager::ListOperations(const std::string& resource_uri) {
+  std::string next_page_token;
+  return ListOperations(resource_uri, /*page_token=*/"",
+                        std::numeric_limits<int64_t>::max(), &next_page_token);
+}
+
+zetasql_base::StatusOr<std::vector<std::shared_ptr<Operation>>>
+OperationManager::ListOperations(const std::string& resource_uri,
+                                 const std::string& page_token,
+                                 int64_t page_size,
+                                 std::string* next_page_token) {
+  const absl::Time now = clock_->Now();
   absl::MutexLock lock(&mu_);
+  EvictOperations(now);
+
   std::vector<std::shared_ptr<Operation>> operations;
-  auto itr = operations_map_.lower_bound(resource_uri);
-  while (itr != operations_map_.end()) {
-    if (!absl::StartsWith(itr->first, resource_uri)) {
+  next_page_token->clear();
+  auto index_itr = operations_by_resource_.find(resource_uri);
+  if (index_itr == operations_by_resource_.end()) {
+    return operations;
+  }
+  const auto& resource_operations = index_itr->second;
+  for (auto itr = resource_operations.lower_bound(page_token);
+       itr != resource_operations.end(); ++itr) {
+    if (static_cast<int64_t>(operations.size()) >= page_size) {
+      *next_page_token = itr->first;
       break;
     }
     operations.push_back(itr->second);
-    ++itr;
   }
-
   return operations;
 }
 
@@ -17,12 +17,21 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_COLLECTIONS_OPERATION_MANAGER_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_COLLECTIONS_OPERATION_MANAGER_H_
 
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "common/clock.h"
+#include "common/timer_service.h"
 #include "frontend/entities/operation.h"
 #include "absl/status/status.h"
 #include "zetasql/base/statusor.h"
@@ -55,6 +64,13 @@ namespace frontend {
 // returns success at the handler level as there is nothing to cancel. Wait is
 // not implemented by Cloud Spanner, so we don't need to implement it here.
 //
+// Completed operations are evicted once they are older than a time to live,
+// or when the manager holds more than a maximum number of operations, oldest
+// first. Eviction happens as the manager is used, and also on a timer if the
+// manager has timers, so that idle managers release their operations.
+// Operations are indexed by the URI of their resource, so that listing the
+// operations of a resource only visits the operations it owns.
+//
 // For more details on the long running operations api, see
 //     https://cloud.google.com/spanner/docs/reference/rpc/google.longrunning
 class OperationManager {
@@ -62,6 +78,28 @@ class OperationManager {
   // A constant indicating that the operation id should be auto generated.
   static const char kAutoGeneratedId[];
 
+  // Completed operations are kept for at least this long after they are
+  // created.
+  static constexpr absl::Duration kCompletedOperationTtl = absl::Hours(24);
+
+  // Completed operations are evicted early when the manager holds more than
+  // this many operations.
+  static constexpr int64_t kMaxOperations = 100000;
+
+  // If `timers` is not null, it runs the timer evicting expired operations,
+  // and must outlive the manager.
+  explicit OperationManager(
+      Clock* clock,
+      absl::Duration completed_operation_ttl = kCompletedOperationTtl,
+      int64_t max_operations = kMaxOperations, TimerService* timers = nullptr)
+      : clock_(clock),
+        completed_operation_ttl_(completed_operation_ttl),
+        max_operations_(max_operations),
+        timers_(timers) {}
+
+  // Cancels the eviction timer.
+  ~OperationManager();
+
   // Creates an operation. Some operations (like update database) allow the
   // user to specify the operation id. If the user specifies an operation id,
   // it is used as-is, otherwise a system generated operation id is used.
@@ -80,20 +118,83 @@ class OperationManager {
   absl::Status DeleteOperation(const std::string& operation_uri)
       ABSL_LOCKS_EXCLUDED(mu_);
 
-  // Lists all the operations registered with the operation manager.
+  // Lists all the operations of the resource with the specified URI, sorted by
+  // operation URI.
   zetasql_base::StatusOr<std::vector<std::shared_ptr<Operation>>> ListOperations(
       const std::string& resource_uri) ABSL_LOCKS_EXCLUDED(mu_);
 
+  // Lists at most `page_size` operations of the resource with the specified
+  // URI, sorted by operation URI, starting at the operation URI `page_token`.
+  // Sets `next_page_token` to the URI of the first operation of the next page,
+  // or to the empty string if there are no more operations.
+  zetasql_base::StatusOr<std::vector<std::shared_ptr<Operation>>> ListOperations(
+      const std::string& resource_uri, const std::string& page_token,
+      int64_t page_size, std::string* next_page_token) ABSL_LOCKS_EXCLUDED(mu_);
+
  private:
+  struct OperationEntry {
+    std::shared_ptr<Operation> operation;
+
+    // The URI of the resource the operation belongs to.
+    std::string resource_uri;
+
+    // The time the operation was added to the eviction queue.
+    absl::Time queue_time;
+  };
+
+  // Removes the operation at `itr` from the operations and from the index.
+  void RemoveOperation(
+      absl::flat_hash_map<std::string, OperationEntry>::iterator itr)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Evicts the completed operations which expired, and the oldest completed
+  // operations if there are more than max_operations_.
+  void EvictOperations(absl::Time now) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Schedules the eviction timer for when the oldest queued operation expires,
+  // if the manager has timers and the timer is not already scheduled.
+  void MaybeScheduleEviction() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Body of the eviction timer.
+  void EvictOnTimer() ABSL_LOCKS_EXCLUDED(mu_);
+
+  // System-wide clock.
+  Clock* clock_;
+
+  const absl::Duration completed_operation_ttl_;
+  const int64_t max_operations_;
+
+  // Timers evicting expired operations, or null.
+  TimerService* const timers_;
+
+  // Counter for the system assigned operation id, advanced without holding
+  // mu_.
+  std::atomic<int64_t> next_operation_id_{0};
+
   // Mutex to guard state below.
   absl::Mutex mu_;
 
-  // Counter for the system assigned operation id.
-  int next_operation_id_ ABSL_GUARDED_BY(mu_) = 0;
-
   // Map from operation URI to actual operation.
-  std::map<std::string, std::shared_ptr<Operation>> operations_map_
+  absl::flat_hash_map<std::string, OperationEntry> operations_
+      ABSL_GUARDED_BY(mu_);
+
+  // Map from resource URI to the operations of the resource, by operation URI.
+  absl::flat_hash_map<std::string,
+                      std::map<std::string, std::shared_ptr<Operation>>>
+      operations_by_resource_ ABSL_GUARDED_BY(mu_);
+
+  // URIs of the operations in the order they were queued for eviction, with
+  // the time they were queued. Entries of deleted operations are skipped when
+  // they reach the front of the queue.
+  std::deque<std::pair<absl::Time, std::string>> eviction_queue_
       ABSL_GUARDED_BY(mu_);
+
+  // The eviction timer, if scheduled.
+  bool eviction_scheduled_ ABSL_GUARDED_BY(mu_) = false;
+  TimerService::TimerId eviction_timer_ ABSL_GUARDED_BY(mu_) = 0;
+
+  // Set by the destructor, after which the timer is no longer scheduled.
+  bool stopping_ ABSL_GUARDED_BY(mu_) = false;
 };
 
 }  // namespace frontend
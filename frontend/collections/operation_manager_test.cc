@@ -16,12 +16,19 @@
 
 #include "frontend/collections/operation_manager.h"
 
+#include <memory>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "zetasql/base/testing/status_matchers.h"
 #include "tests/common/proto_matchers.h"
 #include "absl/strings/match.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "common/clock.h"
+#include "common/timer_service.h"
 #include "frontend/entities/operation.h"
+#include "google/protobuf/empty.pb.h"
 
 namespace google {
 namespace spanner {
@@ -32,8 +39,10 @@ class OperationManagerTest : public testing::Test {
  protected:
   OperationManager* manager() { return &manager_; }
 
+  Clock clock_;
+
  private:
-  OperationManager manager_;
+  OperationManager manager_{&clock_};
 };
 
 TEST_F(OperationManagerTest, CreatesNewOperationWithUserSpecifiedID) {
@@ -136,6 +145,97 @@ TEST_F(OperationManagerTest, ListsOperationsWithSimilarInstanceURI) {
             operation_pb.name());
 }
 
+TEST_F(OperationManagerTest, ListsOperationsInPages) {
+  const std::string instance_uri =
+      "projects/test-project/instances/test-instance";
+  for (int i = 0; i < 5; ++i) {
+    ZETASQL_ASSERT_OK(manager()->CreateOperation(instance_uri, absl::StrCat(i)));
+  }
+  ZETASQL_ASSERT_OK(manager()->CreateOperation(
+      absl::StrCat(instance_uri, "/databases/test-database"), "0"));
+
+  std::vector<std::string> operation_uris;
+  std::string page_token;
+  int num_pages = 0;
+  do {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        std::vector<std::shared_ptr<Operation>> operations,
+        manager()->ListOperations(instance_uri, page_token, /*page_size=*/2,
+                                  &page_token));
+    EXPECT_LE(operations.size(), 2);
+    for (const auto& operation : operations) {
+      google::longrunning::Operation operation_pb;
+      operation->ToProto(&operation_pb);
+      operation_uris.push_back(operation_pb.name());
+    }
+    ++num_pages;
+  } while (!page_token.empty());
+  EXPECT_EQ(num_pages, 3);
+  const std::string prefix = absl::StrCat(instance_uri, "/operations/");
+  EXPECT_THAT(operation_uris,
+              testing::ElementsAre(
+                  absl::StrCat(prefix, 0), absl::StrCat(prefix, 1),
+                  absl::StrCat(prefix, 2), absl::StrCat(prefix, 3),
+                  absl::StrCat(prefix, 4)));
+}
+
+TEST_F(OperationManagerTest, EvictsExpiredCompletedOperations) {
+  OperationManager manager(&clock_,
+                           /*completed_operation_ttl=*/absl::ZeroDuration());
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::shared_ptr<Operation> completed,
+      manager.CreateOperation("projects/123/instances/456", "completed"));
+  completed->SetResponse(google::protobuf::Empty());
+  ZETASQL_ASSERT_OK(manager.CreateOperation("projects/123/instances/456", "running"));
+
+  EXPECT_THAT(
+      manager.GetOperation("projects/123/instances/456/operations/completed"),
+      zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+  ZETASQL_EXPECT_OK(
+      manager.GetOperation("projects/123/instances/456/operations/running"));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::vector<std::shared_ptr<Operation>> operations,
+                       manager.ListOperations("projects/123/instances/456"));
+  EXPECT_EQ(operations.size(), 1);
+}
+
+TEST_F(OperationManagerTest, EvictsOldestCompletedOperationsOverCapacity) {
+  OperationManager manager(&clock_, OperationManager::kCompletedOperationTtl,
+                           /*max_operations=*/2);
+  for (int i = 0; i < 3; ++i) {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        std::shared_ptr<Operation> operation,
+        manager.CreateOperation("projects/123/instances/456", absl::StrCat(i)));
+    operation->SetResponse(google::protobuf::Empty());
+  }
+
+  EXPECT_THAT(manager.GetOperation("projects/123/instances/456/operations/0"),
+              zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+  ZETASQL_EXPECT_OK(manager.GetOperation("projects/123/instances/456/operations/1"));
+  ZETASQL_EXPECT_OK(manager.GetOperation("projects/123/instances/456/operations/2"));
+}
+
+TEST_F(OperationManagerTest, EvictsExpiredOperationsOnTimerWhileIdle) {
+  TimerService timers(absl::Milliseconds(1));
+  OperationManager manager(&clock_,
+                           /*completed_operation_ttl=*/absl::Milliseconds(10),
+                           OperationManager::kMaxOperations, &timers);
+  std::weak_ptr<Operation> evicted;
+  {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        std::shared_ptr<Operation> operation,
+        manager.CreateOperation("projects/123/instances/456", "completed"));
+    operation->SetResponse(google::protobuf::Empty());
+    evicted = operation;
+  }
+
+  // The manager is not called again, so only the timer evicts the operation.
+  const absl::Time deadline = absl::Now() + absl::Seconds(30);
+  while (!evicted.expired() && absl::Now() < deadline) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  EXPECT_TRUE(evicted.expired());
+}
+
 }  // namespace frontend
 }  // namespace emulator
 }  // namespace spanner
@@ -16,15 +16,23 @@
 
 #include "frontend/collections/session_manager.h"
 
-#include <map>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "zetasql/base/statusor.h"
-#include "absl/strings/match.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "common/errors.h"
+#include "common/timer_service.h"
 #include "frontend/common/uris.h"
 #include "frontend/entities/database.h"
 #include "frontend/entities/session.h"
@@ -34,57 +42,321 @@ namespace spanner {
 namespace emulator {
 namespace frontend {
 
+namespace {
+
+// Returns the URI of the database of the session with the given URI, which is
+// of the form <database_uri>/sessions/<session_id>.
+std::string DatabaseUriOfSession(const std::string& session_uri) {
+  return session_uri.substr(0, session_uri.rfind("/sessions/"));
+}
+
+}  // namespace
+
+SessionManager::~SessionManager() {
+  if (timers_ == nullptr) {
+    return;
+  }
+  stopping_ = true;
+  std::vector<TimerService::TimerId> timer_ids;
+  for (Shard& shard : shards_) {
+    absl::MutexLock lock(&shard.mu);
+    for (const auto& [session_uri, timer_id] : shard.expiry_timers) {
+      timer_ids.push_back(timer_id);
+    }
+    shard.expiry_timers.clear();
+  }
+  // Cancelling waits for timers which are already running, so none runs once
+  // the manager is destroyed.
+  for (TimerService::TimerId timer_id : timer_ids) {
+    timers_->Cancel(timer_id);
+  }
+}
+
+SessionManager::Shard& SessionManager::ShardFor(
+    const std::string& session_uri) {
+  return shards_[absl::Hash<std::string>()(session_uri) % kNumShards];
+}
+
+SessionManager::DatabaseIndexShard& SessionManager::IndexShardFor(
+    const std::string& database_uri) {
+  return database_index_[absl::Hash<std::string>()(database_uri) % kNumShards];
+}
+
+const SessionManager::DatabaseIndexShard& SessionManager::IndexShardFor(
+    const std::string& database_uri) const {
+  return database_index_[absl::Hash<std::string>()(database_uri) % kNumShards];
+}
+
+void SessionManager::AddToDatabaseIndex(
+    const std::shared_ptr<Session>& session) {
+  const std::string database_uri = DatabaseUriOfSession(session->session_uri());
+  DatabaseIndexShard& index_shard = IndexShardFor(database_uri);
+  absl::MutexLock lock(&index_shard.mu);
+  index_shard.sessions_by_database[database_uri][session->session_uri()] =
+      session;
+}
+
+void SessionManager::AddToDatabaseIndex(
+    const std::string& database_uri,
+    const std::vector<std::shared_ptr<Session>>& sessions) {
+  DatabaseIndexShard& index_shard = IndexShardFor(database_uri);
+  absl::MutexLock lock(&index_shard.mu);
+  auto& database_sessions = index_shard.sessions_by_database[database_uri];
+  database_sessions.reserve(database_sessions.size() + sessions.size());
+  for (const std::shared_ptr<Session>& session : sessions) {
+    database_sessions[session->session_uri()] = session;
+  }
+}
+
+void SessionManager::RemoveFromDatabaseIndex(const std::string& session_uri) {
+  const std::string database_uri = DatabaseUriOfSession(session_uri);
+  DatabaseIndexShard& index_shard = IndexShardFor(database_uri);
+  absl::MutexLock lock(&index_shard.mu);
+  auto itr = index_shard.sessions_by_database.find(database_uri);
+  if (itr == index_shard.sessions_by_database.end()) {
+    return;
+  }
+  itr->second.erase(session_uri);
+  if (itr->second.empty()) {
+    index_shard.sessions_by_database.erase(itr);
+  }
+}
+
+bool SessionManager::IsExpired(const Session& session, absl::Time now) const {
+  return now - session.approximate_last_use_time() > kMaxSessionIdleTime;
+}
+
+std::vector<std::string> SessionManager::MaybeSweepShard(Shard* shard,
+                                                         absl::Time now) {
+  std::vector<std::string> expired_session_uris;
+  if (timers_ != nullptr || now - shard->last_sweep_time < kSweepInterval) {
+    return expired_session_uris;
+  }
+  shard->last_sweep_time = now;
+  for (auto itr = shard->sessions.begin(); itr != shard->sessions.end();) {
+    // flat_hash_map::erase does not return an iterator, but erasing does not
+    // invalidate the other iterators.
+    auto current = itr++;
+    if (IsExpired(*current->second, now)) {
+      expired_session_uris.push_back(current->first);
+      shard->sessions.erase(current);
+    }
+  }
+  return expired_session_uris;
+}
+
+void SessionManager::ScheduleExpiry(Shard* shard,
+                                    const std::string& session_uri,
+                                    absl::Time deadline) {
+  if (timers_ == nullptr || stopping_) {
+    return;
+  }
+  shard->expiry_timers[session_uri] = timers_->Schedule(
+      deadline, [this, session_uri] { ExpireSession(session_uri); });
+}
+
+void SessionManager::ExpireSession(const std::string& session_uri) {
+  // Declared before the lock, so that the session and its transactions are
+  // destroyed once the shard is unlocked.
+  std::shared_ptr<Session> session;
+  Shard& shard = ShardFor(session_uri);
+  absl::MutexLock lock(&shard.mu);
+  auto itr = shard.sessions.find(session_uri);
+  if (itr == shard.sessions.end()) {
+    shard.expiry_timers.erase(session_uri);
+    return;
+  }
+  const absl::Time now = clock_->Now();
+  if (!IsExpired(*itr->second, now)) {
+    // The session was used since the timer was scheduled.
+    ScheduleExpiry(&shard, session_uri,
+                   itr->second->approximate_last_use_time() +
+                       kMaxSessionIdleTime);
+    return;
+  }
+  session = std::move(itr->second);
+  shard.sessions.erase(itr);
+  shard.expiry_timers.erase(session_uri);
+  // Done with the shard locked, so that the destructor of the manager, which
+  // locks each shard, waits for this timer to finish.
+  RemoveFromDatabaseIndex(session_uri);
+}
+
+void SessionManager::CancelExpiry(
+    const std::vector<std::string>& session_uris) {
+  if (timers_ == nullptr) {
+    return;
+  }
+  std::vector<TimerService::TimerId> timer_ids;
+  for (const std::string& session_uri : session_uris) {
+    Shard& shard = ShardFor(session_uri);
+    absl::MutexLock lock(&shard.mu);
+    auto itr = shard.expiry_timers.find(session_uri);
+    if (itr != shard.expiry_timers.end()) {
+      timer_ids.push_back(itr->second);
+      shard.expiry_timers.erase(itr);
+    }
+  }
+  for (TimerService::TimerId timer_id : timer_ids) {
+    timers_->Cancel(timer_id);
+  }
+}
+
 zetasql_base::StatusOr<std::shared_ptr<Session>> SessionManager::CreateSession(
     const Labels& labels, std::shared_ptr<Database> database) {
-  absl::MutexLock lock(&mu_);
   const std::string session_id = absl::StrCat(next_session_id_++);
   std::string session_uri =
       MakeSessionUri(database->database_uri(), session_id);
-  std::shared_ptr<Session> session =
-      std::make_shared<Session>(session_uri, labels,
-                                /* create_time = */ clock_->Now(), database);
-  session->set_approximate_last_use_time(clock_->Now());
+  const absl::Time now = clock_->Now();
+  std::shared_ptr<Session> session = std::make_shared<Session>(
+      session_uri, labels, /* create_time = */ now, database, timers_);
+  session->set_approximate_last_use_time(now);
 
-  session_map_[session_uri] = session;
+  // Without timers, creating sessions sweeps expired ones from the shard, so
+  // that sessions abandoned by their clients do not accumulate.
+  std::vector<std::string> expired_session_uris;
+  {
+    Shard& shard = ShardFor(session_uri);
+    absl::MutexLock lock(&shard.mu);
+    expired_session_uris = MaybeSweepShard(&shard, now);
+    shard.sessions[session_uri] = session;
+    ScheduleExpiry(&shard, session_uri, now + kMaxSessionIdleTime);
+  }
+  for (const std::string& expired_session_uri : expired_session_uris) {
+    RemoveFromDatabaseIndex(expired_session_uri);
+  }
+  AddToDatabaseIndex(session);
   return session;
 }
 
+zetasql_base::StatusOr<std::vector<std::shared_ptr<Session>>>
+SessionManager::CreateSessions(const Labels& labels,
+                               std::shared_ptr<Database> database, int count) {
+  std::vector<std::shared_ptr<Session>> sessions;
+  if (count <= 0) {
+    return sessions;
+  }
+  const int64_t first_session_id = next_session_id_.fetch_add(count);
+  const std::string& database_uri = database->database_uri();
+  const std::string session_uri_prefix = MakeSessionUri(database_uri, "");
+  const absl::Time now = clock_->Now();
+  sessions.reserve(count);
+  std::array<std::vector<std::shared_ptr<Session>>, kNumShards> by_shard;
+  for (int i = 0; i < count; ++i) {
+    std::string session_uri = session_uri_prefix;
+    absl::StrAppend(&session_uri, first_session_id + i);
+    const size_t shard_index =
+        absl::Hash<std::string>()(session_uri) % kNumShards;
+    std::shared_ptr<Session> session =
+        std::make_shared<Session>(std::move(session_uri), labels,
+                                  /* create_time = */ now, database, timers_);
+    session->set_approximate_last_use_time(now);
+    by_shard[shard_index].push_back(session);
+    sessions.push_back(std::move(session));
+  }
+
+  std::vector<std::string> expired_session_uris;
+  for (int i = 0; i < kNumShards; ++i) {
+    if (by_shard[i].empty()) {
+      continue;
+    }
+    Shard& shard = shards_[i];
+    absl::MutexLock lock(&shard.mu);
+    std::vector<std::string> expired = MaybeSweepShard(&shard, now);
+    expired_session_uris.insert(expired_session_uris.end(),
+                                std::make_move_iterator(expired.begin()),
+                                std::make_move_iterator(expired.end()));
+    for (const std::shared_ptr<Session>& session : by_shard[i]) {
+      shard.sessions[session->session_uri()] = session;
+      ScheduleExpiry(&shard, session->session_uri(), now + kMaxSessionIdleTime);
+    }
+  }
+  for (const std::string& expired_session_uri : expired_session_uris) {
+    RemoveFromDatabaseIndex(expired_session_uri);
+  }
+  AddToDatabaseIndex(database_uri, sessions);
+  return sessions;
+}
+
 zetasql_base::StatusOr<std::shared_ptr<Session>> SessionManager::GetSession(
     const std::string& session_uri) {
-  absl::MutexLock lock(&mu_);
-  auto itr = session_map_.find(session_uri);
-  if (itr == session_map_.end()) {
-    return error::SessionNotFound(session_uri);
-  }
-  std::shared_ptr<Session> session = itr->second;
-  if (clock_->Now() - session->approximate_last_use_time() > absl::Hours(1)) {
+  {
+    Shard& shard = ShardFor(session_uri);
+    absl::MutexLock lock(&shard.mu);
+    auto itr = shard.sessions.find(session_uri);
+    if (itr == shard.sessions.end()) {
+      return error::SessionNotFound(session_uri);
+    }
+    std::shared_ptr<Session> session = itr->second;
+    const absl::Time now = clock_->Now();
+    if (!IsExpired(*session, now)) {
+      session->set_approximate_last_use_time(now);
+      return session;
+    }
     // Delete inactive sessions after 1 hour.
-    session_map_.erase(session_uri);
-    return error::SessionNotFound(session_uri);
+    shard.sessions.erase(itr);
   }
-  session->set_approximate_last_use_time(clock_->Now());
-  return session;
+  RemoveFromDatabaseIndex(session_uri);
+  return error::SessionNotFound(session_uri);
 }
 
 zetasql_base::StatusOr<std::vector<std::shared_ptr<Session>>>
 SessionManager::ListSessions(const std::string& database_uri) const {
-  absl::MutexLock lock(&mu_);
-  std::string session_uri_prefix = absl::StrCat(database_uri, "/");
+  const absl::Time now = clock_->Now();
   std::vector<std::shared_ptr<Session>> sessions;
-  for (auto itr = session_map_.lower_bound(session_uri_prefix);
-       itr != session_map_.end(); ++itr) {
-    if (absl::StartsWith(itr->first, session_uri_prefix)) {
-      sessions.push_back(itr->second);
-    } else {
-      return sessions;
+  {
+    const DatabaseIndexShard& index_shard = IndexShardFor(database_uri);
+    absl::MutexLock lock(&index_shard.mu);
+    auto itr = index_shard.sessions_by_database.find(database_uri);
+    if (itr != index_shard.sessions_by_database.end()) {
+      for (const auto& [session_uri, session] : itr->second) {
+        if (!IsExpired(*session, now)) {
+          sessions.push_back(session);
+        }
+      }
     }
   }
+  // Callers page through the sessions by URI.
+  std::sort(sessions.begin(), sessions.end(),
+            [](const std::shared_ptr<Session>& a,
+               const std::shared_ptr<Session>& b) {
+              return a->session_uri() < b->session_uri();
+            });
   return sessions;
 }
 
 absl::Status SessionManager::DeleteSession(const std::string& session_uri) {
-  absl::MutexLock lock(&mu_);
-  session_map_.erase(session_uri);
+  {
+    Shard& shard = ShardFor(session_uri);
+    absl::MutexLock lock(&shard.mu);
+    shard.sessions.erase(session_uri);
+  }
+  RemoveFromDatabaseIndex(session_uri);
+  CancelExpiry({session_uri});
+  return absl::OkStatus();
+}
+
+absl::Status SessionManager::DeleteSessions(const std::string& database_uri) {
+  absl::flat_hash_map<std::string, std::shared_ptr<Session>> sessions;
+  {
+    DatabaseIndexShard& index_shard = IndexShardFor(database_uri);
+    absl::MutexLock lock(&index_shard.mu);
+    auto itr = index_shard.sessions_by_database.find(database_uri);
+    if (itr == index_shard.sessions_by_database.end()) {
+      return absl::OkStatus();
+    }
+    sessions = std::move(itr->second);
+    index_shard.sessions_by_database.erase(itr);
+  }
+  std::vector<std::string> session_uris;
+  session_uris.reserve(sessions.size());
+  for (const auto& [session_uri, session] : sessions) {
+    Shard& shard = ShardFor(session_uri);
+    absl::MutexLock lock(&shard.mu);
+    shard.sessions.erase(session_uri);
+    session_uris.push_back(session_uri);
+  }
+  CancelExpiry(session_uris);
   return absl::OkStatus();
 }
 
@@ -17,8 +17,18 @@
 #ifndef STORAGE_CLOUD_SPANNER_EMULATOR_FRONTEND_SESSION_MANAGER_H_
 #define STORAGE_CLOUD_SPANNER_EMULATOR_FRONTEND_SESSION_MANAGER_H_
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "common/clock.h"
+#include "common/timer_service.h"
 #include "frontend/entities/database.h"
 #include "frontend/entities/session.h"
 #include "absl/status/status.h"
@@ -30,40 +40,148 @@ namespace emulator {
 namespace frontend {
 
 // Session manager manages the set of active sessions in the emulator.
+//
+// Sessions are spread across shards by a hash of their URI, each guarded by
+// its own mutex, so that concurrent RPCs looking up different sessions rarely
+// contend. Sessions are also indexed by the URI of their database, so that
+// listing or deleting the sessions of a database only visits the sessions it
+// owns. Sessions idle for longer than kMaxSessionIdleTime expire: they are no
+// longer returned, and are removed by a timer of each session, or by periodic
+// sweeps if the manager has no timers. Expired sessions drop their
+// transactions, which releases their locks.
 class SessionManager {
  public:
-  explicit SessionManager(Clock* clock) : clock_(clock) {}
+  // Sessions not used for this long are deleted.
+  static constexpr absl::Duration kMaxSessionIdleTime = absl::Hours(1);
+
+  // If `timers` is not null, it runs the timers expiring sessions and idle
+  // transactions, and must outlive the manager.
+  explicit SessionManager(Clock* clock, TimerService* timers = nullptr)
+      : clock_(clock), timers_(timers) {}
+
+  // Cancels the timers of the sessions.
+  ~SessionManager();
 
   // Creates a session attached to the given database.
   zetasql_base::StatusOr<std::shared_ptr<Session>> CreateSession(
-      const Labels& labels, std::shared_ptr<Database> database)
-      ABSL_LOCKS_EXCLUDED(mu_);
+      const Labels& labels, std::shared_ptr<Database> database);
+
+  // Creates `count` sessions attached to the given database, with the same
+  // labels and creation time. Their ids are reserved at once, and each shard
+  // and the database index are locked once for all the sessions they receive.
+  zetasql_base::StatusOr<std::vector<std::shared_ptr<Session>>> CreateSessions(
+      const Labels& labels, std::shared_ptr<Database> database, int count);
 
   // Returns a session with the given URI.
   zetasql_base::StatusOr<std::shared_ptr<Session>> GetSession(
-      const std::string& session_uri) ABSL_LOCKS_EXCLUDED(mu_);
+      const std::string& session_uri);
 
   // Deletes a session with the given URI.
-  absl::Status DeleteSession(const std::string& session_uri)
-      ABSL_LOCKS_EXCLUDED(mu_);
+  absl::Status DeleteSession(const std::string& session_uri);
+
+  // Deletes all sessions attached to the given database URI.
+  absl::Status DeleteSessions(const std::string& database_uri);
 
-  // Lists sessions attached to the given database URI.
+  // Lists sessions attached to the given database URI, sorted by session URI.
   zetasql_base::StatusOr<std::vector<std::shared_ptr<Session>>> ListSessions(
-      const std::string& database_uri) const ABSL_LOCKS_EXCLUDED(mu_);
+      const std::string& database_uri) const;
 
  private:
+  // Number of shards the sessions are spread across.
+  static constexpr int kNumShards = 16;
+
+  // Minimum time between two sweeps of expired sessions from a shard.
+  static constexpr absl::Duration kSweepInterval = absl::Minutes(1);
+
+  struct Shard {
+    // Mutex to guard state below.
+    mutable absl::Mutex mu;
+
+    // Map from session URI to session objects.
+    absl::flat_hash_map<std::string, std::shared_ptr<Session>> sessions
+        ABSL_GUARDED_BY(mu);
+
+    // Last time expired sessions were removed from this shard.
+    absl::Time last_sweep_time ABSL_GUARDED_BY(mu) = absl::InfinitePast();
+
+    // Timer expiring each session, by session URI, if the manager has timers.
+    // Entries of sessions which were removed otherwise are dropped once their
+    // timer fires.
+    absl::flat_hash_map<std::string, TimerService::TimerId> expiry_timers
+        ABSL_GUARDED_BY(mu);
+  };
+
+  // Sessions of the databases whose URIs hash to a shard of the index.
+  struct DatabaseIndexShard {
+    // Mutex to guard state below.
+    mutable absl::Mutex mu;
+
+    // Map from database URI to the sessions of the database, by session URI.
+    absl::flat_hash_map<
+        std::string, absl::flat_hash_map<std::string, std::shared_ptr<Session>>>
+        sessions_by_database ABSL_GUARDED_BY(mu);
+  };
+
+  // Returns the shard holding the session with the given URI.
+  Shard& ShardFor(const std::string& session_uri);
+
+  // Returns the index shard holding the sessions of the given database URI.
+  DatabaseIndexShard& IndexShardFor(const std::string& database_uri);
+  const DatabaseIndexShard& IndexShardFor(
+      const std::string& database_uri) const;
+
+  // Adds `session` to the sessions of its database in the index.
+  void AddToDatabaseIndex(const std::shared_ptr<Session>& session);
+
+  // Adds `sessions`, all of the database with the given URI, to the index.
+  void AddToDatabaseIndex(
+      const std::string& database_uri,
+      const std::vector<std::shared_ptr<Session>>& sessions);
+
+  // Removes the session with the given URI from the sessions of its database
+  // in the index.
+  void RemoveFromDatabaseIndex(const std::string& session_uri);
+
+  // Returns true if `session` has not been used since its idle time expired.
+  bool IsExpired(const Session& session, absl::Time now) const;
+
+  // Removes expired sessions from `shard` if it was not swept recently, and
+  // returns the URIs of the removed sessions, which are still to be removed
+  // from the database index. Does nothing if the manager has timers.
+  std::vector<std::string> MaybeSweepShard(Shard* shard, absl::Time now)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(shard->mu);
+
+  // Schedules the timer expiring the session with the given URI at
+  // `deadline`, if the manager has timers.
+  void ScheduleExpiry(Shard* shard, const std::string& session_uri,
+                      absl::Time deadline)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(shard->mu);
+
+  // Removes the session with the given URI if it expired, or else schedules
+  // its timer again for when it may next expire.
+  void ExpireSession(const std::string& session_uri);
+
+  // Cancels the timers of the sessions with the given URIs.
+  void CancelExpiry(const std::vector<std::string>& session_uris);
+
   // System-wide clock.
   Clock* clock_;
 
-  // Mutex to guard state below.
-  mutable absl::Mutex mu_;
+  // Timers expiring sessions and idle transactions, or null.
+  TimerService* const timers_;
+
+  // Set by the destructor, after which timers are no longer scheduled.
+  std::atomic<bool> stopping_{false};
 
   // Counter for session ids.
-  int next_session_id_ ABSL_GUARDED_BY(mu_) = 0;
+  std::atomic<int64_t> next_session_id_{0};
+
+  std::array<Shard, kNumShards> shards_;
 
-  // Map from session URI to session objects.
-  std::map<std::string, std::shared_ptr<Session>> session_map_
-      ABSL_GUARDED_BY(mu_);
+  // Index of the sessions by database URI. A session is added to its shard
+  // before the index, and removed from the index after its shard, and the two
+  // mutexes are never held together.
+  std::array<DatabaseIndexShard, kNumShards> database_index_;
 };
 
 }  // namespace frontend
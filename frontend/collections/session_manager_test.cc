@@ -16,6 +16,12 @@
 
 #include "frontend/collections/session_manager.h"
 
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "zetasql/base/testing/status_matchers.h"
@@ -136,6 +142,114 @@ TEST_F(SessionManagerTest, ListSessionsWithSimilarPrefix) {
   }
 }
 
+TEST_F(SessionManagerTest, ListSessionsSkipsExpiredSessionsAndSortsByUri) {
+  std::vector<std::string> expected_uris;
+  for (int i = 0; i < 20; i++) {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        std::shared_ptr<Session> session,
+        session_manager_.CreateSession(test_labels_, database_));
+    if (i % 2 == 0) {
+      session->set_approximate_last_use_time(absl::Now() - absl::Hours(1.5));
+    } else {
+      expected_uris.push_back(session->session_uri());
+    }
+  }
+  std::sort(expected_uris.begin(), expected_uris.end());
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::vector<std::shared_ptr<Session>> actual,
+      session_manager_.ListSessions(database_->database_uri()));
+  std::vector<std::string> actual_uris;
+  for (const auto& session : actual) {
+    actual_uris.push_back(session->session_uri());
+  }
+  EXPECT_EQ(actual_uris, expected_uris);
+}
+
+TEST_F(SessionManagerTest, DeleteSessionsOnlyDeletesSessionsOfDatabase) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::shared_ptr<Database> other_database,
+      database_manager_.CreateDatabase(
+          "projects/test-p/instances/test-i/databases/other-database", {}));
+  std::vector<std::shared_ptr<Session>> sessions;
+  for (int i = 0; i < 5; i++) {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(
+        std::shared_ptr<Session> session,
+        session_manager_.CreateSession(test_labels_, database_));
+    sessions.push_back(session);
+  }
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::shared_ptr<Session> other_session,
+      session_manager_.CreateSession(test_labels_, other_database));
+
+  ZETASQL_ASSERT_OK(session_manager_.DeleteSessions(database_->database_uri()));
+  for (const auto& session : sessions) {
+    EXPECT_THAT(session_manager_.GetSession(session->session_uri()),
+                zetasql_base::testing::StatusIs(absl::StatusCode::kNotFound));
+  }
+  EXPECT_THAT(session_manager_.ListSessions(database_->database_uri()),
+              zetasql_base::testing::IsOkAndHolds(testing::IsEmpty()));
+  ZETASQL_EXPECT_OK(session_manager_.GetSession(other_session->session_uri()));
+  EXPECT_THAT(session_manager_.ListSessions(other_database->database_uri()),
+              zetasql_base::testing::IsOkAndHolds(testing::SizeIs(1)));
+}
+
+TEST_F(SessionManagerTest, DeleteSessionRemovesSessionFromList) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::shared_ptr<Session> session,
+                       session_manager_.CreateSession(test_labels_, database_));
+  ZETASQL_ASSERT_OK(session_manager_.DeleteSession(session->session_uri()));
+  EXPECT_THAT(session_manager_.ListSessions(database_->database_uri()),
+              zetasql_base::testing::IsOkAndHolds(testing::IsEmpty()));
+}
+
+TEST_F(SessionManagerTest, CreatesSessionsInBulk) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::shared_ptr<Session> single,
+                       session_manager_.CreateSession(test_labels_, database_));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::vector<std::shared_ptr<Session>> sessions,
+      session_manager_.CreateSessions(test_labels_, database_, 50));
+  ASSERT_EQ(sessions.size(), 50);
+  for (const std::shared_ptr<Session>& session : sessions) {
+    EXPECT_NE(session->session_uri(), single->session_uri());
+    EXPECT_EQ(session->create_time(), sessions.front()->create_time());
+    ZETASQL_ASSERT_OK_AND_ASSIGN(std::shared_ptr<Session> actual,
+                         session_manager_.GetSession(session->session_uri()));
+    EXPECT_EQ(actual, session);
+  }
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::vector<std::shared_ptr<Session>> listed,
+      session_manager_.ListSessions(database_->database_uri()));
+  EXPECT_EQ(listed.size(), 51);
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      sessions, session_manager_.CreateSessions(test_labels_, database_, 0));
+  EXPECT_TRUE(sessions.empty());
+}
+
+TEST_F(SessionManagerTest, ConcurrentlyCreatesAndGetsSessions) {
+  constexpr int kNumThreads = 8;
+  constexpr int kSessionsPerThread = 100;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([this]() {
+      for (int j = 0; j < kSessionsPerThread; ++j) {
+        auto session = session_manager_.CreateSession(test_labels_, database_);
+        ZETASQL_ASSERT_OK(session.status());
+        ZETASQL_EXPECT_OK(session_manager_.GetSession((*session)->session_uri()));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::vector<std::shared_ptr<Session>> actual,
+      session_manager_.ListSessions(database_->database_uri()));
+  EXPECT_EQ(actual.size(), kNumThreads * kSessionsPerThread);
+}
+
 }  // namespace frontend
 }  // namespace emulator
 }  // namespace spanner
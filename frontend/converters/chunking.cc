@@ -16,12 +16,15 @@
 
 #include "frontend/converters/chunking.h"
 
+#include <deque>
+#include <utility>
 #include <vector>
 
 #include "absl/memory/memory.h"
 #include "zetasql/base/statusor.h"
 #include "absl/strings/substitute.h"
 #include "common/errors.h"
+#include "common/utf8.h"
 #include "zetasql/base/status_macros.h"
 
 namespace google {
@@ -29,48 +32,6 @@ namespace spanner {
 namespace emulator {
 namespace frontend {
 
-namespace {
-
-// UTF-8 is at most 4 bytes. The follow chart explains the format of each
-// UTF-8 character.
-// Char. number range  |        UTF-8 octet sequence
-//    (hexadecimal)    |              (binary)
-// --------------------+---------------------------------------------
-// 0000 0000-0000 007F | 0xxxxxxx
-// 0000 0080-0000 07FF | 110xxxxx 10xxxxxx
-// 0000 0800-0000 FFFF | 1110xxxx 10xxxxxx 10xxxxxx
-// 0001 0000-0010 FFFF | 11110xxx 10xxxxxx 10xxxxxx 10xxxxxx
-//
-// More detail in the spec: https://tools.ietf.org/html/rfc3629#page-4
-const uint8_t kPartialUTF8Bytes = 1 << 7;  // 0b10000000
-const uint8_t kUTF8TwoBytes = 3 << 6;      // 0b11000000
-const uint8_t kUTF8ThreeBytes = 7 << 5;    // 0b11100000
-const uint8_t kUTF8FourBytes = 15 << 4;    // 0b11110000
-const int64_t kMaxUTF8CharSize = 4;
-
-bool IsPartialUTF8(char input) {
-  return (static_cast<int>(input) & kPartialUTF8Bytes) != 0;
-}
-
-int64_t RemovePartialUTF8(absl::string_view string, int64_t available) {
-  for (int64_t pos = available - 1;
-       pos >= std::max<int64_t>(available - kMaxUTF8CharSize, 0); pos--) {
-    char partial = string[pos];
-    // Only remove partial UTF-8 character.
-    if ((partial & kUTF8FourBytes) == kUTF8FourBytes) {
-      if (pos != available - 4) available = pos;
-      break;
-    } else if ((partial & kUTF8ThreeBytes) == kUTF8ThreeBytes) {
-      if (pos != available - 3) available = pos;
-      break;
-    } else if ((partial & kUTF8TwoBytes) == kUTF8TwoBytes) {
-      if (pos != available - 2) available = pos;
-      break;
-    }
-  }
-  return available;
-}
-
 // Constructs a set of PartialResultSets. Data will be chunked as necessary to
 // comply with the Cloud Spanner streaming chunk size limit. Only Strings and
 // Lists need to be chunked (Structs are not a valid column type and will return
@@ -79,7 +40,7 @@ class ResultSetBuilder {
  public:
   explicit ResultSetBuilder(
       int64_t max_chunk_size,
-      std::vector<google::spanner::v1::PartialResultSet>* results)
+      std::deque<google::spanner::v1::PartialResultSet>* results)
       : max_chunk_size_(max_chunk_size), results_(results) {
     if (results_->empty()) {
       results_->emplace_back();
@@ -89,8 +50,11 @@ class ResultSetBuilder {
   }
 
   // Adds the incoming value to the set of PartialResultSets chunking as
-  // necessary.
-  absl::Status AddValue(const protobuf::Value& value) {
+  // necessary. Values which fit into the current chunk are moved into it
+  // rather than copied, so that large STRING and BYTES payloads are not copied
+  // again after being converted to protos. Values which are split across
+  // chunks have each of their pieces copied exactly once.
+  absl::Status AddValue(protobuf::Value value) {
     // If the current size exceeds the limit, create a new chunk.
     if (HasExceededChunkLimit()) {
       StartNewResultSet();
@@ -106,11 +70,15 @@ class ResultSetBuilder {
       case protobuf::Value::kListValue: {
         // Check if list can fit into current chunk.
         if (current_chunk_size_ + value_size <= max_chunk_size_) {
-          AddUnchunkedValue(value);
+          AddUnchunkedValue(std::move(value), value_size);
+        } else if (FitsIntoNewChunk(value_size)) {
+          StartNewResultSet();
+          AddUnchunkedValue(std::move(value), value_size);
         } else {
           StartList();
-          for (const auto& list_value : value.list_value().values()) {
-            ZETASQL_RETURN_IF_ERROR(AddValue(list_value));
+          for (auto& list_value :
+               *value.mutable_list_value()->mutable_values()) {
+            ZETASQL_RETURN_IF_ERROR(AddValue(std::move(list_value)));
           }
           FinishList();
         }
@@ -120,7 +88,10 @@ class ResultSetBuilder {
       case protobuf::Value::kStringValue: {
         // Check if string can fit into current chunk.
         if (current_chunk_size_ + value_size <= max_chunk_size_) {
-          AddUnchunkedValue(value);
+          AddUnchunkedValue(std::move(value), value_size);
+        } else if (FitsIntoNewChunk(value_size)) {
+          StartNewResultSet();
+          AddUnchunkedValue(std::move(value), value_size);
         } else {
           AddString(value.string_value());
         }
@@ -130,7 +101,7 @@ class ResultSetBuilder {
       case protobuf::Value::kBoolValue:
       case protobuf::Value::kNumberValue:
       case protobuf::Value::kNullValue:
-        AddUnchunkedValue(value);
+        AddUnchunkedValue(std::move(value), value_size);
         break;
 
       default:
@@ -152,13 +123,25 @@ class ResultSetBuilder {
 
   bool IsListOpen() { return stack_.size() > 1; }
 
+  // Returns true if a top-level value of `value_size` bytes which does not fit
+  // into the current chunk fits into a new one. Such values are moved whole
+  // into the next chunk rather than split, so that clients do not need to
+  // merge them back together. Values nested in lists are always split, since
+  // the lists holding them are split anyway.
+  bool FitsIntoNewChunk(size_t value_size) {
+    return !IsListOpen() && !stack_.back()->empty() &&
+           value_size <= max_chunk_size_;
+  }
+
   // Adds a value as the next value without chunking. The value will be added to
   // a list if there are any nested lists otherwise it will be added as the next
   // value in results. Used for the fast path when it is known this will not
-  // need to be chunked.
-  void AddUnchunkedValue(const protobuf::Value& value) {
-    *stack_.back()->Add() = value;
-    current_chunk_size_ += value.ByteSizeLong();
+  // need to be chunked. `value_size` is the serialized size of `value`.
+  void AddUnchunkedValue(protobuf::Value value, size_t value_size) {
+    // Moving a proto into a message on the same (heap) arena swaps its
+    // contents instead of copying them.
+    *stack_.back()->Add() = std::move(value);
+    current_chunk_size_ += value_size;
   }
 
   // If a nested list ends at the boundary of the chunk, we need to make sure
@@ -207,9 +190,7 @@ class ResultSetBuilder {
       if (str.size() > available) {
         // Strings are UTF-8 encoded. Not all client libraries support a split
         // UTF-8 character. Flush the entire and not partial UTF-8 character.
-        if (available > 0 && IsPartialUTF8(str[available - 1])) {
-          available = RemovePartialUTF8(str, available);
-        }
+        available = Utf8PrefixLength(str, available);
         // Chunk the string into pieces.
         AddUnchunkedString(str.substr(0, available));
         results_->back().set_chunked_value(true);
@@ -276,7 +257,7 @@ class ResultSetBuilder {
   int64_t max_chunk_size_;
 
   // The list of PartialResultSets that store the resulting chunks.
-  std::vector<::google::spanner::v1::PartialResultSet>* results_;
+  std::deque<::google::spanner::v1::PartialResultSet>* results_;
 
   // The list stack is used to track nested lists. When a result set is chunked
   // all current lists need to be truncated and matching versions created in the
@@ -284,22 +265,72 @@ class ResultSetBuilder {
   std::vector<google::protobuf::RepeatedPtrField<protobuf::Value>*> stack_;
 };
 
-}  // namespace
+ResultSetChunker::ResultSetChunker(
+    const google::spanner::v1::ResultSetMetadata& metadata,
+    int64_t max_chunk_size, ResumeTokenFn resume_token)
+    : resume_token_(std::move(resume_token)) {
+  chunks_.emplace_back();
+  *chunks_.front().mutable_metadata() = metadata;
+  builder_ = absl::make_unique<ResultSetBuilder>(max_chunk_size, &chunks_);
+}
+
+ResultSetChunker::~ResultSetChunker() = default;
+
+absl::Status ResultSetChunker::AddValue(protobuf::Value value) {
+  ZETASQL_RETURN_IF_ERROR(builder_->AddValue(std::move(value)));
+  if (row_boundary_chunk_ != nullptr) {
+    // The chunk holding the end of the last row ends on the row boundary if
+    // the value was added to a new chunk in full. Chunks are never removed
+    // while being filled, so the pointer is still valid.
+    if (row_boundary_chunk_ != &chunks_.back() &&
+        row_boundary_chunk_->values_size() == row_boundary_values_) {
+      row_boundary_chunk_->set_resume_token(resume_token_(rows_));
+    }
+    row_boundary_chunk_ = nullptr;
+  }
+  return absl::OkStatus();
+}
+
+void ResultSetChunker::EndRow() {
+  ++rows_;
+  if (resume_token_ != nullptr) {
+    row_boundary_chunk_ = &chunks_.back();
+    row_boundary_values_ = row_boundary_chunk_->values_size();
+  }
+}
+
+std::vector<google::spanner::v1::PartialResultSet>
+ResultSetChunker::TakeCompletedChunks() {
+  std::vector<google::spanner::v1::PartialResultSet> completed;
+  while (chunks_.size() > 1) {
+    completed.push_back(std::move(chunks_.front()));
+    chunks_.pop_front();
+  }
+  return completed;
+}
+
+std::vector<google::spanner::v1::PartialResultSet> ResultSetChunker::Finish() {
+  // The last chunk carries no resume token, since there is nothing left to
+  // resume after it.
+  row_boundary_chunk_ = nullptr;
+  builder_.reset();
+  std::vector<google::spanner::v1::PartialResultSet> remaining(
+      std::make_move_iterator(chunks_.begin()),
+      std::make_move_iterator(chunks_.end()));
+  chunks_.clear();
+  return remaining;
+}
 
 zetasql_base::StatusOr<std::vector<google::spanner::v1::PartialResultSet>>
 ChunkResultSet(const google::spanner::v1::ResultSet& set,
                int64_t max_chunk_size) {
-  std::vector<google::spanner::v1::PartialResultSet> results;
-  results.emplace_back();
-  *results.front().mutable_metadata() = set.metadata();
-
-  ResultSetBuilder builder(max_chunk_size, &results);
+  ResultSetChunker chunker(set.metadata(), max_chunk_size);
   for (const auto& row : set.rows()) {
     for (const auto& value : row.values()) {
-      ZETASQL_RETURN_IF_ERROR(builder.AddValue(value));
+      ZETASQL_RETURN_IF_ERROR(chunker.AddValue(value));
     }
   }
-  return results;
+  return chunker.Finish();
 }
 
 }  // namespace frontend
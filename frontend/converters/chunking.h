@@ -17,6 +17,10 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_CONVERTERS_CHUNKING_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_CONVERTERS_CHUNKING_H_
 
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "google/protobuf/struct.pb.h"
@@ -30,6 +34,79 @@ namespace spanner {
 namespace emulator {
 namespace frontend {
 
+class ResultSetBuilder;
+
+// ResultSetChunker incrementally chunks a stream of values into
+// PartialResultSets.
+//
+// Unlike ChunkResultSet, this does not need the whole result to be converted
+// to a ResultSet up front: values are added one at a time and every chunk
+// except the one currently being filled can be taken (and sent) as soon as
+// it is complete, so only about one chunk is buffered at any time.
+//
+// Typical usage:
+//
+//   ResultSetChunker chunker(metadata, max_chunk_size);
+//   for (each value) {
+//     ZETASQL_RETURN_IF_ERROR(chunker.AddValue(value));
+//     for (auto& chunk : chunker.TakeCompletedChunks()) Send(chunk);
+//   }
+//   for (auto& chunk : chunker.Finish()) Send(chunk);
+class ResultSetChunker {
+ public:
+  // Returns the resume token of a chunk which ends after `rows` rows.
+  using ResumeTokenFn = std::function<std::string(int64_t rows)>;
+
+  // The first chunk will carry `metadata`. If `resume_token` is set, chunks
+  // other than the last one which end on a row boundary carry the token it
+  // returns for the rows ended so far.
+  ResultSetChunker(const google::spanner::v1::ResultSetMetadata& metadata,
+                   int64_t max_chunk_size,
+                   ResumeTokenFn resume_token = nullptr);
+  ~ResultSetChunker();
+
+  // Adds the next value of the result, chunking it as necessary. Callers which
+  // no longer need `value` should move it in, so that string payloads which
+  // fit into the current chunk are not copied.
+  absl::Status AddValue(google::protobuf::Value value);
+
+  // Marks the end of a row, after its values were added. The current chunk
+  // ends on a row boundary if the next value starts a new chunk.
+  void EndRow();
+
+  // Removes and returns the chunks which are complete, i.e. all chunks except
+  // the one currently being filled.
+  std::vector<google::spanner::v1::PartialResultSet> TakeCompletedChunks();
+
+  // Removes and returns all remaining chunks, including the one currently
+  // being filled, which is returned even if it is empty. No values may be
+  // added afterwards.
+  std::vector<google::spanner::v1::PartialResultSet> Finish();
+
+ private:
+  ResultSetChunker(const ResultSetChunker&) = delete;
+  ResultSetChunker& operator=(const ResultSetChunker&) = delete;
+
+  // Chunks produced so far. A deque is used so that taking completed chunks
+  // from the front does not move the chunk being filled by `builder_`.
+  std::deque<google::spanner::v1::PartialResultSet> chunks_;
+
+  // Builder which appends values to `chunks_`.
+  std::unique_ptr<ResultSetBuilder> builder_;
+
+  // Returns the resume tokens of chunks, if they carry any.
+  ResumeTokenFn resume_token_;
+
+  // Number of rows ended so far.
+  int64_t rows_ = 0;
+
+  // The chunk which was being filled when the last row ended, and the number
+  // of values it held at that point, until the next value is added. Null if
+  // resume tokens are not returned or a value was added since.
+  google::spanner::v1::PartialResultSet* row_boundary_chunk_ = nullptr;
+  int row_boundary_values_ = 0;
+};
+
 // Takes a ResultSet and chunks it into smaller pieces as necessary. Each
 // resulting piece will have a size <= max_chunk_size. Returns an ordered list
 // of PartialResultSets or an error.
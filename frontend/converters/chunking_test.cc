@@ -26,6 +26,7 @@
 #include "zetasql/base/testing/status_matchers.h"
 #include "tests/common/proto_matchers.h"
 #include "absl/random/random.h"
+#include "absl/strings/str_cat.h"
 #include "absl/time/time.h"
 #include "common/limits.h"
 #include "frontend/converters/reads.h"
@@ -708,6 +709,138 @@ TEST(ChunkingTest, RandomChunking) {
   }
 }
 
+TEST(ChunkingTest, ChunkerReleasesCompletedChunksIncrementally) {
+  const size_t kChunkSize = 18;
+  google::spanner::v1::ResultSetMetadata metadata;
+  ResultSetChunker chunker(metadata, kChunkSize);
+
+  // Nothing is complete until a chunk fills up.
+  google::protobuf::Value value;
+  value.set_string_value("abcdefgh");
+  ZETASQL_ASSERT_OK(chunker.AddValue(value));
+  EXPECT_TRUE(chunker.TakeCompletedChunks().empty());
+
+  // Splitting a string across chunks completes the first chunk.
+  value.set_string_value("ijklmnopqrstuvwxyz");
+  ZETASQL_ASSERT_OK(chunker.AddValue(value));
+  std::vector<PartialResultSet> completed = chunker.TakeCompletedChunks();
+  EXPECT_THAT(completed, testing::ElementsAre(test::EqualsProto(R"(
+                metadata {}
+                values { string_value: "abcdefgh" }
+                values { string_value: "ijklmn" }
+                chunked_value: true
+              )")));
+  EXPECT_TRUE(chunker.TakeCompletedChunks().empty());
+
+  EXPECT_THAT(chunker.Finish(), testing::ElementsAre(test::EqualsProto(R"(
+                values { string_value: "opqrstuvwxyz" }
+              )")));
+}
+
+TEST(ChunkingTest, ChunkerDoesNotSplitValuesWhichFitIntoANewChunk) {
+  const size_t kChunkSize = 18;
+  google::spanner::v1::ResultSetMetadata metadata;
+  ResultSetChunker chunker(metadata, kChunkSize);
+
+  google::protobuf::Value value;
+  value.set_string_value("abcdefgh");
+  ZETASQL_ASSERT_OK(chunker.AddValue(value));
+  value.set_string_value("ijklmnop");
+  ZETASQL_ASSERT_OK(chunker.AddValue(value));
+
+  // The second string does not fit after the first one, but is moved whole
+  // into the next chunk.
+  EXPECT_THAT(chunker.Finish(),
+              testing::ElementsAre(test::EqualsProto(R"(
+                                     metadata {}
+                                     values { string_value: "abcdefgh" }
+                                   )"),
+                                   test::EqualsProto(R"(
+                                     values { string_value: "ijklmnop" }
+                                   )")));
+}
+
+TEST(ChunkingTest, ChunkerSetsResumeTokensOnRowBoundaries) {
+  const size_t kChunkSize = 18;
+  google::spanner::v1::ResultSetMetadata metadata;
+  ResultSetChunker chunker(metadata, kChunkSize, [](int64_t rows) {
+    return absl::StrCat("rows:", rows);
+  });
+
+  // The first chunk ends within the second row, so it carries no token.
+  google::protobuf::Value value;
+  value.set_string_value("abcdefgh");
+  ZETASQL_ASSERT_OK(chunker.AddValue(value));
+  chunker.EndRow();
+  value.set_string_value("ijklmnopqrstuvwxyz");
+  ZETASQL_ASSERT_OK(chunker.AddValue(value));
+  chunker.EndRow();
+
+  // The second chunk ends with the second row. The last one carries no token,
+  // since the stream ends with it.
+  value.set_string_value("0123456789abcdef");
+  ZETASQL_ASSERT_OK(chunker.AddValue(value));
+  chunker.EndRow();
+
+  std::vector<PartialResultSet> results = chunker.Finish();
+  ASSERT_EQ(3, results.size());
+  EXPECT_EQ("", results[0].resume_token());
+  EXPECT_EQ("rows:2", results[1].resume_token());
+  EXPECT_EQ("", results[2].resume_token());
+}
+
+TEST(ChunkingTest, ChunkerMovesUnchunkedStringsWithoutCopying) {
+  google::spanner::v1::ResultSetMetadata metadata;
+  ResultSetChunker chunker(metadata, limits::kMaxStreamingChunkSize);
+
+  google::protobuf::Value value;
+  value.set_string_value(std::string(64 * 1024, 'a'));
+  const char* payload = value.string_value().data();
+  ZETASQL_ASSERT_OK(chunker.AddValue(std::move(value)));
+
+  // The chunk holds the original string buffer.
+  std::vector<PartialResultSet> results = chunker.Finish();
+  ASSERT_EQ(1, results.size());
+  ASSERT_EQ(1, results[0].values_size());
+  EXPECT_EQ(payload, results[0].values(0).string_value().data());
+}
+
+TEST(ChunkingTest, ChunkerMatchesChunkResultSet) {
+  int64_t time = absl::ToUnixNanos(absl::Now());
+  std::seed_seq seed({time});
+  absl::BitGen gen(seed);
+  LOG(INFO) << "Testing incremental chunking with seed: " << time;
+
+  for (int i = 0; i < 20; ++i) {
+    const size_t kChunkSize =
+        absl::Uniform<size_t>(absl::IntervalClosedClosed, gen, 40, 1000);
+    ZETASQL_ASSERT_OK_AND_ASSIGN(ResultSet result,
+                         backend::test::GenerateRandomResultSet(&gen, 100));
+    ZETASQL_ASSERT_OK_AND_ASSIGN(std::vector<PartialResultSet> expected,
+                         ChunkResultSet(result, kChunkSize));
+
+    // Take completed chunks after every value, as a streaming caller would.
+    ResultSetChunker chunker(result.metadata(), kChunkSize);
+    std::vector<PartialResultSet> results;
+    for (const auto& row : result.rows()) {
+      for (const auto& value : row.values()) {
+        ZETASQL_ASSERT_OK(chunker.AddValue(value));
+        for (auto& chunk : chunker.TakeCompletedChunks()) {
+          results.push_back(std::move(chunk));
+        }
+      }
+    }
+    for (auto& chunk : chunker.Finish()) {
+      results.push_back(std::move(chunk));
+    }
+
+    ASSERT_EQ(expected.size(), results.size());
+    for (int j = 0; j < expected.size(); ++j) {
+      EXPECT_THAT(results[j], test::EqualsProto(expected[j]));
+    }
+  }
+}
+
 }  // namespace
 
 }  // namespace frontend
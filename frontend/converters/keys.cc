@@ -23,6 +23,8 @@
 #include "backend/schema/catalog/table.h"
 #include "common/errors.h"
 #include "frontend/converters/values.h"
+#include "zetasql/base/ret_check.h"
+#include "zetasql/base/status_macros.h"
 
 namespace google {
 namespace spanner {
@@ -144,6 +146,57 @@ zetasql_base::StatusOr<backend::KeySet> KeySetFromProto(
   return key_set;
 }
 
+zetasql_base::StatusOr<google::protobuf::ListValue> KeyToProto(
+    const backend::Key& key) {
+  google::protobuf::ListValue list_pb;
+  for (int i = 0; i < key.NumColumns(); ++i) {
+    ZETASQL_ASSIGN_OR_RETURN(*list_pb.add_values(),
+                     ValueToProto(key.ColumnValue(i)));
+  }
+  return list_pb;
+}
+
+zetasql_base::StatusOr<spanner_api::KeyRange> KeyRangeToProto(
+    const backend::KeyRange& range) {
+  const backend::KeyRange closed_open = range.ToClosedOpen();
+  spanner_api::KeyRange range_pb;
+
+  // A closed start at K+ excludes every key prefixed by K, like an open start
+  // at K.
+  const backend::Key& start_key = closed_open.start_key();
+  ZETASQL_RET_CHECK(!start_key.IsInfinity())
+      << "Cannot convert key range " << range << " starting at infinity";
+  ZETASQL_ASSIGN_OR_RETURN(*(start_key.IsPrefixLimit()
+                         ? range_pb.mutable_start_open()
+                         : range_pb.mutable_start_closed()),
+                   KeyToProto(start_key));
+
+  // An open limit at K+ includes every key prefixed by K, like a closed end at
+  // K. The end of the key space is the closed end of the empty key.
+  const backend::Key& limit_key = closed_open.limit_key();
+  if (limit_key.IsInfinity()) {
+    range_pb.mutable_end_closed();
+  } else {
+    ZETASQL_ASSIGN_OR_RETURN(*(limit_key.IsPrefixLimit()
+                           ? range_pb.mutable_end_closed()
+                           : range_pb.mutable_end_open()),
+                     KeyToProto(limit_key));
+  }
+  return range_pb;
+}
+
+zetasql_base::StatusOr<spanner_api::KeySet> KeySetToProto(
+    const backend::KeySet& key_set) {
+  spanner_api::KeySet key_set_pb;
+  for (const backend::Key& key : key_set.keys()) {
+    ZETASQL_ASSIGN_OR_RETURN(*key_set_pb.add_keys(), KeyToProto(key));
+  }
+  for (const backend::KeyRange& range : key_set.ranges()) {
+    ZETASQL_ASSIGN_OR_RETURN(*key_set_pb.add_ranges(), KeyRangeToProto(range));
+  }
+  return key_set_pb;
+}
+
 }  // namespace frontend
 }  // namespace emulator
 }  // namespace spanner
@@ -42,6 +42,21 @@ zetasql_base::StatusOr<backend::KeyRange> KeyRangeFromProto(
 zetasql_base::StatusOr<backend::KeySet> KeySetFromProto(
     const google::spanner::v1::KeySet& key_set_pb, const backend::Table& table);
 
+// Converts a backend Key to a CloudSpanner key proto (encoded as a list).
+zetasql_base::StatusOr<google::protobuf::ListValue> KeyToProto(
+    const backend::Key& key);
+
+// Converts a backend KeyRange to a CloudSpanner key range proto. Prefix limit
+// keys, such as those of ranges made closed-open, become open starts and
+// closed ends of their prefix, so that converting the proto back with
+// KeyRangeFromProto yields an equivalent range.
+zetasql_base::StatusOr<google::spanner::v1::KeyRange> KeyRangeToProto(
+    const backend::KeyRange& range);
+
+// Converts a backend KeySet to a Cloud Spanner key set proto.
+zetasql_base::StatusOr<google::spanner::v1::KeySet> KeySetToProto(
+    const backend::KeySet& key_set);
+
 }  // namespace frontend
 }  // namespace emulator
 }  // namespace spanner
@@ -72,19 +72,22 @@ absl::Status WriteFromProto(const backend::Schema& schema,
     return error::MissingRequiredFieldError("Write.values");
   }
 
-  // Populate the list of values for the rows that will be written to.
-  std::vector<backend::ValueList> value_list;
-  for (const google::protobuf::ListValue& values : write_pb.values()) {
-    backend::ValueList row_values;
+  // Populate the list of values for the rows that will be written to. Values
+  // are decoded directly into their final place in the op, since bulk-load
+  // commits carry tens of thousands of them.
+  std::vector<backend::ValueList> value_list(write_pb.values_size());
+  for (int row = 0; row < write_pb.values_size(); ++row) {
+    const google::protobuf::ListValue& values = write_pb.values(row);
     if (values.values_size() != columns.size()) {
       return error::MutationColumnAndValueSizeMismatch(columns.size(),
                                                        values.values_size());
     }
+    backend::ValueList& row_values = value_list[row];
+    row_values.reserve(columns.size());
     for (int i = 0; i < columns.size(); ++i) {
       ZETASQL_ASSIGN_OR_RETURN(row_values.emplace_back(),
                        ValueFromProto(values.values(i), columns[i]->GetType()));
     }
-    value_list.push_back(std::move(row_values));
   }
   mutation->AddWriteOp(op_type, table->Name(), std::move(column_names),
                        std::move(value_list));
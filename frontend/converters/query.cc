@@ -16,10 +16,17 @@
 
 #include "frontend/converters/query.h"
 
+#include <cstdint>
 #include <map>
+#include <string>
 
+#include "google/protobuf/struct.pb.h"
+#include "google/spanner/v1/query_plan.pb.h"
 #include "zetasql/public/type.h"
 #include "zetasql/base/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "backend/query/query_profile.h"
 #include "frontend/converters/types.h"
 #include "frontend/converters/values.h"
 
@@ -28,9 +35,23 @@ namespace spanner {
 namespace emulator {
 namespace frontend {
 
+namespace {
+
+// Sets `name` in the execution stats of a plan node to a total of `value`, in
+// units of `unit`, the format used by Cloud Spanner.
+void SetExecutionStat(const std::string& name, const std::string& value,
+                      const std::string& unit, google::protobuf::Struct* stats) {
+  auto* fields = (*stats->mutable_fields())[name].mutable_struct_value();
+  (*fields->mutable_fields())["total"].set_string_value(value);
+  (*fields->mutable_fields())["unit"].set_string_value(unit);
+}
+
+}  // namespace
+
 zetasql_base::StatusOr<backend::Query> QueryFromProto(
     std::string sql, const google::protobuf::Struct& params,
-    google::protobuf::Map<std::string, google::spanner::v1::Type> param_types,
+    const google::protobuf::Map<std::string, google::spanner::v1::Type>&
+        param_types,
     zetasql::TypeFactory* type_factory) {
   std::map<std::string, zetasql::Value> declared;
   std::map<std::string, google::protobuf::Value> undeclared;
@@ -49,6 +70,35 @@ zetasql_base::StatusOr<backend::Query> QueryFromProto(
   return backend::Query{sql, std::move(declared), std::move(undeclared)};
 }
 
+void QueryPlanToProto(const backend::QueryProfile& profile,
+                      int64_t rows_returned,
+                      google::spanner::v1::QueryPlan* plan) {
+  const auto& nodes = profile.plan();
+  for (int i = 0; i < nodes.size(); ++i) {
+    const backend::QueryPlanNode& node = nodes[i];
+    google::spanner::v1::PlanNode* plan_node = plan->add_plan_nodes();
+    plan_node->set_index(i);
+    plan_node->set_kind(google::spanner::v1::PlanNode::RELATIONAL);
+    plan_node->set_display_name(node.display_name);
+    for (int child_index : node.child_indexes) {
+      plan_node->add_child_links()->set_child_index(child_index);
+    }
+    google::protobuf::Struct* stats = plan_node->mutable_execution_stats();
+    if (!node.table.empty()) {
+      (*plan_node->mutable_metadata()->mutable_fields())["scan_target"]
+          .set_string_value(node.table);
+      SetExecutionStat("rows", absl::StrCat(profile.rows_scanned(node.table)),
+                       "rows", stats);
+    } else if (i == 0) {
+      SetExecutionStat("rows", absl::StrCat(rows_returned), "rows", stats);
+      SetExecutionStat(
+          "cpu_time",
+          absl::StrCat(absl::ToDoubleMilliseconds(profile.cpu_time())),
+          "msecs", stats);
+    }
+  }
+}
+
 }  // namespace frontend
 }  // namespace emulator
 }  // namespace spanner
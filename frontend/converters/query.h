@@ -17,11 +17,14 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_CONVERTERS_QUERY_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_CONVERTERS_QUERY_H_
 
+#include <cstdint>
 #include <string>
 
 #include "google/protobuf/struct.pb.h"
+#include "google/spanner/v1/query_plan.pb.h"
 #include "google/spanner/v1/spanner.pb.h"
 #include "backend/query/query_engine.h"
+#include "backend/query/query_profile.h"
 #include "common/errors.h"
 #include "zetasql/base/statusor.h"
 
@@ -33,9 +36,17 @@ namespace frontend {
 // Converts the sql, params into backend query using given type factory.
 zetasql_base::StatusOr<backend::Query> QueryFromProto(
     std::string sql, const google::protobuf::Struct& params,
-    google::protobuf::Map<std::string, google::spanner::v1::Type> param_types,
+    const google::protobuf::Map<std::string, google::spanner::v1::Type>&
+        param_types,
     zetasql::TypeFactory* type_factory);
 
+// Converts the plan of a profiled query which returned `rows_returned` rows
+// into a query plan. Table scans report the rows read from their table, and the
+// root of the plan reports the rows returned and the CPU time of the query.
+void QueryPlanToProto(const backend::QueryProfile& profile,
+                      int64_t rows_returned,
+                      google::spanner::v1::QueryPlan* plan);
+
 }  // namespace frontend
 }  // namespace emulator
 }  // namespace spanner
@@ -16,6 +16,10 @@
 
 #include "frontend/converters/reads.h"
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include "google/protobuf/struct.pb.h"
 #include "google/spanner/v1/keys.pb.h"
 #include "google/spanner/v1/result_set.pb.h"
@@ -23,7 +27,12 @@
 #include "zetasql/public/type.h"
 #include "zetasql/public/value.h"
 #include "zetasql/base/statusor.h"
+#include "absl/strings/escaping.h"
 #include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "backend/access/read.h"
 #include "backend/access/write.h"
 #include "backend/datamodel/key.h"
 #include "backend/datamodel/key_range.h"
@@ -33,8 +42,11 @@
 #include "backend/schema/catalog/schema.h"
 #include "backend/schema/catalog/table.h"
 #include "backend/transaction/options.h"
+#include "common/config.h"
 #include "common/errors.h"
 #include "common/limits.h"
+#include "common/metrics.h"
+#include "common/trace.h"
 #include "frontend/converters/chunking.h"
 #include "frontend/converters/keys.h"
 #include "frontend/converters/partition.h"
@@ -42,6 +54,8 @@
 #include "frontend/converters/types.h"
 #include "frontend/converters/values.h"
 #include "frontend/proto/partition_token.pb.h"
+#include "frontend/proto/resume_token.pb.h"
+#include "farmhash.h"
 #include "absl/status/status.h"
 #include "zetasql/base/status_macros.h"
 
@@ -54,18 +68,8 @@ namespace spanner_api = ::google::spanner::v1;
 
 namespace {
 
-absl::Status ResultSetMetadataToProto(backend::RowCursor* cursor,
-                                      v1::ResultSetMetadata* metadata_pb) {
-  for (int i = 0; i < cursor->NumColumns(); ++i) {
-    auto* field_pb = metadata_pb->mutable_row_type()->add_fields();
-    field_pb->set_name(cursor->ColumnName(i));
-    ZETASQL_RETURN_IF_ERROR(
-        TypeToProto(cursor->ColumnType(i), field_pb->mutable_type()))
-        << " when converting column " << cursor->ColumnName(i) << " of type "
-        << cursor->ColumnType(i) << " at position " << i << " in row cursor";
-  }
-  return absl::OkStatus();
-}
+// Number of rows read from a cursor at once when converting it to a result set.
+constexpr int kRowBatchSize = 256;
 
 absl::Status ValidateStaleness(absl::Duration staleness) {
   if (staleness < absl::ZeroDuration()) {
@@ -127,6 +131,37 @@ absl::Status ValidatePartitionToken(
   return absl::OkStatus();
 }
 
+// Returns a converter for the values of each column of `cursor`.
+std::vector<ValueProtoConverter> ColumnConverters(backend::RowCursor* cursor) {
+  std::vector<ValueProtoConverter> converters;
+  converters.reserve(cursor->NumColumns());
+  for (int i = 0; i < cursor->NumColumns(); ++i) {
+    converters.emplace_back(cursor->ColumnType(i));
+  }
+  return converters;
+}
+
+// Returns `fingerprint` extended with the values of the current row of
+// `cursor`.
+uint64_t FingerprintRow(uint64_t fingerprint, backend::RowCursor* cursor) {
+  for (int i = 0; i < cursor->NumColumns(); ++i) {
+    fingerprint = farmhash::Fingerprint(
+        farmhash::Uint128(fingerprint, cursor->ColumnValue(i).HashCode()));
+  }
+  return fingerprint;
+}
+
+// Returns `fingerprint` extended with the values of row `r` of `batch`, like
+// FingerprintRow() for the same row of the cursor.
+uint64_t FingerprintBatchRow(uint64_t fingerprint,
+                             const backend::RowBatch& batch, int r) {
+  for (const backend::ColumnVector& column : batch.columns) {
+    fingerprint = farmhash::Fingerprint(
+        farmhash::Uint128(fingerprint, column.values[r].HashCode()));
+  }
+  return fingerprint;
+}
+
 }  // namespace
 
 zetasql_base::StatusOr<backend::ReadOnlyOptions> ReadOnlyOptionsFromProto(
@@ -190,11 +225,16 @@ absl::Status ReadArgFromProto(const backend::Schema& schema,
     return error::InvalidReadLimitWithPartitionToken();
   }
 
+  // Reads of a partition only return the rows of the key set within its key
+  // range, which were resolved when the partition token was created.
   auto key_set = request.key_set();
   if (!request.partition_token().empty()) {
     ZETASQL_ASSIGN_OR_RETURN(auto partition_token,
                      PartitionTokenFromString(request.partition_token()));
     ZETASQL_RETURN_IF_ERROR(ValidatePartitionToken(partition_token, request));
+    if (partition_token.schema_generation() != schema.generation()) {
+      return error::InvalidPartitionToken();
+    }
     key_set = partition_token.partitioned_key_set();
   }
 
@@ -218,33 +258,219 @@ absl::Status ReadArgFromProto(const backend::Schema& schema,
   return absl::OkStatus();
 }
 
+absl::Status ResultSetMetadataToProto(backend::RowCursor* cursor,
+                                      v1::ResultSetMetadata* metadata_pb) {
+  metadata_pb->mutable_row_type()->mutable_fields()->Reserve(
+      cursor->NumColumns());
+  for (int i = 0; i < cursor->NumColumns(); ++i) {
+    auto* field_pb = metadata_pb->mutable_row_type()->add_fields();
+    field_pb->set_name(cursor->ColumnName(i));
+    ZETASQL_RETURN_IF_ERROR(
+        TypeToProto(cursor->ColumnType(i), field_pb->mutable_type()))
+        << " when converting column " << cursor->ColumnName(i) << " of type "
+        << cursor->ColumnType(i) << " at position " << i << " in row cursor";
+  }
+  return absl::OkStatus();
+}
+
 absl::Status RowCursorToResultSetProto(backend::RowCursor* cursor, int limit,
                                        spanner_api::ResultSet* result_pb) {
   ZETASQL_RETURN_IF_ERROR(
       ResultSetMetadataToProto(cursor, result_pb->mutable_metadata()));
 
-  // Iterate over all rows and populate column values into ResultSet.
+  // Iterate over all rows, a batch at a time, and populate column values into
+  // ResultSet. The rows of each batch are reserved at once, rather than grown
+  // one row at a time.
+  const std::vector<ValueProtoConverter> converters = ColumnConverters(cursor);
+  backend::RowBatch batch;
   int row_count = 0;
-  while (cursor->Next()) {
-    auto* row_pb = result_pb->add_rows();
-    for (int i = 0; i < cursor->NumColumns(); ++i) {
-      ZETASQL_ASSIGN_OR_RETURN(*row_pb->add_values(),
-                       ValueToProto(cursor->ColumnValue(i)));
-    }
-    ++row_count;
-    if (limit > 0 && limit == row_count) {
+  while (limit <= 0 || row_count < limit) {
+    const int max_rows =
+        limit > 0 ? std::min(kRowBatchSize, limit - row_count) : kRowBatchSize;
+    if (!cursor->NextBatch(max_rows, &batch)) {
       break;
     }
+    result_pb->mutable_rows()->Reserve(result_pb->rows_size() +
+                                       batch.num_rows);
+    for (int r = 0; r < batch.num_rows; ++r) {
+      auto* row_pb = result_pb->add_rows();
+      row_pb->mutable_values()->Reserve(converters.size());
+      for (int i = 0; i < converters.size(); ++i) {
+        ZETASQL_RETURN_IF_ERROR(converters[i].Convert(batch.columns[i].values[r],
+                                              row_pb->add_values()));
+      }
+    }
+    row_count += batch.num_rows;
   }
 
-  return absl::OkStatus();
+  // Rows may be evaluated as the cursor is read, so errors can surface
+  // partway through.
+  return cursor->Status();
 }
 
 zetasql_base::StatusOr<std::vector<spanner_api::PartialResultSet>>
 RowCursorToPartialResultSetProtos(backend::RowCursor* cursor, int limit) {
-  spanner_api::ResultSet result_set;
-  ZETASQL_RETURN_IF_ERROR(RowCursorToResultSetProto(cursor, limit, &result_set));
-  return ChunkResultSet(result_set, limits::kMaxStreamingChunkSize);
+  std::vector<spanner_api::PartialResultSet> results;
+  ZETASQL_RETURN_IF_ERROR(StreamRowCursor(
+      cursor, limit,
+      [&results](spanner_api::PartialResultSet* response, bool last) {
+        results.push_back(std::move(*response));
+        return absl::OkStatus();
+      }));
+  return results;
+}
+
+std::string ResumeTokenToString(const ResumeToken& resume_token) {
+  std::string token_string;
+  absl::WebSafeBase64Escape(resume_token.SerializeAsString(), &token_string);
+  return token_string;
+}
+
+zetasql_base::StatusOr<ResumeToken> ResumeTokenFromString(
+    const std::string& token) {
+  std::string binary_string;
+  if (!absl::WebSafeBase64Unescape(token, &binary_string)) {
+    return error::InvalidResumeToken();
+  }
+
+  ResumeToken resume_token;
+  if (!resume_token.ParseFromString(binary_string) ||
+      resume_token.rows() < 0) {
+    return error::InvalidResumeToken();
+  }
+  return resume_token;
+}
+
+zetasql_base::StatusOr<spanner_api::TransactionSelector>
+ResumedTransactionSelector(
+    const spanner_api::TransactionSelector& selector,
+    const ResumeToken& resume_token) {
+  spanner_api::TransactionSelector resumed = selector;
+  if (resume_token.has_read_timestamp_nanos() && resumed.has_single_use() &&
+      resumed.single_use().has_read_only()) {
+    spanner_api::TransactionOptions::ReadOnly* read_only =
+        resumed.mutable_single_use()->mutable_read_only();
+    ZETASQL_ASSIGN_OR_RETURN(*read_only->mutable_read_timestamp(),
+                     TimestampToProto(absl::FromUnixNanos(
+                         resume_token.read_timestamp_nanos())));
+  }
+  return resumed;
+}
+
+absl::Status StreamRowCursor(backend::RowCursor* cursor, int limit,
+                             const PartialResultSetSender& send,
+                             int64_t* row_count,
+                             const ResumeOptions* resume) {
+  spanner_api::ResultSetMetadata metadata;
+  ZETASQL_RETURN_IF_ERROR(ResultSetMetadataToProto(cursor, &metadata));
+
+  // Skip the rows returned before the resume token, checking that they are
+  // the same as when it was created.
+  int64_t skipped_rows = 0;
+  uint64_t rows_fingerprint = 0;
+  ResultSetChunker::ResumeTokenFn resume_token;
+  if (resume != nullptr) {
+    const ResumeToken& resume_from = resume->resume_from;
+    while (skipped_rows < resume_from.rows() && cursor->Next()) {
+      rows_fingerprint = FingerprintRow(rows_fingerprint, cursor);
+      ++skipped_rows;
+    }
+    ZETASQL_RETURN_IF_ERROR(cursor->Status());
+    if (skipped_rows != resume_from.rows() ||
+        rows_fingerprint != resume_from.rows_fingerprint()) {
+      return error::ResumedStreamChanged();
+    }
+
+    // Tokens are only created for the chunks which end on a row boundary, at
+    // which point `rows_fingerprint` covers the rows before it.
+    resume_token = [&](int64_t rows) {
+      ResumeToken token;
+      token.set_rows(skipped_rows + rows);
+      token.set_rows_fingerprint(rows_fingerprint);
+      if (resume->read_timestamp.has_value()) {
+        token.set_read_timestamp_nanos(
+            absl::ToUnixNanos(*resume->read_timestamp));
+      }
+      return ResumeTokenToString(token);
+    };
+  }
+  ResultSetChunker chunker(
+      metadata,
+      std::clamp(config::streaming_chunk_size_bytes(),
+                 limits::kMinStreamingChunkSize,
+                 limits::kMaxStreamingChunkSize),
+      std::move(resume_token));
+
+  // Queues `chunks` for sending. The most recent chunk is held back in
+  // `pending` until it is known whether it is the last response.
+  absl::optional<spanner_api::PartialResultSet> pending;
+  auto enqueue =
+      [&](std::vector<spanner_api::PartialResultSet> chunks) -> absl::Status {
+    for (auto& chunk : chunks) {
+      if (pending.has_value()) {
+        ZETASQL_RETURN_IF_ERROR(send(&pending.value(), /*last=*/false));
+      }
+      pending = std::move(chunk);
+    }
+    return absl::OkStatus();
+  };
+
+  // Time spent converting and chunking rows, only tracked if metrics are
+  // enabled or the request is being traced.
+  const bool track_chunking = metrics::Enabled() || trace::Active();
+  const absl::Time chunking_start =
+      track_chunking ? absl::Now() : absl::InfinitePast();
+  absl::Duration chunking_time;
+
+  // Rows are read a batch at a time into the same RowBatch, whose column
+  // vectors keep their capacity from one batch to the next. Completed chunks
+  // are still queued after every row, so that only about one chunk is
+  // buffered.
+  const std::vector<ValueProtoConverter> converters = ColumnConverters(cursor);
+  backend::RowBatch batch;
+  google::protobuf::Value value;
+  int64_t rows = skipped_rows;
+  while (limit <= 0 || rows < limit) {
+    const int max_rows =
+        limit > 0 ? std::min<int64_t>(kRowBatchSize, limit - rows)
+                  : kRowBatchSize;
+    if (!cursor->NextBatch(max_rows, &batch)) {
+      break;
+    }
+    for (int r = 0; r < batch.num_rows; ++r) {
+      const absl::Time start =
+          track_chunking ? absl::Now() : absl::InfinitePast();
+      for (int i = 0; i < converters.size(); ++i) {
+        ZETASQL_RETURN_IF_ERROR(
+            converters[i].Convert(batch.columns[i].values[r], &value));
+        ZETASQL_RETURN_IF_ERROR(chunker.AddValue(std::move(value)));
+      }
+      if (resume != nullptr) {
+        rows_fingerprint = FingerprintBatchRow(rows_fingerprint, batch, r);
+      }
+      chunker.EndRow();
+      if (track_chunking) {
+        chunking_time += absl::Now() - start;
+      }
+      ZETASQL_RETURN_IF_ERROR(enqueue(chunker.TakeCompletedChunks()));
+    }
+    rows += batch.num_rows;
+  }
+
+  // Rows may be evaluated as the cursor is read, so errors can surface
+  // partway through.
+  ZETASQL_RETURN_IF_ERROR(cursor->Status());
+  ZETASQL_RETURN_IF_ERROR(enqueue(chunker.Finish()));
+  if (row_count != nullptr) {
+    *row_count = rows - skipped_rows;
+  }
+  if (track_chunking) {
+    static metrics::Histogram* const chunking_latency =
+        metrics::StageLatency("chunking");
+    chunking_latency->Record(chunking_time);
+    trace::RecordSpan("Chunking", chunking_start, chunking_time);
+  }
+  return send(&pending.value(), /*last=*/true);
 }
 
 }  // namespace frontend
@@ -17,6 +17,10 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_CONVERTERS_READS_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_CONVERTERS_READS_H_
 
+#include <functional>
+#include <string>
+#include <vector>
+
 #include "google/spanner/v1/mutation.pb.h"
 #include "google/spanner/v1/result_set.pb.h"
 #include "google/spanner/v1/spanner.pb.h"
@@ -26,7 +30,10 @@
 #include "backend/common/ids.h"
 #include "backend/schema/catalog/schema.h"
 #include "backend/transaction/options.h"
+#include "frontend/proto/resume_token.pb.h"
 #include "absl/status/status.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
 
 namespace google {
 namespace spanner {
@@ -41,6 +48,11 @@ absl::Status ReadArgFromProto(const backend::Schema& schema,
                               const google::spanner::v1::ReadRequest& request,
                               backend::ReadArg* read_arg);
 
+// Populates the ResultSetMetadata describing the columns of a RowCursor.
+absl::Status ResultSetMetadataToProto(
+    backend::RowCursor* cursor,
+    google::spanner::v1::ResultSetMetadata* metadata_pb);
+
 // Converts a RowCursor to a ResultSet proto.
 //
 // Only handles the types and values supported by Cloud Spanner. Invalid types
@@ -60,6 +72,58 @@ absl::Status RowCursorToResultSetProto(
 zetasql_base::StatusOr<std::vector<google::spanner::v1::PartialResultSet>>
 RowCursorToPartialResultSetProtos(backend::RowCursor* cursor, int limit);
 
+// Callback which receives each PartialResultSet produced by StreamRowCursor.
+// `last` is true for the final response of the stream. The callback may modify
+// the response before sending it. Returning an error stops the stream.
+using PartialResultSetSender = std::function<absl::Status(
+    google::spanner::v1::PartialResultSet* response, bool last)>;
+
+// Converts a resume token into a byte string.
+std::string ResumeTokenToString(const ResumeToken& resume_token);
+
+// Converts a byte string into a resume token. An empty string is the token of
+// a stream which returned no rows yet.
+zetasql_base::StatusOr<ResumeToken> ResumeTokenFromString(
+    const std::string& token);
+
+// Returns the transaction in which a stream is resumed from `resume_token`.
+// Single-use read-only transactions read at the same timestamp as the stream
+// which created the token, so that they return the same rows.
+zetasql_base::StatusOr<google::spanner::v1::TransactionSelector>
+ResumedTransactionSelector(
+    const google::spanner::v1::TransactionSelector& selector,
+    const ResumeToken& resume_token);
+
+// Options of a stream whose responses carry resume tokens.
+struct ResumeOptions {
+  // Token from which the stream is resumed. The rows returned before it are
+  // skipped, and must be the same as when it was created.
+  ResumeToken resume_from;
+
+  // Timestamp at which the rows are read, recorded in the tokens, if the
+  // stream reads in a read-only transaction.
+  absl::optional<absl::Time> read_timestamp;
+};
+
+// Streams a RowCursor as a sequence of PartialResultSet protos, chunked as in
+// RowCursorToPartialResultSetProtos.
+//
+// Rows are pulled from the cursor, converted and chunked incrementally, and
+// each response is passed to `send` as soon as it is complete, so the result
+// is never materialized in full. One complete response is held back so that
+// the last one can be identified. If limit > 0, only the first limit rows are
+// streamed. If row_count is not null, it is set to the number of rows streamed
+// before the last response is passed to `send`.
+//
+// If `resume` is not null, the rows of the cursor must always be returned in
+// the same order. Responses which end on a row boundary then carry a resume
+// token, and the rows returned before `resume->resume_from` are skipped (and
+// count towards the limit).
+absl::Status StreamRowCursor(backend::RowCursor* cursor, int limit,
+                             const PartialResultSetSender& send,
+                             int64_t* row_count = nullptr,
+                             const ResumeOptions* resume = nullptr);
+
 }  // namespace frontend
 }  // namespace emulator
 }  // namespace spanner
@@ -16,6 +16,10 @@
 
 #include "frontend/converters/reads.h"
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include "google/spanner/v1/mutation.pb.h"
 #include "google/spanner/v1/result_set.pb.h"
 #include "google/spanner/v1/spanner.pb.h"
@@ -394,6 +398,169 @@ TEST_F(AccessProtosTest, CannotConvertInvalidRowCursorToResultSet) {
               StatusIs(absl::StatusCode::kInternal));
 }
 
+TEST_F(AccessProtosTest, ReturnsRowCursorErrorsWhenConvertingToResultSet) {
+  // A cursor whose rows are evaluated lazily reports errors through Status()
+  // once Next() returns false.
+  class FailingRowCursor : public TestRowCursor {
+   public:
+    FailingRowCursor() : TestRowCursor({"col1"}, {Int64Type()}, {{Int64(1)}}) {}
+    absl::Status Status() const override {
+      return absl::OutOfRangeError("evaluation failed");
+    }
+  };
+
+  FailingRowCursor cursor;
+  ResultSet result_pb;
+  EXPECT_THAT(RowCursorToResultSetProto(&cursor, 0, &result_pb),
+              StatusIs(absl::StatusCode::kOutOfRange));
+}
+
+TEST_F(AccessProtosTest, StreamsRowCursorAsChunkedPartialResultSets) {
+  // Each row is larger than half of the streaming chunk size, so more than one
+  // response is produced.
+  const std::string large_string(700 * 1024, 'a');
+  TestRowCursor cursor(
+      {"string"}, {StringType()},
+      {{String(large_string)}, {String(large_string)}, {String(large_string)}});
+
+  std::vector<bool> last_flags;
+  std::string streamed;
+  int64_t row_count = 0;
+  ZETASQL_EXPECT_OK(StreamRowCursor(
+      &cursor, /*limit=*/0,
+      [&](PartialResultSet* response, bool last) {
+        EXPECT_EQ(last_flags.empty(), response->has_metadata());
+        for (const auto& value : response->values()) {
+          streamed += value.string_value();
+        }
+        last_flags.push_back(last);
+        return absl::OkStatus();
+      },
+      &row_count));
+
+  ASSERT_GT(last_flags.size(), 1);
+  EXPECT_EQ(1, std::count(last_flags.begin(), last_flags.end(), true));
+  EXPECT_TRUE(last_flags.back());
+  EXPECT_EQ(3 * large_string.size(), streamed.size());
+  EXPECT_EQ(3, row_count);
+}
+
+TEST_F(AccessProtosTest, StreamsRowCursorOfSeveralBatchesUpToLimit) {
+  std::vector<std::vector<Value>> rows;
+  for (int i = 0; i < 600; ++i) {
+    rows.push_back({Int64(i)});
+  }
+  TestRowCursor cursor({"int64"}, {Int64Type()}, rows);
+
+  std::vector<int64_t> streamed;
+  int64_t row_count = 0;
+  ZETASQL_EXPECT_OK(StreamRowCursor(
+      &cursor, /*limit=*/550,
+      [&](PartialResultSet* response, bool last) {
+        for (const auto& value : response->values()) {
+          streamed.push_back(std::stoll(value.string_value()));
+        }
+        return absl::OkStatus();
+      },
+      &row_count));
+  EXPECT_EQ(550, row_count);
+  ASSERT_EQ(550, streamed.size());
+  EXPECT_EQ(549, streamed.back());
+}
+
+TEST_F(AccessProtosTest, StopsStreamingRowCursorWhenSendFails) {
+  const std::string large_string(700 * 1024, 'a');
+  TestRowCursor cursor(
+      {"string"}, {StringType()},
+      {{String(large_string)}, {String(large_string)}, {String(large_string)}});
+
+  int num_sent = 0;
+  EXPECT_THAT(StreamRowCursor(&cursor, /*limit=*/0,
+                              [&](PartialResultSet* response, bool last) {
+                                ++num_sent;
+                                return absl::CancelledError("cancelled");
+                              }),
+              StatusIs(absl::StatusCode::kCancelled));
+  EXPECT_EQ(1, num_sent);
+}
+
+TEST_F(AccessProtosTest, ResumesStreamingRowCursorFromResumeToken) {
+  const std::string large_string(700 * 1024, 'a');
+  const std::vector<std::vector<Value>> rows = {{String(large_string + "1")},
+                                                {String(large_string + "2")},
+                                                {String(large_string + "3")}};
+
+  // Each row fits into a response of its own, so every response but the last
+  // one ends on a row boundary and carries a resume token.
+  TestRowCursor cursor({"string"}, {StringType()}, rows);
+  ResumeOptions resume;
+  std::vector<std::string> resume_tokens;
+  ZETASQL_EXPECT_OK(StreamRowCursor(
+      &cursor, /*limit=*/0,
+      [&](PartialResultSet* response, bool last) {
+        resume_tokens.push_back(response->resume_token());
+        return absl::OkStatus();
+      },
+      /*row_count=*/nullptr, &resume));
+  ASSERT_EQ(3, resume_tokens.size());
+  EXPECT_NE("", resume_tokens[1]);
+  EXPECT_EQ("", resume_tokens[2]);
+  ZETASQL_ASSERT_OK_AND_ASSIGN(resume.resume_from,
+                       ResumeTokenFromString(resume_tokens[0]));
+  EXPECT_EQ(1, resume.resume_from.rows());
+
+  // Resuming from the first token only returns the following rows.
+  TestRowCursor resumed_cursor({"string"}, {StringType()}, rows);
+  std::vector<std::string> streamed;
+  int64_t row_count = 0;
+  ZETASQL_EXPECT_OK(StreamRowCursor(
+      &resumed_cursor, /*limit=*/0,
+      [&](PartialResultSet* response, bool last) {
+        for (const auto& value : response->values()) {
+          streamed.push_back(value.string_value());
+        }
+        return absl::OkStatus();
+      },
+      &row_count, &resume));
+  EXPECT_THAT(streamed, testing::ElementsAre(large_string + "2",
+                                             large_string + "3"));
+  EXPECT_EQ(2, row_count);
+}
+
+TEST_F(AccessProtosTest, DoesNotResumeStreamingRowCursorWithChangedRows) {
+  const std::string large_string(700 * 1024, 'a');
+  TestRowCursor cursor({"string"}, {StringType()},
+                       {{String(large_string)}, {String(large_string)}});
+  ResumeOptions resume;
+  std::string resume_token;
+  ZETASQL_EXPECT_OK(StreamRowCursor(
+      &cursor, /*limit=*/0,
+      [&](PartialResultSet* response, bool last) {
+        if (!last) {
+          resume_token = response->resume_token();
+        }
+        return absl::OkStatus();
+      },
+      /*row_count=*/nullptr, &resume));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(resume.resume_from,
+                       ResumeTokenFromString(resume_token));
+  EXPECT_EQ(1, resume.resume_from.rows());
+
+  // The row returned before the token is different when resuming.
+  TestRowCursor changed_cursor(
+      {"string"}, {StringType()},
+      {{String(large_string + "b")}, {String(large_string)}});
+  EXPECT_THAT(StreamRowCursor(
+                  &changed_cursor, /*limit=*/0,
+                  [&](PartialResultSet* response, bool last) {
+                    return absl::OkStatus();
+                  },
+                  /*row_count=*/nullptr, &resume),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_THAT(ResumeTokenFromString("not a resume token!"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
 TEST_F(AccessProtosTest, CanReadArgsFromProto) {
   // Creates a ReadRequest with one key and one key range.
   ReadRequest request = PARSE_TEXT_PROTO(R"(
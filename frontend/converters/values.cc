@@ -16,11 +16,17 @@
 
 #include "frontend/converters/values.h"
 
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+
 #include "zetasql/public/functions/date_time_util.h"
 #include "zetasql/public/options.pb.h"
 #include "zetasql/base/statusor.h"
 #include "absl/strings/escaping.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
 #include "absl/strings/strip.h"
 #include "absl/time/time.h"
 #include "common/constants.h"
@@ -36,6 +42,146 @@ namespace {
 // Time format used by Cloud Spanner to encode timestamps.
 constexpr char kRFC3339TimeFormatNoOffset[] = "%E4Y-%m-%dT%H:%M:%E*S";
 
+// Alphabet of the standard base64 encoding used for BYTES values.
+constexpr char kBase64Chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Maps each input character to its 6-bit base64 value, or to -1 if it is not
+// part of the alphabet.
+constexpr std::array<int8_t, 256> MakeBase64DecodeTable() {
+  std::array<int8_t, 256> table = {};
+  for (int c = 0; c < 256; ++c) {
+    table[c] = -1;
+  }
+  for (int i = 0; i < 64; ++i) {
+    table[static_cast<unsigned char>(kBase64Chars[i])] = i;
+  }
+  return table;
+}
+
+constexpr std::array<int8_t, 256> kBase64DecodeTable = MakeBase64DecodeTable();
+
+// Maps each 12-bit group of input bits to the two base64 characters encoding
+// it, so that the encoder emits two characters per lookup.
+constexpr std::array<char, 2 * 4096> MakeBase64PairTable() {
+  std::array<char, 2 * 4096> table = {};
+  for (int i = 0; i < 4096; ++i) {
+    table[2 * i] = kBase64Chars[i >> 6];
+    table[2 * i + 1] = kBase64Chars[i & 0x3f];
+  }
+  return table;
+}
+
+constexpr std::array<char, 2 * 4096> kBase64PairTable = MakeBase64PairTable();
+
+// Decodes padded base64 `src` into `dest`, which is sized once to the decoded
+// length and written in place. Returns false, leaving `dest` unspecified, for
+// inputs this canonical fast path does not handle (missing padding, embedded
+// whitespace, non-zero trailing bits or invalid characters); callers fall back
+// to absl::Base64Unescape for those, which decides whether they are valid.
+bool Base64DecodeCanonical(absl::string_view src, std::string* dest) {
+  if (src.size() % 4 != 0) {
+    return false;
+  }
+  size_t padding = 0;
+  if (!src.empty() && src.back() == '=') {
+    padding = src[src.size() - 2] == '=' ? 2 : 1;
+  }
+  const size_t num_groups = src.size() / 4;
+  dest->resize(num_groups * 3 - padding);
+  if (num_groups == 0) {
+    return true;
+  }
+
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(src.data());
+  char* out = &(*dest)[0];
+  auto decode_group = [&in](int32_t* group) {
+    const int32_t a = kBase64DecodeTable[in[0]];
+    const int32_t b = kBase64DecodeTable[in[1]];
+    const int32_t c = kBase64DecodeTable[in[2]];
+    const int32_t d = kBase64DecodeTable[in[3]];
+    in += 4;
+    // Any invalid character makes the combined value negative.
+    if ((a | b | c | d) < 0) {
+      return false;
+    }
+    *group = (a << 18) | (b << 12) | (c << 6) | d;
+    return true;
+  };
+
+  // All groups but the last are complete.
+  int32_t group;
+  for (size_t i = 0; i + 1 < num_groups; ++i) {
+    if (!decode_group(&group)) {
+      return false;
+    }
+    out[0] = static_cast<char>(group >> 16);
+    out[1] = static_cast<char>(group >> 8);
+    out[2] = static_cast<char>(group);
+    out += 3;
+  }
+
+  // The last group may end in padding, in which case the bits it leaves over
+  // must be zero for the encoding to be canonical.
+  if (padding == 0) {
+    if (!decode_group(&group)) {
+      return false;
+    }
+    out[0] = static_cast<char>(group >> 16);
+    out[1] = static_cast<char>(group >> 8);
+    out[2] = static_cast<char>(group);
+    return true;
+  }
+  const int32_t a = kBase64DecodeTable[in[0]];
+  const int32_t b = kBase64DecodeTable[in[1]];
+  const int32_t c = padding == 1 ? kBase64DecodeTable[in[2]] : 0;
+  if ((a | b | c) < 0) {
+    return false;
+  }
+  group = (a << 18) | (b << 12) | (c << 6);
+  if ((group & (padding == 1 ? 0xff : 0xffff)) != 0) {
+    return false;
+  }
+  out[0] = static_cast<char>(group >> 16);
+  if (padding == 1) {
+    out[1] = static_cast<char>(group >> 8);
+  }
+  return true;
+}
+
+// Encodes `src` as padded base64 into `dest`, replacing its contents. `dest`
+// is sized once to the encoded length and written in place.
+void Base64Encode(absl::string_view src, std::string* dest) {
+  dest->resize((src.size() + 2) / 3 * 4);
+  if (src.empty()) {
+    return;
+  }
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(src.data());
+  char* out = &(*dest)[0];
+  auto emit_pair = [&out](uint32_t bits) {
+    out[0] = kBase64PairTable[2 * bits];
+    out[1] = kBase64PairTable[2 * bits + 1];
+    out += 2;
+  };
+
+  size_t remaining = src.size();
+  for (; remaining >= 3; remaining -= 3, in += 3) {
+    const uint32_t group = (in[0] << 16) | (in[1] << 8) | in[2];
+    emit_pair(group >> 12);
+    emit_pair(group & 0xfff);
+  }
+  if (remaining == 1) {
+    emit_pair(in[0] << 4);
+    out[0] = '=';
+    out[1] = '=';
+  } else if (remaining == 2) {
+    const uint32_t group = (in[0] << 16) | (in[1] << 8);
+    emit_pair(group >> 12);
+    out[0] = kBase64Chars[(group >> 6) & 0x3f];
+    out[1] = '=';
+  }
+}
+
 }  // namespace
 
 zetasql_base::StatusOr<zetasql::Value> ValueFromProto(
@@ -142,11 +288,13 @@ zetasql_base::StatusOr<zetasql::Value> ValueFromProto(
         return error::ValueProtoTypeMismatch(value_pb.DebugString(),
                                              type->DebugString());
       }
+      // The decoded bytes are moved into the value rather than copied.
       std::string bytes;
-      if (!absl::Base64Unescape(value_pb.string_value(), &bytes)) {
+      if (!Base64DecodeCanonical(value_pb.string_value(), &bytes) &&
+          !absl::Base64Unescape(value_pb.string_value(), &bytes)) {
         return error::CouldNotParseStringAsBytes(value_pb.string_value());
       }
-      return zetasql::values::Bytes(bytes);
+      return zetasql::values::Bytes(std::move(bytes));
     }
 
     case zetasql::TypeKind::TYPE_NUMERIC: {
@@ -206,120 +354,207 @@ zetasql_base::StatusOr<zetasql::Value> ValueFromProto(
   }
 }
 
-zetasql_base::StatusOr<google::protobuf::Value> ValueToProto(
-    const zetasql::Value& value) {
-  if (!value.is_valid()) {
-    return error::Internal(
-        "Uninitialized ZetaSQL value passed to ValueToProto");
-  }
+namespace {
 
-  google::protobuf::Value value_pb;
-  if (value.is_null()) {
-    value_pb.set_null_value(google::protobuf::NullValue());
-    return value_pb;
+// Encodes a valid, non-null value of the given kind into `value_pb`. Each kind
+// is specialized below so that columns of a known type can pick their encoder
+// once instead of dispatching on the type of every value.
+template <zetasql::TypeKind kind>
+absl::Status EncodeValue(const zetasql::Value& value,
+                         google::protobuf::Value* value_pb);
+
+template <>
+absl::Status EncodeValue<zetasql::TYPE_BOOL>(
+    const zetasql::Value& value, google::protobuf::Value* value_pb) {
+  value_pb->set_bool_value(value.bool_value());
+  return absl::OkStatus();
+}
+
+template <>
+absl::Status EncodeValue<zetasql::TYPE_INT64>(
+    const zetasql::Value& value, google::protobuf::Value* value_pb) {
+  // Formats into a stack buffer, so that a reused proto keeps its string.
+  const absl::AlphaNum digits(value.int64_value());
+  value_pb->set_string_value(digits.data(), digits.size());
+  return absl::OkStatus();
+}
+
+template <>
+absl::Status EncodeValue<zetasql::TYPE_DOUBLE>(
+    const zetasql::Value& value, google::protobuf::Value* value_pb) {
+  double val = value.double_value();
+  if (std::isfinite(val)) {
+    value_pb->set_number_value(val);
+  } else if (val == std::numeric_limits<double>::infinity()) {
+    value_pb->set_string_value("Infinity");
+  } else if (val == -std::numeric_limits<double>::infinity()) {
+    value_pb->set_string_value("-Infinity");
+  } else if (std::isnan(val)) {
+    value_pb->set_string_value("NaN");
+  } else {
+    return error::Internal(absl::StrCat("Unsupported double value ",
+                                        value.double_value(),
+                                        " passed to ValueToProto"));
   }
+  return absl::OkStatus();
+}
 
-  switch (value.type_kind()) {
-    case zetasql::TypeKind::TYPE_BOOL: {
-      value_pb.set_bool_value(value.bool_value());
-      break;
-    }
+template <>
+absl::Status EncodeValue<zetasql::TYPE_TIMESTAMP>(
+    const zetasql::Value& value, google::protobuf::Value* value_pb) {
+  value_pb->set_string_value(
+      absl::StrCat(absl::FormatTime(kRFC3339TimeFormatNoOffset, value.ToTime(),
+                                    absl::UTCTimeZone()),
+                   "Z"));
+  return absl::OkStatus();
+}
 
-    case zetasql::TypeKind::TYPE_INT64: {
-      value_pb.set_string_value(absl::StrCat(value.int64_value()));
-      break;
-    }
+template <>
+absl::Status EncodeValue<zetasql::TYPE_DATE>(
+    const zetasql::Value& value, google::protobuf::Value* value_pb) {
+  int32_t days_since_epoch = value.date_value();
+  absl::CivilDay epoch_date(1970, 1, 1);
+  absl::CivilDay date = epoch_date + days_since_epoch;
+  if (date.year() > 9999 || date.year() < 1) {
+    return error::Internal(absl::StrCat(
+        "Unsupported date value ", value.DebugString(),
+        " passed to ValueToProto. Year must be between 1 and 9999."));
+  }
+  std::string* date_pb = value_pb->mutable_string_value();
+  date_pb->clear();
+  absl::StrAppendFormat(date_pb, "%04d-%02d-%02d", date.year(), date.month(),
+                        date.day());
+  return absl::OkStatus();
+}
 
-    case zetasql::TypeKind::TYPE_DOUBLE: {
-      double val = value.double_value();
-      if (std::isfinite(val)) {
-        value_pb.set_number_value(val);
-      } else if (val == std::numeric_limits<double>::infinity()) {
-        value_pb.set_string_value("Infinity");
-      } else if (val == -std::numeric_limits<double>::infinity()) {
-        value_pb.set_string_value("-Infinity");
-      } else if (std::isnan(val)) {
-        value_pb.set_string_value("NaN");
-      } else {
-        return error::Internal(absl::StrCat("Unsupported double value ",
-                                            value.double_value(),
-                                            " passed to ValueToProto"));
-      }
-      break;
-    }
+template <>
+absl::Status EncodeValue<zetasql::TYPE_STRING>(
+    const zetasql::Value& value, google::protobuf::Value* value_pb) {
+  value_pb->set_string_value(value.string_value());
+  return absl::OkStatus();
+}
 
-    case zetasql::TypeKind::TYPE_TIMESTAMP: {
-      value_pb.set_string_value(
-          absl::StrCat(absl::FormatTime(kRFC3339TimeFormatNoOffset,
-                                        value.ToTime(), absl::UTCTimeZone()),
-                       "Z"));
-      break;
-    }
+template <>
+absl::Status EncodeValue<zetasql::TYPE_NUMERIC>(
+    const zetasql::Value& value, google::protobuf::Value* value_pb) {
+  value_pb->set_string_value(value.numeric_value().ToString());
+  return absl::OkStatus();
+}
 
-    case zetasql::TypeKind::TYPE_DATE: {
-      int32_t days_since_epoch = value.date_value();
-      absl::CivilDay epoch_date(1970, 1, 1);
-      absl::CivilDay date = epoch_date + days_since_epoch;
-      if (date.year() > 9999 || date.year() < 1) {
-        return error::Internal(absl::StrCat(
-            "Unsupported date value ", value.DebugString(),
-            " passed to ValueToProto. Year must be between 1 and 9999."));
-      }
-      absl::StrAppendFormat(value_pb.mutable_string_value(), "%04d-%02d-%02d",
-                            date.year(), date.month(), date.day());
-      break;
-    }
+template <>
+absl::Status EncodeValue<zetasql::TYPE_BYTES>(
+    const zetasql::Value& value, google::protobuf::Value* value_pb) {
+  Base64Encode(value.bytes_value(), value_pb->mutable_string_value());
+  return absl::OkStatus();
+}
 
-    case zetasql::TypeKind::TYPE_STRING: {
-      value_pb.set_string_value(value.string_value());
-      break;
-    }
+template <>
+absl::Status EncodeValue<zetasql::TYPE_ARRAY>(
+    const zetasql::Value& value, google::protobuf::Value* value_pb) {
+  google::protobuf::ListValue* list_value_pb = value_pb->mutable_list_value();
+  list_value_pb->Clear();
+  for (int i = 0; i < value.num_elements(); ++i) {
+    ZETASQL_RETURN_IF_ERROR(
+        ValueToProto(value.element(i), list_value_pb->add_values()))
+        << "\nWhen encoding array element #" << i << ": "
+        << value.element(i).DebugString() << " in " << value.DebugString();
+  }
+  return absl::OkStatus();
+}
 
-    case zetasql::TypeKind::TYPE_NUMERIC: {
-      value_pb.set_string_value(value.numeric_value().ToString());
-      break;
-    }
+template <>
+absl::Status EncodeValue<zetasql::TYPE_STRUCT>(
+    const zetasql::Value& value, google::protobuf::Value* value_pb) {
+  google::protobuf::ListValue* list_value_pb = value_pb->mutable_list_value();
+  list_value_pb->Clear();
+  for (int i = 0; i < value.num_fields(); ++i) {
+    ZETASQL_RETURN_IF_ERROR(
+        ValueToProto(value.field(i), list_value_pb->add_values()))
+        << "\nWhen encoding struct element #" << i << ": "
+        << value.field(i).DebugString() << " in " << value.DebugString();
+  }
+  return absl::OkStatus();
+}
 
-    case zetasql::TypeKind::TYPE_BYTES: {
-      absl::Base64Escape(value.bytes_value(), value_pb.mutable_string_value());
-      break;
-    }
+using ValueEncoder = absl::Status (*)(const zetasql::Value& value,
+                                      google::protobuf::Value* value_pb);
+
+// Returns the encoder for values of the given kind, or nullptr if the kind is
+// not supported by Cloud Spanner.
+ValueEncoder EncoderForKind(zetasql::TypeKind kind) {
+  switch (kind) {
+    case zetasql::TYPE_BOOL:
+      return &EncodeValue<zetasql::TYPE_BOOL>;
+    case zetasql::TYPE_INT64:
+      return &EncodeValue<zetasql::TYPE_INT64>;
+    case zetasql::TYPE_DOUBLE:
+      return &EncodeValue<zetasql::TYPE_DOUBLE>;
+    case zetasql::TYPE_TIMESTAMP:
+      return &EncodeValue<zetasql::TYPE_TIMESTAMP>;
+    case zetasql::TYPE_DATE:
+      return &EncodeValue<zetasql::TYPE_DATE>;
+    case zetasql::TYPE_STRING:
+      return &EncodeValue<zetasql::TYPE_STRING>;
+    case zetasql::TYPE_NUMERIC:
+      return &EncodeValue<zetasql::TYPE_NUMERIC>;
+    case zetasql::TYPE_BYTES:
+      return &EncodeValue<zetasql::TYPE_BYTES>;
+    case zetasql::TYPE_ARRAY:
+      return &EncodeValue<zetasql::TYPE_ARRAY>;
+    case zetasql::TYPE_STRUCT:
+      return &EncodeValue<zetasql::TYPE_STRUCT>;
+    default:
+      return nullptr;
+  }
+}
 
-    case zetasql::TypeKind::TYPE_ARRAY: {
-      google::protobuf::ListValue* list_value_pb =
-          value_pb.mutable_list_value();
-      for (int i = 0; i < value.num_elements(); ++i) {
-        ZETASQL_ASSIGN_OR_RETURN(*list_value_pb->add_values(),
-                         ValueToProto(value.element(i)),
-                         _ << "\nWhen encoding array element #" << i << ": "
-                           << value.element(i).DebugString() << " in "
-                           << value.DebugString());
-      }
-      break;
-    }
+}  // namespace
 
-    case zetasql::TypeKind::TYPE_STRUCT: {
-      google::protobuf::ListValue* list_value_pb =
-          value_pb.mutable_list_value();
-      for (int i = 0; i < value.num_fields(); ++i) {
-        ZETASQL_ASSIGN_OR_RETURN(
-            *list_value_pb->add_values(), ValueToProto(value.field(i)),
-            _ << "\nWhen encoding struct element #" << i << ": "
-              << value.field(i).DebugString() << " in " << value.DebugString());
-      }
-      break;
-    }
+absl::Status ValueToProto(const zetasql::Value& value,
+                          google::protobuf::Value* value_pb) {
+  if (!value.is_valid()) {
+    return error::Internal(
+        "Uninitialized ZetaSQL value passed to ValueToProto");
+  }
 
-    default: {
-      return error::Internal(
-          absl::StrCat("Cloud Spanner unsupported ZetaSQL value ",
-                       value.DebugString(), " passed to ValueToProto"));
-    }
+  if (value.is_null()) {
+    value_pb->set_null_value(google::protobuf::NullValue());
+    return absl::OkStatus();
   }
 
+  ValueEncoder encode = EncoderForKind(value.type_kind());
+  if (encode == nullptr) {
+    return error::Internal(
+        absl::StrCat("Cloud Spanner unsupported ZetaSQL value ",
+                     value.DebugString(), " passed to ValueToProto"));
+  }
+  return encode(value, value_pb);
+}
+
+zetasql_base::StatusOr<google::protobuf::Value> ValueToProto(
+    const zetasql::Value& value) {
+  google::protobuf::Value value_pb;
+  ZETASQL_RETURN_IF_ERROR(ValueToProto(value, &value_pb));
   return value_pb;
 }
 
+ValueProtoConverter::ValueProtoConverter(const zetasql::Type* type)
+    : kind_(type->kind()), encode_(EncoderForKind(type->kind())) {}
+
+absl::Status ValueProtoConverter::Convert(
+    const zetasql::Value& value, google::protobuf::Value* value_pb) const {
+  // Values which do not match the column type take the general path, which
+  // also reports invalid and unsupported values.
+  if (encode_ == nullptr || !value.is_valid() || value.type_kind() != kind_) {
+    return ValueToProto(value, value_pb);
+  }
+  if (value.is_null()) {
+    value_pb->set_null_value(google::protobuf::NullValue());
+    return absl::OkStatus();
+  }
+  return encode_(value, value_pb);
+}
+
 }  // namespace frontend
 }  // namespace emulator
 }  // namespace spanner
@@ -46,6 +46,35 @@ zetasql_base::StatusOr<zetasql::Value> ValueFromProto(
 zetasql_base::StatusOr<google::protobuf::Value> ValueToProto(
     const zetasql::Value& value);
 
+// Same as above, but encodes the value into an existing proto, replacing its
+// contents and re-using its allocated storage where possible.
+absl::Status ValueToProto(const zetasql::Value& value,
+                          google::protobuf::Value* value_pb);
+
+// Converts ZetaSQL values of one type, e.g. the values of a result set column,
+// to Cloud Spanner value protos.
+//
+// The type of the values is dispatched on once, when the converter is created,
+// instead of for every value. Values are written in place, so callers can
+// convert directly into the protos of a result row.
+class ValueProtoConverter {
+ public:
+  explicit ValueProtoConverter(const zetasql::Type* type);
+
+  // Encodes `value` into `value_pb` as ValueToProto does.
+  absl::Status Convert(const zetasql::Value& value,
+                       google::protobuf::Value* value_pb) const;
+
+ private:
+  // Kind of the values this converter is specialized for.
+  zetasql::TypeKind kind_;
+
+  // Encoder of non-null values of kind_, or nullptr if the kind is not
+  // supported by Cloud Spanner.
+  absl::Status (*encode_)(const zetasql::Value& value,
+                          google::protobuf::Value* value_pb);
+};
+
 }  // namespace frontend
 }  // namespace emulator
 }  // namespace spanner
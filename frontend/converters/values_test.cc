@@ -17,11 +17,13 @@
 #include "frontend/converters/values.h"
 
 #include <limits>
+#include <string>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "zetasql/base/testing/status_matchers.h"
 #include "tests/common/proto_matchers.h"
+#include "absl/strings/escaping.h"
 #include "absl/time/time.h"
 
 namespace google {
@@ -55,6 +57,7 @@ using zetasql::values::String;
 using zetasql::values::Struct;
 using zetasql::values::Timestamp;
 
+using zetasql_base::testing::IsOkAndHolds;
 using zetasql_base::testing::StatusIs;
 
 TEST(ValueProtos, ConvertsBasicTypesBetweenValuesAndProtos) {
@@ -114,9 +117,30 @@ TEST(ValueProtos, ConvertsBasicTypesBetweenValuesAndProtos) {
                          ValueToProto(expected_value));
     EXPECT_THAT(actual_value_pb, test::EqualsProto(expected_value_pb_txt))
         << "When encoding {" << expected_value << "}";
+
+    // Check value -> proto conversions specialized by type, into a proto which
+    // already holds a value.
+    google::protobuf::Value reused_value_pb =
+        PARSE_TEXT_PROTO("list_value: { values [{string_value: 'stale'}] }");
+    ZETASQL_ASSERT_OK(ValueProtoConverter(expected_value.type())
+                  .Convert(expected_value, &reused_value_pb));
+    EXPECT_THAT(reused_value_pb, test::EqualsProto(expected_value_pb_txt))
+        << "When encoding {" << expected_value << "} in place";
   }
 }
 
+TEST(ValueProtos, ConverterHandlesValuesOfOtherTypes) {
+  google::protobuf::Value value_pb;
+  ValueProtoConverter converter(Int64Type());
+  ZETASQL_ASSERT_OK(converter.Convert(String("one"), &value_pb));
+  EXPECT_THAT(value_pb, test::EqualsProto("string_value: 'one'"));
+  EXPECT_THAT(converter.Convert(zetasql::values::Invalid(), &value_pb),
+              StatusIs(absl::StatusCode::kInternal));
+  EXPECT_THAT(ValueProtoConverter(zetasql::types::Int32Type())
+                  .Convert(zetasql::values::Int32(0), &value_pb),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
 TEST(ValueProtos, DoesNotConvertUnknownValueTypesToProtos) {
   EXPECT_THAT(ValueToProto(zetasql::values::Invalid()),
               StatusIs(absl::StatusCode::kInternal));
@@ -189,6 +213,33 @@ TEST(ValueProtos, DoesNotParseInvalidBytes) {
       StatusIs(absl::StatusCode::kFailedPrecondition));
 }
 
+TEST(ValueProtos, RoundTripsBytesOfEveryLength) {
+  std::string bytes;
+  for (int i = 0; i < 260; ++i) {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(google::protobuf::Value value_pb,
+                         ValueToProto(Bytes(bytes)));
+    std::string expected_pb;
+    absl::Base64Escape(bytes, &expected_pb);
+    EXPECT_EQ(value_pb.string_value(), expected_pb);
+    EXPECT_THAT(ValueFromProto(value_pb, BytesType()),
+                IsOkAndHolds(Bytes(bytes)));
+    bytes.push_back(static_cast<char>(255 - i));
+  }
+}
+
+TEST(ValueProtos, ParsesNonCanonicalBytes) {
+  // Unpadded, containing whitespace and with non-zero trailing bits.
+  for (const char* text : {"SGVsbG8", "SGVs bG8=", "SGVsbG9="}) {
+    google::protobuf::Value value_pb;
+    value_pb.set_string_value(text);
+    std::string expected;
+    ASSERT_TRUE(absl::Base64Unescape(text, &expected)) << text;
+    EXPECT_THAT(ValueFromProto(value_pb, BytesType()),
+                IsOkAndHolds(Bytes(expected)))
+        << text;
+  }
+}
+
 TEST(ValueProtos, DoesNotParseInvalidNumeric) {
   EXPECT_THAT(ValueFromProto(PARSE_TEXT_PROTO("string_value: '9252.a53'"),
                              NumericType()),
@@ -16,7 +16,14 @@
 
 #include "frontend/entities/database.h"
 
+#include <functional>
+#include <memory>
+#include <utility>
+
 #include "google/spanner/admin/database/v1/spanner_database_admin.pb.h"
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "common/thread_pool.h"
 #include "absl/status/status.h"
 #include "zetasql/base/status_macros.h"
 
@@ -31,6 +38,27 @@ absl::Status Database::ToProto(admin::database::v1::Database* database) {
   return absl::OkStatus();
 }
 
+Database::~Database() { schema_change_cancellation_.Cancel(); }
+
+void Database::ScheduleSchemaChange(std::function<void()> schema_change) {
+  absl::MutexLock lock(&mu_);
+  if (schema_change_pool_ == nullptr) {
+    schema_change_pool_ = absl::make_unique<ThreadPool>(/*num_threads=*/1);
+  }
+  ++num_pending_schema_changes_;
+  schema_change_pool_->Schedule(
+      [this, schema_change = std::move(schema_change)]() {
+        schema_change();
+        absl::MutexLock lock(&mu_);
+        --num_pending_schema_changes_;
+      });
+}
+
+bool Database::HasPendingSchemaChanges() const {
+  absl::MutexLock lock(&mu_);
+  return num_pending_schema_changes_ > 0;
+}
+
 }  // namespace frontend
 }  // namespace emulator
 }  // namespace spanner
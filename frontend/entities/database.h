@@ -17,11 +17,16 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_DATABASE_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_DATABASE_H_
 
+#include <functional>
+#include <memory>
 #include <string>
 
 #include "google/spanner/admin/database/v1/spanner_database_admin.pb.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "backend/database/database.h"
+#include "common/cancellation.h"
+#include "common/thread_pool.h"
 #include "absl/status/status.h"
 
 namespace google {
@@ -42,6 +47,7 @@ class Database {
       : database_uri_(database_uri),
         backend_(std::move(backend)),
         create_time_(create_time) {}
+  ~Database();
 
   // Returns the URI for this database.
   const std::string& database_uri() const { return database_uri_; }
@@ -52,6 +58,23 @@ class Database {
   // Converts this database object to its proto representation.
   absl::Status ToProto(admin::database::v1::Database* database);
 
+  // Runs `schema_change` in the background, once all the schema changes
+  // scheduled before it have finished. Schema changes which are still pending
+  // when the database is destroyed are run to completion by the destructor,
+  // after cancelling schema_change_cancellation().
+  void ScheduleSchemaChange(std::function<void()> schema_change)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns true if schema changes scheduled by ScheduleSchemaChange are still
+  // waiting to run or running.
+  bool HasPendingSchemaChanges() const ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the cancellation of scheduled schema changes, cancelled once the
+  // database is destroyed so that their backfills stop early.
+  const CancellationToken* schema_change_cancellation() const {
+    return &schema_change_cancellation_;
+  }
+
  private:
   // The URI for this database.
   const std::string database_uri_;
@@ -61,6 +84,21 @@ class Database {
 
   // The time at which this database was created.
   const absl::Time create_time_;
+
+  // Cancellation of the schema changes run by schema_change_pool_, declared
+  // before it so that it outlives them.
+  CancellationToken schema_change_cancellation_;
+
+  // Mutex to guard state below.
+  mutable absl::Mutex mu_;
+
+  // Number of scheduled schema changes which have not finished yet.
+  int num_pending_schema_changes_ ABSL_GUARDED_BY(mu_) = 0;
+
+  // Single worker which runs schema changes in the order they were scheduled,
+  // created on the first schema change. Declared last so that pending schema
+  // changes finish before the backend database is destroyed.
+  std::unique_ptr<ThreadPool> schema_change_pool_ ABSL_GUARDED_BY(mu_);
 };
 
 }  // namespace frontend
@@ -16,20 +16,26 @@
 
 #include "frontend/entities/session.h"
 
+#include <functional>
 #include <memory>
+#include <utility>
 
 #include "google/spanner/v1/spanner.pb.h"
 #include "google/spanner/v1/transaction.pb.h"
 #include "zetasql/base/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "backend/common/ids.h"
 #include "backend/transaction/options.h"
 #include "backend/transaction/read_only_transaction.h"
 #include "backend/transaction/read_write_transaction.h"
+#include "common/config.h"
 #include "common/errors.h"
 #include "common/limits.h"
+#include "common/timer_service.h"
+#include "common/trace.h"
 #include "frontend/common/protos.h"
 #include "frontend/converters/reads.h"
 #include "frontend/converters/time.h"
@@ -62,6 +68,24 @@ absl::Status ValidateReadOptionsForMultiUseTransaction(
   }
 }
 
+// Checks `txn` at `deadline`, and then whenever it may next be idle for too
+// long, for as long as it is alive, aborting it once it has been idle for
+// longer than `max_idle_time`.
+void WatchIdleTransaction(TimerService* timers,
+                          std::weak_ptr<Transaction> weak_txn,
+                          absl::Duration max_idle_time, absl::Time deadline) {
+  timers->Schedule(deadline, [timers, weak_txn, max_idle_time]() {
+    std::shared_ptr<Transaction> txn = weak_txn.lock();
+    if (txn == nullptr) {
+      return;
+    }
+    const absl::Time next_deadline = txn->AbortIfIdle(max_idle_time);
+    if (next_deadline != absl::InfiniteFuture()) {
+      WatchIdleTransaction(timers, weak_txn, max_idle_time, next_deadline);
+    }
+  });
+}
+
 absl::Status ValidateMultiUseTransactionOptions(
     const spanner_api::TransactionOptions& options) {
   switch (options.mode_case()) {
@@ -137,27 +161,64 @@ zetasql_base::StatusOr<std::shared_ptr<Transaction>> Session::CreateMultiUseTran
       CreateTransaction(options, Transaction::Usage::kMultiUse,
                         MakeRetryState(options, /*is_single_use_txn=*/false)));
 
-  // Insert shared transaction object into transaction map.
-  transaction_map_.emplace(txn->id(), txn);
+  if (activation == TransactionActivation::kInitializeAndActivate) {
+    // Assign this as the current active transaction, and remove transactions
+    // that came before this one.
+    active_transaction_ = txn;
+    DropOldestTransactions(num_transactions_);
+  }
+
+  // Track the shared transaction object in the session.
+  AddTransaction(txn);
 
-  // Clear older transactions if too many transactions are tracked by session.
-  while (transaction_map_.size() > limits::kMaxTransactionsPerSession) {
-    transaction_map_.begin()->second->Close();
-    transaction_map_.erase(transaction_map_.begin());
+  // Abandoned read-write transactions would hold their locks until the
+  // session expires.
+  const absl::Duration max_idle_time = config::max_transaction_idle_time();
+  if (timers_ != nullptr && txn->IsReadWrite() &&
+      max_idle_time > absl::ZeroDuration()) {
+    WatchIdleTransaction(timers_, txn, max_idle_time,
+                         absl::Now() + max_idle_time);
   }
+  return txn;
+}
 
-  if (activation == TransactionActivation::kInitializeAndActivate) {
-    // Assign this as the current active transaction.
-    active_transaction_ = txn;
+void Session::AddTransaction(std::shared_ptr<Transaction> txn) {
+  // Clear the oldest transaction if too many transactions are tracked.
+  if (num_transactions_ == limits::kMaxTransactionsPerSession) {
+    DropOldestTransactions(1);
+  }
+  transactions_[TransactionIndex(num_transactions_)] = std::move(txn);
+  ++num_transactions_;
+}
 
-    // Remove transactions that came before this one.
-    auto it = transaction_map_.find(txn->id());
-    for (auto prev_txn = transaction_map_.begin(); prev_txn != it; ++prev_txn) {
-      prev_txn->second->Close();
+int Session::FindTransaction(backend::TransactionID id) const {
+  // Binary search over the ring, which is ordered by transaction ID.
+  int low = 0;
+  int high = num_transactions_;
+  while (low < high) {
+    const int mid = low + (high - low) / 2;
+    if (transactions_[TransactionIndex(mid)]->id() < id) {
+      low = mid + 1;
+    } else {
+      high = mid;
     }
-    transaction_map_.erase(transaction_map_.begin(), it);
   }
-  return txn;
+  if (low < num_transactions_ &&
+      transactions_[TransactionIndex(low)]->id() == id) {
+    return low;
+  }
+  return -1;
+}
+
+void Session::DropOldestTransactions(int count) {
+  for (int i = 0; i < count; ++i) {
+    std::shared_ptr<Transaction>& txn = transactions_[TransactionIndex(0)];
+    txn->Close();
+    txn.reset();
+    first_transaction_ =
+        (first_transaction_ + 1) % limits::kMaxTransactionsPerSession;
+    --num_transactions_;
+  }
 }
 
 zetasql_base::StatusOr<std::unique_ptr<Transaction>>
@@ -170,6 +231,20 @@ Session::CreateSingleUseTransaction(
                            MakeRetryState(options, /*is_single_use_txn=*/true));
 }
 
+absl::Status Session::RunSingleUseReadOnly(
+    const spanner_api::TransactionOptions& options,
+    const std::function<absl::Status(backend::ReadOnlyTransaction*)>& fn) {
+  ZETASQL_RETURN_IF_ERROR(ValidateSingleUseTransactionOptions(options));
+  if (!options.has_read_only()) {
+    return error::Internal(
+        "Unexpected TransactionOptions.mode for single-use read-only "
+        "transaction.");
+  }
+  ZETASQL_ASSIGN_OR_RETURN(backend::ReadOnlyOptions read_only_options,
+                   ReadOnlyOptionsFromProto(options.read_only()));
+  return database_->backend()->ReadAtSnapshot(read_only_options, fn);
+}
+
 zetasql_base::StatusOr<std::unique_ptr<Transaction>> Session::CreateTransaction(
     const spanner_api::TransactionOptions& options,
     const Transaction::Usage& usage, const backend::RetryState& retry_state) {
@@ -196,23 +271,27 @@ zetasql_base::StatusOr<std::unique_ptr<Transaction>> Session::CreateReadOnly(
   ZETASQL_ASSIGN_OR_RETURN(
       std::unique_ptr<backend::ReadOnlyTransaction> read_only_transaction,
       database_->backend()->CreateReadOnlyTransaction(read_only_options));
-  return std::make_unique<Transaction>(std::move(read_only_transaction),
-                                       database_->backend()->query_engine(),
-                                       options, usage);
+  return std::make_unique<Transaction>(
+      std::move(read_only_transaction), database_->backend()->query_engine(),
+      database_->backend(), options, usage);
 }
 
 zetasql_base::StatusOr<std::unique_ptr<Transaction>> Session::CreateReadWrite(
     const spanner_api::TransactionOptions& options,
     const Transaction::Usage& usage, const backend::RetryState& retry_state) {
   // Create a new backend read write transaction.
+  backend::ReadWriteOptions read_write_options;
+  if (config::optimistic_read_write_transactions()) {
+    read_write_options.concurrency_mode = backend::ConcurrencyMode::kOptimistic;
+  }
   ZETASQL_ASSIGN_OR_RETURN(
       std::unique_ptr<backend::ReadWriteTransaction> read_write_transaction,
-      database_->backend()->CreateReadWriteTransaction(
-          backend::ReadWriteOptions(), retry_state));
+      database_->backend()->CreateReadWriteTransaction(read_write_options,
+                                                       retry_state));
 
-  return std::make_unique<Transaction>(std::move(read_write_transaction),
-                                       database_->backend()->query_engine(),
-                                       options, usage);
+  return std::make_unique<Transaction>(
+      std::move(read_write_transaction), database_->backend()->query_engine(),
+      database_->backend(), options, usage);
 }
 
 zetasql_base::StatusOr<std::shared_ptr<Transaction>> Session::FindAndUseTransaction(
@@ -227,26 +306,26 @@ zetasql_base::StatusOr<std::shared_ptr<Transaction>> Session::FindAndUseTransact
   }
   min_valid_id_ = std::max(id, min_valid_id_);
 
-  auto it = transaction_map_.find(id);
-  if (it == transaction_map_.end()) {
+  const int position = FindTransaction(id);
+  if (position < 0) {
     return error::TransactionNotFound(id);
   }
 
-  if (it->second->IsClosed()) {
+  const std::shared_ptr<Transaction>& txn =
+      transactions_[TransactionIndex(position)];
+  if (txn->IsClosed()) {
     return error::TransactionClosed(id);
   }
-  active_transaction_ = it->second;
+  active_transaction_ = txn;
 
   // Remove transactions that came before this one.
-  for (auto prev_txn = transaction_map_.begin(); prev_txn != it; ++prev_txn) {
-    prev_txn->second->Close();
-  }
-  transaction_map_.erase(transaction_map_.begin(), it);
+  DropOldestTransactions(position);
   return active_transaction_;
 }
 
 zetasql_base::StatusOr<std::shared_ptr<Transaction>> Session::FindOrInitTransaction(
     const spanner_api::TransactionSelector& selector) {
+  trace::ScopedSpan span("FindOrInitTransaction");
   std::shared_ptr<Transaction> txn;
   switch (selector.selector_case()) {
     case spanner_api::TransactionSelector::SelectorCase::kBegin: {
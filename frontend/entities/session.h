@@ -17,7 +17,8 @@
 #ifndef STORAGE_CLOUD_SPANNER_EMULATOR_FRONTEND_SESSION_H_
 #define STORAGE_CLOUD_SPANNER_EMULATOR_FRONTEND_SESSION_H_
 
-#include <map>
+#include <array>
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -27,6 +28,9 @@
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "backend/common/ids.h"
+#include "backend/transaction/read_only_transaction.h"
+#include "common/limits.h"
+#include "common/timer_service.h"
 #include "frontend/common/labels.h"
 #include "frontend/entities/database.h"
 #include "frontend/entities/transaction.h"
@@ -64,12 +68,16 @@ class Session {
     kInitializeAndActivate,
   };
 
+  // If `timers` is not null, multi-use read-write transactions are aborted by
+  // its timers once idle for longer than config::max_transaction_idle_time().
   Session(const std::string& session_uri, const Labels& labels,
-          const absl::Time create_time, std::shared_ptr<Database> database)
+          const absl::Time create_time, std::shared_ptr<Database> database,
+          TimerService* timers = nullptr)
       : session_uri_(session_uri),
         labels_(labels),
         create_time_(create_time),
-        database_(database) {}
+        database_(database),
+        timers_(timers) {}
 
   // Returns the URI for this session.
   const std::string& session_uri() const { return session_uri_; }
@@ -107,6 +115,15 @@ class Session {
       const google::spanner::v1::TransactionOptions& options)
       ABSL_LOCKS_EXCLUDED(mu_);
 
+  // Runs `fn` in a single-use read-only transaction with `options`. Unlike
+  // CreateSingleUseTransaction, no frontend Transaction is created and the
+  // backend transaction lives on the stack of the call, so `fn` must be done
+  // with it, and with any cursor read from it, when it returns.
+  absl::Status RunSingleUseReadOnly(
+      const google::spanner::v1::TransactionOptions& options,
+      const std::function<absl::Status(backend::ReadOnlyTransaction*)>& fn)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
   // Finds a transaction by id and sets it as the active transaction.
   zetasql_base::StatusOr<std::shared_ptr<Transaction>> FindAndUseTransaction(
       const std::string& bytes) ABSL_LOCKS_EXCLUDED(mu_);
@@ -131,6 +148,25 @@ class Session {
       const spanner_api::TransactionOptions& options,
       const Transaction::Usage& usage, const backend::RetryState& retry_state);
 
+  // Adds `txn` as the newest pre-created transaction, closing and dropping the
+  // oldest one if the session already tracks kMaxTransactionsPerSession.
+  void AddTransaction(std::shared_ptr<Transaction> txn)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Returns the position of the transaction `id` counted from the oldest
+  // tracked transaction, or -1 if it is not tracked.
+  int FindTransaction(backend::TransactionID id) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Closes and drops the `count` oldest tracked transactions.
+  void DropOldestTransactions(int count) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Returns the index in `transactions_` of the tracked transaction at
+  // `position` from the oldest one.
+  int TransactionIndex(int position) const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    return (first_transaction_ + position) % limits::kMaxTransactionsPerSession;
+  }
+
   // Builds the retry state from active transaction.
   backend::RetryState MakeRetryState(
       const spanner_api::TransactionOptions& options, bool is_single_use_txn)
@@ -148,15 +184,23 @@ class Session {
   // The database to which this session is attached.
   std::shared_ptr<Database> database_;
 
+  // Timers aborting idle transactions, or null if they are never aborted.
+  TimerService* const timers_;
+
   // Mutex to guard the state below.
   mutable absl::Mutex mu_;
 
   // The last time this session was used.
   absl::Time approximate_last_use_time_ ABSL_GUARDED_BY(mu_);
 
-  // Map of transactions that have been pre-created in this session.
-  std::map<backend::TransactionID, std::shared_ptr<Transaction>>
-      transaction_map_ ABSL_GUARDED_BY(mu_);
+  // Ring of the transactions that have been pre-created in this session, from
+  // the oldest one at `first_transaction_` to the newest. Transaction IDs only
+  // grow, so the ring is ordered by ID. It never allocates, as a session only
+  // tracks up to kMaxTransactionsPerSession transactions.
+  std::array<std::shared_ptr<Transaction>, limits::kMaxTransactionsPerSession>
+      transactions_ ABSL_GUARDED_BY(mu_);
+  int first_transaction_ ABSL_GUARDED_BY(mu_) = 0;
+  int num_transactions_ ABSL_GUARDED_BY(mu_) = 0;
 
   // The currently active transaction.
   std::shared_ptr<Transaction> active_transaction_ ABSL_GUARDED_BY(mu_);
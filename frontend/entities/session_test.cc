@@ -0,0 +1,128 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "frontend/entities/session.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "google/spanner/v1/transaction.pb.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "backend/database/database.h"
+#include "common/limits.h"
+#include "frontend/entities/database.h"
+#include "frontend/entities/transaction.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+namespace {
+
+namespace spanner_api = ::google::spanner::v1;
+
+using zetasql_base::testing::StatusIs;
+
+class SessionTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ZETASQL_ASSERT_OK_AND_ASSIGN(std::unique_ptr<backend::Database> backend,
+                         backend::Database::Create({}));
+    auto database = std::make_shared<Database>(
+        "projects/p/instances/i/databases/d", std::move(backend), absl::Now());
+    session_ = absl::make_unique<Session>(
+        "projects/p/instances/i/databases/d/sessions/s", Labels(), absl::Now(),
+        database);
+    options_.mutable_read_only()->set_strong(true);
+  }
+
+  // Pre-creates a transaction in the session, without using it.
+  std::shared_ptr<Transaction> CreateTransaction() {
+    zetasql_base::StatusOr<std::shared_ptr<Transaction>> txn =
+        session_->CreateMultiUseTransaction(
+            options_, Session::TransactionActivation::kInitializeOnly);
+    ZETASQL_EXPECT_OK(txn);
+    return txn.ok() ? *txn : nullptr;
+  }
+
+  std::unique_ptr<Session> session_;
+  spanner_api::TransactionOptions options_;
+};
+
+TEST_F(SessionTest, UsingTransactionClosesOlderOnes) {
+  std::vector<std::shared_ptr<Transaction>> txns;
+  for (int i = 0; i < 3; ++i) {
+    txns.push_back(CreateTransaction());
+  }
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::shared_ptr<Transaction> used,
+      session_->FindAndUseTransaction(absl::StrCat(txns[1]->id())));
+  EXPECT_EQ(used, txns[1]);
+  EXPECT_TRUE(txns[0]->IsClosed());
+  EXPECT_FALSE(txns[1]->IsClosed());
+  EXPECT_FALSE(txns[2]->IsClosed());
+
+  // Earlier transactions can no longer be used, later ones still can.
+  EXPECT_THAT(session_->FindAndUseTransaction(absl::StrCat(txns[0]->id())),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  ZETASQL_EXPECT_OK(
+      session_->FindAndUseTransaction(absl::StrCat(txns[2]->id())));
+}
+
+TEST_F(SessionTest, OldestTransactionIsDroppedOnceWindowIsFull) {
+  std::vector<std::shared_ptr<Transaction>> txns;
+  for (int i = 0; i < limits::kMaxTransactionsPerSession + 2; ++i) {
+    txns.push_back(CreateTransaction());
+  }
+  EXPECT_TRUE(txns[0]->IsClosed());
+  EXPECT_TRUE(txns[1]->IsClosed());
+  EXPECT_FALSE(txns[2]->IsClosed());
+
+  EXPECT_THAT(session_->FindAndUseTransaction(absl::StrCat(txns[1]->id())),
+              StatusIs(absl::StatusCode::kNotFound));
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::shared_ptr<Transaction> used,
+      session_->FindAndUseTransaction(absl::StrCat(txns.back()->id())));
+  EXPECT_EQ(used, txns.back());
+  EXPECT_TRUE(txns[txns.size() - 2]->IsClosed());
+}
+
+TEST_F(SessionTest, BeginningTransactionClosesPreCreatedOnes) {
+  std::shared_ptr<Transaction> pre_created = CreateTransaction();
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::shared_ptr<Transaction> begun,
+      session_->CreateMultiUseTransaction(
+          options_, Session::TransactionActivation::kInitializeAndActivate));
+  EXPECT_TRUE(pre_created->IsClosed());
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::shared_ptr<Transaction> used,
+                       session_->FindAndUseTransaction(
+                           absl::StrCat(begun->id())));
+  EXPECT_EQ(used, begun);
+}
+
+}  // namespace
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
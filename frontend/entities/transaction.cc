@@ -19,6 +19,7 @@
 #include <cstddef>
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "google/spanner/v1/spanner.pb.h"
 #include "zetasql/public/value.h"
@@ -26,6 +27,7 @@
 #include "zetasql/base/statusor.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
+#include "absl/memory/memory.h"
 #include "absl/types/variant.h"
 #include "backend/access/read.h"
 #include "backend/access/write.h"
@@ -35,6 +37,8 @@
 #include "backend/query/query_engine.h"
 #include "backend/transaction/options.h"
 #include "backend/transaction/read_write_transaction.h"
+#include "backend/transaction/row_cursor.h"
+#include "common/cancellation.h"
 #include "common/constants.h"
 #include "common/errors.h"
 #include "frontend/converters/time.h"
@@ -56,6 +60,11 @@ namespace spanner_api = ::google::spanner::v1;
 
 namespace {
 
+// Maximum number of DML requests of a transaction whose outcome is kept to be
+// replayed. Clients only retry their most recent requests, so the requests with
+// the lowest sequence numbers are forgotten first.
+constexpr int kMaxReplayableDmlRequests = 256;
+
 Transaction::Type TypeFromTransactionOptions(
     const spanner_api::TransactionOptions& options) {
   switch (options.mode_case()) {
@@ -87,10 +96,11 @@ Transaction::Transaction(
     absl::variant<std::unique_ptr<backend::ReadWriteTransaction>,
                   std::unique_ptr<backend::ReadOnlyTransaction>>
         backend_transaction,
-    const backend::QueryEngine* query_engine,
+    const backend::QueryEngine* query_engine, backend::Database* database,
     const spanner_api::TransactionOptions& options, const Usage& usage)
     : transaction_(std::move(backend_transaction)),
       query_engine_(query_engine),
+      database_(database),
       usage_type_(usage),
       type_(TypeFromTransactionOptions(options)),
       options_(options) {}
@@ -136,12 +146,12 @@ bool Transaction::HasState(
 }
 
 bool Transaction::IsRolledback() const {
-  mu_.AssertHeld();
+  mu_.AssertReaderHeld();
   return HasState(backend::ReadWriteTransaction::State::kRolledback);
 }
 
 bool Transaction::IsInvalid() const {
-  mu_.AssertHeld();
+  mu_.AssertReaderHeld();
   return HasState(backend::ReadWriteTransaction::State::kInvalid);
 }
 
@@ -151,7 +161,7 @@ bool Transaction::IsAborted() const {
 }
 
 bool Transaction::IsCommitted() const {
-  mu_.AssertHeld();
+  mu_.AssertReaderHeld();
   return HasState(backend::ReadWriteTransaction::State::kCommitted);
 }
 
@@ -180,50 +190,88 @@ backend::TransactionID Transaction::id() const {
 }
 
 absl::Status Transaction::Read(const backend::ReadArg& read_arg,
-                               std::unique_ptr<backend::RowCursor>* cursor) {
-  mu_.AssertHeld();
+                               std::unique_ptr<backend::RowCursor>* cursor,
+                               const CancellationToken* cancellation) {
+  mu_.AssertReaderHeld();
   switch (type_) {
     case kReadOnly: {
-      return read_only()->Read(read_arg, cursor);
+      ZETASQL_RETURN_IF_ERROR(read_only()->Read(read_arg, cursor));
+      break;
     }
     case kReadWrite: {
-      return read_write()->Read(read_arg, cursor);
+      ZETASQL_RETURN_IF_ERROR(read_write()->Read(read_arg, cursor));
+      break;
     }
     case kPartitionedDml: {
       return error::InvalidOperationUsingPartitionedDmlTransaction();
     }
   }
+  if (cancellation != nullptr) {
+    *cursor = absl::make_unique<backend::CancellableRowCursor>(
+        std::move(*cursor), cancellation);
+  }
+  return absl::OkStatus();
 }
 
 zetasql_base::StatusOr<backend::QueryResult> Transaction::ExecuteSql(
-    const backend::Query& query) {
-  mu_.AssertHeld();
+    const backend::Query& query, const CancellationToken* cancellation) {
+  return ExecuteSql(query, /*partitioned_table=*/"", backend::KeyRange::All(),
+                    cancellation);
+}
+
+zetasql_base::StatusOr<backend::QueryResult> Transaction::ExecuteSql(
+    const backend::Query& query, const std::string& partitioned_table,
+    const backend::KeyRange& partition_range,
+    const CancellationToken* cancellation) {
+  mu_.AssertReaderHeld();
   switch (type_) {
     case kReadOnly: {
+      // Read-only transactions can be read from several threads at once.
       return query_engine_->ExecuteSql(
-          query,
-          backend::QueryContext{
-              .schema = schema(), .reader = read_only(), .writer = nullptr});
+          query, backend::QueryContext{.schema = schema(),
+                                       .reader = read_only(),
+                                       .writer = nullptr,
+                                       .partitioned_table = partitioned_table,
+                                       .partition_range = partition_range,
+                                       .allow_parallel_execution = true,
+                                       .read_timestamp =
+                                           read_only()->read_timestamp(),
+                                       .cancellation = cancellation});
     }
     case kReadWrite: {
       return query_engine_->ExecuteSql(
           query, backend::QueryContext{.schema = schema(),
                                        .reader = read_write(),
-                                       .writer = read_write()});
+                                       .writer = read_write(),
+                                       .partitioned_table = partitioned_table,
+                                       .partition_range = partition_range,
+                                       .cancellation = cancellation});
     }
     case kPartitionedDml: {
       auto context = backend::QueryContext{
           .schema = schema(), .reader = read_write(), .writer = read_write()};
-      ZETASQL_RETURN_IF_ERROR(query_engine_->IsValidPartitionedDML(query, context));
+      std::string partitioned_table;
+      ZETASQL_RETURN_IF_ERROR(query_engine_->IsValidPartitionedDML(query, context,
+                                                           &partitioned_table));
+      // The statement is executed over each key range of the table in a
+      // separate backend transaction which commits independently. The
+      // transaction itself has no writes, but is still committed since
       // PartitionedDml will auto-commit transactions and cannot be reused.
-      ZETASQL_ASSIGN_OR_RETURN(backend::QueryResult result,
-                       query_engine_->ExecuteSql(query, context));
+      backend::QueryResult result;
+      ZETASQL_ASSIGN_OR_RETURN(
+          result.modified_row_count,
+          database_->ExecutePartitionedDml(query, partitioned_table));
       ZETASQL_RETURN_IF_ERROR(read_write()->Commit());
       return result;
     }
   }
 }
 
+absl::optional<backend::TableStatistics> Transaction::GetTableStatistics(
+    const backend::Table& table) const {
+  return database_->GetTableStatistics(&table);
+}
+
 absl::Status Transaction::Write(const backend::Mutation& mutation) {
   mu_.AssertHeld();
   if (type_ == kReadWrite) {
@@ -232,6 +280,14 @@ absl::Status Transaction::Write(const backend::Mutation& mutation) {
   return error::CannotCommitRollbackReadOnlyOrPartitionedDmlTransaction();
 }
 
+absl::Status Transaction::WriteCoalesced(const backend::Mutation& mutation) {
+  mu_.AssertHeld();
+  if (type_ == kReadWrite) {
+    return read_write()->WriteCoalesced(mutation);
+  }
+  return error::CannotCommitRollbackReadOnlyOrPartitionedDmlTransaction();
+}
+
 absl::Status Transaction::Commit() {
   mu_.AssertHeld();
   if (type_ == kReadWrite) {
@@ -256,6 +312,13 @@ absl::Status Transaction::Rollback() {
   return error::CannotCommitRollbackReadOnlyOrPartitionedDmlTransaction();
 }
 
+absl::Time Transaction::AbortIfIdle(absl::Duration max_idle_time) {
+  if (type_ == kReadWrite) {
+    return read_write()->AbortIfIdle(max_idle_time);
+  }
+  return absl::InfiniteFuture();
+}
+
 zetasql_base::StatusOr<absl::Time> Transaction::GetReadTimestamp() const {
   if (type_ == kReadOnly) {
     return read_only()->read_timestamp();
@@ -307,9 +370,13 @@ Transaction::LookupOrRegisterDmlRequest(int64_t seqno, int64_t request_hash,
     }
 
     // Order was valid, so we record the new sequence number.
-    dml_requests_.emplace(
-        seqno, Transaction::RequestReplayState{.status = absl::OkStatus(),
-                                               .request_hash = request_hash});
+    dml_requests_.emplace_hint(
+        dml_requests_.end(), seqno,
+        Transaction::RequestReplayState{.status = absl::OkStatus(),
+                                        .request_hash = request_hash});
+    if (dml_requests_.size() > kMaxReplayableDmlRequests) {
+      dml_requests_.erase(dml_requests_.begin());
+    }
     dml_error_mode_ = DMLErrorHandlingMode::kDmlRequest;
     return absl::nullopt;
   }
@@ -355,7 +422,7 @@ void Transaction::SetDmlReplayOutcome(
   DCHECK(request != dml_requests_.end())
       << "DML sequence number was not registered.";
   if (request != dml_requests_.end()) {
-    request->second.outcome = outcome;
+    request->second.outcome = std::move(outcome);
   }
 }
 
@@ -365,6 +432,16 @@ Transaction::DMLErrorHandlingMode Transaction::DMLErrorType() const {
 
 absl::Status Transaction::GuardedCall(OpType op,
                                       const std::function<absl::Status()>& fn) {
+  // Reads and queries of a read-only transaction only read its fixed snapshot
+  // and never change the transaction state, so they run concurrently under a
+  // shared lock.
+  if (type_ == kReadOnly && (op == OpType::kRead || op == OpType::kSql)) {
+    absl::ReaderMutexLock lock(&mu_);
+    ZETASQL_RETURN_IF_ERROR(status_);
+    const absl::Status call_status = fn();
+    return absl::Status(call_status.code(), call_status.message());
+  }
+
   absl::MutexLock lock(&mu_);
 
   // Cannot reuse a transaction that previously encountered an error.
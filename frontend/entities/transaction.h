@@ -18,20 +18,26 @@
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_ENTITIES_TRANSACTIONS_H_
 
 #include <memory>
+#include <string>
 
 #include "google/protobuf/empty.pb.h"
 #include "google/spanner/v1/result_set.pb.h"
 #include "google/spanner/v1/spanner.pb.h"
 #include "google/spanner/v1/transaction.pb.h"
 #include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "absl/types/optional.h"
 #include "absl/types/variant.h"
 #include "backend/common/ids.h"
+#include "backend/database/database.h"
+#include "backend/datamodel/key_range.h"
 #include "backend/query/query_engine.h"
 #include "backend/schema/catalog/schema.h"
+#include "backend/storage/storage.h"
 #include "backend/transaction/read_only_transaction.h"
 #include "backend/transaction/read_write_transaction.h"
+#include "common/cancellation.h"
 #include "common/clock.h"
 #include "frontend/entities/database.h"
 #include "absl/status/status.h"
@@ -108,6 +114,7 @@ class Transaction {
                             std::unique_ptr<backend::ReadOnlyTransaction>>
                   backend_transaction,
               const backend::QueryEngine* query_engine,
+              backend::Database* database,
               const spanner_api::TransactionOptions& options,
               const Usage& usage);
 
@@ -128,22 +135,51 @@ class Transaction {
   // Returns the TransactionID from the backend transaction.
   backend::TransactionID id() const;
 
-  // Calls Read using the backend transaction.
+  // Calls Read using the backend transaction. If `cancellation` is not null,
+  // the rows stop once it is cancelled.
   absl::Status Read(const backend::ReadArg& read_arg,
-                    std::unique_ptr<backend::RowCursor>* cursor);
-
-  // Calls ExecuteSql using the backend transaction and query engine.
-  zetasql_base::StatusOr<backend::QueryResult> ExecuteSql(const backend::Query& query);
+                    std::unique_ptr<backend::RowCursor>* cursor,
+                    const CancellationToken* cancellation = nullptr);
+
+  // Calls ExecuteSql using the backend transaction and query engine. If
+  // `cancellation` is not null, the query stops once it is cancelled.
+  zetasql_base::StatusOr<backend::QueryResult> ExecuteSql(
+      const backend::Query& query,
+      const CancellationToken* cancellation = nullptr);
+
+  // Calls ExecuteSql as one partition of a partitioned query, only reading the
+  // rows of partitioned_table with keys in partition_range.
+  zetasql_base::StatusOr<backend::QueryResult> ExecuteSql(
+      const backend::Query& query, const std::string& partitioned_table,
+      const backend::KeyRange& partition_range,
+      const CancellationToken* cancellation = nullptr);
+
+  // Returns statistics of the rows of the given table of the schema, as of the
+  // latest writes to the database rather than the read timestamp of the
+  // transaction. Returns nullopt if the database keeps no statistics.
+  absl::optional<backend::TableStatistics> GetTableStatistics(
+      const backend::Table& table) const;
 
   // Calls Write using the backend transaction.
   absl::Status Write(const backend::Mutation& mutation);
 
+  // Calls WriteCoalesced using the backend transaction, for the mutations of a
+  // commit request.
+  absl::Status WriteCoalesced(const backend::Mutation& mutation);
+
   // Calls Commit using the backend transaction.
   absl::Status Commit();
 
   // Calls Rollback using the backend transaction.
   absl::Status Rollback();
 
+  // Calls AbortIfIdle using the backend transaction of a read-write
+  // transaction, see ReadWriteTransaction::AbortIfIdle. Returns
+  // absl::InfiniteFuture() for other transactions, which hold no locks.
+  // Unlike the calls above, may be called without holding the transaction's
+  // mutex.
+  absl::Time AbortIfIdle(absl::Duration max_idle_time);
+
   // Returns the read timestamp from the backend transaction.
   zetasql_base::StatusOr<absl::Time> GetReadTimestamp() const;
 
@@ -177,7 +213,10 @@ class Transaction {
   // Returns true if the current transaction is a PartitionedDmlTransaction.
   bool IsPartitionedDml() const { return type_ == kPartitionedDml; }
 
-  // All transaction methods should be called inside GuardedCall.
+  // All transaction methods should be called inside GuardedCall. Reads and
+  // queries of read-only transactions may run concurrently with each other, so
+  // fn must only use the methods which are safe to call under a shared lock:
+  // Read, ExecuteSql, GetTableStatistics and the state accessors.
   absl::Status GuardedCall(OpType op, const std::function<absl::Status()>& fn)
       ABSL_LOCKS_EXCLUDED(mu_);
 
@@ -202,6 +241,8 @@ class Transaction {
   // If a state already exists for a given sequence number with a matching
   // request hash, the replay state will be returned. If this is a new sequence
   // number, a new replay state will be registered and nullopt will be returned.
+  // Only the states of the most recent requests are kept, so a replay of an
+  // older request is reported as out of order.
   absl::optional<RequestReplayState> LookupOrRegisterDmlRequest(
       int64_t seqno, int64_t request_hash, const std::string& sql_statement);
 
@@ -241,6 +282,10 @@ class Transaction {
   // The query engine for executing queries.
   const backend::QueryEngine* query_engine_;
 
+  // The backend database, used to execute partitioned DML statements in
+  // transactions of their own.
+  backend::Database* database_;
+
   // True if this transaction should not be reused. In such a case, proto
   // representation of this transaction will not return transaction id.
   bool is_single_use_;
@@ -15,6 +15,8 @@
 //
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "google/longrunning/operations.pb.h"
 #include "google/protobuf/empty.pb.h"
@@ -22,6 +24,7 @@
 #include "backend/database/database.h"
 #include "backend/schema/ddl/operations.pb.h"
 #include "backend/schema/parser/ddl_parser.h"
+#include "common/cancellation.h"
 #include "common/errors.h"
 #include "common/limits.h"
 #include "frontend/common/uris.h"
@@ -107,29 +110,46 @@ absl::Status CreateDatabase(RequestContext* ctx,
     return error::InvalidDatabaseName(database_name);
   }
 
-  // Create the database.
-  std::string database_uri = MakeDatabaseUri(request->parent(), database_name);
-  std::vector<std::string> create_statements;
-  for (const std::string& statement : request->extra_statements()) {
-    create_statements.push_back(statement);
-  }
-  ZETASQL_ASSIGN_OR_RETURN(std::shared_ptr<Database> database,
-                   ctx->env()->database_manager()->CreateDatabase(
-                       database_uri, create_statements));
-
   // Create an operation tracking the database creation.
+  std::string database_uri = MakeDatabaseUri(request->parent(), database_name);
+  OperationManager* operation_manager = ctx->env()->operation_manager();
   ZETASQL_ASSIGN_OR_RETURN(std::shared_ptr<Operation> operation,
-                   ctx->env()->operation_manager()->CreateOperation(
+                   operation_manager->CreateOperation(
                        database_uri, OperationManager::kAutoGeneratedId));
-
   database_api::CreateDatabaseMetadata metadata;
   metadata.set_database(database_uri);
   operation->SetMetadata(metadata);
-  database_api::Database response_database;
-  ZETASQL_RETURN_IF_ERROR(database->ToProto(&response_database));
-  operation->SetResponse(response_database);
   operation->ToProto(response);
 
+  // The database, including its initial schema, is created in the background
+  // and the operation is returned right away, as Cloud Spanner does. Errors in
+  // the schema are reported via the operation.
+  std::vector<std::string> create_statements;
+  for (const std::string& statement : request->extra_statements()) {
+    create_statements.push_back(statement);
+  }
+  absl::Status status =
+      ctx->env()->database_manager()->CreateDatabaseInBackground(
+          database_uri, create_statements,
+          [operation](
+              zetasql_base::StatusOr<std::shared_ptr<Database>> database) {
+            if (!database.ok()) {
+              operation->SetError(database.status());
+              return;
+            }
+            database_api::Database response_database;
+            absl::Status status = (*database)->ToProto(&response_database);
+            if (!status.ok()) {
+              operation->SetError(status);
+              return;
+            }
+            operation->SetResponse(response_database);
+          });
+  if (!status.ok()) {
+    // Nothing is created, so the operation is not kept around.
+    operation_manager->DeleteOperation(response->name()).IgnoreError();
+    return status;
+  }
   return absl::OkStatus();
 }
 REGISTER_GRPC_HANDLER(DatabaseAdmin, CreateDatabase);
@@ -175,29 +195,17 @@ absl::Status UpdateDatabaseDdl(
   for (const std::string& statement : request->statements()) {
     statements.push_back(statement);
   }
-
-  backend::Database* backend_database = database->backend();
-  int num_succesful_statements;
-  absl::Time commit_timestamp;
-  absl::Status backfill_status;
-  ZETASQL_RETURN_IF_ERROR(
-      backend_database->UpdateSchema(statements, &num_succesful_statements,
-                                     &commit_timestamp, &backfill_status));
-
-  // Populate ResultSet metadata.
-  // For simplicity in emulator, we have implemented the schema updates in such
-  // a way that all the statements in update ddl execute at the same commit
-  // timestamp.
-  database_api::UpdateDatabaseDdlMetadata update_md;
-  update_md.set_database(request->database());
-  for (const std::string& statement : statements) {
-    update_md.add_statements(statement);
+  if (statements.empty()) {
+    return error::UpdateDatabaseMissingStatements();
   }
 
-  // Only the timestamps of the successful statements are reported.
-  for (int i = 0; i < num_succesful_statements; ++i) {
-    ZETASQL_ASSIGN_OR_RETURN(*update_md.add_commit_timestamps(),
-                     TimestampToProto(commit_timestamp));
+  // Like Cloud Spanner, reject statements which are invalid for the current
+  // schema without starting an operation for them. If earlier schema changes
+  // are still pending, the statements may depend on them, and are validated by
+  // the operation once those have been applied.
+  if (!database->HasPendingSchemaChanges()) {
+    ZETASQL_RETURN_IF_ERROR(
+        database->backend()->ValidateSchemaChange(statements));
   }
 
   // Create operation to be returned as part of the response.
@@ -205,14 +213,54 @@ absl::Status UpdateDatabaseDdl(
   ZETASQL_ASSIGN_OR_RETURN(std::shared_ptr<Operation> operation,
                    ctx->env()->operation_manager()->CreateOperation(
                        request->database(), request->operation_id()));
-  operation->SetMetadata(update_md);
-  if (backfill_status.ok()) {
-    operation->SetResponse(protobuf_api::Empty());
-  } else {
-    operation->SetError(backfill_status);
+  database_api::UpdateDatabaseDdlMetadata update_md;
+  update_md.set_database(request->database());
+  for (const std::string& statement : statements) {
+    update_md.add_statements(statement);
   }
+  operation->SetMetadata(update_md);
   operation->ToProto(response);
 
+  // The schema change, including any backfills, runs in the background and its
+  // progress is reported via the operation. Reads are not blocked meanwhile,
+  // they are served with the schema preceding the change.
+  backend::Database* backend_database = database->backend();
+  const CancellationToken* cancellation =
+      database->schema_change_cancellation();
+  database->ScheduleSchemaChange([backend_database, cancellation, operation,
+                                  update_md, statements]() mutable {
+    int num_succesful_statements;
+    absl::Time commit_timestamp;
+    absl::Status backfill_status;
+    absl::Status status = backend_database->UpdateSchema(
+        statements, &num_succesful_statements, &commit_timestamp,
+        &backfill_status, cancellation);
+    if (!status.ok()) {
+      operation->SetError(status);
+      return;
+    }
+
+    // For simplicity in emulator, we have implemented the schema updates in
+    // such a way that all the statements in update ddl execute at the same
+    // commit timestamp. Only the timestamps of the successful statements are
+    // reported.
+    for (int i = 0; i < num_succesful_statements; ++i) {
+      zetasql_base::StatusOr<protobuf_api::Timestamp> timestamp =
+          TimestampToProto(commit_timestamp);
+      if (!timestamp.ok()) {
+        operation->SetError(timestamp.status());
+        return;
+      }
+      *update_md.add_commit_timestamps() = timestamp.value();
+    }
+    operation->SetMetadata(update_md);
+    if (backfill_status.ok()) {
+      operation->SetResponse(protobuf_api::Empty());
+    } else {
+      operation->SetError(backfill_status);
+    }
+  });
+
   return absl::OkStatus();
 }
 REGISTER_GRPC_HANDLER(DatabaseAdmin, UpdateDatabaseDdl);
@@ -232,13 +280,8 @@ absl::Status DropDatabase(RequestContext* ctx,
   auto maybe_database =
       ctx->env()->database_manager()->GetDatabase(request->database());
   if (maybe_database.ok()) {
-    ZETASQL_ASSIGN_OR_RETURN(
-        std::vector<std::shared_ptr<Session>> sessions,
-        ctx->env()->session_manager()->ListSessions(request->database()));
-    for (auto session : sessions) {
-      ZETASQL_RETURN_IF_ERROR(
-          ctx->env()->session_manager()->DeleteSession(session->session_uri()));
-    }
+    ZETASQL_RETURN_IF_ERROR(
+        ctx->env()->session_manager()->DeleteSessions(request->database()));
   }
 
   // Clean up the database.
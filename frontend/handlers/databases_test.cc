@@ -15,6 +15,9 @@
 //
 
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "google/protobuf/any.pb.h"
 #include "google/spanner/admin/database/v1/spanner_database_admin.pb.h"
@@ -80,7 +83,9 @@ class DatabaseApiTest : public test::ServerTest {
     ZETASQL_RET_CHECK(operation.metadata().UnpackTo(&metadata));
     ZETASQL_RET_CHECK_EQ(metadata.database(),
                  MakeDatabaseUri(instance_uri, database_name));
-    return absl::OkStatus();
+    google::rpc::Status status = operation.error();
+    return absl::Status(static_cast<absl::StatusCode>(status.code()),
+                        status.message());
   }
 
   absl::Status GetDatabase(const std::string& database_uri,
@@ -198,6 +203,20 @@ TEST_F(DatabaseApiTest, CreateDatabaseWithInvalidInitialSchema) {
       StatusIs(absl::StatusCode::kInvalidArgument));
 }
 
+TEST_F(DatabaseApiTest, CreateDatabaseWithInvalidInitialSchemaCanBeRetried) {
+  EXPECT_THAT(
+      CreateDatabase(test_instance_uri_, test_database_name_, {"INVALID DDL"}),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+
+  // The failed database is neither listed nor reserved.
+  database_api::Database database;
+  EXPECT_THAT(GetDatabase(MakeDatabaseUri(test_instance_uri_,
+                                          test_database_name_),
+                          &database),
+              StatusIs(absl::StatusCode::kNotFound));
+  ZETASQL_EXPECT_OK(CreateDatabase(test_instance_uri_, test_database_name_));
+}
+
 TEST_F(DatabaseApiTest, CreateDuplicateDatabaseReturnsAlreadyExists) {
   ZETASQL_EXPECT_OK(CreateDatabase(test_instance_uri_, test_database_name_));
 
@@ -342,6 +361,78 @@ TEST_F(DatabaseApiTest, UpdateDatabaseDdlPartialSuccess) {
   }
 }
 
+TEST_F(DatabaseApiTest, UpdateDatabaseDdlRunsInBackground) {
+  ZETASQL_EXPECT_OK(CreateTestDatabase());
+
+  grpc::ClientContext context;
+  database_api::UpdateDatabaseDdlRequest request;
+  request.set_database(test_database_uri_);
+  request.add_statements("CREATE INDEX test_index ON test_table(string_col)");
+  operations_api::Operation operation;
+  ZETASQL_ASSERT_OK(test_env()->database_admin_client()->UpdateDatabaseDdl(
+      &context, request, &operation));
+
+  // The operation is returned before the schema change is applied.
+  database_api::UpdateDatabaseDdlMetadata metadata;
+  EXPECT_FALSE(operation.done());
+  ASSERT_TRUE(operation.metadata().UnpackTo(&metadata));
+  EXPECT_EQ(metadata.statements_size(), 1);
+  EXPECT_EQ(metadata.commit_timestamps_size(), 0);
+
+  ZETASQL_ASSERT_OK(WaitForOperation(operation.name(), &operation));
+  EXPECT_FALSE(operation.has_error());
+  ASSERT_TRUE(operation.metadata().UnpackTo(&metadata));
+  EXPECT_EQ(metadata.commit_timestamps_size(), 1);
+
+  database_api::GetDatabaseDdlResponse response;
+  ZETASQL_ASSERT_OK(GetDatabaseDdl(test_database_uri_, &response));
+  EXPECT_THAT(response.statements(),
+              testing::Contains(testing::HasSubstr("test_index")));
+}
+
+TEST_F(DatabaseApiTest, UpdateDatabaseDdlRejectsInvalidStatementsDirectly) {
+  ZETASQL_EXPECT_OK(CreateTestDatabase());
+
+  auto list_operations = [this](operations_api::ListOperationsResponse*
+                                    response) {
+    grpc::ClientContext context;
+    operations_api::ListOperationsRequest request;
+    request.set_name(absl::StrCat(test_database_uri_, "/operations"));
+    return test_env()->operations_client()->ListOperations(&context, request,
+                                                           response);
+  };
+  operations_api::ListOperationsResponse operations_before;
+  ZETASQL_ASSERT_OK(list_operations(&operations_before));
+
+  // Statements which fail to parse or are invalid for the schema of the
+  // database are rejected by the call itself.
+  for (const auto& [statement, code] :
+       std::vector<std::pair<std::string, absl::StatusCode>>{
+           {"CREATE TABLE", absl::StatusCode::kInvalidArgument},
+           {"CREATE INDEX test_index ON missing_table(string_col)",
+            absl::StatusCode::kNotFound},
+       }) {
+    grpc::ClientContext context;
+    database_api::UpdateDatabaseDdlRequest request;
+    request.set_database(test_database_uri_);
+    request.add_statements(statement);
+    operations_api::Operation operation;
+    EXPECT_THAT(test_env()->database_admin_client()->UpdateDatabaseDdl(
+                    &context, request, &operation),
+                StatusIs(code));
+  }
+
+  // No operation was started for them, and the schema is unchanged.
+  operations_api::ListOperationsResponse operations_after;
+  ZETASQL_ASSERT_OK(list_operations(&operations_after));
+  EXPECT_EQ(operations_after.operations_size(),
+            operations_before.operations_size());
+  database_api::GetDatabaseDdlResponse response;
+  ZETASQL_ASSERT_OK(GetDatabaseDdl(test_database_uri_, &response));
+  EXPECT_THAT(response.statements(), testing::Not(testing::Contains(
+                                         testing::HasSubstr("test_index"))));
+}
+
 TEST_F(DatabaseApiTest, GetDatabaseNonExistentDatabase) {
   database_api::Database database;
   EXPECT_THAT(GetDatabase(test_database_uri_, &database),
@@ -14,7 +14,10 @@
 // limitations under the License.
 //
 
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "google/longrunning/operations.pb.h"
 #include "google/protobuf/empty.pb.h"
@@ -39,12 +42,32 @@ absl::Status ListOperations(
   absl::string_view resource_uri, operation_id;
   ZETASQL_RETURN_IF_ERROR(ParseOperationUri(absl::StrCat(request->name(), "/"),
                                     &resource_uri, &operation_id));
-  ZETASQL_ASSIGN_OR_RETURN(
-      std::vector<std::shared_ptr<Operation>> operations,
-      ctx->env()->operation_manager()->ListOperations(request->name()));
+
+  // Validate that the page_token provided is a valid operation_uri.
+  if (!request->page_token().empty()) {
+    absl::string_view token_resource_uri, token_operation_id;
+    ZETASQL_RETURN_IF_ERROR(ParseOperationUri(request->page_token(),
+                                      &token_resource_uri, &token_operation_id));
+  }
+
+  int32_t page_size = request->page_size();
+  static const int32_t kMaxPageSize = 1000;
+  if (page_size <= 0 || page_size > kMaxPageSize) {
+    page_size = kMaxPageSize;
+  }
+
+  // Operations returned from operation manager are sorted by operation_uri and
+  // thus we use operation uri of first operation in next page as
+  // next_page_token.
+  std::string next_page_token;
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<std::shared_ptr<Operation>> operations,
+                   ctx->env()->operation_manager()->ListOperations(
+                       std::string(resource_uri), request->page_token(),
+                       page_size, &next_page_token));
   for (const auto& op : operations) {
     op->ToProto(response->add_operations());
   }
+  response->set_next_page_token(next_page_token);
   return absl::OkStatus();
 }
 REGISTER_GRPC_HANDLER(Operations, ListOperations);
@@ -14,19 +14,39 @@
 // limitations under the License.
 //
 
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "google/protobuf/struct.pb.h"
 #include "google/spanner/v1/keys.pb.h"
 #include "google/spanner/v1/spanner.pb.h"
 #include "google/spanner/v1/transaction.pb.h"
 #include "google/spanner/v1/type.pb.h"
 #include "zetasql/base/statusor.h"
+#include "absl/types/optional.h"
+#include "backend/access/read.h"
+#include "backend/datamodel/key.h"
+#include "backend/datamodel/key_range.h"
+#include "backend/datamodel/key_set.h"
 #include "backend/query/query_engine.h"
+#include "backend/schema/catalog/column.h"
+#include "backend/schema/catalog/index.h"
+#include "backend/schema/catalog/schema.h"
+#include "backend/schema/catalog/table.h"
+#include "backend/storage/storage.h"
 #include "common/config.h"
 #include "common/errors.h"
+#include "frontend/converters/keys.h"
 #include "frontend/converters/partition.h"
 #include "frontend/converters/query.h"
 #include "frontend/converters/reads.h"
+#include "frontend/converters/values.h"
 #include "frontend/entities/session.h"
+#include "frontend/entities/transaction.h"
 #include "frontend/proto/partition_token.pb.h"
 #include "frontend/server/handler.h"
 #include "absl/status/status.h"
@@ -41,6 +61,14 @@ namespace frontend {
 
 namespace {
 
+// Partition size used when the request does not specify one. This matches the
+// default of Cloud Spanner.
+constexpr int64_t kDefaultPartitionSizeBytes = int64_t{1} << 30;
+
+// Tables with at least this many rows are split at keys sampled from their
+// rows rather than by reading them, see SplitKeySpace.
+constexpr int64_t kMinRowsToSplitBySample = 10000;
+
 absl::Status ValidateTransactionSelectorForPartitionRead(
     const spanner_api::TransactionSelector& selector) {
   // PartitionRead and PartitionQuery only support read only snapshot
@@ -73,15 +101,184 @@ absl::Status ValidatePartitionOptions(
   return absl::OkStatus();
 }
 
-// Create a partition token for the given partition read request and partitioned
-// key set.
+// Returns the number of partitions to split data of the given size into.
+int64_t NumPartitions(const spanner_api::PartitionOptions& partition_options,
+                      int64_t data_size_bytes) {
+  // max_partitions alone requests that many partitions. Otherwise, the data is
+  // split into partitions of partition_size_bytes, of which there can be at
+  // most max_partitions.
+  if (partition_options.partition_size_bytes() == 0 &&
+      partition_options.max_partitions() > 0) {
+    return partition_options.max_partitions();
+  }
+  const int64_t partition_size_bytes =
+      partition_options.partition_size_bytes() > 0
+          ? partition_options.partition_size_bytes()
+          : kDefaultPartitionSizeBytes;
+  int64_t num_partitions =
+      (data_size_bytes + partition_size_bytes - 1) / partition_size_bytes;
+  if (partition_options.max_partitions() > 0) {
+    num_partitions =
+        std::min(num_partitions, partition_options.max_partitions());
+  }
+  return std::max<int64_t>(num_partitions, 1);
+}
+
+// Returns the closed-open ranges between consecutive split keys, starting at
+// the start of the key space and ending at its end.
+std::vector<spanner_api::KeyRange> KeyRangesBetween(
+    const std::vector<const google::protobuf::ListValue*>& split_keys) {
+  // The first range starts at the empty key, i.e. the start of the key space,
+  // and the last one ends at (and includes every key prefixed by) the empty
+  // key, i.e. the end of the key space.
+  std::vector<spanner_api::KeyRange> ranges(split_keys.size() + 1);
+  ranges.front().mutable_start_closed();
+  for (int i = 0; i < split_keys.size(); ++i) {
+    *ranges[i].mutable_end_open() = *split_keys[i];
+    *ranges[i + 1].mutable_start_closed() = *split_keys[i];
+  }
+  ranges.back().mutable_end_closed();
+  return ranges;
+}
+
+// Splits the key space of a table at keys sampled from its rows, so that the
+// ranges hold about the same number of rows, see SplitKeySpace.
+zetasql_base::StatusOr<std::vector<spanner_api::KeyRange>> SplitAtSampledKeys(
+    const backend::TableStatistics& statistics, int num_key_columns,
+    const spanner_api::PartitionOptions& partition_options) {
+  // Sampled keys of index data tables which only differ in the columns of the
+  // indexed table make the same split key.
+  std::vector<google::protobuf::ListValue> sampled_keys;
+  std::string last_key;
+  for (const backend::Key& key : statistics.sample_keys) {
+    google::protobuf::ListValue sampled_key;
+    for (int i = 0; i < num_key_columns && i < key.NumColumns(); ++i) {
+      ZETASQL_ASSIGN_OR_RETURN(*sampled_key.add_values(),
+                       ValueToProto(key.ColumnValue(i)));
+    }
+    std::string serialized_key = sampled_key.SerializeAsString();
+    if (sampled_keys.empty() || serialized_key != last_key) {
+      sampled_keys.push_back(std::move(sampled_key));
+      last_key = std::move(serialized_key);
+    }
+  }
+
+  const int64_t num_sampled_keys = sampled_keys.size();
+  const int64_t num_partitions =
+      std::min(NumPartitions(partition_options, statistics.bytes),
+               std::max<int64_t>(num_sampled_keys, 1));
+  std::vector<const google::protobuf::ListValue*> split_keys;
+  for (int64_t i = 1; i < num_partitions; ++i) {
+    split_keys.push_back(&sampled_keys[i * num_sampled_keys / num_partitions]);
+  }
+  return KeyRangesBetween(split_keys);
+}
+
+// Splits the key space of key_table into ranges, so that the rows returned by
+// read_arg are spread evenly (by size) across the ranges. key_table is the
+// table read by read_arg, or the index data table if it reads an index. The
+// ranges are closed-open, ordered, and together cover the whole key space.
+//
+// If read_arg reads the whole key space of a large table, the ranges are
+// split at keys sampled from the rows instead, so that the rows are not read
+// twice, once to split them and again by the partitions. Such ranges hold
+// about the same number of rows, as of the latest writes to the table.
+zetasql_base::StatusOr<std::vector<spanner_api::KeyRange>> SplitKeySpace(
+    Transaction* txn, backend::ReadArg read_arg,
+    const backend::Table& key_table, bool whole_key_space,
+    const spanner_api::PartitionOptions& partition_options) {
+  // Rows are split on the user visible key columns, which for index data
+  // tables are the indexed columns.
+  const int num_key_columns =
+      key_table.owner_index() != nullptr
+          ? key_table.owner_index()->key_columns().size()
+          : key_table.primary_key().size();
+
+  if (whole_key_space) {
+    absl::optional<backend::TableStatistics> statistics =
+        txn->GetTableStatistics(key_table);
+    if (statistics.has_value() &&
+        statistics->num_rows >= kMinRowsToSplitBySample) {
+      return SplitAtSampledKeys(*statistics, num_key_columns,
+                                partition_options);
+    }
+  }
+
+  // Read the key columns first, followed by the other columns of read_arg so
+  // that the size of the rows can be estimated.
+  std::vector<std::string> columns;
+  for (int i = 0; i < num_key_columns; ++i) {
+    columns.push_back(key_table.primary_key()[i]->column()->Name());
+  }
+  for (const std::string& column : read_arg.columns) {
+    if (std::find(columns.begin(), columns.end(), column) == columns.end()) {
+      columns.push_back(column);
+    }
+  }
+  read_arg.columns = std::move(columns);
+  std::unique_ptr<backend::RowCursor> cursor;
+  ZETASQL_RETURN_IF_ERROR(txn->Read(read_arg, &cursor));
+
+  // Keys and sizes of the rows, in key order.
+  std::vector<google::protobuf::ListValue> keys;
+  std::vector<int64_t> row_sizes;
+  int64_t total_size = 0;
+  while (cursor->Next()) {
+    google::protobuf::ListValue key;
+    int64_t row_size = 0;
+    for (int i = 0; i < cursor->NumColumns(); ++i) {
+      ZETASQL_ASSIGN_OR_RETURN(google::protobuf::Value value,
+                       ValueToProto(cursor->ColumnValue(i)));
+      row_size += value.ByteSizeLong();
+      if (i < num_key_columns) {
+        *key.add_values() = std::move(value);
+      }
+    }
+    keys.push_back(std::move(key));
+    row_sizes.push_back(row_size);
+    total_size += row_size;
+  }
+  ZETASQL_RETURN_IF_ERROR(cursor->Status());
+
+  // Pick the split keys so that each partition holds about the same amount of
+  // data: the j-th split is placed at the first row whose midpoint lies past
+  // j/num_partitions of the data, or earlier if there would not be enough rows
+  // left for the remaining partitions otherwise. Rows with the same key (e.g.
+  // duplicates in a non-unique index) cannot be split apart, which may produce
+  // fewer partitions.
+  const int64_t num_rows = keys.size();
+  const int64_t num_partitions =
+      std::min(NumPartitions(partition_options, total_size),
+               std::max<int64_t>(num_rows, 1));
+  std::vector<const google::protobuf::ListValue*> split_keys;
+  int64_t size_before_row = 0;
+  for (int64_t i = 0; i < num_rows; ++i) {
+    const int64_t next_split = split_keys.size() + 1;
+    const bool past_split_point =
+        (2 * size_before_row + row_sizes[i]) * num_partitions >=
+        2 * next_split * total_size;
+    const bool out_of_rows = num_rows - i <= num_partitions - next_split;
+    if (next_split < num_partitions && i > 0 &&
+        (past_split_point || out_of_rows) &&
+        keys[i].SerializeAsString() != keys[i - 1].SerializeAsString()) {
+      split_keys.push_back(&keys[i]);
+    }
+    size_before_row += row_sizes[i];
+  }
+  return KeyRangesBetween(split_keys);
+}
+
+// Create a partition token for the given partition read request, reading the
+// keys and ranges of partitioned_key_set, resolved against the schema of the
+// given generation.
 zetasql_base::StatusOr<PartitionToken> CreatePartitionTokenForRead(
     const google::spanner::v1::PartitionReadRequest& request,
-    const backend::TransactionID& txn_id,
+    const backend::TransactionID& txn_id, int64_t schema_generation,
     const google::spanner::v1::KeySet& partitioned_key_set) {
   PartitionToken partition_token;
   *partition_token.mutable_session() = request.session();
   *partition_token.mutable_transaction_id() = std::to_string(txn_id);
+  partition_token.set_schema_generation(schema_generation);
 
   auto read_params = partition_token.mutable_read_params();
   *read_params->mutable_table() = request.table();
@@ -93,23 +290,31 @@ zetasql_base::StatusOr<PartitionToken> CreatePartitionTokenForRead(
   return partition_token;
 }
 
-// Create a partition token for the given partition query request.
+// Create a partition token for the given partition query request, covering
+// the partition_range of partitioned_table. If partitioned_table is empty, the
+// token covers the whole query.
 zetasql_base::StatusOr<PartitionToken> CreatePartitionTokenForQuery(
     const google::spanner::v1::PartitionQueryRequest& request,
-    const backend::TransactionID& txn_id, bool empty_partition) {
+    const backend::TransactionID& txn_id, int64_t schema_generation,
+    const std::string& partitioned_table,
+    const google::spanner::v1::KeyRange& partition_range) {
   if (request.sql().empty()) {
     return error::MissingRequiredFieldError("sql");
   }
   PartitionToken partition_token;
   *partition_token.mutable_session() = request.session();
   *partition_token.mutable_transaction_id() = std::to_string(txn_id);
+  partition_token.set_schema_generation(schema_generation);
 
   auto query_params = partition_token.mutable_query_params();
   *query_params->mutable_sql() = request.sql();
   *query_params->mutable_params() = request.params();
   *query_params->mutable_param_types() = request.param_types();
 
-  partition_token.set_empty_query_partition(empty_partition);
+  if (!partitioned_table.empty()) {
+    query_params->set_partitioned_table(partitioned_table);
+    *partition_token.mutable_partition_range() = partition_range;
+  }
   return partition_token;
 }
 
@@ -141,25 +346,55 @@ absl::Status PartitionRead(RequestContext* ctx,
     ZETASQL_ASSIGN_OR_RETURN(*response->mutable_transaction(), txn->ToProto());
   }
 
-  // Add two partitions to result set, with first partition being empty.
-  ZETASQL_ASSIGN_OR_RETURN(
-      auto empty_partition_token,
-      CreatePartitionTokenForRead(*request, txn->id(), spanner_api::KeySet()));
-  spanner_api::Partition empty_partition;
-  ZETASQL_ASSIGN_OR_RETURN(*empty_partition.mutable_partition_token(),
-                   PartitionTokenToString(empty_partition_token));
+  // Split the requested key set into partitions by key ranges of the table
+  // (or index) being read. The keys and ranges of the key set within each
+  // partition are resolved here once, rather than by every read of the
+  // partitions.
+  std::vector<spanner_api::KeySet> partitioned_key_sets;
+  int64_t schema_generation = 0;
+  ZETASQL_RETURN_IF_ERROR(txn->GuardedCall(
+      Transaction::OpType::kRead, [&]() -> absl::Status {
+        spanner_api::ReadRequest read_request;
+        read_request.set_table(request->table());
+        read_request.set_index(request->index());
+        *read_request.mutable_columns() = request->columns();
+        *read_request.mutable_key_set() = request->key_set();
+        backend::ReadArg read_arg;
+        ZETASQL_RETURN_IF_ERROR(
+            ReadArgFromProto(*txn->schema(), read_request, &read_arg));
 
-  // Second partition contains full result set for requested key_set.
-  ZETASQL_ASSIGN_OR_RETURN(
-      auto full_partition_token,
-      CreatePartitionTokenForRead(*request, txn->id(), request->key_set()));
-  spanner_api::Partition full_partition;
-  ZETASQL_ASSIGN_OR_RETURN(*full_partition.mutable_partition_token(),
-                   PartitionTokenToString(full_partition_token));
-
-  *response->mutable_partitions()->Add() = empty_partition;
-  *response->mutable_partitions()->Add() = full_partition;
+        const backend::Table* key_table =
+            txn->schema()->FindTable(request->table());
+        if (!request->index().empty()) {
+          key_table = txn->schema()->FindIndex(request->index())
+                          ->index_data_table();
+        }
+        std::vector<spanner_api::KeyRange> partition_ranges;
+        ZETASQL_ASSIGN_OR_RETURN(partition_ranges,
+                         SplitKeySpace(txn.get(), read_arg, *key_table,
+                                       request->key_set().all(),
+                                       request->partition_options()));
+        for (const spanner_api::KeyRange& range_pb : partition_ranges) {
+          ZETASQL_ASSIGN_OR_RETURN(backend::KeyRange range,
+                           KeyRangeFromProto(range_pb, *key_table));
+          ZETASQL_ASSIGN_OR_RETURN(
+              spanner_api::KeySet key_set_pb,
+              KeySetToProto(backend::IntersectKeySet(read_arg.key_set, range)));
+          partitioned_key_sets.push_back(std::move(key_set_pb));
+        }
+        schema_generation = txn->schema()->generation();
+        return absl::OkStatus();
+      }));
 
+  for (const spanner_api::KeySet& partitioned_key_set : partitioned_key_sets) {
+    ZETASQL_ASSIGN_OR_RETURN(
+        auto partition_token,
+        CreatePartitionTokenForRead(*request, txn->id(), schema_generation,
+                                    partitioned_key_set));
+    ZETASQL_ASSIGN_OR_RETURN(
+        *response->add_partitions()->mutable_partition_token(),
+        PartitionTokenToString(partition_token));
+  }
   return absl::OkStatus();
 }
 REGISTER_GRPC_HANDLER(Spanner, PartitionRead);
@@ -195,30 +430,50 @@ absl::Status PartitionQuery(RequestContext* ctx,
       backend::Query query,
       QueryFromProto(request->sql(), request->params(), request->param_types(),
                      txn->query_engine()->type_factory()));
+  std::string partitioned_table;
   ZETASQL_RETURN_IF_ERROR(txn->query_engine()->IsPartitionable(
       query,
       backend::QueryContext{
-          .schema = txn->schema(), .reader = nullptr, .writer = nullptr}));
-
-  // Add two partitions to result set, with first partition being empty.
-  ZETASQL_ASSIGN_OR_RETURN(auto empty_partition_token,
-                   CreatePartitionTokenForQuery(*request, txn->id(),
-                                                /*empty_partition =*/true));
-  spanner_api::Partition empty_partition;
-  ZETASQL_ASSIGN_OR_RETURN(*empty_partition.mutable_partition_token(),
-                   PartitionTokenToString(empty_partition_token));
-
-  // Second partition contains full result set for requested query.
-  ZETASQL_ASSIGN_OR_RETURN(auto full_partition_token,
-                   CreatePartitionTokenForQuery(*request, txn->id(),
-                                                /*empty_partition =*/false));
-  spanner_api::Partition full_partition;
-  ZETASQL_ASSIGN_OR_RETURN(*full_partition.mutable_partition_token(),
-                   PartitionTokenToString(full_partition_token));
-
-  *response->mutable_partitions()->Add() = empty_partition;
-  *response->mutable_partitions()->Add() = full_partition;
+          .schema = txn->schema(), .reader = nullptr, .writer = nullptr},
+      &partitioned_table));
 
+  // Split the query into partitions by key ranges of the table it scans. A
+  // query which is only known to be partitionable through a hint is returned
+  // as a single partition.
+  std::vector<spanner_api::KeyRange> partition_ranges(1);
+  const int64_t schema_generation = txn->schema()->generation();
+  if (!partitioned_table.empty()) {
+    ZETASQL_RETURN_IF_ERROR(txn->GuardedCall(
+        Transaction::OpType::kRead, [&]() -> absl::Status {
+          const backend::Table* table =
+              txn->schema()->FindTable(partitioned_table);
+          if (table == nullptr) {
+            return error::TableNotFound(partitioned_table);
+          }
+          backend::ReadArg read_arg;
+          read_arg.table = partitioned_table;
+          read_arg.key_set = backend::KeySet::All();
+          for (const backend::Column* column : table->columns()) {
+            read_arg.columns.push_back(column->Name());
+          }
+          ZETASQL_ASSIGN_OR_RETURN(partition_ranges,
+                           SplitKeySpace(txn.get(), read_arg, *table,
+                                         /*whole_key_space=*/true,
+                                         request->partition_options()));
+          return absl::OkStatus();
+        }));
+  }
+
+  for (const spanner_api::KeyRange& partition_range : partition_ranges) {
+    ZETASQL_ASSIGN_OR_RETURN(auto partition_token,
+                     CreatePartitionTokenForQuery(*request, txn->id(),
+                                                  schema_generation,
+                                                  partitioned_table,
+                                                  partition_range));
+    ZETASQL_ASSIGN_OR_RETURN(
+        *response->add_partitions()->mutable_partition_token(),
+        PartitionTokenToString(partition_token));
+  }
   return absl::OkStatus();
 }
 REGISTER_GRPC_HANDLER(Spanner, PartitionQuery);
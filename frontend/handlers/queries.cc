@@ -14,7 +14,9 @@
 // limitations under the License.
 //
 
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <utility>
 
 #include "google/protobuf/struct.pb.h"
@@ -23,13 +25,25 @@
 #include "google/spanner/v1/transaction.pb.h"
 #include "zetasql/base/statusor.h"
 #include "absl/strings/cord.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "absl/types/optional.h"
 #include "absl/types/variant.h"
 #include "backend/access/read.h"
+#include "backend/datamodel/key_range.h"
 #include "backend/query/query_engine.h"
+#include "backend/query/query_profile.h"
+#include "backend/schema/catalog/schema.h"
+#include "backend/schema/catalog/table.h"
+#include "common/cancellation.h"
 #include "common/constants.h"
 #include "common/errors.h"
+#include "common/limits.h"
+#include "common/slow_log.h"
 #include "frontend/common/protos.h"
+#include "frontend/converters/keys.h"
 #include "frontend/converters/partition.h"
 #include "frontend/converters/query.h"
 #include "frontend/converters/reads.h"
@@ -132,60 +146,160 @@ absl::Status ValidatePartitionToken(
   return absl::OkStatus();
 }
 
+// QueryPartition describes the partition of a partitioned query to execute.
+struct QueryPartition {
+  // Table scanned by the query, whose reads only return rows with keys in
+  // range. Empty if the query is not partitioned by key ranges.
+  std::string table;
+  backend::KeyRange range = backend::KeyRange::All();
+
+  // True if the query should return no rows.
+  bool empty = false;
+};
+
+// Returns the partition of the query described by the partition token of
+// request, or the whole query if the request has no partition token.
+zetasql_base::StatusOr<QueryPartition> QueryPartitionFromRequest(
+    const spanner_api::ExecuteSqlRequest* request,
+    const backend::Schema& schema) {
+  QueryPartition partition;
+  if (request->partition_token().empty()) {
+    return partition;
+  }
+  ZETASQL_ASSIGN_OR_RETURN(auto partition_token,
+                   PartitionTokenFromString(request->partition_token()));
+  ZETASQL_RETURN_IF_ERROR(ValidatePartitionToken(partition_token, request));
+  if (partition_token.schema_generation() != schema.generation()) {
+    return error::InvalidPartitionToken();
+  }
+  partition.empty = partition_token.empty_query_partition();
+
+  const std::string& table_name =
+      partition_token.query_params().partitioned_table();
+  if (table_name.empty() || !partition_token.has_partition_range()) {
+    return partition;
+  }
+  const backend::Table* table = schema.FindTable(table_name);
+  if (table == nullptr) {
+    return error::TableNotFound(table_name);
+  }
+  partition.table = table_name;
+  ZETASQL_ASSIGN_OR_RETURN(partition.range,
+                   KeyRangeFromProto(partition_token.partition_range(), *table));
+  return partition;
+}
+
 bool IsDmlResult(const backend::QueryResult& result) {
   return result.rows == nullptr;
 }
 
-void AddQueryStatsFromQueryResult(const backend::QueryResult& result,
-                                  google::protobuf::Struct* stats) {
+// Query rows are evaluated as the result's row cursor is read, so the stats
+// are only known once the rows have been converted. The query plan and the
+// rows scanned and CPU time are added if a profile of the query was collected.
+void AddQueryStats(int64_t rows_returned, absl::Duration elapsed_time,
+                   const backend::QueryProfile* profile,
+                   spanner_api::ResultSetStats* result_stats) {
+  google::protobuf::Struct* stats = result_stats->mutable_query_stats();
   (*stats->mutable_fields())["rows_returned"].set_string_value(
-      absl::StrCat(result.num_output_rows));
+      absl::StrCat(rows_returned));
   (*stats->mutable_fields())["elapsed_time"].set_string_value(
-      absl::FormatDuration(result.elapsed_time));
+      absl::FormatDuration(elapsed_time));
+  if (profile == nullptr) {
+    return;
+  }
+  (*stats->mutable_fields())["rows_scanned"].set_string_value(
+      absl::StrCat(profile->total_rows_scanned()));
+  (*stats->mutable_fields())["cpu_time"].set_string_value(
+      absl::FormatDuration(profile->cpu_time()));
+  QueryPlanToProto(*profile, rows_returned,
+                   result_stats->mutable_query_plan());
 }
 
 zetasql_base::StatusOr<backend::QueryResult> ExecuteQuery(
     const spanner_api::ExecuteBatchDmlRequest_Statement& statement,
-    std::shared_ptr<Transaction> txn) {
+    std::shared_ptr<Transaction> txn, const CancellationToken* cancellation) {
   ZETASQL_ASSIGN_OR_RETURN(const backend::Query query,
                    QueryFromProto(statement.sql(), statement.params(),
                                   statement.param_types(),
                                   txn->query_engine()->type_factory()));
-  return txn->ExecuteSql(query);
+  return txn->ExecuteSql(query, cancellation);
 }
 
-template <typename Request>
-int64_t SerializeAndHashRequest(const Request& request) {
-  std::string serialized_request;
-  {
-    // Serialize the request proto deterministically.
-    // Message::SerializeToString() is not guaranteed to deterministically
-    // generate the same string for a message that contains map fields.
-    // We create the output stream in an inner scope so that it gets flushed
-    // in the destructor before computing the fingerprint.
-    google::protobuf::io::StringOutputStream stream(&serialized_request);
-    google::protobuf::io::CodedOutputStream output(&stream);
-    output.SetSerializationDeterministic(true);
-    request.SerializeToCodedStream(&output);
+// RequestHasher hashes the fields of a DML request one at a time, so that
+// detecting replays of a request neither copies nor serializes it as a whole.
+class RequestHasher {
+ public:
+  void AddBytes(absl::string_view bytes) {
+    Add(farmhash::Fingerprint64(bytes.data(), bytes.size()));
   }
-  return farmhash::Fingerprint64(serialized_request);
-}
 
+  void AddInt(int64_t value) { Add(static_cast<uint64_t>(value)); }
+
+  void AddMessage(const google::protobuf::Message& message) {
+    Add(Fingerprint(message));
+  }
+
+  // Adds the sql, parameters and parameter types of a statement.
+  template <typename Statement>
+  void AddStatement(const Statement& statement) {
+    AddBytes(statement.sql());
+    AddMessage(statement.params());
+    // Parameter types are combined regardless of the map iteration order,
+    // which is unspecified.
+    uint64_t param_types_hash = 0;
+    for (const auto& [name, type] : statement.param_types()) {
+      param_types_hash += farmhash::Fingerprint(
+          farmhash::Uint128(farmhash::Fingerprint64(name), Fingerprint(type)));
+    }
+    Add(param_types_hash);
+  }
+
+  int64_t hash() const { return hash_; }
+
+ private:
+  void Add(uint64_t value) {
+    hash_ = farmhash::Fingerprint(farmhash::Uint128(hash_, value));
+  }
+
+  uint64_t Fingerprint(const google::protobuf::Message& message) {
+    buffer_.clear();
+    {
+      // Serialize the message deterministically.
+      // Message::SerializeToString() is not guaranteed to deterministically
+      // generate the same string for a message that contains map fields.
+      // We create the output stream in an inner scope so that it gets flushed
+      // in the destructor before computing the fingerprint.
+      google::protobuf::io::StringOutputStream stream(&buffer_);
+      google::protobuf::io::CodedOutputStream output(&stream);
+      output.SetSerializationDeterministic(true);
+      message.SerializeToCodedStream(&output);
+    }
+    return farmhash::Fingerprint64(buffer_);
+  }
+
+  uint64_t hash_ = 0;
+
+  // Reused to serialize messages.
+  std::string buffer_;
+};
+
+// The hash of a DML request is based entirely on its sql statements, and not
+// on the sequence number or the resume token; the session and transaction are
+// those the sequence number is scoped to.
 int64_t HashRequest(const spanner_api::ExecuteSqlRequest* request) {
-  spanner_api::ExecuteSqlRequest copy = *request;
-  // Clearing resume token and sequence number so that the hash is based
-  // entirely on the sql statement.
-  copy.clear_resume_token();
-  copy.set_seqno(0);
-  return SerializeAndHashRequest(copy);
+  RequestHasher hasher;
+  hasher.AddStatement(*request);
+  hasher.AddInt(request->query_mode());
+  return hasher.hash();
 }
 
 int64_t HashRequest(const spanner_api::ExecuteBatchDmlRequest* request) {
-  spanner_api::ExecuteBatchDmlRequest copy = *request;
-  // Clearing sequence number so that the hash is based entirely on the sql
-  // statement.
-  copy.set_seqno(0);
-  return SerializeAndHashRequest(copy);
+  RequestHasher hasher;
+  hasher.AddInt(request->statements_size());
+  for (const auto& statement : request->statements()) {
+    hasher.AddStatement(statement);
+  }
+  return hasher.hash();
 }
 
 }  //  namespace
@@ -194,6 +308,8 @@ int64_t HashRequest(const spanner_api::ExecuteBatchDmlRequest* request) {
 absl::Status ExecuteSql(RequestContext* ctx,
                         const spanner_api::ExecuteSqlRequest* request,
                         spanner_api::ResultSet* response) {
+  slow_log::RecordSql(request->sql());
+
   // Take shared ownerships of session and transaction so that they will keep
   // valid throughout this function.
   ZETASQL_ASSIGN_OR_RETURN(std::shared_ptr<Session> session,
@@ -253,11 +369,18 @@ absl::Status ExecuteSql(RequestContext* ctx,
         }
 
         // Convert and execute provided SQL statement.
-        ZETASQL_ASSIGN_OR_RETURN(const backend::Query query,
+        ZETASQL_ASSIGN_OR_RETURN(backend::Query query,
                          QueryFromProto(request->sql(), request->params(),
                                         request->param_types(),
                                         txn->query_engine()->type_factory()));
-        auto maybe_result = txn->ExecuteSql(query);
+        query.collect_profile =
+            request->query_mode() == spanner_api::ExecuteSqlRequest::PROFILE;
+        ZETASQL_ASSIGN_OR_RETURN(const QueryPartition partition,
+                         QueryPartitionFromRequest(request, *txn->schema()));
+        absl::Time start_time = absl::Now();
+        auto maybe_result =
+            txn->ExecuteSql(query, partition.table, partition.range,
+                            ctx->cancellation());
         if (!maybe_result.ok()) {
           absl::Status error = maybe_result.status();
           if (txn->IsPartitionedDml()) {
@@ -289,23 +412,20 @@ absl::Status ExecuteSql(RequestContext* ctx,
           ZETASQL_RETURN_IF_ERROR(RowCursorToResultSetProto(result.rows.get(),
                                                     /*limit=*/0, response));
         }
+        int64_t rows_returned = response->rows_size();
+        absl::Duration elapsed_time = absl::Now() - start_time;
 
-        if (!request->partition_token().empty()) {
-          ZETASQL_ASSIGN_OR_RETURN(
-              auto partition_token,
-              PartitionTokenFromString(request->partition_token()));
-          ZETASQL_RETURN_IF_ERROR(ValidatePartitionToken(partition_token, request));
-          if (partition_token.empty_query_partition()) {
-            response->clear_rows();
-          }
+        if (partition.empty) {
+          response->clear_rows();
         }
 
-        // Add basic stats for PROFILE mode. We do this to interoperate with
-        // REPL applications written for Cloud Spanner. The profile will not
-        // contain statistics for plan nodes.
+        // Add stats and the plan of the query for PROFILE mode. The plan
+        // describes the operators of the ZetaSQL reference implementation,
+        // which are unrelated to the ones chosen by Cloud Spanner, and only
+        // table scans report the rows they read.
         if (request->query_mode() == spanner_api::ExecuteSqlRequest::PROFILE) {
-          AddQueryStatsFromQueryResult(
-              result, response->mutable_stats()->mutable_query_stats());
+          AddQueryStats(rows_returned, elapsed_time, result.profile.get(),
+                        response->mutable_stats());
         }
 
         // Reject requests for PLAN mode. The emulator uses ZetaSQL reference
@@ -326,23 +446,33 @@ REGISTER_GRPC_HANDLER(Spanner, ExecuteSql);
 
 // Executes a SQL statement, returning all results as a stream.
 //
-// resume_tokens is not supported in the emulator. This implementation does not
-// limit the size of the response and therefore, chunked_value will always be
-// false.
+// Rows are converted, chunked and sent incrementally as the query result cursor
+// is consumed. If the query orders its rows, responses which end on a row
+// boundary carry a resume token, and a request with a resume token executes
+// the query again and skips the rows returned before it.
 absl::Status ExecuteStreamingSql(
     RequestContext* ctx, const spanner_api::ExecuteSqlRequest* request,
     ServerStream<spanner_api::PartialResultSet>* stream) {
+  slow_log::RecordSql(request->sql());
+
   // Take shared ownerships of session and transaction so that they will keep
   // valid throughout this function.
   ZETASQL_ASSIGN_OR_RETURN(std::shared_ptr<Session> session,
                    GetSession(ctx, request->session()));
 
-  // Get underlying transaction.
+  // Get underlying transaction, reading at the timestamp of the resume token
+  // if a single-use transaction is resumed.
   bool is_dml_query = backend::IsDMLQuery(request->sql());
   ZETASQL_RETURN_IF_ERROR(ValidateTransactionSelectorForQuery(request->transaction(),
                                                       is_dml_query));
+  ResumeOptions resume;
+  ZETASQL_ASSIGN_OR_RETURN(resume.resume_from,
+                   ResumeTokenFromString(request->resume_token()));
+  ZETASQL_ASSIGN_OR_RETURN(
+      const spanner_api::TransactionSelector selector,
+      ResumedTransactionSelector(request->transaction(), resume.resume_from));
   ZETASQL_ASSIGN_OR_RETURN(std::shared_ptr<Transaction> txn,
-                   session->FindOrInitTransaction(request->transaction()));
+                   session->FindOrInitTransaction(selector));
 
   // Wrap all operations on this transaction so they are atomic.
   return txn->GuardedCall(
@@ -393,14 +523,22 @@ absl::Status ExecuteStreamingSql(
           ZETASQL_ASSIGN_OR_RETURN(absl::Time read_timestamp, txn->GetReadTimestamp());
           ZETASQL_RETURN_IF_ERROR(ValidateReadTimestampNotTooFarInFuture(
               read_timestamp, ctx->env()->clock()->Now()));
+          resume.read_timestamp = read_timestamp;
         }
 
         // Convert and execute provided SQL statement.
-        ZETASQL_ASSIGN_OR_RETURN(const backend::Query query,
+        ZETASQL_ASSIGN_OR_RETURN(backend::Query query,
                          QueryFromProto(request->sql(), request->params(),
                                         request->param_types(),
                                         txn->query_engine()->type_factory()));
-        auto maybe_result = txn->ExecuteSql(query);
+        query.collect_profile =
+            request->query_mode() == spanner_api::ExecuteSqlRequest::PROFILE;
+        ZETASQL_ASSIGN_OR_RETURN(const QueryPartition partition,
+                         QueryPartitionFromRequest(request, *txn->schema()));
+        absl::Time start_time = absl::Now();
+        auto maybe_result =
+            txn->ExecuteSql(query, partition.table, partition.range,
+                            ctx->cancellation());
         if (!maybe_result.ok()) {
           absl::Status error = maybe_result.status();
           if (txn->IsPartitionedDml()) {
@@ -412,70 +550,92 @@ absl::Status ExecuteStreamingSql(
         }
         backend::QueryResult& result = maybe_result.value();
 
-        std::vector<spanner_api::PartialResultSet> responses;
+        // Reject requests for PLAN mode. The emulator uses ZetaSQL reference
+        // implementation which performs an unoptimized execution of the SQL
+        // query. The plan chosen by ZetaSQL will have no relation to those
+        // generated by Cloud Spanner, so we reject the PLAN mode completely.
+        if (request->query_mode() == spanner_api::ExecuteSqlRequest::PLAN) {
+          return error::EmulatorDoesNotSupportQueryPlans();
+        }
+
+        // Populates transaction metadata on the first response and the stats
+        // and plan of the query for PROFILE mode on the last one.
+        bool first_response = true;
+        int64_t rows_returned = 0;
+        auto prepare_response = [&](spanner_api::PartialResultSet* response,
+                                    bool last) -> absl::Status {
+          if (first_response &&
+              ShouldReturnTransaction(request->transaction())) {
+            ZETASQL_ASSIGN_OR_RETURN(
+                *response->mutable_metadata()->mutable_transaction(),
+                txn->ToProto());
+          }
+          first_response = false;
+          if (last && request->query_mode() ==
+                          spanner_api::ExecuteSqlRequest::PROFILE) {
+            AddQueryStats(rows_returned, absl::Now() - start_time,
+                          result.profile.get(), response->mutable_stats());
+          }
+          return absl::OkStatus();
+        };
+
         if (IsDmlResult(result)) {
-          responses.emplace_back();
+          spanner_api::PartialResultSet response;
           if (txn->IsPartitionedDml()) {
-            responses.back().mutable_stats()->set_row_count_lower_bound(
+            response.mutable_stats()->set_row_count_lower_bound(
                 result.modified_row_count);
           } else {
-            responses.back().mutable_stats()->set_row_count_exact(
+            response.mutable_stats()->set_row_count_exact(
                 result.modified_row_count);
           }
           // Set empty row type.
-          responses.back().mutable_metadata()->mutable_row_type();
-        } else {
-          ZETASQL_ASSIGN_OR_RETURN(responses, RowCursorToPartialResultSetProtos(
-                                          result.rows.get(), /*limit=*/0));
-        }
+          response.mutable_metadata()->mutable_row_type();
+          ZETASQL_RETURN_IF_ERROR(prepare_response(&response, /*last=*/true));
 
-        if (!request->partition_token().empty()) {
-          ZETASQL_ASSIGN_OR_RETURN(
-              auto partition_token,
-              PartitionTokenFromString(request->partition_token()));
-          ZETASQL_RETURN_IF_ERROR(ValidatePartitionToken(partition_token, request));
-          if (partition_token.empty_query_partition()) {
-            // Clear all partial responses except the first one. Return only
-            // metadata in the first partial response.
-            responses.resize(1);
-            responses.front().clear_values();
-            responses.front().clear_chunked_value();
-          }
-        }
-
-        // Populate transaction metadata.
-        if (ShouldReturnTransaction(request->transaction())) {
-          ZETASQL_ASSIGN_OR_RETURN(
-              *responses.front().mutable_metadata()->mutable_transaction(),
-              txn->ToProto());
-        }
+          // Send results back to client.
+          stream->Send(response);
 
-        // Add basic stats for PROFILE mode. We do this to interoperate with
-        // REPL applications written for Cloud Spanner. The profile will not
-        // contain statistics for plan nodes.
-        if (request->query_mode() == spanner_api::ExecuteSqlRequest::PROFILE) {
-          AddQueryStatsFromQueryResult(
-              result, responses.front().mutable_stats()->mutable_query_stats());
+          spanner_api::ResultSet replay_result;
+          *replay_result.mutable_stats() = response.stats();
+          *replay_result.mutable_metadata() = response.metadata();
+          txn->SetDmlReplayOutcome(replay_result);
+          return absl::OkStatus();
         }
 
-        // Reject requests for PLAN mode. The emulator uses ZetaSQL reference
-        // implementation which performs an unoptimized execution of the SQL
-        // query. The plan chosen by ZetaSQL will have no relation to those
-        // generated by Cloud Spanner, so we reject the PLAN mode completely.
-        if (request->query_mode() == spanner_api::ExecuteSqlRequest::PLAN) {
-          return error::EmulatorDoesNotSupportQueryPlans();
+        if (partition.empty) {
+          // Return only metadata for a partition which contains no rows.
+          spanner_api::PartialResultSet response;
+          ZETASQL_RETURN_IF_ERROR(ResultSetMetadataToProto(
+              result.rows.get(), response.mutable_metadata()));
+          ZETASQL_RETURN_IF_ERROR(prepare_response(&response, /*last=*/true));
+          stream->Send(response);
+          return absl::OkStatus();
         }
 
-        // Send results back to client.
-        for (const auto& response : responses) {
-          stream->Send(response);
+        // Only queries which order their rows return them in the same order
+        // when executed again, and can be resumed.
+        if (!result.ordered && !request->resume_token().empty()) {
+          return error::InvalidResumeToken();
         }
 
-        if (is_dml_query) {
-          spanner_api::ResultSet replay_result;
-          *replay_result.mutable_stats() = responses[0].stats();
-          *replay_result.mutable_metadata() = responses[0].metadata();
-          txn->SetDmlReplayOutcome(replay_result);
+        // Convert rows to protos and send them back to the client as they are
+        // produced, so that the result is never materialized in full. The next
+        // rows are evaluated while the previous response is written.
+        PipelinedServerStream<spanner_api::PartialResultSet> pipelined_stream(
+            stream);
+        ZETASQL_RETURN_IF_ERROR(StreamRowCursor(
+            result.rows.get(), /*limit=*/0,
+            [&](spanner_api::PartialResultSet* response,
+                bool last) -> absl::Status {
+              ZETASQL_RETURN_IF_ERROR(prepare_response(response, last));
+              if (!pipelined_stream.Send(std::move(*response), last)) {
+                return error::StreamingResponseNotDelivered();
+              }
+              return absl::OkStatus();
+            },
+            &rows_returned, result.ordered ? &resume : nullptr));
+        if (!pipelined_stream.Finish()) {
+          return error::StreamingResponseNotDelivered();
         }
         return absl::OkStatus();
       });
@@ -490,6 +650,9 @@ absl::Status ExecuteBatchDml(RequestContext* ctx,
   if (request->statements().empty()) {
     return error::InvalidBatchDmlRequest();
   }
+  for (const auto& statement : request->statements()) {
+    slow_log::RecordSql(statement.sql());
+  }
 
   // Take shared ownerships of session and transaction so that they will keep
   // valid throughout this function.
@@ -555,7 +718,8 @@ absl::Status ExecuteBatchDml(RequestContext* ctx,
         return absl::OkStatus();
       }
 
-      const auto maybe_result = ExecuteQuery(statement, txn);
+      const auto maybe_result =
+          ExecuteQuery(statement, txn, ctx->cancellation());
       if (!maybe_result.ok() &&
           maybe_result.status().code() != absl::StatusCode::kAborted) {
         absl::Status error = maybe_result.status();
@@ -41,6 +41,7 @@ namespace {
 
 namespace spanner_api = ::google::spanner::v1;
 
+using testing::Contains;
 using testing::ElementsAre;
 using test::EqualsProto;
 using test::proto::Partially;
@@ -304,6 +305,74 @@ TEST_F(QueryApiTest, ExecuteStreamingSqlWithParameters) {
                             )")));
 }
 
+TEST_F(QueryApiTest, ProfileModeReturnsQueryPlanAndStats) {
+  spanner_api::ExecuteSqlRequest request = PARSE_TEXT_PROTO(
+      R"(
+        transaction { single_use { read_only { strong: true } } }
+        query_mode: PROFILE
+        sql: "SELECT int64_col FROM test_table WHERE int64_col > 1"
+      )");
+  request.set_session(test_session_uri_);
+
+  spanner_api::ResultSet response;
+  ZETASQL_ASSERT_OK(ExecuteSql(request, &response));
+  EXPECT_EQ(response.rows_size(), 2);
+  const auto& query_stats = response.stats().query_stats().fields();
+  EXPECT_EQ(query_stats.at("rows_returned").string_value(), "2");
+  EXPECT_EQ(query_stats.at("rows_scanned").string_value(), "3");
+  EXPECT_EQ(query_stats.count("cpu_time"), 1);
+
+  const spanner_api::QueryPlan& plan = response.stats().query_plan();
+  ASSERT_GT(plan.plan_nodes_size(), 0);
+  EXPECT_THAT(plan.plan_nodes(0), Partially(EqualsProto(R"(
+                index: 0
+                kind: RELATIONAL
+                display_name: "QueryStmt"
+                child_links { child_index: 1 }
+              )")));
+  EXPECT_THAT(
+      plan.plan_nodes(0).execution_stats().fields().at("rows"),
+      EqualsProto(R"(
+        struct_value {
+          fields {
+            key: "total"
+            value { string_value: "2" }
+          }
+          fields {
+            key: "unit"
+            value { string_value: "rows" }
+          }
+        }
+      )"));
+  EXPECT_THAT(plan.plan_nodes(),
+              Contains(Partially(EqualsProto(R"(
+                display_name: "TableScan"
+                metadata {
+                  fields {
+                    key: "scan_target"
+                    value { string_value: "test_table" }
+                  }
+                }
+                execution_stats {
+                  fields {
+                    key: "rows"
+                    value {
+                      struct_value {
+                        fields {
+                          key: "total"
+                          value { string_value: "3" }
+                        }
+                        fields {
+                          key: "unit"
+                          value { string_value: "rows" }
+                        }
+                      }
+                    }
+                  }
+                }
+              )"))));
+}
+
 TEST_F(QueryApiTest, RejectsPlanMode) {
   spanner_api::ExecuteSqlRequest request = PARSE_TEXT_PROTO(
       R"(
@@ -17,13 +17,19 @@
 #include "frontend/converters/reads.h"
 
 #include <memory>
+#include <utility>
 
 #include "google/spanner/v1/result_set.pb.h"
 #include "google/spanner/v1/spanner.pb.h"
 #include "google/spanner/v1/transaction.pb.h"
+#include "absl/memory/memory.h"
+#include "backend/access/read.h"
 #include "backend/common/ids.h"
+#include "backend/transaction/read_only_transaction.h"
+#include "backend/transaction/row_cursor.h"
 #include "common/errors.h"
 #include "frontend/common/protos.h"
+#include "frontend/converters/time.h"
 #include "frontend/entities/session.h"
 #include "frontend/entities/transaction.h"
 #include "frontend/server/handler.h"
@@ -59,6 +65,45 @@ absl::Status ValidateTransactionSelectorForRead(
   return absl::OkStatus();
 }
 
+// Reads rows like Read, in the single-use read-only transaction of `request`.
+// The rows are all converted before the call returns, so the transaction is
+// run on the stack without creating a Transaction for it.
+absl::Status ReadSingleUse(RequestContext* ctx, Session* session,
+                           const spanner_api::ReadRequest* request,
+                           spanner_api::ResultSet* response) {
+  return session->RunSingleUseReadOnly(
+      request->transaction().single_use(),
+      [&](backend::ReadOnlyTransaction* txn) -> absl::Status {
+        ZETASQL_RETURN_IF_ERROR(ValidateReadTimestampNotTooFarInFuture(
+            txn->read_timestamp(), ctx->env()->clock()->Now()));
+
+        // Parse read request.
+        backend::ReadArg read_arg;
+        ZETASQL_RETURN_IF_ERROR(
+            ReadArgFromProto(*txn->schema(), *request, &read_arg));
+
+        // Execute read on backend.
+        std::unique_ptr<backend::RowCursor> cursor;
+        ZETASQL_RETURN_IF_ERROR(txn->Read(read_arg, &cursor));
+        cursor = absl::make_unique<backend::CancellableRowCursor>(
+            std::move(cursor), ctx->cancellation());
+
+        // Populate transaction metadata. Single-use transactions have no ID.
+        const spanner_api::TransactionOptions::ReadOnly& options =
+            request->transaction().single_use().read_only();
+        if (options.return_read_timestamp()) {
+          ZETASQL_ASSIGN_OR_RETURN(*response->mutable_metadata()
+                               ->mutable_transaction()
+                               ->mutable_read_timestamp(),
+                           TimestampToProto(txn->read_timestamp()));
+        }
+
+        // Convert read results to proto.
+        return RowCursorToResultSetProto(cursor.get(), request->limit(),
+                                         response);
+      });
+}
+
 }  //  namespace
 
 // Reads rows from the database, returning all results in a single reply.
@@ -68,8 +113,12 @@ absl::Status Read(RequestContext* ctx, const spanner_api::ReadRequest* request,
   ZETASQL_ASSIGN_OR_RETURN(std::shared_ptr<Session> session,
                    GetSession(ctx, request->session()));
 
-  // Get underlying transaction.
+  // Get underlying transaction. Single-use transactions, which most reads
+  // use, take a lighter path since they end with the read.
   ZETASQL_RETURN_IF_ERROR(ValidateTransactionSelectorForRead(request->transaction()));
+  if (request->transaction().has_single_use()) {
+    return ReadSingleUse(ctx, session.get(), request, response);
+  }
   ZETASQL_ASSIGN_OR_RETURN(std::shared_ptr<Transaction> txn,
                    session->FindOrInitTransaction(request->transaction()));
 
@@ -94,7 +143,7 @@ absl::Status Read(RequestContext* ctx, const spanner_api::ReadRequest* request,
 
     // Execute read on backend.
     std::unique_ptr<backend::RowCursor> cursor;
-    ZETASQL_RETURN_IF_ERROR(txn->Read(read_arg, &cursor));
+    ZETASQL_RETURN_IF_ERROR(txn->Read(read_arg, &cursor, ctx->cancellation()));
 
     // Populate transaction metadata.
     if (ShouldReturnTransaction(request->transaction())) {
@@ -110,9 +159,10 @@ REGISTER_GRPC_HANDLER(Spanner, Read);
 
 // Reads rows from the database, returning all results as a stream.
 //
-// StreamingReads do not support resume_tokens in the emulator. This
-// implementation does not limit the size of the response and therefore,
-// chunked_value will always be false.
+// Rows are converted, chunked and sent incrementally as the read cursor is
+// consumed. Rows are read in key order, so responses which end on a row
+// boundary carry a resume token, and a request with a resume token skips the
+// rows returned before it.
 absl::Status StreamingRead(
     RequestContext* ctx, const spanner_api::ReadRequest* request,
     ServerStream<spanner_api::PartialResultSet>* stream) {
@@ -120,10 +170,17 @@ absl::Status StreamingRead(
   ZETASQL_ASSIGN_OR_RETURN(std::shared_ptr<Session> session,
                    GetSession(ctx, request->session()));
 
-  // Get underlying transaction.
+  // Get underlying transaction, reading at the timestamp of the resume token
+  // if a single-use transaction is resumed.
   ZETASQL_RETURN_IF_ERROR(ValidateTransactionSelectorForRead(request->transaction()));
+  ResumeOptions resume;
+  ZETASQL_ASSIGN_OR_RETURN(resume.resume_from,
+                   ResumeTokenFromString(request->resume_token()));
+  ZETASQL_ASSIGN_OR_RETURN(
+      const spanner_api::TransactionSelector selector,
+      ResumedTransactionSelector(request->transaction(), resume.resume_from));
   ZETASQL_ASSIGN_OR_RETURN(std::shared_ptr<Transaction> txn,
-                   session->FindOrInitTransaction(request->transaction()));
+                   session->FindOrInitTransaction(selector));
 
   // Wrap all operations on this transaction so they are atomic.
   return txn->GuardedCall(Transaction::OpType::kRead, [&]() -> absl::Status {
@@ -138,6 +195,7 @@ absl::Status StreamingRead(
       ZETASQL_ASSIGN_OR_RETURN(absl::Time read_timestamp, txn->GetReadTimestamp());
       ZETASQL_RETURN_IF_ERROR(ValidateReadTimestampNotTooFarInFuture(
           read_timestamp, ctx->env()->clock()->Now()));
+      resume.read_timestamp = read_timestamp;
     }
 
     // Parse read request.
@@ -146,23 +204,34 @@ absl::Status StreamingRead(
 
     // Execute read on backend.
     std::unique_ptr<backend::RowCursor> cursor;
-    ZETASQL_RETURN_IF_ERROR(txn->Read(read_arg, &cursor));
-
-    // Convert read results to protos.
-    ZETASQL_ASSIGN_OR_RETURN(
-        std::vector<spanner_api::PartialResultSet> responses,
-        RowCursorToPartialResultSetProtos(cursor.get(), request->limit()));
-
-    // Populate transaction metadata.
-    if (ShouldReturnTransaction(request->transaction())) {
-      ZETASQL_ASSIGN_OR_RETURN(
-          *responses.front().mutable_metadata()->mutable_transaction(),
-          txn->ToProto());
-    }
-
-    // Send results back to client.
-    for (const auto& response : responses) {
-      stream->Send(response);
+    ZETASQL_RETURN_IF_ERROR(txn->Read(read_arg, &cursor, ctx->cancellation()));
+
+    // Convert read results to protos and send them back to the client as they
+    // are produced, reading the next rows while the previous response is
+    // written.
+    bool first_response = true;
+    PipelinedServerStream<spanner_api::PartialResultSet> pipelined_stream(
+        stream);
+    ZETASQL_RETURN_IF_ERROR(StreamRowCursor(
+        cursor.get(), request->limit(),
+        [&](spanner_api::PartialResultSet* response,
+            bool last) -> absl::Status {
+          // Populate transaction metadata.
+          if (first_response &&
+              ShouldReturnTransaction(request->transaction())) {
+            ZETASQL_ASSIGN_OR_RETURN(
+                *response->mutable_metadata()->mutable_transaction(),
+                txn->ToProto());
+          }
+          first_response = false;
+          if (!pipelined_stream.Send(std::move(*response), last)) {
+            return error::StreamingResponseNotDelivered();
+          }
+          return absl::OkStatus();
+        },
+        /*row_count=*/nullptr, &resume));
+    if (!pipelined_stream.Finish()) {
+      return error::StreamingResponseNotDelivered();
     }
     return absl::OkStatus();
   });
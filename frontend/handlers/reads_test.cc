@@ -225,6 +225,26 @@ TEST_F(ReadApiTest, CanPerformStrongReadUsingSingleUseTransaction) {
                                     })"));
 }
 
+TEST_F(ReadApiTest, SingleUseReadReturnsReadTimestamp) {
+  spanner_api::ReadRequest read_request = PARSE_TEXT_PROTO(R"(
+    transaction {
+      single_use { read_only { strong: true return_read_timestamp: true } }
+    }
+    table: "test_table"
+    columns: "int64_col"
+    key_set { keys { values { string_value: "1" } } }
+  )");
+  read_request.set_session(test_session_uri_);
+
+  spanner_api::ResultSet read_response;
+  ZETASQL_EXPECT_OK(Read(read_request, &read_response));
+  EXPECT_TRUE(read_response.metadata().transaction().id().empty());
+  EXPECT_TRUE(read_response.metadata().transaction().has_read_timestamp());
+  ASSERT_EQ(read_response.rows_size(), 1);
+  EXPECT_THAT(read_response.rows(0),
+              test::EqualsProto(R"(values { string_value: "1" })"));
+}
+
 TEST_F(ReadApiTest, CanPerformDefaultStrongReadUsingTemporaryTransaction) {
   // Perform a strong read using a read only single use transaction when
   // transaction selector is not set.
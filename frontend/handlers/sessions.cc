@@ -15,6 +15,7 @@
 //
 
 #include <memory>
+#include <vector>
 
 #include "google/protobuf/empty.pb.h"
 #include "google/spanner/v1/spanner.pb.h"
@@ -96,17 +97,23 @@ absl::Status BatchCreateSessions(
       std::min(limits::kMaxBatchCreateSessionsCount, request->session_count());
 
   // Create the requested sessions.
-  std::vector<std::shared_ptr<Session>> sessions(actual_session_count);
   Labels labels(request->session_template().labels().begin(),
                 request->session_template().labels().end());
-  for (int i = 0; i < sessions.size(); ++i) {
-    ZETASQL_ASSIGN_OR_RETURN(sessions[i], ctx->env()->session_manager()->CreateSession(
-                                      labels, database));
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<std::shared_ptr<Session>> sessions,
+                   ctx->env()->session_manager()->CreateSessions(
+                       labels, database, actual_session_count));
+  if (sessions.empty()) {
+    return absl::OkStatus();
   }
 
-  // Return details about the newly created session.
-  for (const auto& session : sessions) {
-    ZETASQL_RETURN_IF_ERROR(session->ToProto(response->add_session()));
+  // Return details about the newly created sessions. They only differ by name,
+  // so the first one is converted and copied for the others.
+  response->mutable_session()->Reserve(sessions.size());
+  ZETASQL_RETURN_IF_ERROR(sessions.front()->ToProto(response->add_session()));
+  for (int i = 1; i < sessions.size(); ++i) {
+    spanner_api::Session* session = response->add_session();
+    *session = response->session(0);
+    session->set_name(sessions[i]->session_uri());
   }
   return absl::OkStatus();
 }
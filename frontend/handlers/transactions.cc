@@ -110,11 +110,13 @@ absl::Status Commit(RequestContext* ctx,
       return absl::OkStatus();
     }
 
-    // Process mutations and write to transaction store.
+    // Process mutations and write to transaction store. Nothing can observe
+    // the transaction between the mutations of the request, so their writes
+    // to the same row are coalesced.
     backend::Mutation mutation;
     ZETASQL_RETURN_IF_ERROR(
         MutationFromProto(*txn->schema(), request->mutations(), &mutation));
-    ZETASQL_RETURN_IF_ERROR(txn->Write(mutation));
+    ZETASQL_RETURN_IF_ERROR(txn->WriteCoalesced(mutation));
 
     // Actually commit the request.
     ZETASQL_RETURN_IF_ERROR(txn->Commit());
@@ -0,0 +1,225 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "frontend/server/admission_controller.h"
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "common/metrics.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+namespace {
+
+using RequestClass = AdmissionController::RequestClass;
+
+// Classes of the methods of the Spanner service. Its other methods, such as
+// those managing sessions, are short and classified as point reads.
+const absl::flat_hash_map<std::string, RequestClass>& SpannerMethodClasses() {
+  static const auto* const classes =
+      new absl::flat_hash_map<std::string, RequestClass>({
+          {"Read", RequestClass::kPointRead},
+          {"StreamingRead", RequestClass::kPointRead},
+          {"ExecuteSql", RequestClass::kScan},
+          {"ExecuteStreamingSql", RequestClass::kScan},
+          {"PartitionQuery", RequestClass::kScan},
+          {"PartitionRead", RequestClass::kScan},
+          {"ExecuteBatchDml", RequestClass::kDml},
+          {"BeginTransaction", RequestClass::kCommit},
+          {"Commit", RequestClass::kCommit},
+          {"Rollback", RequestClass::kCommit},
+      });
+  return *classes;
+}
+
+}  // namespace
+
+AdmissionController::Options AdmissionController::DefaultOptions(
+    int max_concurrent) {
+  max_concurrent = std::max(max_concurrent, 1);
+  Options options;
+  options.max_concurrent = max_concurrent;
+  auto set = [&options](RequestClass request_class, int max_concurrent,
+                        int weight) {
+    ClassOptions& class_options =
+        options.classes[static_cast<int>(request_class)];
+    class_options.max_concurrent = std::max(max_concurrent, 1);
+    class_options.weight = weight;
+  };
+  set(RequestClass::kPointRead, max_concurrent, 8);
+  set(RequestClass::kScan, max_concurrent / 2, 2);
+  set(RequestClass::kDml, max_concurrent / 2, 4);
+  set(RequestClass::kCommit, max_concurrent, 8);
+  set(RequestClass::kAdmin, max_concurrent / 4, 1);
+  return options;
+}
+
+AdmissionController::AdmissionController(const Options& options,
+                                         Executor executor)
+    : max_concurrent_(std::max(options.max_concurrent, 1)),
+      executor_(std::move(executor)) {
+  for (int i = 0; i < kNumRequestClasses; ++i) {
+    ClassState& state = classes_[i];
+    state.options = options.classes[i];
+    state.options.max_concurrent = std::max(state.options.max_concurrent, 1);
+    state.options.weight = std::max(state.options.weight, 1);
+    state.queue_latency = metrics::GetLatencyHistogram(
+        "spanner_emulator_admission_queue_seconds",
+        "Time calls waited to be admitted by the admission controller, by "
+        "request class.",
+        {{"class", ClassName(static_cast<RequestClass>(i))}});
+  }
+  queued_calls_gauge_ = metrics::RegisterGauge(
+      "spanner_emulator_admission_queued_calls",
+      "Number of calls waiting to be admitted by the admission controller, by "
+      "request class.",
+      [this] { return CollectQueuedCalls(); });
+}
+
+RequestClass AdmissionController::Classify(const std::string& service_name,
+                                           const std::string& method_name) {
+  if (service_name != "Spanner") {
+    return RequestClass::kAdmin;
+  }
+  const auto& classes = SpannerMethodClasses();
+  auto itr = classes.find(method_name);
+  return itr == classes.end() ? RequestClass::kPointRead : itr->second;
+}
+
+const char* AdmissionController::ClassName(RequestClass request_class) {
+  switch (request_class) {
+    case RequestClass::kPointRead:
+      return "point_read";
+    case RequestClass::kScan:
+      return "scan";
+    case RequestClass::kDml:
+      return "dml";
+    case RequestClass::kCommit:
+      return "commit";
+    case RequestClass::kAdmin:
+      return "admin";
+  }
+  return "unknown";
+}
+
+void AdmissionController::Submit(RequestClass request_class,
+                                 std::function<void()> fn) {
+  std::vector<std::function<void()>> admitted;
+  {
+    absl::MutexLock lock(&mu_);
+    ClassState& state = classes_[static_cast<int>(request_class)];
+    // A class which had no calls waiting starts its turns at the current
+    // virtual time, so that it cannot claim turns it did not use.
+    const double start_tag = std::max(virtual_time_, state.last_finish_tag);
+    state.last_finish_tag = start_tag + 1.0 / state.options.weight;
+    state.queue.push_back({std::move(fn), start_tag, absl::Now()});
+    admitted = AdmitWaitingCalls();
+  }
+  for (std::function<void()>& call : admitted) {
+    executor_(std::move(call));
+  }
+}
+
+std::vector<std::function<void()>> AdmissionController::AdmitWaitingCalls() {
+  std::vector<std::function<void()>> admitted;
+  while (running_ < max_concurrent_) {
+    // Pick the waiting call with the earliest start tag among the classes
+    // below their limit.
+    int next = -1;
+    for (int i = 0; i < kNumRequestClasses; ++i) {
+      const ClassState& state = classes_[i];
+      if (state.queue.empty() ||
+          state.running >= state.options.max_concurrent) {
+        continue;
+      }
+      if (next < 0 ||
+          state.queue.front().start_tag <
+              classes_[next].queue.front().start_tag) {
+        next = i;
+      }
+    }
+    if (next < 0) {
+      break;
+    }
+
+    ClassState& state = classes_[next];
+    Entry entry = std::move(state.queue.front());
+    state.queue.pop_front();
+    ++state.running;
+    ++running_;
+    virtual_time_ = std::max(virtual_time_, entry.start_tag);
+    if (metrics::Enabled()) {
+      state.queue_latency->Record(absl::Now() - entry.submit_time);
+    }
+    admitted.push_back([this, next, fn = std::move(entry.fn)]() {
+      fn();
+      Release(next);
+    });
+  }
+  return admitted;
+}
+
+void AdmissionController::Release(int class_index) {
+  std::vector<std::function<void()>> admitted;
+  {
+    absl::MutexLock lock(&mu_);
+    --classes_[class_index].running;
+    --running_;
+    admitted = AdmitWaitingCalls();
+  }
+  for (std::function<void()>& call : admitted) {
+    executor_(std::move(call));
+  }
+}
+
+int64_t AdmissionController::num_queued(RequestClass request_class) const {
+  absl::MutexLock lock(&mu_);
+  return classes_[static_cast<int>(request_class)].queue.size();
+}
+
+int64_t AdmissionController::num_running(RequestClass request_class) const {
+  absl::MutexLock lock(&mu_);
+  return classes_[static_cast<int>(request_class)].running;
+}
+
+std::vector<metrics::GaugeSample> AdmissionController::CollectQueuedCalls()
+    const {
+  std::vector<metrics::GaugeSample> samples;
+  absl::MutexLock lock(&mu_);
+  for (int i = 0; i < kNumRequestClasses; ++i) {
+    samples.push_back(
+        {{{"class", ClassName(static_cast<RequestClass>(i))}},
+         static_cast<int64_t>(classes_[i].queue.size())});
+  }
+  return samples;
+}
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
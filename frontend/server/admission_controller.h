@@ -0,0 +1,188 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_ADMISSION_CONTROLLER_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_ADMISSION_CONTROLLER_H_
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "common/metrics.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+// AdmissionController decides when the handler of each call may start running.
+//
+// Calls are classified by method into request classes. At most
+// `max_concurrent` calls run at once, and at most the limit of its class of
+// each class, so that e.g. long queries cannot occupy every handler thread.
+// Calls which cannot run yet wait in a queue per class, from which they are
+// picked with start-time fair queuing: while several classes have calls
+// waiting, each class is picked in proportion to its weight, so that short
+// calls of heavily weighted classes (such as point reads and commits) are not
+// stuck behind a backlog of heavy ones.
+//
+// The time calls wait to be admitted is exported as the histogram
+// spanner_emulator_admission_queue_seconds, and the number of waiting calls
+// as the gauge spanner_emulator_admission_queued_calls, by request class.
+//
+// This class is thread safe.
+class AdmissionController {
+ public:
+  enum class RequestClass {
+    // Reads by key, and the other short calls on sessions.
+    kPointRead,
+    // Queries, which may scan whole tables, and partitioning.
+    kScan,
+    // Batches of DML statements.
+    kDml,
+    // Calls beginning, committing and rolling back transactions.
+    kCommit,
+    // Calls of the admin and long running operation services.
+    kAdmin,
+  };
+  static constexpr int kNumRequestClasses = 5;
+
+  struct ClassOptions {
+    // Maximum number of calls of the class running at once.
+    int max_concurrent = 1;
+
+    // Share of the admitted calls the class gets while calls of several
+    // classes are waiting.
+    int weight = 1;
+  };
+
+  struct Options {
+    // Maximum number of calls running at once.
+    int max_concurrent = 1;
+
+    // Options of each class, indexed by RequestClass.
+    std::array<ClassOptions, kNumRequestClasses> classes;
+  };
+
+  // Returns the default options for a server running `max_concurrent` calls
+  // at once: point reads and commits may use every slot, DML and queries half
+  // of them, and admin calls a quarter, with point reads and commits weighted
+  // most.
+  static Options DefaultOptions(int max_concurrent);
+
+  // Runs an admitted call. Typically schedules it on a thread pool with at
+  // least max_concurrent threads.
+  using Executor = std::function<void(std::function<void()>)>;
+
+  AdmissionController(const Options& options, Executor executor);
+
+  AdmissionController(const AdmissionController&) = delete;
+  AdmissionController& operator=(const AdmissionController&) = delete;
+
+  // Returns the class of calls of the method `method_name` of the service
+  // `service_name`, e.g. ("Spanner", "Commit").
+  static RequestClass Classify(const std::string& service_name,
+                               const std::string& method_name);
+
+  // Returns the name of `request_class`, as used in metric labels.
+  static const char* ClassName(RequestClass request_class);
+
+  // Passes `fn` to the executor once a call of `request_class` is admitted,
+  // possibly right away.
+  void Submit(RequestClass request_class, std::function<void()> fn)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the number of calls of `request_class` waiting to be admitted.
+  int64_t num_queued(RequestClass request_class) const
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the number of calls of `request_class` which are running.
+  int64_t num_running(RequestClass request_class) const
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  struct Entry {
+    std::function<void()> fn;
+
+    // Virtual time at which the call's turn starts.
+    double start_tag;
+
+    // The time the call was submitted.
+    absl::Time submit_time;
+  };
+
+  struct ClassState {
+    ClassOptions options;
+
+    // Calls waiting to be admitted, in submission order.
+    std::deque<Entry> queue;
+
+    // Number of calls running.
+    int running = 0;
+
+    // Virtual time at which the turn of the last queued call finishes.
+    double last_finish_tag = 0;
+
+    // Time the calls of the class waited to be admitted.
+    metrics::Histogram* queue_latency = nullptr;
+  };
+
+  // Admits as many waiting calls as the limits allow, and returns them
+  // wrapped with their accounting, to be passed to the executor once the
+  // mutex is released.
+  std::vector<std::function<void()>> AdmitWaitingCalls()
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Called once an admitted call returns.
+  void Release(int class_index) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the samples of the queued calls gauge.
+  std::vector<metrics::GaugeSample> CollectQueuedCalls() const
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  const int max_concurrent_;
+  const Executor executor_;
+
+  // Mutex to guard state below.
+  mutable absl::Mutex mu_;
+
+  // Number of calls running, of all classes.
+  int running_ ABSL_GUARDED_BY(mu_) = 0;
+
+  // Start tag of the call admitted last.
+  double virtual_time_ ABSL_GUARDED_BY(mu_) = 0;
+
+  std::array<ClassState, kNumRequestClasses> classes_ ABSL_GUARDED_BY(mu_);
+
+  // Declared last, so that it is unregistered before the state it reports is
+  // destroyed.
+  std::unique_ptr<metrics::GaugeRegistration> queued_calls_gauge_;
+};
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_ADMISSION_CONTROLLER_H_
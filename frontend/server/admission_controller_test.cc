@@ -0,0 +1,144 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "frontend/server/admission_controller.h"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/memory/memory.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+namespace {
+
+using RequestClass = AdmissionController::RequestClass;
+
+class AdmissionControllerTest : public testing::Test {
+ protected:
+  // Returns a controller whose admitted calls are only run by RunNext.
+  std::unique_ptr<AdmissionController> MakeController(
+      const AdmissionController::Options& options) {
+    return absl::make_unique<AdmissionController>(
+        options, [this](std::function<void()> fn) {
+          admitted_.push_back(std::move(fn));
+        });
+  }
+
+  // Runs the call admitted first.
+  void RunNext() {
+    std::function<void()> fn = std::move(admitted_.front());
+    admitted_.pop_front();
+    fn();
+  }
+
+  std::deque<std::function<void()>> admitted_;
+};
+
+TEST_F(AdmissionControllerTest, ClassifiesMethods) {
+  EXPECT_EQ(AdmissionController::Classify("Spanner", "StreamingRead"),
+            RequestClass::kPointRead);
+  EXPECT_EQ(AdmissionController::Classify("Spanner", "CreateSession"),
+            RequestClass::kPointRead);
+  EXPECT_EQ(AdmissionController::Classify("Spanner", "ExecuteStreamingSql"),
+            RequestClass::kScan);
+  EXPECT_EQ(AdmissionController::Classify("Spanner", "ExecuteBatchDml"),
+            RequestClass::kDml);
+  EXPECT_EQ(AdmissionController::Classify("Spanner", "Commit"),
+            RequestClass::kCommit);
+  EXPECT_EQ(AdmissionController::Classify("DatabaseAdmin", "UpdateDatabaseDdl"),
+            RequestClass::kAdmin);
+}
+
+TEST_F(AdmissionControllerTest, LimitsConcurrentCallsOfEachClass) {
+  AdmissionController::Options options =
+      AdmissionController::DefaultOptions(/*max_concurrent=*/4);
+  options.classes[static_cast<int>(RequestClass::kScan)].max_concurrent = 1;
+  std::unique_ptr<AdmissionController> controller = MakeController(options);
+
+  std::vector<int> ran;
+  for (int i = 0; i < 3; ++i) {
+    controller->Submit(RequestClass::kScan, [&ran, i]() { ran.push_back(i); });
+  }
+  EXPECT_EQ(admitted_.size(), 1);
+  EXPECT_EQ(controller->num_running(RequestClass::kScan), 1);
+  EXPECT_EQ(controller->num_queued(RequestClass::kScan), 2);
+
+  // Other classes still have room.
+  controller->Submit(RequestClass::kPointRead, []() {});
+  EXPECT_EQ(admitted_.size(), 2);
+
+  // Each scan is admitted once the previous one returns.
+  RunNext();
+  EXPECT_EQ(controller->num_queued(RequestClass::kScan), 1);
+  RunNext();
+  RunNext();
+  RunNext();
+  EXPECT_TRUE(admitted_.empty());
+  EXPECT_THAT(ran, testing::ElementsAre(0, 1, 2));
+  EXPECT_EQ(controller->num_running(RequestClass::kScan), 0);
+  EXPECT_EQ(controller->num_running(RequestClass::kPointRead), 0);
+}
+
+TEST_F(AdmissionControllerTest, SharesSlotsBetweenClassesByWeight) {
+  AdmissionController::Options options;
+  options.max_concurrent = 1;
+  for (AdmissionController::ClassOptions& class_options : options.classes) {
+    class_options.max_concurrent = 1;
+    class_options.weight = 1;
+  }
+  options.classes[static_cast<int>(RequestClass::kPointRead)].weight = 4;
+  std::unique_ptr<AdmissionController> controller = MakeController(options);
+
+  // A call occupies the only slot while a backlog of scans and then of point
+  // reads builds up.
+  std::vector<RequestClass> ran;
+  controller->Submit(RequestClass::kAdmin, []() {});
+  for (int i = 0; i < 10; ++i) {
+    controller->Submit(RequestClass::kScan,
+                       [&ran]() { ran.push_back(RequestClass::kScan); });
+  }
+  for (int i = 0; i < 10; ++i) {
+    controller->Submit(RequestClass::kPointRead,
+                       [&ran]() { ran.push_back(RequestClass::kPointRead); });
+  }
+  while (!admitted_.empty()) {
+    RunNext();
+  }
+
+  // Point reads get four turns for each turn of the scans submitted before
+  // them, instead of waiting for all the scans.
+  ASSERT_EQ(ran.size(), 20);
+  std::vector<RequestClass> first(ran.begin(), ran.begin() + 10);
+  EXPECT_EQ(std::count(first.begin(), first.end(), RequestClass::kScan), 2);
+}
+
+}  // namespace
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,338 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "frontend/server/async_dispatcher.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "zetasql/base/logging.h"
+#include "grpcpp/support/byte_buffer.h"
+#include "grpcpp/support/status.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "common/cpu_placement.h"
+#include "frontend/common/status.h"
+#include "frontend/server/admission_controller.h"
+#include "frontend/server/handler.h"
+#include "frontend/server/read_deferral.h"
+#include "frontend/server/request_context.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+namespace {
+
+// Number of calls each completion queue keeps posted to accept new requests.
+constexpr int kPendingCallsPerQueue = 16;
+
+// Resolution of the timers of deferred calls. Calls which can be served within
+// a tick are not deferred, since they would wait longer for their timer.
+constexpr absl::Duration kDeferralTick = absl::Milliseconds(10);
+
+// Completion queue tags are pointers to callbacks which are invoked with the
+// result of the operation once it completes.
+using Tag = std::function<void(bool ok)>;
+
+}  // namespace
+
+// Call holds the state of a single incoming gRPC call.
+//
+// A call proceeds through the following steps:
+//   - it is accepted on a completion queue,
+//   - its single request message is read on the completion queue,
+//   - if it reads at a future timestamp, it waits on a timer until then,
+//   - it waits to be admitted by the admission controller,
+//   - its handler runs on the handler pool, writing each response and waiting
+//     for the write to complete on the completion queue,
+//   - it is finished with the handler's status, after which it deletes itself.
+class AsyncDispatcher::Call {
+ public:
+  Call(AsyncDispatcher* dispatcher, grpc::ServerCompletionQueue* cq)
+      : dispatcher_(dispatcher), cq_(cq), stream_(&grpc_ctx_) {
+    on_accepted_ = [this](bool ok) { OnAccepted(ok); };
+    on_read_ = [this](bool ok) { OnRead(ok); };
+    on_written_ = [this](bool ok) { OnWritten(ok); };
+    on_finished_ = [this](bool ok) { delete this; };
+  }
+
+  // Asks the server to hand the next incoming call to this object.
+  void Request() {
+    dispatcher_->service_.RequestCall(&grpc_ctx_, &stream_, cq_, cq_,
+                                      &on_accepted_);
+  }
+
+  // Submits the call, whose request has been read, for admission to the
+  // handler pool.
+  void Admit() {
+    dispatcher_->admission_controller_.Submit(request_class_,
+                                              [this]() { RunHandler(); });
+  }
+
+ private:
+  void OnAccepted(bool ok) {
+    if (!ok) {
+      // The server is shutting down.
+      delete this;
+      return;
+    }
+    dispatcher_->RequestCall(cq_);
+    stream_.Read(&request_, &on_read_);
+  }
+
+  void OnRead(bool ok) {
+    if (!ok) {
+      Finish(grpc::Status(grpc::StatusCode::INTERNAL,
+                          "Client closed the call without a request message."));
+      return;
+    }
+    std::string service_name, method_name;
+    if (!ParseMethodPath(grpc_ctx_.method(), &service_name, &method_name)) {
+      Finish(MethodNotFound());
+      return;
+    }
+    handler_ = GetHandler(service_name, method_name);
+    if (handler_ == nullptr) {
+      Finish(MethodNotFound());
+      return;
+    }
+    request_class_ = AdmissionController::Classify(service_name, method_name);
+
+    // Calls are deferred at most until their deadline, after which they are
+    // served (and time out) as usual.
+    const absl::Time serving_time = std::min(
+        EarliestServingTime(service_name, method_name, &request_),
+        absl::FromChrono(grpc_ctx_.deadline()));
+    if (serving_time > absl::Now() + kDeferralTick) {
+      dispatcher_->Defer(this, serving_time);
+      return;
+    }
+    Admit();
+  }
+
+  grpc::Status MethodNotFound() const {
+    return grpc::Status(grpc::StatusCode::UNIMPLEMENTED,
+                        absl::StrCat("Method not found: ", grpc_ctx_.method()));
+  }
+
+  void RunHandler() {
+    // gRPC may only be polled for the cancellation of asynchronous calls once
+    // done, so the call is taken as cancelled once writing a response failed.
+    RequestContext ctx(dispatcher_->env_, &grpc_ctx_, [this]() {
+      absl::MutexLock lock(&mu_);
+      return !stream_ok_;
+    });
+    absl::Status status = handler_->RunSerialized(
+        &ctx, &request_,
+        [this](const grpc::ByteBuffer& response) { return Write(response); });
+    MaybeAddTrailingMetadata(status, &ctx);
+    Finish(ToGRPCStatus(status));
+  }
+
+  // Writes a response and blocks the calling handler thread until the write
+  // completes. Only one write may be outstanding on a stream at a time.
+  bool Write(const grpc::ByteBuffer& response) ABSL_LOCKS_EXCLUDED(mu_) {
+    absl::MutexLock lock(&mu_);
+    if (!stream_ok_) {
+      return false;
+    }
+    write_pending_ = true;
+    stream_.Write(response, &on_written_);
+    while (write_pending_) {
+      write_cvar_.Wait(&mu_);
+    }
+    return stream_ok_;
+  }
+
+  void OnWritten(bool ok) ABSL_LOCKS_EXCLUDED(mu_) {
+    absl::MutexLock lock(&mu_);
+    // A failed write means the call is dead (e.g. the client cancelled it), so
+    // later responses from the handler are dropped.
+    stream_ok_ = ok;
+    write_pending_ = false;
+    write_cvar_.Signal();
+  }
+
+  // Finishes the call. This must be the last use of the object, which is
+  // deleted once the completion queue reports that the call is finished.
+  void Finish(const grpc::Status& status) {
+    stream_.Finish(status, &on_finished_);
+  }
+
+  AsyncDispatcher* const dispatcher_;
+  grpc::ServerCompletionQueue* const cq_;
+
+  grpc::GenericServerContext grpc_ctx_;
+  grpc::GenericServerAsyncReaderWriter stream_;
+  grpc::ByteBuffer request_;
+
+  // Handler of the called method, once the request is read.
+  GRPCHandlerBase* handler_ = nullptr;
+
+  // Admission class of the called method, once the request is read.
+  AdmissionController::RequestClass request_class_;
+
+  Tag on_accepted_;
+  Tag on_read_;
+  Tag on_written_;
+  Tag on_finished_;
+
+  // Mutex to guard state below.
+  absl::Mutex mu_;
+  absl::CondVar write_cvar_;
+  bool write_pending_ ABSL_GUARDED_BY(mu_) = false;
+  bool stream_ok_ ABSL_GUARDED_BY(mu_) = true;
+};
+
+AsyncDispatcher::AsyncDispatcher(ServerEnv* env, int num_completion_queues,
+                                 int num_handler_threads)
+    : env_(env),
+      num_completion_queues_(std::max(num_completion_queues, 1)),
+      admission_controller_(
+          AdmissionController::DefaultOptions(num_handler_threads),
+          [this](std::function<void()> fn) {
+            handler_pool_.Schedule(std::move(fn));
+          }),
+      handler_pool_(num_handler_threads),
+      deferral_timers_(kDeferralTick) {}
+
+AsyncDispatcher::~AsyncDispatcher() { Shutdown(); }
+
+void AsyncDispatcher::RegisterWith(grpc::ServerBuilder* builder) {
+  builder->RegisterAsyncGenericService(&service_);
+  for (int i = 0; i < num_completion_queues_; ++i) {
+    queues_.push_back(builder->AddCompletionQueue());
+  }
+}
+
+void AsyncDispatcher::Start() {
+  for (auto& cq : queues_) {
+    for (int i = 0; i < kPendingCallsPerQueue; ++i) {
+      RequestCall(cq.get());
+    }
+    pollers_.push_back(absl::make_unique<std::thread>(
+        &AsyncDispatcher::PollLoop, this, cq.get()));
+  }
+}
+
+void AsyncDispatcher::Shutdown() {
+  absl::flat_hash_map<Call*, TimerService::TimerId> deferred_calls;
+  {
+    absl::MutexLock lock(&mu_);
+    if (shut_down_) {
+      return;
+    }
+    shut_down_ = true;
+    deferred_calls.swap(deferred_calls_);
+  }
+
+  // Deferred calls are served right away, since completion queues cannot be
+  // shut down while they are pending. Calls whose timer already fired are
+  // submitted by the timer, which Cancel() waits for.
+  for (const auto& [call, timer_id] : deferred_calls) {
+    if (deferral_timers_.Cancel(timer_id)) {
+      call->Admit();
+    }
+  }
+
+  // Handlers may still be waiting for writes to complete, so the completion
+  // queues must keep being polled until the handler pool is idle.
+  handler_pool_.WaitUntilIdle();
+  for (auto& cq : queues_) {
+    cq->Shutdown();
+  }
+  if (pollers_.empty()) {
+    // Never started, so drain the queues here.
+    for (auto& cq : queues_) {
+      PollLoop(cq.get());
+    }
+  }
+  for (auto& poller : pollers_) {
+    poller->join();
+  }
+  pollers_.clear();
+}
+
+void AsyncDispatcher::RequestCall(grpc::ServerCompletionQueue* cq) {
+  // Requests must not be posted to completion queues which are shut down.
+  absl::MutexLock lock(&mu_);
+  if (shut_down_) {
+    return;
+  }
+  (new Call(this, cq))->Request();
+}
+
+void AsyncDispatcher::Defer(Call* call, absl::Time deadline) {
+  absl::MutexLock lock(&mu_);
+  if (shut_down_) {
+    call->Admit();
+    return;
+  }
+  deferred_calls_[call] = deferral_timers_.Schedule(
+      deadline, [this, call]() { Undefer(call); });
+}
+
+void AsyncDispatcher::Undefer(Call* call) {
+  {
+    absl::MutexLock lock(&mu_);
+    deferred_calls_.erase(call);
+  }
+  call->Admit();
+}
+
+void AsyncDispatcher::PollLoop(grpc::ServerCompletionQueue* cq) {
+  cpu_placement::PlaceCurrentThread();
+  void* tag;
+  bool ok;
+  while (cq->Next(&tag, &ok)) {
+    (*static_cast<Tag*>(tag))(ok);
+  }
+}
+
+bool AsyncDispatcher::ParseMethodPath(const std::string& path,
+                                      std::string* service_name,
+                                      std::string* method_name) {
+  // Paths have the form "/<package>.<service>/<method>".
+  if (path.empty() || path[0] != '/') {
+    return false;
+  }
+  size_t method_pos = path.find('/', 1);
+  if (method_pos == std::string::npos || method_pos + 1 == path.size()) {
+    return false;
+  }
+  size_t service_pos = path.rfind('.', method_pos);
+  service_pos = service_pos == std::string::npos ? 1 : service_pos + 1;
+  if (service_pos >= method_pos) {
+    return false;
+  }
+  *service_name = path.substr(service_pos, method_pos - service_pos);
+  *method_name = path.substr(method_pos + 1);
+  return true;
+}
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,158 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_ASYNC_DISPATCHER_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_ASYNC_DISPATCHER_H_
+
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "grpcpp/generic/async_generic_service.h"
+#include "grpcpp/server_builder.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "common/thread_pool.h"
+#include "common/timer_service.h"
+#include "frontend/server/admission_controller.h"
+#include "frontend/server/environment.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+// AsyncDispatcher serves gRPC requests through completion queues.
+//
+// The synchronous gRPC server dedicates one of its threads to each in-flight
+// request for the request's entire lifetime, including any time the handler
+// spends blocked on locks or waiting for a safe read timestamp. With many
+// concurrent sessions this exhausts the server's thread pool.
+//
+// AsyncDispatcher instead registers a single generic service which accepts
+// calls to every method. A small, fixed number of threads poll completion
+// queues to accept calls, read requests and write responses, while handlers
+// (which may block) run on a separate bounded ThreadPool. Calls first wait to
+// be admitted by an AdmissionController, which bounds the number of handlers
+// of each class of calls running at once (e.g. queries cannot occupy every
+// handler thread) and picks the next call to run by weighted fair queuing, so
+// calls which arrive while all handler threads are busy wait in its queues
+// rather than occupying a gRPC thread.
+//
+// Reads at a timestamp in the future would wait for that time in the lock
+// manager, occupying a handler thread. Instead, calls which begin such a read
+// (see EarliestServingTime) are held on a timer until their read timestamp and
+// only then submitted for admission, so any number of them can be pending
+// without holding threads.
+//
+// Incoming methods are dispatched by name to the handlers registered via
+// REGISTER_GRPC_HANDLER, e.g. "/google.spanner.v1.Spanner/ExecuteSql" is
+// served by the handler registered as (Spanner, ExecuteSql).
+//
+// Typical usage:
+//
+//   AsyncDispatcher dispatcher(env, num_queues, num_handler_threads);
+//   dispatcher.RegisterWith(&builder);
+//   std::unique_ptr<grpc::Server> server = builder.BuildAndStart();
+//   dispatcher.Start();
+//   ...
+//   server->Shutdown();
+//   dispatcher.Shutdown();
+class AsyncDispatcher {
+ public:
+  AsyncDispatcher(ServerEnv* env, int num_completion_queues,
+                  int num_handler_threads);
+  ~AsyncDispatcher();
+
+  // Registers the generic service and completion queues with `builder`. Must
+  // be called before the server is built.
+  void RegisterWith(grpc::ServerBuilder* builder);
+
+  // Starts accepting calls. Must be called after the server has been started.
+  void Start();
+
+  // Waits for running handlers and stops polling the completion queues. Must
+  // be called after the server has been shut down.
+  void Shutdown() ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Splits a gRPC method path such as "/google.spanner.v1.Spanner/Read" into
+  // the service and method names used by the handler registry ("Spanner" and
+  // "Read"). Returns false if the path is malformed.
+  static bool ParseMethodPath(const std::string& path,
+                              std::string* service_name,
+                              std::string* method_name);
+
+ private:
+  class Call;
+
+  // Posts a request for a new incoming call on `cq`.
+  void RequestCall(grpc::ServerCompletionQueue* cq) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Submits `call` for admission once `deadline` has passed.
+  void Defer(Call* call, absl::Time deadline) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Timer callback submitting a deferred call for admission.
+  void Undefer(Call* call) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Body of each completion queue polling thread.
+  void PollLoop(grpc::ServerCompletionQueue* cq);
+
+  // Environment shared by all handlers.
+  ServerEnv* const env_;
+
+  // Number of completion queues, each polled by its own thread.
+  const int num_completion_queues_;
+
+  // Service which receives calls to every method.
+  grpc::AsyncGenericService service_;
+
+  // Completion queues on which calls are accepted and proceed.
+  std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> queues_;
+
+  // Threads polling `queues_`.
+  std::vector<std::unique_ptr<std::thread>> pollers_;
+
+  // Admits calls to the handler pool. Declared before the pool, so that it
+  // outlives the handlers, which release it once they return.
+  AdmissionController admission_controller_;
+
+  // Executor on which (potentially blocking) handlers run.
+  ThreadPool handler_pool_;
+
+  // Timers of deferred calls. Declared after the pool and admission
+  // controller, so that it is stopped before they are destroyed.
+  TimerService deferral_timers_;
+
+  // Mutex to guard state below.
+  absl::Mutex mu_;
+
+  // True once Shutdown() has been called, after which no more calls are
+  // requested from the completion queues.
+  bool shut_down_ ABSL_GUARDED_BY(mu_) = false;
+
+  // Calls waiting on deferral_timers_, and the ids of their timers.
+  absl::flat_hash_map<Call*, TimerService::TimerId> deferred_calls_
+      ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_ASYNC_DISPATCHER_H_
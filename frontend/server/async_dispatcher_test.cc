@@ -0,0 +1,237 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "frontend/server/async_dispatcher.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "google/protobuf/empty.pb.h"
+#include "google/spanner/v1/result_set.pb.h"
+#include "google/spanner/v1/spanner.grpc.pb.h"
+#include "google/spanner/v1/spanner.pb.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "grpcpp/create_channel.h"
+#include "grpcpp/security/credentials.h"
+#include "grpcpp/security/server_credentials.h"
+#include "grpcpp/server.h"
+#include "grpcpp/server_builder.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "frontend/server/handler.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+namespace {
+
+namespace spanner_api = ::google::spanner::v1;
+
+// Example unary handler which echoes the database name as the session name.
+absl::Status CreateSession(RequestContext* ctx,
+                           const spanner_api::CreateSessionRequest* request,
+                           spanner_api::Session* response) {
+  response->set_name(request->database());
+  return absl::OkStatus();
+}
+REGISTER_GRPC_HANDLER(Spanner, CreateSession);
+
+// Example unary handler which always fails.
+absl::Status GetSession(RequestContext* ctx,
+                        const spanner_api::GetSessionRequest* request,
+                        spanner_api::Session* response) {
+  return absl::NotFoundError(absl::StrCat("Session not found: ",
+                                          request->name()));
+}
+REGISTER_GRPC_HANDLER(Spanner, GetSession);
+
+// Example server streaming handler which sends one response per column.
+absl::Status StreamingRead(
+    RequestContext* ctx, const spanner_api::ReadRequest* request,
+    ServerStream<spanner_api::PartialResultSet>* stream) {
+  for (const std::string& column : request->columns()) {
+    spanner_api::PartialResultSet prs;
+    prs.set_resume_token(column);
+    stream->Send(prs);
+  }
+  return absl::OkStatus();
+}
+REGISTER_GRPC_HANDLER(Spanner, StreamingRead);
+
+class AsyncDispatcherTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    dispatcher_ = absl::make_unique<AsyncDispatcher>(
+        /*env=*/nullptr, /*num_completion_queues=*/2,
+        /*num_handler_threads=*/2);
+    grpc::ServerBuilder builder;
+    int port = -1;
+    builder.AddListeningPort("localhost:0", grpc::InsecureServerCredentials(),
+                             &port);
+    dispatcher_->RegisterWith(&builder);
+    server_ = builder.BuildAndStart();
+    ASSERT_GT(port, 0);
+    dispatcher_->Start();
+    stub_ = spanner_api::Spanner::NewStub(grpc::CreateChannel(
+        absl::StrCat("localhost:", port), grpc::InsecureChannelCredentials()));
+  }
+
+  void TearDown() override {
+    server_->Shutdown();
+    dispatcher_->Shutdown();
+  }
+
+  std::unique_ptr<AsyncDispatcher> dispatcher_;
+  std::unique_ptr<grpc::Server> server_;
+  std::unique_ptr<spanner_api::Spanner::Stub> stub_;
+};
+
+TEST_F(AsyncDispatcherTest, ServesUnaryCalls) {
+  grpc::ClientContext context;
+  spanner_api::CreateSessionRequest request;
+  request.set_database("test-db");
+  spanner_api::Session response;
+  grpc::Status status = stub_->CreateSession(&context, request, &response);
+  ASSERT_TRUE(status.ok()) << status.error_message();
+  EXPECT_EQ("test-db", response.name());
+}
+
+TEST_F(AsyncDispatcherTest, ServesServerStreamingCalls) {
+  grpc::ClientContext context;
+  spanner_api::ReadRequest request;
+  request.add_columns("a");
+  request.add_columns("b");
+  request.add_columns("c");
+  std::unique_ptr<grpc::ClientReader<spanner_api::PartialResultSet>> reader =
+      stub_->StreamingRead(&context, request);
+
+  std::vector<std::string> tokens;
+  spanner_api::PartialResultSet prs;
+  while (reader->Read(&prs)) {
+    tokens.push_back(prs.resume_token());
+  }
+  grpc::Status status = reader->Finish();
+  ASSERT_TRUE(status.ok()) << status.error_message();
+  EXPECT_THAT(tokens, testing::ElementsAre("a", "b", "c"));
+}
+
+TEST_F(AsyncDispatcherTest, DefersReadsAtFutureTimestampsUntilThen) {
+  // The test handler does not wait for the read timestamp, so the call is
+  // only served after it if the dispatcher held it back.
+  const absl::Time read_time = absl::Now() + absl::Milliseconds(200);
+  grpc::ClientContext context;
+  spanner_api::ReadRequest request;
+  request.add_columns("a");
+  google::protobuf::Timestamp* read_timestamp =
+      request.mutable_transaction()
+          ->mutable_single_use()
+          ->mutable_read_only()
+          ->mutable_read_timestamp();
+  const int64_t seconds = absl::ToUnixSeconds(read_time);
+  read_timestamp->set_seconds(seconds);
+  read_timestamp->set_nanos(
+      (read_time - absl::FromUnixSeconds(seconds)) / absl::Nanoseconds(1));
+  std::unique_ptr<grpc::ClientReader<spanner_api::PartialResultSet>> reader =
+      stub_->StreamingRead(&context, request);
+
+  spanner_api::PartialResultSet prs;
+  ASSERT_TRUE(reader->Read(&prs));
+  EXPECT_GE(absl::Now(), read_time);
+  EXPECT_EQ("a", prs.resume_token());
+  while (reader->Read(&prs)) {
+  }
+  grpc::Status status = reader->Finish();
+  ASSERT_TRUE(status.ok()) << status.error_message();
+}
+
+TEST_F(AsyncDispatcherTest, ReturnsHandlerErrors) {
+  grpc::ClientContext context;
+  spanner_api::GetSessionRequest request;
+  request.set_name("missing");
+  spanner_api::Session response;
+  grpc::Status status = stub_->GetSession(&context, request, &response);
+  EXPECT_EQ(grpc::StatusCode::NOT_FOUND, status.error_code());
+  EXPECT_THAT(status.error_message(), testing::HasSubstr("missing"));
+}
+
+TEST_F(AsyncDispatcherTest, ReturnsUnimplementedForUnregisteredMethods) {
+  grpc::ClientContext context;
+  spanner_api::DeleteSessionRequest request;
+  google::protobuf::Empty response;
+  grpc::Status status = stub_->DeleteSession(&context, request, &response);
+  EXPECT_EQ(grpc::StatusCode::UNIMPLEMENTED, status.error_code());
+}
+
+TEST_F(AsyncDispatcherTest, QueuesCallsBeyondHandlerThreads) {
+  constexpr int kNumCalls = 16;
+  std::vector<std::thread> clients;
+  std::vector<std::string> names(kNumCalls);
+  for (int i = 0; i < kNumCalls; ++i) {
+    clients.emplace_back([this, i, &names]() {
+      grpc::ClientContext context;
+      spanner_api::CreateSessionRequest request;
+      request.set_database(absl::StrCat("db-", i));
+      spanner_api::Session response;
+      if (stub_->CreateSession(&context, request, &response).ok()) {
+        names[i] = response.name();
+      }
+    });
+  }
+  for (std::thread& client : clients) {
+    client.join();
+  }
+  for (int i = 0; i < kNumCalls; ++i) {
+    EXPECT_EQ(absl::StrCat("db-", i), names[i]);
+  }
+}
+
+TEST(AsyncDispatcher, ParsesMethodPaths) {
+  std::string service_name, method_name;
+  ASSERT_TRUE(AsyncDispatcher::ParseMethodPath(
+      "/google.spanner.v1.Spanner/ExecuteSql", &service_name, &method_name));
+  EXPECT_EQ("Spanner", service_name);
+  EXPECT_EQ("ExecuteSql", method_name);
+
+  ASSERT_TRUE(AsyncDispatcher::ParseMethodPath("/Operations/GetOperation",
+                                               &service_name, &method_name));
+  EXPECT_EQ("Operations", service_name);
+  EXPECT_EQ("GetOperation", method_name);
+
+  EXPECT_FALSE(AsyncDispatcher::ParseMethodPath("", &service_name,
+                                                &method_name));
+  EXPECT_FALSE(AsyncDispatcher::ParseMethodPath("Spanner/Read", &service_name,
+                                                &method_name));
+  EXPECT_FALSE(AsyncDispatcher::ParseMethodPath("/google.spanner.v1.Spanner",
+                                                &service_name, &method_name));
+  EXPECT_FALSE(AsyncDispatcher::ParseMethodPath("/google.spanner.v1./Read",
+                                                &service_name, &method_name));
+}
+
+}  // namespace
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,210 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "frontend/server/embedded_emulator.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "zetasql/base/statusor.h"
+#include "absl/memory/memory.h"
+#include "absl/time/time.h"
+#include "backend/access/read.h"
+#include "backend/access/write.h"
+#include "backend/database/database.h"
+#include "backend/datamodel/value.h"
+#include "backend/query/query_engine.h"
+#include "backend/transaction/options.h"
+#include "backend/transaction/read_only_transaction.h"
+#include "backend/transaction/read_write_transaction.h"
+#include "frontend/entities/database.h"
+#include "frontend/server/environment.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+namespace {
+
+// Number of times a read-write transaction is attempted before its ABORTED
+// error is returned.
+constexpr int kMaxTransactionAttempts = 10;
+
+// Returns the remaining rows of `cursor`.
+zetasql_base::StatusOr<std::vector<backend::ValueList>> ReadAllRows(
+    backend::RowCursor* cursor) {
+  std::vector<backend::ValueList> rows;
+  while (cursor->Next()) {
+    backend::ValueList row;
+    row.reserve(cursor->NumColumns());
+    for (int i = 0; i < cursor->NumColumns(); ++i) {
+      row.push_back(cursor->ColumnValue(i));
+    }
+    rows.push_back(std::move(row));
+  }
+  ZETASQL_RETURN_IF_ERROR(cursor->Status());
+  return rows;
+}
+
+}  // namespace
+
+EmbeddedEmulator::EmbeddedEmulator()
+    : owned_env_(absl::make_unique<ServerEnv>()), env_(owned_env_.get()) {}
+
+EmbeddedEmulator::EmbeddedEmulator(ServerEnv* env) : env_(env) {}
+
+zetasql_base::StatusOr<backend::Database*> EmbeddedEmulator::CreateDatabase(
+    const std::string& database_uri,
+    const std::vector<std::string>& create_statements) {
+  ZETASQL_ASSIGN_OR_RETURN(
+      std::shared_ptr<Database> database,
+      env_->database_manager()->CreateDatabase(database_uri,
+                                               create_statements));
+  return database->backend();
+}
+
+zetasql_base::StatusOr<backend::Database*> EmbeddedEmulator::GetDatabase(
+    const std::string& database_uri) {
+  ZETASQL_ASSIGN_OR_RETURN(std::shared_ptr<Database> database,
+                   env_->database_manager()->GetDatabase(database_uri));
+  return database->backend();
+}
+
+absl::Status EmbeddedEmulator::DeleteDatabase(const std::string& database_uri) {
+  return env_->database_manager()->DeleteDatabase(database_uri);
+}
+
+absl::Status EmbeddedEmulator::UpdateSchema(
+    const std::string& database_uri,
+    const std::vector<std::string>& statements) {
+  ZETASQL_ASSIGN_OR_RETURN(backend::Database * database,
+                   GetDatabase(database_uri));
+  int num_succesful_statements;
+  absl::Time commit_timestamp;
+  absl::Status backfill_status;
+  ZETASQL_RETURN_IF_ERROR(database->UpdateSchema(statements,
+                                         &num_succesful_statements,
+                                         &commit_timestamp, &backfill_status));
+  return backfill_status;
+}
+
+zetasql_base::StatusOr<absl::Time> EmbeddedEmulator::RunTransaction(
+    const std::string& database_uri,
+    const std::function<absl::Status(backend::ReadWriteTransaction*)>& body) {
+  ZETASQL_ASSIGN_OR_RETURN(backend::Database * database,
+                   GetDatabase(database_uri));
+  backend::RetryState retry_state;
+  for (int attempt = 1;; ++attempt) {
+    ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<backend::ReadWriteTransaction> txn,
+                     database->CreateReadWriteTransaction(
+                         backend::ReadWriteOptions(), retry_state));
+    absl::Status status = body(txn.get());
+    if (status.ok()) {
+      status = txn->Commit();
+    } else {
+      txn->Rollback().IgnoreError();
+    }
+    if (status.ok()) {
+      return txn->GetCommitTimestamp();
+    }
+    if (status.code() != absl::StatusCode::kAborted ||
+        attempt == kMaxTransactionAttempts) {
+      return status;
+    }
+    // Retry with the priority of the aborted transaction, so that it
+    // eventually wins over the transactions it conflicts with.
+    retry_state = txn->retry_state();
+  }
+}
+
+zetasql_base::StatusOr<absl::Time> EmbeddedEmulator::Commit(
+    const std::string& database_uri, const backend::Mutation& mutation) {
+  return RunTransaction(database_uri,
+                        [&mutation](backend::ReadWriteTransaction* txn) {
+                          return txn->Write(mutation);
+                        });
+}
+
+zetasql_base::StatusOr<std::vector<backend::ValueList>> EmbeddedEmulator::Read(
+    const std::string& database_uri, const backend::ReadArg& read_arg,
+    const backend::ReadOnlyOptions& options) {
+  ZETASQL_ASSIGN_OR_RETURN(backend::Database * database,
+                   GetDatabase(database_uri));
+  std::vector<backend::ValueList> rows;
+  ZETASQL_RETURN_IF_ERROR(database->ReadAtSnapshot(
+      options, [&](backend::ReadOnlyTransaction* txn) -> absl::Status {
+        std::unique_ptr<backend::RowCursor> cursor;
+        ZETASQL_RETURN_IF_ERROR(txn->Read(read_arg, &cursor));
+        ZETASQL_ASSIGN_OR_RETURN(rows, ReadAllRows(cursor.get()));
+        return absl::OkStatus();
+      }));
+  return rows;
+}
+
+zetasql_base::StatusOr<std::vector<backend::ValueList>>
+EmbeddedEmulator::ExecuteSql(
+    const std::string& database_uri, const backend::Query& query,
+    const backend::ReadOnlyOptions& options) {
+  ZETASQL_ASSIGN_OR_RETURN(backend::Database * database,
+                   GetDatabase(database_uri));
+  std::vector<backend::ValueList> rows;
+  ZETASQL_RETURN_IF_ERROR(database->ReadAtSnapshot(
+      options, [&](backend::ReadOnlyTransaction* txn) -> absl::Status {
+        ZETASQL_ASSIGN_OR_RETURN(
+            backend::QueryResult result,
+            database->query_engine()->ExecuteSql(
+                query, backend::QueryContext{.schema = txn->schema(),
+                                             .reader = txn,
+                                             .writer = nullptr}));
+        ZETASQL_ASSIGN_OR_RETURN(rows, ReadAllRows(result.rows.get()));
+        return absl::OkStatus();
+      }));
+  return rows;
+}
+
+zetasql_base::StatusOr<int64_t> EmbeddedEmulator::ExecuteDml(
+    const std::string& database_uri, const backend::Query& query) {
+  ZETASQL_ASSIGN_OR_RETURN(backend::Database * database,
+                   GetDatabase(database_uri));
+  int64_t modified_row_count = 0;
+  ZETASQL_RETURN_IF_ERROR(
+      RunTransaction(database_uri,
+                     [&](backend::ReadWriteTransaction* txn) -> absl::Status {
+                       ZETASQL_ASSIGN_OR_RETURN(
+                           backend::QueryResult result,
+                           database->query_engine()->ExecuteSql(
+                               query,
+                               backend::QueryContext{.schema = txn->schema(),
+                                                     .reader = txn,
+                                                     .writer = txn}));
+                       modified_row_count = result.modified_row_count;
+                       return absl::OkStatus();
+                     })
+          .status());
+  return modified_row_count;
+}
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,129 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_EMBEDDED_EMULATOR_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_EMBEDDED_EMULATOR_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "zetasql/base/statusor.h"
+#include "absl/time/time.h"
+#include "backend/access/read.h"
+#include "backend/access/write.h"
+#include "backend/database/database.h"
+#include "backend/datamodel/value.h"
+#include "backend/query/query_engine.h"
+#include "backend/transaction/options.h"
+#include "backend/transaction/read_write_transaction.h"
+#include "frontend/server/environment.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+// EmbeddedEmulator runs the emulator inside the calling process, for C++ tests
+// which would otherwise start emulator_main and talk to it over gRPC. Requests
+// go straight to the backend databases, with mutations, keys and rows as
+// backend values, so no request is encoded as a proto or crosses a socket.
+//
+// Databases are named by their URIs, as with the gRPC API, and are kept by the
+// DatabaseManager of a ServerEnv. An emulator created over the environment of
+// a Server (see Server::env()) shares its databases with the server, so that
+// a test can set up data in process and exercise a client over gRPC.
+//
+// Reads and queries are strong unless other ReadOnlyOptions are given, and
+// return all their rows. Read-write transactions are retried if they abort.
+//
+// This class is thread-safe.
+class EmbeddedEmulator {
+ public:
+  // Constructs an emulator with an environment of its own.
+  EmbeddedEmulator();
+
+  // Constructs an emulator over `env`, which must outlive the emulator.
+  explicit EmbeddedEmulator(ServerEnv* env);
+
+  // Creates the database at `database_uri`, of the form
+  // projects/<project>/instances/<instance>/databases/<database>, with a
+  // schema created from `create_statements`.
+  zetasql_base::StatusOr<backend::Database*> CreateDatabase(
+      const std::string& database_uri,
+      const std::vector<std::string>& create_statements);
+
+  // Returns the database at `database_uri`. The database remains valid until
+  // it is deleted.
+  zetasql_base::StatusOr<backend::Database*> GetDatabase(
+      const std::string& database_uri);
+
+  // Deletes the database at `database_uri`.
+  absl::Status DeleteDatabase(const std::string& database_uri);
+
+  // Applies the DDL `statements` to the schema of the database, stopping at
+  // the first statement which fails.
+  absl::Status UpdateSchema(const std::string& database_uri,
+                            const std::vector<std::string>& statements);
+
+  // Runs `body` in a read-write transaction of the database and commits it,
+  // running `body` again in a new transaction if the transaction aborts.
+  // Returns the commit timestamp.
+  zetasql_base::StatusOr<absl::Time> RunTransaction(
+      const std::string& database_uri,
+      const std::function<absl::Status(backend::ReadWriteTransaction*)>& body);
+
+  // Applies `mutation` to the database in a read-write transaction, and
+  // returns the commit timestamp.
+  zetasql_base::StatusOr<absl::Time> Commit(const std::string& database_uri,
+                                    const backend::Mutation& mutation);
+
+  // Returns the rows of `read_arg`, read at a snapshot chosen by `options`.
+  zetasql_base::StatusOr<std::vector<backend::ValueList>> Read(
+      const std::string& database_uri, const backend::ReadArg& read_arg,
+      const backend::ReadOnlyOptions& options = backend::ReadOnlyOptions());
+
+  // Returns the rows of the SQL query `query`, executed at a snapshot chosen
+  // by `options`.
+  zetasql_base::StatusOr<std::vector<backend::ValueList>> ExecuteSql(
+      const std::string& database_uri, const backend::Query& query,
+      const backend::ReadOnlyOptions& options = backend::ReadOnlyOptions());
+
+  // Executes the DML statement `query` in a read-write transaction, and
+  // returns the number of rows it modified.
+  zetasql_base::StatusOr<int64_t> ExecuteDml(const std::string& database_uri,
+                                     const backend::Query& query);
+
+  // Returns the environment holding the databases.
+  ServerEnv* env() { return env_; }
+
+ private:
+  // Environment owned by the emulator, if it was not given one.
+  std::unique_ptr<ServerEnv> owned_env_;
+
+  ServerEnv* env_;
+};
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_EMBEDDED_EMULATOR_H_
@@ -0,0 +1,125 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "frontend/server/embedded_emulator.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "zetasql/public/value.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "tests/common/proto_matchers.h"
+#include "backend/access/read.h"
+#include "backend/access/write.h"
+#include "backend/datamodel/key_set.h"
+#include "backend/query/query_engine.h"
+#include "backend/transaction/read_write_transaction.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+namespace {
+
+using testing::ElementsAre;
+using zetasql::values::Int64;
+using zetasql::values::String;
+using zetasql_base::testing::IsOkAndHolds;
+using zetasql_base::testing::StatusIs;
+
+constexpr char kDatabaseUri[] =
+    "projects/test-project/instances/test-instance/databases/test-database";
+
+class EmbeddedEmulatorTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ZETASQL_ASSERT_OK(emulator_.CreateDatabase(kDatabaseUri, {R"(
+      CREATE TABLE Users (
+        UserId INT64 NOT NULL,
+        Name   STRING(MAX),
+      ) PRIMARY KEY (UserId)
+    )"}));
+  }
+
+  backend::Mutation InsertUser(int64_t id, const std::string& name) {
+    backend::Mutation mutation;
+    mutation.AddWriteOp(backend::MutationOpType::kInsert, "Users",
+                        {"UserId", "Name"}, {{Int64(id), String(name)}});
+    return mutation;
+  }
+
+  EmbeddedEmulator emulator_;
+};
+
+TEST_F(EmbeddedEmulatorTest, CommitsMutationsAndReadsThemBack) {
+  ZETASQL_ASSERT_OK(emulator_.Commit(kDatabaseUri, InsertUser(1, "Alice"));
+  ZETASQL_ASSERT_OK(emulator_.Commit(kDatabaseUri, InsertUser(2, "Bob"));
+
+  backend::ReadArg read_arg;
+  read_arg.table = "Users";
+  read_arg.key_set = backend::KeySet::All();
+  read_arg.columns = {"UserId", "Name"};
+  EXPECT_THAT(emulator_.Read(kDatabaseUri, read_arg),
+              IsOkAndHolds(ElementsAre(ElementsAre(Int64(1), String("Alice")),
+                                       ElementsAre(Int64(2), String("Bob")))));
+}
+
+TEST_F(EmbeddedEmulatorTest, ExecutesQueriesAndDml) {
+  ZETASQL_ASSERT_OK(emulator_.Commit(kDatabaseUri, InsertUser(1, "Alice"));
+
+  EXPECT_THAT(emulator_.ExecuteDml(
+                  kDatabaseUri,
+                  backend::Query{"UPDATE Users SET Name = 'Carol' WHERE TRUE"}),
+              IsOkAndHolds(1));
+  EXPECT_THAT(
+      emulator_.ExecuteSql(
+          kDatabaseUri,
+          backend::Query{"SELECT Name FROM Users WHERE UserId = @id",
+                         {{"id", Int64(1)}}}),
+      IsOkAndHolds(ElementsAre(ElementsAre(String("Carol")))));
+}
+
+TEST_F(EmbeddedEmulatorTest, FailedTransactionsAreRolledBack) {
+  EXPECT_THAT(emulator_.RunTransaction(
+                  kDatabaseUri,
+                  [this](backend::ReadWriteTransaction* txn) -> absl::Status {
+                    ZETASQL_RETURN_IF_ERROR(txn->Write(InsertUser(1, "Alice")));
+                    return txn->Write(InsertUser(1, "Alice"));
+                  }),
+              StatusIs(absl::StatusCode::kAlreadyExists));
+  EXPECT_THAT(emulator_.ExecuteSql(kDatabaseUri,
+                                   backend::Query{"SELECT UserId FROM Users"}),
+              IsOkAndHolds(testing::IsEmpty()));
+}
+
+TEST_F(EmbeddedEmulatorTest, UpdatesSchemasAndDeletesDatabases) {
+  ZETASQL_ASSERT_OK(emulator_.UpdateSchema(
+      kDatabaseUri, {"CREATE INDEX UsersByName ON Users(Name)"}));
+  ZETASQL_ASSERT_OK(emulator_.DeleteDatabase(kDatabaseUri));
+  EXPECT_THAT(emulator_.GetDatabase(kDatabaseUri),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+}  // namespace
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -20,6 +20,7 @@
 #include <memory>
 
 #include "common/clock.h"
+#include "common/timer_service.h"
 #include "frontend/collections/database_manager.h"
 #include "frontend/collections/instance_manager.h"
 #include "frontend/collections/operation_manager.h"
@@ -35,10 +36,14 @@ class ServerEnv {
  public:
   ServerEnv()
       : clock_(new Clock()),
+        timer_service_(new TimerService()),
         database_manager_(new DatabaseManager(clock_.get())),
         instance_manager_(new InstanceManager()),
-        operation_manager_(new OperationManager()),
-        session_manager_(new SessionManager(clock_.get())) {}
+        operation_manager_(new OperationManager(
+            clock_.get(), OperationManager::kCompletedOperationTtl,
+            OperationManager::kMaxOperations, timer_service_.get())),
+        session_manager_(
+            new SessionManager(clock_.get(), timer_service_.get())) {}
 
   Clock* clock() { return clock_.get(); }
   DatabaseManager* database_manager() { return database_manager_.get(); }
@@ -48,6 +53,8 @@ class ServerEnv {
 
  private:
   std::unique_ptr<Clock> clock_;
+  // Declared before the managers, so that it outlives them.
+  std::unique_ptr<TimerService> timer_service_;
   std::unique_ptr<DatabaseManager> database_manager_;
   std::unique_ptr<InstanceManager> instance_manager_;
   std::unique_ptr<OperationManager> operation_manager_;
@@ -17,11 +17,33 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_HANDLER_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_HANDLER_H_
 
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+
 #include "zetasql/base/logging.h"
 #include "grpcpp/grpcpp.h"
+#include "grpcpp/impl/codegen/proto_utils.h"
 #include "grpcpp/impl/codegen/sync_stream.h"
+#include "grpcpp/support/byte_buffer.h"
+#include "google/protobuf/arena.h"
+#include "google/protobuf/message.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "common/config.h"
+#include "common/metrics.h"
+#include "common/slow_log.h"
+#include "common/trace.h"
+#include "frontend/proto/workload_capture.pb.h"
 #include "frontend/server/request_context.h"
+#include "frontend/server/workload_capture.h"
 #include "absl/status/status.h"
 
 namespace google {
@@ -29,6 +51,18 @@ namespace spanner {
 namespace emulator {
 namespace frontend {
 
+// Counts the size of a response message sent to a client, if metrics are
+// enabled.
+template <typename T>
+void RecordResponseBytes(const T& msg) {
+  if (metrics::Enabled()) {
+    static metrics::Counter* const response_bytes = metrics::GetCounter(
+        "spanner_emulator_response_bytes_total",
+        "Total size of the response messages sent to clients.");
+    response_bytes->Increment(msg.ByteSizeLong());
+  }
+}
+
 // ServerStream intercepts writes to a grpc::ServerWriter.
 //
 // Instead of passing a grpc::ServerWriter to server streaming handlers, we pass
@@ -38,17 +72,191 @@ template <typename T>
 class ServerStream {
  public:
   explicit ServerStream(grpc::ServerWriterInterface<T>* writer)
-      : writer_(writer) {}
+      : writer_(writer), capture_(workload_capture::Enabled()) {}
 
-  void Send(const T& msg) {
+  // Writes `msg` to the client. Blocks while the transport's flow control
+  // window is full, so a slow client slows down the producer of the stream
+  // instead of causing responses to be buffered. Returns false if the message
+  // could not be written because the call is dead (e.g. it was cancelled), in
+  // which case handlers should stop producing responses.
+  bool Send(const T& msg) {
     if (config::should_log_requests()) {
       LOG(INFO) << "Sending streaming response:\n" << msg.DebugString();
     }
-    writer_->Write(msg);
+    RecordResponseBytes(msg);
+    if (capture_ && !sent_) {
+      msg.SerializeToString(&first_response_);
+    }
+    sent_ = true;
+    return writer_->Write(msg);
   }
 
+  // Returns true if a response was sent.
+  bool sent() const { return sent_; }
+
+  // Returns the first response sent, serialized, if calls were being captured
+  // when the stream was created.
+  const std::string& first_response() const { return first_response_; }
+
  private:
   grpc::ServerWriterInterface<T>* writer_;
+  const bool capture_;
+  bool sent_ = false;
+  std::string first_response_;
+};
+
+// PipelinedServerStream writes the responses of a ServerStream on a separate
+// thread, so that a handler evaluates and converts its next response while the
+// previous one is being written to the wire. At most `max_queued` responses
+// wait to be written, and Send blocks while that many are queued, so a slow
+// client still slows down the producer of the stream.
+//
+// The writer thread is only started by the first response which is not the
+// last one, so single-response streams are written by the calling thread. All
+// responses are written, in order, once Finish returns or the stream is
+// destroyed, which must happen before the handler returns.
+template <typename T>
+class PipelinedServerStream {
+ public:
+  explicit PipelinedServerStream(ServerStream<T>* stream, int max_queued = 2)
+      : stream_(stream), max_queued_(max_queued) {}
+  ~PipelinedServerStream() { Finish(); }
+
+  PipelinedServerStream(const PipelinedServerStream&) = delete;
+  PipelinedServerStream& operator=(const PipelinedServerStream&) = delete;
+
+  // Queues `msg` to be written. `last` is true for the final response of the
+  // stream. Returns false if a response could not be written, in which case
+  // handlers should stop producing responses.
+  bool Send(T msg, bool last) {
+    if (!writer_.joinable()) {
+      if (last) {
+        return WriteInline(msg);
+      }
+      writer_ = std::thread(&PipelinedServerStream::WriterLoop, this);
+    }
+    absl::MutexLock lock(&mu_);
+    mu_.Await(absl::Condition(this, &PipelinedServerStream::CanQueue));
+    if (failed_) {
+      return false;
+    }
+    queue_.push_back(std::move(msg));
+    return true;
+  }
+
+  // Waits until all queued responses are written. Returns false if any of the
+  // responses could not be written.
+  bool Finish() {
+    {
+      absl::MutexLock lock(&mu_);
+      finished_ = true;
+    }
+    if (writer_.joinable()) {
+      writer_.join();
+    }
+    absl::MutexLock lock(&mu_);
+    return !failed_;
+  }
+
+ private:
+  bool WriteInline(const T& msg) {
+    if (stream_->Send(msg)) {
+      return true;
+    }
+    absl::MutexLock lock(&mu_);
+    failed_ = true;
+    return false;
+  }
+
+  void WriterLoop() {
+    while (true) {
+      T msg;
+      {
+        absl::MutexLock lock(&mu_);
+        mu_.Await(absl::Condition(this, &PipelinedServerStream::HasWork));
+        if (queue_.empty()) {
+          return;
+        }
+        msg = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      if (!stream_->Send(msg)) {
+        absl::MutexLock lock(&mu_);
+        failed_ = true;
+        queue_.clear();
+        return;
+      }
+    }
+  }
+
+  bool CanQueue() const ABSL_SHARED_LOCKS_REQUIRED(mu_) {
+    return failed_ || queue_.size() < max_queued_;
+  }
+
+  bool HasWork() const ABSL_SHARED_LOCKS_REQUIRED(mu_) {
+    return !queue_.empty() || finished_;
+  }
+
+  ServerStream<T>* const stream_;
+  const size_t max_queued_;
+
+  absl::Mutex mu_;
+  std::deque<T> queue_ ABSL_GUARDED_BY(mu_);
+
+  // Set by Finish, once no more responses are queued.
+  bool finished_ ABSL_GUARDED_BY(mu_) = false;
+
+  // Set once a response could not be written.
+  bool failed_ ABSL_GUARDED_BY(mu_) = false;
+
+  std::thread writer_;
+};
+
+// Serializes a response message. Returns false if serialization failed.
+template <typename T>
+bool SerializeResponse(const T& msg, grpc::ByteBuffer* buffer) {
+  bool own_buffer;
+  return grpc::SerializationTraits<T>::Serialize(msg, buffer, &own_buffer)
+      .ok();
+}
+
+// SerializingServerWriter adapts a callback which accepts serialized responses
+// to the grpc::ServerWriterInterface used by ServerStream.
+template <typename T>
+class SerializingServerWriter final : public grpc::ServerWriterInterface<T> {
+ public:
+  explicit SerializingServerWriter(
+      std::function<bool(const grpc::ByteBuffer&)> writer)
+      : writer_(std::move(writer)) {}
+
+  void SendInitialMetadata() override {}
+
+  bool Write(const T& msg, grpc::WriteOptions options) override {
+    grpc::ByteBuffer buffer;
+    return SerializeResponse(msg, &buffer) && writer_(buffer);
+  }
+
+ private:
+  std::function<bool(const grpc::ByteBuffer&)> writer_;
+};
+
+// MessageServerWriter adapts a callback which accepts response messages to the
+// grpc::ServerWriterInterface used by ServerStream.
+template <typename T>
+class MessageServerWriter final : public grpc::ServerWriterInterface<T> {
+ public:
+  explicit MessageServerWriter(
+      std::function<bool(const google::protobuf::Message&)> writer)
+      : writer_(std::move(writer)) {}
+
+  void SendInitialMetadata() override {}
+
+  bool Write(const T& msg, grpc::WriteOptions options) override {
+    return writer_(msg);
+  }
+
+ private:
+  std::function<bool(const google::protobuf::Message&)> writer_;
 };
 
 // Base class for gRPC handlers.
@@ -56,15 +264,125 @@ class GRPCHandlerBase {
  public:
   GRPCHandlerBase(const std::string& service_name,
                   const std::string& method_name)
-      : service_name_(service_name), method_name_(method_name) {}
+      : service_name_(service_name),
+        method_name_(method_name),
+        full_method_name_(absl::StrCat(service_name, ".", method_name)),
+        latency_(metrics::GetLatencyHistogram(
+            "spanner_emulator_rpc_latency_seconds",
+            "Latency of the gRPC methods served by the emulator.",
+            {{"method", full_method_name_}})) {}
   virtual ~GRPCHandlerBase() {}
 
   const std::string& service_name() { return service_name_; }
   const std::string& method_name() { return method_name_; }
 
+  // Callback through which RunSerialized emits serialized responses. Returns
+  // false if the response could not be delivered (e.g. the call was cancelled).
+  using SerializedWriter = std::function<bool(const grpc::ByteBuffer&)>;
+
+  // Parses `request`, invokes the handler and passes each serialized response
+  // to `writer`. Unary handlers emit exactly one response if they succeed and
+  // none if they fail.
+  //
+  // This is used by the asynchronous server, which receives requests as raw
+  // bytes and only learns which method is being called at runtime.
+  virtual absl::Status RunSerialized(RequestContext* ctx,
+                                     grpc::ByteBuffer* request,
+                                     const SerializedWriter& writer) = 0;
+
+  // Callback through which RunMessage emits responses.
+  using MessageWriter = std::function<bool(const google::protobuf::Message&)>;
+
+  // Returns an empty request message of the method.
+  virtual std::unique_ptr<google::protobuf::Message> NewRequest() const = 0;
+
+  // Invokes the handler on `request`, which must have been returned by
+  // NewRequest(), and passes each response to `writer`.
+  //
+  // This is used by the REST server, which transcodes requests from JSON
+  // directly into messages.
+  virtual absl::Status RunMessage(RequestContext* ctx,
+                                  const google::protobuf::Message& request,
+                                  const MessageWriter& writer) = 0;
+
+ protected:
+  // Parses a serialized request message.
+  template <typename RequestT>
+  absl::Status ParseRequest(grpc::ByteBuffer* buffer, RequestT* request) {
+    if (!grpc::SerializationTraits<RequestT>::Deserialize(buffer, request)
+             .ok()) {
+      return absl::InternalError(absl::StrCat(
+          "Failed to parse request for ", service_name_, ".", method_name_));
+    }
+    return absl::OkStatus();
+  }
+
+  // Options of the arena on which RunSerialized allocates the messages of a
+  // call. Requests such as commits carry many small sub-messages (mutations,
+  // values) and unary responses such as result sets build many more, so they
+  // are allocated from a few large blocks which are released at once when the
+  // call finishes instead of one object at a time.
+  static google::protobuf::ArenaOptions CallArenaOptions() {
+    google::protobuf::ArenaOptions options;
+    options.start_block_size = 16 * 1024;
+    options.max_block_size = 1024 * 1024;
+    return options;
+  }
+
+  // Counts a failed call of the method, if metrics are enabled.
+  void RecordError(const absl::Status& status) {
+    if (metrics::Enabled()) {
+      metrics::GetCounter(
+          "spanner_emulator_rpc_errors_total",
+          "Number of gRPC calls which failed, by method and status code.",
+          {{"method", full_method_name_},
+           {"code", absl::StatusCodeToString(status.code())}})
+          ->Increment();
+    }
+  }
+
+  // Latency of the calls of the method.
+  metrics::Histogram* latency() const { return latency_; }
+
+  // Returns the trace context of a call of the method, which is only parsed
+  // from the request metadata if requests may be traced.
+  static trace::TraceContext CallTraceContext(const RequestContext* ctx) {
+    return trace::Enabled() ? ctx->trace_context() : trace::TraceContext();
+  }
+
+  // Name of the method qualified by its service, e.g. "Spanner.ExecuteSql".
+  const std::string& full_method_name() const { return full_method_name_; }
+
+  // Appends a call of the method, which started at `start` and completed with
+  // `status`, to the workload capture. `first_response` is the serialized
+  // response of a unary call, or first response of a streaming one, or null if
+  // none was sent.
+  template <typename RequestT, typename ResponseT>
+  void CaptureCall(const RequestT& request, bool server_streaming,
+                   absl::Time start, const absl::Status& status,
+                   const std::string* first_response) {
+    CapturedCall call;
+    call.set_method(absl::StrCat("/", RequestT::descriptor()->file()->package(),
+                                 ".", service_name_, "/", method_name_));
+    call.set_request_type(RequestT::descriptor()->full_name());
+    call.set_response_type(ResponseT::descriptor()->full_name());
+    call.set_server_streaming(server_streaming);
+    call.set_start_offset_micros(
+        absl::ToInt64Microseconds(workload_capture::SinceStart(start)));
+    call.set_latency_micros(absl::ToInt64Microseconds(absl::Now() - start));
+    call.set_status_code(static_cast<int>(status.code()));
+    request.SerializeToString(call.mutable_request());
+    if (first_response != nullptr) {
+      call.set_first_response(*first_response);
+    }
+    workload_capture::Record(call);
+  }
+
  private:
   const std::string service_name_;
   const std::string method_name_;
+  const std::string full_method_name_;
+  metrics::Histogram* const latency_;
 };
 
 // UnaryGRPCHandler handles unary gRPC methods.
@@ -87,7 +405,30 @@ class UnaryGRPCHandler final : public GRPCHandlerBase {
       LOG(INFO) << "Request[" << service_name() << "." << method_name() << "]\n"
                 << request->DebugString();
     }
-    absl::Status status = fn_(ctx, request, response);
+    const bool capture = workload_capture::Enabled();
+    const absl::Time start = capture ? absl::Now() : absl::InfinitePast();
+    absl::Status status;
+    {
+      slow_log::ScopedRequest slow_request(full_method_name());
+      trace::ScopedTrace trace(full_method_name(), CallTraceContext(ctx));
+      metrics::ScopedLatencyRecorder recorder(latency());
+      status = fn_(ctx, request, response);
+      slow_request.set_status(status);
+    }
+    if (status.ok()) {
+      RecordResponseBytes(*response);
+    } else {
+      RecordError(status);
+    }
+    if (capture) {
+      std::string serialized_response;
+      if (status.ok()) {
+        response->SerializeToString(&serialized_response);
+      }
+      CaptureCall<RequestT, ResponseT>(
+          *request, /*server_streaming=*/false, start, status,
+          status.ok() ? &serialized_response : nullptr);
+    }
     if (config::should_log_requests()) {
       LOG(INFO) << "Response[" << service_name() << "." << method_name()
                 << "]\n"
@@ -97,6 +438,48 @@ class UnaryGRPCHandler final : public GRPCHandlerBase {
     return status;
   }
 
+  absl::Status RunSerialized(RequestContext* ctx, grpc::ByteBuffer* request,
+                             const SerializedWriter& writer) override {
+    google::protobuf::Arena arena(CallArenaOptions());
+    RequestT* parsed_request =
+        google::protobuf::Arena::CreateMessage<RequestT>(&arena);
+    absl::Status status = ParseRequest(request, parsed_request);
+    if (!status.ok()) {
+      return status;
+    }
+    ResponseT* response =
+        google::protobuf::Arena::CreateMessage<ResponseT>(&arena);
+    status = Run(ctx, parsed_request, response);
+    if (!status.ok()) {
+      return status;
+    }
+    grpc::ByteBuffer buffer;
+    if (!SerializeResponse(*response, &buffer)) {
+      return absl::InternalError(absl::StrCat(
+          "Failed to serialize response for ", service_name(), ".",
+          method_name()));
+    }
+    writer(buffer);
+    return absl::OkStatus();
+  }
+
+  std::unique_ptr<google::protobuf::Message> NewRequest() const override {
+    return absl::make_unique<RequestT>();
+  }
+
+  absl::Status RunMessage(RequestContext* ctx,
+                          const google::protobuf::Message& request,
+                          const MessageWriter& writer) override {
+    ResponseT response;
+    absl::Status status =
+        Run(ctx, static_cast<const RequestT*>(&request), &response);
+    if (!status.ok()) {
+      return status;
+    }
+    writer(response);
+    return absl::OkStatus();
+  }
+
  private:
   HandlerFn fn_;
 };
@@ -122,7 +505,24 @@ class ServerStreamingGRPCHandler final : public GRPCHandlerBase {
                 << request->DebugString();
     }
     ServerStream<ResponseT> stream(writer);
-    absl::Status status = fn_(ctx, request, &stream);
+    const bool capture = workload_capture::Enabled();
+    const absl::Time start = capture ? absl::Now() : absl::InfinitePast();
+    absl::Status status;
+    {
+      slow_log::ScopedRequest slow_request(full_method_name());
+      trace::ScopedTrace trace(full_method_name(), CallTraceContext(ctx));
+      metrics::ScopedLatencyRecorder recorder(latency());
+      status = fn_(ctx, request, &stream);
+      slow_request.set_status(status);
+    }
+    if (!status.ok()) {
+      RecordError(status);
+    }
+    if (capture) {
+      CaptureCall<RequestT, ResponseT>(
+          *request, /*server_streaming=*/true, start, status,
+          stream.sent() ? &stream.first_response() : nullptr);
+    }
     if (config::should_log_requests()) {
       LOG(INFO) << "Response[" << service_name() << "." << method_name()
                 << "]\n"
@@ -132,6 +532,30 @@ class ServerStreamingGRPCHandler final : public GRPCHandlerBase {
     return status;
   }
 
+  absl::Status RunSerialized(RequestContext* ctx, grpc::ByteBuffer* request,
+                             const SerializedWriter& writer) override {
+    google::protobuf::Arena arena(CallArenaOptions());
+    RequestT* parsed_request =
+        google::protobuf::Arena::CreateMessage<RequestT>(&arena);
+    absl::Status status = ParseRequest(request, parsed_request);
+    if (!status.ok()) {
+      return status;
+    }
+    SerializingServerWriter<ResponseT> serializing_writer(writer);
+    return Run(ctx, parsed_request, &serializing_writer);
+  }
+
+  std::unique_ptr<google::protobuf::Message> NewRequest() const override {
+    return absl::make_unique<RequestT>();
+  }
+
+  absl::Status RunMessage(RequestContext* ctx,
+                          const google::protobuf::Message& request,
+                          const MessageWriter& writer) override {
+    MessageServerWriter<ResponseT> message_writer(writer);
+    return Run(ctx, static_cast<const RequestT*>(&request), &message_writer);
+  }
+
  private:
   HandlerFn fn_;
 };
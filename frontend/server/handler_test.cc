@@ -16,6 +16,10 @@
 
 #include "frontend/server/handler.h"
 
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "google/spanner/v1/result_set.pb.h"
 #include "google/spanner/v1/spanner.pb.h"
 #include "gmock/gmock.h"
@@ -56,6 +60,46 @@ TEST(HandlerRegisterer, RegistersUnaryGRPCHandler) {
   EXPECT_EQ("Hello, World!", response.name());
 }
 
+// Example handler which reports whether its messages live on an arena.
+absl::Status GetSession(
+    RequestContext* ctx, const google::spanner::v1::GetSessionRequest* request,
+    google::spanner::v1::Session* response) {
+  response->set_name(request->name());
+  (*response->mutable_labels())["request_on_arena"] =
+      request->GetArena() != nullptr ? "true" : "false";
+  (*response->mutable_labels())["response_on_arena"] =
+      response->GetArena() != nullptr ? "true" : "false";
+  return absl::OkStatus();
+}
+REGISTER_GRPC_HANDLER(Spanner, GetSession);
+
+TEST(HandlerRegisterer, AllocatesSerializedUnaryCallsOnAnArena) {
+  GRPCHandlerBase* handler = GetHandler("Spanner", "GetSession");
+  ASSERT_NE(nullptr, handler);
+
+  RequestContext ctx(nullptr, nullptr);
+  google::spanner::v1::GetSessionRequest request;
+  request.set_name("session");
+  grpc::ByteBuffer request_buffer;
+  ASSERT_TRUE(SerializeResponse(request, &request_buffer));
+  std::vector<google::spanner::v1::Session> responses;
+  ZETASQL_EXPECT_OK(handler->RunSerialized(
+      &ctx, &request_buffer, [&responses](const grpc::ByteBuffer& buffer) {
+        grpc::ByteBuffer copy(buffer);
+        google::spanner::v1::Session session;
+        EXPECT_TRUE(
+            grpc::SerializationTraits<google::spanner::v1::Session>::
+                Deserialize(&copy, &session)
+                .ok());
+        responses.push_back(session);
+        return true;
+      }));
+  ASSERT_EQ(1, responses.size());
+  EXPECT_EQ("session", responses[0].name());
+  EXPECT_EQ("true", responses[0].labels().at("request_on_arena"));
+  EXPECT_EQ("true", responses[0].labels().at("response_on_arena"));
+}
+
 // Test ServerWriter which just captures the sent messages.
 template <class MessageT>
 class TestServerWriter : public grpc::ServerWriterInterface<MessageT> {
@@ -104,6 +148,83 @@ TEST(HandlerRegisterer, RegistersServerStreamingGRPCHandler) {
   EXPECT_EQ("World", writer.messages().at(1).resume_token());
 }
 
+TEST(HandlerRegisterer, RunsHandlersOnSerializedMessages) {
+  GRPCHandlerBase* handler = GetHandler("Spanner", "StreamingRead");
+  ASSERT_NE(nullptr, handler);
+
+  RequestContext ctx(nullptr, nullptr);
+  google::spanner::v1::ReadRequest request;
+  grpc::ByteBuffer request_buffer;
+  ASSERT_TRUE(SerializeResponse(request, &request_buffer));
+  std::vector<google::spanner::v1::PartialResultSet> responses;
+  ZETASQL_EXPECT_OK(handler->RunSerialized(
+      &ctx, &request_buffer, [&responses](const grpc::ByteBuffer& buffer) {
+        grpc::ByteBuffer copy(buffer);
+        google::spanner::v1::PartialResultSet prs;
+        EXPECT_TRUE(grpc::SerializationTraits<
+                        google::spanner::v1::PartialResultSet>::Deserialize(
+                        &copy, &prs)
+                        .ok());
+        responses.push_back(prs);
+        return true;
+      }));
+  ASSERT_EQ(2, responses.size());
+  EXPECT_EQ("Hello", responses.at(0).resume_token());
+  EXPECT_EQ("World", responses.at(1).resume_token());
+}
+
+TEST(HandlerRegisterer, RunsHandlersOnMessages) {
+  GRPCHandlerBase* handler = GetHandler("Spanner", "StreamingRead");
+  ASSERT_NE(nullptr, handler);
+
+  RequestContext ctx(nullptr, nullptr);
+  std::unique_ptr<google::protobuf::Message> request = handler->NewRequest();
+  EXPECT_EQ(request->GetDescriptor(),
+            google::spanner::v1::ReadRequest::descriptor());
+  std::vector<std::string> resume_tokens;
+  ZETASQL_EXPECT_OK(handler->RunMessage(
+      &ctx, *request,
+      [&resume_tokens](const google::protobuf::Message& response) {
+        resume_tokens.push_back(
+            static_cast<const google::spanner::v1::PartialResultSet&>(response)
+                .resume_token());
+        return true;
+      }));
+  EXPECT_THAT(resume_tokens, testing::ElementsAre("Hello", "World"));
+}
+
+TEST(PipelinedServerStream, WritesResponsesInOrder) {
+  TestServerWriter<google::spanner::v1::PartialResultSet> writer;
+  ServerStream<google::spanner::v1::PartialResultSet> stream(&writer);
+  {
+    PipelinedServerStream<google::spanner::v1::PartialResultSet>
+        pipelined_stream(&stream);
+    for (int i = 0; i < 10; ++i) {
+      google::spanner::v1::PartialResultSet prs;
+      prs.set_resume_token(std::to_string(i));
+      ASSERT_TRUE(pipelined_stream.Send(std::move(prs), /*last=*/i == 9));
+    }
+    EXPECT_TRUE(pipelined_stream.Finish());
+  }
+  ASSERT_EQ(10, writer.messages().size());
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(std::to_string(i), writer.messages().at(i).resume_token());
+  }
+}
+
+TEST(PipelinedServerStream, WritesSingleResponse) {
+  TestServerWriter<google::spanner::v1::PartialResultSet> writer;
+  ServerStream<google::spanner::v1::PartialResultSet> stream(&writer);
+  PipelinedServerStream<google::spanner::v1::PartialResultSet> pipelined_stream(
+      &stream);
+  google::spanner::v1::PartialResultSet prs;
+  prs.set_resume_token("Hello");
+  ASSERT_TRUE(pipelined_stream.Send(std::move(prs), /*last=*/true));
+  ASSERT_EQ(1, writer.messages().size());
+  EXPECT_EQ("Hello", writer.messages().at(0).resume_token());
+  EXPECT_TRUE(pipelined_stream.Finish());
+}
+
 TEST(HandlerRegisterer, ReturnsNullptrForUnrecognizedHandlers) {
   ASSERT_EQ(nullptr, GetHandler("UnknownServer", "UnknownMethod"));
 }
@@ -0,0 +1,116 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "frontend/server/http_listener.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include "zetasql/base/logging.h"
+#include "absl/strings/match.h"
+#include "absl/strings/string_view.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+int ListenOnHostPort(const std::string& host_port, int* port) {
+  const size_t colon = host_port.rfind(':');
+  if (colon == std::string::npos) {
+    LOG(ERROR) << "Invalid address " << host_port;
+    return -1;
+  }
+  std::string host = host_port.substr(0, colon);
+  const std::string service = host_port.substr(colon + 1);
+  // Strip the brackets of IPv6 addresses such as [::1].
+  if (absl::StartsWith(host, "[") && absl::EndsWith(host, "]")) {
+    host = host.substr(1, host.size() - 2);
+  }
+
+  addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  addrinfo* addresses = nullptr;
+  if (int error = getaddrinfo(host.empty() ? nullptr : host.c_str(),
+                              service.c_str(), &hints, &addresses);
+      error != 0) {
+    LOG(ERROR) << "Failed to resolve address " << host_port << ": "
+               << gai_strerror(error);
+    return -1;
+  }
+
+  int listening_socket = -1;
+  for (addrinfo* address = addresses; address != nullptr;
+       address = address->ai_next) {
+    listening_socket = socket(address->ai_family, address->ai_socktype,
+                              address->ai_protocol);
+    if (listening_socket < 0) {
+      continue;
+    }
+    int reuse = 1;
+    setsockopt(listening_socket, SOL_SOCKET, SO_REUSEADDR, &reuse,
+               sizeof(reuse));
+    if (bind(listening_socket, address->ai_addr, address->ai_addrlen) == 0 &&
+        listen(listening_socket, /*backlog=*/16) == 0) {
+      break;
+    }
+    close(listening_socket);
+    listening_socket = -1;
+  }
+  freeaddrinfo(addresses);
+  if (listening_socket < 0) {
+    LOG(ERROR) << "Failed to listen on " << host_port << ": "
+               << std::strerror(errno);
+    return -1;
+  }
+
+  sockaddr_storage bound_address;
+  socklen_t bound_address_size = sizeof(bound_address);
+  getsockname(listening_socket, reinterpret_cast<sockaddr*>(&bound_address),
+              &bound_address_size);
+  *port =
+      bound_address.ss_family == AF_INET6
+          ? ntohs(reinterpret_cast<sockaddr_in6*>(&bound_address)->sin6_port)
+          : ntohs(reinterpret_cast<sockaddr_in*>(&bound_address)->sin_port);
+  return listening_socket;
+}
+
+bool WriteAll(int connection, absl::string_view data) {
+  while (!data.empty()) {
+    ssize_t written = send(connection, data.data(), data.size(), MSG_NOSIGNAL);
+    if (written <= 0) {
+      return false;
+    }
+    data.remove_prefix(written);
+  }
+  return true;
+}
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,42 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_HTTP_LISTENER_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_HTTP_LISTENER_H_
+
+#include <string>
+
+#include "absl/strings/string_view.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+// Returns a socket listening on `host_port` (e.g. "localhost:9090", or
+// "localhost:0" to pick any free port) and sets `port` to the port it is bound
+// to, or returns -1 and logs the reason if it could not listen.
+int ListenOnHostPort(const std::string& host_port, int* port);
+
+// Writes all of `data` to `connection`. Returns false if the client went away.
+bool WriteAll(int connection, absl::string_view data);
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_HTTP_LISTENER_H_
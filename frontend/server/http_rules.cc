@@ -0,0 +1,345 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "frontend/server/http_rules.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "google/api/http.pb.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+namespace {
+
+absl::Status InvalidPathTemplate(absl::string_view path_template,
+                                 absl::string_view reason) {
+  return absl::InvalidArgumentError(
+      absl::StrCat("Invalid path template ", path_template, ": ", reason));
+}
+
+// Returns `segment` with its %XX escapes decoded.
+std::string Unescape(absl::string_view segment) {
+  std::string unescaped;
+  for (size_t i = 0; i < segment.size(); ++i) {
+    int value;
+    if (segment[i] == '%' && i + 2 < segment.size() &&
+        absl::SimpleHexAtoi(segment.substr(i + 1, 2), &value)) {
+      unescaped.push_back(static_cast<char>(value));
+      i += 2;
+    } else {
+      unescaped.push_back(segment[i]);
+    }
+  }
+  return unescaped;
+}
+
+}  // namespace
+
+zetasql_base::StatusOr<PathTemplate> PathTemplate::Parse(
+    absl::string_view path_template) {
+  if (!absl::StartsWith(path_template, "/")) {
+    return InvalidPathTemplate(path_template, "must start with /");
+  }
+  PathTemplate parsed;
+  absl::string_view rest = path_template.substr(1);
+
+  // The verb follows the last colon outside of the variables and segments.
+  const size_t colon = rest.rfind(':');
+  if (colon != absl::string_view::npos &&
+      (rest.rfind('/') == absl::string_view::npos || colon > rest.rfind('/')) &&
+      (rest.rfind('}') == absl::string_view::npos || colon > rest.rfind('}'))) {
+    parsed.verb_ = std::string(rest.substr(colon + 1));
+    rest = rest.substr(0, colon);
+  }
+
+  auto add_segment = [&](absl::string_view segment) -> absl::Status {
+    Segment parsed_segment;
+    if (segment.empty() || absl::StrContains(segment, "{") ||
+        absl::StrContains(segment, "}")) {
+      return InvalidPathTemplate(path_template,
+                                 absl::StrCat("invalid segment ", segment));
+    } else if (segment == "*") {
+      parsed_segment.wildcard = true;
+    } else if (segment == "**") {
+      for (const Segment& other : parsed.segments_) {
+        if (other.double_wildcard) {
+          return InvalidPathTemplate(path_template, "more than one **");
+        }
+      }
+      parsed_segment.double_wildcard = true;
+    } else {
+      parsed_segment.literal = std::string(segment);
+    }
+    parsed.segments_.push_back(std::move(parsed_segment));
+    return absl::OkStatus();
+  };
+
+  while (!rest.empty()) {
+    if (absl::ConsumePrefix(&rest, "{")) {
+      const size_t close = rest.find('}');
+      if (close == absl::string_view::npos) {
+        return InvalidPathTemplate(path_template, "unterminated variable");
+      }
+      std::pair<absl::string_view, absl::string_view> variable =
+          absl::StrSplit(rest.substr(0, close), absl::MaxSplits('=', 1));
+      if (variable.first.empty()) {
+        return InvalidPathTemplate(path_template, "variable without field");
+      }
+      const int begin = parsed.segments_.size();
+      for (absl::string_view segment : absl::StrSplit(
+               variable.second.empty() ? "*" : variable.second, '/')) {
+        ZETASQL_RETURN_IF_ERROR(add_segment(segment));
+      }
+      parsed.variables_.push_back({std::string(variable.first), begin,
+                                   static_cast<int>(parsed.segments_.size())});
+      rest = rest.substr(close + 1);
+    } else {
+      const size_t slash = rest.find('/');
+      ZETASQL_RETURN_IF_ERROR(add_segment(rest.substr(0, slash)));
+      rest = slash == absl::string_view::npos ? "" : rest.substr(slash);
+    }
+    if (!rest.empty() && (!absl::ConsumePrefix(&rest, "/") || rest.empty())) {
+      return InvalidPathTemplate(path_template, "invalid separator");
+    }
+  }
+  return parsed;
+}
+
+bool PathTemplate::Match(absl::string_view path,
+                         std::vector<Binding>* bindings) const {
+  if (!absl::ConsumePrefix(&path, "/")) {
+    return false;
+  }
+  if (!verb_.empty()) {
+    if (!absl::ConsumeSuffix(&path, absl::StrCat(":", verb_))) {
+      return false;
+    }
+  } else if (path.rfind(':') != absl::string_view::npos &&
+             (path.rfind('/') == absl::string_view::npos ||
+              path.rfind(':') > path.rfind('/'))) {
+    // The path calls a custom method, which this template does not have.
+    return false;
+  }
+  std::vector<absl::string_view> parts = absl::StrSplit(path, '/');
+
+  // A double wildcard matches the parts which the other segments do not.
+  const int num_segments = segments_.size();
+  const int num_parts = parts.size();
+  int num_extra_parts = num_parts - num_segments;
+  std::vector<int> starts;
+  int part = 0;
+  for (const Segment& segment : segments_) {
+    starts.push_back(part);
+    if (segment.double_wildcard) {
+      if (num_extra_parts < -1) {
+        return false;
+      }
+      part += num_extra_parts + 1;
+      num_extra_parts = -1;
+      continue;
+    }
+    if (part >= num_parts || parts[part].empty() ||
+        (!segment.wildcard && parts[part] != segment.literal)) {
+      return false;
+    }
+    ++part;
+  }
+  starts.push_back(part);
+  if (part != num_parts) {
+    return false;
+  }
+
+  bindings->clear();
+  for (const Variable& variable : variables_) {
+    std::vector<std::string> values;
+    for (int i = starts[variable.begin]; i < starts[variable.end]; ++i) {
+      values.push_back(Unescape(parts[i]));
+    }
+    bindings->emplace_back(variable.field_path, absl::StrJoin(values, "/"));
+  }
+  return true;
+}
+
+absl::Status AppendHttpBindings(const std::string& selector,
+                                const google::api::HttpRule& rule,
+                                std::vector<HttpBinding>* bindings) {
+  std::string http_method;
+  std::string path;
+  switch (rule.pattern_case()) {
+    case google::api::HttpRule::kGet:
+      http_method = "GET";
+      path = rule.get();
+      break;
+    case google::api::HttpRule::kPut:
+      http_method = "PUT";
+      path = rule.put();
+      break;
+    case google::api::HttpRule::kPost:
+      http_method = "POST";
+      path = rule.post();
+      break;
+    case google::api::HttpRule::kDelete:
+      http_method = "DELETE";
+      path = rule.delete_();
+      break;
+    case google::api::HttpRule::kPatch:
+      http_method = "PATCH";
+      path = rule.patch();
+      break;
+    case google::api::HttpRule::kCustom:
+      http_method = absl::AsciiStrToUpper(rule.custom().kind());
+      path = rule.custom().path();
+      break;
+    default:
+      return absl::InvalidArgumentError(
+          absl::StrCat("HTTP rule for ", selector, " has no pattern"));
+  }
+  ZETASQL_ASSIGN_OR_RETURN(PathTemplate path_template,
+                   PathTemplate::Parse(path));
+  bindings->push_back({selector, std::move(http_method),
+                       std::move(path_template), rule.body()});
+  for (const google::api::HttpRule& additional : rule.additional_bindings()) {
+    ZETASQL_RETURN_IF_ERROR(AppendHttpBindings(selector, additional, bindings));
+  }
+  return absl::OkStatus();
+}
+
+namespace {
+
+// Sets the field `key` of `rule` to `value`.
+absl::Status SetRuleField(absl::string_view key, const std::string& value,
+                          google::api::HttpRule* rule) {
+  if (key == "selector") {
+    rule->set_selector(value);
+  } else if (key == "get") {
+    rule->set_get(value);
+  } else if (key == "put") {
+    rule->set_put(value);
+  } else if (key == "post") {
+    rule->set_post(value);
+  } else if (key == "delete") {
+    rule->set_delete_(value);
+  } else if (key == "patch") {
+    rule->set_patch(value);
+  } else if (key == "body") {
+    rule->set_body(value);
+  } else if (key == "response_body") {
+    rule->set_response_body(value);
+  } else {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Unsupported HTTP rule field ", key));
+  }
+  return absl::OkStatus();
+}
+
+// Returns `value` without its quotes, if it is quoted.
+std::string Unquote(absl::string_view value) {
+  if (value.size() >= 2 && (value.front() == '\'' || value.front() == '"') &&
+      value.back() == value.front()) {
+    value = value.substr(1, value.size() - 2);
+  }
+  return std::string(value);
+}
+
+}  // namespace
+
+zetasql_base::StatusOr<std::vector<google::api::HttpRule>> ParseHttpRulesYaml(
+    absl::string_view yaml) {
+  std::vector<google::api::HttpRule> rules;
+
+  // Indentation of the keys of the rule being parsed, and of the keys of its
+  // additional binding being parsed, or -1 if there are none.
+  int rule_indent = -1;
+  int binding_indent = -1;
+  bool in_rules = false;
+  bool in_additional_bindings = false;
+  for (absl::string_view line : absl::StrSplit(yaml, '\n')) {
+    absl::string_view content = absl::StripAsciiWhitespace(line);
+    if (content.empty() || absl::StartsWith(content, "#")) {
+      continue;
+    }
+    int indent = line.find_first_not_of(' ');
+    const bool item = absl::ConsumePrefix(&content, "- ");
+    if (item) {
+      indent = line.find_first_not_of(" -", indent);
+    }
+    std::pair<absl::string_view, absl::string_view> key_value =
+        absl::StrSplit(content, absl::MaxSplits(':', 1));
+    const absl::string_view key = absl::StripAsciiWhitespace(key_value.first);
+    const std::string value =
+        Unquote(absl::StripAsciiWhitespace(key_value.second));
+
+    if (item && key == "selector") {
+      if (!in_rules) {
+        return absl::InvalidArgumentError("HTTP rule outside of http.rules");
+      }
+      rules.emplace_back();
+      rule_indent = indent;
+      binding_indent = -1;
+      in_additional_bindings = false;
+    } else if (rule_indent < 0 || indent < rule_indent) {
+      // Keys outside of the rules, such as the service type.
+      in_rules = key == "rules" || (in_rules && indent > 0);
+      rule_indent = -1;
+      continue;
+    }
+
+    if (indent == rule_indent) {
+      in_additional_bindings = key == "additional_bindings";
+      if (!in_additional_bindings) {
+        ZETASQL_RETURN_IF_ERROR(SetRuleField(key, value, &rules.back()));
+      }
+      continue;
+    }
+    if (!in_additional_bindings) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Unexpected indentation in HTTP rules: ", line));
+    }
+    if (item) {
+      rules.back().add_additional_bindings();
+      binding_indent = indent;
+    }
+    if (binding_indent < 0 || indent != binding_indent) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Unexpected indentation in HTTP rules: ", line));
+    }
+    ZETASQL_RETURN_IF_ERROR(SetRuleField(
+        key, value,
+        rules.back().mutable_additional_bindings(
+            rules.back().additional_bindings_size() - 1)));
+  }
+  return rules;
+}
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
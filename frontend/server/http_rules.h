@@ -0,0 +1,117 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_HTTP_RULES_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_HTTP_RULES_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "google/api/http.pb.h"
+#include "absl/strings/string_view.h"
+#include "absl/status/status.h"
+#include "zetasql/base/statusor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+// A URL path template of an HTTP rule, such as
+//     /v1/{database=projects/*/instances/*/databases/*}/ddl
+//
+// See google/api/http.proto for the syntax of templates.
+class PathTemplate {
+ public:
+  // The value of a field of the request bound by a path, as a dot-separated
+  // field path and the unescaped value.
+  using Binding = std::pair<std::string, std::string>;
+
+  // Parses `path_template`, or returns INVALID_ARGUMENT if it is malformed.
+  static zetasql_base::StatusOr<PathTemplate> Parse(
+      absl::string_view path_template);
+
+  // Returns true if `path` (without query parameters) matches the template, and
+  // if so sets `bindings` to the values of the variables of the template.
+  bool Match(absl::string_view path, std::vector<Binding>* bindings) const;
+
+ private:
+  // A segment of the template, which matches one segment of a path if it is a
+  // literal or "*", or any number of segments if it is "**".
+  struct Segment {
+    std::string literal;
+    bool wildcard = false;
+    bool double_wildcard = false;
+  };
+
+  // A variable, whose value is the path segments matched by the segments of
+  // the template in [begin, end).
+  struct Variable {
+    std::string field_path;
+    int begin;
+    int end;
+  };
+
+  PathTemplate() = default;
+
+  std::vector<Segment> segments_;
+  std::vector<Variable> variables_;
+  std::string verb_;
+};
+
+// An HTTP method and path template bound to an RPC method.
+struct HttpBinding {
+  // The full name of the RPC method, e.g.
+  // google.spanner.admin.database.v1.DatabaseAdmin.UpdateDatabaseDdl.
+  std::string selector;
+
+  // The HTTP method, e.g. "GET".
+  std::string http_method;
+
+  PathTemplate path;
+
+  // The field of the request set to the body of the HTTP request, "*" for the
+  // whole request, or empty if the HTTP request has no body.
+  std::string body;
+};
+
+// Appends the bindings of `rule` and of its additional bindings to `bindings`.
+absl::Status AppendHttpBindings(const std::string& selector,
+                                const google::api::HttpRule& rule,
+                                std::vector<HttpBinding>* bindings);
+
+// Parses the HTTP rules of a service configuration in YAML, such as the
+// configuration files of the REST gateway:
+//
+//     http:
+//       rules:
+//       - selector: google.longrunning.Operations.GetOperation
+//         get: '/v1/{name=projects/*/instances/*/operations/*}'
+//         additional_bindings:
+//         - get: '/v1/{name=projects/*/instances/*/databases/*/operations/*}'
+//
+// Only the subset of YAML used by these files is supported: block mappings and
+// sequences of scalars, with comments on separate lines.
+zetasql_base::StatusOr<std::vector<google::api::HttpRule>> ParseHttpRulesYaml(
+    absl::string_view yaml);
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_HTTP_RULES_H_
@@ -0,0 +1,173 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "frontend/server/http_rules.h"
+
+#include <string>
+#include <vector>
+
+#include "google/api/http.pb.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "tests/common/proto_matchers.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+namespace {
+
+using testing::ElementsAre;
+using testing::IsEmpty;
+using testing::Pair;
+using zetasql_base::testing::StatusIs;
+
+TEST(PathTemplateTest, MatchesVariablesAndLiterals) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      PathTemplate path_template,
+      PathTemplate::Parse("/v1/{database=projects/*/instances/*/databases/*}"
+                          "/ddl"));
+  std::vector<PathTemplate::Binding> bindings;
+  EXPECT_TRUE(path_template.Match("/v1/projects/p/instances/i/databases/d/ddl",
+                                  &bindings));
+  EXPECT_THAT(bindings, ElementsAre(Pair(
+                            "database", "projects/p/instances/i/databases/d")));
+
+  EXPECT_FALSE(path_template.Match("/v1/projects/p/instances/i/databases/d",
+                                   &bindings));
+  EXPECT_FALSE(path_template.Match(
+      "/v1/projects/p/instances/i/databases/d/ddl/x", &bindings));
+  EXPECT_FALSE(path_template.Match("/v1/projects/p/instances//databases/d/ddl",
+                                   &bindings));
+}
+
+TEST(PathTemplateTest, MatchesVerbs) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      PathTemplate path_template,
+      PathTemplate::Parse("/v1/{name=projects/*/instances/*/operations/*}"
+                          ":cancel"));
+  std::vector<PathTemplate::Binding> bindings;
+  EXPECT_TRUE(path_template.Match(
+      "/v1/projects/p/instances/i/operations/o:cancel", &bindings));
+  EXPECT_THAT(bindings,
+              ElementsAre(Pair("name", "projects/p/instances/i/operations/o")));
+  EXPECT_FALSE(path_template.Match("/v1/projects/p/instances/i/operations/o",
+                                   &bindings));
+
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      PathTemplate no_verb,
+      PathTemplate::Parse("/v1/{name=projects/*/instances/*/operations/*}"));
+  EXPECT_FALSE(no_verb.Match("/v1/projects/p/instances/i/operations/o:cancel",
+                             &bindings));
+}
+
+TEST(PathTemplateTest, MatchesNestedFieldsAndDoubleWildcards) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(PathTemplate path_template,
+                       PathTemplate::Parse("/v1/{instance.name=projects/*/"
+                                           "instances/*}/{rest=**}"));
+  std::vector<PathTemplate::Binding> bindings;
+  EXPECT_TRUE(
+      path_template.Match("/v1/projects/p/instances/i/a/b%2Fc", &bindings));
+  EXPECT_THAT(bindings,
+              ElementsAre(Pair("instance.name", "projects/p/instances/i"),
+                          Pair("rest", "a/b/c")));
+  EXPECT_TRUE(path_template.Match("/v1/projects/p/instances/i", &bindings));
+  EXPECT_THAT(bindings,
+              ElementsAre(Pair("instance.name", "projects/p/instances/i"),
+                          Pair("rest", "")));
+}
+
+TEST(PathTemplateTest, RejectsMalformedTemplates) {
+  EXPECT_THAT(PathTemplate::Parse("v1/projects"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(PathTemplate::Parse("/v1/{name=projects/*"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(PathTemplate::Parse("/v1//projects"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(PathTemplate::Parse("/v1/**/**"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(HttpRulesTest, ParsesRulesOfServiceConfiguration) {
+  ZETASQL_ASSERT_OK_AND_ASSIGN(std::vector<google::api::HttpRule> rules,
+                       ParseHttpRulesYaml(R"(
+# A comment.
+type: google.api.Service
+config_version: 3
+
+http:
+  rules:
+  - selector: google.longrunning.Operations.GetOperation
+    get: '/v1/{name=projects/*/instances/*/databases/*/operations/*}'
+    additional_bindings:
+    - get: '/v1/{name=projects/*/instances/*/operations/*}'
+  - selector: google.spanner.admin.database.v1.DatabaseAdmin.UpdateDatabaseDdl
+    patch: '/v1/{database=projects/*/instances/*/databases/*}/ddl'
+    body: '*'
+    additional_bindings:
+    - post: '/v1/{database=projects/*/instances/*/databases/*}/ddl'
+      body: '*'
+)"));
+  ASSERT_EQ(rules.size(), 2);
+  EXPECT_THAT(rules[0], test::EqualsProto(R"(
+                selector: "google.longrunning.Operations.GetOperation"
+                get: "/v1/{name=projects/*/instances/*/databases/*/operations/*}"
+                additional_bindings {
+                  get: "/v1/{name=projects/*/instances/*/operations/*}"
+                }
+              )"));
+  EXPECT_THAT(rules[1], test::EqualsProto(R"(
+                selector: "google.spanner.admin.database.v1.DatabaseAdmin.UpdateDatabaseDdl"
+                patch: "/v1/{database=projects/*/instances/*/databases/*}/ddl"
+                body: "*"
+                additional_bindings {
+                  post: "/v1/{database=projects/*/instances/*/databases/*}/ddl"
+                  body: "*"
+                }
+              )"));
+
+  std::vector<HttpBinding> bindings;
+  ZETASQL_ASSERT_OK(
+      AppendHttpBindings(rules[1].selector(), rules[1], &bindings));
+  ASSERT_EQ(bindings.size(), 2);
+  EXPECT_EQ(bindings[0].http_method, "PATCH");
+  EXPECT_EQ(bindings[1].http_method, "POST");
+  EXPECT_EQ(bindings[1].body, "*");
+}
+
+TEST(HttpRulesTest, ParsesEmptyConfiguration) {
+  EXPECT_THAT(ParseHttpRulesYaml("type: google.api.Service\n"),
+              zetasql_base::testing::IsOkAndHolds(IsEmpty()));
+}
+
+TEST(HttpRulesTest, RejectsUnsupportedFields) {
+  EXPECT_THAT(ParseHttpRulesYaml(R"(
+http:
+  rules:
+  - selector: google.longrunning.Operations.GetOperation
+    unknown: '/v1/{name=projects/*/instances/*/operations/*}'
+)"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
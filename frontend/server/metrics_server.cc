@@ -0,0 +1,181 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "frontend/server/metrics_server.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+#include "zetasql/base/logging.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "common/metrics.h"
+#include "common/profiler.h"
+#include "common/trace.h"
+#include "frontend/server/http_listener.h"
+#include "zetasql/base/statusor.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+namespace {
+
+// Interval at which the serving thread checks whether it should stop.
+constexpr int kPollIntervalMs = 100;
+
+// Maximum size of a request, which only needs to hold the request line.
+constexpr int kMaxRequestSize = 8192;
+
+// Returns an HTTP/1.0 response with the given status line and body.
+std::string HttpResponse(absl::string_view status, absl::string_view type,
+                         absl::string_view body) {
+  return absl::StrCat("HTTP/1.0 ", status, "\r\nContent-Type: ", type,
+                      "\r\nContent-Length: ", body.size(),
+                      "\r\nConnection: close\r\n\r\n", body);
+}
+
+// Duration of CPU profiles when the request does not specify ?seconds=N, and
+// the longest duration allowed, since the server is blocked while profiling.
+constexpr int kDefaultCpuProfileSeconds = 30;
+constexpr int kMaxCpuProfileSeconds = 300;
+
+// Returns the value of the `seconds` parameter of `request`, a request for
+// /debug/pprof/profile, or the default duration if it has none.
+absl::Duration CpuProfileDuration(absl::string_view request) {
+  absl::string_view target = request.substr(0, request.find(' ', 4));
+  absl::string_view::size_type query = target.find('?');
+  int seconds = kDefaultCpuProfileSeconds;
+  if (query != absl::string_view::npos) {
+    for (absl::string_view param :
+         absl::StrSplit(target.substr(query + 1), '&')) {
+      if (absl::ConsumePrefix(&param, "seconds=") &&
+          (!absl::SimpleAtoi(param, &seconds) || seconds <= 0)) {
+        seconds = kDefaultCpuProfileSeconds;
+      }
+    }
+  }
+  return absl::Seconds(std::min(seconds, kMaxCpuProfileSeconds));
+}
+
+// Returns the response for a profile, or the error that prevented it.
+std::string ProfileResponse(
+    const zetasql_base::StatusOr<std::string>& profile) {
+  if (!profile.ok()) {
+    return HttpResponse(
+        profile.status().code() == absl::StatusCode::kUnimplemented
+            ? "501 Not Implemented"
+            : "503 Service Unavailable",
+        "text/plain", absl::StrCat(profile.status().message(), "\n"));
+  }
+  return HttpResponse("200 OK", "application/octet-stream", profile.value());
+}
+
+}  // namespace
+
+std::unique_ptr<MetricsServer> MetricsServer::Create(
+    const std::string& host_port) {
+  int bound_port;
+  const int listening_socket = ListenOnHostPort(host_port, &bound_port);
+  if (listening_socket < 0) {
+    return nullptr;
+  }
+
+  metrics::SetEnabled(true);
+  return std::unique_ptr<MetricsServer>(
+      new MetricsServer(listening_socket, bound_port));
+}
+
+MetricsServer::MetricsServer(int socket, int port)
+    : socket_(socket), port_(port), thread_([this]() { ServeLoop(); }) {}
+
+MetricsServer::~MetricsServer() {
+  stopping_ = true;
+  thread_.join();
+  close(socket_);
+}
+
+void MetricsServer::ServeLoop() {
+  while (!stopping_) {
+    pollfd listening = {socket_, POLLIN, 0};
+    if (poll(&listening, 1, kPollIntervalMs) <= 0) {
+      continue;
+    }
+    int connection = accept(socket_, nullptr, nullptr);
+    if (connection < 0) {
+      continue;
+    }
+    HandleConnection(connection);
+    close(connection);
+  }
+}
+
+void MetricsServer::HandleConnection(int connection) {
+  // Read until the end of the request headers. Requests have no body.
+  std::string request;
+  char buffer[1024];
+  while (request.find("\r\n\r\n") == std::string::npos &&
+         request.size() < kMaxRequestSize) {
+    pollfd readable = {connection, POLLIN, 0};
+    if (poll(&readable, 1, kPollIntervalMs * 10) <= 0) {
+      return;
+    }
+    ssize_t received = recv(connection, buffer, sizeof(buffer), 0);
+    if (received <= 0) {
+      break;
+    }
+    request.append(buffer, received);
+  }
+
+  if (absl::StartsWith(request, "GET /metrics ") ||
+      absl::StartsWith(request, "GET /metrics?")) {
+    WriteAll(connection,
+             HttpResponse("200 OK", "text/plain; version=0.0.4; charset=utf-8",
+                          metrics::ExportText()));
+  } else if (absl::StartsWith(request, "GET /traces ") ||
+             absl::StartsWith(request, "GET /traces?")) {
+    WriteAll(connection,
+             HttpResponse("200 OK", "text/plain; charset=utf-8",
+                          trace::ExportText()));
+  } else if (absl::StartsWith(request, "GET /debug/pprof/heap ") ||
+             absl::StartsWith(request, "GET /debug/pprof/heap?")) {
+    WriteAll(connection, ProfileResponse(profiler::HeapProfile()));
+  } else if (absl::StartsWith(request, "GET /debug/pprof/profile ") ||
+             absl::StartsWith(request, "GET /debug/pprof/profile?")) {
+    absl::Duration duration = CpuProfileDuration(request);
+    WriteAll(connection, ProfileResponse(profiler::CpuProfile(duration)));
+  } else {
+    WriteAll(connection,
+             HttpResponse("404 Not Found", "text/plain", "Not found.\n"));
+  }
+}
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
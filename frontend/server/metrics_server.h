@@ -0,0 +1,85 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_METRICS_SERVER_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_METRICS_SERVER_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+// MetricsServer serves the metrics of the emulator (see common/metrics.h) over
+// HTTP, in the Prometheus text format, so that they can be scraped while the
+// emulator is under load.
+//
+// It is a minimal HTTP/1.0 server: a single thread accepts connections one at
+// a time and answers GET requests for /metrics, and for /traces with the recent
+// request traces (see common/trace.h). Scrapes are rare and cheap, so there is
+// no need for concurrency. When the emulator is built with tcmalloc, pprof heap
+// and CPU profiles are served at /debug/pprof/heap and
+// /debug/pprof/profile?seconds=N (see common/profiler.h); other requests wait
+// while a CPU profile is collected. Creating the server enables the collection of
+// metrics.
+class MetricsServer {
+ public:
+  // Returns a server listening on `host_port` (e.g. "localhost:9090", or
+  // "localhost:0" to pick any free port), or nullptr if it could not listen.
+  static std::unique_ptr<MetricsServer> Create(const std::string& host_port);
+
+  // Stops serving and closes the listening socket.
+  ~MetricsServer();
+
+  MetricsServer(const MetricsServer&) = delete;
+  MetricsServer& operator=(const MetricsServer&) = delete;
+
+  // Returns the port on which the server listens.
+  int port() const { return port_; }
+
+ private:
+  MetricsServer(int socket, int port);
+
+  // Body of the serving thread.
+  void ServeLoop();
+
+  // Reads a single request from `connection` and writes the response.
+  void HandleConnection(int connection);
+
+  // The listening socket.
+  const int socket_;
+
+  // The port to which socket_ is bound.
+  const int port_;
+
+  // Set by the destructor to stop the serving thread.
+  std::atomic<bool> stopping_{false};
+
+  // The serving thread.
+  std::thread thread_;
+};
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_METRICS_SERVER_H_
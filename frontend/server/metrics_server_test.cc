@@ -0,0 +1,125 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "frontend/server/metrics_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "common/metrics.h"
+#include "common/profiler.h"
+#include "common/trace.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+namespace {
+
+using testing::HasSubstr;
+using testing::StartsWith;
+
+// Sends `request` to the server listening on `port` of the loopback interface
+// and returns the whole response.
+std::string Fetch(int port, const std::string& request) {
+  int connection = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  EXPECT_EQ(connect(connection, reinterpret_cast<sockaddr*>(&address),
+                    sizeof(address)),
+            0);
+  send(connection, request.data(), request.size(), 0);
+  std::string response;
+  char buffer[1024];
+  ssize_t received;
+  while ((received = recv(connection, buffer, sizeof(buffer), 0)) > 0) {
+    response.append(buffer, received);
+  }
+  close(connection);
+  return response;
+}
+
+TEST(MetricsServerTest, ServesMetricsInPrometheusTextFormat) {
+  std::unique_ptr<MetricsServer> server =
+      MetricsServer::Create("127.0.0.1:0");
+  ASSERT_NE(server, nullptr);
+  EXPECT_TRUE(metrics::Enabled());
+  metrics::GetCounter("test_served_total", "Served counter.")->Increment();
+
+  std::string response = Fetch(
+      server->port(), "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+  EXPECT_THAT(response, StartsWith("HTTP/1.0 200 OK\r\n"));
+  EXPECT_THAT(response, HasSubstr("\r\n\r\n# HELP test_served_total"));
+  EXPECT_THAT(response, HasSubstr("test_served_total 1\n"));
+}
+
+TEST(MetricsServerTest, ServesRecentTraces) {
+  std::unique_ptr<MetricsServer> server =
+      MetricsServer::Create("127.0.0.1:0");
+  ASSERT_NE(server, nullptr);
+  trace::SetSamplingRate(1);
+  { trace::ScopedTrace trace("Test.Served", trace::TraceContext()); }
+  trace::SetSamplingRate(0);
+
+  std::string response = Fetch(server->port(), "GET /traces HTTP/1.1\r\n\r\n");
+  EXPECT_THAT(response, StartsWith("HTTP/1.0 200 OK\r\n"));
+  EXPECT_THAT(response, HasSubstr(" Test.Served\n  Test.Served +0 "));
+}
+
+TEST(MetricsServerTest, ServesHeapProfilesWhenBuiltWithTcmalloc) {
+  std::unique_ptr<MetricsServer> server =
+      MetricsServer::Create("127.0.0.1:0");
+  ASSERT_NE(server, nullptr);
+  std::string response =
+      Fetch(server->port(), "GET /debug/pprof/heap HTTP/1.1\r\n\r\n");
+  if (profiler::Enabled()) {
+    EXPECT_THAT(response, StartsWith("HTTP/1.0 200 OK\r\n"));
+  } else {
+    EXPECT_THAT(response, StartsWith("HTTP/1.0 501 Not Implemented\r\n"));
+  }
+}
+
+TEST(MetricsServerTest, RejectsOtherPaths) {
+  std::unique_ptr<MetricsServer> server =
+      MetricsServer::Create("127.0.0.1:0");
+  ASSERT_NE(server, nullptr);
+  EXPECT_THAT(Fetch(server->port(), "GET / HTTP/1.1\r\n\r\n"),
+              StartsWith("HTTP/1.0 404 Not Found\r\n"));
+}
+
+TEST(MetricsServerTest, FailsOnInvalidAddress) {
+  EXPECT_EQ(MetricsServer::Create("no-port"), nullptr);
+}
+
+}  // namespace
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,117 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "frontend/server/read_deferral.h"
+
+#include <cstdint>
+#include <string>
+
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/wire_format_lite.h"
+#include "google/spanner/v1/transaction.pb.h"
+#include "grpcpp/impl/codegen/proto_buffer_reader.h"
+#include "grpcpp/support/byte_buffer.h"
+#include "zetasql/base/statusor.h"
+#include "absl/time/time.h"
+#include "frontend/converters/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+namespace {
+
+namespace spanner_api = ::google::spanner::v1;
+
+using google::protobuf::internal::WireFormatLite;
+
+// Field number of `transaction` in both ReadRequest and ExecuteSqlRequest.
+constexpr int kTransactionFieldNumber = 2;
+
+// Returns true if `method_name` of the Spanner service takes a ReadRequest or
+// an ExecuteSqlRequest.
+bool IsReadMethod(const std::string& method_name) {
+  return method_name == "Read" || method_name == "StreamingRead" ||
+         method_name == "ExecuteSql" || method_name == "ExecuteStreamingSql";
+}
+
+// Reads the serialized transaction selector from `request` into `selector`.
+// Returns false if the request has none or is malformed.
+bool ReadTransactionSelector(grpc::ByteBuffer* request,
+                             std::string* selector) {
+  grpc::ProtoBufferReader reader(request);
+  if (!reader.status().ok()) {
+    return false;
+  }
+  google::protobuf::io::CodedInputStream input(&reader);
+  while (true) {
+    const uint32_t tag = input.ReadTag();
+    const int field_number = WireFormatLite::GetTagFieldNumber(tag);
+    if (tag == 0 || field_number > kTransactionFieldNumber) {
+      // Fields are serialized in field number order, so the selector is not
+      // looked for after the fields which follow it.
+      return false;
+    }
+    if (field_number == kTransactionFieldNumber &&
+        WireFormatLite::GetTagWireType(tag) ==
+            WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      uint32_t size;
+      return input.ReadVarint32(&size) && input.ReadString(selector, size);
+    }
+    if (!WireFormatLite::SkipField(&input, tag)) {
+      return false;
+    }
+  }
+}
+
+}  // namespace
+
+absl::Time EarliestServingTime(const std::string& service_name,
+                               const std::string& method_name,
+                               grpc::ByteBuffer* request) {
+  if (service_name != "Spanner" || !IsReadMethod(method_name)) {
+    return absl::InfinitePast();
+  }
+  std::string serialized_selector;
+  spanner_api::TransactionSelector selector;
+  if (!ReadTransactionSelector(request, &serialized_selector) ||
+      !selector.ParseFromString(serialized_selector)) {
+    return absl::InfinitePast();
+  }
+
+  const spanner_api::TransactionOptions& options =
+      selector.has_single_use() ? selector.single_use() : selector.begin();
+  if (!options.has_read_only()) {
+    return absl::InfinitePast();
+  }
+  const spanner_api::TransactionOptions::ReadOnly& read_only =
+      options.read_only();
+  zetasql_base::StatusOr<absl::Time> read_time = absl::InfinitePast();
+  if (read_only.has_read_timestamp()) {
+    read_time = TimestampFromProto(read_only.read_timestamp());
+  } else if (read_only.has_min_read_timestamp()) {
+    read_time = TimestampFromProto(read_only.min_read_timestamp());
+  }
+  // Invalid timestamps are rejected by the handler.
+  return read_time.ok() ? read_time.value() : absl::InfinitePast();
+}
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
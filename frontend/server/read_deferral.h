@@ -0,0 +1,51 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_READ_DEFERRAL_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_READ_DEFERRAL_H_
+
+#include <string>
+
+#include "grpcpp/support/byte_buffer.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+// Returns the time before which the read or query in `request`, a serialized
+// request to the method `method_name` of the service `service_name`, cannot be
+// served, or absl::InfinitePast() if it can be served right away.
+//
+// Reads of single-use or newly begun read-only transactions at a read_timestamp
+// or min_read_timestamp in the future wait in the lock manager until that time
+// (see LockManager::WaitForSafeRead). The AsyncDispatcher uses this to hold
+// such calls on a timer instead of in a handler thread. Only the request's
+// transaction selector is parsed; the other fields are skipped. Requests
+// which use an existing transaction, or which cannot be parsed, are served
+// right away (and wait in the handler if they need to).
+absl::Time EarliestServingTime(const std::string& service_name,
+                               const std::string& method_name,
+                               grpc::ByteBuffer* request);
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_READ_DEFERRAL_H_
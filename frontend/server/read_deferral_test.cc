@@ -0,0 +1,124 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "frontend/server/read_deferral.h"
+
+#include <string>
+
+#include "google/protobuf/timestamp.pb.h"
+#include "google/spanner/v1/spanner.pb.h"
+#include "gtest/gtest.h"
+#include "grpcpp/impl/codegen/proto_utils.h"
+#include "grpcpp/support/byte_buffer.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+namespace {
+
+namespace spanner_api = ::google::spanner::v1;
+
+// A read timestamp in the future.
+const absl::Time kReadTime = absl::FromUnixSeconds(4102444800);
+
+// Sets `proto` to `time`, which must be a whole number of seconds.
+void SetTimestamp(absl::Time time, google::protobuf::Timestamp* proto) {
+  proto->set_seconds(absl::ToUnixSeconds(time));
+}
+
+// Returns `request` serialized as received by the dispatcher.
+template <typename T>
+grpc::ByteBuffer Serialize(const T& request) {
+  grpc::ByteBuffer buffer;
+  bool own_buffer;
+  EXPECT_TRUE(
+      grpc::SerializationTraits<T>::Serialize(request, &buffer, &own_buffer)
+          .ok());
+  return buffer;
+}
+
+TEST(EarliestServingTimeTest, ReturnsReadTimestampOfSingleUseReads) {
+  spanner_api::ReadRequest request;
+  request.set_session("session");
+  request.set_table("T");
+  SetTimestamp(kReadTime, request.mutable_transaction()
+                              ->mutable_single_use()
+                              ->mutable_read_only()
+                              ->mutable_read_timestamp());
+  grpc::ByteBuffer buffer = Serialize(request);
+  EXPECT_EQ(EarliestServingTime("Spanner", "StreamingRead", &buffer),
+            kReadTime);
+  EXPECT_EQ(EarliestServingTime("Spanner", "Read", &buffer), kReadTime);
+
+  // The request can still be parsed by the handler.
+  spanner_api::ReadRequest parsed;
+  ASSERT_TRUE(grpc::SerializationTraits<spanner_api::ReadRequest>::Deserialize(
+                  &buffer, &parsed)
+                  .ok());
+  EXPECT_EQ(parsed.table(), "T");
+}
+
+TEST(EarliestServingTimeTest, ReturnsMinReadTimestampOfBegunQueries) {
+  spanner_api::ExecuteSqlRequest request;
+  request.set_session("session");
+  request.set_sql("SELECT 1");
+  SetTimestamp(kReadTime, request.mutable_transaction()
+                              ->mutable_begin()
+                              ->mutable_read_only()
+                              ->mutable_min_read_timestamp());
+  grpc::ByteBuffer buffer = Serialize(request);
+  EXPECT_EQ(EarliestServingTime("Spanner", "ExecuteStreamingSql", &buffer),
+            kReadTime);
+}
+
+TEST(EarliestServingTimeTest, ServesOtherRequestsRightAway) {
+  spanner_api::ExecuteSqlRequest strong;
+  strong.mutable_transaction()
+      ->mutable_single_use()
+      ->mutable_read_only()
+      ->set_strong(true);
+  grpc::ByteBuffer buffer = Serialize(strong);
+  EXPECT_EQ(EarliestServingTime("Spanner", "ExecuteSql", &buffer),
+            absl::InfinitePast());
+
+  spanner_api::ExecuteSqlRequest existing;
+  existing.mutable_transaction()->set_id("txn");
+  buffer = Serialize(existing);
+  EXPECT_EQ(EarliestServingTime("Spanner", "ExecuteSql", &buffer),
+            absl::InfinitePast());
+
+  spanner_api::ReadRequest request;
+  SetTimestamp(kReadTime, request.mutable_transaction()
+                              ->mutable_single_use()
+                              ->mutable_read_only()
+                              ->mutable_read_timestamp());
+  buffer = Serialize(request);
+  EXPECT_EQ(EarliestServingTime("Spanner", "Commit", &buffer),
+            absl::InfinitePast());
+  EXPECT_EQ(EarliestServingTime("DatabaseAdmin", "Read", &buffer),
+            absl::InfinitePast());
+}
+
+}  // namespace
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
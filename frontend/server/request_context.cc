@@ -16,7 +16,15 @@
 
 #include "frontend/server/request_context.h"
 
+#include <chrono>  // NOLINT
+#include <functional>
+#include <utility>
+
 #include "zetasql/base/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "common/constants.h"
+#include "common/trace.h"
 #include "frontend/common/uris.h"
 #include "frontend/entities/instance.h"
 #include "zetasql/base/status_macros.h"
@@ -26,6 +34,63 @@ namespace spanner {
 namespace emulator {
 namespace frontend {
 
+namespace {
+
+// Returns the deadline of the call of `grpc`, if any.
+absl::Time CallDeadline(const grpc::ServerContext* grpc) {
+  if (grpc == nullptr ||
+      grpc->deadline() == std::chrono::system_clock::time_point::max()) {
+    return absl::InfiniteFuture();
+  }
+  return absl::FromChrono(grpc->deadline());
+}
+
+}  // namespace
+
+RequestContext::RequestContext(ServerEnv* env, grpc::ServerContext* grpc)
+    : RequestContext(env, grpc, [grpc]() {
+        return grpc != nullptr && grpc->IsCancelled();
+      }) {}
+
+RequestContext::RequestContext(ServerEnv* env, grpc::ServerContext* grpc,
+                               std::function<bool()> is_cancelled)
+    : env_(env),
+      grpc_(grpc),
+      cancellation_(CallDeadline(grpc), std::move(is_cancelled)) {}
+
+trace::TraceContext RequestContext::trace_context() const {
+  trace::TraceContext context;
+  if (grpc_ == nullptr) {
+    return context;
+  }
+  const auto& metadata = grpc_->client_metadata();
+  auto it = metadata.find("traceparent");
+  if (it != metadata.end() &&
+      trace::ParseTraceParent(
+          absl::string_view(it->second.data(), it->second.size()), &context)) {
+    return context;
+  }
+  it = metadata.find("x-cloud-trace-context");
+  if (it != metadata.end()) {
+    trace::ParseCloudTraceContext(
+        absl::string_view(it->second.data(), it->second.size()), &context);
+  }
+  return context;
+}
+
+void MaybeAddTrailingMetadata(const absl::Status& status, RequestContext* ctx) {
+  if (!status.ok()) {
+    // Check for ResourceInfo within the returned status and append it as extra
+    // trailing metadata.
+    auto payload = status.GetPayload(kResourceInfoType);
+    if (payload.has_value()) {
+      std::string serialized_info(payload.value());
+      ctx->grpc()->AddTrailingMetadata(kResourceInfoBinaryHeader,
+                                       serialized_info);
+    }
+  }
+}
+
 zetasql_base::StatusOr<std::shared_ptr<Instance>> GetInstance(
     RequestContext* ctx, const std::string& instance_uri) {
   absl::string_view project_id, instance_id;
@@ -48,6 +113,7 @@ zetasql_base::StatusOr<std::shared_ptr<Database>> GetDatabase(
 
 zetasql_base::StatusOr<std::shared_ptr<Session>> GetSession(
     RequestContext* ctx, const std::string& session_uri) {
+  trace::ScopedSpan span("GetSession");
   // The ParseSessionUri and GetDatabase calls are needed for verification that
   // the session URI and the database for this session is valid, even though
   // they are not used after that.
@@ -17,8 +17,13 @@
 #ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_REQUEST_CONTEXT_H_
 #define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_REQUEST_CONTEXT_H_
 
+#include <functional>
+
 #include "grpcpp/server_context.h"
+#include "common/cancellation.h"
+#include "common/trace.h"
 #include "frontend/server/environment.h"
+#include "absl/status/status.h"
 
 namespace google {
 namespace spanner {
@@ -28,21 +33,44 @@ namespace frontend {
 // RequestContext encapsulates the state passed to a gRPC method handler.
 class RequestContext {
  public:
-  RequestContext(ServerEnv* env, grpc::ServerContext* grpc)
-      : env_(env), grpc_(grpc) {}
+  // Creates the context of a request which is abandoned once its deadline
+  // passes or gRPC reports it cancelled.
+  RequestContext(ServerEnv* env, grpc::ServerContext* grpc);
+
+  // Creates the context of a request which is abandoned once its deadline
+  // passes or `is_cancelled` returns true. Used by the asynchronous server,
+  // which may not poll gRPC for the cancellation of its calls.
+  RequestContext(ServerEnv* env, grpc::ServerContext* grpc,
+                 std::function<bool()> is_cancelled);
 
   // Accessors.
   ServerEnv* env() { return env_; }
   grpc::ServerContext* grpc() { return grpc_; }
 
+  // Returns the token telling work done for the request whether the request
+  // was abandoned, so that it stops early.
+  const CancellationToken* cancellation() const { return &cancellation_; }
+
+  // Returns the trace context propagated by the client in the "traceparent" or
+  // "x-cloud-trace-context" metadata of the request, if any.
+  trace::TraceContext trace_context() const;
+
  private:
   // Server environment shared by all requests.
   ServerEnv* env_;
 
   // gRPC context specific to a single request.
   grpc::ServerContext* grpc_;
+
+  // Cancellation of the request.
+  CancellationToken cancellation_;
 };
 
+// Adds the ResourceInfo attached to a failed `status` (if any) to the trailing
+// metadata of the call. The Java client library expects the ResourceInfo to be
+// added as additional trailing metadata.
+void MaybeAddTrailingMetadata(const absl::Status& status, RequestContext* ctx);
+
 // Checks if an instance exists. Returns the Instance entity or an error:
 //   InstanceNotFound if the instance is not found.
 zetasql_base::StatusOr<std::shared_ptr<Instance>> GetInstance(
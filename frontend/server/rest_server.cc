@@ -0,0 +1,670 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "frontend/server/rest_server.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "google/api/annotations.pb.h"
+#include "google/api/http.pb.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/message.h"
+#include "google/protobuf/util/json_util.h"
+#include "grpcpp/server_context.h"
+#include "zetasql/base/logging.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "frontend/server/http_listener.h"
+#include "frontend/server/request_context.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+namespace {
+
+// The HTTP rules of the REST gateway, which override the annotations of the
+// methods they select.
+constexpr const char* kHttpRulesYaml[] = {
+#include "frontend/server/http_rules_yaml.inc"
+};
+
+// The services served by the emulator.
+constexpr const char* kServiceNames[] = {
+    "google.longrunning.Operations",
+    "google.spanner.admin.database.v1.DatabaseAdmin",
+    "google.spanner.admin.instance.v1.InstanceAdmin",
+    "google.spanner.v1.Spanner",
+};
+
+// Interval at which serving threads check whether they should stop.
+constexpr int kPollIntervalMs = 100;
+
+// Time after which a connection without requests is closed.
+constexpr int kIdleConnectionTimeoutMs = 10000;
+
+// Maximum size of the request line and headers of a request.
+constexpr int kMaxHeaderSize = 64 * 1024;
+
+// Maximum size of the body of a request.
+constexpr int64_t kMaxBodySize = 256 * 1024 * 1024;
+
+// Returns the HTTP status line for `code`, as mapped by the REST gateway.
+absl::string_view HttpStatus(absl::StatusCode code) {
+  switch (code) {
+    case absl::StatusCode::kOk:
+      return "200 OK";
+    case absl::StatusCode::kCancelled:
+      return "499 Client Closed Request";
+    case absl::StatusCode::kInvalidArgument:
+    case absl::StatusCode::kFailedPrecondition:
+    case absl::StatusCode::kOutOfRange:
+      return "400 Bad Request";
+    case absl::StatusCode::kDeadlineExceeded:
+      return "504 Gateway Timeout";
+    case absl::StatusCode::kNotFound:
+      return "404 Not Found";
+    case absl::StatusCode::kAlreadyExists:
+    case absl::StatusCode::kAborted:
+      return "409 Conflict";
+    case absl::StatusCode::kPermissionDenied:
+      return "403 Forbidden";
+    case absl::StatusCode::kUnauthenticated:
+      return "401 Unauthorized";
+    case absl::StatusCode::kResourceExhausted:
+      return "429 Too Many Requests";
+    case absl::StatusCode::kUnimplemented:
+      return "501 Not Implemented";
+    case absl::StatusCode::kUnavailable:
+      return "503 Service Unavailable";
+    default:
+      return "500 Internal Server Error";
+  }
+}
+
+// Returns `text` as a JSON string literal.
+std::string JsonString(absl::string_view text) {
+  std::string json = "\"";
+  for (char c : text) {
+    switch (c) {
+      case '"':
+        absl::StrAppend(&json, "\\\"");
+        break;
+      case '\\':
+        absl::StrAppend(&json, "\\\\");
+        break;
+      case '\n':
+        absl::StrAppend(&json, "\\n");
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          absl::StrAppend(&json, "\\u00",
+                          absl::Hex(static_cast<int>(c), absl::kZeroPad2));
+        } else {
+          json.push_back(c);
+        }
+    }
+  }
+  json.push_back('"');
+  return json;
+}
+
+// Returns the body of the error response for `status`, as by the REST
+// gateway.
+std::string ErrorJson(const absl::Status& status) {
+  const std::string message = JsonString(status.message());
+  return absl::StrCat("{\"error\":", message,
+                      ",\"code\":", static_cast<int>(status.code()),
+                      ",\"message\":", message, ",\"details\":[]}");
+}
+
+// Returns an HTTP/1.1 response with the given status line and body.
+std::string HttpResponse(absl::string_view status, absl::string_view body,
+                         bool keep_alive) {
+  return absl::StrCat("HTTP/1.1 ", status,
+                      "\r\nContent-Type: application/json\r\nContent-Length: ",
+                      body.size(), "\r\nConnection: ",
+                      keep_alive ? "keep-alive" : "close", "\r\n\r\n", body);
+}
+
+// Returns `text` with its %XX escapes decoded, and with plus signs decoded as
+// spaces if `plus_as_space` is true.
+std::string UrlDecode(absl::string_view text, bool plus_as_space) {
+  std::string decoded;
+  for (size_t i = 0; i < text.size(); ++i) {
+    int value;
+    if (text[i] == '%' && i + 2 < text.size() &&
+        absl::SimpleHexAtoi(text.substr(i + 1, 2), &value)) {
+      decoded.push_back(static_cast<char>(value));
+      i += 2;
+    } else if (text[i] == '+' && plus_as_space) {
+      decoded.push_back(' ');
+    } else {
+      decoded.push_back(text[i]);
+    }
+  }
+  return decoded;
+}
+
+// Returns the field of `descriptor` named `name`, by its proto or JSON name.
+const google::protobuf::FieldDescriptor* FindField(
+    const google::protobuf::Descriptor* descriptor, const std::string& name) {
+  const google::protobuf::FieldDescriptor* field =
+      descriptor->FindFieldByName(name);
+  return field != nullptr ? field : descriptor->FindFieldByCamelcaseName(name);
+}
+
+// Returns the message of the field of `message` at the dot-separated
+// `field_path`, or null if `field_path` is empty.
+zetasql_base::StatusOr<google::protobuf::Message*> MutableMessageField(
+    google::protobuf::Message* message, absl::string_view field_path) {
+  for (absl::string_view name : absl::StrSplit(field_path, '.')) {
+    const google::protobuf::FieldDescriptor* field =
+        FindField(message->GetDescriptor(), std::string(name));
+    if (field == nullptr || field->is_repeated() ||
+        field->cpp_type() !=
+            google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Invalid field path ", field_path, " for ",
+          message->GetDescriptor()->full_name()));
+    }
+    message = message->GetReflection()->MutableMessage(message, field);
+  }
+  return message;
+}
+
+// Sets the field of `message` at the dot-separated `field_path` to `value`, or
+// adds `value` to it if it is repeated.
+absl::Status SetField(google::protobuf::Message* message,
+                      absl::string_view field_path, const std::string& value) {
+  const size_t dot = field_path.rfind('.');
+  if (dot != absl::string_view::npos) {
+    ZETASQL_ASSIGN_OR_RETURN(message,
+                     MutableMessageField(message, field_path.substr(0, dot)));
+    field_path = field_path.substr(dot + 1);
+  }
+  const google::protobuf::FieldDescriptor* field =
+      FindField(message->GetDescriptor(), std::string(field_path));
+  if (field == nullptr) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Unknown field ", field_path, " of ",
+                     message->GetDescriptor()->full_name()));
+  }
+
+  const google::protobuf::Reflection* reflection = message->GetReflection();
+  const bool repeated = field->is_repeated();
+  bool parsed = true;
+  switch (field->cpp_type()) {
+    case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+      repeated ? reflection->AddString(message, field, value)
+               : reflection->SetString(message, field, value);
+      break;
+    case google::protobuf::FieldDescriptor::CPPTYPE_INT32: {
+      int32_t number;
+      parsed = absl::SimpleAtoi(value, &number);
+      repeated ? reflection->AddInt32(message, field, number)
+               : reflection->SetInt32(message, field, number);
+      break;
+    }
+    case google::protobuf::FieldDescriptor::CPPTYPE_INT64: {
+      int64_t number;
+      parsed = absl::SimpleAtoi(value, &number);
+      repeated ? reflection->AddInt64(message, field, number)
+               : reflection->SetInt64(message, field, number);
+      break;
+    }
+    case google::protobuf::FieldDescriptor::CPPTYPE_UINT32: {
+      uint32_t number;
+      parsed = absl::SimpleAtoi(value, &number);
+      repeated ? reflection->AddUInt32(message, field, number)
+               : reflection->SetUInt32(message, field, number);
+      break;
+    }
+    case google::protobuf::FieldDescriptor::CPPTYPE_UINT64: {
+      uint64_t number;
+      parsed = absl::SimpleAtoi(value, &number);
+      repeated ? reflection->AddUInt64(message, field, number)
+               : reflection->SetUInt64(message, field, number);
+      break;
+    }
+    case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE: {
+      double number;
+      parsed = absl::SimpleAtod(value, &number);
+      repeated ? reflection->AddDouble(message, field, number)
+               : reflection->SetDouble(message, field, number);
+      break;
+    }
+    case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT: {
+      float number;
+      parsed = absl::SimpleAtof(value, &number);
+      repeated ? reflection->AddFloat(message, field, number)
+               : reflection->SetFloat(message, field, number);
+      break;
+    }
+    case google::protobuf::FieldDescriptor::CPPTYPE_BOOL: {
+      bool boolean;
+      parsed = absl::SimpleAtob(value, &boolean);
+      repeated ? reflection->AddBool(message, field, boolean)
+               : reflection->SetBool(message, field, boolean);
+      break;
+    }
+    case google::protobuf::FieldDescriptor::CPPTYPE_ENUM: {
+      const google::protobuf::EnumValueDescriptor* enum_value =
+          field->enum_type()->FindValueByName(value);
+      int number;
+      if (enum_value == nullptr && absl::SimpleAtoi(value, &number)) {
+        enum_value = field->enum_type()->FindValueByNumber(number);
+      }
+      parsed = enum_value != nullptr;
+      if (parsed) {
+        repeated ? reflection->AddEnum(message, field, enum_value)
+                 : reflection->SetEnum(message, field, enum_value);
+      }
+      break;
+    }
+    case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE: {
+      // Well-known types such as timestamps and field masks are bound from
+      // their JSON string representation.
+      google::protobuf::Message* field_message =
+          repeated ? reflection->AddMessage(message, field)
+                   : reflection->MutableMessage(message, field);
+      parsed = google::protobuf::util::JsonStringToMessage(JsonString(value),
+                                                           field_message)
+                   .ok();
+      break;
+    }
+  }
+  if (!parsed) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid value ", value, " for field ", field_path, " of ",
+                     message->GetDescriptor()->full_name()));
+  }
+  return absl::OkStatus();
+}
+
+// Returns the request of `route` transcoded from `request`, whose path matched
+// the route with `bindings`.
+zetasql_base::StatusOr<std::unique_ptr<google::protobuf::Message>>
+TranscodeRequest(const HttpBinding& binding, GRPCHandlerBase* handler,
+                 const std::vector<PathTemplate::Binding>& bindings,
+                 absl::string_view query, const std::string& body) {
+  std::unique_ptr<google::protobuf::Message> message = handler->NewRequest();
+  if (!binding.body.empty() && !body.empty()) {
+    google::protobuf::Message* body_message = message.get();
+    if (binding.body != "*") {
+      ZETASQL_ASSIGN_OR_RETURN(body_message,
+                       MutableMessageField(message.get(), binding.body));
+    }
+    const auto status =
+        google::protobuf::util::JsonStringToMessage(body, body_message);
+    if (!status.ok()) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid JSON body: ", status.ToString()));
+    }
+  }
+  for (const auto& [field_path, value] : bindings) {
+    ZETASQL_RETURN_IF_ERROR(SetField(message.get(), field_path, value));
+  }
+  // Fields not bound by the path or the body are bound by query parameters.
+  if (binding.body != "*") {
+    for (absl::string_view parameter :
+         absl::StrSplit(query, '&', absl::SkipEmpty())) {
+      std::pair<absl::string_view, absl::string_view> key_value =
+          absl::StrSplit(parameter, absl::MaxSplits('=', 1));
+      ZETASQL_RETURN_IF_ERROR(SetField(message.get(),
+                               UrlDecode(key_value.first, true),
+                               UrlDecode(key_value.second, true)));
+    }
+  }
+  return message;
+}
+
+// Returns `message` in JSON.
+zetasql_base::StatusOr<std::string> ToJson(
+    const google::protobuf::Message& message) {
+  std::string json;
+  const auto status =
+      google::protobuf::util::MessageToJsonString(message, &json);
+  if (!status.ok()) {
+    return absl::InternalError(absl::StrCat(
+        "Failed to convert response to JSON: ", status.ToString()));
+  }
+  return json;
+}
+
+// Returns `data` as a chunk of a chunked HTTP response.
+std::string Chunk(absl::string_view data) {
+  return absl::StrCat(absl::Hex(data.size()), "\r\n", data, "\r\n");
+}
+
+}  // namespace
+
+zetasql_base::StatusOr<std::vector<RestServer::Route>>
+RestServer::BuildRoutes() {
+  absl::flat_hash_map<std::string, google::api::HttpRule> rules;
+  for (const char* yaml : kHttpRulesYaml) {
+    ZETASQL_ASSIGN_OR_RETURN(std::vector<google::api::HttpRule> parsed_rules,
+                     ParseHttpRulesYaml(yaml));
+    for (google::api::HttpRule& rule : parsed_rules) {
+      rules[rule.selector()] = std::move(rule);
+    }
+  }
+
+  std::vector<Route> routes;
+  for (const char* service_name : kServiceNames) {
+    const google::protobuf::ServiceDescriptor* service =
+        google::protobuf::DescriptorPool::generated_pool()->FindServiceByName(
+            service_name);
+    if (service == nullptr) {
+      return absl::InternalError(
+          absl::StrCat("Could not find service ", service_name));
+    }
+    for (int i = 0; i < service->method_count(); ++i) {
+      const google::protobuf::MethodDescriptor* method = service->method(i);
+      GRPCHandlerBase* handler = GetHandler(service->name(), method->name());
+      if (handler == nullptr || method->client_streaming()) {
+        continue;
+      }
+      auto rule = rules.find(method->full_name());
+      const google::api::HttpRule& http_rule =
+          rule != rules.end()
+              ? rule->second
+              : method->options().GetExtension(google::api::http);
+      if (http_rule.pattern_case() ==
+          google::api::HttpRule::PATTERN_NOT_SET) {
+        continue;
+      }
+      std::vector<HttpBinding> bindings;
+      ZETASQL_RETURN_IF_ERROR(
+          AppendHttpBindings(method->full_name(), http_rule, &bindings));
+      for (HttpBinding& binding : bindings) {
+        routes.push_back({std::move(binding), method, handler});
+      }
+    }
+  }
+  return routes;
+}
+
+std::unique_ptr<RestServer> RestServer::Create(const std::string& host_port,
+                                               ServerEnv* env) {
+  zetasql_base::StatusOr<std::vector<Route>> routes = BuildRoutes();
+  if (!routes.ok()) {
+    LOG(ERROR) << "Failed to build REST routes: " << routes.status();
+    return nullptr;
+  }
+  int bound_port;
+  const int listening_socket = ListenOnHostPort(host_port, &bound_port);
+  if (listening_socket < 0) {
+    return nullptr;
+  }
+  return std::unique_ptr<RestServer>(new RestServer(
+      listening_socket, bound_port, env, std::move(routes).value()));
+}
+
+RestServer::RestServer(int socket, int port, ServerEnv* env,
+                       std::vector<Route> routes)
+    : socket_(socket),
+      port_(port),
+      env_(env),
+      routes_(std::move(routes)),
+      thread_([this]() { ServeLoop(); }) {}
+
+RestServer::~RestServer() {
+  stopping_ = true;
+  thread_.join();
+  connection_pool_.WaitUntilIdle();
+  close(socket_);
+}
+
+void RestServer::ServeLoop() {
+  while (!stopping_) {
+    pollfd listening = {socket_, POLLIN, 0};
+    if (poll(&listening, 1, kPollIntervalMs) <= 0) {
+      continue;
+    }
+    int connection = accept(socket_, nullptr, nullptr);
+    if (connection < 0) {
+      continue;
+    }
+    connection_pool_.Schedule([this, connection]() {
+      HandleConnection(connection);
+      close(connection);
+    });
+  }
+}
+
+void RestServer::HandleConnection(int connection) {
+  std::string buffer;
+  char data[16 * 1024];
+  int idle_ms = 0;
+
+  // Receives more data into buffer. Returns false if the connection should be
+  // closed.
+  auto receive = [&]() {
+    while (!stopping_ && idle_ms < kIdleConnectionTimeoutMs) {
+      pollfd readable = {connection, POLLIN, 0};
+      if (poll(&readable, 1, kPollIntervalMs) <= 0) {
+        idle_ms += kPollIntervalMs;
+        continue;
+      }
+      ssize_t received = recv(connection, data, sizeof(data), 0);
+      if (received <= 0) {
+        return false;
+      }
+      buffer.append(data, received);
+      idle_ms = 0;
+      return true;
+    }
+    return false;
+  };
+
+  while (true) {
+    size_t header_end;
+    while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+      if (buffer.size() > kMaxHeaderSize) {
+        WriteAll(connection,
+                 HttpResponse("431 Request Header Fields Too Large",
+                              ErrorJson(absl::InvalidArgumentError(
+                                  "Request headers too large")),
+                              /*keep_alive=*/false));
+        return;
+      }
+      if (!receive()) {
+        return;
+      }
+    }
+
+    // Parse the request line and the headers.
+    std::vector<absl::string_view> lines =
+        absl::StrSplit(absl::string_view(buffer).substr(0, header_end), "\r\n");
+    std::vector<absl::string_view> request_line =
+        absl::StrSplit(lines[0], ' ', absl::SkipEmpty());
+    if (request_line.size() != 3) {
+      WriteAll(connection, HttpResponse("400 Bad Request",
+                                        ErrorJson(absl::InvalidArgumentError(
+                                            "Malformed request line")),
+                                        /*keep_alive=*/false));
+      return;
+    }
+    HttpRequest request;
+    request.method = std::string(request_line[0]);
+    absl::string_view target = request_line[1];
+    const size_t question = target.find('?');
+    request.path = std::string(target.substr(0, question));
+    if (question != absl::string_view::npos) {
+      request.query = std::string(target.substr(question + 1));
+    }
+    bool keep_alive = request_line[2] == "HTTP/1.1";
+    int64_t content_length = 0;
+    bool chunked = false;
+    for (size_t i = 1; i < lines.size(); ++i) {
+      std::pair<absl::string_view, absl::string_view> header =
+          absl::StrSplit(lines[i], absl::MaxSplits(':', 1));
+      const std::string name = absl::AsciiStrToLower(header.first);
+      const std::string value = absl::AsciiStrToLower(
+          absl::StripAsciiWhitespace(header.second));
+      if (name == "content-length") {
+        if (!absl::SimpleAtoi(value, &content_length) || content_length < 0) {
+          content_length = -1;
+        }
+      } else if (name == "connection") {
+        keep_alive = value == "keep-alive" ||
+                     (keep_alive && value != "close");
+      } else if (name == "transfer-encoding") {
+        chunked = value != "identity";
+      } else if (name == "x-http-method-override") {
+        // Some clients send PATCH requests as POST requests.
+        request.method = absl::AsciiStrToUpper(value);
+      }
+    }
+    if (chunked || content_length < 0 || content_length > kMaxBodySize) {
+      WriteAll(connection,
+               HttpResponse(chunked ? "411 Length Required" : "400 Bad Request",
+                            ErrorJson(absl::InvalidArgumentError(
+                                "Requests must have a valid Content-Length")),
+                            /*keep_alive=*/false));
+      return;
+    }
+
+    // Receive the body.
+    buffer.erase(0, header_end + 4);
+    while (static_cast<int64_t>(buffer.size()) < content_length) {
+      if (!receive()) {
+        return;
+      }
+    }
+    request.body = buffer.substr(0, content_length);
+    buffer.erase(0, content_length);
+
+    if (!HandleRequest(connection, request, keep_alive) || !keep_alive) {
+      return;
+    }
+  }
+}
+
+bool RestServer::HandleRequest(int connection, const HttpRequest& request,
+                               bool keep_alive) {
+  const Route* route = nullptr;
+  std::vector<PathTemplate::Binding> bindings;
+  for (const Route& candidate : routes_) {
+    if (candidate.binding.http_method == request.method &&
+        candidate.binding.path.Match(request.path, &bindings)) {
+      route = &candidate;
+      break;
+    }
+  }
+  if (route == nullptr) {
+    return WriteAll(connection,
+                    HttpResponse("404 Not Found",
+                                 ErrorJson(absl::NotFoundError("Not Found")),
+                                 keep_alive));
+  }
+
+  zetasql_base::StatusOr<std::unique_ptr<google::protobuf::Message>> message =
+      TranscodeRequest(route->binding, route->handler, bindings, request.query,
+                       request.body);
+  if (!message.ok()) {
+    return WriteAll(connection,
+                    HttpResponse(HttpStatus(message.status().code()),
+                                 ErrorJson(message.status()), keep_alive));
+  }
+
+  grpc::ServerContext grpc_context;
+  RequestContext ctx(env_, &grpc_context);
+  if (!route->method->server_streaming()) {
+    zetasql_base::StatusOr<std::string> json;
+    absl::Status status = route->handler->RunMessage(
+        &ctx, **message, [&json](const google::protobuf::Message& response) {
+          json = ToJson(response);
+          return json.ok();
+        });
+    if (status.ok()) {
+      status = json.status();
+    }
+    if (!status.ok()) {
+      return WriteAll(connection, HttpResponse(HttpStatus(status.code()),
+                                               ErrorJson(status), keep_alive));
+    }
+    return WriteAll(connection, HttpResponse("200 OK", *json, keep_alive));
+  }
+
+  // Responses of streaming methods are sent as they are produced, which
+  // commits to a successful status; later errors are sent in the stream.
+  bool started = false;
+  bool connected = true;
+  absl::Status json_status;
+  absl::Status status = route->handler->RunMessage(
+      &ctx, **message,
+      [&](const google::protobuf::Message& response) {
+        zetasql_base::StatusOr<std::string> json = ToJson(response);
+        if (!json.ok()) {
+          json_status = json.status();
+          return false;
+        }
+        if (!started) {
+          started = true;
+          connected = WriteAll(
+              connection,
+              absl::StrCat("HTTP/1.1 200 OK\r\nContent-Type: application/json"
+                           "\r\nTransfer-Encoding: chunked\r\nConnection: ",
+                           keep_alive ? "keep-alive" : "close", "\r\n\r\n"));
+        }
+        connected = connected &&
+                    WriteAll(connection,
+                             Chunk(absl::StrCat("{\"result\":", *json, "}\n")));
+        return connected;
+      });
+  if (!connected) {
+    return false;
+  }
+  if (status.ok()) {
+    status = json_status;
+  }
+  if (!started) {
+    return WriteAll(connection,
+                    HttpResponse(HttpStatus(status.code()),
+                                 status.ok() ? "" : ErrorJson(status),
+                                 keep_alive));
+  }
+  if (!status.ok()) {
+    connected = WriteAll(
+        connection,
+        Chunk(absl::StrCat("{\"error\":", ErrorJson(status), "}\n")));
+  }
+  return connected && WriteAll(connection, "0\r\n\r\n");
+}
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -0,0 +1,134 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_REST_SERVER_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_REST_SERVER_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "google/protobuf/descriptor.h"
+#include "absl/strings/string_view.h"
+#include "common/thread_pool.h"
+#include "frontend/server/environment.h"
+#include "frontend/server/handler.h"
+#include "frontend/server/http_rules.h"
+#include "zetasql/base/statusor.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+// RestServer serves the REST API of Cloud Spanner over HTTP/1.1.
+//
+// Requests are transcoded in process from JSON into request messages, which
+// are dispatched directly to the handlers registered via
+// REGISTER_GRPC_HANDLER, and their responses are transcoded back into JSON.
+// This avoids the loopback gRPC connection of the REST gateway, which
+// serializes each message twice more.
+//
+// Methods are bound to URLs by the google.api.http annotations of the service
+// definitions, overridden by the HTTP rules of the gateway configuration files
+// (gateway/*.yaml). Responses of server streaming methods are sent as a
+// chunked stream of {"result": ...} objects, as by the REST gateway.
+class RestServer {
+ public:
+  // Number of connections served concurrently. Further connections wait until
+  // a served connection is closed or idles out.
+  static constexpr int kNumConnectionThreads = 16;
+
+  // Returns a server listening on `host_port` (e.g. "localhost:9020", or
+  // "localhost:0" to pick any free port) which serves requests with `env`, or
+  // nullptr if it could not listen.
+  static std::unique_ptr<RestServer> Create(const std::string& host_port,
+                                            ServerEnv* env);
+
+  // Stops serving and closes the listening socket.
+  ~RestServer();
+
+  RestServer(const RestServer&) = delete;
+  RestServer& operator=(const RestServer&) = delete;
+
+  // Returns the port on which the server listens.
+  int port() const { return port_; }
+
+ private:
+  // An HTTP binding of a method, and the handler of the method.
+  struct Route {
+    HttpBinding binding;
+    const google::protobuf::MethodDescriptor* method;
+    GRPCHandlerBase* handler;
+  };
+
+  // A parsed HTTP request.
+  struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::string query;
+    std::string body;
+  };
+
+  RestServer(int socket, int port, ServerEnv* env, std::vector<Route> routes);
+
+  // Returns the routes of the methods of the emulator services which have a
+  // registered handler.
+  static zetasql_base::StatusOr<std::vector<Route>> BuildRoutes();
+
+  // Body of the serving thread.
+  void ServeLoop();
+
+  // Serves the requests received on `connection` until the client closes it,
+  // it idles out or the server stops.
+  void HandleConnection(int connection);
+
+  // Transcodes `request`, dispatches it to the handler of its route and writes
+  // the response to `connection`. Returns false if the response could not be
+  // written.
+  bool HandleRequest(int connection, const HttpRequest& request,
+                     bool keep_alive);
+
+  // The listening socket.
+  const int socket_;
+
+  // The port to which socket_ is bound.
+  const int port_;
+
+  // Environment shared by all handlers.
+  ServerEnv* const env_;
+
+  const std::vector<Route> routes_;
+
+  // Set by the destructor to stop the serving threads.
+  std::atomic<bool> stopping_{false};
+
+  // Threads serving the accepted connections. Declared before thread_ so that
+  // connections cannot be scheduled after it is destroyed.
+  ThreadPool connection_pool_{kNumConnectionThreads};
+
+  // The thread accepting connections.
+  std::thread thread_;
+};
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_REST_SERVER_H_
@@ -0,0 +1,181 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "frontend/server/rest_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "google/longrunning/operations.pb.h"
+#include "google/spanner/v1/result_set.pb.h"
+#include "google/spanner/v1/spanner.pb.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "frontend/server/environment.h"
+#include "frontend/server/handler.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+namespace {
+
+using testing::EndsWith;
+using testing::HasSubstr;
+using testing::StartsWith;
+
+absl::Status GetSession(
+    RequestContext* ctx, const google::spanner::v1::GetSessionRequest* request,
+    google::spanner::v1::Session* response) {
+  if (absl::EndsWith(request->name(), "/missing")) {
+    return absl::NotFoundError("Session not found");
+  }
+  response->set_name(request->name());
+  return absl::OkStatus();
+}
+REGISTER_GRPC_HANDLER(Spanner, GetSession);
+
+absl::Status ExecuteStreamingSql(
+    RequestContext* ctx, const google::spanner::v1::ExecuteSqlRequest* request,
+    ServerStream<google::spanner::v1::PartialResultSet>* stream) {
+  google::spanner::v1::PartialResultSet result;
+  result.set_resume_token(request->sql());
+  stream->Send(result);
+  result.set_resume_token(request->session());
+  stream->Send(result);
+  return absl::OkStatus();
+}
+REGISTER_GRPC_HANDLER(Spanner, ExecuteStreamingSql);
+
+absl::Status ListOperations(
+    RequestContext* ctx,
+    const google::longrunning::ListOperationsRequest* request,
+    google::longrunning::ListOperationsResponse* response) {
+  response->add_operations()->set_name(request->name());
+  response->set_next_page_token(
+      absl::StrCat(request->page_token(), "+", request->page_size()));
+  return absl::OkStatus();
+}
+REGISTER_GRPC_HANDLER(Operations, ListOperations);
+
+class RestServerTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    server_ = RestServer::Create("127.0.0.1:0", &env_);
+    ASSERT_NE(server_, nullptr);
+  }
+
+  // Sends `requests` on one connection and returns the whole response.
+  std::string Fetch(const std::string& requests) {
+    int connection = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(server_->port());
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    EXPECT_EQ(connect(connection, reinterpret_cast<sockaddr*>(&address),
+                      sizeof(address)),
+              0);
+    send(connection, requests.data(), requests.size(), 0);
+    std::string response;
+    char buffer[1024];
+    ssize_t received;
+    while ((received = recv(connection, buffer, sizeof(buffer), 0)) > 0) {
+      response.append(buffer, received);
+    }
+    close(connection);
+    return response;
+  }
+
+ private:
+  ServerEnv env_;
+  std::unique_ptr<RestServer> server_;
+};
+
+TEST_F(RestServerTest, TranscodesPathVariables) {
+  std::string response =
+      Fetch("GET /v1/projects/p/instances/i/databases/d/sessions/s HTTP/1.1\r\n"
+            "Connection: close\r\n\r\n");
+  EXPECT_THAT(response, StartsWith("HTTP/1.1 200 OK\r\n"));
+  EXPECT_THAT(response,
+              EndsWith("{\"name\":\"projects/p/instances/i/databases/d/"
+                       "sessions/s\"}"));
+}
+
+TEST_F(RestServerTest, TranscodesQueryParametersWithGatewayRules) {
+  std::string response =
+      Fetch("GET /v1/projects/p/instances/i/operations?pageSize=2&"
+            "page_token=a%2Fb HTTP/1.1\r\nConnection: close\r\n\r\n");
+  EXPECT_THAT(response, StartsWith("HTTP/1.1 200 OK\r\n"));
+  EXPECT_THAT(response,
+              HasSubstr("\"name\":\"projects/p/instances/i/operations\""));
+  EXPECT_THAT(response, HasSubstr("\"nextPageToken\":\"a/b+2\""));
+}
+
+TEST_F(RestServerTest, StreamsResponsesInChunks) {
+  const std::string body = "{\"sql\":\"SELECT 1\"}";
+  std::string response = Fetch(absl::StrCat(
+      "POST /v1/projects/p/instances/i/databases/d/sessions/s"
+      ":executeStreamingSql HTTP/1.1\r\nConnection: close\r\n"
+      "Content-Length: ",
+      body.size(), "\r\n\r\n", body));
+  EXPECT_THAT(response, StartsWith("HTTP/1.1 200 OK\r\n"));
+  EXPECT_THAT(response, HasSubstr("Transfer-Encoding: chunked\r\n"));
+  // Bytes fields are base64 encoded in JSON.
+  EXPECT_THAT(response,
+              HasSubstr("{\"result\":{\"resumeToken\":\"U0VMRUNUIDE=\"}}"));
+  EXPECT_THAT(response, EndsWith("0\r\n\r\n"));
+}
+
+TEST_F(RestServerTest, ReturnsErrorsWithHttpStatus) {
+  EXPECT_THAT(
+      Fetch("GET /v1/projects/p/instances/i/databases/d/sessions/missing "
+            "HTTP/1.1\r\nConnection: close\r\n\r\n"),
+      testing::AllOf(StartsWith("HTTP/1.1 404 Not Found\r\n"),
+                     HasSubstr("\"code\":5"),
+                     HasSubstr("\"message\":\"Session not found\"")));
+  EXPECT_THAT(Fetch("GET /v1/unknown HTTP/1.1\r\nConnection: close\r\n\r\n"),
+              StartsWith("HTTP/1.1 404 Not Found\r\n"));
+  EXPECT_THAT(Fetch("GET /v1/projects/p/instances/i/operations?unknown=1 "
+                    "HTTP/1.1\r\nConnection: close\r\n\r\n"),
+              StartsWith("HTTP/1.1 400 Bad Request\r\n"));
+}
+
+TEST_F(RestServerTest, ServesRequestsOnKeptAliveConnections) {
+  std::string response =
+      Fetch("GET /v1/projects/p/instances/i/databases/d/sessions/a HTTP/1.1\r\n"
+            "\r\n"
+            "GET /v1/projects/p/instances/i/databases/d/sessions/b HTTP/1.1\r\n"
+            "Connection: close\r\n\r\n");
+  EXPECT_THAT(response, HasSubstr("sessions/a\"}HTTP/1.1 200 OK\r\n"));
+  EXPECT_THAT(response, EndsWith("sessions/b\"}"));
+}
+
+}  // namespace
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
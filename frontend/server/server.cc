@@ -16,6 +16,9 @@
 
 #include "frontend/server/server.h"
 
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <memory>
 
 #include "zetasql/base/logging.h"
@@ -32,6 +35,8 @@
 #include "grpcpp/server_builder.h"
 #include "grpcpp/support/status.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
 #include "common/constants.h"
 #include "common/errors.h"
 #include "common/limits.h"
@@ -52,24 +57,6 @@ namespace operations_api = ::google::longrunning;
 namespace protobuf_api = ::google::protobuf;
 namespace spanner_api = ::google::spanner::v1;
 
-namespace {
-
-void MaybeAddTrailingMetadata(const absl::Status& status, RequestContext* ctx) {
-  if (!status.ok()) {
-    // Check for ResourceInfo within the returned status and append it as extra
-    // trailing metadata. The Java client library expects the ResourceInfo to be
-    // added as additional trailing metadata.
-    auto payload = status.GetPayload(kResourceInfoType);
-    if (payload.has_value()) {
-      std::string serialized_info(payload.value());
-      ctx->grpc()->AddTrailingMetadata(kResourceInfoBinaryHeader,
-                                       serialized_info);
-    }
-  }
-}
-
-}  // namespace
-
 // Invokes the given unary gRPC method on the given service by looking up the
 // handler registry. Returns INTERNAL error if the handler could not be found.
 template <typename RequestT, typename ResponseT>
@@ -297,17 +284,77 @@ std::unique_ptr<Server> Server::Create(const Server::Options& options) {
   builder.AddListeningPort(options.server_address,
                            ::grpc::InsecureServerCredentials(), &server->port_);
 
+  // Configure the Unix domain socket for clients on the same host. A socket
+  // file left by a server which did not shut down cleanly would fail the
+  // bind, but any other file at the path is left alone.
+  int unix_socket_bound = 0;
+  if (!options.unix_socket_path.empty()) {
+    struct stat socket_stat;
+    if (lstat(options.unix_socket_path.c_str(), &socket_stat) == 0 &&
+        S_ISSOCK(socket_stat.st_mode)) {
+      unlink(options.unix_socket_path.c_str());
+    }
+    builder.AddListeningPort(absl::StrCat("unix:", options.unix_socket_path),
+                             ::grpc::InsecureServerCredentials(),
+                             &unix_socket_bound);
+  }
+
   // Configure server message limits.
   builder.AddChannelArgument(GRPC_ARG_MAX_SEND_MESSAGE_LENGTH,
                              limits::kMaxGRPCOutgoingMessageSize);
   builder.AddChannelArgument(GRPC_ARG_MAX_RECEIVE_MESSAGE_LENGTH,
                              limits::kMaxGRPCIncomingMessageSize);
 
+  // Configure response compression, which applies to clients which advertise
+  // support for the algorithm. Requests are decompressed whatever their
+  // algorithm.
+  if (!options.response_compression.empty()) {
+    if (options.response_compression == "gzip") {
+      builder.SetDefaultCompressionAlgorithm(GRPC_COMPRESS_GZIP);
+    } else if (options.response_compression == "deflate") {
+      builder.SetDefaultCompressionAlgorithm(GRPC_COMPRESS_DEFLATE);
+    } else {
+      LOG(ERROR) << "Unsupported response compression: "
+                 << options.response_compression;
+      return nullptr;
+    }
+  }
+
+  // Configure HTTP/2 flow control and keepalive.
+  if (options.stream_window_bytes > 0) {
+    builder.AddChannelArgument(GRPC_ARG_HTTP2_STREAM_LOOKAHEAD_BYTES,
+                               options.stream_window_bytes);
+  }
+  if (options.max_concurrent_streams > 0) {
+    builder.AddChannelArgument(GRPC_ARG_MAX_CONCURRENT_STREAMS,
+                               options.max_concurrent_streams);
+  }
+  if (options.keepalive_time > absl::ZeroDuration()) {
+    const int keepalive_time_ms =
+        static_cast<int>(absl::ToInt64Milliseconds(options.keepalive_time));
+    builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_TIME_MS, keepalive_time_ms);
+    builder.AddChannelArgument(
+        GRPC_ARG_KEEPALIVE_TIMEOUT_MS,
+        static_cast<int>(absl::ToInt64Milliseconds(options.keepalive_timeout)));
+    builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+    // Clients pinging at the same rate are not treated as abusive.
+    builder.AddChannelArgument(
+        GRPC_ARG_HTTP2_MIN_RECV_PING_INTERVAL_WITHOUT_DATA_MS,
+        keepalive_time_ms);
+  }
+
   // Configure services exported on this server.
-  builder.RegisterService(server->spanner_service_.get())
-      .RegisterService(server->database_admin_service_.get())
-      .RegisterService(server->instance_admin_service_.get())
-      .RegisterService(server->operations_service_.get());
+  if (options.enable_async_server) {
+    server->async_dispatcher_ = absl::make_unique<AsyncDispatcher>(
+        server->env(), options.num_completion_queue_threads,
+        options.num_handler_threads);
+    server->async_dispatcher_->RegisterWith(&builder);
+  } else {
+    builder.RegisterService(server->spanner_service_.get())
+        .RegisterService(server->database_admin_service_.get())
+        .RegisterService(server->instance_admin_service_.get())
+        .RegisterService(server->operations_service_.get());
+  }
 
   // Actually start the server.
   server->grpc_server_ = builder.BuildAndStart();
@@ -315,13 +362,29 @@ std::unique_ptr<Server> Server::Create(const Server::Options& options) {
     LOG(ERROR) << "Failed to bind to address: " << options.server_address;
     return nullptr;
   }
+  if (!options.unix_socket_path.empty()) {
+    if (unix_socket_bound <= 0) {
+      LOG(ERROR) << "Failed to bind to Unix domain socket: "
+                 << options.unix_socket_path;
+      return nullptr;
+    }
+    server->unix_socket_path_ = options.unix_socket_path;
+  }
+  if (server->async_dispatcher_ != nullptr) {
+    server->async_dispatcher_->Start();
+  }
 
   return server;
 }
 
 void Server::WaitForShutdown() { grpc_server_->Wait(); }
 
-void Server::Shutdown() { grpc_server_->Shutdown(); }
+void Server::Shutdown() {
+  grpc_server_->Shutdown();
+  if (async_dispatcher_ != nullptr) {
+    async_dispatcher_->Shutdown();
+  }
+}
 
 }  // namespace frontend
 }  // namespace emulator
@@ -23,6 +23,8 @@
 #include "grpcpp/impl/codegen/service_type.h"
 #include "grpcpp/server.h"
 #include "grpcpp/support/status.h"
+#include "absl/time/time.h"
+#include "frontend/server/async_dispatcher.h"
 #include "frontend/server/environment.h"
 
 namespace google {
@@ -54,6 +56,35 @@ class Server {
  public:
   struct Options {
     std::string server_address;
+
+    // If not empty, requests are also served on a Unix domain socket at this
+    // path, replacing a socket left there by a previous server.
+    std::string unix_socket_path;
+
+    // If true, requests are served asynchronously by an AsyncDispatcher (see
+    // async_dispatcher.h) instead of by synchronous gRPC services.
+    bool enable_async_server = false;
+
+    // Number of completion queue threads used by the asynchronous server.
+    int num_completion_queue_threads = 4;
+
+    // Number of handler threads used by the asynchronous server.
+    int num_handler_threads = 64;
+
+    // Algorithm compressing responses for clients which accept it, "gzip" or
+    // "deflate", or empty for uncompressed responses.
+    std::string response_compression;
+
+    // HTTP/2 settings, which keep their gRPC defaults if zero: the initial
+    // flow-control window of each stream, and the maximum number of
+    // concurrent streams per connection.
+    int stream_window_bytes = 0;
+    int max_concurrent_streams = 0;
+
+    // If positive, idle connections are pinged this often, and closed if a
+    // ping is not acknowledged within keepalive_timeout.
+    absl::Duration keepalive_time = absl::ZeroDuration();
+    absl::Duration keepalive_timeout = absl::Seconds(20);
   };
 
   // Returns an initialized Server, or nullptr if the initialization failed.
@@ -62,6 +93,10 @@ class Server {
   std::string host() const { return host_; }
   int port() const { return port_; }
 
+  // Returns the path of the Unix domain socket requests are served on, or an
+  // empty string if there is none.
+  const std::string& unix_socket_path() const { return unix_socket_path_; }
+
   // Blocks until the server is shut down.
   void WaitForShutdown();
 
@@ -79,6 +114,9 @@ class Server {
   std::string host_;
   int port_ = -1;
 
+  // Path of the Unix domain socket of the gRPC server, if any.
+  std::string unix_socket_path_;
+
   // Environment shared by all handlers.
   std::unique_ptr<ServerEnv> env_;
 
@@ -88,6 +126,10 @@ class Server {
   std::unique_ptr<grpc::Service> operations_service_;
   std::unique_ptr<grpc::Service> spanner_service_;
 
+  // Dispatcher serving all services when the asynchronous server is enabled.
+  // Declared before grpc_server_ so that it outlives the gRPC server.
+  std::unique_ptr<AsyncDispatcher> async_dispatcher_;
+
   // Underlying gRPC server.
   std::unique_ptr<grpc::Server> grpc_server_;
 };
@@ -0,0 +1,172 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "frontend/server/server.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "google/spanner/admin/instance/v1/spanner_instance_admin.grpc.pb.h"
+#include "google/spanner/admin/instance/v1/spanner_instance_admin.pb.h"
+#include "grpcpp/client_context.h"
+#include "grpc/compression.h"
+#include "grpcpp/create_channel.h"
+#include "grpcpp/security/credentials.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+
+namespace {
+
+namespace instance_api = ::google::spanner::admin::instance::v1;
+
+class ServerTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    options_.server_address = "localhost:0";
+    socket_path_ = testing::TempDir() + "/server_test.sock";
+    unlink(socket_path_.c_str());
+  }
+
+  // Lists the instance configs served at `target`, sending the request
+  // compressed with `compression`.
+  grpc::Status ListInstanceConfigs(
+      const std::string& target,
+      grpc_compression_algorithm compression = GRPC_COMPRESS_NONE) {
+    std::unique_ptr<instance_api::InstanceAdmin::Stub> stub =
+        instance_api::InstanceAdmin::NewStub(::grpc::CreateChannel(
+            target, ::grpc::InsecureChannelCredentials()));
+    instance_api::ListInstanceConfigsRequest request;
+    request.set_parent("projects/test-project");
+    instance_api::ListInstanceConfigsResponse response;
+    grpc::ClientContext context;
+    context.set_compression_algorithm(compression);
+    return stub->ListInstanceConfigs(&context, request, &response);
+  }
+
+  // Leaves a socket nobody listens on at `path`, as a crashed server would.
+  void BindAbandonedSocket(const std::string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_GE(fd, 0);
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    ASSERT_LT(path.size(), sizeof(addr.sun_path));
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    ASSERT_EQ(
+        bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)), 0);
+    close(fd);
+  }
+
+  Server::Options options_;
+  std::string socket_path_;
+};
+
+TEST_F(ServerTest, ServesRequestsOnUnixDomainSocket) {
+  options_.unix_socket_path = socket_path_;
+  std::unique_ptr<Server> server = Server::Create(options_);
+  ASSERT_NE(server, nullptr);
+  EXPECT_EQ(server->unix_socket_path(), socket_path_);
+
+  ZETASQL_EXPECT_OK(ListInstanceConfigs(absl::StrCat("unix:", socket_path_)));
+  ZETASQL_EXPECT_OK(ListInstanceConfigs(
+      absl::StrCat(server->host(), ":", server->port())));
+  server->Shutdown();
+}
+
+TEST_F(ServerTest, ServesNoUnixDomainSocketByDefault) {
+  std::unique_ptr<Server> server = Server::Create(options_);
+  ASSERT_NE(server, nullptr);
+  EXPECT_EQ(server->unix_socket_path(), "");
+  server->Shutdown();
+}
+
+TEST_F(ServerTest, ReplacesStaleUnixDomainSocket) {
+  BindAbandonedSocket(socket_path_);
+
+  options_.unix_socket_path = socket_path_;
+  std::unique_ptr<Server> server = Server::Create(options_);
+  ASSERT_NE(server, nullptr);
+  ZETASQL_EXPECT_OK(ListInstanceConfigs(absl::StrCat("unix:", socket_path_)));
+  server->Shutdown();
+}
+
+TEST_F(ServerTest, DoesNotReplaceOtherFilesWithUnixDomainSocket) {
+  std::ofstream(socket_path_) << "not a socket";
+
+  options_.unix_socket_path = socket_path_;
+  EXPECT_EQ(Server::Create(options_), nullptr);
+
+  std::ifstream file(socket_path_);
+  std::string contents;
+  std::getline(file, contents);
+  EXPECT_EQ(contents, "not a socket");
+}
+
+TEST_F(ServerTest, ServesCompressedResponses) {
+  for (const std::string compression : {"gzip", "deflate"}) {
+    options_.response_compression = compression;
+    std::unique_ptr<Server> server = Server::Create(options_);
+    ASSERT_NE(server, nullptr) << compression;
+    const std::string target =
+        absl::StrCat(server->host(), ":", server->port());
+    ZETASQL_EXPECT_OK(ListInstanceConfigs(target));
+    ZETASQL_EXPECT_OK(ListInstanceConfigs(target, GRPC_COMPRESS_GZIP));
+    server->Shutdown();
+  }
+}
+
+TEST_F(ServerTest, RejectsUnsupportedResponseCompression) {
+  options_.response_compression = "zstd";
+  EXPECT_EQ(Server::Create(options_), nullptr);
+}
+
+TEST_F(ServerTest, ServesRequestsWithFlowControlAndKeepalive) {
+  options_.stream_window_bytes = 1 << 20;
+  options_.max_concurrent_streams = 4;
+  options_.keepalive_time = absl::Seconds(30);
+  options_.keepalive_timeout = absl::Seconds(5);
+  std::unique_ptr<Server> server = Server::Create(options_);
+  ASSERT_NE(server, nullptr);
+
+  // More calls than concurrent streams are served one after another.
+  const std::string target = absl::StrCat(server->host(), ":", server->port());
+  for (int i = 0; i < 8; ++i) {
+    ZETASQL_EXPECT_OK(ListInstanceConfigs(target));
+  }
+  server->Shutdown();
+}
+
+}  // namespace
+
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
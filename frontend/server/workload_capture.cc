@@ -0,0 +1,171 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "frontend/server/workload_capture.h"
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/util/delimited_message_util.h"
+#include "zetasql/base/logging.h"
+#include "zetasql/base/statusor.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "frontend/proto/workload_capture.pb.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+namespace workload_capture {
+
+namespace internal {
+
+std::atomic<bool> enabled{false};
+
+}  // namespace internal
+
+namespace {
+
+// Length of the magic header, without its terminating null character.
+constexpr size_t kMagicLength = sizeof(kMagic) - 1;
+
+// The capture being written.
+struct Capture {
+  absl::Mutex mu;
+  absl::Time start ABSL_GUARDED_BY(mu);
+  std::unique_ptr<std::ofstream> file ABSL_GUARDED_BY(mu);
+  std::unique_ptr<CaptureWriter> writer ABSL_GUARDED_BY(mu);
+};
+
+Capture& GetCapture() {
+  static Capture* const capture = new Capture();
+  return *capture;
+}
+
+}  // namespace
+
+absl::Status Start(const std::string& path) {
+  Capture& capture = GetCapture();
+  absl::MutexLock lock(&capture.mu);
+  if (capture.writer != nullptr) {
+    return absl::FailedPreconditionError("A capture is already being written");
+  }
+  auto file = absl::make_unique<std::ofstream>(
+      path, std::ios::binary | std::ios::out | std::ios::trunc);
+  if (!file->is_open()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Failed to open capture file ", path));
+  }
+  capture.writer = absl::make_unique<CaptureWriter>(file.get());
+  capture.file = std::move(file);
+  capture.start = absl::Now();
+  internal::enabled.store(true, std::memory_order_relaxed);
+  return absl::OkStatus();
+}
+
+void Stop() {
+  Capture& capture = GetCapture();
+  absl::MutexLock lock(&capture.mu);
+  internal::enabled.store(false, std::memory_order_relaxed);
+  capture.writer = nullptr;
+  capture.file = nullptr;
+}
+
+absl::Duration SinceStart(absl::Time start) {
+  Capture& capture = GetCapture();
+  absl::MutexLock lock(&capture.mu);
+  return start - capture.start;
+}
+
+void Record(const CapturedCall& call) {
+  Capture& capture = GetCapture();
+  absl::MutexLock lock(&capture.mu);
+  if (capture.writer == nullptr) {
+    return;
+  }
+  absl::Status status = capture.writer->Write(call);
+  if (!status.ok()) {
+    // Stop rather than write a capture missing calls.
+    LOG(ERROR) << "Stopped capturing calls: " << status;
+    internal::enabled.store(false, std::memory_order_relaxed);
+    capture.writer = nullptr;
+    capture.file = nullptr;
+  }
+}
+
+CaptureWriter::CaptureWriter(std::ostream* out) : out_(out) {
+  out_->write(kMagic, kMagicLength);
+}
+
+absl::Status CaptureWriter::Write(const CapturedCall& call) {
+  if (!google::protobuf::util::SerializeDelimitedToOstream(call, out_) ||
+      !out_->flush()) {
+    return absl::InternalError("Failed to write captured call");
+  }
+  return absl::OkStatus();
+}
+
+zetasql_base::StatusOr<std::vector<CapturedCall>> ReadCapture(
+    const std::string& path) {
+  std::ifstream file(path, std::ios::binary | std::ios::in);
+  if (!file.is_open()) {
+    return absl::NotFoundError(
+        absl::StrCat("Failed to open capture file ", path));
+  }
+  return ReadCapture(&file);
+}
+
+zetasql_base::StatusOr<std::vector<CapturedCall>> ReadCapture(
+    std::istream* in) {
+  char magic[kMagicLength];
+  if (!in->read(magic, kMagicLength) ||
+      std::memcmp(magic, kMagic, kMagicLength) != 0) {
+    return absl::InvalidArgumentError("Not a workload capture");
+  }
+  std::vector<CapturedCall> calls;
+  google::protobuf::io::IstreamInputStream stream(in);
+  while (true) {
+    CapturedCall call;
+    bool clean_eof = false;
+    if (!google::protobuf::util::ParseDelimitedFromZeroCopyStream(
+            &call, &stream, &clean_eof)) {
+      if (clean_eof) {
+        break;
+      }
+      // The emulator stopped in the middle of writing the last call.
+      LOG(WARNING) << "Ignoring the truncated last call of the capture";
+      break;
+    }
+    calls.push_back(std::move(call));
+  }
+  return calls;
+}
+
+}  // namespace workload_capture
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
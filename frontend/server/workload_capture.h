@@ -0,0 +1,104 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_WORKLOAD_CAPTURE_H_
+#define THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_WORKLOAD_CAPTURE_H_
+
+#include <atomic>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "zetasql/base/statusor.h"
+#include "absl/time/time.h"
+#include "frontend/proto/workload_capture.pb.h"
+#include "absl/status/status.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+namespace workload_capture {
+
+// Workload capture records the calls served by the emulator, with their
+// requests, their first response and their timing, to a capture file from
+// which tests/load:workload_replay re-drives them against another emulator,
+// so that a workload captured from real clients can be replayed as a
+// repeatable performance test.
+//
+// A capture file starts with kMagic, followed by a CapturedCall per call
+// served, each preceded by its size as a varint. Calls are written as they
+// complete, so they are ordered by completion rather than by start time, and
+// each is flushed to the file before the call returns, so that the capture is
+// complete however the emulator is stopped.
+
+// The first bytes of every capture file.
+constexpr char kMagic[] = "SPANNER_EMULATOR_CAPTURE_V1\n";
+
+namespace internal {
+
+// True while a capture is being written.
+extern std::atomic<bool> enabled;
+
+}  // namespace internal
+
+// Starts capturing the calls served to a new file at `path`, replacing any
+// file there. Fails if a capture is already being written.
+absl::Status Start(const std::string& path);
+
+// Stops capturing calls, and closes the capture file.
+void Stop();
+
+// Returns true if calls are being captured.
+inline bool Enabled() {
+  return internal::enabled.load(std::memory_order_relaxed);
+}
+
+// Returns the start offset to record for a call starting at `start`.
+absl::Duration SinceStart(absl::Time start);
+
+// Appends `call` to the capture, if calls are being captured.
+void Record(const CapturedCall& call);
+
+// Writes captured calls to a stream. Not thread-safe.
+class CaptureWriter {
+ public:
+  // Writes the header of a capture to `out`, which must outlive the writer.
+  explicit CaptureWriter(std::ostream* out);
+
+  // Appends `call` and flushes the stream.
+  absl::Status Write(const CapturedCall& call);
+
+ private:
+  std::ostream* out_;
+};
+
+// Returns the calls of the capture file at `path`, in the order in which they
+// were written.
+zetasql_base::StatusOr<std::vector<CapturedCall>> ReadCapture(
+    const std::string& path);
+
+// Returns the calls of a capture read from `in`.
+zetasql_base::StatusOr<std::vector<CapturedCall>> ReadCapture(std::istream* in);
+
+}  // namespace workload_capture
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+#endif  // THIRD_PARTY_CLOUD_SPANNER_EMULATOR_FRONTEND_SERVER_WORKLOAD_CAPTURE_H_
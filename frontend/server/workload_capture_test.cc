@@ -0,0 +1,126 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "frontend/server/workload_capture.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "tests/common/proto_matchers.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "frontend/proto/workload_capture.pb.h"
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace frontend {
+namespace workload_capture {
+
+namespace {
+
+using test::EqualsProto;
+using testing::ElementsAre;
+using testing::IsEmpty;
+using zetasql_base::testing::IsOkAndHolds;
+using zetasql_base::testing::StatusIs;
+
+CapturedCall MakeCall(const std::string& method, int64_t start_offset_micros) {
+  CapturedCall call;
+  call.set_method(method);
+  call.set_request_type("google.spanner.v1.ExecuteSqlRequest");
+  call.set_response_type("google.spanner.v1.ResultSet");
+  call.set_start_offset_micros(start_offset_micros);
+  call.set_latency_micros(10);
+  call.set_status_code(0);
+  call.set_request(std::string("request\0bytes", 13));
+  call.set_first_response("response");
+  return call;
+}
+
+TEST(WorkloadCaptureTest, ReadsWrittenCalls) {
+  std::stringstream stream;
+  CaptureWriter writer(&stream);
+  const CapturedCall first =
+      MakeCall("/google.spanner.v1.Spanner/ExecuteSql", 100);
+  const CapturedCall second =
+      MakeCall("/google.spanner.v1.Spanner/Commit", 50);
+  ZETASQL_ASSERT_OK(writer.Write(first));
+  ZETASQL_ASSERT_OK(writer.Write(second));
+
+  EXPECT_THAT(ReadCapture(&stream),
+              IsOkAndHolds(ElementsAre(EqualsProto(first),
+                                       EqualsProto(second))));
+}
+
+TEST(WorkloadCaptureTest, ReadsEmptyCapture) {
+  std::stringstream stream;
+  CaptureWriter writer(&stream);
+  EXPECT_THAT(ReadCapture(&stream), IsOkAndHolds(IsEmpty()));
+}
+
+TEST(WorkloadCaptureTest, IgnoresTruncatedLastCall) {
+  std::stringstream stream;
+  CaptureWriter writer(&stream);
+  const CapturedCall first =
+      MakeCall("/google.spanner.v1.Spanner/ExecuteSql", 100);
+  ZETASQL_ASSERT_OK(writer.Write(first));
+  ZETASQL_ASSERT_OK(
+      writer.Write(MakeCall("/google.spanner.v1.Spanner/Read", 200)));
+  std::string contents = stream.str();
+  std::stringstream truncated(contents.substr(0, contents.size() - 5));
+
+  EXPECT_THAT(ReadCapture(&truncated),
+              IsOkAndHolds(ElementsAre(EqualsProto(first))));
+}
+
+TEST(WorkloadCaptureTest, RejectsFilesWhichAreNotCaptures) {
+  std::stringstream stream("not a capture");
+  EXPECT_THAT(ReadCapture(&stream),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ReadCapture(testing::TempDir() + "/no_such_capture"),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(WorkloadCaptureTest, CapturesRecordedCallsToFile) {
+  const std::string path = testing::TempDir() + "/workload_capture";
+  EXPECT_FALSE(Enabled());
+  ZETASQL_ASSERT_OK(Start(path));
+  EXPECT_TRUE(Enabled());
+  EXPECT_THAT(Start(path), StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_GE(SinceStart(absl::Now()), absl::ZeroDuration());
+
+  const CapturedCall call =
+      MakeCall("/google.spanner.v1.Spanner/ExecuteSql", 100);
+  Record(call);
+  Stop();
+  EXPECT_FALSE(Enabled());
+  Record(MakeCall("/google.spanner.v1.Spanner/Commit", 200));
+
+  EXPECT_THAT(ReadCapture(path), IsOkAndHolds(ElementsAre(EqualsProto(call))));
+}
+
+}  // namespace
+
+}  // namespace workload_capture
+}  // namespace frontend
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
@@ -21,10 +21,12 @@ import (
 	"context"
 	"fmt"
 	"log"
+	"net"
 	"net/http"
 	"os"
 	"os/exec"
 	"os/signal"
+	"strconv"
 	"time"
 
 	"google.golang.org/grpc"
@@ -46,6 +48,11 @@ type Options struct {
 	CopyEmulatorStderr   bool
 	LogRequests          bool
 	EnableFaultInjection bool
+
+	// Number of emulator grpc servers to place databases on. If more than one,
+	// FrontendAddress is served by a Router forwarding requests to servers
+	// listening on the ports following its port.
+	NumBackends int
 }
 
 // Gateway implements the emulator gateway server.
@@ -60,35 +67,22 @@ func New(opts Options) *Gateway {
 
 // Run starts the emulator gateway server.
 func (gw *Gateway) Run() {
-	// Start the emulator grpc server and redirect its output.
-	emulatorArgs := []string{
-
-		"--host_port", gw.opts.FrontendAddress,
-	}
-	if gw.opts.LogRequests {
-		emulatorArgs = append(emulatorArgs, "--log_requests")
-	}
-	if gw.opts.EnableFaultInjection {
-		emulatorArgs = append(emulatorArgs, "--enable_fault_injection")
-	}
-
-	cmd := exec.Command(gw.opts.FrontendBinary, emulatorArgs...)
-
-	// Proxy emulator log to gateway log.
-	if gw.opts.CopyEmulatorStdout {
-		cmd.Stdout = os.Stdout
-	}
-	if gw.opts.CopyEmulatorStderr {
-		cmd.Stderr = os.Stderr
+	addr := gw.opts.FrontendAddress
+	backends := []string{addr}
+	if gw.opts.NumBackends > 1 {
+		var err error
+		if backends, err = backendAddresses(addr, gw.opts.NumBackends); err != nil {
+			log.Fatal(err)
+		}
 	}
 
-	// Start the grpc server but won't block for the grpc server to be up.
-	err := cmd.Start()
-	if err != nil {
-		log.Fatal(err)
+	// Start the emulator grpc servers.
+	var cmds []*exec.Cmd
+	for _, backend := range backends {
+		cmds = append(cmds, gw.startFrontend(backend))
 	}
 
-	// Terminate the grpc server if the gateway server is terminated.
+	// Terminate the grpc servers if the gateway server is terminated.
 	c := make(chan os.Signal, 1)
 	signal.Notify(c, os.Interrupt)
 	go func() {
@@ -96,30 +90,45 @@ func (gw *Gateway) Run() {
 		// Release resources e.g., network ports associated with the process.
 		// This is required since gateway may receive an interrupt signal for
 		// shutdown before Wait() returns.
-		cmd.Process.Release()
-		cmd.Process.Kill()
+		for _, cmd := range cmds {
+			cmd.Process.Release()
+			cmd.Process.Kill()
+		}
 		os.Exit(0)
 	}()
 
-	// Terminate the gateway server if the grpc server is terminated.
-	go func() {
-		cmd.Wait()
-		log.Println("Shutting down gateway server since grpc server is terminated.")
-		os.Exit(cmd.ProcessState.ExitCode())
-	}()
-
-	// Wait for the grpc server to be up.
+	// Wait for the grpc servers to be up.
 	ctx := context.Background()
-	addr := gw.opts.FrontendAddress
-	if err = waitForReady(ctx, addr); err != nil {
-		log.Fatal(fmt.Errorf("Error waiting for emulator to start: %v", err))
+	for _, backend := range backends {
+		if err := waitForReady(ctx, backend); err != nil {
+			log.Fatal(fmt.Errorf("Error waiting for emulator to start: %v", err))
+		}
+	}
+
+	// Route the requests to the grpc servers by database.
+	if len(backends) > 1 {
+		router, err := NewRouter(backends)
+		if err != nil {
+			log.Fatal(err)
+		}
+		lis, err := net.Listen("tcp", addr)
+		if err != nil {
+			log.Fatal(err)
+		}
+		go func() {
+			log.Fatal(router.Serve(lis))
+		}()
+		if err = waitForReady(ctx, addr); err != nil {
+			log.Fatal(fmt.Errorf("Error waiting for router to start: %v", err))
+		}
+		log.Println("Routing databases to gRPC servers at", backends)
 	}
 
 	// Setup the gateway services.
 	mux := runtime.NewServeMux(
 		runtime.WithMarshalerOption(runtime.MIMEWildcard, &runtime.JSONPb{OrigName: false}))
 	opts := []grpc.DialOption{grpc.WithInsecure()}
-	err = spgw.RegisterSpannerHandlerFromEndpoint(ctx, mux, addr, opts)
+	err := spgw.RegisterSpannerHandlerFromEndpoint(ctx, mux, addr, opts)
 	if err != nil {
 		log.Fatal(err)
 	}
@@ -146,6 +155,65 @@ func (gw *Gateway) Run() {
 	}
 }
 
+// startFrontend starts an emulator grpc server listening at addr as a
+// subprocess, without waiting for it to be up.
+func (gw *Gateway) startFrontend(addr string) *exec.Cmd {
+	// Start the emulator grpc server and redirect its output.
+	emulatorArgs := []string{
+
+		"--host_port", addr,
+	}
+	if gw.opts.LogRequests {
+		emulatorArgs = append(emulatorArgs, "--log_requests")
+	}
+	if gw.opts.EnableFaultInjection {
+		emulatorArgs = append(emulatorArgs, "--enable_fault_injection")
+	}
+
+	cmd := exec.Command(gw.opts.FrontendBinary, emulatorArgs...)
+
+	// Proxy emulator log to gateway log.
+	if gw.opts.CopyEmulatorStdout {
+		cmd.Stdout = os.Stdout
+	}
+	if gw.opts.CopyEmulatorStderr {
+		cmd.Stderr = os.Stderr
+	}
+
+	// Start the grpc server but won't block for the grpc server to be up.
+	err := cmd.Start()
+	if err != nil {
+		log.Fatal(err)
+	}
+
+	// Terminate the gateway server if the grpc server is terminated.
+	go func() {
+		cmd.Wait()
+		log.Println("Shutting down gateway server since grpc server is terminated.")
+		os.Exit(cmd.ProcessState.ExitCode())
+	}()
+
+	return cmd
+}
+
+// backendAddresses returns the addresses of numBackends grpc servers listening
+// on the ports following the port of addr.
+func backendAddresses(addr string, numBackends int) ([]string, error) {
+	host, portString, err := net.SplitHostPort(addr)
+	if err != nil {
+		return nil, err
+	}
+	port, err := strconv.Atoi(portString)
+	if err != nil {
+		return nil, err
+	}
+	var addresses []string
+	for i := 1; i <= numBackends; i++ {
+		addresses = append(addresses, net.JoinHostPort(host, strconv.Itoa(port+i)))
+	}
+	return addresses, nil
+}
+
 func waitForReady(ctx context.Context, endpoint string) error {
 	timeout := 30 * time.Second
 	ctx, cancel := context.WithTimeout(ctx, timeout)
@@ -0,0 +1,420 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+package gateway
+
+import (
+	"context"
+	"fmt"
+	"hash/fnv"
+	"io"
+	"net"
+	"regexp"
+	"sort"
+	"strings"
+
+	"github.com/golang/protobuf/proto"
+	"google.golang.org/grpc"
+	"google.golang.org/grpc/metadata"
+)
+
+// Number of points each backend is placed at on the hash ring. More points
+// spread the databases more evenly across the backends.
+const ringPointsPerBackend = 64
+
+// routeKind identifies how the requests of a method are routed to backends.
+type routeKind int
+
+const (
+	// Routed to the backend of the database named by a field of the request.
+	// Requests which do not name a database go to the first backend.
+	routeDatabase routeKind = iota
+
+	// Routed to the backend of the database created by the statement of a
+	// CreateDatabaseRequest.
+	routeCreateDatabase
+
+	// Sent to every backend, since instances must exist on all of them. The
+	// response of the first backend is returned.
+	routeAllBackends
+
+	// Sent to every backend, with the databases of the responses merged into a
+	// single page.
+	routeListDatabases
+)
+
+// methodRoute describes how the requests of a method are routed.
+type methodRoute struct {
+	kind routeKind
+
+	// Number of the string field of the request which holds the resource name
+	// the request is routed by.
+	field uint64
+}
+
+// Prefixes of the full names of the methods of the emulator's services.
+const (
+	spanner       = "/google.spanner.v1.Spanner/"
+	databaseAdmin = "/google.spanner.admin.database.v1.DatabaseAdmin/"
+	instanceAdmin = "/google.spanner.admin.instance.v1.InstanceAdmin/"
+	operations    = "/google.longrunning.Operations/"
+)
+
+// methodRoutes lists the routes of the methods served by the emulator.
+// Methods which are not listed are served by the first backend.
+var methodRoutes = map[string]methodRoute{
+	spanner + "CreateSession":       {routeDatabase, 1},
+	spanner + "BatchCreateSessions": {routeDatabase, 1},
+	spanner + "GetSession":          {routeDatabase, 1},
+	spanner + "ListSessions":        {routeDatabase, 1},
+	spanner + "DeleteSession":       {routeDatabase, 1},
+	spanner + "ExecuteSql":          {routeDatabase, 1},
+	spanner + "ExecuteStreamingSql": {routeDatabase, 1},
+	spanner + "ExecuteBatchDml":     {routeDatabase, 1},
+	spanner + "Read":                {routeDatabase, 1},
+	spanner + "StreamingRead":       {routeDatabase, 1},
+	spanner + "BeginTransaction":    {routeDatabase, 1},
+	spanner + "Commit":              {routeDatabase, 1},
+	spanner + "Rollback":            {routeDatabase, 1},
+	spanner + "PartitionQuery":      {routeDatabase, 1},
+	spanner + "PartitionRead":       {routeDatabase, 1},
+
+	databaseAdmin + "ListDatabases":      {routeListDatabases, 0},
+	databaseAdmin + "CreateDatabase":     {routeCreateDatabase, 1},
+	databaseAdmin + "GetDatabase":        {routeDatabase, 1},
+	databaseAdmin + "UpdateDatabaseDdl":  {routeDatabase, 1},
+	databaseAdmin + "DropDatabase":       {routeDatabase, 1},
+	databaseAdmin + "GetDatabaseDdl":     {routeDatabase, 1},
+	databaseAdmin + "SetIamPolicy":       {routeDatabase, 1},
+	databaseAdmin + "GetIamPolicy":       {routeDatabase, 1},
+	databaseAdmin + "TestIamPermissions": {routeDatabase, 1},
+
+	instanceAdmin + "CreateInstance": {routeAllBackends, 0},
+	instanceAdmin + "UpdateInstance": {routeAllBackends, 0},
+	instanceAdmin + "DeleteInstance": {routeAllBackends, 0},
+	instanceAdmin + "SetIamPolicy":   {routeAllBackends, 0},
+
+	// Operations of databases are named after their database, those of
+	// instances are served by the first backend.
+	operations + "GetOperation":    {routeDatabase, 1},
+	operations + "ListOperations":  {routeDatabase, 4},
+	operations + "DeleteOperation": {routeDatabase, 1},
+	operations + "CancelOperation": {routeDatabase, 1},
+	operations + "WaitOperation":   {routeDatabase, 1},
+}
+
+// Field numbers of ListDatabasesRequest and ListDatabasesResponse.
+const (
+	listDatabasesPageSizeField      = 3
+	listDatabasesPageTokenField     = 4
+	listDatabasesNextPageTokenField = 2
+)
+
+// Matches the database id of a CREATE DATABASE statement.
+var createDatabaseRegexp = regexp.MustCompile("(?i)^\\s*CREATE\\s+DATABASE\\s+`?([^`\\s]+)`?")
+
+// frame holds a serialized message forwarded by the router as is.
+type frame struct {
+	payload []byte
+}
+
+// rawCodec passes frames through without parsing them.
+type rawCodec struct{}
+
+func (rawCodec) Marshal(v interface{}) ([]byte, error) {
+	return v.(*frame).payload, nil
+}
+
+func (rawCodec) Unmarshal(data []byte, v interface{}) error {
+	v.(*frame).payload = append([]byte(nil), data...)
+	return nil
+}
+
+func (rawCodec) String() string {
+	return "raw"
+}
+
+// Router serves the emulator grpc API by forwarding each request to one of a
+// pool of emulator grpc servers (backends). Databases are placed on backends
+// by consistent hashing of their names, so that all requests of a database,
+// and of its sessions and operations, are served by the same backend, and
+// adding a backend only moves a fraction of the databases. Instances are
+// created on every backend.
+type Router struct {
+	conns []*grpc.ClientConn
+
+	// Points of the hash ring, sorted by hash, and the backend of each.
+	ringHashes   []uint64
+	ringBackends []int
+}
+
+// NewRouter returns a router which forwards requests to the backends listening
+// at the given addresses.
+func NewRouter(addresses []string) (*Router, error) {
+	r := &Router{}
+	type point struct {
+		hash    uint64
+		backend int
+	}
+	var points []point
+	for i, address := range addresses {
+		conn, err := grpc.Dial(address, grpc.WithInsecure())
+		if err != nil {
+			r.Close()
+			return nil, err
+		}
+		r.conns = append(r.conns, conn)
+		for j := 0; j < ringPointsPerBackend; j++ {
+			points = append(points, point{hashOf(fmt.Sprintf("%s#%d", address, j)), i})
+		}
+	}
+	sort.Slice(points, func(a, b int) bool { return points[a].hash < points[b].hash })
+	for _, p := range points {
+		r.ringHashes = append(r.ringHashes, p.hash)
+		r.ringBackends = append(r.ringBackends, p.backend)
+	}
+	return r, nil
+}
+
+// Close closes the connections to the backends.
+func (r *Router) Close() {
+	for _, conn := range r.conns {
+		conn.Close()
+	}
+}
+
+// Serve accepts grpc connections on the listener and forwards their requests
+// until the listener fails.
+func (r *Router) Serve(lis net.Listener) error {
+	server := grpc.NewServer(
+		grpc.CustomCodec(rawCodec{}),
+		grpc.UnknownServiceHandler(r.handleStream))
+	return server.Serve(lis)
+}
+
+// backendOf returns the backend of the database named by (or prefixing) the
+// given resource name.
+func (r *Router) backendOf(name string) int {
+	database := databaseOf(name)
+	if database == "" {
+		return 0
+	}
+	h := hashOf(database)
+	i := sort.Search(len(r.ringHashes), func(i int) bool { return r.ringHashes[i] >= h })
+	if i == len(r.ringHashes) {
+		i = 0
+	}
+	return r.ringBackends[i]
+}
+
+func (r *Router) handleStream(srv interface{}, stream grpc.ServerStream) error {
+	method, ok := grpc.MethodFromServerStream(stream)
+	if !ok {
+		return fmt.Errorf("router failed to find the method of a request")
+	}
+	ctx := stream.Context()
+	if md, ok := metadata.FromIncomingContext(ctx); ok {
+		ctx = metadata.NewOutgoingContext(ctx, md.Copy())
+	}
+
+	// None of the methods of the emulator stream requests, so the request
+	// holds the resource name it is routed by.
+	request := &frame{}
+	if err := stream.RecvMsg(request); err != nil {
+		return err
+	}
+	route, ok := methodRoutes[method]
+	if !ok {
+		return forward(ctx, r.conns[0], method, request, stream)
+	}
+	switch route.kind {
+	case routeCreateDatabase:
+		parent, _ := stringField(request.payload, route.field)
+		statement, _ := stringField(request.payload, 2)
+		database := ""
+		if m := createDatabaseRegexp.FindStringSubmatch(statement); m != nil {
+			database = parent + "/databases/" + m[1]
+		}
+		return forward(ctx, r.conns[r.backendOf(database)], method, request, stream)
+	case routeAllBackends:
+		return r.broadcast(ctx, method, request, stream)
+	case routeListDatabases:
+		return r.listDatabases(ctx, method, request, stream)
+	default:
+		name, _ := stringField(request.payload, route.field)
+		return forward(ctx, r.conns[r.backendOf(name)], method, request, stream)
+	}
+}
+
+// broadcast sends a unary request to every backend, returning the response of
+// the first one, or the first error.
+func (r *Router) broadcast(ctx context.Context, method string, request *frame,
+	stream grpc.ServerStream) error {
+	var first *frame
+	for _, conn := range r.conns {
+		response := &frame{}
+		if err := conn.Invoke(ctx, method, request, response,
+			grpc.CallCustomCodec(rawCodec{})); err != nil {
+			return err
+		}
+		if first == nil {
+			first = response
+		}
+	}
+	return stream.SendMsg(first)
+}
+
+// listDatabases lists the databases of every backend as a single page. Each
+// backend lists all its databases, since page tokens of one backend mean
+// nothing to the others.
+func (r *Router) listDatabases(ctx context.Context, method string, request *frame,
+	stream grpc.ServerStream) error {
+	request = &frame{withoutFields(request.payload,
+		listDatabasesPageSizeField, listDatabasesPageTokenField)}
+	merged := &frame{}
+	for _, conn := range r.conns {
+		response := &frame{}
+		if err := conn.Invoke(ctx, method, request, response,
+			grpc.CallCustomCodec(rawCodec{})); err != nil {
+			return err
+		}
+		// Repeated fields of concatenated messages are appended.
+		merged.payload = append(merged.payload,
+			withoutFields(response.payload, listDatabasesNextPageTokenField)...)
+	}
+	return stream.SendMsg(merged)
+}
+
+// forward sends a request to a backend, and streams its responses, headers and
+// trailers back to the client.
+func forward(ctx context.Context, conn *grpc.ClientConn, method string, request *frame,
+	stream grpc.ServerStream) error {
+	desc := &grpc.StreamDesc{ServerStreams: true, ClientStreams: true}
+	backend, err := conn.NewStream(ctx, desc, method, grpc.CallCustomCodec(rawCodec{}))
+	if err != nil {
+		return err
+	}
+	if err := backend.SendMsg(request); err != nil && err != io.EOF {
+		return err
+	}
+	if err := backend.CloseSend(); err != nil {
+		return err
+	}
+	for i := 0; ; i++ {
+		response := &frame{}
+		err := backend.RecvMsg(response)
+		if i == 0 {
+			if md, mdErr := backend.Header(); mdErr == nil {
+				stream.SetHeader(md)
+			}
+		}
+		if err != nil {
+			stream.SetTrailer(backend.Trailer())
+			if err == io.EOF {
+				return nil
+			}
+			return err
+		}
+		if err := stream.SendMsg(response); err != nil {
+			return err
+		}
+	}
+}
+
+// databaseOf returns the name of the database which the given resource name
+// is, or is nested in, such as a session or an operation of the database.
+// Returns "" if the name is not part of a database.
+func databaseOf(name string) string {
+	parts := strings.SplitN(name, "/", 7)
+	if len(parts) < 6 || parts[0] != "projects" || parts[2] != "instances" ||
+		parts[4] != "databases" || parts[5] == "" {
+		return ""
+	}
+	return strings.Join(parts[:6], "/")
+}
+
+func hashOf(s string) uint64 {
+	h := fnv.New64a()
+	h.Write([]byte(s))
+	return h.Sum64()
+}
+
+// fieldsOf calls fn with the number, wire type and encoded bytes (including
+// the tag) of each top-level field of a serialized message, stopping at the
+// first malformed field.
+func fieldsOf(message []byte, fn func(number uint64, wireType uint64, field []byte)) {
+	for len(message) > 0 {
+		tag, n := proto.DecodeVarint(message)
+		if n == 0 {
+			return
+		}
+		size := n
+		switch tag & 7 {
+		case proto.WireVarint:
+			_, m := proto.DecodeVarint(message[size:])
+			if m == 0 {
+				return
+			}
+			size += m
+		case proto.WireFixed64:
+			size += 8
+		case proto.WireBytes:
+			length, m := proto.DecodeVarint(message[size:])
+			if m == 0 || length > uint64(len(message)) {
+				return
+			}
+			size += m + int(length)
+		case proto.WireFixed32:
+			size += 4
+		default:
+			return
+		}
+		if size > len(message) {
+			return
+		}
+		fn(tag>>3, tag&7, message[:size])
+		message = message[size:]
+	}
+}
+
+// stringField returns the last value of a string field of a serialized
+// message.
+func stringField(message []byte, number uint64) (string, bool) {
+	value, found := "", false
+	fieldsOf(message, func(n uint64, wireType uint64, field []byte) {
+		if n != number || wireType != proto.WireBytes {
+			return
+		}
+		_, tagSize := proto.DecodeVarint(field)
+		_, lengthSize := proto.DecodeVarint(field[tagSize:])
+		value, found = string(field[tagSize+lengthSize:]), true
+	})
+	return value, found
+}
+
+// withoutFields returns a serialized message without the given fields.
+func withoutFields(message []byte, numbers ...uint64) []byte {
+	var result []byte
+	fieldsOf(message, func(n uint64, wireType uint64, field []byte) {
+		for _, number := range numbers {
+			if n == number {
+				return
+			}
+		}
+		result = append(result, field...)
+	})
+	return result
+}
@@ -18,6 +18,7 @@
 
 #include <memory>
 #include <queue>
+#include <utility>
 
 #include "zetasql/public/value.h"
 #include "absl/status/status.h"
@@ -73,22 +74,24 @@ zetasql_base::StatusOr<std::unique_ptr<StorageIterator>> TestReadOnlyStore::Read
   return itr;
 }
 
-void TestEffectsBuffer::Insert(const Table* table, const Key& key,
+void TestEffectsBuffer::Insert(const Table* table, Key key,
                                const absl::Span<const Column* const> columns,
-                               const std::vector<zetasql::Value>& values) {
-  ops_queue_->push(
-      InsertOp{table, key, {columns.begin(), columns.end()}, values});
+                               std::vector<zetasql::Value> values) {
+  ops_queue_->push(InsertOp{table, std::move(key),
+                            {columns.begin(), columns.end()},
+                            std::move(values)});
 }
 
-void TestEffectsBuffer::Update(const Table* table, const Key& key,
+void TestEffectsBuffer::Update(const Table* table, Key key,
                                const absl::Span<const Column* const> columns,
-                               const std::vector<zetasql::Value>& values) {
-  ops_queue_->push(
-      UpdateOp{table, key, {columns.begin(), columns.end()}, values});
+                               std::vector<zetasql::Value> values) {
+  ops_queue_->push(UpdateOp{table, std::move(key),
+                            {columns.begin(), columns.end()},
+                            std::move(values)});
 }
 
-void TestEffectsBuffer::Delete(const Table* table, const Key& key) {
-  ops_queue_->push(DeleteOp{table, key});
+void TestEffectsBuffer::Delete(const Table* table, Key key) {
+  ops_queue_->push(DeleteOp{table, std::move(key)});
 }
 
 WriteOp ActionsTest::Insert(const Table* table, const Key& key,
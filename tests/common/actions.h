@@ -63,15 +63,15 @@ class TestEffectsBuffer : public EffectsBuffer {
   explicit TestEffectsBuffer(std::queue<WriteOp>* ops_queue)
       : ops_queue_(ops_queue) {}
 
-  void Insert(const Table* table, const Key& key,
+  void Insert(const Table* table, Key key,
               const absl::Span<const Column* const> columns,
-              const std::vector<zetasql::Value>& values) override;
+              std::vector<zetasql::Value> values) override;
 
-  void Update(const Table* table, const Key& key,
+  void Update(const Table* table, Key key,
               const absl::Span<const Column* const> columns,
-              const std::vector<zetasql::Value>& values) override;
+              std::vector<zetasql::Value> values) override;
 
-  void Delete(const Table* table, const Key& key) override;
+  void Delete(const Table* table, Key key) override;
 
   // Accessor.
   std::queue<WriteOp>* ops_queue() const { return ops_queue_; }
@@ -92,7 +92,10 @@ class ActionsTest : public testing::Test {
   test::TestEffectsBuffer* effects_buffer() {
     return dynamic_cast<test::TestEffectsBuffer*>(ctx_->effects());
   }
+  // The store may be changed through the returned pointer, so the rows cached
+  // by the context are discarded.
   test::TestReadOnlyStore* store() {
+    ctx_->ClearRowCache();
     return dynamic_cast<test::TestReadOnlyStore*>(ctx_->store());
   }
   ActionContext* ctx() { return ctx_.get(); }
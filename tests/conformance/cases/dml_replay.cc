@@ -310,6 +310,62 @@ TEST_F(DmlReplayTest, DMLRequestHashMismatchReturnsError) {
   ZETASQL_EXPECT_OK(Commit(txn.id(), &response));
 }
 
+TEST_F(DmlReplayTest, DMLRequestParamsMismatchReturnsError) {
+  spanner_api::Transaction txn;
+  ZETASQL_EXPECT_OK(BeginReadWriteTransaction(&txn));
+
+  {
+    spanner_api::ExecuteSqlRequest dml_request = PARSE_TEXT_PROTO(R"(
+      sql: "INSERT INTO Users(ID, Name) VALUES(@id, 'value') "
+      params {
+        fields {
+          key: "id"
+          value { string_value: "1" }
+        }
+      }
+      param_types {
+        key: "id"
+        value { code: INT64 }
+      }
+      seqno: 1
+    )");
+    dml_request.mutable_transaction()->set_id(txn.id());
+    dml_request.set_session(session_name_);
+
+    spanner_api::ResultSet response;
+    grpc::ClientContext context;
+    ZETASQL_EXPECT_OK(raw_client()->ExecuteSql(&context, dml_request, &response));
+  }
+
+  {
+    // The same statement with a different parameter value is not a replay.
+    spanner_api::ExecuteSqlRequest dml_request = PARSE_TEXT_PROTO(R"(
+      sql: "INSERT INTO Users(ID, Name) VALUES(@id, 'value') "
+      params {
+        fields {
+          key: "id"
+          value { string_value: "2" }
+        }
+      }
+      param_types {
+        key: "id"
+        value { code: INT64 }
+      }
+      seqno: 1
+    )");
+    dml_request.mutable_transaction()->set_id(txn.id());
+    dml_request.set_session(session_name_);
+
+    spanner_api::ResultSet response;
+    grpc::ClientContext context;
+    EXPECT_THAT(raw_client()->ExecuteSql(&context, dml_request, &response),
+                StatusIs(absl::StatusCode::kInvalidArgument));
+  }
+
+  spanner_api::CommitResponse response;
+  ZETASQL_EXPECT_OK(Commit(txn.id(), &response));
+}
+
 TEST_F(DmlReplayTest, StreamingDMLRequestHashMismatchReturnsError) {
   spanner_api::Transaction txn;
   ZETASQL_EXPECT_OK(BeginReadWriteTransaction(&txn));
@@ -193,6 +193,40 @@ TEST_F(PartitionQueryTest, CanReuseTransactionForPartitionQuery) {
   }
 }
 
+TEST_F(PartitionQueryTest, SplitsQueryIntoMaxPartitions) {
+  PopulateDatabase();
+
+  Transaction txn{Transaction::ReadOnlyOptions{}};
+
+  PartitionOptions partition_options = {.max_partitions = 3};
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::vector<QueryPartition> partitions,
+      PartitionQuery(txn, "SELECT UserID, Name FROM Users", partition_options));
+  ASSERT_EQ(partitions.size(), 3);
+
+  // Each partition scans a disjoint range of keys.
+  EXPECT_THAT(Query({partitions[0]}), IsOkAndHoldsRows({{1, "Levin"}}));
+  EXPECT_THAT(Query({partitions[1]}), IsOkAndHoldsRows({{2, "Mark"}}));
+  EXPECT_THAT(Query({partitions[2]}), IsOkAndHoldsRows({{10, "Douglas"}}));
+}
+
+TEST_F(PartitionQueryTest, SplitsFilteredQueryOfInterleavedTable) {
+  PopulateDatabase();
+
+  Transaction txn{Transaction::ReadOnlyOptions{}};
+
+  PartitionOptions partition_options = {.max_partitions = 4};
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::vector<QueryPartition> partitions,
+      PartitionQuery(txn,
+                     "SELECT UserId, ThreadId FROM Threads WHERE Starred",
+                     partition_options));
+  EXPECT_EQ(partitions.size(), 4);
+  EXPECT_THAT(Query(partitions),
+              IsOkAndHoldsUnorderedRows(
+                  {{1, 1}, {1, 2}, {1, 3}, {2, 2}}));
+}
+
 TEST_F(PartitionQueryTest, CannotQueryNonRootPartitionableSqlOrderBy) {
   PopulateDatabase();
 
@@ -202,6 +202,100 @@ TEST_F(PartitionReadsTest, CanReuseTransactionForPartitionReads) {
   }
 }
 
+TEST_F(PartitionReadsTest, SplitsReadIntoMaxPartitions) {
+  PopulateDatabase();
+
+  Transaction txn{Transaction::ReadOnlyOptions{}};
+
+  PartitionOptions partition_options = {.max_partitions = 3};
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::vector<ReadPartition> partitions,
+      PartitionRead(txn, "Users", KeySet::All(), {"UserId", "Name"},
+                    /**read_options =*/{}, partition_options));
+  ASSERT_EQ(partitions.size(), 3);
+
+  // Each partition reads a disjoint range of keys.
+  EXPECT_THAT(Read({partitions[0]}), IsOkAndHoldsRows({{1, "Levin"}}));
+  EXPECT_THAT(Read({partitions[1]}), IsOkAndHoldsRows({{2, "Mark"}}));
+  EXPECT_THAT(Read({partitions[2]}), IsOkAndHoldsRows({{10, "Douglas"}}));
+}
+
+TEST_F(PartitionReadsTest, SplitsReadOfKeyRangeIntoPartitions) {
+  PopulateDatabase();
+
+  Transaction txn{Transaction::ReadOnlyOptions{}};
+
+  PartitionOptions partition_options = {.max_partitions = 10};
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::vector<ReadPartition> partitions,
+      PartitionRead(txn, "Users", OpenClosed(Key(1), Key(10)),
+                    {"UserId", "Name"}, /**read_options =*/{},
+                    partition_options));
+
+  // There are no more partitions than rows in the requested key range.
+  EXPECT_EQ(partitions.size(), 2);
+  EXPECT_THAT(Read(partitions),
+              IsOkAndHoldsRows({{2, "Mark"}, {10, "Douglas"}}));
+}
+
+TEST_F(PartitionReadsTest, SplitsIndexReadIntoPartitions) {
+  PopulateDatabase();
+
+  Transaction txn{Transaction::ReadOnlyOptions{}};
+
+  ReadOptions read_options;
+  read_options.index_name = "UsersByName";
+  PartitionOptions partition_options = {.max_partitions = 2};
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::vector<ReadPartition> partitions,
+      PartitionRead(txn, "Users", KeySet::All(), {"UserId", "Name"},
+                    read_options, partition_options));
+  EXPECT_EQ(partitions.size(), 2);
+  EXPECT_THAT(
+      Read(partitions),
+      IsOkAndHoldsRows({{10, "Douglas"}, {1, "Levin"}, {2, "Mark"}}));
+}
+
+TEST_F(PartitionReadsTest, SplitsKeysAndRangesOfDescendingIndexRead) {
+  PopulateDatabase();
+
+  Transaction txn{Transaction::ReadOnlyOptions{}};
+
+  // Each partition reads the keys and the parts of the ranges of the key set
+  // which fall within it.
+  KeySet key_set;
+  key_set.AddKey(Key("Douglas"));
+  key_set.AddRange(ClosedClosed(Key("Mark"), Key("Levin")));
+  ReadOptions read_options;
+  read_options.index_name = "UsersByNameDescending";
+  PartitionOptions partition_options = {.max_partitions = 3};
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::vector<ReadPartition> partitions,
+      PartitionRead(txn, "Users", key_set, {"UserId", "Name"}, read_options,
+                    partition_options));
+  EXPECT_EQ(partitions.size(), 3);
+  EXPECT_THAT(
+      Read(partitions),
+      IsOkAndHoldsUnorderedRows({{2, "Mark"}, {1, "Levin"}, {10, "Douglas"}}));
+}
+
+TEST_F(PartitionReadsTest, SplitsReadByPartitionSize) {
+  PopulateDatabase();
+
+  Transaction txn{Transaction::ReadOnlyOptions{}};
+
+  // A partition size of one byte puts every row in its own partition.
+  PartitionOptions partition_options = {.partition_size_bytes = 1};
+  ZETASQL_ASSERT_OK_AND_ASSIGN(
+      std::vector<ReadPartition> partitions,
+      PartitionRead(txn, "Users", KeySet::All(), {"UserId", "Name"},
+                    /**read_options =*/{}, partition_options));
+  EXPECT_EQ(partitions.size(), 3);
+  EXPECT_THAT(
+      Read(partitions),
+      IsOkAndHoldsRows({{1, "Levin"}, {2, "Mark"}, {10, "Douglas"}}));
+}
+
 TEST_F(PartitionReadsTest, CannotSetReadLimitWithPartitionToken) {
   ZETASQL_ASSERT_OK_AND_ASSIGN(auto session, CreateSession());
 
@@ -14,6 +14,14 @@
 // limitations under the License.
 //
 
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/testing/status_matchers.h"
+#include "tests/common/proto_matchers.h"
+#include "absl/status/status.h"
 #include "tests/conformance/common/database_test_base.h"
 
 namespace google {
@@ -21,7 +29,60 @@ namespace spanner {
 namespace emulator {
 namespace test {
 
-namespace {}  // namespace
+namespace {
+
+using zetasql_base::testing::IsOkAndHolds;
+
+class ThreadSafetyTest : public DatabaseTest {
+ public:
+  absl::Status SetUpDatabase() override {
+    return SetSchema({R"(
+      CREATE TABLE Users(
+        ID   INT64 NOT NULL,
+        Name STRING(MAX),
+      ) PRIMARY KEY (ID)
+    )"});
+  }
+};
+
+TEST_F(ThreadSafetyTest, ParallelReadsInMultiUseSnapshotTransaction) {
+  // Number of reads and queries issued concurrently on the same transaction.
+  constexpr int kNumThreads = 16;
+  constexpr int kNumRows = 100;
+  std::vector<ValueRow> rows;
+  for (int i = 0; i < kNumRows; ++i) {
+    ZETASQL_ASSERT_OK(Insert("Users", {"ID", "Name"}, {i, "user"}));
+    rows.push_back(ValueRow{i, "user"});
+  }
+
+  // Begin the transaction with a first read so that all the parallel reads
+  // use the same snapshot.
+  auto txn = Transaction(Transaction::ReadOnlyOptions());
+  EXPECT_THAT(Read("Users", {"ID", "Name"}, KeySet::All(), txn),
+              IsOkAndHolds(testing::ElementsAreArray(rows)));
+
+  // Rows inserted after the snapshot are not visible to its reads.
+  ZETASQL_ASSERT_OK(Insert("Users", {"ID", "Name"}, {kNumRows, "user"}));
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&, i]() {
+      if (i % 2 == 0) {
+        EXPECT_THAT(Read("Users", {"ID", "Name"}, KeySet::All(), txn),
+                    IsOkAndHolds(testing::ElementsAreArray(rows)));
+      } else {
+        EXPECT_THAT(
+            QueryTransaction(txn, "SELECT ID, Name FROM Users ORDER BY ID"),
+            IsOkAndHolds(testing::ElementsAreArray(rows)));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace
 
 }  // namespace test
 }  // namespace emulator
@@ -16,7 +16,12 @@
 
 #include "tests/conformance/common/database_test_base.h"
 
+#include <unistd.h>
+
+#include <atomic>
 #include <chrono>  // NOLINT(build/c++11)
+#include <cstdint>
+#include <string>
 #include <vector>
 
 #include "absl/memory/memory.h"
@@ -50,6 +55,21 @@ namespace test {
 using ::google::cloud::spanner::internal::CreateDefaultDatabaseAdminStub;
 using ::google::cloud::spanner::internal::MakeDatabaseAdminConnection;
 
+namespace {
+
+// Returns a database id that is unique across the tests of this process and
+// across processes sharing the same instance, so that conformance tests can be
+// run in parallel (by several threads or sharded binaries) against one
+// emulator. Cloud Spanner limits database ids to 30 characters, so the parts
+// are hex encoded.
+std::string NewDatabaseId() {
+  static std::atomic<int64_t> counter(0);
+  return absl::StrCat("test-", absl::Hex(absl::ToUnixSeconds(absl::Now())),
+                      "-", absl::Hex(getpid()), "-", absl::Hex(counter++));
+}
+
+}  // namespace
+
 void DatabaseTest::SetUp() {
   // Get the global environment in which the test runs.
   const ConformanceTestGlobals& globals = GetConformanceTestGlobals();
@@ -71,7 +91,7 @@ void DatabaseTest::SetUp() {
   // Pick a unique database name for every test (reuse the instance).
   database_ = absl::make_unique<google::cloud::spanner::Database>(
       google::cloud::spanner::Instance(globals.project_id, globals.instance_id),
-      absl::StrCat("test-database-", absl::ToUnixMicros(absl::Now())));
+      NewDatabaseId());
 
   // Setup the database client.
   database_client_ = absl::make_unique<cloud::spanner::DatabaseAdminClient>(
@@ -106,7 +126,7 @@ absl::Status DatabaseTest::ResetDatabase() {
   ZETASQL_RETURN_IF_ERROR(ToUtilStatus(database_client_->DropDatabase(*database_)));
   database_ = absl::make_unique<google::cloud::spanner::Database>(
       google::cloud::spanner::Instance(globals.project_id, globals.instance_id),
-      absl::StrCat("test-database-", absl::ToUnixMicros(absl::Now())));
+      NewDatabaseId());
   return ToUtilStatus(
       database_client_->CreateDatabase(*database_).get().status());
 }
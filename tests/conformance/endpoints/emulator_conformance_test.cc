@@ -14,6 +14,10 @@
 // limitations under the License.
 //
 
+#include <memory>
+#include <string>
+#include <utility>
+
 #include "zetasql/base/logging.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -21,11 +25,20 @@
 #include "tests/common/proto_matchers.h"
 #include "google/cloud/spanner/create_instance_request_builder.h"
 #include "google/cloud/spanner/instance_admin_client.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/status.h"
 #include "common/feature_flags.h"
 #include "frontend/server/server.h"
 #include "tests/common/scoped_feature_flags_setter.h"
 #include "tests/conformance/common/environment.h"
 
+ABSL_FLAG(std::string, emulator_endpoint, "",
+          "Address (host:port) of an already running emulator to run the "
+          "tests against. If empty, the tests start an emulator in-process. "
+          "Used by the parallel runner to share one emulator between several "
+          "test processes.");
+
 namespace google {
 namespace spanner {
 namespace emulator {
@@ -48,34 +61,44 @@ constexpr char kInstanceConfigName[] = "test-config";
 class EmulatorConformanceTestEnvironment : public testing::Environment {
  public:
   void SetUp() override {
-    // Setup emulator server.
-    frontend::Server::Options options;
-    options.server_address = "localhost:0";
-    server_ = frontend::Server::Create(options);
-    ASSERT_NE(server_, nullptr);
+    // Setup emulator server, unless the tests share an external one.
+    std::string endpoint = absl::GetFlag(FLAGS_emulator_endpoint);
+    if (endpoint.empty()) {
+      frontend::Server::Options options;
+      options.server_address = "localhost:0";
+      server_ = frontend::Server::Create(options);
+      ASSERT_NE(server_, nullptr);
+      endpoint = absl::StrCat(server_->host(), ":", server_->port());
+    }
 
     // Initialize connection options required by the client library.
     auto connection_options =
         absl::make_unique<google::cloud::spanner::ConnectionOptions>(
             grpc::InsecureChannelCredentials());
-    connection_options->set_endpoint(
-        absl::StrCat(server_->host(), ":", server_->port()));
+    connection_options->set_endpoint(endpoint);
 
-    // Setup an instance which will be reused for all tests.
+    // Setup an instance which will be reused for all tests. Processes sharing
+    // an external emulator race to create it, so it may already exist.
     google::cloud::spanner::Instance instance(kProjectName, kInstanceName);
     auto instance_client =
         absl::make_unique<google::cloud::spanner::InstanceAdminClient>(
             google::cloud::spanner::MakeInstanceAdminConnection(
                 *connection_options));
-    ZETASQL_ASSERT_OK(google::spanner::emulator::test::ToUtilStatusOr(
-        instance_client
-            ->CreateInstance(
-                google::cloud::spanner::CreateInstanceRequestBuilder(
-                    instance, kInstanceConfigName)
-                    .SetDisplayName(kInstanceConfigName)
-                    .SetNodeCount(1)
-                    .Build())
-            .get()));
+    absl::Status status =
+        google::spanner::emulator::test::ToUtilStatusOr(
+            instance_client
+                ->CreateInstance(
+                    google::cloud::spanner::CreateInstanceRequestBuilder(
+                        instance, kInstanceConfigName)
+                        .SetDisplayName(kInstanceConfigName)
+                        .SetNodeCount(1)
+                        .Build())
+                .get())
+            .status();
+    if (server_ != nullptr ||
+        status.code() != absl::StatusCode::kAlreadyExists) {
+      ZETASQL_ASSERT_OK(status);
+    }
 
     // Set globals for the test.
     globals_ = absl::make_unique<ConformanceTestGlobals>();
@@ -92,7 +115,7 @@ class EmulatorConformanceTestEnvironment : public testing::Environment {
   }
 
  private:
-  // Emulator gRPC server.
+  // Emulator gRPC server, null when running against --emulator_endpoint.
   std::unique_ptr<frontend::Server> server_;
 
   // Globals that need to be provided by a conformance test endpoint.
@@ -108,6 +131,7 @@ class EmulatorConformanceTestEnvironment : public testing::Environment {
 
 int main(int argc, char* argv[]) {
   testing::InitGoogleTest(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
   testing::AddGlobalTestEnvironment(new google::spanner::emulator::test::
                                         EmulatorConformanceTestEnvironment());
   return RUN_ALL_TESTS();
@@ -0,0 +1,218 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+// Runs the emulator conformance tests in parallel against a single emulator.
+//
+// The emulator is started in this process and the conformance test binary is
+// launched --shards times, each process running one gtest shard of the cases
+// against the shared emulator. Every conformance test creates its own
+// database, so the shards are isolated from each other while exercising the
+// emulator's storage, locking and transaction code concurrently.
+//
+// With --replicas > 1 every shard is launched that many times, so that each
+// case is replayed concurrently against the same emulator (on distinct
+// databases), which makes this a stress test for the emulator's concurrency.
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "common/feature_flags.h"
+#include "frontend/server/server.h"
+#include "tests/common/scoped_feature_flags_setter.h"
+
+ABSL_FLAG(std::string, conformance_test, "",
+          "Path to the emulator_conformance_test binary.");
+ABSL_FLAG(int, shards, 8,
+          "Number of test processes the conformance cases are split across.");
+ABSL_FLAG(int, replicas, 1,
+          "Number of concurrent processes running each shard.");
+ABSL_FLAG(int, repeat, 1,
+          "Number of times each process repeats its cases (--gtest_repeat).");
+
+extern char** environ;
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace test {
+
+namespace {
+
+// Environment variables which are set by the test runner for this process and
+// must not be inherited by the children, which are sharded by this runner and
+// whose results are reported through this process.
+constexpr const char* kUninheritedEnvPrefixes[] = {
+    "GTEST_",
+    "TEST_SHARD_",
+    "TEST_TOTAL_SHARDS",
+    "TEST_PREMATURE_EXIT_FILE",
+    "XML_OUTPUT_FILE",
+};
+
+// A conformance test process launched by the runner.
+struct Child {
+  int shard;
+  int replica;
+  std::string log_path;
+  pid_t pid = -1;
+};
+
+// Returns the directory in which the output of the children is written.
+std::string LogDir() {
+  const char* dir = std::getenv("TEST_UNDECLARED_OUTPUTS_DIR");
+  if (dir == nullptr) dir = std::getenv("TEST_TMPDIR");
+  return dir != nullptr ? dir : "/tmp";
+}
+
+// Returns the environment of a child running `shard` of `num_shards`.
+std::vector<std::string> ChildEnvironment(int shard, int num_shards) {
+  std::vector<std::string> env;
+  for (char** var = environ; *var != nullptr; ++var) {
+    bool inherited = true;
+    for (const char* prefix : kUninheritedEnvPrefixes) {
+      if (absl::StartsWith(*var, prefix)) {
+        inherited = false;
+        break;
+      }
+    }
+    if (inherited) env.push_back(*var);
+  }
+  env.push_back(absl::StrCat("GTEST_TOTAL_SHARDS=", num_shards));
+  env.push_back(absl::StrCat("GTEST_SHARD_INDEX=", shard));
+  return env;
+}
+
+// Converts `strings` to the null-terminated array expected by posix_spawn.
+std::vector<char*> ToArgv(std::vector<std::string>* strings) {
+  std::vector<char*> argv;
+  for (std::string& s : *strings) argv.push_back(&s[0]);
+  argv.push_back(nullptr);
+  return argv;
+}
+
+// Launches `child`, with its output redirected to `child->log_path`. Returns
+// false if the process could not be started.
+bool Launch(const std::string& binary, const std::string& endpoint,
+            int num_shards, Child* child) {
+  std::vector<std::string> args = {
+      binary,
+      absl::StrCat("--emulator_endpoint=", endpoint),
+      absl::StrCat("--gtest_repeat=", absl::GetFlag(FLAGS_repeat)),
+  };
+  std::vector<std::string> env = ChildEnvironment(child->shard, num_shards);
+  std::vector<char*> argv = ToArgv(&args);
+  std::vector<char*> envp = ToArgv(&env);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO,
+                                   child->log_path.c_str(),
+                                   O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+  int error = posix_spawn(&child->pid, binary.c_str(), &actions, nullptr,
+                          argv.data(), envp.data());
+  posix_spawn_file_actions_destroy(&actions);
+  if (error != 0) {
+    child->pid = -1;
+    return false;
+  }
+  return true;
+}
+
+// Returns the contents of the file at `path`.
+std::string ReadLog(const std::string& path) {
+  std::ifstream file(path);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+TEST(ParallelConformanceTest, AllShardsPass) {
+  const std::string binary = absl::GetFlag(FLAGS_conformance_test);
+  ASSERT_FALSE(binary.empty()) << "--conformance_test must be set";
+  const int num_shards = absl::GetFlag(FLAGS_shards);
+  const int num_replicas = absl::GetFlag(FLAGS_replicas);
+  ASSERT_GT(num_shards, 0);
+  ASSERT_GT(num_replicas, 0);
+
+  // The emulator shared by all the test processes. Feature flags are process
+  // wide, so they are set here to match the in-process conformance endpoint.
+  EmulatorFeatureFlags::Flags flags;
+  flags.enable_stored_generated_columns = true;
+  flags.enable_numeric_type = true;
+  ScopedEmulatorFeatureFlagsSetter feature_flags(flags);
+  frontend::Server::Options options;
+  options.server_address = "localhost:0";
+  std::unique_ptr<frontend::Server> server = frontend::Server::Create(options);
+  ASSERT_NE(server, nullptr);
+  const std::string endpoint =
+      absl::StrCat(server->host(), ":", server->port());
+
+  std::vector<Child> children;
+  for (int shard = 0; shard < num_shards; ++shard) {
+    for (int replica = 0; replica < num_replicas; ++replica) {
+      Child child;
+      child.shard = shard;
+      child.replica = replica;
+      child.log_path = absl::StrCat(LogDir(), "/conformance_shard_", shard,
+                                    "_replica_", replica, ".log");
+      children.push_back(child);
+    }
+  }
+  for (Child& child : children) {
+    EXPECT_TRUE(Launch(binary, endpoint, num_shards, &child))
+        << "Failed to launch " << binary;
+  }
+
+  for (Child& child : children) {
+    if (child.pid < 0) continue;
+    int status = 0;
+    ASSERT_EQ(waitpid(child.pid, &status, 0), child.pid);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        << "Shard " << child.shard << " (replica " << child.replica
+        << ") failed with status " << status << ":\n"
+        << ReadLog(child.log_path);
+  }
+}
+
+}  // namespace
+
+}  // namespace test
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+int main(int argc, char* argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  return RUN_ALL_TESTS();
+}
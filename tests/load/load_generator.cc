@@ -0,0 +1,536 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Generates load against a running emulator through its gRPC API and reports
+// the throughput and latency of each RPC.
+//
+// Each of --num_sessions threads creates a session and issues the operations
+// of the chosen workload back to back for --duration:
+//
+//   ycsb:      point operations on a table of --num_rows rows: 50% reads, 20%
+//              queries, 20% single row commits and 10% read-write transactions
+//              updating a row through batch DML.
+//   scan:      reads and queries of --rows_per_scan consecutive rows, and
+//              partitioned queries of the whole table, each partition of which
+//              is then executed.
+//   bulk_load: commits inserting --rows_per_commit new rows.
+//
+// Usage: load_generator [--endpoint=localhost:10007] [--workload=ycsb]
+//            [--num_sessions=16] [--duration=10s] [--num_rows=10000]
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "google/longrunning/operations.grpc.pb.h"
+#include "google/longrunning/operations.pb.h"
+#include "google/protobuf/struct.pb.h"
+#include "google/spanner/admin/database/v1/spanner_database_admin.grpc.pb.h"
+#include "google/spanner/admin/instance/v1/spanner_instance_admin.grpc.pb.h"
+#include "google/spanner/v1/spanner.grpc.pb.h"
+#include "grpcpp/grpcpp.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/memory/memory.h"
+#include "absl/random/random.h"
+#include "zetasql/base/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+ABSL_FLAG(std::string, endpoint, "localhost:10007",
+          "Host and port of the emulator's gRPC server.");
+ABSL_FLAG(std::string, project, "load-project", "Project of the instance.");
+ABSL_FLAG(std::string, instance, "load-instance",
+          "Instance to create, or reuse if it already exists.");
+ABSL_FLAG(std::string, workload, "ycsb",
+          "Workload to run: ycsb, scan or bulk_load.");
+ABSL_FLAG(int, num_sessions, 16,
+          "Number of sessions issuing operations concurrently, each from its "
+          "own thread.");
+ABSL_FLAG(absl::Duration, duration, absl::Seconds(10),
+          "Time spent running the workload, after the table is loaded.");
+ABSL_FLAG(int64_t, num_rows, 10000, "Number of rows loaded into the table.");
+ABSL_FLAG(int64_t, rows_per_scan, 1000,
+          "Number of rows read by each read or query of the scan workload.");
+ABSL_FLAG(int64_t, rows_per_commit, 1000,
+          "Number of rows inserted by each commit of the bulk_load workload, "
+          "and of the initial load of the table.");
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace test {
+
+namespace {
+
+namespace database_api = ::google::spanner::admin::database::v1;
+namespace instance_api = ::google::spanner::admin::instance::v1;
+namespace spanner_api = ::google::spanner::v1;
+
+using SpannerStub = spanner_api::Spanner::Stub;
+
+constexpr char kTableName[] = "usertable";
+
+// Size of the values of each of the non-key columns of the table.
+constexpr int kFieldSize = 100;
+
+absl::Status FromGrpcStatus(const grpc::Status& status) {
+  return absl::Status(static_cast<absl::StatusCode>(status.error_code()),
+                      status.error_message());
+}
+
+// The latencies of the calls to an RPC, and the number of failed calls.
+struct RpcStats {
+  std::vector<absl::Duration> latencies;
+  int64_t errors = 0;
+};
+
+// Statistics of each RPC, keyed by RPC name.
+using Stats = std::map<std::string, RpcStats>;
+
+// Returns the latency which a fraction `q` of the sorted latencies are below.
+absl::Duration Percentile(const std::vector<absl::Duration>& sorted,
+                          double q) {
+  if (sorted.empty()) {
+    return absl::ZeroDuration();
+  }
+  size_t index =
+      std::min(sorted.size() - 1, static_cast<size_t>(q * sorted.size()));
+  return sorted[index];
+}
+
+google::protobuf::Value Int64Value(int64_t value) {
+  // INT64 values are encoded as strings.
+  google::protobuf::Value proto;
+  proto.set_string_value(absl::StrCat(value));
+  return proto;
+}
+
+google::protobuf::Value StringValue(const std::string& value) {
+  google::protobuf::Value proto;
+  proto.set_string_value(value);
+  return proto;
+}
+
+const std::vector<std::string>& Columns() {
+  static const auto* columns =
+      new std::vector<std::string>{"key", "field0", "field1"};
+  return *columns;
+}
+
+// Returns the row of the table with the given key, as the values of Columns().
+google::protobuf::ListValue MakeRow(int64_t key) {
+  google::protobuf::ListValue row;
+  *row.add_values() = Int64Value(key);
+  *row.add_values() = StringValue(std::string(kFieldSize, 'a' + key % 26));
+  *row.add_values() = StringValue(std::string(kFieldSize, 'z' - key % 26));
+  return row;
+}
+
+// Sets an INT64 parameter of a query or DML statement.
+template <typename Request>
+void SetInt64Param(const std::string& name, int64_t value, Request* request) {
+  (*request->mutable_params()->mutable_fields())[name] = Int64Value(value);
+  (*request->mutable_param_types())[name].set_code(spanner_api::INT64);
+}
+
+// LoadSession issues the operations of a workload through a single session,
+// recording the latency of every RPC it makes.
+class LoadSession {
+ public:
+  LoadSession(SpannerStub* stub, const std::string& database_uri)
+      : stub_(stub), database_uri_(database_uri) {}
+
+  absl::Status Create() {
+    spanner_api::CreateSessionRequest request;
+    request.set_database(database_uri_);
+    spanner_api::Session session;
+    ZETASQL_RETURN_IF_ERROR(
+        Call("CreateSession", [&](grpc::ClientContext* context) {
+          return stub_->CreateSession(context, request, &session);
+        }));
+    session_ = session.name();
+    return absl::OkStatus();
+  }
+
+  // Inserts or updates the rows [start, start + count) in a single commit.
+  absl::Status Upsert(int64_t start, int64_t count) {
+    spanner_api::CommitRequest request;
+    request.set_session(session_);
+    request.mutable_single_use_transaction()->mutable_read_write();
+    spanner_api::Mutation::Write* write =
+        request.add_mutations()->mutable_insert_or_update();
+    write->set_table(kTableName);
+    for (const std::string& column : Columns()) {
+      write->add_columns(column);
+    }
+    for (int64_t key = start; key < start + count; ++key) {
+      *write->add_values() = MakeRow(key);
+    }
+    spanner_api::CommitResponse response;
+    return Call("Commit", [&](grpc::ClientContext* context) {
+      return stub_->Commit(context, request, &response);
+    });
+  }
+
+  // Reads the rows [start, start + count) with a strong read.
+  absl::Status Read(int64_t start, int64_t count) {
+    spanner_api::ReadRequest request;
+    request.set_session(session_);
+    request.mutable_transaction()
+        ->mutable_single_use()
+        ->mutable_read_only()
+        ->set_strong(true);
+    request.set_table(kTableName);
+    for (const std::string& column : Columns()) {
+      request.add_columns(column);
+    }
+    if (count == 1) {
+      *request.mutable_key_set()->add_keys()->add_values() = Int64Value(start);
+    } else {
+      spanner_api::KeyRange* range = request.mutable_key_set()->add_ranges();
+      *range->mutable_start_closed()->add_values() = Int64Value(start);
+      *range->mutable_end_open()->add_values() = Int64Value(start + count);
+    }
+    spanner_api::ResultSet response;
+    return Call("Read", [&](grpc::ClientContext* context) {
+      return stub_->Read(context, request, &response);
+    });
+  }
+
+  // Queries the rows [start, start + count) with a strong read.
+  absl::Status Query(int64_t start, int64_t count) {
+    spanner_api::ExecuteSqlRequest request;
+    request.set_session(session_);
+    request.mutable_transaction()
+        ->mutable_single_use()
+        ->mutable_read_only()
+        ->set_strong(true);
+    request.set_sql(
+        "SELECT key, field0, field1 FROM usertable "
+        "WHERE key >= @start AND key < @limit");
+    SetInt64Param("start", start, &request);
+    SetInt64Param("limit", start + count, &request);
+    spanner_api::ResultSet response;
+    return Call("ExecuteSql", [&](grpc::ClientContext* context) {
+      return stub_->ExecuteSql(context, request, &response);
+    });
+  }
+
+  // Updates a row with batch DML in a read-write transaction.
+  absl::Status UpdateWithDml(int64_t key) {
+    spanner_api::BeginTransactionRequest begin_request;
+    begin_request.set_session(session_);
+    begin_request.mutable_options()->mutable_read_write();
+    spanner_api::Transaction transaction;
+    ZETASQL_RETURN_IF_ERROR(
+        Call("BeginTransaction", [&](grpc::ClientContext* context) {
+          return stub_->BeginTransaction(context, begin_request, &transaction);
+        }));
+
+    spanner_api::ExecuteBatchDmlRequest dml_request;
+    dml_request.set_session(session_);
+    dml_request.mutable_transaction()->set_id(transaction.id());
+    dml_request.set_seqno(1);
+    spanner_api::ExecuteBatchDmlRequest::Statement* statement =
+        dml_request.add_statements();
+    statement->set_sql("UPDATE usertable SET field0 = field1 WHERE key = @key");
+    SetInt64Param("key", key, statement);
+    spanner_api::ExecuteBatchDmlResponse dml_response;
+    ZETASQL_RETURN_IF_ERROR(
+        Call("ExecuteBatchDml", [&](grpc::ClientContext* context) {
+          return stub_->ExecuteBatchDml(context, dml_request, &dml_response);
+        }));
+
+    spanner_api::CommitRequest commit_request;
+    commit_request.set_session(session_);
+    commit_request.set_transaction_id(transaction.id());
+    spanner_api::CommitResponse commit_response;
+    return Call("Commit", [&](grpc::ClientContext* context) {
+      return stub_->Commit(context, commit_request, &commit_response);
+    });
+  }
+
+  // Partitions a query of the whole table, and executes each partition.
+  absl::Status PartitionedQuery() {
+    spanner_api::PartitionQueryRequest partition_request;
+    partition_request.set_session(session_);
+    partition_request.mutable_transaction()
+        ->mutable_begin()
+        ->mutable_read_only()
+        ->set_strong(true);
+    partition_request.set_sql("SELECT key, field0, field1 FROM usertable");
+    spanner_api::PartitionResponse partition_response;
+    ZETASQL_RETURN_IF_ERROR(
+        Call("PartitionQuery", [&](grpc::ClientContext* context) {
+          return stub_->PartitionQuery(context, partition_request,
+                                       &partition_response);
+        }));
+
+    for (const spanner_api::Partition& partition :
+         partition_response.partitions()) {
+      spanner_api::ExecuteSqlRequest request;
+      request.set_session(session_);
+      request.mutable_transaction()->set_id(
+          partition_response.transaction().id());
+      request.set_sql(partition_request.sql());
+      request.set_partition_token(partition.partition_token());
+      spanner_api::ResultSet response;
+      ZETASQL_RETURN_IF_ERROR(
+          Call("ExecuteSql", [&](grpc::ClientContext* context) {
+            return stub_->ExecuteSql(context, request, &response);
+          }));
+    }
+    return absl::OkStatus();
+  }
+
+  const Stats& stats() const { return stats_; }
+
+ private:
+  // Makes an RPC through `rpc_fn` and records its latency under `rpc`.
+  absl::Status Call(
+      const std::string& rpc,
+      const std::function<grpc::Status(grpc::ClientContext*)>& rpc_fn) {
+    grpc::ClientContext context;
+    absl::Time start = absl::Now();
+    grpc::Status status = rpc_fn(&context);
+    RpcStats& stats = stats_[rpc];
+    stats.latencies.push_back(absl::Now() - start);
+    if (!status.ok()) {
+      ++stats.errors;
+    }
+    return FromGrpcStatus(status);
+  }
+
+  SpannerStub* stub_;
+  const std::string database_uri_;
+  std::string session_;
+  Stats stats_;
+};
+
+// Runs one operation of the workload. Operations which fail, for example
+// because their transaction was aborted, are counted as errors of the failing
+// RPC and do not stop the workload.
+void RunOperation(const std::string& workload, LoadSession* session,
+                  std::atomic<int64_t>* next_key, absl::BitGen* gen) {
+  const int64_t num_rows = absl::GetFlag(FLAGS_num_rows);
+  const int percent = absl::Uniform<int>(*gen, 0, 100);
+  if (workload == "bulk_load") {
+    const int64_t count = absl::GetFlag(FLAGS_rows_per_commit);
+    session->Upsert(next_key->fetch_add(count), count).IgnoreError();
+  } else if (workload == "scan") {
+    const int64_t count = absl::GetFlag(FLAGS_rows_per_scan);
+    const int64_t start = absl::Uniform<int64_t>(
+        *gen, 0, std::max<int64_t>(1, num_rows - count));
+    if (percent < 40) {
+      session->Read(start, count).IgnoreError();
+    } else if (percent < 80) {
+      session->Query(start, count).IgnoreError();
+    } else {
+      session->PartitionedQuery().IgnoreError();
+    }
+  } else {
+    const int64_t key = absl::Uniform<int64_t>(*gen, 0, num_rows);
+    if (percent < 50) {
+      session->Read(key, 1).IgnoreError();
+    } else if (percent < 70) {
+      session->Query(key, 1).IgnoreError();
+    } else if (percent < 90) {
+      session->Upsert(key, 1).IgnoreError();
+    } else {
+      session->UpdateWithDml(key).IgnoreError();
+    }
+  }
+}
+
+// Creates the instance, if it does not exist yet, and a new database with the
+// table of the workloads. Returns the URI of the database.
+zetasql_base::StatusOr<std::string> CreateDatabase(
+    const std::shared_ptr<grpc::Channel>& channel) {
+  const std::string project_uri =
+      absl::StrCat("projects/", absl::GetFlag(FLAGS_project));
+  const std::string instance_uri =
+      absl::StrCat(project_uri, "/instances/", absl::GetFlag(FLAGS_instance));
+
+  auto instance_stub = instance_api::InstanceAdmin::NewStub(channel);
+  instance_api::CreateInstanceRequest instance_request;
+  instance_request.set_parent(project_uri);
+  instance_request.set_instance_id(absl::GetFlag(FLAGS_instance));
+  instance_request.mutable_instance()->set_config(
+      absl::StrCat(project_uri, "/instanceConfigs/emulator-config"));
+  instance_request.mutable_instance()->set_display_name("Load test");
+  instance_request.mutable_instance()->set_node_count(1);
+  longrunning::Operation operation;
+  {
+    grpc::ClientContext context;
+    grpc::Status status =
+        instance_stub->CreateInstance(&context, instance_request, &operation);
+    if (!status.ok() && status.error_code() != grpc::ALREADY_EXISTS) {
+      return FromGrpcStatus(status);
+    }
+  }
+
+  // Each run creates a database of its own, so that runs do not see the rows
+  // of earlier ones.
+  const std::string database_id =
+      absl::StrCat("load-", absl::ToUnixMicros(absl::Now()));
+  auto database_stub = database_api::DatabaseAdmin::NewStub(channel);
+  database_api::CreateDatabaseRequest database_request;
+  database_request.set_parent(instance_uri);
+  database_request.set_create_statement(
+      absl::StrCat("CREATE DATABASE `", database_id, "`"));
+  database_request.add_extra_statements(
+      "CREATE TABLE usertable ("
+      "  key INT64 NOT NULL,"
+      "  field0 STRING(MAX),"
+      "  field1 STRING(MAX),"
+      ") PRIMARY KEY (key)");
+  {
+    grpc::ClientContext context;
+    ZETASQL_RETURN_IF_ERROR(FromGrpcStatus(
+        database_stub->CreateDatabase(&context, database_request, &operation)));
+  }
+
+  // The database is created in the background; wait for the operation before
+  // starting the workloads.
+  auto operations_stub = longrunning::Operations::NewStub(channel);
+  while (!operation.done()) {
+    absl::SleepFor(absl::Milliseconds(10));
+    longrunning::GetOperationRequest operation_request;
+    operation_request.set_name(operation.name());
+    grpc::ClientContext context;
+    ZETASQL_RETURN_IF_ERROR(FromGrpcStatus(operations_stub->GetOperation(
+        &context, operation_request, &operation)));
+  }
+  if (operation.has_error()) {
+    return absl::Status(
+        static_cast<absl::StatusCode>(operation.error().code()),
+        operation.error().message());
+  }
+  return absl::StrCat(instance_uri, "/databases/", database_id);
+}
+
+void PrintStats(const Stats& stats, absl::Duration elapsed) {
+  std::printf("%-18s %10s %10s %10s %10s %10s %8s\n", "rpc", "calls", "qps",
+              "p50 ms", "p99 ms", "p999 ms", "errors");
+  for (const auto& [rpc, rpc_stats] : stats) {
+    std::vector<absl::Duration> latencies = rpc_stats.latencies;
+    std::sort(latencies.begin(), latencies.end());
+    std::printf("%-18s %10zu %10.0f %10.3f %10.3f %10.3f %8lld\n", rpc.c_str(),
+                latencies.size(),
+                latencies.size() / absl::ToDoubleSeconds(elapsed),
+                absl::ToDoubleMilliseconds(Percentile(latencies, 0.5)),
+                absl::ToDoubleMilliseconds(Percentile(latencies, 0.99)),
+                absl::ToDoubleMilliseconds(Percentile(latencies, 0.999)),
+                static_cast<long long>(rpc_stats.errors));  // NOLINT
+  }
+}
+
+absl::Status RunLoad() {
+  const std::string workload = absl::GetFlag(FLAGS_workload);
+  if (workload != "ycsb" && workload != "scan" && workload != "bulk_load") {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Unknown workload: ", workload));
+  }
+  std::shared_ptr<grpc::Channel> channel = grpc::CreateChannel(
+      absl::GetFlag(FLAGS_endpoint), grpc::InsecureChannelCredentials());
+  std::unique_ptr<SpannerStub> stub = spanner_api::Spanner::NewStub(channel);
+  ZETASQL_ASSIGN_OR_RETURN(std::string database_uri, CreateDatabase(channel));
+
+  // Load the table before the workload starts.
+  const int64_t num_rows = absl::GetFlag(FLAGS_num_rows);
+  const int64_t rows_per_commit = absl::GetFlag(FLAGS_rows_per_commit);
+  LoadSession loader(stub.get(), database_uri);
+  ZETASQL_RETURN_IF_ERROR(loader.Create());
+  for (int64_t start = 0; start < num_rows; start += rows_per_commit) {
+    ZETASQL_RETURN_IF_ERROR(
+        loader.Upsert(start, std::min(rows_per_commit, num_rows - start)));
+  }
+
+  const int num_sessions = absl::GetFlag(FLAGS_num_sessions);
+  std::vector<std::unique_ptr<LoadSession>> sessions;
+  for (int i = 0; i < num_sessions; ++i) {
+    sessions.push_back(
+        absl::make_unique<LoadSession>(stub.get(), database_uri));
+    ZETASQL_RETURN_IF_ERROR(sessions.back()->Create());
+  }
+
+  std::atomic<bool> done(false);
+  std::atomic<int64_t> next_key(num_rows);
+  std::vector<std::thread> threads;
+  absl::Time start = absl::Now();
+  for (const std::unique_ptr<LoadSession>& session : sessions) {
+    threads.emplace_back([&, session = session.get()]() {
+      absl::BitGen gen;
+      while (!done.load(std::memory_order_relaxed)) {
+        RunOperation(workload, session, &next_key, &gen);
+      }
+    });
+  }
+  absl::SleepFor(absl::GetFlag(FLAGS_duration));
+  done = true;
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  absl::Duration elapsed = absl::Now() - start;
+
+  // Sessions are created before the workload starts, so their creation is not
+  // reported.
+  Stats stats;
+  for (const std::unique_ptr<LoadSession>& session : sessions) {
+    for (const auto& [rpc, rpc_stats] : session->stats()) {
+      if (rpc == "CreateSession") {
+        continue;
+      }
+      RpcStats& merged = stats[rpc];
+      merged.latencies.insert(merged.latencies.end(),
+                              rpc_stats.latencies.begin(),
+                              rpc_stats.latencies.end());
+      merged.errors += rpc_stats.errors;
+    }
+  }
+  std::printf("workload: %s, sessions: %d, elapsed: %.1fs\n", workload.c_str(),
+              num_sessions, absl::ToDoubleSeconds(elapsed));
+  PrintStats(stats, elapsed);
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+}  // namespace test
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  absl::Status status = google::spanner::emulator::test::RunLoad();
+  if (!status.ok()) {
+    std::fprintf(stderr, "%s\n", status.ToString().c_str());
+    return 1;
+  }
+  return 0;
+}
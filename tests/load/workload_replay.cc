@@ -0,0 +1,553 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Replays a workload captured by an emulator run with --capture_workload_path
+// against a running emulator, and compares the latency and status of each RPC
+// with those it had when it was captured.
+//
+// Calls are started at their captured offsets, scaled down by --speed, from
+// up to --max_concurrent_calls threads; with --speed=0 each call starts as
+// soon as the calls it depends on are done. The emulator replayed against
+// should start in the state the captured one was in when the capture started,
+// which is the case for a fresh emulator if the capture started with it.
+//
+// The emulator assigns the names of sessions, the ids of transactions and the
+// tokens of partitions itself, and concurrent calls are not assigned the same
+// ones on a replay, so those in the requests replayed are replaced by the
+// ones the replayed calls which created them returned. A call using one of
+// them is only started once the call which created it is done, and the calls
+// on the same session are replayed one at a time, in the order they started.
+//
+// Usage: workload_replay --capture=/tmp/capture [--endpoint=localhost:10007]
+//            [--speed=1] [--max_concurrent_calls=64]
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "google/longrunning/operations.pb.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/message.h"
+#include "google/spanner/admin/database/v1/spanner_database_admin.pb.h"
+#include "google/spanner/admin/instance/v1/spanner_instance_admin.pb.h"
+#include "google/spanner/v1/spanner.pb.h"
+#include "grpcpp/generic/generic_stub.h"
+#include "grpcpp/grpcpp.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "frontend/proto/workload_capture.pb.h"
+#include "frontend/server/workload_capture.h"
+#include "absl/status/status.h"
+#include "zetasql/base/status_macros.h"
+
+ABSL_FLAG(std::string, endpoint, "localhost:10007",
+          "Host and port of the emulator's gRPC server.");
+ABSL_FLAG(std::string, capture, "",
+          "Capture file written by an emulator run with "
+          "--capture_workload_path.");
+ABSL_FLAG(double, speed, 1,
+          "Rate at which the capture is replayed relative to the rate at "
+          "which it was captured, or 0 to replay it as fast as possible.");
+ABSL_FLAG(int, max_concurrent_calls, 64,
+          "Maximum number of calls in flight, each from its own thread.");
+
+namespace google {
+namespace spanner {
+namespace emulator {
+namespace test {
+
+namespace {
+
+namespace database_api = ::google::spanner::admin::database::v1;
+namespace instance_api = ::google::spanner::admin::instance::v1;
+namespace spanner_api = ::google::spanner::v1;
+
+using frontend::CapturedCall;
+
+// The kinds of identifiers which the emulator assigns.
+enum class IdKind { kSession, kTransaction, kPartition };
+
+// An identifier assigned by the emulator.
+using Id = std::pair<IdKind, std::string>;
+
+// Returns the kind of identifier held by field `field` of messages of type
+// `type`, if it holds one.
+absl::optional<IdKind> IdKindOf(const std::string& type,
+                                const std::string& field) {
+  if (field == "session" ||
+      (field == "name" && (type == "google.spanner.v1.Session" ||
+                           type == "google.spanner.v1.GetSessionRequest" ||
+                           type == "google.spanner.v1.DeleteSessionRequest"))) {
+    return IdKind::kSession;
+  }
+  if ((field == "id" && (type == "google.spanner.v1.Transaction" ||
+                         type == "google.spanner.v1.TransactionSelector")) ||
+      (field == "transaction_id" &&
+       (type == "google.spanner.v1.CommitRequest" ||
+        type == "google.spanner.v1.RollbackRequest"))) {
+    return IdKind::kTransaction;
+  }
+  if (field == "partition_token" &&
+      (type == "google.spanner.v1.Partition" ||
+       type == "google.spanner.v1.ExecuteSqlRequest" ||
+       type == "google.spanner.v1.ReadRequest")) {
+    return IdKind::kPartition;
+  }
+  return absl::nullopt;
+}
+
+// Calls `visit` on each identifier held by `message` and the messages nested
+// in it, in field order, and stores back the value `visit` leaves it with.
+void VisitIds(google::protobuf::Message* message,
+              const std::function<void(IdKind, std::string*)>& visit) {
+  const google::protobuf::Descriptor* descriptor = message->GetDescriptor();
+  const google::protobuf::Reflection* reflection = message->GetReflection();
+  // Well-known types, such as the values of query parameters, hold no ids.
+  if (descriptor->file()->package() == "google.protobuf") {
+    return;
+  }
+  for (int i = 0; i < descriptor->field_count(); ++i) {
+    const google::protobuf::FieldDescriptor* field = descriptor->field(i);
+    if (field->cpp_type() ==
+        google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE) {
+      if (field->is_repeated()) {
+        for (int j = 0; j < reflection->FieldSize(*message, field); ++j) {
+          VisitIds(reflection->MutableRepeatedMessage(message, field, j),
+                   visit);
+        }
+      } else if (reflection->HasField(*message, field)) {
+        VisitIds(reflection->MutableMessage(message, field), visit);
+      }
+      continue;
+    }
+    if (field->cpp_type() !=
+            google::protobuf::FieldDescriptor::CPPTYPE_STRING ||
+        field->is_repeated()) {
+      continue;
+    }
+    absl::optional<IdKind> kind =
+        IdKindOf(descriptor->full_name(), field->name());
+    if (!kind.has_value()) {
+      continue;
+    }
+    std::string value = reflection->GetString(*message, field);
+    if (value.empty()) {
+      continue;
+    }
+    visit(*kind, &value);
+    reflection->SetString(message, field, value);
+  }
+}
+
+// Returns the identifiers held by `message`, in the order VisitIds visits
+// them.
+std::vector<Id> CollectIds(google::protobuf::Message* message) {
+  std::vector<Id> ids;
+  VisitIds(message, [&ids](IdKind kind, std::string* value) {
+    ids.emplace_back(kind, *value);
+  });
+  return ids;
+}
+
+// Returns an empty message of the type named `type`, or null if the type is
+// not linked into the binary.
+std::unique_ptr<google::protobuf::Message> NewMessage(
+    const std::string& type) {
+  const google::protobuf::Descriptor* descriptor =
+      google::protobuf::DescriptorPool::generated_pool()
+          ->FindMessageTypeByName(type);
+  if (descriptor == nullptr) {
+    return nullptr;
+  }
+  return std::unique_ptr<google::protobuf::Message>(
+      google::protobuf::MessageFactory::generated_factory()
+          ->GetPrototype(descriptor)
+          ->New());
+}
+
+// Returns `message` parsed as a message of the type named `type`, or null if
+// it cannot be.
+std::unique_ptr<google::protobuf::Message> ParseMessage(
+    const std::string& type, const std::string& message) {
+  std::unique_ptr<google::protobuf::Message> parsed = NewMessage(type);
+  if (parsed == nullptr || !parsed->ParseFromString(message)) {
+    return nullptr;
+  }
+  return parsed;
+}
+
+grpc::ByteBuffer ToByteBuffer(const std::string& message) {
+  grpc::Slice slice(message);
+  return grpc::ByteBuffer(&slice, 1);
+}
+
+std::string FromByteBuffer(const grpc::ByteBuffer& buffer) {
+  std::vector<grpc::Slice> slices;
+  buffer.Dump(&slices);
+  std::string message;
+  for (const grpc::Slice& slice : slices) {
+    message.append(reinterpret_cast<const char*>(slice.begin()), slice.size());
+  }
+  return message;
+}
+
+// Returns the latency which a fraction `q` of the sorted latencies are below.
+absl::Duration Percentile(const std::vector<absl::Duration>& sorted,
+                          double q) {
+  if (sorted.empty()) {
+    return absl::ZeroDuration();
+  }
+  size_t index = static_cast<size_t>(q * sorted.size());
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// Replays the calls of a capture through a generic stub, so that any method
+// served by the emulator can be replayed without knowing its service.
+class Replayer {
+ public:
+  Replayer(std::shared_ptr<grpc::Channel> channel,
+           std::vector<CapturedCall> captured)
+      : stub_(channel) {
+    std::sort(captured.begin(), captured.end(),
+              [](const CapturedCall& a, const CapturedCall& b) {
+                return a.start_offset_micros() < b.start_offset_micros();
+              });
+    calls_ = std::vector<Call>(captured.size());
+    for (size_t i = 0; i < captured.size(); ++i) {
+      calls_[i].captured = std::move(captured[i]);
+    }
+    FindDependencies();
+  }
+
+  // Replays the calls from `num_threads` threads, starting each at its
+  // captured offset divided by `speed`, or as soon as possible if `speed` is
+  // 0.
+  void Run(int num_threads, double speed) {
+    std::atomic<size_t> next(0);
+    const absl::Time start = absl::Now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; ++i) {
+      threads.emplace_back([&]() {
+        for (size_t index = next++; index < calls_.size(); index = next++) {
+          Call& call = calls_[index];
+          if (speed > 0) {
+            absl::SleepFor(
+                start +
+                absl::Microseconds(call.captured.start_offset_micros()) /
+                    speed -
+                absl::Now());
+          }
+          for (size_t dependency : call.dependencies) {
+            calls_[dependency].done.WaitForNotification();
+          }
+          Replay(&call);
+          call.done.Notify();
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    elapsed_ = absl::Now() - start;
+  }
+
+  // Prints the captured and replayed latencies and errors of each method.
+  void PrintReport() const {
+    struct MethodStats {
+      std::vector<absl::Duration> captured;
+      std::vector<absl::Duration> replayed;
+      int64_t captured_errors = 0;
+      int64_t replayed_errors = 0;
+    };
+    std::map<std::string, MethodStats> stats;
+    int64_t mismatches = 0;
+    absl::Duration captured_span = absl::ZeroDuration();
+    for (const Call& call : calls_) {
+      MethodStats& method_stats = stats[call.captured.method()];
+      method_stats.captured.push_back(
+          absl::Microseconds(call.captured.latency_micros()));
+      method_stats.replayed.push_back(call.latency);
+      method_stats.captured_errors += call.captured.status_code() != 0;
+      method_stats.replayed_errors += call.status_code != 0;
+      if (call.status_code != call.captured.status_code()) {
+        ++mismatches;
+      }
+      captured_span = std::max(
+          captured_span,
+          absl::Microseconds(call.captured.start_offset_micros() +
+                             call.captured.latency_micros()));
+    }
+    std::printf("calls: %zu, captured over: %.1fs, replayed in: %.1fs, "
+                "status mismatches: %lld\n",
+                calls_.size(), absl::ToDoubleSeconds(captured_span),
+                absl::ToDoubleSeconds(elapsed_),
+                static_cast<long long>(mismatches));  // NOLINT
+    std::printf("%-52s %8s %10s %10s %10s %10s %8s %8s\n", "rpc", "calls",
+                "p50 ms", "was", "p99 ms", "was", "errors", "was");
+    for (auto& [method, method_stats] : stats) {
+      std::sort(method_stats.captured.begin(), method_stats.captured.end());
+      std::sort(method_stats.replayed.begin(), method_stats.replayed.end());
+      std::printf(
+          "%-52s %8zu %10.3f %10.3f %10.3f %10.3f %8lld %8lld\n",
+          method.c_str(), method_stats.replayed.size(),
+          absl::ToDoubleMilliseconds(Percentile(method_stats.replayed, 0.5)),
+          absl::ToDoubleMilliseconds(Percentile(method_stats.captured, 0.5)),
+          absl::ToDoubleMilliseconds(Percentile(method_stats.replayed, 0.99)),
+          absl::ToDoubleMilliseconds(Percentile(method_stats.captured, 0.99)),
+          static_cast<long long>(method_stats.replayed_errors),   // NOLINT
+          static_cast<long long>(method_stats.captured_errors));  // NOLINT
+    }
+  }
+
+ private:
+  struct Call {
+    CapturedCall captured;
+
+    // Indexes of the calls which must be done before this one starts.
+    std::vector<size_t> dependencies;
+
+    // Notified once the call has been replayed.
+    absl::Notification done;
+
+    absl::Duration latency;
+    int status_code = 0;
+  };
+
+  // Makes each call depend on the calls which created the identifiers it uses,
+  // and on the previous call on each session it uses.
+  void FindDependencies() {
+    std::map<Id, size_t> creators;
+    std::map<std::string, size_t> last_on_session;
+    for (size_t i = 0; i < calls_.size(); ++i) {
+      Call& call = calls_[i];
+      std::unique_ptr<google::protobuf::Message> request = ParseMessage(
+          call.captured.request_type(), call.captured.request());
+      if (request != nullptr) {
+        for (const Id& id : CollectIds(request.get())) {
+          auto creator = creators.find(id);
+          if (creator != creators.end()) {
+            call.dependencies.push_back(creator->second);
+          }
+          if (id.first == IdKind::kSession) {
+            auto [last, inserted] = last_on_session.emplace(id.second, i);
+            if (!inserted) {
+              call.dependencies.push_back(last->second);
+              last->second = i;
+            }
+          }
+        }
+      }
+      std::unique_ptr<google::protobuf::Message> response = ParseMessage(
+          call.captured.response_type(), call.captured.first_response());
+      if (response != nullptr) {
+        for (const Id& id : CollectIds(response.get())) {
+          creators.emplace(id, i);
+        }
+      }
+    }
+  }
+
+  // Replays `call` with the identifiers it uses replaced by those assigned on
+  // the replay, and learns the identifiers its response assigns.
+  void Replay(Call* call) {
+    const CapturedCall& captured = call->captured;
+    std::string request = captured.request();
+    std::unique_ptr<google::protobuf::Message> parsed =
+        ParseMessage(captured.request_type(), request);
+    if (parsed != nullptr) {
+      {
+        absl::MutexLock lock(&mu_);
+        VisitIds(parsed.get(), [this](IdKind kind, std::string* value) {
+          auto replayed = replayed_ids_.find(Id(kind, *value));
+          if (replayed != replayed_ids_.end()) {
+            *value = replayed->second;
+          }
+        });
+      }
+      request = parsed->SerializeAsString();
+    }
+
+    std::string response;
+    const absl::Time start = absl::Now();
+    grpc::Status status =
+        captured.server_streaming()
+            ? CallStreaming(captured.method(), request, &response)
+            : CallUnary(captured.method(), request, &response);
+    call->latency = absl::Now() - start;
+    call->status_code = status.error_code();
+    if (!status.ok() || !captured.has_first_response()) {
+      return;
+    }
+
+    std::unique_ptr<google::protobuf::Message> captured_response =
+        ParseMessage(captured.response_type(), captured.first_response());
+    std::unique_ptr<google::protobuf::Message> replayed_response =
+        ParseMessage(captured.response_type(), response);
+    if (captured_response == nullptr || replayed_response == nullptr) {
+      return;
+    }
+    std::vector<Id> captured_ids = CollectIds(captured_response.get());
+    std::vector<Id> replayed_ids = CollectIds(replayed_response.get());
+    absl::MutexLock lock(&mu_);
+    for (size_t i = 0; i < std::min(captured_ids.size(), replayed_ids.size());
+         ++i) {
+      if (captured_ids[i].first != replayed_ids[i].first) {
+        break;
+      }
+      replayed_ids_.emplace(captured_ids[i], replayed_ids[i].second);
+    }
+  }
+
+  // Calls unary method `method` with `request`, storing its response in
+  // `response`.
+  grpc::Status CallUnary(const std::string& method, const std::string& request,
+                         std::string* response) {
+    grpc::ClientContext context;
+    grpc::CompletionQueue cq;
+    std::unique_ptr<grpc::GenericClientAsyncResponseReader> call =
+        stub_.PrepareUnaryCall(&context, method, ToByteBuffer(request), &cq);
+    call->StartCall();
+    grpc::ByteBuffer buffer;
+    grpc::Status status;
+    call->Finish(&buffer, &status, /*tag=*/this);
+    Await(&cq);
+    Drain(&cq);
+    if (status.ok()) {
+      *response = FromByteBuffer(buffer);
+    }
+    return status;
+  }
+
+  // Calls server streaming method `method` with `request`, reading all of its
+  // responses and storing the first in `response`.
+  grpc::Status CallStreaming(const std::string& method,
+                             const std::string& request,
+                             std::string* response) {
+    grpc::ClientContext context;
+    grpc::CompletionQueue cq;
+    std::unique_ptr<grpc::GenericClientAsyncReaderWriter> call =
+        stub_.PrepareCall(&context, method, &cq);
+    call->StartCall(/*tag=*/this);
+    bool ok = Await(&cq);
+    if (ok) {
+      call->Write(ToByteBuffer(request), /*tag=*/this);
+      ok = Await(&cq);
+    }
+    if (ok) {
+      call->WritesDone(/*tag=*/this);
+      ok = Await(&cq);
+    }
+    for (bool first = true; ok; first = false) {
+      grpc::ByteBuffer buffer;
+      call->Read(&buffer, /*tag=*/this);
+      ok = Await(&cq);
+      if (ok && first) {
+        *response = FromByteBuffer(buffer);
+      }
+    }
+    grpc::Status status;
+    call->Finish(&status, /*tag=*/this);
+    Await(&cq);
+    Drain(&cq);
+    return status;
+  }
+
+  // Waits for the operation pending on `cq`, and returns whether it
+  // succeeded.
+  static bool Await(grpc::CompletionQueue* cq) {
+    void* tag;
+    bool ok = false;
+    return cq->Next(&tag, &ok) && ok;
+  }
+
+  static void Drain(grpc::CompletionQueue* cq) {
+    cq->Shutdown();
+    void* tag;
+    bool ok;
+    while (cq->Next(&tag, &ok)) {
+    }
+  }
+
+  grpc::GenericStub stub_;
+  std::vector<Call> calls_;
+  absl::Duration elapsed_;
+
+  absl::Mutex mu_;
+
+  // The identifiers assigned on the replay, keyed by those captured.
+  std::map<Id, std::string> replayed_ids_ ABSL_GUARDED_BY(mu_);
+};
+
+absl::Status RunReplay() {
+  const std::string path = absl::GetFlag(FLAGS_capture);
+  if (path.empty()) {
+    return absl::InvalidArgumentError("--capture is required.");
+  }
+  const double speed = absl::GetFlag(FLAGS_speed);
+  if (speed < 0) {
+    return absl::InvalidArgumentError("--speed must not be negative.");
+  }
+  ZETASQL_ASSIGN_OR_RETURN(std::vector<CapturedCall> calls,
+                   frontend::workload_capture::ReadCapture(path));
+
+  // Messages are looked up by name in the generated pool, which only holds
+  // the types of the files linked in; refer to one type of each API so that
+  // all of them are.
+  const google::protobuf::Descriptor* const linked[] = {
+      spanner_api::Session::descriptor(),
+      database_api::Database::descriptor(),
+      instance_api::Instance::descriptor(),
+      ::google::longrunning::Operation::descriptor(),
+  };
+  (void)linked;
+
+  Replayer replayer(grpc::CreateChannel(absl::GetFlag(FLAGS_endpoint),
+                                        grpc::InsecureChannelCredentials()),
+                    std::move(calls));
+  replayer.Run(absl::GetFlag(FLAGS_max_concurrent_calls), speed);
+  replayer.PrintReport();
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+}  // namespace test
+}  // namespace emulator
+}  // namespace spanner
+}  // namespace google
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  absl::Status status = google::spanner::emulator::test::RunReplay();
+  if (!status.ok()) {
+    std::fprintf(stderr, "%s\n", status.ToString().c_str());
+    return 1;
+  }
+  return 0;
+}